@@ -0,0 +1,668 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * dmu_bench runs a single DMU workload against a throw-away pool built on
+ * file vdevs, entirely in userspace through libzpool, and reports the
+ * throughput, latency percentiles and CPU time per operation.  It is meant
+ * for A/B comparisons of changes to the DMU, ARC and ZIL hot paths: the
+ * same command line against two builds measures the same code paths,
+ * without a kernel module or the noise of a real file system on top.
+ *
+ * Each thread works on its own object, so no range locking is needed.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/dmu.h>
+#include <sys/dmu_objset.h>
+#include <sys/dmu_tx.h>
+#include <sys/dsl_prop.h>
+#include <sys/arc.h>
+#include <sys/txg.h>
+#include <sys/zil.h>
+#include <sys/fs/zfs.h>
+#include <sys/zfeature.h>
+#include <sys/resource.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define	BENCH_POOL		"dmu_bench"
+#define	BENCH_DATASET		BENCH_POOL "/bench"
+#define	BENCH_VDEV_TEMPLATE	"%s/dmu_bench.%d"
+#define	BENCH_PREFILL_CHUNK	(1ULL << 20)
+
+/*
+ * Latencies are kept in log-linear histograms: each power of two is split
+ * into 1 << LAT_SUB_SHIFT buckets, so percentiles are accurate to 12.5%.
+ */
+#define	LAT_SUB_SHIFT		3
+#define	LAT_SUB_BUCKETS		(1 << LAT_SUB_SHIFT)
+#define	LAT_BUCKETS		(64 * LAT_SUB_BUCKETS)
+
+typedef enum bench_workload {
+	BENCH_CREATE,		/* allocate empty objects */
+	BENCH_RANDREAD,		/* random block reads */
+	BENCH_RANDWRITE,	/* random block writes */
+	BENCH_FSYNC,		/* random block writes, each committed */
+	BENCH_PREFETCH,		/* sequential reads with prefetch */
+	BENCH_DEDUP,		/* random block writes to a dedup dataset */
+	BENCH_NUM
+} bench_workload_t;
+
+static const char *const bench_workload_name[BENCH_NUM] = {
+	"create", "randread", "randwrite", "fsync", "prefetch", "dedup"
+};
+
+typedef struct bench_opts {
+	const char	*bo_dir;
+	uint64_t	bo_vdev_size;
+	int		bo_vdevs;
+	uint64_t	bo_blocksize;
+	uint64_t	bo_filesize;
+	int		bo_threads;
+	int		bo_seconds;
+	int		bo_dedup_ratio;
+	boolean_t	bo_warm;
+	bench_workload_t bo_workload;
+} bench_opts_t;
+
+typedef struct bench_thread {
+	int		bt_id;
+	uint64_t	bt_object;
+	uint64_t	bt_offset;	/* sequential cursor */
+	uint64_t	bt_seed;
+	void		*bt_buf;
+	uint64_t	bt_ops;
+	uint64_t	bt_bytes;
+	uint64_t	bt_lat[LAT_BUCKETS];
+} bench_thread_t;
+
+static bench_opts_t bench_opts = {
+	.bo_dir = "/tmp",
+	.bo_vdev_size = 1ULL << 30,
+	.bo_vdevs = 1,
+	.bo_blocksize = 1ULL << 14,
+	.bo_filesize = 1ULL << 26,
+	.bo_threads = 4,
+	.bo_seconds = 10,
+	.bo_dedup_ratio = 4,
+	.bo_warm = B_FALSE,
+	.bo_workload = BENCH_RANDWRITE,
+};
+
+static objset_t *bench_os;
+static zilog_t *bench_zilog;
+static volatile boolean_t bench_stop;
+static void **bench_dedup_bufs;
+static uint64_t bench_dedup_count;
+
+static void
+usage(boolean_t requested)
+{
+	const bench_opts_t *o = &bench_opts;
+	FILE *fp = requested ? stdout : stderr;
+
+	(void) fprintf(fp, "Usage: dmu_bench [-W] [-w workload] "
+	    "[-t threads] [-T seconds]\n"
+	    "\t[-b blocksize] [-f filesize] [-r dedup_ratio]\n"
+	    "\t[-d dir] [-n vdevs] [-s vdev_size]\n\n"
+	    "\t[-w workload]    one of:");
+	for (int i = 0; i < BENCH_NUM; i++)
+		(void) fprintf(fp, " %s", bench_workload_name[i]);
+	(void) fprintf(fp, " (default: %s)\n"
+	    "\t[-t threads]     worker threads (default: %d)\n"
+	    "\t[-T seconds]     duration of the run (default: %d)\n"
+	    "\t[-b blocksize]   object block and I/O size (default: %llu)\n"
+	    "\t[-f filesize]    size of the object of each thread "
+	    "(default: %llu)\n"
+	    "\t[-r ratio]       dedup ratio of the dedup workload "
+	    "(default: %d)\n"
+	    "\t[-W]             do not drop the ARC before read workloads\n"
+	    "\t[-d dir]         directory of the file vdevs (default: %s)\n"
+	    "\t[-n vdevs]       number of file vdevs (default: %d)\n"
+	    "\t[-s vdev_size]   size of each file vdev (default: %llu)\n"
+	    "\t[-h]             print this help\n",
+	    bench_workload_name[o->bo_workload], o->bo_threads,
+	    o->bo_seconds, (u_longlong_t)o->bo_blocksize,
+	    (u_longlong_t)o->bo_filesize, o->bo_dedup_ratio, o->bo_dir,
+	    o->bo_vdevs, (u_longlong_t)o->bo_vdev_size);
+
+	exit(requested ? 0 : 1);
+}
+
+static uint64_t
+parse_size(const char *arg)
+{
+	char *end;
+	uint64_t val = strtoull(arg, &end, 0);
+
+	switch (*end) {
+	case 'k': case 'K':
+		val <<= 10;
+		end++;
+		break;
+	case 'm': case 'M':
+		val <<= 20;
+		end++;
+		break;
+	case 'g': case 'G':
+		val <<= 30;
+		end++;
+		break;
+	}
+	if (*end != '\0' || val == 0) {
+		(void) fprintf(stderr, "invalid size '%s'\n", arg);
+		usage(B_FALSE);
+	}
+	return (val);
+}
+
+static void
+process_options(int argc, char **argv)
+{
+	bench_opts_t *o = &bench_opts;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "b:d:f:hn:r:s:t:T:w:W")) != -1) {
+		switch (opt) {
+		case 'b':
+			o->bo_blocksize = parse_size(optarg);
+			break;
+		case 'd':
+			o->bo_dir = optarg;
+			break;
+		case 'f':
+			o->bo_filesize = parse_size(optarg);
+			break;
+		case 'h':
+			usage(B_TRUE);
+			break;
+		case 'n':
+			o->bo_vdevs = MAX(1, atoi(optarg));
+			break;
+		case 'r':
+			o->bo_dedup_ratio = MAX(1, atoi(optarg));
+			break;
+		case 's':
+			o->bo_vdev_size = parse_size(optarg);
+			break;
+		case 't':
+			o->bo_threads = MAX(1, atoi(optarg));
+			break;
+		case 'T':
+			o->bo_seconds = MAX(1, atoi(optarg));
+			break;
+		case 'w':
+			for (i = 0; i < BENCH_NUM; i++) {
+				if (strcmp(optarg, bench_workload_name[i]) == 0)
+					break;
+			}
+			if (i == BENCH_NUM) {
+				(void) fprintf(stderr, "unknown workload "
+				    "'%s'\n", optarg);
+				usage(B_FALSE);
+			}
+			o->bo_workload = i;
+			break;
+		case 'W':
+			o->bo_warm = B_TRUE;
+			break;
+		default:
+			usage(B_FALSE);
+		}
+	}
+
+	if (!ISP2(o->bo_blocksize) || o->bo_blocksize < SPA_MINBLOCKSIZE ||
+	    o->bo_blocksize > SPA_MAXBLOCKSIZE) {
+		(void) fprintf(stderr, "blocksize must be a power of 2 "
+		    "between %d and %d\n", (int)SPA_MINBLOCKSIZE,
+		    (int)SPA_MAXBLOCKSIZE);
+		exit(1);
+	}
+	if (o->bo_filesize < o->bo_blocksize) {
+		(void) fprintf(stderr, "filesize must be at least one block\n");
+		exit(1);
+	}
+}
+
+/* xorshift64*, one state per thread so the workers do not contend */
+static uint64_t
+bench_random(bench_thread_t *bt)
+{
+	bt->bt_seed ^= bt->bt_seed >> 12;
+	bt->bt_seed ^= bt->bt_seed << 25;
+	bt->bt_seed ^= bt->bt_seed >> 27;
+	return (bt->bt_seed * 0x2545F4914F6CDD1DULL);
+}
+
+static uint_t
+lat_bucket(uint64_t ns)
+{
+	if (ns < LAT_SUB_BUCKETS)
+		return (ns);
+
+	int msb = highbit64(ns) - 1;
+	uint_t sub = (ns >> (msb - LAT_SUB_SHIFT)) & (LAT_SUB_BUCKETS - 1);
+
+	return ((msb - LAT_SUB_SHIFT + 1) * LAT_SUB_BUCKETS + sub);
+}
+
+/* upper bound of a latency bucket, in nanoseconds */
+static uint64_t
+lat_bucket_max(uint_t b)
+{
+	if (b < LAT_SUB_BUCKETS)
+		return (b + 1);
+
+	int msb = b / LAT_SUB_BUCKETS + LAT_SUB_SHIFT - 1;
+	uint64_t sub = b % LAT_SUB_BUCKETS;
+
+	return ((LAT_SUB_BUCKETS + sub + 1) << (msb - LAT_SUB_SHIFT));
+}
+
+static uint64_t
+lat_percentile(const uint64_t *lat, uint64_t total, double pct)
+{
+	uint64_t target = (uint64_t)(total * pct / 100.0);
+	uint64_t seen = 0;
+
+	for (uint_t b = 0; b < LAT_BUCKETS; b++) {
+		seen += lat[b];
+		if (seen > target)
+			return (lat_bucket_max(b));
+	}
+	return (lat_bucket_max(LAT_BUCKETS - 1));
+}
+
+static nvlist_t *
+make_vdev_root(void)
+{
+	const bench_opts_t *o = &bench_opts;
+	nvlist_t *root, **child;
+	char path[MAXPATHLEN];
+
+	child = umem_alloc(o->bo_vdevs * sizeof (nvlist_t *), UMEM_NOFAIL);
+	for (int c = 0; c < o->bo_vdevs; c++) {
+		(void) snprintf(path, sizeof (path), BENCH_VDEV_TEMPLATE,
+		    o->bo_dir, c);
+		int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+		if (fd == -1 || ftruncate(fd, o->bo_vdev_size) != 0) {
+			(void) fprintf(stderr, "can't create %s: %s\n", path,
+			    strerror(errno));
+			exit(1);
+		}
+		(void) close(fd);
+
+		child[c] = fnvlist_alloc();
+		fnvlist_add_string(child[c], ZPOOL_CONFIG_TYPE, VDEV_TYPE_FILE);
+		fnvlist_add_string(child[c], ZPOOL_CONFIG_PATH, path);
+		fnvlist_add_uint64(child[c], ZPOOL_CONFIG_IS_LOG, 0);
+	}
+
+	root = fnvlist_alloc();
+	fnvlist_add_string(root, ZPOOL_CONFIG_TYPE, VDEV_TYPE_ROOT);
+	fnvlist_add_nvlist_array(root, ZPOOL_CONFIG_CHILDREN,
+	    (const nvlist_t **)child, o->bo_vdevs);
+
+	for (int c = 0; c < o->bo_vdevs; c++)
+		fnvlist_free(child[c]);
+	umem_free(child, o->bo_vdevs * sizeof (nvlist_t *));
+
+	return (root);
+}
+
+static void
+bench_remove_vdevs(void)
+{
+	char path[MAXPATHLEN];
+
+	for (int c = 0; c < bench_opts.bo_vdevs; c++) {
+		(void) snprintf(path, sizeof (path), BENCH_VDEV_TEMPLATE,
+		    bench_opts.bo_dir, c);
+		(void) unlink(path);
+	}
+}
+
+static void
+bench_pool_create(void)
+{
+	nvlist_t *nvroot, *props;
+
+	(void) spa_destroy(BENCH_POOL);
+
+	nvroot = make_vdev_root();
+	props = fnvlist_alloc();
+	for (int i = 0; i < SPA_FEATURES; i++) {
+		char *buf;
+
+		if (!spa_feature_table[i].fi_zfs_mod_supported)
+			continue;
+		VERIFY3S(-1, !=, asprintf(&buf, "feature@%s",
+		    spa_feature_table[i].fi_uname));
+		fnvlist_add_uint64(props, buf, 0);
+		free(buf);
+	}
+	VERIFY0(spa_create(BENCH_POOL, nvroot, props, NULL, NULL));
+	fnvlist_free(nvroot);
+	fnvlist_free(props);
+
+	VERIFY0(dmu_objset_create(BENCH_DATASET, DMU_OST_OTHER, 0, NULL,
+	    NULL, NULL));
+	if (bench_opts.bo_workload == BENCH_DEDUP) {
+		VERIFY0(dsl_prop_set_int(BENCH_DATASET,
+		    zfs_prop_to_name(ZFS_PROP_DEDUP), ZPROP_SRC_LOCAL,
+		    ZIO_CHECKSUM_ON));
+	}
+	VERIFY0(dmu_objset_own(BENCH_DATASET, DMU_OST_OTHER, B_FALSE, B_TRUE,
+	    &bench_os, &bench_os));
+}
+
+static void
+bench_pool_destroy(void)
+{
+	if (bench_zilog != NULL)
+		zil_close(bench_zilog);
+	dmu_objset_disown(bench_os, B_TRUE, &bench_os);
+	VERIFY0(spa_destroy(BENCH_POOL));
+	bench_remove_vdevs();
+}
+
+/*
+ * Only WR_NEED_COPY records are logged, so the ZIL always asks for the
+ * data to be copied into the log block and never for a dmu_sync().
+ */
+static int
+bench_get_data(void *arg, uint64_t arg2, lr_write_t *lr, char *buf,
+    struct lwb *lwb, zio_t *zio)
+{
+	(void) arg, (void) arg2, (void) lwb, (void) zio;
+
+	ASSERT3P(buf, !=, NULL);
+	return (dmu_read(bench_os, lr->lr_foid, lr->lr_offset, lr->lr_length,
+	    buf, DMU_READ_NO_PREFETCH | DMU_KEEP_CACHING));
+}
+
+static uint64_t
+bench_object_alloc(uint64_t blocksize)
+{
+	dmu_tx_t *tx;
+	uint64_t object;
+
+	tx = dmu_tx_create(bench_os);
+	dmu_tx_hold_bonus(tx, DMU_NEW_OBJECT);
+	VERIFY0(dmu_tx_assign(tx, DMU_TX_WAIT));
+	object = dmu_object_alloc(bench_os, DMU_OT_UINT64_OTHER, blocksize,
+	    DMU_OT_NONE, 0, tx);
+	dmu_tx_commit(tx);
+
+	return (object);
+}
+
+static void
+bench_write(bench_thread_t *bt, uint64_t offset, uint64_t size,
+    const void *buf, boolean_t logged)
+{
+	dmu_tx_t *tx;
+
+	tx = dmu_tx_create(bench_os);
+	dmu_tx_hold_write(tx, bt->bt_object, offset, size);
+	VERIFY0(dmu_tx_assign(tx, DMU_TX_WAIT));
+	dmu_write(bench_os, bt->bt_object, offset, size, buf, tx);
+
+	if (logged) {
+		itx_t *itx = zil_itx_create(TX_WRITE, sizeof (lr_write_t));
+		lr_write_t *lr = (lr_write_t *)&itx->itx_lr;
+
+		lr->lr_foid = bt->bt_object;
+		lr->lr_offset = offset;
+		lr->lr_length = size;
+		lr->lr_blkoff = 0;
+		BP_ZERO(&lr->lr_blkptr);
+		itx->itx_wr_state = WR_NEED_COPY;
+		itx->itx_sync = B_TRUE;
+		itx->itx_oid = bt->bt_object;
+		zil_itx_assign(bench_zilog, itx, tx);
+	}
+	dmu_tx_commit(tx);
+}
+
+/*
+ * Fill the object of each thread so that reads hit allocated blocks.
+ */
+static void
+bench_prefill(bench_thread_t *threads)
+{
+	const bench_opts_t *o = &bench_opts;
+	uint64_t chunk = MAX(BENCH_PREFILL_CHUNK, o->bo_blocksize);
+	void *buf = umem_alloc(chunk, UMEM_NOFAIL);
+
+	random_get_pseudo_bytes(buf, chunk);
+	for (int t = 0; t < o->bo_threads; t++) {
+		for (uint64_t off = 0; off < o->bo_filesize; off += chunk) {
+			bench_write(&threads[t], off,
+			    MIN(chunk, o->bo_filesize - off), buf, B_FALSE);
+		}
+	}
+	umem_free(buf, chunk);
+
+	txg_wait_synced(dmu_objset_pool(bench_os), 0);
+	if (!o->bo_warm)
+		arc_flush(NULL, B_TRUE);
+}
+
+static void
+bench_dedup_init(void)
+{
+	const bench_opts_t *o = &bench_opts;
+	uint64_t blocks = o->bo_filesize / o->bo_blocksize * o->bo_threads;
+
+	bench_dedup_count = MAX(1, blocks / o->bo_dedup_ratio);
+	bench_dedup_bufs = umem_alloc(bench_dedup_count * sizeof (void *),
+	    UMEM_NOFAIL);
+	for (uint64_t i = 0; i < bench_dedup_count; i++) {
+		bench_dedup_bufs[i] = umem_alloc(o->bo_blocksize, UMEM_NOFAIL);
+		random_get_pseudo_bytes(bench_dedup_bufs[i], o->bo_blocksize);
+	}
+}
+
+static void
+bench_dedup_fini(void)
+{
+	for (uint64_t i = 0; i < bench_dedup_count; i++)
+		umem_free(bench_dedup_bufs[i], bench_opts.bo_blocksize);
+	umem_free(bench_dedup_bufs, bench_dedup_count * sizeof (void *));
+}
+
+static void
+bench_thread(void *arg)
+{
+	bench_thread_t *bt = arg;
+	const bench_opts_t *o = &bench_opts;
+	uint64_t bs = o->bo_blocksize;
+	uint64_t nblocks = o->bo_filesize / bs;
+	uint64_t offset;
+	hrtime_t start;
+
+	while (!bench_stop) {
+		offset = (bench_random(bt) % nblocks) * bs;
+		start = gethrtime();
+
+		switch (o->bo_workload) {
+		case BENCH_CREATE:
+			(void) bench_object_alloc(0);
+			break;
+		case BENCH_RANDREAD:
+			VERIFY0(dmu_read(bench_os, bt->bt_object, offset, bs,
+			    bt->bt_buf, DMU_READ_NO_PREFETCH));
+			bt->bt_bytes += bs;
+			break;
+		case BENCH_RANDWRITE:
+			bench_write(bt, offset, bs, bt->bt_buf, B_FALSE);
+			bt->bt_bytes += bs;
+			break;
+		case BENCH_FSYNC:
+			bench_write(bt, offset, bs, bt->bt_buf, B_TRUE);
+			zil_commit(bench_zilog, bt->bt_object);
+			bt->bt_bytes += bs;
+			break;
+		case BENCH_PREFETCH:
+			VERIFY0(dmu_read(bench_os, bt->bt_object,
+			    bt->bt_offset, bs, bt->bt_buf, DMU_READ_PREFETCH));
+			bt->bt_offset = (bt->bt_offset + bs) % (nblocks * bs);
+			bt->bt_bytes += bs;
+			break;
+		case BENCH_DEDUP:
+			bench_write(bt, offset, bs, bench_dedup_bufs[
+			    bench_random(bt) % bench_dedup_count], B_FALSE);
+			bt->bt_bytes += bs;
+			break;
+		default:
+			break;
+		}
+
+		bt->bt_lat[lat_bucket(gethrtime() - start)]++;
+		bt->bt_ops++;
+	}
+
+	thread_exit();
+}
+
+static double
+rusage_secs(const struct rusage *ru)
+{
+	return (ru->ru_utime.tv_sec + ru->ru_stime.tv_sec +
+	    (ru->ru_utime.tv_usec + ru->ru_stime.tv_usec) / 1e6);
+}
+
+static void
+bench_report(bench_thread_t *threads, hrtime_t elapsed, double cpu)
+{
+	const bench_opts_t *o = &bench_opts;
+	uint64_t *lat = umem_zalloc(sizeof (uint64_t) * LAT_BUCKETS,
+	    UMEM_NOFAIL);
+	uint64_t ops = 0, bytes = 0;
+	double secs = (double)elapsed / NANOSEC;
+
+	for (int t = 0; t < o->bo_threads; t++) {
+		ops += threads[t].bt_ops;
+		bytes += threads[t].bt_bytes;
+		for (uint_t b = 0; b < LAT_BUCKETS; b++)
+			lat[b] += threads[t].bt_lat[b];
+	}
+
+	(void) printf("workload  %s\n", bench_workload_name[o->bo_workload]);
+	(void) printf("threads   %d\n", o->bo_threads);
+	(void) printf("blocksize %llu\n", (u_longlong_t)o->bo_blocksize);
+	(void) printf("seconds   %.2f\n", secs);
+	(void) printf("ops       %llu\n", (u_longlong_t)ops);
+	(void) printf("ops/s     %.0f\n", ops / secs);
+	(void) printf("MiB/s     %.1f\n", bytes / secs / (1 << 20));
+	if (ops > 0) {
+		(void) printf("lat p50   %llu us\n", (u_longlong_t)
+		    lat_percentile(lat, ops, 50.0) / 1000);
+		(void) printf("lat p90   %llu us\n", (u_longlong_t)
+		    lat_percentile(lat, ops, 90.0) / 1000);
+		(void) printf("lat p99   %llu us\n", (u_longlong_t)
+		    lat_percentile(lat, ops, 99.0) / 1000);
+		(void) printf("lat p99.9 %llu us\n", (u_longlong_t)
+		    lat_percentile(lat, ops, 99.9) / 1000);
+		(void) printf("cpu/op    %.1f us\n", cpu * 1e6 / ops);
+	}
+
+	umem_free(lat, sizeof (uint64_t) * LAT_BUCKETS);
+}
+
+int
+main(int argc, char **argv)
+{
+	const bench_opts_t *o = &bench_opts;
+	bench_thread_t *threads;
+	kthread_t **tids;
+	struct rusage ru_start, ru_end;
+	hrtime_t start;
+
+	(void) setvbuf(stdout, NULL, _IOLBF, 0);
+	dprintf_setup(&argc, argv);
+	process_options(argc, argv);
+
+	VERIFY3S(-1, !=, asprintf((char **)&spa_config_path,
+	    "%s/dmu_bench.cache", o->bo_dir));
+	kernel_init(SPA_MODE_READ | SPA_MODE_WRITE);
+
+	bench_pool_create();
+	if (o->bo_workload == BENCH_FSYNC)
+		bench_zilog = zil_open(bench_os, bench_get_data, NULL);
+	if (o->bo_workload == BENCH_DEDUP)
+		bench_dedup_init();
+
+	threads = umem_zalloc(o->bo_threads * sizeof (bench_thread_t),
+	    UMEM_NOFAIL);
+	tids = umem_zalloc(o->bo_threads * sizeof (kthread_t *),
+	    UMEM_NOFAIL);
+	for (int t = 0; t < o->bo_threads; t++) {
+		bench_thread_t *bt = &threads[t];
+
+		bt->bt_id = t;
+		bt->bt_seed = gethrtime() ^ ((uint64_t)(t + 1) << 32);
+		bt->bt_buf = umem_alloc(o->bo_blocksize, UMEM_NOFAIL);
+		random_get_pseudo_bytes(bt->bt_buf, o->bo_blocksize);
+		if (o->bo_workload != BENCH_CREATE)
+			bt->bt_object = bench_object_alloc(o->bo_blocksize);
+	}
+	if (o->bo_workload == BENCH_RANDREAD ||
+	    o->bo_workload == BENCH_PREFETCH)
+		bench_prefill(threads);
+
+	VERIFY0(getrusage(RUSAGE_SELF, &ru_start));
+	start = gethrtime();
+	for (int t = 0; t < o->bo_threads; t++) {
+		tids[t] = thread_create(NULL, 0, bench_thread, &threads[t], 0,
+		    NULL, TS_RUN | TS_JOINABLE, defclsyspri);
+	}
+	(void) sleep(o->bo_seconds);
+	bench_stop = B_TRUE;
+	for (int t = 0; t < o->bo_threads; t++)
+		VERIFY0(thread_join(tids[t]));
+	hrtime_t elapsed = gethrtime() - start;
+	VERIFY0(getrusage(RUSAGE_SELF, &ru_end));
+
+	bench_report(threads, elapsed,
+	    rusage_secs(&ru_end) - rusage_secs(&ru_start));
+
+	for (int t = 0; t < o->bo_threads; t++)
+		umem_free(threads[t].bt_buf, o->bo_blocksize);
+	umem_free(threads, o->bo_threads * sizeof (bench_thread_t));
+	umem_free(tids, o->bo_threads * sizeof (kthread_t *));
+	if (o->bo_workload == BENCH_DEDUP)
+		bench_dedup_fini();
+
+	bench_pool_destroy();
+	kernel_fini();
+	(void) unlink(spa_config_path);
+
+	return (0);
+}
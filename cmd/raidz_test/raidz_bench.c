@@ -27,6 +27,7 @@
 #include <sys/zfs_context.h>
 #include <sys/time.h>
 #include <sys/wait.h>
+#include <sys/utsname.h>
 #include <sys/zio.h>
 #include <sys/vdev_raidz.h>
 #include <sys/vdev_raidz_impl.h>
@@ -40,9 +41,63 @@
 #define	MIN_CS_SHIFT		BENCH_ASHIFT
 #define	MAX_CS_SHIFT		SPA_MAXBLOCKSHIFT
 
+/*
+ * The full sweep (-B -S) visits several thousand configurations, so each
+ * one is measured over a fraction of the memory used by the default run.
+ */
+#define	SWEEP_MEMORY_SHIFT	6
+
+/* Size of each child of the gang ABD layout */
+#define	GANG_CHILD_SIZE		(1ULL << 17)
+
+typedef enum bench_abd {
+	BENCH_ABD_LINEAR,
+	BENCH_ABD_SCATTER,
+	BENCH_ABD_GANG,
+	BENCH_ABD_NUM
+} bench_abd_t;
+
+static const char *const bench_abd_name[BENCH_ABD_NUM] = {
+	"linear", "scatter", "gang"
+};
+
+typedef enum bench_map {
+	BENCH_MAP_NORMAL,	/* regular raidz map */
+	BENCH_MAP_EXPANDED,	/* expanded map, reflow completed */
+	BENCH_MAP_REFLOW,	/* expanded map, reflow half way into block */
+	BENCH_MAP_NUM
+} bench_map_t;
+
+static const char *const bench_map_name[BENCH_MAP_NUM] = {
+	"normal", "expanded", "reflow"
+};
+
+/* Description and result of a single benchmark run */
+typedef struct bench_point {
+	const char	*bp_impl;
+	const char	*bp_op;
+	const char	*bp_method;
+	int		bp_fn;
+	int		bp_parity;
+	size_t		bp_dcols;
+	size_t		bp_ashift;
+	bench_abd_t	bp_abd;
+	bench_map_t	bp_map;
+	uint64_t	bp_reflow_offset;
+	uint64_t	bp_iosize;
+	uint64_t	bp_memory;
+
+	uint64_t	bp_iter;
+	double		bp_disk_bw;
+	double		bp_total_bw;
+} bench_point_t;
+
 static zio_t zio_bench;
 static raidz_map_t *rm_bench;
 static size_t max_data_size = SPA_MAXBLOCKSIZE;
+static abd_t *abd_bench[BENCH_ABD_NUM];
+static uint64_t bench_results;
+static hrtime_t bench_start;
 
 static void
 bench_init_raidz_map(void)
@@ -54,69 +109,267 @@ bench_init_raidz_map(void)
 	 * To permit larger column sizes these have to be done
 	 * allocated using aligned alloc instead of zio_abd_buf_alloc
 	 */
-	zio_bench.io_abd = raidz_alloc(max_data_size);
+	abd_bench[BENCH_ABD_LINEAR] = abd_alloc_linear(max_data_size, B_FALSE);
+	abd_bench[BENCH_ABD_SCATTER] = raidz_alloc(max_data_size);
+	abd_bench[BENCH_ABD_GANG] = abd_alloc_gang();
+	for (size_t off = 0; off < max_data_size; off += GANG_CHILD_SIZE) {
+		abd_gang_add(abd_bench[BENCH_ABD_GANG],
+		    abd_alloc(MIN(GANG_CHILD_SIZE, max_data_size - off),
+		    B_FALSE), B_TRUE);
+	}
 
-	init_zio_abd(&zio_bench);
+	for (int l = 0; l < BENCH_ABD_NUM; l++) {
+		zio_bench.io_abd = abd_bench[l];
+		init_zio_abd(&zio_bench);
+	}
+	zio_bench.io_abd = abd_bench[BENCH_ABD_SCATTER];
 }
 
 static void
 bench_fini_raidz_maps(void)
 {
 	/* tear down golden zio */
-	raidz_free(zio_bench.io_abd, max_data_size);
+	abd_free(abd_bench[BENCH_ABD_LINEAR]);
+	raidz_free(abd_bench[BENCH_ABD_SCATTER], max_data_size);
+	abd_free(abd_bench[BENCH_ABD_GANG]);
+	memset(abd_bench, 0, sizeof (abd_bench));
 	memset(&zio_bench, 0, sizeof (zio_t));
 }
 
-static inline void
-run_gen_bench_impl(const char *impl)
+static void
+bench_header(void)
 {
-	int fn, ncols;
-	uint64_t ds, iter_cnt, iter, disksize;
+	struct utsname u;
+
+	bench_results = 0;
+	bench_start = gethrtime();
+
+	switch (rto_opts.rto_bench_fmt) {
+	case BENCH_FMT_CSV:
+		LOG(D_ALL, "impl,op,method,parity,dcols,ashift,abd,map,"
+		    "reflow_offset,iosize,iter,disk_bw,total_bw\n");
+		break;
+	case BENCH_FMT_JSON:
+		if (uname(&u) != 0)
+			memset(&u, 0, sizeof (u));
+		LOG(D_ALL, "{\n"
+		    "  \"version\": 1,\n"
+		    "  \"host\": {\n"
+		    "    \"sysname\": \"%s\",\n"
+		    "    \"release\": \"%s\",\n"
+		    "    \"machine\": \"%s\",\n"
+		    "    \"ncpus\": %u\n"
+		    "  },\n"
+		    "  \"units\": {\"disk_bw\": \"MiB/s\", "
+		    "\"total_bw\": \"MiB/s\"},\n"
+		    "  \"results\": [",
+		    u.sysname, u.release, u.machine, (unsigned)boot_ncpus);
+		break;
+	case BENCH_FMT_TEXT:
+		break;
+	}
+}
+
+static void
+bench_footer(void)
+{
+	if (rto_opts.rto_bench_fmt == BENCH_FMT_JSON) {
+		LOG(D_ALL, "%s  ],\n  \"elapsed\": %.3lf\n}\n",
+		    bench_results != 0 ? "\n" : "",
+		    NSEC2SEC((double)(gethrtime() - bench_start)));
+	}
+}
+
+static void
+bench_report(const bench_point_t *bp)
+{
+	switch (rto_opts.rto_bench_fmt) {
+	case BENCH_FMT_TEXT:
+		LOG(D_ALL, "%10s, %8s, %zu, %10llu, %lf, %lf, %u\n",
+		    bp->bp_impl,
+		    bp->bp_method,
+		    bp->bp_dcols,
+		    (u_longlong_t)bp->bp_iosize,
+		    bp->bp_disk_bw,
+		    bp->bp_total_bw,
+		    (unsigned)bp->bp_iter);
+		break;
+	case BENCH_FMT_CSV:
+		LOG(D_ALL, "%s,%s,%s,%d,%zu,%zu,%s,%s,%llu,%llu,%llu,"
+		    "%lf,%lf\n",
+		    bp->bp_impl,
+		    bp->bp_op,
+		    bp->bp_method,
+		    bp->bp_parity,
+		    bp->bp_dcols,
+		    bp->bp_ashift,
+		    bench_abd_name[bp->bp_abd],
+		    bench_map_name[bp->bp_map],
+		    (u_longlong_t)bp->bp_reflow_offset,
+		    (u_longlong_t)bp->bp_iosize,
+		    (u_longlong_t)bp->bp_iter,
+		    bp->bp_disk_bw,
+		    bp->bp_total_bw);
+		break;
+	case BENCH_FMT_JSON:
+		LOG(D_ALL, "%s\n    {\"impl\": \"%s\", \"op\": \"%s\", "
+		    "\"method\": \"%s\", \"parity\": %d, \"dcols\": %zu, "
+		    "\"ashift\": %zu, \"abd\": \"%s\", \"map\": \"%s\", "
+		    "\"reflow_offset\": %llu, \"iosize\": %llu, "
+		    "\"iter\": %llu, \"disk_bw\": %lf, \"total_bw\": %lf}",
+		    bench_results != 0 ? "," : "",
+		    bp->bp_impl,
+		    bp->bp_op,
+		    bp->bp_method,
+		    bp->bp_parity,
+		    bp->bp_dcols,
+		    bp->bp_ashift,
+		    bench_abd_name[bp->bp_abd],
+		    bench_map_name[bp->bp_map],
+		    (u_longlong_t)bp->bp_reflow_offset,
+		    (u_longlong_t)bp->bp_iosize,
+		    (u_longlong_t)bp->bp_iter,
+		    bp->bp_disk_bw,
+		    bp->bp_total_bw);
+		break;
+	}
+	bench_results++;
+}
+
+static raidz_map_t *
+bench_map_alloc(const bench_point_t *bp, int ncols)
+{
+	zio_bench.io_abd = abd_bench[bp->bp_abd];
+	zio_bench.io_size = bp->bp_iosize;
+
+	if (bp->bp_map == BENCH_MAP_NORMAL) {
+		return (vdev_raidz_map_alloc(&zio_bench, bp->bp_ashift,
+		    ncols, bp->bp_parity));
+	}
+	return (vdev_raidz_map_alloc_expanded(&zio_bench, bp->bp_ashift,
+	    ncols + 1, ncols, bp->bp_parity, bp->bp_reflow_offset, 0,
+	    B_FALSE));
+}
+
+static void
+run_gen_bench_one(bench_point_t *bp)
+{
+	uint64_t iter_cnt, iter, disksize;
 	hrtime_t start;
 	double elapsed, d_bw;
 
+	/* create suitable raidz_map */
+	int ncols = bp->bp_dcols + bp->bp_parity;
+	rm_bench = bench_map_alloc(bp, ncols);
+
+	/* estimate iteration count */
+	iter_cnt = MAX(1, bp->bp_memory / bp->bp_iosize);
+
+	start = gethrtime();
+	for (iter = 0; iter < iter_cnt; iter++)
+		vdev_raidz_generate_parity(rm_bench);
+	elapsed = NSEC2SEC((double)(gethrtime() - start));
+
+	disksize = bp->bp_iosize / bp->bp_dcols;
+	d_bw = (double)iter_cnt * (double)disksize;
+	d_bw /= (1024.0 * 1024.0 * elapsed);
+
+	bp->bp_iter = iter_cnt;
+	bp->bp_disk_bw = d_bw;
+	bp->bp_total_bw = d_bw * (double)(ncols);
+	bench_report(bp);
+
+	vdev_raidz_map_free(rm_bench);
+}
+
+/*
+ * Number of data columns rebuilt by a reconstruction method.  Every method
+ * also discards the unused parity columns, so three columns are always bad.
+ */
+static int
+rec_bench_ndata(int fn)
+{
+	return (fn < 3 ? 1 : fn < 6 ? 2 : 3);
+}
+
+static boolean_t
+rec_bench_valid(const bench_point_t *bp)
+{
+	/* raidz block is too short or narrow to test the requested method */
+	return (bp->bp_iosize / bp->bp_dcols >= (1ULL << bp->bp_ashift) &&
+	    bp->bp_dcols >= rec_bench_ndata(bp->bp_fn));
+}
+
+static void
+run_rec_bench_one(bench_point_t *bp)
+{
+	uint64_t iter_cnt, iter, disksize;
+	hrtime_t start;
+	double elapsed, d_bw;
+	static const int tgt[7][3] = {
+		{1, 2, 3},	/* rec_p:   bad QR & D[0]	*/
+		{0, 2, 3},	/* rec_q:   bad PR & D[0]	*/
+		{0, 1, 3},	/* rec_r:   bad PQ & D[0]	*/
+		{2, 3, 4},	/* rec_pq:  bad R  & D[0][1]	*/
+		{1, 3, 4},	/* rec_pr:  bad Q  & D[0][1]	*/
+		{0, 3, 4},	/* rec_qr:  bad P  & D[0][1]	*/
+		{3, 4, 5}	/* rec_pqr: bad    & D[0][1][2] */
+	};
+
+	/* create suitable raidz_map */
+	int ncols = bp->bp_dcols + PARITY_PQR;
+	rm_bench = bench_map_alloc(bp, ncols);
+
+	/* estimate iteration count */
+	iter_cnt = MAX(1, bp->bp_memory / bp->bp_iosize);
+
+	start = gethrtime();
+	for (iter = 0; iter < iter_cnt; iter++)
+		vdev_raidz_reconstruct(rm_bench, tgt[bp->bp_fn], 3);
+	elapsed = NSEC2SEC((double)(gethrtime() - start));
+
+	disksize = bp->bp_iosize / bp->bp_dcols;
+	d_bw = (double)iter_cnt * (double)(disksize);
+	d_bw /= (1024.0 * 1024.0 * elapsed);
+
+	bp->bp_iter = iter_cnt;
+	bp->bp_disk_bw = d_bw;
+	bp->bp_total_bw = d_bw * (double)ncols;
+	bench_report(bp);
+
+	vdev_raidz_map_free(rm_bench);
+}
+
+static inline void
+run_gen_bench_impl(const char *impl)
+{
+	bench_point_t bp = {
+		.bp_impl = impl,
+		.bp_op = "gen",
+		.bp_dcols = rto_opts.rto_dcols,
+		.bp_abd = BENCH_ABD_SCATTER,
+		.bp_memory = GEN_BENCH_MEMORY,
+	};
+
+	if (rto_opts.rto_expand) {
+		bp.bp_ashift = rto_opts.rto_ashift;
+		bp.bp_map = BENCH_MAP_EXPANDED;
+		bp.bp_reflow_offset = rto_opts.rto_expand_offset;
+	} else {
+		bp.bp_ashift = BENCH_ASHIFT;
+		bp.bp_map = BENCH_MAP_NORMAL;
+		bp.bp_reflow_offset = UINT64_MAX;
+	}
+
 	/* Benchmark generate functions */
-	for (fn = 0; fn < RAIDZ_GEN_NUM; fn++) {
-
-		for (ds = MIN_CS_SHIFT; ds <= MAX_CS_SHIFT; ds++) {
-			/* create suitable raidz_map */
-			ncols = rto_opts.rto_dcols + fn + 1;
-			zio_bench.io_size = 1ULL << ds;
-
-			if (rto_opts.rto_expand) {
-				rm_bench = vdev_raidz_map_alloc_expanded(
-				    &zio_bench,
-				    rto_opts.rto_ashift, ncols+1, ncols,
-				    fn+1, rto_opts.rto_expand_offset,
-				    0, B_FALSE);
-			} else {
-				rm_bench = vdev_raidz_map_alloc(&zio_bench,
-				    BENCH_ASHIFT, ncols, fn+1);
-			}
-
-			/* estimate iteration count */
-			iter_cnt = GEN_BENCH_MEMORY;
-			iter_cnt /= zio_bench.io_size;
-
-			start = gethrtime();
-			for (iter = 0; iter < iter_cnt; iter++)
-				vdev_raidz_generate_parity(rm_bench);
-			elapsed = NSEC2SEC((double)(gethrtime() - start));
-
-			disksize = (1ULL << ds) / rto_opts.rto_dcols;
-			d_bw = (double)iter_cnt * (double)disksize;
-			d_bw /= (1024.0 * 1024.0 * elapsed);
-
-			LOG(D_ALL, "%10s, %8s, %zu, %10llu, %lf, %lf, %u\n",
-			    impl,
-			    raidz_gen_name[fn],
-			    rto_opts.rto_dcols,
-			    (1ULL<<ds),
-			    d_bw,
-			    d_bw * (double)(ncols),
-			    (unsigned)iter_cnt);
-
-			vdev_raidz_map_free(rm_bench);
+	for (int fn = 0; fn < RAIDZ_GEN_NUM; fn++) {
+		bp.bp_fn = fn;
+		bp.bp_method = raidz_gen_name[fn];
+		bp.bp_parity = fn + 1;
+
+		for (uint64_t ds = MIN_CS_SHIFT; ds <= MAX_CS_SHIFT; ds++) {
+			bp.bp_iosize = 1ULL << ds;
+			run_gen_bench_one(&bp);
 		}
 	}
 }
@@ -126,8 +379,11 @@ run_gen_bench(void)
 {
 	char **impl_name;
 
-	LOG(D_INFO, DBLSEP "\nBenchmarking parity generation...\n\n");
-	LOG(D_ALL, "impl, math, dcols, iosize, disk_bw, total_bw, iter\n");
+	if (rto_opts.rto_bench_fmt == BENCH_FMT_TEXT) {
+		LOG(D_INFO, DBLSEP "\nBenchmarking parity generation...\n\n");
+		LOG(D_ALL, "impl, math, dcols, iosize, disk_bw, total_bw, "
+		    "iter\n");
+	}
 
 	for (impl_name = (char **)raidz_impl_names; *impl_name != NULL;
 	    impl_name++) {
@@ -142,73 +398,32 @@ run_gen_bench(void)
 static void
 run_rec_bench_impl(const char *impl)
 {
-	int fn, ncols, nbad;
-	uint64_t ds, iter_cnt, iter, disksize;
-	hrtime_t start;
-	double elapsed, d_bw;
-	static const int tgt[7][3] = {
-		{1, 2, 3},	/* rec_p:   bad QR & D[0]	*/
-		{0, 2, 3},	/* rec_q:   bad PR & D[0]	*/
-		{0, 1, 3},	/* rec_r:   bad PQ & D[0]	*/
-		{2, 3, 4},	/* rec_pq:  bad R  & D[0][1]	*/
-		{1, 3, 4},	/* rec_pr:  bad Q  & D[0][1]	*/
-		{0, 3, 4},	/* rec_qr:  bad P  & D[0][1]	*/
-		{3, 4, 5}	/* rec_pqr: bad    & D[0][1][2] */
+	bench_point_t bp = {
+		.bp_impl = impl,
+		.bp_op = "rec",
+		.bp_parity = PARITY_PQR,
+		.bp_dcols = rto_opts.rto_dcols,
+		.bp_ashift = BENCH_ASHIFT,
+		.bp_abd = BENCH_ABD_SCATTER,
+		.bp_memory = REC_BENCH_MEMORY,
 	};
 
-	for (fn = 0; fn < RAIDZ_REC_NUM; fn++) {
-		for (ds = MIN_CS_SHIFT; ds <= MAX_CS_SHIFT; ds++) {
-
-			/* create suitable raidz_map */
-			ncols = rto_opts.rto_dcols + PARITY_PQR;
-			zio_bench.io_size = 1ULL << ds;
+	if (rto_opts.rto_expand) {
+		bp.bp_map = BENCH_MAP_EXPANDED;
+		bp.bp_reflow_offset = rto_opts.rto_expand_offset;
+	} else {
+		bp.bp_map = BENCH_MAP_NORMAL;
+		bp.bp_reflow_offset = UINT64_MAX;
+	}
 
-			/*
-			 * raidz block is too short to test
-			 * the requested method
-			 */
-			if (zio_bench.io_size / rto_opts.rto_dcols <
-			    (1ULL << BENCH_ASHIFT))
-				continue;
+	for (int fn = 0; fn < RAIDZ_REC_NUM; fn++) {
+		bp.bp_fn = fn;
+		bp.bp_method = raidz_rec_name[fn];
 
-			if (rto_opts.rto_expand) {
-				rm_bench = vdev_raidz_map_alloc_expanded(
-				    &zio_bench,
-				    BENCH_ASHIFT, ncols+1, ncols,
-				    PARITY_PQR,
-				    rto_opts.rto_expand_offset, 0, B_FALSE);
-			} else {
-				rm_bench = vdev_raidz_map_alloc(&zio_bench,
-				    BENCH_ASHIFT, ncols, PARITY_PQR);
-			}
-
-			/* estimate iteration count */
-			iter_cnt = (REC_BENCH_MEMORY);
-			iter_cnt /= zio_bench.io_size;
-
-			/* calculate how many bad columns there are */
-			nbad = MIN(3, raidz_ncols(rm_bench) -
-			    raidz_parity(rm_bench));
-
-			start = gethrtime();
-			for (iter = 0; iter < iter_cnt; iter++)
-				vdev_raidz_reconstruct(rm_bench, tgt[fn], nbad);
-			elapsed = NSEC2SEC((double)(gethrtime() - start));
-
-			disksize = (1ULL << ds) / rto_opts.rto_dcols;
-			d_bw = (double)iter_cnt * (double)(disksize);
-			d_bw /= (1024.0 * 1024.0 * elapsed);
-
-			LOG(D_ALL, "%10s, %8s, %zu, %10llu, %lf, %lf, %u\n",
-			    impl,
-			    raidz_rec_name[fn],
-			    rto_opts.rto_dcols,
-			    (1ULL<<ds),
-			    d_bw,
-			    d_bw * (double)ncols,
-			    (unsigned)iter_cnt);
-
-			vdev_raidz_map_free(rm_bench);
+		for (uint64_t ds = MIN_CS_SHIFT; ds <= MAX_CS_SHIFT; ds++) {
+			bp.bp_iosize = 1ULL << ds;
+			if (rec_bench_valid(&bp))
+				run_rec_bench_one(&bp);
 		}
 	}
 }
@@ -218,8 +433,11 @@ run_rec_bench(void)
 {
 	char **impl_name;
 
-	LOG(D_INFO, DBLSEP "\nBenchmarking data reconstruction...\n\n");
-	LOG(D_ALL, "impl, math, dcols, iosize, disk_bw, total_bw, iter\n");
+	if (rto_opts.rto_bench_fmt == BENCH_FMT_TEXT) {
+		LOG(D_INFO, DBLSEP "\nBenchmarking data reconstruction...\n\n");
+		LOG(D_ALL, "impl, math, dcols, iosize, disk_bw, total_bw, "
+		    "iter\n");
+	}
 
 	for (impl_name = (char **)raidz_impl_names; *impl_name != NULL;
 	    impl_name++) {
@@ -231,13 +449,105 @@ run_rec_bench(void)
 	}
 }
 
+static boolean_t
+bench_sweep_timeout(void)
+{
+	return (rto_opts.rto_sweep_timeout > 0 &&
+	    (gethrtime() - bench_start) / NANOSEC >=
+	    rto_opts.rto_sweep_timeout);
+}
+
+/*
+ * Benchmark an implementation over the whole parameter space: all
+ * generation and reconstruction methods, data widths, ashifts, ABD layouts
+ * and map types, including expanded maps in the middle of a reflow.
+ */
+static boolean_t
+run_sweep_bench_impl(const char *impl)
+{
+	static const size_t dcols_v[] = { 1, 2, 3, 4, 5, 6, 7, 8, 12, 15, 16 };
+	static const size_t ashift_v[] = { 9, 12, 14 };
+	bench_point_t bp = { .bp_impl = impl };
+
+	for (int op = 0; op < 2; op++)
+	for (int m = 0; m < BENCH_MAP_NUM; m++)
+	for (int l = 0; l < BENCH_ABD_NUM; l++)
+	for (int a = 0; a < ARRAY_SIZE(ashift_v); a++)
+	for (int d = 0; d < ARRAY_SIZE(dcols_v); d++)
+	for (int fn = 0; fn < (op == 0 ? RAIDZ_GEN_NUM : RAIDZ_REC_NUM); fn++)
+	for (uint64_t ds = ashift_v[a]; ds <= MAX_CS_SHIFT; ds += 2) {
+
+		if (bench_sweep_timeout())
+			return (B_FALSE);
+
+		bp.bp_map = m;
+		bp.bp_abd = l;
+		bp.bp_ashift = ashift_v[a];
+		bp.bp_dcols = dcols_v[d];
+		bp.bp_fn = fn;
+		bp.bp_iosize = 1ULL << ds;
+
+		/*
+		 * Like allocations on an expanded vdev, the blocks of an
+		 * expanded map have to fill whole rows.
+		 */
+		if (m != BENCH_MAP_NORMAL) {
+			uint64_t row = bp.bp_dcols << bp.bp_ashift;
+			bp.bp_iosize -= bp.bp_iosize % row;
+			if (bp.bp_iosize == 0)
+				continue;
+		}
+		bp.bp_reflow_offset = (m == BENCH_MAP_REFLOW) ?
+		    P2ALIGN_TYPED(bp.bp_iosize / 2, 1ULL << bp.bp_ashift,
+		    uint64_t) : UINT64_MAX;
+
+		if (op == 0) {
+			bp.bp_op = "gen";
+			bp.bp_method = raidz_gen_name[fn];
+			bp.bp_parity = fn + 1;
+			bp.bp_memory = GEN_BENCH_MEMORY >> SWEEP_MEMORY_SHIFT;
+			run_gen_bench_one(&bp);
+		} else if (rec_bench_valid(&bp)) {
+			bp.bp_op = "rec";
+			bp.bp_method = raidz_rec_name[fn];
+			bp.bp_parity = PARITY_PQR;
+			bp.bp_memory = REC_BENCH_MEMORY >> SWEEP_MEMORY_SHIFT;
+			run_rec_bench_one(&bp);
+		}
+	}
+
+	return (B_TRUE);
+}
+
+static void
+run_sweep_bench(void)
+{
+	char **impl_name;
+
+	for (impl_name = (char **)raidz_impl_names; *impl_name != NULL;
+	    impl_name++) {
+
+		if (vdev_raidz_impl_set(*impl_name) != 0)
+			continue;
+
+		if (!run_sweep_bench_impl(*impl_name))
+			break;
+	}
+}
+
 void
 run_raidz_benchmark(void)
 {
 	bench_init_raidz_map();
+	bench_header();
 
-	run_gen_bench();
-	run_rec_bench();
+	if (rto_opts.rto_sweep) {
+		run_sweep_bench();
+	} else {
+		run_gen_bench();
+		run_rec_bench();
+	}
 
+	bench_footer();
 	bench_fini_raidz_maps();
 }
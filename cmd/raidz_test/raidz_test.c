@@ -119,6 +119,8 @@ static void usage(boolean_t requested)
 	    "\t[-S parameter sweep (default: %s)]\n"
 	    "\t[-t timeout for parameter sweep test]\n"
 	    "\t[-B benchmark all raidz implementations]\n"
+	    "\t[-f benchmark output format: text, csv or json "
+	    "(default: text)]\n"
 	    "\t[-e use expanded raidz map (default: %s)]\n"
 	    "\t[-r expanded raidz map reflow offset (default: %llx)]\n"
 	    "\t[-v increase verbosity (default: %d)]\n"
@@ -146,7 +148,7 @@ static void process_options(int argc, char **argv)
 
 	memcpy(o, &rto_opts_defaults, sizeof (*o));
 
-	while ((opt = getopt(argc, argv, "TDBSvha:er:o:d:s:t:")) != -1) {
+	while ((opt = getopt(argc, argv, "TDBSvha:er:o:d:s:t:f:")) != -1) {
 		switch (opt) {
 		case 'a':
 			value = strtoull(optarg, NULL, 0);
@@ -184,6 +186,19 @@ static void process_options(int argc, char **argv)
 		case 'B':
 			o->rto_benchmark = 1;
 			break;
+		case 'f':
+			if (strcmp(optarg, "text") == 0) {
+				o->rto_bench_fmt = BENCH_FMT_TEXT;
+			} else if (strcmp(optarg, "csv") == 0) {
+				o->rto_bench_fmt = BENCH_FMT_CSV;
+			} else if (strcmp(optarg, "json") == 0) {
+				o->rto_bench_fmt = BENCH_FMT_JSON;
+			} else {
+				ERR("raidz_test: invalid format \"%s\"\n",
+				    optarg);
+				usage(B_FALSE);
+			}
+			break;
 		case 'D':
 			o->rto_gdb = 1;
 			break;
@@ -199,6 +214,11 @@ static void process_options(int argc, char **argv)
 			break;
 		}
 	}
+
+	/* the sweep varies more parameters than the text format shows */
+	if (o->rto_benchmark && o->rto_sweep &&
+	    o->rto_bench_fmt == BENCH_FMT_TEXT)
+		o->rto_bench_fmt = BENCH_FMT_CSV;
 }
 
 #define	DATA_COL(rr, i) ((rr)->rr_col[rr->rr_firstdatacol + (i)].rc_abd)
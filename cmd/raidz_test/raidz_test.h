@@ -37,6 +37,7 @@ static const char *const raidz_impl_names[] = {
 	"avx2",
 	"avx512f",
 	"avx512bw",
+	"avx512gfni",
 	"aarch64_neon",
 	"aarch64_neonx2",
 	"powerpc_altivec",
@@ -49,6 +50,12 @@ enum raidz_verbosity {
 	D_DEBUG,
 };
 
+enum raidz_bench_fmt {
+	BENCH_FMT_TEXT,
+	BENCH_FMT_CSV,
+	BENCH_FMT_JSON,
+};
+
 typedef struct raidz_test_opts {
 	size_t rto_ashift;
 	uint64_t rto_offset;
@@ -58,6 +65,7 @@ typedef struct raidz_test_opts {
 	size_t rto_sweep;
 	size_t rto_sweep_timeout;
 	size_t rto_benchmark;
+	enum raidz_bench_fmt rto_bench_fmt;
 	size_t rto_expand;
 	uint64_t rto_expand_offset;
 	size_t rto_sanity;
@@ -78,6 +86,7 @@ static const raidz_test_opts_t rto_opts_defaults = {
 	.rto_v = D_ALL,
 	.rto_sweep = 0,
 	.rto_benchmark = 0,
+	.rto_bench_fmt = BENCH_FMT_TEXT,
 	.rto_expand = 0,
 	.rto_expand_offset = -1ULL,
 	.rto_sanity = 0,
@@ -5641,6 +5641,16 @@ typedef struct zdb_cb {
 	uint32_t	**zcb_vd_obsolete_counts;
 	avl_tree_t	zcb_brt;
 	boolean_t	zcb_brt_is_active;
+	/*
+	 * With ZDB_TRAVERSE_THREADS, each traversal thread counts blocks
+	 * into its own zdb_cb_t, which is merged into the main one at the
+	 * end.  zcb_shared points at the main one, which alone holds the
+	 * BRT tracking and the progress counters, under zcb_lock.
+	 */
+	struct zdb_cb	*zcb_shared;
+	kmutex_t	zcb_lock;
+	uint64_t	zcb_progress_asize;
+	uint64_t	zcb_reported_asize;
 } zdb_cb_t;
 
 /* test if two DVA offsets from same vdev are within the same metaslab */
@@ -5955,11 +5965,13 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
 		 * normal. If we see the block again, we count it as a clone
 		 * and then give it no further consideration.
 		 */
+		zdb_cb_t *szcb = zcb->zcb_shared;
 		zdb_brt_entry_t zbre_search, *zbre;
 		avl_index_t where;
 
+		mutex_enter(&szcb->zcb_lock);
 		zbre_search.zbre_dva = bp->blk_dva[0];
-		zbre = avl_find(&zcb->zcb_brt, &zbre_search, &where);
+		zbre = avl_find(&szcb->zcb_brt, &zbre_search, &where);
 		if (zbre == NULL) {
 			/* Not seen before; track it */
 			uint64_t refcnt =
@@ -5969,7 +5981,7 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
 				    UMEM_NOFAIL);
 				zbre->zbre_dva = bp->blk_dva[0];
 				zbre->zbre_refcount = refcnt;
-				avl_insert(&zcb->zcb_brt, zbre, where);
+				avl_insert(&szcb->zcb_brt, zbre, where);
 			}
 		} else  {
 			/*
@@ -5981,13 +5993,14 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
 
 			zbre->zbre_refcount--;
 			if (zbre->zbre_refcount == 0) {
-				avl_remove(&zcb->zcb_brt, zbre);
+				avl_remove(&szcb->zcb_brt, zbre);
 				umem_free(zbre, sizeof (zdb_brt_entry_t));
 			}
 
 			/* Already claimed, don't do it again. */
 			do_claim = B_FALSE;
 		}
+		mutex_exit(&szcb->zcb_lock);
 	}
 
 skipped:
@@ -6202,14 +6215,21 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	else
 		return (0);
 
-	if (dump_opt['b'] < 5 && gethrtime() > zcb->zcb_lastprint + NANOSEC) {
+	zdb_cb_t *szcb = zcb->zcb_shared;
+	uint64_t counted = zcb->zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_asize;
+	uint64_t bytes = atomic_add_64_nv(&szcb->zcb_progress_asize,
+	    counted - zcb->zcb_reported_asize);
+	zcb->zcb_reported_asize = counted;
+
+	if (dump_opt['b'] < 5 && gethrtime() > szcb->zcb_lastprint + NANOSEC &&
+	    mutex_tryenter(&szcb->zcb_lock)) {
 		uint64_t now = gethrtime();
 		char buf[10];
-		uint64_t bytes = zcb->zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_asize;
 		uint64_t kb_per_sec =
-		    1 + bytes / (1 + ((now - zcb->zcb_start) / 1000 / 1000));
+		    1 + bytes / (1 + ((now - szcb->zcb_start) / 1000 / 1000));
 		uint64_t sec_remaining =
-		    (zcb->zcb_totalasize - bytes) / 1024 / kb_per_sec;
+		    (szcb->zcb_totalasize - MIN(bytes, szcb->zcb_totalasize)) /
+		    1024 / kb_per_sec;
 
 		/* make sure nicenum has enough space */
 		_Static_assert(sizeof (buf) >= NN_NUMBUF_SZ, "buf truncated");
@@ -6224,7 +6244,8 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 		    sec_remaining / 60 % 60,
 		    sec_remaining % 60);
 
-		zcb->zcb_lastprint = now;
+		szcb->zcb_lastprint = now;
+		mutex_exit(&szcb->zcb_lock);
 	}
 
 	return (0);
@@ -7048,6 +7069,61 @@ zdb_brt_entry_compare(const void *zcn1, const void *zcn2)
 	return (cmp);
 }
 
+/*
+ * Add the block accounting of a traversal thread into the main zdb_cb_t.
+ */
+static void
+zdb_cb_merge(zdb_cb_t *dst, const zdb_cb_t *src)
+{
+	for (int l = 0; l <= ZB_TOTAL; l++) {
+		for (int t = 0; t <= ZDB_OT_TOTAL; t++) {
+			zdb_blkstats_t *d = &dst->zcb_type[l][t];
+			const zdb_blkstats_t *s = &src->zcb_type[l][t];
+
+			d->zb_asize += s->zb_asize;
+			d->zb_lsize += s->zb_lsize;
+			d->zb_psize += s->zb_psize;
+			d->zb_count += s->zb_count;
+			d->zb_gangs += s->zb_gangs;
+			d->zb_ditto_samevdev += s->zb_ditto_samevdev;
+			d->zb_ditto_same_ms += s->zb_ditto_same_ms;
+			for (int i = 0; i < PSIZE_HISTO_SIZE; i++) {
+				d->zb_psize_histogram[i] +=
+				    s->zb_psize_histogram[i];
+			}
+		}
+	}
+
+	dst->zcb_dedup_asize += src->zcb_dedup_asize;
+	dst->zcb_dedup_blocks += src->zcb_dedup_blocks;
+	dst->zcb_clone_asize += src->zcb_clone_asize;
+	dst->zcb_clone_blocks += src->zcb_clone_blocks;
+
+	for (int i = 0; i < SPA_MAX_FOR_16M; i++) {
+		dst->zcb_psize_count[i] += src->zcb_psize_count[i];
+		dst->zcb_lsize_count[i] += src->zcb_lsize_count[i];
+		dst->zcb_asize_count[i] += src->zcb_asize_count[i];
+		dst->zcb_psize_len[i] += src->zcb_psize_len[i];
+		dst->zcb_lsize_len[i] += src->zcb_lsize_len[i];
+		dst->zcb_asize_len[i] += src->zcb_asize_len[i];
+	}
+	dst->zcb_psize_total += src->zcb_psize_total;
+	dst->zcb_lsize_total += src->zcb_lsize_total;
+	dst->zcb_asize_total += src->zcb_asize_total;
+
+	for (int i = 0; i < NUM_BP_EMBEDDED_TYPES; i++) {
+		dst->zcb_embedded_blocks[i] += src->zcb_embedded_blocks[i];
+		for (int j = 0; j <= BPE_PAYLOAD_SIZE; j++) {
+			dst->zcb_embedded_histogram[i][j] +=
+			    src->zcb_embedded_histogram[i][j];
+		}
+	}
+
+	for (int e = 0; e < 256; e++)
+		dst->zcb_errors[e] += src->zcb_errors[e];
+	dst->zcb_haderrors |= src->zcb_haderrors;
+}
+
 static int
 dump_block_stats(spa_t *spa)
 {
@@ -7059,10 +7135,23 @@ dump_block_stats(spa_t *spa)
 	boolean_t leaks = B_FALSE;
 	int e, c, err;
 	bp_embedded_type_t i;
+	zdb_cb_t **zcbs = NULL;
+	int nthreads = 1;
+	const char *env;
+
+	/*
+	 * Datasets can be traversed by several threads at once.  This is
+	 * not done when printing every block, which would interleave.
+	 */
+	if ((env = getenv("ZDB_TRAVERSE_THREADS")) != NULL &&
+	    dump_opt['b'] < 5)
+		nthreads = MAX(1, (int)strtol(env, NULL, 0));
 
 	ddt_prefetch_all(spa);
 
 	zcb = umem_zalloc(sizeof (zdb_cb_t), UMEM_NOFAIL);
+	zcb->zcb_shared = zcb;
+	mutex_init(&zcb->zcb_lock, NULL, MUTEX_DEFAULT, NULL);
 
 	if (spa_feature_is_active(spa, SPA_FEATURE_BLOCK_CLONING)) {
 		avl_create(&zcb->zcb_brt, zdb_brt_entry_compare,
@@ -7122,7 +7211,20 @@ dump_block_stats(spa_t *spa)
 	zcb->zcb_totalasize +=
 	    metaslab_class_get_alloc(spa_embedded_log_class(spa));
 	zcb->zcb_start = zcb->zcb_lastprint = gethrtime();
-	err = traverse_pool(spa, 0, flags, zdb_blkptr_cb, zcb);
+	if (nthreads > 1) {
+		zcbs = umem_alloc(nthreads * sizeof (zdb_cb_t *), UMEM_NOFAIL);
+		zcbs[0] = zcb;
+		for (int t = 1; t < nthreads; t++) {
+			zcbs[t] = umem_zalloc(sizeof (zdb_cb_t), UMEM_NOFAIL);
+			zcbs[t]->zcb_spa = spa;
+			zcbs[t]->zcb_shared = zcb;
+			zcbs[t]->zcb_brt_is_active = zcb->zcb_brt_is_active;
+		}
+		err = traverse_pool_parallel(spa, 0, flags, zdb_blkptr_cb,
+		    (void **)zcbs, nthreads);
+	} else {
+		err = traverse_pool(spa, 0, flags, zdb_blkptr_cb, zcb);
+	}
 
 	/*
 	 * If we've traversed the data blocks then we need to wait for those
@@ -7139,6 +7241,18 @@ dump_block_stats(spa_t *spa)
 	}
 	ASSERT0(spa->spa_load_verify_bytes);
 
+	/*
+	 * The checksum reads above count errors into the zdb_cb_t of the
+	 * thread that issued them, so merge only once they are done.
+	 */
+	if (zcbs != NULL) {
+		for (int t = 1; t < nthreads; t++) {
+			zdb_cb_merge(zcb, zcbs[t]);
+			umem_free(zcbs[t], sizeof (zdb_cb_t));
+		}
+		umem_free(zcbs, nthreads * sizeof (zdb_cb_t *));
+	}
+
 	/*
 	 * Done after zio_wait() since zcb_haderrors is modified in
 	 * zdb_blkptr_done()
@@ -7189,6 +7303,7 @@ dump_block_stats(spa_t *spa)
 	}
 
 	if (tzb->zb_count == 0) {
+		mutex_destroy(&zcb->zcb_lock);
 		umem_free(zcb, sizeof (zdb_cb_t));
 		return (2);
 	}
@@ -7433,15 +7548,18 @@ dump_block_stats(spa_t *spa)
 	(void) printf("\n");
 
 	if (leaks) {
+		mutex_destroy(&zcb->zcb_lock);
 		umem_free(zcb, sizeof (zdb_cb_t));
 		return (2);
 	}
 
 	if (zcb->zcb_haderrors) {
+		mutex_destroy(&zcb->zcb_lock);
 		umem_free(zcb, sizeof (zdb_cb_t));
 		return (3);
 	}
 
+	mutex_destroy(&zcb->zcb_lock);
 	umem_free(zcb, sizeof (zdb_cb_t));
 	return (0);
 }
@@ -7456,12 +7574,101 @@ typedef struct zdb_ddt_entry {
 	avl_node_t	zdde_node;
 } zdb_ddt_entry_t;
 
+/*
+ * State for the dedup simulation (-S). Datasets are traversed in parallel,
+ * and the simulated DDT is split into ZDB_DDT_SIM_SHARDS trees so they don't
+ * all contend on one lock.
+ *
+ * If the table would grow beyond zds_max_entries, we fall back to sampling:
+ * only keys whose top zds_sample_shift bits are all zero are kept. Since a
+ * block's key decides whether it is sampled, every reference to a sampled
+ * block is counted exactly, and scaling the histogram by 2^shift gives an
+ * unbiased estimate whose relative error is about 1/sqrt(entries kept).
+ */
+#define	ZDB_DDT_SIM_SHARDS	64
+#define	ZDB_DDT_SIM_MAX_SHIFT	32
+
+typedef struct zdb_ddt_sim {
+	spa_t		*zds_spa;
+	krwlock_t	zds_sample_lock;
+	uint_t		zds_sample_shift;
+	uint64_t	zds_max_entries;
+	uint64_t	zds_entries;
+	uint64_t	zds_blocks;
+	uint64_t	zds_datasets;
+	uint64_t	zds_datasets_done;
+	hrtime_t	zds_start;
+	hrtime_t	zds_last_progress;
+	kmutex_t	zds_lock[ZDB_DDT_SIM_SHARDS];
+	avl_tree_t	zds_tree[ZDB_DDT_SIM_SHARDS];
+} zdb_ddt_sim_t;
+
+typedef struct zdb_ddt_sim_task {
+	zdb_ddt_sim_t	*zdst_sim;
+	uint64_t	zdst_dsobj;
+} zdb_ddt_sim_task_t;
+
+static boolean_t
+zdb_ddt_sim_sampled(const ddt_key_t *ddk, uint_t shift)
+{
+	return (shift == 0 || (ddk->ddk_cksum.zc_word[0] >> (64 - shift)) == 0);
+}
+
+/*
+ * Halve the sample rate until the table is back under three quarters of its
+ * limit, dropping the entries that are no longer sampled.
+ */
+static void
+zdb_ddt_sim_shrink(zdb_ddt_sim_t *zds)
+{
+	rw_enter(&zds->zds_sample_lock, RW_WRITER);
+	while (zds->zds_entries > zds->zds_max_entries / 4 * 3 &&
+	    zds->zds_sample_shift < ZDB_DDT_SIM_MAX_SHIFT) {
+		zds->zds_sample_shift++;
+		for (int i = 0; i < ZDB_DDT_SIM_SHARDS; i++) {
+			avl_tree_t *t = &zds->zds_tree[i];
+			zdb_ddt_entry_t *zdde, *next;
+			for (zdde = avl_first(t); zdde != NULL; zdde = next) {
+				next = AVL_NEXT(t, zdde);
+				if (zdb_ddt_sim_sampled(&zdde->zdde_key,
+				    zds->zds_sample_shift))
+					continue;
+				avl_remove(t, zdde);
+				umem_free(zdde, sizeof (*zdde));
+				zds->zds_entries--;
+			}
+		}
+	}
+	rw_exit(&zds->zds_sample_lock);
+}
+
+static void
+zdb_ddt_sim_progress(zdb_ddt_sim_t *zds, boolean_t final)
+{
+	hrtime_t now = gethrtime();
+	hrtime_t last = zds->zds_last_progress;
+
+	if (!final && (now - last < SEC2NSEC(5) ||
+	    atomic_cas_64((uint64_t *)&zds->zds_last_progress, last, now) !=
+	    last))
+		return;
+
+	(void) fprintf(stderr, "%llu/%llu datasets, %llu blocks, "
+	    "%llu checksums (1 in %llu sampled), %llu s\n",
+	    (u_longlong_t)zds->zds_datasets_done,
+	    (u_longlong_t)zds->zds_datasets,
+	    (u_longlong_t)zds->zds_blocks,
+	    (u_longlong_t)zds->zds_entries,
+	    (u_longlong_t)1ULL << zds->zds_sample_shift,
+	    (u_longlong_t)NSEC2SEC(now - zds->zds_start));
+}
+
 static int
 zdb_ddt_add_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
     const zbookmark_phys_t *zb, const dnode_phys_t *dnp, void *arg)
 {
 	(void) zilog, (void) dnp;
-	avl_tree_t *t = arg;
+	zdb_ddt_sim_t *zds = arg;
 	avl_index_t where;
 	zdb_ddt_entry_t *zdde, zdde_search;
 
@@ -7471,81 +7678,190 @@ zdb_ddt_add_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 
 	if (dump_opt['S'] > 1 && zb->zb_level == ZB_ROOT_LEVEL) {
 		(void) printf("traversing objset %llu, %llu objects, "
-		    "%lu blocks so far\n",
+		    "%llu blocks so far\n",
 		    (u_longlong_t)zb->zb_objset,
 		    (u_longlong_t)BP_GET_FILL(bp),
-		    avl_numnodes(t));
+		    (u_longlong_t)zds->zds_entries);
 	}
 
 	if (BP_IS_HOLE(bp) || BP_GET_CHECKSUM(bp) == ZIO_CHECKSUM_OFF ||
 	    BP_GET_LEVEL(bp) > 0 || DMU_OT_IS_METADATA(BP_GET_TYPE(bp)))
 		return (0);
 
+	if ((atomic_inc_64_nv(&zds->zds_blocks) & 0xffff) == 0 &&
+	    dump_opt['S'] > 1)
+		zdb_ddt_sim_progress(zds, B_FALSE);
+
 	ddt_key_fill(&zdde_search.zdde_key, bp);
 
+	rw_enter(&zds->zds_sample_lock, RW_READER);
+	if (!zdb_ddt_sim_sampled(&zdde_search.zdde_key,
+	    zds->zds_sample_shift)) {
+		rw_exit(&zds->zds_sample_lock);
+		return (0);
+	}
+
+	int i = zdde_search.zdde_key.ddk_cksum.zc_word[1] %
+	    ZDB_DDT_SIM_SHARDS;
+	avl_tree_t *t = &zds->zds_tree[i];
+	boolean_t full = B_FALSE;
+
+	mutex_enter(&zds->zds_lock[i]);
 	zdde = avl_find(t, &zdde_search, &where);
 
 	if (zdde == NULL) {
 		zdde = umem_zalloc(sizeof (*zdde), UMEM_NOFAIL);
 		zdde->zdde_key = zdde_search.zdde_key;
 		avl_insert(t, zdde, where);
+		full = (atomic_inc_64_nv(&zds->zds_entries) >
+		    zds->zds_max_entries);
 	}
 
 	zdde->zdde_ref_blocks += 1;
 	zdde->zdde_ref_lsize += BP_GET_LSIZE(bp);
 	zdde->zdde_ref_psize += BP_GET_PSIZE(bp);
 	zdde->zdde_ref_dsize += bp_get_dsize_sync(spa, bp);
+	mutex_exit(&zds->zds_lock[i]);
+	rw_exit(&zds->zds_sample_lock);
+
+	if (full)
+		zdb_ddt_sim_shrink(zds);
 
 	return (0);
 }
 
+static void
+zdb_ddt_sim_task(void *arg)
+{
+	zdb_ddt_sim_task_t *zdst = arg;
+	zdb_ddt_sim_t *zds = zdst->zdst_sim;
+	dsl_pool_t *dp = spa_get_dsl(zds->zds_spa);
+	dsl_dataset_t *ds;
+
+	dsl_pool_config_enter(dp, FTAG);
+	int err = dsl_dataset_hold_obj(dp, zdst->zdst_dsobj, FTAG, &ds);
+	dsl_pool_config_exit(dp, FTAG);
+
+	if (err == 0) {
+		/* Like traverse_pool(), only visit blocks born since prev. */
+		(void) traverse_dataset(ds,
+		    dsl_dataset_phys(ds)->ds_prev_snap_txg,
+		    TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA |
+		    TRAVERSE_NO_DECRYPT, zdb_ddt_add_cb, zds);
+		dsl_dataset_rele(ds, FTAG);
+	}
+
+	atomic_inc_64(&zds->zds_datasets_done);
+	umem_free(zdst, sizeof (*zdst));
+}
+
 static void
 dump_simulated_ddt(spa_t *spa)
 {
-	avl_tree_t t;
-	void *cookie = NULL;
+	zdb_ddt_sim_t *zds;
+	objset_t *mos = spa_meta_objset(spa);
 	zdb_ddt_entry_t *zdde;
 	ddt_histogram_t ddh_total = {{{0}}};
 	ddt_stat_t dds_total = {0};
-
-	avl_create(&t, ddt_key_compare,
-	    sizeof (zdb_ddt_entry_t), offsetof(zdb_ddt_entry_t, zdde_node));
+	const char *env;
+	uint64_t maxmem = physmem * PAGESIZE / 2;
+	int nthreads = MAX(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+
+	if ((env = getenv("ZDB_SIMULATE_DEDUP_THREADS")) != NULL)
+		nthreads = MAX(1, (int)strtol(env, NULL, 0));
+	if ((env = getenv("ZDB_SIMULATE_DEDUP_MEM")) != NULL)
+		maxmem = MAX(strtoull(env, NULL, 0), 1ULL << 20);
+
+	zds = umem_zalloc(sizeof (zdb_ddt_sim_t), UMEM_NOFAIL);
+	zds->zds_spa = spa;
+	zds->zds_max_entries = maxmem / sizeof (zdb_ddt_entry_t);
+	zds->zds_start = zds->zds_last_progress = gethrtime();
+	rw_init(&zds->zds_sample_lock, NULL, RW_DEFAULT, NULL);
+	for (int i = 0; i < ZDB_DDT_SIM_SHARDS; i++) {
+		mutex_init(&zds->zds_lock[i], NULL, MUTEX_DEFAULT, NULL);
+		avl_create(&zds->zds_tree[i], ddt_key_compare,
+		    sizeof (zdb_ddt_entry_t),
+		    offsetof(zdb_ddt_entry_t, zdde_node));
+	}
+
+	taskq_t *tq = taskq_create("zdb_ddt_sim", nthreads, minclsyspri,
+	    nthreads, INT_MAX, TASKQ_PREPOPULATE);
 
 	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
 
-	(void) traverse_pool(spa, 0, TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA |
-	    TRAVERSE_NO_DECRYPT, zdb_ddt_add_cb, &t);
+	/*
+	 * Only level 0 data blocks are counted, so the MOS can be skipped and
+	 * each dataset traversed on its own.
+	 */
+	int err = 0;
+	for (uint64_t obj = 1; err == 0;
+	    err = dmu_object_next(mos, &obj, B_FALSE, 0)) {
+		dmu_object_info_t doi;
+
+		if (dmu_object_info(mos, obj, &doi) != 0 ||
+		    doi.doi_bonus_type != DMU_OT_DSL_DATASET)
+			continue;
+
+		zdb_ddt_sim_task_t *zdst =
+		    umem_alloc(sizeof (*zdst), UMEM_NOFAIL);
+		zdst->zdst_sim = zds;
+		zdst->zdst_dsobj = obj;
+		atomic_inc_64(&zds->zds_datasets);
+		VERIFY3U(taskq_dispatch(tq, zdb_ddt_sim_task, zdst, TQ_SLEEP),
+		    !=, TASKQID_INVALID);
+	}
+	taskq_wait(tq);
+	taskq_destroy(tq);
 
 	spa_config_exit(spa, SCL_CONFIG, FTAG);
 
-	while ((zdde = avl_destroy_nodes(&t, &cookie)) != NULL) {
-		uint64_t refcnt = zdde->zdde_ref_blocks;
-		ASSERT(refcnt != 0);
+	if (dump_opt['S'] > 1)
+		zdb_ddt_sim_progress(zds, B_TRUE);
 
-		ddt_stat_t *dds = &ddh_total.ddh_stat[highbit64(refcnt) - 1];
+	uint64_t scale = 1ULL << zds->zds_sample_shift;
+	for (int i = 0; i < ZDB_DDT_SIM_SHARDS; i++) {
+		void *cookie = NULL;
+		while ((zdde = avl_destroy_nodes(&zds->zds_tree[i],
+		    &cookie)) != NULL) {
+			uint64_t refcnt = zdde->zdde_ref_blocks;
+			ASSERT(refcnt != 0);
 
-		dds->dds_blocks += zdde->zdde_ref_blocks / refcnt;
-		dds->dds_lsize += zdde->zdde_ref_lsize / refcnt;
-		dds->dds_psize += zdde->zdde_ref_psize / refcnt;
-		dds->dds_dsize += zdde->zdde_ref_dsize / refcnt;
+			ddt_stat_t *dds =
+			    &ddh_total.ddh_stat[highbit64(refcnt) - 1];
 
-		dds->dds_ref_blocks += zdde->zdde_ref_blocks;
-		dds->dds_ref_lsize += zdde->zdde_ref_lsize;
-		dds->dds_ref_psize += zdde->zdde_ref_psize;
-		dds->dds_ref_dsize += zdde->zdde_ref_dsize;
+			dds->dds_blocks += scale * zdde->zdde_ref_blocks /
+			    refcnt;
+			dds->dds_lsize += scale * zdde->zdde_ref_lsize / refcnt;
+			dds->dds_psize += scale * zdde->zdde_ref_psize / refcnt;
+			dds->dds_dsize += scale * zdde->zdde_ref_dsize / refcnt;
 
-		umem_free(zdde, sizeof (*zdde));
-	}
+			dds->dds_ref_blocks += scale * zdde->zdde_ref_blocks;
+			dds->dds_ref_lsize += scale * zdde->zdde_ref_lsize;
+			dds->dds_ref_psize += scale * zdde->zdde_ref_psize;
+			dds->dds_ref_dsize += scale * zdde->zdde_ref_dsize;
 
-	avl_destroy(&t);
+			umem_free(zdde, sizeof (*zdde));
+		}
+		avl_destroy(&zds->zds_tree[i]);
+		mutex_destroy(&zds->zds_lock[i]);
+	}
 
 	ddt_histogram_total(&dds_total, &ddh_total);
 
-	(void) printf("Simulated DDT histogram:\n");
+	if (scale > 1) {
+		(void) printf("Simulated DDT histogram (estimated from 1 in "
+		    "%llu checksums, %llu sampled):\n", (u_longlong_t)scale,
+		    (u_longlong_t)zds->zds_entries);
+	} else {
+		(void) printf("Simulated DDT histogram:\n");
+	}
 
 	zpool_dump_ddt(&dds_total, &ddh_total);
 
 	dump_dedup_ratio(&dds_total);
+
+	rw_destroy(&zds->zds_sample_lock);
+	umem_free(zds, sizeof (zdb_ddt_sim_t));
 }
 
 static int
@@ -8229,6 +8545,11 @@ dump_mos_leaks(spa_t *spa)
 	mos_obj_refd(spa->spa_l2cache.sav_object);
 	mos_obj_refd(spa->spa_spares.sav_object);
 
+	uint64_t arc_warm_obj;
+	if (zap_lookup(mos, DMU_POOL_DIRECTORY_OBJECT, DMU_POOL_ARC_WARM,
+	    sizeof (uint64_t), 1, &arc_warm_obj) == 0)
+		mos_obj_refd(arc_warm_obj);
+
 	if (spa->spa_syncing_log_sm != NULL)
 		mos_obj_refd(spa->spa_syncing_log_sm->sm_object);
 	mos_leak_log_spacemaps(spa);
@@ -8588,9 +8909,9 @@ zdb_dump_indirect(blkptr_t *bp, int nbps, int flags)
 }
 
 static void
-zdb_dump_gbh(void *buf, int flags)
+zdb_dump_gbh(void *buf, uint64_t size, int flags)
 {
-	zdb_dump_indirect((blkptr_t *)buf, SPA_GBH_NBLKPTRS, flags);
+	zdb_dump_indirect((blkptr_t *)buf, gbh_nblkptrs(size), flags);
 }
 
 static void
@@ -9073,7 +9394,7 @@ zdb_read_block(char *thing, spa_t *spa)
 		zdb_dump_indirect((blkptr_t *)buf,
 		    orig_lsize / sizeof (blkptr_t), flags);
 	else if (flags & ZDB_FLAG_GBH)
-		zdb_dump_gbh(buf, flags);
+		zdb_dump_gbh(buf, lsize, flags);
 	else
 		zdb_dump_block(thing, buf, lsize, flags);
 
@@ -50,6 +50,7 @@ zed_conf_init(struct zed_conf *zcp)
 
 	zcp->max_jobs = 16;
 	zcp->max_zevent_buf_len = 1 << 20;
+	zcp->event_batch_len = 1;
 
 	if (!(zcp->pid_file = strdup(ZED_PID_FILE)) ||
 	    !(zcp->zedlet_dir = strdup(ZED_ZEDLET_DIR)) ||
@@ -97,6 +98,10 @@ zed_conf_destroy(struct zed_conf *zcp)
 		free(zcp->state_file);
 		zcp->state_file = NULL;
 	}
+	if (zcp->plugin_dir) {
+		free(zcp->plugin_dir);
+		zcp->plugin_dir = NULL;
+	}
 	if (zcp->zedlets) {
 		zed_strings_destroy(zcp->zedlets);
 		zcp->zedlets = NULL;
@@ -145,6 +150,12 @@ _zed_conf_display_help(const char *prog, boolean_t got_err)
 		    .v = "16" },
 		{ .o = "-b LEN", .d = "Cap kernel event buffer at LEN entries.",
 		    .v = "1048576" },
+		{ .o = "-B LEN", .d = "Read up to LEN events per wakeup.",
+		    .v = "1" },
+		{ .o = "-C SECS", .d = "Coalesce repeated ereports for SECS.",
+		    .v = "0" },
+		{ .o = "-A DIR", .d = "Load event plugins from DIR.",
+		    .v = "none" },
 		{},
 	};
 
@@ -234,7 +245,7 @@ _zed_conf_parse_path(char **resultp, const char *path)
 void
 zed_conf_parse_opts(struct zed_conf *zcp, int argc, char **argv)
 {
-	const char * const opts = ":hLVd:p:P:s:vfFMZIj:b:";
+	const char * const opts = ":hLVd:p:P:s:vfFMZIj:b:A:B:C:";
 	int opt;
 	unsigned long raw;
 
@@ -306,6 +317,27 @@ zed_conf_parse_opts(struct zed_conf *zcp, int argc, char **argv)
 				zcp->max_zevent_buf_len = raw;
 			}
 			break;
+		case 'A':
+			_zed_conf_parse_path(&zcp->plugin_dir, optarg);
+			break;
+		case 'B':
+			errno = 0;
+			raw = strtoul(optarg, NULL, 0);
+			if (errno == ERANGE || raw > 65536) {
+				zed_log_die("%lu is too large", raw);
+			} else if (raw == 0) {
+				zed_log_die("0 events makes no sense");
+			} else {
+				zcp->event_batch_len = raw;
+			}
+			break;
+		case 'C':
+			errno = 0;
+			raw = strtoul(optarg, NULL, 0);
+			if (errno == ERANGE || raw > INT32_MAX)
+				zed_log_die("%lu is too large", raw);
+			zcp->coalesce_secs = raw;
+			break;
 		case '?':
 		default:
 			if (optopt == '?')
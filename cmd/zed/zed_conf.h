@@ -28,6 +28,7 @@ struct zed_conf {
 	libzfs_handle_t	*zfs_hdl;		/* handle to libzfs */
 	zed_strings_t	*zedlets;		/* names of enabled zedlets */
 	char		*path;		/* custom $PATH for zedlets to use */
+	char		*plugin_dir;		/* abs path to plugin dir */
 
 	int		pid_fd;			/* fd to pid file for lock */
 	int		state_fd;		/* fd to state file */
@@ -35,6 +36,8 @@ struct zed_conf {
 
 	int16_t max_jobs;		/* max zedlets to run at one time */
 	int32_t max_zevent_buf_len;	/* max size of kernel event list */
+	int32_t event_batch_len;	/* max events read per wakeup */
+	int32_t coalesce_secs;		/* window to coalesce ereports */
 
 	boolean_t	do_force:1;		/* true if force enabled */
 	boolean_t	do_foreground:1;	/* true if run in foreground */
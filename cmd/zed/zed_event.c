@@ -22,6 +22,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <sys/avl.h>
 #include <sys/zfs_ioctl.h>
 #include <time.h>
 #include <unistd.h>
@@ -33,6 +35,7 @@
 #include "zed_exec.h"
 #include "zed_file.h"
 #include "zed_log.h"
+#include "zed_plugin.h"
 #include "zed_strings.h"
 
 #include "agents/zfs_agents.h"
@@ -42,6 +45,27 @@
 
 static int max_zevent_buf_len = 1 << 20;
 
+/*
+ * Ereports of the same class for the same vdev seen within the coalescing
+ * window (-C) after one was handed to the zedlets are not handed to them
+ * again; the number of such ereports is passed along with the next one that
+ * is, as ZEVENT_COALESCED.  The agents and plugins still see every ereport,
+ * since the diagnosis engines depend on their rate.
+ */
+typedef struct zed_coalesce_node {
+	avl_node_t	zcn_node;
+	char		*zcn_class;
+	uint64_t	zcn_pool_guid;
+	uint64_t	zcn_vdev_guid;
+	int64_t		zcn_last;	/* time of the last ereport exec'd */
+	uint64_t	zcn_suppressed;
+} zed_coalesce_node_t;
+
+static avl_tree_t _coalesce_tree;
+static boolean_t _coalesce_init = B_FALSE;
+
+static nvlist_t **_event_batch;
+
 /*
  * Open the libzfs interface.
  */
@@ -68,6 +92,14 @@ zed_event_init(struct zed_conf *zcp)
 
 	zfs_agent_init(zcp->zfs_hdl);
 
+	if (zed_plugin_init(zcp) != 0 && !zcp->do_force)
+		zed_log_die("Failed to initialize plugins");
+
+	_event_batch = calloc(zcp->event_batch_len, sizeof (nvlist_t *));
+	if (_event_batch == NULL)
+		zed_log_die("Failed to allocate event batch: %s",
+		    strerror(ENOMEM));
+
 	if (zed_disk_event_init() != 0) {
 		if (zcp->do_idle)
 			return (-1);
@@ -90,8 +122,24 @@ zed_event_fini(struct zed_conf *zcp)
 		zed_log_die("Failed zed_event_fini: %s", strerror(EINVAL));
 
 	zed_disk_event_fini();
+	zed_plugin_fini();
 	zfs_agent_fini();
 
+	free(_event_batch);
+	_event_batch = NULL;
+
+	if (_coalesce_init) {
+		zed_coalesce_node_t *zcn;
+		void *ck = NULL;
+
+		while ((zcn = avl_destroy_nodes(&_coalesce_tree, &ck))) {
+			free(zcn->zcn_class);
+			free(zcn);
+		}
+		avl_destroy(&_coalesce_tree);
+		_coalesce_init = B_FALSE;
+	}
+
 	if (zcp->zevent_fd >= 0) {
 		if (close(zcp->zevent_fd) < 0)
 			zed_log_msg(LOG_WARNING, "Failed to close \"%s\": %s",
@@ -943,39 +991,96 @@ _zed_event_update_enc_sysfs_path(nvlist_t *nvl)
 	    FM_EREPORT_PAYLOAD_ZFS_VDEV_ENC_SYSFS_PATH);
 }
 
+static int
+_zed_coalesce_compare(const void *x1, const void *x2)
+{
+	const zed_coalesce_node_t *n1 = x1;
+	const zed_coalesce_node_t *n2 = x2;
+	int cmp;
+
+	cmp = TREE_CMP(n1->zcn_pool_guid, n2->zcn_pool_guid);
+	if (cmp != 0)
+		return (cmp);
+	cmp = TREE_CMP(n1->zcn_vdev_guid, n2->zcn_vdev_guid);
+	if (cmp != 0)
+		return (cmp);
+	return (TREE_ISIGN(strcmp(n1->zcn_class, n2->zcn_class)));
+}
+
 /*
- * Service the next zevent, blocking until one is available.
+ * Return B_TRUE if the zedlets should not be run for this ereport because
+ * an identical one was handed to them within the coalescing window.
+ * Otherwise, return B_FALSE and set [coalesced] to the number of ereports
+ * suppressed since the last one handed to them.
  */
-int
-zed_event_service(struct zed_conf *zcp)
+static boolean_t
+_zed_event_coalesce(struct zed_conf *zcp, const char *class, nvlist_t *nvl,
+    int64_t etime[], uint64_t *coalesced)
+{
+	zed_coalesce_node_t search, *zcn;
+	avl_index_t where;
+
+	*coalesced = 0;
+	if (zcp->coalesce_secs == 0 || strncmp(class, "ereport.", 8) != 0)
+		return (B_FALSE);
+
+	if (nvlist_lookup_uint64(nvl, FM_EREPORT_PAYLOAD_ZFS_POOL_GUID,
+	    &search.zcn_pool_guid) != 0)
+		return (B_FALSE);
+	if (nvlist_lookup_uint64(nvl, FM_EREPORT_PAYLOAD_ZFS_VDEV_GUID,
+	    &search.zcn_vdev_guid) != 0)
+		search.zcn_vdev_guid = 0;
+	search.zcn_class = (char *)class;
+
+	if (!_coalesce_init) {
+		avl_create(&_coalesce_tree, _zed_coalesce_compare,
+		    sizeof (zed_coalesce_node_t),
+		    offsetof(zed_coalesce_node_t, zcn_node));
+		_coalesce_init = B_TRUE;
+	}
+
+	zcn = avl_find(&_coalesce_tree, &search, &where);
+	if (zcn == NULL) {
+		zcn = calloc(1, sizeof (*zcn));
+		if (zcn == NULL || (zcn->zcn_class = strdup(class)) == NULL) {
+			free(zcn);
+			return (B_FALSE);
+		}
+		zcn->zcn_pool_guid = search.zcn_pool_guid;
+		zcn->zcn_vdev_guid = search.zcn_vdev_guid;
+		zcn->zcn_last = etime[0];
+		avl_insert(&_coalesce_tree, zcn, where);
+		return (B_FALSE);
+	}
+
+	if (etime[0] >= zcn->zcn_last &&
+	    etime[0] - zcn->zcn_last < zcp->coalesce_secs) {
+		zcn->zcn_suppressed++;
+		return (B_TRUE);
+	}
+
+	*coalesced = zcn->zcn_suppressed;
+	zcn->zcn_suppressed = 0;
+	zcn->zcn_last = etime[0];
+	return (B_FALSE);
+}
+
+/*
+ * Process the zevent [nvl]: hand it to the agents and plugins, then to the
+ * zedlets matching its class, and record it in the state file.
+ */
+static void
+_zed_event_process(struct zed_conf *zcp, nvlist_t *nvl)
 {
-	nvlist_t *nvl;
 	nvpair_t *nvp;
-	int n_dropped;
 	zed_strings_t *zsp;
 	uint64_t eid;
+	uint64_t coalesced;
 	int64_t *etime;
 	uint_t nelem;
 	const char *class;
 	const char *subclass;
-	int rv;
 
-	if (!zcp) {
-		errno = EINVAL;
-		zed_log_msg(LOG_ERR, "Failed to service zevent: %s",
-		    strerror(errno));
-		return (EINVAL);
-	}
-	rv = zpool_events_next(zcp->zfs_hdl, &nvl, &n_dropped, ZEVENT_NONE,
-	    zcp->zevent_fd);
-
-	if ((rv != 0) || !nvl)
-		return (errno);
-
-	if (n_dropped > 0) {
-		zed_log_msg(LOG_WARNING, "Missed %d events", n_dropped);
-		_bump_event_queue_length();
-	}
 	if (nvlist_lookup_uint64(nvl, "eid", &eid) != 0) {
 		zed_log_msg(LOG_WARNING, "Failed to lookup zevent eid");
 	} else if (nvlist_lookup_int64_array(
@@ -1003,6 +1108,12 @@ zed_event_service(struct zed_conf *zcp)
 
 		/* let internal modules see this event first */
 		zfs_agent_post_event(class, NULL, nvl);
+		zed_plugin_post_event(class, nvl);
+
+		if (_zed_event_coalesce(zcp, class, nvl, etime, &coalesced)) {
+			zed_conf_write_state(zcp, eid, etime);
+			return;
+		}
 
 		zsp = zed_strings_create();
 
@@ -1020,6 +1131,13 @@ zed_event_service(struct zed_conf *zcp)
 		subclass = _zed_event_get_subclass(class);
 		_zed_event_add_var(eid, zsp, ZEVENT_VAR_PREFIX, "SUBCLASS",
 		    "%s", (subclass ? subclass : class));
+		if (coalesced > 0) {
+			zed_log_msg(LOG_INFO, "Coalesced %llu \"%s\" events "
+			    "before eid=%llu", (u_longlong_t)coalesced, class,
+			    eid);
+			_zed_event_add_var(eid, zsp, ZEVENT_VAR_PREFIX,
+			    "COALESCED", "%llu", (u_longlong_t)coalesced);
+		}
 
 		_zed_event_add_time_strings(eid, zsp, etime);
 
@@ -1029,6 +1147,52 @@ zed_event_service(struct zed_conf *zcp)
 
 		zed_strings_destroy(zsp);
 	}
-	nvlist_free(nvl);
+}
+
+/*
+ * Service the next zevents, blocking until one is available.
+ *
+ * Up to [zcp->event_batch_len] pending zevents are read before any is
+ * processed, so that a burst is drained from the kernel, whose event list
+ * drops the oldest entries once it is full, while zedlets are running.
+ */
+int
+zed_event_service(struct zed_conf *zcp)
+{
+	nvlist_t *nvl;
+	int n_dropped;
+	int n, i;
+	int rv;
+
+	if (!zcp) {
+		errno = EINVAL;
+		zed_log_msg(LOG_ERR, "Failed to service zevent: %s",
+		    strerror(errno));
+		return (EINVAL);
+	}
+	rv = zpool_events_next(zcp->zfs_hdl, &nvl, &n_dropped, ZEVENT_NONE,
+	    zcp->zevent_fd);
+
+	if ((rv != 0) || !nvl)
+		return (errno);
+
+	n = 0;
+	do {
+		if (n_dropped > 0) {
+			zed_log_msg(LOG_WARNING, "Missed %d events", n_dropped);
+			_bump_event_queue_length();
+		}
+		_event_batch[n++] = nvl;
+		if (n == zcp->event_batch_len)
+			break;
+		rv = zpool_events_next(zcp->zfs_hdl, &nvl, &n_dropped,
+		    ZEVENT_NONBLOCK, zcp->zevent_fd);
+	} while (rv == 0 && nvl != NULL);
+
+	for (i = 0; i < n; i++) {
+		_zed_event_process(zcp, _event_batch[i]);
+		nvlist_free(_event_batch[i]);
+		_event_batch[i] = NULL;
+	}
 	return (0);
 }
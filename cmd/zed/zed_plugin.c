@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * This file is part of the ZFS Event Daemon (ZED).
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License Version 1.0 (CDDL-1.0).
+ * You can obtain a copy of the license from the top-level file
+ * "OPENSOLARIS.LICENSE" or at <http://opensource.org/licenses/CDDL-1.0>.
+ * You may not use this file except in compliance with the license.
+ */
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "zed_conf.h"
+#include "zed_log.h"
+#include "zed_plugin.h"
+
+typedef struct zed_plugin {
+	struct zed_plugin	*zp_next;
+	void			*zp_handle;
+	const zed_plugin_ops_t	*zp_ops;
+	size_t			zp_class_len;
+} zed_plugin_t;
+
+static zed_plugin_t *_zed_plugins;
+
+/*
+ * Load the plugin at [pathname], applying the same ownership and
+ * permission checks as zedlets.
+ */
+static void
+_zed_plugin_load(struct zed_conf *zcp, const char *pathname, const char *name)
+{
+	const zed_plugin_ops_t *ops;
+	zed_plugin_t *zp;
+	struct stat st;
+	void *handle;
+
+	if (stat(pathname, &st) < 0) {
+		zed_log_msg(LOG_WARNING, "Failed to stat \"%s\": %s",
+		    pathname, strerror(errno));
+		return;
+	}
+	if (!S_ISREG(st.st_mode))
+		return;
+	if (((st.st_uid != 0) || (st.st_mode & (S_IWGRP | S_IWOTH))) &&
+	    !zcp->do_force) {
+		zed_log_msg(LOG_NOTICE,
+		    "Ignoring plugin \"%s\": not owned by root or writable by "
+		    "group or other", name);
+		return;
+	}
+
+	handle = dlopen(pathname, RTLD_NOW | RTLD_LOCAL);
+	if (handle == NULL) {
+		zed_log_msg(LOG_WARNING, "Failed to load plugin \"%s\": %s",
+		    name, dlerror());
+		return;
+	}
+	ops = dlsym(handle, ZED_PLUGIN_SYMBOL);
+	if (ops == NULL || ops->zpo_version != ZED_PLUGIN_VERSION ||
+	    ops->zpo_event == NULL) {
+		zed_log_msg(LOG_WARNING,
+		    "Ignoring plugin \"%s\": missing or incompatible %s",
+		    name, ZED_PLUGIN_SYMBOL);
+		(void) dlclose(handle);
+		return;
+	}
+	if (ops->zpo_init != NULL && ops->zpo_init() != 0) {
+		zed_log_msg(LOG_WARNING, "Failed to initialize plugin \"%s\"",
+		    name);
+		(void) dlclose(handle);
+		return;
+	}
+
+	zp = calloc(1, sizeof (*zp));
+	if (zp == NULL) {
+		zed_log_msg(LOG_WARNING, "Failed to register plugin \"%s\": %s",
+		    name, strerror(ENOMEM));
+		if (ops->zpo_fini != NULL)
+			ops->zpo_fini();
+		(void) dlclose(handle);
+		return;
+	}
+	zp->zp_handle = handle;
+	zp->zp_ops = ops;
+	zp->zp_class_len = ops->zpo_class ? strlen(ops->zpo_class) : 0;
+	zp->zp_next = _zed_plugins;
+	_zed_plugins = zp;
+
+	zed_log_msg(LOG_INFO, "Registered plugin \"%s\" (%s)", name,
+	    ops->zpo_name ? ops->zpo_name : name);
+}
+
+/*
+ * Load the shared libraries (*.so) found in [zcp->plugin_dir].
+ * Return 0 on success, or -1 if the directory cannot be read.
+ */
+int
+zed_plugin_init(struct zed_conf *zcp)
+{
+	char pathname[PATH_MAX];
+	struct dirent *direntp;
+	DIR *dirp;
+	size_t len;
+	int n;
+
+	if (zcp->plugin_dir == NULL)
+		return (0);
+
+	dirp = opendir(zcp->plugin_dir);
+	if (dirp == NULL) {
+		zed_log_msg(LOG_WARNING, "Failed to open dir \"%s\": %s",
+		    zcp->plugin_dir, strerror(errno));
+		return (-1);
+	}
+	while ((direntp = readdir(dirp))) {
+		len = strlen(direntp->d_name);
+		if (direntp->d_name[0] == '.' || len < 4 ||
+		    strcmp(direntp->d_name + len - 3, ".so") != 0)
+			continue;
+
+		n = snprintf(pathname, sizeof (pathname),
+		    "%s/%s", zcp->plugin_dir, direntp->d_name);
+		if ((n < 0) || (n >= sizeof (pathname))) {
+			zed_log_msg(LOG_WARNING, "Failed to load \"%s\": %s",
+			    direntp->d_name, strerror(ENAMETOOLONG));
+			continue;
+		}
+		_zed_plugin_load(zcp, pathname, direntp->d_name);
+	}
+	(void) closedir(dirp);
+	return (0);
+}
+
+void
+zed_plugin_fini(void)
+{
+	zed_plugin_t *zp;
+
+	while ((zp = _zed_plugins) != NULL) {
+		_zed_plugins = zp->zp_next;
+		if (zp->zp_ops->zpo_fini != NULL)
+			zp->zp_ops->zpo_fini();
+		(void) dlclose(zp->zp_handle);
+		free(zp);
+	}
+}
+
+/*
+ * Hand the zevent [nvl] of class [class] to every matching plugin.
+ */
+void
+zed_plugin_post_event(const char *class, nvlist_t *nvl)
+{
+	for (zed_plugin_t *zp = _zed_plugins; zp != NULL; zp = zp->zp_next) {
+		if (zp->zp_class_len == 0 || strncmp(class,
+		    zp->zp_ops->zpo_class, zp->zp_class_len) == 0)
+			zp->zp_ops->zpo_event(class, nvl);
+	}
+}
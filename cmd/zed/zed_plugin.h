@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * This file is part of the ZFS Event Daemon (ZED).
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License Version 1.0 (CDDL-1.0).
+ * You can obtain a copy of the license from the top-level file
+ * "OPENSOLARIS.LICENSE" or at <http://opensource.org/licenses/CDDL-1.0>.
+ * You may not use this file except in compliance with the license.
+ */
+
+#ifndef	ZED_PLUGIN_H
+#define	ZED_PLUGIN_H
+
+#include <libnvpair.h>
+
+/*
+ * In-process event consumers.
+ *
+ * A plugin is a shared library in the plugin directory (-A) exporting a
+ * zed_plugin_ops_t named ZED_PLUGIN_SYMBOL.  Its zpo_event callback is
+ * called from the event loop for every zevent whose class starts with
+ * zpo_class (or for every zevent if zpo_class is NULL), right after the
+ * internal agents and before any zedlet is started.  Unlike zedlets, no
+ * process is forked, so plugins suit high-rate consumers; in exchange,
+ * zpo_event must not block, and the nvlist it is handed is only valid for
+ * the duration of the call.
+ */
+#define	ZED_PLUGIN_VERSION	1
+#define	ZED_PLUGIN_SYMBOL	"zed_plugin"
+
+typedef struct zed_plugin_ops {
+	int		zpo_version;	/* ZED_PLUGIN_VERSION */
+	const char	*zpo_name;
+	const char	*zpo_class;	/* class prefix, or NULL for all */
+	int		(*zpo_init)(void);	/* optional, 0 on success */
+	void		(*zpo_event)(const char *class, nvlist_t *nvl);
+	void		(*zpo_fini)(void);	/* optional */
+} zed_plugin_ops_t;
+
+struct zed_conf;
+
+int zed_plugin_init(struct zed_conf *zcp);
+void zed_plugin_fini(void);
+void zed_plugin_post_event(const char *class, nvlist_t *nvl);
+
+#endif	/* !ZED_PLUGIN_H */
@@ -68,6 +68,7 @@
 #include <sys/types.h>
 #include <time.h>
 #include <sys/zfs_project.h>
+#include <thread_pool.h>
 
 #include <libzfs.h>
 #include <libzfs_core.h>
@@ -123,6 +124,7 @@ static int zfs_do_project(int argc, char **argv);
 static int zfs_do_version(int argc, char **argv);
 static int zfs_do_redact(int argc, char **argv);
 static int zfs_do_rewrite(int argc, char **argv);
+static int zfs_do_prefetch(int argc, char **argv);
 static int zfs_do_wait(int argc, char **argv);
 
 #ifdef __FreeBSD__
@@ -196,6 +198,7 @@ typedef enum {
 	HELP_VERSION,
 	HELP_REDACT,
 	HELP_REWRITE,
+	HELP_PREFETCH,
 	HELP_JAIL,
 	HELP_UNJAIL,
 	HELP_WAIT,
@@ -267,6 +270,7 @@ static zfs_command_t command_table[] = {
 	{ NULL },
 	{ "program",	zfs_do_channel_program,	HELP_CHANNEL_PROGRAM	},
 	{ "rewrite",	zfs_do_rewrite,		HELP_REWRITE		},
+	{ "prefetch",	zfs_do_prefetch,	HELP_PREFETCH		},
 	{ "wait",	zfs_do_wait,		HELP_WAIT		},
 
 #ifdef __FreeBSD__
@@ -440,8 +444,13 @@ get_usage(zfs_help_t idx)
 		return (gettext("\tredact <snapshot> <bookmark> "
 		    "<redaction_snapshot> ...\n"));
 	case HELP_REWRITE:
-		return (gettext("\trewrite [-rvx] [-o <offset>] [-l <length>] "
-		    "<directory|file ...>\n"));
+		return (gettext("\trewrite [-rvx] [-N|-S] [-b <rate>] "
+		    "[-o <offset>] [-l <length>]\n"
+		    "\t    <directory|file ...>\n"));
+	case HELP_PREFETCH:
+		return (gettext("\tprefetch [-rvx] [-b <rate>] [-o <offset>] "
+		    "[-l <length>]\n"
+		    "\t    <filesystem|volume|snapshot|directory|file> ...\n"));
 	case HELP_JAIL:
 		return (gettext("\tjail <jailid|jailname> <filesystem>\n"));
 	case HELP_UNJAIL:
@@ -940,6 +949,7 @@ default_volblocksize(zpool_handle_t *zhp, nvlist_t *props)
 	uint64_t volblocksize, asize = SPA_MINBLOCKSIZE;
 	nvlist_t *tree, **vdevs;
 	uint_t nvdevs;
+	boolean_t draid = B_FALSE;
 
 	nvlist_t *config = zpool_get_config(zhp, NULL);
 
@@ -959,17 +969,26 @@ default_volblocksize(zpool_handle_t *zhp, nvlist_t *props)
 		if (nvlist_lookup_uint64(nv, ZPOOL_CONFIG_DRAID_NDATA,
 		    &ndata) == 0) {
 			/* dRAID minimum allocation width */
-			asize = MAX(asize, ndata * (1ULL << ashift));
+			if (ndata * (1ULL << ashift) > asize) {
+				asize = ndata * (1ULL << ashift);
+				draid = B_TRUE;
+			}
 		} else if (nvlist_lookup_uint64(nv, ZPOOL_CONFIG_NPARITY,
 		    &nparity) == 0) {
-			/* raidz minimum allocation width */
-			if (nparity == 1)
-				asize = MAX(asize, 2 * (1ULL << ashift));
-			else
-				asize = MAX(asize, 4 * (1ULL << ashift));
-		} else {
+			/*
+			 * raidz minimum allocation width.  Allocations are
+			 * a multiple of nparity + 1 sectors, so small blocks
+			 * are padded with skip sectors.
+			 */
+			uint64_t width = (nparity == 1 ? 2ULL : 4ULL) << ashift;
+			if (width > asize) {
+				asize = width;
+				draid = B_FALSE;
+			}
+		} else if ((1ULL << ashift) > asize) {
 			/* mirror or (non-redundant) leaf vdev */
-			asize = MAX(asize, 1ULL << ashift);
+			asize = 1ULL << ashift;
+			draid = B_FALSE;
 		}
 	}
 
@@ -1016,11 +1035,15 @@ default_volblocksize(zpool_handle_t *zhp, nvlist_t *props)
 			    "minimum allocation\nunit (%llu), which wastes "
 			    "at least %llu%% of space. To reduce wasted "
 			    "space,\nuse a larger volblocksize (%llu is "
-			    "recommended), fewer dRAID data disks\n"
-			    "per group, or smaller sector size (ashift).\n"),
+			    "recommended), %s,\nor smaller sector size "
+			    "(ashift).\n"),
 			    (u_longlong_t)volblocksize, (u_longlong_t)asize,
 			    (u_longlong_t)((100 * (asize - volblocksize)) /
-			    asize), (u_longlong_t)tgt_volblocksize);
+			    asize), (u_longlong_t)tgt_volblocksize,
+			    draid ?
+			    gettext("fewer dRAID data disks per group") :
+			    gettext("a mirrored special vdev with "
+			    "special_small_blocks"));
 		}
 	} else {
 		volblocksize = tgt_volblocksize;
@@ -7981,6 +8004,20 @@ unshare_unmount(int op, int argc, char **argv)
 		}
 		(void) fclose(mnttab);
 
+		/*
+		 * Unshare everything up front and commit the shares once,
+		 * rather than once for every filesystem as it is unmounted.
+		 */
+		if (op == OP_MOUNT) {
+			for (node = uu_avl_first(tree); node != NULL;
+			    node = uu_avl_next(tree, node)) {
+				if (zfs_unshare(node->un_zhp, node->un_mountp,
+				    NULL) != 0)
+					ret = 1;
+			}
+			zfs_commit_shares(NULL);
+		}
+
 		/*
 		 * Walk the AVL tree in reverse, unmounting each filesystem and
 		 * removing it from the AVL tree in the process.
@@ -8605,8 +8642,82 @@ typedef struct loadkey_cbdata {
 	char *cb_keylocation;
 	uint64_t cb_numfailed;
 	uint64_t cb_numattempted;
+	zfs_handle_t **cb_deferred;
+	size_t cb_ndeferred;
+	size_t cb_deferred_alloc;
+	pthread_mutex_t cb_lock;
 } loadkey_cbdata_t;
 
+typedef struct loadkey_task {
+	loadkey_cbdata_t *lt_cb;
+	zfs_handle_t *lt_zhp;
+} loadkey_task_t;
+
+/*
+ * Keys stored in files can be loaded without user interaction, so when
+ * loading many of them they are deferred and loaded in parallel.  For
+ * passphrases most of the time goes to PBKDF2, which is single threaded.
+ */
+static boolean_t
+load_key_deferrable(zfs_handle_t *zhp, loadkey_cbdata_t *cb)
+{
+	char keylocation[MAXNAMELEN];
+
+	if (!cb->cb_loadkey || !cb->cb_recursive || cb->cb_keylocation != NULL)
+		return (B_FALSE);
+
+	if (zfs_prop_get(zhp, ZFS_PROP_KEYLOCATION, keylocation,
+	    sizeof (keylocation), NULL, NULL, 0, B_TRUE) != 0)
+		return (B_FALSE);
+
+	return (strncmp(keylocation, "file://", 7) == 0);
+}
+
+static void
+load_key_task(void *arg)
+{
+	loadkey_task_t *lt = arg;
+	loadkey_cbdata_t *cb = lt->lt_cb;
+
+	int ret = zfs_crypto_load_key(lt->lt_zhp, cb->cb_noop, NULL);
+
+	pthread_mutex_lock(&cb->cb_lock);
+	cb->cb_numattempted++;
+	if (ret != 0)
+		cb->cb_numfailed++;
+	pthread_mutex_unlock(&cb->cb_lock);
+}
+
+static void
+load_deferred_keys(loadkey_cbdata_t *cb)
+{
+	loadkey_task_t *tasks;
+	tpool_t *tp;
+
+	if (cb->cb_ndeferred == 0)
+		return;
+
+	tasks = safe_malloc(cb->cb_ndeferred * sizeof (loadkey_task_t));
+	tp = tpool_create(1, sysconf(_SC_NPROCESSORS_ONLN), 0, NULL);
+	if (tp == NULL)
+		nomem();
+
+	for (size_t i = 0; i < cb->cb_ndeferred; i++) {
+		tasks[i].lt_cb = cb;
+		tasks[i].lt_zhp = cb->cb_deferred[i];
+		if (tpool_dispatch(tp, load_key_task, &tasks[i]) != 0)
+			load_key_task(&tasks[i]);
+	}
+
+	tpool_wait(tp);
+	tpool_destroy(tp);
+
+	for (size_t i = 0; i < cb->cb_ndeferred; i++)
+		zfs_close(cb->cb_deferred[i]);
+	free(cb->cb_deferred);
+	free(tasks);
+}
+
 static int
 load_key_callback(zfs_handle_t *zhp, void *data)
 {
@@ -8632,6 +8743,20 @@ load_key_callback(zfs_handle_t *zhp, void *data)
 			return (0);
 	}
 
+	if (load_key_deferrable(zhp, cb)) {
+		if (cb->cb_ndeferred == cb->cb_deferred_alloc) {
+			cb->cb_deferred_alloc = MAX(16,
+			    cb->cb_deferred_alloc * 2);
+			cb->cb_deferred = safe_realloc(cb->cb_deferred,
+			    cb->cb_deferred_alloc * sizeof (zfs_handle_t *));
+		}
+		if ((cb->cb_deferred[cb->cb_ndeferred] =
+		    zfs_handle_dup(zhp)) == NULL)
+			nomem();
+		cb->cb_ndeferred++;
+		return (0);
+	}
+
 	cb->cb_numattempted++;
 
 	if (cb->cb_loadkey)
@@ -8709,9 +8834,12 @@ load_unload_keys(int argc, char **argv, boolean_t loadkey)
 		usage(B_FALSE);
 	}
 
+	pthread_mutex_init(&cb.cb_lock, NULL);
 	ret = zfs_for_each(argc, argv, flags,
 	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME, NULL, NULL, 0,
 	    load_key_callback, &cb);
+	load_deferred_keys(&cb);
+	pthread_mutex_destroy(&cb.cb_lock);
 
 	if (cb.cb_noop || (cb.cb_recursive && cb.cb_numattempted != 0)) {
 		(void) printf(gettext("%llu / %llu key(s) successfully %s\n"),
@@ -9160,11 +9288,26 @@ zfs_do_rewrite(int argc, char **argv)
 	zfs_rewrite_args_t args;
 	memset(&args, 0, sizeof (args));
 
-	while ((c = getopt(argc, argv, "l:o:rvx")) != -1) {
+	while ((c = getopt(argc, argv, "b:l:No:rSvx")) != -1) {
 		switch (c) {
+		case 'b':
+			if (zfs_nicestrtonum(g_zfs, optarg, &args.arg) != 0 ||
+			    args.arg == 0) {
+				(void) fprintf(stderr, gettext("bad rate "
+				    "value '%s'\n"), optarg);
+				usage(B_FALSE);
+			}
+			args.flags |= ZFS_REWRITE_RATE;
+			break;
 		case 'l':
 			args.len = strtoll(optarg, NULL, 0);
 			break;
+		case 'N':
+			args.flags |= ZFS_REWRITE_NORMAL;
+			break;
+		case 'S':
+			args.flags |= ZFS_REWRITE_SPECIAL;
+			break;
 		case 'o':
 			args.off = strtoll(optarg, NULL, 0);
 			break;
@@ -9191,6 +9334,12 @@ zfs_do_rewrite(int argc, char **argv)
 		    gettext("missing file or directory target(s)\n"));
 		usage(B_FALSE);
 	}
+	if ((args.flags & ZFS_REWRITE_NORMAL) &&
+	    (args.flags & ZFS_REWRITE_SPECIAL)) {
+		(void) fprintf(stderr,
+		    gettext("-N and -S are mutually exclusive\n"));
+		usage(B_FALSE);
+	}
 
 	nvlist_t *dirs = fnvlist_alloc();
 	for (int i = 0; i < argc; i++) {
@@ -9212,6 +9361,278 @@ zfs_do_rewrite(int argc, char **argv)
 	return (ret);
 }
 
+typedef struct zfs_prefetch_cb {
+	uint64_t	zpc_offset;
+	uint64_t	zpc_length;
+	uint64_t	zpc_rate;
+	boolean_t	zpc_range;	/* -o or -l given */
+	boolean_t	zpc_verbose;
+	boolean_t	zpc_xdev;
+	hrtime_t	zpc_start;
+	uint64_t	zpc_bytes;	/* file bytes read so far */
+	dev_t		zpc_dev;	/* device of zpc_dsname */
+	char		zpc_dsname[ZFS_MAX_DATASET_NAME_LEN];
+} zfs_prefetch_cb_t;
+
+/*
+ * Read a dataset, or with a non-NULL object that object, into the ARC.
+ * The kernel paces each call to the rate on its own; for files, which
+ * take a call each, the pace over all of them is kept here, by sleeping
+ * until the bytes read so far are due.
+ */
+static int
+zfs_prefetch_one(const char *dsname, const uint64_t *object, uint64_t size,
+    const char *target, zfs_prefetch_cb_t *cb)
+{
+	nvlist_t *args = fnvlist_alloc();
+	int err;
+
+	if (object != NULL)
+		fnvlist_add_uint64(args, ZFS_PREFETCH_OBJECT, *object);
+	if (cb->zpc_range) {
+		fnvlist_add_uint64(args, ZFS_PREFETCH_OFFSET, cb->zpc_offset);
+		fnvlist_add_uint64(args, ZFS_PREFETCH_LENGTH, cb->zpc_length);
+	}
+	if (cb->zpc_rate != 0)
+		fnvlist_add_uint64(args, ZFS_PREFETCH_RATE, cb->zpc_rate);
+
+	err = lzc_prefetch(dsname, args);
+	fnvlist_free(args);
+	if (err != 0) {
+		(void) fprintf(stderr, gettext("failed to prefetch %s: %s\n"),
+		    target, strerror(err));
+		return (err);
+	}
+	if (cb->zpc_verbose)
+		(void) printf("%s\n", target);
+
+	if (cb->zpc_rate != 0 && object != NULL) {
+		if (size > cb->zpc_offset)
+			cb->zpc_bytes += MIN(size - cb->zpc_offset,
+			    cb->zpc_length);
+		hrtime_t due = cb->zpc_start +
+		    (hrtime_t)((double)cb->zpc_bytes / cb->zpc_rate * NANOSEC);
+		hrtime_t now = gethrtime();
+		if (due > now) {
+			struct timespec ts;
+			ts.tv_sec = (due - now) / NANOSEC;
+			ts.tv_nsec = (due - now) % NANOSEC;
+			(void) nanosleep(&ts, NULL);
+		}
+	}
+	return (0);
+}
+
+static int
+zfs_prefetch_file(const char *path, const struct stat64 *st,
+    zfs_prefetch_cb_t *cb)
+{
+	if (cb->zpc_dsname[0] == '\0' || st->st_dev != cb->zpc_dev) {
+		struct stat64 mntst;
+		struct extmnttab entry;
+
+		if (getextmntent(path, &entry, &mntst) != 0) {
+			(void) fprintf(stderr, gettext("failed to find the "
+			    "file system of %s\n"), path);
+			return (ENOENT);
+		}
+		if (strcmp(entry.mnt_fstype, MNTTYPE_ZFS) != 0) {
+			(void) fprintf(stderr,
+			    gettext("%s is not on a ZFS file system\n"), path);
+			return (EINVAL);
+		}
+		(void) strlcpy(cb->zpc_dsname, entry.mnt_special,
+		    sizeof (cb->zpc_dsname));
+		cb->zpc_dev = st->st_dev;
+	}
+
+	uint64_t object = st->st_ino;
+	return (zfs_prefetch_one(cb->zpc_dsname, &object, st->st_size, path,
+	    cb));
+}
+
+static int
+zfs_prefetch_dir(const char *path, dev_t dev, zfs_prefetch_cb_t *cb,
+    nvlist_t *dirs)
+{
+	struct dirent *ent;
+	DIR *dir;
+	int ret = 0, err;
+
+	dir = opendir(path);
+	if (dir == NULL) {
+		if (errno == ENOENT)
+			return (0);
+		ret = errno;
+		(void) fprintf(stderr, gettext("failed to opendir %s: %s\n"),
+		    path, strerror(errno));
+		return (ret);
+	}
+
+	while ((ent = readdir(dir)) != NULL) {
+		char *fullname;
+		struct stat64 st;
+
+		if (ent->d_type != DT_REG && ent->d_type != DT_DIR)
+			continue;
+
+		if (strcmp(ent->d_name, ".") == 0 ||
+		    strcmp(ent->d_name, "..") == 0)
+			continue;
+
+		if (asprintf(&fullname, "%s/%s", path, ent->d_name) == -1) {
+			(void) fprintf(stderr,
+			    gettext("failed to allocate memory\n"));
+			ret = ENOMEM;
+			continue;
+		}
+
+		if (lstat64(fullname, &st) < 0) {
+			ret = errno;
+			(void) fprintf(stderr,
+			    gettext("failed to stat %s: %s\n"),
+			    fullname, strerror(errno));
+			free(fullname);
+			continue;
+		}
+		if (cb->zpc_xdev && st.st_dev != dev) {
+			free(fullname);
+			continue;
+		}
+
+		if (S_ISREG(st.st_mode)) {
+			err = zfs_prefetch_file(fullname, &st, cb);
+			if (err)
+				ret = err;
+		} else if (S_ISDIR(st.st_mode)) {
+			fnvlist_add_uint64(dirs, fullname, dev);
+		}
+
+		free(fullname);
+	}
+
+	closedir(dir);
+	return (ret);
+}
+
+static int
+zfs_prefetch_target(const char *target, boolean_t recurse,
+    zfs_prefetch_cb_t *cb, nvlist_t *dirs)
+{
+	struct stat64 st;
+
+	/*
+	 * Anything but an explicit path naming an existing dataset is
+	 * prefetched as a whole, or for a volume, over the given range.
+	 */
+	if (target[0] != '/' && strncmp(target, "./", 2) != 0 &&
+	    zfs_dataset_exists(g_zfs, target, ZFS_TYPE_DATASET)) {
+		return (zfs_prefetch_one(target, NULL, 0, target, cb));
+	}
+
+	if (lstat64(target, &st) < 0) {
+		int ret = errno;
+		(void) fprintf(stderr, gettext("failed to stat %s: %s\n"),
+		    target, strerror(errno));
+		return (ret);
+	}
+
+	if (S_ISREG(st.st_mode))
+		return (zfs_prefetch_file(target, &st, cb));
+	if (S_ISDIR(st.st_mode) && recurse)
+		return (zfs_prefetch_dir(target, st.st_dev, cb, dirs));
+	return (0);
+}
+
+/*
+ * zfs prefetch [-rvx] [-b rate] [-o offset] [-l length] <target> ...
+ *
+ * Read datasets, or files, into the ARC (and from there the L2ARC), for
+ * example to warm a standby before a failover or a batch job.
+ */
+static int
+zfs_do_prefetch(int argc, char **argv)
+{
+	int ret = 0, err, c;
+	boolean_t recurse = B_FALSE;
+	zfs_prefetch_cb_t cb = { 0 };
+
+	cb.zpc_length = UINT64_MAX;
+
+	while ((c = getopt(argc, argv, "b:l:o:rvx")) != -1) {
+		switch (c) {
+		case 'b':
+			if (zfs_nicestrtonum(g_zfs, optarg,
+			    &cb.zpc_rate) != 0) {
+				(void) fprintf(stderr, gettext("bad rate "
+				    "value '%s': %s\n"), optarg,
+				    libzfs_error_description(g_zfs));
+				usage(B_FALSE);
+			}
+			break;
+		case 'l':
+			if (zfs_nicestrtonum(g_zfs, optarg,
+			    &cb.zpc_length) != 0) {
+				(void) fprintf(stderr, gettext("bad length "
+				    "value '%s': %s\n"), optarg,
+				    libzfs_error_description(g_zfs));
+				usage(B_FALSE);
+			}
+			cb.zpc_range = B_TRUE;
+			break;
+		case 'o':
+			if (zfs_nicestrtonum(g_zfs, optarg,
+			    &cb.zpc_offset) != 0) {
+				(void) fprintf(stderr, gettext("bad offset "
+				    "value '%s': %s\n"), optarg,
+				    libzfs_error_description(g_zfs));
+				usage(B_FALSE);
+			}
+			cb.zpc_range = B_TRUE;
+			break;
+		case 'r':
+			recurse = B_TRUE;
+			break;
+		case 'v':
+			cb.zpc_verbose = B_TRUE;
+			break;
+		case 'x':
+			cb.zpc_xdev = B_TRUE;
+			break;
+		default:
+			(void) fprintf(stderr, gettext("invalid option '%c'\n"),
+			    optopt);
+			usage(B_FALSE);
+		}
+	}
+
+	argv += optind;
+	argc -= optind;
+	if (argc == 0) {
+		(void) fprintf(stderr, gettext("missing target(s)\n"));
+		usage(B_FALSE);
+	}
+
+	cb.zpc_start = gethrtime();
+	nvlist_t *dirs = fnvlist_alloc();
+	for (int i = 0; i < argc; i++) {
+		err = zfs_prefetch_target(argv[i], recurse, &cb, dirs);
+		if (err)
+			ret = err;
+	}
+	nvpair_t *dir;
+	while ((dir = nvlist_next_nvpair(dirs, NULL)) != NULL) {
+		err = zfs_prefetch_dir(nvpair_name(dir),
+		    fnvpair_value_uint64(dir), &cb, dirs);
+		if (err)
+			ret = err;
+		fnvlist_remove_nvpair(dirs, dir);
+	}
+	fnvlist_free(dirs);
+
+	return (ret != 0);
+}
+
 static int
 zfs_do_wait(int argc, char **argv)
 {
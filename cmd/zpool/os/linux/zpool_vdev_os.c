@@ -387,6 +387,41 @@ check_disk(const char *path, blkid_cache cache, int force,
 	return (err);
 }
 
+static char *zpool_sysfs_gets(char *path);
+
+/*
+ * Host-managed zoned devices (SMR drives, ZNS SSDs) only accept writes at
+ * the write pointer of each zone, which the allocator does not honor.
+ * The model is reported by the whole disk, so look at the parent of a
+ * partition.
+ */
+static boolean_t
+is_host_managed(const char *path)
+{
+	char *devpath, *model;
+	char sysfs[MAXPATHLEN];
+	boolean_t ret = B_FALSE;
+
+	if ((devpath = realpath(path, NULL)) == NULL)
+		return (B_FALSE);
+
+	(void) snprintf(sysfs, sizeof (sysfs),
+	    "/sys/class/block/%s/queue/zoned", zfs_basename(devpath));
+	if ((model = zpool_sysfs_gets(sysfs)) == NULL) {
+		(void) snprintf(sysfs, sizeof (sysfs),
+		    "/sys/class/block/%s/../queue/zoned",
+		    zfs_basename(devpath));
+		model = zpool_sysfs_gets(sysfs);
+	}
+	if (model != NULL) {
+		ret = (strcmp(model, "host-managed") == 0);
+		free(model);
+	}
+	free(devpath);
+
+	return (ret);
+}
+
 int
 check_device(const char *path, boolean_t force,
     boolean_t isspare, boolean_t iswholedisk)
@@ -394,6 +429,12 @@ check_device(const char *path, boolean_t force,
 	blkid_cache cache;
 	int error;
 
+	if (is_host_managed(path)) {
+		vdev_error(gettext("%s is a host-managed zoned device, "
+		    "which is not supported\n"), path);
+		return (-1);
+	}
+
 	error = blkid_get_cache(&cache, NULL);
 	if (error != 0) {
 		(void) fprintf(stderr, gettext("unable to access the blkid "
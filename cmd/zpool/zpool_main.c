@@ -513,8 +513,8 @@ get_usage(zpool_help_t idx)
 		return (gettext("\tinitialize [-c | -s | -u] [-w] <pool> "
 		    "[<device> ...]\n"));
 	case HELP_SCRUB:
-		return (gettext("\tscrub [-e | -s | -p | -C] [-w] "
-		    "<pool> ...\n"));
+		return (gettext("\tscrub [-e | -s | -p | -C | -S txg|date] "
+		    "[-w] <pool> ...\n"));
 	case HELP_RESILVER:
 		return (gettext("\tresilver <pool> ...\n"));
 	case HELP_TRIM:
@@ -8368,6 +8368,8 @@ zpool_do_reopen(int argc, char **argv)
 typedef struct scrub_cbdata {
 	int	cb_type;
 	pool_scrub_cmd_t cb_scrub_cmd;
+	uint64_t cb_txg_start;
+	time_t	cb_date_start;
 } scrub_cbdata_t;
 
 static boolean_t
@@ -8396,10 +8398,50 @@ zpool_has_checkpoint(zpool_handle_t *zhp)
 	return (B_FALSE);
 }
 
+/*
+ * Find a txg that is no later than the first txg written at or after the
+ * given time, from the txgs and times of the internal pool history records.
+ * Any block written since then is born after the returned txg.
+ */
+static int
+scrub_txg_at_date(zpool_handle_t *zhp, time_t date, uint64_t *txgp)
+{
+	uint64_t off = 0;
+	boolean_t eof = B_FALSE;
+	int err;
+
+	*txgp = 0;
+	while (!eof) {
+		nvlist_t *nvhis, **records;
+		uint_t numrecords;
+
+		if ((err = zpool_get_history(zhp, &nvhis, &off, &eof)) != 0)
+			return (err);
+
+		verify(nvlist_lookup_nvlist_array(nvhis, ZPOOL_HIST_RECORD,
+		    &records, &numrecords) == 0);
+		for (uint_t i = 0; i < numrecords; i++) {
+			uint64_t txg, tm;
+
+			if (nvlist_lookup_uint64(records[i], ZPOOL_HIST_TXG,
+			    &txg) != 0 ||
+			    nvlist_lookup_uint64(records[i], ZPOOL_HIST_TIME,
+			    &tm) != 0)
+				continue;
+			if (tm <= date && txg > *txgp)
+				*txgp = txg;
+		}
+		nvlist_free(nvhis);
+	}
+
+	return (0);
+}
+
 static int
 scrub_callback(zpool_handle_t *zhp, void *data)
 {
 	scrub_cbdata_t *cb = data;
+	uint64_t txgstart = cb->cb_txg_start;
 	int err;
 
 	/*
@@ -8411,7 +8453,17 @@ scrub_callback(zpool_handle_t *zhp, void *data)
 		return (1);
 	}
 
-	err = zpool_scan(zhp, cb->cb_type, cb->cb_scrub_cmd);
+	if (cb->cb_date_start != 0) {
+		err = scrub_txg_at_date(zhp, cb->cb_date_start, &txgstart);
+		if (err != 0)
+			return (1);
+	}
+
+	/* The kernel scrubs the blocks born after txgstart. */
+	if (txgstart != 0)
+		txgstart--;
+
+	err = zpool_scan_range(zhp, cb->cb_type, cb->cb_scrub_cmd, txgstart);
 
 	if (err == 0 && zpool_has_checkpoint(zhp) &&
 	    cb->cb_type == POOL_SCAN_SCRUB) {
@@ -8431,13 +8483,50 @@ wait_callback(zpool_handle_t *zhp, void *data)
 }
 
 /*
- * zpool scrub [-e | -s | -p | -C] [-w] <pool> ...
+ * Parse the argument of "zpool scrub -S", either a txg number or a local
+ * date as "YYYY-MM-DD[ HH:MM[:SS]]".
+ */
+static int
+scrub_parse_since(const char *arg, scrub_cbdata_t *cb)
+{
+	static const char *const formats[] = {
+		"%Y-%m-%d %H:%M:%S",
+		"%Y-%m-%d %H:%M",
+		"%Y-%m-%d",
+	};
+	char *end;
+
+	errno = 0;
+	cb->cb_txg_start = strtoull(arg, &end, 10);
+	if (*arg != '\0' && *end == '\0' && errno == 0) {
+		cb->cb_date_start = 0;
+		return (0);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(formats); i++) {
+		struct tm tm = { 0 };
+
+		end = strptime(arg, formats[i], &tm);
+		if (end == NULL || *end != '\0')
+			continue;
+		tm.tm_isdst = -1;
+		cb->cb_date_start = mktime(&tm);
+		cb->cb_txg_start = 0;
+		return (cb->cb_date_start == (time_t)-1 ? -1 : 0);
+	}
+
+	return (-1);
+}
+
+/*
+ * zpool scrub [-e | -s | -p | -C | -S txg|date] [-w] <pool> ...
  *
  *	-e	Only scrub blocks in the error log.
  *	-s	Stop.  Stops any in-progress scrub.
  *	-p	Pause. Pause in-progress scrub.
  *	-w	Wait.  Blocks until scrub has completed.
  *	-C	Scrub from last saved txg.
+ *	-S	Only scrub blocks written since the given txg or date.
  */
 int
 zpool_do_scrub(int argc, char **argv)
@@ -8449,14 +8538,17 @@ zpool_do_scrub(int argc, char **argv)
 
 	cb.cb_type = POOL_SCAN_SCRUB;
 	cb.cb_scrub_cmd = POOL_SCRUB_NORMAL;
+	cb.cb_txg_start = 0;
+	cb.cb_date_start = 0;
 
 	boolean_t is_error_scrub = B_FALSE;
 	boolean_t is_pause = B_FALSE;
 	boolean_t is_stop = B_FALSE;
 	boolean_t is_txg_continue = B_FALSE;
+	boolean_t is_since = B_FALSE;
 
 	/* check options */
-	while ((c = getopt(argc, argv, "spweC")) != -1) {
+	while ((c = getopt(argc, argv, "spweCS:")) != -1) {
 		switch (c) {
 		case 'e':
 			is_error_scrub = B_TRUE;
@@ -8473,6 +8565,14 @@ zpool_do_scrub(int argc, char **argv)
 		case 'C':
 			is_txg_continue = B_TRUE;
 			break;
+		case 'S':
+			is_since = B_TRUE;
+			if (scrub_parse_since(optarg, &cb) != 0) {
+				(void) fprintf(stderr, gettext("invalid txg or "
+				    "date '%s'\n"), optarg);
+				usage(B_FALSE);
+			}
+			break;
 		case '?':
 			(void) fprintf(stderr, gettext("invalid option '%c'\n"),
 			    optopt);
@@ -8496,6 +8596,11 @@ zpool_do_scrub(int argc, char **argv)
 		(void) fprintf(stderr, gettext("invalid option "
 		    "combination: -e and -C are mutually exclusive\n"));
 		usage(B_FALSE);
+	} else if (is_since &&
+	    (is_error_scrub || is_pause || is_stop || is_txg_continue)) {
+		(void) fprintf(stderr, gettext("invalid option "
+		    "combination: -S cannot be used with -e, -p, -s or -C\n"));
+		usage(B_FALSE);
 	} else {
 		if (is_error_scrub)
 			cb.cb_type = POOL_SCAN_ERRORSCRUB;
@@ -8551,6 +8656,8 @@ zpool_do_resilver(int argc, char **argv)
 
 	cb.cb_type = POOL_SCAN_RESILVER;
 	cb.cb_scrub_cmd = POOL_SCRUB_NORMAL;
+	cb.cb_txg_start = 0;
+	cb.cb_date_start = 0;
 
 	/* check options */
 	while ((c = getopt(argc, argv, "")) != -1) {
@@ -9713,6 +9820,14 @@ raidz_expand_status_nvlist(zpool_handle_t *zhp, status_cbdata_t *cb,
 		nice_num_str_nvlist(nv, "waiting_for_resilver",
 		    pres->pres_waiting_for_resilver, B_TRUE,
 		    cb->cb_json_as_int, ZFS_NICENUM_1024);
+		if (c >= sizeof (*pres) / sizeof (uint64_t)) {
+			nice_num_str_nvlist(nv, "pass_start_time",
+			    pres->pres_pass_start, cb->cb_literal,
+			    cb->cb_json_as_int, ZFS_NICE_TIMESTAMP);
+			nice_num_str_nvlist(nv, "pass_reflowed",
+			    pres->pres_pass_reflowed, cb->cb_literal,
+			    cb->cb_json_as_int, ZFS_NICENUM_BYTES);
+		}
 		fnvlist_add_nvlist(item, ZPOOL_CONFIG_RAIDZ_EXPAND_STATS, nv);
 		fnvlist_free(nv);
 		free(name);
@@ -10113,7 +10228,8 @@ print_removal_status(zpool_handle_t *zhp, pool_removal_stat_t *prs)
  * Print out detailed raidz expansion status.
  */
 static void
-print_raidz_expand_status(zpool_handle_t *zhp, pool_raidz_expand_stat_t *pres)
+print_raidz_expand_status(zpool_handle_t *zhp, pool_raidz_expand_stat_t *pres,
+    uint_t c)
 {
 	char copied_buf[7];
 
@@ -10168,10 +10284,20 @@ print_raidz_expand_status(zpool_handle_t *zhp, pool_raidz_expand_stat_t *pres)
 		total = pres->pres_to_reflow;
 		fraction_done = (double)copied / total;
 
-		/* elapsed time for this pass */
-		elapsed = time(NULL) - pres->pres_start_time;
+		/*
+		 * Base the rate on the current pass when the kernel reports
+		 * it, so that time spent paused or exported is not counted.
+		 */
+		if (c >= sizeof (*pres) / sizeof (uint64_t) &&
+		    pres->pres_pass_start != 0) {
+			elapsed = time(NULL) - pres->pres_pass_start;
+			rate = pres->pres_pass_reflowed;
+		} else {
+			elapsed = time(NULL) - pres->pres_start_time;
+			rate = copied;
+		}
 		elapsed = elapsed > 0 ? elapsed : 1;
-		rate = copied / elapsed;
+		rate = rate / elapsed;
 		rate = rate > 0 ? rate : 1;
 		secs_left = (total - copied) / rate;
 
@@ -10906,7 +11032,7 @@ status_callback(zpool_handle_t *zhp, void *data)
 		pool_raidz_expand_stat_t *pres = NULL;
 		(void) nvlist_lookup_uint64_array(nvroot,
 		    ZPOOL_CONFIG_RAIDZ_EXPAND_STATS, (uint64_t **)&pres, &c);
-		print_raidz_expand_status(zhp, pres);
+		print_raidz_expand_status(zhp, pres, c);
 
 		cbp->cb_namewidth = max_width(zhp, nvroot, 0, 0,
 		    cbp->cb_name_flags | VDEV_NAME_TYPE_ID);
@@ -67,11 +67,13 @@
  *
  * CDDL HEADER END
  */
+#include <errno.h>
 #include <string.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <time.h>
 #include <libzfs.h>
 
 #define	POOL_MEASUREMENT	"zpool_stats"
@@ -82,6 +84,7 @@
 #define	MIN_LAT_INDEX	10  /* minimum latency index 10 = 1024ns */
 #define	POOL_IO_SIZE_MEASUREMENT	"zpool_io_size"
 #define	MIN_SIZE_INDEX	9  /* minimum size index 9 = 512 bytes */
+#define	RESCAN_INTERVAL	60 /* seconds between pool rescans in interval mode */
 
 /* global options */
 int execd_mode = 0;
@@ -91,7 +94,10 @@ char metric_data_type = 'u';
 uint64_t metric_value_mask = UINT64_MAX;
 uint64_t timestamp = 0;
 int complained_about_sync = 0;
+int changed_only = 0;
+double interval = 0;
 const char *tags = "";
+nvlist_t *vdev_cache = NULL;
 
 typedef int (*stat_printer_f)(nvlist_t *, const char *, const char *);
 
@@ -666,6 +672,78 @@ print_top_level_vdev_stats(nvlist_t *nvroot, const char *pool_name)
 	return (0);
 }
 
+/*
+ * In changed-only mode, a vdev is printed only when one of its activity
+ * counters moved since the previous sample. The counters of each vdev are
+ * cached by pool name and guid, and the cache is updated once per sample
+ * before any of the printers walk the tree.
+ */
+static void
+update_vdev_cache(nvlist_t *nvroot, const char *pool_name)
+{
+	uint_t c, children;
+	nvlist_t **child;
+	nvlist_t *prev;
+	vdev_stat_t *vs;
+	uint64_t guid, *old;
+	char key[ZFS_MAX_DATASET_NAME_LEN * 2 + 24];
+
+	if (nvlist_lookup_uint64(nvroot, ZPOOL_CONFIG_GUID, &guid) != 0 ||
+	    nvlist_lookup_uint64_array(nvroot, ZPOOL_CONFIG_VDEV_STATS,
+	    (uint64_t **)&vs, &c) != 0)
+		return;
+
+	uint64_t counters[] = {
+		vs->vs_state, vs->vs_aux, vs->vs_alloc, vs->vs_space,
+		vs->vs_ops[ZIO_TYPE_READ], vs->vs_ops[ZIO_TYPE_WRITE],
+		vs->vs_bytes[ZIO_TYPE_READ], vs->vs_bytes[ZIO_TYPE_WRITE],
+		vs->vs_read_errors, vs->vs_write_errors,
+		vs->vs_checksum_errors, vs->vs_fragmentation
+	};
+	uint_t ncounters = sizeof (counters) / sizeof (counters[0]);
+	boolean_t changed = B_TRUE;
+
+	(void) snprintf(key, sizeof (key), "%s/%llu", pool_name,
+	    (u_longlong_t)guid);
+	if (nvlist_lookup_nvlist(vdev_cache, key, &prev) == 0 &&
+	    nvlist_lookup_uint64_array(prev, "counters", &old, &c) == 0 &&
+	    c == ncounters &&
+	    memcmp(old, counters, sizeof (counters)) == 0)
+		changed = B_FALSE;
+
+	nvlist_t *entry = fnvlist_alloc();
+	fnvlist_add_uint64_array(entry, "counters", counters, ncounters);
+	fnvlist_add_boolean_value(entry, "changed", changed);
+	fnvlist_add_nvlist(vdev_cache, key, entry);
+	fnvlist_free(entry);
+
+	if (nvlist_lookup_nvlist_array(nvroot, ZPOOL_CONFIG_CHILDREN,
+	    &child, &children) == 0) {
+		for (c = 0; c < children; c++)
+			update_vdev_cache(child[c], pool_name);
+	}
+}
+
+static boolean_t
+vdev_changed(nvlist_t *nvroot, const char *pool_name)
+{
+	nvlist_t *entry;
+	uint64_t guid;
+	boolean_t changed;
+	char key[ZFS_MAX_DATASET_NAME_LEN * 2 + 24];
+
+	if (vdev_cache == NULL ||
+	    nvlist_lookup_uint64(nvroot, ZPOOL_CONFIG_GUID, &guid) != 0)
+		return (B_TRUE);
+
+	(void) snprintf(key, sizeof (key), "%s/%llu", pool_name,
+	    (u_longlong_t)guid);
+	if (nvlist_lookup_nvlist(vdev_cache, key, &entry) != 0 ||
+	    nvlist_lookup_boolean_value(entry, "changed", &changed) != 0)
+		return (B_TRUE);
+	return (changed);
+}
+
 /*
  * recursive stats printer
  */
@@ -678,9 +756,11 @@ print_recursive_stats(stat_printer_f func, nvlist_t *nvroot,
 	char vdev_name[256];
 	int err;
 
-	err = func(nvroot, pool_name, parent_name);
-	if (err)
-		return (err);
+	if (vdev_changed(nvroot, pool_name)) {
+		err = func(nvroot, pool_name, parent_name);
+		if (err)
+			return (err);
+	}
 
 	if (descend && nvlist_lookup_nvlist_array(nvroot, ZPOOL_CONFIG_CHILDREN,
 	    &child, &children) == 0) {
@@ -698,33 +778,26 @@ print_recursive_stats(stat_printer_f func, nvlist_t *nvroot,
 }
 
 /*
- * call-back to print the stats from the pool config
+ * print the stats from the pool config
  *
  * Note: if the pool is broken, this can hang indefinitely and perhaps in an
  * unkillable state.
  */
 static int
-print_stats(zpool_handle_t *zhp, void *data)
+print_pool_stats(zpool_handle_t *zhp, boolean_t *missing)
 {
 	uint_t c;
 	int err;
-	boolean_t missing;
 	nvlist_t *config, *nvroot;
 	vdev_stat_t *vs;
 	struct timespec tv;
 	char *pool_name;
 
-	/* if not this pool return quickly */
-	if (data &&
-	    strncmp(data, zpool_get_name(zhp), ZFS_MAX_DATASET_NAME_LEN) != 0) {
-		zpool_close(zhp);
-		return (0);
-	}
-
-	if (zpool_refresh_stats(zhp, &missing) != 0) {
-		zpool_close(zhp);
+	*missing = B_FALSE;
+	if (zpool_refresh_stats(zhp, missing) != 0)
 		return (1);
-	}
+	if (*missing)
+		return (0);
 
 	config = zpool_get_config(zhp, NULL);
 	if (clock_gettime(CLOCK_REALTIME, &tv) != 0)
@@ -735,16 +808,16 @@ print_stats(zpool_handle_t *zhp, void *data)
 
 	if (nvlist_lookup_nvlist(
 	    config, ZPOOL_CONFIG_VDEV_TREE, &nvroot) != 0) {
-	zpool_close(zhp);
 		return (2);
 	}
 	if (nvlist_lookup_uint64_array(nvroot, ZPOOL_CONFIG_VDEV_STATS,
 	    (uint64_t **)&vs, &c) != 0) {
-	zpool_close(zhp);
 		return (3);
 	}
 
 	pool_name = escape_string(zpool_get_name(zhp));
+	if (vdev_cache != NULL)
+		update_vdev_cache(nvroot, pool_name);
 	err = print_recursive_stats(print_summary_stats, nvroot,
 	    pool_name, NULL, 1);
 	/* if any of these return an error, skip the rest */
@@ -766,15 +839,141 @@ print_stats(zpool_handle_t *zhp, void *data)
 		err = print_scan_status(nvroot, pool_name);
 
 	free(pool_name);
+	return (err);
+}
+
+/*
+ * call-back to print the stats of each pool
+ */
+static int
+print_stats(zpool_handle_t *zhp, void *data)
+{
+	boolean_t missing;
+	int err;
+
+	/* if not this pool return quickly */
+	if (data &&
+	    strncmp(data, zpool_get_name(zhp), ZFS_MAX_DATASET_NAME_LEN) != 0) {
+		zpool_close(zhp);
+		return (0);
+	}
+
+	err = print_pool_stats(zhp, &missing);
 	zpool_close(zhp);
 	return (err);
 }
 
+/*
+ * Interval mode keeps the libzfs and pool handles open between samples,
+ * so that each sample costs a single stats refresh per pool rather than
+ * a full pool iteration and config load.
+ */
+typedef struct pool_list {
+	const char *pl_filter;
+	zpool_handle_t **pl_handles;
+	int pl_count;
+	int pl_alloc;
+} pool_list_t;
+
+static int
+collect_pool(zpool_handle_t *zhp, void *data)
+{
+	pool_list_t *pl = data;
+
+	if (pl->pl_filter != NULL && strncmp(pl->pl_filter,
+	    zpool_get_name(zhp), ZFS_MAX_DATASET_NAME_LEN) != 0) {
+		zpool_close(zhp);
+		return (0);
+	}
+	if (pl->pl_count == pl->pl_alloc) {
+		int alloc = pl->pl_alloc == 0 ? 8 : pl->pl_alloc * 2;
+		zpool_handle_t **handles = realloc(pl->pl_handles,
+		    alloc * sizeof (zpool_handle_t *));
+		if (handles == NULL) {
+			fprintf(stderr, "error: cannot allocate memory\n");
+			exit(1);
+		}
+		pl->pl_handles = handles;
+		pl->pl_alloc = alloc;
+	}
+	pl->pl_handles[pl->pl_count++] = zhp;
+	return (0);
+}
+
+static void
+release_pools(pool_list_t *pl)
+{
+	for (int i = 0; i < pl->pl_count; i++)
+		zpool_close(pl->pl_handles[i]);
+	pl->pl_count = 0;
+}
+
+static int
+print_stats_interval(libzfs_handle_t *g_zfs, const char *filter)
+{
+	pool_list_t pl = { .pl_filter = filter };
+	struct timespec next, now;
+	uint64_t interval_ns = (uint64_t)(interval * 1000000000);
+	uint64_t rescan = 0;
+	boolean_t missing;
+	int err = 0;
+
+	if (changed_only)
+		vdev_cache = fnvlist_alloc();
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &next);
+	for (;;) {
+		/* pick up imported pools and drop exported ones */
+		if (rescan == 0) {
+			release_pools(&pl);
+			if (vdev_cache != NULL) {
+				fnvlist_free(vdev_cache);
+				vdev_cache = fnvlist_alloc();
+			}
+			(void) zpool_iter(g_zfs, collect_pool, &pl);
+			rescan = MAX(RESCAN_INTERVAL * 1000000000ULL /
+			    interval_ns, 1);
+		}
+		rescan--;
+
+		for (int i = 0; i < pl.pl_count; i++) {
+			err = print_pool_stats(pl.pl_handles[i], &missing);
+			if (missing)
+				rescan = 0;
+		}
+		if (fflush(stdout) != 0)
+			break;
+
+		/* sleep until the next deadline, so the samples do not drift */
+		next.tv_sec += interval_ns / 1000000000;
+		next.tv_nsec += interval_ns % 1000000000;
+		if (next.tv_nsec >= 1000000000) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000;
+		}
+		(void) clock_gettime(CLOCK_MONOTONIC, &now);
+		if (now.tv_sec > next.tv_sec || (now.tv_sec == next.tv_sec &&
+		    now.tv_nsec >= next.tv_nsec)) {
+			/* the sample overran the interval, skip ahead */
+			next = now;
+			continue;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+		    &next, NULL) == EINTR)
+			;
+	}
+
+	release_pools(&pl);
+	free(pl.pl_handles);
+	return (err);
+}
+
 static void
 usage(char *name)
 {
 	fprintf(stderr, "usage: %s [--execd][--no-histograms]"
-	    "[--sum-histogram-buckets] [--signed-int] [poolname]\n", name);
+	    "[--sum-histogram-buckets] [--signed-int]\n"
+	    "\t[--interval seconds [--changed-only]] [poolname]\n", name);
 	exit(EXIT_FAILURE);
 }
 
@@ -785,9 +984,12 @@ main(int argc, char *argv[])
 	int ret = 8;
 	char *line = NULL, *ttags = NULL;
 	size_t len, tagslen = 0;
+	char *end;
 	struct option long_options[] = {
+	    {"changed-only", no_argument, NULL, 'c'},
 	    {"execd", no_argument, NULL, 'e'},
 	    {"help", no_argument, NULL, 'h'},
+	    {"interval", required_argument, NULL, 'l'},
 	    {"no-histograms", no_argument, NULL, 'n'},
 	    {"signed-int", no_argument, NULL, 'i'},
 	    {"sum-histogram-buckets", no_argument, NULL, 's'},
@@ -795,8 +997,11 @@ main(int argc, char *argv[])
 	    {0, 0, 0, 0}
 	};
 	while ((opt = getopt_long(
-	    argc, argv, "ehinst:", long_options, NULL)) != -1) {
+	    argc, argv, "cehil:nst:", long_options, NULL)) != -1) {
 		switch (opt) {
+		case 'c':
+			changed_only = 1;
+			break;
 		case 'e':
 			execd_mode = 1;
 			break;
@@ -804,6 +1009,15 @@ main(int argc, char *argv[])
 			metric_data_type = 'i';
 			metric_value_mask = INT64_MAX;
 			break;
+		case 'l':
+			interval = strtod(optarg, &end);
+			if (*end != '\0' || interval < 0.001 ||
+			    interval > 86400) {
+				fprintf(stderr, "error: invalid interval "
+				    "'%s'\n", optarg);
+				exit(1);
+			}
+			break;
 		case 'n':
 			no_histograms = 1;
 			break;
@@ -827,6 +1041,8 @@ main(int argc, char *argv[])
 			usage(argv[0]);
 		}
 	}
+	if ((changed_only && interval == 0) || (execd_mode && interval != 0))
+		usage(argv[0]);
 
 	libzfs_handle_t *g_zfs;
 	if ((g_zfs = libzfs_init()) == NULL) {
@@ -835,6 +1051,8 @@ main(int argc, char *argv[])
 		    "Is the zfs module loaded or zrepl running?\n");
 		exit(EXIT_FAILURE);
 	}
+	if (interval != 0)
+		return (print_stats_interval(g_zfs, argv[optind]));
 	if (execd_mode == 0) {
 		ret = zpool_iter(g_zfs, print_stats, argv[optind]);
 		return (ret);
@@ -21,10 +21,35 @@
 #ifndef	_ZSTREAM_H
 #define	_ZSTREAM_H
 
+#include <sys/zfs_ioctl.h>
+
 #ifdef	__cplusplus
 extern "C" {
 #endif
 
+typedef struct zstream_record {
+	dmu_replay_record_t	zr_drr;
+	char			*zr_buf;	/* payload buffer */
+	uint64_t		zr_bufsz;	/* allocated size of zr_buf */
+	uint64_t		zr_payload_size;
+	void			*zr_private;	/* for the work function */
+} zstream_record_t;
+
+typedef struct zstream_pipeline zstream_pipeline_t;
+typedef void (zstream_work_func_t)(zstream_record_t *, void *);
+
+extern zstream_pipeline_t *zstream_pipeline_create(int, zstream_work_func_t *,
+    void *, int);
+extern zstream_record_t *zstream_pipeline_get(zstream_pipeline_t *);
+extern void zstream_pipeline_submit(zstream_pipeline_t *, zstream_record_t *,
+    boolean_t);
+extern int zstream_pipeline_error(zstream_pipeline_t *);
+extern void zstream_pipeline_destroy(zstream_pipeline_t *);
+extern void zstream_record_read(zstream_record_t *, uint64_t, FILE *);
+extern void zstream_record_set_payload(zstream_record_t *, char *, uint64_t,
+    uint64_t);
+extern int zstream_default_threads(void);
+
 extern void *safe_calloc(size_t n);
 extern int sfread(void *buf, size_t size, FILE *fp);
 extern void *safe_malloc(size_t size);
@@ -38,45 +38,76 @@
 #include "zfs_fletcher.h"
 #include "zstream.h"
 
-static int
-dump_record(dmu_replay_record_t *drr, void *payload, int payload_len,
-    zio_cksum_t *zc, int outfd)
+/*
+ * Decompress the payload of one WRITE record with the compression type
+ * stashed in zr_private.  Called from the pipeline's worker threads.
+ */
+static void
+decompress_write(zstream_record_t *zr, void *arg)
 {
-	assert(offsetof(dmu_replay_record_t, drr_u.drr_checksum.drr_checksum)
-	    == sizeof (dmu_replay_record_t) - sizeof (zio_cksum_t));
-	fletcher_4_incremental_native(drr,
-	    offsetof(dmu_replay_record_t, drr_u.drr_checksum.drr_checksum), zc);
-	if (drr->drr_type != DRR_BEGIN) {
-		assert(ZIO_CHECKSUM_IS_ZERO(&drr->drr_u.
-		    drr_checksum.drr_checksum));
-		drr->drr_u.drr_checksum.drr_checksum = *zc;
-	}
-	fletcher_4_incremental_native(&drr->drr_u.drr_checksum.drr_checksum,
-	    sizeof (zio_cksum_t), zc);
-	if (write(outfd, drr, sizeof (*drr)) == -1)
-		return (errno);
-	if (payload_len != 0) {
-		fletcher_4_incremental_native(payload, payload_len, zc);
-		if (write(outfd, payload, payload_len) == -1)
-			return (errno);
+	boolean_t verbose = *(boolean_t *)arg;
+	struct drr_write *drrw = &zr->zr_drr.drr_u.drr_write;
+	enum zio_compress c = (enum zio_compress)(intptr_t)zr->zr_private;
+	uint64_t payload_size = zr->zr_payload_size;
+	uint64_t lsize = drrw->drr_logical_size;
+	ASSERT3U(payload_size, <=, lsize);
+
+	char *buf = safe_calloc(lsize);
+	abd_t sabd, dabd;
+	abd_get_from_buf_struct(&sabd, zr->zr_buf, payload_size);
+	abd_get_from_buf_struct(&dabd, buf, lsize);
+	int err = zio_decompress_data(c, &sabd, &dabd,
+	    payload_size, lsize, NULL);
+	abd_free(&dabd);
+	abd_free(&sabd);
+
+	if (err == 0) {
+		drrw->drr_compressiontype = 0;
+		drrw->drr_compressed_size = 0;
+		zstream_record_set_payload(zr, buf, lsize, lsize);
+		if (verbose) {
+			fprintf(stderr,
+			    "successfully decompressed "
+			    "ino %llu offset %llu\n",
+			    (u_longlong_t)drrw->drr_object,
+			    (u_longlong_t)drrw->drr_offset);
+		}
+	} else {
+		/*
+		 * The block must not be compressed, at least
+		 * not with this compression type, possibly
+		 * because it gets written multiple times in
+		 * this stream.
+		 */
+		warnx("decompression failed for "
+		    "ino %llu offset %llu",
+		    (u_longlong_t)drrw->drr_object,
+		    (u_longlong_t)drrw->drr_offset);
+		free(buf);
 	}
-	return (0);
 }
 
 int
 zstream_do_decompress(int argc, char *argv[])
 {
 	const int KEYSIZE = 64;
-	int bufsz = SPA_MAXBLOCKSIZE;
-	char *buf = safe_malloc(bufsz);
 	dmu_replay_record_t thedrr;
-	dmu_replay_record_t *drr = &thedrr;
-	zio_cksum_t stream_cksum;
+	dmu_replay_record_t *drr;
 	int c;
 	boolean_t verbose = B_FALSE;
+	int nthreads = zstream_default_threads();
 
-	while ((c = getopt(argc, argv, "v")) != -1) {
+	while ((c = getopt(argc, argv, "j:v")) != -1) {
 		switch (c) {
+		case 'j':
+			if (sscanf(optarg, "%d", &nthreads) != 1 ||
+			    nthreads < 1) {
+				fprintf(stderr,
+				    "failed to parse thread count '%s'\n",
+				    optarg);
+				zstream_usage();
+			}
+			break;
 		case 'v':
 			verbose = B_TRUE;
 			break;
@@ -161,24 +192,27 @@ zstream_do_decompress(int argc, char *argv[])
 	}
 
 	fletcher_4_init();
+	zstream_pipeline_t *zp = zstream_pipeline_create(nthreads,
+	    decompress_write, &verbose, STDOUT_FILENO);
 	int begin = 0;
 	boolean_t seen = B_FALSE;
-	while (sfread(drr, sizeof (*drr), stdin) != 0) {
+	while (sfread(&thedrr, sizeof (thedrr), stdin) != 0) {
 		struct drr_write *drrw;
-		uint64_t payload_size = 0;
+		boolean_t work = B_FALSE;
 
 		/*
-		 * We need to regenerate the checksum.
+		 * Stop reading once the output can no longer be written.
 		 */
-		if (drr->drr_type != DRR_BEGIN) {
-			memset(&drr->drr_u.drr_checksum.drr_checksum, 0,
-			    sizeof (drr->drr_u.drr_checksum.drr_checksum));
-		}
+		if (zstream_pipeline_error(zp) != 0)
+			break;
+
+		zstream_record_t *zr = zstream_pipeline_get(zp);
+		zr->zr_drr = thedrr;
+		drr = &zr->zr_drr;
 
 		switch (drr->drr_type) {
 		case DRR_BEGIN:
 		{
-			ZIO_SET_CHECKSUM(&stream_cksum, 0, 0, 0, 0);
 			VERIFY0(begin++);
 			seen = B_TRUE;
 
@@ -186,21 +220,10 @@ zstream_do_decompress(int argc, char *argv[])
 
 			VERIFY3U(sz, <=, 1U << 28);
 
-			if (sz != 0) {
-				if (sz > bufsz) {
-					buf = realloc(buf, sz);
-					if (buf == NULL)
-						err(1, "realloc");
-					bufsz = sz;
-				}
-				(void) sfread(buf, sz, stdin);
-			}
-			payload_size = sz;
+			zstream_record_read(zr, sz, stdin);
 			break;
 		}
 		case DRR_END:
-		{
-			struct drr_end *drre = &drr->drr_u.drr_end;
 			/*
 			 * We would prefer to just check --begin == 0, but
 			 * replication streams have an end of stream END
@@ -208,15 +231,7 @@ zstream_do_decompress(int argc, char *argv[])
 			 */
 			VERIFY3B(seen, ==, B_TRUE);
 			begin--;
-			/*
-			 * Use the recalculated checksum, unless this is
-			 * the END record of a stream package, which has
-			 * no checksum.
-			 */
-			if (!ZIO_CHECKSUM_IS_ZERO(&drre->drr_checksum))
-				drre->drr_checksum = stream_cksum;
 			break;
-		}
 
 		case DRR_OBJECT:
 		{
@@ -224,8 +239,8 @@ zstream_do_decompress(int argc, char *argv[])
 			VERIFY3S(begin, ==, 1);
 
 			if (drro->drr_bonuslen > 0) {
-				payload_size = DRR_OBJECT_PAYLOAD_SIZE(drro);
-				(void) sfread(buf, payload_size, stdin);
+				zstream_record_read(zr,
+				    DRR_OBJECT_PAYLOAD_SIZE(drro), stdin);
 			}
 			break;
 		}
@@ -234,8 +249,8 @@ zstream_do_decompress(int argc, char *argv[])
 		{
 			struct drr_spill *drrs = &drr->drr_u.drr_spill;
 			VERIFY3S(begin, ==, 1);
-			payload_size = DRR_SPILL_PAYLOAD_SIZE(drrs);
-			(void) sfread(buf, payload_size, stdin);
+			zstream_record_read(zr, DRR_SPILL_PAYLOAD_SIZE(drrs),
+			    stdin);
 			break;
 		}
 
@@ -249,8 +264,9 @@ zstream_do_decompress(int argc, char *argv[])
 		case DRR_WRITE:
 		{
 			VERIFY3S(begin, ==, 1);
-			drrw = &thedrr.drr_u.drr_write;
-			payload_size = DRR_WRITE_PAYLOAD_SIZE(drrw);
+			drrw = &drr->drr_u.drr_write;
+			zstream_record_read(zr, DRR_WRITE_PAYLOAD_SIZE(drrw),
+			    stdin);
 			ENTRY *p;
 			char key[KEYSIZE];
 
@@ -259,23 +275,19 @@ zstream_do_decompress(int argc, char *argv[])
 			    (u_longlong_t)drrw->drr_offset);
 			ENTRY e = {.key = key};
 
+			/*
+			 * Look the record up here rather than in the
+			 * workers, since hsearch() is not thread-safe.
+			 * Unlisted records are passed through unaltered.
+			 */
 			p = hsearch(e, FIND);
-			if (p == NULL) {
-				/*
-				 * Read the contents of the block unaltered
-				 */
-				(void) sfread(buf, payload_size, stdin);
+			if (p == NULL)
 				break;
-			}
 
-			/*
-			 * Read and decompress the block
-			 */
 			enum zio_compress c =
 			    (enum zio_compress)(intptr_t)p->data;
 
 			if (c == ZIO_COMPRESS_OFF) {
-				(void) sfread(buf, payload_size, stdin);
 				drrw->drr_compressiontype = 0;
 				drrw->drr_compressed_size = 0;
 				if (verbose)
@@ -287,46 +299,9 @@ zstream_do_decompress(int argc, char *argv[])
 				break;
 			}
 
-			uint64_t lsize = drrw->drr_logical_size;
-			ASSERT3U(payload_size, <=, lsize);
-
-			char *lzbuf = safe_calloc(payload_size);
-			(void) sfread(lzbuf, payload_size, stdin);
-
-			abd_t sabd, dabd;
-			abd_get_from_buf_struct(&sabd, lzbuf, payload_size);
-			abd_get_from_buf_struct(&dabd, buf, lsize);
-			int err = zio_decompress_data(c, &sabd, &dabd,
-			    payload_size, lsize, NULL);
-			abd_free(&dabd);
-			abd_free(&sabd);
-
-			if (err == 0) {
-				drrw->drr_compressiontype = 0;
-				drrw->drr_compressed_size = 0;
-				payload_size = lsize;
-				if (verbose) {
-					fprintf(stderr,
-					    "successfully decompressed "
-					    "ino %llu offset %llu\n",
-					    (u_longlong_t)drrw->drr_object,
-					    (u_longlong_t)drrw->drr_offset);
-				}
-			} else {
-				/*
-				 * The block must not be compressed, at least
-				 * not with this compression type, possibly
-				 * because it gets written multiple times in
-				 * this stream.
-				 */
-				warnx("decompression failed for "
-				    "ino %llu offset %llu",
-				    (u_longlong_t)drrw->drr_object,
-				    (u_longlong_t)drrw->drr_offset);
-				memcpy(buf, lzbuf, payload_size);
-			}
-
-			free(lzbuf);
+			/* Decompress the block on a worker thread */
+			zr->zr_private = (void *)(intptr_t)c;
+			work = B_TRUE;
 			break;
 		}
 
@@ -335,9 +310,8 @@ zstream_do_decompress(int argc, char *argv[])
 			VERIFY3S(begin, ==, 1);
 			struct drr_write_embedded *drrwe =
 			    &drr->drr_u.drr_write_embedded;
-			payload_size =
-			    P2ROUNDUP((uint64_t)drrwe->drr_psize, 8);
-			(void) sfread(buf, payload_size, stdin);
+			zstream_record_read(zr,
+			    P2ROUNDUP((uint64_t)drrwe->drr_psize, 8), stdin);
 			break;
 		}
 
@@ -364,31 +338,9 @@ zstream_do_decompress(int argc, char *argv[])
 			exit(1);
 		}
 
-		/*
-		 * We need to recalculate the checksum, and it needs to be
-		 * initially zero to do that.  BEGIN records don't have
-		 * a checksum.
-		 */
-		if (drr->drr_type != DRR_BEGIN) {
-			memset(&drr->drr_u.drr_checksum.drr_checksum, 0,
-			    sizeof (drr->drr_u.drr_checksum.drr_checksum));
-		}
-		if (dump_record(drr, buf, payload_size,
-		    &stream_cksum, STDOUT_FILENO) != 0)
-			break;
-		if (drr->drr_type == DRR_END) {
-			/*
-			 * Typically the END record is either the last
-			 * thing in the stream, or it is followed
-			 * by a BEGIN record (which also zeros the checksum).
-			 * However, a stream package ends with two END
-			 * records.  The last END record's checksum starts
-			 * from zero.
-			 */
-			ZIO_SET_CHECKSUM(&stream_cksum, 0, 0, 0, 0);
-		}
+		zstream_pipeline_submit(zp, zr, work);
 	}
-	free(buf);
+	zstream_pipeline_destroy(zp);
 	fletcher_4_fini();
 	hdestroy();
 
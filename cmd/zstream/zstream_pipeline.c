@@ -0,0 +1,353 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Ordered record pipeline shared by "zstream recompress" and
+ * "zstream decompress".
+ *
+ * The reading thread parses the stream on standard input and places each
+ * record, with its payload, into the next slot of a ring.  Records that
+ * need (de)compression are handed to a pool of worker threads; all other
+ * records are ready immediately.  A single writer thread emits the slots
+ * strictly in stream order, so that the stream checksum can be
+ * regenerated incrementally exactly as the serial code did.  The ring
+ * bounds the number of records in flight, and therefore memory use, to a
+ * small multiple of the number of workers.
+ */
+
+#include <err.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/zfs_ioctl.h>
+#include <sys/zio_checksum.h>
+#include "zfs_fletcher.h"
+#include "zstream.h"
+
+/* Number of ring slots per worker thread */
+#define	ZSTREAM_SLOTS_PER_THREAD	4
+
+typedef enum zstream_record_state {
+	ZR_FREE,	/* owned by the reader */
+	ZR_WORK,	/* waiting for a worker */
+	ZR_BUSY,	/* being processed by a worker */
+	ZR_DONE		/* ready to be written */
+} zstream_record_state_t;
+
+struct zstream_pipeline {
+	pthread_mutex_t		zp_lock;
+	pthread_cond_t		zp_cv;
+	zstream_record_t	*zp_ring;
+	zstream_record_state_t	*zp_state;
+	uint64_t		zp_nslots;
+	uint64_t		zp_head;	/* next record to fill */
+	uint64_t		zp_work;	/* next record to scan */
+	uint64_t		zp_tail;	/* next record to write */
+	boolean_t		zp_exiting;
+	int			zp_error;
+	int			zp_nthreads;
+	pthread_t		*zp_threads;
+	pthread_t		zp_writer;
+	zstream_work_func_t	*zp_func;
+	void			*zp_arg;
+	int			zp_outfd;
+};
+
+static int
+dump_record(dmu_replay_record_t *drr, void *payload, int payload_len,
+    zio_cksum_t *zc, int outfd)
+{
+	assert(offsetof(dmu_replay_record_t, drr_u.drr_checksum.drr_checksum)
+	    == sizeof (dmu_replay_record_t) - sizeof (zio_cksum_t));
+	fletcher_4_incremental_native(drr,
+	    offsetof(dmu_replay_record_t, drr_u.drr_checksum.drr_checksum), zc);
+	if (drr->drr_type != DRR_BEGIN) {
+		assert(ZIO_CHECKSUM_IS_ZERO(&drr->drr_u.
+		    drr_checksum.drr_checksum));
+		drr->drr_u.drr_checksum.drr_checksum = *zc;
+	}
+	fletcher_4_incremental_native(&drr->drr_u.drr_checksum.drr_checksum,
+	    sizeof (zio_cksum_t), zc);
+	if (write(outfd, drr, sizeof (*drr)) == -1)
+		return (errno);
+	if (payload_len != 0) {
+		fletcher_4_incremental_native(payload, payload_len, zc);
+		if (write(outfd, payload, payload_len) == -1)
+			return (errno);
+	}
+	return (0);
+}
+
+static void *
+zstream_pipeline_worker(void *arg)
+{
+	zstream_pipeline_t *zp = arg;
+
+	pthread_mutex_lock(&zp->zp_lock);
+	for (;;) {
+		/* Records behind the writer have already been handled. */
+		if (zp->zp_work < zp->zp_tail)
+			zp->zp_work = zp->zp_tail;
+		if (zp->zp_work == zp->zp_head) {
+			if (zp->zp_exiting)
+				break;
+			pthread_cond_wait(&zp->zp_cv, &zp->zp_lock);
+			continue;
+		}
+
+		uint64_t idx = zp->zp_work++ % zp->zp_nslots;
+		if (zp->zp_state[idx] != ZR_WORK)
+			continue;
+		zp->zp_state[idx] = ZR_BUSY;
+		pthread_mutex_unlock(&zp->zp_lock);
+
+		zp->zp_func(&zp->zp_ring[idx], zp->zp_arg);
+
+		pthread_mutex_lock(&zp->zp_lock);
+		zp->zp_state[idx] = ZR_DONE;
+		pthread_cond_broadcast(&zp->zp_cv);
+	}
+	pthread_mutex_unlock(&zp->zp_lock);
+	return (NULL);
+}
+
+static void *
+zstream_pipeline_writer(void *arg)
+{
+	zstream_pipeline_t *zp = arg;
+	zio_cksum_t stream_cksum;
+
+	ZIO_SET_CHECKSUM(&stream_cksum, 0, 0, 0, 0);
+	pthread_mutex_lock(&zp->zp_lock);
+	for (;;) {
+		uint64_t idx = zp->zp_tail % zp->zp_nslots;
+		if (zp->zp_tail == zp->zp_head ||
+		    zp->zp_state[idx] != ZR_DONE) {
+			if (zp->zp_exiting && zp->zp_tail == zp->zp_head)
+				break;
+			pthread_cond_wait(&zp->zp_cv, &zp->zp_lock);
+			continue;
+		}
+		pthread_mutex_unlock(&zp->zp_lock);
+
+		zstream_record_t *zr = &zp->zp_ring[idx];
+		dmu_replay_record_t *drr = &zr->zr_drr;
+
+		if (drr->drr_type == DRR_BEGIN)
+			ZIO_SET_CHECKSUM(&stream_cksum, 0, 0, 0, 0);
+		/*
+		 * Use the recalculated checksum, unless this is the END
+		 * record of a stream package, which has no checksum.
+		 */
+		if (drr->drr_type == DRR_END &&
+		    !ZIO_CHECKSUM_IS_ZERO(&drr->drr_u.drr_end.drr_checksum))
+			drr->drr_u.drr_end.drr_checksum = stream_cksum;
+
+		/*
+		 * We need to recalculate the checksum, and it needs to be
+		 * initially zero to do that.  BEGIN records don't have
+		 * a checksum.
+		 */
+		if (drr->drr_type != DRR_BEGIN) {
+			memset(&drr->drr_u.drr_checksum.drr_checksum, 0,
+			    sizeof (drr->drr_u.drr_checksum.drr_checksum));
+		}
+
+		/*
+		 * After a write error stop producing output, but keep
+		 * retiring slots so that the reader can notice and stop.
+		 */
+		int error = 0;
+		if (zp->zp_error == 0) {
+			error = dump_record(drr, zr->zr_buf,
+			    zr->zr_payload_size, &stream_cksum, zp->zp_outfd);
+		}
+		if (drr->drr_type == DRR_END) {
+			/*
+			 * Typically the END record is either the last
+			 * thing in the stream, or it is followed
+			 * by a BEGIN record (which also zeros the checksum).
+			 * However, a stream package ends with two END
+			 * records.  The last END record's checksum starts
+			 * from zero.
+			 */
+			ZIO_SET_CHECKSUM(&stream_cksum, 0, 0, 0, 0);
+		}
+
+		pthread_mutex_lock(&zp->zp_lock);
+		if (error != 0 && zp->zp_error == 0)
+			zp->zp_error = error;
+		zp->zp_state[idx] = ZR_FREE;
+		zp->zp_tail++;
+		pthread_cond_broadcast(&zp->zp_cv);
+	}
+	pthread_mutex_unlock(&zp->zp_lock);
+	return (NULL);
+}
+
+/*
+ * Create a pipeline writing to outfd, with nthreads workers calling func
+ * on each record submitted with work set.
+ */
+zstream_pipeline_t *
+zstream_pipeline_create(int nthreads, zstream_work_func_t *func, void *arg,
+    int outfd)
+{
+	zstream_pipeline_t *zp = safe_calloc(sizeof (*zp));
+
+	if (nthreads < 1)
+		nthreads = 1;
+	zp->zp_nthreads = nthreads;
+	zp->zp_nslots = (uint64_t)nthreads * ZSTREAM_SLOTS_PER_THREAD;
+	zp->zp_ring = safe_calloc(zp->zp_nslots * sizeof (zstream_record_t));
+	zp->zp_state = safe_calloc(zp->zp_nslots *
+	    sizeof (zstream_record_state_t));
+	zp->zp_threads = safe_calloc(nthreads * sizeof (pthread_t));
+	zp->zp_func = func;
+	zp->zp_arg = arg;
+	zp->zp_outfd = outfd;
+	VERIFY0(pthread_mutex_init(&zp->zp_lock, NULL));
+	VERIFY0(pthread_cond_init(&zp->zp_cv, NULL));
+
+	for (int i = 0; i < nthreads; i++) {
+		if ((errno = pthread_create(&zp->zp_threads[i], NULL,
+		    zstream_pipeline_worker, zp)) != 0)
+			err(1, "pthread_create");
+	}
+	if ((errno = pthread_create(&zp->zp_writer, NULL,
+	    zstream_pipeline_writer, zp)) != 0)
+		err(1, "pthread_create");
+
+	return (zp);
+}
+
+/*
+ * Return the next free slot, waiting for the writer to retire one if the
+ * ring is full.  The caller fills in zr_drr, reads the payload with
+ * zstream_record_read(), and hands the slot back with
+ * zstream_pipeline_submit().
+ */
+zstream_record_t *
+zstream_pipeline_get(zstream_pipeline_t *zp)
+{
+	pthread_mutex_lock(&zp->zp_lock);
+	while (zp->zp_head - zp->zp_tail >= zp->zp_nslots)
+		pthread_cond_wait(&zp->zp_cv, &zp->zp_lock);
+	zstream_record_t *zr = &zp->zp_ring[zp->zp_head % zp->zp_nslots];
+	ASSERT3U(zp->zp_state[zp->zp_head % zp->zp_nslots], ==, ZR_FREE);
+	pthread_mutex_unlock(&zp->zp_lock);
+
+	zr->zr_payload_size = 0;
+	zr->zr_private = NULL;
+	return (zr);
+}
+
+void
+zstream_pipeline_submit(zstream_pipeline_t *zp, zstream_record_t *zr,
+    boolean_t work)
+{
+	pthread_mutex_lock(&zp->zp_lock);
+	ASSERT3P(zr, ==, &zp->zp_ring[zp->zp_head % zp->zp_nslots]);
+	zp->zp_state[zp->zp_head % zp->zp_nslots] = work ? ZR_WORK : ZR_DONE;
+	zp->zp_head++;
+	pthread_cond_broadcast(&zp->zp_cv);
+	pthread_mutex_unlock(&zp->zp_lock);
+}
+
+/*
+ * Returns the first error hit while writing the output, or 0.
+ */
+int
+zstream_pipeline_error(zstream_pipeline_t *zp)
+{
+	pthread_mutex_lock(&zp->zp_lock);
+	int error = zp->zp_error;
+	pthread_mutex_unlock(&zp->zp_lock);
+	return (error);
+}
+
+/*
+ * Wait for all submitted records to be written, then tear down the
+ * threads and free the ring.
+ */
+void
+zstream_pipeline_destroy(zstream_pipeline_t *zp)
+{
+	pthread_mutex_lock(&zp->zp_lock);
+	zp->zp_exiting = B_TRUE;
+	pthread_cond_broadcast(&zp->zp_cv);
+	pthread_mutex_unlock(&zp->zp_lock);
+
+	VERIFY0(pthread_join(zp->zp_writer, NULL));
+	for (int i = 0; i < zp->zp_nthreads; i++)
+		VERIFY0(pthread_join(zp->zp_threads[i], NULL));
+
+	for (uint64_t i = 0; i < zp->zp_nslots; i++)
+		free(zp->zp_ring[i].zr_buf);
+	pthread_cond_destroy(&zp->zp_cv);
+	pthread_mutex_destroy(&zp->zp_lock);
+	free(zp->zp_threads);
+	free(zp->zp_state);
+	free(zp->zp_ring);
+	free(zp);
+}
+
+/*
+ * Read a payload of the given size from fp into the record, growing its
+ * buffer as needed.
+ */
+void
+zstream_record_read(zstream_record_t *zr, uint64_t size, FILE *fp)
+{
+	if (size > zr->zr_bufsz) {
+		free(zr->zr_buf);
+		zr->zr_buf = safe_malloc(size);
+		zr->zr_bufsz = size;
+	}
+	if (size != 0)
+		(void) sfread(zr->zr_buf, size, fp);
+	zr->zr_payload_size = size;
+}
+
+/*
+ * Replace the record's payload with buf, which was allocated with
+ * bufsz bytes and holds size bytes of payload.  The record takes
+ * ownership of buf.
+ */
+void
+zstream_record_set_payload(zstream_record_t *zr, char *buf, uint64_t bufsz,
+    uint64_t size)
+{
+	ASSERT3U(size, <=, bufsz);
+	if (buf != zr->zr_buf) {
+		free(zr->zr_buf);
+		zr->zr_buf = buf;
+		zr->zr_bufsz = bufsz;
+	}
+	zr->zr_payload_size = size;
+}
+
+/*
+ * Default number of worker threads: one per online CPU.
+ */
+int
+zstream_default_threads(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return (ncpus > 0 ? (int)ncpus : 1);
+}
@@ -38,44 +38,103 @@
 #include "zfs_fletcher.h"
 #include "zstream.h"
 
-static int
-dump_record(dmu_replay_record_t *drr, void *payload, int payload_len,
-    zio_cksum_t *zc, int outfd)
+typedef struct recompress_arg {
+	enum zio_compress	ra_ctype;
+	int			ra_level;
+} recompress_arg_t;
+
+/*
+ * Decompress and recompress the payload of one WRITE record.  Called from
+ * the pipeline's worker threads.
+ */
+static void
+recompress_write(zstream_record_t *zr, void *arg)
 {
-	assert(offsetof(dmu_replay_record_t, drr_u.drr_checksum.drr_checksum)
-	    == sizeof (dmu_replay_record_t) - sizeof (zio_cksum_t));
-	fletcher_4_incremental_native(drr,
-	    offsetof(dmu_replay_record_t, drr_u.drr_checksum.drr_checksum), zc);
-	if (drr->drr_type != DRR_BEGIN) {
-		assert(ZIO_CHECKSUM_IS_ZERO(&drr->drr_u.
-		    drr_checksum.drr_checksum));
-		drr->drr_u.drr_checksum.drr_checksum = *zc;
+	recompress_arg_t *ra = arg;
+	struct drr_write *drrw = &zr->zr_drr.drr_u.drr_write;
+	uint64_t lsize = drrw->drr_logical_size;
+	uint64_t payload_size = zr->zr_payload_size;
+	enum zio_compress dtype = drrw->drr_compressiontype;
+
+	if (zio_compress_table[dtype].ci_decompress == NULL)
+		dtype = ZIO_COMPRESS_OFF;
+
+	/* Decompress the payload */
+	char *dbuf;
+	if (dtype == ZIO_COMPRESS_OFF) {
+		if (zr->zr_bufsz < lsize) {
+			dbuf = safe_calloc(lsize);
+			memcpy(dbuf, zr->zr_buf, payload_size);
+			zstream_record_set_payload(zr, dbuf, lsize,
+			    payload_size);
+		}
+		dbuf = zr->zr_buf;
+	} else {
+		dbuf = safe_calloc(lsize);
+		abd_t cabd, dabd;
+		abd_get_from_buf_struct(&cabd, zr->zr_buf, payload_size);
+		abd_get_from_buf_struct(&dabd, dbuf, lsize);
+		if (zio_decompress_data(dtype, &cabd, &dabd,
+		    payload_size, lsize, NULL) != 0) {
+			warnx("decompression type %d failed "
+			    "for ino %llu offset %llu",
+			    dtype,
+			    (u_longlong_t)drrw->drr_object,
+			    (u_longlong_t)drrw->drr_offset);
+			exit(4);
+		}
+		abd_free(&dabd);
+		abd_free(&cabd);
+		zstream_record_set_payload(zr, dbuf, lsize, lsize);
 	}
-	fletcher_4_incremental_native(&drr->drr_u.drr_checksum.drr_checksum,
-	    sizeof (zio_cksum_t), zc);
-	if (write(outfd, drr, sizeof (*drr)) == -1)
-		return (errno);
-	if (payload_len != 0) {
-		fletcher_4_incremental_native(payload, payload_len, zc);
-		if (write(outfd, payload, payload_len) == -1)
-			return (errno);
+
+	drrw->drr_compressiontype = 0;
+	drrw->drr_compressed_size = 0;
+	if (ra->ra_ctype == ZIO_COMPRESS_OFF)
+		return;
+
+	/* Recompress the payload */
+	char *cbuf = safe_calloc(lsize);
+	abd_t dabd, abd;
+	abd_get_from_buf_struct(&dabd, dbuf, lsize);
+	abd_t *pabd = abd_get_from_buf_struct(&abd, cbuf, lsize);
+	size_t csize = zio_compress_data(ra->ra_ctype, &dabd, &pabd,
+	    lsize, lsize, ra->ra_level);
+	size_t rounded = P2ROUNDUP(csize, SPA_MINBLOCKSIZE);
+	if (rounded < lsize) {
+		abd_zero_off(pabd, csize, rounded - csize);
+		drrw->drr_compressiontype = ra->ra_ctype;
+		drrw->drr_compressed_size = rounded;
 	}
-	return (0);
+	abd_free(&abd);
+	abd_free(&dabd);
+	if (rounded < lsize)
+		zstream_record_set_payload(zr, cbuf, lsize, rounded);
+	else
+		free(cbuf);
 }
 
 int
 zstream_do_recompress(int argc, char *argv[])
 {
-	int bufsz = SPA_MAXBLOCKSIZE;
-	char *buf = safe_malloc(bufsz);
 	dmu_replay_record_t thedrr;
-	dmu_replay_record_t *drr = &thedrr;
-	zio_cksum_t stream_cksum;
+	dmu_replay_record_t *drr;
+	recompress_arg_t ra;
 	int c;
 	int level = 0;
+	int nthreads = zstream_default_threads();
 
-	while ((c = getopt(argc, argv, "l:")) != -1) {
+	while ((c = getopt(argc, argv, "j:l:")) != -1) {
 		switch (c) {
+		case 'j':
+			if (sscanf(optarg, "%d", &nthreads) != 1 ||
+			    nthreads < 1) {
+				fprintf(stderr,
+				    "failed to parse thread count '%s'\n",
+				    optarg);
+				zstream_usage();
+			}
+			break;
 		case 'l':
 			if (sscanf(optarg, "%d", &level) != 1) {
 				fprintf(stderr,
@@ -108,7 +167,8 @@ zstream_do_recompress(int argc, char *argv[])
 				break;
 		}
 		if (ctype == ZIO_COMPRESS_FUNCTIONS ||
-		    zio_compress_table[ctype].ci_compress == NULL) {
+		    zio_compress_table[ctype].ci_compress == NULL ||
+		    ZIO_COMPRESS_IS_CHUNKED(ctype)) {
 			fprintf(stderr, "Invalid compression type %s.\n",
 			    argv[0]);
 			exit(2);
@@ -127,25 +187,29 @@ zstream_do_recompress(int argc, char *argv[])
 	fletcher_4_init();
 	zio_init();
 	zstd_init();
+	ra.ra_ctype = ctype;
+	ra.ra_level = level;
+	zstream_pipeline_t *zp = zstream_pipeline_create(nthreads,
+	    recompress_write, &ra, STDOUT_FILENO);
 	int begin = 0;
 	boolean_t seen = B_FALSE;
-	while (sfread(drr, sizeof (*drr), stdin) != 0) {
+	while (sfread(&thedrr, sizeof (thedrr), stdin) != 0) {
 		struct drr_write *drrw;
-		uint64_t payload_size = 0;
+		boolean_t work = B_FALSE;
 
 		/*
-		 * We need to regenerate the checksum.
+		 * Stop reading once the output can no longer be written.
 		 */
-		if (drr->drr_type != DRR_BEGIN) {
-			memset(&drr->drr_u.drr_checksum.drr_checksum, 0,
-			    sizeof (drr->drr_u.drr_checksum.drr_checksum));
-		}
+		if (zstream_pipeline_error(zp) != 0)
+			break;
 
+		zstream_record_t *zr = zstream_pipeline_get(zp);
+		zr->zr_drr = thedrr;
+		drr = &zr->zr_drr;
 
 		switch (drr->drr_type) {
 		case DRR_BEGIN:
 		{
-			ZIO_SET_CHECKSUM(&stream_cksum, 0, 0, 0, 0);
 			VERIFY0(begin++);
 			seen = B_TRUE;
 
@@ -153,21 +217,10 @@ zstream_do_recompress(int argc, char *argv[])
 
 			VERIFY3U(sz, <=, 1U << 28);
 
-			if (sz != 0) {
-				if (sz > bufsz) {
-					buf = realloc(buf, sz);
-					if (buf == NULL)
-						err(1, "realloc");
-					bufsz = sz;
-				}
-				(void) sfread(buf, sz, stdin);
-			}
-			payload_size = sz;
+			zstream_record_read(zr, sz, stdin);
 			break;
 		}
 		case DRR_END:
-		{
-			struct drr_end *drre = &drr->drr_u.drr_end;
 			/*
 			 * We would prefer to just check --begin == 0, but
 			 * replication streams have an end of stream END
@@ -175,15 +228,7 @@ zstream_do_recompress(int argc, char *argv[])
 			 */
 			VERIFY3B(seen, ==, B_TRUE);
 			begin--;
-			/*
-			 * Use the recalculated checksum, unless this is
-			 * the END record of a stream package, which has
-			 * no checksum.
-			 */
-			if (!ZIO_CHECKSUM_IS_ZERO(&drre->drr_checksum))
-				drre->drr_checksum = stream_cksum;
 			break;
-		}
 
 		case DRR_OBJECT:
 		{
@@ -191,8 +236,8 @@ zstream_do_recompress(int argc, char *argv[])
 			VERIFY3S(begin, ==, 1);
 
 			if (drro->drr_bonuslen > 0) {
-				payload_size = DRR_OBJECT_PAYLOAD_SIZE(drro);
-				(void) sfread(buf, payload_size, stdin);
+				zstream_record_read(zr,
+				    DRR_OBJECT_PAYLOAD_SIZE(drro), stdin);
 			}
 			break;
 		}
@@ -201,8 +246,8 @@ zstream_do_recompress(int argc, char *argv[])
 		{
 			struct drr_spill *drrs = &drr->drr_u.drr_spill;
 			VERIFY3S(begin, ==, 1);
-			payload_size = DRR_SPILL_PAYLOAD_SIZE(drrs);
-			(void) sfread(buf, payload_size, stdin);
+			zstream_record_read(zr, DRR_SPILL_PAYLOAD_SIZE(drrs),
+			    stdin);
 			break;
 		}
 
@@ -216,8 +261,9 @@ zstream_do_recompress(int argc, char *argv[])
 		case DRR_WRITE:
 		{
 			VERIFY3S(begin, ==, 1);
-			drrw = &thedrr.drr_u.drr_write;
-			payload_size = DRR_WRITE_PAYLOAD_SIZE(drrw);
+			drrw = &drr->drr_u.drr_write;
+			zstream_record_read(zr, DRR_WRITE_PAYLOAD_SIZE(drrw),
+			    stdin);
 			/*
 			 * In order to recompress an encrypted block, you have
 			 * to decrypt, decompress, recompress, and
@@ -232,85 +278,18 @@ zstream_do_recompress(int argc, char *argv[])
 					break;
 				}
 			}
-			if (encrypted) {
-				(void) sfread(buf, payload_size, stdin);
+			if (encrypted)
 				break;
-			}
 			enum zio_compress dtype = drrw->drr_compressiontype;
 			if (dtype >= ZIO_COMPRESS_FUNCTIONS) {
 				fprintf(stderr, "Invalid compression type in "
 				    "stream: %d\n", dtype);
 				exit(3);
 			}
-			if (zio_compress_table[dtype].ci_decompress == NULL)
-				dtype = ZIO_COMPRESS_OFF;
-
-			/* Set up buffers to minimize memcpys */
-			char *cbuf, *dbuf;
-			if (ctype == ZIO_COMPRESS_OFF)
-				dbuf = buf;
-			else
-				dbuf = safe_calloc(bufsz);
-
-			if (dtype == ZIO_COMPRESS_OFF)
-				cbuf = dbuf;
-			else
-				cbuf = safe_calloc(payload_size);
-
-			/* Read and decompress the payload */
-			(void) sfread(cbuf, payload_size, stdin);
-			if (dtype != ZIO_COMPRESS_OFF) {
-				abd_t cabd, dabd;
-				abd_get_from_buf_struct(&cabd,
-				    cbuf, payload_size);
-				abd_get_from_buf_struct(&dabd, dbuf,
-				    MIN(bufsz, drrw->drr_logical_size));
-				if (zio_decompress_data(dtype, &cabd, &dabd,
-				    payload_size, abd_get_size(&dabd),
-				    NULL) != 0) {
-					warnx("decompression type %d failed "
-					    "for ino %llu offset %llu",
-					    dtype,
-					    (u_longlong_t)drrw->drr_object,
-					    (u_longlong_t)drrw->drr_offset);
-					exit(4);
-				}
-				payload_size = drrw->drr_logical_size;
-				abd_free(&dabd);
-				abd_free(&cabd);
-				free(cbuf);
-			}
+			VERIFY3U(drrw->drr_logical_size, <=, SPA_MAXBLOCKSIZE);
 
-			/* Recompress the payload */
-			if (ctype != ZIO_COMPRESS_OFF) {
-				abd_t dabd, abd;
-				abd_get_from_buf_struct(&dabd,
-				    dbuf, drrw->drr_logical_size);
-				abd_t *pabd =
-				    abd_get_from_buf_struct(&abd, buf, bufsz);
-				size_t csize = zio_compress_data(ctype, &dabd,
-				    &pabd, drrw->drr_logical_size,
-				    drrw->drr_logical_size, level);
-				size_t rounded =
-				    P2ROUNDUP(csize, SPA_MINBLOCKSIZE);
-				if (rounded >= drrw->drr_logical_size) {
-					memcpy(buf, dbuf, payload_size);
-					drrw->drr_compressiontype = 0;
-					drrw->drr_compressed_size = 0;
-				} else {
-					abd_zero_off(pabd, csize,
-					    rounded - csize);
-					drrw->drr_compressiontype = ctype;
-					drrw->drr_compressed_size =
-					    payload_size = rounded;
-				}
-				abd_free(&abd);
-				abd_free(&dabd);
-				free(dbuf);
-			} else {
-				drrw->drr_compressiontype = 0;
-				drrw->drr_compressed_size = 0;
-			}
+			/* Decompress and recompress on a worker thread */
+			work = B_TRUE;
 			break;
 		}
 
@@ -319,9 +298,8 @@ zstream_do_recompress(int argc, char *argv[])
 			struct drr_write_embedded *drrwe =
 			    &drr->drr_u.drr_write_embedded;
 			VERIFY3S(begin, ==, 1);
-			payload_size =
-			    P2ROUNDUP((uint64_t)drrwe->drr_psize, 8);
-			(void) sfread(buf, payload_size, stdin);
+			zstream_record_read(zr,
+			    P2ROUNDUP((uint64_t)drrwe->drr_psize, 8), stdin);
 			break;
 		}
 
@@ -348,31 +326,9 @@ zstream_do_recompress(int argc, char *argv[])
 			exit(1);
 		}
 
-		/*
-		 * We need to recalculate the checksum, and it needs to be
-		 * initially zero to do that.  BEGIN records don't have
-		 * a checksum.
-		 */
-		if (drr->drr_type != DRR_BEGIN) {
-			memset(&drr->drr_u.drr_checksum.drr_checksum, 0,
-			    sizeof (drr->drr_u.drr_checksum.drr_checksum));
-		}
-		if (dump_record(drr, buf, payload_size,
-		    &stream_cksum, STDOUT_FILENO) != 0)
-			break;
-		if (drr->drr_type == DRR_END) {
-			/*
-			 * Typically the END record is either the last
-			 * thing in the stream, or it is followed
-			 * by a BEGIN record (which also zeros the checksum).
-			 * However, a stream package ends with two END
-			 * records.  The last END record's checksum starts
-			 * from zero.
-			 */
-			ZIO_SET_CHECKSUM(&stream_cksum, 0, 0, 0, 0);
-		}
+		zstream_pipeline_submit(zp, zr, work);
 	}
-	free(buf);
+	zstream_pipeline_destroy(zp);
 	fletcher_4_fini();
 	zio_fini();
 	zstd_fini();
@@ -29,9 +29,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <umem.h>
 #include <unistd.h>
 #include <sys/debug.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/zfs_ioctl.h>
 #include <sys/zio_checksum.h>
@@ -39,22 +39,32 @@
 #include "zstream.h"
 
 
-#define	MAX_RDT_PHYSMEM_PERCENT		20
-#define	SMALLEST_POSSIBLE_MAX_RDT_MB		128
+/*
+ * The redup table maps the (guid, object, offset) of every WRITE record seen
+ * so far to the record's offset in the input stream.  It is an open
+ * addressing hash table with linear probing, and each entry holds only the
+ * 64-bit hash of the key and the stream offset.  The key itself is not
+ * stored: it is checked against the WRITE record in the stream, which
+ * has to be read anyway to resolve a WRITE_BYREF.
+ *
+ * The table starts small and doubles as it fills.  It lives in anonymous
+ * memory, or with -T in an unlinked file in the given directory, so that
+ * the index of a very large stream can be paged to disk rather than swap.
+ */
+#define	RDT_INITIAL_SIZE	(1ULL << 20)
 
 typedef struct redup_entry {
-	struct redup_entry	*rde_next;
-	uint64_t rde_guid;
-	uint64_t rde_object;
-	uint64_t rde_offset;
+	uint64_t rde_hash;		/* 0 if the slot is empty */
 	uint64_t rde_stream_offset;
 } redup_entry_t;
 
 typedef struct redup_table {
-	redup_entry_t	**redup_hash_array;
-	umem_cache_t	*ddecache;
-	uint64_t	ddt_count;
-	int		numhashbits;
+	redup_entry_t	*rdt_entries;
+	uint64_t	rdt_size;	/* number of slots, a power of 2 */
+	uint64_t	rdt_count;
+	int		rdt_infd;	/* the input stream */
+	int		rdt_mapfd;	/* backing file, or -1 */
+	const char	*rdt_dir;	/* where to create rdt_mapfd */
 } redup_table_t;
 
 void *
@@ -129,43 +139,153 @@ dump_record(dmu_replay_record_t *drr, void *payload, int payload_len,
 	return (0);
 }
 
+static void
+rdt_map(redup_table_t *rdt, uint64_t size)
+{
+	size_t len = size * sizeof (redup_entry_t);
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+	rdt->rdt_mapfd = -1;
+	if (rdt->rdt_dir != NULL) {
+		char *path;
+		if (asprintf(&path, "%s/zstream-redup.XXXXXX",
+		    rdt->rdt_dir) == -1) {
+			(void) fprintf(stderr, "Error: out of memory\n");
+			exit(1);
+		}
+		rdt->rdt_mapfd = mkstemp(path);
+		if (rdt->rdt_mapfd == -1 ||
+		    ftruncate(rdt->rdt_mapfd, len) != 0) {
+			(void) fprintf(stderr,
+			    "Error while creating file '%s': %s\n",
+			    path, strerror(errno));
+			exit(1);
+		}
+		(void) unlink(path);
+		free(path);
+		flags = MAP_SHARED;
+	}
+
+	rdt->rdt_entries = mmap(NULL, len, PROT_READ | PROT_WRITE, flags,
+	    rdt->rdt_mapfd, 0);
+	if (rdt->rdt_entries == MAP_FAILED) {
+		(void) fprintf(stderr,
+		    "Error: could not map %llu bytes for the redup table: "
+		    "%s\n", (u_longlong_t)len, strerror(errno));
+		exit(1);
+	}
+	rdt->rdt_size = size;
+}
+
+static void
+rdt_unmap(redup_entry_t *entries, uint64_t size, int mapfd)
+{
+	VERIFY0(munmap(entries, size * sizeof (redup_entry_t)));
+	if (mapfd != -1)
+		(void) close(mapfd);
+}
+
+static uint64_t
+rdt_hash(uint64_t guid, uint64_t object, uint64_t offset)
+{
+	uint64_t hash = cityhash3(guid, object, offset);
+	return (hash == 0 ? 1 : hash);
+}
+
+/*
+ * Read the WRITE record at the given stream offset, and check whether it
+ * is the one for guid, object and offset.
+ */
+static boolean_t
+rdt_check(redup_table_t *rdt, uint64_t stream_offset,
+    uint64_t guid, uint64_t object, uint64_t offset,
+    dmu_replay_record_t *drr)
+{
+	spread(rdt->rdt_infd, drr, sizeof (*drr), stream_offset);
+	assert(drr->drr_type == DRR_WRITE);
+	struct drr_write *drrw = &drr->drr_u.drr_write;
+	return (drrw->drr_toguid == guid && drrw->drr_object == object &&
+	    drrw->drr_offset == offset);
+}
+
+/*
+ * Double the size of the table.  Entries are reinserted by their stored
+ * hash; as all keys are distinct, nothing needs to be read back.
+ */
+static void
+rdt_grow(redup_table_t *rdt)
+{
+	redup_entry_t *old = rdt->rdt_entries;
+	uint64_t oldsize = rdt->rdt_size;
+	int oldfd = rdt->rdt_mapfd;
+
+	rdt_map(rdt, oldsize * 2);
+	uint64_t mask = rdt->rdt_size - 1;
+	for (uint64_t i = 0; i < oldsize; i++) {
+		if (old[i].rde_hash == 0)
+			continue;
+		uint64_t idx = old[i].rde_hash & mask;
+		while (rdt->rdt_entries[idx].rde_hash != 0)
+			idx = (idx + 1) & mask;
+		rdt->rdt_entries[idx] = old[i];
+	}
+	rdt_unmap(old, oldsize, oldfd);
+}
+
 static void
 rdt_insert(redup_table_t *rdt,
     uint64_t guid, uint64_t object, uint64_t offset, uint64_t stream_offset)
 {
-	uint64_t ch = cityhash3(guid, object, offset);
-	uint64_t hashcode = BF64_GET(ch, 0, rdt->numhashbits);
-	redup_entry_t **rdepp;
-
-	rdepp = &(rdt->redup_hash_array[hashcode]);
-	redup_entry_t *rde = umem_cache_alloc(rdt->ddecache, UMEM_NOFAIL);
-	rde->rde_next = *rdepp;
-	rde->rde_guid = guid;
-	rde->rde_object = object;
-	rde->rde_offset = offset;
+	/* Keep the load factor at or below 3/4 */
+	if ((rdt->rdt_count + 1) * 4 > rdt->rdt_size * 3)
+		rdt_grow(rdt);
+
+	uint64_t hash = rdt_hash(guid, object, offset);
+	uint64_t mask = rdt->rdt_size - 1;
+	uint64_t idx = hash & mask;
+	redup_entry_t *rde;
+
+	while ((rde = &rdt->rdt_entries[idx])->rde_hash != 0) {
+		/*
+		 * The same block may be written more than once; the later
+		 * record replaces the earlier one.
+		 */
+		if (rde->rde_hash == hash) {
+			dmu_replay_record_t drr;
+			if (rdt_check(rdt, rde->rde_stream_offset,
+			    guid, object, offset, &drr)) {
+				rde->rde_stream_offset = stream_offset;
+				return;
+			}
+		}
+		idx = (idx + 1) & mask;
+	}
+	rde->rde_hash = hash;
 	rde->rde_stream_offset = stream_offset;
-	*rdepp = rde;
-	rdt->ddt_count++;
+	rdt->rdt_count++;
 }
 
-static void
+/*
+ * Find the WRITE record for guid, object and offset, and read its header
+ * into drr.  Returns the record's offset in the stream.
+ */
+static uint64_t
 rdt_lookup(redup_table_t *rdt,
     uint64_t guid, uint64_t object, uint64_t offset,
-    uint64_t *stream_offsetp)
+    dmu_replay_record_t *drr)
 {
-	uint64_t ch = cityhash3(guid, object, offset);
-	uint64_t hashcode = BF64_GET(ch, 0, rdt->numhashbits);
-
-	for (redup_entry_t *rde = rdt->redup_hash_array[hashcode];
-	    rde != NULL; rde = rde->rde_next) {
-		if (rde->rde_guid == guid &&
-		    rde->rde_object == object &&
-		    rde->rde_offset == offset) {
-			*stream_offsetp = rde->rde_stream_offset;
-			return;
-		}
+	uint64_t hash = rdt_hash(guid, object, offset);
+	uint64_t mask = rdt->rdt_size - 1;
+
+	for (uint64_t idx = hash & mask;
+	    rdt->rdt_entries[idx].rde_hash != 0; idx = (idx + 1) & mask) {
+		redup_entry_t *rde = &rdt->rdt_entries[idx];
+		if (rde->rde_hash == hash && rdt_check(rdt,
+		    rde->rde_stream_offset, guid, object, offset, drr))
+			return (rde->rde_stream_offset);
 	}
 	assert(!"could not find expected redup table entry");
+	return (0);
 }
 
 /*
@@ -175,43 +295,23 @@ rdt_lookup(redup_table_t *rdt,
  * infd must be seekable.
  */
 static void
-zfs_redup_stream(int infd, int outfd, boolean_t verbose)
+zfs_redup_stream(int infd, int outfd, const char *tmpdir,
+    boolean_t verbose)
 {
 	int bufsz = SPA_MAXBLOCKSIZE;
 	dmu_replay_record_t thedrr;
 	dmu_replay_record_t *drr = &thedrr;
 	redup_table_t rdt;
 	zio_cksum_t stream_cksum;
-	uint64_t numbuckets;
 	uint64_t num_records = 0;
 	uint64_t num_write_byref_records = 0;
 
 	memset(&thedrr, 0, sizeof (dmu_replay_record_t));
 
-#ifdef _ILP32
-	uint64_t max_rde_size = SMALLEST_POSSIBLE_MAX_RDT_MB << 20;
-#else
-	uint64_t physmem = sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
-	uint64_t max_rde_size =
-	    MAX((physmem * MAX_RDT_PHYSMEM_PERCENT) / 100,
-	    SMALLEST_POSSIBLE_MAX_RDT_MB << 20);
-#endif
-
-	numbuckets = max_rde_size / (sizeof (redup_entry_t));
-
-	/*
-	 * numbuckets must be a power of 2.  Increase number to
-	 * a power of 2 if necessary.
-	 */
-	if (!ISP2(numbuckets))
-		numbuckets = 1ULL << highbit64(numbuckets);
-
-	rdt.redup_hash_array =
-	    safe_calloc(numbuckets * sizeof (redup_entry_t *));
-	rdt.ddecache = umem_cache_create("rde", sizeof (redup_entry_t), 0,
-	    NULL, NULL, NULL, NULL, NULL, 0);
-	rdt.numhashbits = highbit64(numbuckets) - 1;
-	rdt.ddt_count = 0;
+	rdt.rdt_infd = infd;
+	rdt.rdt_dir = tmpdir;
+	rdt.rdt_count = 0;
+	rdt_map(&rdt, RDT_INITIAL_SIZE);
 
 	char *buf = safe_calloc(bufsz);
 	FILE *ofp = fdopen(infd, "r");
@@ -319,14 +419,10 @@ zfs_redup_stream(int infd, int outfd, boolean_t verbose)
 			 * record with the found WRITE record, but with
 			 * drr_object,drr_offset,drr_toguid replaced with ours.
 			 */
-			uint64_t stream_offset = 0;
-			rdt_lookup(&rdt, drrwb.drr_refguid,
-			    drrwb.drr_refobject, drrwb.drr_refoffset,
-			    &stream_offset);
-
-			spread(infd, drr, sizeof (*drr), stream_offset);
+			uint64_t stream_offset = rdt_lookup(&rdt,
+			    drrwb.drr_refguid, drrwb.drr_refobject,
+			    drrwb.drr_refoffset, drr);
 
-			assert(drr->drr_type == DRR_WRITE);
 			struct drr_write *drrw = &drr->drr_u.drr_write;
 			assert(drrw->drr_toguid == drrwb.drr_refguid);
 			assert(drrw->drr_object == drrwb.drr_refobject);
@@ -416,7 +512,7 @@ zfs_redup_stream(int infd, int outfd, boolean_t verbose)
 
 	if (verbose) {
 		char mem_str[16];
-		zfs_nicenum(rdt.ddt_count * sizeof (redup_entry_t),
+		zfs_nicenum(rdt.rdt_size * sizeof (redup_entry_t),
 		    mem_str, sizeof (mem_str));
 		fprintf(stderr, "converted stream with %llu total records, "
 		    "including %llu dedup records, using %sB memory.\n",
@@ -425,8 +521,7 @@ zfs_redup_stream(int infd, int outfd, boolean_t verbose)
 		    mem_str);
 	}
 
-	umem_cache_destroy(rdt.ddecache);
-	free(rdt.redup_hash_array);
+	rdt_unmap(rdt.rdt_entries, rdt.rdt_size, rdt.rdt_mapfd);
 	free(buf);
 	(void) fclose(ofp);
 }
@@ -435,10 +530,14 @@ int
 zstream_do_redup(int argc, char *argv[])
 {
 	boolean_t verbose = B_FALSE;
+	const char *tmpdir = NULL;
 	int c;
 
-	while ((c = getopt(argc, argv, "v")) != -1) {
+	while ((c = getopt(argc, argv, "T:v")) != -1) {
 		switch (c) {
+		case 'T':
+			tmpdir = optarg;
+			break;
 		case 'v':
 			verbose = B_TRUE;
 			break;
@@ -474,7 +573,7 @@ zstream_do_redup(int argc, char *argv[])
 	}
 
 	fletcher_4_init();
-	zfs_redup_stream(fd, STDOUT_FILENO, verbose);
+	zfs_redup_stream(fd, STDOUT_FILENO, tmpdir, verbose);
 	fletcher_4_fini();
 
 	close(fd);
@@ -233,6 +233,35 @@ AC_DEFUN([ZFS_AC_KERNEL_BIO_ALLOC_4ARG], [
 	])
 ])
 
+dnl #
+dnl # Linux 5.17 API,
+dnl #
+dnl # REQ_HIPRI was renamed REQ_POLLED, and blk_poll() was replaced by
+dnl # bio_poll(), which takes the bio to poll for.
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_SRC_BIO_POLL], [
+	ZFS_LINUX_TEST_SRC([bio_poll], [
+		#include <linux/bio.h>
+		#include <linux/blkdev.h>
+	],[
+		struct bio *bio = NULL;
+		int ret __attribute__ ((unused));
+
+		bio->bi_opf |= REQ_POLLED;
+		ret = bio_poll(bio, NULL, BLK_POLL_ONESHOT);
+	])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_BIO_POLL], [
+	AC_MSG_CHECKING([whether bio_poll() is available])
+	ZFS_LINUX_TEST_RESULT([bio_poll], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE([HAVE_BIO_POLL], 1, [bio_poll() is available])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
+
 AC_DEFUN([ZFS_AC_KERNEL_SRC_BIO], [
 	ZFS_AC_KERNEL_SRC_BIO_OPS
 	ZFS_AC_KERNEL_SRC_BIO_SET_DEV
@@ -242,6 +271,7 @@ AC_DEFUN([ZFS_AC_KERNEL_SRC_BIO], [
 	ZFS_AC_KERNEL_SRC_BDEV_SUBMIT_BIO_RETURNS_VOID
 	ZFS_AC_KERNEL_SRC_BIO_SET_DEV_MACRO
 	ZFS_AC_KERNEL_SRC_BIO_ALLOC_4ARG
+	ZFS_AC_KERNEL_SRC_BIO_POLL
 ])
 
 AC_DEFUN([ZFS_AC_KERNEL_BIO], [
@@ -252,4 +282,5 @@ AC_DEFUN([ZFS_AC_KERNEL_BIO], [
 	ZFS_AC_KERNEL_BIO_BDEV_DISK
 	ZFS_AC_KERNEL_BDEV_SUBMIT_BIO_RETURNS_VOID
 	ZFS_AC_KERNEL_BIO_ALLOC_4ARG
+	ZFS_AC_KERNEL_BIO_POLL
 ])
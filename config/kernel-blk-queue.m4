@@ -269,6 +269,52 @@ AC_DEFUN([ZFS_AC_KERNEL_BLK_MQ_RQ_HCTX], [
 	])
 ])
 
+dnl #
+dnl # 6.10: host-aware devices are no longer zoned, so bdev_is_zoned()
+dnl #       means host-managed and blk_queue_zoned_model() is gone
+dnl # 4.10: blk_queue_zoned_model() available
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_SRC_BLK_QUEUE_ZONED], [
+	ZFS_LINUX_TEST_SRC([blk_queue_zoned_model], [
+		#include <linux/blkdev.h>
+	],[
+		struct request_queue *q __attribute__ ((unused)) = NULL;
+		enum blk_zoned_model model __attribute__ ((unused));
+
+		model = blk_queue_zoned_model(q);
+		model = BLK_ZONED_HM;
+	])
+
+	ZFS_LINUX_TEST_SRC([bdev_is_zoned], [
+		#include <linux/blkdev.h>
+	],[
+		struct block_device *bdev __attribute__ ((unused)) = NULL;
+		bool zoned __attribute__ ((unused));
+
+		zoned = bdev_is_zoned(bdev);
+	])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_BLK_QUEUE_ZONED], [
+	AC_MSG_CHECKING([whether blk_queue_zoned_model() is available])
+	ZFS_LINUX_TEST_RESULT([blk_queue_zoned_model], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_BLK_QUEUE_ZONED_MODEL, 1,
+		    [blk_queue_zoned_model() is available])
+	],[
+		AC_MSG_RESULT(no)
+
+		AC_MSG_CHECKING([whether bdev_is_zoned() is available])
+		ZFS_LINUX_TEST_RESULT([bdev_is_zoned], [
+			AC_MSG_RESULT(yes)
+			AC_DEFINE(HAVE_BDEV_IS_ZONED, 1,
+			    [bdev_is_zoned() is available])
+		],[
+			AC_MSG_RESULT(no)
+		])
+	])
+])
+
 AC_DEFUN([ZFS_AC_KERNEL_SRC_BLK_QUEUE], [
 	ZFS_AC_KERNEL_SRC_BLK_QUEUE_PLUG
 	ZFS_AC_KERNEL_SRC_BLK_QUEUE_BDI
@@ -276,6 +322,7 @@ AC_DEFUN([ZFS_AC_KERNEL_SRC_BLK_QUEUE], [
 	ZFS_AC_KERNEL_SRC_BLK_QUEUE_UPDATE_READAHEAD
 	ZFS_AC_KERNEL_SRC_BLK_QUEUE_DISCARD
 	ZFS_AC_KERNEL_SRC_BLK_QUEUE_SECURE_ERASE
+	ZFS_AC_KERNEL_SRC_BLK_QUEUE_ZONED
 	ZFS_AC_KERNEL_SRC_BLK_QUEUE_MAX_HW_SECTORS
 	ZFS_AC_KERNEL_SRC_BLK_QUEUE_MAX_SEGMENTS
 	ZFS_AC_KERNEL_SRC_BLK_MQ_RQ_HCTX
@@ -288,6 +335,7 @@ AC_DEFUN([ZFS_AC_KERNEL_BLK_QUEUE], [
 	ZFS_AC_KERNEL_BLK_QUEUE_UPDATE_READAHEAD
 	ZFS_AC_KERNEL_BLK_QUEUE_DISCARD
 	ZFS_AC_KERNEL_BLK_QUEUE_SECURE_ERASE
+	ZFS_AC_KERNEL_BLK_QUEUE_ZONED
 	ZFS_AC_KERNEL_BLK_QUEUE_MAX_HW_SECTORS
 	ZFS_AC_KERNEL_BLK_QUEUE_MAX_SEGMENTS
 	ZFS_AC_KERNEL_BLK_MQ_RQ_HCTX
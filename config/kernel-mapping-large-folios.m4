@@ -0,0 +1,30 @@
+AC_DEFUN([ZFS_AC_KERNEL_SRC_MAPPING_LARGE_FOLIOS], [
+	dnl #
+	dnl # 5.17 API change
+	dnl # mapping_set_large_folios() lets a filesystem opt in to page
+	dnl # cache folios larger than a single page.  We also need
+	dnl # readahead_folio() and flush_dcache_folio() to handle them.
+	dnl #
+	ZFS_LINUX_TEST_SRC([mapping_set_large_folios], [
+		#include <linux/pagemap.h>
+		#include <linux/highmem.h>
+	],[
+		struct address_space *mapping = NULL;
+		struct readahead_control *ractl = NULL;
+		struct folio *folio __attribute__ ((unused));
+		mapping_set_large_folios(mapping);
+		folio = readahead_folio(ractl);
+		flush_dcache_folio(folio);
+	])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_MAPPING_LARGE_FOLIOS], [
+	AC_MSG_CHECKING([whether mapping_set_large_folios() exists])
+	ZFS_LINUX_TEST_RESULT([mapping_set_large_folios], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_MAPPING_LARGE_FOLIOS, 1,
+		    [mapping_set_large_folios() exists])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
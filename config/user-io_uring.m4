@@ -0,0 +1,22 @@
+dnl #
+dnl # Check for <linux/io_uring.h> - used by libzpool to issue file vdev
+dnl # I/O asynchronously.  IORING_OP_READ and IORING_OP_WRITE are 5.6+.
+dnl #
+AC_DEFUN([ZFS_AC_CONFIG_USER_IO_URING], [
+	AC_MSG_CHECKING([for IORING_OP_READ in linux/io_uring.h])
+	AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[
+		#include <sys/syscall.h>
+		#include <linux/io_uring.h>
+	]], [[
+		long nr = __NR_io_uring_setup;
+		int op = IORING_OP_READ;
+		(void) nr;
+		(void) op;
+	]])],[
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_LINUX_IO_URING, 1,
+		    [linux/io_uring.h provides IORING_OP_READ])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
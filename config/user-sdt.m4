@@ -0,0 +1,19 @@
+dnl #
+dnl # Check for systemtap's <sys/sdt.h>, so that the DTRACE_PROBE points of
+dnl # libzpool can be built as USDT probes.
+dnl #
+AC_DEFUN([ZFS_AC_CONFIG_USER_SDT], [
+	AC_MSG_CHECKING([for USDT probe support in sys/sdt.h])
+	AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[
+		#include <sys/sdt.h>
+	]], [[
+		int x = 0;
+		STAP_PROBE1(zfs, test, x);
+	]])],[
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_SYS_SDT_H, 1,
+		    [sys/sdt.h provides USDT probes])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
@@ -165,6 +165,11 @@ _LIBZFS_CORE_H int lzc_scrub(zfs_ioc_t, const char *, nvlist_t *, nvlist_t **);
 _LIBZFS_CORE_H int lzc_ddt_prune(const char *, zpool_ddt_prune_unit_t,
     uint64_t);
 
+_LIBZFS_CORE_H int lzc_list_bulk(const char *, nvlist_t *, nvlist_t **);
+_LIBZFS_CORE_H int lzc_objs_to_stats(const char *, const uint64_t *, uint_t,
+    nvlist_t **);
+_LIBZFS_CORE_H int lzc_prefetch(const char *, nvlist_t *);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -191,6 +191,45 @@ zfs_shani_available(void)
 	return (has_shani && __ymm_enabled());
 }
 
+/*
+ * Check if GFNI instruction set is available
+ */
+static inline boolean_t
+zfs_gfni_available(void)
+{
+#if defined(CPUID_STDEXT2_GFNI)
+	return ((cpu_stdext_feature2 & CPUID_STDEXT2_GFNI) != 0);
+#else
+	return (B_FALSE);
+#endif
+}
+
+/*
+ * Check if VAES instruction set is available
+ */
+static inline boolean_t
+zfs_vaes_available(void)
+{
+#if defined(CPUID_STDEXT2_VAES)
+	return ((cpu_stdext_feature2 & CPUID_STDEXT2_VAES) != 0);
+#else
+	return (B_FALSE);
+#endif
+}
+
+/*
+ * Check if VPCLMULQDQ instruction set is available
+ */
+static inline boolean_t
+zfs_vpclmulqdq_available(void)
+{
+#if defined(CPUID_STDEXT2_VPCLMULQDQ)
+	return ((cpu_stdext_feature2 & CPUID_STDEXT2_VPCLMULQDQ) != 0);
+#else
+	return (B_FALSE);
+#endif
+}
+
 /*
  * AVX-512 family of instruction sets:
  *
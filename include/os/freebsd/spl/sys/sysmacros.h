@@ -82,6 +82,10 @@ extern "C" {
 #define	kpreempt_enable() critical_exit()
 #define	CPU_SEQID curcpu
 #define	CPU_SEQID_UNSTABLE curcpu
+#define	boot_nnodes 1
+#define	CPU_NODE 0
+#define	spl_node_index(node) ((void) (node), 0)
+#define	spl_node_id(index) ((void) (index), 0)
 #define	is_system_labeled()		0
 /*
  * Convert a single byte to/from binary-coded decimal (BCD).
@@ -76,6 +76,9 @@ struct zfsvfs {
 	zfs_teardown_inactive_lock_t z_teardown_inactive_lock;
 	list_t		z_all_znodes;	/* all vnodes in the fs */
 	kmutex_t	z_znodes_lock;	/* lock for z_all_znodes */
+	kmutex_t	z_async_lock;	/* lock for z_async_reads */
+	kcondvar_t	z_async_cv;	/* signalled as async reads finish */
+	uint64_t	z_async_reads;	/* zfs_read_async() reads in flight */
 	struct zfsctl_root	*z_ctldir;	/* .zfs directory pointer */
 	uint_t		z_show_ctldir;	/* how to expose .zfs in the root dir */
 	boolean_t	z_issnap;	/* true if this is a snapshot */
@@ -102,7 +105,6 @@ struct zfsvfs {
 	uint64_t	z_defaultuserobjquota;
 	uint64_t	z_defaultgroupobjquota;
 	uint64_t	z_defaultprojectobjquota;
-	uint64_t	z_replay_eof;	/* New end of file - replay only */
 	sa_attr_type_t	*z_attr_table;	/* SA attr mapping->id */
 #define	ZFS_OBJ_MTX_SZ	64
 	kmutex_t	z_hold_mtx[ZFS_OBJ_MTX_SZ];	/* znode hold locks */
@@ -452,6 +452,53 @@ bdev_discard_supported(struct block_device *bdev)
 #endif
 }
 
+/*
+ * 6.10 API,
+ *   bdev_is_zoned(), true only for host-managed devices
+ *
+ * 4.10 API,
+ *   blk_queue_zoned_model()
+ *
+ * Host-managed zoned devices (SMR drives, ZNS SSDs) fail any write that
+ * is not at the write pointer of its zone.  Host-aware ones accept
+ * random writes and are treated like any other disk.
+ */
+static inline boolean_t
+bdev_is_host_managed(struct block_device *bdev)
+{
+#if defined(HAVE_BLK_QUEUE_ZONED_MODEL)
+	return (blk_queue_zoned_model(bdev_get_queue(bdev)) == BLK_ZONED_HM);
+#elif defined(HAVE_BDEV_IS_ZONED)
+	return (bdev_is_zoned(bdev));
+#else
+	return (B_FALSE);
+#endif
+}
+
+/*
+ * Discard granularity and largest single discard, in bytes.
+ */
+static inline uint64_t
+bdev_discard_granularity_bytes(struct block_device *bdev)
+{
+#if defined(HAVE_BDEV_MAX_DISCARD_SECTORS)
+	return (bdev_discard_granularity(bdev));
+#else
+	return (bdev_get_queue(bdev)->limits.discard_granularity);
+#endif
+}
+
+static inline uint64_t
+bdev_max_discard_bytes(struct block_device *bdev)
+{
+#if defined(HAVE_BDEV_MAX_DISCARD_SECTORS)
+	return ((uint64_t)bdev_max_discard_sectors(bdev) << 9);
+#else
+	return ((uint64_t)
+	    bdev_get_queue(bdev)->limits.max_discard_sectors << 9);
+#endif
+}
+
 /*
  * 5.19 API,
  *   bdev_max_secure_erase_sectors()
@@ -55,6 +55,9 @@
  *	zfs_bmi2_available()
  *
  *	zfs_shani_available()
+ *	zfs_gfni_available()
+ *	zfs_vaes_available()
+ *	zfs_vpclmulqdq_available()
  *
  *	zfs_avx512f_available()
  *	zfs_avx512cd_available()
@@ -611,6 +614,45 @@ zfs_shani_available(void)
 #endif
 }
 
+/*
+ * Check if GFNI instruction set is available
+ */
+static inline boolean_t
+zfs_gfni_available(void)
+{
+#if defined(X86_FEATURE_GFNI)
+	return (!!boot_cpu_has(X86_FEATURE_GFNI));
+#else
+	return (B_FALSE);
+#endif
+}
+
+/*
+ * Check if VAES instruction set is available
+ */
+static inline boolean_t
+zfs_vaes_available(void)
+{
+#if defined(X86_FEATURE_VAES)
+	return (!!boot_cpu_has(X86_FEATURE_VAES));
+#else
+	return (B_FALSE);
+#endif
+}
+
+/*
+ * Check if VPCLMULQDQ instruction set is available
+ */
+static inline boolean_t
+zfs_vpclmulqdq_available(void)
+{
+#if defined(X86_FEATURE_VPCLMULQDQ)
+	return (!!boot_cpu_has(X86_FEATURE_VPCLMULQDQ));
+#else
+	return (B_FALSE);
+#endif
+}
+
 /*
  * AVX-512 family of instruction sets:
  *
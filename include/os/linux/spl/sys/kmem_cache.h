@@ -106,6 +106,7 @@ typedef struct spl_kmem_magazine {
 	uint32_t		skm_refill;	/* Batch refill size */
 	struct spl_kmem_cache	*skm_cache;	/* Owned by cache */
 	unsigned int		skm_cpu;	/* Owned by cpu */
+	struct list_head	skm_list;	/* Depot list linkage */
 	void			*skm_objs[];	/* Object pointers */
 } spl_kmem_magazine_t;
 
@@ -144,6 +145,11 @@ typedef struct spl_kmem_cache {
 	spl_kmem_magazine_t	**skc_mag;	/* Per-CPU warm cache */
 	uint32_t		skc_mag_size;	/* Magazine size */
 	uint32_t		skc_mag_refill;	/* Magazine refill count */
+	spinlock_t		skc_depot_lock;	/* Magazine depot lock */
+	struct list_head	skc_depot_full;	/* Depot full magazines */
+	struct list_head	skc_depot_empty; /* Depot empty magazines */
+	uint32_t		skc_depot_nfull; /* # full magazines in depot */
+	uint32_t		skc_depot_contention; /* Depot contention */
 	spl_kmem_ctor_t		skc_ctor;	/* Constructor */
 	spl_kmem_dtor_t		skc_dtor;	/* Destructor */
 	void			*skc_private;	/* Private data */
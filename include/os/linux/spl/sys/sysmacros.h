@@ -29,6 +29,7 @@
 #include <linux/sched.h>
 #include <linux/sched/rt.h>
 #include <linux/cpumask.h>
+#include <linux/nodemask.h>
 #include <sys/debug.h>
 #include <sys/zone.h>
 #include <sys/signal.h>
@@ -78,6 +79,8 @@
 #define	boot_ncpus			num_online_cpus()
 #define	CPU_SEQID			smp_processor_id()
 #define	CPU_SEQID_UNSTABLE		raw_smp_processor_id()
+#define	boot_nnodes			num_node_state(N_CPU)
+#define	CPU_NODE			numa_node_id()
 #define	is_system_labeled()		0
 
 #ifndef RLIM64_INFINITY
@@ -119,6 +122,8 @@ extern unsigned long spl_hostid;
 /* Missing misc functions */
 extern uint32_t zone_get_hostid(void *zone);
 extern void spl_setup(void);
+extern int spl_node_index(int node);
+extern int spl_node_id(int index);
 extern void spl_cleanup(void);
 
 /*
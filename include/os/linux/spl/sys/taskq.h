@@ -48,6 +48,7 @@
 #define	TASKQ_DYNAMIC		0x00000004
 #define	TASKQ_THREADS_CPU_PCT	0x00000008
 #define	TASKQ_DC_BATCH		0x00000010
+#define	TASKQ_STEAL		0x00000020
 #define	TASKQ_ACTIVE		0x80000000
 
 /*
@@ -102,11 +103,20 @@ typedef struct taskq_sums {
 	wmsum_t tqs_tasks_executed;		/* total tasks executed */
 	wmsum_t tqs_tasks_delayed_requeued;	/* delayed tasks requeued */
 	wmsum_t tqs_tasks_cancelled;		/* tasks cancelled before run */
+	wmsum_t tqs_tasks_stolen;		/* tasks run from other queue */
 	wmsum_t tqs_thread_wakeups;		/* total thread wakeups */
 	wmsum_t tqs_thread_wakeups_nowork;	/* thread woken but no tasks */
 	wmsum_t tqs_thread_sleeps;		/* total thread sleeps */
 } taskq_sums_t;
 
+/*
+ * Per-thread queue of a work-stealing (TASKQ_STEAL) taskq.
+ */
+typedef struct taskq_steal_queue {
+	spinlock_t		tqsq_lock;	/* protects tqsq_list */
+	struct list_head	tqsq_list;	/* queued taskq_ent_t's */
+} ____cacheline_aligned taskq_steal_queue_t;
+
 typedef struct taskq {
 	spinlock_t		tq_lock;	/* protects taskq_t */
 	char			*tq_name;	/* taskq name */
@@ -137,7 +147,11 @@ typedef struct taskq {
 	/* list node for the cpu hotplug callback */
 	struct hlist_node	tq_hp_cb_node;
 	boolean_t		tq_hp_support;
+	int			tq_node;	/* NUMA node, or NUMA_NO_NODE */
+	int			tq_node_cpu;	/* last CPU bound on tq_node */
 	unsigned long		lastspawnstop;	/* when to purge dynamic */
+	taskq_steal_queue_t	*tq_steal_queues; /* TASKQ_STEAL queues */
+	int			tq_nsteal_queues; /* # of tq_steal_queues */
 	taskq_sums_t		tq_sums;
 	kstat_t			*tq_ksp;
 } taskq_t;
@@ -173,6 +187,7 @@ typedef struct taskq_thread {
 	taskqid_t		tqt_id;
 	taskq_ent_t		*tqt_task;
 	uintptr_t		tqt_flags;
+	int			tqt_steal_queue; /* own TASKQ_STEAL queue */
 } taskq_thread_t;
 
 /* Global system-wide dynamic task queue available for all consumers */
@@ -192,6 +207,8 @@ extern void taskq_dispatch_ent(taskq_t *, task_func_t, void *, uint_t,
 extern int taskq_empty_ent(taskq_ent_t *);
 extern void taskq_init_ent(taskq_ent_t *);
 extern taskq_t *taskq_create(const char *, int, pri_t, int, int, uint_t);
+extern taskq_t *taskq_create_node(const char *, int, pri_t, int, int, uint_t,
+    int);
 extern taskq_t *taskq_create_synced(const char *, int, pri_t, int, int, uint_t,
     kthread_t ***);
 extern void taskq_destroy(taskq_t *);
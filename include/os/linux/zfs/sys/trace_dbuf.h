@@ -143,6 +143,66 @@ DEFINE_EVENT(zfs_dbuf_evict_one_class, name, \
     TP_ARGS(db, mls))
 DEFINE_DBUF_EVICT_ONE_EVENT(zfs_dbuf__evict__one);
 
+/*
+ * Generic support for two argument tracepoints of the form:
+ *
+ * DTRACE_PROBE2(...,
+ *     dmu_buf_impl_t *, ...,
+ *     const void *, ...);
+ */
+/* BEGIN CSTYLED */
+DECLARE_EVENT_CLASS(zfs_dbuf_hold_class,
+	TP_PROTO(dmu_buf_impl_t *db, const void *tag),
+	TP_ARGS(db, tag),
+	TP_STRUCT__entry(
+	    DBUF_TP_STRUCT_ENTRY
+	    __field(const void *, tag)
+	),
+	TP_fast_assign(
+	    DBUF_TP_FAST_ASSIGN
+	    __entry->tag = tag;
+	),
+	TP_printk(DBUF_TP_PRINTK_FMT " tag %p", DBUF_TP_PRINTK_ARGS,
+	    __entry->tag)
+);
+/* END CSTYLED */
+
+#define	DEFINE_DBUF_HOLD_EVENT(name) \
+DEFINE_EVENT(zfs_dbuf_hold_class, name, \
+    TP_PROTO(dmu_buf_impl_t *db, const void *tag), \
+    TP_ARGS(db, tag))
+DEFINE_DBUF_HOLD_EVENT(zfs_dbuf__hold);
+
+/*
+ * Generic support for two argument tracepoints of the form:
+ *
+ * DTRACE_PROBE2(...,
+ *     dmu_buf_impl_t *, ...,
+ *     dmu_tx_t *, ...);
+ */
+/* BEGIN CSTYLED */
+DECLARE_EVENT_CLASS(zfs_dbuf_dirty_class,
+	TP_PROTO(dmu_buf_impl_t *db, dmu_tx_t *tx),
+	TP_ARGS(db, tx),
+	TP_STRUCT__entry(
+	    DBUF_TP_STRUCT_ENTRY
+	    __field(uint64_t, txg)
+	),
+	TP_fast_assign(
+	    DBUF_TP_FAST_ASSIGN
+	    __entry->txg = tx->tx_txg;
+	),
+	TP_printk(DBUF_TP_PRINTK_FMT " txg %llu", DBUF_TP_PRINTK_ARGS,
+	    __entry->txg)
+);
+/* END CSTYLED */
+
+#define	DEFINE_DBUF_DIRTY_EVENT(name) \
+DEFINE_EVENT(zfs_dbuf_dirty_class, name, \
+    TP_PROTO(dmu_buf_impl_t *db, dmu_tx_t *tx), \
+    TP_ARGS(db, tx))
+DEFINE_DBUF_DIRTY_EVENT(zfs_dbuf__dirty);
+
 #endif /* _TRACE_DBUF_H */
 
 #undef TRACE_INCLUDE_PATH
@@ -156,6 +216,8 @@ DEFINE_DBUF_EVICT_ONE_EVENT(zfs_dbuf__evict__one);
 DEFINE_DTRACE_PROBE2(blocked__read);
 DEFINE_DTRACE_PROBE2(dbuf__evict__one);
 DEFINE_DTRACE_PROBE2(dbuf__state_change);
+DEFINE_DTRACE_PROBE2(dbuf__hold);
+DEFINE_DTRACE_PROBE2(dbuf__dirty);
 
 #endif /* HAVE_DECLARE_EVENT_CLASS */
 #endif /* _KERNEL */
@@ -255,6 +255,38 @@ DEFINE_EVENT(zfs_zil_block_size_class, name, \
     TP_ARGS(zilog, res, s1))
 DEFINE_ZIL_BLOCK_SIZE_EVENT(zfs_zil__block__size);
 
+/*
+ * Generic support for two argument tracepoints of the form:
+ *
+ * DTRACE_PROBE2(...,
+ *     zilog_t *, ...,
+ *     uint64_t, ...);
+ */
+/* BEGIN CSTYLED */
+DECLARE_EVENT_CLASS(zfs_zil_commit_class,
+	TP_PROTO(zilog_t *zilog, uint64_t foid),
+	TP_ARGS(zilog, foid),
+	TP_STRUCT__entry(
+	    ZILOG_TP_STRUCT_ENTRY
+	    __field(uint64_t, foid)
+	),
+	TP_fast_assign(
+	    ZILOG_TP_FAST_ASSIGN
+	    __entry->foid = foid;
+	),
+	TP_printk(
+	    ZILOG_TP_PRINTK_FMT " foid %llu",
+	    ZILOG_TP_PRINTK_ARGS, __entry->foid)
+);
+/* END CSTYLED */
+
+#define	DEFINE_ZIL_COMMIT_EVENT(name) \
+DEFINE_EVENT(zfs_zil_commit_class, name, \
+    TP_PROTO(zilog_t *zilog, uint64_t foid), \
+    TP_ARGS(zilog, foid))
+DEFINE_ZIL_COMMIT_EVENT(zfs_zil__commit__start);
+DEFINE_ZIL_COMMIT_EVENT(zfs_zil__commit__done);
+
 #endif /* _TRACE_ZIL_H */
 
 #undef TRACE_INCLUDE_PATH
@@ -269,6 +301,8 @@ DEFINE_DTRACE_PROBE2(zil__process__commit__itx);
 DEFINE_DTRACE_PROBE2(zil__process__normal__itx);
 DEFINE_DTRACE_PROBE2(zil__commit__io__error);
 DEFINE_DTRACE_PROBE3(zil__block__size);
+DEFINE_DTRACE_PROBE2(zil__commit__start);
+DEFINE_DTRACE_PROBE2(zil__commit__done);
 
 #endif /* HAVE_DECLARE_EVENT_CLASS */
 #endif /* _KERNEL */
@@ -78,8 +78,31 @@ TRACE_EVENT(zfs_zio__delay__skip,
 	TP_fast_assign(ZIO_TP_FAST_ASSIGN),
 	TP_printk(ZIO_TP_PRINTK_FMT, ZIO_TP_PRINTK_ARGS)
 );
+
+/*
+ * Generic support for one argument tracepoints of the form:
+ *
+ * DTRACE_PROBE1(...,
+ *     zio_t *, ...);
+ */
+DECLARE_EVENT_CLASS(zfs_zio_class,
+	TP_PROTO(zio_t *zio),
+	TP_ARGS(zio),
+	TP_STRUCT__entry(ZIO_TP_STRUCT_ENTRY),
+	TP_fast_assign(ZIO_TP_FAST_ASSIGN),
+	TP_printk(ZIO_TP_PRINTK_FMT, ZIO_TP_PRINTK_ARGS)
+);
 /* END CSTYLED */
 
+#define	DEFINE_ZIO_EVENT(name) \
+DEFINE_EVENT(zfs_zio_class, name, \
+    TP_PROTO(zio_t *zio), \
+    TP_ARGS(zio))
+DEFINE_ZIO_EVENT(zfs_zio__create);
+DEFINE_ZIO_EVENT(zfs_zio__done);
+DEFINE_ZIO_EVENT(zfs_vdev__queue__enqueue);
+DEFINE_ZIO_EVENT(zfs_vdev__queue__issue);
+
 #endif /* _TRACE_ZIO_H */
 
 #undef TRACE_INCLUDE_PATH
@@ -93,6 +116,10 @@ TRACE_EVENT(zfs_zio__delay__skip,
 DEFINE_DTRACE_PROBE2(zio__delay__miss);
 DEFINE_DTRACE_PROBE3(zio__delay__hit);
 DEFINE_DTRACE_PROBE1(zio__delay__skip);
+DEFINE_DTRACE_PROBE1(zio__create);
+DEFINE_DTRACE_PROBE1(zio__done);
+DEFINE_DTRACE_PROBE1(vdev__queue__enqueue);
+DEFINE_DTRACE_PROBE1(vdev__queue__issue);
 
 #endif /* HAVE_DECLARE_EVENT_CLASS */
 #endif /* _KERNEL */
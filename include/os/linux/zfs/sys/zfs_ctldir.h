@@ -36,6 +36,8 @@
 #include <sys/pathname.h>
 #include <sys/zfs_vfsops.h>
 #include <sys/zfs_znode.h>
+#include <sys/zfs_refcount.h>
+#include <sys/avl.h>
 
 #define	ZFS_CTLDIR_NAME		".zfs"
 #define	ZFS_SNAPDIR_NAME	"snapshot"
@@ -50,6 +52,28 @@
 
 extern int zfs_expire_snapshot;
 
+/*
+ * A snapshot of the '.zfs/snapshot' directory listing, rebuilt whenever
+ * dmu_objset_snap_gen() changes.  Entries are kept in readdir order and
+ * indexed by the readdir offset at which they are returned, so readdir
+ * can resume from the cache without a ZAP lookup per entry.
+ */
+typedef struct zfs_snapdir_entry {
+	avl_node_t	sde_node;	/* sc_tree link */
+	uint64_t	sde_pos;	/* readdir offset of this entry */
+	uint64_t	sde_next;	/* readdir offset of the next entry */
+	uint64_t	sde_id;		/* snapshot objset id */
+	char		*sde_name;	/* snapshot name */
+} zfs_snapdir_entry_t;
+
+typedef struct zfs_snapdir_cache {
+	zfs_refcount_t	sc_refcount;	/* reference count */
+	uint64_t	sc_gen;		/* dmu_objset_snap_gen() when built */
+	uint64_t	sc_count;	/* number of sc_entries */
+	zfs_snapdir_entry_t *sc_entries; /* entries in readdir order */
+	avl_tree_t	sc_tree;	/* entries indexed by sde_pos */
+} zfs_snapdir_cache_t;
+
 /* zfsctl generic functions */
 extern int zfsctl_create(zfsvfs_t *);
 extern void zfsctl_destroy(zfsvfs_t *);
@@ -81,6 +105,12 @@ extern int zfsctl_snapshot_unmount_delay(spa_t *spa, uint64_t objsetid,
     int delay);
 extern int zfsctl_snapdir_vget(struct super_block *sb, uint64_t objsetid,
     int gen, struct inode **ipp);
+extern zfs_snapdir_cache_t *zfsctl_snapdir_cache_hold(zfsvfs_t *zfsvfs,
+    const void *tag);
+extern void zfsctl_snapdir_cache_rele(zfs_snapdir_cache_t *sc,
+    const void *tag);
+extern zfs_snapdir_entry_t *zfsctl_snapdir_cache_find(zfs_snapdir_cache_t *sc,
+    uint64_t pos);
 
 /* zfsctl '.zfs/shares' functions */
 extern int zfsctl_shares_lookup(struct inode *dip, char *name,
@@ -110,8 +110,13 @@ struct zfsvfs {
 	unsigned long	z_rollback_time; /* last online rollback time */
 	unsigned long	z_snap_defer_time; /* last snapshot unmount deferral */
 	kmutex_t	z_znodes_lock;	/* lock for z_all_znodes */
+	kmutex_t	z_async_lock;	/* lock for z_async_reads */
+	kcondvar_t	z_async_cv;	/* signalled as async reads finish */
+	uint64_t	z_async_reads;	/* zfs_read_async() reads in flight */
 	arc_prune_t	*z_arc_prune;	/* called by ARC to prune caches */
 	struct inode	*z_ctldir;	/* .zfs directory inode */
+	kmutex_t	z_snapdir_lock;	/* protects z_snapdir_cache */
+	struct zfs_snapdir_cache *z_snapdir_cache; /* .zfs/snapshot names */
 	uint_t		z_show_ctldir;	/* how to expose .zfs in the root dir */
 	boolean_t	z_issnap;	/* true if this is a snapshot */
 	boolean_t	z_use_fuids;	/* version allows fuids */
@@ -137,11 +142,11 @@ struct zfsvfs {
 	uint64_t	z_defaultuserobjquota;
 	uint64_t	z_defaultgroupobjquota;
 	uint64_t	z_defaultprojectobjquota;
-	uint64_t	z_replay_eof;	/* New end of file - replay only */
 	sa_attr_type_t	*z_attr_table;	/* SA attr mapping->id */
 	uint64_t	z_hold_size;	/* znode hold array size */
 	avl_tree_t	*z_hold_trees;	/* znode hold trees */
 	kmutex_t	*z_hold_locks;	/* znode hold locks */
+	struct zfs_stale_fid *z_stale_fids; /* recently freed obj/gen pairs */
 	taskqid_t	z_drain_task;	/* task id for the unlink drain task */
 };
 
@@ -201,6 +206,20 @@ struct zfsvfs {
  * We reserve only 48 bits for the object number, as this is the limit
  * currently defined and imposed by the DMU.
  */
+/*
+ * Objects recently freed from this filesystem, with their generation.  A
+ * file handle naming one of them can be rejected by zfs_vget() without
+ * reading the dnode or instantiating a znode.  There are
+ * ZFS_STALE_FIDS_PER_HOLD slots per znode hold lock, indexed by object
+ * number, so each slot is protected by the hold lock of its object.
+ */
+#define	ZFS_STALE_FIDS_PER_HOLD	16
+
+typedef struct zfs_stale_fid {
+	uint64_t	zsf_obj;
+	uint64_t	zsf_gen;
+} zfs_stale_fid_t;
+
 typedef struct zfid_short {
 	uint16_t	zf_len;
 	uint8_t		zf_object[6];		/* obj[i] = obj >> (8 * i) */
@@ -254,6 +273,8 @@ extern int zfs_statvfs(struct inode *ip, struct kstatfs *statp);
 extern int zfs_vget(struct super_block *sb, struct inode **ipp, fid_t *fidp);
 extern int zfs_prune(struct super_block *sb, unsigned long nr_to_scan,
     int *objects);
+extern uint64_t zfs_prune_count(struct super_block *sb);
+extern void zfs_stale_fid_add(zfsvfs_t *zfsvfs, uint64_t obj, uint64_t gen);
 extern int zfs_get_temporary_prop(dsl_dataset_t *ds, zfs_prop_t zfs_prop,
     uint64_t *val, char *setpoint);
 extern int zfs_set_default_quota(zfsvfs_t *zfsvfs, zfs_prop_t zfs_prop,
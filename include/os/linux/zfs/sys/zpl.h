@@ -53,6 +53,7 @@ extern const struct file_operations zpl_dir_file_operations;
 
 /* zpl_super.c */
 extern void zpl_prune_sb(uint64_t nr_to_scan, void *arg);
+extern uint64_t zpl_prune_count_sb(void *arg);
 
 extern const struct super_operations zpl_super_operations;
 extern const struct export_operations zpl_export_operations;
@@ -123,6 +124,9 @@ extern int zpl_clone_file_range(struct file *src_file, loff_t src_off,
 extern int zpl_dedupe_file_range(struct file *src_file, loff_t src_off,
     struct file *dst_file, loff_t dst_off, uint64_t len);
 
+/* ZFS_IOC_CLONE_BATCH */
+extern long zpl_ioctl_clone_batch(void __user *arg);
+
 
 #if defined(HAVE_INODE_TIMESTAMP_TRUNCATE)
 #define	zpl_inode_timestamp_truncate(ts, ip)	timestamp_truncate(ts, ip)
@@ -97,6 +97,7 @@ abd_t *abd_get_zeros(size_t);
 abd_t *abd_get_from_buf(void *, size_t);
 abd_t *abd_get_from_buf_struct(abd_t *, void *, size_t);
 void abd_cache_reap_now(void);
+int abd_numa_node(abd_t *);
 
 /*
  * Conversion to and from a normal buffer
@@ -90,6 +90,7 @@ typedef void arc_read_done_func_t(zio_t *zio, const zbookmark_phys_t *zb,
     const blkptr_t *bp, arc_buf_t *buf, void *priv);
 typedef void arc_write_done_func_t(zio_t *zio, arc_buf_t *buf, void *priv);
 typedef void arc_prune_func_t(uint64_t bytes, void *priv);
+typedef uint64_t arc_prune_count_func_t(void *priv);
 
 /* Shared module parameters */
 extern uint_t zfs_arc_average_blocksize;
@@ -102,8 +103,10 @@ arc_read_done_func_t arc_getbuf_func;
 /* generic arc_prune_func_t wrapper for callbacks */
 struct arc_prune {
 	arc_prune_func_t	*p_pfunc;
+	arc_prune_count_func_t	*p_cfunc;
 	void			*p_private;
 	uint64_t		p_adjust;
+	uint64_t		p_count;
 	list_node_t		p_node;
 	zfs_refcount_t		p_refcnt;
 };
@@ -176,7 +179,7 @@ typedef enum arc_flags
 	ARC_FLAG_NO_BUF			= 1 << 23,
 
 	/*
-	 * The arc buffer's compression mode is stored in the top 7 bits of the
+	 * The arc buffer's compression mode is stored in bits 24-29 of the
 	 * flags field, so these dummy flags are included so that MDB can
 	 * interpret the enum properly.
 	 */
@@ -186,7 +189,14 @@ typedef enum arc_flags
 	ARC_FLAG_COMPRESS_3		= 1 << 27,
 	ARC_FLAG_COMPRESS_4		= 1 << 28,
 	ARC_FLAG_COMPRESS_5		= 1 << 29,
-	ARC_FLAG_COMPRESS_6		= 1 << 30
+
+	/*
+	 * Public flag: the read is done for a dataset with arcpriority=low.
+	 * A buffer it brings into the cache is never promoted to the MFU
+	 * state and its ghost hits do not grow the MRU target, so it cannot
+	 * push out other datasets' MFU data.
+	 */
+	ARC_FLAG_LOW_PRIORITY		= 1 << 30,
 } arc_flags_t;
 
 typedef enum arc_buf_flags {
@@ -257,6 +267,17 @@ typedef struct arc_buf_info {
 	enum zio_compress	abi_l2arc_compress;
 } arc_buf_info_t;
 
+/*
+ * One block of an arc_read_many() batch.
+ */
+typedef struct arc_read_req {
+	const blkptr_t		*arr_bp;
+	const zbookmark_phys_t	*arr_zb;
+	void			*arr_private;	/* passed to the done func */
+	arc_flags_t		arr_flags;	/* see arc_read() *arc_flags */
+	int			arr_zio_flags;
+} arc_read_req_t;
+
 /*
  * Flags returned by arc_cached; describes which part of the arc
  * the block is cached in.
@@ -318,6 +339,8 @@ int arc_referenced(arc_buf_t *buf);
 int arc_read(zio_t *pio, spa_t *spa, const blkptr_t *bp,
     arc_read_done_func_t *done, void *priv, zio_priority_t priority,
     int flags, arc_flags_t *arc_flags, const zbookmark_phys_t *zb);
+int arc_read_many(zio_t *pio, spa_t *spa, arc_read_req_t *reqs,
+    uint_t count, arc_read_done_func_t *done, zio_priority_t priority);
 zio_t *arc_write(zio_t *pio, spa_t *spa, uint64_t txg, blkptr_t *bp,
     arc_buf_t *buf, boolean_t uncached, boolean_t l2arc, const zio_prop_t *zp,
     arc_write_done_func_t *ready, arc_write_done_func_t *child_ready,
@@ -325,8 +348,11 @@ zio_t *arc_write(zio_t *pio, spa_t *spa, uint64_t txg, blkptr_t *bp,
     int zio_flags, const zbookmark_phys_t *zb);
 
 arc_prune_t *arc_add_prune_callback(arc_prune_func_t *func, void *priv);
+arc_prune_t *arc_add_prune_count_callback(arc_prune_func_t *func,
+    arc_prune_count_func_t *count, void *priv);
 void arc_remove_prune_callback(arc_prune_t *p);
 void arc_freed(spa_t *spa, const blkptr_t *bp);
+void arc_uncache(spa_t *spa, const blkptr_t *bp);
 int arc_cached(spa_t *spa, const blkptr_t *bp);
 
 void arc_flush(spa_t *spa, boolean_t retry);
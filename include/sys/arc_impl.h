@@ -390,6 +390,9 @@ typedef struct l2arc_dev {
 	list_t			l2ad_buflist;	/* buffer list */
 	list_node_t		l2ad_node;	/* device list node */
 	zfs_refcount_t		l2ad_alloc;	/* allocated bytes */
+	boolean_t		l2ad_feeding;	/* feed task dispatched */
+	clock_t			l2ad_feed_next;	/* when to feed next */
+	taskq_ent_t		l2ad_feed_tqent; /* feed task entry */
 	/*
 	 * Persistence-related stuff
 	 */
@@ -456,12 +459,30 @@ typedef struct arc_buf_hdr_crypt {
 typedef struct l2arc_buf_hdr {
 	/* protected by arc_buf_hdr mutex */
 	l2arc_dev_t		*b_dev;		/* L2ARC device */
-	uint64_t		b_daddr;	/* disk address, offset byte */
-	uint32_t		b_hits;
-	arc_state_type_t	b_arcs_state;
+	uint64_t		b_l2prop;	/* see L2HDR_* macros */
 	list_node_t		b_l2node;
 } l2arc_buf_hdr_t;
 
+/*
+ * Every header in the L2ARC carries an l2arc_buf_hdr_t, and with large cache
+ * devices most of those belong to L2-only headers, so the device address,
+ * ARC state and hit count are packed into a single word of b_l2prop:
+ *
+ *	bits 0-47	disk address in SPA_MINBLOCKSIZE units (up to 128 PiB)
+ *	bits 48-51	arc_state_type_t the buffer was in when written
+ *	bits 52-63	L2ARC hits, saturating at L2HDR_HITS_MAX
+ */
+#define	L2HDR_GET_DADDR(l2hdr)		\
+	BF64_GET_SB((l2hdr)->b_l2prop, 0, 48, SPA_MINBLOCKSHIFT, 0)
+#define	L2HDR_SET_DADDR(l2hdr, x)	\
+	BF64_SET_SB((l2hdr)->b_l2prop, 0, 48, SPA_MINBLOCKSHIFT, 0, x)
+#define	L2HDR_GET_STATE(l2hdr)		\
+	((arc_state_type_t)BF64_GET((l2hdr)->b_l2prop, 48, 4))
+#define	L2HDR_SET_STATE(l2hdr, x)	BF64_SET((l2hdr)->b_l2prop, 48, 4, x)
+#define	L2HDR_HITS_MAX			((1U << 12) - 1)
+#define	L2HDR_GET_HITS(l2hdr)		BF64_GET((l2hdr)->b_l2prop, 52, 12)
+#define	L2HDR_SET_HITS(l2hdr, x)	BF64_SET((l2hdr)->b_l2prop, 52, 12, x)
+
 typedef struct l2arc_write_callback {
 	l2arc_dev_t	*l2wcb_dev;		/* device info */
 	arc_buf_hdr_t	*l2wcb_head;		/* head of write buflist */
@@ -601,6 +622,12 @@ typedef struct arc_stats {
 	 * above.
 	 */
 	kstat_named_t arcstat_uncompressed_size;
+	/*
+	 * Bytes of b_pabd and b_rabd held by headers which were read by an
+	 * arcpriority=low dataset.  Compared against
+	 * zfs_arc_low_priority_limit.
+	 */
+	kstat_named_t arcstat_low_priority_size;
 	/*
 	 * Number of bytes stored in all the arc_buf_t's. This is classified
 	 * as "overhead" since this data is typically short-lived and will
@@ -882,6 +909,12 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_memory_throttle_count;
 	kstat_named_t arcstat_memory_direct_count;
 	kstat_named_t arcstat_memory_indirect_count;
+	/*
+	 * Number of times, and bytes by which, arc_c was reduced because
+	 * direct reclaims exceeded zfs_arc_direct_reclaim_limit.
+	 */
+	kstat_named_t arcstat_memory_stall_shrink_count;
+	kstat_named_t arcstat_memory_stall_shrink_bytes;
 	kstat_named_t arcstat_memory_all_bytes;
 	kstat_named_t arcstat_memory_free_bytes;
 	kstat_named_t arcstat_memory_available_bytes;
@@ -909,6 +942,14 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_raw_size;
 	kstat_named_t arcstat_cached_only_in_progress;
 	kstat_named_t arcstat_abd_chunk_waste_size;
+	/* Decompressed bufs filled by copying from a sibling buf. */
+	kstat_named_t arcstat_buf_decompress_hits;
+	/* Decompressed bufs filled by decompressing the hdr data. */
+	kstat_named_t arcstat_buf_decompress_misses;
+	/* Buffers admitted to L2ARC by the l2arc_admit_lfu filter. */
+	kstat_named_t arcstat_l2_admit_accepts;
+	/* Buffers rejected by the l2arc_admit_lfu filter. */
+	kstat_named_t arcstat_l2_admit_rejects;
 } arc_stats_t;
 
 typedef struct arc_sums {
@@ -949,6 +990,7 @@ typedef struct arc_sums {
 	aggsum_t arcstat_size;
 	wmsum_t arcstat_compressed_size;
 	wmsum_t arcstat_uncompressed_size;
+	aggsum_t arcstat_low_priority_size;
 	wmsum_t arcstat_overhead_size;
 	wmsum_t arcstat_hdr_size;
 	wmsum_t arcstat_data_size;
@@ -998,6 +1040,8 @@ typedef struct arc_sums {
 	wmsum_t arcstat_memory_throttle_count;
 	wmsum_t arcstat_memory_direct_count;
 	wmsum_t arcstat_memory_indirect_count;
+	wmsum_t arcstat_memory_stall_shrink_count;
+	wmsum_t arcstat_memory_stall_shrink_bytes;
 	wmsum_t arcstat_prune;
 	wmsum_t arcstat_meta_used;
 	wmsum_t arcstat_async_upgrade_sync;
@@ -1010,8 +1054,17 @@ typedef struct arc_sums {
 	wmsum_t arcstat_raw_size;
 	wmsum_t arcstat_cached_only_in_progress;
 	wmsum_t arcstat_abd_chunk_waste_size;
+	wmsum_t arcstat_buf_decompress_hits;
+	wmsum_t arcstat_buf_decompress_misses;
+	wmsum_t arcstat_l2_admit_accepts;
+	wmsum_t arcstat_l2_admit_rejects;
 } arc_sums_t;
 
+extern void arc_mrc_init(void);
+extern void arc_mrc_fini(void);
+extern void arc_mrc_access(uint64_t spa, const dva_t *dva, uint64_t birth,
+    uint64_t size);
+
 typedef struct arc_evict_waiter {
 	list_node_t aew_node;
 	kcondvar_t aew_cv;
@@ -83,6 +83,9 @@ void Blake3_Init(BLAKE3_CTX *ctx);
 /* init the context for a MAC and/or tree hash operation */
 void Blake3_InitKeyed(BLAKE3_CTX *ctx, const uint8_t key[BLAKE3_KEY_LEN]);
 
+/* pick the implementation for hashing len bytes, before any update */
+void Blake3_SizeHint(BLAKE3_CTX *ctx, uint64_t len);
+
 /* process the input bytes */
 void Blake3_Update(BLAKE3_CTX *ctx, const void *input, size_t input_len);
 
@@ -93,6 +96,13 @@ void Blake3_Final(const BLAKE3_CTX *ctx, uint8_t *out);
 void Blake3_FinalSeek(const BLAKE3_CTX *ctx, uint64_t seek, uint8_t *out,
     size_t out_len);
 
+/* hash up to BLAKE3_MANY_MAX inputs of the same power of two length */
+#define	BLAKE3_MANY_MAX		32
+#define	BLAKE3_MANY_SCRATCH(n, len) \
+	((n) * (((len) / BLAKE3_CHUNK_LEN) * BLAKE3_OUT_LEN + BLAKE3_BLOCK_LEN))
+void Blake3_HashMany(const BLAKE3_CTX *ctx, const uint8_t * const *inputs,
+    size_t n, size_t len, uint8_t *out, uint8_t *scratch);
+
 /* these are pre-allocated contexts */
 extern void **blake3_per_cpu_ctx;
 extern void blake3_per_cpu_ctx_init(void);
@@ -58,6 +58,8 @@ void bptree_add(objset_t *os, uint64_t obj, blkptr_t *bp, uint64_t birth_txg,
 
 int bptree_iterate(objset_t *os, uint64_t obj, boolean_t free,
     bptree_itor_t func, void *arg, dmu_tx_t *tx);
+int bptree_get_entries(objset_t *os, uint64_t obj,
+    bptree_entry_phys_t *entries, uint64_t *count);
 
 #ifdef	__cplusplus
 }
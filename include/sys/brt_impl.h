@@ -87,20 +87,57 @@ typedef struct brt_vdev_phys {
 	uint64_t	bvp_savedspace;
 } brt_vdev_phys_t;
 
-struct brt_vdev {
+/*
+ * Entries of each VDEV are split by block offset into BRT_SHARDS shards, so
+ * that concurrent clones and frees of different blocks don't all serialize
+ * on one lock.
+ */
+#define	BRT_SHARDS_SHIFT	4
+#define	BRT_SHARDS		(1 << BRT_SHARDS_SHIFT)
+
+typedef struct brt_shard {
 	/*
 	 * Pending changes from open contexts.
 	 */
-	kmutex_t	bv_pending_lock;
-	avl_tree_t	bv_pending_tree[TXG_SIZE];
+	kmutex_t	bs_pending_lock ____cacheline_aligned;
+	avl_tree_t	bs_pending_tree[TXG_SIZE];
+	/*
+	 * Entries to sync.
+	 */
+	kmutex_t	bs_lock;
+	avl_tree_t	bs_tree;
+} brt_shard_t;
+
+/*
+ * Arrays of VDEVs replaced by a larger one. brt_vdev() reads spa_brt_vdevs
+ * without a lock, so these are kept until the BRT is unloaded.
+ */
+typedef struct brt_vdevs_retired {
+	brt_vdev_t			**bvr_vdevs;
+	uint64_t			bvr_nvdevs;
+	struct brt_vdevs_retired	*bvr_next;
+} brt_vdevs_retired_t;
+
+struct brt_vdev {
+	/*
+	 * Pending and to-be-synced entries, by block offset.
+	 */
+	brt_shard_t	bv_shard[BRT_SHARDS];
 	/*
 	 * Protects bv_mos_*.
 	 */
 	krwlock_t	bv_mos_entries_lock ____cacheline_aligned;
 	/*
-	 * Protects all the fields starting from bv_initiated.
+	 * Protects all the fields starting from bv_initiated. Held as writer
+	 * to (re)allocate bv_entcount[] and bv_bitmap, and as reader while
+	 * updating entries, with bv_entcount_lock protecting their contents.
 	 */
 	krwlock_t	bv_lock ____cacheline_aligned;
+	/*
+	 * Protects the bv_entcount[] and bv_bitmap contents, the dirty flags
+	 * and the counters while bv_lock is held as reader.
+	 */
+	kmutex_t	bv_entcount_lock ____cacheline_aligned;
 	/*
 	 * VDEV id.
 	 */
@@ -163,10 +200,6 @@ struct brt_vdev {
 	 * How much additional space would be occupied without block cloning.
 	 */
 	uint64_t	bv_savedspace;
-	/*
-	 * Entries to sync.
-	 */
-	avl_tree_t	bv_tree;
 };
 
 /* Size of offset / sizeof (uint64_t). */
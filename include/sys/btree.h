@@ -140,8 +140,20 @@ struct btree {
  *          or +1 -1 for <, 0 for ==, and +1 for >. For trivial comparisons,
  *          TREE_CMP() from avl.h can be used in a boilerplate function.
  */
-/* BEGIN CSTYLED */
 #define	ZFS_BTREE_FIND_IN_BUF_FUNC(NAME, T, COMP)			\
+	ZFS_BTREE_FIND_IN_BUF_BEFORE_FUNC(NAME, T, COMP, COMP)
+
+/*
+ * As ZFS_BTREE_FIND_IN_BUF_FUNC(), with a separate comparator for the
+ * search loop:
+ *
+ * BEFORE - Called with an element in the tree and the value searched for.
+ *          It must return a negative value exactly when COMP would.
+ *          Knowing the invariants of the elements stored in the tree often
+ *          allows this to be done with fewer comparisons than COMP needs.
+ */
+/* BEGIN CSTYLED */
+#define	ZFS_BTREE_FIND_IN_BUF_BEFORE_FUNC(NAME, T, BEFORE, COMP)	\
 _Pragma("GCC diagnostic push")						\
 _Pragma("GCC diagnostic ignored \"-Wunknown-pragmas\"")			\
 static void *								\
@@ -154,7 +166,7 @@ NAME(zfs_btree_t *tree, uint8_t *buf, uint32_t nelems,			\
 	while (nelems > 1) {						\
 		uint32_t half = nelems / 2;				\
 		nelems -= half;						\
-		i += (COMP(&i[half - 1], value) < 0) * half;		\
+		i += (BEFORE(&i[half - 1], value) < 0) * half;		\
 	}								\
 									\
 	int comp = COMP(i, value);					\
@@ -294,6 +306,13 @@ void *zfs_btree_destroy_nodes(zfs_btree_t *, zfs_btree_index_t **);
  */
 void zfs_btree_clear(zfs_btree_t *);
 
+/*
+ * Rebuild the tree with densely packed nodes if less than the given
+ * percentage of its node capacity is in use.  Returns B_TRUE if the tree
+ * was rebuilt.  All indexes into the tree are invalidated.
+ */
+boolean_t zfs_btree_compact(zfs_btree_t *, uint_t);
+
 /*
  * Final destroy of an B-Tree. Arguments are:
  *
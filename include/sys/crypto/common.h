@@ -72,6 +72,17 @@ typedef struct CK_AES_GCM_PARAMS {
 	ulong_t ulTagBits;
 } CK_AES_GCM_PARAMS;
 
+/*
+ * CK_SALSA20_CHACHA20_POLY1305_PARAMS provides parameters to the
+ * CKM_CHACHA20_POLY1305 mechanism
+ */
+typedef struct CK_SALSA20_CHACHA20_POLY1305_PARAMS {
+	uchar_t *pNonce;
+	ulong_t ulNonceLen;
+	uchar_t *pAAD;
+	ulong_t ulAADLen;
+} CK_SALSA20_CHACHA20_POLY1305_PARAMS;
+
 /*
  * The measurement unit bit flag for a mechanism's minimum or maximum key size.
  * The unit are mechanism dependent.  It can be in bits or in bytes.
@@ -83,6 +94,7 @@ typedef uint32_t crypto_keysize_unit_t;
 #define	SUN_CKM_SHA512_HMAC		"CKM_SHA512_HMAC"
 #define	SUN_CKM_AES_CCM			"CKM_AES_CCM"
 #define	SUN_CKM_AES_GCM			"CKM_AES_GCM"
+#define	SUN_CKM_CHACHA20_POLY1305	"CKM_CHACHA20_POLY1305"
 
 /* Data arguments of cryptographic operations */
 
@@ -30,6 +30,9 @@
 int aes_mod_init(void);
 int aes_mod_fini(void);
 
+int chacha20_mod_init(void);
+int chacha20_mod_fini(void);
+
 int sha2_mod_init(void);
 int sha2_mod_fini(void);
 
@@ -38,5 +41,6 @@ void icp_fini(void);
 
 int aes_impl_set(const char *);
 int gcm_impl_set(const char *);
+int chacha20_impl_set(const char *);
 
 #endif /* _SYS_CRYPTO_ALGS_H */
@@ -42,6 +42,35 @@ typedef struct dataset_sum_stats_t {
 	wmsum_t dss_nunlinked;
 } dataset_sum_stats_t;
 
+/*
+ * Optional per-dataset histograms, see zfs_dataset_histograms.  Latencies
+ * are bucketed by powers of two nanoseconds from below 1us, and request
+ * sizes by powers of two bytes from below 1K; the last bucket of each also
+ * counts everything beyond it.
+ */
+#define	DATASET_LAT_MIN_SHIFT	10
+#define	DATASET_LAT_BUCKETS	25
+#define	DATASET_SIZE_MIN_SHIFT	10
+#define	DATASET_SIZE_BUCKETS	15
+
+typedef enum dataset_kstats_op {
+	DATASET_OP_READ,
+	DATASET_OP_WRITE,
+	DATASET_OP_SYNC,
+	DATASET_OP_COUNT
+} dataset_kstats_op_t;
+
+/* Sizes are only recorded for reads and writes. */
+#define	DATASET_SIZE_OPS	DATASET_OP_SYNC
+
+typedef struct dataset_histograms {
+	wmsum_t dh_lat[DATASET_OP_COUNT][DATASET_LAT_BUCKETS];
+	wmsum_t dh_size[DATASET_SIZE_OPS][DATASET_SIZE_BUCKETS];
+} dataset_histograms_t;
+
+#define	DATASET_HISTO_NDATA	(DATASET_OP_COUNT * DATASET_LAT_BUCKETS + \
+	DATASET_SIZE_OPS * DATASET_SIZE_BUCKETS)
+
 typedef struct dataset_kstat_values {
 	kstat_named_t dkv_ds_name;
 	kstat_named_t dkv_writes;
@@ -67,6 +96,7 @@ typedef struct dataset_kstat_values {
 typedef struct dataset_kstats {
 	dataset_sum_stats_t dk_sums;
 	zil_sums_t dk_zil_sums;
+	dataset_histograms_t *dk_histograms;
 	kstat_t *dk_kstats;
 } dataset_kstats_t;
 
@@ -80,4 +110,8 @@ void dataset_kstats_update_read_kstats(dataset_kstats_t *, int64_t);
 void dataset_kstats_update_nunlinks_kstat(dataset_kstats_t *, int64_t);
 void dataset_kstats_update_nunlinked_kstat(dataset_kstats_t *, int64_t);
 
+hrtime_t dataset_kstats_start(dataset_kstats_t *);
+void dataset_kstats_update_histograms(dataset_kstats_t *,
+    dataset_kstats_op_t, int64_t, hrtime_t);
+
 #endif /* _SYS_DATASET_KSTATS_H */
@@ -165,6 +165,8 @@ typedef struct dbuf_dirty_record {
 			boolean_t dr_brtwrite;
 			boolean_t dr_diowrite;
 			boolean_t dr_has_raw_params;
+			boolean_t dr_early_write;
+			uint8_t dr_class_hint;
 
 			/* Override and raw params are mutually exclusive. */
 			union {
@@ -328,6 +330,12 @@ typedef struct dmu_buf_impl {
 	dmu_buf_user_t *db_user;
 } dmu_buf_impl_t;
 
+/*
+ * The mutex may be chosen by either the hash value or the bucket index,
+ * since there are never more mutexes than buckets.  The bucket index and
+ * hash_table itself must be read with the mutex held, as the table may be
+ * resized; walkers of the whole table also hold hash_resize_lock.
+ */
 #define	DBUF_HASH_MUTEX(h, idx) \
 	(&(h)->hash_mutexes[(idx) & ((h)->hash_mutex_mask)])
 
@@ -336,6 +344,7 @@ typedef struct dbuf_hash_table {
 	uint64_t hash_mutex_mask;
 	dmu_buf_impl_t **hash_table;
 	kmutex_t *hash_mutexes;
+	krwlock_t hash_resize_lock;
 } dbuf_hash_table_t;
 
 typedef void (*dbuf_prefetch_fn)(void *, uint64_t, uint64_t, boolean_t);
@@ -353,6 +362,8 @@ void dbuf_rm_spill(struct dnode *dn, dmu_tx_t *tx);
 dmu_buf_impl_t *dbuf_hold(struct dnode *dn, uint64_t blkid, const void *tag);
 dmu_buf_impl_t *dbuf_hold_level(struct dnode *dn, int level, uint64_t blkid,
     const void *tag);
+int dbuf_hold_range(struct dnode *dn, uint64_t blkid, uint64_t nblks,
+    const void *tag, dmu_buf_impl_t **dbp);
 int dbuf_hold_impl(struct dnode *dn, uint8_t level, uint64_t blkid,
     boolean_t fail_sparse, boolean_t fail_uncached,
     const void *tag, dmu_buf_impl_t **dbp);
@@ -374,6 +385,8 @@ void dbuf_rele_and_unlock(dmu_buf_impl_t *db, const void *tag,
 
 dmu_buf_impl_t *dbuf_find(struct objset *os, uint64_t object, uint8_t level,
     uint64_t blkid, uint64_t *hash_out);
+typedef int (*dbuf_walk_fn)(dmu_buf_impl_t *, void *);
+uint64_t dbuf_walk_cached(spa_t *spa, dbuf_walk_fn func, void *arg);
 
 int dbuf_read(dmu_buf_impl_t *db, zio_t *zio, dmu_flags_t flags);
 void dmu_buf_will_clone_or_dio(dmu_buf_t *db, dmu_tx_t *tx);
@@ -414,6 +427,8 @@ void dbuf_free_range(struct dnode *dn, uint64_t start, uint64_t end,
 void dbuf_new_size(dmu_buf_impl_t *db, int size, dmu_tx_t *tx);
 
 void dbuf_stats_init(dbuf_hash_table_t *hash);
+void dbuf_stats_objset_init(objset_t *os);
+void dbuf_stats_objset_destroy(objset_t *os);
 void dbuf_stats_destroy(void);
 
 int dbuf_dnode_findbp(dnode_t *dn, uint64_t level, uint64_t blkid,
@@ -268,8 +268,12 @@ typedef struct {
 	uint64_t	ddl_length;	/* on-disk log size */
 	uint64_t	ddl_first_txg;	/* txg log became active */
 	ddt_key_t	ddl_checkpoint;	/* last checkpoint */
+	uint64_t	ddl_mspace;	/* memory used by ddl_tree */
 } ddt_log_t;
 
+/* Most keys gathered for one sorted write prefetch batch */
+#define	DDT_PREFETCH_BATCH_MAX	64
+
 /*
  * In-core DDT object. This covers all entries and stats for a the whole pool
  * for a given checksum type.
@@ -318,6 +322,24 @@ typedef struct {
 
 	/* log stats power-2-sized referenced blocks */
 	ddt_histogram_t	ddt_log_histogram;
+
+	/* Bloom filter over stored keys, see zfs_dedup_bloom */
+	uint64_t	*ddt_bloom;		/* filter bits */
+	uint64_t	ddt_bloom_nbits;	/* filter size, power of 2 */
+	uint64_t	ddt_bloom_set;		/* bits currently set */
+	uint64_t	ddt_bloom_keys;		/* keys added */
+	boolean_t	ddt_bloom_ready;	/* all stored keys added */
+	ddt_type_t	ddt_bloom_type;		/* build walk position */
+	ddt_class_t	ddt_bloom_class;
+	uint64_t	ddt_bloom_walk;
+
+	/* object creation and histograms during a sharded log flush */
+	kmutex_t	ddt_flush_lock;
+
+	/* keys of pending dedup writes, sorted, see zfs_dedup_prefetch_batch */
+	kmutex_t	ddt_prefetch_lock;
+	uint_t		ddt_prefetch_nkeys;
+	ddt_key_t	ddt_prefetch_keys[DDT_PREFETCH_BATCH_MAX];
 } ddt_t;
 
 /*
@@ -385,6 +407,8 @@ extern ddt_entry_t *ddt_lookup(ddt_t *ddt, const blkptr_t *bp,
 extern void ddt_remove(ddt_t *ddt, ddt_entry_t *dde);
 extern void ddt_prefetch(spa_t *spa, const blkptr_t *bp);
 extern void ddt_prefetch_all(spa_t *spa);
+extern boolean_t ddt_prefetch_batch_add(ddt_t *ddt, const blkptr_t *bp);
+extern void ddt_prefetch_batch_issue(ddt_t *ddt);
 
 extern boolean_t ddt_class_contains(spa_t *spa, ddt_class_t max_class,
     const blkptr_t *bp);
@@ -60,9 +60,21 @@ extern "C" {
 	(ddlwe)->ddlwe_key = (ddle)->ddle_key;                          \
 	(ddlwe)->ddlwe_type = (ddle)->ddle_type;                        \
 	(ddlwe)->ddlwe_class = (ddle)->ddle_class;                      \
-	memcpy(&(ddlwe)->ddlwe_phys, (ddle)->ddle_phys, DDT_PHYS_SIZE(ddt)); \
+	ddt_log_entry_unpack(ddt, ddle, &(ddlwe)->ddlwe_phys);          \
 } while (0)
 
+/*
+ * The flat phys of a log tree entry, packed to hold only the DVAs up to the
+ * last one in use. Most deduped blocks have a single copy, so this keeps
+ * the log trees, which stay in memory for many txgs, a fifth smaller.
+ */
+typedef struct {
+	uint64_t	ddlp_refcnt;
+	uint64_t	ddlp_phys_birth;
+	uint64_t	ddlp_class_start;
+	dva_t		ddlp_dva[];	/* ddle_ndvas entries */
+} ddt_log_flat_phys_t;
+
 /*
  * An entry on the log tree. These are "frozen", and a record of what's in
  * the on-disk log. They can't be used in place, but can be "loaded" back into
@@ -72,11 +84,12 @@ typedef struct {
 	ddt_key_t	ddle_key;	/* ddt_log_tree key */
 	avl_node_t	ddle_node;	/* ddt_log_tree node */
 
-	ddt_type_t	ddle_type;	/* storage type */
-	ddt_class_t	ddle_class;	/* storage class */
+	uint8_t		ddle_type;	/* storage type */
+	uint8_t		ddle_class;	/* storage class */
+	uint8_t		ddle_ndvas;	/* DVAs kept, flat phys only */
 
-	/* extra allocation for flat/trad phys */
-	ddt_univ_phys_t	ddle_phys[];
+	/* extra allocation for packed flat or whole trad phys */
+	uint64_t	ddle_phys[];
 } ddt_log_entry_t;
 
 /* On-disk log record types. */
@@ -209,6 +222,9 @@ extern int ddt_log_load(ddt_t *ddt);
 extern void ddt_log_alloc(ddt_t *ddt);
 extern void ddt_log_free(ddt_t *ddt);
 
+extern void ddt_log_entry_unpack(const ddt_t *ddt,
+    const ddt_log_entry_t *ddle, ddt_univ_phys_t *ddp);
+
 extern void ddt_log_init(void);
 extern void ddt_log_fini(void);
 
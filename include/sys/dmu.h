@@ -394,6 +394,7 @@ typedef struct dmu_buf {
 #define	DMU_POOL_ZPOOL_CHECKPOINT	"com.delphix:zpool_checkpoint"
 #define	DMU_POOL_LOG_SPACEMAP_ZAP	"com.delphix:log_spacemap_zap"
 #define	DMU_POOL_DELETED_CLONES		"com.delphix:deleted_clones"
+#define	DMU_POOL_ARC_WARM		"org.openzfs:arc_warm"
 
 /*
  * Allocate an object from this objset.  The range of object numbers
@@ -802,6 +803,7 @@ struct blkptr *dmu_buf_get_blkptr(dmu_buf_t *db);
  */
 void dmu_buf_will_dirty(dmu_buf_t *db, dmu_tx_t *tx);
 void dmu_buf_will_dirty_flags(dmu_buf_t *db, dmu_tx_t *tx, dmu_flags_t flags);
+void dmu_buf_set_class_hint(dmu_buf_t *db, dmu_tx_t *tx, uint8_t hint);
 boolean_t dmu_buf_is_dirty(dmu_buf_t *db, dmu_tx_t *tx);
 void dmu_buf_set_crypt_params(dmu_buf_t *db_fake, boolean_t byteorder,
     const uint8_t *salt, const uint8_t *iv, const uint8_t *mac, dmu_tx_t *tx);
@@ -887,6 +889,8 @@ int dmu_free_range(objset_t *os, uint64_t object, uint64_t offset,
     uint64_t size, dmu_tx_t *tx);
 int dmu_free_long_range(objset_t *os, uint64_t object, uint64_t offset,
     uint64_t size);
+int dmu_free_long_range_background(objset_t *os, uint64_t object,
+    uint64_t offset, uint64_t size);
 int dmu_free_long_object(objset_t *os, uint64_t object);
 
 /*
@@ -938,6 +942,23 @@ void dmu_prefetch_by_dnode(dnode_t *dn, int64_t level, uint64_t offset,
 void dmu_prefetch_dnode(objset_t *os, uint64_t object, enum zio_priority pri);
 int dmu_prefetch_wait(objset_t *os, uint64_t object, uint64_t offset,
     uint64_t size);
+int dmu_prefetch_object(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t length, uint64_t rate);
+int dmu_prefetch_objset(objset_t *os, uint64_t rate);
+
+/*
+ * Access pattern hints for an object, from posix_fadvise(2) or similar.
+ * They tune the predictive prefetcher of the object's dnode.
+ */
+typedef enum dmu_advice {
+	DMU_ADVICE_NORMAL = 0,
+	DMU_ADVICE_SEQUENTIAL,
+	DMU_ADVICE_RANDOM
+} dmu_advice_t;
+
+int dmu_object_set_advice(objset_t *os, uint64_t object, dmu_advice_t advice);
+void dmu_uncache_range(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t len);
 
 typedef struct dmu_object_info {
 	/* All sizes are in bytes unless otherwise indicated. */
@@ -1045,6 +1066,7 @@ uint64_t dmu_objset_fsid_guid(objset_t *os);
  * Get the [cm]time for an objset's snapshot dir
  */
 inode_timespec_t dmu_objset_snap_cmtime(objset_t *os);
+uint64_t dmu_objset_snap_gen(objset_t *os);
 
 int dmu_objset_is_snapshot(objset_t *os);
 
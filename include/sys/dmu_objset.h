@@ -40,6 +40,7 @@
 #include <sys/zil.h>
 #include <sys/sa.h>
 #include <sys/zfs_ioctl.h>
+#include <sys/zfs_qos.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -132,6 +133,8 @@ struct objset {
 	boolean_t os_dedup_verify;
 	zfs_logbias_op_t os_logbias;
 	zfs_cache_type_t os_primary_cache;
+	zfs_arc_priority_t os_arc_priority;
+	zfs_qos_t os_qos;
 	zfs_cache_type_t os_secondary_cache;
 	zfs_prefetch_type_t os_prefetch;
 	zfs_sync_type_t os_sync;
@@ -175,9 +178,14 @@ struct objset {
 	/* Protected by os_obj_lock */
 	kmutex_t os_obj_lock;
 	uint64_t os_obj_next_chunk;
+	uint_t os_obj_chunk_shift;
 
-	/* Per-CPU next object to allocate, protected by atomic ops. */
+	/*
+	 * Per-CPU next object to allocate, and the end of the run of dnode
+	 * slots reserved for that CPU, protected by atomic ops.
+	 */
 	uint64_t *os_obj_next_percpu;
+	uint64_t *os_obj_end_percpu;
 	int os_obj_next_percpu_len;
 
 	/* Protected by os_lock */
@@ -200,6 +208,16 @@ struct objset {
 	dmu_objset_upgrade_cb_t os_upgrade_cb;
 	boolean_t os_upgrade_exit;
 	int os_upgrade_status;
+
+	/*
+	 * Dbuf cache accounting for this objset.  The sizes are indexed by
+	 * dbuf_cached_state_t and updated atomically; see dbuf_stats.c for
+	 * the per-objset kstat that reports them.
+	 */
+	wmsum_t os_dbuf_hits;
+	wmsum_t os_dbuf_misses;
+	uint64_t os_dbuf_cache_size[2];
+	kstat_t *os_dbuf_kstat;
 };
 
 #define	DMU_META_OBJSET		0
@@ -32,6 +32,7 @@
 #define	_DMU_ZFETCH_H
 
 #include <sys/zfs_context.h>
+#include <sys/dmu.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -44,6 +45,13 @@ typedef struct zfetch {
 	list_t		zf_stream;	/* list of zstream_t's */
 	struct dnode	*zf_dnode;	/* dnode that owns this zfetch */
 	int		zf_numstreams;	/* number of zstream_t's */
+	uint64_t	zf_last_blkid;	/* last unmatched access start */
+	int64_t		zf_last_delta;	/* distance from the one before */
+	dmu_advice_t	zf_advice;	/* access pattern hint */
+	uint_t		zf_random;	/* accesses matching no stream */
+	uint64_t	zf_rnd_lo;	/* first L1 block randomly accessed */
+	uint64_t	zf_rnd_hi;	/* last L1 block randomly accessed */
+	uint64_t	zf_rnd_next;	/* next L1 block to prefetch */
 } zfetch_t;
 
 typedef struct zsrange {
@@ -51,7 +59,7 @@ typedef struct zsrange {
 	uint16_t	end;
 } zsrange_t;
 
-#define	ZFETCH_RANGES	9		/* Fits zstream_t into 128 bytes */
+#define	ZFETCH_RANGES	9		/* Fits zstream_t into 160 bytes */
 
 typedef struct zstream {
 	list_node_t	zs_node;	/* link for zf_stream */
@@ -66,6 +74,16 @@ typedef struct zstream {
 	uint64_t	zs_ipf_end;	/* data block to prefetch L1 up to */
 	boolean_t	zs_missed;	/* stream saw cache misses */
 	boolean_t	zs_more;	/* need more distant prefetch */
+	/*
+	 * Strided streams (zs_stride != 0) expect the next access to start
+	 * zs_stride blocks after zs_last, and are never matched as forward
+	 * sequential streams.  A negative stride is a descending scan.  For
+	 * them zs_pf_start and zs_pf_end are the starts of the first access
+	 * to prefetch and of the first one past the prefetched window.
+	 */
+	int64_t		zs_stride;	/* blocks between access starts */
+	uint64_t	zs_last;	/* start of the last strided access */
+	uint32_t	zs_nblks;	/* blocks per strided access */
 	zfs_refcount_t	zs_callers;	/* number of pending callers */
 	/*
 	 * Number of stream references: dnode, callers and pending blocks.
@@ -85,6 +103,7 @@ void		dmu_zfetch_run(zfetch_t *, zstream_t *, boolean_t, boolean_t,
     boolean_t);
 void		dmu_zfetch(zfetch_t *, uint64_t, uint64_t, boolean_t, boolean_t,
     boolean_t, boolean_t);
+void		dmu_zfetch_advise(zfetch_t *, dmu_advice_t);
 
 
 #ifdef	__cplusplus
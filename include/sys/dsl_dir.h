@@ -111,13 +111,21 @@ struct dsl_dir {
 	/* Protected by dd_lock */
 	kmutex_t dd_lock;
 	list_t dd_props; /* list of dsl_prop_record_t's */
+
+	/* Protected by dd_prop_cache_lock */
+	kmutex_t dd_prop_cache_lock;
+	avl_tree_t dd_prop_cache; /* tree of dsl_prop_cache_t's */
+
 	inode_timespec_t dd_snap_cmtime; /* last snapshot namespace change */
+	uint64_t dd_snap_gen; /* in-core snapshot namespace generation */
 	uint64_t dd_origin_txg;
 
 	/* gross estimate of space used by in-flight tx's */
 	uint64_t dd_tempreserved[TXG_SIZE];
 	/* amount of space we expect to write; == amount of dirty data */
 	uint64_t dd_space_towrite[TXG_SIZE];
+	/* dirty data of this dir's own head dataset; updated atomically */
+	uint64_t dd_dirty_pertxg[TXG_SIZE];
 
 	dsl_deadlist_t dd_livelist;
 	bplist_t dd_pending_frees;
@@ -172,6 +180,8 @@ int dsl_dir_tempreserve_space(dsl_dir_t *dd, uint64_t mem,
     uint64_t asize, boolean_t netfree, void **tr_cookiep, dmu_tx_t *tx);
 void dsl_dir_tempreserve_clear(void *tr_cookie, dmu_tx_t *tx);
 void dsl_dir_willuse_space(dsl_dir_t *dd, int64_t space, dmu_tx_t *tx);
+void dsl_dir_dirty_space(dsl_dir_t *dd, int64_t space, dmu_tx_t *tx);
+uint64_t dsl_dir_dirty_total(dsl_dir_t *dd);
 void dsl_dir_diduse_space(dsl_dir_t *dd, dd_used_t type,
     int64_t used, int64_t compressed, int64_t uncompressed, dmu_tx_t *tx);
 void dsl_dir_transfer_space(dsl_dir_t *dd, int64_t delta,
@@ -195,6 +205,7 @@ void dsl_dir_new_refreservation(dsl_dir_t *dd, struct dsl_dataset *ds,
     uint64_t reservation, cred_t *cr, dmu_tx_t *tx);
 void dsl_dir_snap_cmtime_update(dsl_dir_t *dd, dmu_tx_t *tx);
 inode_timespec_t dsl_dir_snap_cmtime(dsl_dir_t *dd);
+uint64_t dsl_dir_snap_gen(dsl_dir_t *dd);
 void dsl_dir_set_reservation_sync_impl(dsl_dir_t *dd, uint64_t value,
     dmu_tx_t *tx);
 void dsl_dir_zapify(dsl_dir_t *dd, dmu_tx_t *tx);
@@ -64,6 +64,7 @@ extern uint64_t zfs_wrlog_data_max;
 extern uint_t zfs_dirty_data_max_percent;
 extern uint_t zfs_dirty_data_max_max_percent;
 extern uint_t zfs_delay_min_dirty_percent;
+extern uint_t zfs_delay_fair_share_percent;
 extern uint_t zfs_vdev_async_write_active_min_dirty_percent;
 extern uint_t zfs_vdev_async_write_active_max_dirty_percent;
 extern uint64_t zfs_delay_scale;
@@ -150,6 +151,14 @@ typedef struct dsl_pool {
 	 */
 	rrwlock_t dp_config_rwlock;
 
+	/*
+	 * Bumped, with dp_config_rwlock held for write, on every change that
+	 * may alter the effective property values of any dsl_dir.  Entries in
+	 * the per-dsl_dir property caches are only valid for the generation
+	 * they were resolved in.
+	 */
+	uint64_t dp_prop_gen;
+
 	zfs_all_blkstats_t *dp_blkstats;
 } dsl_pool_t;
 
@@ -160,6 +169,7 @@ dsl_pool_t *dsl_pool_create(spa_t *spa, nvlist_t *zplprops,
     struct dsl_crypto_params *dcp, uint64_t txg);
 void dsl_pool_sync(dsl_pool_t *dp, uint64_t txg);
 void dsl_pool_sync_done(dsl_pool_t *dp, uint64_t txg);
+void dsl_pool_early_write(dsl_pool_t *dp, uint64_t txg);
 int dsl_pool_sync_context(dsl_pool_t *dp);
 uint64_t dsl_pool_adjustedsize(dsl_pool_t *dp, zfs_space_check_t slop_policy);
 uint64_t dsl_pool_unreserved_space(dsl_pool_t *dp,
@@ -49,6 +49,20 @@ typedef struct dsl_prop_record {
 	list_t pr_cbs;
 } dsl_prop_record_t;
 
+/*
+ * Cached effective value of an integer property of a dsl_dir, as resolved
+ * through its inheritance chain by dsl_prop_get_dd().
+ */
+typedef struct dsl_prop_cache {
+	avl_node_t pc_node; /* link on dd_prop_cache */
+	const char *pc_propname;
+	boolean_t pc_snapshot;
+	uint64_t pc_gen; /* dp_prop_gen the value was resolved in */
+	int pc_err;
+	uint64_t pc_value;
+	char *pc_setpoint;
+} dsl_prop_cache_t;
+
 typedef struct dsl_prop_cb_record {
 	list_node_t cbr_pr_node; /* link on pr_cbs */
 	list_node_t cbr_ds_node; /* link on ds_prop_cbs */
@@ -143,16 +143,26 @@ typedef struct dsl_scan {
 	boolean_t scn_clearing;		/* scan is issuing sequential extents */
 	boolean_t scn_checkpointing;	/* scan is issuing all queued extents */
 	boolean_t scn_suspending;	/* scan is suspending until next txg */
+	uint_t scn_throttle_pct;	/* adaptive scan pacing, % of tunables */
 	uint64_t scn_last_checkpoint;	/* time of last checkpoint */
 
 	/* members for thread synchronization */
 	zio_t *scn_zio_root;		/* root zio for waiting on IO */
 	taskq_t *scn_taskq;		/* task queue for issuing extents */
+	taskq_t *scn_errorscrub_taskq;	/* task queue for error scrub reads */
+
+	/* open context prefetch for async destroy */
+	taskq_t *scn_destroy_pf_taskq;	/* prefetch worker threads */
+	kmutex_t scn_destroy_pf_lock;	/* protects the two fields below */
+	kcondvar_t scn_destroy_pf_cv;	/* signalled as workers exit */
+	uint_t scn_destroy_pf_active;	/* prefetch workers running */
+	boolean_t scn_destroy_pf_cancel; /* prefetch workers should stop */
 
 	/* for controlling scan prefetch, protected by spa_scrub_lock */
 	boolean_t scn_prefetch_stop;	/* prefetch should stop */
 	zbookmark_phys_t scn_prefetch_bookmark;	/* prefetch start bookmark */
 	avl_tree_t scn_prefetch_queue;	/* priority queue of prefetch IOs */
+	avl_tree_t scn_prefetch_lba_queue; /* same prefetch IOs in LBA order */
 	uint64_t scn_maxinflight_bytes; /* max bytes in flight for pool */
 
 	/* per txg statistics */
@@ -174,6 +184,7 @@ typedef struct dsl_scan {
 	dsl_scan_phys_t scn_phys;	/* on disk representation of scan */
 	dsl_scan_phys_t scn_phys_cached;
 	avl_tree_t scn_queue;		/* queue of datasets to scan */
+	avl_tree_t scn_queue_prio;	/* same, by resilver_priority */
 	kmutex_t scn_queue_lock;	/* serializes scn_queue inserts */
 	uint64_t scn_queues_pending;	/* outstanding data to issue */
 	/* members needed for syncing error scrub status to disk */
@@ -203,6 +203,13 @@ typedef enum {
 	ZFS_PROP_DEFAULTUSEROBJQUOTA,
 	ZFS_PROP_DEFAULTGROUPOBJQUOTA,
 	ZFS_PROP_DEFAULTPROJECTOBJQUOTA,
+	ZFS_PROP_ARCPRIORITY,
+	ZFS_PROP_QOS_READ_BW,
+	ZFS_PROP_QOS_WRITE_BW,
+	ZFS_PROP_QOS_READ_IOPS,
+	ZFS_PROP_QOS_WRITE_IOPS,
+	ZFS_PROP_QOS_WEIGHT,
+	ZFS_PROP_RESILVER_PRIORITY,
 	ZFS_NUM_PROPS
 } zfs_prop_t;
 
@@ -385,6 +392,11 @@ typedef enum {
 	VDEV_PROP_TRIM_SUPPORT,
 	VDEV_PROP_TRIM_ERRORS,
 	VDEV_PROP_SLOW_IOS,
+	VDEV_PROP_AGG_READ_OPS,
+	VDEV_PROP_AGG_WRITE_OPS,
+	VDEV_PROP_AGG_READ_GAP_BYTES,
+	VDEV_PROP_AGG_WRITE_GAP_BYTES,
+	VDEV_PROP_READ_GAP_LIMIT,
 	VDEV_NUM_PROPS
 } vdev_prop_t;
 
@@ -577,6 +589,19 @@ typedef enum {
 	ZFS_PREFETCH_ALL = 2
 } zfs_prefetch_type_t;
 
+typedef enum {
+	ZFS_ARC_PRIORITY_LOW = 0,
+	ZFS_ARC_PRIORITY_NORMAL = 1
+} zfs_arc_priority_t;
+
+#define	ZFS_QOS_WEIGHT_MIN	1
+#define	ZFS_QOS_WEIGHT_DEFAULT	100
+#define	ZFS_QOS_WEIGHT_MAX	1000
+
+#define	ZFS_RESILVER_PRIORITY_MIN	0
+#define	ZFS_RESILVER_PRIORITY_DEFAULT	50
+#define	ZFS_RESILVER_PRIORITY_MAX	100
+
 #define	DEFAULT_PBKDF2_ITERATIONS 350000
 #define	MIN_PBKDF2_ITERATIONS 100000
 
@@ -1214,6 +1239,8 @@ typedef struct pool_raidz_expand_stat {
 	uint64_t pres_to_reflow; /* bytes that need to be moved */
 	uint64_t pres_reflowed; /* bytes moved so far */
 	uint64_t pres_waiting_for_resilver;
+	uint64_t pres_pass_start; /* start time of this pass */
+	uint64_t pres_pass_reflowed; /* bytes moved during this pass */
 } pool_raidz_expand_stat_t;
 
 typedef enum dsl_scan_state {
@@ -1562,6 +1589,9 @@ typedef enum zfs_ioc {
 	ZFS_IOC_POOL_SCRUB,			/* 0x5a57 */
 	ZFS_IOC_POOL_PREFETCH,			/* 0x5a58 */
 	ZFS_IOC_DDT_PRUNE,			/* 0x5a59 */
+	ZFS_IOC_LIST_BULK,			/* 0x5a5a */
+	ZFS_IOC_OBJS_TO_STATS,			/* 0x5a5b */
+	ZFS_IOC_PREFETCH,			/* 0x5a5c */
 
 	/*
 	 * Per-platform (Optional) - 8/128 numbers reserved.
@@ -1627,8 +1657,48 @@ typedef struct zfs_rewrite_args {
 	uint64_t	arg;
 } zfs_rewrite_args_t;
 
+/*
+ * zfs_rewrite_args_t flags.  ZFS_REWRITE_SPECIAL moves the rewritten
+ * blocks to the special allocation class while it has room for them,
+ * ZFS_REWRITE_NORMAL moves them back to the normal class.
+ * ZFS_REWRITE_RATE limits the rewrite to arg bytes per second.
+ */
+#define	ZFS_REWRITE_SPECIAL	(1ULL << 0)
+#define	ZFS_REWRITE_NORMAL	(1ULL << 1)
+#define	ZFS_REWRITE_RATE	(1ULL << 2)
+#define	ZFS_REWRITE_MASK	\
+	(ZFS_REWRITE_SPECIAL | ZFS_REWRITE_NORMAL | ZFS_REWRITE_RATE)
+
 #define	ZFS_IOC_REWRITE		_IOW(0x83, 3, zfs_rewrite_args_t)
 
+/*
+ * Clone many file ranges with one call.  zcba_ents points to an array of
+ * zcba_count entries; each is cloned as by FICLONERANGE (a zero length
+ * means to the end of the source file), except that the clone may be
+ * shortened, and zcre_len and zcre_error are updated with the result.
+ * A failed entry doesn't stop the batch; zcba_done reports how many
+ * entries were processed.
+ */
+typedef struct zfs_clone_range_ent {
+	int64_t		zcre_src_fd;
+	uint64_t	zcre_src_off;
+	int64_t		zcre_dst_fd;
+	uint64_t	zcre_dst_off;
+	uint64_t	zcre_len;	/* in: bytes to clone, out: cloned */
+	int64_t		zcre_error;	/* out: errno or 0 */
+} zfs_clone_range_ent_t;
+
+typedef struct zfs_clone_batch_args {
+	uint64_t	zcba_ents;	/* user pointer to the entries */
+	uint64_t	zcba_count;
+	uint64_t	zcba_flags;	/* must be zero */
+	uint64_t	zcba_done;	/* out: entries processed */
+} zfs_clone_batch_args_t;
+
+#define	ZFS_CLONE_BATCH_MAX	(1 << 20)
+
+#define	ZFS_IOC_CLONE_BATCH	_IOWR(0x83, 4, zfs_clone_batch_args_t)
+
 /*
  * ZFS-specific error codes used for returning descriptive errors
  * to the userland through zfs ioctls.
@@ -1818,6 +1888,39 @@ typedef enum {
 #define	DDT_PRUNE_UNIT		"ddt_prune_unit"
 #define	DDT_PRUNE_AMOUNT	"ddt_prune_amount"
 
+/*
+ * The following are names used when invoking ZFS_IOC_LIST_BULK.  The
+ * snapshot range may also be restricted with SNAP_ITER_MIN_TXG and
+ * SNAP_ITER_MAX_TXG.
+ */
+#define	ZFS_LIST_BULK_CURSOR	"list_cursor"
+#define	ZFS_LIST_BULK_COUNT	"list_count"
+#define	ZFS_LIST_BULK_SNAPSHOTS	"list_snapshots"
+#define	ZFS_LIST_BULK_SIMPLE	"list_simple"
+#define	ZFS_LIST_BULK_PROPS	"list_props"
+#define	ZFS_LIST_BULK_DATASETS	"list_datasets"
+#define	ZFS_LIST_BULK_STATS	"list_stats"
+#define	ZFS_LIST_BULK_MAX	1024
+
+/*
+ * The following are names used when invoking ZFS_IOC_OBJS_TO_STATS.
+ */
+#define	ZFS_OBJS_STATS_OBJECTS	"objs_objects"
+#define	ZFS_OBJS_STATS_PATH	"objs_path"
+#define	ZFS_OBJS_STATS_STAT	"objs_stat"
+#define	ZFS_OBJS_STATS_ERROR	"objs_error"
+#define	ZFS_OBJS_STATS_MAX	1024
+
+/*
+ * The following are names used when invoking ZFS_IOC_PREFETCH.  Without
+ * ZFS_PREFETCH_OBJECT every object of the dataset is read, or the data of
+ * a volume if a range is given.
+ */
+#define	ZFS_PREFETCH_OBJECT	"prefetch_object"
+#define	ZFS_PREFETCH_OFFSET	"prefetch_offset"
+#define	ZFS_PREFETCH_LENGTH	"prefetch_length"
+#define	ZFS_PREFETCH_RATE	"prefetch_rate"
+
 /*
  * Flags for ZFS_IOC_VDEV_SET_STATE
  */
@@ -1958,6 +2061,7 @@ enum zio_encrypt {
 	ZIO_CRYPT_AES_128_GCM,
 	ZIO_CRYPT_AES_192_GCM,
 	ZIO_CRYPT_AES_256_GCM,
+	ZIO_CRYPT_CHACHA20_POLY1305,
 	ZIO_CRYPT_FUNCTIONS
 };
 
@@ -248,6 +248,15 @@ struct metaslab_group {
 	boolean_t		mg_initialized;
 
 	int64_t			mg_activation_count;
+
+	/*
+	 * Number of metaslabs activated for an allocator since the last
+	 * metaslab_group_preload() and a decaying average of that count
+	 * per txg, used to predict how many metaslabs to preload.
+	 */
+	uint64_t		mg_activations;
+	uint64_t		mg_activation_rate;
+
 	metaslab_class_t	*mg_class;
 	vdev_t			*mg_vd;
 	metaslab_group_t	*mg_prev;
@@ -279,6 +288,22 @@ struct metaslab_group {
  */
 #define	MAX_LBAS	64
 
+/*
+ * A window of a metaslab that the blocks of one stream (the data blocks of
+ * one object) are allocated from one after the other, when
+ * metaslab_stream_window is set.  Windows are only hints: their space stays
+ * in ms_allocatable, and a stream whose next block was taken by some other
+ * allocation is simply given a new window.
+ */
+typedef struct metaslab_stream {
+	uint64_t	mss_id;		/* stream, 0 if the slot is unused */
+	uint64_t	mss_cursor;	/* next offset of the stream */
+	uint64_t	mss_end;	/* end of the window */
+	hrtime_t	mss_used;	/* last allocation, for replacement */
+} metaslab_stream_t;
+
+#define	METASLAB_STREAMS	8
+
 /*
  * Each metaslab maintains a set of in-core trees to track metaslab
  * operations.  The in-core free tree (ms_allocatable) contains the list of
@@ -501,6 +526,7 @@ struct metaslab {
 	zfs_btree_t		ms_allocatable_by_size;
 	zfs_btree_t		ms_unflushed_frees_by_size;
 	uint64_t	ms_lbas[MAX_LBAS];
+	metaslab_stream_t ms_streams[METASLAB_STREAMS];
 
 	metaslab_group_t *ms_group;	/* metaslab group		*/
 	avl_node_t	ms_group_node;	/* node in metaslab group tree	*/
@@ -46,6 +46,7 @@ typedef struct mmp_thread {
 	kmutex_t	mmp_io_lock;	/* protect below */
 	hrtime_t	mmp_last_write;	/* last successful MMP write */
 	uint64_t	mmp_delay;	/* decaying avg ns between MMP writes */
+	hrtime_t	mmp_latency;	/* decaying avg MMP write latency */
 	uberblock_t	mmp_ub;		/* last ub written by sync */
 	zio_t		*mmp_zio_root;	/* root of mmp write zios */
 	uint64_t	mmp_kstat_id;	/* unique id for next MMP write kstat */
@@ -68,6 +69,7 @@ extern int param_set_multihost_interval(ZFS_MODULE_PARAM_ARGS);
 extern uint64_t zfs_multihost_interval;
 extern uint_t zfs_multihost_fail_intervals;
 extern uint_t zfs_multihost_import_intervals;
+extern uint_t zfs_multihost_leaves;
 
 #ifdef	__cplusplus
 }
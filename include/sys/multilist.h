@@ -85,6 +85,8 @@ unsigned int multilist_get_random_index(multilist_t *);
 
 void multilist_sublist_lock(multilist_sublist_t *);
 multilist_sublist_t *multilist_sublist_lock_idx(multilist_t *, unsigned int);
+multilist_sublist_t *multilist_sublist_trylock_idx(multilist_t *,
+    unsigned int);
 multilist_sublist_t *multilist_sublist_lock_obj(multilist_t *, void *);
 void multilist_sublist_unlock(multilist_sublist_t *);
 
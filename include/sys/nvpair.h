@@ -137,6 +137,7 @@ struct nv_alloc_ops {
 };
 
 _SYS_NVPAIR_H const nv_alloc_ops_t *const nv_fixed_ops;
+_SYS_NVPAIR_H const nv_alloc_ops_t *const nv_arena_ops;
 _SYS_NVPAIR_H nv_alloc_t *const nv_alloc_nosleep;
 
 #if defined(_KERNEL)
@@ -155,6 +156,7 @@ _SYS_NVPAIR_H void nvlist_free(nvlist_t *);
 _SYS_NVPAIR_H int nvlist_size(nvlist_t *, size_t *, int);
 _SYS_NVPAIR_H int nvlist_pack(nvlist_t *, char **, size_t *, int, int);
 _SYS_NVPAIR_H int nvlist_unpack(char *, size_t, nvlist_t **, int);
+_SYS_NVPAIR_H int nvlist_unpack_arena(char *, size_t, nvlist_t **, int);
 _SYS_NVPAIR_H int nvlist_dup(const nvlist_t *, nvlist_t **, int);
 _SYS_NVPAIR_H int nvlist_merge(nvlist_t *, nvlist_t *, int);
 
@@ -113,6 +113,7 @@ typedef struct sa_idx_tab {
 	uint16_t	*sa_variable_lengths;
 	zfs_refcount_t	sa_refcount;
 	uint32_t	*sa_idx_tab;	/* array of offsets */
+	uint16_t	*sa_attr_lengths;	/* array of resolved lengths */
 } sa_idx_tab_t;
 
 /*
@@ -98,6 +98,9 @@ typedef enum sha2_mech_type {
 /* SHA2 Init function */
 extern void SHA2Init(int algotype, SHA2_CTX *ctx);
 
+/* SHA2 implementation hint for hashing len bytes, before any update */
+extern void SHA2SizeHint(SHA2_CTX *ctx, uint64_t len);
+
 /* SHA2 Update function */
 extern void SHA2Update(SHA2_CTX *ctx, const void *data, size_t len);
 
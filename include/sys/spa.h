@@ -836,6 +836,7 @@ void spa_sync_tq_destroy(spa_t *spa);
 uint_t spa_acq_allocator(spa_t *spa);
 void spa_rel_allocator(spa_t *spa, uint_t allocator);
 void spa_select_allocator(zio_t *zio);
+void spa_alloc_rebalance(spa_t *spa);
 
 /* spa namespace global mutex */
 extern kmutex_t spa_namespace_lock;
@@ -911,6 +912,7 @@ typedef struct spa_stats {
 	spa_history_kstat_t	state;		/* pool state */
 	spa_history_kstat_t	guid;		/* pool guid */
 	spa_history_kstat_t	iostats;
+	spa_history_kstat_t	zio_stages;	/* pipeline stage latency */
 } spa_stats_t;
 
 typedef enum txg_state {
@@ -929,6 +931,26 @@ typedef struct txg_stat {
 	uint64_t		ndirty;
 } txg_stat_t;
 
+/*
+ * Phases of spa_sync() timed individually and reported per txg in the
+ * txgs kstat.  Each phase accumulates over all convergence passes.
+ */
+typedef enum spa_sync_phase {
+	SPA_SYNC_PHASE_DATASETS = 0,	/* dirty datasets and dsl_dirs */
+	SPA_SYNC_PHASE_MOS,		/* dsl_pool_sync_mos() */
+	SPA_SYNC_PHASE_TASKS,		/* dsl sync tasks */
+	SPA_SYNC_PHASE_FREES,		/* spa_sync_frees() */
+	SPA_SYNC_PHASE_DDT_BRT,		/* ddt_sync() and brt_sync() */
+	SPA_SYNC_PHASE_LOG_FLUSH,	/* spa_flush_metaslabs() */
+	SPA_SYNC_PHASE_VDEVS,		/* vdev_sync() and metaslab_sync() */
+	SPA_SYNC_PHASE_DEFERRED,	/* spa_sync_deferred_frees() */
+	SPA_SYNC_PHASE_CONFIG,		/* uberblock and label writes */
+	SPA_SYNC_PHASES
+} spa_sync_phase_t;
+
+/* Number of sync passes with their own block count; the last is 4+ */
+#define	SPA_SYNC_PASS_HIST	4
+
 /* Assorted pool IO kstats */
 typedef struct spa_iostats {
 	kstat_named_t	trim_extents_written;
@@ -957,6 +979,16 @@ typedef struct spa_iostats {
 	kstat_named_t	direct_read_bytes;
 	kstat_named_t	direct_write_count;
 	kstat_named_t	direct_write_bytes;
+	kstat_named_t	config_syncs;
+	kstat_named_t	config_flush_nsecs;
+	kstat_named_t	config_label_nsecs;
+	kstat_named_t	config_uberblock_nsecs;
+	kstat_named_t	alloc_throttle_normal_count;
+	kstat_named_t	alloc_throttle_normal_nsecs;
+	kstat_named_t	alloc_throttle_special_count;
+	kstat_named_t	alloc_throttle_special_nsecs;
+	kstat_named_t	alloc_throttle_dedup_count;
+	kstat_named_t	alloc_throttle_dedup_nsecs;
 } spa_iostats_t;
 
 extern void spa_stats_init(spa_t *spa);
@@ -969,7 +1001,10 @@ extern int spa_txg_history_set(spa_t *spa,  uint64_t txg,
 extern txg_stat_t *spa_txg_history_init_io(spa_t *, uint64_t,
     struct dsl_pool *);
 extern void spa_txg_history_fini_io(spa_t *, txg_stat_t *);
+extern void spa_sync_phase_add(spa_t *spa, spa_sync_phase_t phase,
+    hrtime_t start);
 extern void spa_tx_assign_add_nsecs(spa_t *spa, uint64_t nsecs);
+extern void spa_zio_stage_add_nsecs(spa_t *spa, int stage, uint64_t nsecs);
 extern int spa_mmp_history_set_skip(spa_t *spa, uint64_t mmp_kstat_id);
 extern int spa_mmp_history_set(spa_t *spa, uint64_t mmp_kstat_id, int io_error,
     hrtime_t duration);
@@ -984,6 +1019,10 @@ extern void spa_iostats_read_add(spa_t *spa, uint64_t size, uint64_t iops,
     dmu_flags_t flags);
 extern void spa_iostats_write_add(spa_t *spa, uint64_t size, uint64_t iops,
     dmu_flags_t flags);
+extern void spa_iostats_config_sync_add(spa_t *spa, hrtime_t flush,
+    hrtime_t labels, hrtime_t uberblocks);
+extern void spa_iostats_alloc_throttle_add(spa_t *spa, metaslab_class_t *mc,
+    hrtime_t wait);
 extern void spa_import_progress_add(spa_t *spa);
 extern void spa_import_progress_remove(uint64_t spa_guid);
 extern int spa_import_progress_set_mmp_check(uint64_t pool_guid,
@@ -1208,6 +1247,10 @@ extern void name_to_errphys(char *buf, zbookmark_err_phys_t *zep);
 extern void vdev_mirror_stat_init(void);
 extern void vdev_mirror_stat_fini(void);
 
+/* vdev queue */
+extern void vdev_queue_stat_init(void);
+extern void vdev_queue_stat_fini(void);
+
 /* Initialization and termination */
 extern void spa_init(spa_mode_t mode);
 extern void spa_fini(void);
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef _SYS_SPA_ARC_WARM_H
+#define	_SYS_SPA_ARC_WARM_H
+
+#include <sys/spa.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * On-disk ARC warm-start log.  The MOS object named by DMU_POOL_ARC_WARM
+ * holds an array of these records; the first one is a header whose
+ * fields are reinterpreted as described below.
+ */
+typedef struct spa_arc_warm_rec {
+	uint64_t	awr_objset;	/* dataset object (header: magic) */
+	uint64_t	awr_object;	/* object (header: record count) */
+	uint64_t	awr_level;	/* indirection level (header: txg) */
+	uint64_t	awr_blkid;	/* block id (header: reserved) */
+} spa_arc_warm_rec_t;
+
+#define	SPA_ARC_WARM_MAGIC	0x0a7c3a7a33000001ULL
+
+void spa_arc_warm_start(spa_t *spa);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_SPA_ARC_WARM_H */
@@ -52,6 +52,7 @@
 #include <sys/dsl_crypt.h>
 #include <sys/zfeature.h>
 #include <sys/zthr.h>
+#include <sys/wmsum.h>
 #include <sys/dsl_deadlist.h>
 #include <zfeature_common.h>
 
@@ -189,6 +190,7 @@ typedef enum spa_proc_state {
 
 typedef struct spa_taskqs {
 	uint_t stqs_count;
+	uint_t stqs_nodes;	/* NUMA nodes the taskqs are split across */
 	taskq_t **stqs_taskq;
 } spa_taskqs_t;
 
@@ -270,6 +272,11 @@ struct spa {
 	list_t		spa_state_dirty_list;	/* vdevs with dirty state */
 	spa_allocs_use_t *spa_allocs_use;
 	int		spa_alloc_count;
+	int		spa_alloc_active;	/* allocators for new writes */
+	wmsum_t		spa_alloc_locked;	/* metaslab ms_lock entries */
+	wmsum_t		spa_alloc_contended;	/* ... which had to wait */
+	uint64_t	spa_alloc_locked_last;	/* values at last rebalance */
+	uint64_t	spa_alloc_contended_last;
 	int		spa_active_allocator;	/* selectable allocator */
 
 	/* per-allocator sync thread taskqs */
@@ -353,6 +360,10 @@ struct spa {
 
 	zthr_t		*spa_livelist_delete_zthr; /* deleting livelists */
 	zthr_t		*spa_livelist_condense_zthr; /* condensing livelists */
+	zthr_t		*spa_arc_warm_zthr;	/* ARC warm-start log */
+	uint64_t	spa_arc_warm_obj;	/* MOS object of the log */
+	uint64_t	spa_arc_warm_last;	/* time of last log update */
+	boolean_t	spa_arc_warm_replay;	/* log replay pending */
 	uint64_t	spa_livelists_to_delete; /* set of livelists to free */
 	livelist_condense_entry_t	spa_to_condense; /* next to condense */
 
@@ -409,6 +420,7 @@ struct spa {
 	uint64_t	spa_brt_nvdevs;		/* number of vdevs in BRT */
 	uint64_t	spa_brt_rangesize;	/* pool's BRT range size */
 	krwlock_t	spa_brt_lock;		/* Protects brt_vdevs/nvdevs */
+	struct brt_vdevs_retired *spa_brt_vdevs_retired; /* old brt_vdevs */
 	kmutex_t	spa_vdev_top_lock;	/* dueling offline/remove */
 	kmutex_t	spa_proc_lock;		/* protects spa_proc* */
 	kcondvar_t	spa_proc_cv;		/* spa_proc_state transitions */
@@ -423,6 +435,7 @@ struct spa {
 	uint64_t	spa_feat_for_read_obj;	/* required to read from pool */
 	uint64_t	spa_feat_desc_obj;	/* Feature descriptions */
 	uint64_t	spa_feat_enabled_txg_obj; /* Feature enabled txg */
+	uint64_t	spa_gang_header_txg;	/* first txg of wide GBHs */
 	kmutex_t	spa_feat_stats_lock;	/* protects spa_feat_stats */
 	nvlist_t	*spa_feat_stats;	/* Cache of enabled features */
 	/* cache feature refcounts */
@@ -430,6 +443,9 @@ struct spa {
 	taskqid_t	spa_deadman_tqid;	/* Task id */
 	uint64_t	spa_deadman_calls;	/* number of deadman calls */
 	hrtime_t	spa_sync_starttime;	/* starting time of spa_sync */
+	hrtime_t	spa_sync_phase_time[SPA_SYNC_PHASES]; /* per phase */
+	uint64_t	spa_sync_pass_blocks[SPA_SYNC_PASS_HIST]; /* per pass */
+	uint32_t	spa_sync_passes;	/* passes of last spa_sync */
 	uint64_t	spa_deadman_synctime;	/* deadman sync expiration */
 	uint64_t	spa_deadman_ziotime;	/* deadman zio expiration */
 	uint64_t	spa_all_vdev_zaps;	/* ZAP of per-vd ZAP obj #s */
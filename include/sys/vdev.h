@@ -143,7 +143,8 @@ extern uint64_t vdev_psize_to_asize(vdev_t *vd, uint64_t psize);
 /*
  * Return the amount of space allocated for a gang block header.  Note that
  * since the physical birth txg is not provided, this must be constant for
- * a given vdev.  (e.g. raidz expansion can't change this)
+ * a given vdev.  (e.g. raidz expansion can't change this)  A header filling
+ * a whole sector (see zio_gang_header_size()) has the same allocated size.
  */
 static inline uint64_t
 vdev_gang_header_asize(vdev_t *vd)
@@ -174,8 +175,13 @@ extern void vdev_queue_change_io_priority(zio_t *zio, zio_priority_t priority);
 
 extern uint32_t vdev_queue_length(vdev_t *vd);
 extern uint64_t vdev_queue_last_offset(vdev_t *vd);
+extern hrtime_t vdev_queue_read_latency(vdev_t *vd, hrtime_t max_age);
+extern hrtime_t vdev_queue_stall_time(vdev_t *vd);
+extern hrtime_t vdev_queue_fg_latency(vdev_t *vd, hrtime_t *base,
+    hrtime_t *last);
 extern uint64_t vdev_queue_class_length(vdev_t *vq, zio_priority_t p);
 extern boolean_t vdev_queue_pool_busy(spa_t *spa);
+extern uint64_t vdev_queue_agg_stat(vdev_t *vd, vdev_prop_t prop);
 
 extern void vdev_config_dirty(vdev_t *vd);
 extern void vdev_config_clean(vdev_t *vd);
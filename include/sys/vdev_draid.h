@@ -81,6 +81,8 @@ typedef struct vdev_draid_config {
 	uint64_t vdc_ndisks;		/* = children - spares */
 	uint64_t vdc_groupsz;		/* = groupwidth * DRAID_ROWSIZE */
 	uint64_t vdc_devslicesz;	/* = (groupsz * groups) / ndisks */
+	uint8_t *vdc_perm_cache;	/* expanded permutations or NULL */
+	uint64_t vdc_perm_cachesz;	/* = nperms * children^2 */
 } vdev_draid_config_t;
 
 /*
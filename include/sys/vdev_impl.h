@@ -31,6 +31,7 @@
 
 #include <sys/avl.h>
 #include <sys/bpobj.h>
+#include <sys/btree.h>
 #include <sys/dmu.h>
 #include <sys/metaslab.h>
 #include <sys/nvpair.h>
@@ -128,19 +129,32 @@ typedef const struct vdev_ops {
 /*
  * Virtual device properties
  */
+
+/*
+ * Entry of the LBA-ordered class trees and of the offset trees.  The sort
+ * keys are copied out of the zio so that searches stay within the B-tree
+ * nodes; they must not change while the zio is queued.  vqe_ts is unused
+ * in the offset trees.
+ */
+typedef struct vdev_queue_ent {
+	int64_t		vqe_ts;		/* sort time >> VDQ_T_SHIFT */
+	uint64_t	vqe_offset;
+	zio_t		*vqe_zio;
+} vdev_queue_ent_t;
+
 typedef union vdev_queue_class {
 	struct {
 		ulong_t 	vqc_list_numnodes;
 		list_t		vqc_list;
 	};
-	avl_tree_t	vqc_tree;
+	zfs_btree_t	vqc_tree;
 } vdev_queue_class_t;
 
 struct vdev_queue {
 	vdev_t		*vq_vdev;
 	vdev_queue_class_t vq_class[ZIO_PRIORITY_NUM_QUEUEABLE];
-	avl_tree_t	vq_read_offset_tree;
-	avl_tree_t	vq_write_offset_tree;
+	zfs_btree_t	vq_read_offset_tree;
+	zfs_btree_t	vq_write_offset_tree;
 	uint64_t	vq_last_offset;
 	zio_priority_t	vq_last_prio;	/* Last sent I/O priority. */
 	uint32_t	vq_cqueued;	/* Classes with queued I/Os. */
@@ -149,9 +163,28 @@ struct vdev_queue {
 	uint32_t	vq_ia_active;	/* Active interactive I/Os. */
 	uint32_t	vq_nia_credit;	/* Non-interactive I/Os credit. */
 	list_t		vq_active_list;	/* List of active I/Os. */
+	uint64_t	vq_agg_ops[2];	/* Aggregated reads and writes. */
+	uint64_t	vq_agg_gap_bytes[2]; /* Gap bytes read or written. */
+	uint64_t	vq_cost_small_ns; /* Average small read time. */
+	uint64_t	vq_cost_small_size;
+	uint64_t	vq_cost_large_ns; /* Average large read time. */
+	uint64_t	vq_cost_large_size;
+	uint64_t	vq_read_gap;	/* Estimated break-even read gap. */
+	uint32_t	vq_mq_active;	/* Active bypassed I/Os. */
+	kmutex_t	vq_bypass_lock;	/* Protects vq_bypass_list. */
+	list_t		vq_bypass_list;	/* List of active bypassed I/Os. */
+	uint32_t	vq_mq_cactive[ZIO_PRIORITY_NUM_QUEUEABLE];
 	hrtime_t	vq_io_complete_ts; /* time last i/o completed */
 	hrtime_t	vq_io_delta_ts;
-	zio_t		vq_io_search; /* used as local for stack reduction */
+	/* Latency-target adaptive limits, see zfs_vdev_target_latency_us. */
+	uint32_t	vq_lat_max[ZIO_PRIORITY_NUM_QUEUEABLE];
+	hrtime_t	vq_lat_avg[ZIO_PRIORITY_NUM_QUEUEABLE];
+	hrtime_t	vq_lat_ts[ZIO_PRIORITY_NUM_QUEUEABLE];
+	hrtime_t	vq_read_lat;	/* Average read device time. */
+	hrtime_t	vq_read_lat_ts;	/* Time of last read sample. */
+	hrtime_t	vq_fg_lat;	/* Average interactive I/O time. */
+	hrtime_t	vq_fg_lat_base;	/* Same, without scan I/O active. */
+	hrtime_t	vq_fg_ts;	/* Time of last interactive I/O. */
 	kmutex_t	vq_lock;
 };
 
@@ -409,6 +442,9 @@ struct vdev {
 	boolean_t	vdev_nowritecache; /* true if flushwritecache failed */
 	boolean_t	vdev_has_trim;	/* TRIM is supported		*/
 	boolean_t	vdev_has_securetrim; /* secure TRIM is supported */
+	boolean_t	vdev_has_write_zeroes; /* WRITE ZEROES offload	*/
+	uint64_t	vdev_trim_granularity; /* TRIM granularity (bytes) */
+	uint64_t	vdev_trim_max_bytes; /* largest TRIM (bytes)	*/
 	boolean_t	vdev_checkremove; /* temporary online test	*/
 	boolean_t	vdev_forcefault; /* force online fault		*/
 	boolean_t	vdev_splitting;	/* split or repair in progress  */
@@ -426,10 +462,13 @@ struct vdev {
 	vdev_queue_t	vdev_queue;	/* I/O deadline schedule queue	*/
 	spa_aux_vdev_t	*vdev_aux;	/* for l2cache and spares vdevs	*/
 	zio_t		*vdev_probe_zio; /* root of current probe	*/
+	zio_t		*vdev_zil_flush_next; /* next shared ZIL flush epoch */
+	boolean_t	vdev_zil_flush_active; /* shared ZIL flush in flight */
 	vdev_aux_t	vdev_label_aux;	/* on-disk aux state		*/
 	uint64_t	vdev_leaf_zap;
 	hrtime_t	vdev_mmp_pending; /* 0 if write finished	*/
 	uint64_t	vdev_mmp_kstat_id;	/* to find kstat entry */
+	hrtime_t	vdev_mmp_latency; /* decaying avg MMP write latency */
 	uint64_t	vdev_expansion_time;	/* vdev's last expansion time */
 	list_node_t	vdev_leaf_node;		/* leaf vdev list */
 
@@ -443,6 +482,7 @@ struct vdev {
 	kmutex_t	vdev_dtl_lock;	/* vdev_dtl_{map,resilver}	*/
 	kmutex_t	vdev_stat_lock;	/* vdev_stat			*/
 	kmutex_t	vdev_probe_lock; /* protects vdev_probe_zio	*/
+	kmutex_t	vdev_zil_flush_lock; /* protects vdev_zil_flush_* */
 
 	/*
 	 * We rate limit ZIO delay, deadman, and checksum events, since they
@@ -456,6 +496,7 @@ struct vdev {
 	zfs_ratelimit_t vdev_deadman_rl;
 	zfs_ratelimit_t vdev_dio_verify_rl;
 	zfs_ratelimit_t vdev_checksum_rl;
+	uint64_t vdev_checksum_suppressed; /* rate limited checksum events */
 
 	/*
 	 * Vdev properties for tuning ZED or zfsd
@@ -77,6 +77,9 @@ typedef struct vdev_indirect_mapping_phys {
 
 #define	VDEV_INDIRECT_MAPPING_SIZE_V0	(3 * sizeof (uint64_t))
 
+#define	VIM_INDEX_SHIFT		6
+#define	VIM_INDEX_STRIDE	(1ULL << VIM_INDEX_SHIFT)
+
 typedef struct vdev_indirect_mapping {
 	uint64_t	vim_object;
 	boolean_t	vim_havecounts;
@@ -89,6 +92,14 @@ typedef struct vdev_indirect_mapping {
 	 */
 	vdev_indirect_mapping_entry_phys_t *vim_entries;
 
+	/*
+	 * The source offset of every VIM_INDEX_STRIDE'th entry of
+	 * vim_entries, so that lookups binary search this small, dense
+	 * array first and then only a single stride of vim_entries.
+	 */
+	uint64_t	*vim_index;
+	uint64_t	vim_index_count;
+
 	objset_t	*vim_objset;
 
 	dmu_buf_t	*vim_dbuf;
@@ -60,6 +60,8 @@ void vdev_raidz_io_done(zio_t *);
 void vdev_raidz_checksum_error(zio_t *, struct raidz_col *, abd_t *);
 struct raidz_row *vdev_raidz_row_alloc(int, zio_t *);
 void vdev_raidz_reflow_copy_scratch(spa_t *);
+void vdev_raidz_combrec_init(void);
+void vdev_raidz_combrec_fini(void);
 void raidz_dtl_reassessed(vdev_t *);
 
 extern const zio_vsd_ops_t vdev_raidz_vsd_ops;
@@ -119,6 +121,18 @@ typedef struct vdev_raidz_expand {
 	 */
 	zfs_rangelock_t vre_rangelock;
 
+	/*
+	 * Current limit on outstanding i/o, see raidz_expand_copy_limit().
+	 */
+	uint64_t vre_copy_limit;
+
+	/*
+	 * When the expansion thread last (re)started, and how many bytes had
+	 * been copied by then.  Used to report the current copy rate.
+	 */
+	uint64_t vre_pass_start_time;
+	uint64_t vre_pass_start_copied;
+
 	/*
 	 * These fields are stored on-disk in the vdev_top_zap:
 	 */
@@ -58,16 +58,31 @@ typedef struct vdev_rebuild_phys {
 	uint64_t	vrp_errors;		/* errors during rebuild */
 } vdev_rebuild_phys_t;
 
+/*
+ * Each of the zfs_rebuild_max_metaslabs workers of a rebuild scans one
+ * metaslab at a time.  The lowest vrw_offset of all workers with a metaslab
+ * is the offset below which all rebuild I/O has been issued.
+ */
+typedef struct vdev_rebuild_worker {
+	struct vdev_rebuild *vrw_vr;
+	metaslab_t	*vrw_msp;		/* scanning disabled metaslab */
+	/* scan ranges (in metaslab) */
+	zfs_range_tree_t	*vrw_scan_tree;
+	uint64_t	vrw_offset;		/* next offset to be issued */
+} vdev_rebuild_worker_t;
+
 /*
  * The vdev_rebuild_t describes the current state and how a top-level vdev
- * should be rebuilt.  The core elements are the top-vdev, the metaslab being
- * rebuilt, range tree containing the allocated extents and the on-disk state.
+ * should be rebuilt.  The core elements are the top-vdev, the workers
+ * scanning its metaslabs and the on-disk state.
  */
 typedef struct vdev_rebuild {
 	vdev_t		*vr_top_vdev;		/* top-level vdev to rebuild */
-	metaslab_t	*vr_scan_msp;		/* scanning disabled metaslab */
-	/* scan ranges (in metaslab) */
-	zfs_range_tree_t	*vr_scan_tree;
+	vdev_rebuild_worker_t *vr_workers;	/* metaslab scan workers */
+	uint_t		vr_nworkers;
+	uint64_t	vr_next_ms;		/* next metaslab to scan */
+	int		vr_error;		/* first error of any worker */
+	hrtime_t	vr_update_est_time;	/* last vrp_bytes_est update */
 	kmutex_t	vr_io_lock;		/* inflight IO lock */
 	kcondvar_t	vr_io_cv;		/* inflight IO cv */
 
@@ -76,6 +91,8 @@ typedef struct vdev_rebuild {
 	uint64_t	vr_prev_scan_time_ms;	/* any previous scan time */
 	uint64_t	vr_bytes_inflight_max;	/* maximum bytes inflight */
 	uint64_t	vr_bytes_inflight;	/* current bytes inflight */
+	hrtime_t	vr_rate_start;		/* start of rate window */
+	uint64_t	vr_rate_bytes;		/* bytes issued in the window */
 
 	/* Per-rebuild pass statistics for calculating bandwidth */
 	uint64_t	vr_pass_start_time;
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	_SYS_WMSUM_KSTAT_H
+#define	_SYS_WMSUM_KSTAT_H
+
+#include <sys/zfs_context.h>
+#include <sys/wmsum.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * A named kstat whose leading values are backed by per-CPU wmsum_t
+ * counters.  Hot paths bump the counters without sharing a cache line,
+ * and the values are only summed when the kstat is read.  The kstat data
+ * is a struct of kstat_named_t, and a counter is addressed by its field
+ * in that struct with WMSUM_KSTAT_INDEX().  Any values after the first
+ * wk_nsums are left to the optional wk_update callback.
+ */
+typedef struct wmsum_kstat {
+	kstat_t		*wk_ksp;	/* installed kstat, or NULL */
+	kstat_named_t	*wk_named;	/* kstat data */
+	wmsum_t		*wk_sums;	/* one counter per leading value */
+	uint_t		wk_nsums;	/* # of counters */
+	void		(*wk_update)(kstat_named_t *); /* other values */
+} wmsum_kstat_t;
+
+#define	WMSUM_KSTAT_INDEX(type, field)	\
+	(offsetof(type, field) / sizeof (kstat_named_t))
+
+extern void wmsum_kstat_init(wmsum_kstat_t *, const char *, const char *,
+    const char *, kstat_named_t *, uint_t, uint_t,
+    void (*)(kstat_named_t *));
+extern void wmsum_kstat_fini(wmsum_kstat_t *);
+
+static inline void
+wmsum_kstat_add(wmsum_kstat_t *wk, uint_t idx, int64_t delta)
+{
+	ASSERT3U(idx, <, wk->wk_nsums);
+	wmsum_add(&wk->wk_sums[idx], delta);
+}
+
+static inline uint64_t
+wmsum_kstat_value(wmsum_kstat_t *wk, uint_t idx)
+{
+	ASSERT3U(idx, <, wk->wk_nsums);
+	return (wmsum_value(&wk->wk_sums[idx]));
+}
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_WMSUM_KSTAT_H */
@@ -367,6 +367,8 @@ typedef struct zap_cursor {
 	uint64_t zc_hash;
 	uint32_t zc_cd;
 	boolean_t zc_prefetch;
+	uint64_t zc_prefetch_next;	/* hash to issue more read-ahead */
+	uint64_t zc_prefetch_end;	/* read-ahead issued up to this hash */
 } zap_cursor_t;
 
 typedef struct {
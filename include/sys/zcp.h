@@ -41,6 +41,8 @@ int zcp_argerror(lua_State *, int, const char *, ...);
 
 int zcp_eval(const char *, const char *, boolean_t, uint64_t, uint64_t,
     nvpair_t *, nvlist_t *);
+void zcp_init(void);
+void zcp_fini(void);
 
 int zcp_load_list_lib(lua_State *);
 
@@ -64,8 +66,9 @@ typedef struct zcp_run_info {
 
 	/*
 	 * An estimate of the total amount of space consumed by all
-	 * synctasks we have successfully performed so far in this
-	 * channel program. Used to generate ENOSPC errors for syncfuncs.
+	 * synctasks we have successfully performed so far in the current
+	 * txg of this channel program. Used to generate ENOSPC errors for
+	 * syncfuncs.
 	 */
 	int		zri_space_used;
 
@@ -84,13 +87,14 @@ typedef struct zcp_run_info {
 
 	/*
 	 * The maximum number of Lua instructions the channel program is allowed
-	 * to execute. If it takes longer than this it will time out. A value
-	 * of 0 indicates no instruction limit.
+	 * to execute in each txg. If it takes longer than this it will time
+	 * out. A value of 0 indicates no instruction limit.
 	 */
 	uint64_t	zri_maxinstrs;
 
 	/*
-	 * The number of Lua instructions the channel program has executed.
+	 * The number of Lua instructions the channel program has executed
+	 * in the current txg.
 	 */
 	uint64_t	zri_curinstrs;
 
@@ -122,6 +126,25 @@ typedef struct zcp_run_info {
 	 */
 	lua_State	*zri_state;
 
+	/*
+	 * The Lua thread running the script. It is kept apart from the main
+	 * state so that the script can be suspended by zfs.yield() and
+	 * resumed in a later txg.
+	 */
+	lua_State	*zri_thread;
+
+	/*
+	 * Boolean indicating whether the script called zfs.yield() and
+	 * should be resumed in the next txg.
+	 */
+	boolean_t	zri_yielded;
+
+	/*
+	 * Datasets passed to zfs.yield() to be read in from open context
+	 * before the script is resumed.
+	 */
+	nvlist_t	*zri_prefetch;
+
 	/*
 	 * Lua memory allocator arguments.
 	 */
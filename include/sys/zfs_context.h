@@ -165,44 +165,65 @@ extern void vpanic(const char *, va_list)
 
 /*
  * DTrace SDT probes have different signatures in userland than they do in
- * the kernel.  If they're being used in kernel code, re-define them out of
- * existence for their counterparts in libzpool.
+ * the kernel.  If they're being used in kernel code, re-define them for
+ * their counterparts in libzpool.
  *
- * Here's an example of how to use the set-error probes in userland:
- * zfs$target:::set-error /arg0 == EBUSY/ {stack();}
+ * When systemtap's <sys/sdt.h> is available, every DTRACE_PROBE becomes a
+ * USDT probe of the "zfs" provider, with the same name and arguments as
+ * the kernel tracepoint.  Disabled probes are a single nop.  For example,
+ * the zio latency of ztest can be measured with:
+ * bpftrace -p $PID -e 'usdt:libzpool.so:zfs:zio__create { @s[arg0] = nsecs; }
+ *     usdt:libzpool.so:zfs:zio__done /@s[arg0]/ {
+ *     @lat = hist(nsecs - @s[arg0]); delete(@s[arg0]); }'
  *
- * Here's an example of how to use DTRACE_PROBE probes in userland:
- * If there is a probe declared as follows:
- * DTRACE_PROBE2(zfs__probe_name, uint64_t, blkid, dnode_t *, dn);
- * Then you can use it as follows:
- * zfs$target:::probe2 /copyinstr(arg0) == "zfs__probe_name"/
- *     {printf("%u %p\n", arg1, arg2);}
+ * Without it, the probes compile to nothing.
  */
 
 #ifdef DTRACE_PROBE
 #undef	DTRACE_PROBE
 #endif	/* DTRACE_PROBE */
-#define	DTRACE_PROBE(a)
 
 #ifdef DTRACE_PROBE1
 #undef	DTRACE_PROBE1
 #endif	/* DTRACE_PROBE1 */
-#define	DTRACE_PROBE1(a, b, c)
 
 #ifdef DTRACE_PROBE2
 #undef	DTRACE_PROBE2
 #endif	/* DTRACE_PROBE2 */
-#define	DTRACE_PROBE2(a, b, c, d, e)
 
 #ifdef DTRACE_PROBE3
 #undef	DTRACE_PROBE3
 #endif	/* DTRACE_PROBE3 */
-#define	DTRACE_PROBE3(a, b, c, d, e, f, g)
 
 #ifdef DTRACE_PROBE4
 #undef	DTRACE_PROBE4
 #endif	/* DTRACE_PROBE4 */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+/* <sys/sdt.h> has its own DTRACE_PROBE macros, with a provider argument */
+#undef	DTRACE_PROBE
+#undef	DTRACE_PROBE1
+#undef	DTRACE_PROBE2
+#undef	DTRACE_PROBE3
+#undef	DTRACE_PROBE4
+
+#define	DTRACE_PROBE(a)					STAP_PROBE(zfs, a)
+#define	DTRACE_PROBE1(a, b, c)				STAP_PROBE1(zfs, a, c)
+#define	DTRACE_PROBE2(a, b, c, d, e)			\
+	STAP_PROBE2(zfs, a, c, e)
+#define	DTRACE_PROBE3(a, b, c, d, e, f, g)		\
+	STAP_PROBE3(zfs, a, c, e, g)
+#define	DTRACE_PROBE4(a, b, c, d, e, f, g, h, i)	\
+	STAP_PROBE4(zfs, a, c, e, g, i)
+#else
+#define	DTRACE_PROBE(a)
+#define	DTRACE_PROBE1(a, b, c)
+#define	DTRACE_PROBE2(a, b, c, d, e)
+#define	DTRACE_PROBE3(a, b, c, d, e, f, g)
 #define	DTRACE_PROBE4(a, b, c, d, e, f, g, h, i)
+#endif	/* HAVE_SYS_SDT_H */
 
 /*
  * Tunables.
@@ -485,6 +506,7 @@ typedef struct taskq {
 #define	TASKQ_DYNAMIC		0x0004	/* Use dynamic thread scheduling */
 #define	TASKQ_THREADS_CPU_PCT	0x0008	/* Scale # threads by # cpus */
 #define	TASKQ_DC_BATCH		0x0010	/* Mark threads as batch */
+#define	TASKQ_STEAL		0x0020	/* Per-thread work-stealing queues */
 
 #define	TQ_SLEEP	KM_SLEEP	/* Can block for memory */
 #define	TQ_NOSLEEP	KM_NOSLEEP	/* cannot block for memory; may fail */
@@ -503,6 +525,8 @@ extern taskq_t	*taskq_create_synced(const char *, int, pri_t, int, int, uint_t,
 	    (taskq_create(a, b, c, d, e, f))
 #define	taskq_create_sysdc(a, b, d, e, p, dc, f) \
 	    ((void) sizeof (dc), taskq_create(a, b, maxclsyspri, d, e, f))
+#define	taskq_create_node(a, b, c, d, e, f, n) \
+	    ((void) sizeof (n), taskq_create(a, b, c, d, e, f))
 extern taskqid_t taskq_dispatch(taskq_t *, task_func_t, void *, uint_t);
 extern taskqid_t taskq_dispatch_delay(taskq_t *, task_func_t, void *, uint_t,
     clock_t);
@@ -628,6 +652,10 @@ extern void delay(clock_t ticks);
 
 #define	CPU_SEQID	((uintptr_t)pthread_self() & (max_ncpus - 1))
 #define	CPU_SEQID_UNSTABLE	CPU_SEQID
+#define	boot_nnodes	1
+#define	CPU_NODE	0
+#define	spl_node_index(node)	((void) (node), 0)
+#define	spl_node_id(index)	((void) (index), 0)
 
 #define	kcred		NULL
 #define	CRED()		NULL
@@ -51,6 +51,10 @@ int zfs_file_read(zfs_file_t *fp, void *buf, size_t len, ssize_t *resid);
 int zfs_file_pread(zfs_file_t *fp, void *buf, size_t len, loff_t off,
     ssize_t *resid);
 
+typedef void (zfs_file_aio_done_t)(void *arg, int err, ssize_t resid);
+int zfs_file_aio_rw(zfs_file_t *fp, boolean_t write, void *buf, size_t len,
+    loff_t off, zfs_file_aio_done_t *done, void *arg);
+
 int zfs_file_seek(zfs_file_t *fp, loff_t *offp, int whence);
 int zfs_file_getattr(zfs_file_t *fp, zfs_file_attr_t *zfattr);
 int zfs_file_fsync(zfs_file_t *fp, int flags);
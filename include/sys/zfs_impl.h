@@ -31,6 +31,13 @@
 extern "C" {
 #endif
 
+/*
+ * The checksum benchmark measures block sizes from 1 KiB up to 16 MiB in
+ * steps of four, each of those size classes may get its own fastest
+ * implementation.
+ */
+#define	ZFS_IMPL_SIZE_CLASSES	8
+
 /* generic implementation backends */
 typedef struct
 {
@@ -49,6 +56,9 @@ typedef struct
 	/* setup id as fastest implementation */
 	void (*set_fastest)(uint32_t id);
 
+	/* setup id as fastest implementation for one size class */
+	void (*set_fastest_sized)(uint32_t id, uint32_t sizeclass);
+
 	/* set implementation by id */
 	void (*setid)(uint32_t id);
 
@@ -60,6 +70,7 @@ typedef struct
 extern const zfs_impl_t *zfs_impl_get_ops(const char *algo);
 
 extern const zfs_impl_t zfs_blake3_ops;
+extern const zfs_impl_t zfs_chacha20_ops;
 extern const zfs_impl_t zfs_sha256_ops;
 extern const zfs_impl_t zfs_sha512_ops;
 
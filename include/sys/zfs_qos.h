@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef _SYS_ZFS_QOS_H
+#define	_SYS_ZFS_QOS_H
+
+#include <sys/zfs_context.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-dataset I/O limits, set by the qos_* properties and charged at the
+ * ZPL and zvol entry points.  Each limit is a token bucket refilled at the
+ * configured rate and holding at most one second's worth of tokens.  A
+ * request may drive the bucket negative; the caller then sleeps until the
+ * debt would have been repaid.
+ */
+typedef enum zfs_qos_limit {
+	ZFS_QOS_READ_BW,
+	ZFS_QOS_WRITE_BW,
+	ZFS_QOS_READ_IOPS,
+	ZFS_QOS_WRITE_IOPS,
+	ZFS_QOS_NUM_LIMITS
+} zfs_qos_limit_t;
+
+/* Rates above this are treated as this, to keep the arithmetic in range. */
+#define	ZFS_QOS_RATE_MAX	(1ULL << 42)
+
+typedef struct zfs_qos_bucket {
+	uint64_t	zqb_rate;	/* units per second, 0 is unlimited */
+	int64_t		zqb_tokens;	/* may go negative while in debt */
+	hrtime_t	zqb_last;	/* time of last refill */
+} zfs_qos_bucket_t;
+
+typedef struct zfs_qos {
+	kmutex_t	zq_lock;
+	zfs_qos_bucket_t zq_bucket[ZFS_QOS_NUM_LIMITS];
+	uint16_t	zq_weight;	/* vdev queue weight, see qos_weight */
+} zfs_qos_t;
+
+void zfs_qos_init(zfs_qos_t *zq);
+void zfs_qos_fini(zfs_qos_t *zq);
+void zfs_qos_set_limit(zfs_qos_t *zq, zfs_qos_limit_t limit, uint64_t rate);
+void zfs_qos_charge(zfs_qos_t *zq, boolean_t write, uint64_t bytes);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_ZFS_QOS_H */
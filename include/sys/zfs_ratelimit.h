@@ -38,6 +38,7 @@ typedef struct {
 } zfs_ratelimit_t;
 
 int zfs_ratelimit(zfs_ratelimit_t *rl);
+int zfs_ratelimit_exceeded(zfs_ratelimit_t *rl);
 void zfs_ratelimit_init(zfs_ratelimit_t *rl, unsigned int *burst,
     unsigned int interval);
 void zfs_ratelimit_fini(zfs_ratelimit_t *rl);
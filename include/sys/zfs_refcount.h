@@ -89,6 +89,8 @@ void zfs_refcount_add_few(zfs_refcount_t *, uint64_t, const void *);
 void zfs_refcount_remove_few(zfs_refcount_t *, uint64_t, const void *);
 int64_t zfs_refcount_add_many(zfs_refcount_t *, uint64_t, const void *);
 int64_t zfs_refcount_remove_many(zfs_refcount_t *, uint64_t, const void *);
+boolean_t zfs_refcount_add_if_held(zfs_refcount_t *, const void *);
+boolean_t zfs_refcount_remove_if_shared(zfs_refcount_t *, const void *);
 void zfs_refcount_transfer(zfs_refcount_t *, zfs_refcount_t *);
 void zfs_refcount_transfer_ownership(zfs_refcount_t *, const void *,
     const void *);
@@ -136,6 +138,36 @@ typedef struct refcount {
 #define	zfs_refcount_init()
 #define	zfs_refcount_fini()
 
+static inline boolean_t
+zfs_refcount_add_if_held(zfs_refcount_t *rc, const void *holder)
+{
+	(void) holder;
+	uint64_t count = atomic_load_64(&rc->rc_count);
+
+	while (count != 0) {
+		uint64_t old = atomic_cas_64(&rc->rc_count, count, count + 1);
+		if (old == count)
+			return (B_TRUE);
+		count = old;
+	}
+	return (B_FALSE);
+}
+
+static inline boolean_t
+zfs_refcount_remove_if_shared(zfs_refcount_t *rc, const void *holder)
+{
+	(void) holder;
+	uint64_t count = atomic_load_64(&rc->rc_count);
+
+	while (count > 1) {
+		uint64_t old = atomic_cas_64(&rc->rc_count, count, count - 1);
+		if (old == count)
+			return (B_TRUE);
+		count = old;
+	}
+	return (B_FALSE);
+}
+
 #endif	/* ZFS_DEBUG */
 
 #ifdef	__cplusplus
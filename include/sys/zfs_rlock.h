@@ -51,6 +51,9 @@ typedef struct zfs_rangelock {
 	kmutex_t rl_lock;
 	zfs_rangelock_cb_t *rl_cb;
 	void *rl_arg;
+	struct zfs_rangelock *rl_buckets; /* per-region locks, once sharded */
+	uint_t rl_contended;	/* times rl_lock was found busy */
+	boolean_t rl_bucket;	/* this is one of another lock's buckets */
 } zfs_rangelock_t;
 
 typedef struct zfs_locked_range {
@@ -65,6 +68,7 @@ typedef struct zfs_locked_range {
 	uint8_t lr_proxy;	/* acting for original range */
 	uint8_t lr_write_wanted; /* writer wants to lock this range */
 	uint8_t lr_read_wanted;	/* reader wants to lock this range */
+	struct zfs_locked_range **lr_sub; /* bucket locks, if sharded */
 } zfs_locked_range_t;
 
 void zfs_rangelock_init(zfs_rangelock_t *, zfs_rangelock_cb_t *, void *);
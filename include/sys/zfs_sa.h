@@ -76,6 +76,7 @@ typedef enum zpl_attr {
 	ZPL_DACL_ACES,
 	ZPL_DXATTR,
 	ZPL_PROJID,
+	ZPL_INLINE_DATA,
 	ZPL_END
 } zpl_attr_t;
 
@@ -142,6 +143,13 @@ int zfs_sa_get_xattr(struct znode *);
 int zfs_sa_set_xattr(struct znode *, const char *, const void *, size_t);
 void zfs_sa_upgrade(struct sa_handle  *, dmu_tx_t *);
 void zfs_sa_upgrade_txholds(dmu_tx_t *, struct znode *);
+boolean_t zfs_sa_inline_fits(struct znode *, uint64_t);
+int zfs_sa_inline_read(struct znode *, void *, uint64_t, uint64_t);
+void zfs_sa_inline_update(struct znode *, const void *, uint64_t, dmu_tx_t *);
+void zfs_sa_inline_remove(struct znode *, dmu_tx_t *);
+int zfs_sa_inline_to_blocks_locked(struct znode *);
+int zfs_sa_inline_to_blocks(struct znode *);
+int zfs_sa_inline_freesp(struct znode *, uint64_t, uint64_t);
 void zfs_sa_init(void);
 void zfs_sa_fini(void);
 #endif
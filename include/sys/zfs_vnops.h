@@ -32,7 +32,12 @@
 extern int zfs_bclone_enabled;
 
 extern int zfs_fsync(znode_t *, int, cred_t *);
+extern int zfs_fsync_range(znode_t *, int, uint64_t, uint64_t, cred_t *);
 extern int zfs_read(znode_t *, zfs_uio_t *, int, cred_t *);
+typedef void (zfs_read_done_func_t)(void *, ssize_t, int);
+extern int zfs_read_async(znode_t *, zfs_uio_t *, int,
+    zfs_read_done_func_t *, void *);
+extern void zfs_read_async_wait(zfsvfs_t *);
 extern int zfs_write(znode_t *, zfs_uio_t *, int, cred_t *);
 extern int zfs_holey(znode_t *, ulong_t, loff_t *);
 extern int zfs_access(znode_t *, int, int, cred_t *);
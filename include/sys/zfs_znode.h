@@ -67,6 +67,12 @@ extern "C" {
  */
 #define	ZFS_PROJID		0x0000800000000000ull
 
+/*
+ * INLINE_DATA is used internally to indicate that the file data is stored
+ * in the ZPL_INLINE_DATA system attribute instead of in data blocks.
+ */
+#define	ZFS_INLINE_DATA		0x0001000000000000ull
+
 #define	ZFS_ATTR_SET(zp, attr, value, pflags, tx) \
 { \
 	if (value) \
@@ -112,6 +118,7 @@ extern "C" {
 #define	SA_ZPL_DXATTR(z)	z->z_attr_table[ZPL_DXATTR]
 #define	SA_ZPL_PAD(z)		z->z_attr_table[ZPL_PAD]
 #define	SA_ZPL_PROJID(z)	z->z_attr_table[ZPL_PROJID]
+#define	SA_ZPL_INLINE_DATA(z)	z->z_attr_table[ZPL_INLINE_DATA]
 
 /*
  * Is ID ephemeral?
@@ -196,9 +203,11 @@ typedef struct znode {
 	boolean_t	z_suspended;	/* extra ref from a suspend? */
 	uint_t		z_blksz;	/* block size in bytes */
 	uint_t		z_seq;		/* modification sequence number */
+	uint_t		z_auto_blksz;	/* zfs_recordsize_auto block size */
 	uint64_t	z_mapcnt;	/* number of pages mapped to file */
 	uint64_t	z_dnodesize;	/* dnode size */
 	uint64_t	z_size;		/* file size (cached) */
+	uint64_t	z_replay_eof;	/* new end of file - replay only */
 	uint64_t	z_pflags;	/* pflags (cached) */
 	uint32_t	z_sync_cnt;	/* synchronous open count */
 	uint32_t	z_sync_writes_cnt; /* synchronous write count */
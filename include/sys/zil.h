@@ -472,6 +472,27 @@ typedef struct itx {
 	uint8_t		itx_lr_data[];	/* type-specific part of lr_xx_t */
 } itx_t;
 
+/*
+ * Stages of a ZIL commit for which latency histograms are kept:
+ *
+ * COMMIT: the whole of zil_commit(), from entry until the waiter returns.
+ * ASSIGN: zil_commit_writer() moving itxs from the commit list into lwbs,
+ *         including the time spent waiting for zl_issuer_lock.
+ * ISSUE:  filling and issuing a single lwb (zil_lwb_write_issue()).
+ * WRITE:  from lwb issue until its write zio completes.
+ * FLUSH:  from write completion until the vdev caches have been flushed.
+ */
+typedef enum zil_lat_stage {
+	ZIL_LAT_COMMIT,
+	ZIL_LAT_ASSIGN,
+	ZIL_LAT_ISSUE,
+	ZIL_LAT_WRITE,
+	ZIL_LAT_FLUSH,
+	ZIL_LAT_STAGES
+} zil_lat_stage_t;
+
+#define	ZIL_LAT_BUCKETS	24	/* 1us .. 2^23us (~8s) */
+
 /*
  * Used for zil kstat.
  */
@@ -541,6 +562,15 @@ typedef struct zil_stats {
 	kstat_named_t zil_itx_metaslab_slog_bytes;
 	kstat_named_t zil_itx_metaslab_slog_write;
 	kstat_named_t zil_itx_metaslab_slog_alloc;
+
+	/*
+	 * Latency histograms for the stages of a ZIL commit, one row per
+	 * zil_lat_stage_t.  Bucket "n" counts the events which took less
+	 * than 2^n microseconds; the last bucket also absorbs everything
+	 * slower.  The names ("zil_lat_<stage>_<2^n>us") are filled in by
+	 * zil_kstat_values_init().
+	 */
+	kstat_named_t zil_lat[ZIL_LAT_STAGES][ZIL_LAT_BUCKETS];
 } zil_kstat_values_t;
 
 typedef struct zil_sums {
@@ -564,6 +594,7 @@ typedef struct zil_sums {
 	wmsum_t zil_itx_metaslab_slog_bytes;
 	wmsum_t zil_itx_metaslab_slog_write;
 	wmsum_t zil_itx_metaslab_slog_alloc;
+	uint64_t zil_lat[ZIL_LAT_STAGES][ZIL_LAT_BUCKETS];
 } zil_sums_t;
 
 #define	ZIL_STAT_INCR(zil, stat, val) \
@@ -611,6 +642,8 @@ extern void	zil_itx_assign(zilog_t *zilog, itx_t *itx, dmu_tx_t *tx);
 
 extern void	zil_async_to_sync(zilog_t *zilog, uint64_t oid);
 extern void	zil_commit(zilog_t *zilog, uint64_t oid);
+extern void	zil_commit_range(zilog_t *zilog, uint64_t oid, uint64_t off,
+    uint64_t len);
 extern void	zil_commit_impl(zilog_t *zilog, uint64_t oid);
 extern void	zil_remove_async(zilog_t *zilog, uint64_t oid);
 
@@ -638,6 +671,7 @@ extern uint64_t	zil_max_log_data(zilog_t *zilog, size_t hdrsize);
 
 extern void zil_sums_init(zil_sums_t *zs);
 extern void zil_sums_fini(zil_sums_t *zs);
+extern void zil_kstat_values_init(zil_kstat_values_t *zs);
 extern void zil_kstat_values_update(zil_kstat_values_t *zs,
     zil_sums_t *zil_sums);
 
@@ -59,7 +59,10 @@ typedef struct zio_eck {
 
 /*
  * Gang block headers are self-checksumming and contain an array
- * of block pointers.
+ * of block pointers.  The zio_gbh_phys_t below is the original
+ * SPA_GANGBLOCKSIZE layout; with the dynamic_gang_header feature a header
+ * may fill a whole sector, holding more block pointers with the
+ * checksum tail moved to its end (see zio_gang_header_size()).
  */
 #define	SPA_GANGBLOCKSIZE	SPA_MINBLOCKSIZE
 #define	SPA_GBH_NBLKPTRS	((SPA_GANGBLOCKSIZE - \
@@ -75,6 +78,25 @@ typedef struct zio_gbh {
 	zio_eck_t		zg_tail;
 } zio_gbh_phys_t;
 
+static inline uint64_t
+gbh_nblkptrs(uint64_t size)
+{
+	ASSERT3U(size, >=, SPA_GANGBLOCKSIZE);
+	return ((size - sizeof (zio_eck_t)) / sizeof (blkptr_t));
+}
+
+static inline blkptr_t *
+gbh_bp(zio_gbh_phys_t *gbh, int g)
+{
+	return (&((blkptr_t *)gbh)[g]);
+}
+
+static inline zio_eck_t *
+gbh_eck(zio_gbh_phys_t *gbh, uint64_t size)
+{
+	return ((zio_eck_t *)((char *)gbh + size - sizeof (zio_eck_t)));
+}
+
 enum zio_checksum {
 	ZIO_CHECKSUM_INHERIT = 0,
 	ZIO_CHECKSUM_ON,
@@ -228,6 +250,7 @@ typedef uint64_t zio_flag_t;
 #define	ZIO_FLAG_DELEGATED	(1ULL << 31)
 #define	ZIO_FLAG_DIO_CHKSUM_ERR	(1ULL << 32)
 #define	ZIO_FLAG_PREALLOCATED	(1ULL << 33)
+#define	ZIO_FLAG_DDT_PREFETCHED	(1ULL << 34)
 
 #define	ZIO_ALLOCATOR_NONE	(-1)
 #define	ZIO_HAS_ALLOCATOR(zio)	((zio)->io_allocator != ZIO_ALLOCATOR_NONE)
@@ -365,8 +388,17 @@ typedef struct zio_prop {
 	uint8_t			zp_mac[ZIO_DATA_MAC_LEN];
 	uint32_t		zp_zpl_smallblk;
 	dmu_object_type_t	zp_storage_type;
+	uint8_t			zp_class_hint;
 } zio_prop_t;
 
+/*
+ * Allocation class placement hints for level 0 file blocks, set by
+ * zfs_rewrite() to move existing data between allocation classes.
+ */
+#define	ZIO_CLASS_HINT_NONE	0	/* Normal class selection */
+#define	ZIO_CLASS_HINT_SPECIAL	1	/* Prefer special class if room */
+#define	ZIO_CLASS_HINT_NORMAL	2	/* Keep out of special class */
+
 typedef struct zio_cksum_report zio_cksum_report_t;
 
 typedef void zio_cksum_finish_f(zio_cksum_report_t *rep,
@@ -399,7 +431,8 @@ typedef struct zio_vsd_ops {
 
 typedef struct zio_gang_node {
 	zio_gbh_phys_t		*gn_gbh;
-	struct zio_gang_node	*gn_child[SPA_GBH_NBLKPTRS];
+	uint64_t		gn_gangblocksize;
+	struct zio_gang_node	*gn_child[];
 } zio_gang_node_t;
 
 typedef zio_t *zio_gang_issue_func_t(zio_t *zio, blkptr_t *bp,
@@ -433,11 +466,13 @@ typedef zio_t *zio_pipe_stage_t(zio_t *zio);
  */
 enum trim_flag {
 	ZIO_TRIM_SECURE		= 1U << 0,
+	ZIO_TRIM_ZEROES		= 1U << 1,	/* write zeroes instead */
 };
 
 typedef struct zio_alloc_list {
 	list_t  zal_list;
 	uint64_t zal_size;
+	uint64_t zal_stream;	/* metaslab stream of the block, or 0 */
 } zio_alloc_list_t;
 
 typedef struct zio_link {
@@ -451,6 +486,7 @@ enum zio_qstate {
 	ZIO_QS_NONE = 0,
 	ZIO_QS_QUEUED,
 	ZIO_QS_ACTIVE,
+	ZIO_QS_BYPASS,
 };
 
 struct zio {
@@ -470,6 +506,7 @@ struct zio {
 	blkptr_t	io_bp_copy;
 	list_t		io_parent_list;
 	list_t		io_child_list;
+	zio_link_t	io_parent_link;	/* link to the parent given at create */
 	zio_t		*io_logical;
 	zio_transform_t *io_transform_stack;
 
@@ -496,18 +533,20 @@ struct zio {
 	metaslab_class_t *io_metaslab_class;	/* dva throttle class */
 
 	enum zio_qstate	io_queue_state;	/* vdev queue state */
+	uint16_t	io_qos_weight;	/* dataset qos_weight, 0 if none */
 	union {
 		list_node_t l;
 		avl_node_t a;
-	} io_queue_node ____cacheline_aligned;	/* allocator and vdev queues */
-	avl_node_t	io_offset_node;	/* vdev offset queues */
+	} io_queue_node ____cacheline_aligned;	/* alloc, cksum, vdev queues */
 	uint64_t	io_offset;
 	hrtime_t	io_timestamp;	/* submitted at */
 	hrtime_t	io_queued_timestamp;
 	hrtime_t	io_target_timestamp;
+	hrtime_t	io_throttle_timestamp;	/* queued for allocation at */
 	hrtime_t	io_delta;	/* vdev queue service delta */
 	hrtime_t	io_delay;	/* Device access time (disk or */
 					/* file). */
+	hrtime_t	io_stage_timestamp; /* current stage started at */
 	zio_alloc_list_t 	io_alloc_list;
 
 	/* Internal pipeline state */
@@ -661,6 +700,8 @@ extern enum zio_compress zio_compress_select(spa_t *spa,
     enum zio_compress child, enum zio_compress parent);
 extern uint8_t zio_complevel_select(spa_t *spa, enum zio_compress compress,
     uint8_t child, uint8_t parent);
+extern enum zio_compress zio_compress_chunked(spa_t *spa,
+    enum zio_compress compress, uint64_t lsize);
 
 extern void zio_suspend(spa_t *spa, zio_t *zio, zio_suspend_reason_t);
 extern int zio_resume(spa_t *spa);
@@ -668,6 +709,8 @@ extern void zio_resume_wait(spa_t *spa);
 
 extern int zfs_blkptr_verify(spa_t *spa, const blkptr_t *bp,
     enum blk_config_flag blk_config, enum blk_verify_flag blk_verify);
+extern uint64_t zio_gang_header_size(spa_t *spa, const blkptr_t *bp,
+    uint64_t birth);
 
 /*
  * Initial setup and teardown.
@@ -130,6 +130,8 @@ extern zio_checksum_t abd_checksum_blake3_native;
 extern zio_checksum_t abd_checksum_blake3_byteswap;
 extern zio_checksum_tmpl_init_t abd_checksum_blake3_tmpl_init;
 extern zio_checksum_tmpl_free_t abd_checksum_blake3_tmpl_free;
+extern void abd_checksum_blake3_native_many(struct abd **, uint_t,
+    uint64_t, const void *, zio_cksum_t *);
 
 /* Fletcher 4 */
 _SYS_ZIO_CHECKSUM_H zio_abd_checksum_func_t fletcher_4_abd_ops;
@@ -140,6 +142,7 @@ extern int zio_checksum_equal(spa_t *, blkptr_t *, enum zio_checksum,
     void *, uint64_t, uint64_t, zio_bad_cksum_t *);
 extern void zio_checksum_compute(zio_t *, enum zio_checksum,
     struct abd *, uint64_t);
+extern void zio_checksum_compute_many(zio_t **, uint_t, enum zio_checksum);
 extern int zio_checksum_error_impl(spa_t *, const blkptr_t *, enum zio_checksum,
     struct abd *, uint64_t, uint64_t, zio_bad_cksum_t *);
 extern int zio_checksum_error(zio_t *zio, zio_bad_cksum_t *out);
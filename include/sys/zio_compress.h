@@ -56,13 +56,25 @@ enum zio_compress {
 	ZIO_COMPRESS_ZLE,
 	ZIO_COMPRESS_LZ4,
 	ZIO_COMPRESS_ZSTD,
+	ZIO_COMPRESS_LZ4_CHUNKED,
+	ZIO_COMPRESS_ZSTD_CHUNKED,
 	ZIO_COMPRESS_FUNCTIONS
 };
 
 /* Compression algorithms that have levels */
-#define	ZIO_COMPRESS_HASLEVEL(compress)	((compress == ZIO_COMPRESS_ZSTD || \
-					(compress >= ZIO_COMPRESS_GZIP_1 && \
-					compress <= ZIO_COMPRESS_GZIP_9)))
+#define	ZIO_COMPRESS_HASLEVEL(compress)	\
+	((compress) == ZIO_COMPRESS_ZSTD ||	\
+	(compress) == ZIO_COMPRESS_ZSTD_CHUNKED ||	\
+	((compress) >= ZIO_COMPRESS_GZIP_1 &&	\
+	(compress) <= ZIO_COMPRESS_GZIP_9))
+
+/*
+ * Block formats made of independently compressed chunks.  These are only
+ * chosen by the write policy for large blocks, never set as a property.
+ */
+#define	ZIO_COMPRESS_IS_CHUNKED(compress)	\
+	((compress) == ZIO_COMPRESS_LZ4_CHUNKED ||	\
+	(compress) == ZIO_COMPRESS_ZSTD_CHUNKED)
 
 #define	ZIO_COMPLEVEL_INHERIT	0
 #define	ZIO_COMPLEVEL_DEFAULT	255
@@ -116,7 +128,7 @@ enum zio_zstd_levels {
 	ZIO_ZSTD_LEVEL_FAST_500,
 	ZIO_ZSTD_LEVEL_FAST_1000,
 #define	ZIO_ZSTD_LEVEL_FAST_MAX	ZIO_ZSTD_LEVEL_FAST_1000
-	ZIO_ZSTD_LEVEL_AUTO = 251, /* Reserved for future use */
+	ZIO_ZSTD_LEVEL_AUTO = 251, /* Level picked per block when written */
 	ZIO_ZSTD_LEVEL_LEVELS
 };
 
@@ -180,6 +192,15 @@ extern size_t zio_compress_data(enum zio_compress c, abd_t *src, abd_t **dst,
 extern int zio_decompress_data(enum zio_compress c, abd_t *src, abd_t *abd,
     size_t s_len, size_t d_len, uint8_t *level);
 extern int zio_compress_to_feature(enum zio_compress comp);
+extern boolean_t zio_compress_incompressible(abd_t *src, size_t s_len);
+
+/*
+ * Level selection for compression=zstd-auto.
+ */
+extern void zio_compress_init(void);
+extern void zio_compress_fini(void);
+extern uint8_t zio_zstd_auto_level(void);
+extern void zio_zstd_auto_done(uint8_t level, size_t lsize, size_t psize);
 
 #define	ZFS_COMPRESS_WRAP_DECL(name)					\
 size_t									\
@@ -43,10 +43,14 @@ struct zbookmark_phys;
 
 #define	ZIO_CRYPT_KEY_CURRENT_VERSION	1ULL
 
+/* number of keys derived from older salts kept around for each master key */
+#define	ZIO_CRYPT_KEY_CACHE_SIZE	8
+
 typedef enum zio_crypt_type {
 	ZC_TYPE_NONE = 0,
 	ZC_TYPE_CCM,
-	ZC_TYPE_GCM
+	ZC_TYPE_GCM,
+	ZC_TYPE_CHACHA20_POLY1305
 } zio_crypt_type_t;
 
 /* table of supported crypto algorithms, modes and keylengths. */
@@ -61,7 +65,7 @@ typedef struct zio_crypt_info {
 #else
 	crypto_mech_name_t ci_mechname;
 #endif
-	/* cipher mode type (GCM, CCM) */
+	/* cipher mode type (GCM, CCM, ChaCha20-Poly1305) */
 	zio_crypt_type_t ci_crypt_type;
 
 	/* length of the encryption key */
@@ -73,6 +77,21 @@ typedef struct zio_crypt_info {
 
 extern const zio_crypt_info_t zio_crypt_table[ZIO_CRYPT_FUNCTIONS];
 
+#if !defined(__FreeBSD__) || !defined(_KERNEL)
+/* an encryption key derived from the master key and a non-current salt */
+typedef struct zio_crypt_cached_key {
+	/* salt the key was derived from */
+	uint8_t zck_salt[ZIO_DATA_SALT_LEN];
+
+	/* buffer for the derived key */
+	uint8_t zck_keydata[MASTER_KEY_MAX_LEN];
+
+	/* illumos crypto api derived key, ck_data is NULL if unused */
+	crypto_key_t zck_key;
+	crypto_ctx_template_t zck_tmpl;
+} zio_crypt_cached_key_t;
+#endif
+
 /* in memory representation of an unwrapped key that is loaded into memory */
 typedef struct zio_crypt_key {
 	/* encryption algorithm */
@@ -108,6 +127,12 @@ typedef struct zio_crypt_key {
 #else
 	/* template of current encryption key for illumos crypto api */
 	crypto_ctx_template_t zk_current_tmpl;
+
+	/* recently used keys derived from older salts */
+	zio_crypt_cached_key_t zk_cache[ZIO_CRYPT_KEY_CACHE_SIZE];
+
+	/* next zk_cache entry to replace */
+	uint_t zk_cache_next;
 #endif
 
 	/* illumos crypto api current hmac key */
@@ -116,7 +141,7 @@ typedef struct zio_crypt_key {
 	/* template of hmac key for illumos crypto api */
 	crypto_ctx_template_t zk_hmac_tmpl;
 
-	/* lock for changing the salt and dependent values */
+	/* lock for changing the salt, dependent values and zk_cache */
 	krwlock_t zk_salt_lock;
 } zio_crypt_key_t;
 
@@ -166,6 +166,10 @@ enum zio_stage {
 	ZIO_STAGE_DONE			= 1 << 26	/* RWFCXT */
 };
 
+#define	ZIO_STAGES	27	/* highbit64(ZIO_STAGE_DONE) */
+
+extern const char *const zio_stage_names[ZIO_STAGES];
+
 #define	ZIO_ROOT_PIPELINE			\
 	ZIO_STAGE_DONE
 
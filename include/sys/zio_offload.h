@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	_SYS_ZIO_OFFLOAD_H
+#define	_SYS_ZIO_OFFLOAD_H
+
+#include <sys/zfs_context.h>
+#include <sys/zio.h>
+#include <sys/zio_compress.h>
+#include <sys/crypto/api.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hardware offload providers.
+ *
+ * An accelerator driver registers a zio_offload_provider_t with
+ * zio_offload_register().  The compression, checksum and encryption code
+ * then asks the registered providers, in registration order, to handle each
+ * operation before falling back to the software implementation.  A provider
+ * may decline any request, e.g. because its queues are full, by returning
+ * an error; the next provider or the software path is then used.
+ */
+typedef enum zio_offload_op {
+	ZIO_OFFLOAD_COMPRESS,
+	ZIO_OFFLOAD_DECOMPRESS,
+	ZIO_OFFLOAD_CHECKSUM,
+	ZIO_OFFLOAD_ENCRYPT,
+	ZIO_OFFLOAD_DECRYPT,
+	ZIO_OFFLOAD_OPS
+} zio_offload_op_t;
+
+typedef struct zio_offload_provider {
+	const char	*zop_name;
+
+	/*
+	 * Cheap check of whether the provider would accept an operation on
+	 * "len" bytes with algorithm "alg" (an enum zio_compress,
+	 * enum zio_checksum or enum zio_encrypt, depending on "op").  Called
+	 * before the caller prepares linear buffers for the request.
+	 */
+	boolean_t	(*zop_usable)(zio_offload_op_t op, uint64_t alg,
+	    size_t len);
+
+	/*
+	 * Compress or decompress.  On compression, returns E2BIG if the
+	 * result would not fit in d_len bytes.
+	 */
+	int		(*zop_compress)(zio_offload_op_t op,
+	    enum zio_compress alg, int level, void *src, size_t s_len,
+	    void *dst, size_t d_len, size_t *c_len);
+
+	int		(*zop_checksum)(enum zio_checksum alg, void *buf,
+	    size_t size, zio_cksum_t *zcp);
+
+	/*
+	 * Authenticated encryption or decryption of len bytes from src to
+	 * dst, producing or verifying the MAC in digest.
+	 */
+	int		(*zop_crypt)(zio_offload_op_t op, uint64_t crypt,
+	    crypto_key_t *key, uint8_t *src, uint8_t *dst, uint8_t *aad,
+	    uint_t aad_len, uint8_t *iv, uint8_t *digest, uint_t len);
+} zio_offload_provider_t;
+
+extern void zio_offload_init(void);
+extern void zio_offload_fini(void);
+extern int zio_offload_register(const zio_offload_provider_t *zop);
+extern void zio_offload_unregister(const zio_offload_provider_t *zop);
+
+/*
+ * Consumer interface.  zio_offload_usable() returns B_FALSE without
+ * taking any lock when no provider is registered.  The others return 0 if
+ * a provider performed the operation, E2BIG if a provider found the data
+ * incompressible, and ENOTSUP if the software implementation must be used.
+ */
+extern boolean_t zio_offload_usable(zio_offload_op_t op, uint64_t alg,
+    size_t len);
+extern int zio_offload_compress(zio_offload_op_t op, enum zio_compress alg,
+    int level, void *src, size_t s_len, void *dst, size_t d_len,
+    size_t *c_len);
+extern int zio_offload_checksum(enum zio_checksum alg, void *buf,
+    size_t size, zio_cksum_t *zcp);
+extern int zio_offload_crypt(zio_offload_op_t op, uint64_t crypt,
+    crypto_key_t *key, uint8_t *src, uint8_t *dst, uint8_t *aad,
+    uint_t aad_len, uint8_t *iv, uint8_t *digest, uint_t len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_ZIO_OFFLOAD_H */
@@ -87,6 +87,10 @@ typedef enum spa_feature {
 	SPA_FEATURE_FAST_DEDUP,
 	SPA_FEATURE_LONGNAME,
 	SPA_FEATURE_LARGE_MICROZAP,
+	SPA_FEATURE_CHACHA20_POLY1305,
+	SPA_FEATURE_INLINE_DATA,
+	SPA_FEATURE_CHUNKED_COMPRESS,
+	SPA_FEATURE_DYNAMIC_GANG_HEADER,
 	SPA_FEATURES
 } spa_feature_t;
 
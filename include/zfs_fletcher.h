@@ -104,10 +104,10 @@ typedef union fletcher_4_ctx {
 	zfs_fletcher_avx_t avx[4];
 #endif
 #if defined(__x86_64) && defined(HAVE_AVX512F)
-	zfs_fletcher_avx512_t avx512[4];
+	zfs_fletcher_avx512_t avx512[8];
 #endif
 #if defined(__aarch64__)
-	zfs_fletcher_aarch64_neon_t aarch64_neon[4];
+	zfs_fletcher_aarch64_neon_t aarch64_neon[8];
 #endif
 } fletcher_4_ctx_t;
 
@@ -148,6 +148,7 @@ _ZFS_FLETCHER_H const fletcher_4_ops_t fletcher_4_avx2_ops;
 
 #if defined(__x86_64) && defined(HAVE_AVX512F)
 _ZFS_FLETCHER_H const fletcher_4_ops_t fletcher_4_avx512f_ops;
+_ZFS_FLETCHER_H const fletcher_4_ops_t fletcher_4_avx512fx2_ops;
 #endif
 
 #if defined(__x86_64) && defined(HAVE_AVX512BW)
@@ -156,6 +157,7 @@ _ZFS_FLETCHER_H const fletcher_4_ops_t fletcher_4_avx512bw_ops;
 
 #if defined(__aarch64__)
 _ZFS_FLETCHER_H const fletcher_4_ops_t fletcher_4_aarch64_neon_ops;
+_ZFS_FLETCHER_H const fletcher_4_ops_t fletcher_4_aarch64_neonx2_ops;
 #endif
 
 #ifdef	__cplusplus
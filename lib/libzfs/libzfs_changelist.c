@@ -87,6 +87,13 @@ struct prop_changelist {
 	boolean_t		cl_haszonedchild;
 };
 
+/*
+ * Number of threads used to mount file systems for CL_GATHER_PARALLEL_MOUNT.
+ * This matches what "zfs mount -a" uses; the threads mostly wait in the
+ * kernel.
+ */
+#define	CL_MOUNT_NTHR	512
+
 /*
  * If the property is 'mountpoint', go through and unmount filesystems as
  * necessary.  We don't do the same for 'sharenfs', because we can just re-share
@@ -167,6 +174,89 @@ changelist_prefix(prop_changelist_t *clp)
 	return (ret);
 }
 
+/*
+ * Should changelist_postfix() mount this currently unmounted node?
+ */
+static boolean_t
+changelist_want_mount(prop_changelist_t *clp, prop_changenode_t *cn,
+    boolean_t sharenfs, boolean_t sharesmb)
+{
+	if (zfs_prop_get_int(cn->cn_handle, ZFS_PROP_KEYSTATUS) ==
+	    ZFS_KEYSTATUS_UNAVAILABLE)
+		return (B_FALSE);
+
+	/*
+	 * Remount if previously mounted or mountpoint was legacy,
+	 * or sharenfs or sharesmb  property is set.
+	 */
+	return (cn->cn_mounted ||
+	    (((clp->cl_prop == ZFS_PROP_MOUNTPOINT &&
+	    clp->cl_prop == clp->cl_realprop) ||
+	    sharenfs || sharesmb || clp->cl_waslegacy) &&
+	    (zfs_prop_get_int(cn->cn_handle,
+	    ZFS_PROP_CANMOUNT) == ZFS_CANMOUNT_ON)));
+}
+
+static boolean_t
+changelist_node_shared(prop_changenode_t *cn, zfs_prop_t prop)
+{
+	char shareopts[ZFS_MAXPROPLEN];
+
+	return ((zfs_prop_get(cn->cn_handle, prop, shareopts,
+	    sizeof (shareopts), NULL, NULL, 0, B_FALSE) == 0) &&
+	    (strcmp(shareopts, "off") != 0));
+}
+
+static int
+changelist_mount_one(zfs_handle_t *zhp, void *arg)
+{
+	(void) arg;
+	(void) zfs_mount(zhp, NULL, 0);
+	return (0);
+}
+
+/*
+ * Mount all the nodes that changelist_postfix() would mount, using
+ * zfs_foreach_mountpoint() so that file systems which don't depend on each
+ * other are mounted concurrently.  Sharing is left to changelist_postfix(),
+ * since libshare is not mt-safe.
+ */
+static void
+changelist_mount_parallel(libzfs_handle_t *hdl, prop_changelist_t *clp)
+{
+	prop_changenode_t *cn;
+	zfs_handle_t **handles;
+	size_t count = 0;
+
+	handles = zfs_alloc(hdl,
+	    uu_avl_numnodes(clp->cl_tree) * sizeof (zfs_handle_t *));
+
+	for (cn = uu_avl_first(clp->cl_tree); cn != NULL;
+	    cn = uu_avl_next(clp->cl_tree, cn)) {
+		if (getzoneid() == GLOBAL_ZONEID && cn->cn_zoned)
+			continue;
+		if (!cn->cn_needpost)
+			continue;
+
+		zfs_refresh_properties(cn->cn_handle);
+
+		if (ZFS_IS_VOLUME(cn->cn_handle) ||
+		    zfs_is_mounted(cn->cn_handle, NULL))
+			continue;
+
+		if (changelist_want_mount(clp, cn,
+		    changelist_node_shared(cn, ZFS_PROP_SHARENFS),
+		    changelist_node_shared(cn, ZFS_PROP_SHARESMB)))
+			handles[count++] = cn->cn_handle;
+	}
+
+	if (count > 0) {
+		zfs_foreach_mountpoint(hdl, handles, count,
+		    changelist_mount_one, NULL, CL_MOUNT_NTHR);
+	}
+	free(handles);
+}
+
 /*
  * If the property is 'mountpoint' or 'sharenfs', go through and remount and/or
  * reshare the filesystems as necessary.  In changelist_gather() we recorded
@@ -180,7 +270,6 @@ changelist_postfix(prop_changelist_t *clp)
 {
 	prop_changenode_t *cn;
 	uu_avl_walk_t *walk;
-	char shareopts[ZFS_MAXPROPLEN];
 	boolean_t commit_smb_shares = B_FALSE;
 	boolean_t commit_nfs_shares = B_FALSE;
 
@@ -206,6 +295,9 @@ changelist_postfix(prop_changelist_t *clp)
 	    !(clp->cl_gflags & CL_GATHER_DONT_UNMOUNT))
 		remove_mountpoint(cn->cn_handle);
 
+	if (clp->cl_gflags & CL_GATHER_PARALLEL_MOUNT)
+		changelist_mount_parallel(cn->cn_handle->zfs_hdl, clp);
+
 	/*
 	 * We walk the datasets in reverse, because we want to mount any parent
 	 * datasets before mounting the children.  We walk all datasets even if
@@ -220,7 +312,6 @@ changelist_postfix(prop_changelist_t *clp)
 		boolean_t sharenfs;
 		boolean_t sharesmb;
 		boolean_t mounted;
-		boolean_t needs_key;
 
 		/*
 		 * If we are in the global zone, but this dataset is exported
@@ -239,30 +330,17 @@ changelist_postfix(prop_changelist_t *clp)
 		if (ZFS_IS_VOLUME(cn->cn_handle))
 			continue;
 
-		/*
-		 * Remount if previously mounted or mountpoint was legacy,
-		 * or sharenfs or sharesmb  property is set.
-		 */
-		sharenfs = ((zfs_prop_get(cn->cn_handle, ZFS_PROP_SHARENFS,
-		    shareopts, sizeof (shareopts), NULL, NULL, 0,
-		    B_FALSE) == 0) && (strcmp(shareopts, "off") != 0));
-
-		sharesmb = ((zfs_prop_get(cn->cn_handle, ZFS_PROP_SHARESMB,
-		    shareopts, sizeof (shareopts), NULL, NULL, 0,
-		    B_FALSE) == 0) && (strcmp(shareopts, "off") != 0));
-
-		needs_key = (zfs_prop_get_int(cn->cn_handle,
-		    ZFS_PROP_KEYSTATUS) == ZFS_KEYSTATUS_UNAVAILABLE);
+		sharenfs = changelist_node_shared(cn, ZFS_PROP_SHARENFS);
+		sharesmb = changelist_node_shared(cn, ZFS_PROP_SHARESMB);
 
 		mounted = zfs_is_mounted(cn->cn_handle, NULL);
 
-		if (!mounted && !needs_key && (cn->cn_mounted ||
-		    (((clp->cl_prop == ZFS_PROP_MOUNTPOINT &&
-		    clp->cl_prop == clp->cl_realprop) ||
-		    sharenfs || sharesmb || clp->cl_waslegacy) &&
-		    (zfs_prop_get_int(cn->cn_handle,
-		    ZFS_PROP_CANMOUNT) == ZFS_CANMOUNT_ON)))) {
-
+		/*
+		 * With CL_GATHER_PARALLEL_MOUNT the mounts have already been
+		 * attempted; don't retry the ones that failed.
+		 */
+		if (!mounted && !(clp->cl_gflags & CL_GATHER_PARALLEL_MOUNT) &&
+		    changelist_want_mount(clp, cn, sharenfs, sharesmb)) {
 			if (zfs_mount(cn->cn_handle, NULL, 0) == 0)
 				mounted = TRUE;
 		}
@@ -62,27 +62,85 @@
 #define	ZDIFF_RENAMED_COLOR  ANSI_BOLD_BLUE
 
 /*
- * Given a {dsname, object id}, get the object path
+ * Get the paths and stats of the objects first to last of dsname in one
+ * ZFS_IOC_OBJS_TO_STATS call, for get_stats_for_obj().  Returns NULL if
+ * that fails, leaving get_stats_for_obj() to look the objects up one by
+ * one (and report any error).
+ */
+static nvlist_t *
+get_stats_for_objs(differ_info_t *di, const char *dsname, uint64_t first,
+    uint64_t last)
+{
+	uint64_t objs[ZFS_OBJS_STATS_MAX];
+	nvlist_t *result = NULL;
+	uint_t nobjs = 0;
+	int err;
+
+	ASSERT3U(last - first, <, ZFS_OBJS_STATS_MAX);
+
+	if (di->no_objs_to_stats)
+		return (NULL);
+
+	for (uint64_t o = first; o <= last; o++) {
+		if (o != di->shares)
+			objs[nobjs++] = o;
+	}
+	err = lzc_objs_to_stats(dsname, objs, nobjs, &result);
+	if (err != 0) {
+		nvlist_free(result);
+		if (err == ZFS_ERR_IOC_CMD_UNAVAIL)
+			di->no_objs_to_stats = B_TRUE;
+		return (NULL);
+	}
+	return (result);
+}
+
+/*
+ * Given a {dsname, object id}, get the object path.  If batch is not NULL,
+ * it holds the result of get_stats_for_objs() for a range including obj.
  */
 static int
 get_stats_for_obj(differ_info_t *di, const char *dsname, uint64_t obj,
-    char *pn, int maxlen, zfs_stat_t *sb)
+    char *pn, int maxlen, zfs_stat_t *sb, nvlist_t *batch)
 {
 	zfs_cmd_t zc = {"\0"};
+	const char *path;
+	nvlist_t *entry;
+	char name[32];
 	int error;
 
-	(void) strlcpy(zc.zc_name, dsname, sizeof (zc.zc_name));
-	zc.zc_obj = obj;
+	(void) snprintf(name, sizeof (name), "%llu", (u_longlong_t)obj);
+	if (batch != NULL && nvlist_lookup_nvlist(batch, name, &entry) == 0) {
+		uint8_t *stat;
+		uint_t len;
+
+		if (nvlist_lookup_uint8_array(entry, ZFS_OBJS_STATS_STAT,
+		    &stat, &len) == 0 && len == sizeof (zfs_stat_t))
+			(void) memcpy(sb, stat, sizeof (zfs_stat_t));
+		else
+			(void) memset(sb, 0, sizeof (zfs_stat_t));
+		if (nvlist_lookup_int32(entry, ZFS_OBJS_STATS_ERROR,
+		    &di->zerr) != 0)
+			di->zerr = 0;
+		if (nvlist_lookup_string(entry, ZFS_OBJS_STATS_PATH,
+		    &path) != 0)
+			path = "";
+		error = (di->zerr == 0) ? 0 : -1;
+	} else {
+		(void) strlcpy(zc.zc_name, dsname, sizeof (zc.zc_name));
+		zc.zc_obj = obj;
 
-	errno = 0;
-	error = zfs_ioctl(di->zhp->zfs_hdl, ZFS_IOC_OBJ_TO_STATS, &zc);
-	di->zerr = errno;
+		errno = 0;
+		error = zfs_ioctl(di->zhp->zfs_hdl, ZFS_IOC_OBJ_TO_STATS, &zc);
+		di->zerr = errno;
 
-	/* we can get stats even if we failed to get a path */
-	(void) memcpy(sb, &zc.zc_stat, sizeof (zfs_stat_t));
+		/* we can get stats even if we failed to get a path */
+		(void) memcpy(sb, &zc.zc_stat, sizeof (zfs_stat_t));
+		path = zc.zc_value;
+	}
 	if (error == 0) {
 		ASSERT(di->zerr == 0);
-		(void) strlcpy(pn, zc.zc_value, maxlen);
+		(void) strlcpy(pn, path, maxlen);
 		return (0);
 	}
 
@@ -260,7 +318,8 @@ print_file(FILE *fp, differ_info_t *di, char type, const char *file,
 }
 
 static int
-write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
+write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj,
+    nvlist_t *fbatch, nvlist_t *tbatch)
 {
 	struct zfs_stat fsb, tsb;
 	mode_t fmode, tmode;
@@ -282,7 +341,7 @@ write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
 	 */
 
 	fobjerr = get_stats_for_obj(di, di->fromsnap, dobj, fobjname,
-	    MAXPATHLEN, &fsb);
+	    MAXPATHLEN, &fsb, fbatch);
 	if (fobjerr && di->zerr != ENOTSUP && di->zerr != ENOENT) {
 		zfs_error_aux(di->zhp->zfs_hdl, "%s", zfs_strerror(di->zerr));
 		zfs_error(di->zhp->zfs_hdl, di->zerr, di->errbuf);
@@ -294,7 +353,7 @@ write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
 	}
 
 	tobjerr = get_stats_for_obj(di, di->tosnap, dobj, tobjname,
-	    MAXPATHLEN, &tsb);
+	    MAXPATHLEN, &tsb, tbatch);
 
 	if (tobjerr && di->zerr != ENOTSUP && di->zerr != ENOENT) {
 		if (!already_logged) {
@@ -365,14 +424,25 @@ write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
 static int
 write_inuse_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
 {
-	uint64_t o;
-	int err;
+	uint64_t o, last;
+	int err = 0;
 
-	for (o = dr->ddr_first; o <= dr->ddr_last; o++) {
-		if ((err = write_inuse_diffs_one(fp, di, o)) != 0)
-			return (err);
+	/*
+	 * Look the objects up ZFS_OBJS_STATS_MAX at a time in each snapshot,
+	 * rather than with two ioctls per object.
+	 */
+	for (o = dr->ddr_first; o <= dr->ddr_last && err == 0; o = last + 1) {
+		nvlist_t *fbatch, *tbatch;
+
+		last = MIN(dr->ddr_last, o + ZFS_OBJS_STATS_MAX - 1);
+		fbatch = get_stats_for_objs(di, di->fromsnap, o, last);
+		tbatch = get_stats_for_objs(di, di->tosnap, o, last);
+		for (uint64_t i = o; i <= last && err == 0; i++)
+			err = write_inuse_diffs_one(fp, di, i, fbatch, tbatch);
+		nvlist_free(fbatch);
+		nvlist_free(tbatch);
 	}
-	return (0);
+	return (err);
 }
 
 static int
@@ -382,7 +452,7 @@ describe_free(FILE *fp, differ_info_t *di, uint64_t object, char *namebuf,
 	struct zfs_stat sb;
 
 	(void) get_stats_for_obj(di, di->fromsnap, object, namebuf,
-	    maxlen, &sb);
+	    maxlen, &sb, NULL);
 
 	/* Don't print if in the delete queue on from side */
 	if (di->zerr == ESTALE || di->zerr == ENOENT) {
@@ -141,6 +141,8 @@ extern int zpool_standard_error_fmt(libzfs_handle_t *, int, const char *, ...)
     __attribute__((format(printf, 3, 4)));
 
 extern zfs_handle_t *make_dataset_handle_zc(libzfs_handle_t *, zfs_cmd_t *);
+extern zfs_handle_t *make_dataset_handle_stats(libzfs_handle_t *,
+    const char *, const dmu_objset_stats_t *, nvlist_t *);
 extern zfs_handle_t *make_dataset_simple_handle_zc(zfs_handle_t *, zfs_cmd_t *);
 
 extern int zprop_parse_value(libzfs_handle_t *, nvpair_t *, int, zfs_type_t,
@@ -162,6 +164,11 @@ extern int zprop_expand_list(libzfs_handle_t *hdl, zprop_list_t **plp,
  * Use this changelist_gather() flag to prevent unmounting of file systems.
  */
 #define	CL_GATHER_DONT_UNMOUNT	4
+/*
+ * Use this changelist_gather() flag to have changelist_postfix() mount the
+ * file systems in parallel, parents before children.
+ */
+#define	CL_GATHER_PARALLEL_MOUNT	8
 
 typedef struct prop_changelist prop_changelist_t;
 
@@ -220,6 +227,7 @@ typedef struct differ_info {
 	boolean_t classify;
 	boolean_t timestamped;
 	boolean_t no_mangle;
+	boolean_t no_objs_to_stats;
 	uint64_t shares;
 	int zerr;
 	int cleanupfd;
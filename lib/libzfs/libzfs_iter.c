@@ -100,6 +100,112 @@ top:
 	return (rc);
 }
 
+/*
+ * Iterate over child filesystems or snapshots using ZFS_IOC_LIST_BULK, which
+ * returns many datasets per call.  If the kernel doesn't support it, *unavail
+ * is set and the caller is expected to fall back to the one-at-a-time list
+ * ioctls.
+ */
+static int
+zfs_iter_bulk(zfs_handle_t *zhp, int flags, boolean_t snapshots,
+    uint64_t min_txg, uint64_t max_txg, zfs_iter_f func, void *data,
+    boolean_t *unavail)
+{
+	libzfs_handle_t *hdl = zhp->zfs_hdl;
+	boolean_t simple = (flags & ZFS_ITER_SIMPLE) != 0;
+	boolean_t first = B_TRUE;
+	uint64_t cursor = 0;
+	int ret = 0;
+
+	*unavail = B_FALSE;
+
+	for (;;) {
+		nvlist_t *args = fnvlist_alloc();
+		nvlist_t *result = NULL;
+		nvlist_t *datasets;
+		int err;
+
+		if (!first)
+			fnvlist_add_uint64(args, ZFS_LIST_BULK_CURSOR, cursor);
+		if (snapshots)
+			fnvlist_add_boolean(args, ZFS_LIST_BULK_SNAPSHOTS);
+		if (simple)
+			fnvlist_add_boolean(args, ZFS_LIST_BULK_SIMPLE);
+		if (min_txg != 0)
+			fnvlist_add_uint64(args, SNAP_ITER_MIN_TXG, min_txg);
+		if (max_txg != 0)
+			fnvlist_add_uint64(args, SNAP_ITER_MAX_TXG, max_txg);
+
+		err = lzc_list_bulk(zhp->zfs_name, args, &result);
+		fnvlist_free(args);
+		if (err != 0) {
+			nvlist_free(result);
+			if (err == ZFS_ERR_IOC_CMD_UNAVAIL && first) {
+				*unavail = B_TRUE;
+				return (0);
+			}
+			/*
+			 * ENOENT indicates that the underlying dataset has
+			 * been removed since we obtained the handle.
+			 */
+			if (err == ENOENT || err == ESRCH)
+				return (0);
+			return (zfs_standard_error(hdl, err,
+			    dgettext(TEXT_DOMAIN,
+			    "cannot iterate filesystems")));
+		}
+		first = B_FALSE;
+
+		datasets = fnvlist_lookup_nvlist(result,
+		    ZFS_LIST_BULK_DATASETS);
+		for (nvpair_t *pair = nvlist_next_nvpair(datasets, NULL);
+		    pair != NULL; pair = nvlist_next_nvpair(datasets, pair)) {
+			nvlist_t *entry = fnvpair_value_nvlist(pair);
+			dmu_objset_stats_t *stats;
+			zfs_handle_t *nzhp;
+			uint_t len;
+
+			if (nvlist_lookup_uint8_array(entry,
+			    ZFS_LIST_BULK_STATS, (uint8_t **)&stats,
+			    &len) != 0 || len != sizeof (dmu_objset_stats_t))
+				continue;
+
+			if (simple) {
+				zfs_cmd_t zc = {"\0"};
+
+				(void) strlcpy(zc.zc_name, nvpair_name(pair),
+				    sizeof (zc.zc_name));
+				zc.zc_objset_stats = *stats;
+				nzhp = make_dataset_simple_handle_zc(zhp, &zc);
+			} else {
+				nvlist_t *props = fnvlist_dup(
+				    fnvlist_lookup_nvlist(entry,
+				    ZFS_LIST_BULK_PROPS));
+				nzhp = make_dataset_handle_stats(hdl,
+				    nvpair_name(pair), stats, props);
+				if (nzhp == NULL)
+					nvlist_free(props);
+			}
+			/*
+			 * Silently ignore errors, as the only plausible
+			 * explanation is that the pool has since been removed.
+			 */
+			if (nzhp == NULL)
+				continue;
+
+			if ((ret = func(nzhp, data)) != 0)
+				break;
+		}
+
+		if (ret != 0 || nvlist_lookup_uint64(result,
+		    ZFS_LIST_BULK_CURSOR, &cursor) != 0) {
+			nvlist_free(result);
+			return (ret);
+		}
+		nvlist_free(result);
+	}
+}
+
 /*
  * Iterate over all child filesystems
  */
@@ -115,11 +221,16 @@ zfs_iter_filesystems_v2(zfs_handle_t *zhp, int flags, zfs_iter_f func,
 {
 	zfs_cmd_t zc = {"\0"};
 	zfs_handle_t *nzhp;
+	boolean_t unavail;
 	int ret;
 
 	if (zhp->zfs_type != ZFS_TYPE_FILESYSTEM)
 		return (0);
 
+	ret = zfs_iter_bulk(zhp, flags, B_FALSE, 0, 0, func, data, &unavail);
+	if (!unavail)
+		return (ret);
+
 	zcmd_alloc_dst_nvlist(zhp->zfs_hdl, &zc, 0);
 
 	if ((flags & ZFS_ITER_SIMPLE) == ZFS_ITER_SIMPLE)
@@ -164,6 +275,7 @@ zfs_iter_snapshots_v2(zfs_handle_t *zhp, int flags, zfs_iter_f func,
 {
 	zfs_cmd_t zc = {"\0"};
 	zfs_handle_t *nzhp;
+	boolean_t unavail;
 	int ret;
 	nvlist_t *range_nvl = NULL;
 
@@ -171,6 +283,11 @@ zfs_iter_snapshots_v2(zfs_handle_t *zhp, int flags, zfs_iter_f func,
 	    zhp->zfs_type == ZFS_TYPE_BOOKMARK)
 		return (0);
 
+	ret = zfs_iter_bulk(zhp, flags, B_TRUE, min_txg, max_txg, func, data,
+	    &unavail);
+	if (!unavail)
+		return (ret);
+
 	zc.zc_simple = (flags & ZFS_ITER_SIMPLE) != 0;
 
 	zcmd_alloc_dst_nvlist(zhp->zfs_hdl, &zc, 0);
@@ -609,13 +609,23 @@ zfs_unmount(zfs_handle_t *zhp, const char *mountpoint, int flags)
 			mntpt = zfs_strdup(hdl, mountpoint);
 
 		/*
-		 * Unshare and unmount the filesystem
+		 * Unshare and unmount the filesystem.  Committing the shares
+		 * may reload every export, so it is only done if this
+		 * filesystem was actually shared; callers unmounting many
+		 * filesystems can then unshare them all and commit once.
 		 */
-		if (zfs_unshare(zhp, mntpt, share_all_proto) != 0) {
-			free(mntpt);
-			return (-1);
+		boolean_t shared = B_FALSE;
+		for (const enum sa_protocol *p = share_all_proto;
+		    *p != SA_NO_PROTOCOL; ++p)
+			shared |= sa_is_shared(mntpt, *p);
+
+		if (shared) {
+			if (zfs_unshare(zhp, mntpt, share_all_proto) != 0) {
+				free(mntpt);
+				return (-1);
+			}
+			zfs_commit_shares(NULL);
 		}
-		zfs_commit_shares(NULL);
 
 		if (unmount_one(zhp, mntpt, flags) != 0) {
 			free(mntpt);
@@ -1343,6 +1353,196 @@ mountpoint_compare(const void *a, const void *b)
 	return (strcmp(mountb->mountpoint, mounta->mountpoint));
 }
 
+/*
+ * Sync the pool once before its filesystems are unmounted, so that the
+ * teardown of each filesystem finds its objset clean and does not wait for
+ * a txg sync of its own.  Suspended and read-only pools are skipped, since
+ * the sync would either hang or have nothing to write.  Errors are ignored:
+ * each unmount still writes out whatever is left dirty.
+ */
+static void
+zpool_disable_datasets_sync(zpool_handle_t *zhp)
+{
+	boolean_t missing;
+	uint64_t suspended;
+
+	if (zpool_refresh_stats(zhp, &missing) != 0 || missing)
+		return;
+	if (nvlist_lookup_uint64(zhp->zpool_config, ZPOOL_CONFIG_SUSPENDED,
+	    &suspended) == 0 ||
+	    zpool_get_prop_int(zhp, ZPOOL_PROP_READONLY, NULL))
+		return;
+
+	(void) lzc_sync(zhp->zpool_name, NULL, NULL);
+}
+
+/*
+ * Given the index of a mountpoint in the sets array, sorted in reverse by
+ * mountpoint_compare(), return the index of the entry which must not be
+ * unmounted until this one is, or -1 if there is none.  That is the nearest
+ * enclosing mountpoint, or the next entry stacked on the same path.
+ */
+static int
+unmount_parent_idx(libzfs_handle_t *hdl, struct sets_s *sets, int used,
+    int idx)
+{
+	struct sets_s key;
+	struct sets_s *found;
+	char *slash;
+	int parent = -1;
+
+	if (idx + 1 < used &&
+	    strcmp(sets[idx + 1].mountpoint, sets[idx].mountpoint) == 0)
+		return (idx + 1);
+
+	key.mountpoint = zfs_strdup(hdl, sets[idx].mountpoint);
+	while (parent == -1 && key.mountpoint[1] != '\0' &&
+	    (slash = strrchr(key.mountpoint, '/')) != NULL) {
+		if (slash == key.mountpoint)
+			slash[1] = '\0';
+		else
+			*slash = '\0';
+
+		found = bsearch(&key, sets, used, sizeof (struct sets_s),
+		    mountpoint_compare);
+		if (found == NULL)
+			continue;
+
+		/* Wait for the first of any mounts stacked on this path. */
+		parent = found - sets;
+		while (parent > 0 && strcmp(sets[parent - 1].mountpoint,
+		    key.mountpoint) == 0)
+			parent--;
+	}
+	free(key.mountpoint);
+
+	return (parent);
+}
+
+typedef struct unmount_state {
+	pthread_mutex_t	us_lock;
+	tpool_t		*us_tp;
+	struct sets_s	*us_sets;
+	int		*us_parent;	/* see unmount_parent_idx() */
+	int		*us_pending;	/* mounted children, plus one */
+	struct unmount_task *us_tasks;
+	int		us_flags;
+	/*
+	 * us_status is set to -1 if any unmount fails.  Like ms_mntstatus,
+	 * it needs no synchronization as it's only ever set to -1.
+	 */
+	int		us_status;
+} unmount_state_t;
+
+typedef struct unmount_task {
+	unmount_state_t	*ut_state;
+	int		ut_idx;
+} unmount_task_t;
+
+static void unmount_task(void *);
+
+/*
+ * Drop one reference on the entry selected by idx, and schedule it to be
+ * unmounted once nothing mounted beneath it remains.
+ */
+static void
+unmount_release(unmount_state_t *us, int idx)
+{
+	boolean_t ready;
+
+	pthread_mutex_lock(&us->us_lock);
+	ready = (--us->us_pending[idx] == 0);
+	pthread_mutex_unlock(&us->us_lock);
+
+	if (ready && tpool_dispatch(us->us_tp, unmount_task,
+	    &us->us_tasks[idx])) {
+		/* Could not dispatch to thread pool; execute directly */
+		unmount_task(&us->us_tasks[idx]);
+	}
+}
+
+/*
+ * Thread pool function to unmount one file system.  On success, it releases
+ * the enclosing mountpoint, which is scheduled in turn once all of its
+ * children are gone.  A failure leaves every enclosing mountpoint mounted.
+ */
+static void
+unmount_task(void *arg)
+{
+	unmount_task_t *ut = arg;
+	unmount_state_t *us = ut->ut_state;
+	struct sets_s *set = &us->us_sets[ut->ut_idx];
+
+	if (unmount_one(set->dataset, set->mountpoint, us->us_flags) != 0) {
+		us->us_status = -1;
+		return;
+	}
+
+	if (us->us_parent[ut->ut_idx] != -1)
+		unmount_release(us, us->us_parent[ut->ut_idx]);
+}
+
+/*
+ * Unmount every entry of the sets array, which must be sorted by
+ * mountpoint_compare().  Filesystems are unmounted in parallel, with each
+ * one waiting only for the filesystems mounted beneath it.  The
+ * ZFS_SERIAL_UNMOUNT environment variable is an undocumented variable that
+ * can be used to unmount one at a time instead, stopping at the first
+ * failure, for a/b comparisons.
+ */
+static int
+unmount_datasets(libzfs_handle_t *hdl, struct sets_s *sets, int used,
+    int flags)
+{
+	unmount_state_t us = { 0 };
+	long nthr = sysconf(_SC_NPROCESSORS_ONLN);
+	int i;
+
+	if (used > 1 && nthr > 1 && getenv("ZFS_SERIAL_UNMOUNT") == NULL)
+		us.us_tp = tpool_create(1, MIN(nthr, used), 0, NULL);
+
+	if (us.us_tp == NULL) {
+		for (i = 0; i < used; i++) {
+			if (unmount_one(sets[i].dataset, sets[i].mountpoint,
+			    flags) != 0)
+				return (-1);
+		}
+		return (0);
+	}
+
+	pthread_mutex_init(&us.us_lock, NULL);
+	us.us_sets = sets;
+	us.us_flags = flags;
+	us.us_parent = zfs_alloc(hdl, used * sizeof (int));
+	us.us_pending = zfs_alloc(hdl, used * sizeof (int));
+	us.us_tasks = zfs_alloc(hdl, used * sizeof (unmount_task_t));
+
+	for (i = 0; i < used; i++) {
+		us.us_tasks[i].ut_state = &us;
+		us.us_tasks[i].ut_idx = i;
+		us.us_parent[i] = unmount_parent_idx(hdl, sets, used, i);
+		us.us_pending[i]++;
+		if (us.us_parent[i] != -1)
+			us.us_pending[us.us_parent[i]]++;
+	}
+
+	/*
+	 * Drop the initial reference on every entry, which dispatches those
+	 * with nothing mounted beneath them.
+	 */
+	for (i = 0; i < used; i++)
+		unmount_release(&us, i);
+
+	tpool_wait(us.us_tp);
+	tpool_destroy(us.us_tp);
+	pthread_mutex_destroy(&us.us_lock);
+	free(us.us_tasks);
+	free(us.us_pending);
+	free(us.us_parent);
+
+	return (us.us_status);
+}
+
 /*
  * Unshare and unmount all datasets within the given pool.  We don't want to
  * rely on traversing the DSL to discover the filesystems within the pool,
@@ -1437,15 +1637,20 @@ zpool_disable_datasets(zpool_handle_t *zhp, boolean_t force)
 	}
 	zfs_commit_shares(NULL);
 
+	/*
+	 * Write out the dirty data of all the filesystems in one txg sync,
+	 * rather than one per filesystem as they are torn down.  A forced
+	 * unmount may be getting a hung pool out of the way, so skip it then.
+	 */
+	if (used != 0 && !force)
+		zpool_disable_datasets_sync(zhp);
+
 	/*
 	 * Now unmount everything, removing the underlying directories as
 	 * appropriate.
 	 */
-	for (i = 0; i < used; i++) {
-		if (unmount_one(sets[i].dataset, sets[i].mountpoint,
-		    flags) != 0)
-			goto out;
-	}
+	if (unmount_datasets(hdl, sets, used, flags) != 0)
+		goto out;
 
 	for (i = 0; i < used; i++) {
 		if (sets[i].dataset)
@@ -2731,6 +2731,16 @@ out:
  */
 int
 zpool_scan(zpool_handle_t *zhp, pool_scan_func_t func, pool_scrub_cmd_t cmd)
+{
+	return (zpool_scan_range(zhp, func, cmd, 0));
+}
+
+/*
+ * Scan the pool, only visiting blocks born after txgstart when it is not 0.
+ */
+int
+zpool_scan_range(zpool_handle_t *zhp, pool_scan_func_t func,
+    pool_scrub_cmd_t cmd, uint64_t txgstart)
 {
 	char errbuf[ERRBUFLEN];
 	int err;
@@ -2739,13 +2749,15 @@ zpool_scan(zpool_handle_t *zhp, pool_scan_func_t func, pool_scrub_cmd_t cmd)
 	nvlist_t *args = fnvlist_alloc();
 	fnvlist_add_uint64(args, "scan_type", (uint64_t)func);
 	fnvlist_add_uint64(args, "scan_command", (uint64_t)cmd);
+	if (txgstart != 0)
+		fnvlist_add_uint64(args, "scan_txg_start", txgstart);
 
 	err = lzc_scrub(ZFS_IOC_POOL_SCRUB, zhp->zpool_name, args, NULL);
 	fnvlist_free(args);
 
 	if (err == 0) {
 		return (0);
-	} else if (err == ZFS_ERR_IOC_CMD_UNAVAIL) {
+	} else if (err == ZFS_ERR_IOC_CMD_UNAVAIL && txgstart == 0) {
 		zfs_cmd_t zc = {"\0"};
 		(void) strlcpy(zc.zc_name, zhp->zpool_name,
 		    sizeof (zc.zc_name));
@@ -5408,6 +5420,11 @@ zpool_get_vdev_prop_value(nvlist_t *nvprop, vdev_prop_t prop, char *prop_name,
 		case VDEV_PROP_INITIALIZE_ERRORS:
 		case VDEV_PROP_TRIM_ERRORS:
 		case VDEV_PROP_SLOW_IOS:
+		case VDEV_PROP_AGG_READ_OPS:
+		case VDEV_PROP_AGG_WRITE_OPS:
+		case VDEV_PROP_AGG_READ_GAP_BYTES:
+		case VDEV_PROP_AGG_WRITE_GAP_BYTES:
+		case VDEV_PROP_READ_GAP_LIMIT:
 		case VDEV_PROP_OPS_NULL:
 		case VDEV_PROP_OPS_READ:
 		case VDEV_PROP_OPS_WRITE:
@@ -5622,8 +5622,12 @@ zfs_receive(libzfs_handle_t *hdl, const char *tosnap, nvlist_t *props,
 				goto out;
 			}
 
+			/*
+			 * A replication stream may have created a large
+			 * hierarchy; mount it in parallel.
+			 */
 			clp = changelist_gather(zhp, ZFS_PROP_MOUNTPOINT,
-			    CL_GATHER_MOUNT_ALWAYS,
+			    CL_GATHER_MOUNT_ALWAYS | CL_GATHER_PARALLEL_MOUNT,
 			    flags->forceunmount ? MS_FORCE : 0);
 			zfs_close(zhp);
 			if (clp == NULL) {
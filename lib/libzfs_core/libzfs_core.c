@@ -1994,3 +1994,53 @@ lzc_ddt_prune(const char *pool, zpool_ddt_prune_unit_t unit, uint64_t amount)
 
 	return (error);
 }
+
+/*
+ * Retrieve the stats (and optionally properties) of many children or
+ * snapshots of the given dataset in a single call.  See zfs_ioc_list_bulk()
+ * for the format of args and of the returned nvlist.  Pass the
+ * ZFS_LIST_BULK_CURSOR of the result back in args to continue the listing.
+ */
+int
+lzc_list_bulk(const char *fsname, nvlist_t *args, nvlist_t **resultp)
+{
+	return (lzc_ioctl(ZFS_IOC_LIST_BULK, fsname, args, resultp));
+}
+
+/*
+ * Retrieve the path and stats of up to ZFS_OBJS_STATS_MAX objects of the
+ * given snapshot in a single call, as ZFS_IOC_OBJ_TO_STATS does for one.
+ * See zfs_ioc_objs_to_stats() for the format of the returned nvlist.
+ */
+int
+lzc_objs_to_stats(const char *snapname, const uint64_t *objs, uint_t nobjs,
+    nvlist_t **resultp)
+{
+	nvlist_t *args = fnvlist_alloc();
+	int error;
+
+	fnvlist_add_uint64_array(args, ZFS_OBJS_STATS_OBJECTS, objs, nobjs);
+	error = lzc_ioctl(ZFS_IOC_OBJS_TO_STATS, snapname, args, resultp);
+	fnvlist_free(args);
+
+	return (error);
+}
+
+/*
+ * Read a dataset, or a range of one of its objects, into the ARC and wait
+ * for the reads to complete.  args may hold ZFS_PREFETCH_OBJECT,
+ * ZFS_PREFETCH_OFFSET, ZFS_PREFETCH_LENGTH and ZFS_PREFETCH_RATE, see
+ * zfs_ioc_prefetch(); a NULL args reads the whole dataset.
+ */
+int
+lzc_prefetch(const char *fsname, nvlist_t *args)
+{
+	nvlist_t *nvl = args != NULL ? args : fnvlist_alloc();
+	int error;
+
+	error = lzc_ioctl(ZFS_IOC_PREFETCH, fsname, nvl, NULL);
+	if (args == NULL)
+		fnvlist_free(nvl);
+
+	return (error);
+}
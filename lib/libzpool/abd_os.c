@@ -365,6 +365,16 @@ abd_cache_reap_now(void)
 {
 }
 
+/*
+ * NUMA placement of ABD pages is not tracked on this platform.
+ */
+int
+abd_numa_node(abd_t *abd)
+{
+	(void) abd;
+	return (-1);
+}
+
 /*
  * Borrow a raw buffer from an ABD without copying the contents of the ABD
  * into the buffer. If the ABD is scattered, this will alloate a raw buffer
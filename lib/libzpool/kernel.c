@@ -49,6 +49,11 @@
 #include <sys/zvol.h>
 #include <zfs_fletcher.h>
 #include <zlib.h>
+#ifdef HAVE_LINUX_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
 
 /*
  * Emulation of kernel services in userland.
@@ -811,6 +816,8 @@ umem_out_of_memory(void)
 	return (0);
 }
 
+static void zfs_file_aio_fini(void);
+
 void
 kernel_init(int mode)
 {
@@ -846,6 +853,7 @@ kernel_fini(void)
 {
 	fletcher_4_fini();
 	spa_fini();
+	zfs_file_aio_fini();
 
 	zstd_fini();
 
@@ -1294,6 +1302,276 @@ zfs_file_pread(zfs_file_t *fp, void *buf, size_t count, loff_t off,
 	return (0);
 }
 
+/*
+ * Asynchronous stateless read or write.  On Linux a single io_uring is
+ * shared by every file; it is set up on first use and a dedicated thread
+ * reaps completions and invokes the callbacks.  The callbacks must not
+ * block waiting for further submissions.
+ *
+ * fp -  pointer to file to read from or write to
+ * write - B_TRUE to write buf, B_FALSE to read into it
+ * buf - buffer, which must remain valid until done is called
+ * count - # of bytes to transfer
+ * off - file offset
+ * done - completion callback, passed arg, an errno and the residual count
+ *
+ * Returns 0 if the request was queued, otherwise an errno; ENOTSUP means
+ * the ring is unavailable and the synchronous interfaces should be used.
+ */
+#ifdef HAVE_LINUX_IO_URING
+#define	ZFS_FILE_URING_ENTRIES	256
+
+typedef struct zfs_file_aio_req {
+	zfs_file_aio_done_t	*far_done;
+	void			*far_arg;
+	size_t			far_count;
+} zfs_file_aio_req_t;
+
+typedef struct zfs_file_uring {
+	kmutex_t		zu_lock;
+	kcondvar_t		zu_cv;
+	int			zu_fd;
+	uint32_t		zu_entries;
+	uint32_t		zu_inflight;
+	void			*zu_sq_ring;
+	size_t			zu_sq_ring_size;
+	void			*zu_cq_ring;
+	size_t			zu_cq_ring_size;
+	struct io_uring_sqe	*zu_sqes;
+	size_t			zu_sqes_size;
+	uint32_t		*zu_sq_tail;
+	uint32_t		*zu_sq_mask;
+	uint32_t		*zu_sq_array;
+	uint32_t		*zu_cq_head;
+	uint32_t		*zu_cq_tail;
+	uint32_t		*zu_cq_mask;
+	struct io_uring_cqe	*zu_cqes;
+	pthread_t		zu_thread;
+} zfs_file_uring_t;
+
+static pthread_mutex_t zfs_file_uring_init_lock = PTHREAD_MUTEX_INITIALIZER;
+static int zfs_file_uring_state;	/* 0 unset, 1 ready, -1 unavailable */
+static zfs_file_uring_t zfs_file_uring;
+
+static void
+zfs_file_uring_submit(zfs_file_uring_t *zu, uint8_t opcode, int fd,
+    void *buf, size_t count, loff_t off, zfs_file_aio_req_t *req)
+{
+	struct io_uring_sqe *sqe;
+	uint32_t tail, idx;
+
+	mutex_enter(&zu->zu_lock);
+	while (zu->zu_inflight >= zu->zu_entries)
+		cv_wait(&zu->zu_cv, &zu->zu_lock);
+
+	tail = *zu->zu_sq_tail;
+	idx = tail & *zu->zu_sq_mask;
+	sqe = &zu->zu_sqes[idx];
+	memset(sqe, 0, sizeof (*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t)buf;
+	sqe->len = count;
+	sqe->off = off;
+	sqe->user_data = (uintptr_t)req;
+	zu->zu_sq_array[idx] = idx;
+	__atomic_store_n(zu->zu_sq_tail, tail + 1, __ATOMIC_RELEASE);
+	zu->zu_inflight++;
+
+	/*
+	 * Without SQPOLL the kernel consumes the entry before returning, so
+	 * the slot may be reused by the next submission.
+	 */
+	while (syscall(__NR_io_uring_enter, zu->zu_fd, 1, 0, 0, NULL, 0) < 0)
+		VERIFY(errno == EINTR || errno == EAGAIN);
+	mutex_exit(&zu->zu_lock);
+}
+
+static void *
+zfs_file_uring_reap(void *arg)
+{
+	zfs_file_uring_t *zu = arg;
+
+	for (;;) {
+		uint32_t head = *zu->zu_cq_head;
+		uint32_t tail = __atomic_load_n(zu->zu_cq_tail,
+		    __ATOMIC_ACQUIRE);
+
+		if (head == tail) {
+			if (syscall(__NR_io_uring_enter, zu->zu_fd, 0, 1,
+			    IORING_ENTER_GETEVENTS, NULL, 0) < 0)
+				VERIFY(errno == EINTR || errno == EAGAIN);
+			continue;
+		}
+
+		struct io_uring_cqe *cqe = &zu->zu_cqes[head & *zu->zu_cq_mask];
+		zfs_file_aio_req_t *req =
+		    (zfs_file_aio_req_t *)(uintptr_t)cqe->user_data;
+		int res = cqe->res;
+		__atomic_store_n(zu->zu_cq_head, head + 1, __ATOMIC_RELEASE);
+
+		mutex_enter(&zu->zu_lock);
+		zu->zu_inflight--;
+		cv_signal(&zu->zu_cv);
+		mutex_exit(&zu->zu_lock);
+
+		/* A NOP without a request is queued by zfs_file_aio_fini(). */
+		if (req == NULL)
+			pthread_exit(NULL);
+
+		if (res < 0)
+			req->far_done(req->far_arg, -res, req->far_count);
+		else
+			req->far_done(req->far_arg, 0, req->far_count - res);
+		umem_free(req, sizeof (*req));
+	}
+}
+
+static int
+zfs_file_uring_setup(zfs_file_uring_t *zu)
+{
+	struct io_uring_params p;
+	char *sq, *cq;
+
+	memset(&p, 0, sizeof (p));
+	zu->zu_fd = syscall(__NR_io_uring_setup, ZFS_FILE_URING_ENTRIES, &p);
+	if (zu->zu_fd < 0)
+		return (errno);
+
+	/* IORING_OP_READ and IORING_OP_WRITE arrived with this feature. */
+	if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+		(void) close(zu->zu_fd);
+		return (ENOTSUP);
+	}
+
+	zu->zu_entries = p.sq_entries;
+	zu->zu_sq_ring_size = p.sq_off.array +
+	    p.sq_entries * sizeof (uint32_t);
+	zu->zu_cq_ring_size = p.cq_off.cqes +
+	    p.cq_entries * sizeof (struct io_uring_cqe);
+	zu->zu_sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+
+	zu->zu_sq_ring = mmap(NULL, zu->zu_sq_ring_size,
+	    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, zu->zu_fd,
+	    IORING_OFF_SQ_RING);
+	zu->zu_cq_ring = mmap(NULL, zu->zu_cq_ring_size,
+	    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, zu->zu_fd,
+	    IORING_OFF_CQ_RING);
+	zu->zu_sqes = mmap(NULL, zu->zu_sqes_size,
+	    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, zu->zu_fd,
+	    IORING_OFF_SQES);
+	if (zu->zu_sq_ring == MAP_FAILED || zu->zu_cq_ring == MAP_FAILED ||
+	    zu->zu_sqes == MAP_FAILED) {
+		int err = errno;
+		if (zu->zu_sq_ring != MAP_FAILED)
+			(void) munmap(zu->zu_sq_ring, zu->zu_sq_ring_size);
+		if (zu->zu_cq_ring != MAP_FAILED)
+			(void) munmap(zu->zu_cq_ring, zu->zu_cq_ring_size);
+		if (zu->zu_sqes != MAP_FAILED)
+			(void) munmap(zu->zu_sqes, zu->zu_sqes_size);
+		(void) close(zu->zu_fd);
+		return (err);
+	}
+
+	sq = zu->zu_sq_ring;
+	cq = zu->zu_cq_ring;
+	zu->zu_sq_tail = (uint32_t *)(sq + p.sq_off.tail);
+	zu->zu_sq_mask = (uint32_t *)(sq + p.sq_off.ring_mask);
+	zu->zu_sq_array = (uint32_t *)(sq + p.sq_off.array);
+	zu->zu_cq_head = (uint32_t *)(cq + p.cq_off.head);
+	zu->zu_cq_tail = (uint32_t *)(cq + p.cq_off.tail);
+	zu->zu_cq_mask = (uint32_t *)(cq + p.cq_off.ring_mask);
+	zu->zu_cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	zu->zu_inflight = 0;
+	mutex_init(&zu->zu_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zu->zu_cv, NULL, CV_DEFAULT, NULL);
+	VERIFY0(pthread_create(&zu->zu_thread, NULL, zfs_file_uring_reap, zu));
+	pthread_setname_np(zu->zu_thread, "z_file_uring");
+
+	return (0);
+}
+
+static boolean_t
+zfs_file_uring_ready(void)
+{
+	int state = __atomic_load_n(&zfs_file_uring_state, __ATOMIC_ACQUIRE);
+
+	if (state == 0) {
+		VERIFY0(pthread_mutex_lock(&zfs_file_uring_init_lock));
+		state = zfs_file_uring_state;
+		if (state == 0) {
+			state = zfs_file_uring_setup(&zfs_file_uring) == 0 ?
+			    1 : -1;
+			__atomic_store_n(&zfs_file_uring_state, state,
+			    __ATOMIC_RELEASE);
+		}
+		VERIFY0(pthread_mutex_unlock(&zfs_file_uring_init_lock));
+	}
+
+	return (state == 1);
+}
+
+static void
+zfs_file_aio_fini(void)
+{
+	zfs_file_uring_t *zu = &zfs_file_uring;
+
+	VERIFY0(pthread_mutex_lock(&zfs_file_uring_init_lock));
+	if (zfs_file_uring_state == 1) {
+		zfs_file_uring_submit(zu, IORING_OP_NOP, -1, NULL, 0, 0, NULL);
+		VERIFY0(pthread_join(zu->zu_thread, NULL));
+		ASSERT0(zu->zu_inflight);
+
+		(void) munmap(zu->zu_sqes, zu->zu_sqes_size);
+		(void) munmap(zu->zu_cq_ring, zu->zu_cq_ring_size);
+		(void) munmap(zu->zu_sq_ring, zu->zu_sq_ring_size);
+		(void) close(zu->zu_fd);
+		cv_destroy(&zu->zu_cv);
+		mutex_destroy(&zu->zu_lock);
+	}
+	zfs_file_uring_state = 0;
+	VERIFY0(pthread_mutex_unlock(&zfs_file_uring_init_lock));
+}
+
+int
+zfs_file_aio_rw(zfs_file_t *fp, boolean_t write, void *buf, size_t count,
+    loff_t off, zfs_file_aio_done_t *done, void *arg)
+{
+	zfs_file_aio_req_t *req;
+
+	/* Reads mirrored to a dump file stay on the synchronous path. */
+	if (fp->f_dump_fd != -1 || count > UINT32_MAX ||
+	    !zfs_file_uring_ready())
+		return (ENOTSUP);
+
+	req = umem_alloc(sizeof (*req), UMEM_NOFAIL);
+	req->far_done = done;
+	req->far_arg = arg;
+	req->far_count = count;
+
+	zfs_file_uring_submit(&zfs_file_uring,
+	    write ? IORING_OP_WRITE : IORING_OP_READ, fp->f_fd, buf, count,
+	    off, req);
+
+	return (0);
+}
+#else
+static void
+zfs_file_aio_fini(void)
+{
+}
+
+int
+zfs_file_aio_rw(zfs_file_t *fp, boolean_t write, void *buf, size_t count,
+    loff_t off, zfs_file_aio_done_t *done, void *arg)
+{
+	(void) fp, (void) write, (void) buf, (void) count, (void) off;
+	(void) done, (void) arg;
+	return (ENOTSUP);
+}
+#endif
+
 /*
  * lseek - set / get file pointer
  *
@@ -158,6 +158,7 @@ zpool_open_func(void *arg)
 		goto out;
 	if (num_labels == 0) {
 		nvlist_free(config);
+		rn->rn_nolabels = B_TRUE;
 		goto out;
 	}
 
@@ -145,6 +145,7 @@ zpool_open_func(void *arg)
 	if (num_labels == 0) {
 		(void) close(fd);
 		nvlist_free(config);
+		rn->rn_nolabels = B_TRUE;
 		return;
 	}
 
@@ -1437,6 +1437,73 @@ error:
 	return (error);
 }
 
+/*
+ * The same device is often reachable through many of the scanned paths, as
+ * with the links under /dev/disk.  Only one path per device is probed at
+ * first, and the rest are deferred to the end of the scan, when they are
+ * dropped if that first probe read the device and found no labels.  This
+ * spares the reads of every alias of the non-ZFS devices on a SAN host.
+ */
+typedef struct probe_node {
+	dev_t		pn_dev;
+	ino_t		pn_ino;
+	rdsk_node_t	*pn_leader;
+	avl_node_t	pn_node;
+} probe_node_t;
+
+static int
+probe_node_compare(const void *arg1, const void *arg2)
+{
+	const probe_node_t *pn1 = arg1;
+	const probe_node_t *pn2 = arg2;
+	int cmp;
+
+	cmp = TREE_CMP(pn1->pn_dev, pn2->pn_dev);
+	if (cmp != 0)
+		return (cmp);
+
+	return (TREE_CMP(pn1->pn_ino, pn2->pn_ino));
+}
+
+/*
+ * Return B_TRUE if another path to the same device is already being probed,
+ * in which case the probe of this one is deferred.
+ */
+static boolean_t
+zpool_find_import_defer(libpc_handle_t *hdl, avl_tree_t *probed,
+    rdsk_node_t *slice)
+{
+	struct stat64 statbuf;
+	probe_node_t search, *pn;
+	avl_index_t where;
+
+	if (slice->rn_vdev_guid != 0 || stat64(slice->rn_name, &statbuf) != 0)
+		return (B_FALSE);
+
+	if (S_ISBLK(statbuf.st_mode) || S_ISCHR(statbuf.st_mode)) {
+		search.pn_dev = statbuf.st_rdev;
+		search.pn_ino = 0;
+	} else if (S_ISREG(statbuf.st_mode)) {
+		search.pn_dev = statbuf.st_dev;
+		search.pn_ino = statbuf.st_ino;
+	} else {
+		return (B_FALSE);
+	}
+
+	if ((pn = avl_find(probed, &search, &where)) != NULL) {
+		slice->rn_leader = pn->pn_leader;
+		return (B_TRUE);
+	}
+
+	pn = zutil_alloc(hdl, sizeof (probe_node_t));
+	pn->pn_dev = search.pn_dev;
+	pn->pn_ino = search.pn_ino;
+	pn->pn_leader = slice;
+	avl_insert(probed, pn, where);
+
+	return (B_FALSE);
+}
+
 /*
  * Given a list of directories to search, find all pools stored on disk.  This
  * includes partial pools which are not available to import.  If no args are
@@ -1448,7 +1515,6 @@ static nvlist_t *
 zpool_find_import_impl(libpc_handle_t *hdl, importargs_t *iarg,
     pthread_mutex_t *lock, avl_tree_t *cache)
 {
-	(void) lock;
 	nvlist_t *ret = NULL;
 	pool_list_t pools = { 0 };
 	pool_entry_t *pe, *penext;
@@ -1456,6 +1522,8 @@ zpool_find_import_impl(libpc_handle_t *hdl, importargs_t *iarg,
 	config_entry_t *ce, *cenext;
 	name_entry_t *ne, *nenext;
 	rdsk_node_t *slice;
+	probe_node_t *pn;
+	avl_tree_t probed;
 	void *cookie;
 	tpool_t *t;
 
@@ -1480,14 +1548,33 @@ zpool_find_import_impl(libpc_handle_t *hdl, importargs_t *iarg,
 		threads = MIN(threads, am / VDEV_LABELS);
 #endif
 #endif
+	avl_create(&probed, probe_node_compare, sizeof (probe_node_t),
+	    offsetof(probe_node_t, pn_node));
 	t = tpool_create(1, threads, 0, NULL);
+	pthread_mutex_lock(lock);
 	for (slice = avl_first(cache); slice;
-	    (slice = avl_walk(cache, slice, AVL_AFTER)))
-		(void) tpool_dispatch(t, zpool_open_func, slice);
+	    (slice = avl_walk(cache, slice, AVL_AFTER))) {
+		if (!zpool_find_import_defer(hdl, &probed, slice))
+			(void) tpool_dispatch(t, zpool_open_func, slice);
+	}
+	pthread_mutex_unlock(lock);
+	tpool_wait(t);
 
+	pthread_mutex_lock(lock);
+	for (slice = avl_first(cache); slice;
+	    (slice = avl_walk(cache, slice, AVL_AFTER))) {
+		if (slice->rn_leader != NULL && !slice->rn_leader->rn_nolabels)
+			(void) tpool_dispatch(t, zpool_open_func, slice);
+	}
+	pthread_mutex_unlock(lock);
 	tpool_wait(t);
 	tpool_destroy(t);
 
+	cookie = NULL;
+	while ((pn = avl_destroy_nodes(&probed, &cookie)) != NULL)
+		free(pn);
+	avl_destroy(&probed);
+
 	/*
 	 * Process the cache, filtering out any entries which are not
 	 * for the specified pool then adding matching label configs.
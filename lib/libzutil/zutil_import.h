@@ -53,6 +53,8 @@ typedef struct rdsk_node {
 	avl_node_t rn_node;
 	pthread_mutex_t *rn_lock;
 	boolean_t rn_labelpaths;
+	boolean_t rn_nolabels;		/* Read, but no labels found */
+	struct rdsk_node *rn_leader;	/* Path probed first for device */
 } rdsk_node_t;
 
 int slice_cache_compare(const void *, const void *);
@@ -520,6 +520,12 @@ Blake3_InitKeyed(BLAKE3_CTX *ctx, const uint8_t key[BLAKE3_KEY_LEN])
 	hasher_init_base(ctx, key_words, KEYED_HASH);
 }
 
+void
+Blake3_SizeHint(BLAKE3_CTX *ctx, uint64_t len)
+{
+	ctx->ops = blake3_get_ops_sized(len);
+}
+
 static void
 Blake3_Update2(BLAKE3_CTX *ctx, const void *input, size_t input_len)
 {
@@ -681,6 +687,82 @@ Blake3_Final(const BLAKE3_CTX *ctx, uint8_t *out)
 	Blake3_FinalSeek(ctx, 0, out, BLAKE3_OUT_LEN);
 }
 
+/*
+ * Hash n independent inputs of len bytes each, using the key and flags of
+ * a freshly initialized ctx, and write the n results to out. len must be a
+ * power of two of at least BLAKE3_BLOCK_LEN, so that every input has the
+ * same complete tree. Instead of walking the tree of one input at a time,
+ * the chunks and parents at the same position of all inputs are passed to
+ * hash_many together. This fills the SIMD lanes even if each input has
+ * fewer chunks than the SIMD degree. scratch must be at least
+ * BLAKE3_MANY_SCRATCH(n, len) bytes.
+ */
+void
+Blake3_HashMany(const BLAKE3_CTX *ctx, const uint8_t * const *inputs,
+    size_t n, size_t len, uint8_t *out, uint8_t *scratch)
+{
+	const blake3_ops_t *ops = ctx->ops;
+	const uint8_t *ptrs[BLAKE3_MANY_MAX];
+	uint8_t flags = ctx->chunk.flags;
+	size_t chunks, blocks;
+
+	ASSERT3U(n, <=, BLAKE3_MANY_MAX);
+	ASSERT(ISP2(len) && len >= BLAKE3_BLOCK_LEN);
+	ASSERT0(ctx->cv_stack_len);
+	ASSERT0(chunk_state_len(&ctx->chunk));
+
+	if (n == 0)
+		return;
+
+	/* A single chunk is the root itself. */
+	if (len <= BLAKE3_CHUNK_LEN) {
+		blocks = len / BLAKE3_BLOCK_LEN;
+		ops->hash_many(inputs, n, blocks, ctx->key, 0, B_FALSE, flags,
+		    CHUNK_START, CHUNK_END | ROOT, out);
+		return;
+	}
+
+	/*
+	 * The chaining values of chunk or parent i of all inputs are stored
+	 * next to each other at scratch + i * n * BLAKE3_OUT_LEN, followed by
+	 * room to assemble n parent blocks.
+	 */
+	chunks = len / BLAKE3_CHUNK_LEN;
+	blocks = BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN;
+	uint8_t *parents = scratch + chunks * n * BLAKE3_OUT_LEN;
+
+	for (size_t c = 0; c < chunks; c++) {
+		for (size_t i = 0; i < n; i++)
+			ptrs[i] = inputs[i] + c * BLAKE3_CHUNK_LEN;
+		ops->hash_many(ptrs, n, blocks, ctx->key, c, B_FALSE, flags,
+		    CHUNK_START, CHUNK_END, scratch + c * n * BLAKE3_OUT_LEN);
+	}
+
+	/* Merge pairs of children level by level, the last one is the root. */
+	for (size_t width = chunks / 2; width > 0; width /= 2) {
+		uint8_t pflags = flags | PARENT | (width == 1 ? ROOT : 0);
+
+		for (size_t p = 0; p < width; p++) {
+			uint8_t *left = scratch + 2 * p * n * BLAKE3_OUT_LEN;
+			uint8_t *right = left + n * BLAKE3_OUT_LEN;
+			uint8_t *dst = (width == 1) ? out :
+			    scratch + p * n * BLAKE3_OUT_LEN;
+
+			for (size_t i = 0; i < n; i++) {
+				uint8_t *block = parents + i * BLAKE3_BLOCK_LEN;
+
+				memcpy(block, left + i * BLAKE3_OUT_LEN,
+				    BLAKE3_OUT_LEN);
+				memcpy(block + BLAKE3_OUT_LEN,
+				    right + i * BLAKE3_OUT_LEN, BLAKE3_OUT_LEN);
+				ptrs[i] = block;
+			}
+			ops->hash_many(ptrs, n, 1, ctx->key, 0, B_FALSE,
+			    pflags, 0, 0, dst);
+		}
+	}
+}
+
 void
 Blake3_FinalSeek(const BLAKE3_CTX *ctx, uint64_t seek, uint8_t *out,
     size_t out_len)
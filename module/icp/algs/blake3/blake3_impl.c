@@ -281,6 +281,7 @@ static const blake3_ops_t *const blake3_impls[] = {
 #define	IMPL_OPS_T		blake3_ops_t
 #define	IMPL_ARRAY		blake3_impls
 #define	IMPL_GET_OPS		blake3_get_ops
+#define	IMPL_GET_OPS_SIZED	blake3_get_ops_sized
 #define	ZFS_IMPL_OPS		zfs_blake3_ops
 #include <generic_impl.c>
 
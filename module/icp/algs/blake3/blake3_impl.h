@@ -68,6 +68,9 @@ typedef struct {
 /* return selected BLAKE3 implementation ops */
 extern const blake3_ops_t *blake3_get_ops(void);
 
+/* return the BLAKE3 implementation ops for hashing size bytes */
+extern const blake3_ops_t *blake3_get_ops_sized(uint64_t size);
+
 #if defined(__x86_64)
 #define	MAX_SIMD_DEGREE 16
 #else
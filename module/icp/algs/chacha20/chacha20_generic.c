@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Portable ChaCha20 block function (RFC 8439).
+ */
+
+#include <sys/zfs_context.h>
+#include <chacha20/chacha20_impl.h>
+
+#define	ROTL32(v, n)	(((v) << (n)) | ((v) >> (32 - (n))))
+
+#define	QUARTERROUND(a, b, c, d) do {				\
+	a += b; d ^= a; d = ROTL32(d, 16);			\
+	c += d; b ^= c; b = ROTL32(b, 12);			\
+	a += b; d ^= a; d = ROTL32(d, 8);			\
+	c += d; b ^= c; b = ROTL32(b, 7);			\
+} while (0)
+
+static void
+chacha20_block(const uint32_t state[16], uint32_t counter, uint8_t *out)
+{
+	uint32_t x[16];
+
+	memcpy(x, state, sizeof (x));
+	x[12] = counter;
+
+	for (int i = 0; i < 10; i++) {
+		QUARTERROUND(x[0], x[4], x[8], x[12]);
+		QUARTERROUND(x[1], x[5], x[9], x[13]);
+		QUARTERROUND(x[2], x[6], x[10], x[14]);
+		QUARTERROUND(x[3], x[7], x[11], x[15]);
+		QUARTERROUND(x[0], x[5], x[10], x[15]);
+		QUARTERROUND(x[1], x[6], x[11], x[12]);
+		QUARTERROUND(x[2], x[7], x[8], x[13]);
+		QUARTERROUND(x[3], x[4], x[9], x[14]);
+	}
+
+	for (int i = 0; i < 16; i++) {
+		uint32_t v = x[i] + (i == 12 ? counter : state[i]);
+
+		out[4 * i + 0] = v;
+		out[4 * i + 1] = v >> 8;
+		out[4 * i + 2] = v >> 16;
+		out[4 * i + 3] = v >> 24;
+	}
+}
+
+static void
+chacha20_xor_generic(uint8_t *out, const uint8_t *in, size_t nblocks,
+    const uint32_t state[16])
+{
+	uint8_t ks[CHACHA20_BLOCK_LEN];
+	uint32_t counter = state[12];
+
+	for (size_t b = 0; b < nblocks; b++) {
+		chacha20_block(state, counter++, ks);
+		for (int i = 0; i < CHACHA20_BLOCK_LEN; i++)
+			out[i] = in[i] ^ ks[i];
+		in += CHACHA20_BLOCK_LEN;
+		out += CHACHA20_BLOCK_LEN;
+	}
+
+	memset(ks, 0, sizeof (ks));
+}
+
+static boolean_t
+chacha20_generic_is_supported(void)
+{
+	return (B_TRUE);
+}
+
+const chacha20_ops_t chacha20_generic_impl = {
+	.name = "generic",
+	.xor_blocks = chacha20_xor_generic,
+	.degree = 1,
+	.is_supported = chacha20_generic_is_supported
+};
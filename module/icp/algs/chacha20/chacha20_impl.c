@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/simd.h>
+#include <sys/zfs_context.h>
+#include <sys/zfs_impl.h>
+
+#include <chacha20/chacha20_impl.h>
+#include <sys/asm_linkage.h>
+#include <sys/crypto/icp.h>
+
+#define	TF(E, N) \
+	extern void ASMABI E(uint8_t *, const uint8_t *, size_t, \
+	    const uint32_t [16]); \
+	static void N(uint8_t *o, const uint8_t *i, size_t n, \
+	    const uint32_t s[16]) { \
+	kfpu_begin(); E(o, i, n, s); kfpu_end(); \
+}
+
+static boolean_t chacha20_selftest(chacha20_xor_f);
+
+#if defined(__x86_64) && defined(HAVE_AVX2)
+TF(zfs_chacha20_xor_avx2, tf_chacha20_xor_avx2);
+
+static boolean_t
+chacha20_have_avx2(void)
+{
+	return (kfpu_allowed() && zfs_avx2_available() &&
+	    chacha20_selftest(tf_chacha20_xor_avx2));
+}
+
+const chacha20_ops_t chacha20_avx2_impl = {
+	.is_supported = chacha20_have_avx2,
+	.xor_blocks = tf_chacha20_xor_avx2,
+	.degree = 4,
+	.name = "avx2"
+};
+#endif
+
+#if defined(__aarch64__)
+TF(zfs_chacha20_xor_neon, tf_chacha20_xor_neon);
+
+static boolean_t
+chacha20_have_neon(void)
+{
+	return (kfpu_allowed() && zfs_neon_available() &&
+	    chacha20_selftest(tf_chacha20_xor_neon));
+}
+
+const chacha20_ops_t chacha20_neon_impl = {
+	.is_supported = chacha20_have_neon,
+	.xor_blocks = tf_chacha20_xor_neon,
+	.degree = 4,
+	.name = "neon"
+};
+#endif
+
+/* array with all chacha20 implementations, fastest last */
+static const chacha20_ops_t *const chacha20_impls[] = {
+	&chacha20_generic_impl,
+#if defined(__x86_64) && defined(HAVE_AVX2)
+	&chacha20_avx2_impl,
+#endif
+#if defined(__aarch64__)
+	&chacha20_neon_impl,
+#endif
+};
+
+/* use the generic implementation functions */
+#define	IMPL_NAME		"chacha20"
+#define	IMPL_OPS_T		chacha20_ops_t
+#define	IMPL_ARRAY		chacha20_impls
+#define	IMPL_GET_OPS		chacha20_get_ops
+#define	ZFS_IMPL_OPS		zfs_chacha20_ops
+#include <generic_impl.c>
+
+/*
+ * Compare the output of an accelerated implementation to the generic one
+ * before it is offered. Eight blocks, starting one block before the
+ * counter wraps, cover the per-block counters and the loop of the vector
+ * routines.
+ */
+static boolean_t
+chacha20_selftest(chacha20_xor_f xor_blocks)
+{
+	uint8_t *in, *ref, *out;
+	uint32_t state[16];
+	size_t len = 8 * CHACHA20_BLOCK_LEN;
+	boolean_t ok;
+
+	in = kmem_alloc(3 * len, KM_SLEEP);
+	ref = in + len;
+	out = ref + len;
+
+	for (int i = 0; i < 16; i++)
+		state[i] = 0x9e3779b9U * (i + 1);
+	state[12] = UINT32_MAX;
+	for (size_t i = 0; i < len; i++)
+		in[i] = i * 7;
+
+	chacha20_generic_impl.xor_blocks(ref, in, 8, state);
+	xor_blocks(out, in, 8, state);
+	ok = (memcmp(ref, out, len) == 0);
+
+	kmem_free(in, 3 * len);
+	return (ok);
+}
+
+/*
+ * Pick the last supported implementation as the fastest one, there is no
+ * benchmark for ciphers.
+ */
+void
+chacha20_impl_init(void)
+{
+	generic_impl_set_fastest(generic_impl_getcnt() - 1);
+}
+
+/*
+ * Select an implementation by name, returns 0 or -EINVAL. Used by the
+ * module parameter and by crypto_test to cycle through the implementations.
+ */
+int
+chacha20_impl_set(const char *val)
+{
+	return (generic_impl_setname(val));
+}
+
+#ifdef _KERNEL
+
+#define	IMPL_FMT(impl, i)	(((impl) == (i)) ? "[%s] " : "%s ")
+
+#if defined(__linux__)
+
+static int
+chacha20_param_get(char *buffer, zfs_kernel_param_t *unused)
+{
+	const uint32_t impl = IMPL_READ(generic_impl_chosen);
+	char *fmt;
+	int cnt = 0;
+
+	/* cycling */
+	fmt = IMPL_FMT(impl, IMPL_CYCLE);
+	cnt += sprintf(buffer + cnt, fmt, "cycle");
+
+	/* list fastest */
+	fmt = IMPL_FMT(impl, IMPL_FASTEST);
+	cnt += sprintf(buffer + cnt, fmt, "fastest");
+
+	/* list all supported implementations */
+	generic_impl_init();
+	for (uint32_t i = 0; i < generic_supp_impls_cnt; ++i) {
+		fmt = IMPL_FMT(impl, i);
+		cnt += sprintf(buffer + cnt, fmt,
+		    generic_supp_impls[i]->name);
+	}
+
+	return (cnt);
+}
+
+static int
+chacha20_param_set(const char *val, zfs_kernel_param_t *unused)
+{
+	(void) unused;
+	return (chacha20_impl_set(val));
+}
+
+#elif defined(__FreeBSD__)
+
+#include <sys/sbuf.h>
+
+static int
+chacha20_param(ZFS_MODULE_PARAM_ARGS)
+{
+	int err;
+
+	generic_impl_init();
+	if (req->newptr == NULL) {
+		const uint32_t impl = IMPL_READ(generic_impl_chosen);
+		const int init_buflen = 64;
+		const char *fmt;
+		struct sbuf *s;
+
+		s = sbuf_new_for_sysctl(NULL, NULL, init_buflen, req);
+
+		/* cycling */
+		fmt = IMPL_FMT(impl, IMPL_CYCLE);
+		(void) sbuf_printf(s, fmt, "cycle");
+
+		/* list fastest */
+		fmt = IMPL_FMT(impl, IMPL_FASTEST);
+		(void) sbuf_printf(s, fmt, "fastest");
+
+		/* list all supported implementations */
+		for (uint32_t i = 0; i < generic_supp_impls_cnt; ++i) {
+			fmt = IMPL_FMT(impl, i);
+			(void) sbuf_printf(s, fmt, generic_supp_impls[i]->name);
+		}
+
+		err = sbuf_finish(s);
+		sbuf_delete(s);
+
+		return (err);
+	}
+
+	char buf[16];
+
+	err = sysctl_handle_string(oidp, buf, sizeof (buf), req);
+	if (err) {
+		return (err);
+	}
+
+	return (-chacha20_impl_set(buf));
+}
+#endif
+
+#undef IMPL_FMT
+
+ZFS_MODULE_VIRTUAL_PARAM_CALL(zfs, zfs_, chacha20_impl,
+    chacha20_param_set, chacha20_param_get, ZMOD_RW, \
+	"Select ChaCha20 implementation.");
+#endif
+
+#undef TF
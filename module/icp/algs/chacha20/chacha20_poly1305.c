@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * ChaCha20-Poly1305 AEAD construction (RFC 8439).
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/crypto/common.h>
+#include <sys/crypto/impl.h>
+#include <chacha20/chacha20_impl.h>
+
+static const uint8_t chacha20_poly1305_zero[POLY1305_BLOCK_LEN] = { 0 };
+
+static inline uint32_t
+load_le32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	    ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static inline void
+store_le64(uint8_t *p, uint64_t v)
+{
+	for (int i = 0; i < 8; i++)
+		p[i] = v >> (8 * i);
+}
+
+/* Pad the MACed data with zeros to a multiple of 16 bytes. */
+static void
+chacha20_poly1305_pad16(chacha20_poly1305_ctx_t *ctx, uint64_t len)
+{
+	if (len % POLY1305_BLOCK_LEN != 0) {
+		poly1305_update(&ctx->cc_poly, chacha20_poly1305_zero,
+		    POLY1305_BLOCK_LEN - len % POLY1305_BLOCK_LEN);
+	}
+}
+
+/*
+ * Set up the cipher state and the one-time Poly1305 key, which is the
+ * first half of the keystream block with counter 0, and MAC the additional
+ * authenticated data. The data is encrypted starting with block 1.
+ */
+int
+chacha20_poly1305_init_ctx(chacha20_poly1305_ctx_t *ctx, const uint8_t *key,
+    const CK_SALSA20_CHACHA20_POLY1305_PARAMS *params)
+{
+	uint8_t block[CHACHA20_BLOCK_LEN];
+
+	if (params->ulNonceLen != CHACHA20_NONCE_LEN)
+		return (CRYPTO_MECHANISM_PARAM_INVALID);
+
+	ctx->cc_ops = chacha20_get_ops();
+	ctx->cc_state[0] = 0x61707865;	/* "expand 32-byte k" */
+	ctx->cc_state[1] = 0x3320646e;
+	ctx->cc_state[2] = 0x79622d32;
+	ctx->cc_state[3] = 0x6b206574;
+	for (int i = 0; i < 8; i++)
+		ctx->cc_state[4 + i] = load_le32(key + 4 * i);
+	ctx->cc_state[12] = 0;
+	for (int i = 0; i < 3; i++)
+		ctx->cc_state[13 + i] = load_le32(params->pNonce + 4 * i);
+
+	memset(block, 0, sizeof (block));
+	chacha20_generic_impl.xor_blocks(block, block, 1, ctx->cc_state);
+	ctx->cc_state[12] = 1;
+	poly1305_init(&ctx->cc_poly, block);
+	memset(block, 0, sizeof (block));
+
+	ctx->cc_aad_len = params->ulAADLen;
+	ctx->cc_data_len = 0;
+	ctx->cc_ct_len = 0;
+	ctx->cc_tag_len = 0;
+	ctx->cc_keystream_len = 0;
+	if (params->ulAADLen != 0) {
+		poly1305_update(&ctx->cc_poly, params->pAAD,
+		    params->ulAADLen);
+		chacha20_poly1305_pad16(ctx, params->ulAADLen);
+	}
+
+	return (CRYPTO_SUCCESS);
+}
+
+/*
+ * XOR len bytes of keystream into in. Keystream left over from a partial
+ * block is used first, whole blocks go to the selected implementation in
+ * multiples of its degree and to the generic one otherwise.
+ */
+static void
+chacha20_poly1305_xor(chacha20_poly1305_ctx_t *ctx, uint8_t *out,
+    const uint8_t *in, size_t len)
+{
+	const chacha20_ops_t *ops = ctx->cc_ops;
+	size_t n, nblocks, bulk;
+
+	n = MIN(len, ctx->cc_keystream_len);
+	if (n != 0) {
+		const uint8_t *ks = ctx->cc_keystream +
+		    CHACHA20_BLOCK_LEN - ctx->cc_keystream_len;
+
+		for (size_t i = 0; i < n; i++)
+			out[i] = in[i] ^ ks[i];
+		ctx->cc_keystream_len -= n;
+		in += n;
+		out += n;
+		len -= n;
+	}
+
+	nblocks = len / CHACHA20_BLOCK_LEN;
+	bulk = nblocks - nblocks % ops->degree;
+	if (bulk != 0) {
+		ops->xor_blocks(out, in, bulk, ctx->cc_state);
+		ctx->cc_state[12] += bulk;
+	}
+	if (nblocks != bulk) {
+		chacha20_generic_impl.xor_blocks(
+		    out + bulk * CHACHA20_BLOCK_LEN,
+		    in + bulk * CHACHA20_BLOCK_LEN, nblocks - bulk,
+		    ctx->cc_state);
+		ctx->cc_state[12] += nblocks - bulk;
+	}
+	in += nblocks * CHACHA20_BLOCK_LEN;
+	out += nblocks * CHACHA20_BLOCK_LEN;
+	len -= nblocks * CHACHA20_BLOCK_LEN;
+
+	if (len != 0) {
+		memset(ctx->cc_keystream, 0, CHACHA20_BLOCK_LEN);
+		chacha20_generic_impl.xor_blocks(ctx->cc_keystream,
+		    ctx->cc_keystream, 1, ctx->cc_state);
+		ctx->cc_state[12]++;
+		for (size_t i = 0; i < len; i++)
+			out[i] = in[i] ^ ctx->cc_keystream[i];
+		ctx->cc_keystream_len = CHACHA20_BLOCK_LEN - len;
+	}
+}
+
+/*
+ * Encrypt length bytes of data into the output and MAC the ciphertext.
+ */
+int
+chacha20_poly1305_encrypt_contiguous(void *arg, caddr_t data, size_t length,
+    crypto_data_t *out)
+{
+	chacha20_poly1305_ctx_t *ctx = arg;
+	uint8_t *in = (uint8_t *)data;
+	int rv;
+
+	while (length > 0) {
+		size_t n = MIN(length, CHACHA20_CHUNK_LEN);
+
+		chacha20_poly1305_xor(ctx, ctx->cc_buf, in, n);
+		poly1305_update(&ctx->cc_poly, ctx->cc_buf, n);
+		rv = crypto_put_output_data(ctx->cc_buf, out, n);
+		if (rv != CRYPTO_SUCCESS)
+			return (rv);
+		out->cd_offset += n;
+		ctx->cc_data_len += n;
+		in += n;
+		length -= n;
+	}
+
+	return (CRYPTO_SUCCESS);
+}
+
+/*
+ * First pass of a decryption: MAC the first cc_ct_len bytes of the
+ * ciphertext and gather the tag that follows them.
+ */
+int
+chacha20_poly1305_mac_contiguous(void *arg, caddr_t data, size_t length,
+    crypto_data_t *out)
+{
+	(void) out;
+	chacha20_poly1305_ctx_t *ctx = arg;
+	size_t n = MIN(length, ctx->cc_ct_len - ctx->cc_data_len);
+
+	poly1305_update(&ctx->cc_poly, (uint8_t *)data, n);
+	ctx->cc_data_len += n;
+	data += n;
+	length -= n;
+
+	if (length > POLY1305_TAG_LEN - ctx->cc_tag_len)
+		return (CRYPTO_ENCRYPTED_DATA_LEN_RANGE);
+	memcpy(ctx->cc_tag + ctx->cc_tag_len, data, length);
+	ctx->cc_tag_len += length;
+
+	return (CRYPTO_SUCCESS);
+}
+
+/*
+ * Second pass of a decryption, after the tag has been verified: decrypt
+ * the first cc_ct_len bytes of the ciphertext into the output.
+ */
+int
+chacha20_poly1305_decrypt_contiguous(void *arg, caddr_t data, size_t length,
+    crypto_data_t *out)
+{
+	chacha20_poly1305_ctx_t *ctx = arg;
+	uint8_t *in = (uint8_t *)data;
+	int rv;
+
+	length = MIN(length, ctx->cc_ct_len - ctx->cc_data_len);
+	while (length > 0) {
+		size_t n = MIN(length, CHACHA20_CHUNK_LEN);
+
+		chacha20_poly1305_xor(ctx, ctx->cc_buf, in, n);
+		rv = crypto_put_output_data(ctx->cc_buf, out, n);
+		if (rv != CRYPTO_SUCCESS)
+			return (rv);
+		out->cd_offset += n;
+		ctx->cc_data_len += n;
+		in += n;
+		length -= n;
+	}
+
+	return (CRYPTO_SUCCESS);
+}
+
+/*
+ * Compute the tag over the additional data and the cc_data_len bytes of
+ * ciphertext MACed so far.
+ */
+void
+chacha20_poly1305_final(chacha20_poly1305_ctx_t *ctx,
+    uint8_t tag[POLY1305_TAG_LEN])
+{
+	uint8_t lens[16];
+
+	chacha20_poly1305_pad16(ctx, ctx->cc_data_len);
+	store_le64(lens, ctx->cc_aad_len);
+	store_le64(lens + 8, ctx->cc_data_len);
+	poly1305_update(&ctx->cc_poly, lens, sizeof (lens));
+	poly1305_final(&ctx->cc_poly, tag);
+}
+
+void
+chacha20_poly1305_clear_ctx(chacha20_poly1305_ctx_t *ctx)
+{
+	memset(ctx, 0, sizeof (*ctx));
+}
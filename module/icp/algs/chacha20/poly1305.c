@@ -0,0 +1,424 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Poly1305 one-time authenticator (RFC 8439), after the public domain
+ * poly1305-donna by Andrew Moon.
+ */
+
+#include <sys/zfs_context.h>
+#include <chacha20/chacha20_impl.h>
+
+static inline uint32_t
+load_le32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	    ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static inline void
+store_le32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+#ifdef POLY1305_64BIT
+
+typedef unsigned __int128 uint128_t;
+
+#define	MASK42	((uint64_t)0x3ffffffffff)
+#define	MASK44	((uint64_t)0xfffffffffff)
+
+static inline uint64_t
+load_le64(const uint8_t *p)
+{
+	return ((uint64_t)load_le32(p) | ((uint64_t)load_le32(p + 4) << 32));
+}
+
+void
+poly1305_init(poly1305_ctx_t *ctx, const uint8_t key[32])
+{
+	uint64_t t0 = load_le64(key);
+	uint64_t t1 = load_le64(key + 8);
+
+	/* r &= 0xffffffc0ffffffc0ffffffc0fffffff */
+	ctx->r[0] = t0 & 0xffc0fffffffULL;
+	ctx->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+	ctx->r[2] = (t1 >> 24) & 0x00ffffffc0fULL;
+
+	ctx->h[0] = ctx->h[1] = ctx->h[2] = 0;
+
+	ctx->pad[0] = load_le64(key + 16);
+	ctx->pad[1] = load_le64(key + 24);
+
+	ctx->buflen = 0;
+}
+
+static void
+poly1305_blocks(poly1305_ctx_t *ctx, const uint8_t *m, size_t bytes,
+    uint64_t hibit)
+{
+	uint64_t r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2];
+	uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+	uint64_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+	uint128_t d0, d1, d2;
+	uint64_t c;
+
+	while (bytes >= POLY1305_BLOCK_LEN) {
+		uint64_t t0 = load_le64(m);
+		uint64_t t1 = load_le64(m + 8);
+
+		/* h += m */
+		h0 += t0 & MASK44;
+		h1 += ((t0 >> 44) | (t1 << 20)) & MASK44;
+		h2 += ((t1 >> 24) & MASK42) | hibit;
+
+		/* h *= r */
+		d0 = (uint128_t)h0 * r0 + (uint128_t)h1 * s2 +
+		    (uint128_t)h2 * s1;
+		d1 = (uint128_t)h0 * r1 + (uint128_t)h1 * r0 +
+		    (uint128_t)h2 * s2;
+		d2 = (uint128_t)h0 * r2 + (uint128_t)h1 * r1 +
+		    (uint128_t)h2 * r0;
+
+		/* (partial) h %= p */
+		c = (uint64_t)(d0 >> 44);
+		h0 = (uint64_t)d0 & MASK44;
+		d1 += c;
+		c = (uint64_t)(d1 >> 44);
+		h1 = (uint64_t)d1 & MASK44;
+		d2 += c;
+		c = (uint64_t)(d2 >> 42);
+		h2 = (uint64_t)d2 & MASK42;
+		h0 += c * 5;
+		c = h0 >> 44;
+		h0 &= MASK44;
+		h1 += c;
+
+		m += POLY1305_BLOCK_LEN;
+		bytes -= POLY1305_BLOCK_LEN;
+	}
+
+	ctx->h[0] = h0;
+	ctx->h[1] = h1;
+	ctx->h[2] = h2;
+}
+
+static void
+poly1305_finish(poly1305_ctx_t *ctx, uint8_t tag[16])
+{
+	uint64_t h0, h1, h2, g0, g1, g2, c, t0, t1;
+
+	/* fully carry h */
+	h0 = ctx->h[0];
+	h1 = ctx->h[1];
+	h2 = ctx->h[2];
+
+	c = h1 >> 44;
+	h1 &= MASK44;
+	h2 += c;
+	c = h2 >> 42;
+	h2 &= MASK42;
+	h0 += c * 5;
+	c = h0 >> 44;
+	h0 &= MASK44;
+	h1 += c;
+	c = h1 >> 44;
+	h1 &= MASK44;
+	h2 += c;
+	c = h2 >> 42;
+	h2 &= MASK42;
+	h0 += c * 5;
+	c = h0 >> 44;
+	h0 &= MASK44;
+	h1 += c;
+
+	/* compute h + -p */
+	g0 = h0 + 5;
+	c = g0 >> 44;
+	g0 &= MASK44;
+	g1 = h1 + c;
+	c = g1 >> 44;
+	g1 &= MASK44;
+	g2 = h2 + c - ((uint64_t)1 << 42);
+
+	/* select h if h < p, or h + -p if h >= p */
+	c = (g2 >> 63) - 1;
+	g0 &= c;
+	g1 &= c;
+	g2 &= c;
+	c = ~c;
+	h0 = (h0 & c) | g0;
+	h1 = (h1 & c) | g1;
+	h2 = (h2 & c) | g2;
+
+	/* h = (h + pad) */
+	t0 = ctx->pad[0];
+	t1 = ctx->pad[1];
+
+	h0 += t0 & MASK44;
+	c = h0 >> 44;
+	h0 &= MASK44;
+	h1 += (((t0 >> 44) | (t1 << 20)) & MASK44) + c;
+	c = h1 >> 44;
+	h1 &= MASK44;
+	h2 += ((t1 >> 24) & MASK42) + c;
+	h2 &= MASK42;
+
+	/* mac = h % (2^128) */
+	h0 = h0 | (h1 << 44);
+	h1 = (h1 >> 20) | (h2 << 24);
+
+	store_le32(tag, (uint32_t)h0);
+	store_le32(tag + 4, (uint32_t)(h0 >> 32));
+	store_le32(tag + 8, (uint32_t)h1);
+	store_le32(tag + 12, (uint32_t)(h1 >> 32));
+}
+
+#define	POLY1305_HIBIT	((uint64_t)1 << 40)
+
+#else	/* POLY1305_64BIT */
+
+#define	MASK26	0x3ffffff
+
+void
+poly1305_init(poly1305_ctx_t *ctx, const uint8_t key[32])
+{
+	/* r &= 0xffffffc0ffffffc0ffffffc0fffffff */
+	ctx->r[0] = (load_le32(key + 0)) & 0x3ffffff;
+	ctx->r[1] = (load_le32(key + 3) >> 2) & 0x3ffff03;
+	ctx->r[2] = (load_le32(key + 6) >> 4) & 0x3ffc0ff;
+	ctx->r[3] = (load_le32(key + 9) >> 6) & 0x3f03fff;
+	ctx->r[4] = (load_le32(key + 12) >> 8) & 0x00fffff;
+
+	for (int i = 0; i < 5; i++)
+		ctx->h[i] = 0;
+
+	for (int i = 0; i < 4; i++)
+		ctx->pad[i] = load_le32(key + 16 + 4 * i);
+
+	ctx->buflen = 0;
+}
+
+static void
+poly1305_blocks(poly1305_ctx_t *ctx, const uint8_t *m, size_t bytes,
+    uint32_t hibit)
+{
+	uint32_t r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2];
+	uint32_t r3 = ctx->r[3], r4 = ctx->r[4];
+	uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+	uint32_t h3 = ctx->h[3], h4 = ctx->h[4];
+	uint64_t d0, d1, d2, d3, d4;
+	uint32_t c;
+
+	while (bytes >= POLY1305_BLOCK_LEN) {
+		/* h += m[i] */
+		h0 += (load_le32(m + 0)) & MASK26;
+		h1 += (load_le32(m + 3) >> 2) & MASK26;
+		h2 += (load_le32(m + 6) >> 4) & MASK26;
+		h3 += (load_le32(m + 9) >> 6) & MASK26;
+		h4 += (load_le32(m + 12) >> 8) | hibit;
+
+		/* h *= r */
+		d0 = ((uint64_t)h0 * r0) + ((uint64_t)h1 * s4) +
+		    ((uint64_t)h2 * s3) + ((uint64_t)h3 * s2) +
+		    ((uint64_t)h4 * s1);
+		d1 = ((uint64_t)h0 * r1) + ((uint64_t)h1 * r0) +
+		    ((uint64_t)h2 * s4) + ((uint64_t)h3 * s3) +
+		    ((uint64_t)h4 * s2);
+		d2 = ((uint64_t)h0 * r2) + ((uint64_t)h1 * r1) +
+		    ((uint64_t)h2 * r0) + ((uint64_t)h3 * s4) +
+		    ((uint64_t)h4 * s3);
+		d3 = ((uint64_t)h0 * r3) + ((uint64_t)h1 * r2) +
+		    ((uint64_t)h2 * r1) + ((uint64_t)h3 * r0) +
+		    ((uint64_t)h4 * s4);
+		d4 = ((uint64_t)h0 * r4) + ((uint64_t)h1 * r3) +
+		    ((uint64_t)h2 * r2) + ((uint64_t)h3 * r1) +
+		    ((uint64_t)h4 * r0);
+
+		/* (partial) h %= p */
+		c = (uint32_t)(d0 >> 26);
+		h0 = (uint32_t)d0 & MASK26;
+		d1 += c;
+		c = (uint32_t)(d1 >> 26);
+		h1 = (uint32_t)d1 & MASK26;
+		d2 += c;
+		c = (uint32_t)(d2 >> 26);
+		h2 = (uint32_t)d2 & MASK26;
+		d3 += c;
+		c = (uint32_t)(d3 >> 26);
+		h3 = (uint32_t)d3 & MASK26;
+		d4 += c;
+		c = (uint32_t)(d4 >> 26);
+		h4 = (uint32_t)d4 & MASK26;
+		h0 += c * 5;
+		c = h0 >> 26;
+		h0 &= MASK26;
+		h1 += c;
+
+		m += POLY1305_BLOCK_LEN;
+		bytes -= POLY1305_BLOCK_LEN;
+	}
+
+	ctx->h[0] = h0;
+	ctx->h[1] = h1;
+	ctx->h[2] = h2;
+	ctx->h[3] = h3;
+	ctx->h[4] = h4;
+}
+
+static void
+poly1305_finish(poly1305_ctx_t *ctx, uint8_t tag[16])
+{
+	uint32_t h0, h1, h2, h3, h4, c;
+	uint32_t g0, g1, g2, g3, g4;
+	uint64_t f;
+	uint32_t mask;
+
+	/* fully carry h */
+	h0 = ctx->h[0];
+	h1 = ctx->h[1];
+	h2 = ctx->h[2];
+	h3 = ctx->h[3];
+	h4 = ctx->h[4];
+
+	c = h1 >> 26;
+	h1 &= MASK26;
+	h2 += c;
+	c = h2 >> 26;
+	h2 &= MASK26;
+	h3 += c;
+	c = h3 >> 26;
+	h3 &= MASK26;
+	h4 += c;
+	c = h4 >> 26;
+	h4 &= MASK26;
+	h0 += c * 5;
+	c = h0 >> 26;
+	h0 &= MASK26;
+	h1 += c;
+
+	/* compute h + -p */
+	g0 = h0 + 5;
+	c = g0 >> 26;
+	g0 &= MASK26;
+	g1 = h1 + c;
+	c = g1 >> 26;
+	g1 &= MASK26;
+	g2 = h2 + c;
+	c = g2 >> 26;
+	g2 &= MASK26;
+	g3 = h3 + c;
+	c = g3 >> 26;
+	g3 &= MASK26;
+	g4 = h4 + c - (1UL << 26);
+
+	/* select h if h < p, or h + -p if h >= p */
+	mask = (g4 >> 31) - 1;
+	g0 &= mask;
+	g1 &= mask;
+	g2 &= mask;
+	g3 &= mask;
+	g4 &= mask;
+	mask = ~mask;
+	h0 = (h0 & mask) | g0;
+	h1 = (h1 & mask) | g1;
+	h2 = (h2 & mask) | g2;
+	h3 = (h3 & mask) | g3;
+	h4 = (h4 & mask) | g4;
+
+	/* h = h % (2^128) */
+	h0 = ((h0) | (h1 << 26)) & 0xffffffff;
+	h1 = ((h1 >> 6) | (h2 << 20)) & 0xffffffff;
+	h2 = ((h2 >> 12) | (h3 << 14)) & 0xffffffff;
+	h3 = ((h3 >> 18) | (h4 << 8)) & 0xffffffff;
+
+	/* mac = (h + pad) % (2^128) */
+	f = (uint64_t)h0 + ctx->pad[0];
+	h0 = (uint32_t)f;
+	f = (uint64_t)h1 + ctx->pad[1] + (f >> 32);
+	h1 = (uint32_t)f;
+	f = (uint64_t)h2 + ctx->pad[2] + (f >> 32);
+	h2 = (uint32_t)f;
+	f = (uint64_t)h3 + ctx->pad[3] + (f >> 32);
+	h3 = (uint32_t)f;
+
+	store_le32(tag + 0, h0);
+	store_le32(tag + 4, h1);
+	store_le32(tag + 8, h2);
+	store_le32(tag + 12, h3);
+}
+
+#define	POLY1305_HIBIT	((uint32_t)1 << 24)
+
+#endif	/* POLY1305_64BIT */
+
+void
+poly1305_update(poly1305_ctx_t *ctx, const uint8_t *m, size_t bytes)
+{
+	/* complete a partial block left over from the last update */
+	if (ctx->buflen != 0) {
+		size_t want = MIN(POLY1305_BLOCK_LEN - ctx->buflen, bytes);
+
+		memcpy(ctx->buf + ctx->buflen, m, want);
+		ctx->buflen += want;
+		m += want;
+		bytes -= want;
+		if (ctx->buflen < POLY1305_BLOCK_LEN)
+			return;
+		poly1305_blocks(ctx, ctx->buf, POLY1305_BLOCK_LEN,
+		    POLY1305_HIBIT);
+		ctx->buflen = 0;
+	}
+
+	if (bytes >= POLY1305_BLOCK_LEN) {
+		size_t want = bytes & ~(size_t)(POLY1305_BLOCK_LEN - 1);
+
+		poly1305_blocks(ctx, m, want, POLY1305_HIBIT);
+		m += want;
+		bytes -= want;
+	}
+
+	if (bytes != 0) {
+		memcpy(ctx->buf, m, bytes);
+		ctx->buflen = bytes;
+	}
+}
+
+void
+poly1305_final(poly1305_ctx_t *ctx, uint8_t tag[16])
+{
+	/* pad the last partial block with a 1 bit and zeroes */
+	if (ctx->buflen != 0) {
+		ctx->buf[ctx->buflen] = 1;
+		memset(ctx->buf + ctx->buflen + 1, 0,
+		    POLY1305_BLOCK_LEN - ctx->buflen - 1);
+		poly1305_blocks(ctx, ctx->buf, POLY1305_BLOCK_LEN, 0);
+	}
+
+	poly1305_finish(ctx, tag);
+	memset(ctx, 0, sizeof (*ctx));
+}
@@ -47,6 +47,9 @@
 #ifdef CAN_USE_GCM_ASM
 #define	IMPL_AVX	(UINT32_MAX-2)
 #endif
+#ifdef CAN_USE_GCM_AVX512
+#define	IMPL_AVX512	(UINT32_MAX-3)
+#endif
 #define	GCM_IMPL_READ(i) (*(volatile uint32_t *) &(i))
 static uint32_t icp_gcm_impl = IMPL_FASTEST;
 static uint32_t user_sel_impl = IMPL_FASTEST;
@@ -60,13 +63,28 @@ boolean_t gcm_avx_can_use_movbe = B_FALSE;
  */
 static boolean_t gcm_use_avx = B_FALSE;
 #define	GCM_IMPL_USE_AVX	(*(volatile boolean_t *)&gcm_use_avx)
+/*
+ * Whether the avx contexts use the VAES and VPCLMULQDQ based bulk routines.
+ * Set to true if icp_gcm_impl == "avx512", or if it is "fastest" and they
+ * won the benchmark run at module load.
+ */
+static boolean_t gcm_use_avx512 = B_FALSE;
+#define	GCM_IMPL_USE_AVX512	(*(volatile boolean_t *)&gcm_use_avx512)
 
 extern boolean_t ASMABI atomic_toggle_boolean_nv(volatile boolean_t *);
 
 static inline boolean_t gcm_avx_will_work(void);
 static inline void gcm_set_avx(boolean_t);
 static inline boolean_t gcm_toggle_avx(void);
-static inline size_t gcm_simd_get_htab_size(boolean_t);
+static inline size_t gcm_simd_get_htab_size(boolean_t, boolean_t);
+#ifdef CAN_USE_GCM_AVX512
+static boolean_t gcm_avx512_is_fastest = B_FALSE;
+
+static inline boolean_t gcm_avx512_will_work(void);
+static inline void gcm_set_avx512(boolean_t);
+static inline boolean_t gcm_toggle_avx512(void);
+static boolean_t gcm_avx512_bench(void);
+#endif
 
 static int gcm_mode_encrypt_contiguous_blocks_avx(gcm_ctx_t *, char *, size_t,
     crypto_data_t *, size_t);
@@ -672,9 +690,22 @@ gcm_init_ctx(gcm_ctx_t *gcm_ctx, char *param,
 		    "restore performance.");
 	}
 
+	/* Pick the bulk routines, the cycle impl. alternates them as well. */
+	gcm_ctx->gcm_use_avx512 = B_FALSE;
+#ifdef CAN_USE_GCM_AVX512
+	if (gcm_ctx->gcm_use_avx == B_TRUE) {
+		if (GCM_IMPL_READ(icp_gcm_impl) != IMPL_CYCLE) {
+			gcm_ctx->gcm_use_avx512 = GCM_IMPL_USE_AVX512;
+		} else {
+			gcm_ctx->gcm_use_avx512 = gcm_toggle_avx512();
+		}
+	}
+#endif
+
 	/* Allocate Htab memory as needed. */
 	if (gcm_ctx->gcm_use_avx == B_TRUE) {
-		size_t htab_len = gcm_simd_get_htab_size(gcm_ctx->gcm_use_avx);
+		size_t htab_len = gcm_simd_get_htab_size(gcm_ctx->gcm_use_avx,
+		    gcm_ctx->gcm_use_avx512);
 
 		if (htab_len == 0) {
 			return (CRYPTO_MECHANISM_PARAM_INVALID);
@@ -767,6 +798,9 @@ gcm_impl_get_ops(void)
 		break;
 #ifdef CAN_USE_GCM_ASM
 	case IMPL_AVX:
+#ifdef CAN_USE_GCM_AVX512
+	case IMPL_AVX512:
+#endif
 		/*
 		 * Make sure that we return a valid implementation while
 		 * switching to the avx implementation since there still
@@ -838,6 +872,18 @@ gcm_impl_init(void)
 			gcm_set_avx(B_TRUE);
 		}
 	}
+#endif
+#ifdef CAN_USE_GCM_AVX512
+	/*
+	 * Only let fastest use the avx512 routines if they actually beat the
+	 * avx ones on this CPU.
+	 */
+	if (gcm_avx512_will_work() && gcm_avx512_bench()) {
+		gcm_avx512_is_fastest = B_TRUE;
+		if (GCM_IMPL_READ(user_sel_impl) == IMPL_FASTEST) {
+			gcm_set_avx512(B_TRUE);
+		}
+	}
 #endif
 	/* Finish initialization */
 	atomic_swap_32(&icp_gcm_impl, user_sel_impl);
@@ -853,6 +899,9 @@ static const struct {
 #ifdef CAN_USE_GCM_ASM
 		{ "avx",	IMPL_AVX },
 #endif
+#ifdef CAN_USE_GCM_AVX512
+		{ "avx512",	IMPL_AVX512 },
+#endif
 };
 
 /*
@@ -891,6 +940,12 @@ gcm_impl_set(const char *val)
 		if (gcm_impl_opts[i].sel == IMPL_AVX && !gcm_avx_will_work()) {
 			continue;
 		}
+#endif
+#ifdef CAN_USE_GCM_AVX512
+		if (gcm_impl_opts[i].sel == IMPL_AVX512 &&
+		    !gcm_avx512_will_work()) {
+			continue;
+		}
 #endif
 		if (strcmp(req_name, gcm_impl_opts[i].name) == 0) {
 			impl = gcm_impl_opts[i].sel;
@@ -913,10 +968,22 @@ gcm_impl_set(const char *val)
 #ifdef CAN_USE_GCM_ASM
 	/*
 	 * Use the avx implementation if available and the requested one is
-	 * avx or fastest.
+	 * avx, avx512 or fastest.
 	 */
-	if (gcm_avx_will_work() == B_TRUE &&
-	    (impl == IMPL_AVX || impl == IMPL_FASTEST)) {
+	boolean_t want_avx = (impl == IMPL_AVX || impl == IMPL_FASTEST);
+#ifdef CAN_USE_GCM_AVX512
+	/* Fastest only uses the avx512 routines if they won the benchmark. */
+	boolean_t want_avx512 = (impl == IMPL_AVX512 ||
+	    (impl == IMPL_FASTEST && gcm_avx512_is_fastest));
+
+	want_avx = (want_avx || impl == IMPL_AVX512);
+	if (gcm_avx512_will_work() == B_TRUE && want_avx512) {
+		gcm_set_avx512(B_TRUE);
+	} else {
+		gcm_set_avx512(B_FALSE);
+	}
+#endif
+	if (gcm_avx_will_work() == B_TRUE && want_avx) {
 		gcm_set_avx(B_TRUE);
 	} else {
 		gcm_set_avx(B_FALSE);
@@ -957,6 +1024,12 @@ icp_gcm_impl_get(char *buffer, zfs_kernel_param_t *kp)
 		if (gcm_impl_opts[i].sel == IMPL_AVX && !gcm_avx_will_work()) {
 			continue;
 		}
+#endif
+#ifdef CAN_USE_GCM_AVX512
+		if (gcm_impl_opts[i].sel == IMPL_AVX512 &&
+		    !gcm_avx512_will_work()) {
+			continue;
+		}
 #endif
 		fmt = (impl == gcm_impl_opts[i].sel) ? "[%s] " : "%s ";
 		cnt += kmem_scnprintf(buffer + cnt, PAGE_SIZE - cnt, fmt,
@@ -1027,6 +1100,46 @@ extern size_t ASMABI aesni_gcm_encrypt(const uint8_t *, uint8_t *, size_t,
 extern size_t ASMABI aesni_gcm_decrypt(const uint8_t *, uint8_t *, size_t,
     const void *, uint64_t *, uint64_t *);
 
+#ifdef CAN_USE_GCM_AVX512
+extern void ASMABI gcm_init_htab_avx512(uint64_t *Htable, const uint64_t H[2]);
+
+extern size_t ASMABI aesni_gcm_encrypt_avx512(const uint8_t *, uint8_t *,
+    size_t, const void *, uint64_t *, uint64_t *);
+
+extern size_t ASMABI aesni_gcm_decrypt_avx512(const uint8_t *, uint8_t *,
+    size_t, const void *, uint64_t *, uint64_t *);
+#endif
+
+/*
+ * Bulk encrypt or decrypt all complete blocks of len bytes, using the
+ * routines selected for this context. Returns the number of bytes done.
+ */
+static inline size_t
+gcm_avx_encrypt(gcm_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t len)
+{
+#ifdef CAN_USE_GCM_AVX512
+	if (ctx->gcm_use_avx512 == B_TRUE) {
+		return (aesni_gcm_encrypt_avx512(in, out, len,
+		    ctx->gcm_keysched, ctx->gcm_cb, ctx->gcm_ghash));
+	}
+#endif
+	return (aesni_gcm_encrypt(in, out, len, ctx->gcm_keysched,
+	    ctx->gcm_cb, ctx->gcm_ghash));
+}
+
+static inline size_t
+gcm_avx_decrypt(gcm_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t len)
+{
+#ifdef CAN_USE_GCM_AVX512
+	if (ctx->gcm_use_avx512 == B_TRUE) {
+		return (aesni_gcm_decrypt_avx512(in, out, len,
+		    ctx->gcm_keysched, ctx->gcm_cb, ctx->gcm_ghash));
+	}
+#endif
+	return (aesni_gcm_decrypt(in, out, len, ctx->gcm_keysched,
+	    ctx->gcm_cb, ctx->gcm_ghash));
+}
+
 static inline boolean_t
 gcm_avx_will_work(void)
 {
@@ -1054,18 +1167,96 @@ gcm_toggle_avx(void)
 	}
 }
 
+#ifdef CAN_USE_GCM_AVX512
+static inline boolean_t
+gcm_avx512_will_work(void)
+{
+	return (gcm_avx_will_work() &&
+	    zfs_avx512f_available() && zfs_avx512bw_available() &&
+	    zfs_avx512vl_available() && zfs_vaes_available() &&
+	    zfs_vpclmulqdq_available());
+}
+
+static inline void
+gcm_set_avx512(boolean_t val)
+{
+	if (gcm_avx512_will_work() == B_TRUE) {
+		atomic_swap_32(&gcm_use_avx512, val);
+	}
+}
+
+static inline boolean_t
+gcm_toggle_avx512(void)
+{
+	if (gcm_avx512_will_work() == B_TRUE) {
+		return (atomic_toggle_boolean_nv(&GCM_IMPL_USE_AVX512));
+	} else {
+		return (B_FALSE);
+	}
+}
+#endif
+
+/*
+ * The avx512 routines expect H^16 ... H^1 right after the 192 bytes used
+ * by gcm_ghash_avx().
+ */
 static inline size_t
-gcm_simd_get_htab_size(boolean_t simd_mode)
+gcm_simd_get_htab_size(boolean_t simd_mode, boolean_t avx512)
 {
 	switch (simd_mode) {
 	case B_TRUE:
-		return (2 * 6 * 2 * sizeof (uint64_t));
+		return (2 * 6 * 2 * sizeof (uint64_t) +
+		    (avx512 ? 16 * GCM_BLOCK_LEN : 0));
 
 	default:
 		return (0);
 	}
 }
 
+#ifdef CAN_USE_GCM_AVX512
+#define	GCM_AVX512_BENCH_SIZE	(32 * 1024)
+#define	GCM_AVX512_BENCH_RUNS	8
+
+/*
+ * Time the avx and the avx512 bulk encryption on a chunk sized buffer and
+ * return B_TRUE if the latter is faster. The key and Htable are left zero,
+ * only the speed is of interest here.
+ */
+static boolean_t
+gcm_avx512_bench(void)
+{
+	size_t htab_len = gcm_simd_get_htab_size(B_TRUE, B_TRUE);
+	gcm_ctx_t *ctx = kmem_zalloc(sizeof (gcm_ctx_t), KM_SLEEP);
+	aes_key_t *key = kmem_zalloc(sizeof (aes_key_t), KM_SLEEP);
+	uint8_t *buf = vmem_zalloc(GCM_AVX512_BENCH_SIZE, KM_SLEEP);
+	hrtime_t best[2] = { INT64_MAX, INT64_MAX };
+
+	key->nr = 14;
+	ctx->gcm_keysched = key;
+	ctx->gcm_Htable = kmem_zalloc(htab_len, KM_SLEEP);
+
+	for (int i = 0; i < 2 * GCM_AVX512_BENCH_RUNS; i++) {
+		int avx512 = i & 1;
+		hrtime_t start;
+
+		ctx->gcm_use_avx512 = avx512;
+		kfpu_begin();
+		start = gethrtime();
+		(void) gcm_avx_encrypt(ctx, buf, buf, GCM_AVX512_BENCH_SIZE);
+		best[avx512] = MIN(best[avx512], gethrtime() - start);
+		clear_fpu_regs();
+		kfpu_end();
+	}
+
+	kmem_free(ctx->gcm_Htable, htab_len);
+	vmem_free(buf, GCM_AVX512_BENCH_SIZE);
+	kmem_free(key, sizeof (aes_key_t));
+	kmem_free(ctx, sizeof (gcm_ctx_t));
+
+	return (best[1] < best[0]);
+}
+#endif
+
 
 /* Increment the GCM counter block by n. */
 static inline void
@@ -1094,7 +1285,6 @@ gcm_mode_encrypt_contiguous_blocks_avx(gcm_ctx_t *ctx, char *data,
 	uint8_t *datap = (uint8_t *)data;
 	size_t chunk_size = (size_t)GCM_CHUNK_SIZE_READ;
 	const aes_key_t *key = ((aes_key_t *)ctx->gcm_keysched);
-	uint64_t *ghash = ctx->gcm_ghash;
 	uint64_t *cb = ctx->gcm_cb;
 	uint8_t *ct_buf = NULL;
 	uint8_t *tmp = (uint8_t *)ctx->gcm_tmp;
@@ -1158,8 +1348,7 @@ gcm_mode_encrypt_contiguous_blocks_avx(gcm_ctx_t *ctx, char *data,
 	/* Do the bulk encryption in chunk_size blocks. */
 	for (; bleft >= chunk_size; bleft -= chunk_size) {
 		kfpu_begin();
-		done = aesni_gcm_encrypt(
-		    datap, ct_buf, chunk_size, key, cb, ghash);
+		done = gcm_avx_encrypt(ctx, datap, ct_buf, chunk_size);
 
 		clear_fpu_regs();
 		kfpu_end();
@@ -1182,7 +1371,7 @@ gcm_mode_encrypt_contiguous_blocks_avx(gcm_ctx_t *ctx, char *data,
 	/* Bulk encrypt the remaining data. */
 	kfpu_begin();
 	if (bleft >= GCM_AVX_MIN_ENCRYPT_BYTES) {
-		done = aesni_gcm_encrypt(datap, ct_buf, bleft, key, cb, ghash);
+		done = gcm_avx_encrypt(ctx, datap, ct_buf, bleft);
 		if (done == 0) {
 			rv = CRYPTO_FAILED;
 			goto out;
@@ -1324,8 +1513,7 @@ gcm_decrypt_final_avx(gcm_ctx_t *ctx, crypto_data_t *out, size_t block_size)
 	 */
 	for (bleft = pt_len; bleft >= chunk_size; bleft -= chunk_size) {
 		kfpu_begin();
-		done = aesni_gcm_decrypt(datap, datap, chunk_size,
-		    (const void *)key, ctx->gcm_cb, ghash);
+		done = gcm_avx_decrypt(ctx, datap, datap, chunk_size);
 		clear_fpu_regs();
 		kfpu_end();
 		if (done != chunk_size) {
@@ -1336,8 +1524,7 @@ gcm_decrypt_final_avx(gcm_ctx_t *ctx, crypto_data_t *out, size_t block_size)
 	/* Decrypt remainder, which is less than chunk size, in one go. */
 	kfpu_begin();
 	if (bleft >= GCM_AVX_MIN_DECRYPT_BYTES) {
-		done = aesni_gcm_decrypt(datap, datap, bleft,
-		    (const void *)key, ctx->gcm_cb, ghash);
+		done = gcm_avx_decrypt(ctx, datap, datap, bleft);
 		if (done == 0) {
 			clear_fpu_regs();
 			kfpu_end();
@@ -1433,6 +1620,11 @@ gcm_init_avx(gcm_ctx_t *ctx, const uint8_t *iv, size_t iv_len,
 	    (const uint32_t *)H, (uint32_t *)H);
 
 	gcm_init_htab_avx(ctx->gcm_Htable, H);
+#ifdef CAN_USE_GCM_AVX512
+	if (ctx->gcm_use_avx512 == B_TRUE) {
+		gcm_init_htab_avx512(ctx->gcm_Htable, H);
+	}
+#endif
 
 	if (iv_len == 12) {
 		memcpy(cb, iv, 12);
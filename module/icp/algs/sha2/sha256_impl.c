@@ -213,6 +213,7 @@ static const sha256_ops_t *const sha256_impls[] = {
 #define	IMPL_OPS_T		sha256_ops_t
 #define	IMPL_ARRAY		sha256_impls
 #define	IMPL_GET_OPS		sha256_get_ops
+#define	IMPL_GET_OPS_SIZED	sha256_get_ops_sized
 #define	ZFS_IMPL_OPS		zfs_sha256_ops
 #include <generic_impl.c>
 
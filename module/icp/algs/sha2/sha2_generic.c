@@ -449,6 +449,22 @@ SHA2Init(int algotype, SHA2_CTX *ctx)
 	}
 }
 
+/* SHA2 implementation hint for hashing len bytes, before any update */
+void
+SHA2SizeHint(SHA2_CTX *ctx, uint64_t len)
+{
+	switch (ctx->algotype) {
+		case SHA256:
+			ctx->sha256.ops = sha256_get_ops_sized(len);
+			break;
+		case SHA512:
+		case SHA512_HMAC_MECH_INFO_TYPE:
+		case SHA512_256:
+			ctx->sha512.ops = sha512_get_ops_sized(len);
+			break;
+	}
+}
+
 /* SHA2 Update function */
 void
 SHA2Update(SHA2_CTX *ctx, const void *data, size_t len)
@@ -181,6 +181,7 @@ static const sha512_ops_t *const sha512_impls[] = {
 #define	IMPL_OPS_T		sha512_ops_t
 #define	IMPL_ARRAY		sha512_impls
 #define	IMPL_GET_OPS		sha512_get_ops
+#define	IMPL_GET_OPS_SIZED	sha512_get_ops_sized
 #define	ZFS_IMPL_OPS		zfs_sha512_ops
 #include <generic_impl.c>
 
@@ -109,6 +109,7 @@ void
 icp_fini(void)
 {
 	sha2_mod_fini();
+	chacha20_mod_fini();
 	aes_mod_fini();
 	kcf_sched_destroy();
 	kcf_prov_tab_destroy();
@@ -133,6 +134,7 @@ icp_init(void)
 
 	/* initialize algorithms */
 	aes_mod_init();
+	chacha20_mod_init();
 	sha2_mod_init();
 
 	return (0);
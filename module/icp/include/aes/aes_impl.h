@@ -105,7 +105,8 @@ typedef struct aes_impl_ops aes_impl_ops_t;
 
 /*
  * The absolute offset of the encr_ks (0) and the nr (504) fields are hard
- * coded in aesni-gcm-x86_64, so please don't change (or adjust accordingly).
+ * coded in aesni-gcm-x86_64 and aesni-gcm-avx512, so please don't change
+ * (or adjust accordingly).
  */
 typedef struct aes_key aes_key_t;
 struct aes_key {
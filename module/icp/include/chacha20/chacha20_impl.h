@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	_CHACHA20_IMPL_H
+#define	_CHACHA20_IMPL_H
+
+#include <sys/zfs_context.h>
+#include <sys/crypto/common.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define	CHACHA20_KEY_LEN	32
+#define	CHACHA20_NONCE_LEN	12
+#define	CHACHA20_BLOCK_LEN	64
+#define	POLY1305_KEY_LEN	32
+#define	POLY1305_BLOCK_LEN	16
+#define	POLY1305_TAG_LEN	16
+
+/*
+ * Bytes of input handled per call of the block function, large enough to
+ * amortize saving the FPU state.
+ */
+#define	CHACHA20_CHUNK_LEN	(32 * CHACHA20_BLOCK_LEN)
+
+/*
+ * XOR nblocks blocks of keystream, starting at the block counter in
+ * state[12], into in and store the result in out. The state holds the
+ * constants, the key, the counter and the nonce as 32-bit words and is not
+ * modified.
+ */
+typedef void (*chacha20_xor_f)(uint8_t *out, const uint8_t *in,
+    size_t nblocks, const uint32_t state[16]);
+
+typedef boolean_t (*chacha20_is_supported_f)(void);
+
+typedef struct {
+	const char *name;
+	chacha20_xor_f xor_blocks;
+	/* xor_blocks only takes multiples of this many blocks */
+	size_t degree;
+	chacha20_is_supported_f is_supported;
+} chacha20_ops_t;
+
+extern const chacha20_ops_t chacha20_generic_impl;
+extern const chacha20_ops_t *chacha20_get_ops(void);
+extern void chacha20_impl_init(void);
+
+/*
+ * Poly1305 uses 64x64->128 bit multiplies where they are cheap and known to
+ * be available in the kernel, and 32x32->64 bit ones everywhere else.
+ */
+#if (defined(__x86_64) || defined(__aarch64__)) && defined(__SIZEOF_INT128__)
+#define	POLY1305_64BIT
+#endif
+
+typedef struct {
+#ifdef POLY1305_64BIT
+	/* radix 2^44 */
+	uint64_t r[3];
+	uint64_t h[3];
+	uint64_t pad[2];
+#else
+	/* radix 2^26 */
+	uint32_t r[5];
+	uint32_t h[5];
+	uint32_t pad[4];
+#endif
+	uint8_t buf[POLY1305_BLOCK_LEN];
+	size_t buflen;
+} poly1305_ctx_t;
+
+extern void poly1305_init(poly1305_ctx_t *, const uint8_t key[32]);
+extern void poly1305_update(poly1305_ctx_t *, const uint8_t *, size_t);
+extern void poly1305_final(poly1305_ctx_t *, uint8_t tag[16]);
+
+/* Mechanism type of the only mechanism of the provider */
+typedef enum chacha20_mech_type {
+	CHACHA20_POLY1305_MECH_INFO_TYPE,	/* SUN_CKM_CHACHA20_POLY1305 */
+} chacha20_mech_type_t;
+
+/* State of a ChaCha20-Poly1305 (RFC 8439) encryption or decryption */
+typedef struct chacha20_poly1305_ctx {
+	const chacha20_ops_t *cc_ops;
+	uint32_t cc_state[16];
+	poly1305_ctx_t cc_poly;
+	uint64_t cc_aad_len;
+	/* bytes encrypted or decrypted so far */
+	uint64_t cc_data_len;
+	/* length of the ciphertext without the tag, when decrypting */
+	uint64_t cc_ct_len;
+	/* tag gathered from the end of the ciphertext */
+	uint8_t cc_tag[POLY1305_TAG_LEN];
+	size_t cc_tag_len;
+	/* keystream left over from the last block of the previous update */
+	uint8_t cc_keystream[CHACHA20_BLOCK_LEN];
+	size_t cc_keystream_len;
+	uint8_t cc_buf[CHACHA20_CHUNK_LEN];
+} chacha20_poly1305_ctx_t;
+
+extern int chacha20_poly1305_init_ctx(chacha20_poly1305_ctx_t *,
+    const uint8_t *, const CK_SALSA20_CHACHA20_POLY1305_PARAMS *);
+extern int chacha20_poly1305_encrypt_contiguous(void *, caddr_t, size_t,
+    crypto_data_t *);
+extern int chacha20_poly1305_decrypt_contiguous(void *, caddr_t, size_t,
+    crypto_data_t *);
+extern int chacha20_poly1305_mac_contiguous(void *, caddr_t, size_t,
+    crypto_data_t *);
+extern void chacha20_poly1305_final(chacha20_poly1305_ctx_t *,
+    uint8_t tag[POLY1305_TAG_LEN]);
+extern void chacha20_poly1305_clear_ctx(chacha20_poly1305_ctx_t *);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _CHACHA20_IMPL_H */
@@ -49,6 +49,9 @@ static IMPL_OPS_T generic_fastest_impl = {
 	.name = "fastest"
 };
 
+/* Fastest implementation per size class, NULL if not benchmarked */
+static const IMPL_OPS_T *generic_sized_impls[ZFS_IMPL_SIZE_CLASSES];
+
 /* Hold all supported implementations */
 static const IMPL_OPS_T *generic_supp_impls[ARRAY_SIZE(IMPL_ARRAY)];
 static uint32_t generic_supp_impls_cnt = 0;
@@ -195,6 +198,16 @@ generic_impl_set_fastest(uint32_t id)
 	    sizeof (generic_fastest_impl));
 }
 
+/* setup id as fastest implementation for blocks of one size class */
+static void
+generic_impl_set_fastest_sized(uint32_t id, uint32_t sizeclass)
+{
+	generic_impl_init();
+	ASSERT3U(id, <, generic_supp_impls_cnt);
+	ASSERT3U(sizeclass, <, ZFS_IMPL_SIZE_CLASSES);
+	generic_sized_impls[sizeclass] = generic_supp_impls[id];
+}
+
 /* return impl iterating functions */
 const zfs_impl_t ZFS_IMPL_OPS = {
 	.name = IMPL_NAME,
@@ -202,6 +215,7 @@ const zfs_impl_t ZFS_IMPL_OPS = {
 	.getid = generic_impl_getid,
 	.getname = generic_impl_getname,
 	.set_fastest = generic_impl_set_fastest,
+	.set_fastest_sized = generic_impl_set_fastest_sized,
 	.setid = generic_impl_setid,
 	.setname = generic_impl_setname
 };
@@ -232,3 +246,41 @@ IMPL_GET_OPS(void)
 	ASSERT3P(ops, !=, NULL);
 	return (ops);
 }
+
+#ifdef IMPL_GET_OPS_SIZED
+/*
+ * Map a block size to the size class of the closest benchmarked size that
+ * is not smaller: 1k, 4k, 16k, 64k, 256k, 1m, 4m and 16m.
+ */
+static uint32_t
+generic_impl_size_class(uint64_t size)
+{
+	uint32_t sizeclass;
+
+	if (size <= 1024)
+		return (0);
+
+	sizeclass = (highbit64(size - 1) - 9) / 2;
+	return (MIN(sizeclass, ZFS_IMPL_SIZE_CLASSES - 1));
+}
+
+/*
+ * get impl ops_t for processing a block of size bytes, the benchmark may
+ * have found a different fastest implementation for each size class
+ */
+const IMPL_OPS_T *
+IMPL_GET_OPS_SIZED(uint64_t size)
+{
+	const IMPL_OPS_T *ops;
+
+	if (IMPL_READ(generic_impl_chosen) != IMPL_FASTEST)
+		return (IMPL_GET_OPS());
+
+	generic_impl_init();
+	ops = generic_sized_impls[generic_impl_size_class(size)];
+	if (ops == NULL)
+		ops = &generic_fastest_impl;
+
+	return (ops);
+}
+#endif
@@ -46,6 +46,16 @@ extern "C" {
 extern boolean_t gcm_avx_can_use_movbe;
 #endif
 
+/*
+ * Additionally, can the toolchain build the VAES and VPCLMULQDQ based
+ * AVX-512 routines.
+ */
+#if defined(CAN_USE_GCM_ASM) && defined(HAVE_VAES) && \
+    defined(HAVE_VPCLMULQDQ) && defined(HAVE_AVX512F) && \
+    defined(HAVE_AVX512BW) && defined(HAVE_AVX512VL)
+#define	CAN_USE_GCM_AVX512
+#endif
+
 #define	CCM_MODE			0x00000010
 #define	GCM_MODE			0x00000020
 
@@ -147,7 +157,8 @@ typedef struct ccm_ctx {
  * gcm_H:		Subkey.
  *
  * gcm_Htable:		Pre-computed and pre-shifted H, H^2, ... H^6 for the
- *			Karatsuba Algorithm in host byte order.
+ *			Karatsuba Algorithm in host byte order, followed by
+ *			H^16 ... H^1 if gcm_use_avx512 is set.
  *
  * gcm_J0:		Pre-counter block generated from the IV.
  *
@@ -162,7 +173,8 @@ typedef struct gcm_ctx {
 	uint32_t gcm_tmp[4];
 	/*
 	 * The offset of gcm_Htable relative to gcm_ghash, (32), is hard coded
-	 * in aesni-gcm-x86_64.S, so please don't change (or adjust there).
+	 * in aesni-gcm-x86_64.S and aesni-gcm-avx512.S, so please don't
+	 * change (or adjust there).
 	 */
 	uint64_t gcm_ghash[2];
 	uint64_t gcm_H[2];
@@ -175,6 +187,7 @@ typedef struct gcm_ctx {
 	uint8_t *gcm_pt_buf;
 #ifdef CAN_USE_GCM_ASM
 	boolean_t gcm_use_avx;
+	boolean_t gcm_use_avx512;
 #endif
 } gcm_ctx_t;
 
@@ -55,6 +55,8 @@ typedef struct {
 
 extern const sha256_ops_t *sha256_get_ops(void);
 extern const sha512_ops_t *sha512_get_ops(void);
+extern const sha256_ops_t *sha256_get_ops_sized(uint64_t size);
+extern const sha512_ops_t *sha512_get_ops_sized(uint64_t size);
 
 typedef enum {
 	SHA1_TYPE,
@@ -0,0 +1,340 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * ChaCha20-Poly1305 provider for the Kernel Cryptographic Framework (KCF)
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/crypto/common.h>
+#include <sys/crypto/impl.h>
+#include <sys/crypto/spi.h>
+#include <sys/crypto/icp.h>
+#include <chacha20/chacha20_impl.h>
+
+/*
+ * Mechanism info structure passed to KCF during registration.
+ */
+static const crypto_mech_info_t chacha20_mech_info_tab[] = {
+	/* CHACHA20_POLY1305 */
+	{SUN_CKM_CHACHA20_POLY1305, CHACHA20_POLY1305_MECH_INFO_TYPE,
+	    CRYPTO_FG_ENCRYPT_ATOMIC | CRYPTO_FG_DECRYPT_ATOMIC},
+};
+
+static int chacha20_encrypt_atomic(crypto_mechanism_t *, crypto_key_t *,
+    crypto_data_t *, crypto_data_t *, crypto_spi_ctx_template_t);
+
+static int chacha20_decrypt_atomic(crypto_mechanism_t *, crypto_key_t *,
+    crypto_data_t *, crypto_data_t *, crypto_spi_ctx_template_t);
+
+static const crypto_cipher_ops_t chacha20_cipher_ops = {
+	.encrypt_atomic = chacha20_encrypt_atomic,
+	.decrypt_atomic = chacha20_decrypt_atomic
+};
+
+static int chacha20_create_ctx_template(crypto_mechanism_t *, crypto_key_t *,
+    crypto_spi_ctx_template_t *, size_t *);
+static int chacha20_free_context(crypto_ctx_t *);
+
+static const crypto_ctx_ops_t chacha20_ctx_ops = {
+	.create_ctx_template = chacha20_create_ctx_template,
+	.free_context = chacha20_free_context
+};
+
+static const crypto_ops_t chacha20_crypto_ops = {
+	&chacha20_cipher_ops,
+	NULL,
+	&chacha20_ctx_ops,
+};
+
+static const crypto_provider_info_t chacha20_prov_info = {
+	"ChaCha20 Software Provider",
+	&chacha20_crypto_ops,
+	sizeof (chacha20_mech_info_tab) / sizeof (crypto_mech_info_t),
+	chacha20_mech_info_tab
+};
+
+static crypto_kcf_provider_handle_t chacha20_prov_handle = 0;
+
+int
+chacha20_mod_init(void)
+{
+	/* Determine the fastest available implementation. */
+	chacha20_impl_init();
+
+	/* Register with KCF.  If the registration fails, remove the module. */
+	if (crypto_register_provider(&chacha20_prov_info,
+	    &chacha20_prov_handle))
+		return (EACCES);
+
+	return (0);
+}
+
+int
+chacha20_mod_fini(void)
+{
+	/* Unregister from KCF if module is registered */
+	if (chacha20_prov_handle != 0) {
+		if (crypto_unregister_provider(chacha20_prov_handle))
+			return (EBUSY);
+
+		chacha20_prov_handle = 0;
+	}
+
+	return (0);
+}
+
+/*
+ * Check the mechanism and the key and set up a context for it. The
+ * context template, if there is one, is a copy of the key.
+ */
+static int
+chacha20_init_ctx(chacha20_poly1305_ctx_t **ctxp,
+    crypto_mechanism_t *mechanism, crypto_key_t *key,
+    crypto_spi_ctx_template_t template)
+{
+	chacha20_poly1305_ctx_t *ctx;
+	const uint8_t *keydata;
+	int rv;
+
+	if (mechanism->cm_type != CHACHA20_POLY1305_MECH_INFO_TYPE)
+		return (CRYPTO_MECHANISM_INVALID);
+	if (mechanism->cm_param == NULL ||
+	    mechanism->cm_param_len !=
+	    sizeof (CK_SALSA20_CHACHA20_POLY1305_PARAMS))
+		return (CRYPTO_MECHANISM_PARAM_INVALID);
+
+	if (template != NULL) {
+		keydata = template;
+	} else {
+		if (key->ck_length != CRYPTO_BYTES2BITS(CHACHA20_KEY_LEN))
+			return (CRYPTO_KEY_SIZE_RANGE);
+		keydata = (const uint8_t *)key->ck_data;
+	}
+
+	ctx = kmem_alloc(sizeof (*ctx), KM_SLEEP);
+	rv = chacha20_poly1305_init_ctx(ctx, keydata,
+	    (CK_SALSA20_CHACHA20_POLY1305_PARAMS *)mechanism->cm_param);
+	if (rv != CRYPTO_SUCCESS) {
+		chacha20_poly1305_clear_ctx(ctx);
+		kmem_free(ctx, sizeof (*ctx));
+		return (rv);
+	}
+
+	*ctxp = ctx;
+	return (CRYPTO_SUCCESS);
+}
+
+static void
+chacha20_free_ctx(chacha20_poly1305_ctx_t *ctx)
+{
+	chacha20_poly1305_clear_ctx(ctx);
+	kmem_free(ctx, sizeof (*ctx));
+}
+
+/*
+ * KCF software provider encrypt entry points.
+ */
+static int
+chacha20_encrypt_atomic(crypto_mechanism_t *mechanism,
+    crypto_key_t *key, crypto_data_t *plaintext, crypto_data_t *ciphertext,
+    crypto_spi_ctx_template_t template)
+{
+	chacha20_poly1305_ctx_t *ctx;
+	uint8_t tag[POLY1305_TAG_LEN];
+	off_t saved_offset;
+	size_t saved_length;
+	size_t length_needed;
+	int ret;
+
+	ASSERT(ciphertext != NULL);
+
+	/* return size of buffer needed to store output */
+	length_needed = plaintext->cd_length + POLY1305_TAG_LEN;
+	if (ciphertext->cd_length < length_needed) {
+		ciphertext->cd_length = length_needed;
+		return (CRYPTO_BUFFER_TOO_SMALL);
+	}
+
+	ret = chacha20_init_ctx(&ctx, mechanism, key, template);
+	if (ret != CRYPTO_SUCCESS)
+		return (ret);
+
+	saved_offset = ciphertext->cd_offset;
+	saved_length = ciphertext->cd_length;
+
+	/*
+	 * Do an update on the specified input data.
+	 */
+	switch (plaintext->cd_format) {
+	case CRYPTO_DATA_RAW:
+		ret = crypto_update_iov(ctx, plaintext, ciphertext,
+		    chacha20_poly1305_encrypt_contiguous);
+		break;
+	case CRYPTO_DATA_UIO:
+		ret = crypto_update_uio(ctx, plaintext, ciphertext,
+		    chacha20_poly1305_encrypt_contiguous);
+		break;
+	default:
+		ret = CRYPTO_ARGUMENTS_BAD;
+	}
+
+	if (ret == CRYPTO_SUCCESS) {
+		chacha20_poly1305_final(ctx, tag);
+		ret = crypto_put_output_data(tag, ciphertext, sizeof (tag));
+		ciphertext->cd_offset += sizeof (tag);
+		memset(tag, 0, sizeof (tag));
+	}
+
+	if (ret == CRYPTO_SUCCESS) {
+		ciphertext->cd_length = ciphertext->cd_offset - saved_offset;
+	} else {
+		ciphertext->cd_length = saved_length;
+	}
+	ciphertext->cd_offset = saved_offset;
+
+	chacha20_free_ctx(ctx);
+	return (ret);
+}
+
+/*
+ * The tag is verified over the whole ciphertext before any plaintext is
+ * written, so the ciphertext is walked twice.
+ */
+static int
+chacha20_decrypt_atomic(crypto_mechanism_t *mechanism,
+    crypto_key_t *key, crypto_data_t *ciphertext, crypto_data_t *plaintext,
+    crypto_spi_ctx_template_t template)
+{
+	chacha20_poly1305_ctx_t *ctx;
+	uint8_t tag[POLY1305_TAG_LEN];
+	off_t saved_offset;
+	size_t saved_length;
+	size_t length_needed;
+	uint8_t diff = 0;
+	int ret;
+
+	ASSERT(plaintext != NULL);
+
+	if (ciphertext->cd_length < POLY1305_TAG_LEN)
+		return (CRYPTO_ENCRYPTED_DATA_LEN_RANGE);
+
+	/* return size of buffer needed to store output */
+	length_needed = ciphertext->cd_length - POLY1305_TAG_LEN;
+	if (plaintext->cd_length < length_needed) {
+		plaintext->cd_length = length_needed;
+		return (CRYPTO_BUFFER_TOO_SMALL);
+	}
+
+	ret = chacha20_init_ctx(&ctx, mechanism, key, template);
+	if (ret != CRYPTO_SUCCESS)
+		return (ret);
+	ctx->cc_ct_len = length_needed;
+
+	saved_offset = plaintext->cd_offset;
+	saved_length = plaintext->cd_length;
+
+	switch (ciphertext->cd_format) {
+	case CRYPTO_DATA_RAW:
+		ret = crypto_update_iov(ctx, ciphertext, plaintext,
+		    chacha20_poly1305_mac_contiguous);
+		break;
+	case CRYPTO_DATA_UIO:
+		ret = crypto_update_uio(ctx, ciphertext, plaintext,
+		    chacha20_poly1305_mac_contiguous);
+		break;
+	default:
+		ret = CRYPTO_ARGUMENTS_BAD;
+	}
+	if (ret != CRYPTO_SUCCESS)
+		goto out;
+	if (ctx->cc_tag_len != POLY1305_TAG_LEN) {
+		ret = CRYPTO_ENCRYPTED_DATA_LEN_RANGE;
+		goto out;
+	}
+
+	chacha20_poly1305_final(ctx, tag);
+	for (int i = 0; i < POLY1305_TAG_LEN; i++)
+		diff |= tag[i] ^ ctx->cc_tag[i];
+	memset(tag, 0, sizeof (tag));
+	if (diff != 0) {
+		ret = CRYPTO_INVALID_MAC;
+		goto out;
+	}
+
+	ctx->cc_data_len = 0;
+	if (ciphertext->cd_format == CRYPTO_DATA_RAW) {
+		ret = crypto_update_iov(ctx, ciphertext, plaintext,
+		    chacha20_poly1305_decrypt_contiguous);
+	} else {
+		ret = crypto_update_uio(ctx, ciphertext, plaintext,
+		    chacha20_poly1305_decrypt_contiguous);
+	}
+
+out:
+	if (ret == CRYPTO_SUCCESS) {
+		plaintext->cd_length = plaintext->cd_offset - saved_offset;
+	} else {
+		plaintext->cd_length = saved_length;
+	}
+	plaintext->cd_offset = saved_offset;
+
+	chacha20_free_ctx(ctx);
+	return (ret);
+}
+
+/*
+ * KCF software provider context template entry points.
+ */
+static int
+chacha20_create_ctx_template(crypto_mechanism_t *mechanism, crypto_key_t *key,
+    crypto_spi_ctx_template_t *tmpl, size_t *tmpl_size)
+{
+	uint8_t *keydata;
+
+	if (mechanism->cm_type != CHACHA20_POLY1305_MECH_INFO_TYPE)
+		return (CRYPTO_MECHANISM_INVALID);
+
+	if (key->ck_length != CRYPTO_BYTES2BITS(CHACHA20_KEY_LEN))
+		return (CRYPTO_KEY_SIZE_RANGE);
+
+	keydata = kmem_alloc(CHACHA20_KEY_LEN, KM_SLEEP);
+	memcpy(keydata, key->ck_data, CHACHA20_KEY_LEN);
+
+	*tmpl = keydata;
+	*tmpl_size = CHACHA20_KEY_LEN;
+
+	return (CRYPTO_SUCCESS);
+}
+
+static int
+chacha20_free_context(crypto_ctx_t *ctx)
+{
+	chacha20_poly1305_ctx_t *cc_ctx = ctx->cc_provider_private;
+
+	if (cc_ctx != NULL) {
+		chacha20_free_ctx(cc_ctx);
+		ctx->cc_provider_private = NULL;
+	}
+
+	return (CRYPTO_SUCCESS);
+}
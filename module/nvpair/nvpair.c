@@ -140,6 +140,7 @@ static int nvlist_add_common(nvlist_t *nvl, const char *name, data_type_t type,
     uint_t nelem, const void *data);
 
 #define	NV_STAT_EMBEDDED	0x1
+#define	NV_STAT_ARENA		0x2	/* owns its nv_arena_ops allocator */
 #define	EMBEDDED_NVL(nvp)	((nvlist_t *)(void *)NVP_VALUE(nvp))
 #define	EMBEDDED_NVL_ARRAY(nvp)	((nvlist_t **)(void *)NVP_VALUE(nvp))
 
@@ -877,6 +878,17 @@ nvlist_free(nvlist_t *nvl)
 	    (priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
 		return;
 
+	/*
+	 * Everything in an arena nvlist, including the allocator itself,
+	 * lives in the arena, which goes away in one step.
+	 */
+	if (priv->nvp_stat & NV_STAT_ARENA) {
+		nv_alloc_t nva = *priv->nvp_nva;
+
+		nv_alloc_fini(&nva);
+		return;
+	}
+
 	/*
 	 * Unpacked nvlist are linked through i_nvp_t
 	 */
@@ -2746,6 +2758,48 @@ nvlist_unpack(char *buf, size_t buflen, nvlist_t **nvlp, int kmflag)
 	return (nvlist_xunpack(buf, buflen, nvlp, nvlist_nv_alloc(kmflag)));
 }
 
+/*
+ * Unpack buf into an nvlist_t that lives in an arena of its own: the
+ * pairs are carved out of a few large chunks instead of being allocated
+ * one by one, and nvlist_free() releases the whole list in one step.
+ * This is meant for large lists that are mostly read, such as the pool
+ * configs and properties that come back from ioctls.  The list can still
+ * be modified, but the memory of removed pairs is only reclaimed when
+ * the list is freed.  Lists looked up in it must not outlive it.
+ */
+int
+nvlist_unpack_arena(char *buf, size_t buflen, nvlist_t **nvlp, int kmflag)
+{
+	nv_alloc_t arena, *nva;
+	nvpriv_t *priv;
+	int err;
+
+	if (nvlp == NULL)
+		return (EINVAL);
+
+	/* An unpacked list takes about as much memory as the packed one */
+	if ((err = nv_alloc_init(&arena, nv_arena_ops,
+	    nvlist_nv_alloc(kmflag), buflen + buflen / 2)) != 0)
+		return (err);
+
+	if ((nva = arena.nva_ops->nv_ao_alloc(&arena,
+	    sizeof (nv_alloc_t))) == NULL) {
+		nv_alloc_fini(&arena);
+		return (ENOMEM);
+	}
+	*nva = arena;
+
+	if ((err = nvlist_xunpack(buf, buflen, nvlp, nva)) != 0) {
+		nv_alloc_fini(&arena);
+		return (err);
+	}
+
+	priv = (nvpriv_t *)(uintptr_t)(*nvlp)->nvl_priv;
+	priv->nvp_stat |= NV_STAT_ARENA;
+
+	return (0);
+}
+
 int
 nvlist_xunpack(char *buf, size_t buflen, nvlist_t **nvlp, nv_alloc_t *nva)
 {
@@ -3925,6 +3979,7 @@ EXPORT_SYMBOL(nvlist_free);
 EXPORT_SYMBOL(nvlist_size);
 EXPORT_SYMBOL(nvlist_pack);
 EXPORT_SYMBOL(nvlist_unpack);
+EXPORT_SYMBOL(nvlist_unpack_arena);
 EXPORT_SYMBOL(nvlist_dup);
 EXPORT_SYMBOL(nvlist_merge);
 
@@ -111,6 +111,138 @@ static const nv_alloc_ops_t nv_fixed_ops_def = {
 
 const nv_alloc_ops_t *const nv_fixed_ops = &nv_fixed_ops_def;
 
+/*
+ * The arena allocator is the growable sibling of the one above.  It hands
+ * out memory from chunks that it gets from another allocator, and returns
+ * them only when it is reset or torn down, so that a large nvlist can be
+ * built with one allocation per chunk instead of one or more per pair, and
+ * freed in one step.  Memory freed before that is not reused.
+ */
+
+/* chunks start at the size given at init and double up to this size */
+#define	NV_ARENA_MAXCHUNK	(1024 * 1024)
+
+typedef struct nvarena_chunk {
+	struct nvarena_chunk	*nvc_next;
+	size_t			nvc_size;
+} nvarena_chunk_t;
+
+typedef struct nvarena {
+	nv_alloc_t	*nvr_backing;	/* allocator of the chunks */
+	nvarena_chunk_t	*nvr_chunks;	/* most recent chunk first */
+	uintptr_t	nvr_cur;	/* current address in the chunk */
+	uintptr_t	nvr_lim;	/* limit address in the chunk */
+	size_t		nvr_chunksz;	/* size of the next chunk */
+} nvarena_t;
+
+/*
+ * Initialize the arena allocator. The caller needs to supply
+ *
+ *   backing	nv_alloc_t to allocate the chunks from
+ *   chunksz	size of the first chunk
+ */
+static int
+nv_arena_init(nv_alloc_t *nva, va_list valist)
+{
+	nv_alloc_t *backing = va_arg(valist, nv_alloc_t *);
+	size_t chunksz = va_arg(valist, size_t);
+	nvarena_t *nvr;
+
+	if (backing == NULL)
+		return (EINVAL);
+
+	nvr = backing->nva_ops->nv_ao_alloc(backing, sizeof (nvarena_t));
+	if (nvr == NULL)
+		return (ENOMEM);
+
+	nvr->nvr_backing = backing;
+	nvr->nvr_chunks = NULL;
+	nvr->nvr_cur = 0;
+	nvr->nvr_lim = 0;
+	nvr->nvr_chunksz = MIN(MAX(chunksz, 4096), NV_ARENA_MAXCHUNK);
+	nva->nva_arg = nvr;
+
+	return (0);
+}
+
+static void *
+nv_arena_alloc(nv_alloc_t *nva, size_t size)
+{
+	nvarena_t *nvr = nva->nva_arg;
+	nv_alloc_t *backing = nvr->nvr_backing;
+	uintptr_t new;
+
+	if (size == 0)
+		return (NULL);
+	size = P2ROUNDUP(size, sizeof (uint64_t));
+
+	if (nvr->nvr_cur + size > nvr->nvr_lim) {
+		size_t hdrsz = P2ROUNDUP(sizeof (nvarena_chunk_t),
+		    sizeof (uint64_t));
+		size_t chunksz = MAX(nvr->nvr_chunksz, hdrsz + size);
+		nvarena_chunk_t *nvc;
+
+		nvc = backing->nva_ops->nv_ao_alloc(backing, chunksz);
+		if (nvc == NULL)
+			return (NULL);
+		nvc->nvc_next = nvr->nvr_chunks;
+		nvc->nvc_size = chunksz;
+		nvr->nvr_chunks = nvc;
+		nvr->nvr_cur = (uintptr_t)nvc + hdrsz;
+		nvr->nvr_lim = (uintptr_t)nvc + chunksz;
+		nvr->nvr_chunksz = MIN(nvr->nvr_chunksz * 2, NV_ARENA_MAXCHUNK);
+	}
+
+	new = nvr->nvr_cur;
+	nvr->nvr_cur += size;
+
+	return ((void *)new);
+}
+
+static void
+nv_arena_free(nv_alloc_t *nva, void *buf, size_t size)
+{
+	/* memory is only given back when the whole arena is */
+	(void) nva, (void) buf, (void) size;
+}
+
+static void
+nv_arena_reset(nv_alloc_t *nva)
+{
+	nvarena_t *nvr = nva->nva_arg;
+	nv_alloc_t *backing = nvr->nvr_backing;
+	nvarena_chunk_t *nvc;
+
+	while ((nvc = nvr->nvr_chunks) != NULL) {
+		nvr->nvr_chunks = nvc->nvc_next;
+		backing->nva_ops->nv_ao_free(backing, nvc, nvc->nvc_size);
+	}
+	nvr->nvr_cur = 0;
+	nvr->nvr_lim = 0;
+}
+
+static void
+nv_arena_fini(nv_alloc_t *nva)
+{
+	nvarena_t *nvr = nva->nva_arg;
+	nv_alloc_t *backing = nvr->nvr_backing;
+
+	nv_arena_reset(nva);
+	backing->nva_ops->nv_ao_free(backing, nvr, sizeof (nvarena_t));
+	nva->nva_arg = NULL;
+}
+
+static const nv_alloc_ops_t nv_arena_ops_def = {
+	.nv_ao_init = nv_arena_init,
+	.nv_ao_fini = nv_arena_fini,
+	.nv_ao_alloc = nv_arena_alloc,
+	.nv_ao_free = nv_arena_free,
+	.nv_ao_reset = nv_arena_reset
+};
+
+const nv_alloc_ops_t *const nv_arena_ops = &nv_arena_ops_def;
+
 #if defined(_KERNEL)
 EXPORT_SYMBOL(nv_fixed_ops);
+EXPORT_SYMBOL(nv_arena_ops);
 #endif
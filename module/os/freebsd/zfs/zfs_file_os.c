@@ -220,6 +220,15 @@ zfs_file_pread(zfs_file_t *fp, void *buf, size_t count, loff_t off,
 	return (zfs_file_read_impl(fp, buf, count, &off, resid));
 }
 
+int
+zfs_file_aio_rw(zfs_file_t *fp, boolean_t write, void *buf, size_t count,
+    loff_t off, zfs_file_aio_done_t *done, void *arg)
+{
+	(void) fp, (void) write, (void) buf, (void) count, (void) off;
+	(void) done, (void) arg;
+	return (SET_ERROR(ENOTSUP));
+}
+
 int
 zfs_file_seek(zfs_file_t *fp, loff_t *offp, int whence)
 {
@@ -1043,6 +1043,8 @@ zfsvfs_create_impl(zfsvfs_t **zfvp, zfsvfs_t *zfsvfs, objset_t *os)
 	zfsvfs->z_parent = zfsvfs;
 
 	mutex_init(&zfsvfs->z_znodes_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&zfsvfs->z_async_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zfsvfs->z_async_cv, NULL, CV_DEFAULT, NULL);
 	mutex_init(&zfsvfs->z_lock, NULL, MUTEX_DEFAULT, NULL);
 	list_create(&zfsvfs->z_all_znodes, sizeof (znode_t),
 	    offsetof(znode_t, z_link_node));
@@ -1191,6 +1193,8 @@ zfsvfs_free(zfsvfs_t *zfsvfs)
 	zfs_fuid_destroy(zfsvfs);
 
 	mutex_destroy(&zfsvfs->z_znodes_lock);
+	mutex_destroy(&zfsvfs->z_async_lock);
+	cv_destroy(&zfsvfs->z_async_cv);
 	mutex_destroy(&zfsvfs->z_lock);
 	list_destroy(&zfsvfs->z_all_znodes);
 	ZFS_TEARDOWN_DESTROY(zfsvfs);
@@ -1609,6 +1613,12 @@ zfsvfs_teardown(zfsvfs_t *zfsvfs, boolean_t unmounting)
 	}
 	ZFS_TEARDOWN_ENTER_WRITE(zfsvfs, FTAG);
 
+	/*
+	 * New asynchronous reads can no longer start, wait for the ones
+	 * still in flight, which do not take the teardown lock.
+	 */
+	zfs_read_async_wait(zfsvfs);
+
 	if (!unmounting) {
 		/*
 		 * We purge the parent filesystem's vfsp as the parent
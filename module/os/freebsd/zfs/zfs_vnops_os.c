@@ -457,8 +457,13 @@ mappedread_sf(znode_t *zp, int nbytes, zfs_uio_t *uio)
 		    VM_ALLOC_SBUSY | VM_ALLOC_NORMAL | VM_ALLOC_IGN_SBUSY);
 		if (vm_page_none_valid(pp)) {
 			va = zfs_map_page(pp, &sf);
-			error = dmu_read(os, zp->z_id, start, bytes, va,
-			    DMU_READ_PREFETCH);
+			if (zp->z_pflags & ZFS_INLINE_DATA) {
+				error = zfs_sa_inline_read(zp, va, start,
+				    bytes);
+			} else {
+				error = dmu_read(os, zp->z_id, start, bytes,
+				    va, DMU_READ_PREFETCH);
+			}
 			if (bytes != PAGESIZE && error == 0)
 				memset(va + bytes, 0, PAGESIZE - bytes);
 			zfs_unmap_page(sf);
@@ -3987,6 +3992,27 @@ zfs_getpages(struct vnode *vp, vm_page_t *ma, int count, int *rbehind,
 			    ma, count);
 			zfs_vmobject_wunlock(object);
 		}
+		if (zp->z_pflags & ZFS_INLINE_DATA) {
+			/*
+			 * Pages are only backed by data blocks, move inline
+			 * data to one.  As above, the pages are unbusied
+			 * while the file is locked.
+			 */
+			zfs_rangelock_exit(lr);
+			for (int i = 0; i < count; i++)
+				vm_page_xunbusy(ma[i]);
+			error = zfs_sa_inline_to_blocks(zp);
+			zfs_vmobject_wlock(object);
+			(void) vm_page_grab_pages(object, OFF_TO_IDX(start),
+			    VM_ALLOC_NORMAL | VM_ALLOC_WAITOK | VM_ALLOC_ZERO,
+			    ma, count);
+			zfs_vmobject_wunlock(object);
+			if (error != 0) {
+				zfs_exit(zfsvfs, FTAG);
+				return (zfs_vm_pagerret_error);
+			}
+			continue;
+		}
 		if (blksz == zp->z_blksz)
 			break;
 		zfs_rangelock_exit(lr);
@@ -4118,6 +4144,13 @@ zfs_putpages(struct vnode *vp, vm_page_t *ma, size_t len, int flags,
 	if (zfs_enter_verify_zp(zfsvfs, zp, FTAG) != 0)
 		return (zfs_vm_pagerret_error);
 
+	/* Pages are only backed by data blocks, see zfs_read(). */
+	if ((zp->z_pflags & ZFS_INLINE_DATA) &&
+	    zfs_sa_inline_to_blocks(zp) != 0) {
+		zfs_exit(zfsvfs, FTAG);
+		return (zfs_vm_pagerret_error);
+	}
+
 	off = IDX_TO_OFF(ma[0]->pindex);
 	blksz = zp->z_blksz;
 	lo_off = rounddown(off, blksz);
@@ -104,7 +104,9 @@ extern struct vop_vector zfs_shareops;
  * This callback is invoked when acquiring a RL_WRITER or RL_APPEND lock on
  * z_rangelock. It will modify the offset and length of the lock to reflect
  * znode-specific information, and convert RL_APPEND to RL_WRITER.  This is
- * called with the rangelock_t's rl_lock held, which avoids races.
+ * called with the rangelock_t's rl_lock held, which avoids races.  Once the
+ * range lock is sharded it is called unlocked instead, and again after the
+ * range is locked to check the result still holds.
  */
 static void
 zfs_rangelock_cb(zfs_locked_range_t *new, void *arg)
@@ -454,7 +456,9 @@ zfs_znode_alloc(zfsvfs_t *zfsvfs, dmu_buf_t *db, int blksz,
 	zp->z_id = db->db_object;
 	zp->z_blksz = blksz;
 	zp->z_seq = 0x7A4653;
+	zp->z_auto_blksz = 0;
 	zp->z_sync_cnt = 0;
+	zp->z_replay_eof = 0;
 	zp->z_sync_writes_cnt = 0;
 	zp->z_async_writes_cnt = 0;
 	atomic_store_ptr(&zp->z_cached_symlink, NULL);
@@ -1594,6 +1598,10 @@ zfs_freesp(znode_t *zp, uint64_t off, uint64_t len, int flag, boolean_t log)
 	    sizeof (mode))) != 0)
 		return (error);
 
+	if ((zp->z_pflags & ZFS_INLINE_DATA) &&
+	    (error = zfs_sa_inline_freesp(zp, off, len)) != 0)
+		return (error);
+
 	if (off > zp->z_size) {
 		error =  zfs_extend(zp, off+len);
 		if (error == 0 && log)
@@ -651,6 +651,9 @@ zvol_strategy_impl(zv_request_t *zvr)
 		goto resume;
 	}
 
+	if (bp->bio_cmd != BIO_DELETE)
+		zfs_qos_charge(&os->os_qos, !doread, resid);
+
 	is_dumpified = B_FALSE;
 	commit = !doread && !is_dumpified &&
 	    zv->zv_objset->os_sync == ZFS_SYNC_ALWAYS;
@@ -826,6 +829,7 @@ zvol_cdev_read(struct cdev *dev, struct uio *uio_s, int ioflag)
 
 	rw_enter(&zv->zv_suspend_lock, ZVOL_RW_READER);
 	ssize_t start_resid = zfs_uio_resid(&uio);
+	zfs_qos_charge(&zv->zv_objset->os_qos, B_FALSE, start_resid);
 	lr = zfs_rangelock_enter(&zv->zv_rangelock, zfs_uio_offset(&uio),
 	    zfs_uio_resid(&uio), RL_READER);
 	while (zfs_uio_resid(&uio) > 0 && zfs_uio_offset(&uio) < volsize) {
@@ -878,6 +882,7 @@ zvol_cdev_write(struct cdev *dev, struct uio *uio_s, int ioflag)
 
 	rw_enter(&zv->zv_suspend_lock, ZVOL_RW_READER);
 	zvol_ensure_zilog(zv);
+	zfs_qos_charge(&zv->zv_objset->os_qos, B_TRUE, start_resid);
 
 	lr = zfs_rangelock_enter(&zv->zv_rangelock, zfs_uio_offset(&uio),
 	    zfs_uio_resid(&uio), RL_WRITER);
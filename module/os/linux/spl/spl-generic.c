@@ -61,6 +61,41 @@ MODULE_PARM_DESC(spl_hostid, "The system hostid.");
 proc_t p0;
 EXPORT_SYMBOL(p0);
 
+/*
+ * NUMA node ids may be sparse and some nodes have no CPUs.  Map between
+ * node ids and a dense index over the online nodes with CPUs, which are
+ * the ones boot_nnodes counts.  Returns -1 for a node without CPUs.
+ */
+int
+spl_node_index(int node)
+{
+	int n, index = 0;
+
+	for_each_node_state(n, N_CPU) {
+		if (n == node)
+			return (index);
+		index++;
+	}
+	return (-1);
+}
+EXPORT_SYMBOL(spl_node_index);
+
+/*
+ * Return the id of the index'th online node with CPUs, or NUMA_NO_NODE.
+ */
+int
+spl_node_id(int index)
+{
+	int n;
+
+	for_each_node_state(n, N_CPU) {
+		if (index-- == 0)
+			return (n);
+	}
+	return (NUMA_NO_NODE);
+}
+EXPORT_SYMBOL(spl_node_id);
+
 /*
  * xoshiro256++ 1.0 PRNG by David Blackman and Sebastiano Vigna
  *
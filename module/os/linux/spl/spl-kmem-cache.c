@@ -68,6 +68,24 @@ module_param(spl_kmem_cache_magazine_size, uint, 0444);
 MODULE_PARM_DESC(spl_kmem_cache_magazine_size,
 	"Default magazine size (2-256), set automatically (0)");
 
+/*
+ * The magazine depot holds full and empty magazines which are swapped with
+ * the per-cpu magazines, so a cpu whose magazine runs empty or full only
+ * takes the depot lock instead of refilling from or flushing to the slabs
+ * under the cache lock.  Up to spl_kmem_cache_depot_size full magazines are
+ * kept per cache, and the depot is disabled when this is set to 0.  While
+ * the depot is enabled, contention on its lock doubles the magazine size of
+ * the cache up to SPL_MAGAZINE_GROWTH times its initial size, unless the
+ * size was fixed with spl_kmem_cache_magazine_size.
+ */
+static unsigned int spl_kmem_cache_depot_size = 0;
+module_param(spl_kmem_cache_depot_size, uint, 0644);
+MODULE_PARM_DESC(spl_kmem_cache_depot_size,
+	"Full magazines kept in each cache depot, disabled (0)");
+
+#define	SPL_DEPOT_CONTENTION	16	/* contentions per magazine resize */
+#define	SPL_MAGAZINE_GROWTH	4	/* max growth over initial size */
+
 static unsigned int spl_kmem_cache_obj_per_slab = SPL_KMEM_CACHE_OBJ_PER_SLAB;
 module_param(spl_kmem_cache_obj_per_slab, uint, 0644);
 MODULE_PARM_DESC(spl_kmem_cache_obj_per_slab, "Number of objects per slab");
@@ -572,20 +590,21 @@ spl_magazine_size(spl_kmem_cache_t *skc)
  * Allocate a per-cpu magazine to associate with a specific core.
  */
 static spl_kmem_magazine_t *
-spl_magazine_alloc(spl_kmem_cache_t *skc, int cpu)
+spl_magazine_alloc(spl_kmem_cache_t *skc, int cpu, gfp_t gfp)
 {
 	spl_kmem_magazine_t *skm;
-	int size = sizeof (spl_kmem_magazine_t) +
-	    sizeof (void *) * skc->skc_mag_size;
+	uint32_t mag_size = READ_ONCE(skc->skc_mag_size);
+	int size = sizeof (spl_kmem_magazine_t) + sizeof (void *) * mag_size;
 
-	skm = kmalloc_node(size, GFP_KERNEL, cpu_to_node(cpu));
+	skm = kmalloc_node(size, gfp, cpu_to_node(cpu));
 	if (skm) {
 		skm->skm_magic = SKM_MAGIC;
 		skm->skm_avail = 0;
-		skm->skm_size = skc->skc_mag_size;
-		skm->skm_refill = skc->skc_mag_refill;
+		skm->skm_size = mag_size;
+		skm->skm_refill = (mag_size + 1) / 2;
 		skm->skm_cache = skc;
 		skm->skm_cpu = cpu;
+		INIT_LIST_HEAD(&skm->skm_list);
 	}
 
 	return (skm);
@@ -602,6 +621,157 @@ spl_magazine_free(spl_kmem_magazine_t *skm)
 	kfree(skm);
 }
 
+/*
+ * Take the depot lock.  Contention on it means the magazines are too small
+ * for the rate at which this cache is exchanging them, so grow the size of
+ * newly allocated magazines.
+ */
+static void
+spl_depot_lock(spl_kmem_cache_t *skc)
+{
+	uint32_t max_size;
+
+	if (spin_trylock(&skc->skc_depot_lock))
+		return;
+
+	spin_lock(&skc->skc_depot_lock);
+	if (++skc->skc_depot_contention < SPL_DEPOT_CONTENTION ||
+	    spl_kmem_cache_magazine_size > 0)
+		return;
+
+	skc->skc_depot_contention = 0;
+	max_size = MIN(spl_magazine_size(skc) * SPL_MAGAZINE_GROWTH, 256);
+	if (skc->skc_mag_size < max_size) {
+		WRITE_ONCE(skc->skc_mag_size,
+		    MIN(skc->skc_mag_size * 2, max_size));
+		skc->skc_mag_refill = (skc->skc_mag_size + 1) / 2;
+	}
+}
+
+/*
+ * Swap the empty per-cpu magazine for a full one from the depot.  Returns
+ * the now loaded magazine, or NULL when the depot has no full magazines.
+ * Must be called with interrupts disabled.
+ */
+static spl_kmem_magazine_t *
+spl_depot_alloc(spl_kmem_cache_t *skc, spl_kmem_magazine_t *skm)
+{
+	spl_kmem_magazine_t *full = NULL;
+	int cpu = smp_processor_id();
+
+	ASSERT0(skm->skm_avail);
+
+	if (list_empty(&skc->skc_depot_full))
+		return (NULL);
+
+	spl_depot_lock(skc);
+	if (!list_empty(&skc->skc_depot_full)) {
+		full = list_first_entry(&skc->skc_depot_full,
+		    spl_kmem_magazine_t, skm_list);
+		list_del_init(&full->skm_list);
+		skc->skc_depot_nfull--;
+
+		/* Keep the empty magazine unless it has been outgrown */
+		if (skm->skm_size == skc->skc_mag_size) {
+			list_add(&skm->skm_list, &skc->skc_depot_empty);
+			skm = NULL;
+		}
+	}
+	spin_unlock(&skc->skc_depot_lock);
+
+	if (full == NULL)
+		return (NULL);
+
+	if (skm != NULL)
+		spl_magazine_free(skm);
+
+	full->skm_cpu = cpu;
+	skc->skc_mag[cpu] = full;
+
+	return (full);
+}
+
+/*
+ * Swap the full per-cpu magazine for an empty one, leaving the full one in
+ * the depot.  Returns the now loaded magazine, or NULL when the depot is
+ * full or disabled.  Must be called with interrupts disabled.
+ */
+static spl_kmem_magazine_t *
+spl_depot_free(spl_kmem_cache_t *skc, spl_kmem_magazine_t *skm)
+{
+	spl_kmem_magazine_t *empty = NULL;
+	int cpu = smp_processor_id();
+
+	ASSERT3U(skm->skm_avail, ==, skm->skm_size);
+
+	if (READ_ONCE(skc->skc_depot_nfull) >= spl_kmem_cache_depot_size)
+		return (NULL);
+
+	spl_depot_lock(skc);
+	while (empty == NULL && !list_empty(&skc->skc_depot_empty)) {
+		empty = list_first_entry(&skc->skc_depot_empty,
+		    spl_kmem_magazine_t, skm_list);
+		list_del_init(&empty->skm_list);
+
+		/* Drop empty magazines which have been outgrown */
+		if (empty->skm_size != skc->skc_mag_size) {
+			spl_magazine_free(empty);
+			empty = NULL;
+		}
+	}
+	spin_unlock(&skc->skc_depot_lock);
+
+	if (empty == NULL) {
+		empty = spl_magazine_alloc(skc, cpu, GFP_ATOMIC | __GFP_NOWARN);
+		if (empty == NULL)
+			return (NULL);
+	}
+
+	spl_depot_lock(skc);
+	if (skc->skc_depot_nfull >= spl_kmem_cache_depot_size) {
+		list_add(&empty->skm_list, &skc->skc_depot_empty);
+		spin_unlock(&skc->skc_depot_lock);
+		return (NULL);
+	}
+	list_add(&skm->skm_list, &skc->skc_depot_full);
+	skc->skc_depot_nfull++;
+	spin_unlock(&skc->skc_depot_lock);
+
+	empty->skm_cpu = cpu;
+	skc->skc_mag[cpu] = empty;
+
+	return (empty);
+}
+
+/*
+ * Release all magazines held by the depot, returning the objects in the
+ * full ones to their slabs.
+ */
+static void
+spl_depot_reap(spl_kmem_cache_t *skc)
+{
+	spl_kmem_magazine_t *skm, *next;
+	LIST_HEAD(full);
+	LIST_HEAD(empty);
+
+	spin_lock(&skc->skc_depot_lock);
+	list_splice_init(&skc->skc_depot_full, &full);
+	list_splice_init(&skc->skc_depot_empty, &empty);
+	skc->skc_depot_nfull = 0;
+	spin_unlock(&skc->skc_depot_lock);
+
+	list_for_each_entry_safe(skm, next, &full, skm_list) {
+		list_del_init(&skm->skm_list);
+		spl_cache_flush(skc, skm, skm->skm_avail);
+		spl_magazine_free(skm);
+	}
+
+	list_for_each_entry_safe(skm, next, &empty, skm_list) {
+		list_del_init(&skm->skm_list);
+		spl_magazine_free(skm);
+	}
+}
+
 /*
  * Create all pre-cpu magazines of reasonable sizes.
  */
@@ -616,9 +786,14 @@ spl_magazine_create(spl_kmem_cache_t *skc)
 	    num_possible_cpus(), kmem_flags_convert(KM_SLEEP));
 	skc->skc_mag_size = spl_magazine_size(skc);
 	skc->skc_mag_refill = (skc->skc_mag_size + 1) / 2;
+	spin_lock_init(&skc->skc_depot_lock);
+	INIT_LIST_HEAD(&skc->skc_depot_full);
+	INIT_LIST_HEAD(&skc->skc_depot_empty);
+	skc->skc_depot_nfull = 0;
+	skc->skc_depot_contention = 0;
 
 	for_each_possible_cpu(i) {
-		skc->skc_mag[i] = spl_magazine_alloc(skc, i);
+		skc->skc_mag[i] = spl_magazine_alloc(skc, i, GFP_KERNEL);
 		if (!skc->skc_mag[i]) {
 			for (i--; i >= 0; i--)
 				spl_magazine_free(skc->skc_mag[i]);
@@ -648,6 +823,7 @@ spl_magazine_destroy(spl_kmem_cache_t *skc)
 		spl_magazine_free(skm);
 	}
 
+	spl_depot_reap(skc);
 	kfree(skc->skc_mag);
 }
 
@@ -1251,7 +1427,11 @@ restart:
 	if (likely(skm->skm_avail)) {
 		/* Object available in CPU cache, use it */
 		obj = skm->skm_objs[--skm->skm_avail];
+	} else if ((skm = spl_depot_alloc(skc, skm)) != NULL) {
+		/* Swapped in a full magazine from the depot */
+		obj = skm->skm_objs[--skm->skm_avail];
 	} else {
+		skm = skc->skc_mag[smp_processor_id()];
 		obj = spl_cache_refill(skc, skm, flags);
 		if ((obj == NULL) && !(flags & KM_NOSLEEP))
 			goto restart;
@@ -1341,8 +1521,13 @@ spl_kmem_cache_free(spl_kmem_cache_t *skc, void *obj)
 	 * interrupts are re-enabled.
 	 */
 	if (unlikely(skm->skm_avail >= skm->skm_size)) {
-		spl_cache_flush(skc, skm, skm->skm_refill);
-		do_reclaim = 1;
+		spl_kmem_magazine_t *empty = spl_depot_free(skc, skm);
+		if (empty != NULL) {
+			skm = empty;
+		} else {
+			spl_cache_flush(skc, skm, skm->skm_refill);
+			do_reclaim = 1;
+		}
 	}
 
 	/* Available space in cache, use it */
@@ -1386,6 +1571,7 @@ spl_kmem_cache_reap_now(spl_kmem_cache_t *skc)
 	spl_cache_flush(skc, skm, skm->skm_avail);
 	local_irq_restore(irq_flags);
 
+	spl_depot_reap(skc);
 	spl_slab_reclaim(skc);
 	clear_bit_unlock(KMC_BIT_REAPING, &skc->skc_flags);
 	smp_mb__after_atomic();
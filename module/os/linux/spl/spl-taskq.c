@@ -69,6 +69,7 @@ typedef struct taskq_kstats {
 	kstat_named_t tqks_tasks_executed;
 	kstat_named_t tqks_tasks_delayed_requeued;
 	kstat_named_t tqks_tasks_cancelled;
+	kstat_named_t tqks_tasks_stolen;
 	kstat_named_t tqks_thread_wakeups;
 	kstat_named_t tqks_thread_wakeups_nowork;
 	kstat_named_t tqks_thread_sleeps;
@@ -96,6 +97,7 @@ static taskq_kstats_t taskq_kstats_template = {
 	{ "tasks_executed",		KSTAT_DATA_UINT64 },
 	{ "tasks_delayed_requeued",	KSTAT_DATA_UINT64 },
 	{ "tasks_cancelled",		KSTAT_DATA_UINT64 },
+	{ "tasks_stolen",		KSTAT_DATA_UINT64 },
 	{ "thread_wakeups",		KSTAT_DATA_UINT64 },
 	{ "thread_wakeups_nowork",	KSTAT_DATA_UINT64 },
 	{ "thread_sleeps",		KSTAT_DATA_UINT64 },
@@ -480,6 +482,112 @@ taskq_find(taskq_t *tq, taskqid_t id)
 	return (NULL);
 }
 
+/*
+ * Work-stealing taskqs (TASKQ_STEAL) queue entries dispatched with
+ * taskq_dispatch_ent() on per-thread queues instead of the shared pending
+ * and priority lists, so that dispatchers on different CPUs do not all
+ * contend on tq_lock.  A dispatcher picks the queue by its CPU, and each
+ * thread runs work from its own queue first, stealing from the others
+ * before it goes idle.  These entries are never given a task id and are
+ * not tracked by tq_lowest_id, so they can only be waited for as a whole
+ * by taskq_wait() and cannot be canceled.  Everything else, including
+ * TQ_NOQUEUE dispatches, still goes through the shared lists.
+ */
+static boolean_t
+taskq_steal_queued(taskq_t *tq)
+{
+	if (!(tq->tq_flags & TASKQ_STEAL))
+		return (B_FALSE);
+
+	/* Pairs with wq_has_sleeper() in taskq_dispatch_steal() */
+	smp_mb();
+
+	for (int i = 0; i < tq->tq_nsteal_queues; i++) {
+		if (!list_empty(&tq->tq_steal_queues[i].tqsq_list))
+			return (B_TRUE);
+	}
+
+	return (B_FALSE);
+}
+
+/*
+ * Returns B_TRUE when no work-stealing queue entry is queued or running.
+ * A thread marks itself busy under the queue lock while taking an entry,
+ * so the queues must be checked before the threads.
+ */
+static boolean_t
+taskq_steal_idle(taskq_t *tq)
+{
+	taskq_steal_queue_t *tqsq;
+	taskq_thread_t *tqt;
+	unsigned long flags;
+	boolean_t idle = B_TRUE;
+
+	for (int i = 0; i < tq->tq_nsteal_queues && idle; i++) {
+		tqsq = &tq->tq_steal_queues[i];
+		spin_lock_irqsave(&tqsq->tqsq_lock, flags);
+		idle = list_empty(&tqsq->tqsq_list);
+		spin_unlock_irqrestore(&tqsq->tqsq_lock, flags);
+	}
+
+	if (!idle)
+		return (B_FALSE);
+
+	spin_lock_irqsave_nested(&tq->tq_lock, flags, tq->tq_lock_class);
+	list_for_each_entry(tqt, &tq->tq_thread_list, tqt_thread_list) {
+		if (READ_ONCE(tqt->tqt_task) != NULL) {
+			idle = B_FALSE;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&tq->tq_lock, flags);
+
+	return (idle);
+}
+
+/*
+ * Take the next entry from the queue owned by the thread or, failing that,
+ * steal one from the other queues.  The caller must not hold tq_lock.
+ */
+static taskq_ent_t *
+taskq_steal_ent(taskq_t *tq, taskq_thread_t *tqt, taskq_ent_t *dup_task)
+{
+	taskq_steal_queue_t *tqsq;
+	taskq_ent_t *t = NULL;
+	unsigned long flags;
+	int i, n = tq->tq_nsteal_queues;
+
+	for (i = 0; i < n && t == NULL; i++) {
+		tqsq = &tq->tq_steal_queues[(tqt->tqt_steal_queue + i) % n];
+		if (list_empty(&tqsq->tqsq_list))
+			continue;
+
+		spin_lock_irqsave(&tqsq->tqsq_lock, flags);
+		if (!list_empty(&tqsq->tqsq_list)) {
+			t = list_first_entry(&tqsq->tqsq_list, taskq_ent_t,
+			    tqent_list);
+			list_del_init(&t->tqent_list);
+
+			/*
+			 * The entry may be reused once its function is
+			 * called, so run from a copy as taskq_thread() does.
+			 */
+			*dup_task = *t;
+			WRITE_ONCE(tqt->tqt_task, dup_task);
+		}
+		spin_unlock_irqrestore(&tqsq->tqsq_lock, flags);
+	}
+
+	if (t == NULL)
+		return (NULL);
+
+	/* Taken from the queue of another thread */
+	if (i > 1)
+		TQSTAT_INC(tq, tasks_stolen);
+
+	return (dup_task);
+}
+
 /*
  * Theory for the taskq_wait_id(), taskq_wait_outstanding(), and
  * taskq_wait() functions below.
@@ -541,6 +649,13 @@ taskq_wait_outstanding_check(taskq_t *tq, taskqid_t id)
 	rc = (id < tq->tq_lowest_id);
 	spin_unlock_irqrestore(&tq->tq_lock, flags);
 
+	/*
+	 * Work-stealing queue entries have no task id, so conservatively
+	 * wait for all of them.
+	 */
+	if (rc && (tq->tq_flags & TASKQ_STEAL))
+		rc = taskq_steal_idle(tq);
+
 	return (rc);
 }
 
@@ -569,6 +684,9 @@ taskq_wait_check(taskq_t *tq)
 	rc = (tq->tq_lowest_id == tq->tq_next_id);
 	spin_unlock_irqrestore(&tq->tq_lock, flags);
 
+	if (rc && (tq->tq_flags & TASKQ_STEAL))
+		rc = taskq_steal_idle(tq);
+
 	return (rc);
 }
 
@@ -785,6 +903,57 @@ out:
 }
 EXPORT_SYMBOL(taskq_dispatch_delay);
 
+static void
+taskq_dispatch_steal(taskq_t *tq, task_func_t func, void *arg, uint_t flags,
+    taskq_ent_t *t)
+{
+	taskq_steal_queue_t *tqsq;
+	unsigned long irqflags;
+
+	/* Taskq being destroyed and all tasks drained */
+	if (!(READ_ONCE(tq->tq_flags) & TASKQ_ACTIVE)) {
+		t->tqent_id = TASKQID_INVALID;
+		return;
+	}
+
+	tqsq = &tq->tq_steal_queues[raw_smp_processor_id() %
+	    tq->tq_nsteal_queues];
+
+	spin_lock_irqsave(&tqsq->tqsq_lock, irqflags);
+	spin_lock(&t->tqent_lock);
+
+	ASSERT(taskq_empty_ent(t));
+	t->tqent_flags |= TQENT_FLAG_PREALLOC;
+
+	/* TQ_FRONT entries go to the head of the queue */
+	if (flags & TQ_FRONT) {
+		TQENT_SET_LIST(t, TQENT_LIST_PRIORITY);
+		list_add(&t->tqent_list, &tqsq->tqsq_list);
+	} else {
+		TQENT_SET_LIST(t, TQENT_LIST_PENDING);
+		list_add_tail(&t->tqent_list, &tqsq->tqsq_list);
+	}
+	TQSTAT_INC_LIST(tq, t);
+	TQSTAT_INC(tq, tasks_total);
+
+	t->tqent_id = TASKQID_INVALID;
+	t->tqent_func = func;
+	t->tqent_arg = arg;
+	t->tqent_taskq = tq;
+
+	t->tqent_birth = jiffies;
+	DTRACE_PROBE1(taskq_ent__birth, taskq_ent_t *, t);
+
+	spin_unlock(&t->tqent_lock);
+	spin_unlock_irqrestore(&tqsq->tqsq_lock, irqflags);
+
+	TQSTAT_INC(tq, tasks_dispatched);
+
+	/* Only wake a thread if one is idle, pairs with taskq_steal_queued() */
+	if (wq_has_sleeper(&tq->tq_work_waitq))
+		wake_up(&tq->tq_work_waitq);
+}
+
 void
 taskq_dispatch_ent(taskq_t *tq, task_func_t func, void *arg, uint_t flags,
     taskq_ent_t *t)
@@ -793,6 +962,11 @@ taskq_dispatch_ent(taskq_t *tq, task_func_t func, void *arg, uint_t flags,
 	ASSERT(tq);
 	ASSERT(func);
 
+	if ((tq->tq_flags & TASKQ_STEAL) && !(flags & TQ_NOQUEUE)) {
+		taskq_dispatch_steal(tq, func, arg, flags, t);
+		return;
+	}
+
 	spin_lock_irqsave_nested(&tq->tq_lock, irqflags,
 	    tq->tq_lock_class);
 
@@ -972,6 +1146,55 @@ taskq_thread_should_stop(taskq_t *tq, taskq_thread_t *tqt)
 	return (1);
 }
 
+/*
+ * Run work-stealing queue entries until none are left or the shared lists
+ * have work.  Called and returns with tq_lock held, which is dropped while
+ * the entries run.
+ */
+static void
+taskq_thread_steal(taskq_t *tq, taskq_thread_t *tqt, unsigned long *flags)
+{
+	taskq_ent_t dup_task = {};
+	taskq_ent_t *t;
+	boolean_t ran = B_FALSE;
+
+	spin_unlock_irqrestore(&tq->tq_lock, *flags);
+
+	while (!kthread_should_stop() && list_empty(&tq->tq_prio_list) &&
+	    list_empty(&tq->tq_pend_list) &&
+	    (t = taskq_steal_ent(tq, tqt, &dup_task)) != NULL) {
+		__set_current_state(TASK_RUNNING);
+		TQSTAT_DEC_LIST(tq, t);
+		TQSTAT_DEC(tq, tasks_total);
+
+		TQSTAT_INC(tq, threads_active);
+		DTRACE_PROBE1(taskq_ent__start, taskq_ent_t *, t);
+
+		/* Perform the requested task */
+		t->tqent_func(t->tqent_arg);
+
+		DTRACE_PROBE1(taskq_ent__finish, taskq_ent_t *, t);
+
+		TQSTAT_DEC(tq, threads_active);
+		if ((t->tqent_flags & TQENT_LIST_MASK) == TQENT_LIST_PENDING)
+			TQSTAT_INC(tq, tasks_executed_normal);
+		else
+			TQSTAT_INC(tq, tasks_executed_priority);
+		TQSTAT_INC(tq, tasks_executed);
+
+		/* Pairs with the READ_ONCE() in taskq_steal_idle() */
+		smp_store_release(&tqt->tqt_task, NULL);
+		if (wq_has_sleeper(&tq->tq_wait_waitq))
+			wake_up_all(&tq->tq_wait_waitq);
+		ran = B_TRUE;
+	}
+
+	if (ran)
+		set_current_state(TASK_INTERRUPTIBLE);
+
+	spin_lock_irqsave_nested(&tq->tq_lock, *flags, tq->tq_lock_class);
+}
+
 static int
 taskq_thread(void *args)
 {
@@ -1010,6 +1233,7 @@ taskq_thread(void *args)
 	if (tq->tq_nthreads >= tq->tq_maxthreads)
 		goto error;
 
+	tqt->tqt_steal_queue = tq->tq_nthreads;
 	tq->tq_nthreads++;
 	list_add_tail(&tqt->tqt_thread_list, &tq->tq_thread_list);
 	wake_up(&tq->tq_wait_waitq);
@@ -1019,6 +1243,12 @@ taskq_thread(void *args)
 
 	while (!kthread_should_stop()) {
 
+		if (tq->tq_flags & TASKQ_STEAL) {
+			taskq_thread_steal(tq, tqt, &flags);
+			if (kthread_should_stop())
+				break;
+		}
+
 		if (list_empty(&tq->tq_pend_list) &&
 		    list_empty(&tq->tq_prio_list)) {
 
@@ -1031,7 +1261,10 @@ taskq_thread(void *args)
 			TQSTAT_INC(tq, thread_sleeps);
 			TQSTAT_INC(tq, threads_idle);
 
-			schedule();
+			if (taskq_steal_queued(tq))
+				__set_current_state(TASK_RUNNING);
+			else
+				schedule();
 			seq_tasks = 0;
 
 			TQSTAT_DEC(tq, threads_idle);
@@ -1127,6 +1360,10 @@ taskq_thread(void *args)
 	tq->tq_nthreads--;
 	list_del_init(&tqt->tqt_thread_list);
 
+	/* Leave anything still on our queue to the remaining threads */
+	if (taskq_steal_queued(tq))
+		wake_up(&tq->tq_work_waitq);
+
 	TQSTAT_DEC(tq, threads_total);
 	TQSTAT_INC(tq, threads_destroyed);
 
@@ -1159,7 +1396,21 @@ taskq_thread_create(taskq_t *tq)
 		return (NULL);
 	}
 
-	if (spl_taskq_thread_bind) {
+	if (tq->tq_node != NUMA_NO_NODE) {
+		/*
+		 * Only binding to a single CPU is available to us, so spread
+		 * the threads of a NUMA-local taskq over the node's CPUs.
+		 */
+		const struct cpumask *mask = cpumask_of_node(tq->tq_node);
+		int cpu = cpumask_next_and(tq->tq_node_cpu, mask,
+		    cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first_and(mask, cpu_online_mask);
+		if (cpu < nr_cpu_ids) {
+			tq->tq_node_cpu = cpu;
+			kthread_bind(tqt->tqt_thread, cpu);
+		}
+	} else if (spl_taskq_thread_bind) {
 		last_used_cpu = (last_used_cpu + 1) % num_online_cpus();
 		kthread_bind(tqt->tqt_thread, last_used_cpu);
 	}
@@ -1195,6 +1446,7 @@ taskq_stats_init(taskq_t *tq)
 	wmsum_init(&tqs->tqs_tasks_executed, 0);
 	wmsum_init(&tqs->tqs_tasks_delayed_requeued, 0);
 	wmsum_init(&tqs->tqs_tasks_cancelled, 0);
+	wmsum_init(&tqs->tqs_tasks_stolen, 0);
 	wmsum_init(&tqs->tqs_thread_wakeups, 0);
 	wmsum_init(&tqs->tqs_thread_wakeups_nowork, 0);
 	wmsum_init(&tqs->tqs_thread_sleeps, 0);
@@ -1221,6 +1473,7 @@ taskq_stats_fini(taskq_t *tq)
 	wmsum_fini(&tqs->tqs_tasks_executed);
 	wmsum_fini(&tqs->tqs_tasks_delayed_requeued);
 	wmsum_fini(&tqs->tqs_tasks_cancelled);
+	wmsum_fini(&tqs->tqs_tasks_stolen);
 	wmsum_fini(&tqs->tqs_thread_wakeups);
 	wmsum_fini(&tqs->tqs_thread_wakeups_nowork);
 	wmsum_fini(&tqs->tqs_thread_sleeps);
@@ -1275,6 +1528,8 @@ taskq_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&tqs->tqs_tasks_delayed_requeued);
 	tqks->tqks_tasks_cancelled.value.ui64 =
 	    wmsum_value(&tqs->tqs_tasks_cancelled);
+	tqks->tqks_tasks_stolen.value.ui64 =
+	    wmsum_value(&tqs->tqs_tasks_stolen);
 	tqks->tqks_thread_wakeups.value.ui64 =
 	    wmsum_value(&tqs->tqs_thread_wakeups);
 	tqks->tqks_thread_wakeups_nowork.value.ui64 =
@@ -1319,9 +1574,9 @@ taskq_kstats_fini(taskq_t *tq)
 	tq->tq_ksp = NULL;
 }
 
-taskq_t *
-taskq_create(const char *name, int threads_arg, pri_t pri,
-    int minalloc, int maxalloc, uint_t flags)
+static taskq_t *
+taskq_create_impl(const char *name, int threads_arg, pri_t pri,
+    int minalloc, int maxalloc, uint_t flags, int node)
 {
 	taskq_t *tq;
 	taskq_thread_t *tqt;
@@ -1347,6 +1602,8 @@ taskq_create(const char *name, int threads_arg, pri_t pri,
 		return (NULL);
 
 	tq->tq_hp_support = B_FALSE;
+	tq->tq_node = node;
+	tq->tq_node_cpu = -1;
 
 	if (flags & TASKQ_THREADS_CPU_PCT) {
 		tq->tq_hp_support = B_TRUE;
@@ -1382,8 +1639,26 @@ taskq_create(const char *name, int threads_arg, pri_t pri,
 	init_waitqueue_head(&tq->tq_wait_waitq);
 	tq->tq_lock_class = TQ_LOCK_GENERAL;
 	INIT_LIST_HEAD(&tq->tq_taskqs);
+	tq->tq_steal_queues = NULL;
+	tq->tq_nsteal_queues = 0;
 	taskq_stats_init(tq);
 
+	/*
+	 * Work-stealing taskqs get one queue per thread, and run all of
+	 * their threads for their lifetime since an idle thread is what
+	 * picks up work queued behind a busy one.
+	 */
+	if (flags & TASKQ_STEAL) {
+		tq->tq_flags &= ~TASKQ_DYNAMIC;
+		tq->tq_nsteal_queues = nthreads;
+		tq->tq_steal_queues = kmem_alloc(nthreads *
+		    sizeof (taskq_steal_queue_t), KM_PUSHPAGE);
+		for (i = 0; i < nthreads; i++) {
+			spin_lock_init(&tq->tq_steal_queues[i].tqsq_lock);
+			INIT_LIST_HEAD(&tq->tq_steal_queues[i].tqsq_list);
+		}
+	}
+
 	if (flags & TASKQ_PREPOPULATE) {
 		spin_lock_irqsave_nested(&tq->tq_lock, irqflags,
 		    tq->tq_lock_class);
@@ -1395,7 +1670,7 @@ taskq_create(const char *name, int threads_arg, pri_t pri,
 		spin_unlock_irqrestore(&tq->tq_lock, irqflags);
 	}
 
-	if ((flags & TASKQ_DYNAMIC) && spl_taskq_thread_dynamic)
+	if ((tq->tq_flags & TASKQ_DYNAMIC) && spl_taskq_thread_dynamic)
 		nthreads = 1;
 
 	for (i = 0; i < nthreads; i++) {
@@ -1429,8 +1704,31 @@ taskq_create(const char *name, int threads_arg, pri_t pri,
 
 	return (tq);
 }
+
+taskq_t *
+taskq_create(const char *name, int threads_arg, pri_t pri,
+    int minalloc, int maxalloc, uint_t flags)
+{
+	return (taskq_create_impl(name, threads_arg, pri, minalloc, maxalloc,
+	    flags, NUMA_NO_NODE));
+}
 EXPORT_SYMBOL(taskq_create);
 
+/*
+ * Create a taskq whose threads only run on the CPUs of the given NUMA node.
+ * Falls back to an unbound taskq if the node has no online CPUs.
+ */
+taskq_t *
+taskq_create_node(const char *name, int threads_arg, pri_t pri,
+    int minalloc, int maxalloc, uint_t flags, int node)
+{
+	ASSERT(node == NUMA_NO_NODE || (node >= 0 && node < nr_node_ids));
+
+	return (taskq_create_impl(name, threads_arg, pri, minalloc, maxalloc,
+	    flags, node));
+}
+EXPORT_SYMBOL(taskq_create_node);
+
 void
 taskq_destroy(taskq_t *tq)
 {
@@ -1513,6 +1811,13 @@ taskq_destroy(taskq_t *tq)
 
 	spin_unlock_irqrestore(&tq->tq_lock, flags);
 
+	if (tq->tq_steal_queues != NULL) {
+		for (int i = 0; i < tq->tq_nsteal_queues; i++)
+			ASSERT(list_empty(&tq->tq_steal_queues[i].tqsq_list));
+		kmem_free(tq->tq_steal_queues,
+		    tq->tq_nsteal_queues * sizeof (taskq_steal_queue_t));
+	}
+
 	taskq_stats_fini(tq);
 	kmem_strfree(tq->tq_name);
 	kmem_free(tq, sizeof (taskq_t));
@@ -70,6 +70,9 @@
 #define	ABD_MAX_ORDER	(MAX_PAGE_ORDER)
 #endif
 
+/* Order of a 2 MiB chunk, the size of a huge page on most platforms */
+#define	ABD_HUGE_ORDER	(MIN(21 - PAGE_SHIFT, ABD_MAX_ORDER - 1))
+
 typedef struct abd_stats {
 	kstat_named_t abdstat_struct_size;
 	kstat_named_t abdstat_linear_cnt;
@@ -82,6 +85,9 @@ typedef struct abd_stats {
 	kstat_named_t abdstat_scatter_page_multi_zone;
 	kstat_named_t abdstat_scatter_page_alloc_retry;
 	kstat_named_t abdstat_scatter_sg_table_retry;
+	kstat_named_t abdstat_scatter_page_huge_fail;
+	kstat_named_t abdstat_scatter_page_pool_hit;
+	kstat_named_t abdstat_scatter_page_pool_size;
 } abd_stats_t;
 
 static abd_stats_t abd_stats = {
@@ -136,6 +142,18 @@ static abd_stats_t abd_stats = {
 	 *  allocate the sg table for an ABD.
 	 */
 	{ "scatter_sg_table_retry",		KSTAT_DATA_UINT64 },
+	/*
+	 *  The number of times a huge chunk could not be allocated even
+	 *  after compaction, see zfs_abd_scatter_huge_pages.
+	 */
+	{ "scatter_page_huge_fail",		KSTAT_DATA_UINT64 },
+	/*
+	 *  The number of chunks taken from the per-CPU page pools instead
+	 *  of the page allocator, see zfs_abd_page_pool_max.
+	 */
+	{ "scatter_page_pool_hit",		KSTAT_DATA_UINT64 },
+	/* Amount of memory held by the per-CPU page pools */
+	{ "scatter_page_pool_size",		KSTAT_DATA_UINT64 },
 };
 
 static struct {
@@ -150,6 +168,9 @@ static struct {
 	wmsum_t abdstat_scatter_page_multi_zone;
 	wmsum_t abdstat_scatter_page_alloc_retry;
 	wmsum_t abdstat_scatter_sg_table_retry;
+	wmsum_t abdstat_scatter_page_huge_fail;
+	wmsum_t abdstat_scatter_page_pool_hit;
+	wmsum_t abdstat_scatter_page_pool_size;
 } abd_sums;
 
 #define	abd_for_each_sg(abd, sg, n, i)	\
@@ -228,6 +249,20 @@ abd_free_struct_impl(abd_t *abd)
 
 static unsigned zfs_abd_scatter_max_order = ABD_MAX_ORDER - 1;
 
+/*
+ * Scatter ABDs are normally built from whatever chunks can be had without
+ * any reclaim or compaction, which on a fragmented system means order-0 or
+ * small compound pages and thousands of scatterlist entries for a 16M
+ * record.  When zfs_abd_scatter_huge_pages is set, ABDs of at least 2 MiB
+ * let the page allocator do a light compaction for each 2 MiB chunk before
+ * falling back to smaller ones.  After such an attempt fails, memory is
+ * considered too fragmented and no compaction is asked for during the next
+ * zfs_abd_scatter_huge_backoff_ms milliseconds.
+ */
+static int zfs_abd_scatter_huge_pages = 0;
+static uint_t zfs_abd_scatter_huge_backoff_ms = 1000;
+static unsigned long abd_huge_retry_time = 0;
+
 /*
  * Mark zfs data pages so they can be excluded from kernel crash dumps
  */
@@ -254,6 +289,154 @@ abd_unmark_zfs_page(struct page *page)
 #define	abd_unmark_zfs_page(page)
 #endif /* _LP64 */
 
+/*
+ * Under steady streaming the ARC evicts buffers and new reads allocate
+ * the same amount of memory right after, so the pages of freed scatter
+ * ABDs are handed back and forth with the page allocator.  The per-CPU
+ * page pools keep freed chunks, by order, for the next abd_alloc_chunks()
+ * on that CPU instead.
+ *
+ * A pool holds at most zfs_abd_page_pool_max bytes, 0 disables the pools.
+ * Within that its limit grows by a chunk each time an allocation finds no
+ * chunk of the order it needs, so the pool only keeps as much as is being
+ * reallocated, and halves each time the ARC reaps its caches or the ARC
+ * shrinker runs, which also returns the chunks above the new limit.
+ */
+static unsigned long zfs_abd_page_pool_max = 0;
+
+typedef struct abd_page_pool {
+	spinlock_t		pp_lock;
+	size_t			pp_size;
+	size_t			pp_limit;
+	struct list_head	pp_pages[ABD_MAX_ORDER];
+} ____cacheline_aligned abd_page_pool_t;
+
+static abd_page_pool_t *abd_page_pools = NULL;
+
+static void
+abd_page_pool_init(void)
+{
+	abd_page_pools = kmem_zalloc(max_ncpus * sizeof (abd_page_pool_t),
+	    KM_SLEEP);
+
+	for (int c = 0; c < max_ncpus; c++) {
+		abd_page_pool_t *pp = &abd_page_pools[c];
+
+		spin_lock_init(&pp->pp_lock);
+		for (int i = 0; i < ABD_MAX_ORDER; i++)
+			INIT_LIST_HEAD(&pp->pp_pages[i]);
+	}
+}
+
+/*
+ * Take a chunk of the given order from the current CPU's pool, or return
+ * NULL if there is none.
+ */
+static struct page *
+abd_page_pool_get(unsigned int order)
+{
+	abd_page_pool_t *pp = &abd_page_pools[CPU_SEQID_UNSTABLE];
+	size_t size = PAGESIZE << order;
+	struct page *page;
+
+	if (zfs_abd_page_pool_max == 0 && READ_ONCE(pp->pp_size) == 0)
+		return (NULL);
+
+	spin_lock(&pp->pp_lock);
+	page = list_first_entry_or_null(&pp->pp_pages[order], struct page,
+	    lru);
+	if (page != NULL) {
+		list_del(&page->lru);
+		pp->pp_size -= size;
+	} else {
+		pp->pp_limit = MIN(pp->pp_limit + size,
+		    zfs_abd_page_pool_max);
+	}
+	spin_unlock(&pp->pp_lock);
+
+	if (page != NULL) {
+		ABDSTAT_BUMP(abdstat_scatter_page_pool_hit);
+		ABDSTAT_INCR(abdstat_scatter_page_pool_size, -(int64_t)size);
+	}
+
+	return (page);
+}
+
+/*
+ * Keep a freed chunk in the current CPU's pool if it has room for it.
+ */
+static boolean_t
+abd_page_pool_put(struct page *page, unsigned int order)
+{
+	abd_page_pool_t *pp = &abd_page_pools[CPU_SEQID_UNSTABLE];
+	size_t size = PAGESIZE << order;
+	boolean_t kept = B_FALSE;
+
+	if (zfs_abd_page_pool_max == 0 || order >= ABD_MAX_ORDER)
+		return (B_FALSE);
+
+	spin_lock(&pp->pp_lock);
+	if (pp->pp_size + size <= MIN(pp->pp_limit, zfs_abd_page_pool_max)) {
+		list_add(&page->lru, &pp->pp_pages[order]);
+		pp->pp_size += size;
+		kept = B_TRUE;
+	}
+	spin_unlock(&pp->pp_lock);
+
+	if (kept)
+		ABDSTAT_INCR(abdstat_scatter_page_pool_size, size);
+
+	return (kept);
+}
+
+/*
+ * Halve the limit of every pool, or drop it to zero when all is set, and
+ * return the chunks above it to the page allocator.  The largest chunks
+ * go first, they are the most valuable to the rest of the system.
+ */
+static void
+abd_page_pool_reap(boolean_t all)
+{
+	for (int c = 0; c < max_ncpus; c++) {
+		abd_page_pool_t *pp = &abd_page_pools[c];
+		struct page *page, *tmp_page;
+		LIST_HEAD(pages);
+		size_t freed = 0;
+
+		if (READ_ONCE(pp->pp_size) == 0 &&
+		    READ_ONCE(pp->pp_limit) == 0)
+			continue;
+
+		spin_lock(&pp->pp_lock);
+		pp->pp_limit = all ? 0 : pp->pp_limit / 2;
+		for (int i = ABD_MAX_ORDER - 1; i >= 0; i--) {
+			while (pp->pp_size > pp->pp_limit &&
+			    !list_empty(&pp->pp_pages[i])) {
+				page = list_first_entry(&pp->pp_pages[i],
+				    struct page, lru);
+				list_move(&page->lru, &pages);
+				pp->pp_size -= PAGESIZE << i;
+			}
+		}
+		spin_unlock(&pp->pp_lock);
+
+		list_for_each_entry_safe(page, tmp_page, &pages, lru) {
+			list_del(&page->lru);
+			freed += PAGESIZE << compound_order(page);
+			__free_pages(page, compound_order(page));
+		}
+		ABDSTAT_INCR(abdstat_scatter_page_pool_size, -(int64_t)freed);
+	}
+}
+
+static void
+abd_page_pool_fini(void)
+{
+	abd_page_pool_reap(B_TRUE);
+	kmem_free(abd_page_pools, max_ncpus * sizeof (abd_page_pool_t));
+	abd_page_pools = NULL;
+}
+
 #ifndef CONFIG_HIGHMEM
 
 #ifndef __GFP_RECLAIM
@@ -279,10 +462,14 @@ abd_alloc_chunks(abd_t *abd, size_t size)
 	unsigned int max_order = MIN(zfs_abd_scatter_max_order,
 	    ABD_MAX_ORDER - 1);
 	unsigned int nr_pages = abd_chunkcnt_for_bytes(size);
+	gfp_t gfp_huge = gfp | __GFP_NORETRY | __GFP_COMP;
 	unsigned int chunks = 0, zones = 0;
 	size_t remaining_size;
 	int nid = NUMA_NO_NODE;
 	unsigned int alloc_pages = 0;
+	boolean_t huge = zfs_abd_scatter_huge_pages &&
+	    nr_pages >= (1U << ABD_HUGE_ORDER) &&
+	    time_after_eq(jiffies, READ_ONCE(abd_huge_retry_time));
 
 	INIT_LIST_HEAD(&pages);
 
@@ -295,7 +482,21 @@ abd_alloc_chunks(abd_t *abd, size_t size)
 		order = MIN(highbit64(nr_pages - alloc_pages) - 1, max_order);
 		chunk_pages = (1U << order);
 
-		page = alloc_pages_node(nid, order ? gfp_comp : gfp, order);
+		page = abd_page_pool_get(order);
+		if (page == NULL)
+			page = alloc_pages_node(nid, order ? gfp_comp : gfp,
+			    order);
+		if (page == NULL && huge && order == ABD_HUGE_ORDER) {
+			/* Allow compaction to assemble a huge chunk */
+			page = alloc_pages_node(nid, gfp_huge, order);
+			if (page == NULL) {
+				ABDSTAT_BUMP(abdstat_scatter_page_huge_fail);
+				WRITE_ONCE(abd_huge_retry_time, jiffies +
+				    msecs_to_jiffies(
+				    zfs_abd_scatter_huge_backoff_ms));
+				huge = B_FALSE;
+			}
+		}
 		if (page == NULL) {
 			if (order == 0) {
 				ABDSTAT_BUMP(abdstat_scatter_page_alloc_retry);
@@ -410,7 +611,9 @@ abd_alloc_chunks(abd_t *abd, size_t size)
 	ABD_SCATTER(abd).abd_nents = nr_pages;
 
 	abd_for_each_sg(abd, sg, nr_pages, i) {
-		while ((page = __page_cache_alloc(gfp)) == NULL) {
+		page = abd_page_pool_get(0);
+		while (page == NULL &&
+		    (page = __page_cache_alloc(gfp)) == NULL) {
 			ABDSTAT_BUMP(abdstat_scatter_page_alloc_retry);
 			schedule_timeout_interruptible(1);
 		}
@@ -464,8 +667,9 @@ abd_free_chunks(abd_t *abd)
 			page = sg_page(sg);
 			abd_unmark_zfs_page(page);
 			order = compound_order(page);
-			__free_pages(page, order);
 			ASSERT3U(sg->length, <=, PAGE_SIZE << order);
+			if (!abd_page_pool_put(page, order))
+				__free_pages(page, order);
 			ABDSTAT_BUMPDOWN(abdstat_scatter_orders[order]);
 		}
 	}
@@ -623,6 +827,12 @@ abd_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&abd_sums.abdstat_scatter_page_alloc_retry);
 	as->abdstat_scatter_sg_table_retry.value.ui64 =
 	    wmsum_value(&abd_sums.abdstat_scatter_sg_table_retry);
+	as->abdstat_scatter_page_huge_fail.value.ui64 =
+	    wmsum_value(&abd_sums.abdstat_scatter_page_huge_fail);
+	as->abdstat_scatter_page_pool_hit.value.ui64 =
+	    wmsum_value(&abd_sums.abdstat_scatter_page_pool_hit);
+	as->abdstat_scatter_page_pool_size.value.ui64 =
+	    wmsum_value(&abd_sums.abdstat_scatter_page_pool_size);
 	return (0);
 }
 
@@ -646,6 +856,9 @@ abd_init(void)
 	wmsum_init(&abd_sums.abdstat_scatter_page_multi_zone, 0);
 	wmsum_init(&abd_sums.abdstat_scatter_page_alloc_retry, 0);
 	wmsum_init(&abd_sums.abdstat_scatter_sg_table_retry, 0);
+	wmsum_init(&abd_sums.abdstat_scatter_page_huge_fail, 0);
+	wmsum_init(&abd_sums.abdstat_scatter_page_pool_hit, 0);
+	wmsum_init(&abd_sums.abdstat_scatter_page_pool_size, 0);
 
 	abd_ksp = kstat_create("zfs", 0, "abdstats", "misc", KSTAT_TYPE_NAMED,
 	    sizeof (abd_stats) / sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
@@ -662,11 +875,13 @@ abd_init(void)
 	}
 
 	abd_alloc_zero_scatter();
+	abd_page_pool_init();
 }
 
 void
 abd_fini(void)
 {
+	abd_page_pool_fini();
 	abd_free_zero_scatter();
 
 	if (abd_ksp != NULL) {
@@ -686,6 +901,9 @@ abd_fini(void)
 	wmsum_fini(&abd_sums.abdstat_scatter_page_multi_zone);
 	wmsum_fini(&abd_sums.abdstat_scatter_page_alloc_retry);
 	wmsum_fini(&abd_sums.abdstat_scatter_sg_table_retry);
+	wmsum_fini(&abd_sums.abdstat_scatter_page_huge_fail);
+	wmsum_fini(&abd_sums.abdstat_scatter_page_pool_hit);
+	wmsum_fini(&abd_sums.abdstat_scatter_page_pool_size);
 
 	if (abd_cache) {
 		kmem_cache_destroy(abd_cache);
@@ -891,6 +1109,33 @@ abd_iter_advance(struct abd_iter *aiter, size_t amount)
 	}
 }
 
+#ifndef CONFIG_HIGHMEM
+/*
+ * Without highmem every page is permanently mapped, and chunks which are
+ * physically adjacent are adjacent in the kernel's address space too. The
+ * page allocator often hands out consecutive chunks that way, so extend the
+ * mapping of the current chunk over the following ones for as long as they
+ * continue it. Callbacks of abd_iterate_func(), abd_iterate_func2() and the
+ * raidz iterators then get fewer and longer spans to work on.
+ */
+static size_t
+abd_iter_contig_size(struct abd_iter *aiter, char *paddr)
+{
+	struct scatterlist *sg = aiter->iter_sg;
+	size_t left = aiter->iter_abd->abd_size - aiter->iter_pos;
+	size_t size = sg->length - aiter->iter_offset;
+	char *end = paddr + sg->length;
+
+	while (size < left && (sg = sg_next(sg)) != NULL &&
+	    page_address(sg_page(sg)) == end) {
+		size += sg->length;
+		end += sg->length;
+	}
+
+	return (MIN(size, left));
+}
+#endif
+
 /*
  * Map the current chunk into aiter. This can be safely called when the aiter
  * has already exhausted, in which case this does nothing.
@@ -919,6 +1164,9 @@ abd_iter_map(struct abd_iter *aiter)
 		    aiter->iter_abd->abd_size - aiter->iter_pos);
 
 		paddr = zfs_kmap_local(sg_page(aiter->iter_sg));
+#ifndef CONFIG_HIGHMEM
+		aiter->iter_mapsize = abd_iter_contig_size(aiter, paddr);
+#endif
 	}
 
 	aiter->iter_mapaddr = (char *)paddr + offset;
@@ -950,6 +1198,35 @@ abd_iter_unmap(struct abd_iter *aiter)
 void
 abd_cache_reap_now(void)
 {
+	abd_page_pool_reap(B_FALSE);
+}
+
+/*
+ * Return the NUMA node holding the first page of an ABD, or -1 if it
+ * cannot be determined.
+ */
+int
+abd_numa_node(abd_t *abd)
+{
+	struct page *page;
+
+	if (abd_is_gang(abd)) {
+		abd_t *cabd = list_head(&ABD_GANG(abd).abd_gang_chain);
+		return (cabd != NULL ? abd_numa_node(cabd) : -1);
+	}
+
+	if (abd_is_linear(abd)) {
+		void *buf = ABD_LINEAR_BUF(abd);
+
+		if (buf == NULL)
+			return (-1);
+		page = is_vmalloc_addr(buf) ?
+		    vmalloc_to_page(buf) : virt_to_page(buf);
+	} else {
+		page = sg_page(ABD_SCATTER(abd).abd_sgl);
+	}
+
+	return (page != NULL ? page_to_nid(page) : -1);
 }
 
 /*
@@ -1352,3 +1629,12 @@ MODULE_PARM_DESC(zfs_abd_scatter_min_size,
 module_param(zfs_abd_scatter_max_order, uint, 0644);
 MODULE_PARM_DESC(zfs_abd_scatter_max_order,
 	"Maximum order allocation used for a scatter ABD.");
+module_param(zfs_abd_page_pool_max, ulong, 0644);
+MODULE_PARM_DESC(zfs_abd_page_pool_max,
+	"Maximum bytes of freed ABD chunks kept per CPU for reuse.");
+module_param(zfs_abd_scatter_huge_pages, int, 0644);
+MODULE_PARM_DESC(zfs_abd_scatter_huge_pages,
+	"Compact memory for 2 MiB chunks of large scatter ABDs.");
+module_param(zfs_abd_scatter_huge_backoff_ms, uint, 0644);
+MODULE_PARM_DESC(zfs_abd_scatter_huge_backoff_ms,
+	"Time without compaction for ABDs after a failed attempt.");
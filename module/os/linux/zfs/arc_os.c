@@ -216,6 +216,9 @@ arc_shrinker_scan(struct shrinker *shrink, struct shrink_control *sc)
 	 */
 	arc_no_grow = B_TRUE;
 
+	/* Give the pages held for recycling back first */
+	abd_cache_reap_now();
+
 	/*
 	 * Evict the requested number of pages by reducing arc_c and waiting
 	 * for the requested amount of data to be evicted.  To avoid deadlock
@@ -23,6 +23,7 @@
 #if defined(_KERNEL) && defined(HAVE_QAT)
 #include <sys/zfs_context.h>
 #include <sys/qat.h>
+#include <sys/zio_offload.h>
 
 qat_stats_t qat_stats = {
 	{ "comp_requests",			KSTAT_DATA_UINT64 },
@@ -64,6 +65,70 @@ qat_mem_free_contig(void **pp_mem_addr)
 	}
 }
 
+static boolean_t
+qat_offload_usable(zio_offload_op_t op, uint64_t alg, size_t len)
+{
+	switch (op) {
+	case ZIO_OFFLOAD_COMPRESS:
+	case ZIO_OFFLOAD_DECOMPRESS:
+		return (alg >= ZIO_COMPRESS_GZIP_1 &&
+		    alg <= ZIO_COMPRESS_GZIP_9 && qat_dc_use_accel(len));
+	case ZIO_OFFLOAD_CHECKSUM:
+		return (alg == ZIO_CHECKSUM_SHA256 &&
+		    qat_checksum_use_accel(len));
+	case ZIO_OFFLOAD_ENCRYPT:
+	case ZIO_OFFLOAD_DECRYPT:
+		return (qat_crypt_use_accel(len));
+	default:
+		return (B_FALSE);
+	}
+}
+
+static int
+qat_offload_compress(zio_offload_op_t op, enum zio_compress alg, int level,
+    void *src, size_t s_len, void *dst, size_t d_len, size_t *c_len)
+{
+	(void) alg, (void) level;
+	int ret;
+
+	ret = qat_compress(op == ZIO_OFFLOAD_COMPRESS ? QAT_COMPRESS :
+	    QAT_DECOMPRESS, src, s_len, dst, d_len, c_len);
+	if (ret == CPA_STATUS_SUCCESS)
+		return (0);
+	if (ret == CPA_STATUS_INCOMPRESSIBLE)
+		return (SET_ERROR(E2BIG));
+	return (SET_ERROR(EIO));
+}
+
+static int
+qat_offload_checksum(enum zio_checksum alg, void *buf, size_t size,
+    zio_cksum_t *zcp)
+{
+	if (qat_checksum(alg, buf, size, zcp) != CPA_STATUS_SUCCESS)
+		return (SET_ERROR(EIO));
+	return (0);
+}
+
+static int
+qat_offload_crypt(zio_offload_op_t op, uint64_t crypt, crypto_key_t *key,
+    uint8_t *src, uint8_t *dst, uint8_t *aad, uint_t aad_len, uint8_t *iv,
+    uint8_t *digest, uint_t len)
+{
+	if (qat_crypt(op == ZIO_OFFLOAD_ENCRYPT ? QAT_ENCRYPT : QAT_DECRYPT,
+	    src, dst, aad, aad_len, iv, digest, key, crypt, len) !=
+	    CPA_STATUS_SUCCESS)
+		return (SET_ERROR(EIO));
+	return (0);
+}
+
+static const zio_offload_provider_t qat_offload_provider = {
+	.zop_name = "qat",
+	.zop_usable = qat_offload_usable,
+	.zop_compress = qat_offload_compress,
+	.zop_checksum = qat_offload_checksum,
+	.zop_crypt = qat_offload_crypt,
+};
+
 int
 qat_init(void)
 {
@@ -88,12 +153,16 @@ qat_init(void)
 		zfs_qat_encrypt_disable = 1;
 	}
 
+	VERIFY0(zio_offload_register(&qat_offload_provider));
+
 	return (0);
 }
 
 void
 qat_fini(void)
 {
+	zio_offload_unregister(&qat_offload_provider);
+
 	if (qat_ksp != NULL) {
 		kstat_delete(qat_ksp);
 		qat_ksp = NULL;
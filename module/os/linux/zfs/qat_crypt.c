@@ -163,7 +163,7 @@ qat_init_crypt_session_ctx(qat_encrypt_dir_t dir, CpaInstanceHandle inst_handle,
 	Cpa32U hash_algorithm;
 	CpaCySymSessionSetupData sd = { 0 };
 
-	if (zio_crypt_table[crypt].ci_crypt_type == ZC_TYPE_CCM) {
+	if (zio_crypt_table[crypt].ci_crypt_type != ZC_TYPE_GCM) {
 		return (CPA_STATUS_FAIL);
 	} else {
 		ciper_algorithm = CPA_CY_SYM_CIPHER_AES_GCM;
@@ -331,7 +331,7 @@ qat_crypt(qat_encrypt_dir_t dir, uint8_t *src_buf, uint8_t *dst_buf,
 	status = qat_init_crypt_session_ctx(dir, cy_inst_handle,
 	    &cy_session_ctx, key, crypt, aad_len);
 	if (status != CPA_STATUS_SUCCESS) {
-		/* don't count CCM as a failure since it's not supported */
+		/* only GCM is supported, don't count the others as failures */
 		if (zio_crypt_table[crypt].ci_crypt_type == ZC_TYPE_GCM)
 			QAT_STAT_BUMP(crypt_fails);
 		return (status);
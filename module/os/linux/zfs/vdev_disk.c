@@ -83,6 +83,15 @@ typedef struct vdev_disk {
  */
 uint_t zfs_vdev_disk_max_segs = 0;
 
+/*
+ * If set, sync reads and sync writes are submitted as polled BIOs and the
+ * issuing thread spins on the device completion queue instead of waiting
+ * for an interrupt. This only has an effect on devices with poll queues
+ * configured (eg nvme.poll_queues), and only with the new BIO submission
+ * method.
+ */
+static uint_t zfs_vdev_disk_poll = 0;
+
 /*
  * Unique identifier for the exclusive vdev holder.
  */
@@ -426,6 +435,17 @@ vdev_disk_open(vdev_t *v, uint64_t *psize, uint64_t *max_psize,
 
 	struct block_device *bdev = BDH_BDEV(vd->vd_bdh);
 
+	/*
+	 * The allocator writes anywhere in a metaslab and rewrites the
+	 * labels in place, which a host-managed zoned device rejects.
+	 * Refuse it here rather than fault it on the first write.
+	 */
+	if (bdev_is_host_managed(bdev)) {
+		v->vdev_stat.vs_aux = VDEV_AUX_OPEN_FAILED;
+		vdev_dbgmsg(v, "host-managed zoned devices are not supported");
+		return (SET_ERROR(ENOTSUP));
+	}
+
 	/*  Determine the physical block size */
 	int physical_block_size = bdev_physical_block_size(bdev);
 
@@ -440,10 +460,15 @@ vdev_disk_open(vdev_t *v, uint64_t *psize, uint64_t *max_psize,
 
 	/* Set when device reports it supports TRIM. */
 	v->vdev_has_trim = bdev_discard_supported(bdev);
+	v->vdev_trim_granularity = bdev_discard_granularity_bytes(bdev);
+	v->vdev_trim_max_bytes = bdev_max_discard_bytes(bdev);
 
 	/* Set when device reports it supports secure TRIM. */
 	v->vdev_has_securetrim = bdev_secure_discard_supported(bdev);
 
+	/* Set when device can zero ranges without a data transfer. */
+	v->vdev_has_write_zeroes = bdev_write_zeroes_sectors(bdev) != 0;
+
 	/* Inform the ZIO pipeline that we are non-rotational */
 	v->vdev_nonrot = blk_queue_nonrot(bdev_get_queue(bdev));
 
@@ -667,8 +692,22 @@ typedef struct {
 
 	struct bio	*vbio_bio;	/* pointer to the current bio */
 	int		vbio_flags;	/* bio flags */
+
+	boolean_t	vbio_polled;	/* completion is polled for */
+	atomic_t	vbio_poll_state; /* VBIO_POLL_* */
 } vbio_t;
 
+/*
+ * Polled completion handoff. Whichever of the submitter and the completion
+ * callback moves vbio_poll_state away from VBIO_POLL_ACTIVE first decides
+ * who returns the zio: if the callback gets there first, it leaves the zio
+ * for the still-polling submitter; if the submitter stops polling first,
+ * the callback completes the zio as usual.
+ */
+#define	VBIO_POLL_DETACHED	0
+#define	VBIO_POLL_ACTIVE	1
+#define	VBIO_POLL_COMPLETE	2
+
 static vbio_t *
 vbio_alloc(zio_t *zio, struct block_device *bdev, int flags)
 {
@@ -683,6 +722,8 @@ vbio_alloc(zio_t *zio, struct block_device *bdev, int flags)
 	vbio->vbio_offset = zio->io_offset;
 	vbio->vbio_bio = NULL;
 	vbio->vbio_flags = flags;
+	vbio->vbio_polled = B_FALSE;
+	atomic_set(&vbio->vbio_poll_state, VBIO_POLL_DETACHED);
 
 	return (vbio);
 }
@@ -771,6 +812,23 @@ vbio_submit(vbio_t *vbio, abd_t *abd, uint64_t size)
 	vbio->vbio_bio->bi_end_io = vbio_completion;
 	vbio->vbio_bio->bi_private = vbio;
 
+#ifdef HAVE_BIO_POLL
+	/*
+	 * Only the final BIO is polled; any earlier ones in the chain were
+	 * already submitted from vbio_add_page() and will complete through
+	 * their interrupt queue. We take an extra reference so that the BIO
+	 * remains valid to poll on after vbio_completion() has released it.
+	 */
+	zio_t *zio = vbio->vbio_zio;
+	struct bio *bio = vbio->vbio_bio;
+	if (vbio->vbio_polled) {
+		bio->bi_opf |= REQ_POLLED;
+		atomic_set(&vbio->vbio_poll_state, VBIO_POLL_ACTIVE);
+		bio_get(bio);
+	}
+	const boolean_t polled = vbio->vbio_polled;
+#endif
+
 	/*
 	 * Once submitted, vbio_bio now owns vbio (through bi_private) and we
 	 * can't touch it again. The bio may complete and vbio_completion() be
@@ -780,6 +838,31 @@ vbio_submit(vbio_t *vbio, abd_t *abd, uint64_t size)
 	vdev_submit_bio(vbio->vbio_bio);
 
 	blk_finish_plug(&plug);
+
+#ifdef HAVE_BIO_POLL
+	if (!polled)
+		return;
+
+	/*
+	 * While we hold vbio_poll_state at VBIO_POLL_ACTIVE the zio has not
+	 * been returned, so the vbio is still valid. If the block layer
+	 * cleared REQ_POLLED (the queue has no poll support) stop polling and
+	 * let the interrupt path finish the zio.
+	 */
+	while (atomic_read(&vbio->vbio_poll_state) == VBIO_POLL_ACTIVE) {
+		if (!(bio->bi_opf & REQ_POLLED) &&
+		    atomic_cmpxchg(&vbio->vbio_poll_state, VBIO_POLL_ACTIVE,
+		    VBIO_POLL_DETACHED) == VBIO_POLL_ACTIVE) {
+			bio_put(bio);
+			return;
+		}
+		if (bio_poll(bio, NULL, BLK_POLL_ONESHOT) == 0)
+			cond_resched();
+	}
+
+	bio_put(bio);
+	zio_delay_interrupt(zio);
+#endif
 }
 
 /* IO completion callback */
@@ -809,6 +892,12 @@ vbio_completion(struct bio *bio)
 	ASSERT3P(zio->io_bio, ==, NULL);
 	zio->io_bio = vbio;
 
+	/* The submitter is polling for us, and will return the zio itself */
+	if (vbio->vbio_polled &&
+	    atomic_cmpxchg(&vbio->vbio_poll_state, VBIO_POLL_ACTIVE,
+	    VBIO_POLL_COMPLETE) == VBIO_POLL_ACTIVE)
+		return;
+
 	zio_delay_interrupt(zio);
 }
 
@@ -961,6 +1050,13 @@ vdev_disk_io_rw(zio_t *zio)
 	if (abd != zio->io_abd)
 		vbio->vbio_abd = abd;
 
+#ifdef HAVE_BIO_POLL
+	/* Poll for completion of latency-sensitive IO if requested */
+	if (zfs_vdev_disk_poll && (zio->io_priority == ZIO_PRIORITY_SYNC_READ ||
+	    zio->io_priority == ZIO_PRIORITY_SYNC_WRITE))
+		vbio->vbio_polled = B_TRUE;
+#endif
+
 	/* Fill it with data pages and submit it to the kernel */
 	vbio_submit(vbio, abd, zio->io_size);
 	return (0);
@@ -1298,9 +1394,23 @@ vdev_bdev_issue_discard(zfs_bdev_handle_t *bdh, sector_t sector,
 }
 
 /*
- * Entry point for TRIM ops. This calls the right wrapper for secure erase or
- * discard, and then does the appropriate finishing work for error vs success
- * and async vs sync.
+ * Zero a range with REQ_OP_WRITE_ZEROES.  The device must keep the range
+ * allocated, and the kernel must not fall back to writing zero pages.
+ */
+static int
+vdev_bdev_issue_write_zeroes(zfs_bdev_handle_t *bdh, sector_t sector,
+    sector_t nsect, struct bio **biop)
+{
+	*biop = NULL;
+
+	return (__blkdev_issue_zeroout(BDH_BDEV(bdh), sector, nsect, GFP_NOFS,
+	    biop, BLKDEV_ZERO_NOUNMAP | BLKDEV_ZERO_NOFALLBACK));
+}
+
+/*
+ * Entry point for TRIM ops. This calls the right wrapper for write zeroes,
+ * secure erase or discard, and then does the appropriate finishing work for
+ * error vs success and async vs sync.
  */
 static int
 vdev_disk_io_trim(zio_t *zio)
@@ -1312,7 +1422,9 @@ vdev_disk_io_trim(zio_t *zio)
 	sector_t sector = zio->io_offset >> 9;
 	sector_t nsects = zio->io_size >> 9;
 
-	if (zio->io_trim_flags & ZIO_TRIM_SECURE)
+	if (zio->io_trim_flags & ZIO_TRIM_ZEROES)
+		error = vdev_bdev_issue_write_zeroes(bdh, sector, nsects, &bio);
+	else if (zio->io_trim_flags & ZIO_TRIM_SECURE)
 		error = vdev_bdev_issue_secure_erase(bdh, sector, nsects, &bio);
 	else
 		error = vdev_bdev_issue_discard(bdh, sector, nsects, &bio);
@@ -1648,6 +1760,9 @@ ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, failfast_mask, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_vdev_disk, zfs_vdev_disk_, max_segs, UINT, ZMOD_RW,
 	"Maximum number of data segments to add to an IO request (min 4)");
 
+ZFS_MODULE_PARAM(zfs_vdev_disk, zfs_vdev_disk_, poll, UINT, ZMOD_RW,
+	"Poll for completion of sync reads and writes on capable devices");
+
 ZFS_MODULE_PARAM_CALL(zfs_vdev_disk, zfs_vdev_disk_, classic,
     vdev_disk_param_set_classic, param_get_uint, ZMOD_RD,
 	"Use classic BIO submission method");
@@ -85,8 +85,10 @@
 #include <sys/stat.h>
 #include <sys/dmu.h>
 #include <sys/dmu_objset.h>
+#include <sys/dsl_dataset.h>
 #include <sys/dsl_destroy.h>
 #include <sys/dsl_deleg.h>
+#include <sys/zap.h>
 #include <sys/zpl.h>
 #include <sys/mntent.h>
 #include "zfs_namecheck.h"
@@ -113,6 +115,7 @@ static krwlock_t zfs_snapshot_lock;
 int zfs_expire_snapshot = ZFSCTL_EXPIRE_SNAPSHOT;
 static int zfs_admin_snapshot = 0;
 static int zfs_snapshot_no_setuid = 0;
+static int zfs_snapdir_cache = 0;
 
 typedef struct {
 	char		*se_name;	/* full snapshot name */
@@ -579,6 +582,162 @@ zfsctl_inode_lookup(zfsvfs_t *zfsvfs, uint64_t id,
 	return (ip);
 }
 
+static int
+zfsctl_snapdir_entry_compare(const void *arg1, const void *arg2)
+{
+	const zfs_snapdir_entry_t *sde1 = arg1;
+	const zfs_snapdir_entry_t *sde2 = arg2;
+
+	return (TREE_CMP(sde1->sde_pos, sde2->sde_pos));
+}
+
+static void
+zfsctl_snapdir_cache_free(zfs_snapdir_cache_t *sc)
+{
+	void *cookie = NULL;
+
+	while (avl_destroy_nodes(&sc->sc_tree, &cookie) != NULL)
+		;
+	avl_destroy(&sc->sc_tree);
+
+	for (uint64_t i = 0; i < sc->sc_count; i++) {
+		if (sc->sc_entries[i].sde_name != NULL)
+			kmem_strfree(sc->sc_entries[i].sde_name);
+	}
+	if (sc->sc_entries != NULL) {
+		vmem_free(sc->sc_entries,
+		    sc->sc_count * sizeof (zfs_snapdir_entry_t));
+	}
+
+	zfs_refcount_destroy(&sc->sc_refcount);
+	kmem_free(sc, sizeof (zfs_snapdir_cache_t));
+}
+
+/*
+ * Read the whole snapshot namespace of the dataset in one pass, under a
+ * single hold of the pool configuration lock.  Snapshots cannot be created,
+ * destroyed or renamed while it is held, so sc_gen matches the listing.
+ */
+static zfs_snapdir_cache_t *
+zfsctl_snapdir_cache_build(zfsvfs_t *zfsvfs)
+{
+	objset_t *os = zfsvfs->z_os;
+	dsl_pool_t *dp = dmu_objset_pool(os);
+	dsl_dataset_t *ds = dmu_objset_ds(os);
+	zfs_snapdir_cache_t *sc;
+	char *snapname;
+	uint64_t i, pos = 0;
+	int error = 0;
+
+	sc = kmem_zalloc(sizeof (zfs_snapdir_cache_t), KM_SLEEP);
+	zfs_refcount_create(&sc->sc_refcount);
+	avl_create(&sc->sc_tree, zfsctl_snapdir_entry_compare,
+	    sizeof (zfs_snapdir_entry_t), offsetof(zfs_snapdir_entry_t,
+	    sde_node));
+	snapname = kmem_alloc(ZFS_MAX_DATASET_NAME_LEN, KM_SLEEP);
+
+	dsl_pool_config_enter(dp, FTAG);
+	sc->sc_gen = dmu_objset_snap_gen(os);
+	if (dsl_dataset_phys(ds)->ds_snapnames_zapobj != 0) {
+		error = zap_count(dp->dp_meta_objset,
+		    dsl_dataset_phys(ds)->ds_snapnames_zapobj, &sc->sc_count);
+	}
+	if (error == 0 && sc->sc_count != 0) {
+		sc->sc_entries = vmem_zalloc(
+		    sc->sc_count * sizeof (zfs_snapdir_entry_t), KM_SLEEP);
+	}
+	for (i = 0; error == 0 && i < sc->sc_count; i++) {
+		zfs_snapdir_entry_t *sde = &sc->sc_entries[i];
+
+		sde->sde_pos = pos;
+		error = dmu_snapshot_list_next(os, ZFS_MAX_DATASET_NAME_LEN,
+		    snapname, &sde->sde_id, &pos, NULL);
+		if (error == 0) {
+			sde->sde_next = pos;
+			sde->sde_name = kmem_strdup(snapname);
+			avl_add(&sc->sc_tree, sde);
+		}
+	}
+	dsl_pool_config_exit(dp, FTAG);
+	kmem_free(snapname, ZFS_MAX_DATASET_NAME_LEN);
+
+	if (error != 0) {
+		zfsctl_snapdir_cache_free(sc);
+		return (NULL);
+	}
+
+	return (sc);
+}
+
+static void
+zfsctl_snapdir_cache_purge(zfsvfs_t *zfsvfs)
+{
+	zfs_snapdir_cache_t *sc;
+
+	mutex_enter(&zfsvfs->z_snapdir_lock);
+	sc = zfsvfs->z_snapdir_cache;
+	zfsvfs->z_snapdir_cache = NULL;
+	mutex_exit(&zfsvfs->z_snapdir_lock);
+
+	if (sc != NULL)
+		zfsctl_snapdir_cache_rele(sc, zfsvfs);
+}
+
+/*
+ * Return a held, current listing of '.zfs/snapshot', rebuilding it if the
+ * snapshot namespace changed since it was last read.  Returns NULL when
+ * the cache is disabled or cannot be built, in which case callers must
+ * walk the snapshot ZAP themselves.
+ */
+zfs_snapdir_cache_t *
+zfsctl_snapdir_cache_hold(zfsvfs_t *zfsvfs, const void *tag)
+{
+	zfs_snapdir_cache_t *sc;
+
+	if (!zfs_snapdir_cache) {
+		zfsctl_snapdir_cache_purge(zfsvfs);
+		return (NULL);
+	}
+
+	mutex_enter(&zfsvfs->z_snapdir_lock);
+	sc = zfsvfs->z_snapdir_cache;
+	if (sc == NULL || sc->sc_gen != dmu_objset_snap_gen(zfsvfs->z_os)) {
+		if (sc != NULL)
+			zfsctl_snapdir_cache_rele(sc, zfsvfs);
+		sc = zfsctl_snapdir_cache_build(zfsvfs);
+		if (sc != NULL)
+			zfs_refcount_add(&sc->sc_refcount, zfsvfs);
+		zfsvfs->z_snapdir_cache = sc;
+	}
+	if (sc != NULL)
+		zfs_refcount_add(&sc->sc_refcount, tag);
+	mutex_exit(&zfsvfs->z_snapdir_lock);
+
+	return (sc);
+}
+
+void
+zfsctl_snapdir_cache_rele(zfs_snapdir_cache_t *sc, const void *tag)
+{
+	if (zfs_refcount_remove(&sc->sc_refcount, tag) == 0)
+		zfsctl_snapdir_cache_free(sc);
+}
+
+/*
+ * Find the entry readdir returns at the given offset.  Only offsets handed
+ * out by this listing are found; any other offset must be resolved through
+ * the snapshot ZAP.
+ */
+zfs_snapdir_entry_t *
+zfsctl_snapdir_cache_find(zfs_snapdir_cache_t *sc, uint64_t pos)
+{
+	zfs_snapdir_entry_t search;
+
+	search.sde_pos = pos;
+
+	return (avl_find(&sc->sc_tree, &search, NULL));
+}
+
 /*
  * Create the '.zfs' directory.  This directory is cached as part of the VFS
  * structure.  This results in a hold on the zfsvfs_t.  The code in zfs_umount()
@@ -624,6 +783,7 @@ zfsctl_destroy(zfsvfs_t *zfsvfs)
 			zfsctl_snapshot_rele(se);
 		}
 	} else if (zfsvfs->z_ctldir) {
+		zfsctl_snapdir_cache_purge(zfsvfs);
 		iput(zfsvfs->z_ctldir);
 		zfsvfs->z_ctldir = NULL;
 	}
@@ -762,6 +922,7 @@ zfsctl_snapshot_path_objset(zfsvfs_t *zfsvfs, uint64_t objsetid,
     int path_len, char *full_path)
 {
 	objset_t *os = zfsvfs->z_os;
+	zfs_snapdir_cache_t *sc;
 	fstrans_cookie_t cookie;
 	char *snapname;
 	boolean_t case_conflict;
@@ -771,17 +932,34 @@ zfsctl_snapshot_path_objset(zfsvfs_t *zfsvfs, uint64_t objsetid,
 	cookie = spl_fstrans_mark();
 	snapname = kmem_alloc(ZFS_MAX_DATASET_NAME_LEN, KM_SLEEP);
 
-	while (error == 0) {
-		dsl_pool_config_enter(dmu_objset_pool(os), FTAG);
-		error = dmu_snapshot_list_next(zfsvfs->z_os,
-		    ZFS_MAX_DATASET_NAME_LEN, snapname, &id, &pos,
-		    &case_conflict);
-		dsl_pool_config_exit(dmu_objset_pool(os), FTAG);
+	sc = zfsctl_snapdir_cache_hold(zfsvfs, FTAG);
+	if (sc != NULL) {
+		error = SET_ERROR(ENOENT);
+		for (uint64_t i = 0; i < sc->sc_count; i++) {
+			if (sc->sc_entries[i].sde_id == objsetid) {
+				(void) strlcpy(snapname,
+				    sc->sc_entries[i].sde_name,
+				    ZFS_MAX_DATASET_NAME_LEN);
+				error = 0;
+				break;
+			}
+		}
+		zfsctl_snapdir_cache_rele(sc, FTAG);
 		if (error)
 			goto out;
-
-		if (id == objsetid)
-			break;
+	} else {
+		while (error == 0) {
+			dsl_pool_config_enter(dmu_objset_pool(os), FTAG);
+			error = dmu_snapshot_list_next(zfsvfs->z_os,
+			    ZFS_MAX_DATASET_NAME_LEN, snapname, &id, &pos,
+			    &case_conflict);
+			dsl_pool_config_exit(dmu_objset_pool(os), FTAG);
+			if (error)
+				goto out;
+
+			if (id == objsetid)
+				break;
+		}
 	}
 
 	mutex_enter(&zfsvfs->z_vfs->vfs_mntpt_lock);
@@ -1424,3 +1602,6 @@ MODULE_PARM_DESC(zfs_expire_snapshot, "Seconds to expire .zfs/snapshot");
 module_param(zfs_snapshot_no_setuid, int, 0644);
 MODULE_PARM_DESC(zfs_snapshot_no_setuid,
 	"Disable setuid/setgid for automounts in .zfs/snapshot");
+
+module_param(zfs_snapdir_cache, int, 0644);
+MODULE_PARM_DESC(zfs_snapdir_cache, "Cache the .zfs/snapshot listing");
@@ -689,7 +689,8 @@ zfs_rmnode(znode_t *zp)
 	 * truncated file is harmless since it only contains user data.
 	 */
 	if (S_ISREG(ZTOI(zp)->i_mode)) {
-		error = dmu_free_long_range(os, zp->z_id, 0, DMU_OBJECT_END);
+		error = dmu_free_long_range_background(os, zp->z_id, 0,
+		    DMU_OBJECT_END);
 		if (error) {
 			/*
 			 * Not enough space or we were interrupted by unmount.
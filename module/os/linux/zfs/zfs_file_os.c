@@ -194,6 +194,22 @@ zfs_file_pread(zfs_file_t *fp, void *buf, size_t count, loff_t off,
 	return (0);
 }
 
+/*
+ * Asynchronous stateless read or write.  There is no in-kernel interface
+ * comparable to the userspace io_uring ring, so callers always fall back
+ * to zfs_file_pread()/zfs_file_pwrite().
+ *
+ * Returns ENOTSUP.
+ */
+int
+zfs_file_aio_rw(zfs_file_t *fp, boolean_t write, void *buf, size_t count,
+    loff_t off, zfs_file_aio_done_t *done, void *arg)
+{
+	(void) fp, (void) write, (void) buf, (void) count, (void) off;
+	(void) done, (void) arg;
+	return (SET_ERROR(ENOTSUP));
+}
+
 /*
  * lseek - set / get file pointer
  *
@@ -64,6 +64,12 @@
 #include <linux/fs.h>
 #include "zfs_comutil.h"
 
+/*
+ * Remember recently freed object/generation pairs so that NFS file handles
+ * naming them are rejected without reading the dnode.
+ */
+static int zfs_vget_stale_cache = 0;
+
 enum {
 	TOKEN_RO,
 	TOKEN_RW,
@@ -847,6 +853,9 @@ zfsvfs_create_impl(zfsvfs_t **zfvp, zfsvfs_t *zfsvfs, objset_t *os)
 	zfsvfs->z_parent = zfsvfs;
 
 	mutex_init(&zfsvfs->z_znodes_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&zfsvfs->z_async_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zfsvfs->z_async_cv, NULL, CV_DEFAULT, NULL);
+	mutex_init(&zfsvfs->z_snapdir_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&zfsvfs->z_lock, NULL, MUTEX_DEFAULT, NULL);
 	list_create(&zfsvfs->z_all_znodes, sizeof (znode_t),
 	    offsetof(znode_t, z_link_node));
@@ -865,6 +874,8 @@ zfsvfs_create_impl(zfsvfs_t **zfvp, zfsvfs_t *zfsvfs, objset_t *os)
 		    sizeof (znode_hold_t), offsetof(znode_hold_t, zh_node));
 		mutex_init(&zfsvfs->z_hold_locks[i], NULL, MUTEX_DEFAULT, NULL);
 	}
+	zfsvfs->z_stale_fids = vmem_zalloc(sizeof (zfs_stale_fid_t) *
+	    size * ZFS_STALE_FIDS_PER_HOLD, KM_SLEEP);
 
 	error = zfsvfs_init(zfsvfs, os);
 	if (error != 0) {
@@ -991,6 +1002,9 @@ zfsvfs_free(zfsvfs_t *zfsvfs)
 	zfs_fuid_destroy(zfsvfs);
 
 	mutex_destroy(&zfsvfs->z_znodes_lock);
+	mutex_destroy(&zfsvfs->z_async_lock);
+	cv_destroy(&zfsvfs->z_async_cv);
+	mutex_destroy(&zfsvfs->z_snapdir_lock);
 	mutex_destroy(&zfsvfs->z_lock);
 	list_destroy(&zfsvfs->z_all_znodes);
 	ZFS_TEARDOWN_DESTROY(zfsvfs);
@@ -1002,6 +1016,8 @@ zfsvfs_free(zfsvfs_t *zfsvfs)
 	}
 	vmem_free(zfsvfs->z_hold_trees, sizeof (avl_tree_t) * size);
 	vmem_free(zfsvfs->z_hold_locks, sizeof (kmutex_t) * size);
+	vmem_free(zfsvfs->z_stale_fids, sizeof (zfs_stale_fid_t) *
+	    size * ZFS_STALE_FIDS_PER_HOLD);
 	zfsvfs_vfs_free(zfsvfs->z_vfs);
 	dataset_kstats_destroy(&zfsvfs->z_kstat);
 	kmem_free(zfsvfs, sizeof (zfsvfs_t));
@@ -1291,6 +1307,45 @@ zfs_prune(struct super_block *sb, unsigned long nr_to_scan, int *objects)
 	return (error);
 }
 
+/*
+ * Return the number of dentries and inodes which zfs_prune() could release,
+ * so the ARC can direct its prune requests at the filesystems which hold
+ * the most of them.  This is called synchronously from arc_evict(), so it
+ * must not block on z_teardown_lock; the caller's hold on s_umount keeps the
+ * superblock and its shrinker alive, and counting only reads the LRU sizes.
+ */
+uint64_t
+zfs_prune_count(struct super_block *sb)
+{
+	struct shrinker *shrinker = S_SHRINK(sb);
+	struct shrink_control sc = {
+		.nr_to_scan = 0,
+		.gfp_mask = GFP_KERNEL,
+	};
+	uint64_t count = 0;
+	long c;
+
+#ifdef SHRINKER_NUMA_AWARE
+	if (shrinker->flags & SHRINKER_NUMA_AWARE) {
+		for_each_online_node(sc.nid) {
+			c = shrinker->count_objects(shrinker, &sc);
+			if (c > 0)
+				count += c;
+		}
+	} else {
+		c = shrinker->count_objects(shrinker, &sc);
+		if (c > 0)
+			count = c;
+	}
+#else
+	c = shrinker->count_objects(shrinker, &sc);
+	if (c > 0)
+		count = c;
+#endif
+
+	return (count);
+}
+
 /*
  * Teardown the zfsvfs_t.
  *
@@ -1333,6 +1388,12 @@ zfsvfs_teardown(zfsvfs_t *zfsvfs, boolean_t unmounting)
 
 	ZFS_TEARDOWN_ENTER_WRITE(zfsvfs, FTAG);
 
+	/*
+	 * New asynchronous reads can no longer start, wait for the ones
+	 * still in flight, which do not take the teardown lock.
+	 */
+	zfs_read_async_wait(zfsvfs);
+
 	if (!unmounting) {
 		/*
 		 * We purge the parent filesystem's super block as the
@@ -1559,7 +1620,8 @@ zfs_domount(struct super_block *sb, zfs_mnt_t *zm, int silent)
 	if (!zfsvfs->z_issnap)
 		zfsctl_create(zfsvfs);
 
-	zfsvfs->z_arc_prune = arc_add_prune_callback(zpl_prune_sb, sb);
+	zfsvfs->z_arc_prune = arc_add_prune_count_callback(zpl_prune_sb,
+	    zpl_prune_count_sb, sb);
 out:
 	if (error) {
 		if (zfsvfs != NULL) {
@@ -1684,6 +1746,71 @@ zfs_remount(struct super_block *sb, int *flags, zfs_mnt_t *zm)
 	return (error);
 }
 
+static zfs_stale_fid_t *
+zfs_stale_fid_slot(zfsvfs_t *zfsvfs, uint64_t obj)
+{
+	uint64_t nslots = zfsvfs->z_hold_size * ZFS_STALE_FIDS_PER_HOLD;
+
+	ASSERT(MUTEX_HELD(&zfsvfs->z_hold_locks[ZFS_OBJ_HASH(zfsvfs, obj)]));
+	return (&zfsvfs->z_stale_fids[obj & (nslots - 1)]);
+}
+
+/*
+ * Remember that generation gen of object obj was freed.  Object numbers
+ * are only reused in a later txg, with a new generation, so until the
+ * filesystem is rolled back or received into (see zfs_resume_fs()) any
+ * handle naming this pair is stale.
+ */
+void
+zfs_stale_fid_add(zfsvfs_t *zfsvfs, uint64_t obj, uint64_t gen)
+{
+	kmutex_t *lock = &zfsvfs->z_hold_locks[ZFS_OBJ_HASH(zfsvfs, obj)];
+
+	if (!zfs_vget_stale_cache)
+		return;
+
+	mutex_enter(lock);
+	zfs_stale_fid_t *zsf = zfs_stale_fid_slot(zfsvfs, obj);
+	zsf->zsf_obj = obj;
+	zsf->zsf_gen = gen;
+	mutex_exit(lock);
+}
+
+static boolean_t
+zfs_stale_fid_check(zfsvfs_t *zfsvfs, uint64_t obj, uint64_t fid_gen,
+    uint64_t gen_mask)
+{
+	kmutex_t *lock = &zfsvfs->z_hold_locks[ZFS_OBJ_HASH(zfsvfs, obj)];
+	boolean_t stale = B_FALSE;
+
+	if (!zfs_vget_stale_cache || fid_gen == 0)
+		return (B_FALSE);
+
+	mutex_enter(lock);
+	zfs_stale_fid_t *zsf = zfs_stale_fid_slot(zfsvfs, obj);
+	if (zsf->zsf_obj == obj && zsf->zsf_gen != 0) {
+		uint64_t gen = zsf->zsf_gen & gen_mask;
+		stale = (MAX(gen, 1) == fid_gen);
+	}
+	mutex_exit(lock);
+
+	return (stale);
+}
+
+static void
+zfs_stale_fid_clear(zfsvfs_t *zfsvfs)
+{
+	for (uint64_t i = 0; i < zfsvfs->z_hold_size; i++) {
+		mutex_enter(&zfsvfs->z_hold_locks[i]);
+		for (uint64_t j = i; j < zfsvfs->z_hold_size *
+		    ZFS_STALE_FIDS_PER_HOLD; j += zfsvfs->z_hold_size) {
+			zfsvfs->z_stale_fids[j].zsf_obj = 0;
+			zfsvfs->z_stale_fids[j].zsf_gen = 0;
+		}
+		mutex_exit(&zfsvfs->z_hold_locks[i]);
+	}
+}
+
 int
 zfs_vget(struct super_block *sb, struct inode **ipp, fid_t *fidp)
 {
@@ -1767,6 +1894,12 @@ zfs_vget(struct super_block *sb, struct inode **ipp, fid_t *fidp)
 
 	gen_mask = -1ULL >> (64 - 8 * i);
 
+	if (zfs_stale_fid_check(zfsvfs, object, fid_gen, gen_mask)) {
+		dprintf("stale fid %llu gen %llu\n", object, fid_gen);
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(ENOENT));
+	}
+
 	dprintf("getting %llu [%llu mask %llx]\n", object, fid_gen, gen_mask);
 	if ((err = zfs_zget(zfsvfs, object, &zp))) {
 		zfs_exit(zfsvfs, FTAG);
@@ -1860,6 +1993,9 @@ zfs_resume_fs(zfsvfs_t *zfsvfs, dsl_dataset_t *ds)
 	zfs_set_fuid_feature(zfsvfs);
 	zfsvfs->z_rollback_time = jiffies;
 
+	/* A rollback or receive may have brought freed objects back. */
+	zfs_stale_fid_clear(zfsvfs);
+
 	/*
 	 * Attempt to re-establish all the active inodes with their
 	 * dbufs.  If a zfs_rezget() fails, then we unhash the inode
@@ -2171,3 +2307,6 @@ EXPORT_SYMBOL(zfs_vget);
 EXPORT_SYMBOL(zfs_prune);
 EXPORT_SYMBOL(zfs_set_default_quota);
 #endif
+
+ZFS_MODULE_PARAM(zfs, zfs_, vget_stale_cache, INT, ZMOD_RW,
+	"Reject file handles of recently freed files without a dnode read");
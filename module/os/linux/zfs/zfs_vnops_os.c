@@ -233,50 +233,88 @@ zfs_close(struct inode *ip, int flag, cred_t *cr)
 
 static int zfs_fillpage(struct inode *ip, struct page *pp);
 
+/*
+ * When zfs_mmap_large_folios is set, a page cache entry may be a folio
+ * spanning several pages.  Those are only enabled without highmem, so
+ * kmap() of the head page maps the whole folio.  These return the head
+ * page and the byte range of the folio (or just the page) holding pp.
+ */
+#ifdef HAVE_MAPPING_LARGE_FOLIOS
+#define	zfs_folio_head(pp)		(&page_folio(pp)->page)
+#define	zfs_folio_pos(pp)		folio_pos(page_folio(pp))
+#define	zfs_folio_size(pp)		folio_size(page_folio(pp))
+#define	zfs_folio_nr_pages(pp)		folio_nr_pages(page_folio(pp))
+#define	zfs_flush_dcache_folio(pp)	flush_dcache_folio(page_folio(pp))
+#else
+#define	zfs_folio_head(pp)		(pp)
+#define	zfs_folio_pos(pp)		page_offset(pp)
+#define	zfs_folio_size(pp)		PAGE_SIZE
+#define	zfs_folio_nr_pages(pp)		1
+#define	zfs_flush_dcache_folio(pp)	flush_dcache_page(pp)
+#endif
+
+/*
+ * Data of a memory mapped file is normally cached twice, once in the page
+ * cache and once in the ARC.  When set, blocks read to fill the page cache
+ * and blocks written through it are dropped from the ARC once they are no
+ * longer needed, so that the page cache holds the only cached copy.
+ */
+static int zfs_mmap_arc_uncached = 0;
+
 /*
  * When a file is memory mapped, we must keep the IO data synchronized
  * between the DMU cache and the memory mapped pages.  Update all mapped
- * pages with the contents of the coresponding dmu buffer.
+ * pages with the contents of the coresponding dmu buffer, one dmu_read()
+ * per folio.
  */
 void
 update_pages(znode_t *zp, int64_t start, int len, objset_t *os)
 {
 	struct address_space *mp = ZTOI(zp)->i_mapping;
-	int64_t off = start & (PAGE_SIZE - 1);
+	int64_t orig_start = start;
+	int orig_len = len;
 
-	for (start &= PAGE_MASK; len > 0; start += PAGE_SIZE) {
-		uint64_t nbytes = MIN(PAGE_SIZE - off, len);
+	while (len > 0) {
+		uint64_t nbytes = MIN(PAGE_SIZE - (start & (PAGE_SIZE - 1)),
+		    len);
 
 		struct page *pp = find_lock_page(mp, start >> PAGE_SHIFT);
 		if (pp) {
+			struct page *head = zfs_folio_head(pp);
+			int64_t off = start - zfs_folio_pos(head);
+			nbytes = MIN(zfs_folio_size(head) - off, len);
+
 			if (mapping_writably_mapped(mp))
-				flush_dcache_page(pp);
+				zfs_flush_dcache_folio(head);
 
-			void *pb = kmap(pp);
-			int error = dmu_read(os, zp->z_id, start + off,
+			void *pb = kmap(head);
+			int error = dmu_read(os, zp->z_id, start,
 			    nbytes, pb + off, DMU_READ_PREFETCH);
-			kunmap(pp);
+			kunmap(head);
 
 			if (error) {
-				SetPageError(pp);
-				ClearPageUptodate(pp);
+				SetPageError(head);
+				ClearPageUptodate(head);
 			} else {
-				ClearPageError(pp);
-				SetPageUptodate(pp);
+				ClearPageError(head);
+				SetPageUptodate(head);
 
 				if (mapping_writably_mapped(mp))
-					flush_dcache_page(pp);
+					zfs_flush_dcache_folio(head);
 
-				mark_page_accessed(pp);
+				mark_page_accessed(head);
 			}
 
 			unlock_page(pp);
 			put_page(pp);
 		}
 
+		start += nbytes;
 		len -= nbytes;
-		off = 0;
 	}
+
+	if (zfs_mmap_arc_uncached)
+		dmu_uncache_range(os, zp->z_id, orig_start, orig_len);
 }
 
 /*
@@ -290,23 +328,26 @@ mappedread(znode_t *zp, int nbytes, zfs_uio_t *uio)
 	struct inode *ip = ZTOI(zp);
 	struct address_space *mp = ip->i_mapping;
 	int64_t start = uio->uio_loffset;
-	int64_t off = start & (PAGE_SIZE - 1);
 	int len = nbytes;
 	int error = 0;
 
-	for (start &= PAGE_MASK; len > 0; start += PAGE_SIZE) {
-		uint64_t bytes = MIN(PAGE_SIZE - off, len);
+	while (len > 0) {
+		uint64_t bytes = MIN(PAGE_SIZE - (start & (PAGE_SIZE - 1)),
+		    len);
 
 		struct page *pp = find_lock_page(mp, start >> PAGE_SHIFT);
 		if (pp) {
+			struct page *head = zfs_folio_head(pp);
+			int64_t off = start - zfs_folio_pos(head);
+			bytes = MIN(zfs_folio_size(head) - off, len);
 
 			/*
 			 * If filemap_fault() retries there exists a window
 			 * where the page will be unlocked and not up to date.
 			 * In this case we must try and fill the page.
 			 */
-			if (unlikely(!PageUptodate(pp))) {
-				error = zfs_fillpage(ip, pp);
+			if (unlikely(!PageUptodate(head))) {
+				error = zfs_fillpage(ip, head);
 				if (error) {
 					unlock_page(pp);
 					put_page(pp);
@@ -314,26 +355,26 @@ mappedread(znode_t *zp, int nbytes, zfs_uio_t *uio)
 				}
 			}
 
-			ASSERT(PageUptodate(pp) || PageDirty(pp));
+			ASSERT(PageUptodate(head) || PageDirty(head));
 
 			unlock_page(pp);
 
-			void *pb = kmap(pp);
+			void *pb = kmap(head);
 			error = zfs_uiomove(pb + off, bytes, UIO_READ, uio);
-			kunmap(pp);
+			kunmap(head);
 
 			if (mapping_writably_mapped(mp))
-				flush_dcache_page(pp);
+				zfs_flush_dcache_folio(head);
 
-			mark_page_accessed(pp);
+			mark_page_accessed(head);
 			put_page(pp);
 		} else {
 			error = dmu_read_uio_dbuf(sa_get_db(zp->z_sa_hdl),
 			    uio, bytes, DMU_READ_PREFETCH);
 		}
 
+		start += bytes;
 		len -= bytes;
-		off = 0;
 
 		if (error)
 			break;
@@ -3739,10 +3780,11 @@ zfs_putpage(struct inode *ip, struct page *pp, struct writeback_control *wbc,
 		return (err);
 
 	ASSERT(PageLocked(pp));
+	ASSERT3P(pp, ==, zfs_folio_head(pp));
 
-	pgoff = page_offset(pp);	/* Page byte-offset in file */
+	pgoff = zfs_folio_pos(pp);	/* Folio byte-offset in file */
 	offset = i_size_read(ip);	/* File length in bytes */
-	pglen = MIN(PAGE_SIZE,		/* Page length in bytes */
+	pglen = MIN(zfs_folio_size(pp),	/* Folio length in bytes */
 	    P2ROUNDUP(offset, PAGE_SIZE)-pgoff);
 
 	/* Page is beyond end of file */
@@ -3851,7 +3893,7 @@ zfs_putpage(struct inode *ip, struct page *pp, struct writeback_control *wbc,
 	 * Counterpart for redirty_page_for_writepage() above.  This page
 	 * was in fact not skipped and should not be counted as if it were.
 	 */
-	wbc->pages_skipped--;
+	wbc->pages_skipped -= zfs_folio_nr_pages(pp);
 	if (!for_sync)
 		atomic_inc_32(&zp->z_async_writes_cnt);
 	set_page_writeback(pp);
@@ -3880,7 +3922,7 @@ zfs_putpage(struct inode *ip, struct page *pp, struct writeback_control *wbc,
 	}
 
 	va = kmap(pp);
-	ASSERT3U(pglen, <=, PAGE_SIZE);
+	ASSERT3U(pglen, <=, zfs_folio_size(pp));
 	dmu_write(zfsvfs->z_os, zp->z_id, pgoff, pglen, va, tx);
 	kunmap(pp);
 
@@ -3925,6 +3967,9 @@ zfs_putpage(struct inode *ip, struct page *pp, struct writeback_control *wbc,
 
 	dmu_tx_commit(tx);
 
+	if (zfs_mmap_arc_uncached)
+		dmu_uncache_range(zfsvfs->z_os, zp->z_id, pgoff, pglen);
+
 	zfs_rangelock_exit(lr);
 
 	if (commit)
@@ -4058,7 +4103,8 @@ zfs_inactive(struct inode *ip)
 }
 
 /*
- * Fill pages with data from the disk.
+ * Fill pages with data from the disk.  pp is the head page of a folio,
+ * which is filled with a single dmu_read().
  */
 static int
 zfs_fillpage(struct inode *ip, struct page *pp)
@@ -4066,19 +4112,25 @@ zfs_fillpage(struct inode *ip, struct page *pp)
 	znode_t *zp = ITOZ(ip);
 	zfsvfs_t *zfsvfs = ITOZSB(ip);
 	loff_t i_size = i_size_read(ip);
-	u_offset_t io_off = page_offset(pp);
-	size_t io_len = PAGE_SIZE;
+	u_offset_t io_off = zfs_folio_pos(pp);
+	size_t folio_len = zfs_folio_size(pp);
+	size_t io_len = folio_len;
 
+	ASSERT3P(pp, ==, zfs_folio_head(pp));
 	ASSERT3U(io_off, <, i_size);
 
 	if (io_off + io_len > i_size)
 		io_len = i_size - io_off;
 
+	dmu_flags_t flags = DMU_READ_PREFETCH;
+	if (zfs_mmap_arc_uncached)
+		flags |= DMU_UNCACHEDIO;
+
 	void *va = kmap(pp);
 	int error = dmu_read(zfsvfs->z_os, zp->z_id, io_off,
-	    io_len, va, DMU_READ_PREFETCH);
-	if (io_len != PAGE_SIZE)
-		memset((char *)va + io_len, 0, PAGE_SIZE - io_len);
+	    io_len, va, flags);
+	if (io_len != folio_len)
+		memset((char *)va + io_len, 0, folio_len - io_len);
 	kunmap(pp);
 
 	if (error) {
@@ -4114,8 +4166,8 @@ zfs_getpage(struct inode *ip, struct page *pp)
 	znode_t *zp = ITOZ(ip);
 	int error;
 	loff_t i_size = i_size_read(ip);
-	u_offset_t io_off = page_offset(pp);
-	size_t io_len = PAGE_SIZE;
+	u_offset_t io_off = zfs_folio_pos(pp);
+	size_t io_len = zfs_folio_size(pp);
 
 	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
 		return (error);
@@ -4125,6 +4177,23 @@ zfs_getpage(struct inode *ip, struct page *pp)
 	if (io_off + io_len > i_size)
 		io_len = i_size - io_off;
 
+	/*
+	 * Pages are only backed by data blocks, move inline data to one.
+	 * As below the page lock is dropped while taking the rangelock.
+	 * While this page is cached the file cannot get inline data again.
+	 */
+	if (zp->z_pflags & ZFS_INLINE_DATA) {
+		get_page(pp);
+		unlock_page(pp);
+		error = zfs_sa_inline_to_blocks(zp);
+		lock_page(pp);
+		put_page(pp);
+		if (error != 0) {
+			zfs_exit(zfsvfs, FTAG);
+			return (error);
+		}
+	}
+
 	/*
 	 * It is important to hold the rangelock here because it is possible
 	 * a Direct I/O write or block clone might be taking place at the same
@@ -4157,7 +4226,7 @@ zfs_getpage(struct inode *ip, struct page *pp)
 	zfs_rangelock_exit(lr);
 
 	if (error == 0)
-		dataset_kstats_update_read_kstats(&zfsvfs->z_kstat, PAGE_SIZE);
+		dataset_kstats_update_read_kstats(&zfsvfs->z_kstat, io_len);
 
 	zfs_exit(zfsvfs, FTAG);
 
@@ -4357,4 +4426,8 @@ EXPORT_SYMBOL(zfs_map);
 
 module_param(zfs_delete_blocks, ulong, 0644);
 MODULE_PARM_DESC(zfs_delete_blocks, "Delete files larger than N blocks async");
+
+module_param(zfs_mmap_arc_uncached, int, 0644);
+MODULE_PARM_DESC(zfs_mmap_arc_uncached,
+	"Avoid caching memory mapped file data in both page cache and ARC");
 #endif
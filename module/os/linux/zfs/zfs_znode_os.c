@@ -74,11 +74,19 @@ unsigned int zfs_object_mutex_size = ZFS_OBJ_MTX_SZ;
  */
 static int zfs_unlink_suspend_progress = 0;
 
+/*
+ * Allow the page cache to use large folios for regular files.  mmap
+ * faults, readahead and writeback then move a whole folio per DMU call.
+ */
+static int zfs_mmap_large_folios = 0;
+
 /*
  * This callback is invoked when acquiring a RL_WRITER or RL_APPEND lock on
  * z_rangelock. It will modify the offset and length of the lock to reflect
  * znode-specific information, and convert RL_APPEND to RL_WRITER.  This is
- * called with the rangelock_t's rl_lock held, which avoids races.
+ * called with the rangelock_t's rl_lock held, which avoids races.  Once the
+ * range lock is sharded it is called unlocked instead, and again after the
+ * range is locked to check the result still holds.
  */
 static void
 zfs_rangelock_cb(zfs_locked_range_t *new, void *arg)
@@ -409,6 +417,10 @@ zfs_inode_set_ops(zfsvfs_t *zfsvfs, struct inode *ip)
 		ip->i_op = &zpl_inode_operations;
 		ip->i_fop = &zpl_file_operations;
 		ip->i_mapping->a_ops = &zpl_address_space_operations;
+#if defined(HAVE_MAPPING_LARGE_FOLIOS) && !defined(CONFIG_HIGHMEM)
+		if (zfs_mmap_large_folios)
+			mapping_set_large_folios(ip->i_mapping);
+#endif
 		break;
 
 	case S_IFDIR:
@@ -534,7 +546,9 @@ zfs_znode_alloc(zfsvfs_t *zfsvfs, dmu_buf_t *db, int blksz,
 	zp->z_id = db->db_object;
 	zp->z_blksz = blksz;
 	zp->z_seq = 0x7A4653;
+	zp->z_auto_blksz = 0;
 	zp->z_sync_cnt = 0;
+	zp->z_replay_eof = 0;
 	zp->z_sync_writes_cnt = 0;
 	zp->z_async_writes_cnt = 0;
 
@@ -1305,12 +1319,16 @@ zfs_znode_delete(znode_t *zp, dmu_tx_t *tx)
 	uint64_t acl_obj = zfs_external_acl(zp);
 	znode_hold_t *zh;
 
+	uint64_t gen = 0;
+	(void) sa_lookup(zp->z_sa_hdl, SA_ZPL_GEN(zfsvfs), &gen, sizeof (gen));
+
 	zh = zfs_znode_hold_enter(zfsvfs, obj);
 	if (acl_obj) {
 		VERIFY(!zp->z_is_sa);
 		VERIFY(0 == dmu_object_free(os, acl_obj, tx));
 	}
 	VERIFY(0 == dmu_object_free(os, obj, tx));
+	zfs_stale_fid_add(zfsvfs, obj, gen);
 	zfs_znode_dmu_fini(zp);
 	zfs_znode_hold_exit(zfsvfs, zh);
 }
@@ -1755,6 +1773,10 @@ zfs_freesp(znode_t *zp, uint64_t off, uint64_t len, int flag, boolean_t log)
 	    sizeof (mode))) != 0)
 		return (error);
 
+	if ((zp->z_pflags & ZFS_INLINE_DATA) &&
+	    (error = zfs_sa_inline_freesp(zp, off, len)) != 0)
+		return (error);
+
 	if (off > zp->z_size) {
 		error =  zfs_extend(zp, off+len);
 		if (error == 0 && log)
@@ -1973,3 +1995,5 @@ MODULE_PARM_DESC(zfs_object_mutex_size, "Size of znode hold array");
 module_param(zfs_unlink_suspend_progress, int, 0644);
 MODULE_PARM_DESC(zfs_unlink_suspend_progress, "Set to prevent async unlinks "
 "(debug - leaks space into the unlinked set)");
+module_param(zfs_mmap_large_folios, int, 0644);
+MODULE_PARM_DESC(zfs_mmap_large_folios, "Use large folios in the page cache");
@@ -27,7 +27,7 @@
 #include <sys/zil.h>
 #include <sys/sha2.h>
 #include <sys/hkdf.h>
-#include <sys/qat.h>
+#include <sys/zio_offload.h>
 
 /*
  * This file is responsible for handling all of the details of generating
@@ -204,7 +204,9 @@ const zio_crypt_info_t zio_crypt_table[ZIO_CRYPT_FUNCTIONS] = {
 	{SUN_CKM_AES_CCM,	ZC_TYPE_CCM,	32,	"aes-256-ccm"},
 	{SUN_CKM_AES_GCM,	ZC_TYPE_GCM,	16,	"aes-128-gcm"},
 	{SUN_CKM_AES_GCM,	ZC_TYPE_GCM,	24,	"aes-192-gcm"},
-	{SUN_CKM_AES_GCM,	ZC_TYPE_GCM,	32,	"aes-256-gcm"}
+	{SUN_CKM_AES_GCM,	ZC_TYPE_GCM,	32,	"aes-256-gcm"},
+	{SUN_CKM_CHACHA20_POLY1305, ZC_TYPE_CHACHA20_POLY1305, 32,
+	    "chacha20-poly1305"}
 };
 
 void
@@ -215,6 +217,8 @@ zio_crypt_key_destroy(zio_crypt_key_t *key)
 	/* free crypto templates */
 	crypto_destroy_ctx_template(key->zk_current_tmpl);
 	crypto_destroy_ctx_template(key->zk_hmac_tmpl);
+	for (int i = 0; i < ZIO_CRYPT_KEY_CACHE_SIZE; i++)
+		crypto_destroy_ctx_template(key->zk_cache[i].zck_tmpl);
 
 	/* zero out sensitive data */
 	memset(key, 0, sizeof (zio_crypt_key_t));
@@ -314,7 +318,7 @@ zio_crypt_key_change_salt(zio_crypt_key_t *key)
 {
 	int ret = 0;
 	uint8_t salt[ZIO_DATA_SALT_LEN];
-	crypto_mechanism_t mech;
+	crypto_mechanism_t mech = {0};
 	uint_t keydata_len = zio_crypt_table[key->zk_crypt].ci_keylen;
 
 	/* generate a new salt */
@@ -340,6 +344,8 @@ zio_crypt_key_change_salt(zio_crypt_key_t *key)
 
 	/* destroy the old context template and create the new one */
 	crypto_destroy_ctx_template(key->zk_current_tmpl);
+	mech.cm_type =
+	    crypto_mech2id(zio_crypt_table[key->zk_crypt].ci_mechname);
 	ret = crypto_create_ctx_template(&mech, &key->zk_current_key,
 	    &key->zk_current_tmpl);
 	if (ret != CRYPTO_SUCCESS)
@@ -398,6 +404,7 @@ zio_do_crypt_uio(boolean_t encrypt, uint64_t crypt, crypto_key_t *key,
 	crypto_data_t plaindata, cipherdata;
 	CK_AES_CCM_PARAMS ccmp;
 	CK_AES_GCM_PARAMS gcmp;
+	CK_SALSA20_CHACHA20_POLY1305_PARAMS ccp;
 	crypto_mechanism_t mech;
 	zio_crypt_info_t crypt_info;
 	uint_t plain_full_len, maclen;
@@ -427,8 +434,8 @@ zio_do_crypt_uio(boolean_t encrypt, uint64_t crypt, crypto_key_t *key,
 	}
 
 	/*
-	 * setup encryption params (currently only AES CCM and AES GCM
-	 * are supported)
+	 * setup encryption params (currently only AES CCM, AES GCM and
+	 * ChaCha20-Poly1305 are supported)
 	 */
 	if (crypt_info.ci_crypt_type == ZC_TYPE_CCM) {
 		ccmp.ulNonceSize = ZIO_DATA_IV_LEN;
@@ -440,6 +447,15 @@ zio_do_crypt_uio(boolean_t encrypt, uint64_t crypt, crypto_key_t *key,
 
 		mech.cm_param = (char *)(&ccmp);
 		mech.cm_param_len = sizeof (CK_AES_CCM_PARAMS);
+	} else if (crypt_info.ci_crypt_type == ZC_TYPE_CHACHA20_POLY1305) {
+		ccp.pNonce = ivbuf;
+		ccp.ulNonceLen = ZIO_DATA_IV_LEN;
+		ccp.pAAD = authbuf;
+		ccp.ulAADLen = auth_len;
+
+		mech.cm_param = (char *)(&ccp);
+		mech.cm_param_len =
+		    sizeof (CK_SALSA20_CHACHA20_POLY1305_PARAMS);
 	} else {
 		gcmp.ulIvLen = ZIO_DATA_IV_LEN;
 		gcmp.ulIvBits = CRYPTO_BYTES2BITS(ZIO_DATA_IV_LEN);
@@ -569,6 +585,8 @@ zio_crypt_key_unwrap(crypto_key_t *cwkey, uint64_t crypt, uint64_t version,
 	ASSERT3U(crypt, <, ZIO_CRYPT_FUNCTIONS);
 
 	rw_init(&key->zk_salt_lock, NULL, RW_DEFAULT, NULL);
+	memset(key->zk_cache, 0, sizeof (key->zk_cache));
+	key->zk_cache_next = 0;
 
 	keydata_len = zio_crypt_table[crypt].ci_keylen;
 
@@ -1905,6 +1923,70 @@ error:
 	return (ret);
 }
 
+/*
+ * Find the key derived from salt among the recently used keys. Must be
+ * called with zk_salt_lock held.
+ */
+static zio_crypt_cached_key_t *
+zio_crypt_key_cache_lookup(zio_crypt_key_t *key, const uint8_t *salt)
+{
+	for (int i = 0; i < ZIO_CRYPT_KEY_CACHE_SIZE; i++) {
+		zio_crypt_cached_key_t *ck = &key->zk_cache[i];
+
+		if (ck->zck_key.ck_data != NULL &&
+		    memcmp(salt, ck->zck_salt, ZIO_DATA_SALT_LEN) == 0)
+			return (ck);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Remember the key derived from salt, along with its expanded key schedule,
+ * in place of the oldest cached key. Blocks written before the last salt
+ * change or key load all share a handful of salts, so this saves reads of
+ * such blocks from running HKDF and expanding the key for every block.
+ * Since this is just an optimization, give up if the salt lock is busy. On
+ * success the salt lock is held as reader, just like after a lookup.
+ */
+static zio_crypt_cached_key_t *
+zio_crypt_key_cache_insert(zio_crypt_key_t *key, const uint8_t *salt,
+    const uint8_t *keydata)
+{
+	uint_t keydata_len = zio_crypt_table[key->zk_crypt].ci_keylen;
+	crypto_mechanism_t mech = {0};
+	zio_crypt_cached_key_t *ck;
+	int ret;
+
+	if (!rw_tryenter(&key->zk_salt_lock, RW_WRITER))
+		return (NULL);
+
+	/* someone beat us to it, use their copy */
+	ck = zio_crypt_key_cache_lookup(key, salt);
+	if (ck == NULL) {
+		ck = &key->zk_cache[key->zk_cache_next];
+		key->zk_cache_next =
+		    (key->zk_cache_next + 1) % ZIO_CRYPT_KEY_CACHE_SIZE;
+
+		crypto_destroy_ctx_template(ck->zck_tmpl);
+		memcpy(ck->zck_salt, salt, ZIO_DATA_SALT_LEN);
+		memcpy(ck->zck_keydata, keydata, keydata_len);
+		ck->zck_key.ck_data = ck->zck_keydata;
+		ck->zck_key.ck_length = CRYPTO_BYTES2BITS(keydata_len);
+
+		mech.cm_type =
+		    crypto_mech2id(zio_crypt_table[key->zk_crypt].ci_mechname);
+		ret = crypto_create_ctx_template(&mech, &ck->zck_key,
+		    &ck->zck_tmpl);
+		if (ret != CRYPTO_SUCCESS)
+			ck->zck_tmpl = NULL;
+	}
+
+	rw_downgrade(&key->zk_salt_lock);
+
+	return (ck);
+}
+
 /*
  * Primary encryption / decryption entrypoint for zio data.
  */
@@ -1923,14 +2005,16 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 	uint8_t enc_keydata[MASTER_KEY_MAX_LEN];
 	crypto_key_t tmp_ckey, *ckey = NULL;
 	crypto_ctx_template_t tmpl;
+	zio_crypt_cached_key_t *ck;
 	uint8_t *authbuf = NULL;
 
 	memset(&puio, 0, sizeof (puio));
 	memset(&cuio, 0, sizeof (cuio));
 
 	/*
-	 * If the needed key is the current one, just use it. Otherwise we
-	 * need to generate a temporary one from the given salt + master key.
+	 * If the needed key is the current one or a recently used one, just
+	 * use it. Otherwise we need to generate one from the given salt +
+	 * master key, and try to cache it for the next blocks with this salt.
 	 * If we are encrypting, we must return a copy of the current salt
 	 * so that it can be stored in the blkptr_t.
 	 */
@@ -1940,6 +2024,9 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 	if (memcmp(salt, key->zk_salt, ZIO_DATA_SALT_LEN) == 0) {
 		ckey = &key->zk_current_key;
 		tmpl = key->zk_current_tmpl;
+	} else if ((ck = zio_crypt_key_cache_lookup(key, salt)) != NULL) {
+		ckey = &ck->zck_key;
+		tmpl = ck->zck_tmpl;
 	} else {
 		rw_exit(&key->zk_salt_lock);
 		locked = B_FALSE;
@@ -1949,21 +2036,31 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 		if (ret != 0)
 			goto error;
 
-		tmp_ckey.ck_data = enc_keydata;
-		tmp_ckey.ck_length = CRYPTO_BYTES2BITS(keydata_len);
+		ck = zio_crypt_key_cache_insert(key, salt, enc_keydata);
+		if (ck != NULL) {
+			locked = B_TRUE;
+			memset(enc_keydata, 0, keydata_len);
+			ckey = &ck->zck_key;
+			tmpl = ck->zck_tmpl;
+		} else {
+			tmp_ckey.ck_data = enc_keydata;
+			tmp_ckey.ck_length = CRYPTO_BYTES2BITS(keydata_len);
 
-		ckey = &tmp_ckey;
-		tmpl = NULL;
+			ckey = &tmp_ckey;
+			tmpl = NULL;
+		}
 	}
 
 	/*
-	 * Attempt to use QAT acceleration if we can. We currently don't
+	 * Attempt to use hardware acceleration if we can. We currently don't
 	 * do this for metadnode and ZIL blocks, since they have a much
-	 * more involved buffer layout and the qat_crypt() function only
-	 * works in-place.
+	 * more involved buffer layout and offload providers only handle
+	 * flat buffers.
 	 */
-	if (qat_crypt_use_accel(datalen) &&
-	    ot != DMU_OT_INTENT_LOG && ot != DMU_OT_DNODE) {
+	zio_offload_op_t op = encrypt ? ZIO_OFFLOAD_ENCRYPT :
+	    ZIO_OFFLOAD_DECRYPT;
+	if (ot != DMU_OT_INTENT_LOG && ot != DMU_OT_DNODE &&
+	    zio_offload_usable(op, key->zk_crypt, datalen)) {
 		uint8_t *srcbuf, *dstbuf;
 
 		if (encrypt) {
@@ -1974,9 +2071,9 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 			dstbuf = plainbuf;
 		}
 
-		ret = qat_crypt((encrypt) ? QAT_ENCRYPT : QAT_DECRYPT, srcbuf,
-		    dstbuf, NULL, 0, iv, mac, ckey, key->zk_crypt, datalen);
-		if (ret == CPA_STATUS_SUCCESS) {
+		ret = zio_offload_crypt(op, key->zk_crypt, ckey, srcbuf,
+		    dstbuf, NULL, 0, iv, mac, datalen);
+		if (ret == 0) {
 			if (locked) {
 				rw_exit(&key->zk_salt_lock);
 				locked = B_FALSE;
@@ -247,6 +247,8 @@ static int
 zpl_snapdir_iterate(struct file *filp, struct dir_context *ctx)
 {
 	zfsvfs_t *zfsvfs = ITOZSB(file_inode(filp));
+	zfs_snapdir_cache_t *sc = NULL;
+	zfs_snapdir_entry_t *sde;
 	fstrans_cookie_t cookie;
 	char snapname[MAXNAMELEN];
 	boolean_t case_conflict;
@@ -262,6 +264,24 @@ zpl_snapdir_iterate(struct file *filp, struct dir_context *ctx)
 
 	/* Start the position at 0 if it already emitted . and .. */
 	pos = (ctx->pos == 2 ? 0 : ctx->pos);
+
+	/*
+	 * Serve the listing from the cache when resuming at an offset it
+	 * handed out, falling back to walking the snapshot ZAP otherwise.
+	 */
+	sc = zfsctl_snapdir_cache_hold(zfsvfs, FTAG);
+	if (sc != NULL && (sde = zfsctl_snapdir_cache_find(sc, pos)) != NULL) {
+		for (; sde < sc->sc_entries + sc->sc_count; sde++) {
+			if (!dir_emit(ctx, sde->sde_name,
+			    strlen(sde->sde_name),
+			    ZFSCTL_INO_SHARES - sde->sde_id, DT_DIR))
+				goto out;
+
+			ctx->pos = sde->sde_next;
+		}
+		goto out;
+	}
+
 	while (error == 0) {
 		dsl_pool_config_enter(dmu_objset_pool(zfsvfs->z_os), FTAG);
 		error = -dmu_snapshot_list_next(zfsvfs->z_os, MAXNAMELEN,
@@ -277,6 +297,8 @@ zpl_snapdir_iterate(struct file *filp, struct dir_context *ctx)
 		ctx->pos = pos;
 	}
 out:
+	if (sc != NULL)
+		zfsctl_snapdir_cache_rele(sc, FTAG);
 	spl_fstrans_unmark(cookie);
 	zpl_exit(zfsvfs, FTAG);
 
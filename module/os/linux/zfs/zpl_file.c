@@ -165,7 +165,11 @@ zpl_fsync(struct file *filp, loff_t start, loff_t end, int datasync)
 
 	crhold(cr);
 	cookie = spl_fstrans_mark();
-	error = -zfs_fsync(zp, datasync, cr);
+	if (start == 0 && end == LLONG_MAX)
+		error = -zfs_fsync(zp, datasync, cr);
+	else
+		error = -zfs_fsync_range(zp, datasync, start,
+		    end - start + 1, cr);
 	spl_fstrans_unmark(cookie);
 	crfree(cr);
 	ASSERT3S(error, <=, 0);
@@ -217,6 +221,18 @@ zpl_file_accessed(struct file *filp)
 	}
 }
 
+#ifdef HAVE_KIOCB_KI_COMPLETE_2ARGS
+static void
+zpl_aio_read_done(void *arg, ssize_t nread, int error)
+{
+	struct kiocb *kiocb = arg;
+
+	if (error == 0)
+		kiocb->ki_pos += nread;
+	kiocb->ki_complete(kiocb, error != 0 ? -error : nread);
+}
+#endif
+
 static ssize_t
 zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 {
@@ -225,13 +241,35 @@ zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 	struct file *filp = kiocb->ki_filp;
 	ssize_t count = iov_iter_count(to);
 	zfs_uio_t uio;
+	ssize_t ret;
 
 	zfs_uio_iov_iter_init(&uio, to, kiocb->ki_pos, count);
 
+#ifdef HAVE_KIOCB_KI_COMPLETE_2ARGS
+	/*
+	 * Asynchronous Direct I/O reads, as from io_uring or AIO, complete
+	 * through ki_complete() instead of blocking the submitter.  The read
+	 * may complete, and with it the kiocb and its reference on the file
+	 * be released, before zfs_read_async() returns, so update atime first.
+	 */
+	if (!is_sync_kiocb(kiocb)) {
+		zpl_file_accessed(filp);
+		cookie = spl_fstrans_mark();
+		ret = -zfs_read_async(ITOZ(filp->f_mapping->host), &uio,
+		    filp->f_flags | zfs_io_flags(kiocb), zpl_aio_read_done,
+		    kiocb);
+		spl_fstrans_unmark(cookie);
+		if (ret == 0)
+			return (-EIOCBQUEUED);
+		if (ret != -EOPNOTSUPP)
+			return (ret);
+	}
+#endif
+
 	crhold(cr);
 	cookie = spl_fstrans_mark();
 
-	ssize_t ret = -zfs_read(ITOZ(filp->f_mapping->host), &uio,
+	ret = -zfs_read(ITOZ(filp->f_mapping->host), &uio,
 	    filp->f_flags | zfs_io_flags(kiocb), cr);
 
 	spl_fstrans_unmark(cookie);
@@ -248,6 +286,32 @@ zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 	return (read);
 }
 
+#if defined(HAVE_COPY_SPLICE_READ) && defined(HAVE_FILEMAP_SPLICE_READ)
+/*
+ * Data of mmap'd files may also be in the page cache, which the write path
+ * keeps in sync with the ARC.  If the spliced range has such pages, lend
+ * them to the pipe instead of copying, the same as other filesystems do.
+ * Otherwise copy from the ARC into new pipe pages through zpl_iter_read().
+ * ARC buffers themselves are never lent: block cloning and Direct I/O
+ * writes release them while the dbuf is still held, and they may be slab
+ * memory, which the network stack would not reference anyway.
+ */
+static ssize_t
+zpl_splice_read(struct file *in, loff_t *ppos, struct pipe_inode_info *pipe,
+    size_t len, unsigned int flags)
+{
+	struct inode *ip = file_inode(in);
+	loff_t isize = i_size_read(ip);
+
+	if (!(in->f_flags & O_DIRECT) && len > 0 && *ppos < isize &&
+	    zn_has_cached_data(ITOZ(ip), *ppos,
+	    MIN(*ppos + (loff_t)len, isize) - 1))
+		return (filemap_splice_read(in, ppos, pipe, len, flags));
+
+	return (copy_splice_read(in, ppos, pipe, len, flags));
+}
+#endif
+
 static inline ssize_t
 zpl_generic_write_checks(struct kiocb *kiocb, struct iov_iter *from,
     size_t *countp)
@@ -691,6 +755,10 @@ zpl_fadvise(struct file *filp, loff_t offset, loff_t len, int advice)
 	if ((error = zpl_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
 		return (error);
 
+	/*
+	 * The access pattern hints are kept by the object's prefetcher, so
+	 * they apply to all opens of the file rather than to this one only.
+	 */
 	switch (advice) {
 	case POSIX_FADV_SEQUENTIAL:
 	case POSIX_FADV_WILLNEED:
@@ -698,6 +766,9 @@ zpl_fadvise(struct file *filp, loff_t offset, loff_t len, int advice)
 		if (zn_has_cached_data(zp, offset, offset + len - 1))
 			error = generic_fadvise(filp, offset, len, advice);
 #endif
+		if (advice == POSIX_FADV_SEQUENTIAL)
+			(void) dmu_object_set_advice(os, zp->z_id,
+			    DMU_ADVICE_SEQUENTIAL);
 		/*
 		 * Pass on the caller's size directly, but note that
 		 * dmu_prefetch_max will effectively cap it.  If there
@@ -712,7 +783,23 @@ zpl_fadvise(struct file *filp, loff_t offset, loff_t len, int advice)
 		break;
 	case POSIX_FADV_NORMAL:
 	case POSIX_FADV_RANDOM:
+#ifdef HAVE_GENERIC_FADVISE
+		error = generic_fadvise(filp, offset, len, advice);
+#endif
+		(void) dmu_object_set_advice(os, zp->z_id,
+		    advice == POSIX_FADV_RANDOM ? DMU_ADVICE_RANDOM :
+		    DMU_ADVICE_NORMAL);
+		break;
 	case POSIX_FADV_DONTNEED:
+#ifdef HAVE_GENERIC_FADVISE
+		if (zn_has_cached_data(zp, offset, offset + len - 1))
+			error = generic_fadvise(filp, offset, len, advice);
+#endif
+		if (len == 0)
+			len = i_size_read(ip) - offset;
+
+		dmu_uncache_range(os, zp->z_id, offset, len);
+		break;
 	case POSIX_FADV_NOREUSE:
 		/* ignored for now */
 		break;
@@ -1026,6 +1113,8 @@ zpl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		return (zpl_ioctl_setdosflags(filp, (void *)arg));
 	case ZFS_IOC_REWRITE:
 		return (zpl_ioctl_rewrite(filp, (void *)arg));
+	case ZFS_IOC_CLONE_BATCH:
+		return (zpl_ioctl_clone_batch((void *)arg));
 	default:
 		return (-ENOTTY);
 	}
@@ -1085,7 +1174,9 @@ const struct file_operations zpl_file_operations = {
 	.llseek		= zpl_llseek,
 	.read_iter	= zpl_iter_read,
 	.write_iter	= zpl_iter_write,
-#ifdef HAVE_COPY_SPLICE_READ
+#if defined(HAVE_COPY_SPLICE_READ) && defined(HAVE_FILEMAP_SPLICE_READ)
+	.splice_read	= zpl_splice_read,
+#elif defined(HAVE_COPY_SPLICE_READ)
 	.splice_read	= copy_splice_read,
 #else
 	.splice_read	= generic_file_splice_read,
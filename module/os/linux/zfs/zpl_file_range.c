@@ -212,3 +212,139 @@ zpl_dedupe_file_range(struct file *src_file, loff_t src_off,
 	return (-EOPNOTSUPP);
 }
 #endif /* HAVE_VFS_DEDUPE_FILE_RANGE */
+
+/*
+ * Clone one entry of a ZFS_IOC_CLONE_BATCH request.  It goes through
+ * vfs_clone_file_range() like FICLONERANGE does, which does the permission,
+ * security and lease checks, takes freeze protection on the destination and
+ * generates the fsnotify events before calling zpl_remap_file_range().
+ * Unlike FICLONERANGE, the clone may come up short, in which case zcre_len
+ * says how much was cloned.
+ */
+static int
+zpl_clone_batch_ent(zfs_clone_range_ent_t *ent)
+{
+	struct file *src_file, *dst_file;
+	loff_t len;
+	loff_t ret;
+
+	if (ent->zcre_src_fd < 0 || ent->zcre_src_fd > INT_MAX ||
+	    ent->zcre_dst_fd < 0 || ent->zcre_dst_fd > INT_MAX)
+		return (EBADF);
+
+	if ((src_file = fget(ent->zcre_src_fd)) == NULL)
+		return (EBADF);
+	if ((dst_file = fget(ent->zcre_dst_fd)) == NULL) {
+		fput(src_file);
+		return (EBADF);
+	}
+
+	/* Don't let the batch clone on other file systems. */
+	if (src_file->f_op != &zpl_file_operations ||
+	    dst_file->f_op != &zpl_file_operations) {
+		ret = -EXDEV;
+		goto out;
+	}
+	if (ent->zcre_src_off > MAXOFFSET_T ||
+	    ent->zcre_dst_off > MAXOFFSET_T ||
+	    ent->zcre_len > MAXOFFSET_T ||
+	    ent->zcre_src_off > i_size_read(file_inode(src_file))) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* Zero length means to clone everything to the end of the file */
+	len = ent->zcre_len;
+	if (len == 0)
+		len = i_size_read(file_inode(src_file)) - ent->zcre_src_off;
+	if (len == 0) {
+		ret = 0;
+		goto out;
+	}
+
+#if defined(HAVE_VFS_REMAP_FILE_RANGE)
+	ret = vfs_clone_file_range(src_file, ent->zcre_src_off,
+	    dst_file, ent->zcre_dst_off, len, REMAP_FILE_CAN_SHORTEN);
+#elif defined(HAVE_VFS_CLONE_FILE_RANGE)
+	ret = vfs_clone_file_range(src_file, ent->zcre_src_off,
+	    dst_file, ent->zcre_dst_off, len);
+	if (ret == 0)
+		ret = len;
+#else
+	ret = -EOPNOTSUPP;
+#endif
+out:
+	fput(dst_file);
+	fput(src_file);
+	if (ret < 0)
+		return (-ret);
+	ent->zcre_len = ret;
+	return (0);
+}
+
+#define	ZPL_CLONE_BATCH_CHUNK	64
+
+/*
+ * Entry point for ZFS_IOC_CLONE_BATCH.  Copying a tree of small files with
+ * copy_file_range() is dominated by the per-call overhead, so take a whole
+ * vector of ranges with one syscall.  Each range is still cloned by
+ * zfs_clone_range() in its own transaction, since it has to take the range
+ * locks and possibly grow the block size of its destination file, but they
+ * all normally land in the same TXG and the BRT applies them together.
+ */
+long
+zpl_ioctl_clone_batch(void __user *arg)
+{
+	zfs_clone_batch_args_t args;
+	zfs_clone_range_ent_t *ents;
+	zfs_clone_range_ent_t __user *uents;
+	uint64_t done = 0;
+	int err = 0;
+
+	if (copy_from_user(&args, arg, sizeof (args)))
+		return (-EFAULT);
+
+	if (args.zcba_flags != 0 || args.zcba_count > ZFS_CLONE_BATCH_MAX)
+		return (-EINVAL);
+
+	uents = (zfs_clone_range_ent_t __user *)(uintptr_t)args.zcba_ents;
+	ents = kmem_alloc(sizeof (*ents) * ZPL_CLONE_BATCH_CHUNK, KM_SLEEP);
+
+	while (done < args.zcba_count) {
+		uint64_t n = MIN(args.zcba_count - done, ZPL_CLONE_BATCH_CHUNK);
+
+		if (copy_from_user(ents, &uents[done], sizeof (*ents) * n)) {
+			err = -EFAULT;
+			break;
+		}
+
+		uint64_t i;
+		for (i = 0; i < n; i++) {
+			ents[i].zcre_error = zpl_clone_batch_ent(&ents[i]);
+			if (ents[i].zcre_error != 0)
+				ents[i].zcre_len = 0;
+			if (ents[i].zcre_error == EINTR || issig()) {
+				err = -EINTR;
+				i++;
+				break;
+			}
+		}
+
+		if (copy_to_user(&uents[done], ents, sizeof (*ents) * i)) {
+			err = -EFAULT;
+			break;
+		}
+		done += i;
+		if (err != 0)
+			break;
+	}
+
+	kmem_free(ents, sizeof (*ents) * ZPL_CLONE_BATCH_CHUNK);
+
+	/* Report progress even if we were interrupted. */
+	args.zcba_done = done;
+	if (copy_to_user(arg, &args, sizeof (args)))
+		return (-EFAULT);
+
+	return (err);
+}
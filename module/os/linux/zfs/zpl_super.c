@@ -370,32 +370,54 @@ zpl_kill_sb(struct super_block *sb)
 	kill_anon_super(sb);
 }
 
+/*
+ * Take s_umount for reading if the superblock is live, i.e. neither being
+ * set up nor torn down.  Returns B_FALSE without the lock otherwise.
+ */
+static boolean_t
+zpl_sb_enter(struct super_block *sb)
+{
+	if (!down_read_trylock(&sb->s_umount))
+		return (B_FALSE);
+
+#ifdef HAVE_SB_DYING
+	if (!(sb->s_flags & SB_DYING) && sb->s_root &&
+	    (sb->s_flags & SB_BORN))
+		return (B_TRUE);
+#else
+	if (!hlist_unhashed(&sb->s_instances) &&
+	    sb->s_root && (sb->s_flags & SB_BORN))
+		return (B_TRUE);
+#endif
+
+	up_read(&sb->s_umount);
+	return (B_FALSE);
+}
+
 void
 zpl_prune_sb(uint64_t nr_to_scan, void *arg)
 {
 	struct super_block *sb = (struct super_block *)arg;
 	int objects = 0;
 
-	/*
-	 * Ensure the superblock is not in the process of being torn down.
-	 */
-#ifdef HAVE_SB_DYING
-	if (down_read_trylock(&sb->s_umount)) {
-		if (!(sb->s_flags & SB_DYING) && sb->s_root &&
-		    (sb->s_flags & SB_BORN)) {
-			(void) zfs_prune(sb, nr_to_scan, &objects);
-		}
+	if (zpl_sb_enter(sb)) {
+		(void) zfs_prune(sb, nr_to_scan, &objects);
 		up_read(&sb->s_umount);
 	}
-#else
-	if (down_read_trylock(&sb->s_umount)) {
-		if (!hlist_unhashed(&sb->s_instances) &&
-		    sb->s_root && (sb->s_flags & SB_BORN)) {
-			(void) zfs_prune(sb, nr_to_scan, &objects);
-		}
+}
+
+uint64_t
+zpl_prune_count_sb(void *arg)
+{
+	struct super_block *sb = (struct super_block *)arg;
+	uint64_t count = 0;
+
+	if (zpl_sb_enter(sb)) {
+		count = zfs_prune_count(sb);
 		up_read(&sb->s_umount);
 	}
-#endif
+
+	return (count);
 }
 
 const struct super_operations zpl_super_operations = {
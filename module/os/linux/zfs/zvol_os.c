@@ -53,6 +53,8 @@ static void zvol_request_impl(zvol_state_t *zv, struct bio *bio,
 static unsigned int zvol_major = ZVOL_MAJOR;
 static unsigned int zvol_prefetch_bytes = (128 * 1024);
 static unsigned long zvol_max_discard_blocks = 16384;
+static unsigned int zvol_discard_batch = 0;
+static unsigned int zvol_write_arcbuf = 0;
 
 #ifndef HAVE_BLKDEV_GET_ERESTARTSYS
 static unsigned int zvol_open_timeout_ms = 1000;
@@ -105,8 +107,29 @@ struct zvol_state_os {
 
 	/* Set from the global 'zvol_use_blk_mq' at zvol load */
 	boolean_t use_blk_mq;
+
+	/* Discards waiting for the batch in progress, see zvol_discard_task */
+	kmutex_t		zvo_discard_lock;
+	list_t			zvo_discard_list;
+	boolean_t		zvo_discard_active;
 };
 
+typedef struct zvol_discard_ent {
+	zv_request_task_t	*zde_task;
+	uint64_t		zde_start;	/* aligned range to free */
+	uint64_t		zde_end;
+	unsigned long		zde_start_time;
+	boolean_t		zde_acct;
+	boolean_t		zde_sync;
+	list_node_t		zde_node;
+} zvol_discard_ent_t;
+
+typedef struct zvol_discard_range {
+	uint64_t		zdr_start;
+	uint64_t		zdr_end;
+	zfs_locked_range_t	*zdr_lr;
+} zvol_discard_range_t;
+
 static struct ida zvol_ida;
 
 /*
@@ -188,6 +211,43 @@ zvol_os_is_zvol(const char *path)
 	return (B_FALSE);
 }
 
+/* Most blocks copied into loaned ARC buffers per tx, see zvol_write_loan */
+#define	ZVOL_LOAN_MAX_BLOCKS	32
+
+/*
+ * Copy a run of whole volblocksize blocks from the request into loaned ARC
+ * buffers before the tx is assigned.  dmu_assign_arcbuf_by_dnode() then
+ * hands each buffer to its dbuf without a second copy, and the copy is not
+ * made while holding the txg open.  The request uio is not advanced.
+ */
+static int
+zvol_write_loan(zvol_state_t *zv, zfs_uio_t *uio, uint64_t bytes,
+    arc_buf_t **abufs)
+{
+	spa_t *spa = dmu_objset_spa(zv->zv_objset);
+	uint64_t bs = zv->zv_volblocksize;
+	uint_t nbufs = bytes / bs;
+	zfs_uio_t uio_copy;
+	int error = 0;
+
+	ASSERT3U(uio->uio_segflg, ==, UIO_BVEC);
+	ASSERT3U(nbufs, <=, ZVOL_LOAN_MAX_BLOCKS);
+	memcpy(&uio_copy, uio, sizeof (zfs_uio_t));
+
+	for (uint_t i = 0; i < nbufs; i++) {
+		abufs[i] = arc_loan_buf(spa, B_FALSE, bs);
+		error = zfs_uiomove(abufs[i]->b_data, bs, UIO_WRITE,
+		    &uio_copy);
+		if (error != 0) {
+			for (int j = i; j >= 0; j--)
+				dmu_return_arcbuf(abufs[j]);
+			break;
+		}
+	}
+
+	return (error);
+}
+
 static void
 zvol_write(zv_request_t *zvr)
 {
@@ -200,6 +260,7 @@ zvol_write(zv_request_t *zvr)
 	struct gendisk *disk;
 	unsigned long start_time = 0;
 	boolean_t acct = B_FALSE;
+	hrtime_t start = dataset_kstats_start(&zv->zv_kstat);
 
 	ASSERT3P(zv, !=, NULL);
 	ASSERT3U(zv->zv_open_count, >, 0);
@@ -209,8 +270,11 @@ zvol_write(zv_request_t *zvr)
 	disk = zv->zv_zso->zvo_disk;
 
 	/* bio marked as FLUSH need to flush before write */
-	if (io_is_flush(bio, rq))
+	if (io_is_flush(bio, rq)) {
 		zil_commit(zv->zv_zilog, ZVOL_OBJ);
+		dataset_kstats_update_histograms(&zv->zv_kstat,
+		    DATASET_OP_SYNC, 0, start);
+	}
 
 	/* Some requests are just for flush and nothing else. */
 	if (io_size(bio, rq) == 0) {
@@ -235,6 +299,8 @@ zvol_write(zv_request_t *zvr)
 		}
 	}
 
+	zfs_qos_charge(&zv->zv_objset->os_qos, B_TRUE, start_resid);
+
 	boolean_t sync =
 	    io_is_fua(bio, rq) || zv->zv_objset->os_sync == ZFS_SYNC_ALWAYS;
 
@@ -242,24 +308,63 @@ zvol_write(zv_request_t *zvr)
 	    uio.uio_loffset, uio.uio_resid, RL_WRITER);
 
 	uint64_t volsize = zv->zv_volsize;
+	uint64_t bs = zv->zv_volblocksize;
 	while (uio.uio_resid > 0 && uio.uio_loffset < volsize) {
 		uint64_t bytes = MIN(uio.uio_resid, DMU_MAX_ACCESS >> 1);
 		uint64_t off = uio.uio_loffset;
-		dmu_tx_t *tx = dmu_tx_create(zv->zv_objset);
+		arc_buf_t *abufs[ZVOL_LOAN_MAX_BLOCKS];
+		boolean_t loaned = B_FALSE;
 
 		if (bytes > volsize - off)	/* don't write past the end */
 			bytes = volsize - off;
 
+		/*
+		 * Whole blocks go through loaned ARC buffers.  A partial
+		 * head or tail block is written on its own so the blocks
+		 * between them stay aligned.
+		 */
+		if (zvol_write_arcbuf && bytes > bs) {
+			if (P2PHASE(off, bs) != 0) {
+				bytes = bs - P2PHASE(off, bs);
+			} else {
+				bytes = MIN(P2ALIGN_TYPED(bytes, bs, uint64_t),
+				    ZVOL_LOAN_MAX_BLOCKS * bs);
+				error = zvol_write_loan(zv, &uio, bytes, abufs);
+				if (error)
+					break;
+				loaned = B_TRUE;
+			}
+		}
+
+		dmu_tx_t *tx = dmu_tx_create(zv->zv_objset);
 		dmu_tx_hold_write_by_dnode(tx, zv->zv_dn, off, bytes);
 
 		/* This will only fail for ENOSPC */
 		error = dmu_tx_assign(tx, DMU_TX_WAIT);
 		if (error) {
 			dmu_tx_abort(tx);
+			for (uint_t i = 0; loaned && i < bytes / bs; i++)
+				dmu_return_arcbuf(abufs[i]);
 			break;
 		}
-		error = dmu_write_uio_dnode(zv->zv_dn, &uio, bytes, tx,
-		    DMU_READ_PREFETCH);
+		if (loaned) {
+			for (uint_t i = 0; i < bytes / bs; i++) {
+				if (error != 0) {
+					dmu_return_arcbuf(abufs[i]);
+					continue;
+				}
+				error = dmu_assign_arcbuf_by_dnode(zv->zv_dn,
+				    off + i * bs, abufs[i], tx,
+				    DMU_READ_PREFETCH);
+				if (error != 0)
+					dmu_return_arcbuf(abufs[i]);
+			}
+			if (error == 0)
+				zfs_uioskip(&uio, bytes);
+		} else {
+			error = dmu_write_uio_dnode(zv->zv_dn, &uio, bytes, tx,
+			    DMU_READ_PREFETCH);
+		}
 		if (error == 0) {
 			zvol_log_write(zv, tx, off, bytes, sync);
 		}
@@ -276,6 +381,8 @@ zvol_write(zv_request_t *zvr)
 
 	if (sync)
 		zil_commit(zv->zv_zilog, ZVOL_OBJ);
+	dataset_kstats_update_histograms(&zv->zv_kstat, DATASET_OP_WRITE,
+	    nwritten, start);
 
 	rw_exit(&zv->zv_suspend_lock);
 
@@ -375,12 +482,166 @@ unlock:
 	zvol_end_io(bio, rq, -error);
 }
 
+/*
+ * Free a batch of discards sorted by offset.  Overlapping and adjacent
+ * ranges are merged, all of them are logged in a single tx, and every
+ * request in the batch completes with the same error.
+ */
+static void
+zvol_discard_batch_free(zvol_state_t *zv, list_t *batch, uint_t count)
+{
+	struct request_queue *q = zv->zv_zso->zvo_queue;
+	struct gendisk *disk = zv->zv_zso->zvo_disk;
+	zvol_discard_range_t *zdr;
+	zvol_discard_ent_t *zde;
+	boolean_t sync = B_FALSE;
+	uint_t nranges = 0;
+	int error = 0;
+
+	zdr = kmem_alloc(count * sizeof (zvol_discard_range_t), KM_SLEEP);
+	for (zde = list_head(batch); zde != NULL;
+	    zde = list_next(batch, zde)) {
+		sync |= zde->zde_sync;
+		if (zde->zde_start >= zde->zde_end)
+			continue;
+		if (nranges > 0 &&
+		    zde->zde_start <= zdr[nranges - 1].zdr_end) {
+			zdr[nranges - 1].zdr_end = MAX(zdr[nranges - 1].zdr_end,
+			    zde->zde_end);
+		} else {
+			zdr[nranges].zdr_start = zde->zde_start;
+			zdr[nranges].zdr_end = zde->zde_end;
+			nranges++;
+		}
+	}
+
+	if (nranges > 0) {
+		/* Ranges are disjoint and ascending, so this cannot deadlock */
+		for (uint_t i = 0; i < nranges; i++) {
+			zdr[i].zdr_lr = zfs_rangelock_enter(&zv->zv_rangelock,
+			    zdr[i].zdr_start, zdr[i].zdr_end - zdr[i].zdr_start,
+			    RL_WRITER);
+		}
+
+		dmu_tx_t *tx = dmu_tx_create(zv->zv_objset);
+		dmu_tx_mark_netfree(tx);
+		error = dmu_tx_assign(tx, DMU_TX_WAIT);
+		if (error != 0) {
+			dmu_tx_abort(tx);
+		} else {
+			for (uint_t i = 0; i < nranges; i++) {
+				zvol_log_truncate(zv, tx, zdr[i].zdr_start,
+				    zdr[i].zdr_end - zdr[i].zdr_start);
+			}
+			dmu_tx_commit(tx);
+			for (uint_t i = 0; i < nranges && error == 0; i++) {
+				error = dmu_free_long_range(zv->zv_objset,
+				    ZVOL_OBJ, zdr[i].zdr_start,
+				    zdr[i].zdr_end - zdr[i].zdr_start);
+			}
+		}
+
+		for (uint_t i = 0; i < nranges; i++)
+			zfs_rangelock_exit(zdr[i].zdr_lr);
+
+		if (error == 0 && sync)
+			zil_commit(zv->zv_zilog, ZVOL_OBJ);
+	}
+	kmem_free(zdr, count * sizeof (zvol_discard_range_t));
+
+	while ((zde = list_remove_head(batch)) != NULL) {
+		zv_request_t *zvr = &zde->zde_task->zvr;
+
+		if (zvr->bio && zde->zde_acct) {
+			blk_generic_end_io_acct(q, disk, WRITE, zvr->bio,
+			    zde->zde_start_time);
+		}
+		zvol_end_io(zvr->bio, zvr->rq, -error);
+		zv_request_task_free(zde->zde_task);
+		kmem_free(zde, sizeof (zvol_discard_ent_t));
+	}
+}
+
+/*
+ * Guests trimming a filesystem send floods of small discards, and freeing
+ * each of them in its own tx stalls the zvol taskqs.  When batching is
+ * enabled, a discard is queued on the zvol, and the first thread to find no
+ * batch in progress frees everything queued, zvol_discard_batch requests at
+ * a time, until the queue is empty.  Other threads just queue their request
+ * and return.  The batching thread holds zv_suspend_lock as reader for the
+ * whole time, so the zvol cannot be suspended under queued requests.
+ */
 static void
 zvol_discard_task(void *arg)
 {
 	zv_request_task_t *task = arg;
-	zvol_discard(&task->zvr);
-	zv_request_task_free(task);
+	zv_request_t *zvr = &task->zvr;
+	zvol_state_t *zv = zvr->zv;
+	struct zvol_state_os *zso = zv->zv_zso;
+	uint64_t start = io_offset(zvr->bio, zvr->rq);
+	uint64_t end = start + io_size(zvr->bio, zvr->rq);
+
+	if (zvol_discard_batch <= 1 || io_is_secure_erase(zvr->bio, zvr->rq) ||
+	    end > zv->zv_volsize) {
+		zvol_discard(zvr);
+		zv_request_task_free(task);
+		return;
+	}
+
+	zvol_discard_ent_t *zde = kmem_alloc(sizeof (*zde), KM_SLEEP);
+	zde->zde_task = task;
+	zde->zde_start = P2ROUNDUP(start, zv->zv_volblocksize);
+	zde->zde_end = P2ALIGN_TYPED(end, zv->zv_volblocksize, uint64_t);
+	zde->zde_sync = io_is_fua(zvr->bio, zvr->rq) ||
+	    zv->zv_objset->os_sync == ZFS_SYNC_ALWAYS;
+	zde->zde_acct = B_FALSE;
+	zde->zde_start_time = 0;
+	if (zvr->bio) {
+		zde->zde_acct = blk_queue_io_stat(zso->zvo_queue);
+		if (zde->zde_acct) {
+			zde->zde_start_time = blk_generic_start_io_acct(
+			    zso->zvo_queue, zso->zvo_disk, WRITE, zvr->bio);
+		}
+	}
+
+	mutex_enter(&zso->zvo_discard_lock);
+	list_insert_tail(&zso->zvo_discard_list, zde);
+	if (zso->zvo_discard_active) {
+		mutex_exit(&zso->zvo_discard_lock);
+		rw_exit(&zv->zv_suspend_lock);
+		return;
+	}
+	zso->zvo_discard_active = B_TRUE;
+
+	list_t batch;
+	list_create(&batch, sizeof (zvol_discard_ent_t),
+	    offsetof(zvol_discard_ent_t, zde_node));
+	while (!list_is_empty(&zso->zvo_discard_list)) {
+		uint_t count = 0;
+
+		/* Insertion sort by offset, the batch is small */
+		while (count < zvol_discard_batch &&
+		    (zde = list_remove_head(&zso->zvo_discard_list)) != NULL) {
+			zvol_discard_ent_t *prev = list_tail(&batch);
+			while (prev != NULL && prev->zde_start > zde->zde_start)
+				prev = list_prev(&batch, prev);
+			if (prev == NULL)
+				list_insert_head(&batch, zde);
+			else
+				list_insert_after(&batch, prev, zde);
+			count++;
+		}
+		mutex_exit(&zso->zvo_discard_lock);
+
+		zvol_discard_batch_free(zv, &batch, count);
+
+		mutex_enter(&zso->zvo_discard_lock);
+	}
+	list_destroy(&batch);
+	zso->zvo_discard_active = B_FALSE;
+	mutex_exit(&zso->zvo_discard_lock);
+
+	rw_exit(&zv->zv_suspend_lock);
 }
 
 static void
@@ -395,6 +656,7 @@ zvol_read(zv_request_t *zvr)
 	struct request_queue *q;
 	struct gendisk *disk;
 	unsigned long start_time = 0;
+	hrtime_t start = dataset_kstats_start(&zv->zv_kstat);
 
 	ASSERT3P(zv, !=, NULL);
 	ASSERT3U(zv->zv_open_count, >, 0);
@@ -417,6 +679,8 @@ zvol_read(zv_request_t *zvr)
 			    bio);
 	}
 
+	zfs_qos_charge(&zv->zv_objset->os_qos, B_FALSE, start_resid);
+
 	zfs_locked_range_t *lr = zfs_rangelock_enter(&zv->zv_rangelock,
 	    uio.uio_loffset, uio.uio_resid, RL_READER);
 
@@ -442,6 +706,8 @@ zvol_read(zv_request_t *zvr)
 
 	int64_t nread = start_resid - uio.uio_resid;
 	dataset_kstats_update_read_kstats(&zv->zv_kstat, nread);
+	dataset_kstats_update_histograms(&zv->zv_kstat, DATASET_OP_READ,
+	    nread, start);
 	task_io_account_read(nread);
 
 	rw_exit(&zv->zv_suspend_lock);
@@ -595,6 +861,7 @@ zvol_request_impl(zvol_state_t *zv, struct bio *bio, struct request *rq,
 			if (force_sync) {
 				zvol_write(&zvr);
 			} else {
+				zvol_prefetch_partial(zv, offset, size);
 				task = zv_request_task_create(zvr);
 				taskq_dispatch_ent(ztqs->tqs_taskq[tq_idx],
 				    zvol_write_task, task, 0, &task->ent);
@@ -1323,6 +1590,9 @@ zvol_alloc(dev_t dev, const char *name, uint64_t volblocksize)
 	zv = kmem_zalloc(sizeof (zvol_state_t), KM_SLEEP);
 	zso = kmem_zalloc(sizeof (struct zvol_state_os), KM_SLEEP);
 	zv->zv_zso = zso;
+	mutex_init(&zso->zvo_discard_lock, NULL, MUTEX_DEFAULT, NULL);
+	list_create(&zso->zvo_discard_list, sizeof (zvol_discard_ent_t),
+	    offsetof(zvol_discard_ent_t, zde_node));
 	zv->zv_volmode = volmode;
 	zv->zv_volblocksize = volblocksize;
 
@@ -1398,6 +1668,8 @@ zvol_alloc(dev_t dev, const char *name, uint64_t volblocksize)
 	return (zv);
 
 out_kmem:
+	list_destroy(&zso->zvo_discard_list);
+	mutex_destroy(&zso->zvo_discard_lock);
 	kmem_free(zso, sizeof (struct zvol_state_os));
 	kmem_free(zv, sizeof (zvol_state_t));
 	return (NULL);
@@ -1448,6 +1720,8 @@ zvol_os_free(zvol_state_t *zv)
 	cv_destroy(&zv->zv_removing_cv);
 	mutex_destroy(&zv->zv_state_lock);
 	dataset_kstats_destroy(&zv->zv_kstat);
+	list_destroy(&zv->zv_zso->zvo_discard_list);
+	mutex_destroy(&zv->zv_zso->zvo_discard_lock);
 
 	kmem_free(zv->zv_zso, sizeof (struct zvol_state_os));
 	kmem_free(zv, sizeof (zvol_state_t));
@@ -1797,6 +2071,13 @@ MODULE_PARM_DESC(zvol_major, "Major number for zvol device");
 module_param(zvol_max_discard_blocks, ulong, 0444);
 MODULE_PARM_DESC(zvol_max_discard_blocks, "Max number of blocks to discard");
 
+module_param(zvol_discard_batch, uint, 0644);
+MODULE_PARM_DESC(zvol_discard_batch, "Max discards to merge and free at once");
+
+module_param(zvol_write_arcbuf, uint, 0644);
+MODULE_PARM_DESC(zvol_write_arcbuf,
+	"Copy whole-block zvol writes into loaned ARC buffers");
+
 module_param(zvol_prefetch_bytes, uint, 0644);
 MODULE_PARM_DESC(zvol_prefetch_bytes, "Prefetch N bytes at zvol start+end");
 
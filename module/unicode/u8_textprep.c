@@ -327,6 +327,36 @@ static const uint8_t u8_valid_max_2nd_byte[0x100] = {
 };
 
 
+/*
+ * Return the length of the run of 7-bit ASCII characters at the start of
+ * s, looking at no more than n bytes and, if stop_at_null is set, stopping
+ * at a null byte.  Names are mostly ASCII, so this checks a word at a time.
+ */
+static size_t
+u8_ascii_run(const uchar_t *s, size_t n, boolean_t stop_at_null)
+{
+	const uint64_t high = 0x8080808080808080ULL;
+	const uint64_t low = 0x0101010101010101ULL;
+	size_t i;
+
+	for (i = 0; i + sizeof (uint64_t) <= n; i += sizeof (uint64_t)) {
+		uint64_t v;
+
+		memcpy(&v, s + i, sizeof (v));
+		if (v & high)
+			break;
+		/* Is any of the bytes zero? */
+		if (stop_at_null && ((v - low) & ~v & high))
+			break;
+	}
+	for (; i < n; i++) {
+		if (!U8_ISASCII(s[i]) || (stop_at_null && s[i] == '\0'))
+			break;
+	}
+
+	return (i);
+}
+
 /*
  * The u8_validate() validates on the given UTF-8 character string and
  * calculate the byte length. It is quite similar to mblen(3C) except that
@@ -362,6 +392,16 @@ u8_validate(const char *u8str, size_t n, char **list, int flag, int *errnum)
 	check_additional = flag & U8_VALIDATE_CHECK_ADDITIONAL;
 	validate_ucs2_range_only = flag & U8_VALIDATE_UCS2_RANGE;
 
+	/*
+	 * ASCII characters are always valid, and unless we have to check
+	 * them against the list, we can skip over them in bulk.
+	 */
+	if (!no_need_to_validate_entire && !check_additional) {
+		i = u8_ascii_run(ib, n, B_FALSE);
+		ib += i;
+		ret_val += i;
+	}
+
 	while (ib < ibtail) {
 		/*
 		 * The first byte of a UTF-8 character tells how many
@@ -2006,6 +2046,30 @@ u8_textprep_str(char *inarray, size_t *inlen, char *outarray, size_t *outlen,
 
 	ret_val = 0;
 
+	/*
+	 * Normalization leaves 7-bit ASCII characters alone and the case
+	 * conversions only map them within ASCII, so a leading run of them
+	 * is copied over directly, which for most names is the whole name.
+	 * Unless the run reaches the end of the input, its last character
+	 * is left to the loops below, as it may start a sequence with a
+	 * combining character that follows it.
+	 */
+	j = u8_ascii_run(ib, ibtail - ib, do_not_ignore_null);
+	if (j > 0 && j < (size_t)(ibtail - ib))
+		j--;
+	j = MIN(j, (size_t)(obtail - ob));
+	if (is_it_toupper) {
+		for (i = 0; i < j; i++)
+			ob[i] = U8_ASCII_TOUPPER(ib[i]);
+	} else if (is_it_tolower) {
+		for (i = 0; i < j; i++)
+			ob[i] = U8_ASCII_TOLOWER(ib[i]);
+	} else {
+		memcpy(ob, ib, j);
+	}
+	ib += j;
+	ob += j;
+
 	/*
 	 * If we don't have a normalization flag set, we do the simple case
 	 * conversion based text preparation separately below. Text
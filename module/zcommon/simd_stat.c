@@ -104,6 +104,12 @@ simd_stat_kstat_data(char *buf, size_t size, void *data)
 		    "avx512ifma", zfs_avx512ifma_available());
 		off += SIMD_STAT_PRINT(simd_stat_kstat_payload,
 		    "avx512vbmi", zfs_avx512vbmi_available());
+		off += SIMD_STAT_PRINT(simd_stat_kstat_payload,
+		    "gfni", zfs_gfni_available());
+		off += SIMD_STAT_PRINT(simd_stat_kstat_payload,
+		    "vaes", zfs_vaes_available());
+		off += SIMD_STAT_PRINT(simd_stat_kstat_payload,
+		    "vpclmulqdq", zfs_vpclmulqdq_available());
 		off += SIMD_STAT_PRINT(simd_stat_kstat_payload,
 		    "ymm", __ymm_enabled());
 		off += SIMD_STAT_PRINT(simd_stat_kstat_payload,
@@ -786,6 +786,55 @@ zpool_feature_init(void)
 		    ZFEATURE_TYPE_BOOLEAN, large_microzap_deps, sfeatures);
 	}
 
+	{
+		static const spa_feature_t chacha20_poly1305_deps[] = {
+			SPA_FEATURE_ENCRYPTION,
+			SPA_FEATURE_EXTENSIBLE_DATASET,
+			SPA_FEATURE_NONE
+		};
+		zfeature_register(SPA_FEATURE_CHACHA20_POLY1305,
+		    "org.openzfs:chacha20_poly1305", "chacha20_poly1305",
+		    "Support for ChaCha20-Poly1305 encryption.",
+		    ZFEATURE_FLAG_PER_DATASET, ZFEATURE_TYPE_BOOLEAN,
+		    chacha20_poly1305_deps, sfeatures);
+	}
+
+	{
+		static const spa_feature_t inline_data_deps[] = {
+			SPA_FEATURE_EXTENSIBLE_DATASET,
+			SPA_FEATURE_NONE
+		};
+		zfeature_register(SPA_FEATURE_INLINE_DATA,
+		    "org.openzfs:inline_data", "inline_data",
+		    "Support for file data stored in the dnode.",
+		    ZFEATURE_FLAG_PER_DATASET, ZFEATURE_TYPE_BOOLEAN,
+		    inline_data_deps, sfeatures);
+	}
+
+	{
+		static const spa_feature_t chunked_compress_deps[] = {
+			SPA_FEATURE_EXTENSIBLE_DATASET,
+			SPA_FEATURE_NONE
+		};
+		zfeature_register(SPA_FEATURE_CHUNKED_COMPRESS,
+		    "org.openzfs:chunked_compress", "chunked_compress",
+		    "Large blocks compressed in independent chunks.",
+		    ZFEATURE_FLAG_PER_DATASET, ZFEATURE_TYPE_BOOLEAN,
+		    chunked_compress_deps, sfeatures);
+	}
+
+	{
+		static const spa_feature_t dynamic_gang_header_deps[] = {
+			SPA_FEATURE_ENABLED_TXG,
+			SPA_FEATURE_NONE
+		};
+		zfeature_register(SPA_FEATURE_DYNAMIC_GANG_HEADER,
+		    "org.openzfs:dynamic_gang_header", "dynamic_gang_header",
+		    "Gang block headers fill a whole sector.",
+		    ZFEATURE_FLAG_MOS | ZFEATURE_FLAG_ACTIVATE_ON_ENABLE,
+		    ZFEATURE_TYPE_BOOLEAN, dynamic_gang_header_deps, sfeatures);
+	}
+
 	zfs_mod_list_supported_free(sfeatures);
 }
 
@@ -185,12 +185,14 @@ static const fletcher_4_ops_t *fletcher_4_impls[] = {
 #endif
 #if defined(__x86_64) && defined(HAVE_AVX512F)
 	&fletcher_4_avx512f_ops,
+	&fletcher_4_avx512fx2_ops,
 #endif
 #if defined(__x86_64) && defined(HAVE_AVX512BW)
 	&fletcher_4_avx512bw_ops,
 #endif
 #if defined(__aarch64__) && !defined(__FreeBSD__)
 	&fletcher_4_aarch64_neon_ops,
+	&fletcher_4_aarch64_neonx2_ops,
 #endif
 };
 
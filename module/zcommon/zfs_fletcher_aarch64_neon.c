@@ -189,6 +189,165 @@ unsigned char SRC __attribute__((vector_size(16)));
 	NEON_FINI_LOOP();
 }
 
+/*
+ * The aarch64_neonx2 variant keeps a second set of accumulators, so two
+ * independent dependency chains are in flight at any time. The first set
+ * sums up words 0 and 1 of every 16 bytes and the second one words 2 and
+ * 3, which makes them a 4 lane fletcher 4 together.
+ */
+static void
+fletcher_4_aarch64_neonx2_init(fletcher_4_ctx_t *ctx)
+{
+	memset(ctx->aarch64_neon, 0, 8 * sizeof (zfs_fletcher_aarch64_neon_t));
+}
+
+static void
+fletcher_4_aarch64_neonx2_fini(fletcher_4_ctx_t *ctx, zio_cksum_t *zcp)
+{
+	const zfs_fletcher_aarch64_neon_t *s0 = &ctx->aarch64_neon[0];
+	const zfs_fletcher_aarch64_neon_t *s1 = &ctx->aarch64_neon[4];
+	uint64_t A, B, C, D;
+
+	A = s0[0].v[0] + s0[0].v[1] + s1[0].v[0] + s1[0].v[1];
+	B = 4 * s0[1].v[0] + 4 * s0[1].v[1] + 4 * s1[1].v[0] +
+	    4 * s1[1].v[1] - s0[0].v[1] - 2 * s1[0].v[0] - 3 * s1[0].v[1];
+	C = 16 * s0[2].v[0] + 16 * s0[2].v[1] + 16 * s1[2].v[0] +
+	    16 * s1[2].v[1] - 6 * s0[1].v[0] - 10 * s0[1].v[1] -
+	    14 * s1[1].v[0] - 18 * s1[1].v[1] + s1[0].v[0] + 3 * s1[0].v[1];
+	D = 64 * s0[3].v[0] + 64 * s0[3].v[1] + 64 * s1[3].v[0] +
+	    64 * s1[3].v[1] - 48 * s0[2].v[0] - 64 * s0[2].v[1] -
+	    80 * s1[2].v[0] - 96 * s1[2].v[1] + 4 * s0[1].v[0] +
+	    10 * s0[1].v[1] + 20 * s1[1].v[0] + 34 * s1[1].v[1] - s1[0].v[1];
+	ZIO_SET_CHECKSUM(zcp, A, B, C, D);
+}
+
+#define	NEON_X2_INIT_LOOP()			\
+	asm("eor %[ZERO].16b,%[ZERO].16b,%[ZERO].16b\n"	\
+	"ld1 { %[ACC0].4s }, %[CTX0]\n"		\
+	"ld1 { %[ACC1].4s }, %[CTX1]\n"		\
+	"ld1 { %[ACC2].4s }, %[CTX2]\n"		\
+	"ld1 { %[ACC3].4s }, %[CTX3]\n"		\
+	"ld1 { %[ACC4].4s }, %[CTX4]\n"		\
+	"ld1 { %[ACC5].4s }, %[CTX5]\n"		\
+	"ld1 { %[ACC6].4s }, %[CTX6]\n"		\
+	"ld1 { %[ACC7].4s }, %[CTX7]\n"		\
+	: [ZERO] "=w" (ZERO),			\
+	[ACC0] "=w" (ACC0), [ACC1] "=w" (ACC1),	\
+	[ACC2] "=w" (ACC2), [ACC3] "=w" (ACC3),	\
+	[ACC4] "=w" (ACC4), [ACC5] "=w" (ACC5),	\
+	[ACC6] "=w" (ACC6), [ACC7] "=w" (ACC7)	\
+	: [CTX0] "Q" (ctx->aarch64_neon[0]),	\
+	[CTX1] "Q" (ctx->aarch64_neon[1]),	\
+	[CTX2] "Q" (ctx->aarch64_neon[2]),	\
+	[CTX3] "Q" (ctx->aarch64_neon[3]),	\
+	[CTX4] "Q" (ctx->aarch64_neon[4]),	\
+	[CTX5] "Q" (ctx->aarch64_neon[5]),	\
+	[CTX6] "Q" (ctx->aarch64_neon[6]),	\
+	[CTX7] "Q" (ctx->aarch64_neon[7]))
+
+#define	NEON_X2_MAIN_LOOP()				\
+	asm("ld1 { %[SRC].4s }, %[IP]\n"		\
+	"ld1 { %[SRC2].4s }, %[IP2]\n"			\
+	"zip1 %[TMP1].4s, %[SRC].4s, %[ZERO].4s\n"	\
+	"zip2 %[TMP2].4s, %[SRC].4s, %[ZERO].4s\n"	\
+	"zip1 %[TMP3].4s, %[SRC2].4s, %[ZERO].4s\n"	\
+	"zip2 %[TMP4].4s, %[SRC2].4s, %[ZERO].4s\n"	\
+	"add %[ACC0].2d, %[ACC0].2d, %[TMP1].2d\n"	\
+	"add %[ACC4].2d, %[ACC4].2d, %[TMP2].2d\n"	\
+	"add %[ACC1].2d, %[ACC1].2d, %[ACC0].2d\n"	\
+	"add %[ACC5].2d, %[ACC5].2d, %[ACC4].2d\n"	\
+	"add %[ACC2].2d, %[ACC2].2d, %[ACC1].2d\n"	\
+	"add %[ACC6].2d, %[ACC6].2d, %[ACC5].2d\n"	\
+	"add %[ACC3].2d, %[ACC3].2d, %[ACC2].2d\n"	\
+	"add %[ACC7].2d, %[ACC7].2d, %[ACC6].2d\n"	\
+	"add %[ACC0].2d, %[ACC0].2d, %[TMP3].2d\n"	\
+	"add %[ACC4].2d, %[ACC4].2d, %[TMP4].2d\n"	\
+	"add %[ACC1].2d, %[ACC1].2d, %[ACC0].2d\n"	\
+	"add %[ACC5].2d, %[ACC5].2d, %[ACC4].2d\n"	\
+	"add %[ACC2].2d, %[ACC2].2d, %[ACC1].2d\n"	\
+	"add %[ACC6].2d, %[ACC6].2d, %[ACC5].2d\n"	\
+	"add %[ACC3].2d, %[ACC3].2d, %[ACC2].2d\n"	\
+	"add %[ACC7].2d, %[ACC7].2d, %[ACC6].2d\n"	\
+	: [SRC] "=&w" (SRC), [SRC2] "=&w" (SRC2),	\
+	[TMP1] "=&w" (TMP1), [TMP2] "=&w" (TMP2),	\
+	[TMP3] "=&w" (TMP3), [TMP4] "=&w" (TMP4),	\
+	[ACC0] "+w" (ACC0), [ACC1] "+w" (ACC1),		\
+	[ACC2] "+w" (ACC2), [ACC3] "+w" (ACC3),		\
+	[ACC4] "+w" (ACC4), [ACC5] "+w" (ACC5),		\
+	[ACC6] "+w" (ACC6), [ACC7] "+w" (ACC7)		\
+	: [ZERO] "w" (ZERO), [IP] "Q" (ip[0]), [IP2] "Q" (ip[2]))
+
+#define	NEON_X2_FINI_LOOP()			\
+	asm("st1 { %[ACC0].4s },%[DST0]\n"	\
+	"st1 { %[ACC1].4s },%[DST1]\n"		\
+	"st1 { %[ACC2].4s },%[DST2]\n"		\
+	"st1 { %[ACC3].4s },%[DST3]\n"		\
+	"st1 { %[ACC4].4s },%[DST4]\n"		\
+	"st1 { %[ACC5].4s },%[DST5]\n"		\
+	"st1 { %[ACC6].4s },%[DST6]\n"		\
+	"st1 { %[ACC7].4s },%[DST7]\n"		\
+	: [DST0] "=Q" (ctx->aarch64_neon[0]),	\
+	[DST1] "=Q" (ctx->aarch64_neon[1]),	\
+	[DST2] "=Q" (ctx->aarch64_neon[2]),	\
+	[DST3] "=Q" (ctx->aarch64_neon[3]),	\
+	[DST4] "=Q" (ctx->aarch64_neon[4]),	\
+	[DST5] "=Q" (ctx->aarch64_neon[5]),	\
+	[DST6] "=Q" (ctx->aarch64_neon[6]),	\
+	[DST7] "=Q" (ctx->aarch64_neon[7])	\
+	: [ACC0] "w" (ACC0), [ACC1] "w" (ACC1),	\
+	[ACC2] "w" (ACC2), [ACC3] "w" (ACC3),	\
+	[ACC4] "w" (ACC4), [ACC5] "w" (ACC5),	\
+	[ACC6] "w" (ACC6), [ACC7] "w" (ACC7))
+
+static void
+fletcher_4_aarch64_neonx2_native(fletcher_4_ctx_t *ctx,
+    const void *buf, uint64_t size)
+{
+	const uint64_t *ip = buf;
+	const uint64_t *ipend = (uint64_t *)((uint8_t *)ip + size);
+#if defined(_KERNEL)
+register unsigned char ZERO asm("v0") __attribute__((vector_size(16)));
+register unsigned char ACC0 asm("v1") __attribute__((vector_size(16)));
+register unsigned char ACC1 asm("v2") __attribute__((vector_size(16)));
+register unsigned char ACC2 asm("v3") __attribute__((vector_size(16)));
+register unsigned char ACC3 asm("v4") __attribute__((vector_size(16)));
+register unsigned char TMP1 asm("v5") __attribute__((vector_size(16)));
+register unsigned char TMP2 asm("v6") __attribute__((vector_size(16)));
+register unsigned char SRC asm("v7") __attribute__((vector_size(16)));
+register unsigned char ACC4 asm("v16") __attribute__((vector_size(16)));
+register unsigned char ACC5 asm("v17") __attribute__((vector_size(16)));
+register unsigned char ACC6 asm("v18") __attribute__((vector_size(16)));
+register unsigned char ACC7 asm("v19") __attribute__((vector_size(16)));
+register unsigned char TMP3 asm("v20") __attribute__((vector_size(16)));
+register unsigned char TMP4 asm("v21") __attribute__((vector_size(16)));
+register unsigned char SRC2 asm("v22") __attribute__((vector_size(16)));
+#else
+unsigned char ZERO __attribute__((vector_size(16)));
+unsigned char ACC0 __attribute__((vector_size(16)));
+unsigned char ACC1 __attribute__((vector_size(16)));
+unsigned char ACC2 __attribute__((vector_size(16)));
+unsigned char ACC3 __attribute__((vector_size(16)));
+unsigned char TMP1 __attribute__((vector_size(16)));
+unsigned char TMP2 __attribute__((vector_size(16)));
+unsigned char SRC __attribute__((vector_size(16)));
+unsigned char ACC4 __attribute__((vector_size(16)));
+unsigned char ACC5 __attribute__((vector_size(16)));
+unsigned char ACC6 __attribute__((vector_size(16)));
+unsigned char ACC7 __attribute__((vector_size(16)));
+unsigned char TMP3 __attribute__((vector_size(16)));
+unsigned char TMP4 __attribute__((vector_size(16)));
+unsigned char SRC2 __attribute__((vector_size(16)));
+#endif
+
+	NEON_X2_INIT_LOOP();
+
+	do {
+		NEON_X2_MAIN_LOOP();
+	} while ((ip += 4) < ipend);
+
+	NEON_X2_FINI_LOOP();
+}
+
 static boolean_t fletcher_4_aarch64_neon_valid(void)
 {
 	return (kfpu_allowed());
@@ -206,4 +365,17 @@ const fletcher_4_ops_t fletcher_4_aarch64_neon_ops = {
 	.name = "aarch64_neon"
 };
 
+/* byteswapped blocks are rare, they keep using a single accumulator set */
+const fletcher_4_ops_t fletcher_4_aarch64_neonx2_ops = {
+	.init_native = fletcher_4_aarch64_neonx2_init,
+	.compute_native = fletcher_4_aarch64_neonx2_native,
+	.fini_native = fletcher_4_aarch64_neonx2_fini,
+	.init_byteswap = fletcher_4_aarch64_neon_init,
+	.compute_byteswap = fletcher_4_aarch64_neon_byteswap,
+	.fini_byteswap = fletcher_4_aarch64_neon_fini,
+	.valid = fletcher_4_aarch64_neon_valid,
+	.uses_fpu = B_TRUE,
+	.name = "aarch64_neonx2"
+};
+
 #endif /* defined(__aarch64__) */
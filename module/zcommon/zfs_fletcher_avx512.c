@@ -167,6 +167,111 @@ const fletcher_4_ops_t fletcher_4_avx512f_ops = {
 	.name = "avx512f"
 };
 
+/*
+ * The avx512fx2 variant keeps a second set of accumulators in zmm4-zmm7,
+ * so two independent dependency chains are in flight at any time. The
+ * first set sums up words 0-7 of every 64 byte block and the second one
+ * words 8-15, which makes them a 16 lane fletcher 4 together.
+ */
+static void
+fletcher_4_avx512fx2_init(fletcher_4_ctx_t *ctx)
+{
+	memset(ctx->avx512, 0, 8 * sizeof (zfs_fletcher_avx512_t));
+}
+
+static void
+fletcher_4_avx512fx2_fini(fletcher_4_ctx_t *ctx, zio_cksum_t *zcp)
+{
+	static const uint64_t
+	CcA[] = {    0,    0,    1,    3,    6,   10,   15,   21,
+	    28,   36,   45,   55,   66,   78,   91,  105 },
+	CcB[] = {  120,  136,  152,  168,  184,  200,  216,  232,
+	    248,  264,  280,  296,  312,  328,  344,  360 },
+	DcA[] = {    0,    0,    0,    1,    4,   10,   20,   35,
+	    56,   84,  120,  165,  220,  286,  364,  455 },
+	DcB[] = {  560,  680,  816,  968, 1136, 1320, 1520, 1736,
+	    1968, 2216, 2480, 2760, 3056, 3368, 3696, 4040 },
+	DcC[] = { 3840, 4096, 4352, 4608, 4864, 5120, 5376, 5632,
+	    5888, 6144, 6400, 6656, 6912, 7168, 7424, 7680 };
+
+	uint64_t A = 0, B = 0, C = 0, D = 0;
+	uint64_t a, b, c, d;
+	uint64_t i;
+
+	for (i = 0; i < 16; i++) {
+		const zfs_fletcher_avx512_t *set = &ctx->avx512[(i / 8) * 4];
+
+		a = set[0].v[i % 8];
+		b = set[1].v[i % 8];
+		c = set[2].v[i % 8];
+		d = set[3].v[i % 8];
+
+		A += a;
+		B += 16 * b - i * a;
+		C += 256 * c - CcB[i] * b + CcA[i] * a;
+		D += 4096 * d - DcC[i] * c + DcB[i] * b - DcA[i] * a;
+	}
+
+	ZIO_SET_CHECKSUM(zcp, A, B, C, D);
+}
+
+#define	FLETCHER_4_AVX512X2_RESTORE_CTX(ctx)				\
+{									\
+	FLETCHER_4_AVX512_RESTORE_CTX(ctx);				\
+	__asm("vmovdqu64 %0, %%zmm4" :: "m" ((ctx)->avx512[4]));	\
+	__asm("vmovdqu64 %0, %%zmm5" :: "m" ((ctx)->avx512[5]));	\
+	__asm("vmovdqu64 %0, %%zmm6" :: "m" ((ctx)->avx512[6]));	\
+	__asm("vmovdqu64 %0, %%zmm7" :: "m" ((ctx)->avx512[7]));	\
+}
+
+#define	FLETCHER_4_AVX512X2_SAVE_CTX(ctx)				\
+{									\
+	FLETCHER_4_AVX512_SAVE_CTX(ctx);				\
+	__asm("vmovdqu64 %%zmm4, %0" : "=m" ((ctx)->avx512[4]));	\
+	__asm("vmovdqu64 %%zmm5, %0" : "=m" ((ctx)->avx512[5]));	\
+	__asm("vmovdqu64 %%zmm6, %0" : "=m" ((ctx)->avx512[6]));	\
+	__asm("vmovdqu64 %%zmm7, %0" : "=m" ((ctx)->avx512[7]));	\
+}
+
+static void
+fletcher_4_avx512fx2_native(fletcher_4_ctx_t *ctx, const void *buf,
+    uint64_t size)
+{
+	const uint32_t *ip = buf;
+	const uint32_t *ipend = (uint32_t *)((uint8_t *)ip + size);
+
+	FLETCHER_4_AVX512X2_RESTORE_CTX(ctx);
+
+	do {
+		__asm("vpmovzxdq %0, %%zmm8"::"m" (ip[0]));
+		__asm("vpmovzxdq %0, %%zmm9"::"m" (ip[8]));
+		__asm("vpaddq %zmm8, %zmm0, %zmm0");
+		__asm("vpaddq %zmm9, %zmm4, %zmm4");
+		__asm("vpaddq %zmm0, %zmm1, %zmm1");
+		__asm("vpaddq %zmm4, %zmm5, %zmm5");
+		__asm("vpaddq %zmm1, %zmm2, %zmm2");
+		__asm("vpaddq %zmm5, %zmm6, %zmm6");
+		__asm("vpaddq %zmm2, %zmm3, %zmm3");
+		__asm("vpaddq %zmm6, %zmm7, %zmm7");
+	} while ((ip += 16) < ipend);
+
+	FLETCHER_4_AVX512X2_SAVE_CTX(ctx);
+}
+STACK_FRAME_NON_STANDARD(fletcher_4_avx512fx2_native);
+
+/* byteswapped blocks are rare, they keep using a single accumulator set */
+const fletcher_4_ops_t fletcher_4_avx512fx2_ops = {
+	.init_native = fletcher_4_avx512fx2_init,
+	.fini_native = fletcher_4_avx512fx2_fini,
+	.compute_native = fletcher_4_avx512fx2_native,
+	.init_byteswap = fletcher_4_avx512f_init,
+	.fini_byteswap = fletcher_4_avx512f_fini,
+	.compute_byteswap = fletcher_4_avx512f_byteswap,
+	.valid = fletcher_4_avx512f_valid,
+	.uses_fpu = B_TRUE,
+	.name = "avx512fx2"
+};
+
 #if defined(HAVE_AVX512BW)
 static void
 fletcher_4_avx512bw_byteswap(fletcher_4_ctx_t *ctx, const void *buf,
@@ -213,6 +213,7 @@ zfs_prop_init(void)
 		    ZIO_COMPLEVEL_ZSTD(ZIO_ZSTD_LEVEL_FAST_500) },
 		{ "zstd-fast-1000",
 		    ZIO_COMPLEVEL_ZSTD(ZIO_ZSTD_LEVEL_FAST_1000) },
+		{ "zstd-auto",	ZIO_COMPLEVEL_ZSTD(ZIO_ZSTD_LEVEL_AUTO) },
 		{ NULL }
 	};
 
@@ -225,6 +226,7 @@ zfs_prop_init(void)
 		{ "aes-128-gcm",	ZIO_CRYPT_AES_128_GCM },
 		{ "aes-192-gcm",	ZIO_CRYPT_AES_192_GCM },
 		{ "aes-256-gcm",	ZIO_CRYPT_AES_256_GCM },
+		{ "chacha20-poly1305",	ZIO_CRYPT_CHACHA20_POLY1305 },
 		{ NULL }
 	};
 
@@ -355,6 +357,12 @@ zfs_prop_init(void)
 		{ NULL }
 	};
 
+	static const zprop_index_t arc_priority_table[] = {
+		{ "low",	ZFS_ARC_PRIORITY_LOW },
+		{ "normal",	ZFS_ARC_PRIORITY_NORMAL },
+		{ NULL }
+	};
+
 	static const zprop_index_t sync_table[] = {
 		{ "standard",	ZFS_SYNC_STANDARD },
 		{ "always",	ZFS_SYNC_ALWAYS },
@@ -433,7 +441,7 @@ zfs_prop_init(void)
 	    ZIO_COMPRESS_DEFAULT, PROP_INHERIT,
 	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
 	    "on | off | lzjb | gzip | gzip-[1-9] | zle | lz4 | "
-	    "zstd | zstd-[1-19] | "
+	    "zstd | zstd-[1-19] | zstd-auto | "
 	    "zstd-fast | zstd-fast-[1-10,20,30,40,50,60,70,80,90,100,500,1000]",
 	    "COMPRESS", compress_table, sfeatures);
 	zprop_register_index(ZFS_PROP_SNAPDIR, "snapdir", ZFS_SNAPDIR_HIDDEN,
@@ -474,6 +482,10 @@ zfs_prop_init(void)
 	    ZFS_PREFETCH_ALL, PROP_INHERIT,
 	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_SNAPSHOT | ZFS_TYPE_VOLUME,
 	    "none | metadata | all", "PREFETCH", prefetch_table, sfeatures);
+	zprop_register_index(ZFS_PROP_ARCPRIORITY, "arcpriority",
+	    ZFS_ARC_PRIORITY_NORMAL, PROP_INHERIT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_SNAPSHOT | ZFS_TYPE_VOLUME,
+	    "normal | low", "ARCPRIORITY", arc_priority_table, sfeatures);
 	zprop_register_index(ZFS_PROP_LOGBIAS, "logbias", ZFS_LOGBIAS_LATENCY,
 	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
 	    "latency | throughput", "LOGBIAS", logbias_table, sfeatures);
@@ -566,7 +578,8 @@ zfs_prop_init(void)
 	zprop_register_index(ZFS_PROP_ENCRYPTION, "encryption",
 	    ZIO_CRYPT_DEFAULT, PROP_ONETIME, ZFS_TYPE_DATASET,
 	    "on | off | aes-128-ccm | aes-192-ccm | aes-256-ccm | "
-	    "aes-128-gcm | aes-192-gcm | aes-256-gcm", "ENCRYPTION",
+	    "aes-128-gcm | aes-192-gcm | aes-256-gcm | chacha20-poly1305",
+	    "ENCRYPTION",
 	    crypto_table, sfeatures);
 
 	/* set once index (boolean) properties */
@@ -740,6 +753,26 @@ zfs_prop_init(void)
 	    "special_small_blocks", 0, PROP_INHERIT, ZFS_TYPE_FILESYSTEM,
 	    "zero or 512 to 1M, power of 2", "SPECIAL_SMALL_BLOCKS", B_FALSE,
 	    sfeatures);
+	zprop_register_number(ZFS_PROP_QOS_READ_BW, "qos_read_bw", 0,
+	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<bytes/s> | none", "QOS_READ_BW", B_FALSE, sfeatures);
+	zprop_register_number(ZFS_PROP_QOS_WRITE_BW, "qos_write_bw", 0,
+	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<bytes/s> | none", "QOS_WRITE_BW", B_FALSE, sfeatures);
+	zprop_register_number(ZFS_PROP_QOS_READ_IOPS, "qos_read_iops", 0,
+	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<ops/s> | none", "QOS_READ_IOPS", B_FALSE, sfeatures);
+	zprop_register_number(ZFS_PROP_QOS_WRITE_IOPS, "qos_write_iops", 0,
+	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<ops/s> | none", "QOS_WRITE_IOPS", B_FALSE, sfeatures);
+	zprop_register_number(ZFS_PROP_QOS_WEIGHT, "qos_weight",
+	    ZFS_QOS_WEIGHT_DEFAULT, PROP_INHERIT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME, "1 to 1000", "QOS_WEIGHT",
+	    B_FALSE, sfeatures);
+	zprop_register_number(ZFS_PROP_RESILVER_PRIORITY, "resilver_priority",
+	    ZFS_RESILVER_PRIORITY_DEFAULT, PROP_INHERIT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME, "0 to 100",
+	    "RESILVER_PRIORITY", B_FALSE, sfeatures);
 
 	/* hidden properties */
 	zprop_register_hidden(ZFS_PROP_NUMCLONES, "numclones", PROP_TYPE_NUMBER,
@@ -223,6 +223,7 @@ _VALSTR_BITFIELD_IMPL(zio_flag,
 	{ '.', "DG", "DELEGATED" },
 	{ '.', "DC", "DIO_CHKSUM_ERR" },
 	{ '.', "PA", "PREALLOCATED" },
+	{ '.', "DF", "DDT_PREFETCHED" },
 )
 
 /*
@@ -400,6 +400,21 @@ vdev_prop_init(void)
 	zprop_register_number(VDEV_PROP_SLOW_IOS, "slow_ios", 0,
 	    PROP_READONLY, ZFS_TYPE_VDEV, "<slowios>", "SLOW", B_FALSE,
 	    sfeatures);
+	zprop_register_number(VDEV_PROP_AGG_READ_OPS, "agg_read_ops", 0,
+	    PROP_READONLY, ZFS_TYPE_VDEV, "<operations>", "AGGREAD", B_FALSE,
+	    sfeatures);
+	zprop_register_number(VDEV_PROP_AGG_WRITE_OPS, "agg_write_ops", 0,
+	    PROP_READONLY, ZFS_TYPE_VDEV, "<operations>", "AGGWRITE", B_FALSE,
+	    sfeatures);
+	zprop_register_number(VDEV_PROP_AGG_READ_GAP_BYTES,
+	    "agg_read_gap_bytes", 0, PROP_READONLY, ZFS_TYPE_VDEV, "<bytes>",
+	    "AGGREADGAP", B_FALSE, sfeatures);
+	zprop_register_number(VDEV_PROP_AGG_WRITE_GAP_BYTES,
+	    "agg_write_gap_bytes", 0, PROP_READONLY, ZFS_TYPE_VDEV, "<bytes>",
+	    "AGGWRITEGAP", B_FALSE, sfeatures);
+	zprop_register_number(VDEV_PROP_READ_GAP_LIMIT, "read_gap_limit", 0,
+	    PROP_READONLY, ZFS_TYPE_VDEV, "<bytes>", "READGAP", B_FALSE,
+	    sfeatures);
 	zprop_register_number(VDEV_PROP_OPS_NULL, "null_ops", 0,
 	    PROP_READONLY, ZFS_TYPE_VDEV, "<operations>", "NULLOP", B_FALSE,
 	    sfeatures);
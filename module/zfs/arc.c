@@ -98,7 +98,9 @@
  *
  * buf_hash_find() returns the appropriate mutex (held) when it
  * locates the requested buffer in the hash table.  It returns
- * NULL for the mutex if the buffer was not in the table.
+ * NULL for the mutex if the buffer was not in the table.  Lookups
+ * which land on an empty hash chain return without taking the
+ * mutex at all; see buf_hash_find() for why this is safe.
  *
  * buf_hash_remove() expects the appropriate hash mutex to be
  * already held before it is invoked.
@@ -390,6 +392,23 @@ uint_t arc_shrink_shift = 7;
 uint_t zfs_arc_pc_percent = 0;
 #endif
 
+/*
+ * Number of direct reclaims per second which the ARC tolerates before it
+ * starts shrinking on its own.  Direct reclaim means an application stalled
+ * on a page allocation because kswapd could not keep up, so while the rate
+ * stays above this limit arc_c is stepped down in proportion to the excess.
+ * Set to 0 to disable.
+ */
+static uint_t zfs_arc_direct_reclaim_limit = 0;
+
+/*
+ * Percent of arc_c which buffers read by arcpriority=low datasets may hold.
+ * Once they hold more, further misses from those datasets are read as
+ * uncached, and are evicted as soon as they are no longer referenced.
+ * Set to 0 to disable.
+ */
+static uint_t zfs_arc_low_priority_limit = 0;
+
 /*
  * log2(fraction of ARC which must be free to allow growing).
  * I.e. If there is less than arc_c >> arc_no_grow_shift free memory,
@@ -470,6 +489,12 @@ static uint_t zfs_arc_lotsfree_percent = 10;
  */
 static int zfs_arc_prune_task_threads = 1;
 
+/*
+ * Share each prune request among the registered consumers in proportion to
+ * the objects they hold, rather than asking each of them for all of it.
+ */
+static int zfs_arc_prune_targeted = 0;
+
 /* Used by spa_export/spa_destroy to flush the arc asynchronously */
 static taskq_t *arc_flush_taskq;
 
@@ -540,6 +565,7 @@ arc_stats_t arc_stats = {
 	{ "size",			KSTAT_DATA_UINT64 },
 	{ "compressed_size",		KSTAT_DATA_UINT64 },
 	{ "uncompressed_size",		KSTAT_DATA_UINT64 },
+	{ "low_priority_size",		KSTAT_DATA_UINT64 },
 	{ "overhead_size",		KSTAT_DATA_UINT64 },
 	{ "hdr_size",			KSTAT_DATA_UINT64 },
 	{ "data_size",			KSTAT_DATA_UINT64 },
@@ -624,6 +650,8 @@ arc_stats_t arc_stats = {
 	{ "memory_throttle_count",	KSTAT_DATA_UINT64 },
 	{ "memory_direct_count",	KSTAT_DATA_UINT64 },
 	{ "memory_indirect_count",	KSTAT_DATA_UINT64 },
+	{ "memory_stall_shrink_count",	KSTAT_DATA_UINT64 },
+	{ "memory_stall_shrink_bytes",	KSTAT_DATA_UINT64 },
 	{ "memory_all_bytes",		KSTAT_DATA_UINT64 },
 	{ "memory_free_bytes",		KSTAT_DATA_UINT64 },
 	{ "memory_available_bytes",	KSTAT_DATA_INT64 },
@@ -645,6 +673,10 @@ arc_stats_t arc_stats = {
 	{ "arc_raw_size",		KSTAT_DATA_UINT64 },
 	{ "cached_only_in_progress",	KSTAT_DATA_UINT64 },
 	{ "abd_chunk_waste_size",	KSTAT_DATA_UINT64 },
+	{ "buf_decompress_hits",	KSTAT_DATA_UINT64 },
+	{ "buf_decompress_misses",	KSTAT_DATA_UINT64 },
+	{ "l2_admit_accepts",		KSTAT_DATA_UINT64 },
+	{ "l2_admit_rejects",		KSTAT_DATA_UINT64 },
 };
 
 arc_sums_t arc_sums;
@@ -728,6 +760,7 @@ taskq_t *arc_prune_taskq;
 
 #define	HDR_L2CACHE(hdr)	((hdr)->b_flags & ARC_FLAG_L2CACHE)
 #define	HDR_UNCACHED(hdr)	((hdr)->b_flags & ARC_FLAG_UNCACHED)
+#define	HDR_LOW_PRIORITY(hdr)	((hdr)->b_flags & ARC_FLAG_LOW_PRIORITY)
 #define	HDR_L2_READING(hdr)	\
 	(((hdr)->b_flags & ARC_FLAG_IO_IN_PROGRESS) &&	\
 	((hdr)->b_flags & ARC_FLAG_HAS_L2HDR))
@@ -752,13 +785,19 @@ taskq_t *arc_prune_taskq;
 #define	HDR_AUTHENTICATED(hdr)	\
 	(HDR_PROTECTED(hdr) && !DMU_OT_IS_ENCRYPTED((hdr)->b_crypt_hdr.b_ot))
 
-/* For storing compression mode in b_flags */
+/*
+ * For storing compression mode in b_flags.  That takes fewer bits than
+ * in a block pointer, leaving the top one for ARC_FLAG_LOW_PRIORITY.
+ */
 #define	HDR_COMPRESS_OFFSET	(highbit64(ARC_FLAG_COMPRESS_0) - 1)
+#define	HDR_COMPRESS_BITS	6
+_Static_assert(ZIO_COMPRESS_FUNCTIONS <= (1 << HDR_COMPRESS_BITS),
+	"compression functions don't fit in b_flags");
 
 #define	HDR_GET_COMPRESS(hdr)	((enum zio_compress)BF32_GET((hdr)->b_flags, \
-	HDR_COMPRESS_OFFSET, SPA_COMPRESSBITS))
+	HDR_COMPRESS_OFFSET, HDR_COMPRESS_BITS))
 #define	HDR_SET_COMPRESS(hdr, cmp) BF32_SET((hdr)->b_flags, \
-	HDR_COMPRESS_OFFSET, SPA_COMPRESSBITS, (cmp));
+	HDR_COMPRESS_OFFSET, HDR_COMPRESS_BITS, (cmp));
 
 #define	ARC_BUF_LAST(buf)	((buf)->b_next == NULL)
 #define	ARC_BUF_SHARED(buf)	((buf)->b_flags & ARC_BUF_FLAG_SHARED)
@@ -849,7 +888,6 @@ static uint_t l2arc_meta_percent = 33;	/* limit on headers size */
 static list_t L2ARC_dev_list;			/* device list */
 static list_t *l2arc_dev_list;			/* device list pointer */
 static kmutex_t l2arc_dev_mtx;			/* device list mutex */
-static l2arc_dev_t *l2arc_dev_last;		/* last device used */
 static list_t L2ARC_free_on_write;		/* free after write buf list */
 static list_t *l2arc_free_on_write;		/* free after write list ptr */
 static kmutex_t l2arc_free_on_write_mtx;	/* mutex for list */
@@ -888,6 +926,7 @@ typedef enum arc_ovf_level {
 static kmutex_t l2arc_feed_thr_lock;
 static kcondvar_t l2arc_feed_thr_cv;
 static uint8_t l2arc_thread_exit;
+static taskq_t *l2arc_feed_taskq;
 
 static kmutex_t l2arc_rebuild_thr_lock;
 static kcondvar_t l2arc_rebuild_thr_cv;
@@ -919,6 +958,7 @@ static inline void arc_hdr_set_flags(arc_buf_hdr_t *hdr, arc_flags_t flags);
 static inline void arc_hdr_clear_flags(arc_buf_hdr_t *hdr, arc_flags_t flags);
 
 static boolean_t l2arc_write_eligible(uint64_t, arc_buf_hdr_t *);
+static void l2arc_sketch_add(const arc_buf_hdr_t *);
 static void l2arc_read_done(zio_t *);
 static void l2arc_do_free_on_write(void);
 static void l2arc_hdr_arcstats_update(arc_buf_hdr_t *hdr, boolean_t incr,
@@ -949,6 +989,32 @@ int l2arc_exclude_special = 0;
  */
 static int l2arc_mfuonly = 0;
 
+/*
+ * l2arc_admit_lfu : A ZFS module parameter that enables a TinyLFU-style
+ * 		admission filter for L2ARC writes. When set, the access
+ * 		frequency of every ARC buffer (including ghost hits) is
+ * 		tracked in a small count-min sketch, and once a cache device
+ * 		has wrapped around, a buffer is only written if its
+ * 		estimated frequency is higher than that of the oldest buffer
+ * 		on the device, which is the next one to be overwritten.
+ */
+static int l2arc_admit_lfu = 0;
+
+/*
+ * Count-min sketch backing l2arc_admit_lfu: L2ARC_SKETCH_DEPTH rows of
+ * saturating counters, each indexed by a different slice of one 64-bit
+ * hash of the block identity. All counters are halved every
+ * L2ARC_SKETCH_AGE samples so that the estimate tracks recent accesses.
+ * Updates are not atomic; the occasional lost increment is harmless.
+ */
+#define	L2ARC_SKETCH_DEPTH	4
+#define	L2ARC_SKETCH_SHIFT	16
+#define	L2ARC_SKETCH_WIDTH	(1U << L2ARC_SKETCH_SHIFT)
+#define	L2ARC_SKETCH_MAX	15
+#define	L2ARC_SKETCH_AGE	(10ULL * L2ARC_SKETCH_WIDTH)
+static uint8_t *l2arc_sketch;
+static uint64_t l2arc_sketch_samples;
+
 /*
  * L2ARC TRIM
  * l2arc_trim_ahead : A ZFS module parameter that controls how much ahead of
@@ -1057,6 +1123,21 @@ buf_hash_find(uint64_t spa, const blkptr_t *bp, kmutex_t **lockp)
 	kmutex_t *hash_lock = BUF_HASH_LOCK(idx);
 	arc_buf_hdr_t *hdr;
 
+	/*
+	 * The hash table is sized so that most chains hold at most one
+	 * header, so the common miss lands on an empty chain.  Check for
+	 * that without taking the hash lock.  The chain head is only ever
+	 * changed under the lock, so a racing insert is indistinguishable
+	 * from one which happened just after we dropped it, and callers
+	 * which go on to insert (arc_read()) recheck in buf_hash_insert().
+	 * Headers are never dereferenced without the lock held, so hits
+	 * still take the locked path below.
+	 */
+	if (buf_hash_table.ht_table[idx] == NULL) {
+		*lockp = NULL;
+		return (NULL);
+	}
+
 	mutex_enter(hash_lock);
 	for (hdr = buf_hash_table.ht_table[idx]; hdr != NULL;
 	    hdr = hdr->b_hash_next) {
@@ -1773,8 +1854,9 @@ arc_buf_alloc_l2only(size_t size, arc_buf_contents_t type, l2arc_dev_t *dev,
 	hdr->b_dva = dva;
 
 	hdr->b_l2hdr.b_dev = dev;
-	hdr->b_l2hdr.b_daddr = daddr;
-	hdr->b_l2hdr.b_arcs_state = arcs_state;
+	hdr->b_l2hdr.b_l2prop = 0;
+	L2HDR_SET_DADDR(&hdr->b_l2hdr, daddr);
+	L2HDR_SET_STATE(&hdr->b_l2hdr, arcs_state);
 
 	return (hdr);
 }
@@ -1797,6 +1879,63 @@ arc_hdr_size(arc_buf_hdr_t *hdr)
 	return (size);
 }
 
+/*
+ * Account data attached to or detached from a header which was read by an
+ * arcpriority=low dataset.
+ */
+static inline void
+arc_hdr_low_priority_incr(arc_buf_hdr_t *hdr, int64_t size)
+{
+	if (HDR_LOW_PRIORITY(hdr))
+		aggsum_add(&arc_sums.arcstat_low_priority_size, size);
+}
+
+/*
+ * arcpriority=low only applies to headers that a low priority read brings
+ * into the cache itself.  Reading a block some other dataset also has
+ * cached (a clone, a dedup copy, or just the same block) must not demote
+ * it for everybody, and a normal read of a low priority header makes it
+ * normal again.  Called by arc_read() with the hash lock held.
+ */
+static void
+arc_hdr_update_low_priority(arc_buf_hdr_t *hdr, arc_flags_t arc_flags)
+{
+	boolean_t low = !!(arc_flags & ARC_FLAG_LOW_PRIORITY);
+	int64_t size = 0;
+
+	if (low == !!HDR_LOW_PRIORITY(hdr) ||
+	    (low && hdr->b_l1hdr.b_state != arc_anon))
+		return;
+
+	if (hdr->b_l1hdr.b_pabd != NULL)
+		size += arc_hdr_size(hdr);
+	if (HDR_HAS_RABD(hdr))
+		size += HDR_GET_PSIZE(hdr);
+
+	if (low) {
+		arc_hdr_set_flags(hdr, ARC_FLAG_LOW_PRIORITY);
+		arc_hdr_low_priority_incr(hdr, size);
+	} else {
+		arc_hdr_low_priority_incr(hdr, -size);
+		arc_hdr_clear_flags(hdr, ARC_FLAG_LOW_PRIORITY);
+	}
+}
+
+/*
+ * Return B_TRUE if arcpriority=low datasets already hold their share of
+ * the ARC, see zfs_arc_low_priority_limit.
+ */
+static boolean_t
+arc_low_priority_full(void)
+{
+	uint_t limit = zfs_arc_low_priority_limit;
+
+	if (limit == 0 || limit >= 100)
+		return (B_FALSE);
+	return (aggsum_compare(&arc_sums.arcstat_low_priority_size,
+	    arc_c / 100 * limit) > 0);
+}
+
 static int
 arc_hdr_authenticate(arc_buf_hdr_t *hdr, spa_t *spa, uint64_t dsobj)
 {
@@ -2150,10 +2289,12 @@ arc_buf_fill(arc_buf_t *buf, spa_t *spa, const zbookmark_phys_t *zb,
 		 * bite the bullet and decompress the data from the hdr.
 		 */
 		if (arc_buf_try_copy_decompressed_data(buf)) {
+			ARCSTAT_BUMP(arcstat_buf_decompress_hits);
 			/* Skip byteswapping and checksumming (already done) */
 			return (0);
 		} else {
 			abd_t dabd;
+			ARCSTAT_BUMP(arcstat_buf_decompress_misses);
 			abd_get_from_buf_struct(&dabd, buf->b_data,
 			    HDR_GET_LSIZE(hdr));
 			error = zio_decompress_data(HDR_GET_COMPRESS(hdr),
@@ -2405,8 +2546,8 @@ arc_buf_info(arc_buf_t *ab, arc_buf_info_t *abi, int state_index)
 	}
 
 	if (l2hdr) {
-		abi->abi_l2arc_dattr = l2hdr->b_daddr;
-		abi->abi_l2arc_hits = l2hdr->b_hits;
+		abi->abi_l2arc_dattr = L2HDR_GET_DADDR(l2hdr);
+		abi->abi_l2arc_hits = L2HDR_GET_HITS(l2hdr);
 	}
 
 	abi->abi_state_type = state ? state->arcs_state : ARC_STATE_ANON;
@@ -2607,7 +2748,7 @@ arc_change_state(arc_state_t *new_state, arc_buf_hdr_t *hdr)
 
 		if (HDR_HAS_L2HDR(hdr) && new_state != arc_l2c_only) {
 			l2arc_hdr_arcstats_decrement_state(hdr);
-			hdr->b_l2hdr.b_arcs_state = new_state->arcs_state;
+			L2HDR_SET_STATE(&hdr->b_l2hdr, new_state->arcs_state);
 			l2arc_hdr_arcstats_increment_state(hdr);
 		}
 	}
@@ -3008,6 +3149,7 @@ arc_share_buf(arc_buf_hdr_t *hdr, arc_buf_t *buf)
 	ARCSTAT_INCR(arcstat_compressed_size, arc_hdr_size(hdr));
 	ARCSTAT_INCR(arcstat_uncompressed_size, HDR_GET_LSIZE(hdr));
 	ARCSTAT_INCR(arcstat_overhead_size, -arc_buf_size(buf));
+	arc_hdr_low_priority_incr(hdr, arc_hdr_size(hdr));
 }
 
 static void
@@ -3037,6 +3179,7 @@ arc_unshare_buf(arc_buf_hdr_t *hdr, arc_buf_t *buf)
 	ARCSTAT_INCR(arcstat_compressed_size, -arc_hdr_size(hdr));
 	ARCSTAT_INCR(arcstat_uncompressed_size, -HDR_GET_LSIZE(hdr));
 	ARCSTAT_INCR(arcstat_overhead_size, arc_buf_size(buf));
+	arc_hdr_low_priority_incr(hdr, -arc_hdr_size(hdr));
 }
 
 /*
@@ -3216,6 +3359,7 @@ arc_hdr_alloc_abd(arc_buf_hdr_t *hdr, int alloc_flags)
 
 	ARCSTAT_INCR(arcstat_compressed_size, size);
 	ARCSTAT_INCR(arcstat_uncompressed_size, HDR_GET_LSIZE(hdr));
+	arc_hdr_low_priority_incr(hdr, size);
 }
 
 static void
@@ -3254,6 +3398,7 @@ arc_hdr_free_abd(arc_buf_hdr_t *hdr, boolean_t free_rdata)
 
 	ARCSTAT_INCR(arcstat_compressed_size, -size);
 	ARCSTAT_INCR(arcstat_uncompressed_size, -HDR_GET_LSIZE(hdr));
+	arc_hdr_low_priority_incr(hdr, -size);
 }
 
 /*
@@ -3583,7 +3728,7 @@ l2arc_hdr_arcstats_update(arc_buf_hdr_t *hdr, boolean_t incr,
 		 * possibly absent L1 header (apparent in buffers restored
 		 * from persistent L2ARC).
 		 */
-		switch (hdr->b_l2hdr.b_arcs_state) {
+		switch (L2HDR_GET_STATE(&hdr->b_l2hdr)) {
 			case ARC_STATE_MRU_GHOST:
 			case ARC_STATE_MRU:
 				ARCSTAT_INCR(arcstat_l2_mru_asize, asize_s);
@@ -4896,11 +5041,50 @@ arc_evict_cb(void *arg, zthr_t *zthr)
 	spl_fstrans_unmark(cookie);
 }
 
+/*
+ * Shrink the ARC when the rate of direct reclaims over the last second
+ * exceeds zfs_arc_direct_reclaim_limit.  Each step releases a
+ * 1/2^arc_shrink_shift fraction of the reducible ARC per multiple of the
+ * limit, up to 8 multiples, and holds off growth for arc_grow_retry.
+ */
+static void
+arc_direct_reclaim_check(void)
+{
+	static uint64_t last_count = 0;
+	static hrtime_t last_time = 0;
+
+	hrtime_t now = gethrtime();
+	if (now - last_time < SEC2NSEC(1))
+		return;
+
+	uint64_t count = wmsum_value(&arc_sums.arcstat_memory_direct_count);
+	uint64_t rate = (count - last_count) * NANOSEC / (now - last_time);
+	uint_t limit = zfs_arc_direct_reclaim_limit;
+	boolean_t first = (last_time == 0);
+
+	last_count = count;
+	last_time = now;
+	if (limit == 0 || first || rate <= limit)
+		return;
+
+	int64_t can_free = arc_c - arc_c_min;
+	uint64_t to_free = (MAX(can_free, 0) >> arc_shrink_shift) *
+	    MIN(rate / limit, 8);
+	to_free = arc_reduce_target_size(to_free);
+
+	arc_no_grow = B_TRUE;
+	arc_growtime = now + SEC2NSEC(arc_grow_retry);
+	ARCSTAT_BUMP(arcstat_memory_stall_shrink_count);
+	ARCSTAT_INCR(arcstat_memory_stall_shrink_bytes, to_free);
+}
+
 static boolean_t
 arc_reap_cb_check(void *arg, zthr_t *zthr)
 {
 	(void) arg, (void) zthr;
 
+	arc_direct_reclaim_check();
+
 	int64_t free_memory = arc_available_memory();
 	static int reap_cb_check_counter = 0;
 
@@ -5329,6 +5513,11 @@ arc_access(arc_buf_hdr_t *hdr, arc_flags_t arc_flags, boolean_t hit)
 	ASSERT(MUTEX_HELD(HDR_LOCK(hdr)));
 	ASSERT(HDR_HAS_L1HDR(hdr));
 
+	arc_mrc_access(hdr->b_spa, &hdr->b_dva, hdr->b_birth,
+	    arc_hdr_size(hdr));
+	if (l2arc_admit_lfu && l2arc_ndev != 0)
+		l2arc_sketch_add(hdr);
+
 	/*
 	 * Update buffer prefetch status.
 	 */
@@ -5401,6 +5590,15 @@ arc_access(arc_buf_hdr_t *hdr, arc_flags_t arc_flags, boolean_t hit)
 			return;
 		}
 
+		/*
+		 * Low priority buffers stay in the MRU state no matter how
+		 * often they are accessed.
+		 */
+		if (HDR_LOW_PRIORITY(hdr)) {
+			hdr->b_l1hdr.b_arc_access = now;
+			return;
+		}
+
 		/*
 		 * If more than ARC_MINTIME have passed from the previous
 		 * hit, promote the buffer to the MFU state.
@@ -5422,6 +5620,16 @@ arc_access(arc_buf_hdr_t *hdr, arc_flags_t arc_flags, boolean_t hit)
 		hdr->b_l1hdr.b_mru_ghost_hits++;
 		ARCSTAT_BUMP(arcstat_mru_ghost_hits);
 		hdr->b_l1hdr.b_arc_access = now;
+		if (HDR_LOW_PRIORITY(hdr)) {
+			/*
+			 * Don't let low priority buffers grow the MRU at
+			 * the expense of the MFU, and don't promote them.
+			 */
+			new_state = arc_mru;
+			DTRACE_PROBE1(new_state__mru, arc_buf_hdr_t *, hdr);
+			arc_change_state(new_state, hdr);
+			return;
+		}
 		wmsum_add(&arc_mru_ghost->arcs_hits[arc_buf_type(hdr)],
 		    arc_hdr_size(hdr));
 		if (was_prefetch) {
@@ -5936,6 +6144,7 @@ top:
 			}
 
 			DTRACE_PROBE1(arc__iohit, arc_buf_hdr_t *, hdr);
+			arc_hdr_update_low_priority(hdr, *arc_flags);
 			arc_access(hdr, *arc_flags, B_FALSE);
 
 			/*
@@ -6007,6 +6216,7 @@ top:
 		    hdr->b_l1hdr.b_state == arc_uncached);
 
 		DTRACE_PROBE1(arc__hit, arc_buf_hdr_t *, hdr);
+		arc_hdr_update_low_priority(hdr, *arc_flags);
 		arc_access(hdr, *arc_flags, B_TRUE);
 
 		if (done && !no_buf) {
@@ -6174,7 +6384,10 @@ top:
 				goto top;
 			}
 		}
-		if (*arc_flags & ARC_FLAG_UNCACHED) {
+		if ((*arc_flags & ARC_FLAG_UNCACHED) ||
+		    ((*arc_flags & ARC_FLAG_LOW_PRIORITY) &&
+		    hdr->b_l1hdr.b_state == arc_anon &&
+		    arc_low_priority_full())) {
 			arc_hdr_set_flags(hdr, ARC_FLAG_UNCACHED);
 			if (!encrypted_read)
 				alloc_flags |= ARC_HDR_ALLOC_LINEAR;
@@ -6187,6 +6400,7 @@ top:
 		 * the evictable list of MRU or MFU state.
 		 */
 		add_reference(hdr, hdr);
+		arc_hdr_update_low_priority(hdr, *arc_flags);
 		if (!embedded_bp)
 			arc_access(hdr, *arc_flags, B_FALSE);
 		arc_hdr_set_flags(hdr, ARC_FLAG_IO_IN_PROGRESS);
@@ -6237,7 +6451,7 @@ top:
 		if (HDR_HAS_L2HDR(hdr) &&
 		    (vd = hdr->b_l2hdr.b_dev->l2ad_vdev) != NULL) {
 			devw = hdr->b_l2hdr.b_dev->l2ad_writing;
-			addr = hdr->b_l2hdr.b_daddr;
+			addr = L2HDR_GET_DADDR(&hdr->b_l2hdr);
 			/*
 			 * Lock out L2ARC device removal.
 			 */
@@ -6302,7 +6516,11 @@ top:
 
 				DTRACE_PROBE1(l2arc__hit, arc_buf_hdr_t *, hdr);
 				ARCSTAT_BUMP(arcstat_l2_hits);
-				hdr->b_l2hdr.b_hits++;
+				uint64_t l2hits = L2HDR_GET_HITS(&hdr->b_l2hdr);
+				if (l2hits < L2HDR_HITS_MAX) {
+					L2HDR_SET_HITS(&hdr->b_l2hdr,
+					    l2hits + 1);
+				}
 
 				cb = kmem_zalloc(sizeof (l2arc_read_callback_t),
 				    KM_SLEEP);
@@ -6438,14 +6656,70 @@ done:
 	goto out;
 }
 
+/*
+ * Issue asynchronous reads for a batch of blocks.  Every request must have
+ * ARC_FLAG_NOWAIT set in arr_flags, which is updated as for arc_read().
+ * The reads are issued as children of pio or, if pio is NULL, of a single
+ * root zio created for the batch, so that callers with many blocks to fetch
+ * (prefetchers in particular) need one parent zio per batch rather than per
+ * block.  done is called for each request, with its arr_private, exactly as
+ * arc_read() would call it.
+ *
+ * Returns 0, or the error of the first request whose arc_read() failed; the
+ * remaining requests are still issued.
+ */
+int
+arc_read_many(zio_t *pio, spa_t *spa, arc_read_req_t *reqs, uint_t count,
+    arc_read_done_func_t *done, zio_priority_t priority)
+{
+	zio_t *rio = pio;
+	int error = 0;
+
+	if (count == 0)
+		return (0);
+
+	if (rio == NULL)
+		rio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+
+	for (uint_t i = 0; i < count; i++) {
+		arc_read_req_t *req = &reqs[i];
+
+		ASSERT(req->arr_flags & ARC_FLAG_NOWAIT);
+		int err = arc_read(rio, spa, req->arr_bp, done,
+		    req->arr_private, priority, req->arr_zio_flags,
+		    &req->arr_flags, req->arr_zb);
+		if (err != 0 && error == 0)
+			error = err;
+	}
+
+	if (pio == NULL)
+		zio_nowait(rio);
+
+	return (error);
+}
+
 arc_prune_t *
 arc_add_prune_callback(arc_prune_func_t *func, void *private)
+{
+	return (arc_add_prune_count_callback(func, NULL, private));
+}
+
+/*
+ * Like arc_add_prune_callback(), but with a function which reports how many
+ * objects the consumer could release.  When zfs_arc_prune_targeted is set
+ * this is used to share each prune request out among the consumers.
+ */
+arc_prune_t *
+arc_add_prune_count_callback(arc_prune_func_t *func,
+    arc_prune_count_func_t *count, void *private)
 {
 	arc_prune_t *p;
 
 	p = kmem_alloc(sizeof (*p), KM_SLEEP);
 	p->p_pfunc = func;
+	p->p_cfunc = count;
 	p->p_private = private;
+	p->p_count = 0;
 	list_link_init(&p->p_node);
 	zfs_refcount_create(&p->p_refcnt);
 
@@ -6500,21 +6774,44 @@ arc_prune_task(void *ptr)
  * in the context of the arc_reclaim_thread().  A reference is taken here
  * for each registered arc_prune_t and the arc_prune_task() is responsible
  * for releasing it once the registered arc_prune_func_t has completed.
+ *
+ * By default every consumer is asked to release the full adjustment.  With
+ * zfs_arc_prune_targeted, consumers which can report how many objects they
+ * hold are instead each asked for their proportional share of it, and those
+ * holding nothing are not woken at all.
  */
 static void
 arc_prune_async(uint64_t adjust)
 {
 	arc_prune_t *ap;
+	uint64_t total = 0;
 
 	mutex_enter(&arc_prune_mtx);
+	if (zfs_arc_prune_targeted) {
+		for (ap = list_head(&arc_prune_list); ap != NULL;
+		    ap = list_next(&arc_prune_list, ap)) {
+			if (ap->p_cfunc == NULL)
+				continue;
+			ap->p_count = ap->p_cfunc(ap->p_private);
+			total += ap->p_count;
+		}
+	}
+
 	for (ap = list_head(&arc_prune_list); ap != NULL;
 	    ap = list_next(&arc_prune_list, ap)) {
+		uint64_t share = adjust;
 
 		if (zfs_refcount_count(&ap->p_refcnt) >= 2)
 			continue;
 
+		if (zfs_arc_prune_targeted && ap->p_cfunc != NULL) {
+			if (ap->p_count == 0)
+				continue;
+			share = MAX(arc_mf(adjust, ap->p_count, total), 1);
+		}
+
 		zfs_refcount_add(&ap->p_refcnt, ap->p_pfunc);
-		ap->p_adjust = adjust;
+		ap->p_adjust = share;
 		if (taskq_dispatch(arc_prune_taskq, arc_prune_task,
 		    ap, TQ_SLEEP) == TASKQID_INVALID) {
 			(void) zfs_refcount_remove(&ap->p_refcnt, ap->p_pfunc);
@@ -6572,6 +6869,32 @@ arc_freed(spa_t *spa, const blkptr_t *bp)
 
 }
 
+/*
+ * Mark the block as not worth caching, as for POSIX_FADV_DONTNEED.  The
+ * header moves to the uncached state, so it is freed on its last release
+ * or, if not referenced now, by the next uncached state flush.
+ */
+void
+arc_uncache(spa_t *spa, const blkptr_t *bp)
+{
+	arc_buf_hdr_t *hdr;
+	kmutex_t *hash_lock;
+	uint64_t guid = spa_load_guid(spa);
+
+	ASSERT(!BP_IS_EMBEDDED(bp));
+
+	hdr = buf_hash_find(guid, bp, &hash_lock);
+	if (hdr == NULL)
+		return;
+
+	if (HDR_HAS_L1HDR(hdr) && (hdr->b_l1hdr.b_state == arc_mru ||
+	    hdr->b_l1hdr.b_state == arc_mfu)) {
+		arc_hdr_set_flags(hdr, ARC_FLAG_UNCACHED);
+		arc_change_state(arc_uncached, hdr);
+	}
+	mutex_exit(hash_lock);
+}
+
 /*
  * Release this buffer from the cache, making it an anonymous buffer.  This
  * must be done after a read and prior to modifying the buffer contents.
@@ -7313,6 +7636,8 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_compressed_size);
 	as->arcstat_uncompressed_size.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_uncompressed_size);
+	as->arcstat_low_priority_size.value.ui64 =
+	    aggsum_value(&arc_sums.arcstat_low_priority_size);
 	as->arcstat_overhead_size.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_overhead_size);
 	as->arcstat_hdr_size.value.ui64 =
@@ -7455,6 +7780,10 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_memory_direct_count);
 	as->arcstat_memory_indirect_count.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_memory_indirect_count);
+	as->arcstat_memory_stall_shrink_count.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_memory_stall_shrink_count);
+	as->arcstat_memory_stall_shrink_bytes.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_memory_stall_shrink_bytes);
 
 	as->arcstat_memory_all_bytes.value.ui64 =
 	    arc_all_memory();
@@ -7487,6 +7816,14 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_cached_only_in_progress);
 	as->arcstat_abd_chunk_waste_size.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_abd_chunk_waste_size);
+	as->arcstat_buf_decompress_hits.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_buf_decompress_hits);
+	as->arcstat_buf_decompress_misses.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_buf_decompress_misses);
+	as->arcstat_l2_admit_accepts.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_admit_accepts);
+	as->arcstat_l2_admit_rejects.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_admit_rejects);
 
 	return (0);
 }
@@ -7733,6 +8070,7 @@ arc_state_init(void)
 	aggsum_init(&arc_sums.arcstat_size, 0);
 	wmsum_init(&arc_sums.arcstat_compressed_size, 0);
 	wmsum_init(&arc_sums.arcstat_uncompressed_size, 0);
+	aggsum_init(&arc_sums.arcstat_low_priority_size, 0);
 	wmsum_init(&arc_sums.arcstat_overhead_size, 0);
 	wmsum_init(&arc_sums.arcstat_hdr_size, 0);
 	wmsum_init(&arc_sums.arcstat_data_size, 0);
@@ -7782,6 +8120,8 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_memory_throttle_count, 0);
 	wmsum_init(&arc_sums.arcstat_memory_direct_count, 0);
 	wmsum_init(&arc_sums.arcstat_memory_indirect_count, 0);
+	wmsum_init(&arc_sums.arcstat_memory_stall_shrink_count, 0);
+	wmsum_init(&arc_sums.arcstat_memory_stall_shrink_bytes, 0);
 	wmsum_init(&arc_sums.arcstat_prune, 0);
 	wmsum_init(&arc_sums.arcstat_meta_used, 0);
 	wmsum_init(&arc_sums.arcstat_async_upgrade_sync, 0);
@@ -7794,6 +8134,10 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_raw_size, 0);
 	wmsum_init(&arc_sums.arcstat_cached_only_in_progress, 0);
 	wmsum_init(&arc_sums.arcstat_abd_chunk_waste_size, 0);
+	wmsum_init(&arc_sums.arcstat_buf_decompress_hits, 0);
+	wmsum_init(&arc_sums.arcstat_buf_decompress_misses, 0);
+	wmsum_init(&arc_sums.arcstat_l2_admit_accepts, 0);
+	wmsum_init(&arc_sums.arcstat_l2_admit_rejects, 0);
 
 	arc_anon->arcs_state = ARC_STATE_ANON;
 	arc_mru->arcs_state = ARC_STATE_MRU;
@@ -7892,6 +8236,7 @@ arc_state_fini(void)
 	aggsum_fini(&arc_sums.arcstat_size);
 	wmsum_fini(&arc_sums.arcstat_compressed_size);
 	wmsum_fini(&arc_sums.arcstat_uncompressed_size);
+	aggsum_fini(&arc_sums.arcstat_low_priority_size);
 	wmsum_fini(&arc_sums.arcstat_overhead_size);
 	wmsum_fini(&arc_sums.arcstat_hdr_size);
 	wmsum_fini(&arc_sums.arcstat_data_size);
@@ -7941,6 +8286,8 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_memory_throttle_count);
 	wmsum_fini(&arc_sums.arcstat_memory_direct_count);
 	wmsum_fini(&arc_sums.arcstat_memory_indirect_count);
+	wmsum_fini(&arc_sums.arcstat_memory_stall_shrink_count);
+	wmsum_fini(&arc_sums.arcstat_memory_stall_shrink_bytes);
 	wmsum_fini(&arc_sums.arcstat_prune);
 	wmsum_fini(&arc_sums.arcstat_meta_used);
 	wmsum_fini(&arc_sums.arcstat_async_upgrade_sync);
@@ -7953,6 +8300,10 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_raw_size);
 	wmsum_fini(&arc_sums.arcstat_cached_only_in_progress);
 	wmsum_fini(&arc_sums.arcstat_abd_chunk_waste_size);
+	wmsum_fini(&arc_sums.arcstat_buf_decompress_hits);
+	wmsum_fini(&arc_sums.arcstat_buf_decompress_misses);
+	wmsum_fini(&arc_sums.arcstat_l2_admit_accepts);
+	wmsum_fini(&arc_sums.arcstat_l2_admit_rejects);
 }
 
 uint64_t
@@ -8056,6 +8407,8 @@ arc_init(void)
 	arc_flush_taskq = taskq_create("arc_flush", MIN(boot_ncpus, 4),
 	    defclsyspri, 1, INT_MAX, TASKQ_DYNAMIC);
 
+	arc_mrc_init();
+
 	arc_ksp = kstat_create("zfs", 0, "arcstats", "misc", KSTAT_TYPE_NAMED,
 	    sizeof (arc_stats) / sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
 
@@ -8133,6 +8486,8 @@ arc_fini(void)
 		arc_ksp = NULL;
 	}
 
+	arc_mrc_fini();
+
 	taskq_wait(arc_prune_taskq);
 	taskq_destroy(arc_prune_taskq);
 
@@ -8305,7 +8660,9 @@ arc_fini(void)
  * 6. Writes to the L2ARC devices are grouped and sent in-sequence, so that
  * the vdev queue can aggregate them into larger and fewer writes.  Each
  * device is written to in a rotor fashion, sweeping writes through
- * available space then repeating.
+ * available space then repeating.  Every device is fed by its own task,
+ * so multiple cache devices are filled in parallel, each scanning a
+ * different ARC sublist where possible.
  *
  * 7. The L2ARC does not store dirty content.  It never needs to flush
  * write buffers back to disk based storage.
@@ -8454,6 +8811,49 @@ l2arc_write_eligible(uint64_t spa_guid, arc_buf_hdr_t *hdr)
 	return (B_TRUE);
 }
 
+static inline uint8_t *
+l2arc_sketch_counter(uint64_t hash, int row)
+{
+	return (&l2arc_sketch[row * L2ARC_SKETCH_WIDTH +
+	    ((hash >> (row * L2ARC_SKETCH_SHIFT)) & (L2ARC_SKETCH_WIDTH - 1))]);
+}
+
+/*
+ * Record an access to hdr in the l2arc_admit_lfu frequency sketch.
+ */
+static void
+l2arc_sketch_add(const arc_buf_hdr_t *hdr)
+{
+	uint64_t hash = buf_hash(hdr->b_spa, &hdr->b_dva, hdr->b_birth);
+
+	for (int row = 0; row < L2ARC_SKETCH_DEPTH; row++) {
+		uint8_t *c = l2arc_sketch_counter(hash, row);
+		if (*c < L2ARC_SKETCH_MAX)
+			(*c)++;
+	}
+
+	if (atomic_inc_64_nv(&l2arc_sketch_samples) == L2ARC_SKETCH_AGE) {
+		for (uint64_t i = 0;
+		    i < L2ARC_SKETCH_DEPTH * L2ARC_SKETCH_WIDTH; i++)
+			l2arc_sketch[i] >>= 1;
+		atomic_store_64(&l2arc_sketch_samples, 0);
+	}
+}
+
+/*
+ * Estimated recent access frequency of hdr, from 0 to L2ARC_SKETCH_MAX.
+ */
+static uint_t
+l2arc_sketch_estimate(const arc_buf_hdr_t *hdr)
+{
+	uint64_t hash = buf_hash(hdr->b_spa, &hdr->b_dva, hdr->b_birth);
+	uint_t freq = L2ARC_SKETCH_MAX;
+
+	for (int row = 0; row < L2ARC_SKETCH_DEPTH; row++)
+		freq = MIN(freq, *l2arc_sketch_counter(hash, row));
+	return (freq);
+}
+
 static uint64_t
 l2arc_write_size(l2arc_dev_t *dev)
 {
@@ -8531,68 +8931,6 @@ l2arc_dev_invalid(const l2arc_dev_t *dev)
 	    dev->l2ad_spa == NULL || dev->l2ad_spa->spa_is_exporting);
 }
 
-/*
- * Cycle through L2ARC devices.  This is how L2ARC load balances.
- * If a device is returned, this also returns holding the spa config lock.
- */
-static l2arc_dev_t *
-l2arc_dev_get_next(void)
-{
-	l2arc_dev_t *first, *next = NULL;
-
-	/*
-	 * Lock out the removal of spas (spa_namespace_lock), then removal
-	 * of cache devices (l2arc_dev_mtx).  Once a device has been selected,
-	 * both locks will be dropped and a spa config lock held instead.
-	 */
-	mutex_enter(&spa_namespace_lock);
-	mutex_enter(&l2arc_dev_mtx);
-
-	/* if there are no vdevs, there is nothing to do */
-	if (l2arc_ndev == 0)
-		goto out;
-
-	first = NULL;
-	next = l2arc_dev_last;
-	do {
-		/* loop around the list looking for a non-faulted vdev */
-		if (next == NULL) {
-			next = list_head(l2arc_dev_list);
-		} else {
-			next = list_next(l2arc_dev_list, next);
-			if (next == NULL)
-				next = list_head(l2arc_dev_list);
-		}
-
-		/* if we have come back to the start, bail out */
-		if (first == NULL)
-			first = next;
-		else if (next == first)
-			break;
-
-		ASSERT3P(next, !=, NULL);
-	} while (l2arc_dev_invalid(next));
-
-	/* if we were unable to find any usable vdevs, return NULL */
-	if (l2arc_dev_invalid(next))
-		next = NULL;
-
-	l2arc_dev_last = next;
-
-out:
-	mutex_exit(&l2arc_dev_mtx);
-
-	/*
-	 * Grab the config lock to prevent the 'next' device from being
-	 * removed while we are writing to it.
-	 */
-	if (next != NULL)
-		spa_config_enter(next->l2ad_spa, SCL_L2ARC, next, RW_READER);
-	mutex_exit(&spa_namespace_lock);
-
-	return (next);
-}
-
 /*
  * Free buffers that were tagged for destruction.
  */
@@ -9044,7 +9382,7 @@ static multilist_sublist_t *
 l2arc_sublist_lock(int list_num)
 {
 	multilist_t *ml = NULL;
-	unsigned int idx;
+	unsigned int idx, num;
 
 	ASSERT(list_num >= 0 && list_num < L2ARC_FEED_TYPES);
 
@@ -9069,9 +9407,18 @@ l2arc_sublist_lock(int list_num)
 	 * Return a randomly-selected sublist. This is acceptable
 	 * because the caller feeds only a little bit of data for each
 	 * call (8MB). Subsequent calls will result in different
-	 * sublists being selected.
+	 * sublists being selected.  Feed tasks for different devices
+	 * run concurrently, so prefer a sublist that is not already
+	 * locked to keep them scanning disjoint parts of the list.
 	 */
 	idx = multilist_get_random_index(ml);
+	num = multilist_get_num_sublists(ml);
+	for (unsigned int i = 0; i < num; i++) {
+		multilist_sublist_t *mls =
+		    multilist_sublist_trylock_idx(ml, (idx + i) % num);
+		if (mls != NULL)
+			return (mls);
+	}
 	return (multilist_sublist_lock_idx(ml, idx));
 }
 
@@ -9258,8 +9605,9 @@ retry:
 		ASSERT(!HDR_L2_WRITING(hdr));
 		ASSERT(!HDR_L2_WRITE_HEAD(hdr));
 
-		if (!all && (hdr->b_l2hdr.b_daddr >= dev->l2ad_evict ||
-		    hdr->b_l2hdr.b_daddr < dev->l2ad_hand)) {
+		uint64_t daddr = L2HDR_GET_DADDR(&hdr->b_l2hdr);
+		if (!all && (daddr >= dev->l2ad_evict ||
+		    daddr < dev->l2ad_hand)) {
 			/*
 			 * We've evicted to the target address,
 			 * or the end of the device.
@@ -9487,6 +9835,27 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 	arc_hdr_set_flags(head, ARC_FLAG_L2_WRITE_HEAD | ARC_FLAG_HAS_L2HDR);
 	marker = arc_state_alloc_marker();
 
+	/*
+	 * With the admission filter enabled, candidates have to beat the
+	 * frequency of the oldest buffer on the device, i.e. the one the
+	 * write hand will overwrite next.  Until the device has wrapped
+	 * around nothing is being replaced, so everything is admitted.
+	 */
+	boolean_t admit_lfu = l2arc_admit_lfu && !dev->l2ad_first;
+	uint_t victim_freq = 0;
+	if (admit_lfu) {
+		arc_buf_hdr_t *victim;
+
+		mutex_enter(&dev->l2ad_mtx);
+		for (victim = list_tail(&dev->l2ad_buflist);
+		    victim != NULL && HDR_L2_WRITE_HEAD(victim);
+		    victim = list_prev(&dev->l2ad_buflist, victim))
+			;
+		if (victim != NULL)
+			victim_freq = l2arc_sketch_estimate(victim);
+		mutex_exit(&dev->l2ad_mtx);
+	}
+
 	/*
 	 * Copy buffers for L2ARC writing.
 	 */
@@ -9571,6 +9940,15 @@ skip:
 				break;
 			}
 
+			if (admit_lfu) {
+				if (l2arc_sketch_estimate(hdr) <= victim_freq) {
+					ARCSTAT_BUMP(arcstat_l2_admit_rejects);
+					mutex_exit(hash_lock);
+					goto skip;
+				}
+				ARCSTAT_BUMP(arcstat_l2_admit_accepts);
+			}
+
 			/*
 			 * We should not sleep with sublist lock held or it
 			 * may block ARC eviction.  Insert a marker to save
@@ -9623,10 +10001,10 @@ skip:
 			}
 
 			hdr->b_l2hdr.b_dev = dev;
-			hdr->b_l2hdr.b_daddr = dev->l2ad_hand;
-			hdr->b_l2hdr.b_hits = 0;
-			hdr->b_l2hdr.b_arcs_state =
-			    hdr->b_l1hdr.b_state->arcs_state;
+			hdr->b_l2hdr.b_l2prop = 0;
+			L2HDR_SET_DADDR(&hdr->b_l2hdr, dev->l2ad_hand);
+			L2HDR_SET_STATE(&hdr->b_l2hdr,
+			    hdr->b_l1hdr.b_state->arcs_state);
 			/* l2arc_hdr_arcstats_update() expects a valid asize */
 			HDR_SET_L2SIZE(hdr, asize);
 			arc_hdr_set_flags(hdr, ARC_FLAG_HAS_L2HDR |
@@ -9748,78 +10126,37 @@ l2arc_hdr_limit_reached(void)
 }
 
 /*
- * This thread feeds the L2ARC at regular intervals.  This is the beating
- * heart of the L2ARC.
+ * Feed a single L2ARC device.  This is dispatched by l2arc_feed_thread()
+ * with the device's spa config lock held, which keeps the device from
+ * being removed until the task drops it.
  */
-static  __attribute__((noreturn)) void
-l2arc_feed_thread(void *unused)
+static void
+l2arc_feed_dev(void *arg)
 {
-	(void) unused;
-	callb_cpr_t cpr;
-	l2arc_dev_t *dev;
-	spa_t *spa;
+	l2arc_dev_t *dev = arg;
+	spa_t *spa = dev->l2ad_spa;
 	uint64_t size, wrote;
-	clock_t begin, next = ddi_get_lbolt();
+	clock_t begin, next;
 	fstrans_cookie_t cookie;
 
-	CALLB_CPR_INIT(&cpr, &l2arc_feed_thr_lock, callb_generic_cpr, FTAG);
-
-	mutex_enter(&l2arc_feed_thr_lock);
+	ASSERT3P(spa, !=, NULL);
 
 	cookie = spl_fstrans_mark();
-	while (l2arc_thread_exit == 0) {
-		CALLB_CPR_SAFE_BEGIN(&cpr);
-		(void) cv_timedwait_idle(&l2arc_feed_thr_cv,
-		    &l2arc_feed_thr_lock, next);
-		CALLB_CPR_SAFE_END(&cpr, &l2arc_feed_thr_lock);
-		next = ddi_get_lbolt() + hz;
-
-		/*
-		 * Quick check for L2ARC devices.
-		 */
-		mutex_enter(&l2arc_dev_mtx);
-		if (l2arc_ndev == 0) {
-			mutex_exit(&l2arc_dev_mtx);
-			continue;
-		}
-		mutex_exit(&l2arc_dev_mtx);
-		begin = ddi_get_lbolt();
+	begin = ddi_get_lbolt();
+	next = begin + hz;
 
+	if (!spa_writeable(spa)) {
 		/*
-		 * This selects the next l2arc device to write to, and in
-		 * doing so the next spa to feed from: dev->l2ad_spa.   This
-		 * will return NULL if there are now no l2arc devices or if
-		 * they are all faulted.
-		 *
-		 * If a device is returned, its spa's config lock is also
-		 * held to prevent device removal.  l2arc_dev_get_next()
-		 * will grab and release l2arc_dev_mtx.
+		 * If the pool is read-only then feed this device a little
+		 * less often.
 		 */
-		if ((dev = l2arc_dev_get_next()) == NULL)
-			continue;
-
-		spa = dev->l2ad_spa;
-		ASSERT3P(spa, !=, NULL);
-
-		/*
-		 * If the pool is read-only then force the feed thread to
-		 * sleep a little longer.
-		 */
-		if (!spa_writeable(spa)) {
-			next = ddi_get_lbolt() + 5 * l2arc_feed_secs * hz;
-			spa_config_exit(spa, SCL_L2ARC, dev);
-			continue;
-		}
-
+		next = begin + 5 * l2arc_feed_secs * hz;
+	} else if (l2arc_hdr_limit_reached()) {
 		/*
 		 * Avoid contributing to memory pressure.
 		 */
-		if (l2arc_hdr_limit_reached()) {
-			ARCSTAT_BUMP(arcstat_l2_abort_lowmem);
-			spa_config_exit(spa, SCL_L2ARC, dev);
-			continue;
-		}
-
+		ARCSTAT_BUMP(arcstat_l2_abort_lowmem);
+	} else {
 		ARCSTAT_BUMP(arcstat_l2_feeds);
 
 		size = l2arc_write_size(dev);
@@ -9838,10 +10175,88 @@ l2arc_feed_thread(void *unused)
 		 * Calculate interval between writes.
 		 */
 		next = l2arc_write_interval(begin, size, wrote);
-		spa_config_exit(spa, SCL_L2ARC, dev);
 	}
+
+	mutex_enter(&l2arc_dev_mtx);
+	dev->l2ad_feed_next = next;
+	dev->l2ad_feeding = B_FALSE;
+	mutex_exit(&l2arc_dev_mtx);
+
+	/* The device may be removed as soon as the config lock is dropped. */
+	spa_config_exit(spa, SCL_L2ARC, dev);
 	spl_fstrans_unmark(cookie);
 
+	mutex_enter(&l2arc_feed_thr_lock);
+	cv_broadcast(&l2arc_feed_thr_cv);
+	mutex_exit(&l2arc_feed_thr_lock);
+}
+
+/*
+ * Dispatch a feed task for every usable L2ARC device that is due to be
+ * written and is not being fed already, so that cache devices are filled
+ * in parallel rather than in turn.  Returns the time of the next feed.
+ */
+static clock_t
+l2arc_feed_dispatch(void)
+{
+	clock_t now = ddi_get_lbolt();
+	clock_t next = now + hz;
+	l2arc_dev_t *dev;
+
+	mutex_enter(&l2arc_dev_mtx);
+	for (dev = list_head(l2arc_dev_list); dev != NULL;
+	    dev = list_next(l2arc_dev_list, dev)) {
+		if (dev->l2ad_feeding || l2arc_dev_invalid(dev))
+			continue;
+		if (dev->l2ad_feed_next > now) {
+			next = MIN(next, dev->l2ad_feed_next);
+			continue;
+		}
+
+		/*
+		 * Hold the config lock to prevent the device from being
+		 * removed while we are writing to it.  Don't wait for it
+		 * while holding l2arc_dev_mtx; the device is retried on the
+		 * next pass.
+		 */
+		if (!spa_config_tryenter(dev->l2ad_spa, SCL_L2ARC, dev,
+		    RW_READER))
+			continue;
+
+		dev->l2ad_feeding = B_TRUE;
+		taskq_dispatch_ent(l2arc_feed_taskq, l2arc_feed_dev, dev,
+		    TQ_SLEEP, &dev->l2ad_feed_tqent);
+	}
+	mutex_exit(&l2arc_dev_mtx);
+
+	return (next);
+}
+
+/*
+ * This thread feeds the L2ARC at regular intervals.  This is the beating
+ * heart of the L2ARC.  The writes themselves are done by l2arc_feed_dev()
+ * tasks, one per cache device at a time.
+ */
+static  __attribute__((noreturn)) void
+l2arc_feed_thread(void *unused)
+{
+	(void) unused;
+	callb_cpr_t cpr;
+	clock_t next = ddi_get_lbolt();
+
+	CALLB_CPR_INIT(&cpr, &l2arc_feed_thr_lock, callb_generic_cpr, FTAG);
+
+	mutex_enter(&l2arc_feed_thr_lock);
+
+	while (l2arc_thread_exit == 0) {
+		CALLB_CPR_SAFE_BEGIN(&cpr);
+		(void) cv_timedwait_idle(&l2arc_feed_thr_cv,
+		    &l2arc_feed_thr_lock, next);
+		CALLB_CPR_SAFE_END(&cpr, &l2arc_feed_thr_lock);
+
+		next = l2arc_feed_dispatch();
+	}
+
 	l2arc_thread_exit = 0;
 	cv_broadcast(&l2arc_feed_thr_cv);
 	CALLB_CPR_EXIT(&cpr);		/* drops l2arc_feed_thr_lock */
@@ -9984,6 +10399,7 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	adddev->l2ad_writing = B_FALSE;
 	adddev->l2ad_trim_all = B_FALSE;
 	list_link_init(&adddev->l2ad_node);
+	taskq_init_ent(&adddev->l2ad_feed_tqent);
 	adddev->l2ad_dev_hdr = kmem_zalloc(l2dhdr_asize, KM_SLEEP);
 
 	mutex_init(&adddev->l2ad_mtx, NULL, MUTEX_DEFAULT, NULL);
@@ -10138,8 +10554,8 @@ l2arc_remove_vdev(vdev_t *vd)
 	 */
 	ASSERT(spa_config_held(spa, SCL_L2ARC, RW_WRITER) & SCL_L2ARC);
 	mutex_enter(&l2arc_dev_mtx);
+	ASSERT(!remdev->l2ad_feeding);
 	list_remove(l2arc_dev_list, remdev);
-	l2arc_dev_last = NULL;		/* may have been invalidated */
 	atomic_dec_64(&l2arc_ndev);
 
 	/* During a pool export spa & vdev will no longer be valid */
@@ -10179,6 +10595,9 @@ l2arc_init(void)
 	    offsetof(l2arc_dev_t, l2ad_node));
 	list_create(l2arc_free_on_write, sizeof (l2arc_data_free_t),
 	    offsetof(l2arc_data_free_t, l2df_list_node));
+
+	l2arc_sketch = vmem_zalloc(L2ARC_SKETCH_DEPTH * L2ARC_SKETCH_WIDTH,
+	    KM_SLEEP);
 }
 
 void
@@ -10193,6 +10612,9 @@ l2arc_fini(void)
 
 	list_destroy(l2arc_dev_list);
 	list_destroy(l2arc_free_on_write);
+
+	vmem_free(l2arc_sketch, L2ARC_SKETCH_DEPTH * L2ARC_SKETCH_WIDTH);
+	l2arc_sketch = NULL;
 }
 
 void
@@ -10201,6 +10623,8 @@ l2arc_start(void)
 	if (!(spa_mode_global & SPA_MODE_WRITE))
 		return;
 
+	l2arc_feed_taskq = taskq_create("l2arc_feed", boot_ncpus,
+	    defclsyspri, 1, INT_MAX, TASKQ_DYNAMIC);
 	(void) thread_create(NULL, 0, l2arc_feed_thread, NULL, 0, &p0,
 	    TS_RUN, defclsyspri);
 }
@@ -10217,6 +10641,10 @@ l2arc_stop(void)
 	while (l2arc_thread_exit != 0)
 		cv_wait(&l2arc_feed_thr_cv, &l2arc_feed_thr_lock);
 	mutex_exit(&l2arc_feed_thr_lock);
+
+	taskq_wait(l2arc_feed_taskq);
+	taskq_destroy(l2arc_feed_taskq);
+	l2arc_feed_taskq = NULL;
 }
 
 /*
@@ -10821,9 +11249,10 @@ l2arc_hdr_restore(const l2arc_log_ent_phys_t *le, l2arc_dev_t *dev)
 		if (!HDR_HAS_L2HDR(exists)) {
 			arc_hdr_set_flags(exists, ARC_FLAG_HAS_L2HDR);
 			exists->b_l2hdr.b_dev = dev;
-			exists->b_l2hdr.b_daddr = le->le_daddr;
-			exists->b_l2hdr.b_arcs_state =
-			    L2BLK_GET_STATE((le)->le_prop);
+			exists->b_l2hdr.b_l2prop = 0;
+			L2HDR_SET_DADDR(&exists->b_l2hdr, le->le_daddr);
+			L2HDR_SET_STATE(&exists->b_l2hdr,
+			    L2BLK_GET_STATE((le)->le_prop));
 			/* l2arc_hdr_arcstats_update() expects a valid asize */
 			HDR_SET_L2SIZE(exists, asize);
 			mutex_enter(&dev->l2ad_mtx);
@@ -11121,7 +11550,7 @@ l2arc_log_blk_insert(l2arc_dev_t *dev, const arc_buf_hdr_t *hdr)
 	memset(le, 0, sizeof (*le));
 	le->le_dva = hdr->b_dva;
 	le->le_birth = hdr->b_birth;
-	le->le_daddr = hdr->b_l2hdr.b_daddr;
+	le->le_daddr = L2HDR_GET_DADDR(&hdr->b_l2hdr);
 	if (index == 0)
 		dev->l2ad_log_blk_payload_start = le->le_daddr;
 	L2BLK_SET_LSIZE((le)->le_prop, HDR_GET_LSIZE(hdr));
@@ -11131,7 +11560,7 @@ l2arc_log_blk_insert(l2arc_dev_t *dev, const arc_buf_hdr_t *hdr)
 	L2BLK_SET_TYPE((le)->le_prop, hdr->b_type);
 	L2BLK_SET_PROTECTED((le)->le_prop, !!(HDR_PROTECTED(hdr)));
 	L2BLK_SET_PREFETCH((le)->le_prop, !!(HDR_PREFETCH(hdr)));
-	L2BLK_SET_STATE((le)->le_prop, hdr->b_l2hdr.b_arcs_state);
+	L2BLK_SET_STATE((le)->le_prop, L2HDR_GET_STATE(&hdr->b_l2hdr));
 
 	dev->l2ad_log_blk_payload_asize += vdev_psize_to_asize(dev->l2ad_vdev,
 	    HDR_GET_PSIZE(hdr));
@@ -11182,6 +11611,7 @@ l2arc_range_check_overlap(uint64_t bottom, uint64_t top, uint64_t check)
 EXPORT_SYMBOL(arc_buf_size);
 EXPORT_SYMBOL(arc_write);
 EXPORT_SYMBOL(arc_read);
+EXPORT_SYMBOL(arc_read_many);
 EXPORT_SYMBOL(arc_buf_info);
 EXPORT_SYMBOL(arc_getbuf_func);
 EXPORT_SYMBOL(arc_add_prune_callback);
@@ -11205,6 +11635,12 @@ ZFS_MODULE_PARAM_CALL(zfs_arc, zfs_arc_, shrink_shift, param_set_arc_int,
 ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, pc_percent, UINT, ZMOD_RW,
 	"Percent of pagecache to reclaim ARC to");
 
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, direct_reclaim_limit, UINT, ZMOD_RW,
+	"Direct reclaims per second before the ARC shrinks itself");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, low_priority_limit, UINT, ZMOD_RW,
+	"Percent of ARC which arcpriority=low datasets may fill");
+
 ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, average_blocksize, UINT, ZMOD_RD,
 	"Target average block size");
 
@@ -11257,6 +11693,9 @@ ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, rebuild_enabled, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, rebuild_blocks_min_l2size, U64, ZMOD_RW,
 	"Min size in bytes to write rebuild log blocks in L2ARC");
 
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, admit_lfu, INT, ZMOD_RW,
+	"Only write buffers accessed more often than the ones they replace");
+
 ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, mfuonly, INT, ZMOD_RW,
 	"Cache only MFU data from ARC into L2ARC");
 
@@ -11288,5 +11727,8 @@ ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, evict_batch_limit, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, prune_task_threads, INT, ZMOD_RW,
 	"Number of arc_prune threads");
 
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, prune_targeted, INT, ZMOD_RW,
+	"Share arc_prune requests among consumers by their object counts");
+
 ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, evict_threads, UINT, ZMOD_RD,
 	"Number of threads to use for ARC eviction.");
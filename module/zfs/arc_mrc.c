@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * ARC miss ratio curve estimation
+ *
+ * To answer "what would the hit ratio be with N bytes of cache" we need
+ * the reuse distance of every access: the number of distinct bytes
+ * accessed since the previous access to the same block.  Any access
+ * whose reuse distance is smaller than N would be a hit in an LRU cache
+ * of N bytes.  Tracking this for every block is far too expensive, so we
+ * use spatially hashed sampling (SHARDS, Waldspurger et al., FAST '15):
+ * a block is tracked only when the hash of its identity falls into
+ * 1 / 2^zfs_arc_mrc_sample_shift of the hash space.  Because the choice
+ * is made by identity, every access to a tracked block is seen, and the
+ * reuse distances measured over the sample only need to be scaled back
+ * up by 2^zfs_arc_mrc_sample_shift.
+ *
+ * Tracked blocks are kept on an LRU list, with an AVL tree to find them.
+ * The reuse distance of an access is the sum of the sizes of the entries
+ * in front of the block on the list.  Walking the list costs at most
+ * zfs_arc_mrc_max_entries steps, but only for sampled accesses, and the
+ * walk is done under a lock private to the estimator.  When the list is
+ * full the least recently used entry is dropped, and a later access to
+ * that block counts as a cold miss.  With the default sampling rate and
+ * 16384 entries of 128K blocks this covers caches of up to 2 TiB.
+ *
+ * The results are exported in the arcmrc kstat as cumulative counts: the
+ * hits_<size> counter is the number of sampled accesses that would have
+ * been cache hits with <size> bytes of ARC.  Dividing by "accesses" gives
+ * the predicted hit ratio at that size.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/arc_impl.h>
+#include <sys/avl.h>
+#include <cityhash.h>
+
+/*
+ * Track 1 in 2^zfs_arc_mrc_sample_shift blocks.
+ */
+static uint_t zfs_arc_mrc_sample_shift = 10;
+
+/*
+ * Maximum number of sampled blocks to track.  Each takes about 64 bytes
+ * of memory.  Set to 0 (the default) to disable the estimator.
+ */
+static uint_t zfs_arc_mrc_max_entries = 0;
+
+/*
+ * Curve points, one per power of two cache size from 2^MRC_MIN_SHIFT
+ * (1 MiB) to 2^(MRC_MIN_SHIFT + MRC_BUCKETS - 1) (512 TiB).
+ */
+#define	MRC_MIN_SHIFT	20
+#define	MRC_BUCKETS	30
+
+typedef struct mrc_entry {
+	uint64_t	me_spa;
+	dva_t		me_dva;
+	uint64_t	me_birth;
+	uint64_t	me_size;
+	avl_node_t	me_avl;
+	list_node_t	me_lru;
+} mrc_entry_t;
+
+typedef struct arc_mrc {
+	kmutex_t	mrc_lock;
+	avl_tree_t	mrc_tree;
+	list_t		mrc_lru;	/* head is most recently used */
+	uint64_t	mrc_count;
+	uint_t		mrc_shift;	/* sample shift the data was taken at */
+	uint64_t	mrc_accesses;
+	uint64_t	mrc_cold;
+	uint64_t	mrc_hist[MRC_BUCKETS];
+} arc_mrc_t;
+
+typedef struct arc_mrc_stats {
+	kstat_named_t	ams_sample_shift;
+	kstat_named_t	ams_entries;
+	kstat_named_t	ams_accesses;
+	kstat_named_t	ams_cold;
+	kstat_named_t	ams_hits[MRC_BUCKETS];
+} arc_mrc_stats_t;
+
+static arc_mrc_t arc_mrc;
+static arc_mrc_stats_t arc_mrc_stats;
+static kstat_t *arc_mrc_ksp;
+
+static int
+mrc_entry_compare(const void *x1, const void *x2)
+{
+	const mrc_entry_t *e1 = x1;
+	const mrc_entry_t *e2 = x2;
+
+	int cmp = TREE_CMP(e1->me_dva.dva_word[1], e2->me_dva.dva_word[1]);
+	if (likely(cmp))
+		return (cmp);
+	cmp = TREE_CMP(e1->me_dva.dva_word[0], e2->me_dva.dva_word[0]);
+	if (likely(cmp))
+		return (cmp);
+	cmp = TREE_CMP(e1->me_birth, e2->me_birth);
+	if (likely(cmp))
+		return (cmp);
+	return (TREE_CMP(e1->me_spa, e2->me_spa));
+}
+
+/*
+ * Forget everything collected so far.  Called when the estimator is
+ * disabled or its sampling rate changes.
+ */
+static void
+arc_mrc_reset(arc_mrc_t *mrc, uint_t shift)
+{
+	mrc_entry_t *me;
+
+	ASSERT(MUTEX_HELD(&mrc->mrc_lock));
+
+	while ((me = list_remove_head(&mrc->mrc_lru)) != NULL) {
+		avl_remove(&mrc->mrc_tree, me);
+		kmem_free(me, sizeof (*me));
+	}
+	mrc->mrc_count = 0;
+	mrc->mrc_accesses = 0;
+	mrc->mrc_cold = 0;
+	memset(mrc->mrc_hist, 0, sizeof (mrc->mrc_hist));
+	mrc->mrc_shift = shift;
+}
+
+/*
+ * Record an access of the block identified by (spa, dva, birth).  Called
+ * from arc_access() for every access; returns quickly unless the block
+ * is part of the sample.
+ */
+void
+arc_mrc_access(uint64_t spa, const dva_t *dva, uint64_t birth, uint64_t size)
+{
+	arc_mrc_t *mrc = &arc_mrc;
+	uint_t max_entries = zfs_arc_mrc_max_entries;
+	uint_t shift = MIN(zfs_arc_mrc_sample_shift, 63);
+
+	if (max_entries == 0 && mrc->mrc_count == 0)
+		return;
+
+	uint64_t hash = cityhash4(spa, dva->dva_word[0], dva->dva_word[1],
+	    birth);
+	if ((hash & ((1ULL << shift) - 1)) != 0)
+		return;
+
+	mutex_enter(&mrc->mrc_lock);
+	if (max_entries == 0 || mrc->mrc_shift != shift) {
+		arc_mrc_reset(mrc, shift);
+		if (max_entries == 0) {
+			mutex_exit(&mrc->mrc_lock);
+			return;
+		}
+	}
+
+	mrc_entry_t search = {
+		.me_spa = spa,
+		.me_dva = *dva,
+		.me_birth = birth,
+	};
+	avl_index_t where;
+	mrc_entry_t *me = avl_find(&mrc->mrc_tree, &search, &where);
+
+	mrc->mrc_accesses++;
+	if (me != NULL) {
+		uint64_t distance = 0;
+
+		for (mrc_entry_t *e = list_head(&mrc->mrc_lru); e != me;
+		    e = list_next(&mrc->mrc_lru, e))
+			distance += e->me_size;
+		distance <<= shift;
+
+		/*
+		 * A reuse at this distance is a hit in any cache larger
+		 * than the distance, so count it at the first curve point
+		 * above it.
+		 */
+		int b = MAX((int)highbit64(distance) - MRC_MIN_SHIFT, 0);
+		if (b < MRC_BUCKETS)
+			mrc->mrc_hist[b]++;
+		else
+			mrc->mrc_cold++;
+
+		me->me_size = size;
+		list_remove(&mrc->mrc_lru, me);
+		list_insert_head(&mrc->mrc_lru, me);
+	} else {
+		mrc->mrc_cold++;
+
+		me = kmem_alloc(sizeof (*me), KM_NOSLEEP);
+		if (me != NULL) {
+			*me = search;
+			me->me_size = size;
+			avl_insert(&mrc->mrc_tree, me, where);
+			list_insert_head(&mrc->mrc_lru, me);
+			mrc->mrc_count++;
+		}
+	}
+
+	while (mrc->mrc_count > max_entries) {
+		me = list_remove_tail(&mrc->mrc_lru);
+		avl_remove(&mrc->mrc_tree, me);
+		kmem_free(me, sizeof (*me));
+		mrc->mrc_count--;
+	}
+	mutex_exit(&mrc->mrc_lock);
+}
+
+static int
+arc_mrc_kstat_update(kstat_t *ksp, int rw)
+{
+	arc_mrc_t *mrc = &arc_mrc;
+	arc_mrc_stats_t *ams = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	mutex_enter(&mrc->mrc_lock);
+	ams->ams_sample_shift.value.ui64 = mrc->mrc_shift;
+	ams->ams_entries.value.ui64 = mrc->mrc_count;
+	ams->ams_accesses.value.ui64 = mrc->mrc_accesses;
+	ams->ams_cold.value.ui64 = mrc->mrc_cold;
+	uint64_t hits = 0;
+	for (int b = 0; b < MRC_BUCKETS; b++) {
+		hits += mrc->mrc_hist[b];
+		ams->ams_hits[b].value.ui64 = hits;
+	}
+	mutex_exit(&mrc->mrc_lock);
+
+	return (0);
+}
+
+static void
+arc_mrc_stat_init(kstat_named_t *ksn, const char *name)
+{
+	(void) strlcpy(ksn->name, name, sizeof (ksn->name));
+	ksn->data_type = KSTAT_DATA_UINT64;
+}
+
+void
+arc_mrc_init(void)
+{
+	arc_mrc_t *mrc = &arc_mrc;
+	arc_mrc_stats_t *ams = &arc_mrc_stats;
+	static const char units[] = "MGTP";
+
+	mutex_init(&mrc->mrc_lock, NULL, MUTEX_DEFAULT, NULL);
+	avl_create(&mrc->mrc_tree, mrc_entry_compare, sizeof (mrc_entry_t),
+	    offsetof(mrc_entry_t, me_avl));
+	list_create(&mrc->mrc_lru, sizeof (mrc_entry_t),
+	    offsetof(mrc_entry_t, me_lru));
+	mrc->mrc_shift = MIN(zfs_arc_mrc_sample_shift, 63);
+
+	arc_mrc_stat_init(&ams->ams_sample_shift, "sample_shift");
+	arc_mrc_stat_init(&ams->ams_entries, "entries");
+	arc_mrc_stat_init(&ams->ams_accesses, "accesses");
+	arc_mrc_stat_init(&ams->ams_cold, "cold");
+	for (int b = 0; b < MRC_BUCKETS; b++) {
+		char name[KSTAT_STRLEN];
+
+		(void) snprintf(name, sizeof (name), "hits_%u%c",
+		    1U << (b % 10), units[b / 10]);
+		arc_mrc_stat_init(&ams->ams_hits[b], name);
+	}
+
+	arc_mrc_ksp = kstat_create("zfs", 0, "arcmrc", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (arc_mrc_stats_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (arc_mrc_ksp != NULL) {
+		arc_mrc_ksp->ks_data = ams;
+		arc_mrc_ksp->ks_update = arc_mrc_kstat_update;
+		kstat_install(arc_mrc_ksp);
+	}
+}
+
+void
+arc_mrc_fini(void)
+{
+	arc_mrc_t *mrc = &arc_mrc;
+
+	if (arc_mrc_ksp != NULL) {
+		kstat_delete(arc_mrc_ksp);
+		arc_mrc_ksp = NULL;
+	}
+
+	mutex_enter(&mrc->mrc_lock);
+	arc_mrc_reset(mrc, mrc->mrc_shift);
+	mutex_exit(&mrc->mrc_lock);
+
+	list_destroy(&mrc->mrc_lru);
+	avl_destroy(&mrc->mrc_tree);
+	mutex_destroy(&mrc->mrc_lock);
+}
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, mrc_sample_shift, UINT, ZMOD_RW,
+	"Track 1 in 2^N blocks for miss ratio curve estimation");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, mrc_max_entries, UINT, ZMOD_RW,
+	"Max sampled blocks for miss ratio curve estimation, 0 to disable");
@@ -58,6 +58,7 @@ abd_checksum_blake3_native(abd_t *abd, uint64_t size, const void *ctx_template,
 #endif
 
 	memcpy(ctx, ctx_template, sizeof (*ctx));
+	Blake3_SizeHint(ctx, size);
 	(void) abd_iterate_func(abd, 0, size, blake3_incremental, ctx);
 	Blake3_Final(ctx, (uint8_t *)zcp);
 
@@ -69,6 +70,36 @@ abd_checksum_blake3_native(abd_t *abd, uint64_t size, const void *ctx_template,
 #endif
 }
 
+/*
+ * Computes the native BLAKE3 checksums of n buffers of the same power of two
+ * size at once. Hashing the buffers side by side lets the multi-buffer
+ * kernels fill all of their lanes even when a single buffer is too small to
+ * do so on its own. The results are identical to those of
+ * abd_checksum_blake3_native.
+ */
+void
+abd_checksum_blake3_native_many(abd_t **abds, uint_t n, uint64_t size,
+    const void *ctx_template, zio_cksum_t *zcp)
+{
+	const uint8_t *bufs[BLAKE3_MANY_MAX];
+	size_t scratch_size = BLAKE3_MANY_SCRATCH(n, size);
+	uint8_t *scratch;
+
+	ASSERT(ctx_template != NULL);
+	ASSERT3U(n, <=, BLAKE3_MANY_MAX);
+	ASSERT(ISP2(size));
+
+	scratch = kmem_alloc(scratch_size, KM_SLEEP);
+	for (uint_t i = 0; i < n; i++)
+		bufs[i] = abd_borrow_buf_copy(abds[i], size);
+
+	Blake3_HashMany(ctx_template, bufs, n, size, (uint8_t *)zcp, scratch);
+
+	for (uint_t i = 0; i < n; i++)
+		abd_return_buf(abds[i], (void *)bufs[i], size);
+	kmem_free(scratch, scratch_size);
+}
+
 /*
  * Byteswapped version of abd_checksum_blake3_native. This just invokes
  * the native checksum function and byteswaps the resulting checksum (since
@@ -302,3 +302,37 @@ bptree_iterate(objset_t *os, uint64_t obj, boolean_t free, bptree_itor_t func,
 
 	return (err);
 }
+
+/*
+ * Copy out up to *count of the entries that remain to be traversed, in
+ * queue order, starting with the one bptree_iterate() will resume from.
+ * Entries that are already finished but could not be logically removed
+ * because of earlier i/o errors are skipped.  On return *count holds the
+ * number of entries copied.
+ */
+int
+bptree_get_entries(objset_t *os, uint64_t obj, bptree_entry_phys_t *entries,
+    uint64_t *count)
+{
+	dmu_buf_t *db;
+	uint64_t n = 0;
+	int err;
+
+	err = dmu_bonus_hold(os, obj, FTAG, &db);
+	if (err != 0)
+		return (err);
+
+	bptree_phys_t *bt = db->db_data;
+	for (uint64_t i = bt->bt_begin; i < bt->bt_end && n < *count; i++) {
+		err = dmu_read(os, obj, i * sizeof (entries[n]),
+		    sizeof (entries[n]), &entries[n], DMU_READ_NO_PREFETCH);
+		if (err != 0)
+			break;
+		if (entries[n].be_birth_txg != UINT64_MAX)
+			n++;
+	}
+
+	dmu_buf_rele(db, FTAG);
+	*count = n;
+	return (err);
+}
@@ -327,6 +327,26 @@ brt_unlock(spa_t *spa)
 	rw_exit(&spa->spa_brt_lock);
 }
 
+/*
+ * Block offsets are aligned to at least the minimum block size, so hash them
+ * (Fibonacci hashing) rather than using the low bits directly.
+ */
+static brt_shard_t *
+brt_shard(brt_vdev_t *brtvd, uint64_t off)
+{
+	uint64_t h = (off >> SPA_MINBLOCKSHIFT) * 0x9e3779b97f4a7c15ULL;
+	return (&brtvd->bv_shard[h >> (64 - BRT_SHARDS_SHIFT)]);
+}
+
+static uint64_t
+brt_vdev_numnodes(brt_vdev_t *brtvd)
+{
+	uint64_t n = 0;
+	for (int i = 0; i < BRT_SHARDS; i++)
+		n += avl_numnodes(&brtvd->bv_shard[i].bs_tree);
+	return (n);
+}
+
 static uint16_t
 brt_vdev_entcount_get(const brt_vdev_t *brtvd, uint64_t idx)
 {
@@ -424,17 +444,24 @@ brt_vdev(spa_t *spa, uint64_t vdevid, boolean_t alloc)
 {
 	brt_vdev_t *brtvd = NULL;
 
-	brt_rlock(spa);
-	if (vdevid < spa->spa_brt_nvdevs) {
-		brtvd = spa->spa_brt_vdevs[vdevid];
-	} else if (alloc) {
-		/* New VDEV was added. */
-		brt_unlock(spa);
-		brt_wlock(spa);
-		if (vdevid >= spa->spa_brt_nvdevs)
-			brt_vdevs_expand(spa, vdevid + 1);
-		brtvd = spa->spa_brt_vdevs[vdevid];
-	}
+	/*
+	 * This is called for every clone and free, so avoid bouncing the
+	 * spa_brt_lock cache line between CPUs. brt_vdevs_expand() publishes
+	 * the new array before the new count, and keeps the old arrays, so
+	 * any array we see is valid for any count we see before it.
+	 */
+	uint64_t nvdevs = atomic_load_64(&spa->spa_brt_nvdevs);
+	membar_consumer();
+	if (vdevid < nvdevs)
+		return (spa->spa_brt_vdevs[vdevid]);
+	if (!alloc)
+		return (NULL);
+
+	/* New VDEV was added. */
+	brt_wlock(spa);
+	if (vdevid >= spa->spa_brt_nvdevs)
+		brt_vdevs_expand(spa, vdevid + 1);
+	brtvd = spa->spa_brt_vdevs[vdevid];
 	brt_unlock(spa);
 	return (brtvd);
 }
@@ -599,7 +626,7 @@ brt_vdev_dealloc(brt_vdev_t *brtvd)
 {
 	ASSERT(RW_WRITE_HELD(&brtvd->bv_lock));
 	ASSERT(brtvd->bv_initiated);
-	ASSERT0(avl_numnodes(&brtvd->bv_tree));
+	ASSERT0(brt_vdev_numnodes(brtvd));
 
 	vmem_free(brtvd->bv_entcount, sizeof (uint16_t) * brtvd->bv_size);
 	brtvd->bv_entcount = NULL;
@@ -677,31 +704,44 @@ brt_vdevs_expand(spa_t *spa, uint64_t nvdevs)
 
 		memcpy(vdevs, spa->spa_brt_vdevs,
 		    sizeof (*spa->spa_brt_vdevs) * spa->spa_brt_nvdevs);
-		kmem_free(spa->spa_brt_vdevs,
-		    sizeof (*spa->spa_brt_vdevs) * spa->spa_brt_nvdevs);
+
+		/* brt_vdev() may still be looking at the old array. */
+		brt_vdevs_retired_t *bvr = kmem_alloc(sizeof (*bvr), KM_SLEEP);
+		bvr->bvr_vdevs = spa->spa_brt_vdevs;
+		bvr->bvr_nvdevs = spa->spa_brt_nvdevs;
+		bvr->bvr_next = spa->spa_brt_vdevs_retired;
+		spa->spa_brt_vdevs_retired = bvr;
 	}
-	spa->spa_brt_vdevs = vdevs;
 
 	for (uint64_t vdevid = spa->spa_brt_nvdevs; vdevid < nvdevs; vdevid++) {
 		brt_vdev_t *brtvd = kmem_zalloc(sizeof (*brtvd), KM_SLEEP);
 		rw_init(&brtvd->bv_lock, NULL, RW_DEFAULT, NULL);
+		mutex_init(&brtvd->bv_entcount_lock, NULL, MUTEX_DEFAULT, NULL);
 		brtvd->bv_vdevid = vdevid;
 		brtvd->bv_initiated = FALSE;
 		rw_init(&brtvd->bv_mos_entries_lock, NULL, RW_DEFAULT, NULL);
-		avl_create(&brtvd->bv_tree, brt_entry_compare,
-		    sizeof (brt_entry_t), offsetof(brt_entry_t, bre_node));
-		for (int i = 0; i < TXG_SIZE; i++) {
-			avl_create(&brtvd->bv_pending_tree[i],
-			    brt_entry_compare, sizeof (brt_entry_t),
+		for (int s = 0; s < BRT_SHARDS; s++) {
+			brt_shard_t *bs = &brtvd->bv_shard[s];
+			mutex_init(&bs->bs_lock, NULL, MUTEX_DEFAULT, NULL);
+			avl_create(&bs->bs_tree, brt_entry_compare,
+			    sizeof (brt_entry_t),
 			    offsetof(brt_entry_t, bre_node));
+			mutex_init(&bs->bs_pending_lock, NULL, MUTEX_DEFAULT,
+			    NULL);
+			for (int i = 0; i < TXG_SIZE; i++) {
+				avl_create(&bs->bs_pending_tree[i],
+				    brt_entry_compare, sizeof (brt_entry_t),
+				    offsetof(brt_entry_t, bre_node));
+			}
 		}
-		mutex_init(&brtvd->bv_pending_lock, NULL, MUTEX_DEFAULT, NULL);
-		spa->spa_brt_vdevs[vdevid] = brtvd;
+		vdevs[vdevid] = brtvd;
 	}
 
 	BRT_DEBUG("BRT VDEVs expanded from %llu to %llu.",
 	    (u_longlong_t)spa->spa_brt_nvdevs, (u_longlong_t)nvdevs);
-	spa->spa_brt_nvdevs = nvdevs;
+	spa->spa_brt_vdevs = vdevs;
+	membar_producer();
+	atomic_store_64(&spa->spa_brt_nvdevs, nvdevs);
 }
 
 static boolean_t
@@ -723,29 +763,30 @@ brt_vdev_addref(spa_t *spa, brt_vdev_t *brtvd, const brt_entry_t *bre,
 
 	ASSERT(brtvd->bv_initiated);
 
-	brtvd->bv_savedspace += dsize * count;
-	brtvd->bv_meta_dirty = TRUE;
-
-	if (bre->bre_count > 0)
-		return;
-
-	brtvd->bv_usedspace += dsize;
-
 	idx = BRE_OFFSET(bre) / spa->spa_brt_rangesize;
-	if (idx >= brtvd->bv_size) {
+	if (bre->bre_count == 0 && idx >= brtvd->bv_size) {
 		/* VDEV has been expanded. */
 		rw_enter(&brtvd->bv_lock, RW_WRITER);
 		brt_vdev_realloc(spa, brtvd);
 		rw_exit(&brtvd->bv_lock);
 	}
 
-	ASSERT3U(idx, <, brtvd->bv_size);
+	mutex_enter(&brtvd->bv_entcount_lock);
+	brtvd->bv_savedspace += dsize * count;
+	brtvd->bv_meta_dirty = TRUE;
+
+	if (bre->bre_count == 0) {
+		brtvd->bv_usedspace += dsize;
 
-	brtvd->bv_totalcount++;
-	brt_vdev_entcount_inc(brtvd, idx);
-	brtvd->bv_entcount_dirty = TRUE;
-	idx = idx / BRT_BLOCKSIZE / 8;
-	BT_SET(brtvd->bv_bitmap, idx);
+		ASSERT3U(idx, <, brtvd->bv_size);
+
+		brtvd->bv_totalcount++;
+		brt_vdev_entcount_inc(brtvd, idx);
+		brtvd->bv_entcount_dirty = TRUE;
+		idx = idx / BRT_BLOCKSIZE / 8;
+		BT_SET(brtvd->bv_bitmap, idx);
+	}
+	mutex_exit(&brtvd->bv_entcount_lock);
 }
 
 static void
@@ -754,26 +795,27 @@ brt_vdev_decref(spa_t *spa, brt_vdev_t *brtvd, const brt_entry_t *bre,
 {
 	uint64_t idx;
 
-	ASSERT(RW_WRITE_HELD(&brtvd->bv_lock));
+	ASSERT(RW_LOCK_HELD(&brtvd->bv_lock));
 	ASSERT(brtvd->bv_initiated);
 
+	mutex_enter(&brtvd->bv_entcount_lock);
 	brtvd->bv_savedspace -= dsize;
 	brtvd->bv_meta_dirty = TRUE;
 
-	if (bre->bre_count > 0)
-		return;
-
-	brtvd->bv_usedspace -= dsize;
+	if (bre->bre_count == 0) {
+		brtvd->bv_usedspace -= dsize;
 
-	idx = BRE_OFFSET(bre) / spa->spa_brt_rangesize;
-	ASSERT3U(idx, <, brtvd->bv_size);
+		idx = BRE_OFFSET(bre) / spa->spa_brt_rangesize;
+		ASSERT3U(idx, <, brtvd->bv_size);
 
-	ASSERT(brtvd->bv_totalcount > 0);
-	brtvd->bv_totalcount--;
-	brt_vdev_entcount_dec(brtvd, idx);
-	brtvd->bv_entcount_dirty = TRUE;
-	idx = idx / BRT_BLOCKSIZE / 8;
-	BT_SET(brtvd->bv_bitmap, idx);
+		ASSERT(brtvd->bv_totalcount > 0);
+		brtvd->bv_totalcount--;
+		brt_vdev_entcount_dec(brtvd, idx);
+		brtvd->bv_entcount_dirty = TRUE;
+		idx = idx / BRT_BLOCKSIZE / 8;
+		BT_SET(brtvd->bv_bitmap, idx);
+	}
+	mutex_exit(&brtvd->bv_entcount_lock);
 }
 
 static void
@@ -831,17 +873,30 @@ brt_vdevs_free(spa_t *spa)
 			brt_vdev_dealloc(brtvd);
 		rw_exit(&brtvd->bv_lock);
 		rw_destroy(&brtvd->bv_lock);
+		mutex_destroy(&brtvd->bv_entcount_lock);
 		if (brtvd->bv_mos_entries != 0)
 			dnode_rele(brtvd->bv_mos_entries_dnode, brtvd);
 		rw_destroy(&brtvd->bv_mos_entries_lock);
-		avl_destroy(&brtvd->bv_tree);
-		for (int i = 0; i < TXG_SIZE; i++)
-			avl_destroy(&brtvd->bv_pending_tree[i]);
-		mutex_destroy(&brtvd->bv_pending_lock);
+		for (int s = 0; s < BRT_SHARDS; s++) {
+			brt_shard_t *bs = &brtvd->bv_shard[s];
+			avl_destroy(&bs->bs_tree);
+			mutex_destroy(&bs->bs_lock);
+			for (int i = 0; i < TXG_SIZE; i++)
+				avl_destroy(&bs->bs_pending_tree[i]);
+			mutex_destroy(&bs->bs_pending_lock);
+		}
 		kmem_free(brtvd, sizeof (*brtvd));
 	}
 	kmem_free(spa->spa_brt_vdevs, sizeof (*spa->spa_brt_vdevs) *
 	    spa->spa_brt_nvdevs);
+
+	brt_vdevs_retired_t *bvr;
+	while ((bvr = spa->spa_brt_vdevs_retired) != NULL) {
+		spa->spa_brt_vdevs_retired = bvr->bvr_next;
+		kmem_free(bvr->bvr_vdevs,
+		    sizeof (*bvr->bvr_vdevs) * bvr->bvr_nvdevs);
+		kmem_free(bvr, sizeof (*bvr));
+	}
 }
 
 static void
@@ -1044,16 +1099,24 @@ brt_entry_decref(spa_t *spa, const blkptr_t *bp)
 
 	brt_vdev_t *brtvd = brt_vdev(spa, vdevid, B_FALSE);
 	ASSERT(brtvd != NULL);
+	brt_shard_t *bs = brt_shard(brtvd, BRE_OFFSET(&bre_search));
 
-	rw_enter(&brtvd->bv_lock, RW_WRITER);
+	/*
+	 * Frees of different blocks only contend on the shard lock; the
+	 * reader hold on bv_lock keeps the entcount array from being
+	 * reallocated or synced underneath us.
+	 */
+	rw_enter(&brtvd->bv_lock, RW_READER);
 	ASSERT(brtvd->bv_initiated);
-	bre = avl_find(&brtvd->bv_tree, &bre_search, NULL);
+	mutex_enter(&bs->bs_lock);
+	bre = avl_find(&bs->bs_tree, &bre_search, NULL);
 	if (bre != NULL) {
 		BRTSTAT_BUMP(brt_decref_entry_in_memory);
 		goto out;
 	} else {
 		BRTSTAT_BUMP(brt_decref_entry_not_in_memory);
 	}
+	mutex_exit(&bs->bs_lock);
 	rw_exit(&brtvd->bv_lock);
 
 	error = brt_entry_lookup(brtvd, &bre_search);
@@ -1064,8 +1127,9 @@ brt_entry_decref(spa_t *spa, const blkptr_t *bp)
 	}
 	ASSERT0(error);
 
-	rw_enter(&brtvd->bv_lock, RW_WRITER);
-	racebre = avl_find(&brtvd->bv_tree, &bre_search, &where);
+	rw_enter(&brtvd->bv_lock, RW_READER);
+	mutex_enter(&bs->bs_lock);
+	racebre = avl_find(&bs->bs_tree, &bre_search, &where);
 	if (racebre != NULL) {
 		/* The entry was added when the lock was dropped. */
 		BRTSTAT_BUMP(brt_decref_entry_read_lost_race);
@@ -1078,10 +1142,11 @@ brt_entry_decref(spa_t *spa, const blkptr_t *bp)
 	bre->bre_bp = bre_search.bre_bp;
 	bre->bre_count = bre_search.bre_count;
 	bre->bre_pcount = 0;
-	avl_insert(&brtvd->bv_tree, bre, where);
+	avl_insert(&bs->bs_tree, bre, where);
 
 out:
 	if (bre->bre_count == 0) {
+		mutex_exit(&bs->bs_lock);
 		rw_exit(&brtvd->bv_lock);
 		BRTSTAT_BUMP(brt_decref_free_data_now);
 		return (B_TRUE);
@@ -1096,6 +1161,7 @@ out:
 		BRTSTAT_BUMP(brt_decref_entry_still_referenced);
 	brt_vdev_decref(spa, brtvd, bre, bp_get_dsize_sync(spa, bp));
 
+	mutex_exit(&bs->bs_lock);
 	rw_exit(&brtvd->bv_lock);
 
 	return (B_FALSE);
@@ -1113,10 +1179,14 @@ brt_entry_get_refcount(spa_t *spa, const blkptr_t *bp)
 	brt_vdev_t *brtvd = brt_vdev(spa, vdevid, B_FALSE);
 	ASSERT(brtvd != NULL);
 
+	brt_shard_t *bs = brt_shard(brtvd, BRE_OFFSET(&bre_search));
+
 	rw_enter(&brtvd->bv_lock, RW_READER);
 	ASSERT(brtvd->bv_initiated);
-	bre = avl_find(&brtvd->bv_tree, &bre_search, NULL);
+	mutex_enter(&bs->bs_lock);
+	bre = avl_find(&bs->bs_tree, &bre_search, NULL);
 	if (bre == NULL) {
+		mutex_exit(&bs->bs_lock);
 		rw_exit(&brtvd->bv_lock);
 		error = brt_entry_lookup(brtvd, &bre_search);
 		if (error == ENOENT) {
@@ -1127,6 +1197,7 @@ brt_entry_get_refcount(spa_t *spa, const blkptr_t *bp)
 		}
 	} else {
 		refcnt = bre->bre_count;
+		mutex_exit(&bs->bs_lock);
 		rw_exit(&brtvd->bv_lock);
 	}
 
@@ -1170,14 +1241,15 @@ brt_pending_add(spa_t *spa, const blkptr_t *bp, dmu_tx_t *tx)
 
 	uint64_t vdevid = DVA_GET_VDEV(&bp->blk_dva[0]);
 	brt_vdev_t *brtvd = brt_vdev(spa, vdevid, B_TRUE);
-	avl_tree_t *pending_tree = &brtvd->bv_pending_tree[txg & TXG_MASK];
+	brt_shard_t *bs = brt_shard(brtvd, DVA_GET_OFFSET(&bp->blk_dva[0]));
+	avl_tree_t *pending_tree = &bs->bs_pending_tree[txg & TXG_MASK];
 
 	newbre = kmem_cache_alloc(brt_entry_cache, KM_SLEEP);
 	newbre->bre_bp = *bp;
 	newbre->bre_count = 0;
 	newbre->bre_pcount = 1;
 
-	mutex_enter(&brtvd->bv_pending_lock);
+	mutex_enter(&bs->bs_pending_lock);
 	bre = avl_find(pending_tree, newbre, &where);
 	if (bre == NULL) {
 		avl_insert(pending_tree, newbre, where);
@@ -1185,7 +1257,7 @@ brt_pending_add(spa_t *spa, const blkptr_t *bp, dmu_tx_t *tx)
 	} else {
 		bre->bre_pcount++;
 	}
-	mutex_exit(&brtvd->bv_pending_lock);
+	mutex_exit(&bs->bs_pending_lock);
 
 	if (newbre != NULL) {
 		ASSERT(bre != NULL);
@@ -1211,11 +1283,12 @@ brt_pending_remove(spa_t *spa, const blkptr_t *bp, dmu_tx_t *tx)
 	uint64_t vdevid = DVA_GET_VDEV(&bp->blk_dva[0]);
 	brt_vdev_t *brtvd = brt_vdev(spa, vdevid, B_FALSE);
 	ASSERT(brtvd != NULL);
-	avl_tree_t *pending_tree = &brtvd->bv_pending_tree[txg & TXG_MASK];
+	brt_shard_t *bs = brt_shard(brtvd, DVA_GET_OFFSET(&bp->blk_dva[0]));
+	avl_tree_t *pending_tree = &bs->bs_pending_tree[txg & TXG_MASK];
 
 	bre_search.bre_bp = *bp;
 
-	mutex_enter(&brtvd->bv_pending_lock);
+	mutex_enter(&bs->bs_pending_lock);
 	bre = avl_find(pending_tree, &bre_search, NULL);
 	ASSERT(bre != NULL);
 	ASSERT(bre->bre_pcount > 0);
@@ -1224,26 +1297,27 @@ brt_pending_remove(spa_t *spa, const blkptr_t *bp, dmu_tx_t *tx)
 		avl_remove(pending_tree, bre);
 	else
 		bre = NULL;
-	mutex_exit(&brtvd->bv_pending_lock);
+	mutex_exit(&bs->bs_pending_lock);
 
 	if (bre)
 		kmem_cache_free(brt_entry_cache, bre);
 }
 
 static void
-brt_pending_apply_vdev(spa_t *spa, brt_vdev_t *brtvd, uint64_t txg)
+brt_pending_apply_shard(spa_t *spa, brt_vdev_t *brtvd, brt_shard_t *bs,
+    uint64_t txg)
 {
 	brt_entry_t *bre, *nbre;
 
 	/*
-	 * We are in syncing context, so no other bv_pending_tree accesses
-	 * are possible for the TXG.  So we don't need bv_pending_lock.
+	 * We are in syncing context, so no other bs_pending_tree accesses
+	 * are possible for the TXG.  So we don't need bs_pending_lock.
 	 */
-	ASSERT(avl_is_empty(&brtvd->bv_tree));
-	avl_swap(&brtvd->bv_tree, &brtvd->bv_pending_tree[txg & TXG_MASK]);
+	ASSERT(avl_is_empty(&bs->bs_tree));
+	avl_swap(&bs->bs_tree, &bs->bs_pending_tree[txg & TXG_MASK]);
 
-	for (bre = avl_first(&brtvd->bv_tree); bre; bre = nbre) {
-		nbre = AVL_NEXT(&brtvd->bv_tree, bre);
+	for (bre = avl_first(&bs->bs_tree); bre; bre = nbre) {
+		nbre = AVL_NEXT(&bs->bs_tree, bre);
 
 		/*
 		 * If the block has DEDUP bit set, it means that it
@@ -1257,7 +1331,7 @@ brt_pending_apply_vdev(spa_t *spa, brt_vdev_t *brtvd, uint64_t txg)
 				bre->bre_pcount--;
 			}
 			if (bre->bre_pcount == 0) {
-				avl_remove(&brtvd->bv_tree, bre);
+				avl_remove(&bs->bs_tree, bre);
 				kmem_cache_free(brt_entry_cache, bre);
 				continue;
 			}
@@ -1282,12 +1356,21 @@ brt_pending_apply_vdev(spa_t *spa, brt_vdev_t *brtvd, uint64_t txg)
 			}
 		}
 	}
+}
+
+static void
+brt_pending_apply_vdev(spa_t *spa, brt_vdev_t *brtvd, uint64_t txg)
+{
+	brt_entry_t *bre;
+
+	for (int s = 0; s < BRT_SHARDS; s++)
+		brt_pending_apply_shard(spa, brtvd, &brtvd->bv_shard[s], txg);
 
 	/*
 	 * If all the cloned blocks we had were handled by DDT, we don't need
 	 * to initiate the vdev.
 	 */
-	if (avl_is_empty(&brtvd->bv_tree))
+	if (brt_vdev_numnodes(brtvd) == 0)
 		return;
 
 	if (!brtvd->bv_initiated) {
@@ -1301,11 +1384,13 @@ brt_pending_apply_vdev(spa_t *spa, brt_vdev_t *brtvd, uint64_t txg)
 	 * separate loop, since entcount modifications would cause false
 	 * positives for brt_vdev_lookup() on following iterations.
 	 */
-	for (bre = avl_first(&brtvd->bv_tree); bre;
-	    bre = AVL_NEXT(&brtvd->bv_tree, bre)) {
-		brt_vdev_addref(spa, brtvd, bre,
-		    bp_get_dsize(spa, &bre->bre_bp), bre->bre_pcount);
-		bre->bre_count += bre->bre_pcount;
+	for (int s = 0; s < BRT_SHARDS; s++) {
+		avl_tree_t *tree = &brtvd->bv_shard[s].bs_tree;
+		for (bre = avl_first(tree); bre; bre = AVL_NEXT(tree, bre)) {
+			brt_vdev_addref(spa, brtvd, bre,
+			    bp_get_dsize(spa, &bre->bre_bp), bre->bre_pcount);
+			bre->bre_count += bre->bre_pcount;
+		}
 	}
 }
 
@@ -1355,21 +1440,25 @@ brt_sync_table(spa_t *spa, dmu_tx_t *tx)
 
 		if (!brtvd->bv_meta_dirty) {
 			ASSERT(!brtvd->bv_entcount_dirty);
-			ASSERT0(avl_numnodes(&brtvd->bv_tree));
+			ASSERT0(brt_vdev_numnodes(brtvd));
 			brt_rlock(spa);
 			continue;
 		}
 
 		ASSERT(!brtvd->bv_entcount_dirty ||
-		    avl_numnodes(&brtvd->bv_tree) != 0);
+		    brt_vdev_numnodes(brtvd) != 0);
 
 		if (brtvd->bv_mos_brtvdev == 0)
 			brt_vdev_create(spa, brtvd, tx);
 
-		void *c = NULL;
-		while ((bre = avl_destroy_nodes(&brtvd->bv_tree, &c)) != NULL) {
-			brt_sync_entry(brtvd->bv_mos_entries_dnode, bre, tx);
-			kmem_cache_free(brt_entry_cache, bre);
+		for (int s = 0; s < BRT_SHARDS; s++) {
+			avl_tree_t *tree = &brtvd->bv_shard[s].bs_tree;
+			void *c = NULL;
+			while ((bre = avl_destroy_nodes(tree, &c)) != NULL) {
+				brt_sync_entry(brtvd->bv_mos_entries_dnode,
+				    bre, tx);
+				kmem_cache_free(brt_entry_cache, bre);
+			}
 		}
 
 #ifdef ZFS_DEBUG
@@ -1943,6 +1943,36 @@ zfs_btree_clear(zfs_btree_t *tree)
 	tree->bt_bulk = NULL;
 }
 
+/*
+ * Trees which have seen many random insertions and removals can have most
+ * of their nodes only half full.  Rebuild such a tree by moving its
+ * elements in order in to a new tree, where bulk insertion leaves the leaves
+ * about 3/4 full.  The old nodes are freed as their elements are moved, so
+ * compacting does not double the memory used by the tree.
+ */
+boolean_t
+zfs_btree_compact(zfs_btree_t *tree, uint_t pct)
+{
+	zfs_btree_index_t *cookie = NULL;
+	zfs_btree_t new_tree;
+	void *elem;
+
+	if (tree->bt_height < 1 || tree->bt_num_elems * 100 >=
+	    tree->bt_num_nodes * tree->bt_leaf_cap * pct)
+		return (B_FALSE);
+
+	zfs_btree_create_custom(&new_tree, tree->bt_compar,
+	    tree->bt_find_in_buf, tree->bt_elem_size, tree->bt_leaf_size);
+	while ((elem = zfs_btree_destroy_nodes(tree, &cookie)) != NULL)
+		zfs_btree_add(&new_tree, elem);
+	zfs_btree_destroy(tree);
+
+	*tree = new_tree;
+	zfs_btree_verify(tree);
+
+	return (B_TRUE);
+}
+
 void
 zfs_btree_destroy(zfs_btree_t *tree)
 {
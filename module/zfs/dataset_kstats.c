@@ -30,6 +30,16 @@
 #include <sys/dsl_dataset.h>
 #include <sys/spa.h>
 
+/*
+ * Keep latency and size histograms for each dataset mounted, or zvol
+ * created, while this is set.
+ */
+static int zfs_dataset_histograms = 0;
+
+static const char *dataset_histogram_op_names[DATASET_OP_COUNT] = {
+	"read", "write", "sync"
+};
+
 static dataset_kstat_values_t empty_dataset_kstats = {
 	{ "dataset_name",	KSTAT_DATA_STRING },
 	{ "writes",	KSTAT_DATA_UINT64 },
@@ -87,9 +97,74 @@ dataset_kstats_update(kstat_t *ksp, int rw)
 
 	zil_kstat_values_update(&dkv->dkv_zil_stats, &dk->dk_zil_sums);
 
+	dataset_histograms_t *dh = dk->dk_histograms;
+	if (dh != NULL) {
+		kstat_named_t *kn = (kstat_named_t *)(dkv + 1);
+
+		for (int op = 0; op < DATASET_OP_COUNT; op++) {
+			for (int b = 0; b < DATASET_LAT_BUCKETS; b++)
+				(kn++)->value.ui64 =
+				    wmsum_value(&dh->dh_lat[op][b]);
+		}
+		for (int op = 0; op < DATASET_SIZE_OPS; op++) {
+			for (int b = 0; b < DATASET_SIZE_BUCKETS; b++)
+				(kn++)->value.ui64 =
+				    wmsum_value(&dh->dh_size[op][b]);
+		}
+	}
+
 	return (0);
 }
 
+/*
+ * Name each histogram bucket after its exclusive upper bound, e.g.
+ * read_lat_2048 counts reads that took from 1024 to 2047 nanoseconds.
+ */
+static void
+dataset_histograms_init(dataset_kstats_t *dk, kstat_named_t *kn)
+{
+	dataset_histograms_t *dh = kmem_zalloc(sizeof (*dh), KM_SLEEP);
+	char name[KSTAT_STRLEN];
+
+	for (int op = 0; op < DATASET_OP_COUNT; op++) {
+		for (int b = 0; b < DATASET_LAT_BUCKETS; b++) {
+			wmsum_init(&dh->dh_lat[op][b], 0);
+			(void) snprintf(name, sizeof (name), "%s_lat_%llu",
+			    dataset_histogram_op_names[op],
+			    1ULL << (DATASET_LAT_MIN_SHIFT + b));
+			kstat_named_init(kn++, name, KSTAT_DATA_UINT64);
+		}
+	}
+	for (int op = 0; op < DATASET_SIZE_OPS; op++) {
+		for (int b = 0; b < DATASET_SIZE_BUCKETS; b++) {
+			wmsum_init(&dh->dh_size[op][b], 0);
+			(void) snprintf(name, sizeof (name), "%s_size_%llu",
+			    dataset_histogram_op_names[op],
+			    1ULL << (DATASET_SIZE_MIN_SHIFT + b));
+			kstat_named_init(kn++, name, KSTAT_DATA_UINT64);
+		}
+	}
+
+	dk->dk_histograms = dh;
+}
+
+static void
+dataset_histograms_fini(dataset_kstats_t *dk)
+{
+	dataset_histograms_t *dh = dk->dk_histograms;
+
+	for (int op = 0; op < DATASET_OP_COUNT; op++) {
+		for (int b = 0; b < DATASET_LAT_BUCKETS; b++)
+			wmsum_fini(&dh->dh_lat[op][b]);
+	}
+	for (int op = 0; op < DATASET_SIZE_OPS; op++) {
+		for (int b = 0; b < DATASET_SIZE_BUCKETS; b++)
+			wmsum_fini(&dh->dh_size[op][b]);
+	}
+	kmem_free(dh, sizeof (*dh));
+	dk->dk_histograms = NULL;
+}
+
 int
 dataset_kstats_create(dataset_kstats_t *dk, objset_t *objset)
 {
@@ -144,17 +219,23 @@ dataset_kstats_create(dataset_kstats_t *dk, objset_t *objset)
 		return (SET_ERROR(ENAMETOOLONG));
 	}
 
+	boolean_t histograms = (zfs_dataset_histograms != 0);
+	size_t ndata = sizeof (empty_dataset_kstats) / sizeof (kstat_named_t);
+	if (histograms)
+		ndata += DATASET_HISTO_NDATA;
+
 	kstat_t *kstat = kstat_create(kstat_module_name, 0, kstat_name,
-	    "dataset", KSTAT_TYPE_NAMED,
-	    sizeof (empty_dataset_kstats) / sizeof (kstat_named_t),
-	    KSTAT_FLAG_VIRTUAL);
+	    "dataset", KSTAT_TYPE_NAMED, ndata, KSTAT_FLAG_VIRTUAL);
 	if (kstat == NULL)
 		return (SET_ERROR(ENOMEM));
 
 	dataset_kstat_values_t *dk_kstats =
-	    kmem_alloc(sizeof (empty_dataset_kstats), KM_SLEEP);
+	    kmem_alloc(ndata * sizeof (kstat_named_t), KM_SLEEP);
 	memcpy(dk_kstats, &empty_dataset_kstats,
 	    sizeof (empty_dataset_kstats));
+	zil_kstat_values_init(&dk_kstats->dkv_zil_stats);
+	if (histograms)
+		dataset_histograms_init(dk, (kstat_named_t *)(dk_kstats + 1));
 
 	char *ds_name = kmem_zalloc(ZFS_MAX_DATASET_NAME_LEN, KM_SLEEP);
 	dsl_dataset_name(objset->os_dsl_dataset, ds_name);
@@ -187,11 +268,14 @@ dataset_kstats_destroy(dataset_kstats_t *dk)
 		return;
 
 	dataset_kstat_values_t *dkv = dk->dk_kstats->ks_data;
+	size_t ndata = dk->dk_kstats->ks_ndata;
 	kstat_delete(dk->dk_kstats);
 	dk->dk_kstats = NULL;
 	kmem_free(KSTAT_NAMED_STR_PTR(&dkv->dkv_ds_name),
 	    KSTAT_NAMED_STR_BUFLEN(&dkv->dkv_ds_name));
-	kmem_free(dkv, sizeof (empty_dataset_kstats));
+	kmem_free(dkv, ndata * sizeof (kstat_named_t));
+	if (dk->dk_histograms != NULL)
+		dataset_histograms_fini(dk);
 
 	wmsum_fini(&dk->dk_sums.dss_writes);
 	wmsum_fini(&dk->dk_sums.dss_nwritten);
@@ -258,3 +342,41 @@ dataset_kstats_update_nunlinked_kstat(dataset_kstats_t *dk, int64_t delta)
 
 	wmsum_add(&dk->dk_sums.dss_nunlinked, delta);
 }
+
+/*
+ * Returns the time to pass to dataset_kstats_update_histograms() once the
+ * operation is done, or zero when the dataset keeps no histograms.
+ */
+hrtime_t
+dataset_kstats_start(dataset_kstats_t *dk)
+{
+	return (dk->dk_histograms != NULL ? gethrtime() : 0);
+}
+
+static inline uint_t
+dataset_histogram_bucket(uint64_t v, uint_t min_shift, uint_t buckets)
+{
+	uint_t b = MAX(highbit64(v), min_shift) - min_shift;
+	return (MIN(b, buckets - 1));
+}
+
+void
+dataset_kstats_update_histograms(dataset_kstats_t *dk,
+    dataset_kstats_op_t op, int64_t bytes, hrtime_t start)
+{
+	dataset_histograms_t *dh = dk->dk_histograms;
+
+	if (start == 0 || dh == NULL)
+		return;
+
+	wmsum_add(&dh->dh_lat[op][dataset_histogram_bucket(
+	    gethrtime() - start, DATASET_LAT_MIN_SHIFT,
+	    DATASET_LAT_BUCKETS)], 1);
+	if (op < DATASET_SIZE_OPS) {
+		wmsum_add(&dh->dh_size[op][dataset_histogram_bucket(bytes,
+		    DATASET_SIZE_MIN_SHIFT, DATASET_SIZE_BUCKETS)], 1);
+	}
+}
+
+ZFS_MODULE_PARAM(zfs, zfs_, dataset_histograms, INT, ZMOD_RW,
+	"Keep per-dataset latency and size histograms");
@@ -238,6 +238,22 @@ static uint_t dbuf_metadata_cache_shift = 6;
 /* Set the dbuf hash mutex count as log2 shift (dynamic by default) */
 static uint_t dbuf_mutex_cache_shift = 0;
 
+/*
+ * The hash table is doubled in size when the average chain length exceeds
+ * this value.  Zero disables online resizing.
+ */
+static uint_t dbuf_hash_table_max_load = 4;
+
+/*
+ * Percentage of the dbuf cache target that each objset may keep cached
+ * before the eviction thread will pick its dbufs over those of other
+ * objsets.  Zero disables the reservation.
+ */
+static uint_t dbuf_cache_objset_reserve_pct = 0;
+
+/* Number of reserved dbufs the eviction thread skips before giving up */
+#define	DBUF_EVICT_RESERVE_SKIP	32
+
 static unsigned long dbuf_cache_target_bytes(void);
 static unsigned long dbuf_metadata_cache_target_bytes(void);
 
@@ -349,25 +365,67 @@ dbuf_find(objset_t *os, uint64_t obj, uint8_t level, uint64_t blkid,
 	dmu_buf_impl_t *db;
 
 	hv = dbuf_hash(os, obj, level, blkid);
-	idx = hv & h->hash_table_mask;
 
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
+	mutex_enter(DBUF_HASH_MUTEX(h, hv));
+	idx = hv & h->hash_table_mask;
 	for (db = h->hash_table[idx]; db != NULL; db = db->db_hash_next) {
 		if (DBUF_EQUAL(db, os, obj, level, blkid)) {
 			mutex_enter(&db->db_mtx);
 			if (db->db_state != DB_EVICTING) {
-				mutex_exit(DBUF_HASH_MUTEX(h, idx));
+				mutex_exit(DBUF_HASH_MUTEX(h, hv));
 				return (db);
 			}
 			mutex_exit(&db->db_mtx);
 		}
 	}
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
+	mutex_exit(DBUF_HASH_MUTEX(h, hv));
 	if (hash_out != NULL)
 		*hash_out = hv;
 	return (NULL);
 }
 
+/*
+ * Call func for every DB_CACHED dbuf in the hash table that belongs to spa.
+ * The callback runs with the hash chain mutex and db_mtx held, so it must
+ * not block or allocate memory; a non-zero return value ends the walk.
+ * Returns the number of dbufs visited.
+ */
+uint64_t
+dbuf_walk_cached(spa_t *spa, dbuf_walk_fn func, void *arg)
+{
+	dbuf_hash_table_t *h = &dbuf_hash_table;
+	uint64_t visited = 0;
+
+	rw_enter(&h->hash_resize_lock, RW_READER);
+	for (uint64_t idx = 0; idx <= h->hash_table_mask; idx++) {
+		int stop = 0;
+
+		/* Most chains are empty; skip them without the mutex. */
+		if (h->hash_table[idx] == NULL)
+			continue;
+
+		mutex_enter(DBUF_HASH_MUTEX(h, idx));
+		for (dmu_buf_impl_t *db = h->hash_table[idx]; db != NULL;
+		    db = db->db_hash_next) {
+			if (db->db_objset->os_spa != spa)
+				continue;
+			mutex_enter(&db->db_mtx);
+			if (db->db_state == DB_CACHED) {
+				visited++;
+				stop = func(db, arg);
+			}
+			mutex_exit(&db->db_mtx);
+			if (stop != 0)
+				break;
+		}
+		mutex_exit(DBUF_HASH_MUTEX(h, idx));
+		if (stop != 0)
+			break;
+	}
+	rw_exit(&h->hash_resize_lock);
+	return (visited);
+}
+
 static dmu_buf_impl_t *
 dbuf_find_bonus(objset_t *os, uint64_t object)
 {
@@ -405,15 +463,15 @@ dbuf_hash_insert(dmu_buf_impl_t *db)
 
 	blkid = db->db_blkid;
 	ASSERT3U(dbuf_hash(os, obj, level, blkid), ==, db->db_hash);
-	idx = db->db_hash & h->hash_table_mask;
 
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
+	mutex_enter(DBUF_HASH_MUTEX(h, db->db_hash));
+	idx = db->db_hash & h->hash_table_mask;
 	for (dbf = h->hash_table[idx], i = 0; dbf != NULL;
 	    dbf = dbf->db_hash_next, i++) {
 		if (DBUF_EQUAL(dbf, os, obj, level, blkid)) {
 			mutex_enter(&dbf->db_mtx);
 			if (dbf->db_state != DB_EVICTING) {
-				mutex_exit(DBUF_HASH_MUTEX(h, idx));
+				mutex_exit(DBUF_HASH_MUTEX(h, db->db_hash));
 				return (dbf);
 			}
 			mutex_exit(&dbf->db_mtx);
@@ -431,7 +489,7 @@ dbuf_hash_insert(dmu_buf_impl_t *db)
 	mutex_enter(&db->db_mtx);
 	db->db_hash_next = h->hash_table[idx];
 	h->hash_table[idx] = db;
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
+	mutex_exit(DBUF_HASH_MUTEX(h, db->db_hash));
 	DBUF_STAT_BUMP(hash_elements);
 
 	return (NULL);
@@ -483,7 +541,6 @@ dbuf_hash_remove(dmu_buf_impl_t *db)
 
 	ASSERT3U(dbuf_hash(db->db_objset, db->db.db_object, db->db_level,
 	    db->db_blkid), ==, db->db_hash);
-	idx = db->db_hash & h->hash_table_mask;
 
 	/*
 	 * We mustn't hold db_mtx to maintain lock ordering:
@@ -493,7 +550,8 @@ dbuf_hash_remove(dmu_buf_impl_t *db)
 	ASSERT(db->db_state == DB_EVICTING);
 	ASSERT(!MUTEX_HELD(&db->db_mtx));
 
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
+	mutex_enter(DBUF_HASH_MUTEX(h, db->db_hash));
+	idx = db->db_hash & h->hash_table_mask;
 	dbp = &h->hash_table[idx];
 	while ((dbf = *dbp) != db) {
 		dbp = &dbf->db_hash_next;
@@ -504,10 +562,86 @@ dbuf_hash_remove(dmu_buf_impl_t *db)
 	if (h->hash_table[idx] &&
 	    h->hash_table[idx]->db_hash_next == NULL)
 		DBUF_STAT_BUMPDOWN(hash_chains);
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
+	mutex_exit(DBUF_HASH_MUTEX(h, db->db_hash));
 	DBUF_STAT_BUMPDOWN(hash_elements);
 }
 
+/*
+ * Grow the hash table once the average chain length exceeds
+ * dbuf_hash_table_max_load.  Lookups pick their mutex from the hash value
+ * rather than the bucket index, and the table always has at least as many
+ * buckets as there are mutexes, so holding every mutex is enough to keep
+ * all lookups out while the chains are rehashed into the new table.
+ * Only the dbuf eviction thread calls this, so the current size can be
+ * read without locks.
+ */
+static void
+dbuf_hash_table_grow(void)
+{
+	dbuf_hash_table_t *h = &dbuf_hash_table;
+	dmu_buf_impl_t **otable, **ntable;
+	uint64_t elements, hsize, nsize, nmask;
+	int64_t chains = 0;
+
+	if (dbuf_hash_table_max_load == 0)
+		return;
+
+	hsize = h->hash_table_mask + 1;
+	elements = wmsum_value(&dbuf_sums.hash_elements);
+	if (elements <= hsize * dbuf_hash_table_max_load)
+		return;
+
+	/*
+	 * Size the new table for half of the maximum load so that we do not
+	 * resize again right away, but never let it use more than 1/64th of
+	 * physical memory.
+	 */
+	nsize = hsize << 1;
+	while (nsize * dbuf_hash_table_max_load < elements * 2)
+		nsize <<= 1;
+	while (nsize > hsize && nsize * sizeof (void *) > arc_all_memory() / 64)
+		nsize >>= 1;
+	if (nsize == hsize)
+		return;
+
+	ntable = vmem_zalloc(nsize * sizeof (void *), KM_NOSLEEP);
+	if (ntable == NULL)
+		return;
+	nmask = nsize - 1;
+
+	rw_enter(&h->hash_resize_lock, RW_WRITER);
+	for (uint64_t i = 0; i <= h->hash_mutex_mask; i++)
+		mutex_enter(&h->hash_mutexes[i]);
+
+	otable = h->hash_table;
+	for (uint64_t idx = 0; idx < hsize; idx++) {
+		dmu_buf_impl_t *db, *next;
+
+		if (otable[idx] != NULL && otable[idx]->db_hash_next != NULL)
+			chains--;
+
+		for (db = otable[idx]; db != NULL; db = next) {
+			uint64_t nidx = db->db_hash & nmask;
+
+			next = db->db_hash_next;
+			if (ntable[nidx] != NULL &&
+			    ntable[nidx]->db_hash_next == NULL)
+				chains++;
+			db->db_hash_next = ntable[nidx];
+			ntable[nidx] = db;
+		}
+	}
+	h->hash_table = ntable;
+	h->hash_table_mask = nmask;
+
+	for (uint64_t i = 0; i <= h->hash_mutex_mask; i++)
+		mutex_exit(&h->hash_mutexes[i]);
+	rw_exit(&h->hash_resize_lock);
+
+	wmsum_add(&dbuf_sums.hash_chains, chains);
+	vmem_free(otable, hsize * sizeof (void *));
+}
+
 typedef enum {
 	DBVU_EVICTING,
 	DBVU_NOT_EVICTING
@@ -780,9 +914,33 @@ dbuf_evict_one(void)
 
 	ASSERT(!MUTEX_HELD(&dbuf_evict_lock));
 
-	dmu_buf_impl_t *db = multilist_sublist_tail(mls);
-	while (db != NULL && mutex_tryenter(&db->db_mtx) == 0) {
-		db = multilist_sublist_prev(mls, db);
+	/*
+	 * Prefer dbufs of objsets that hold more than their reservation, so
+	 * that one objset streaming through the cache does not push out
+	 * everybody else.  If nothing in this sublist qualifies within
+	 * DBUF_EVICT_RESERVE_SKIP entries, evict as if there were no
+	 * reservations.
+	 */
+	uint64_t reserve = dbuf_cache_target_bytes() / 100 *
+	    dbuf_cache_objset_reserve_pct;
+	dmu_buf_impl_t *db;
+	for (;;) {
+		int skipped = 0;
+
+		db = multilist_sublist_tail(mls);
+		while (db != NULL) {
+			if (reserve != 0 && skipped < DBUF_EVICT_RESERVE_SKIP &&
+			    db->db_objset->os_dbuf_cache_size[DB_DBUF_CACHE] <=
+			    reserve) {
+				skipped++;
+			} else if (mutex_tryenter(&db->db_mtx)) {
+				break;
+			}
+			db = multilist_sublist_prev(mls, db);
+		}
+		if (db != NULL || skipped == 0)
+			break;
+		reserve = 0;
 	}
 
 	DTRACE_PROBE2(dbuf__evict__one, dmu_buf_impl_t *, db,
@@ -797,6 +955,8 @@ dbuf_evict_one(void)
 		    &dbuf_caches[DB_DBUF_CACHE].size, size, db);
 		(void) zfs_refcount_remove_many(
 		    &dbuf_caches[DB_DBUF_CACHE].size, usize, db->db_user);
+		atomic_sub_64(&db->db_objset->os_dbuf_cache_size[DB_DBUF_CACHE],
+		    size);
 		DBUF_STAT_BUMPDOWN(cache_levels[db->db_level]);
 		DBUF_STAT_BUMPDOWN(cache_count);
 		DBUF_STAT_DECR(cache_levels_bytes[db->db_level], size + usize);
@@ -831,6 +991,10 @@ dbuf_evict_thread(void *unused)
 			(void) cv_timedwait_idle_hires(&dbuf_evict_cv,
 			    &dbuf_evict_lock, SEC2NSEC(1), MSEC2NSEC(1), 0);
 			CALLB_CPR_SAFE_END(&cpr, &dbuf_evict_lock);
+
+			mutex_exit(&dbuf_evict_lock);
+			dbuf_hash_table_grow();
+			mutex_enter(&dbuf_evict_lock);
 		}
 		mutex_exit(&dbuf_evict_lock);
 
@@ -968,6 +1132,13 @@ dbuf_init(void)
 	else
 		hmsize = 1ULL << MIN(dbuf_mutex_cache_shift, 24);
 
+	/*
+	 * A bucket must never be covered by more than one mutex, or lookups
+	 * that choose their mutex by hash value would not exclude each
+	 * other.  See dbuf_hash_table_grow().
+	 */
+	hmsize = MIN(hmsize, hsize);
+
 	h->hash_mutexes = NULL;
 	while (h->hash_mutexes == NULL) {
 		h->hash_mutex_mask = hmsize - 1;
@@ -977,6 +1148,7 @@ dbuf_init(void)
 		if (h->hash_mutexes == NULL)
 			hmsize >>= 1;
 	}
+	rw_init(&h->hash_resize_lock, NULL, RW_DEFAULT, NULL);
 
 	dbuf_kmem_cache = kmem_cache_create("dmu_buf_impl_t",
 	    sizeof (dmu_buf_impl_t),
@@ -1051,13 +1223,6 @@ dbuf_fini(void)
 
 	dbuf_stats_destroy();
 
-	for (int i = 0; i < (h->hash_mutex_mask + 1); i++)
-		mutex_destroy(&h->hash_mutexes[i]);
-
-	vmem_free(h->hash_table, (h->hash_table_mask + 1) * sizeof (void *));
-	vmem_free(h->hash_mutexes, (h->hash_mutex_mask + 1) *
-	    sizeof (kmutex_t));
-
 	kmem_cache_destroy(dbuf_kmem_cache);
 	kmem_cache_destroy(dbuf_dirty_kmem_cache);
 	taskq_destroy(dbu_evict_taskq);
@@ -1073,6 +1238,15 @@ dbuf_fini(void)
 	mutex_destroy(&dbuf_evict_lock);
 	cv_destroy(&dbuf_evict_cv);
 
+	/* The eviction thread may resize the hash table, so free it last */
+	for (int i = 0; i < (h->hash_mutex_mask + 1); i++)
+		mutex_destroy(&h->hash_mutexes[i]);
+	rw_destroy(&h->hash_resize_lock);
+
+	vmem_free(h->hash_table, (h->hash_table_mask + 1) * sizeof (void *));
+	vmem_free(h->hash_mutexes, (h->hash_mutex_mask + 1) *
+	    sizeof (kmutex_t));
+
 	for (dbuf_cached_state_t dcs = 0; dcs < DB_CACHE_MAX; dcs++) {
 		zfs_refcount_destroy(&dbuf_caches[dcs].size);
 		multilist_destroy(&dbuf_caches[dcs].cache);
@@ -1635,6 +1809,8 @@ dbuf_read_impl(dmu_buf_impl_t *db, dnode_t *dn, zio_t *zio, dmu_flags_t flags,
 		aflags |= ARC_FLAG_UNCACHED;
 	else if (dbuf_is_l2cacheable(db, bp))
 		aflags |= ARC_FLAG_L2CACHE;
+	if (db->db_objset->os_arc_priority == ZFS_ARC_PRIORITY_LOW)
+		aflags |= ARC_FLAG_LOW_PRIORITY;
 
 	dbuf_add_ref(db, NULL);
 
@@ -1876,10 +2052,13 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *pio, dmu_flags_t flags)
 	}
 
 done:
-	if (miss)
+	if (miss) {
 		DBUF_STAT_BUMP(hash_misses);
-	else
+		wmsum_add(&db->db_objset->os_dbuf_misses, 1);
+	} else {
 		DBUF_STAT_BUMP(hash_hits);
+		wmsum_add(&db->db_objset->os_dbuf_hits, 1);
+	}
 	if (pio && err != 0) {
 		zio_t *zio = zio_null(pio, pio->io_spa, NULL, NULL, NULL,
 		    ZIO_FLAG_CANFAIL);
@@ -1951,6 +2130,7 @@ dbuf_unoverride(dbuf_dirty_record_t *dr)
 	dr->dt.dl.dr_brtwrite = B_FALSE;
 	dr->dt.dl.dr_diowrite = B_FALSE;
 	dr->dt.dl.dr_has_raw_params = B_FALSE;
+	dr->dt.dl.dr_early_write = B_FALSE;
 
 	/*
 	 * In the event that Direct I/O was used, we do not
@@ -2245,6 +2425,7 @@ dbuf_dirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 	ASSERT(tx->tx_txg != 0);
 	ASSERT(!zfs_refcount_is_zero(&db->db_holds));
 	DMU_TX_DIRTY_BUF(tx, db);
+	DTRACE_PROBE2(dbuf__dirty, dmu_buf_impl_t *, db, dmu_tx_t *, tx);
 
 	DB_DNODE_ENTER(db);
 	dn = DB_DNODE(db);
@@ -2708,6 +2889,26 @@ dmu_buf_will_dirty(dmu_buf_t *db_fake, dmu_tx_t *tx)
 	dmu_buf_will_dirty_flags(db_fake, tx, DMU_READ_NO_PREFETCH);
 }
 
+/*
+ * Set the allocation class hint (ZIO_CLASS_HINT_*) used when the dirty
+ * record of this level 0 dbuf for the given transaction is written out.
+ * The dbuf must already be dirty in this transaction.
+ */
+void
+dmu_buf_set_class_hint(dmu_buf_t *db_fake, dmu_tx_t *tx, uint8_t hint)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
+
+	ASSERT0(db->db_level);
+	ASSERT3U(db->db_blkid, !=, DMU_BONUS_BLKID);
+
+	mutex_enter(&db->db_mtx);
+	dbuf_dirty_record_t *dr = dbuf_find_dirty_eq(db, tx->tx_txg);
+	ASSERT3P(dr, !=, NULL);
+	dr->dt.dl.dr_class_hint = hint;
+	mutex_exit(&db->db_mtx);
+}
+
 boolean_t
 dmu_buf_is_dirty(dmu_buf_t *db_fake, dmu_tx_t *tx)
 {
@@ -2795,6 +2996,7 @@ dmu_buf_untransform_direct(dmu_buf_impl_t *db, spa_t *spa)
 	}
 	DB_DNODE_EXIT(db);
 	DBUF_STAT_BUMP(hash_hits);
+	wmsum_add(&db->db_objset->os_dbuf_hits, 1);
 
 	return (err);
 }
@@ -3219,6 +3421,8 @@ dbuf_destroy(dmu_buf_impl_t *db)
 		(void) zfs_refcount_remove_many(
 		    &dbuf_caches[db->db_caching_status].size,
 		    db->db.db_size, db);
+		atomic_sub_64(&db->db_objset->os_dbuf_cache_size[
+		    db->db_caching_status], db->db.db_size);
 
 		if (db->db_caching_status == DB_DBUF_METADATA_CACHE) {
 			DBUF_STAT_BUMPDOWN(metadata_cache_count);
@@ -3803,6 +4007,8 @@ dbuf_prefetch_impl(dnode_t *dn, int64_t level, uint64_t blkid,
 		dpa->dpa_aflags |= ARC_FLAG_UNCACHED;
 	else if (dnode_level_is_l2cacheable(&bp, dn, level))
 		dpa->dpa_aflags |= ARC_FLAG_L2CACHE;
+	if (dn->dn_objset->os_arc_priority == ZFS_ARC_PRIORITY_LOW)
+		dpa->dpa_aflags |= ARC_FLAG_LOW_PRIORITY;
 
 	/*
 	 * If we have the indirect just above us, no need to do the asynchronous
@@ -3891,6 +4097,68 @@ dbuf_hold_copy(dnode_t *dn, dmu_buf_impl_t *db)
 	dbuf_set_data(db, db_data);
 }
 
+/*
+ * Add a hold on a dbuf returned by dbuf_find() or dbuf_create(), taking it
+ * off the dbuf cache if it was there.  Called and returns with db_mtx held.
+ */
+static void
+dbuf_hold_found(dnode_t *dn, dmu_buf_impl_t *db, const void *tag)
+{
+	ASSERT(MUTEX_HELD(&db->db_mtx));
+
+	if (db->db_buf != NULL) {
+		arc_buf_access(db->db_buf);
+		ASSERT3P(db->db.db_data, ==, db->db_buf->b_data);
+	}
+
+	ASSERT(db->db_buf == NULL || arc_referenced(db->db_buf));
+
+	/*
+	 * If this buffer is currently syncing out, and we are
+	 * still referencing it from db_data, we need to make a copy
+	 * of it in case we decide we want to dirty it again in this txg.
+	 */
+	if (db->db_level == 0 && db->db_blkid != DMU_BONUS_BLKID &&
+	    dn->dn_object != DMU_META_DNODE_OBJECT &&
+	    db->db_state == DB_CACHED && db->db_data_pending) {
+		dbuf_dirty_record_t *dr = db->db_data_pending;
+		if (dr->dt.dl.dr_data == db->db_buf) {
+			ASSERT3P(db->db_buf, !=, NULL);
+			dbuf_hold_copy(dn, db);
+		}
+	}
+
+	if (multilist_link_active(&db->db_cache_link)) {
+		ASSERT(zfs_refcount_is_zero(&db->db_holds));
+		ASSERT(db->db_caching_status == DB_DBUF_CACHE ||
+		    db->db_caching_status == DB_DBUF_METADATA_CACHE);
+
+		multilist_remove(&dbuf_caches[db->db_caching_status].cache, db);
+
+		uint64_t size = db->db.db_size;
+		uint64_t usize = dmu_buf_user_size(&db->db);
+		(void) zfs_refcount_remove_many(
+		    &dbuf_caches[db->db_caching_status].size, size, db);
+		(void) zfs_refcount_remove_many(
+		    &dbuf_caches[db->db_caching_status].size, usize,
+		    db->db_user);
+		atomic_sub_64(&db->db_objset->os_dbuf_cache_size[
+		    db->db_caching_status], size);
+
+		if (db->db_caching_status == DB_DBUF_METADATA_CACHE) {
+			DBUF_STAT_BUMPDOWN(metadata_cache_count);
+		} else {
+			DBUF_STAT_BUMPDOWN(cache_levels[db->db_level]);
+			DBUF_STAT_BUMPDOWN(cache_count);
+			DBUF_STAT_DECR(cache_levels_bytes[db->db_level],
+			    size + usize);
+		}
+		db->db_caching_status = DB_NO_CACHE;
+	}
+	(void) zfs_refcount_add(&db->db_holds, tag);
+	DBUF_VERIFY(db);
+}
+
 /*
  * Returns with db_holds incremented, and db_mtx not held.
  * Note: dn_struct_rwlock must be held.
@@ -3947,56 +4215,7 @@ dbuf_hold_impl(dnode_t *dn, uint8_t level, uint64_t blkid,
 		return (SET_ERROR(ENOENT));
 	}
 
-	if (db->db_buf != NULL) {
-		arc_buf_access(db->db_buf);
-		ASSERT(MUTEX_HELD(&db->db_mtx));
-		ASSERT3P(db->db.db_data, ==, db->db_buf->b_data);
-	}
-
-	ASSERT(db->db_buf == NULL || arc_referenced(db->db_buf));
-
-	/*
-	 * If this buffer is currently syncing out, and we are
-	 * still referencing it from db_data, we need to make a copy
-	 * of it in case we decide we want to dirty it again in this txg.
-	 */
-	if (db->db_level == 0 && db->db_blkid != DMU_BONUS_BLKID &&
-	    dn->dn_object != DMU_META_DNODE_OBJECT &&
-	    db->db_state == DB_CACHED && db->db_data_pending) {
-		dbuf_dirty_record_t *dr = db->db_data_pending;
-		if (dr->dt.dl.dr_data == db->db_buf) {
-			ASSERT3P(db->db_buf, !=, NULL);
-			dbuf_hold_copy(dn, db);
-		}
-	}
-
-	if (multilist_link_active(&db->db_cache_link)) {
-		ASSERT(zfs_refcount_is_zero(&db->db_holds));
-		ASSERT(db->db_caching_status == DB_DBUF_CACHE ||
-		    db->db_caching_status == DB_DBUF_METADATA_CACHE);
-
-		multilist_remove(&dbuf_caches[db->db_caching_status].cache, db);
-
-		uint64_t size = db->db.db_size;
-		uint64_t usize = dmu_buf_user_size(&db->db);
-		(void) zfs_refcount_remove_many(
-		    &dbuf_caches[db->db_caching_status].size, size, db);
-		(void) zfs_refcount_remove_many(
-		    &dbuf_caches[db->db_caching_status].size, usize,
-		    db->db_user);
-
-		if (db->db_caching_status == DB_DBUF_METADATA_CACHE) {
-			DBUF_STAT_BUMPDOWN(metadata_cache_count);
-		} else {
-			DBUF_STAT_BUMPDOWN(cache_levels[db->db_level]);
-			DBUF_STAT_BUMPDOWN(cache_count);
-			DBUF_STAT_DECR(cache_levels_bytes[db->db_level],
-			    size + usize);
-		}
-		db->db_caching_status = DB_NO_CACHE;
-	}
-	(void) zfs_refcount_add(&db->db_holds, tag);
-	DBUF_VERIFY(db);
+	dbuf_hold_found(dn, db, tag);
 	mutex_exit(&db->db_mtx);
 
 	/* NOTE: we can't rele the parent until after we drop the db_mtx */
@@ -4006,11 +4225,95 @@ dbuf_hold_impl(dnode_t *dn, uint8_t level, uint64_t blkid,
 	ASSERT3P(DB_DNODE(db), ==, dn);
 	ASSERT3U(db->db_blkid, ==, blkid);
 	ASSERT3U(db->db_level, ==, level);
+	DTRACE_PROBE2(dbuf__hold, dmu_buf_impl_t *, db, const void *, tag);
 	*dbp = db;
 
 	return (0);
 }
 
+/*
+ * Hold nblks consecutive level-0 dbufs starting at blkid, as if by calling
+ * dbuf_hold() on each of them.  Children that are not cached share the
+ * parent that dbuf_findbp() resolved for the first of them, so a range
+ * under one indirect block only looks up and reads that parent once.
+ * On failure no holds are left behind.
+ * Note: dn_struct_rwlock must be held.
+ */
+int
+dbuf_hold_range(dnode_t *dn, uint64_t blkid, uint64_t nblks,
+    const void *tag, dmu_buf_impl_t **dbp)
+{
+	objset_t *os = dn->dn_objset;
+	dmu_buf_impl_t *parent = NULL;
+	boolean_t have_parent = B_FALSE;
+	int epbs = dn->dn_indblkshift - SPA_BLKPTRSHIFT;
+	uint64_t i;
+	int err = 0;
+
+	ASSERT(RW_LOCK_HELD(&dn->dn_struct_rwlock));
+	ASSERT(blkid != DMU_BONUS_BLKID && blkid != DMU_SPILL_BLKID);
+
+	for (i = 0; i < nblks; i++) {
+		uint64_t b = blkid + i;
+		dmu_buf_impl_t *db;
+		uint64_t hv;
+
+		/* Drop the parent once we step past its last child. */
+		if (have_parent && (b & ((1ULL << epbs) - 1)) == 0) {
+			if (parent != NULL)
+				dbuf_rele(parent, NULL);
+			parent = NULL;
+			have_parent = B_FALSE;
+		}
+
+		/* dbuf_find() returns with db_mtx held */
+		db = dbuf_find(os, dn->dn_object, 0, b, &hv);
+		if (db == NULL) {
+			blkptr_t *bp = NULL;
+
+			if (!have_parent) {
+				err = dbuf_findbp(dn, 0, b, FALSE, &parent,
+				    &bp);
+				if (err != 0 && err != ENOENT)
+					break;
+				/* ENOENT leaves no parent to share */
+				ASSERT(err == 0 || parent == NULL);
+				have_parent = (err == 0);
+				err = 0;
+			} else if (dn->dn_phys->dn_nlevels > 1) {
+				ASSERT3P(parent, !=, NULL);
+				ASSERT3U(parent->db_blkid, ==, b >> epbs);
+				rw_enter(&parent->db_rwlock, RW_READER);
+				bp = ((blkptr_t *)parent->db.db_data) +
+				    (b & ((1ULL << epbs) - 1));
+				rw_exit(&parent->db_rwlock);
+			} else if (b < dn->dn_phys->dn_nblkptr) {
+				bp = &dn->dn_phys->dn_blkptr[b];
+			}
+			/*
+			 * Past the dnode's last block pointer the block is a
+			 * hole with no parent, as in dbuf_findbp().
+			 */
+			db = dbuf_create(dn, 0, b, bp != NULL ? parent : NULL,
+			    bp, hv);
+		}
+
+		dbuf_hold_found(dn, db, tag);
+		mutex_exit(&db->db_mtx);
+		dbp[i] = db;
+	}
+
+	if (parent != NULL)
+		dbuf_rele(parent, NULL);
+
+	if (err != 0) {
+		while (i-- > 0)
+			dbuf_rele(dbp[i], tag);
+		return (err);
+	}
+	return (0);
+}
+
 dmu_buf_impl_t *
 dbuf_hold(dnode_t *dn, uint64_t blkid, const void *tag)
 {
@@ -4220,6 +4523,8 @@ dbuf_rele_and_unlock(dmu_buf_impl_t *db, const void *tag, boolean_t evicting)
 			    &dbuf_caches[dcs].size, db_size, db);
 			size = zfs_refcount_add_many(
 			    &dbuf_caches[dcs].size, dbu_size, db->db_user);
+			atomic_add_64(&db->db_objset->os_dbuf_cache_size[dcs],
+			    db_size);
 			uint8_t db_level = db->db_level;
 			mutex_exit(&db->db_mtx);
 
@@ -5342,6 +5647,8 @@ dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx)
 	wp_flag |= (data == NULL) ? WP_NOFILL : 0;
 
 	dmu_write_policy(os, dn, db->db_level, wp_flag, &zp);
+	if (db->db_level == 0)
+		zp.zp_class_hint = dr->dt.dl.dr_class_hint;
 
 	/*
 	 * We copy the blkptr now (rather than when we instantiate the dirty
@@ -5413,6 +5720,7 @@ EXPORT_SYMBOL(dbuf_release_bp);
 EXPORT_SYMBOL(dbuf_dirty);
 EXPORT_SYMBOL(dmu_buf_set_crypt_params);
 EXPORT_SYMBOL(dmu_buf_will_dirty);
+EXPORT_SYMBOL(dmu_buf_set_class_hint);
 EXPORT_SYMBOL(dmu_buf_is_dirty);
 EXPORT_SYMBOL(dmu_buf_will_clone_or_dio);
 EXPORT_SYMBOL(dmu_buf_will_not_fill);
@@ -5457,3 +5765,9 @@ ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, metadata_cache_shift, UINT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, mutex_cache_shift, UINT, ZMOD_RD,
 	"Set size of dbuf cache mutex array as log2 shift.");
+
+ZFS_MODULE_PARAM(zfs_dbuf_cache, dbuf_cache_, objset_reserve_pct, UINT,
+	ZMOD_RW, "Percentage of the dbuf cache reserved for each objset.");
+
+ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, hash_table_max_load, UINT, ZMOD_RW,
+	"Average dbuf hash chain length that triggers a table resize.");
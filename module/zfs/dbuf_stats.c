@@ -135,10 +135,16 @@ dbuf_stats_hash_table_data(char *buf, size_t size, void *data)
 	int length, error = 0;
 
 	ASSERT3S(dsh->idx, >=, 0);
-	ASSERT3S(dsh->idx, <=, h->hash_table_mask);
 	if (size)
 		buf[0] = 0;
 
+	/* The table may have been resized since dsh->idx was chosen. */
+	rw_enter(&h->hash_resize_lock, RW_READER);
+	if (dsh->idx > h->hash_table_mask) {
+		rw_exit(&h->hash_resize_lock);
+		return (0);
+	}
+
 	mutex_enter(DBUF_HASH_MUTEX(h, dsh->idx));
 	for (db = h->hash_table[dsh->idx]; db != NULL; db = db->db_hash_next) {
 		/*
@@ -161,6 +167,7 @@ dbuf_stats_hash_table_data(char *buf, size_t size, void *data)
 		mutex_exit(&db->db_mtx);
 	}
 	mutex_exit(DBUF_HASH_MUTEX(h, dsh->idx));
+	rw_exit(&h->hash_resize_lock);
 
 	return (error);
 }
@@ -216,6 +223,102 @@ dbuf_stats_hash_table_destroy(void)
 	mutex_destroy(&dsh->lock);
 }
 
+/*
+ * ==========================================================================
+ * Per-objset Dbuf Cache Statistics
+ * ==========================================================================
+ */
+typedef struct dbuf_objset_stats {
+	kstat_named_t dos_hits;
+	kstat_named_t dos_misses;
+	kstat_named_t dos_cache_size_bytes;
+	kstat_named_t dos_metadata_cache_size_bytes;
+} dbuf_objset_stats_t;
+
+static const dbuf_objset_stats_t dbuf_objset_stats_template = {
+	{ "hits",			KSTAT_DATA_UINT64 },
+	{ "misses",			KSTAT_DATA_UINT64 },
+	{ "cache_size_bytes",		KSTAT_DATA_UINT64 },
+	{ "metadata_cache_size_bytes",	KSTAT_DATA_UINT64 },
+};
+
+static int
+dbuf_stats_objset_update(kstat_t *ksp, int rw)
+{
+	objset_t *os = ksp->ks_private;
+	dbuf_objset_stats_t *dos = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	dos->dos_hits.value.ui64 = wmsum_value(&os->os_dbuf_hits);
+	dos->dos_misses.value.ui64 = wmsum_value(&os->os_dbuf_misses);
+	dos->dos_cache_size_bytes.value.ui64 =
+	    os->os_dbuf_cache_size[DB_DBUF_CACHE];
+	dos->dos_metadata_cache_size_bytes.value.ui64 =
+	    os->os_dbuf_cache_size[DB_DBUF_METADATA_CACHE];
+
+	return (0);
+}
+
+/*
+ * Set up the dbuf cache counters of a newly opened objset and publish them
+ * as zfs/<pool>/dbufs-0x<objset id>.  Like the dataset kstats, snapshots
+ * are counted but not published.
+ */
+void
+dbuf_stats_objset_init(objset_t *os)
+{
+	char kstat_module_name[KSTAT_STRLEN];
+	char kstat_name[KSTAT_STRLEN];
+	dbuf_objset_stats_t *dos;
+	kstat_t *ksp;
+
+	wmsum_init(&os->os_dbuf_hits, 0);
+	wmsum_init(&os->os_dbuf_misses, 0);
+	os->os_dbuf_kstat = NULL;
+
+	if (dmu_objset_is_snapshot(os))
+		return;
+
+	if (snprintf(kstat_module_name, sizeof (kstat_module_name), "zfs/%s",
+	    spa_name(os->os_spa)) >= KSTAT_STRLEN ||
+	    snprintf(kstat_name, sizeof (kstat_name), "dbufs-0x%llx",
+	    (unsigned long long)dmu_objset_id(os)) >= KSTAT_STRLEN)
+		return;
+
+	ksp = kstat_create(kstat_module_name, 0, kstat_name, "misc",
+	    KSTAT_TYPE_NAMED, sizeof (dbuf_objset_stats_t) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (ksp == NULL)
+		return;
+
+	dos = kmem_alloc(sizeof (dbuf_objset_stats_t), KM_SLEEP);
+	memcpy(dos, &dbuf_objset_stats_template, sizeof (*dos));
+	ksp->ks_data = dos;
+	ksp->ks_private = os;
+	ksp->ks_update = dbuf_stats_objset_update;
+	kstat_install(ksp);
+	os->os_dbuf_kstat = ksp;
+}
+
+void
+dbuf_stats_objset_destroy(objset_t *os)
+{
+	kstat_t *ksp = os->os_dbuf_kstat;
+
+	if (ksp != NULL) {
+		void *data = ksp->ks_data;
+
+		kstat_delete(ksp);
+		kmem_free(data, sizeof (dbuf_objset_stats_t));
+		os->os_dbuf_kstat = NULL;
+	}
+
+	wmsum_fini(&os->os_dbuf_hits);
+	wmsum_fini(&os->os_dbuf_misses);
+}
+
 void
 dbuf_stats_init(dbuf_hash_table_t *hash)
 {
@@ -230,6 +230,13 @@ static kmem_cache_t *ddt_entry_trad_cache;
  */
 int zfs_dedup_prefetch = 0;
 
+/*
+ * Gather the keys of up to this many dedup writes, and prefetch their stored
+ * entries together in key order before looking any of them up, so that the
+ * on-disk lookups overlap instead of being issued one at a time. 0 disables.
+ */
+uint_t zfs_dedup_prefetch_batch = 0;
+
 /*
  * If the dedup class cannot satisfy a DDT allocation, treat as over quota
  * for this many TXGs.
@@ -290,6 +297,43 @@ boolean_t zfs_dedup_log_hard_cap = B_FALSE;
  */
 uint_t zfs_dedup_log_flush_flow_rate_txgs = 10;
 
+/*
+ * Number of key ranges to split each round of log flushing into. Each range
+ * is flushed by its own dp_sync_taskq thread, which first prefetches the
+ * store object leaves it is about to update. 1 flushes from the sync thread
+ * alone, one entry at a time.
+ */
+uint_t zfs_dedup_log_flush_shards = 8;
+
+/* Entries per shard in each round of a sharded log flush */
+#define	DDT_FLUSH_SHARD_ENTRIES	128
+#define	DDT_FLUSH_SHARDS_MAX	64
+
+/*
+ * Keep an in-memory Bloom filter over the keys of the stored DDT objects, so
+ * that lookups for blocks that are definitely not in the table (the common
+ * case when writing mostly-unique data) can skip the on-disk ZAP lookups.
+ * The filter is built incrementally in syncing context after import, and is
+ * only consulted once every stored entry has been added to it.
+ */
+int zfs_dedup_bloom = 0;
+
+/*
+ * Filter bits per stored entry. The filter is sized for twice the current
+ * number of stored entries, and rebuilt larger once it fills up.
+ */
+uint_t zfs_dedup_bloom_bits_per_entry = 16;
+
+/*
+ * Number of stored entries to add to the filter each txg while building it.
+ */
+uint_t zfs_dedup_bloom_build_entries = 100000;
+
+/* Number of hash functions; optimal for ~16 bits per entry at half fill. */
+#define	DDT_BLOOM_HASHES	6
+#define	DDT_BLOOM_MIN_BITS	(1ULL << 20)
+#define	DDT_BLOOM_MAX_BITS	(1ULL << 33)
+
 static const ddt_ops_t *const ddt_ops[DDT_TYPES] = {
 	&ddt_zap_ops,
 };
@@ -331,6 +375,10 @@ typedef struct {
 	kstat_named_t dds_lookup_stored_hit;
 	kstat_named_t dds_lookup_stored_miss;
 
+	/* store lookups skipped by the bloom filter, and its false positives */
+	kstat_named_t dds_lookup_bloom_skip;
+	kstat_named_t dds_lookup_bloom_false_pos;
+
 	/* number of entries on log trees */
 	kstat_named_t dds_log_active_entries;
 	kstat_named_t dds_log_flushing_entries;
@@ -339,6 +387,11 @@ typedef struct {
 	kstat_named_t dds_log_ingest_rate;
 	kstat_named_t dds_log_flush_rate;
 	kstat_named_t dds_log_flush_time_rate;
+
+	/* bloom filter size, keys added and estimated false positive rate */
+	kstat_named_t dds_bloom_bytes;
+	kstat_named_t dds_bloom_keys;
+	kstat_named_t dds_bloom_fpr_ppm;
 } ddt_kstats_t;
 
 static const ddt_kstats_t ddt_kstats_template = {
@@ -354,11 +407,16 @@ static const ddt_kstats_t ddt_kstats_template = {
 	{ "lookup_log_miss",		KSTAT_DATA_UINT64 },
 	{ "lookup_stored_hit",		KSTAT_DATA_UINT64 },
 	{ "lookup_stored_miss",		KSTAT_DATA_UINT64 },
+	{ "lookup_bloom_skip",		KSTAT_DATA_UINT64 },
+	{ "lookup_bloom_false_pos",	KSTAT_DATA_UINT64 },
 	{ "log_active_entries",		KSTAT_DATA_UINT64 },
 	{ "log_flushing_entries",	KSTAT_DATA_UINT64 },
 	{ "log_ingest_rate",		KSTAT_DATA_UINT32 },
 	{ "log_flush_rate",		KSTAT_DATA_UINT32 },
 	{ "log_flush_time_rate",	KSTAT_DATA_UINT32 },
+	{ "bloom_bytes",		KSTAT_DATA_UINT64 },
+	{ "bloom_keys",			KSTAT_DATA_UINT64 },
+	{ "bloom_fpr_ppm",		KSTAT_DATA_UINT64 },
 };
 
 #ifdef _KERNEL
@@ -381,6 +439,77 @@ static const ddt_kstats_t ddt_kstats_template = {
 #define	DDT_KSTAT_ZERO(ddt, stat) do {} while (0)
 #endif /* _KERNEL */
 
+/*
+ * The key is already a cryptographic-strength checksum, so its words are
+ * used directly as the two base hashes for double hashing.
+ */
+#define	DDT_BLOOM_BIT(ddt, ddk, i)					\
+	(((ddk)->ddk_cksum.zc_word[0] +					\
+	    (i) * ((ddk)->ddk_cksum.zc_word[1] | 1)) &			\
+	    ((ddt)->ddt_bloom_nbits - 1))
+
+static void
+ddt_bloom_add(ddt_t *ddt, const ddt_key_t *ddk)
+{
+	if (ddt->ddt_bloom == NULL)
+		return;
+
+	for (int i = 0; i < DDT_BLOOM_HASHES; i++) {
+		uint64_t bit = DDT_BLOOM_BIT(ddt, ddk, i);
+		uint64_t *word = &ddt->ddt_bloom[bit >> 6];
+		uint64_t mask = 1ULL << (bit & 63);
+
+		if ((atomic_load_64(word) & mask) == 0) {
+			atomic_or_64(word, mask);
+			atomic_inc_64(&ddt->ddt_bloom_set);
+		}
+	}
+	atomic_inc_64(&ddt->ddt_bloom_keys);
+}
+
+/*
+ * Returns B_FALSE if the key is definitely not in any stored object. Must be
+ * called with ddt_lock held, which keeps the filter from being freed.
+ */
+static boolean_t
+ddt_bloom_contains(const ddt_t *ddt, const ddt_key_t *ddk)
+{
+	ASSERT(MUTEX_HELD(&ddt->ddt_lock));
+
+	if (!ddt->ddt_bloom_ready)
+		return (B_TRUE);
+
+	for (int i = 0; i < DDT_BLOOM_HASHES; i++) {
+		uint64_t bit = DDT_BLOOM_BIT(ddt, ddk, i);
+		if ((atomic_load_64(&ddt->ddt_bloom[bit >> 6]) &
+		    (1ULL << (bit & 63))) == 0)
+			return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+static void
+ddt_bloom_free(ddt_t *ddt)
+{
+	if (ddt->ddt_bloom == NULL)
+		return;
+
+	ddt_enter(ddt);
+	uint64_t *bloom = ddt->ddt_bloom;
+	uint64_t nbits = ddt->ddt_bloom_nbits;
+	ddt->ddt_bloom = NULL;
+	ddt->ddt_bloom_nbits = 0;
+	ddt->ddt_bloom_set = 0;
+	ddt->ddt_bloom_keys = 0;
+	ddt->ddt_bloom_ready = B_FALSE;
+	ddt_exit(ddt);
+
+	vmem_free(bloom, nbits / NBBY);
+
+	DDT_KSTAT_ZERO(ddt, dds_bloom_bytes);
+	DDT_KSTAT_ZERO(ddt, dds_bloom_keys);
+	DDT_KSTAT_ZERO(ddt, dds_bloom_fpr_ppm);
+}
 
 static void
 ddt_object_create(ddt_t *ddt, ddt_type_t type, ddt_class_t class,
@@ -568,6 +697,8 @@ ddt_object_update(ddt_t *ddt, ddt_type_t type, ddt_class_t class,
 {
 	ASSERT(ddt_object_exists(ddt, type, class));
 
+	ddt_bloom_add(ddt, &ddlwe->ddlwe_key);
+
 	return (ddt_ops[type]->ddt_op_update(ddt->ddt_os,
 	    ddt->ddt_object[type][class], &ddlwe->ddlwe_key,
 	    &ddlwe->ddlwe_phys, DDT_PHYS_SIZE(ddt), tx));
@@ -1280,21 +1411,34 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t verify)
 	 * ddt_tree is now stable, so unlock and let everyone else keep moving.
 	 * Anyone landing on this entry will find it without DDE_FLAG_LOADED,
 	 * and go to sleep waiting for it above.
+	 *
+	 * If the bloom filter says the key was never stored, there's no
+	 * point searching the store objects for it.
 	 */
+	boolean_t bloom_ready = ddt->ddt_bloom_ready;
+	boolean_t maybe_stored = ddt_bloom_contains(ddt, &search);
+
 	ddt_exit(ddt);
 
 	/* Search all store objects for the entry. */
 	error = ENOENT;
-	for (type = 0; type < DDT_TYPES; type++) {
-		for (class = 0; class < DDT_CLASSES; class++) {
-			error = ddt_object_lookup(ddt, type, class, dde);
-			if (error != ENOENT) {
-				ASSERT0(error);
-				break;
+	if (!maybe_stored) {
+		DDT_KSTAT_BUMP(ddt, dds_lookup_bloom_skip);
+		type = DDT_TYPES;
+		class = DDT_CLASSES;
+	} else {
+		for (type = 0; type < DDT_TYPES; type++) {
+			for (class = 0; class < DDT_CLASSES; class++) {
+				error = ddt_object_lookup(ddt, type, class,
+				    dde);
+				if (error != ENOENT) {
+					ASSERT0(error);
+					break;
+				}
 			}
+			if (error != ENOENT)
+				break;
 		}
-		if (error != ENOENT)
-			break;
 	}
 
 	ddt_enter(ddt);
@@ -1359,6 +1503,8 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t verify)
 	} else {
 		DDT_KSTAT_BUMP(ddt, dds_lookup_stored_miss);
 		DDT_KSTAT_BUMP(ddt, dds_lookup_new);
+		if (bloom_ready && maybe_stored)
+			DDT_KSTAT_BUMP(ddt, dds_lookup_bloom_false_pos);
 	}
 
 	/* Entry loaded, everyone can proceed now */
@@ -1395,6 +1541,73 @@ ddt_prefetch(spa_t *spa, const blkptr_t *bp)
 	}
 }
 
+/*
+ * Issue prefetches for every key in the pending batch. The keys are kept in
+ * ddt_key_compare() order, which is the order ddt_zap.c hashes them into the
+ * ZAP, so neighbouring keys land on the same or adjacent leaf blocks.
+ */
+void
+ddt_prefetch_batch_issue(ddt_t *ddt)
+{
+	ddt_key_t keys[DDT_PREFETCH_BATCH_MAX];
+	uint_t nkeys;
+
+	if (ddt->ddt_prefetch_nkeys == 0)
+		return;
+
+	mutex_enter(&ddt->ddt_prefetch_lock);
+	nkeys = ddt->ddt_prefetch_nkeys;
+	memcpy(keys, ddt->ddt_prefetch_keys, nkeys * sizeof (ddt_key_t));
+	ddt->ddt_prefetch_nkeys = 0;
+	mutex_exit(&ddt->ddt_prefetch_lock);
+
+	for (uint_t i = 0; i < nkeys; i++) {
+		for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
+			for (ddt_class_t class = 0; class < DDT_CLASSES;
+			    class++) {
+				ddt_object_prefetch(ddt, type, class, &keys[i]);
+			}
+		}
+	}
+}
+
+/*
+ * Add the key for a dedup write to the pending prefetch batch, issuing the
+ * batch once it is full. Returns B_FALSE if batching is disabled or there is
+ * nothing stored to prefetch, in which case the caller should just go ahead
+ * with the lookup.
+ */
+boolean_t
+ddt_prefetch_batch_add(ddt_t *ddt, const blkptr_t *bp)
+{
+	uint_t batch = MIN(zfs_dedup_prefetch_batch, DDT_PREFETCH_BATCH_MAX);
+	ddt_key_t ddk;
+	boolean_t full;
+
+	/* As in ddt_prefetch(), the DDT can't disappear while in use. */
+	if (batch == 0 || ddt->ddt_version == DDT_VERSION_UNCONFIGURED)
+		return (B_FALSE);
+
+	ddt_key_fill(&ddk, bp);
+
+	mutex_enter(&ddt->ddt_prefetch_lock);
+	uint_t i = MIN(ddt->ddt_prefetch_nkeys, batch - 1);
+	while (i > 0 &&
+	    ddt_key_compare(&ddt->ddt_prefetch_keys[i - 1], &ddk) > 0) {
+		ddt->ddt_prefetch_keys[i] = ddt->ddt_prefetch_keys[i - 1];
+		i--;
+	}
+	ddt->ddt_prefetch_keys[i] = ddk;
+	ddt->ddt_prefetch_nkeys = MIN(ddt->ddt_prefetch_nkeys + 1, batch);
+	full = (ddt->ddt_prefetch_nkeys >= batch);
+	mutex_exit(&ddt->ddt_prefetch_lock);
+
+	if (full)
+		ddt_prefetch_batch_issue(ddt);
+
+	return (B_TRUE);
+}
+
 /*
  * ddt_key_t comparison. Any struct wanting to make use of this function must
  * have the key as the first element. Casts it to N uint64_ts, and checks until
@@ -1622,6 +1835,8 @@ ddt_table_alloc(spa_t *spa, enum zio_checksum c)
 	ddt = kmem_cache_alloc(ddt_cache, KM_SLEEP);
 	memset(ddt, 0, sizeof (ddt_t));
 	mutex_init(&ddt->ddt_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&ddt->ddt_flush_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&ddt->ddt_prefetch_lock, NULL, MUTEX_DEFAULT, NULL);
 	avl_create(&ddt->ddt_tree, ddt_key_compare,
 	    sizeof (ddt_entry_t), offsetof(ddt_entry_t, dde_node));
 	avl_create(&ddt->ddt_repair_tree, ddt_key_compare,
@@ -1648,11 +1863,18 @@ ddt_table_free(ddt_t *ddt)
 		kstat_delete(ddt->ddt_ksp);
 	}
 
+	if (ddt->ddt_bloom != NULL) {
+		vmem_free(ddt->ddt_bloom, ddt->ddt_bloom_nbits / NBBY);
+		ddt->ddt_bloom = NULL;
+	}
+
 	ddt_log_free(ddt);
 	ASSERT0(avl_numnodes(&ddt->ddt_tree));
 	ASSERT0(avl_numnodes(&ddt->ddt_repair_tree));
 	avl_destroy(&ddt->ddt_tree);
 	avl_destroy(&ddt->ddt_repair_tree);
+	mutex_destroy(&ddt->ddt_prefetch_lock);
+	mutex_destroy(&ddt->ddt_flush_lock);
 	mutex_destroy(&ddt->ddt_lock);
 	kmem_cache_free(ddt_cache, ddt);
 }
@@ -2025,14 +2247,81 @@ ddt_sync_flush_entry(ddt_t *ddt, ddt_lightweight_entry_t *ddlwe,
 		ddt_histogram_t *ddh =
 		    &ddt->ddt_histogram[ntype][nclass];
 
+		mutex_enter(&ddt->ddt_flush_lock);
 		ddt_histogram_add_entry(ddt, ddh, ddlwe);
-
 		if (!ddt_object_exists(ddt, ntype, nclass))
 			ddt_object_create(ddt, ntype, nclass, tx);
+		mutex_exit(&ddt->ddt_flush_lock);
+
 		VERIFY0(ddt_object_update(ddt, ntype, nclass, ddlwe, tx));
 	}
 }
 
+typedef struct {
+	ddt_t				*dft_ddt;
+	ddt_lightweight_entry_t		*dft_entries;
+	uint_t				dft_count;
+	dmu_tx_t			*dft_tx;
+} ddt_flush_task_t;
+
+/*
+ * Flush one contiguous key range of logged entries to the store objects.
+ * Since ddt_zap.c hashes the key prefix into the ZAP, a key range maps to a
+ * narrow range of leaf blocks, so shards mostly touch disjoint leaves and the
+ * fat ZAP lets them update concurrently.
+ */
+static void
+ddt_sync_flush_task(void *arg)
+{
+	ddt_flush_task_t *dft = arg;
+	ddt_t *ddt = dft->dft_ddt;
+
+	if (dft->dft_count > 1) {
+		for (uint_t i = 0; i < dft->dft_count; i++) {
+			for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
+				for (ddt_class_t class = 0;
+				    class < DDT_CLASSES; class++) {
+					ddt_object_prefetch(ddt, type, class,
+					    &dft->dft_entries[i].ddlwe_key);
+				}
+			}
+		}
+	}
+
+	for (uint_t i = 0; i < dft->dft_count; i++) {
+		ddt_lightweight_entry_t *ddlwe = &dft->dft_entries[i];
+		ddt_sync_flush_entry(ddt, ddlwe,
+		    ddlwe->ddlwe_type, ddlwe->ddlwe_class, dft->dft_tx);
+	}
+}
+
+static void
+ddt_sync_flush_batch(ddt_t *ddt, ddt_lightweight_entry_t *entries,
+    uint_t count, uint_t shards, dmu_tx_t *tx)
+{
+	ddt_flush_task_t tasks[DDT_FLUSH_SHARDS_MAX];
+	taskqid_t ids[DDT_FLUSH_SHARDS_MAX];
+	uint_t per = DIV_ROUND_UP(count, shards);
+
+	if (shards == 1 || count <= per) {
+		tasks[0] = (ddt_flush_task_t){ ddt, entries, count, tx };
+		ddt_sync_flush_task(&tasks[0]);
+		return;
+	}
+
+	taskq_t *tq = ddt->ddt_spa->spa_dsl_pool->dp_sync_taskq;
+	uint_t n = 0;
+	for (uint_t i = 0; i < count; i += per, n++) {
+		tasks[n] = (ddt_flush_task_t){
+		    ddt, &entries[i], MIN(per, count - i), tx };
+		ids[n] = taskq_dispatch(tq, ddt_sync_flush_task, &tasks[n],
+		    TQ_SLEEP);
+		VERIFY3U(ids[n], !=, TASKQID_INVALID);
+	}
+	for (uint_t i = 0; i < n; i++)
+		taskq_wait_id(tq, ids[i]);
+}
+
 /* Calculate an exponential weighted moving average, lower limited to zero */
 static inline int32_t
 _ewma(int32_t val, int32_t prev, uint32_t weight)
@@ -2173,13 +2462,34 @@ ddt_sync_flush_log(ddt_t *ddt, dmu_tx_t *tx)
 		target_time = SEC2NSEC(zfs_txg_timeout) / 2;
 	}
 
+	/*
+	 * Entries are taken in key order a round at a time, and each round is
+	 * split into key ranges flushed in parallel. The round is finished
+	 * before the next is taken, so the checkpoint (the last key of the
+	 * last round) still covers everything before it.
+	 */
+	uint_t shards = MIN(MAX(zfs_dedup_log_flush_shards, 1),
+	    DDT_FLUSH_SHARDS_MAX);
+	uint_t round_max = (shards == 1) ? 1 :
+	    shards * DDT_FLUSH_SHARD_ENTRIES;
+	ddt_lightweight_entry_t *batch =
+	    vmem_alloc(round_max * sizeof (ddt_lightweight_entry_t), KM_SLEEP);
+
 	ddt_lightweight_entry_t ddlwe;
-	while (ddt_log_take_first(ddt, ddt->ddt_log_flushing, &ddlwe)) {
-		ddt_sync_flush_entry(ddt, &ddlwe,
-		    ddlwe.ddlwe_type, ddlwe.ddlwe_class, tx);
+	for (;;) {
+		uint_t n = 0;
+		while (n < round_max && (n == 0 || count + n < flush_max) &&
+		    ddt_log_take_first(ddt, ddt->ddt_log_flushing, &batch[n]))
+			n++;
+		if (n == 0)
+			break;
+
+		ddt_sync_flush_batch(ddt, batch, n, shards, tx);
+		ddlwe = batch[n - 1];
+		count += n;
 
 		/* End if we've synced as much as we needed to. */
-		if (++count >= flush_max)
+		if (count >= flush_max)
 			break;
 
 		/*
@@ -2198,6 +2508,8 @@ ddt_sync_flush_log(ddt_t *ddt, dmu_tx_t *tx)
 			break;
 	}
 
+	vmem_free(batch, round_max * sizeof (ddt_lightweight_entry_t));
+
 	if (avl_is_empty(&ddt->ddt_log_flushing->ddl_tree)) {
 		/* We emptied it, so truncate on-disk */
 		DDT_KSTAT_ZERO(ddt, dds_log_flushing_entries);
@@ -2375,6 +2687,113 @@ ddt_sync_table(ddt_t *ddt, dmu_tx_t *tx)
 		ddt_sync_table_flush(ddt, tx);
 }
 
+/*
+ * Allocate, incrementally build and, once it has filled up, resize the bloom
+ * filter. Entries written to the store objects are added as they are written
+ * (see ddt_object_update()), so once the walk over the existing objects has
+ * completed, the filter covers every stored key.
+ */
+static void
+ddt_bloom_sync(ddt_t *ddt, dmu_tx_t *tx)
+{
+	spa_t *spa = ddt->ddt_spa;
+
+	if (!zfs_dedup_bloom) {
+		ddt_bloom_free(ddt);
+		return;
+	}
+
+	if (ddt->ddt_version == DDT_VERSION_UNCONFIGURED ||
+	    spa_sync_pass(spa) > 1 || tx->tx_txg > spa_final_dirty_txg(spa))
+		return;
+
+	/*
+	 * Past half full the false positive rate climbs quickly, so start
+	 * over with a filter sized for the current number of entries.
+	 */
+	if (ddt->ddt_bloom_ready &&
+	    ddt->ddt_bloom_set > ddt->ddt_bloom_nbits / 2 &&
+	    ddt->ddt_bloom_nbits < DDT_BLOOM_MAX_BITS)
+		ddt_bloom_free(ddt);
+
+	if (ddt->ddt_bloom == NULL) {
+		uint64_t entries = 0;
+		for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
+			for (ddt_class_t class = 0; class < DDT_CLASSES;
+			    class++) {
+				uint64_t count;
+				if (ddt_object_exists(ddt, type, class) &&
+				    ddt_object_count(ddt, type, class,
+				    &count) == 0)
+					entries += count;
+			}
+		}
+
+		uint64_t nbits = MAX(entries * 2 *
+		    MAX(zfs_dedup_bloom_bits_per_entry, 1), DDT_BLOOM_MIN_BITS);
+		nbits = MIN(1ULL << highbit64(nbits - 1), DDT_BLOOM_MAX_BITS);
+		uint64_t *bloom = vmem_zalloc(nbits / NBBY, KM_SLEEP);
+
+		ddt_enter(ddt);
+		ddt->ddt_bloom = bloom;
+		ddt->ddt_bloom_nbits = nbits;
+		ddt->ddt_bloom_type = 0;
+		ddt->ddt_bloom_class = 0;
+		ddt->ddt_bloom_walk = 0;
+		ddt_exit(ddt);
+
+		DDT_KSTAT_SET(ddt, dds_bloom_bytes, nbits / NBBY);
+	}
+
+	if (!ddt->ddt_bloom_ready) {
+		ddt_lightweight_entry_t ddlwe;
+		uint_t count = 0;
+
+		while (ddt->ddt_bloom_type < DDT_TYPES &&
+		    count < zfs_dedup_bloom_build_entries) {
+			ddt_type_t type = ddt->ddt_bloom_type;
+			ddt_class_t class = ddt->ddt_bloom_class;
+			int error = ENOENT;
+
+			if (ddt_object_exists(ddt, type, class)) {
+				error = ddt_object_walk(ddt, type, class,
+				    &ddt->ddt_bloom_walk, &ddlwe);
+			}
+			if (error == 0) {
+				ddt_bloom_add(ddt, &ddlwe.ddlwe_key);
+				count++;
+				continue;
+			}
+			if (error != ENOENT) {
+				/* Can't trust it with a hole; retry later. */
+				ddt_bloom_free(ddt);
+				return;
+			}
+
+			ddt->ddt_bloom_walk = 0;
+			if (++ddt->ddt_bloom_class == DDT_CLASSES) {
+				ddt->ddt_bloom_class = 0;
+				ddt->ddt_bloom_type++;
+			}
+		}
+
+		if (ddt->ddt_bloom_type == DDT_TYPES) {
+			ddt_enter(ddt);
+			ddt->ddt_bloom_ready = B_TRUE;
+			ddt_exit(ddt);
+		}
+	}
+
+	/* Estimated false positive rate is the fill fraction to the k. */
+	uint64_t fill = ddt->ddt_bloom_set * 1000000 / ddt->ddt_bloom_nbits;
+	uint64_t fpr = 1000000;
+	for (int i = 0; i < DDT_BLOOM_HASHES; i++)
+		fpr = fpr * fill / 1000000;
+
+	DDT_KSTAT_SET(ddt, dds_bloom_keys, ddt->ddt_bloom_keys);
+	DDT_KSTAT_SET(ddt, dds_bloom_fpr_ppm, fpr);
+}
+
 void
 ddt_sync(spa_t *spa, uint64_t txg)
 {
@@ -2405,6 +2824,7 @@ ddt_sync(spa_t *spa, uint64_t txg)
 		ddt_sync_table(ddt, tx);
 		if (ddt->ddt_flags & DDT_FLAG_LOG)
 			ddt_sync_flush_log(ddt, tx);
+		ddt_bloom_sync(ddt, tx);
 		ddt_repair_table(ddt, rio);
 	}
 
@@ -2803,6 +3223,9 @@ ddt_prune_unique_entries(spa_t *spa, zpool_ddt_prune_unit_t unit,
 ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, prefetch, INT, ZMOD_RW,
 	"Enable prefetching dedup-ed blks");
 
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, prefetch_batch, UINT, ZMOD_RW,
+	"Number of dedup write lookups to gather and prefetch together");
+
 ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_flush_min_time_ms, UINT, ZMOD_RW,
 	"Min time to spend on incremental dedup log flush each transaction");
 
@@ -2815,6 +3238,9 @@ ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_flush_entries_max, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_flush_txgs, UINT, ZMOD_RW,
 	"Number of TXGs to try to rotate the log in");
 
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_flush_shards, UINT, ZMOD_RW,
+	"Number of key ranges to flush the dedup log in parallel");
+
 ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_cap, UINT, ZMOD_RW,
 	"Soft cap for the size of the current dedup log");
 
@@ -2823,3 +3249,12 @@ ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_hard_cap, UINT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_flush_flow_rate_txgs, UINT, ZMOD_RW,
 	"Number of txgs to average flow rates across");
+
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, bloom, INT, ZMOD_RW,
+	"Skip on-disk DDT lookups for keys absent from an in-memory filter");
+
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, bloom_bits_per_entry, UINT, ZMOD_RW,
+	"Bloom filter bits per stored DDT entry");
+
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, bloom_build_entries, UINT, ZMOD_RW,
+	"Number of stored DDT entries to add to the bloom filter per txg");
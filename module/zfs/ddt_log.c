@@ -48,22 +48,31 @@ uint64_t zfs_dedup_log_mem_max = 0;
 uint_t zfs_dedup_log_mem_max_percent = 1;
 
 
-static kmem_cache_t *ddt_log_entry_flat_cache;
+/* Flat entries, by number of DVAs kept */
+static kmem_cache_t *ddt_log_entry_flat_cache[SPA_DVAS_PER_BP];
 static kmem_cache_t *ddt_log_entry_trad_cache;
 
-#define	DDT_LOG_ENTRY_FLAT_SIZE	\
-	(sizeof (ddt_log_entry_t) + DDT_FLAT_PHYS_SIZE)
+#define	DDT_LOG_ENTRY_FLAT_SIZE(ndvas)	\
+	(sizeof (ddt_log_entry_t) + sizeof (ddt_log_flat_phys_t) + \
+	(ndvas) * sizeof (dva_t))
 #define	DDT_LOG_ENTRY_TRAD_SIZE	\
 	(sizeof (ddt_log_entry_t) + DDT_TRAD_PHYS_SIZE)
 
-#define	DDT_LOG_ENTRY_SIZE(ddt)	\
-	_DDT_PHYS_SWITCH(ddt, DDT_LOG_ENTRY_FLAT_SIZE, DDT_LOG_ENTRY_TRAD_SIZE)
+static const char *const ddt_log_entry_flat_cache_name[SPA_DVAS_PER_BP] = {
+	"ddt_log_entry_flat1_cache",
+	"ddt_log_entry_flat2_cache",
+	"ddt_log_entry_flat3_cache",
+};
 
 void
 ddt_log_init(void)
 {
-	ddt_log_entry_flat_cache = kmem_cache_create("ddt_log_entry_flat_cache",
-	    DDT_LOG_ENTRY_FLAT_SIZE, 0, NULL, NULL, NULL, NULL, NULL, 0);
+	for (int d = 0; d < SPA_DVAS_PER_BP; d++) {
+		ddt_log_entry_flat_cache[d] = kmem_cache_create(
+		    ddt_log_entry_flat_cache_name[d],
+		    DDT_LOG_ENTRY_FLAT_SIZE(d + 1), 0, NULL, NULL, NULL, NULL,
+		    NULL, 0);
+	}
 	ddt_log_entry_trad_cache = kmem_cache_create("ddt_log_entry_trad_cache",
 	    DDT_LOG_ENTRY_TRAD_SIZE, 0, NULL, NULL, NULL, NULL, NULL, 0);
 
@@ -85,7 +94,8 @@ void
 ddt_log_fini(void)
 {
 	kmem_cache_destroy(ddt_log_entry_trad_cache);
-	kmem_cache_destroy(ddt_log_entry_flat_cache);
+	for (int d = 0; d < SPA_DVAS_PER_BP; d++)
+		kmem_cache_destroy(ddt_log_entry_flat_cache[d]);
 }
 
 static void
@@ -186,7 +196,8 @@ ddt_log_update_stats(ddt_t *ddt)
 	ddo->ddo_count =
 	    avl_numnodes(&ddt->ddt_log_active->ddl_tree) +
 	    avl_numnodes(&ddt->ddt_log_flushing->ddl_tree);
-	ddo->ddo_mspace = ddo->ddo_count * DDT_LOG_ENTRY_SIZE(ddt);
+	ddo->ddo_mspace = ddt->ddt_log_active->ddl_mspace +
+	    ddt->ddt_log_flushing->ddl_mspace;
 	ddo->ddo_dspace = nblocks << 9;
 }
 
@@ -226,37 +237,124 @@ ddt_log_begin(ddt_t *ddt, size_t nentries, dmu_tx_t *tx, ddt_log_update_t *dlu)
 	dlu->dlu_block = dlu->dlu_offset = 0;
 }
 
+/*
+ * Number of DVAs a packed flat phys needs to keep: up to the last one in
+ * use, and at least one so that every entry has a cache to come from.
+ */
+static uint_t
+ddt_log_flat_ndvas(const ddt_univ_phys_t *ddp)
+{
+	uint_t ndvas = SPA_DVAS_PER_BP;
+	while (ndvas > 1 && DVA_IS_EMPTY(&ddp->ddp_flat.ddp_dva[ndvas - 1]))
+		ndvas--;
+	return (ndvas);
+}
+
+static size_t
+ddt_log_entry_size(const ddt_t *ddt, uint_t ndvas)
+{
+	return (ddt->ddt_flags & DDT_FLAG_FLAT ?
+	    DDT_LOG_ENTRY_FLAT_SIZE(ndvas) : DDT_LOG_ENTRY_TRAD_SIZE);
+}
+
 static ddt_log_entry_t *
-ddt_log_alloc_entry(ddt_t *ddt)
+ddt_log_alloc_entry(ddt_t *ddt, ddt_log_t *ddl, uint_t ndvas)
 {
 	ddt_log_entry_t *ddle;
 
 	if (ddt->ddt_flags & DDT_FLAG_FLAT) {
-		ddle = kmem_cache_alloc(ddt_log_entry_flat_cache, KM_SLEEP);
-		memset(ddle, 0, DDT_LOG_ENTRY_FLAT_SIZE);
+		ASSERT3U(ndvas, >=, 1);
+		ASSERT3U(ndvas, <=, SPA_DVAS_PER_BP);
+		ddle = kmem_cache_alloc(ddt_log_entry_flat_cache[ndvas - 1],
+		    KM_SLEEP);
 	} else {
 		ddle = kmem_cache_alloc(ddt_log_entry_trad_cache, KM_SLEEP);
-		memset(ddle, 0, DDT_LOG_ENTRY_TRAD_SIZE);
+		ndvas = 0;
 	}
+	memset(ddle, 0, ddt_log_entry_size(ddt, ndvas));
+	ddle->ddle_ndvas = ndvas;
+	ddl->ddl_mspace += ddt_log_entry_size(ddt, ndvas);
 
 	return (ddle);
 }
 
+static void
+ddt_log_free_entry(ddt_t *ddt, ddt_log_t *ddl, ddt_log_entry_t *ddle)
+{
+	ASSERT3U(ddl->ddl_mspace, >=,
+	    ddt_log_entry_size(ddt, ddle->ddle_ndvas));
+	ddl->ddl_mspace -= ddt_log_entry_size(ddt, ddle->ddle_ndvas);
+
+	if (ddt->ddt_flags & DDT_FLAG_FLAT) {
+		kmem_cache_free(ddt_log_entry_flat_cache[ddle->ddle_ndvas - 1],
+		    ddle);
+	} else {
+		kmem_cache_free(ddt_log_entry_trad_cache, ddle);
+	}
+}
+
+void
+ddt_log_entry_unpack(const ddt_t *ddt, const ddt_log_entry_t *ddle,
+    ddt_univ_phys_t *ddp)
+{
+	if (!(ddt->ddt_flags & DDT_FLAG_FLAT)) {
+		memcpy(ddp, ddle->ddle_phys, DDT_TRAD_PHYS_SIZE);
+		return;
+	}
+
+	const ddt_log_flat_phys_t *ddlp =
+	    (const ddt_log_flat_phys_t *)ddle->ddle_phys;
+	memset(ddp, 0, DDT_FLAT_PHYS_SIZE);
+	memcpy(ddp->ddp_flat.ddp_dva, ddlp->ddlp_dva,
+	    ddle->ddle_ndvas * sizeof (dva_t));
+	ddp->ddp_flat.ddp_refcnt = ddlp->ddlp_refcnt;
+	ddp->ddp_flat.ddp_phys_birth = ddlp->ddlp_phys_birth;
+	ddp->ddp_flat.ddp_class_start = ddlp->ddlp_class_start;
+}
+
+static void
+ddt_log_entry_pack(const ddt_t *ddt, ddt_log_entry_t *ddle,
+    const ddt_univ_phys_t *ddp)
+{
+	if (!(ddt->ddt_flags & DDT_FLAG_FLAT)) {
+		memcpy(ddle->ddle_phys, ddp, DDT_TRAD_PHYS_SIZE);
+		return;
+	}
+
+	ddt_log_flat_phys_t *ddlp = (ddt_log_flat_phys_t *)ddle->ddle_phys;
+	memcpy(ddlp->ddlp_dva, ddp->ddp_flat.ddp_dva,
+	    ddle->ddle_ndvas * sizeof (dva_t));
+	ddlp->ddlp_refcnt = ddp->ddp_flat.ddp_refcnt;
+	ddlp->ddlp_phys_birth = ddp->ddp_flat.ddp_phys_birth;
+	ddlp->ddlp_class_start = ddp->ddp_flat.ddp_class_start;
+}
+
 static void
 ddt_log_update_entry(ddt_t *ddt, ddt_log_t *ddl, ddt_lightweight_entry_t *ddlwe)
 {
+	uint_t ndvas = (ddt->ddt_flags & DDT_FLAG_FLAT) ?
+	    ddt_log_flat_ndvas(&ddlwe->ddlwe_phys) : 0;
+
 	/* Create the log tree entry from a live or stored entry */
 	avl_index_t where;
 	ddt_log_entry_t *ddle =
 	    avl_find(&ddl->ddl_tree, &ddlwe->ddlwe_key, &where);
 	if (ddle == NULL) {
-		ddle = ddt_log_alloc_entry(ddt);
+		ddle = ddt_log_alloc_entry(ddt, ddl, ndvas);
 		ddle->ddle_key = ddlwe->ddlwe_key;
 		avl_insert(&ddl->ddl_tree, ddle, where);
+	} else if (ddle->ddle_ndvas != ndvas) {
+		/* The phys no longer fits its size, swap in a new entry */
+		ddt_log_entry_t *old = ddle;
+		ddle = ddt_log_alloc_entry(ddt, ddl, ndvas);
+		ddle->ddle_key = ddlwe->ddlwe_key;
+		avl_insert_here(&ddl->ddl_tree, ddle, old, AVL_AFTER);
+		avl_remove(&ddl->ddl_tree, old);
+		ddt_log_free_entry(ddt, ddl, old);
 	}
 	ddle->ddle_type = ddlwe->ddlwe_type;
 	ddle->ddle_class = ddlwe->ddlwe_class;
-	memcpy(ddle->ddle_phys, &ddlwe->ddlwe_phys, DDT_PHYS_SIZE(ddt));
+	ddt_log_entry_pack(ddt, ddle, &ddlwe->ddlwe_phys);
 }
 
 void
@@ -347,8 +445,7 @@ ddt_log_take_first(ddt_t *ddt, ddt_log_t *ddl, ddt_lightweight_entry_t *ddlwe)
 	ddt_histogram_sub_entry(ddt, &ddt->ddt_log_histogram, ddlwe);
 
 	avl_remove(&ddl->ddl_tree, ddle);
-	kmem_cache_free(ddt->ddt_flags & DDT_FLAG_FLAT ?
-	    ddt_log_entry_flat_cache : ddt_log_entry_trad_cache, ddle);
+	ddt_log_free_entry(ddt, ddl, ddle);
 
 	return (B_TRUE);
 }
@@ -365,8 +462,7 @@ ddt_log_remove_key(ddt_t *ddt, ddt_log_t *ddl, const ddt_key_t *ddk)
 	ddt_histogram_sub_entry(ddt, &ddt->ddt_log_histogram, &ddlwe);
 
 	avl_remove(&ddl->ddl_tree, ddle);
-	kmem_cache_free(ddt->ddt_flags & DDT_FLAG_FLAT ?
-	    ddt_log_entry_flat_cache : ddt_log_entry_trad_cache, ddle);
+	ddt_log_free_entry(ddt, ddl, ddle);
 
 	return (B_TRUE);
 }
@@ -460,8 +556,7 @@ ddt_log_swap(ddt_t *ddt, dmu_tx_t *tx)
 	 * the available memory.
 	 */
 	const boolean_t too_large =
-	    (avl_numnodes(&ddt->ddt_log_active->ddl_tree) *
-	    DDT_LOG_ENTRY_SIZE(ddt)) >= (zfs_dedup_log_mem_max >> 1);
+	    ddt->ddt_log_active->ddl_mspace >= (zfs_dedup_log_mem_max >> 1);
 
 	const boolean_t too_old =
 	    tx->tx_txg >=
@@ -527,10 +622,10 @@ ddt_log_empty(ddt_t *ddt, ddt_log_t *ddl)
 	IMPLY(ddt->ddt_version == UINT64_MAX, avl_is_empty(&ddl->ddl_tree));
 	while ((ddle =
 	    avl_destroy_nodes(&ddl->ddl_tree, &cookie)) != NULL) {
-		kmem_cache_free(ddt->ddt_flags & DDT_FLAG_FLAT ?
-		    ddt_log_entry_flat_cache : ddt_log_entry_trad_cache, ddle);
+		ddt_log_free_entry(ddt, ddl, ddle);
 	}
 	ASSERT(avl_is_empty(&ddl->ddl_tree));
+	ASSERT0(ddl->ddl_mspace);
 }
 
 static int
@@ -727,6 +822,8 @@ ddt_log_load(ddt_t *ddt)
 				ddle = fe;
 				fe = AVL_NEXT(fl, fe);
 				avl_remove(fl, ddle);
+				ddt_log_free_entry(ddt,
+				    ddt->ddt_log_flushing, ddle);
 
 				ddle = ae;
 				ae = AVL_NEXT(al, ae);
@@ -76,6 +76,17 @@ static int zfs_nopwrite_enabled = 1;
  */
 static uint_t zfs_per_txg_dirty_frees_percent = 30;
 
+/*
+ * Background frees (e.g. the data of large unlinked files, which is freed
+ * after unlink has returned) are limited to a smaller share of each TXG
+ * while the pool has plenty of free space, so that they do not grow the
+ * TXGs of foreground writers.  As the normal class fills up toward
+ * zfs_bg_free_pressure_pct the share grows linearly from
+ * zfs_per_txg_dirty_bg_frees_percent to zfs_per_txg_dirty_frees_percent.
+ */
+static uint_t zfs_per_txg_dirty_bg_frees_percent = 5;
+static uint_t zfs_bg_free_pressure_pct = 80;
+
 /*
  * Enable/disable forcing txg sync when dirty checking for holes with lseek().
  * By default this is enabled to ensure accurate hole reporting, it can result
@@ -534,9 +545,11 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 	}
 	dbp = kmem_zalloc(sizeof (dmu_buf_t *) * nblks, KM_SLEEP);
 
-	if (read)
+	if (read) {
 		zio = zio_root(dn->dn_objset->os_spa, NULL, NULL,
 		    ZIO_FLAG_CANFAIL);
+		zio->io_qos_weight = dn->dn_objset->os_qos.zq_weight;
+	}
 	blkid = dbuf_whichblock(dn, 0, offset);
 	if ((flags & DMU_READ_NO_PREFETCH) == 0) {
 		/*
@@ -547,19 +560,27 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 		zs = dmu_zfetch_prepare(&dn->dn_zfetch, blkid, nblks,
 		    read && !(flags & DMU_DIRECTIO), B_TRUE);
 	}
-	for (i = 0; i < nblks; i++) {
-		dmu_buf_impl_t *db = dbuf_hold(dn, blkid + i, tag);
-		if (db == NULL) {
-			if (zs) {
-				dmu_zfetch_run(&dn->dn_zfetch, zs, missed,
-				    B_TRUE, (flags & DMU_UNCACHEDIO));
-			}
-			rw_exit(&dn->dn_struct_rwlock);
-			dmu_buf_rele_array(dbp, nblks, tag);
-			if (read)
-				zio_nowait(zio);
-			return (SET_ERROR(EIO));
+	/*
+	 * Hold all the dbufs in one pass so that the indirect blocks above
+	 * them are only looked up once per range rather than once per block.
+	 * The dmu_buf_t is the first member of dmu_buf_impl_t, so the array can
+	 * be filled in place.
+	 */
+	if (dbuf_hold_range(dn, blkid, nblks, tag,
+	    (dmu_buf_impl_t **)dbp) != 0) {
+		if (zs) {
+			dmu_zfetch_run(&dn->dn_zfetch, zs, missed,
+			    B_TRUE, (flags & DMU_UNCACHEDIO));
 		}
+		rw_exit(&dn->dn_struct_rwlock);
+		kmem_free(dbp, sizeof (dmu_buf_t *) * nblks);
+		if (read)
+			zio_nowait(zio);
+		return (SET_ERROR(EIO));
+	}
+
+	for (i = 0; i < nblks; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
 
 		/*
 		 * Initiate async demand data read.
@@ -582,7 +603,6 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 			if (db->db_state != DB_CACHED)
 				missed = B_TRUE;
 		}
-		dbp[i] = &db->db;
 	}
 
 	/*
@@ -865,6 +885,103 @@ dmu_prefetch_wait(objset_t *os, uint64_t object, uint64_t offset, uint64_t size)
 	return (err);
 }
 
+/*
+ * Read the given range of an object into the ARC like dmu_prefetch_wait(),
+ * at no more than dpp_rate bytes per second since dpp_start if dpp_rate is
+ * set.  The range is read in pieces of about a tenth of a second, so that
+ * the pace is smooth and signals are noticed quickly.
+ */
+typedef struct dmu_prefetch_pace {
+	hrtime_t	dpp_start;
+	uint64_t	dpp_bytes;
+	uint64_t	dpp_rate;
+} dmu_prefetch_pace_t;
+
+static int
+dmu_prefetch_paced(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t len, dmu_prefetch_pace_t *dpp)
+{
+	uint64_t rate = dpp->dpp_rate;
+	int err;
+
+	if (rate == 0)
+		return (dmu_prefetch_wait(os, object, offset, len));
+
+	uint64_t chunk = MAX(rate / 10, SPA_OLD_MAXBLOCKSIZE);
+	while (len > 0) {
+		uint64_t mylen = MIN(len, chunk);
+
+		err = dmu_prefetch_wait(os, object, offset, mylen);
+		if (err != 0)
+			return (err);
+		offset += mylen;
+		len -= mylen;
+
+		dpp->dpp_bytes += mylen;
+		hrtime_t wakeup = dpp->dpp_start +
+		    SEC2NSEC(dpp->dpp_bytes / rate) +
+		    USEC2NSEC((dpp->dpp_bytes % rate) * MICROSEC / rate);
+		if (wakeup > gethrtime())
+			zfs_sleep_until(wakeup);
+		if (issig())
+			return (SET_ERROR(EINTR));
+	}
+	return (0);
+}
+
+/*
+ * Read length bytes of an object starting at offset into the ARC, waiting
+ * for the reads to complete, at no more than rate bytes per second if rate
+ * is not zero.  The range is clipped to the end of the object.
+ */
+int
+dmu_prefetch_object(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t length, uint64_t rate)
+{
+	dmu_prefetch_pace_t dpp = { gethrtime(), 0, rate };
+	dmu_object_info_t doi;
+	int err;
+
+	err = dmu_object_info(os, object, &doi);
+	if (err != 0)
+		return (err);
+	if (offset >= doi.doi_max_offset)
+		return (0);
+	length = MIN(length, doi.doi_max_offset - offset);
+	return (dmu_prefetch_paced(os, object, offset, length, &dpp));
+}
+
+/*
+ * Read every object of the objset into the ARC, starting with the dnodes,
+ * at no more than rate bytes per second if rate is not zero.  Indirect
+ * blocks are read on the way, so this warms metadata and data alike.
+ * Objects are visited in object order; the vdev queues sort the reads of
+ * each batch by offset.
+ */
+int
+dmu_prefetch_objset(objset_t *os, uint64_t rate)
+{
+	dmu_prefetch_pace_t dpp = { gethrtime(), 0, rate };
+	dmu_object_info_t doi;
+	uint64_t object = DMU_META_DNODE_OBJECT;
+	int err;
+
+	do {
+		err = dmu_object_info(os, object, &doi);
+		if (err == 0 && doi.doi_max_offset > 0) {
+			err = dmu_prefetch_paced(os, object, 0,
+			    doi.doi_max_offset, &dpp);
+		}
+		/* The object may have been freed since we found it. */
+		if (err == ENOENT)
+			err = 0;
+		if (err != 0)
+			return (err);
+	} while ((err = dmu_object_next(os, &object, B_FALSE, 0)) == 0);
+
+	return (err == ESRCH ? 0 : err);
+}
+
 /*
  * Issue prefetch I/Os for the given object's dnode.
  */
@@ -881,6 +998,96 @@ dmu_prefetch_dnode(objset_t *os, uint64_t object, zio_priority_t pri)
 	rw_exit(&dn->dn_struct_rwlock);
 }
 
+/*
+ * Record an access pattern hint for the object's predictive prefetcher.
+ * The hint applies to the object as a whole, not to a particular handle,
+ * and lasts while the dnode stays cached.
+ */
+int
+dmu_object_set_advice(objset_t *os, uint64_t object, dmu_advice_t advice)
+{
+	dnode_t *dn;
+	int err;
+
+	err = dnode_hold(os, object, FTAG, &dn);
+	if (err != 0)
+		return (err);
+	dmu_zfetch_advise(&dn->dn_zfetch, advice);
+	dnode_rele(dn, FTAG);
+	return (0);
+}
+
+/*
+ * Drop the data blocks in the given range from the dbuf cache and the
+ * ARC, since the caller does not expect to access them again soon.  Blocks
+ * still held or dirty are dropped once released.  Only block pointers from
+ * indirect blocks already in cache are looked at, so no I/O is issued.
+ */
+void
+dmu_uncache_range(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t len)
+{
+	dmu_buf_impl_t *db, *parent = NULL;
+	uint64_t start, end, blkid;
+	dnode_t *dn;
+	int epbs;
+
+	if (len == 0 || dnode_hold(os, object, FTAG, &dn) != 0)
+		return;
+
+	rw_enter(&dn->dn_struct_rwlock, RW_READER);
+	if (dn->dn_datablkshift != 0) {
+		start = offset >> dn->dn_datablkshift;
+		end = (offset + MIN(len, UINT64_MAX - offset) - 1) >>
+		    dn->dn_datablkshift;
+	} else {
+		start = end = (offset < dn->dn_datablksz) ? 0 : 1;
+	}
+	end = MIN(end, dn->dn_maxblkid);
+	epbs = dn->dn_indblkshift - SPA_BLKPTRSHIFT;
+
+	for (blkid = start; blkid <= end; blkid++) {
+		const blkptr_t *bp = NULL;
+
+		if (dn->dn_nlevels == 1) {
+			bp = &dn->dn_phys->dn_blkptr[blkid];
+		} else {
+			uint64_t l1blkid = blkid >> epbs;
+
+			if (parent != NULL && parent->db_blkid != l1blkid) {
+				dbuf_rele(parent, FTAG);
+				parent = NULL;
+			}
+			/*
+			 * Cached level 0 dbufs hold their parent, so with
+			 * the level 1 indirect not cached skip all of it.
+			 */
+			if (parent == NULL && dbuf_hold_impl(dn, 1, l1blkid,
+			    TRUE, TRUE, FTAG, &parent) != 0) {
+				parent = NULL;
+				blkid = ((l1blkid + 1) << epbs) - 1;
+				continue;
+			}
+			bp = (blkptr_t *)parent->db.db_data +
+			    (blkid & ((1ULL << epbs) - 1));
+		}
+		if (!BP_IS_HOLE(bp) && !BP_IS_EMBEDDED(bp))
+			arc_uncache(os->os_spa, bp);
+
+		if (dbuf_hold_impl(dn, 0, blkid, TRUE, TRUE, FTAG, &db) == 0) {
+			mutex_enter(&db->db_mtx);
+			db->db_pending_evict = TRUE;
+			db->db_partial_read = FALSE;
+			mutex_exit(&db->db_mtx);
+			dbuf_rele(db, FTAG);
+		}
+	}
+	if (parent != NULL)
+		dbuf_rele(parent, FTAG);
+	rw_exit(&dn->dn_struct_rwlock);
+	dnode_rele(dn, FTAG);
+}
+
 /*
  * Get the next "chunk" of file data to free.  We traverse the file from
  * the end so that the file gets shorter over time (if we crash in the
@@ -978,12 +1185,13 @@ dmu_objset_zfs_unmounting(objset_t *os)
 
 static int
 dmu_free_long_range_impl(objset_t *os, dnode_t *dn, uint64_t offset,
-    uint64_t length)
+    uint64_t length, boolean_t background)
 {
 	uint64_t object_size;
 	int err;
 	uint64_t dirty_frees_threshold;
 	dsl_pool_t *dp = dmu_objset_pool(os);
+	uint_t pct = zfs_per_txg_dirty_frees_percent;
 
 	if (dn == NULL)
 		return (SET_ERROR(EINVAL));
@@ -992,11 +1200,21 @@ dmu_free_long_range_impl(objset_t *os, dnode_t *dn, uint64_t offset,
 	if (offset >= object_size)
 		return (0);
 
-	if (zfs_per_txg_dirty_frees_percent <= 100)
-		dirty_frees_threshold =
-		    zfs_per_txg_dirty_frees_percent * zfs_dirty_data_max / 100;
-	else
-		dirty_frees_threshold = zfs_dirty_data_max / 20;
+	if (pct > 100)
+		pct = 5;
+	if (background && pct > zfs_per_txg_dirty_bg_frees_percent) {
+		metaslab_class_t *mc = spa_normal_class(dp->dp_spa);
+		uint64_t space = metaslab_class_get_space(mc);
+		uint64_t capacity = (space == 0) ? 100 :
+		    metaslab_class_get_alloc(mc) * 100 / space;
+
+		if (capacity < zfs_bg_free_pressure_pct) {
+			pct = zfs_per_txg_dirty_bg_frees_percent +
+			    (pct - zfs_per_txg_dirty_bg_frees_percent) *
+			    capacity / zfs_bg_free_pressure_pct;
+		}
+	}
+	dirty_frees_threshold = pct * zfs_dirty_data_max / 100;
 
 	if (length == DMU_OBJECT_END || offset + length > object_size)
 		length = object_size - offset;
@@ -1080,9 +1298,9 @@ dmu_free_long_range_impl(objset_t *os, dnode_t *dn, uint64_t offset,
 	return (0);
 }
 
-int
-dmu_free_long_range(objset_t *os, uint64_t object,
-    uint64_t offset, uint64_t length)
+static int
+dmu_free_long_range_common(objset_t *os, uint64_t object,
+    uint64_t offset, uint64_t length, boolean_t background)
 {
 	dnode_t *dn;
 	int err;
@@ -1090,7 +1308,7 @@ dmu_free_long_range(objset_t *os, uint64_t object,
 	err = dnode_hold(os, object, FTAG, &dn);
 	if (err != 0)
 		return (err);
-	err = dmu_free_long_range_impl(os, dn, offset, length);
+	err = dmu_free_long_range_impl(os, dn, offset, length, background);
 
 	/*
 	 * It is important to zero out the maxblkid when freeing the entire
@@ -1105,6 +1323,27 @@ dmu_free_long_range(objset_t *os, uint64_t object,
 	return (err);
 }
 
+int
+dmu_free_long_range(objset_t *os, uint64_t object,
+    uint64_t offset, uint64_t length)
+{
+	return (dmu_free_long_range_common(os, object, offset, length,
+	    B_FALSE));
+}
+
+/*
+ * Like dmu_free_long_range(), for callers that free in the background and
+ * nobody is waiting on.  The frees are paced by the pool's free space; see
+ * zfs_per_txg_dirty_bg_frees_percent.
+ */
+int
+dmu_free_long_range_background(objset_t *os, uint64_t object,
+    uint64_t offset, uint64_t length)
+{
+	return (dmu_free_long_range_common(os, object, offset, length,
+	    B_TRUE));
+}
+
 int
 dmu_free_long_object(objset_t *os, uint64_t object)
 {
@@ -1764,6 +2003,12 @@ dmu_return_arcbuf(arc_buf_t *buf)
  * synced.  This makes it appropriate for workloads that are known to be
  * (temporarily) write-only, like "zfs receive".
  *
+ * It can't be used for ZPL or zvol writes, even full-block overwrites with
+ * primarycache=none: a read of the block before the txg syncs would create
+ * a dbuf from the old block pointer and return stale data, as nothing
+ * finds the data of a lightweight dirty record but its own sync.  Only a
+ * dataset being received, which can't be read, is safe.
+ *
  * A single block is written, starting at the specified offset in bytes.  If
  * the call is successful, it returns 0 and the provided abd has been
  * consumed (the caller should not free it).
@@ -1772,6 +2017,9 @@ int
 dmu_lightweight_write_by_dnode(dnode_t *dn, uint64_t offset, abd_t *abd,
     const zio_prop_t *zp, zio_flag_t flags, dmu_tx_t *tx)
 {
+	ASSERT(dn->dn_objset->os_dsl_dataset == NULL ||
+	    DS_IS_INCONSISTENT(dn->dn_objset->os_dsl_dataset));
+
 	dbuf_dirty_record_t *dr =
 	    dbuf_dirty_lightweight(dn, dbuf_whichblock(dn, 0, offset), tx);
 	if (dr == NULL)
@@ -1883,9 +2131,10 @@ dmu_sync_done(zio_t *zio, arc_buf_t *buf, void *varg)
 
 	/*
 	 * Record the vdev(s) backing this blkptr so they can be flushed after
-	 * the writes for the lwb have completed.
+	 * the writes for the lwb have completed.  Early txg writes (see
+	 * dsl_pool_early_write()) have no lwb.
 	 */
-	if (zgd && zio->io_error == 0) {
+	if (zgd && zgd->zgd_lwb != NULL && zio->io_error == 0) {
 		zil_lwb_add_block(zgd->zgd_lwb, zgd->zgd_bp);
 	}
 
@@ -1925,6 +2174,7 @@ dmu_sync_done(zio_t *zio, arc_buf_t *buf, void *varg)
 			BP_ZERO(&dr->dt.dl.dr_overridden_by);
 	} else {
 		dr->dt.dl.dr_override_state = DR_NOT_OVERRIDDEN;
+		dr->dt.dl.dr_early_write = B_FALSE;
 	}
 
 	cv_broadcast(&db->db_changed);
@@ -2086,12 +2336,20 @@ dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
 	dmu_write_policy(os, DB_DNODE(db), db->db_level, WP_DMU_SYNC, &zp);
 	DB_DNODE_EXIT(db);
 
+	/*
+	 * Early writes (see dsl_pool_early_write() and zfs_write_early())
+	 * have no log block, so they can only override the dirty record.
+	 */
+	if (zgd->zgd_lwb == NULL && txg > spa_freeze_txg(os->os_spa))
+		return (SET_ERROR(EALREADY));
+
 	/*
 	 * If we're frozen (running ziltest), we always need to generate a bp.
 	 */
 	if (txg > spa_freeze_txg(os->os_spa))
 		return (dmu_sync_late_arrival(pio, os, done, zgd, &zp, &zb));
 
+top:
 	/*
 	 * Grabbing db_mtx now provides a barrier between dbuf_sync_leaf()
 	 * and us.  If we determine that this txg is not yet syncing,
@@ -2114,6 +2372,8 @@ dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
 		 * the dirty record anymore; just write a new log block.
 		 */
 		mutex_exit(&db->db_mtx);
+		if (zgd->zgd_lwb == NULL)
+			return (SET_ERROR(EALREADY));
 		return (dmu_sync_late_arrival(pio, os, done, zgd, &zp, &zb));
 	}
 
@@ -2178,6 +2438,30 @@ dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
 	}
 
 	ASSERT(dr->dr_txg == txg);
+
+	/*
+	 * A block written out early is not covered by any log record yet,
+	 * so rather than returning EALREADY, wait for the early write and
+	 * log the block pointer it produced.
+	 */
+	if (dr->dt.dl.dr_early_write && zgd->zgd_lwb != NULL) {
+		if (dr->dt.dl.dr_override_state == DR_IN_DMU_SYNC) {
+			cv_wait(&db->db_changed, &db->db_mtx);
+			mutex_exit(&db->db_mtx);
+			goto top;
+		}
+		if (dr->dt.dl.dr_override_state == DR_OVERRIDDEN) {
+			*zgd->zgd_bp = dr->dt.dl.dr_overridden_by;
+			dr->dt.dl.dr_early_write = B_FALSE;
+			mutex_exit(&db->db_mtx);
+
+			if (!BP_IS_HOLE(zgd->zgd_bp))
+				zil_lwb_add_block(zgd->zgd_lwb, zgd->zgd_bp);
+			done(zgd, 0);
+			return (0);
+		}
+	}
+
 	if (dr->dt.dl.dr_override_state == DR_IN_DMU_SYNC ||
 	    dr->dt.dl.dr_override_state == DR_OVERRIDDEN) {
 		/*
@@ -2192,6 +2476,7 @@ dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
 	ASSERT0(dr->dt.dl.dr_has_raw_params);
 	ASSERT(dr->dt.dl.dr_override_state == DR_NOT_OVERRIDDEN);
 	dr->dt.dl.dr_override_state = DR_IN_DMU_SYNC;
+	dr->dt.dl.dr_early_write = (zgd->zgd_lwb == NULL);
 	mutex_exit(&db->db_mtx);
 
 	dsa = kmem_alloc(sizeof (dmu_sync_arg_t), KM_SLEEP);
@@ -2200,11 +2485,13 @@ dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
 	dsa->dsa_zgd = zgd;
 	dsa->dsa_tx = NULL;
 
+	/* Nobody waits on early writes, issue them as background writes. */
 	zio_nowait(arc_write(pio, os->os_spa, txg, zgd->zgd_bp,
 	    dr->dt.dl.dr_data, !DBUF_IS_CACHEABLE(db),
 	    dbuf_is_l2cacheable(db, NULL), &zp, dmu_sync_ready, NULL,
-	    dmu_sync_done, dsa, ZIO_PRIORITY_SYNC_WRITE, ZIO_FLAG_CANFAIL,
-	    &zb));
+	    dmu_sync_done, dsa, zgd->zgd_lwb != NULL ?
+	    ZIO_PRIORITY_SYNC_WRITE : ZIO_PRIORITY_ASYNC_WRITE,
+	    ZIO_FLAG_CANFAIL, &zb));
 
 	return (0);
 }
@@ -2473,6 +2760,15 @@ dmu_write_policy(objset_t *os, dnode_t *dn, int level, int wp, zio_prop_t *zp)
 		}
 	}
 
+	/*
+	 * Large unencrypted file blocks may be compressed in chunks, which
+	 * lets several threads share the work of a single block.
+	 */
+	if (!encrypt && level == 0 && dn != NULL && DMU_OT_IS_FILE(type) &&
+	    !(wp & WP_SPILL))
+		compress = zio_compress_chunked(os->os_spa, compress,
+		    dn->dn_datablksz);
+
 	zp->zp_compress = compress;
 	zp->zp_complevel = complevel;
 	zp->zp_checksum = checksum;
@@ -2492,6 +2788,7 @@ dmu_write_policy(objset_t *os, dnode_t *dn, int level, int wp, zio_prop_t *zp)
 	zp->zp_zpl_smallblk = DMU_OT_IS_FILE(zp->zp_type) ?
 	    os->os_zpl_special_smallblock : 0;
 	zp->zp_storage_type = dn ? dn->dn_storage_type : DMU_OT_NONE;
+	zp->zp_class_hint = ZIO_CLASS_HINT_NONE;
 
 	ASSERT3U(zp->zp_compress, !=, ZIO_COMPRESS_INHERIT);
 }
@@ -2910,8 +3207,11 @@ EXPORT_SYMBOL(dmu_buf_rele_array);
 EXPORT_SYMBOL(dmu_prefetch);
 EXPORT_SYMBOL(dmu_prefetch_by_dnode);
 EXPORT_SYMBOL(dmu_prefetch_dnode);
+EXPORT_SYMBOL(dmu_prefetch_object);
+EXPORT_SYMBOL(dmu_prefetch_objset);
 EXPORT_SYMBOL(dmu_free_range);
 EXPORT_SYMBOL(dmu_free_long_range);
+EXPORT_SYMBOL(dmu_free_long_range_background);
 EXPORT_SYMBOL(dmu_free_long_object);
 EXPORT_SYMBOL(dmu_read);
 EXPORT_SYMBOL(dmu_read_by_dnode);
@@ -2950,6 +3250,12 @@ ZFS_MODULE_PARAM(zfs, zfs_, nopwrite_enabled, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs, zfs_, per_txg_dirty_frees_percent, UINT, ZMOD_RW,
 	"Percentage of dirtied blocks from frees in one TXG");
 
+ZFS_MODULE_PARAM(zfs, zfs_, per_txg_dirty_bg_frees_percent, UINT, ZMOD_RW,
+	"Percentage of dirtied blocks from background frees in one TXG");
+
+ZFS_MODULE_PARAM(zfs, zfs_, bg_free_pressure_pct, UINT, ZMOD_RW,
+	"Pool capacity at which background frees are no longer slowed");
+
 ZFS_MODULE_PARAM(zfs, zfs_, dmu_offset_next_sync, INT, ZMOD_RW,
 	"Enable forcing txg sync to find holes");
 
@@ -43,12 +43,37 @@
 #include <sys/zfs_znode.h>
 #include <sys/zfs_file.h>
 
+/*
+ * Number of threads traversing the meta-dnode of the snapshot in parallel,
+ * each over its own range of objects.  0 or 1 traverses it from a single
+ * thread, as the caller does.
+ */
+static uint_t zfs_diff_threads = 4;
+
+/*
+ * Number of meta-dnode level-0 blocks (32 objects each) in the range of
+ * objects handed to a parallel diff thread at a time.
+ */
+#define	DIFF_CHUNK_BLKS		256
 
 typedef struct dmu_diffarg {
 	zfs_file_t *da_fp;		/* file to which we are reporting */
 	offset_t *da_offp;
 	int da_err;			/* error that stopped diff search */
 	dmu_diff_record_t da_ddr;
+
+	/*
+	 * The parallel diff threads only report the objects from da_first
+	 * to da_last, and hold their records back in da_recs (rather than
+	 * writing them to da_fp) until they can be written in order.
+	 */
+	uint64_t da_first;
+	uint64_t da_last;
+	boolean_t da_range_done;	/* traversal went past da_last */
+	volatile boolean_t *da_cancel;
+	dmu_diff_record_t *da_recs;
+	uint_t da_nrecs;
+	uint_t da_maxrecs;
 } dmu_diffarg_t;
 
 static int
@@ -62,6 +87,26 @@ write_record(dmu_diffarg_t *da)
 		return (0);
 	}
 
+	if (da->da_fp == NULL) {
+		if (da->da_nrecs == da->da_maxrecs) {
+			uint_t maxrecs = MAX(da->da_maxrecs * 2, 64);
+			dmu_diff_record_t *recs =
+			    kmem_alloc(maxrecs * sizeof (*recs), KM_SLEEP);
+
+			if (da->da_recs != NULL) {
+				memcpy(recs, da->da_recs,
+				    da->da_nrecs * sizeof (*recs));
+				kmem_free(da->da_recs,
+				    da->da_maxrecs * sizeof (*recs));
+			}
+			da->da_recs = recs;
+			da->da_maxrecs = maxrecs;
+		}
+		da->da_recs[da->da_nrecs++] = da->da_ddr;
+		da->da_err = 0;
+		return (0);
+	}
+
 	fp = da->da_fp;
 	da->da_err = zfs_file_write(fp, (caddr_t)&da->da_ddr,
 	    sizeof (da->da_ddr), &resid);
@@ -70,14 +115,14 @@ write_record(dmu_diffarg_t *da)
 }
 
 static int
-report_free_dnode_range(dmu_diffarg_t *da, uint64_t first, uint64_t last)
+report_range(dmu_diffarg_t *da, uint64_t type, uint64_t first, uint64_t last)
 {
 	ASSERT(first <= last);
-	if (da->da_ddr.ddr_type != DDR_FREE ||
+	if (da->da_ddr.ddr_type != type ||
 	    first != da->da_ddr.ddr_last + 1) {
 		if (write_record(da) != 0)
 			return (da->da_err);
-		da->da_ddr.ddr_type = DDR_FREE;
+		da->da_ddr.ddr_type = type;
 		da->da_ddr.ddr_first = first;
 		da->da_ddr.ddr_last = last;
 		return (0);
@@ -86,6 +131,17 @@ report_free_dnode_range(dmu_diffarg_t *da, uint64_t first, uint64_t last)
 	return (0);
 }
 
+static int
+report_free_dnode_range(dmu_diffarg_t *da, uint64_t first, uint64_t last)
+{
+	ASSERT(first <= last);
+	first = MAX(first, da->da_first);
+	last = MIN(last, da->da_last);
+	if (first > last)
+		return (0);
+	return (report_range(da, DDR_FREE, first, last));
+}
+
 static int
 report_dnode(dmu_diffarg_t *da, uint64_t object, dnode_phys_t *dnp)
 {
@@ -93,16 +149,7 @@ report_dnode(dmu_diffarg_t *da, uint64_t object, dnode_phys_t *dnp)
 	if (dnp->dn_type == DMU_OT_NONE)
 		return (report_free_dnode_range(da, object, object));
 
-	if (da->da_ddr.ddr_type != DDR_INUSE ||
-	    object != da->da_ddr.ddr_last + 1) {
-		if (write_record(da) != 0)
-			return (da->da_err);
-		da->da_ddr.ddr_type = DDR_INUSE;
-		da->da_ddr.ddr_first = da->da_ddr.ddr_last = object;
-		return (0);
-	}
-	da->da_ddr.ddr_last = object;
-	return (0);
+	return (report_range(da, DDR_INUSE, object, object));
 }
 
 #define	DBP_SPAN(dnp, level)				  \
@@ -115,19 +162,29 @@ diff_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 {
 	(void) zilog;
 	dmu_diffarg_t *da = arg;
+	uint64_t span, dnobj;
 	int err = 0;
 
-	if (issig())
+	if (da->da_cancel != NULL) {
+		if (*da->da_cancel)
+			return (SET_ERROR(EINTR));
+	} else if (issig()) {
 		return (SET_ERROR(EINTR));
+	}
 
 	if (zb->zb_level == ZB_DNODE_LEVEL ||
 	    zb->zb_object != DMU_META_DNODE_OBJECT)
 		return (0);
 
-	if (BP_IS_HOLE(bp)) {
-		uint64_t span = DBP_SPAN(dnp, zb->zb_level);
-		uint64_t dnobj = (zb->zb_blkid * span) >> DNODE_SHIFT;
+	span = DBP_SPAN(dnp, zb->zb_level);
+	dnobj = (zb->zb_blkid * span) >> DNODE_SHIFT;
+	if (dnobj > da->da_last) {
+		/* Everything from here on belongs to a later range. */
+		da->da_range_done = B_TRUE;
+		return (SET_ERROR(EINTR));
+	}
 
+	if (BP_IS_HOLE(bp)) {
 		err = report_free_dnode_range(da, dnobj,
 		    dnobj + (span >> DNODE_SHIFT) - 1);
 		if (err)
@@ -164,6 +221,150 @@ diff_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	return (0);
 }
 
+/*
+ * State shared by dmu_diff_parallel() and its diff_chunk_task()s.
+ */
+typedef struct diff_workers {
+	dsl_dataset_t *dw_ds;
+	uint64_t dw_fromtxg;
+	kmutex_t dw_lock;
+	kcondvar_t dw_cv;
+	volatile boolean_t dw_cancel;
+} diff_workers_t;
+
+typedef struct diff_chunk {
+	diff_workers_t *dc_dw;
+	dmu_diffarg_t dc_da;
+	int dc_err;
+	boolean_t dc_complete;		/* protected by dw_lock */
+	list_node_t dc_node;
+} diff_chunk_t;
+
+static void
+diff_chunk_task(void *arg)
+{
+	diff_chunk_t *dc = arg;
+	diff_workers_t *dw = dc->dc_dw;
+	dmu_diffarg_t *da = &dc->dc_da;
+	zbookmark_phys_t resume;
+	int err;
+
+	SET_BOOKMARK(&resume, dw->dw_ds->ds_object, DMU_META_DNODE_OBJECT, 0,
+	    da->da_first >> (DNODE_BLOCK_SHIFT - DNODE_SHIFT));
+	err = traverse_dataset_resume(dw->dw_ds, dw->dw_fromtxg, &resume,
+	    TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA | TRAVERSE_NO_DECRYPT,
+	    diff_cb, da);
+	if (da->da_range_done)
+		err = 0;
+	if (err == 0)
+		err = write_record(da);
+
+	mutex_enter(&dw->dw_lock);
+	dc->dc_err = err;
+	dc->dc_complete = B_TRUE;
+	cv_broadcast(&dw->dw_cv);
+	mutex_exit(&dw->dw_lock);
+}
+
+static void
+diff_chunk_free(diff_chunk_t *dc)
+{
+	if (dc->dc_da.da_recs != NULL) {
+		kmem_free(dc->dc_da.da_recs,
+		    dc->dc_da.da_maxrecs * sizeof (dmu_diff_record_t));
+	}
+	kmem_free(dc, sizeof (*dc));
+}
+
+/*
+ * Traverse the meta-dnode of tosnap from zfs_diff_threads threads, each
+ * reporting the objects of DIFF_CHUNK_BLKS meta-dnode blocks at a time into
+ * memory.  The records of each range are passed on to da in object order,
+ * as the ranges complete, so only a bounded number of ranges are ever held
+ * in memory.  The last range is left open-ended, so that the records are
+ * the same as those of a single traversal.
+ */
+static int
+dmu_diff_parallel(dsl_dataset_t *tosnap, uint64_t fromtxg, uint64_t nblks,
+    dmu_diffarg_t *da)
+{
+	diff_workers_t dw;
+	diff_chunk_t *dc;
+	list_t chunks;
+	taskq_t *tq;
+	uint64_t next = 0;
+	uint_t inflight = 0;
+	int err = 0;
+
+	dw.dw_ds = tosnap;
+	dw.dw_fromtxg = fromtxg;
+	dw.dw_cancel = B_FALSE;
+	mutex_init(&dw.dw_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&dw.dw_cv, NULL, CV_DEFAULT, NULL);
+	list_create(&chunks, sizeof (diff_chunk_t),
+	    offsetof(diff_chunk_t, dc_node));
+
+	tq = taskq_create("z_diff", zfs_diff_threads, minclsyspri,
+	    zfs_diff_threads, INT_MAX, TASKQ_PREPOPULATE);
+
+	for (;;) {
+		while (next < nblks && inflight < 2 * zfs_diff_threads) {
+			dc = kmem_zalloc(sizeof (*dc), KM_SLEEP);
+			dc->dc_dw = &dw;
+			dc->dc_da.da_ddr.ddr_type = DDR_NONE;
+			dc->dc_da.da_cancel = &dw.dw_cancel;
+			dc->dc_da.da_first =
+			    next << (DNODE_BLOCK_SHIFT - DNODE_SHIFT);
+			next += DIFF_CHUNK_BLKS;
+			dc->dc_da.da_last = (next >= nblks) ? UINT64_MAX :
+			    (next << (DNODE_BLOCK_SHIFT - DNODE_SHIFT)) - 1;
+			list_insert_tail(&chunks, dc);
+			inflight++;
+			VERIFY(taskq_dispatch(tq, diff_chunk_task, dc,
+			    TQ_SLEEP) != TASKQID_INVALID);
+		}
+
+		if ((dc = list_head(&chunks)) == NULL)
+			break;
+
+		mutex_enter(&dw.dw_lock);
+		while (!dc->dc_complete) {
+			(void) cv_wait_sig(&dw.dw_cv, &dw.dw_lock);
+			if (issig()) {
+				err = SET_ERROR(EINTR);
+				break;
+			}
+		}
+		mutex_exit(&dw.dw_lock);
+		if (err != 0)
+			break;
+
+		list_remove(&chunks, dc);
+		inflight--;
+		err = dc->dc_err;
+		for (uint_t i = 0; err == 0 && i < dc->dc_da.da_nrecs; i++) {
+			dmu_diff_record_t *ddr = &dc->dc_da.da_recs[i];
+			err = report_range(da, ddr->ddr_type, ddr->ddr_first,
+			    ddr->ddr_last);
+		}
+		diff_chunk_free(dc);
+		if (err != 0)
+			break;
+	}
+
+	/* On error, stop the ranges still being traversed. */
+	dw.dw_cancel = B_TRUE;
+	taskq_wait(tq);
+	taskq_destroy(tq);
+	while ((dc = list_remove_head(&chunks)) != NULL)
+		diff_chunk_free(dc);
+	list_destroy(&chunks);
+	cv_destroy(&dw.dw_cv);
+	mutex_destroy(&dw.dw_lock);
+
+	return (err);
+}
+
 int
 dmu_diff(const char *tosnap_name, const char *fromsnap_name,
     zfs_file_t *fp, offset_t *offp)
@@ -172,8 +373,10 @@ dmu_diff(const char *tosnap_name, const char *fromsnap_name,
 	dsl_dataset_t *fromsnap;
 	dsl_dataset_t *tosnap;
 	dsl_pool_t *dp;
+	objset_t *os;
 	int error;
 	uint64_t fromtxg;
+	uint64_t nblks = 0;
 
 	if (strchr(tosnap_name, '@') == NULL ||
 	    strchr(fromsnap_name, '@') == NULL)
@@ -206,14 +409,20 @@ dmu_diff(const char *tosnap_name, const char *fromsnap_name,
 	fromtxg = dsl_dataset_phys(fromsnap)->ds_creation_txg;
 	dsl_dataset_rele(fromsnap, FTAG);
 
+	/* Size of the meta-dnode, to split it between the diff threads. */
+	if (zfs_diff_threads > 1 && dmu_objset_from_ds(tosnap, &os) == 0)
+		nblks = DMU_META_DNODE(os)->dn_maxblkid + 1;
+
 	dsl_dataset_long_hold(tosnap, FTAG);
 	dsl_pool_rele(dp, FTAG);
 
+	memset(&da, 0, sizeof (da));
 	da.da_fp = fp;
 	da.da_offp = offp;
 	da.da_ddr.ddr_type = DDR_NONE;
 	da.da_ddr.ddr_first = da.da_ddr.ddr_last = 0;
 	da.da_err = 0;
+	da.da_last = UINT64_MAX;
 
 	/*
 	 * Since zfs diff only looks at dnodes which are stored in plaintext
@@ -223,9 +432,13 @@ dmu_diff(const char *tosnap_name, const char *fromsnap_name,
 	 * dataset isn't mounted and because it will fail when it attempts to
 	 * call the ZFS_IOC_OBJ_TO_STATS ioctl.
 	 */
-	error = traverse_dataset(tosnap, fromtxg,
-	    TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA | TRAVERSE_NO_DECRYPT,
-	    diff_cb, &da);
+	if (nblks > DIFF_CHUNK_BLKS) {
+		error = dmu_diff_parallel(tosnap, fromtxg, nblks, &da);
+	} else {
+		error = traverse_dataset(tosnap, fromtxg,
+		    TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA |
+		    TRAVERSE_NO_DECRYPT, diff_cb, &da);
+	}
 
 	if (error != 0) {
 		da.da_err = error;
@@ -239,3 +452,6 @@ dmu_diff(const char *tosnap_name, const char *fromsnap_name,
 
 	return (da.da_err);
 }
+
+ZFS_MODULE_PARAM(zfs, zfs_, diff_threads, UINT, ZMOD_RW,
+	"Number of threads traversing a snapshot for zfs diff");
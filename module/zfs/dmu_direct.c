@@ -245,9 +245,15 @@ dmu_write_abd(dnode_t *dn, uint64_t offset, uint64_t size,
 	return (err);
 }
 
+/*
+ * Issue the Direct I/O reads of the given range as children of rio, without
+ * waiting for them.  Blocks that are holes or cached are copied right away.
+ * The data abd must stay valid until rio completes.  On error some reads
+ * may still have been issued, so rio must be waited for or issued anyway.
+ */
 int
-dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
-    abd_t *data, dmu_flags_t flags)
+dmu_read_abd_nowait(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_flags_t flags, zio_t *rio)
 {
 	objset_t *os = dn->dn_objset;
 	spa_t *spa = os->os_spa;
@@ -261,8 +267,6 @@ dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
 	if (err)
 		return (err);
 
-	zio_t *rio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
-
 	for (int i = 0; i < numbufs; i++) {
 		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
 		abd_t *mbuf;
@@ -284,7 +288,7 @@ dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
 		err = dmu_buf_get_bp_from_dbuf(db, &bp);
 		if (err) {
 			mutex_exit(&db->db_mtx);
-			goto error;
+			break;
 		}
 
 		/*
@@ -341,14 +345,21 @@ dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
 
 	dmu_buf_rele_array(dbp, numbufs, FTAG);
 
-	return (zio_wait(rio));
-
-error:
-	dmu_buf_rele_array(dbp, numbufs, FTAG);
-	(void) zio_wait(rio);
 	return (err);
 }
 
+int
+dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_flags_t flags)
+{
+	zio_t *rio = zio_root(dn->dn_objset->os_spa, NULL, NULL,
+	    ZIO_FLAG_CANFAIL);
+	int err = dmu_read_abd_nowait(dn, offset, size, data, flags, rio);
+	int zerr = zio_wait(rio);
+
+	return (err != 0 ? err : zerr);
+}
+
 #ifdef _KERNEL
 int
 dmu_read_uio_direct(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
@@ -396,4 +407,5 @@ dmu_write_uio_direct(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
 #endif /* _KERNEL */
 
 EXPORT_SYMBOL(dmu_read_abd);
+EXPORT_SYMBOL(dmu_read_abd_nowait);
 EXPORT_SYMBOL(dmu_write_abd);
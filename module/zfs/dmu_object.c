@@ -44,6 +44,16 @@
  */
 uint_t dmu_object_alloc_chunk_shift = 7;
 
+/*
+ * When the global allocator lock is found contended, the run of dnode
+ * slots reserved for each CPU is doubled, up to
+ * 2^dmu_object_alloc_chunk_shift_max slots (32 blocks by default), so that
+ * parallel creates go back to the lock less often and each CPU keeps
+ * filling its own dnode blocks.  An uncontended reservation halves it
+ * again.
+ */
+uint_t dmu_object_alloc_chunk_shift_max = 10;
+
 static uint64_t
 dmu_object_alloc_impl(objset_t *os, dmu_object_type_t ot, int blocksize,
     int indirect_blockshift, dmu_object_type_t bonustype, int bonuslen,
@@ -52,15 +62,20 @@ dmu_object_alloc_impl(objset_t *os, dmu_object_type_t ot, int blocksize,
 	uint64_t object;
 	uint64_t L1_dnode_count = DNODES_PER_BLOCK <<
 	    (DMU_META_DNODE(os)->dn_indblkshift - SPA_BLKPTRSHIFT);
+	uint_t L1_dnode_shift = DNODES_PER_BLOCK_SHIFT +
+	    DMU_META_DNODE(os)->dn_indblkshift - SPA_BLKPTRSHIFT;
 	dnode_t *dn = NULL;
 	int dn_slots = dnodesize >> DNODE_SHIFT;
 	boolean_t restarted = B_FALSE;
 	uint64_t *cpuobj = NULL;
-	uint_t dnodes_per_chunk = 1 << dmu_object_alloc_chunk_shift;
+	uint64_t *cpuend = NULL;
+	uint_t chunk_shift, chunk_shift_min, chunk_shift_max;
+	uint64_t dnodes_per_chunk;
 	int error;
 
-	cpuobj = &os->os_obj_next_percpu[CPU_SEQID_UNSTABLE %
-	    os->os_obj_next_percpu_len];
+	uint_t cpu = CPU_SEQID_UNSTABLE % os->os_obj_next_percpu_len;
+	cpuobj = &os->os_obj_next_percpu[cpu];
+	cpuend = &os->os_obj_end_percpu[cpu];
 
 	if (dn_slots == 0) {
 		dn_slots = DNODE_MIN_SLOTS;
@@ -76,10 +91,10 @@ dmu_object_alloc_impl(objset_t *os, dmu_object_type_t ot, int blocksize,
 	 * worth, so that the "rescan after polishing off a L1's worth"
 	 * logic below will be sure to kick in.
 	 */
-	if (dnodes_per_chunk < DNODES_PER_BLOCK)
-		dnodes_per_chunk = DNODES_PER_BLOCK;
-	if (dnodes_per_chunk > L1_dnode_count)
-		dnodes_per_chunk = L1_dnode_count;
+	chunk_shift_min = MIN(MAX(dmu_object_alloc_chunk_shift,
+	    DNODES_PER_BLOCK_SHIFT), L1_dnode_shift);
+	chunk_shift_max = MIN(MAX(dmu_object_alloc_chunk_shift_max,
+	    chunk_shift_min), L1_dnode_shift);
 
 	/*
 	 * The caller requested the dnode be returned as a performance
@@ -97,17 +112,32 @@ dmu_object_alloc_impl(objset_t *os, dmu_object_type_t ot, int blocksize,
 	object = *cpuobj;
 	for (;;) {
 		/*
-		 * If we finished a chunk of dnodes, get a new one from
-		 * the global allocator.
+		 * If we finished the chunk of dnodes reserved for this CPU,
+		 * or the object would not fit in it, get a new one from the
+		 * global allocator.
 		 */
-		if ((P2PHASE(object, dnodes_per_chunk) == 0) ||
-		    (P2PHASE(object + dn_slots - 1, dnodes_per_chunk) <
-		    dn_slots)) {
+		if (object + dn_slots > atomic_load_64(cpuend)) {
 			DNODE_STAT_BUMP(dnode_alloc_next_chunk);
-			mutex_enter(&os->os_obj_lock);
-			ASSERT0(P2PHASE(os->os_obj_next_chunk,
-			    dnodes_per_chunk));
-			object = os->os_obj_next_chunk;
+			boolean_t contended = !mutex_tryenter(&os->os_obj_lock);
+			if (contended)
+				mutex_enter(&os->os_obj_lock);
+
+			chunk_shift = MIN(MAX(os->os_obj_chunk_shift,
+			    chunk_shift_min), chunk_shift_max);
+			if (contended && chunk_shift < chunk_shift_max)
+				chunk_shift++;
+			else if (!contended && chunk_shift > chunk_shift_min)
+				chunk_shift--;
+			os->os_obj_chunk_shift = chunk_shift;
+			dnodes_per_chunk = 1ULL << chunk_shift;
+
+			/*
+			 * Chunks are handed out aligned to their size; after
+			 * the size grew the next one starts at the following
+			 * suitably aligned boundary.
+			 */
+			object = P2ROUNDUP_TYPED(os->os_obj_next_chunk,
+			    dnodes_per_chunk, uint64_t);
 
 			/*
 			 * Each time we polish off a L1 bp worth of dnodes
@@ -163,6 +193,7 @@ dmu_object_alloc_impl(objset_t *os, dmu_object_type_t ot, int blocksize,
 			os->os_obj_next_chunk =
 			    P2ALIGN_TYPED(object, dnodes_per_chunk, uint64_t) +
 			    dnodes_per_chunk;
+			(void) atomic_swap_64(cpuend, os->os_obj_next_chunk);
 			(void) atomic_swap_64(cpuobj, object);
 			mutex_exit(&os->os_obj_lock);
 		}
@@ -522,3 +553,6 @@ EXPORT_SYMBOL(dmu_object_free_zapified);
 
 ZFS_MODULE_PARAM(zfs, , dmu_object_alloc_chunk_shift, UINT, ZMOD_RW,
 	"CPU-specific allocator grabs 2^N objects at once");
+
+ZFS_MODULE_PARAM(zfs, , dmu_object_alloc_chunk_shift_max, UINT, ZMOD_RW,
+	"CPU-specific allocator grabs at most 2^N objects under contention");
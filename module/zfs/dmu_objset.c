@@ -280,6 +280,66 @@ prefetch_changed_cb(void *arg, uint64_t newval)
 	os->os_prefetch = newval;
 }
 
+static void
+arc_priority_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	/*
+	 * Inheritance and range checking should have been done by now.
+	 */
+	ASSERT(newval == ZFS_ARC_PRIORITY_NORMAL ||
+	    newval == ZFS_ARC_PRIORITY_LOW);
+
+	os->os_arc_priority = newval;
+}
+
+static void
+qos_read_bw_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	zfs_qos_set_limit(&os->os_qos, ZFS_QOS_READ_BW, newval);
+}
+
+static void
+qos_write_bw_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	zfs_qos_set_limit(&os->os_qos, ZFS_QOS_WRITE_BW, newval);
+}
+
+static void
+qos_read_iops_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	zfs_qos_set_limit(&os->os_qos, ZFS_QOS_READ_IOPS, newval);
+}
+
+static void
+qos_write_iops_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	zfs_qos_set_limit(&os->os_qos, ZFS_QOS_WRITE_IOPS, newval);
+}
+
+static void
+qos_weight_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	/*
+	 * Inheritance and range checking should have been done by now.
+	 */
+	ASSERT3U(newval, >=, ZFS_QOS_WEIGHT_MIN);
+	ASSERT3U(newval, <=, ZFS_QOS_WEIGHT_MAX);
+
+	os->os_qos.zq_weight = newval;
+}
+
 static void
 sync_changed_cb(void *arg, uint64_t newval)
 {
@@ -584,6 +644,11 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 			    zfs_prop_to_name(ZFS_PROP_PREFETCH),
 			    prefetch_changed_cb, os);
 		}
+		if (err == 0) {
+			err = dsl_prop_register(ds,
+			    zfs_prop_to_name(ZFS_PROP_ARCPRIORITY),
+			    arc_priority_changed_cb, os);
+		}
 		if (!ds->ds_is_snapshot) {
 			if (err == 0) {
 				err = dsl_prop_register(ds,
@@ -642,6 +707,31 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 				    zfs_prop_to_name(ZFS_PROP_DIRECT),
 				    direct_changed_cb, os);
 			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_QOS_READ_BW),
+				    qos_read_bw_changed_cb, os);
+			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_QOS_WRITE_BW),
+				    qos_write_bw_changed_cb, os);
+			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_QOS_READ_IOPS),
+				    qos_read_iops_changed_cb, os);
+			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_QOS_WRITE_IOPS),
+				    qos_write_iops_changed_cb, os);
+			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_QOS_WEIGHT),
+				    qos_weight_changed_cb, os);
+			}
 		}
 		if (err != 0) {
 			arc_buf_destroy(os->os_phys_buf, &os->os_phys_buf);
@@ -663,7 +753,10 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 		os->os_secondary_cache = ZFS_CACHE_ALL;
 		os->os_dnodesize = DNODE_MIN_SIZE;
 		os->os_prefetch = ZFS_PREFETCH_ALL;
+		os->os_arc_priority = ZFS_ARC_PRIORITY_NORMAL;
 	}
+	if (os->os_qos.zq_weight == 0)
+		os->os_qos.zq_weight = ZFS_QOS_WEIGHT_DEFAULT;
 
 	if (ds == NULL || !ds->ds_is_snapshot)
 		os->os_zil_header = os->os_phys->os_zil_header;
@@ -688,6 +781,8 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 	os->os_obj_next_percpu_len = boot_ncpus;
 	os->os_obj_next_percpu = kmem_zalloc(os->os_obj_next_percpu_len *
 	    sizeof (os->os_obj_next_percpu[0]), KM_SLEEP);
+	os->os_obj_end_percpu = kmem_zalloc(os->os_obj_next_percpu_len *
+	    sizeof (os->os_obj_end_percpu[0]), KM_SLEEP);
 
 	dnode_special_open(os, &os->os_phys->os_meta_dnode,
 	    DMU_META_DNODE_OBJECT, &os->os_meta_dnode);
@@ -703,6 +798,8 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 	}
 
 	mutex_init(&os->os_upgrade_lock, NULL, MUTEX_DEFAULT, NULL);
+	zfs_qos_init(&os->os_qos);
+	dbuf_stats_objset_init(os);
 
 	*osp = os;
 	return (0);
@@ -1058,14 +1155,18 @@ dmu_objset_evict_done(objset_t *os)
 
 	kmem_free(os->os_obj_next_percpu,
 	    os->os_obj_next_percpu_len * sizeof (os->os_obj_next_percpu[0]));
+	kmem_free(os->os_obj_end_percpu,
+	    os->os_obj_next_percpu_len * sizeof (os->os_obj_end_percpu[0]));
 
 	mutex_destroy(&os->os_lock);
 	mutex_destroy(&os->os_userused_lock);
 	mutex_destroy(&os->os_obj_lock);
 	mutex_destroy(&os->os_user_ptr_lock);
 	mutex_destroy(&os->os_upgrade_lock);
+	zfs_qos_fini(&os->os_qos);
 	for (int i = 0; i < TXG_SIZE; i++)
 		multilist_destroy(&os->os_dirty_dnodes[i]);
+	dbuf_stats_objset_destroy(os);
 	spa_evicting_os_deregister(os->os_spa, os);
 	kmem_free(os, sizeof (objset_t));
 }
@@ -1076,6 +1177,12 @@ dmu_objset_snap_cmtime(objset_t *os)
 	return (dsl_dir_snap_cmtime(os->os_dsl_dataset->ds_dir));
 }
 
+uint64_t
+dmu_objset_snap_gen(objset_t *os)
+{
+	return (dsl_dir_snap_gen(os->os_dsl_dataset->ds_dir));
+}
+
 objset_t *
 dmu_objset_create_impl_dnstats(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
     dmu_objset_type_t type, int levels, int blksz, int ibs, dmu_tx_t *tx)
@@ -1573,11 +1680,19 @@ dmu_objset_upgrade_stop(objset_t *os)
 	}
 }
 
+/*
+ * Sync the dirty dnodes of one sublist.  The sublist lock is only held
+ * while taking a dnode off the list, so several threads may drain the
+ * same sublist concurrently.
+ */
 static void
-dmu_objset_sync_dnodes(multilist_sublist_t *list, dmu_tx_t *tx)
+dmu_objset_sync_dnodes(multilist_t *ml, int sublist_idx, dmu_tx_t *tx)
 {
+	multilist_sublist_t *list;
 	dnode_t *dn;
 
+	list = multilist_sublist_lock_idx(ml, sublist_idx);
+
 	while ((dn = multilist_sublist_head(list)) != NULL) {
 		ASSERT(dn->dn_object != DMU_META_DNODE_OBJECT);
 		ASSERT(dn->dn_dbuf->db_data_pending);
@@ -1590,6 +1705,7 @@ dmu_objset_sync_dnodes(multilist_sublist_t *list, dmu_tx_t *tx)
 
 		ASSERT3U(dn->dn_nlevels, <=, DN_MAX_LEVELS);
 		multilist_sublist_remove(list, dn);
+		multilist_sublist_unlock(list);
 
 		/*
 		 * See the comment above dnode_rele_task() for an explanation
@@ -1601,7 +1717,10 @@ dmu_objset_sync_dnodes(multilist_sublist_t *list, dmu_tx_t *tx)
 		multilist_insert(newlist, dn);
 
 		dnode_sync(dn, tx);
+
+		list = multilist_sublist_lock_idx(ml, sublist_idx);
 	}
+	multilist_sublist_unlock(list);
 }
 
 static void
@@ -1680,13 +1799,19 @@ sync_dnodes_task(void *arg)
 	sync_objset_arg_t *soa = sda->sda_soa;
 	objset_t *os = soa->soa_os;
 
-	uint_t allocator = spa_acq_allocator(os->os_spa);
-	multilist_sublist_t *ms =
-	    multilist_sublist_lock_idx(sda->sda_list, sda->sda_sublist_idx);
+	multilist_t *ml = sda->sda_list;
+	int num_sublists = multilist_get_num_sublists(ml);
 
-	dmu_objset_sync_dnodes(ms, soa->soa_tx);
-
-	multilist_sublist_unlock(ms);
+	/*
+	 * Drain our own sublist first, then help with the others so that
+	 * a few crowded sublists do not leave the remaining sync threads
+	 * idle.
+	 */
+	uint_t allocator = spa_acq_allocator(os->os_spa);
+	for (int i = 0; i < num_sublists; i++) {
+		dmu_objset_sync_dnodes(ml,
+		    (sda->sda_sublist_idx + i) % num_sublists, soa->soa_tx);
+	}
 	spa_rel_allocator(os->os_spa, allocator);
 
 	kmem_free(sda, sizeof (*sda));
@@ -1958,52 +2083,89 @@ userquota_compare(const void *l, const void *r)
 }
 
 static void
-do_userquota_cacheflush(objset_t *os, userquota_cache_t *cache, dmu_tx_t *tx)
+userquota_cache_create(objset_t *os, userquota_cache_t *cache)
+{
+	avl_create(&cache->uqc_user_deltas, userquota_compare,
+	    sizeof (userquota_node_t), offsetof(userquota_node_t, uqn_node));
+	avl_create(&cache->uqc_group_deltas, userquota_compare,
+	    sizeof (userquota_node_t), offsetof(userquota_node_t, uqn_node));
+	if (dmu_objset_projectquota_enabled(os))
+		avl_create(&cache->uqc_project_deltas, userquota_compare,
+		    sizeof (userquota_node_t), offsetof(userquota_node_t,
+		    uqn_node));
+}
+
+/*
+ * Move the deltas of src into dst, summing those of ids present in both.
+ * src is destroyed.
+ */
+static void
+userquota_cache_merge(avl_tree_t *dst, avl_tree_t *src)
+{
+	void *cookie = NULL;
+	userquota_node_t *uqn, *found;
+	avl_index_t idx;
+
+	while ((uqn = avl_destroy_nodes(src, &cookie)) != NULL) {
+		found = avl_find(dst, uqn, &idx);
+		if (found != NULL) {
+			found->uqn_delta += uqn->uqn_delta;
+			kmem_free(uqn, sizeof (*uqn));
+		} else {
+			avl_insert(dst, uqn, idx);
+		}
+	}
+	avl_destroy(src);
+}
+
+static void
+userquota_flush_deltas(objset_t *os, uint64_t zapobj, avl_tree_t *avl,
+    dmu_tx_t *tx)
 {
-	void *cookie;
+	void *cookie = NULL;
 	userquota_node_t *uqn;
 
-	ASSERT(dmu_tx_is_syncing(tx));
+	/*
+	 * Issue the reads of all the leaves we are about to modify before
+	 * the first update, so that they are not read one at a time.
+	 */
+	for (uqn = avl_first(avl); uqn != NULL; uqn = AVL_NEXT(avl, uqn)) {
+		if (uqn->uqn_delta != 0)
+			(void) zap_prefetch(os, zapobj, uqn->uqn_id);
+	}
 
-	cookie = NULL;
-	while ((uqn = avl_destroy_nodes(&cache->uqc_user_deltas,
-	    &cookie)) != NULL) {
-		/*
-		 * os_userused_lock protects against concurrent calls to
-		 * zap_increment_int().  It's needed because zap_increment_int()
-		 * is not thread-safe (i.e. not atomic).
-		 */
-		mutex_enter(&os->os_userused_lock);
-		VERIFY0(zap_increment(os, DMU_USERUSED_OBJECT,
-		    uqn->uqn_id, uqn->uqn_delta, tx));
-		mutex_exit(&os->os_userused_lock);
-		kmem_free(uqn, sizeof (*uqn));
+	for (uqn = avl_first(avl); uqn != NULL; uqn = AVL_NEXT(avl, uqn)) {
+		if (uqn->uqn_delta != 0) {
+			VERIFY0(zap_increment(os, zapobj, uqn->uqn_id,
+			    uqn->uqn_delta, tx));
+		}
 	}
-	avl_destroy(&cache->uqc_user_deltas);
 
-	cookie = NULL;
-	while ((uqn = avl_destroy_nodes(&cache->uqc_group_deltas,
-	    &cookie)) != NULL) {
-		mutex_enter(&os->os_userused_lock);
-		VERIFY0(zap_increment(os, DMU_GROUPUSED_OBJECT,
-		    uqn->uqn_id, uqn->uqn_delta, tx));
-		mutex_exit(&os->os_userused_lock);
+	while ((uqn = avl_destroy_nodes(avl, &cookie)) != NULL)
 		kmem_free(uqn, sizeof (*uqn));
-	}
-	avl_destroy(&cache->uqc_group_deltas);
+	avl_destroy(avl);
+}
+
+static void
+do_userquota_cacheflush(objset_t *os, userquota_cache_t *cache, dmu_tx_t *tx)
+{
+	ASSERT(dmu_tx_is_syncing(tx));
 
+	/*
+	 * os_userused_lock protects against concurrent calls to
+	 * zap_increment().  It's needed because zap_increment() is
+	 * not thread-safe (i.e. not atomic).
+	 */
+	mutex_enter(&os->os_userused_lock);
+	userquota_flush_deltas(os, DMU_USERUSED_OBJECT,
+	    &cache->uqc_user_deltas, tx);
+	userquota_flush_deltas(os, DMU_GROUPUSED_OBJECT,
+	    &cache->uqc_group_deltas, tx);
 	if (dmu_objset_projectquota_enabled(os)) {
-		cookie = NULL;
-		while ((uqn = avl_destroy_nodes(&cache->uqc_project_deltas,
-		    &cookie)) != NULL) {
-			mutex_enter(&os->os_userused_lock);
-			VERIFY0(zap_increment(os, DMU_PROJECTUSED_OBJECT,
-			    uqn->uqn_id, uqn->uqn_delta, tx));
-			mutex_exit(&os->os_userused_lock);
-			kmem_free(uqn, sizeof (*uqn));
-		}
-		avl_destroy(&cache->uqc_project_deltas);
+		userquota_flush_deltas(os, DMU_PROJECTUSED_OBJECT,
+		    &cache->uqc_project_deltas, tx);
 	}
+	mutex_exit(&os->os_userused_lock);
 }
 
 static void
@@ -2079,10 +2241,22 @@ do_userobjquota_update(objset_t *os, userquota_cache_t *cache, uint64_t flags,
 	}
 }
 
+/*
+ * The deltas of all the userquota_updates_task()s of an objset are merged
+ * here, and written out once by the last task to finish, so that each id
+ * is updated at most once per txg no matter how many sublists it is seen in.
+ */
+typedef struct userquota_merge {
+	userquota_cache_t uqm_cache;
+	/* Tasks yet to merge their deltas, protected by os_userused_lock */
+	int uqm_pending;
+} userquota_merge_t;
+
 typedef struct userquota_updates_arg {
 	objset_t *uua_os;
 	int uua_sublist_idx;
 	dmu_tx_t *uua_tx;
+	userquota_merge_t *uua_merge;
 } userquota_updates_arg_t;
 
 static void
@@ -2092,21 +2266,16 @@ userquota_updates_task(void *arg)
 	objset_t *os = uua->uua_os;
 	dmu_tx_t *tx = uua->uua_tx;
 	dnode_t *dn;
+	userquota_merge_t *uqm = uua->uua_merge;
 	userquota_cache_t cache = { { 0 } };
+	boolean_t last;
 
 	multilist_sublist_t *list = multilist_sublist_lock_idx(
 	    &os->os_synced_dnodes, uua->uua_sublist_idx);
 
 	ASSERT(multilist_sublist_head(list) == NULL ||
 	    dmu_objset_userused_enabled(os));
-	avl_create(&cache.uqc_user_deltas, userquota_compare,
-	    sizeof (userquota_node_t), offsetof(userquota_node_t, uqn_node));
-	avl_create(&cache.uqc_group_deltas, userquota_compare,
-	    sizeof (userquota_node_t), offsetof(userquota_node_t, uqn_node));
-	if (dmu_objset_projectquota_enabled(os))
-		avl_create(&cache.uqc_project_deltas, userquota_compare,
-		    sizeof (userquota_node_t), offsetof(userquota_node_t,
-		    uqn_node));
+	userquota_cache_create(os, &cache);
 
 	while ((dn = multilist_sublist_head(list)) != NULL) {
 		int flags;
@@ -2154,8 +2323,24 @@ userquota_updates_task(void *arg)
 		multilist_sublist_remove(list, dn);
 		dnode_rele(dn, &os->os_synced_dnodes);
 	}
-	do_userquota_cacheflush(os, &cache, tx);
 	multilist_sublist_unlock(list);
+
+	mutex_enter(&os->os_userused_lock);
+	userquota_cache_merge(&uqm->uqm_cache.uqc_user_deltas,
+	    &cache.uqc_user_deltas);
+	userquota_cache_merge(&uqm->uqm_cache.uqc_group_deltas,
+	    &cache.uqc_group_deltas);
+	if (dmu_objset_projectquota_enabled(os)) {
+		userquota_cache_merge(&uqm->uqm_cache.uqc_project_deltas,
+		    &cache.uqc_project_deltas);
+	}
+	last = (--uqm->uqm_pending == 0);
+	mutex_exit(&os->os_userused_lock);
+
+	if (last) {
+		do_userquota_cacheflush(os, &uqm->uqm_cache, tx);
+		kmem_free(uqm, sizeof (*uqm));
+	}
 	kmem_free(uua, sizeof (*uua));
 }
 
@@ -2238,14 +2423,21 @@ void
 dmu_objset_sync_done(objset_t *os, dmu_tx_t *tx)
 {
 	boolean_t need_userquota = dmu_objset_do_userquota_updates_prep(os, tx);
+	userquota_merge_t *uqm = NULL;
 
 	int num_sublists = multilist_get_num_sublists(&os->os_synced_dnodes);
+	if (need_userquota) {
+		uqm = kmem_zalloc(sizeof (*uqm), KM_SLEEP);
+		userquota_cache_create(os, &uqm->uqm_cache);
+		uqm->uqm_pending = num_sublists;
+	}
 	for (int i = 0; i < num_sublists; i++) {
 		userquota_updates_arg_t *uua =
 		    kmem_alloc(sizeof (*uua), KM_SLEEP);
 		uua->uua_os = os;
 		uua->uua_sublist_idx = i;
 		uua->uua_tx = tx;
+		uua->uua_merge = uqm;
 
 		/*
 		 * If we don't need to update userquotas, use
@@ -3146,6 +3338,7 @@ dmu_objset_willuse_space(objset_t *os, int64_t space, dmu_tx_t *tx)
 
 	if (ds != NULL) {
 		dsl_dir_willuse_space(ds->ds_dir, aspace, tx);
+		dsl_dir_dirty_space(ds->ds_dir, space, tx);
 	}
 
 	dsl_pool_dirty_space(dmu_tx_pool(tx), space, tx);
@@ -3175,6 +3368,7 @@ EXPORT_SYMBOL(dmu_objset_find);
 EXPORT_SYMBOL(dmu_objset_byteswap);
 EXPORT_SYMBOL(dmu_objset_evict_dbufs);
 EXPORT_SYMBOL(dmu_objset_snap_cmtime);
+EXPORT_SYMBOL(dmu_objset_snap_gen);
 EXPORT_SYMBOL(dmu_objset_dnodesize);
 
 EXPORT_SYMBOL(dmu_objset_sync);
@@ -75,6 +75,13 @@ static uint_t zfs_recv_queue_length = SPA_MAXBLOCKSIZE;
 static uint_t zfs_recv_queue_ff = 20;
 static uint_t zfs_recv_write_batch_size = 1024 * 1024;
 static int zfs_recv_best_effort_corrective = 0;
+/*
+ * Number of threads that apply batches of WRITE records of a receive in
+ * parallel.  Only used for receives that are neither resumable nor
+ * corrective, since the resume state requires records to be applied in
+ * stream order.  0 applies all records from the receive writer thread.
+ */
+static uint_t zfs_recv_write_threads = 0;
 
 static const void *const dmu_recv_tag = "dmu_recv_tag";
 const char *const recv_clone_name = "%recv";
@@ -129,6 +136,18 @@ struct receive_writer_arg {
 
 	list_t write_batch;
 
+	/*
+	 * Write batches being applied by write_tq, and the number of them.
+	 * A record that touches an object must wait for the in-flight
+	 * batches of that object; see receive_write_batch_wait().
+	 */
+	taskq_t *write_tq;
+	kmutex_t inflight_lock;
+	kcondvar_t inflight_cv;
+	list_t inflight;
+	uint_t inflight_count;
+	uint_t inflight_max;
+
 	/* Encryption parameters for the last received DRR_OBJECT_RANGE */
 	boolean_t or_crypt_params_present;
 	uint64_t or_firstobj;
@@ -143,6 +162,13 @@ struct receive_writer_arg {
 	or_need_sync_t or_need_sync;
 };
 
+struct receive_write_batch {
+	struct receive_writer_arg *rwb_rwa;
+	uint64_t rwb_object;
+	list_t rwb_records;
+	list_node_t rwb_node;
+};
+
 typedef struct dmu_recv_begin_arg {
 	const char *drba_origin;
 	dmu_recv_cookie_t *drba_cookie;
@@ -614,6 +640,13 @@ recv_begin_check_feature_flags_impl(uint64_t featureflags, spa_t *spa)
 	    !spa_feature_is_enabled(spa, SPA_FEATURE_LONGNAME))
 		return (SET_ERROR(ENOTSUP));
 
+	/*
+	 * Files with inline data can only be read with the feature enabled.
+	 */
+	if ((featureflags & DMU_BACKUP_FEATURE_INLINE_DATA) &&
+	    !spa_feature_is_enabled(spa, SPA_FEATURE_INLINE_DATA))
+		return (SET_ERROR(ENOTSUP));
+
 	return (0);
 }
 
@@ -1028,6 +1061,16 @@ dmu_recv_begin_sync(void *arg, dmu_tx_t *tx)
 		newds->ds_feature[SPA_FEATURE_LONGNAME] = (void *)B_TRUE;
 	}
 
+	/*
+	 * Activate inline_data feature if received
+	 */
+	if (featureflags & DMU_BACKUP_FEATURE_INLINE_DATA &&
+	    !dsl_dataset_feature_is_active(newds, SPA_FEATURE_INLINE_DATA)) {
+		dsl_dataset_activate_feature(newds->ds_object,
+		    SPA_FEATURE_INLINE_DATA, (void *)B_TRUE, tx);
+		newds->ds_feature[SPA_FEATURE_INLINE_DATA] = (void *)B_TRUE;
+	}
+
 	/*
 	 * If we actually created a non-clone, we need to create the objset
 	 * in our new dataset. If this is a raw send we postpone this until
@@ -2214,25 +2257,22 @@ receive_freeobjects(struct receive_writer_arg *rwa,
 
 /*
  * Note: if this fails, the caller will clean up any records left on the
- * rwa->write_batch list.
+ * batch list.
  */
 static int
-flush_write_batch_impl(struct receive_writer_arg *rwa)
+flush_write_batch_impl(struct receive_writer_arg *rwa, list_t *batch)
 {
 	dnode_t *dn;
 	int err;
 
-	if (dnode_hold(rwa->os, rwa->last_object, FTAG, &dn) != 0)
-		return (SET_ERROR(EINVAL));
-
-	struct receive_record_arg *last_rrd = list_tail(&rwa->write_batch);
+	struct receive_record_arg *last_rrd = list_tail(batch);
 	struct drr_write *last_drrw = &last_rrd->header.drr_u.drr_write;
 
-	struct receive_record_arg *first_rrd = list_head(&rwa->write_batch);
+	struct receive_record_arg *first_rrd = list_head(batch);
 	struct drr_write *first_drrw = &first_rrd->header.drr_u.drr_write;
 
-	ASSERT3U(rwa->last_object, ==, last_drrw->drr_object);
-	ASSERT3U(rwa->last_offset, ==, last_drrw->drr_offset);
+	if (dnode_hold(rwa->os, first_drrw->drr_object, FTAG, &dn) != 0)
+		return (SET_ERROR(EINVAL));
 
 	dmu_tx_t *tx = dmu_tx_create(rwa->os);
 	dmu_tx_hold_write_by_dnode(tx, dn, first_drrw->drr_offset,
@@ -2246,11 +2286,11 @@ flush_write_batch_impl(struct receive_writer_arg *rwa)
 	}
 
 	struct receive_record_arg *rrd;
-	while ((rrd = list_head(&rwa->write_batch)) != NULL) {
+	while ((rrd = list_head(batch)) != NULL) {
 		struct drr_write *drrw = &rrd->header.drr_u.drr_write;
 		abd_t *abd = rrd->abd;
 
-		ASSERT3U(drrw->drr_object, ==, rwa->last_object);
+		ASSERT3U(drrw->drr_object, ==, first_drrw->drr_object);
 
 		if (drrw->drr_logical_size != dn->dn_datablksz) {
 			/*
@@ -2367,7 +2407,7 @@ flush_write_batch_impl(struct receive_writer_arg *rwa)
 		 */
 		save_resume_state(rwa, drrw->drr_object, drrw->drr_offset, tx);
 
-		list_remove(&rwa->write_batch, rrd);
+		list_remove(batch, rrd);
 		kmem_free(rrd, sizeof (*rrd));
 	}
 
@@ -2376,21 +2416,101 @@ flush_write_batch_impl(struct receive_writer_arg *rwa)
 	return (err);
 }
 
+static void
+free_write_batch(list_t *batch)
+{
+	struct receive_record_arg *rrd;
+	while ((rrd = list_remove_head(batch)) != NULL) {
+		abd_free(rrd->abd);
+		kmem_free(rrd, sizeof (*rrd));
+	}
+}
+
+/*
+ * Wait until no batch writing to an object in [first, last] is in flight.
+ */
+static void
+receive_write_batch_wait(struct receive_writer_arg *rwa, uint64_t first,
+    uint64_t last)
+{
+	struct receive_write_batch *rwb;
+
+	if (rwa->write_tq == NULL)
+		return;
+
+	mutex_enter(&rwa->inflight_lock);
+	for (rwb = list_head(&rwa->inflight); rwb != NULL; ) {
+		if (rwb->rwb_object >= first && rwb->rwb_object <= last) {
+			cv_wait(&rwa->inflight_cv, &rwa->inflight_lock);
+			rwb = list_head(&rwa->inflight);
+		} else {
+			rwb = list_next(&rwa->inflight, rwb);
+		}
+	}
+	mutex_exit(&rwa->inflight_lock);
+}
+
+static void
+receive_write_batch_task(void *arg)
+{
+	struct receive_write_batch *rwb = arg;
+	struct receive_writer_arg *rwa = rwb->rwb_rwa;
+
+	int err = flush_write_batch_impl(rwa, &rwb->rwb_records);
+	free_write_batch(&rwb->rwb_records);
+
+	mutex_enter(&rwa->inflight_lock);
+	if (err != 0 && rwa->err == 0)
+		rwa->err = err;
+	list_remove(&rwa->inflight, rwb);
+	rwa->inflight_count--;
+	cv_broadcast(&rwa->inflight_cv);
+	mutex_exit(&rwa->inflight_lock);
+
+	list_destroy(&rwb->rwb_records);
+	kmem_free(rwb, sizeof (*rwb));
+}
+
+/*
+ * Hand the current write batch to write_tq.  The number of batches in
+ * flight is bounded so that their payloads can not use more memory than
+ * a few times the receive queue.
+ */
+static void
+receive_write_batch_dispatch(struct receive_writer_arg *rwa)
+{
+	struct receive_write_batch *rwb = kmem_alloc(sizeof (*rwb), KM_SLEEP);
+	rwb->rwb_rwa = rwa;
+	rwb->rwb_object = rwa->last_object;
+	list_create(&rwb->rwb_records, sizeof (struct receive_record_arg),
+	    offsetof(struct receive_record_arg, node.bqn_node));
+	list_move_tail(&rwb->rwb_records, &rwa->write_batch);
+
+	mutex_enter(&rwa->inflight_lock);
+	while (rwa->inflight_count >= rwa->inflight_max)
+		cv_wait(&rwa->inflight_cv, &rwa->inflight_lock);
+	list_insert_tail(&rwa->inflight, rwb);
+	rwa->inflight_count++;
+	mutex_exit(&rwa->inflight_lock);
+
+	(void) taskq_dispatch(rwa->write_tq, receive_write_batch_task, rwb,
+	    TQ_SLEEP);
+}
+
 noinline static int
 flush_write_batch(struct receive_writer_arg *rwa)
 {
 	if (list_is_empty(&rwa->write_batch))
 		return (0);
 	int err = rwa->err;
-	if (err == 0)
-		err = flush_write_batch_impl(rwa);
-	if (err != 0) {
-		struct receive_record_arg *rrd;
-		while ((rrd = list_remove_head(&rwa->write_batch)) != NULL) {
-			abd_free(rrd->abd);
-			kmem_free(rrd, sizeof (*rrd));
-		}
+	if (err == 0 && rwa->write_tq != NULL) {
+		receive_write_batch_dispatch(rwa);
+		return (0);
 	}
+	if (err == 0)
+		err = flush_write_batch_impl(rwa, &rwa->write_batch);
+	if (err != 0)
+		free_write_batch(&rwa->write_batch);
 	ASSERT(list_is_empty(&rwa->write_batch));
 	return (err);
 }
@@ -2408,6 +2528,11 @@ receive_process_write_record(struct receive_writer_arg *rwa,
 	    !DMU_OT_IS_VALID(drrw->drr_type))
 		return (SET_ERROR(EINVAL));
 
+	/* Chunked blocks are always sent decompressed. */
+	if (DRR_WRITE_COMPRESSED(drrw) &&
+	    ZIO_COMPRESS_IS_CHUNKED(drrw->drr_compressiontype))
+		return (SET_ERROR(EINVAL));
+
 	if (rwa->heal) {
 		blkptr_t *bp;
 		dmu_buf_t *dbp;
@@ -3099,6 +3224,51 @@ dprintf_drr(struct receive_record_arg *rrd, int err)
 #endif
 }
 
+/*
+ * Before applying a record other than a WRITE, wait for the in-flight
+ * write batches of the objects it touches.  Records that do not name a
+ * range of objects wait for all batches.
+ */
+static void
+receive_record_wait(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd)
+{
+	dmu_replay_record_t *drr = &rrd->header;
+	uint64_t first = 0, last = UINT64_MAX;
+
+	switch (drr->drr_type) {
+	case DRR_OBJECT: {
+		struct drr_object *drro = &drr->drr_u.drr_object;
+		first = drro->drr_object;
+		last = first + MAX(drro->drr_dn_slots, 1) - 1;
+		break;
+	}
+	case DRR_FREEOBJECTS: {
+		struct drr_freeobjects *drrfo = &drr->drr_u.drr_freeobjects;
+		first = drrfo->drr_firstobj;
+		if (drrfo->drr_numobjs != 0 &&
+		    first + drrfo->drr_numobjs - 1 >= first)
+			last = first + drrfo->drr_numobjs - 1;
+		break;
+	}
+	case DRR_WRITE_EMBEDDED:
+		first = last = drr->drr_u.drr_write_embedded.drr_object;
+		break;
+	case DRR_FREE:
+		first = last = drr->drr_u.drr_free.drr_object;
+		break;
+	case DRR_SPILL:
+		first = last = drr->drr_u.drr_spill.drr_object;
+		break;
+	case DRR_REDACT:
+		first = last = drr->drr_u.drr_redact.drr_object;
+		break;
+	default:
+		break;
+	}
+	receive_write_batch_wait(rwa, first, last);
+}
+
 /*
  * Commit the records to the pool.
  */
@@ -3138,6 +3308,7 @@ receive_process_record(struct receive_writer_arg *rwa,
 
 			return (err);
 		}
+		receive_record_wait(rwa, rrd);
 	}
 
 	switch (rrd->header.drr_type) {
@@ -3273,6 +3444,7 @@ receive_writer_thread(void *arg)
 		zio_wait(rwa->heal_pio);
 	} else {
 		int err = flush_write_batch(rwa);
+		receive_write_batch_wait(rwa, 0, UINT64_MAX);
 		if (rwa->err == 0)
 			rwa->err = err;
 	}
@@ -3426,12 +3598,23 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, offset_t *voffp)
 	}
 	list_create(&rwa->write_batch, sizeof (struct receive_record_arg),
 	    offsetof(struct receive_record_arg, node.bqn_node));
+	mutex_init(&rwa->inflight_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&rwa->inflight_cv, NULL, CV_DEFAULT, NULL);
+	list_create(&rwa->inflight, sizeof (struct receive_write_batch),
+	    offsetof(struct receive_write_batch, rwb_node));
+	uint_t write_threads = zfs_recv_write_threads;
+	if (write_threads > 0 && !rwa->heal && !rwa->resumable) {
+		rwa->write_tq = taskq_create("z_recv_write", write_threads,
+		    minclsyspri, write_threads, INT_MAX, TASKQ_PREPOPULATE);
+		rwa->inflight_max = 2 * write_threads;
+	}
 
 	(void) thread_create(NULL, 0, receive_writer_thread, rwa, 0, curproc,
 	    TS_RUN, minclsyspri);
 	/*
 	 * We're reading rwa->err without locks, which is safe since we are the
-	 * only reader, and the worker thread is the only writer.  It's ok if we
+	 * only reader, and the worker thread (and its write_tq tasks) are the
+	 * only writers.  It's ok if we
 	 * miss a write for an iteration or two of the loop, since the writer
 	 * thread will keep freeing records we send it until we send it an eos
 	 * marker.
@@ -3513,6 +3696,13 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, offset_t *voffp)
 	mutex_destroy(&rwa->mutex);
 	bqueue_destroy(&rwa->q);
 	list_destroy(&rwa->write_batch);
+	/* The writer thread waited for all write batches before exiting */
+	if (rwa->write_tq != NULL)
+		taskq_destroy(rwa->write_tq);
+	ASSERT0(rwa->inflight_count);
+	list_destroy(&rwa->inflight);
+	cv_destroy(&rwa->inflight_cv);
+	mutex_destroy(&rwa->inflight_lock);
 	if (err == 0)
 		err = rwa->err;
 
@@ -3864,5 +4054,8 @@ ZFS_MODULE_PARAM(zfs_recv, zfs_recv_, queue_ff, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_recv, zfs_recv_, write_batch_size, UINT, ZMOD_RW,
 	"Maximum amount of writes to batch into one transaction");
 
+ZFS_MODULE_PARAM(zfs_recv, zfs_recv_, write_threads, UINT, ZMOD_RW,
+	"Number of threads applying write batches of a receive in parallel");
+
 ZFS_MODULE_PARAM(zfs_recv, zfs_recv_, best_effort_corrective, INT, ZMOD_RW,
 	"Ignore errors during corrective receive");
@@ -69,6 +69,18 @@ static const int zfs_redact_queue_length = 1024 * 1024;
  */
 static const uint64_t zfs_redact_queue_ff = 20;
 
+/*
+ * Number of object ranges of the snapshot that are redacted in parallel,
+ * each with its own traversal and merge threads.  The blocks found in each
+ * range are appended to the redaction list in object order.
+ */
+static uint_t zfs_redact_ranges = 4;
+
+/*
+ * Smallest number of objects worth splitting off into a range of its own.
+ */
+static const uint64_t redact_range_min_objects = 64 * 1024;
+
 struct redact_record {
 	bqueue_node_t		ln;
 	boolean_t		eos_marker; /* Marks the end of the stream */
@@ -92,6 +104,8 @@ struct redact_thread_arg {
 	uint64_t	*num_blocks_visited;
 	uint64_t	ignore_object;	/* ignore further callbacks on this */
 	uint64_t	txg; /* txg to traverse since */
+	uint64_t	first_object;	/* range of objects to report */
+	uint64_t	last_object;
 };
 
 /*
@@ -109,6 +123,11 @@ struct redact_node {
 	uint32_t			thread_num;
 };
 
+/*
+ * md_redaction_list is NULL while building the list of blocks of one range
+ * of objects, see redact_range_thread(); the blocks are then only gathered
+ * in md_redact_block_pending, and not committed.
+ */
 struct merge_data {
 	list_t				md_redact_block_pending;
 	redact_block_phys_t		md_coalesce_block;
@@ -253,6 +272,30 @@ zfs_get_deleteq(objset_t *os)
  * Third, if there is a deleted object, we need to create a redaction record for
  * all of the blocks in that object.
  */
+/*
+ * Returns B_TRUE once the traversal has gone past the last object of the
+ * range of rta.
+ */
+static boolean_t
+redact_past_range(const struct redact_thread_arg *rta,
+    const zbookmark_phys_t *zb, const struct dnode_phys *dnp)
+{
+	uint64_t object = zb->zb_object;
+
+	if (rta->last_object == UINT64_MAX)
+		return (B_FALSE);
+
+	if (object == DMU_META_DNODE_OBJECT) {
+		if (zb->zb_level < 0)
+			return (B_FALSE);
+		object = zb->zb_blkid *
+		    bp_span_in_blocks(dnp->dn_indblkshift, zb->zb_level) *
+		    ((SPA_MINBLOCKSIZE * dnp->dn_datablkszsec) /
+		    sizeof (dnode_phys_t));
+	}
+	return (object > rta->last_object);
+}
+
 static int
 redact_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
     const zbookmark_phys_t *zb, const struct dnode_phys *dnp, void *arg)
@@ -264,7 +307,7 @@ redact_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	ASSERT(zb->zb_object == DMU_META_DNODE_OBJECT ||
 	    zb->zb_object >= rta->resume.zb_object);
 
-	if (rta->cancel)
+	if (rta->cancel || redact_past_range(rta, zb, dnp))
 		return (SET_ERROR(EINTR));
 
 	if (rta->ignore_object == zb->zb_object)
@@ -339,6 +382,11 @@ redact_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 			    1) * ((SPA_MINBLOCKSIZE * dnp->dn_datablkszsec) /
 			    sizeof (dnode_phys_t))) - 1;
 			record->end_blkid = UINT64_MAX;
+
+			record->start_object = MAX(record->start_object,
+			    rta->first_object);
+			record->end_object = MIN(record->end_object,
+			    rta->last_object);
 		}
 	} else if (zb->zb_level != 0 ||
 	    zb->zb_object == DMU_META_DNODE_OBJECT) {
@@ -644,7 +692,7 @@ update_redaction_list(struct merge_data *md, objset_t *os,
 		list_insert_tail(&md->md_redact_block_pending, rbln);
 	}
 
-	if (gethrtime() > md->md_last_time +
+	if (md->md_redaction_list != NULL && gethrtime() > md->md_last_time +
 	    redaction_list_update_interval_ns) {
 		commit_rl_updates(os, md, object, blkid);
 	}
@@ -883,25 +931,45 @@ hold_next_object(objset_t *os, struct redact_record *rec, const void *tag,
 	return (err);
 }
 
-static int
-perform_redaction(objset_t *os, redaction_list_t *rl,
-    struct redact_merge_thread_arg *rmta)
+static void
+merge_data_init(struct merge_data *md, redaction_list_t *rl)
 {
-	int err = 0;
-	bqueue_t *q = &rmta->q;
-	struct redact_record *rec = NULL;
-	struct merge_data md = { {0} };
-
-	list_create(&md.md_redact_block_pending,
+	list_create(&md->md_redact_block_pending,
 	    sizeof (struct redact_block_list_node),
 	    offsetof(struct redact_block_list_node, node));
-	md.md_redaction_list = rl;
+	md->md_redaction_list = rl;
 
 	for (int i = 0; i < TXG_SIZE; i++) {
-		list_create(&md.md_blocks[i],
+		list_create(&md->md_blocks[i],
 		    sizeof (struct redact_block_list_node),
 		    offsetof(struct redact_block_list_node, node));
 	}
+}
+
+static void
+merge_data_fini(struct merge_data *md)
+{
+	struct redact_block_list_node *rbln;
+
+	while ((rbln = list_remove_head(&md->md_redact_block_pending)) != NULL)
+		kmem_free(rbln, sizeof (*rbln));
+	list_destroy(&md->md_redact_block_pending);
+	for (int i = 0; i < TXG_SIZE; i++)
+		list_destroy(&md->md_blocks[i]);
+}
+
+/*
+ * Turn the records produced by the merge thread into the blocks to redact,
+ * and add them to md.  Stops early on a signal, or once *cancel is set if
+ * cancel is not NULL.
+ */
+static int
+build_redaction_list(objset_t *os, struct merge_data *md,
+    struct redact_merge_thread_arg *rmta, const boolean_t *cancel)
+{
+	int err = 0;
+	bqueue_t *q = &rmta->q;
+	struct redact_record *rec = NULL;
 	dnode_t *dn = NULL;
 	uint64_t prev_obj = 0;
 	for (rec = bqueue_dequeue(q); !rec->eos_marker && err == 0;
@@ -915,7 +983,7 @@ perform_redaction(objset_t *os, redaction_list_t *rl,
 			object = prev_obj;
 		}
 		while (err == 0 && object <= rec->end_object) {
-			if (issig()) {
+			if (cancel != NULL ? *cancel : issig()) {
 				err = EINTR;
 				break;
 			}
@@ -940,7 +1008,7 @@ perform_redaction(objset_t *os, redaction_list_t *rl,
 			} else {
 				endblkid = rec->end_blkid;
 			}
-			update_redaction_list(&md, os, object, startblkid,
+			update_redaction_list(md, os, object, startblkid,
 			    endblkid, dn->dn_datablksz);
 
 			if (object == rec->end_object)
@@ -966,13 +1034,25 @@ perform_redaction(objset_t *os, redaction_list_t *rl,
 	 * There may be a block that's being coalesced, sync that out before we
 	 * return.
 	 */
-	if (err == 0 && md.md_coalesce_block.rbp_size_count != 0) {
+	if (err == 0 && md->md_coalesce_block.rbp_size_count != 0) {
 		struct redact_block_list_node *rbln =
 		    kmem_alloc(sizeof (struct redact_block_list_node),
 		    KM_SLEEP);
-		rbln->block = md.md_coalesce_block;
-		list_insert_tail(&md.md_redact_block_pending, rbln);
+		rbln->block = md->md_coalesce_block;
+		list_insert_tail(&md->md_redact_block_pending, rbln);
 	}
+	return (err);
+}
+
+static int
+perform_redaction(objset_t *os, redaction_list_t *rl,
+    struct redact_merge_thread_arg *rmta)
+{
+	struct merge_data md = { {0} };
+	int err;
+
+	merge_data_init(&md, rl);
+	err = build_redaction_list(os, &md, rmta, NULL);
 	commit_rl_updates(os, &md, UINT64_MAX, UINT64_MAX);
 
 	/*
@@ -983,8 +1063,194 @@ perform_redaction(objset_t *os, redaction_list_t *rl,
 	dsl_pool_t *dp = spa_get_dsl(os->os_spa);
 	if (md.md_latest_synctask_txg != 0)
 		txg_wait_synced(dp, md.md_latest_synctask_txg);
-	for (int i = 0; i < TXG_SIZE; i++)
-		list_destroy(&md.md_blocks[i]);
+	merge_data_fini(&md);
+	return (err);
+}
+
+/*
+ * Start a traversal thread for each of the numsnaps redaction snapshots in
+ * args, from the given resume point, reporting the blocks of the objects
+ * first_object to last_object, and a thread merging what they report.
+ */
+static struct redact_merge_thread_arg *
+redact_start_threads(objset_t *os, struct redact_thread_arg *args,
+    int numsnaps, uint64_t txg, const zbookmark_phys_t *resume,
+    uint64_t first_object, uint64_t last_object)
+{
+	struct redact_merge_thread_arg *rmta;
+
+	for (int i = 0; i < numsnaps; i++) {
+		struct redact_thread_arg *rta = &args[i];
+		(void) bqueue_init(&rta->q, zfs_redact_queue_ff,
+		    zfs_redact_queue_length,
+		    offsetof(struct redact_record, ln));
+		rta->resume.zb_blkid = resume->zb_blkid;
+		rta->resume.zb_object = resume->zb_object;
+		rta->txg = txg;
+		rta->first_object = first_object;
+		rta->last_object = last_object;
+		(void) thread_create(NULL, 0, redact_traverse_thread, rta,
+		    0, curproc, TS_RUN, minclsyspri);
+	}
+
+	rmta = kmem_zalloc(sizeof (struct redact_merge_thread_arg), KM_SLEEP);
+
+	(void) bqueue_init(&rmta->q, zfs_redact_queue_ff,
+	    zfs_redact_queue_length, offsetof(struct redact_record, ln));
+	rmta->numsnaps = numsnaps;
+	rmta->spa = os->os_spa;
+	rmta->thr_args = args;
+	(void) thread_create(NULL, 0, redact_merge_thread, rmta, 0, curproc,
+	    TS_RUN, minclsyspri);
+	return (rmta);
+}
+
+/*
+ * State shared by perform_redaction_parallel() and its redact_range_thread()s.
+ */
+struct redact_ranges {
+	kmutex_t	lock;
+	kcondvar_t	cv;
+	boolean_t	cancel;
+};
+
+struct redact_range_arg {
+	struct redact_ranges	*ranges;
+	objset_t		*os;
+	struct redact_thread_arg *thr_args;
+	int			numsnaps;
+	uint64_t		txg;
+	zbookmark_phys_t	resume;
+	uint64_t		first_object;
+	uint64_t		last_object;
+	struct merge_data	md;
+	int			error_code;
+	boolean_t		done;	/* protected by ranges->lock */
+};
+
+static __attribute__((noreturn)) void
+redact_range_thread(void *arg)
+{
+	struct redact_range_arg *rra = arg;
+	struct redact_ranges *rr = rra->ranges;
+	struct redact_merge_thread_arg *rmta;
+	int err;
+
+	rmta = redact_start_threads(rra->os, rra->thr_args, rra->numsnaps,
+	    rra->txg, &rra->resume, rra->first_object, rra->last_object);
+	err = build_redaction_list(rra->os, &rra->md, rmta, &rr->cancel);
+	bqueue_destroy(&rmta->q);
+	kmem_free(rmta, sizeof (struct redact_merge_thread_arg));
+
+	mutex_enter(&rr->lock);
+	rra->error_code = err;
+	rra->done = B_TRUE;
+	cv_broadcast(&rr->cv);
+	mutex_exit(&rr->lock);
+	thread_exit();
+}
+
+/*
+ * Split the objects of the snapshot from the resume point on into
+ * zfs_redact_ranges ranges, and find the blocks to redact in each of them
+ * in parallel.  The blocks of each range are then appended to the redaction
+ * list in object order, recording the start of the next range as the point
+ * to resume from, so an interrupted redaction resumes as it would have with
+ * a single range.  The last range is open-ended.
+ */
+static int
+perform_redaction_parallel(objset_t *os, redaction_list_t *rl,
+    struct redact_thread_arg *args, int numsnaps, uint64_t txg,
+    const zbookmark_phys_t *resume, uint64_t nobjs)
+{
+	struct redact_ranges rr;
+	struct redact_range_arg *rras;
+	struct merge_data md = { {0} };
+	uint_t nranges = zfs_redact_ranges;
+	uint64_t base, per_range;
+	int err = 0;
+
+	base = P2ALIGN_TYPED(resume->zb_object, DNODES_PER_BLOCK, uint64_t);
+	per_range = P2ROUNDUP((nobjs - base) / nranges, DNODES_PER_BLOCK);
+
+	mutex_init(&rr.lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&rr.cv, NULL, CV_DEFAULT, NULL);
+	rr.cancel = B_FALSE;
+
+	rras = vmem_zalloc(nranges * sizeof (*rras), KM_SLEEP);
+	for (uint_t i = 0; i < nranges; i++) {
+		struct redact_range_arg *rra = &rras[i];
+
+		rra->ranges = &rr;
+		rra->os = os;
+		rra->numsnaps = numsnaps;
+		rra->txg = txg;
+		rra->thr_args = vmem_zalloc(numsnaps * sizeof (*args),
+		    KM_SLEEP);
+		for (int j = 0; j < numsnaps; j++) {
+			rra->thr_args[j].ds = args[j].ds;
+			rra->thr_args[j].os = args[j].os;
+		}
+		if (i == 0) {
+			rra->resume = *resume;
+			rra->first_object = 0;
+		} else {
+			rra->first_object = base + i * per_range;
+			rra->resume.zb_object = rra->first_object;
+		}
+		if (i == nranges - 1) {
+			rra->last_object = UINT64_MAX;
+		} else {
+			rra->last_object = base + (i + 1) * per_range - 1;
+		}
+		merge_data_init(&rra->md, NULL);
+		(void) thread_create(NULL, 0, redact_range_thread, rra, 0,
+		    curproc, TS_RUN, minclsyspri);
+	}
+
+	merge_data_init(&md, rl);
+	for (uint_t i = 0; i < nranges; i++) {
+		struct redact_range_arg *rra = &rras[i];
+
+		mutex_enter(&rr.lock);
+		while (!rra->done) {
+			if (err == 0) {
+				(void) cv_wait_sig(&rr.cv, &rr.lock);
+				if (issig()) {
+					err = SET_ERROR(EINTR);
+					rr.cancel = B_TRUE;
+				}
+			} else {
+				cv_wait(&rr.cv, &rr.lock);
+			}
+		}
+		mutex_exit(&rr.lock);
+
+		if (err == 0 && rra->error_code != 0) {
+			err = rra->error_code;
+			rr.cancel = B_TRUE;
+		}
+		if (err == 0) {
+			list_move_tail(&md.md_redact_block_pending,
+			    &rra->md.md_redact_block_pending);
+			if (i < nranges - 1) {
+				commit_rl_updates(os, &md,
+				    rra->last_object + 1, 0);
+			}
+		}
+		merge_data_fini(&rra->md);
+		vmem_free(rra->thr_args, numsnaps * sizeof (*args));
+	}
+	commit_rl_updates(os, &md, UINT64_MAX, UINT64_MAX);
+
+	dsl_pool_t *dp = spa_get_dsl(os->os_spa);
+	if (md.md_latest_synctask_txg != 0)
+		txg_wait_synced(dp, md.md_latest_synctask_txg);
+	merge_data_fini(&md);
+
+	vmem_free(rras, nranges * sizeof (*rras));
+	cv_destroy(&rr.cv);
+	mutex_destroy(&rr.lock);
 	return (err);
 }
 
@@ -1139,35 +1405,31 @@ dmu_redact_snap(const char *snapname, nvlist_t *redactnvl,
 			goto out;
 	}
 
-	for (int i = 0; i < numsnaps; i++) {
-		struct redact_thread_arg *rta = &args[i];
-		(void) bqueue_init(&rta->q, zfs_redact_queue_ff,
-		    zfs_redact_queue_length,
-		    offsetof(struct redact_record, ln));
-		if (resuming) {
-			rta->resume.zb_blkid =
-			    new_rl->rl_phys->rlp_last_blkid;
-			rta->resume.zb_object =
-			    new_rl->rl_phys->rlp_last_object;
-		}
-		rta->txg = dsl_dataset_phys(ds)->ds_creation_txg;
-		(void) thread_create(NULL, 0, redact_traverse_thread, rta,
-		    0, curproc, TS_RUN, minclsyspri);
+	zbookmark_phys_t resume = { 0 };
+	uint64_t txg = dsl_dataset_phys(ds)->ds_creation_txg;
+	uint64_t nobjs = (DMU_META_DNODE(os)->dn_maxblkid + 1) *
+	    DNODES_PER_BLOCK;
+
+	if (resuming) {
+		resume.zb_blkid = new_rl->rl_phys->rlp_last_blkid;
+		resume.zb_object = new_rl->rl_phys->rlp_last_object;
 	}
 
-	struct redact_merge_thread_arg *rmta;
-	rmta = kmem_zalloc(sizeof (struct redact_merge_thread_arg), KM_SLEEP);
+	if (numsnaps > 0 && zfs_redact_ranges > 1 &&
+	    resume.zb_object < nobjs &&
+	    nobjs - resume.zb_object >=
+	    zfs_redact_ranges * redact_range_min_objects) {
+		err = perform_redaction_parallel(os, new_rl, args, numsnaps,
+		    txg, &resume, nobjs);
+	} else {
+		struct redact_merge_thread_arg *rmta;
 
-	(void) bqueue_init(&rmta->q, zfs_redact_queue_ff,
-	    zfs_redact_queue_length, offsetof(struct redact_record, ln));
-	rmta->numsnaps = numsnaps;
-	rmta->spa = os->os_spa;
-	rmta->thr_args = args;
-	(void) thread_create(NULL, 0, redact_merge_thread, rmta, 0, curproc,
-	    TS_RUN, minclsyspri);
-	err = perform_redaction(os, new_rl, rmta);
-	bqueue_destroy(&rmta->q);
-	kmem_free(rmta, sizeof (struct redact_merge_thread_arg));
+		rmta = redact_start_threads(os, args, numsnaps, txg, &resume,
+		    0, UINT64_MAX);
+		err = perform_redaction(os, new_rl, rmta);
+		bqueue_destroy(&rmta->q);
+		kmem_free(rmta, sizeof (struct redact_merge_thread_arg));
+	}
 
 out:
 	kmem_free(newredactbook, sizeof (char) * ZFS_MAX_DATASET_NAME_LEN);
@@ -1200,3 +1462,6 @@ out:
 	return (SET_ERROR(err));
 
 }
+
+ZFS_MODULE_PARAM(zfs, zfs_, redact_ranges, UINT, ZMOD_RW,
+	"Number of object ranges redacted in parallel");
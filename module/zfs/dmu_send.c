@@ -106,6 +106,14 @@ static const boolean_t zfs_send_set_freerecords_bit = B_TRUE;
 /* Set this tunable to FALSE is disable sending unmodified spill blocks. */
 static int zfs_send_unmodified_spill_blocks = B_TRUE;
 
+/*
+ * Number of threads per send that read the data blocks on behalf of the
+ * reader thread.  Reads that hit the ARC may have to decompress or decrypt
+ * the block, which is too much work for a single thread on fast links.  Set
+ * to 0 to issue all reads from the reader thread.
+ */
+static uint_t zfs_send_reader_threads = 4;
+
 static inline boolean_t
 overflow_multiply(uint64_t a, uint64_t b, uint64_t *c)
 {
@@ -163,6 +171,8 @@ struct send_range {
 			blkptr_t		bp;
 			arc_buf_t		*abuf;
 			abd_t			*abd;
+			objset_t		*os;
+			zio_flag_t		io_flags;
 			kmutex_t		lock;
 			kcondvar_t		cv;
 			boolean_t		io_outstanding;
@@ -1561,6 +1571,7 @@ send_merge_thread(void *arg)
 struct send_reader_thread_arg {
 	struct send_merge_thread_arg *smta;
 	bqueue_t q;
+	taskq_t *read_tq;
 	boolean_t cancel;
 	boolean_t issue_reads;
 	uint64_t featureflags;
@@ -1585,6 +1596,51 @@ dmu_send_read_done(zio_t *zio)
 	mutex_exit(&range->sru.data.lock);
 }
 
+/*
+ * Read the data of a DATA range, either from the send_reader_thread() or
+ * from the per-send read taskq.  io_outstanding is set by the caller and
+ * cleared here, or by dmu_send_read_done() if we had to issue a zio.
+ */
+static void
+send_read_task(void *arg)
+{
+	struct send_range *range = arg;
+	struct srd *srdp = &range->sru.data;
+	objset_t *os = srdp->os;
+
+	zbookmark_phys_t zb = {
+	    .zb_objset = dmu_objset_id(os),
+	    .zb_object = range->object,
+	    .zb_level = 0,
+	    .zb_blkid = range->start_blkid,
+	};
+
+	arc_flags_t aflags = ARC_FLAG_CACHED_ONLY;
+
+	int arc_err = arc_read(NULL, os->os_spa, &srdp->bp,
+	    arc_getbuf_func, &srdp->abuf, ZIO_PRIORITY_ASYNC_READ,
+	    srdp->io_flags, &aflags, &zb);
+	/*
+	 * If the data is not already cached in the ARC, we read directly
+	 * from zio.  This avoids the performance overhead of adding a new
+	 * entry to the ARC, and we also avoid polluting the ARC cache with
+	 * data that is not likely to be used in the future.
+	 */
+	if (arc_err != 0) {
+		srdp->abd = abd_alloc_linear(srdp->datasz, B_FALSE);
+		zio_nowait(zio_read(NULL, os->os_spa, &srdp->bp, srdp->abd,
+		    srdp->datasz, dmu_send_read_done, range,
+		    ZIO_PRIORITY_ASYNC_READ, srdp->io_flags, &zb));
+		return;
+	}
+
+	mutex_enter(&srdp->lock);
+	ASSERT(srdp->io_outstanding);
+	srdp->io_outstanding = B_FALSE;
+	cv_broadcast(&srdp->cv);
+	mutex_exit(&srdp->lock);
+}
+
 static void
 issue_data_read(struct send_reader_thread_arg *srta, struct send_range *range)
 {
@@ -1612,11 +1668,14 @@ issue_data_read(struct send_reader_thread_arg *srta, struct send_range *range)
 	 *  - this isn't an embedded block
 	 *  - this isn't metadata (if receiving on a different endian
 	 *    system it can be byteswapped more easily)
+	 *  - the block isn't compressed in chunks, a format the receiver
+	 *    may not know
 	 */
 	boolean_t request_compressed =
 	    (srta->featureflags & DMU_BACKUP_FEATURE_COMPRESSED) &&
 	    !split_large_blocks && !BP_SHOULD_BYTESWAP(bp) &&
-	    !BP_IS_EMBEDDED(bp) && !DMU_OT_IS_METADATA(BP_GET_TYPE(bp));
+	    !BP_IS_EMBEDDED(bp) && !DMU_OT_IS_METADATA(BP_GET_TYPE(bp)) &&
+	    !ZIO_COMPRESS_IS_CHUNKED(BP_GET_COMPRESS(bp));
 
 	zio_flag_t zioflags = ZIO_FLAG_CANFAIL;
 
@@ -1638,30 +1697,20 @@ issue_data_read(struct send_reader_thread_arg *srta, struct send_range *range)
 	if (send_do_embed(bp, srta->featureflags))
 		return;
 
-	zbookmark_phys_t zb = {
-	    .zb_objset = dmu_objset_id(os),
-	    .zb_object = range->object,
-	    .zb_level = 0,
-	    .zb_blkid = range->start_blkid,
-	};
-
-	arc_flags_t aflags = ARC_FLAG_CACHED_ONLY;
+	srdp->os = os;
+	srdp->io_flags = zioflags;
+	srdp->io_outstanding = B_TRUE;
 
-	int arc_err = arc_read(NULL, os->os_spa, bp,
-	    arc_getbuf_func, &srdp->abuf, ZIO_PRIORITY_ASYNC_READ,
-	    zioflags, &aflags, &zb);
 	/*
-	 * If the data is not already cached in the ARC, we read directly
-	 * from zio.  This avoids the performance overhead of adding a new
-	 * entry to the ARC, and we also avoid polluting the ARC cache with
-	 * data that is not likely to be used in the future.
+	 * The main send thread consumes the ranges in order and waits for
+	 * io_outstanding to clear on each, so the reads may complete in any
+	 * order.
 	 */
-	if (arc_err != 0) {
-		srdp->abd = abd_alloc_linear(srdp->datasz, B_FALSE);
-		srdp->io_outstanding = B_TRUE;
-		zio_nowait(zio_read(NULL, os->os_spa, bp, srdp->abd,
-		    srdp->datasz, dmu_send_read_done, range,
-		    ZIO_PRIORITY_ASYNC_READ, zioflags, &zb));
+	if (srta->read_tq != NULL) {
+		(void) taskq_dispatch(srta->read_tq, send_read_task, range,
+		    TQ_SLEEP);
+	} else {
+		send_read_task(range);
 	}
 }
 
@@ -2029,6 +2078,16 @@ setup_featureflags(struct dmu_send_params *dspp, objset_t *os,
 		*featureflags |= DMU_BACKUP_FEATURE_LARGE_MICROZAP;
 	}
 
+	if (dsl_dataset_feature_is_active(to_ds, SPA_FEATURE_INLINE_DATA)) {
+		/*
+		 * Inline file data is sent with the dnode, so it cannot be
+		 * redacted.
+		 */
+		if (dspp->redactbook != NULL)
+			return (SET_ERROR(ENOTSUP));
+		*featureflags |= DMU_BACKUP_FEATURE_INLINE_DATA;
+	}
+
 	return (0);
 }
 
@@ -2167,6 +2226,11 @@ setup_reader_thread(struct send_reader_thread_arg *srt_arg,
 	srt_arg->smta = smt_arg;
 	srt_arg->issue_reads = !dspp->dso->dso_dryrun;
 	srt_arg->featureflags = featureflags;
+	if (srt_arg->issue_reads && zfs_send_reader_threads > 0) {
+		srt_arg->read_tq = taskq_create("z_send_read",
+		    zfs_send_reader_threads, minclsyspri,
+		    zfs_send_reader_threads, INT_MAX, TASKQ_PREPOPULATE);
+	}
 	(void) thread_create(NULL, 0, send_reader_thread, srt_arg, 0,
 	    curproc, TS_RUN, minclsyspri);
 }
@@ -2588,6 +2652,10 @@ dmu_send_impl(struct dmu_send_params *dspp)
 	}
 	range_free(range);
 
+	/* All ranges are freed, so no read task can be outstanding */
+	if (srt_arg->read_tq != NULL)
+		taskq_destroy(srt_arg->read_tq);
+
 	bqueue_destroy(&srt_arg->q);
 	bqueue_destroy(&smt_arg->q);
 	if (dspp->redactbook != NULL)
@@ -3013,9 +3081,10 @@ dmu_adjust_send_estimate_for_indirects(dsl_dataset_t *ds, uint64_t uncompressed,
 	 * Assume no ditto blocks or internal fragmentation.
 	 *
 	 * Therefore, space used by indirect blocks is sizeof(blkptr_t) per
-	 * block.
+	 * block.  With highly compressible data the compressed size can be
+	 * smaller than that, so don't let the subtraction wrap around.
 	 */
-	size -= record_count * sizeof (blkptr_t);
+	size -= MIN(size, record_count * sizeof (blkptr_t));
 
 	/* Add in the space for the record associated with each block. */
 	size += record_count * sizeof (dmu_replay_record_t);
@@ -3124,6 +3193,9 @@ ZFS_MODULE_PARAM(zfs_send, zfs_send_, corrupt_data, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_send, zfs_send_, queue_length, UINT, ZMOD_RW,
 	"Maximum send queue length");
 
+ZFS_MODULE_PARAM(zfs_send, zfs_send_, reader_threads, UINT, ZMOD_RW,
+	"Number of threads per send that read data blocks");
+
 ZFS_MODULE_PARAM(zfs_send, zfs_send_, unmodified_spill_blocks, INT, ZMOD_RW,
 	"Send unmodified spill blocks");
 
@@ -749,6 +749,39 @@ traverse_dataset_destroyed(spa_t *spa, blkptr_t *blkptr,
 	    blkptr, txg_start, resume, flags, func, arg));
 }
 
+/*
+ * Traverse the dataset whose head or snapshot is stored in MOS object "obj",
+ * if it is one.  Errors looking the dataset up are ignored for TRAVERSE_HARD.
+ */
+static int
+traverse_pool_dataset(spa_t *spa, uint64_t obj, uint64_t txg_start,
+    int flags, blkptr_cb_t func, void *arg)
+{
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	boolean_t hard = (flags & TRAVERSE_HARD);
+	dmu_object_info_t doi;
+	dsl_dataset_t *ds;
+	uint64_t txg = txg_start;
+	int err;
+
+	err = dmu_object_info(dp->dp_meta_objset, obj, &doi);
+	if (err != 0)
+		return (hard ? 0 : err);
+	if (doi.doi_bonus_type != DMU_OT_DSL_DATASET)
+		return (0);
+
+	dsl_pool_config_enter(dp, FTAG);
+	err = dsl_dataset_hold_obj(dp, obj, FTAG, &ds);
+	dsl_pool_config_exit(dp, FTAG);
+	if (err != 0)
+		return (hard ? 0 : err);
+	if (dsl_dataset_phys(ds)->ds_prev_snap_txg > txg)
+		txg = dsl_dataset_phys(ds)->ds_prev_snap_txg;
+	err = traverse_dataset(ds, txg, flags, func, arg);
+	dsl_dataset_rele(ds, FTAG);
+	return (err);
+}
+
 /*
  * NB: pool must not be changing on-disk (eg, from zdb or sync context).
  */
@@ -757,9 +790,7 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
     blkptr_cb_t func, void *arg)
 {
 	int err;
-	dsl_pool_t *dp = spa_get_dsl(spa);
-	objset_t *mos = dp->dp_meta_objset;
-	boolean_t hard = (flags & TRAVERSE_HARD);
+	objset_t *mos = spa_get_dsl(spa)->dp_meta_objset;
 
 	/* visit the MOS */
 	err = traverse_impl(spa, NULL, 0, spa_get_rootblkptr(spa),
@@ -770,35 +801,133 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 	/* visit each dataset */
 	for (uint64_t obj = 1; err == 0;
 	    err = dmu_object_next(mos, &obj, B_FALSE, txg_start)) {
-		dmu_object_info_t doi;
+		err = traverse_pool_dataset(spa, obj, txg_start, flags,
+		    func, arg);
+		if (err != 0)
+			break;
+	}
+	if (err == ESRCH)
+		err = 0;
+	return (err);
+}
+
+typedef struct traverse_pool_arg {
+	spa_t		*tpa_spa;
+	uint64_t	tpa_txg_start;
+	int		tpa_flags;
+	blkptr_cb_t	*tpa_func;
+	kmutex_t	tpa_lock;
+	uint64_t	*tpa_objs;
+	uint64_t	tpa_count;
+	uint64_t	tpa_next;
+	int		tpa_err;
+} traverse_pool_arg_t;
+
+typedef struct traverse_pool_worker {
+	traverse_pool_arg_t	*tpw_tpa;
+	void			*tpw_arg;
+} traverse_pool_worker_t;
+
+static void
+traverse_pool_worker(void *arg)
+{
+	traverse_pool_worker_t *tpw = arg;
+	traverse_pool_arg_t *tpa = tpw->tpw_tpa;
+
+	for (;;) {
+		mutex_enter(&tpa->tpa_lock);
+		if (tpa->tpa_err != 0 || tpa->tpa_next == tpa->tpa_count) {
+			mutex_exit(&tpa->tpa_lock);
+			return;
+		}
+		uint64_t obj = tpa->tpa_objs[tpa->tpa_next++];
+		mutex_exit(&tpa->tpa_lock);
 
-		err = dmu_object_info(mos, obj, &doi);
+		int err = traverse_pool_dataset(tpa->tpa_spa, obj,
+		    tpa->tpa_txg_start, tpa->tpa_flags, tpa->tpa_func,
+		    tpw->tpw_arg);
 		if (err != 0) {
-			if (hard)
-				continue;
-			break;
+			mutex_enter(&tpa->tpa_lock);
+			if (tpa->tpa_err == 0)
+				tpa->tpa_err = err;
+			mutex_exit(&tpa->tpa_lock);
 		}
+	}
+}
 
-		if (doi.doi_bonus_type == DMU_OT_DSL_DATASET) {
-			dsl_dataset_t *ds;
-			uint64_t txg = txg_start;
+/*
+ * Like traverse_pool(), but with the datasets spread over "nthreads"
+ * threads.  Thread i passes args[i] to the callback, so that callers can
+ * keep separate state per thread and merge it afterwards; the MOS is
+ * visited first, with args[0].  The order datasets are visited in is not
+ * defined, and the callback must be safe to run concurrently on different
+ * datasets.
+ *
+ * NB: pool must not be changing on-disk (eg, from zdb).
+ */
+int
+traverse_pool_parallel(spa_t *spa, uint64_t txg_start, int flags,
+    blkptr_cb_t func, void **args, int nthreads)
+{
+	objset_t *mos = spa_get_dsl(spa)->dp_meta_objset;
+	traverse_pool_arg_t tpa = { 0 };
+	uint64_t alloc = 64;
+	int err;
 
-			dsl_pool_config_enter(dp, FTAG);
-			err = dsl_dataset_hold_obj(dp, obj, FTAG, &ds);
-			dsl_pool_config_exit(dp, FTAG);
-			if (err != 0) {
-				if (hard)
-					continue;
-				break;
-			}
-			if (dsl_dataset_phys(ds)->ds_prev_snap_txg > txg)
-				txg = dsl_dataset_phys(ds)->ds_prev_snap_txg;
-			err = traverse_dataset(ds, txg, flags, func, arg);
-			dsl_dataset_rele(ds, FTAG);
-			if (err != 0)
-				break;
+	ASSERT3S(nthreads, >, 0);
+
+	/* visit the MOS */
+	err = traverse_impl(spa, NULL, 0, spa_get_rootblkptr(spa),
+	    txg_start, NULL, flags, func, args[0]);
+	if (err != 0)
+		return (err);
+
+	/*
+	 * Collect the objects to visit up front; the walk of the MOS
+	 * object numbers is cheap next to the traversals themselves.
+	 */
+	tpa.tpa_objs = vmem_alloc(alloc * sizeof (uint64_t), KM_SLEEP);
+	for (uint64_t obj = 1; err == 0;
+	    err = dmu_object_next(mos, &obj, B_FALSE, txg_start)) {
+		if (tpa.tpa_count == alloc) {
+			uint64_t *objs = vmem_alloc(2 * alloc *
+			    sizeof (uint64_t), KM_SLEEP);
+			memcpy(objs, tpa.tpa_objs, alloc * sizeof (uint64_t));
+			vmem_free(tpa.tpa_objs, alloc * sizeof (uint64_t));
+			tpa.tpa_objs = objs;
+			alloc *= 2;
 		}
+		tpa.tpa_objs[tpa.tpa_count++] = obj;
+	}
+	if (err != ESRCH) {
+		vmem_free(tpa.tpa_objs, alloc * sizeof (uint64_t));
+		return (err);
 	}
+
+	tpa.tpa_spa = spa;
+	tpa.tpa_txg_start = txg_start;
+	tpa.tpa_flags = flags;
+	tpa.tpa_func = func;
+	mutex_init(&tpa.tpa_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	traverse_pool_worker_t *tpw = kmem_alloc(nthreads * sizeof (*tpw),
+	    KM_SLEEP);
+	taskq_t *tq = taskq_create("traverse_pool", nthreads, defclsyspri,
+	    nthreads, nthreads, TASKQ_PREPOPULATE);
+	for (int i = 0; i < nthreads; i++) {
+		tpw[i].tpw_tpa = &tpa;
+		tpw[i].tpw_arg = args[i];
+		VERIFY(taskq_dispatch(tq, traverse_pool_worker, &tpw[i],
+		    TQ_SLEEP) != TASKQID_INVALID);
+	}
+	taskq_wait(tq);
+	taskq_destroy(tq);
+	kmem_free(tpw, nthreads * sizeof (*tpw));
+
+	err = tpa.tpa_err;
+	mutex_destroy(&tpa.tpa_lock);
+	vmem_free(tpa.tpa_objs, alloc * sizeof (uint64_t));
+
 	if (err == ESRCH)
 		err = 0;
 	return (err);
@@ -806,6 +935,7 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 
 EXPORT_SYMBOL(traverse_dataset);
 EXPORT_SYMBOL(traverse_pool);
+EXPORT_SYMBOL(traverse_pool_parallel);
 
 ZFS_MODULE_PARAM(zfs, zfs_, pd_bytes_max, INT, ZMOD_RW,
 	"Max number of bytes to prefetch");
@@ -257,12 +257,32 @@ dmu_tx_count_write(dmu_tx_hold_t *txh, uint64_t off, uint64_t len)
 			}
 		}
 	} else {
-		zio_t *zio = zio_root(dn->dn_objset->os_spa,
-		    NULL, NULL, ZIO_FLAG_CANFAIL);
+		uint64_t start = off >> dn->dn_datablkshift;
+		uint64_t end = (off + len - 1) >> dn->dn_datablkshift;
+		int shft = dn->dn_indblkshift - SPA_BLKPTRSHIFT;
+		boolean_t first = (P2PHASE(off, dn->dn_datablksz) ||
+		    len < dn->dn_datablksz);
+		boolean_t last = (end != start && end <= dn->dn_maxblkid &&
+		    P2PHASE(off + len, dn->dn_datablksz));
+		uint64_t l1start = (start >> shft) + 1;
+		uint64_t l1end = (dn->dn_nlevels > 1) ? end >> shft : 0;
+		uint64_t l1blks = (l1end > l1start) ? l1end - l1start : 0;
+
+		/*
+		 * Most writes are aligned overwrites that need no block read,
+		 * or small ones that need one.  Only set up a zio to read
+		 * several blocks at once when there are several.
+		 */
+		if (!first && !last && l1blks == 0)
+			return;
+		zio_t *zio = NULL;
+		if (first + last + l1blks > 1) {
+			zio = zio_root(dn->dn_objset->os_spa,
+			    NULL, NULL, ZIO_FLAG_CANFAIL);
+		}
 
 		/* first level-0 block */
-		uint64_t start = off >> dn->dn_datablkshift;
-		if (P2PHASE(off, dn->dn_datablksz) || len < dn->dn_datablksz) {
+		if (first) {
 			err = dmu_tx_check_ioerr(zio, dn, 0, start);
 			if (err != 0) {
 				txh->txh_tx->tx_err = err;
@@ -270,9 +290,7 @@ dmu_tx_count_write(dmu_tx_hold_t *txh, uint64_t off, uint64_t len)
 		}
 
 		/* last level-0 block */
-		uint64_t end = (off + len - 1) >> dn->dn_datablkshift;
-		if (end != start && end <= dn->dn_maxblkid &&
-		    P2PHASE(off + len, dn->dn_datablksz)) {
+		if (last) {
 			err = dmu_tx_check_ioerr(zio, dn, 0, end);
 			if (err != 0) {
 				txh->txh_tx->tx_err = err;
@@ -280,20 +298,18 @@ dmu_tx_count_write(dmu_tx_hold_t *txh, uint64_t off, uint64_t len)
 		}
 
 		/* level-1 blocks */
-		if (dn->dn_nlevels > 1) {
-			int shft = dn->dn_indblkshift - SPA_BLKPTRSHIFT;
-			for (uint64_t i = (start >> shft) + 1;
-			    i < end >> shft; i++) {
-				err = dmu_tx_check_ioerr(zio, dn, 1, i);
-				if (err != 0) {
-					txh->txh_tx->tx_err = err;
-				}
+		for (uint64_t i = l1start; i < l1end; i++) {
+			err = dmu_tx_check_ioerr(zio, dn, 1, i);
+			if (err != 0) {
+				txh->txh_tx->tx_err = err;
 			}
 		}
 
-		err = zio_wait(zio);
-		if (err != 0) {
-			txh->txh_tx->tx_err = err;
+		if (zio != NULL) {
+			err = zio_wait(zio);
+			if (err != 0) {
+				txh->txh_tx->tx_err = err;
+			}
 		}
 	}
 }
@@ -326,22 +342,14 @@ dmu_tx_count_append(dmu_tx_hold_t *txh, uint64_t off, uint64_t len)
 			}
 		}
 	} else {
-		zio_t *zio = zio_root(dn->dn_objset->os_spa,
-		    NULL, NULL, ZIO_FLAG_CANFAIL);
-
-		/* first level-0 block */
+		/* first level-0 block, read directly as it is the only one */
 		uint64_t start = off >> dn->dn_datablkshift;
 		if (P2PHASE(off, dn->dn_datablksz) || len < dn->dn_datablksz) {
-			err = dmu_tx_check_ioerr(zio, dn, 0, start);
+			err = dmu_tx_check_ioerr(NULL, dn, 0, start);
 			if (err != 0) {
 				txh->txh_tx->tx_err = err;
 			}
 		}
-
-		err = zio_wait(zio);
-		if (err != 0) {
-			txh->txh_tx->tx_err = err;
-		}
 	}
 }
 
@@ -930,6 +938,7 @@ dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty)
 	dsl_pool_t *dp = tx->tx_pool;
 	uint64_t delay_min_bytes, wrlog;
 	hrtime_t wakeup, tx_time = 0, now;
+	boolean_t light = B_FALSE;
 
 	/* Calculate minimum transaction time for the dirty data amount. */
 	delay_min_bytes =
@@ -945,6 +954,22 @@ dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty)
 
 		tx_time = zfs_delay_scale * (dirty - delay_min_bytes) /
 		    (zfs_dirty_data_max - dirty);
+
+		/*
+		 * If this dataset only holds a small share of the dirty
+		 * data, it is not the one filling up the dirty budget.
+		 * Scale its delay down in proportion to its share, and don't
+		 * queue it behind the heavy writers' wakeups below.  The
+		 * pool-wide zfs_dirty_data_max limit still applies to it.
+		 */
+		uint64_t fair = dirty * zfs_delay_fair_share_percent / 100;
+		if (fair != 0 && tx->tx_dir != NULL) {
+			uint64_t own = dsl_dir_dirty_total(tx->tx_dir);
+			if (own < fair) {
+				tx_time = tx_time * (own * 100 / fair) / 100;
+				light = B_TRUE;
+			}
+		}
 	}
 
 	/* Calculate minimum transaction time for the TX_WRITE log size. */
@@ -969,10 +994,15 @@ dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty)
 	DTRACE_PROBE3(delay__mintime, dmu_tx_t *, tx, uint64_t, dirty,
 	    uint64_t, tx_time);
 
-	mutex_enter(&dp->dp_lock);
-	wakeup = MAX(tx->tx_start + tx_time, dp->dp_last_wakeup + tx_time);
-	dp->dp_last_wakeup = wakeup;
-	mutex_exit(&dp->dp_lock);
+	if (light) {
+		wakeup = tx->tx_start + tx_time;
+	} else {
+		mutex_enter(&dp->dp_lock);
+		wakeup = MAX(tx->tx_start + tx_time,
+		    dp->dp_last_wakeup + tx_time);
+		dp->dp_last_wakeup = wakeup;
+		mutex_exit(&dp->dp_lock);
+	}
 
 	zfs_sleep_until(wakeup);
 }
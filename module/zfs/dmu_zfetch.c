@@ -36,7 +36,7 @@
 #include <sys/dmu.h>
 #include <sys/dbuf.h>
 #include <sys/kstat.h>
-#include <sys/wmsum.h>
+#include <sys/wmsum_kstat.h>
 
 /*
  * This tunable disables predictive prefetch.  Note that it leaves "prescient"
@@ -70,12 +70,27 @@ unsigned int	zfetch_max_idistance = 128 * 1024 * 1024;
 unsigned int	zfetch_max_reorder = 16 * 1024 * 1024;
 /* Max log2 fraction of holes in a stream */
 unsigned int	zfetch_hole_shift = 2;
+/* max distance between strided accesses to detect (default 64MB) */
+static unsigned int	zfetch_max_stride = 64 * 1024 * 1024;
+/* min object size for random access indirect prefetch (default 1GB) */
+static uint64_t	zfetch_random_min_size = 1ULL << 30;
+
+/*
+ * Consecutive accesses matching no stream after which an object is seen
+ * as randomly accessed, and the number of level 1 indirect blocks to
+ * prefetch after each following such access.
+ */
+#define	ZFETCH_RANDOM_MISSES	8
+#define	ZFETCH_RANDOM_L1S	8
 
 typedef struct zfetch_stats {
 	kstat_named_t zfetchstat_hits;
 	kstat_named_t zfetchstat_future;
 	kstat_named_t zfetchstat_stride;
 	kstat_named_t zfetchstat_past;
+	kstat_named_t zfetchstat_strided;
+	kstat_named_t zfetchstat_reverse;
+	kstat_named_t zfetchstat_random;
 	kstat_named_t zfetchstat_misses;
 	kstat_named_t zfetchstat_max_streams;
 	kstat_named_t zfetchstat_io_issued;
@@ -87,97 +102,53 @@ static zfetch_stats_t zfetch_stats = {
 	{ "future",			KSTAT_DATA_UINT64 },
 	{ "stride",			KSTAT_DATA_UINT64 },
 	{ "past",			KSTAT_DATA_UINT64 },
+	{ "strided",			KSTAT_DATA_UINT64 },
+	{ "reverse",			KSTAT_DATA_UINT64 },
+	{ "random",			KSTAT_DATA_UINT64 },
 	{ "misses",			KSTAT_DATA_UINT64 },
 	{ "max_streams",		KSTAT_DATA_UINT64 },
 	{ "io_issued",			KSTAT_DATA_UINT64 },
 	{ "io_active",			KSTAT_DATA_UINT64 },
 };
 
-struct {
-	wmsum_t zfetchstat_hits;
-	wmsum_t zfetchstat_future;
-	wmsum_t zfetchstat_stride;
-	wmsum_t zfetchstat_past;
-	wmsum_t zfetchstat_misses;
-	wmsum_t zfetchstat_max_streams;
-	wmsum_t zfetchstat_io_issued;
-	aggsum_t zfetchstat_io_active;
-} zfetch_sums;
+/* Everything before io_active is a per-CPU counter. */
+#define	ZFETCHSTAT_NSUMS	\
+	WMSUM_KSTAT_INDEX(zfetch_stats_t, zfetchstat_io_active)
+
+static wmsum_kstat_t zfetch_wk;
+static aggsum_t zfetchstat_io_active;
 
 #define	ZFETCHSTAT_BUMP(stat)					\
-	wmsum_add(&zfetch_sums.stat, 1)
+	ZFETCHSTAT_ADD(stat, 1)
 #define	ZFETCHSTAT_ADD(stat, val)				\
-	wmsum_add(&zfetch_sums.stat, val)
-
+	wmsum_kstat_add(&zfetch_wk,				\
+	    WMSUM_KSTAT_INDEX(zfetch_stats_t, stat), val)
 
-static kstat_t		*zfetch_ksp;
-
-static int
-zfetch_kstats_update(kstat_t *ksp, int rw)
+static void
+zfetch_kstats_update(kstat_named_t *named)
 {
-	zfetch_stats_t *zs = ksp->ks_data;
-
-	if (rw == KSTAT_WRITE)
-		return (EACCES);
-	zs->zfetchstat_hits.value.ui64 =
-	    wmsum_value(&zfetch_sums.zfetchstat_hits);
-	zs->zfetchstat_future.value.ui64 =
-	    wmsum_value(&zfetch_sums.zfetchstat_future);
-	zs->zfetchstat_stride.value.ui64 =
-	    wmsum_value(&zfetch_sums.zfetchstat_stride);
-	zs->zfetchstat_past.value.ui64 =
-	    wmsum_value(&zfetch_sums.zfetchstat_past);
-	zs->zfetchstat_misses.value.ui64 =
-	    wmsum_value(&zfetch_sums.zfetchstat_misses);
-	zs->zfetchstat_max_streams.value.ui64 =
-	    wmsum_value(&zfetch_sums.zfetchstat_max_streams);
-	zs->zfetchstat_io_issued.value.ui64 =
-	    wmsum_value(&zfetch_sums.zfetchstat_io_issued);
+	zfetch_stats_t *zs = (zfetch_stats_t *)named;
+
 	zs->zfetchstat_io_active.value.ui64 =
-	    aggsum_value(&zfetch_sums.zfetchstat_io_active);
-	return (0);
+	    aggsum_value(&zfetchstat_io_active);
 }
 
 void
 zfetch_init(void)
 {
-	wmsum_init(&zfetch_sums.zfetchstat_hits, 0);
-	wmsum_init(&zfetch_sums.zfetchstat_future, 0);
-	wmsum_init(&zfetch_sums.zfetchstat_stride, 0);
-	wmsum_init(&zfetch_sums.zfetchstat_past, 0);
-	wmsum_init(&zfetch_sums.zfetchstat_misses, 0);
-	wmsum_init(&zfetch_sums.zfetchstat_max_streams, 0);
-	wmsum_init(&zfetch_sums.zfetchstat_io_issued, 0);
-	aggsum_init(&zfetch_sums.zfetchstat_io_active, 0);
-
-	zfetch_ksp = kstat_create("zfs", 0, "zfetchstats", "misc",
-	    KSTAT_TYPE_NAMED, sizeof (zfetch_stats) / sizeof (kstat_named_t),
-	    KSTAT_FLAG_VIRTUAL);
-
-	if (zfetch_ksp != NULL) {
-		zfetch_ksp->ks_data = &zfetch_stats;
-		zfetch_ksp->ks_update = zfetch_kstats_update;
-		kstat_install(zfetch_ksp);
-	}
+	aggsum_init(&zfetchstat_io_active, 0);
+	wmsum_kstat_init(&zfetch_wk, "zfs", "zfetchstats", "misc",
+	    (kstat_named_t *)&zfetch_stats,
+	    sizeof (zfetch_stats) / sizeof (kstat_named_t),
+	    ZFETCHSTAT_NSUMS, zfetch_kstats_update);
 }
 
 void
 zfetch_fini(void)
 {
-	if (zfetch_ksp != NULL) {
-		kstat_delete(zfetch_ksp);
-		zfetch_ksp = NULL;
-	}
-
-	wmsum_fini(&zfetch_sums.zfetchstat_hits);
-	wmsum_fini(&zfetch_sums.zfetchstat_future);
-	wmsum_fini(&zfetch_sums.zfetchstat_stride);
-	wmsum_fini(&zfetch_sums.zfetchstat_past);
-	wmsum_fini(&zfetch_sums.zfetchstat_misses);
-	wmsum_fini(&zfetch_sums.zfetchstat_max_streams);
-	wmsum_fini(&zfetch_sums.zfetchstat_io_issued);
-	ASSERT0(aggsum_value(&zfetch_sums.zfetchstat_io_active));
-	aggsum_fini(&zfetch_sums.zfetchstat_io_active);
+	wmsum_kstat_fini(&zfetch_wk);
+	ASSERT0(aggsum_value(&zfetchstat_io_active));
+	aggsum_fini(&zfetchstat_io_active);
 }
 
 /*
@@ -192,6 +163,13 @@ dmu_zfetch_init(zfetch_t *zf, dnode_t *dno)
 		return;
 	zf->zf_dnode = dno;
 	zf->zf_numstreams = 0;
+	zf->zf_last_blkid = 0;
+	zf->zf_last_delta = 0;
+	zf->zf_advice = DMU_ADVICE_NORMAL;
+	zf->zf_random = 0;
+	zf->zf_rnd_lo = UINT64_MAX;
+	zf->zf_rnd_hi = 0;
+	zf->zf_rnd_next = 0;
 
 	list_create(&zf->zf_stream, sizeof (zstream_t),
 	    offsetof(zstream_t, zs_node));
@@ -238,13 +216,34 @@ dmu_zfetch_fini(zfetch_t *zf)
 	zf->zf_dnode = NULL;
 }
 
+/*
+ * Apply an access pattern hint to the dnode.  Random access hint stops
+ * creation of new streams and drops the existing ones, while sequential
+ * one makes streams start at zfetch_min_distance instead of ramping up.
+ */
+void
+dmu_zfetch_advise(zfetch_t *zf, dmu_advice_t advice)
+{
+	zstream_t *zs;
+
+	mutex_enter(&zf->zf_lock);
+	zf->zf_advice = advice;
+	if (advice == DMU_ADVICE_RANDOM) {
+		while ((zs = list_head(&zf->zf_stream)) != NULL)
+			dmu_zfetch_stream_remove(zf, zs);
+		zf->zf_last_delta = 0;
+	}
+	mutex_exit(&zf->zf_lock);
+}
+
 /*
  * If there aren't too many active streams already, create one more.
  * In process delete/reuse all streams without hits for zfetch_max_sec_reap.
  * If needed, reuse oldest stream without hits for zfetch_min_sec_reap or ever.
  * The "blkid" argument is the next block that we expect this stream to access.
+ * Returns the new stream, or NULL if there was no room for one.
  */
-static void
+static zstream_t *
 dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
 {
 	zstream_t *zs, *zs_next, *zs_old = NULL;
@@ -302,7 +301,7 @@ dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
 			goto reuse;
 		}
 		ZFETCHSTAT_BUMP(zfetchstat_max_streams);
-		return;
+		return (NULL);
 	}
 
 	zs = kmem_zalloc(sizeof (*zs), KM_SLEEP);
@@ -326,6 +325,10 @@ reuse:
 	zs->zs_ipf_end = blkid;
 	zs->zs_missed = B_FALSE;
 	zs->zs_more = B_FALSE;
+	zs->zs_stride = 0;
+	zs->zs_last = 0;
+	zs->zs_nblks = 0;
+	return (zs);
 }
 
 static void
@@ -337,7 +340,7 @@ dmu_zfetch_done(void *arg, uint64_t level, uint64_t blkid, boolean_t io_issued)
 		zs->zs_more = B_TRUE;
 	if (zfs_refcount_remove(&zs->zs_refs, NULL) == 0)
 		dmu_zfetch_stream_fini(zs);
-	aggsum_add(&zfetch_sums.zfetchstat_io_active, -1);
+	aggsum_add(&zfetchstat_io_active, -1);
 }
 
 /*
@@ -454,6 +457,144 @@ dmu_zfetch_future(zstream_t *zs, uint64_t blkid, uint64_t nblks)
 	return (0);
 }
 
+/*
+ * Look for a constant distance between the starts of consecutive accesses
+ * that did not match any stream.  Seeing the same distance twice in a row
+ * turns the access into a strided stream, which also covers descending
+ * scans (negative stride).  Returns that stream, set up so that this access
+ * is its first hit, or NULL.
+ */
+static zstream_t *
+dmu_zfetch_stride_detect(zfetch_t *zf, uint64_t blkid, uint64_t nblks)
+{
+	unsigned int dbs = zf->zf_dnode->dn_datablkshift;
+	int64_t delta = (int64_t)(blkid - zf->zf_last_blkid);
+	int64_t prev = zf->zf_last_delta;
+	zstream_t *zs;
+
+	ASSERT(MUTEX_HELD(&zf->zf_lock));
+
+	zf->zf_last_blkid = blkid;
+	zf->zf_last_delta = delta;
+
+	/* Repeated, overlapping and sequential accesses are not strides. */
+	if (delta != prev || delta == 0 ||
+	    (delta > 0 && delta <= (int64_t)nblks))
+		return (NULL);
+	if ((delta > 0 ? delta : -delta) > (zfetch_max_stride >> dbs))
+		return (NULL);
+
+	zs = dmu_zfetch_stream_create(zf, UINT64_MAX);
+	if (zs == NULL)
+		return (NULL);
+	zs->zs_stride = delta;
+	zs->zs_last = blkid - delta;
+	zs->zs_pf_start = zs->zs_pf_end = blkid + delta;
+	zs->zs_ipf_start = zs->zs_ipf_end = 0;
+	zf->zf_last_delta = 0;
+	return (zs);
+}
+
+/*
+ * Process a hit of strided stream zs by an access of nblks blocks at blkid.
+ * Grows the prefetch distance like for sequential streams and extends the
+ * window of strided accesses to prefetch.  Returns B_TRUE if the stream
+ * should be passed to dmu_zfetch_run(), in which case references for the
+ * caller have been taken.
+ */
+static boolean_t
+dmu_zfetch_stride_hit(zfetch_t *zf, zstream_t *zs, uint64_t blkid,
+    uint64_t nblks, boolean_t fetch_data, uint64_t maxblkid)
+{
+	unsigned int dbs = zf->zf_dnode->dn_datablkshift;
+	int64_t stride = zs->zs_stride;
+	int64_t next = (int64_t)blkid + stride;
+
+	ASSERT(MUTEX_HELD(&zf->zf_lock));
+	ASSERT3S(stride, !=, 0);
+
+	zs->zs_last = blkid;
+	zs->zs_nblks = nblks;
+	zs->zs_atime = gethrestime_sec();
+	if (stride < 0)
+		ZFETCHSTAT_BUMP(zfetchstat_reverse);
+	else
+		ZFETCHSTAT_BUMP(zfetchstat_strided);
+
+	/* The pattern has walked off the end of the file. */
+	if (next > (int64_t)maxblkid || next + (int64_t)nblks <= 0) {
+		dmu_zfetch_stream_remove(zf, zs);
+		return (B_FALSE);
+	}
+	if (!fetch_data || nblks == 0)
+		return (B_FALSE);
+
+	unsigned int nbytes = nblks << dbs;
+	if (unlikely(zs->zs_pf_dist < nbytes))
+		zs->zs_pf_dist = nbytes;
+	else if (zs->zs_pf_dist < zfetch_min_distance)
+		zs->zs_pf_dist *= 2;
+	if (zs->zs_pf_dist > zfetch_max_distance)
+		zs->zs_pf_dist = zfetch_max_distance;
+
+	int64_t ahead = MAX(1, zs->zs_pf_dist / nbytes);
+	int64_t end = next + stride * ahead;
+	int64_t pf_end = (int64_t)zs->zs_pf_end;
+	if (stride > 0 ? pf_end < next : pf_end > next)
+		zs->zs_pf_start = zs->zs_pf_end = next;
+	if (stride > 0 ? (int64_t)zs->zs_pf_end < end :
+	    (int64_t)zs->zs_pf_end > end)
+		zs->zs_pf_end = end;
+
+	zfs_refcount_add(&zs->zs_refs, NULL);
+	zfs_refcount_add(&zs->zs_callers, NULL);
+	return (B_TRUE);
+}
+
+/*
+ * Random reads of a large object pay for a chain of dependent indirect
+ * block reads on most misses.  Once the object is seen as randomly read,
+ * either by ZFETCH_RANDOM_MISSES consecutive accesses matching no stream
+ * or by advice, sweep the level 1 indirect blocks over the region touched
+ * so far, a few per access, so that later reads need only one I/O.  Data
+ * blocks are not prefetched.  Returns the range of level 1 blocks to
+ * prefetch in *startp and *endp, or B_FALSE if there are none.
+ */
+static boolean_t
+dmu_zfetch_random(zfetch_t *zf, uint64_t blkid, uint64_t maxblkid,
+    int64_t *startp, int64_t *endp)
+{
+	dnode_t *dn = zf->zf_dnode;
+
+	ASSERT(MUTEX_HELD(&zf->zf_lock));
+
+	if (zf->zf_random < ZFETCH_RANDOM_MISSES)
+		zf->zf_random++;
+	if (zfetch_random_min_size == 0 || dn->dn_nlevels < 2 ||
+	    maxblkid < (zfetch_random_min_size >> dn->dn_datablkshift))
+		return (B_FALSE);
+	if (zf->zf_random < ZFETCH_RANDOM_MISSES &&
+	    zf->zf_advice != DMU_ADVICE_RANDOM)
+		return (B_FALSE);
+
+	int epbs = dn->dn_indblkshift - SPA_BLKPTRSHIFT;
+	uint64_t l1blkid = blkid >> epbs;
+	if (l1blkid < zf->zf_rnd_lo) {
+		zf->zf_rnd_lo = l1blkid;
+		zf->zf_rnd_next = l1blkid;
+	}
+	if (l1blkid > zf->zf_rnd_hi)
+		zf->zf_rnd_hi = l1blkid;
+	if (zf->zf_rnd_next > zf->zf_rnd_hi)
+		return (B_FALSE);
+
+	*startp = zf->zf_rnd_next;
+	*endp = MIN(zf->zf_rnd_hi + 1, zf->zf_rnd_next + ZFETCH_RANDOM_L1S);
+	zf->zf_rnd_next = *endp;
+	ZFETCHSTAT_BUMP(zfetchstat_random);
+	return (B_TRUE);
+}
+
 /*
  * This is the predictive prefetch entry point.  dmu_zfetch_prepare()
  * associates dnode access specified with blkid and nblks arguments with
@@ -474,6 +615,8 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	spa_t *spa = zf->zf_dnode->dn_objset->os_spa;
 	zfs_prefetch_type_t os_prefetch = zf->zf_dnode->dn_objset->os_prefetch;
 	int64_t ipf_start, ipf_end;
+	int64_t rnd_start = 0, rnd_end = 0;
+	uint64_t req_nblks = nblks;
 
 	if (zfs_prefetch_disable || os_prefetch == ZFS_PREFETCH_NONE)
 		return (NULL);
@@ -522,6 +665,11 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	uint64_t end_blkid = blkid + nblks;
 	for (zs = list_head(&zf->zf_stream); zs != NULL;
 	    zs = list_next(&zf->zf_stream, zs)) {
+		if (zs->zs_stride != 0) {
+			if (blkid == zs->zs_last + zs->zs_stride)
+				goto stride;
+			continue;
+		}
 		if (blkid == zs->zs_blkid) {
 			goto hit;
 		} else if (blkid + 1 == zs->zs_blkid) {
@@ -542,6 +690,8 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	uint_t t = gethrestime_sec() - zfetch_max_sec_reap;
 	for (zs = list_head(&zf->zf_stream); zs != NULL;
 	    zs = list_next(&zf->zf_stream, zs)) {
+		if (zs->zs_stride != 0)
+			continue;
 		if (blkid > zs->zs_blkid) {
 			if (end_blkid <= zs->zs_blkid + max_reorder) {
 				if (!fetch_data) {
@@ -565,6 +715,9 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 		    (int)(zs->zs_atime - t) >= 0) {
 			ZFETCHSTAT_BUMP(zfetchstat_past);
 			zs->zs_atime = gethrestime_sec();
+			zs = dmu_zfetch_stride_detect(zf, blkid, req_nblks);
+			if (zs != NULL)
+				goto stride;
 			goto out;
 		}
 	}
@@ -574,23 +727,50 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	 * stream for it unless we are at the end of file.
 	 */
 	ASSERT0P(zs);
+	(void) dmu_zfetch_random(zf, blkid, maxblkid, &rnd_start, &rnd_end);
+	if (zf->zf_advice == DMU_ADVICE_RANDOM) {
+		mutex_exit(&zf->zf_lock);
+		ZFETCHSTAT_BUMP(zfetchstat_misses);
+		ipf_start = 0;
+		goto prescient;
+	}
+	zs = dmu_zfetch_stride_detect(zf, blkid, req_nblks);
+	if (zs != NULL)
+		goto stride;
 	if (end_blkid < maxblkid)
-		dmu_zfetch_stream_create(zf, end_blkid);
+		(void) dmu_zfetch_stream_create(zf, end_blkid);
 	mutex_exit(&zf->zf_lock);
 	ZFETCHSTAT_BUMP(zfetchstat_misses);
 	ipf_start = 0;
 	goto prescient;
 
+stride:
+	if (!dmu_zfetch_stride_hit(zf, zs, blkid, req_nblks, fetch_data,
+	    maxblkid))
+		goto out;
+	zf->zf_random = 0;
+	mutex_exit(&zf->zf_lock);
+	ipf_start = 0;
+	goto prescient;
+
 hit:
 	nblks = dmu_zfetch_hit(zs, nblks);
 	ZFETCHSTAT_BUMP(zfetchstat_hits);
+	zf->zf_random = 0;
 
 future:
 	zs->zs_atime = gethrestime_sec();
 
-	/* Exit if we already prefetched for this position before. */
-	if (nblks == 0)
+	/*
+	 * Exit if we already prefetched for this position before.  An access
+	 * that only got recorded for the future may still be strided.
+	 */
+	if (nblks == 0) {
+		zs = dmu_zfetch_stride_detect(zf, blkid, req_nblks);
+		if (zs != NULL)
+			goto stride;
 		goto out;
+	}
 
 	/* If the file is ending, remove the stream. */
 	end_blkid = zs->zs_blkid;
@@ -613,16 +793,20 @@ out:
 	 *
 	 * Don't double the distance beyond single block if we have more
 	 * than ~6% of ARC held by active prefetches.  It should help with
-	 * getting out of RAM on some badly mispredicted read patterns.
+	 * getting out of RAM on some badly mispredicted read patterns.  With
+	 * sequential access advised, start right at zfetch_min_distance.
 	 */
 	unsigned int nbytes = nblks << dbs;
 	unsigned int pf_nblks;
 	if (fetch_data) {
-		if (unlikely(zs->zs_pf_dist < nbytes))
+		if (zf->zf_advice == DMU_ADVICE_SEQUENTIAL &&
+		    zs->zs_pf_dist < zfetch_min_distance)
+			zs->zs_pf_dist = MAX(nbytes, zfetch_min_distance);
+		else if (unlikely(zs->zs_pf_dist < nbytes))
 			zs->zs_pf_dist = nbytes;
 		else if (zs->zs_pf_dist < zfetch_min_distance &&
 		    (zs->zs_pf_dist < (1 << dbs) ||
-		    aggsum_compare(&zfetch_sums.zfetchstat_io_active,
+		    aggsum_compare(&zfetchstat_io_active,
 		    arc_c_max >> (4 + dbs)) < 0))
 			zs->zs_pf_dist *= 2;
 		else if (zs->zs_more)
@@ -680,6 +864,10 @@ prescient:
 		issued += dbuf_prefetch(zf->zf_dnode, 1, iblk,
 		    ZIO_PRIORITY_SYNC_READ, ARC_FLAG_PRESCIENT_PREFETCH);
 	}
+	for (int64_t iblk = rnd_start; iblk < rnd_end; iblk++) {
+		issued += dbuf_prefetch(zf->zf_dnode, 1, iblk,
+		    ZIO_PRIORITY_ASYNC_READ, 0);
+	}
 
 	if (!have_lock)
 		rw_exit(&zf->zf_dnode->dn_struct_rwlock);
@@ -688,6 +876,77 @@ prescient:
 	return (zs);
 }
 
+/*
+ * Number of blocks of the strided access of nblks blocks at start that are
+ * inside the file.
+ */
+static uint64_t
+dmu_zfetch_stride_nblks(int64_t start, uint64_t nblks, uint64_t maxblkid)
+{
+	int64_t lo = MAX(start, 0);
+	int64_t hi = MIN(start + (int64_t)nblks - 1, (int64_t)maxblkid);
+
+	return (hi >= lo ? hi - lo + 1 : 0);
+}
+
+/*
+ * dmu_zfetch_run() for strided streams; called with zf_lock held and
+ * drops it.
+ */
+static void
+dmu_zfetch_run_stride(zfetch_t *zf, zstream_t *zs, boolean_t have_lock,
+    boolean_t uncached)
+{
+	uint64_t maxblkid = zf->zf_dnode->dn_maxblkid;
+	int64_t stride = zs->zs_stride;
+	uint64_t nblks = zs->zs_nblks;
+	int64_t start, end;
+	int issued = 0;
+
+	ASSERT(MUTEX_HELD(&zf->zf_lock));
+
+	if (zs->zs_missed) {
+		start = zs->zs_pf_start;
+		end = zs->zs_pf_start = zs->zs_pf_end;
+	} else {
+		start = end = 0;
+	}
+	mutex_exit(&zf->zf_lock);
+
+	/* Every block we pass to dbuf_prefetch_impl() holds a reference. */
+	for (int64_t s = start; stride > 0 ? s < end : s > end; s += stride)
+		issued += dmu_zfetch_stride_nblks(s, nblks, maxblkid);
+	if (issued > 1) {
+		zfs_refcount_add_few(&zs->zs_refs, issued - 1, NULL);
+	} else if (issued == 0) {
+		if (zfs_refcount_remove(&zs->zs_refs, NULL) == 0)
+			dmu_zfetch_stream_fini(zs);
+		return;
+	}
+	aggsum_add(&zfetchstat_io_active, issued);
+
+	if (!have_lock)
+		rw_enter(&zf->zf_dnode->dn_struct_rwlock, RW_READER);
+
+	issued = 0;
+	for (int64_t s = start; stride > 0 ? s < end : s > end; s += stride) {
+		int64_t blk = MAX(s, 0);
+		int64_t n = dmu_zfetch_stride_nblks(s, nblks, maxblkid);
+
+		for (; n > 0; n--, blk++) {
+			issued += dbuf_prefetch_impl(zf->zf_dnode, 0, blk,
+			    ZIO_PRIORITY_ASYNC_READ, uncached ?
+			    ARC_FLAG_UNCACHED : 0, dmu_zfetch_done, zs);
+		}
+	}
+
+	if (!have_lock)
+		rw_exit(&zf->zf_dnode->dn_struct_rwlock);
+
+	if (issued)
+		ZFETCHSTAT_ADD(zfetchstat_io_issued, issued);
+}
+
 void
 dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
     boolean_t have_lock, boolean_t uncached)
@@ -711,6 +970,10 @@ dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
 	}
 
 	mutex_enter(&zf->zf_lock);
+	if (zs->zs_stride != 0) {
+		dmu_zfetch_run_stride(zf, zs, have_lock, uncached);
+		return;
+	}
 	if (zs->zs_missed) {
 		pf_start = zs->zs_pf_start;
 		pf_end = zs->zs_pf_start = zs->zs_pf_end;
@@ -737,7 +1000,7 @@ dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
 			dmu_zfetch_stream_fini(zs);
 		return;
 	}
-	aggsum_add(&zfetch_sums.zfetchstat_io_active, issued);
+	aggsum_add(&zfetchstat_io_active, issued);
 
 	if (!have_lock)
 		rw_enter(&zf->zf_dnode->dn_struct_rwlock, RW_READER);
@@ -797,3 +1060,9 @@ ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, max_reorder, UINT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, hole_shift, UINT, ZMOD_RW,
 	"Max log2 fraction of holes in a stream");
+
+ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, max_stride, UINT, ZMOD_RW,
+	"Max distance in bytes between strided accesses to prefetch for");
+
+ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, random_min_size, U64, ZMOD_RW,
+	"Min object size in bytes to prefetch indirects for random reads");
@@ -1581,6 +1581,20 @@ dnode_hold_impl(objset_t *os, uint64_t object, int flag, int slots,
 
 		if (DN_SLOT_IS_PTR(dnh->dnh_dnode)) {
 			dn = dnh->dnh_dnode;
+
+			/*
+			 * If the dnode already has holds, they keep it from
+			 * being evicted, so another one can be added without
+			 * dn_mtx.  Only the first hold, which also holds the
+			 * dbuf, needs to be serialized with the last release.
+			 */
+			if (!(flag & DNODE_DRY_RUN) &&
+			    dn->dn_type != DMU_OT_NONE &&
+			    dn->dn_free_txg == 0 &&
+			    zfs_refcount_add_if_held(&dn->dn_holds, tag)) {
+				DNODE_STAT_BUMP(dnode_hold_alloc_hits);
+				goto held;
+			}
 		} else if (dnh->dnh_dnode == DN_SLOT_INTERIOR) {
 			DNODE_STAT_BUMP(dnode_hold_alloc_interior);
 			dnode_slots_rele(dnc, idx, slots);
@@ -1716,6 +1730,7 @@ dnode_hold_impl(objset_t *os, uint64_t object, int flag, int slots,
 
 	mutex_exit(&dn->dn_mtx);
 
+held:
 	/* Now we can rely on the hold to prevent the dnode from moving. */
 	dnode_slots_rele(dnc, idx, slots);
 
@@ -1747,19 +1762,19 @@ dnode_hold(objset_t *os, uint64_t object, const void *tag, dnode_t **dnp)
 boolean_t
 dnode_add_ref(dnode_t *dn, const void *tag)
 {
-	mutex_enter(&dn->dn_mtx);
-	if (zfs_refcount_is_zero(&dn->dn_holds)) {
-		mutex_exit(&dn->dn_mtx);
-		return (FALSE);
-	}
-	VERIFY(1 < zfs_refcount_add(&dn->dn_holds, tag));
-	mutex_exit(&dn->dn_mtx);
-	return (TRUE);
+	return (zfs_refcount_add_if_held(&dn->dn_holds, tag));
 }
 
 void
 dnode_rele(dnode_t *dn, const void *tag)
 {
+	/*
+	 * Only the last release may let the dnode be evicted, and has to
+	 * wake up waiters and release the dbuf under dn_mtx.
+	 */
+	if (zfs_refcount_remove_if_shared(&dn->dn_holds, tag))
+		return;
+
 	mutex_enter(&dn->dn_mtx);
 	dnode_rele_and_unlock(dn, tag, B_FALSE);
 }
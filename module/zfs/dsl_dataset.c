@@ -3727,6 +3727,9 @@ dsl_dataset_promote_sync(void *arg, dmu_tx_t *tx)
 		ASSERT(!dsl_prop_hascb(ds));
 	}
 
+	/* The moved snapshots are now in this dir's snapshot namespace. */
+	dsl_dir_snap_cmtime_update(dd, tx);
+
 	/*
 	 * Change space accounting.
 	 * Note, pa->*usedsnap and dd_used_breakdown[SNAP] will either
@@ -863,11 +863,12 @@ dsl_deadlist_insert_cb(void *arg, const blkptr_t *bp, boolean_t bp_freed,
 }
 
 /*
- * Merge the deadlist pointed to by 'obj' into dl.  obj will be left as
- * an empty deadlist.
+ * Merge the deadlist pointed to by 'obj' into dl.  If free_obj is set, obj
+ * is freed afterwards, otherwise it is left as an empty deadlist.
  */
-void
-dsl_deadlist_merge(dsl_deadlist_t *dl, uint64_t obj, dmu_tx_t *tx)
+static void
+dsl_deadlist_merge_impl(dsl_deadlist_t *dl, uint64_t obj, boolean_t free_obj,
+    dmu_tx_t *tx)
 {
 	zap_cursor_t zc, pzc;
 	zap_attribute_t *za, *pza;
@@ -882,6 +883,8 @@ dsl_deadlist_merge(dsl_deadlist_t *dl, uint64_t obj, dmu_tx_t *tx)
 		VERIFY0(bpobj_open(&bpo, dl->dl_os, obj));
 		VERIFY0(bpobj_iterate(&bpo, dsl_deadlist_insert_cb, dl, tx));
 		bpobj_close(&bpo);
+		if (free_obj)
+			bpobj_free(dl->dl_os, obj, tx);
 		return;
 	}
 
@@ -904,7 +907,13 @@ dsl_deadlist_merge(dsl_deadlist_t *dl, uint64_t obj, dmu_tx_t *tx)
 	    zap_cursor_advance(&zc)) {
 		dsl_deadlist_insert_bpobj(dl, za->za_first_integer,
 		    zfs_strtonum(za->za_name, NULL), tx);
-		VERIFY0(zap_remove(dl->dl_os, obj, za->za_name, tx));
+		/*
+		 * When the deadlist is about to be freed there is no need
+		 * to remove its entries one at a time, which would dirty
+		 * most of its ZAP blocks along the way.
+		 */
+		if (!free_obj)
+			VERIFY0(zap_remove(dl->dl_os, obj, za->za_name, tx));
 		if (perror == 0) {
 			dsl_deadlist_prefetch_bpobj(dl, pza->za_first_integer,
 			    zfs_strtonum(pza->za_name, NULL));
@@ -916,17 +925,43 @@ dsl_deadlist_merge(dsl_deadlist_t *dl, uint64_t obj, dmu_tx_t *tx)
 	zap_cursor_fini(&zc);
 	zap_cursor_fini(&pzc);
 
-	VERIFY0(dmu_bonus_hold(dl->dl_os, obj, FTAG, &bonus));
-	dlp = bonus->db_data;
-	dmu_buf_will_dirty(bonus, tx);
-	memset(dlp, 0, sizeof (*dlp));
-	dmu_buf_rele(bonus, FTAG);
+	if (free_obj) {
+		VERIFY0(dmu_object_free(dl->dl_os, obj, tx));
+	} else {
+		VERIFY0(dmu_bonus_hold(dl->dl_os, obj, FTAG, &bonus));
+		dlp = bonus->db_data;
+		dmu_buf_will_dirty(bonus, tx);
+		memset(dlp, 0, sizeof (*dlp));
+		dmu_buf_rele(bonus, FTAG);
+	}
 	mutex_exit(&dl->dl_lock);
 
 	zap_attribute_free(za);
 	zap_attribute_free(pza);
 }
 
+/*
+ * Merge the deadlist pointed to by 'obj' into dl.  obj will be left as
+ * an empty deadlist.
+ */
+void
+dsl_deadlist_merge(dsl_deadlist_t *dl, uint64_t obj, dmu_tx_t *tx)
+{
+	dsl_deadlist_merge_impl(dl, obj, B_FALSE, tx);
+}
+
+/*
+ * Merge the deadlist pointed to by 'obj' into dl and free it.  This is
+ * cheaper than dsl_deadlist_merge() followed by dsl_deadlist_free(), as the
+ * entries of obj are handed over in a single sequential pass without being
+ * removed from it.  obj must not be open.
+ */
+void
+dsl_deadlist_merge_free(dsl_deadlist_t *dl, uint64_t obj, dmu_tx_t *tx)
+{
+	dsl_deadlist_merge_impl(dl, obj, B_TRUE, tx);
+}
+
 /*
  * Remove entries on dl that are born > mintxg, and put them on the bpobj.
  */
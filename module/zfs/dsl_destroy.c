@@ -52,6 +52,12 @@
 
 extern int zfs_snapshot_history_enabled;
 
+/*
+ * Maximum number of snapshots destroyed per txg by
+ * dsl_destroy_snapshots_nvl(), or 0 to destroy them all in one txg.
+ */
+static uint_t zfs_destroy_snapshots_per_txg = 0;
+
 int
 dsl_destroy_snapshot_check_impl(dsl_dataset_t *ds, boolean_t defer)
 {
@@ -396,6 +402,9 @@ dsl_destroy_snapshot_sync_impl(dsl_dataset_t *ds, boolean_t defer, dmu_tx_t *tx)
 	if (ds_next->ds_deadlist.dl_oldfmt) {
 		process_old_deadlist(ds, ds_prev, ds_next,
 		    after_branch_point, tx);
+		dsl_deadlist_close(&ds->ds_deadlist);
+		dsl_deadlist_free(mos, dsl_dataset_phys(ds)->ds_deadlist_obj,
+		    tx);
 	} else {
 		/* Adjust prev's unique space. */
 		if (ds_prev && !after_branch_point) {
@@ -421,19 +430,18 @@ dsl_destroy_snapshot_sync_impl(dsl_dataset_t *ds, boolean_t defer, dmu_tx_t *tx)
 		    DD_USED_HEAD, used, comp, uncomp, tx);
 
 		/* Merge our deadlist into next's and free it. */
-		dsl_deadlist_merge(&ds_next->ds_deadlist,
+		dsl_deadlist_close(&ds->ds_deadlist);
+		dsl_deadlist_merge_free(&ds_next->ds_deadlist,
 		    dsl_dataset_phys(ds)->ds_deadlist_obj, tx);
 
 		/*
 		 * We are done with the deadlist tree (generated/used
-		 * by dsl_deadlist_move_bpobj() and dsl_deadlist_merge()).
+		 * by dsl_deadlist_move_bpobj() and dsl_deadlist_merge_free()).
 		 * Discard it to save memory.
 		 */
 		dsl_deadlist_discard_tree(&ds_next->ds_deadlist);
 	}
 
-	dsl_deadlist_close(&ds->ds_deadlist);
-	dsl_deadlist_free(mos, dsl_dataset_phys(ds)->ds_deadlist_obj, tx);
 	dmu_buf_will_dirty(ds->ds_dbuf, tx);
 	dsl_dataset_phys(ds)->ds_deadlist_obj = 0;
 
@@ -599,6 +607,12 @@ dsl_destroy_snapshot_sync(void *arg, dmu_tx_t *tx)
  * On success, all snaps will be destroyed and this will return 0.
  * On failure, no snaps will be destroyed, the errlist will be filled in,
  * and this will return an errno.
+ *
+ * With zfs_destroy_snapshots_per_txg set, the snapshots are checked in one
+ * txg but destroyed in batches over several txgs, so that very large lists
+ * do not hold up a single txg sync. A snapshot which can no longer be
+ * destroyed when its batch comes is then reported in the errlist, and the
+ * snapshots of the earlier batches stay destroyed.
  */
 int
 dsl_destroy_snapshots_nvl(nvlist_t *snaps, boolean_t defer,
@@ -623,6 +637,7 @@ dsl_destroy_snapshots_nvl(nvlist_t *snaps, boolean_t defer,
 	fnvlist_add_nvlist(arg, "snaps", snaps_normalized);
 	fnvlist_free(snaps_normalized);
 	fnvlist_add_boolean_value(arg, "defer", defer);
+	fnvlist_add_uint64(arg, "batch", zfs_destroy_snapshots_per_txg);
 
 	nvlist_t *wrapper = fnvlist_alloc();
 	fnvlist_add_nvlist(wrapper, ZCP_ARG_ARGLIST, arg);
@@ -632,6 +647,7 @@ dsl_destroy_snapshots_nvl(nvlist_t *snaps, boolean_t defer,
 	    "arg = ...\n"
 	    "snaps = arg['snaps']\n"
 	    "defer = arg['defer']\n"
+	    "batch = arg['batch']\n"
 	    "errors = { }\n"
 	    "has_errors = false\n"
 	    "for snap, v in pairs(snaps) do\n"
@@ -647,9 +663,31 @@ dsl_destroy_snapshots_nvl(nvlist_t *snaps, boolean_t defer,
 	    "if has_errors then\n"
 	    "    return errors\n"
 	    "end\n"
+	    "function next_batch(snap)\n"
+	    "    list = { }\n"
+	    "    for i = 1, batch do\n"
+	    "        snap = next(snaps, snap)\n"
+	    "        if snap == nil then\n"
+	    "            break\n"
+	    "        end\n"
+	    "        list[i] = snap\n"
+	    "    end\n"
+	    "    return list\n"
+	    "end\n"
+	    "n = 0\n"
 	    "for snap, v in pairs(snaps) do\n"
 	    "    errno = zfs.sync.destroy{snap, defer=defer}\n"
-	    "    assert(errno == 0)\n"
+	    "    if batch == 0 then\n"
+	    "        assert(errno == 0)\n"
+	    "    elseif errno ~= 0 then\n"
+	    "        errors[snap] = errno\n"
+	    "        return errors\n"
+	    "    end\n"
+	    "    n = n + 1\n"
+	    "    if n == batch then\n"
+	    "        n = 0\n"
+	    "        zfs.yield{prefetch=next_batch(snap)}\n"
+	    "    end\n"
 	    "end\n"
 	    "return { }\n";
 
@@ -1303,3 +1341,7 @@ EXPORT_SYMBOL(dsl_destroy_inconsistent);
 EXPORT_SYMBOL(dsl_dataset_user_release_tmp);
 EXPORT_SYMBOL(dsl_destroy_head_check_impl);
 #endif
+
+ZFS_MODULE_PARAM(zfs, zfs_, destroy_snapshots_per_txg, UINT, ZMOD_RW,
+	"Max snapshots destroyed per txg by a multi-snapshot destroy, "
+	"0 for no limit");
@@ -65,6 +65,13 @@
  */
 static int zvol_enforce_quotas = B_TRUE;
 
+/*
+ * Source of dd_snap_gen values.  Every dsl_dir_t instance and every change
+ * to its snapshot namespace draws a new value, so that a generation can
+ * never repeat even if the dsl_dir_t is evicted and opened again.
+ */
+static uint64_t dsl_dir_snap_gen_next = 0;
+
 /*
  * Filesystem and Snapshot Limits
  * ------------------------------
@@ -153,6 +160,7 @@ dsl_dir_evict_async(void *dbu)
 		ASSERT(!txg_list_member(&dp->dp_dirty_dirs, dd, t));
 		ASSERT(dd->dd_tempreserved[t] == 0);
 		ASSERT(dd->dd_space_towrite[t] == 0);
+		ASSERT0(dd->dd_dirty_pertxg[t]);
 	}
 
 	if (dd->dd_parent)
@@ -292,6 +300,7 @@ dsl_dir_hold_obj(dsl_pool_t *dp, uint64_t ddobj,
 			    &t);
 			dd->dd_snap_cmtime = t;
 		}
+		dd->dd_snap_gen = atomic_inc_64_nv(&dsl_dir_snap_gen_next);
 
 		dmu_buf_init_user(&dd->dd_dbu, NULL, dsl_dir_evict_async,
 		    &dd->dd_dbuf);
@@ -1171,6 +1180,7 @@ dsl_dir_sync(dsl_dir_t *dd, dmu_tx_t *tx)
 	dprintf_dd(dd, "txg=%llu towrite=%lluK\n", (u_longlong_t)tx->tx_txg,
 	    (u_longlong_t)dd->dd_space_towrite[tx->tx_txg & TXG_MASK] / 1024);
 	dd->dd_space_towrite[tx->tx_txg & TXG_MASK] = 0;
+	dd->dd_dirty_pertxg[tx->tx_txg & TXG_MASK] = 0;
 	mutex_exit(&dd->dd_lock);
 
 	/* release the hold from dsl_dir_dirty */
@@ -1190,6 +1200,36 @@ dsl_dir_space_towrite(dsl_dir_t *dd)
 	return (space);
 }
 
+/*
+ * Account for data dirtied in dd's own head dataset, as opposed to
+ * dsl_dir_willuse_space() which charges dd and all of its ancestors.  This
+ * is used by dmu_tx_delay() to tell heavy writers apart from light ones.
+ * The caller must also call dsl_dir_willuse_space(), which makes sure the
+ * counter is reset when the txg syncs.
+ */
+void
+dsl_dir_dirty_space(dsl_dir_t *dd, int64_t space, dmu_tx_t *tx)
+{
+	if (space > 0) {
+		atomic_add_64(&dd->dd_dirty_pertxg[tx->tx_txg & TXG_MASK],
+		    space);
+	}
+}
+
+/*
+ * Amount of dirty data of dd's own head dataset which has not synced yet.
+ */
+uint64_t
+dsl_dir_dirty_total(dsl_dir_t *dd)
+{
+	uint64_t dirty = 0;
+
+	for (int i = 0; i < TXG_SIZE; i++)
+		dirty += atomic_load_64(&dd->dd_dirty_pertxg[i]);
+
+	return (dirty);
+}
+
 /*
  * How much space would dd have available if ancestor had delta applied
  * to it?  If ondiskonly is set, we're only interested in what's
@@ -2261,6 +2301,24 @@ dsl_dir_snap_cmtime(dsl_dir_t *dd)
 	return (t);
 }
 
+/*
+ * Returns a value which changes whenever a snapshot of this dsl_dir is
+ * created, destroyed or renamed.  Unlike dd_snap_cmtime it is only kept in
+ * core, but it is never reused, so it can be used to validate caches of
+ * the snapshot namespace.
+ */
+uint64_t
+dsl_dir_snap_gen(dsl_dir_t *dd)
+{
+	uint64_t gen;
+
+	mutex_enter(&dd->dd_lock);
+	gen = dd->dd_snap_gen;
+	mutex_exit(&dd->dd_lock);
+
+	return (gen);
+}
+
 void
 dsl_dir_snap_cmtime_update(dsl_dir_t *dd, dmu_tx_t *tx)
 {
@@ -2270,6 +2328,7 @@ dsl_dir_snap_cmtime_update(dsl_dir_t *dd, dmu_tx_t *tx)
 
 	mutex_enter(&dd->dd_lock);
 	dd->dd_snap_cmtime = t;
+	dd->dd_snap_gen = atomic_inc_64_nv(&dsl_dir_snap_gen_next);
 	if (spa_feature_is_enabled(dp->dp_spa,
 	    SPA_FEATURE_EXTENSIBLE_DATASET)) {
 		objset_t *mos = dd->dd_pool->dp_meta_objset;
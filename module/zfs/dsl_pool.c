@@ -34,6 +34,7 @@
 #include <sys/dsl_synctask.h>
 #include <sys/dsl_scan.h>
 #include <sys/dnode.h>
+#include <sys/dbuf.h>
 #include <sys/dmu_tx.h>
 #include <sys/dmu_objset.h>
 #include <sys/arc.h>
@@ -119,6 +120,13 @@ uint64_t zfs_wrlog_data_max = 0;
  */
 static uint_t zfs_dirty_data_sync_percent = 20;
 
+/*
+ * Maximum amount of data of a quiesced txg that may be written out early,
+ * while the previous txg is still syncing (see dsl_pool_early_write()).
+ * Zero disables early writes.
+ */
+static uint64_t zfs_txg_early_write_max = 0;
+
 /*
  * Once there is this amount of dirty data, the dmu_tx_delay() will kick in
  * and delay each transaction.
@@ -126,6 +134,13 @@ static uint_t zfs_dirty_data_sync_percent = 20;
  */
 uint_t zfs_delay_min_dirty_percent = 60;
 
+/*
+ * When non-zero, datasets holding less than this percentage of the pool's
+ * dirty data are considered light writers, and their transaction delay is
+ * scaled down in proportion to their share.  See dmu_tx_delay().
+ */
+uint_t zfs_delay_fair_share_percent = 0;
+
 /*
  * This controls how quickly the delay approaches infinity.
  * Larger values cause it to delay more for a given amount of dirty data.
@@ -541,6 +556,8 @@ dsl_pool_create(spa_t *spa, nvlist_t *zplprops __attribute__((unused)),
 	if (dcp != NULL && dcp->cp_crypt != ZIO_CRYPT_OFF &&
 	    dcp->cp_crypt != ZIO_CRYPT_INHERIT)
 		spa_feature_enable(spa, SPA_FEATURE_ENCRYPTION, tx);
+	if (dcp != NULL && dcp->cp_crypt == ZIO_CRYPT_CHACHA20_POLY1305)
+		spa_feature_enable(spa, SPA_FEATURE_CHACHA20_POLY1305, tx);
 
 	/* create the root dataset */
 	obj = dsl_dataset_create_sync_dd(dp->dp_root_dir, NULL, dcp, 0, tx);
@@ -682,6 +699,7 @@ dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 	dsl_dataset_t *ds;
 	objset_t *mos = dp->dp_meta_objset;
 	list_t synced_datasets;
+	hrtime_t start = gethrtime();
 
 	list_create(&synced_datasets, sizeof (dsl_dataset_t),
 	    offsetof(dsl_dataset_t, ds_synced_link));
@@ -814,8 +832,12 @@ dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 		dp->dp_mos_uncompressed_delta = 0;
 	}
 
+	spa_sync_phase_add(dp->dp_spa, SPA_SYNC_PHASE_DATASETS, start);
+
 	if (dmu_objset_is_dirty(mos, txg)) {
+		start = gethrtime();
 		dsl_pool_sync_mos(dp, tx);
+		spa_sync_phase_add(dp->dp_spa, SPA_SYNC_PHASE_MOS, start);
 	}
 
 	/*
@@ -849,8 +871,10 @@ dsl_pool_sync(dsl_pool_t *dp, uint64_t txg)
 		 * were syncing.
 		 */
 		ASSERT3U(spa_sync_pass(dp->dp_spa), ==, 1);
+		start = gethrtime();
 		while ((dst = txg_list_remove(&dp->dp_sync_tasks, txg)) != NULL)
 			dsl_sync_task_sync(dst, tx);
+		spa_sync_phase_add(dp->dp_spa, SPA_SYNC_PHASE_TASKS, start);
 	}
 
 	dmu_tx_commit(tx);
@@ -1456,6 +1480,149 @@ dsl_pool_config_held_writer(dsl_pool_t *dp)
 	return (RRW_WRITE_HELD(&dp->dp_config_rwlock));
 }
 
+#define	EARLY_WRITE_BATCH	64
+
+static void
+dsl_pool_early_write_done(zgd_t *zgd, int error)
+{
+	(void) error;
+
+	dmu_buf_rele(zgd->zgd_db, zgd);
+	kmem_free(zgd->zgd_bp, sizeof (blkptr_t));
+	kmem_free(zgd, sizeof (zgd_t));
+}
+
+/*
+ * Collect up to EARLY_WRITE_BATCH level 0 dirty records from the given list
+ * of dirty records (descending into those of indirect blocks) which have
+ * not been written out yet.  A hold is taken on the dbuf of each of them.
+ */
+static void
+dsl_pool_early_write_collect(list_t *list, zgd_t **zgds, int *countp)
+{
+	for (dbuf_dirty_record_t *dr = list_head(list);
+	    dr != NULL && *countp < EARLY_WRITE_BATCH;
+	    dr = list_next(list, dr)) {
+		dmu_buf_impl_t *db = dr->dr_dbuf;
+
+		if (db->db_level > 0) {
+			mutex_enter(&dr->dt.di.dr_mtx);
+			dsl_pool_early_write_collect(&dr->dt.di.dr_children,
+			    zgds, countp);
+			mutex_exit(&dr->dt.di.dr_mtx);
+			continue;
+		}
+
+		if (db->db_blkid == DMU_BONUS_BLKID ||
+		    db->db_blkid == DMU_SPILL_BLKID ||
+		    dr->dt.dl.dr_data == NULL || dr->dt.dl.dr_brtwrite ||
+		    dr->dt.dl.dr_has_raw_params ||
+		    dr->dt.dl.dr_override_state != DR_NOT_OVERRIDDEN)
+			continue;
+
+		zgd_t *zgd = kmem_zalloc(sizeof (zgd_t), KM_SLEEP);
+		zgd->zgd_bp = kmem_zalloc(sizeof (blkptr_t), KM_SLEEP);
+		zgd->zgd_db = &db->db;
+		dbuf_add_ref(db, zgd);
+		zgds[(*countp)++] = zgd;
+	}
+}
+
+/*
+ * Write out the dirty level 0 blocks of a dnode early.  Returns B_FALSE
+ * once no more early writes should be issued for this txg.
+ */
+static boolean_t
+dsl_pool_early_write_dnode(dsl_pool_t *dp, dnode_t *dn, uint64_t txg,
+    zio_t *pio, uint64_t *issuedp)
+{
+	zgd_t *zgds[EARLY_WRITE_BATCH];
+	int count, issued;
+
+	do {
+		if (*issuedp >= zfs_txg_early_write_max ||
+		    dp->dp_tx.tx_syncing_txg == 0)
+			return (B_FALSE);
+
+		count = 0;
+		mutex_enter(&dn->dn_mtx);
+		dsl_pool_early_write_collect(&dn->dn_dirty_records[txg &
+		    TXG_MASK], zgds, &count);
+		mutex_exit(&dn->dn_mtx);
+
+		issued = 0;
+		for (int i = 0; i < count; i++) {
+			uint64_t size = zgds[i]->zgd_db->db_size;
+			int error = dmu_sync(pio, txg,
+			    dsl_pool_early_write_done, zgds[i]);
+			if (error == 0) {
+				*issuedp += size;
+				issued++;
+			} else {
+				dsl_pool_early_write_done(zgds[i], error);
+			}
+		}
+	} while (count == EARLY_WRITE_BATCH && issued > 0);
+
+	return (B_TRUE);
+}
+
+/*
+ * Called by the quiesce thread once txg has been quiesced but before it is
+ * handed to the sync thread, while the previous txg is still syncing.  On
+ * high latency storage the sync thread spends a good part of spa_sync()
+ * waiting for the final passes and the uberblock and label writes of the
+ * previous txg.  Use that time to start writing out the file and volume data
+ * of this txg, the same way dmu_sync() does for the ZIL: the blocks are
+ * written and their dirty records overridden, so that dbuf_sync_leaf() only
+ * has to record the block pointers when this txg syncs.
+ *
+ * No new changes can be made to txg at this point, and spa_sync() waits for
+ * the writes (issued as children of spa_txg_zio) before syncing it, so the
+ * ordering of the on-disk state is unchanged.  We stop as soon as the sync
+ * thread becomes idle, so that the sync of this txg is not delayed.  Datasets
+ * using dedup are skipped, as dmu_sync() writes are not deduplicated.
+ */
+void
+dsl_pool_early_write(dsl_pool_t *dp, uint64_t txg)
+{
+	spa_t *spa = dp->dp_spa;
+	uint64_t issued = 0;
+	zio_t *pio;
+
+	if (zfs_txg_early_write_max == 0 || txg > spa_freeze_txg(spa))
+		return;
+
+	pio = spa->spa_txg_zio[txg & TXG_MASK];
+
+	for (dsl_dataset_t *ds = txg_list_head(&dp->dp_dirty_datasets, txg);
+	    ds != NULL; ds = txg_list_next(&dp->dp_dirty_datasets, ds, txg)) {
+		objset_t *os = ds->ds_objset;
+		multilist_t *ml = &os->os_dirty_dnodes[txg & TXG_MASK];
+
+		if (os->os_dedup_checksum != ZIO_CHECKSUM_OFF)
+			continue;
+
+		for (unsigned int i = 0; i < multilist_get_num_sublists(ml);
+		    i++) {
+			multilist_sublist_t *mls =
+			    multilist_sublist_lock_idx(ml, i);
+			for (dnode_t *dn = multilist_sublist_head(mls);
+			    dn != NULL; dn = multilist_sublist_next(mls, dn)) {
+				if (dn->dn_type != DMU_OT_PLAIN_FILE_CONTENTS &&
+				    dn->dn_type != DMU_OT_ZVOL)
+					continue;
+				if (!dsl_pool_early_write_dnode(dp, dn, txg,
+				    pio, &issued)) {
+					multilist_sublist_unlock(mls);
+					return;
+				}
+			}
+			multilist_sublist_unlock(mls);
+		}
+	}
+}
+
 EXPORT_SYMBOL(dsl_pool_config_enter);
 EXPORT_SYMBOL(dsl_pool_config_exit);
 
@@ -1470,6 +1637,9 @@ ZFS_MODULE_PARAM(zfs, zfs_, dirty_data_max_max_percent, UINT, ZMOD_RD,
 ZFS_MODULE_PARAM(zfs, zfs_, delay_min_dirty_percent, UINT, ZMOD_RW,
 	"Transaction delay threshold");
 
+ZFS_MODULE_PARAM(zfs, zfs_, delay_fair_share_percent, UINT, ZMOD_RW,
+	"Dirty data share below which a dataset's tx delay is reduced");
+
 ZFS_MODULE_PARAM(zfs, zfs_, dirty_data_max, U64, ZMOD_RW,
 	"Determines the dirty space limit");
 
@@ -1486,6 +1656,9 @@ ZFS_MODULE_PARAM(zfs, zfs_, dirty_data_sync_percent, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs, zfs_, delay_scale, U64, ZMOD_RW,
 	"How quickly delay approaches infinity");
 
+ZFS_MODULE_PARAM(zfs_txg, zfs_txg_, early_write_max, U64, ZMOD_RW,
+	"Max bytes of a quiesced txg to write while the previous one syncs");
+
 ZFS_MODULE_PARAM(zfs_zil, zfs_zil_, clean_taskq_nthr_pct, INT, ZMOD_RW,
 	"Max percent of CPUs that are used per dp_sync_taskq");
 
@@ -83,8 +83,8 @@ dsl_prop_known_index(zfs_prop_t prop, uint64_t value)
 	return (-1);
 }
 
-int
-dsl_prop_get_dd(dsl_dir_t *dd, const char *propname,
+static int
+dsl_prop_get_dd_impl(dsl_dir_t *dd, const char *propname,
     int intsz, int numints, void *buf, char *setpoint, boolean_t snapshot)
 {
 	int err;
@@ -188,6 +188,89 @@ dsl_prop_get_dd(dsl_dir_t *dd, const char *propname,
 	return (err);
 }
 
+static int
+dsl_prop_cache_compare(const void *arg1, const void *arg2)
+{
+	const dsl_prop_cache_t *pc1 = arg1;
+	const dsl_prop_cache_t *pc2 = arg2;
+
+	int cmp = strcmp(pc1->pc_propname, pc2->pc_propname);
+	if (cmp != 0)
+		return (TREE_ISIGN(cmp));
+
+	return (TREE_CMP(pc1->pc_snapshot, pc2->pc_snapshot));
+}
+
+/*
+ * Resolving a property walks the dsl_dir's ancestors with several ZAP
+ * lookups at each level.  The effective values of integer properties are
+ * therefore cached per dsl_dir, and the whole cache is invalidated by
+ * bumping dp_prop_gen whenever a property is changed or a dsl_dir is moved
+ * to a new parent.  Both happen with dp_config_rwlock held for write, so
+ * a reader holding the config lock always sees a consistent generation.
+ */
+int
+dsl_prop_get_dd(dsl_dir_t *dd, const char *propname,
+    int intsz, int numints, void *buf, char *setpoint, boolean_t snapshot)
+{
+	dsl_prop_cache_t search, *pc;
+	uint64_t gen = dd->dd_pool->dp_prop_gen;
+	avl_index_t where;
+	char *sp;
+	int err;
+
+	if (intsz != 8 || numints != 1) {
+		return (dsl_prop_get_dd_impl(dd, propname, intsz, numints,
+		    buf, setpoint, snapshot));
+	}
+
+	ASSERT(dsl_pool_config_held(dd->dd_pool));
+
+	search.pc_propname = propname;
+	search.pc_snapshot = snapshot;
+
+	mutex_enter(&dd->dd_prop_cache_lock);
+	pc = avl_find(&dd->dd_prop_cache, &search, NULL);
+	if (pc != NULL && pc->pc_gen == gen) {
+		err = pc->pc_err;
+		if (err == 0)
+			*(uint64_t *)buf = pc->pc_value;
+		if (setpoint != NULL)
+			(void) strlcpy(setpoint, pc->pc_setpoint, MAXNAMELEN);
+		mutex_exit(&dd->dd_prop_cache_lock);
+		return (err);
+	}
+	mutex_exit(&dd->dd_prop_cache_lock);
+
+	sp = kmem_alloc(MAXNAMELEN, KM_SLEEP);
+	err = dsl_prop_get_dd_impl(dd, propname, intsz, numints, buf, sp,
+	    snapshot);
+	if (setpoint != NULL)
+		(void) strlcpy(setpoint, sp, MAXNAMELEN);
+
+	/* Don't cache transient errors such as EIO. */
+	if (err == 0 || err == ENOENT) {
+		mutex_enter(&dd->dd_prop_cache_lock);
+		pc = avl_find(&dd->dd_prop_cache, &search, &where);
+		if (pc == NULL) {
+			pc = kmem_alloc(sizeof (dsl_prop_cache_t), KM_SLEEP);
+			pc->pc_propname = spa_strdup(propname);
+			pc->pc_snapshot = snapshot;
+			avl_insert(&dd->dd_prop_cache, pc, where);
+		} else {
+			spa_strfree(pc->pc_setpoint);
+		}
+		pc->pc_gen = gen;
+		pc->pc_err = err;
+		pc->pc_value = (err == 0) ? *(uint64_t *)buf : 0;
+		pc->pc_setpoint = spa_strdup(sp);
+		mutex_exit(&dd->dd_prop_cache_lock);
+	}
+	kmem_free(sp, MAXNAMELEN);
+
+	return (err);
+}
+
 int
 dsl_prop_get_ds(dsl_dataset_t *ds, const char *propname,
     int intsz, int numints, void *buf, char *setpoint)
@@ -285,12 +368,17 @@ dsl_prop_init(dsl_dir_t *dd)
 {
 	list_create(&dd->dd_props, sizeof (dsl_prop_record_t),
 	    offsetof(dsl_prop_record_t, pr_node));
+	mutex_init(&dd->dd_prop_cache_lock, NULL, MUTEX_DEFAULT, NULL);
+	avl_create(&dd->dd_prop_cache, dsl_prop_cache_compare,
+	    sizeof (dsl_prop_cache_t), offsetof(dsl_prop_cache_t, pc_node));
 }
 
 void
 dsl_prop_fini(dsl_dir_t *dd)
 {
 	dsl_prop_record_t *pr;
+	dsl_prop_cache_t *pc;
+	void *cookie = NULL;
 
 	while ((pr = list_remove_head(&dd->dd_props)) != NULL) {
 		list_destroy(&pr->pr_cbs);
@@ -298,6 +386,14 @@ dsl_prop_fini(dsl_dir_t *dd)
 		kmem_free(pr, sizeof (dsl_prop_record_t));
 	}
 	list_destroy(&dd->dd_props);
+
+	while ((pc = avl_destroy_nodes(&dd->dd_prop_cache, &cookie)) != NULL) {
+		spa_strfree((char *)pc->pc_propname);
+		spa_strfree(pc->pc_setpoint);
+		kmem_free(pc, sizeof (dsl_prop_cache_t));
+	}
+	avl_destroy(&dd->dd_prop_cache);
+	mutex_destroy(&dd->dd_prop_cache_lock);
 }
 
 /*
@@ -597,6 +693,8 @@ dsl_prop_notify_all(dsl_dir_t *dd)
 {
 	dsl_pool_t *dp = dd->dd_pool;
 	ASSERT(RRW_WRITE_HELD(&dp->dp_config_rwlock));
+	/* Values inherited from the old ancestors are no longer valid. */
+	dp->dp_prop_gen++;
 	(void) dmu_objset_find_dp(dp, dd->dd_object, dsl_prop_notify_all_cb,
 	    NULL, DS_FIND_CHILDREN);
 }
@@ -844,6 +942,13 @@ dsl_prop_set_sync_impl(dsl_dataset_t *ds, const char *propname,
 	kmem_strfree(recvdstr);
 	kmem_strfree(iuvstr);
 
+	/*
+	 * Snapshot properties are looked up in the snapshot's own ZAP before
+	 * consulting the (cached) dsl_dir chain, so they need no invalidation.
+	 */
+	if (!ds->ds_is_snapshot)
+		ds->ds_dir->dd_pool->dp_prop_gen++;
+
 	/*
 	 * If we are left with an empty snap zap we can destroy it.
 	 * This will prevent unnecessary calls to zap_lookup() in
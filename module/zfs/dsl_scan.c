@@ -37,6 +37,7 @@
 #include <sys/dnode.h>
 #include <sys/dmu_tx.h>
 #include <sys/dmu_objset.h>
+#include <sys/dmu_traverse.h>
 #include <sys/arc.h>
 #include <sys/arc_impl.h>
 #include <sys/zap.h>
@@ -122,7 +123,9 @@ typedef int (scan_cb_t)(dsl_pool_t *, const blkptr_t *,
 static scan_cb_t dsl_scan_scrub_cb;
 
 static int scan_ds_queue_compare(const void *a, const void *b);
+static int scan_ds_queue_prio_compare(const void *a, const void *b);
 static int scan_prefetch_queue_compare(const void *a, const void *b);
+static int scan_prefetch_lba_queue_compare(const void *a, const void *b);
 static void scan_ds_queue_clear(dsl_scan_t *scn);
 static void scan_ds_prefetch_queue_clear(dsl_scan_t *scn);
 static boolean_t scan_ds_queue_contains(dsl_scan_t *scn, uint64_t dsobj,
@@ -132,6 +135,7 @@ static void scan_ds_queue_remove(dsl_scan_t *scn, uint64_t dsobj);
 static void scan_ds_queue_sync(dsl_scan_t *scn, dmu_tx_t *tx);
 static uint64_t dsl_scan_count_data_disks(spa_t *spa);
 static void read_by_block_level(dsl_scan_t *scn, zbookmark_phys_t zb);
+static void dsl_destroy_prefetch_stop(dsl_scan_t *scn);
 
 extern uint_t zfs_vdev_async_write_active_min_dirty_percent;
 static int zfs_scan_blkstats = 0;
@@ -200,7 +204,33 @@ static uint_t zfs_free_min_time_ms = 1000;
 /* minimum milliseconds to resilver per txg */
 static uint_t zfs_resilver_min_time_ms = 3000;
 
+/*
+ * Adaptive scan pacing.  When zfs_scan_target_slowdown_pct is non-zero,
+ * the per-txg minimum scan time and the per-vdev issue limit are scaled
+ * each txg between SCAN_THROTTLE_MIN_PCT and SCAN_THROTTLE_MAX_PCT of
+ * their tunables.  The scale grows quickly while no leaf vdev has seen
+ * foreground I/O for zfs_scan_idle_ms, grows slowly while foreground
+ * latency is within the target slowdown of its scan-free baseline, and
+ * shrinks when any leaf vdev exceeds it.
+ */
+static uint_t zfs_scan_target_slowdown_pct = 0;
+static uint_t zfs_scan_idle_ms = 100;
+
+#define	SCAN_THROTTLE_MIN_PCT	10
+#define	SCAN_THROTTLE_MAX_PCT	400
+
 static uint_t zfs_scan_checkpoint_intval = 7200; /* in seconds */
+
+/*
+ * Metadata-first scanning.  When set, metadata prefetch I/Os are issued in
+ * on-disk (LBA) order instead of traversal order, and the periodic scan
+ * checkpoint is skipped, so that the metadata traversal runs to completion
+ * (or until the memory limit forces clearing) before the sorted data I/Os
+ * are issued.  This replaces the random metadata I/O at the start of a
+ * scrub with mostly sequential reads, at the cost of losing more progress
+ * if the pool is exported or the system reboots during the traversal.
+ */
+static int zfs_scan_metadata_first = B_FALSE;
 int zfs_scan_suspend_progress = 0; /* set to prevent scans from progressing */
 static int zfs_no_scrub_io = B_FALSE; /* set to disable scrub i/o */
 static int zfs_no_scrub_prefetch = B_FALSE; /* set to disable scrub prefetch */
@@ -210,6 +240,18 @@ static uint64_t zfs_async_block_max_blocks = UINT64_MAX;
 /* max number of dedup blocks to free in a single TXG */
 static uint64_t zfs_max_async_dedup_frees = 100000;
 
+/*
+ * Between txgs, up to zfs_async_destroy_prefetch_threads workers walk ahead
+ * of the async destroy bookmark of the pending bptree entries in open
+ * context, reading in the indirect and dnode blocks that the next
+ * dsl_process_async_destroys() will traverse.  A single destroyed dataset
+ * is split by object number among the workers.  Each worker stops after
+ * zfs_async_destroy_prefetch_blocks blocks or when the next sync begins,
+ * so they never touch blocks that may already have been freed.
+ */
+static uint_t zfs_async_destroy_prefetch_threads = 4;
+static uint64_t zfs_async_destroy_prefetch_blocks = 100000;
+
 /* set to disable resilver deferring */
 static int zfs_resilver_disable_defer = B_FALSE;
 
@@ -243,6 +285,9 @@ static int zfs_free_bpobj_enabled = 1;
 /* Error blocks to be scrubbed in one txg. */
 static uint_t zfs_scrub_error_blocks_per_txg = 1 << 12;
 
+/* Threads resolving and reading error blocks concurrently. */
+static uint_t zfs_scrub_error_threads = 8;
+
 /* the order has to match pool_scan_type */
 static scan_cb_t *scan_funcs[POOL_SCAN_FUNCS] = {
 	NULL,
@@ -254,7 +299,9 @@ static scan_cb_t *scan_funcs[POOL_SCAN_FUNCS] = {
 typedef struct {
 	uint64_t	sds_dsobj;
 	uint64_t	sds_txg;
-	avl_node_t	sds_node;
+	uint64_t	sds_prio;	/* resilver_priority of the dataset */
+	avl_node_t	sds_node;	/* link into scn_queue */
+	avl_node_t	sds_prio_node;	/* link into scn_queue_prio */
 } scan_ds_t;
 
 /*
@@ -352,11 +399,15 @@ typedef struct scan_prefetch_ctx {
 /* private data for dsl_scan_prefetch() */
 typedef struct scan_prefetch_issue_ctx {
 	avl_node_t spic_avl_node;	/* link into scn->scn_prefetch_queue */
+	avl_node_t spic_lba_node;	/* link into scn_prefetch_lba_queue */
 	scan_prefetch_ctx_t *spic_spc;	/* spc for the callback */
 	blkptr_t spic_bp;		/* bp to prefetch */
 	zbookmark_phys_t spic_zb;	/* bookmark to prefetch */
 } scan_prefetch_issue_ctx_t;
 
+/* maximum number of prefetch IOs issued per arc_read_many() call */
+#define	SCAN_PREFETCH_BATCH	16
+
 static void scan_exec_io(dsl_pool_t *dp, const blkptr_t *bp, int zio_flags,
     const zbookmark_phys_t *zb, dsl_scan_io_queue_t *queue);
 static void scan_io_queue_insert_impl(dsl_scan_io_queue_t *queue,
@@ -498,10 +549,18 @@ dsl_scan_init(dsl_pool_t *dp, uint64_t txg)
 
 	avl_create(&scn->scn_queue, scan_ds_queue_compare, sizeof (scan_ds_t),
 	    offsetof(scan_ds_t, sds_node));
+	avl_create(&scn->scn_queue_prio, scan_ds_queue_prio_compare,
+	    sizeof (scan_ds_t), offsetof(scan_ds_t, sds_prio_node));
 	mutex_init(&scn->scn_queue_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&scn->scn_destroy_pf_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&scn->scn_destroy_pf_cv, NULL, CV_DEFAULT, NULL);
 	avl_create(&scn->scn_prefetch_queue, scan_prefetch_queue_compare,
 	    sizeof (scan_prefetch_issue_ctx_t),
 	    offsetof(scan_prefetch_issue_ctx_t, spic_avl_node));
+	avl_create(&scn->scn_prefetch_lba_queue,
+	    scan_prefetch_lba_queue_compare,
+	    sizeof (scan_prefetch_issue_ctx_t),
+	    offsetof(scan_prefetch_issue_ctx_t, spic_lba_node));
 
 	err = zap_lookup(dp->dp_meta_objset, DMU_POOL_DIRECTORY_OBJECT,
 	    "scrub_func", sizeof (uint64_t), 1, &f);
@@ -654,12 +713,21 @@ dsl_scan_fini(dsl_pool_t *dp)
 
 		if (scn->scn_taskq != NULL)
 			taskq_destroy(scn->scn_taskq);
+		if (scn->scn_errorscrub_taskq != NULL)
+			taskq_destroy(scn->scn_errorscrub_taskq);
+		dsl_destroy_prefetch_stop(scn);
+		if (scn->scn_destroy_pf_taskq != NULL)
+			taskq_destroy(scn->scn_destroy_pf_taskq);
+		mutex_destroy(&scn->scn_destroy_pf_lock);
+		cv_destroy(&scn->scn_destroy_pf_cv);
 
 		scan_ds_queue_clear(scn);
 		avl_destroy(&scn->scn_queue);
+		avl_destroy(&scn->scn_queue_prio);
 		mutex_destroy(&scn->scn_queue_lock);
 		scan_ds_prefetch_queue_clear(scn);
 		avl_destroy(&scn->scn_prefetch_queue);
+		avl_destroy(&scn->scn_prefetch_lba_queue);
 
 		kmem_free(dp->dp_scan, sizeof (dsl_scan_t));
 		dp->dp_scan = NULL;
@@ -1474,11 +1542,50 @@ scan_ds_queue_compare(const void *a, const void *b)
 	return (1);
 }
 
+/*
+ * The dataset queue is also kept sorted by descending resilver_priority,
+ * which is the order dsl_scan_visit() takes datasets from it.  Datasets of
+ * equal priority are visited in object number order.
+ */
+static int
+scan_ds_queue_prio_compare(const void *a, const void *b)
+{
+	const scan_ds_t *sds_a = a, *sds_b = b;
+
+	int cmp = TREE_CMP(sds_b->sds_prio, sds_a->sds_prio);
+	if (likely(cmp != 0))
+		return (cmp);
+
+	return (scan_ds_queue_compare(a, b));
+}
+
+static uint64_t
+scan_ds_priority(dsl_scan_t *scn, uint64_t dsobj)
+{
+	dsl_dataset_t *ds;
+	uint64_t prio = ZFS_RESILVER_PRIORITY_DEFAULT;
+
+	if (scn->scn_phys.scn_func != POOL_SCAN_RESILVER)
+		return (prio);
+
+	if (dsl_dataset_hold_obj(scn->scn_dp, dsobj, FTAG, &ds) == 0) {
+		if (dsl_prop_get_int_ds(ds,
+		    zfs_prop_to_name(ZFS_PROP_RESILVER_PRIORITY), &prio) != 0)
+			prio = ZFS_RESILVER_PRIORITY_DEFAULT;
+		dsl_dataset_rele(ds, FTAG);
+	}
+
+	return (prio);
+}
+
 static void
 scan_ds_queue_clear(dsl_scan_t *scn)
 {
 	void *cookie = NULL;
 	scan_ds_t *sds;
+	while (avl_destroy_nodes(&scn->scn_queue_prio, &cookie) != NULL)
+		;
+	cookie = NULL;
 	while ((sds = avl_destroy_nodes(&scn->scn_queue, &cookie)) != NULL) {
 		kmem_free(sds, sizeof (*sds));
 	}
@@ -1505,9 +1612,11 @@ scan_ds_queue_insert(dsl_scan_t *scn, uint64_t dsobj, uint64_t txg)
 	sds = kmem_zalloc(sizeof (*sds), KM_SLEEP);
 	sds->sds_dsobj = dsobj;
 	sds->sds_txg = txg;
+	sds->sds_prio = scan_ds_priority(scn, dsobj);
 
 	VERIFY3P(avl_find(&scn->scn_queue, sds, &where), ==, NULL);
 	avl_insert(&scn->scn_queue, sds, where);
+	avl_add(&scn->scn_queue_prio, sds);
 }
 
 static void
@@ -1520,6 +1629,7 @@ scan_ds_queue_remove(dsl_scan_t *scn, uint64_t dsobj)
 	sds = avl_find(&scn->scn_queue, &srch, NULL);
 	VERIFY(sds != NULL);
 	avl_remove(&scn->scn_queue, sds);
+	avl_remove(&scn->scn_queue_prio, sds);
 	kmem_free(sds, sizeof (*sds));
 }
 
@@ -1631,6 +1741,79 @@ dsl_scan_should_clear(dsl_scan_t *scn)
 		return (scn->scn_clearing);
 }
 
+static void
+dsl_scan_throttle_walk(vdev_t *vd, hrtime_t now, boolean_t *busy,
+    uint64_t *slowdown)
+{
+	if (!vd->vdev_ops->vdev_op_leaf) {
+		for (uint64_t i = 0; i < vd->vdev_children; i++) {
+			dsl_scan_throttle_walk(vd->vdev_child[i], now, busy,
+			    slowdown);
+		}
+		return;
+	}
+
+	hrtime_t base, last;
+	hrtime_t lat = vdev_queue_fg_latency(vd, &base, &last);
+
+	if (last == 0 || now - last > MSEC2NSEC(zfs_scan_idle_ms))
+		return;
+
+	*busy = B_TRUE;
+	if (base > 0 && lat > base) {
+		*slowdown = MAX(*slowdown,
+		    (uint64_t)(lat - base) * 100 / base);
+	}
+}
+
+/*
+ * Adjust scn_throttle_pct once per txg from the foreground latency and
+ * idleness of all leaf vdevs.  See zfs_scan_target_slowdown_pct.
+ */
+static void
+dsl_scan_throttle_update(dsl_scan_t *scn)
+{
+	spa_t *spa = scn->scn_dp->dp_spa;
+	uint_t pct = scn->scn_throttle_pct;
+	boolean_t busy = B_FALSE;
+	uint64_t slowdown = 0;
+
+	if (zfs_scan_target_slowdown_pct == 0) {
+		scn->scn_throttle_pct = 100;
+		return;
+	}
+	if (pct == 0)
+		pct = 100;
+
+	ASSERT(spa_config_held(spa, SCL_CONFIG, RW_READER));
+	dsl_scan_throttle_walk(spa->spa_root_vdev, gethrtime(), &busy,
+	    &slowdown);
+
+	if (!busy)
+		pct *= 2;
+	else if (slowdown > zfs_scan_target_slowdown_pct)
+		pct -= pct / 4;
+	else
+		pct += SCAN_THROTTLE_MIN_PCT;
+
+	scn->scn_throttle_pct = MIN(MAX(pct, SCAN_THROTTLE_MIN_PCT),
+	    SCAN_THROTTLE_MAX_PCT);
+}
+
+/*
+ * Minimum time to spend scanning per txg, scaled by the adaptive pacing.
+ */
+static uint_t
+dsl_scan_min_time_ms(const dsl_scan_t *scn)
+{
+	uint_t mintime = (scn->scn_phys.scn_func == POOL_SCAN_RESILVER) ?
+	    zfs_resilver_min_time_ms : zfs_scrub_min_time_ms;
+
+	if (scn->scn_throttle_pct == 0)
+		return (mintime);
+	return ((uint64_t)mintime * scn->scn_throttle_pct / 100);
+}
+
 static boolean_t
 dsl_scan_check_suspend(dsl_scan_t *scn, const zbookmark_phys_t *zb)
 {
@@ -1668,8 +1851,7 @@ dsl_scan_check_suspend(dsl_scan_t *scn, const zbookmark_phys_t *zb)
 	    scn->scn_dp->dp_spa->spa_sync_starttime;
 	uint64_t dirty_min_bytes = zfs_dirty_data_max *
 	    zfs_vdev_async_write_active_min_dirty_percent / 100;
-	uint_t mintime = (scn->scn_phys.scn_func == POOL_SCAN_RESILVER) ?
-	    zfs_resilver_min_time_ms : zfs_scrub_min_time_ms;
+	uint_t mintime = dsl_scan_min_time_ms(scn);
 
 	if ((NSEC2MSEC(scan_time_ns) > mintime &&
 	    (scn->scn_dp->dp_dirty_total >= dirty_min_bytes ||
@@ -1862,6 +2044,28 @@ scan_prefetch_queue_compare(const void *a, const void *b)
 	    spc_b->spc_indblkshift, &spic_a->spic_zb, &spic_b->spic_zb));
 }
 
+/*
+ * For metadata-first scanning the same prefetch IOs are also sorted by the
+ * location of their first DVA, so that they can be issued in LBA order.
+ * Identical DVAs reached through different bookmarks (e.g. snapshots) are
+ * ordered by bookmark.
+ */
+static int
+scan_prefetch_lba_queue_compare(const void *a, const void *b)
+{
+	const scan_prefetch_issue_ctx_t *spic_a = a, *spic_b = b;
+	const dva_t *dva_a = &spic_a->spic_bp.blk_dva[0];
+	const dva_t *dva_b = &spic_b->spic_bp.blk_dva[0];
+
+	int cmp = TREE_CMP(DVA_GET_VDEV(dva_a), DVA_GET_VDEV(dva_b));
+	if (likely(cmp == 0))
+		cmp = TREE_CMP(DVA_GET_OFFSET(dva_a), DVA_GET_OFFSET(dva_b));
+	if (cmp == 0)
+		cmp = scan_prefetch_queue_compare(a, b);
+
+	return (cmp);
+}
+
 static void
 scan_prefetch_ctx_rele(scan_prefetch_ctx_t *spc, const void *tag)
 {
@@ -1907,6 +2111,10 @@ scan_ds_prefetch_queue_clear(dsl_scan_t *scn)
 	scan_prefetch_issue_ctx_t *spic = NULL;
 
 	mutex_enter(&spa->spa_scrub_lock);
+	while (avl_destroy_nodes(&scn->scn_prefetch_lba_queue,
+	    &cookie) != NULL)
+		;
+	cookie = NULL;
 	while ((spic = avl_destroy_nodes(&scn->scn_prefetch_queue,
 	    &cookie)) != NULL) {
 		scan_prefetch_ctx_rele(spic->spic_spc, scn);
@@ -1978,6 +2186,7 @@ dsl_scan_prefetch(scan_prefetch_ctx_t *spc, blkptr_t *bp, zbookmark_phys_t *zb)
 	}
 
 	avl_insert(&scn->scn_prefetch_queue, spic, idx);
+	avl_add(&scn->scn_prefetch_lba_queue, spic);
 	cv_broadcast(&spa->spa_scrub_io_cv);
 	mutex_exit(&spa->spa_scrub_lock);
 }
@@ -2087,12 +2296,12 @@ dsl_scan_prefetch_thread(void *arg)
 	dsl_scan_t *scn = arg;
 	spa_t *spa = scn->scn_dp->dp_spa;
 	scan_prefetch_issue_ctx_t *spic;
+	scan_prefetch_issue_ctx_t *batch[SCAN_PREFETCH_BATCH];
+	arc_read_req_t reqs[SCAN_PREFETCH_BATCH];
 
 	/* loop until we are told to stop */
 	while (!scn->scn_prefetch_stop) {
-		arc_flags_t flags = ARC_FLAG_NOWAIT |
-		    ARC_FLAG_PRESCIENT_PREFETCH | ARC_FLAG_PREFETCH;
-		int zio_flags = ZIO_FLAG_CANFAIL | ZIO_FLAG_SCAN_THREAD;
+		uint_t count = 0;
 
 		mutex_enter(&spa->spa_scrub_lock);
 
@@ -2112,32 +2321,63 @@ dsl_scan_prefetch_thread(void *arg)
 			break;
 		}
 
-		/* remove the prefetch IO from the tree */
-		spic = avl_first(&scn->scn_prefetch_queue);
-		spa->spa_scrub_inflight += BP_GET_PSIZE(&spic->spic_bp);
-		avl_remove(&scn->scn_prefetch_queue, spic);
+		/*
+		 * Remove as many prefetch IOs from the tree as the in flight
+		 * limit allows, up to a batch, so that they can be issued
+		 * together without retaking spa_scrub_lock for each one.
+		 * Metadata-first scans take them in LBA order rather than in
+		 * the order the traversal will need them.
+		 */
+		do {
+			if (zfs_scan_metadata_first)
+				spic = avl_first(&scn->scn_prefetch_lba_queue);
+			else
+				spic = avl_first(&scn->scn_prefetch_queue);
+			spa->spa_scrub_inflight += BP_GET_PSIZE(&spic->spic_bp);
+			avl_remove(&scn->scn_prefetch_queue, spic);
+			avl_remove(&scn->scn_prefetch_lba_queue, spic);
+			batch[count++] = spic;
+		} while (count < SCAN_PREFETCH_BATCH &&
+		    avl_numnodes(&scn->scn_prefetch_queue) != 0 &&
+		    spa->spa_scrub_inflight < scn->scn_maxinflight_bytes);
 
 		mutex_exit(&spa->spa_scrub_lock);
 
-		if (BP_IS_PROTECTED(&spic->spic_bp)) {
-			ASSERT(BP_GET_TYPE(&spic->spic_bp) == DMU_OT_DNODE ||
-			    BP_GET_TYPE(&spic->spic_bp) == DMU_OT_OBJSET);
-			ASSERT3U(BP_GET_LEVEL(&spic->spic_bp), ==, 0);
-			zio_flags |= ZIO_FLAG_RAW;
-		}
+		for (uint_t i = 0; i < count; i++) {
+			arc_read_req_t *req = &reqs[i];
+			blkptr_t *bp = &batch[i]->spic_bp;
+
+			req->arr_bp = bp;
+			req->arr_zb = &batch[i]->spic_zb;
+			req->arr_private = batch[i]->spic_spc;
+			req->arr_flags = ARC_FLAG_NOWAIT |
+			    ARC_FLAG_PRESCIENT_PREFETCH | ARC_FLAG_PREFETCH;
+			req->arr_zio_flags = ZIO_FLAG_CANFAIL |
+			    ZIO_FLAG_SCAN_THREAD;
+
+			if (BP_IS_PROTECTED(bp)) {
+				ASSERT(BP_GET_TYPE(bp) == DMU_OT_DNODE ||
+				    BP_GET_TYPE(bp) == DMU_OT_OBJSET);
+				ASSERT3U(BP_GET_LEVEL(bp), ==, 0);
+				req->arr_zio_flags |= ZIO_FLAG_RAW;
+			}
 
-		/* We don't need data L1 buffer since we do not prefetch L0. */
-		blkptr_t *bp = &spic->spic_bp;
-		if (BP_GET_LEVEL(bp) == 1 && BP_GET_TYPE(bp) != DMU_OT_DNODE &&
-		    BP_GET_TYPE(bp) != DMU_OT_OBJSET)
-			flags |= ARC_FLAG_NO_BUF;
+			/*
+			 * We don't need data L1 buffer since we do not
+			 * prefetch L0.
+			 */
+			if (BP_GET_LEVEL(bp) == 1 &&
+			    BP_GET_TYPE(bp) != DMU_OT_DNODE &&
+			    BP_GET_TYPE(bp) != DMU_OT_OBJSET)
+				req->arr_flags |= ARC_FLAG_NO_BUF;
+		}
 
-		/* issue the prefetch asynchronously */
-		(void) arc_read(scn->scn_zio_root, spa, bp,
-		    dsl_scan_prefetch_cb, spic->spic_spc, ZIO_PRIORITY_SCRUB,
-		    zio_flags, &flags, &spic->spic_zb);
+		/* issue the prefetches asynchronously */
+		(void) arc_read_many(scn->scn_zio_root, spa, reqs, count,
+		    dsl_scan_prefetch_cb, ZIO_PRIORITY_SCRUB);
 
-		kmem_free(spic, sizeof (scan_prefetch_issue_ctx_t));
+		for (uint_t i = 0; i < count; i++)
+			kmem_free(batch[i], sizeof (scan_prefetch_issue_ctx_t));
 	}
 
 	ASSERT(scn->scn_prefetch_stop);
@@ -2146,10 +2386,12 @@ dsl_scan_prefetch_thread(void *arg)
 	mutex_enter(&spa->spa_scrub_lock);
 	while ((spic = avl_first(&scn->scn_prefetch_queue)) != NULL) {
 		avl_remove(&scn->scn_prefetch_queue, spic);
+		avl_remove(&scn->scn_prefetch_lba_queue, spic);
 		scan_prefetch_ctx_rele(spic->spic_spc, scn);
 		kmem_free(spic, sizeof (scan_prefetch_issue_ctx_t));
 	}
 	ASSERT0(avl_numnodes(&scn->scn_prefetch_queue));
+	ASSERT0(avl_numnodes(&scn->scn_prefetch_lba_queue));
 	mutex_exit(&spa->spa_scrub_lock);
 }
 
@@ -3155,10 +3397,11 @@ dsl_scan_visit(dsl_scan_t *scn, dmu_tx_t *tx)
 	memset(&scn->scn_phys.scn_bookmark, 0, sizeof (zbookmark_phys_t));
 
 	/*
-	 * Keep pulling things out of the dataset avl queue. Updates to the
-	 * persistent zap-object-as-queue happen only at checkpoints.
+	 * Keep pulling things out of the dataset avl queue, highest
+	 * resilver_priority first. Updates to the persistent
+	 * zap-object-as-queue happen only at checkpoints.
 	 */
-	while ((sds = avl_first(&scn->scn_queue)) != NULL) {
+	while ((sds = avl_first(&scn->scn_queue_prio)) != NULL) {
 		dsl_dataset_t *ds;
 		uint64_t dsobj = sds->sds_dsobj;
 		uint64_t txg = sds->sds_txg;
@@ -3237,8 +3480,7 @@ scan_io_queue_check_suspend(dsl_scan_t *scn)
 	    scn->scn_dp->dp_spa->spa_sync_starttime;
 	uint64_t dirty_min_bytes = zfs_dirty_data_max *
 	    zfs_vdev_async_write_active_min_dirty_percent / 100;
-	uint_t mintime = (scn->scn_phys.scn_func == POOL_SCAN_RESILVER) ?
-	    zfs_resilver_min_time_ms : zfs_scrub_min_time_ms;
+	uint_t mintime = dsl_scan_min_time_ms(scn);
 
 	return ((NSEC2MSEC(scan_time_ns) > mintime &&
 	    (scn->scn_dp->dp_dirty_total >= dirty_min_bytes ||
@@ -3450,6 +3692,11 @@ scan_io_queues_run_one(void *arg)
 	/* Calculate maximum in-flight bytes for this vdev. */
 	queue->q_maxinflight_bytes = MAX(1, zfs_scan_vdev_limit *
 	    (vdev_get_ndisks(queue->q_vd) - vdev_get_nparity(queue->q_vd)));
+	if (queue->q_scn->scn_throttle_pct != 0) {
+		queue->q_maxinflight_bytes = MAX(1,
+		    queue->q_maxinflight_bytes *
+		    queue->q_scn->scn_throttle_pct / 100);
+	}
 
 	/* reset per-queue scan statistics for this txg */
 	queue->q_total_seg_size_this_txg = 0;
@@ -3784,6 +4031,195 @@ dsl_scan_need_resilver(spa_t *spa, const dva_t *dva, size_t psize,
 	return (B_TRUE);
 }
 
+typedef struct destroy_prefetch {
+	dsl_scan_t	*dpf_scn;
+	blkptr_t	dpf_bp;		/* root of the destroyed objset */
+	uint64_t	dpf_birth_txg;	/* only blocks born after this txg */
+	zbookmark_phys_t dpf_zb;	/* where to start walking */
+	uint64_t	dpf_end_object;	/* first object of the next slice */
+	uint_t		dpf_slices;	/* number of slices to split into */
+	uint64_t	dpf_blocks;	/* blocks read so far */
+} destroy_prefetch_t;
+
+static int
+dsl_destroy_prefetch_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
+    const zbookmark_phys_t *zb, const dnode_phys_t *dnp, void *arg)
+{
+	(void) spa, (void) zilog, (void) dnp;
+	destroy_prefetch_t *dpf = arg;
+
+	if (dpf->dpf_scn->scn_destroy_pf_cancel)
+		return (SET_ERROR(EINTR));
+	if (zb->zb_level == ZB_DNODE_LEVEL || BP_IS_HOLE(bp) ||
+	    BP_IS_REDACTED(bp))
+		return (0);
+	if (zb->zb_object != DMU_META_DNODE_OBJECT &&
+	    zb->zb_object >= dpf->dpf_end_object)
+		return (SET_ERROR(EINTR));
+
+	/*
+	 * The traversal reads indirect and dnode blocks itself before
+	 * visiting their children; level 0 data blocks are never read.
+	 */
+	if (BP_GET_LEVEL(bp) > 0 || BP_GET_TYPE(bp) == DMU_OT_DNODE) {
+		if (++dpf->dpf_blocks >= zfs_async_destroy_prefetch_blocks)
+			return (SET_ERROR(EINTR));
+	}
+	return (0);
+}
+
+static void
+dsl_destroy_prefetch_done(dsl_scan_t *scn, destroy_prefetch_t *dpf)
+{
+	kmem_free(dpf, sizeof (destroy_prefetch_t));
+
+	mutex_enter(&scn->scn_destroy_pf_lock);
+	ASSERT3U(scn->scn_destroy_pf_active, >, 0);
+	if (--scn->scn_destroy_pf_active == 0)
+		cv_broadcast(&scn->scn_destroy_pf_cv);
+	mutex_exit(&scn->scn_destroy_pf_lock);
+}
+
+static boolean_t
+dsl_destroy_prefetch_dispatch(dsl_scan_t *scn, task_func_t func,
+    destroy_prefetch_t *dpf)
+{
+	mutex_enter(&scn->scn_destroy_pf_lock);
+	scn->scn_destroy_pf_active++;
+	mutex_exit(&scn->scn_destroy_pf_lock);
+
+	if (taskq_dispatch(scn->scn_destroy_pf_taskq, func, dpf,
+	    TQ_NOSLEEP) == TASKQID_INVALID) {
+		dsl_destroy_prefetch_done(scn, dpf);
+		return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+static void
+dsl_destroy_prefetch_slice(void *arg)
+{
+	destroy_prefetch_t *dpf = arg;
+	dsl_scan_t *scn = dpf->dpf_scn;
+	zbookmark_phys_t zb = dpf->dpf_zb;
+	fstrans_cookie_t cookie = spl_fstrans_mark();
+
+	(void) traverse_dataset_destroyed(scn->scn_dp->dp_spa, &dpf->dpf_bp,
+	    dpf->dpf_birth_txg, &zb, TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA |
+	    TRAVERSE_NO_DECRYPT, dsl_destroy_prefetch_cb, dpf);
+
+	spl_fstrans_unmark(cookie);
+	dsl_destroy_prefetch_done(scn, dpf);
+}
+
+/*
+ * Split the objects of one destroyed dataset that remain after its bookmark
+ * into dpf_slices ranges, hand all but the first to other workers, and walk
+ * the first one here.
+ */
+static void
+dsl_destroy_prefetch_entry(void *arg)
+{
+	destroy_prefetch_t *dpf = arg;
+	dsl_scan_t *scn = dpf->dpf_scn;
+	spa_t *spa = scn->scn_dp->dp_spa;
+	uint64_t first = dpf->dpf_zb.zb_object;
+	uint64_t nobjs = 0;
+
+	if (dpf->dpf_slices > 1 && !BP_IS_HOLE(&dpf->dpf_bp)) {
+		zbookmark_phys_t czb;
+		zio_flag_t zio_flags = ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE;
+		arc_flags_t aflags = ARC_FLAG_WAIT;
+		arc_buf_t *buf;
+
+		if (BP_IS_PROTECTED(&dpf->dpf_bp))
+			zio_flags |= ZIO_FLAG_RAW;
+		SET_BOOKMARK(&czb, ZB_DESTROYED_OBJSET, ZB_ROOT_OBJECT,
+		    ZB_ROOT_LEVEL, ZB_ROOT_BLKID);
+		if (arc_read(NULL, spa, &dpf->dpf_bp, arc_getbuf_func, &buf,
+		    ZIO_PRIORITY_ASYNC_READ, zio_flags, &aflags, &czb) == 0) {
+			objset_phys_t *osp = buf->b_data;
+			nobjs = (osp->os_meta_dnode.dn_maxblkid + 1) <<
+			    DNODES_PER_BLOCK_SHIFT;
+			arc_buf_destroy(buf, &buf);
+		}
+	}
+
+	if (nobjs > first + DNODES_PER_BLOCK) {
+		uint64_t stride = P2ROUNDUP(
+		    howmany(nobjs - first, dpf->dpf_slices), DNODES_PER_BLOCK);
+
+		dpf->dpf_end_object = first + stride;
+		for (uint64_t obj = first + stride; obj < nobjs &&
+		    !scn->scn_destroy_pf_cancel; obj += stride) {
+			destroy_prefetch_t *sub =
+			    kmem_alloc(sizeof (*sub), KM_SLEEP);
+			*sub = *dpf;
+			SET_BOOKMARK(&sub->dpf_zb, ZB_DESTROYED_OBJSET, obj,
+			    0, 0);
+			sub->dpf_end_object = (obj + stride < nobjs) ?
+			    obj + stride : UINT64_MAX;
+			if (!dsl_destroy_prefetch_dispatch(scn,
+			    dsl_destroy_prefetch_slice, sub))
+				break;
+		}
+	}
+
+	dsl_destroy_prefetch_slice(dpf);
+}
+
+/*
+ * Stop the open context async destroy prefetch workers and wait for them.
+ * This must be done before the bptree is traversed in syncing context,
+ * since after that the workers may reach blocks that have been freed.
+ */
+static void
+dsl_destroy_prefetch_stop(dsl_scan_t *scn)
+{
+	mutex_enter(&scn->scn_destroy_pf_lock);
+	scn->scn_destroy_pf_cancel = B_TRUE;
+	while (scn->scn_destroy_pf_active > 0)
+		cv_wait(&scn->scn_destroy_pf_cv, &scn->scn_destroy_pf_lock);
+	scn->scn_destroy_pf_cancel = B_FALSE;
+	mutex_exit(&scn->scn_destroy_pf_lock);
+}
+
+static void
+dsl_destroy_prefetch_start(dsl_scan_t *scn)
+{
+	dsl_pool_t *dp = scn->scn_dp;
+	uint_t nthreads = zfs_async_destroy_prefetch_threads;
+	bptree_entry_phys_t *ents;
+	uint64_t count = nthreads;
+
+	if (nthreads == 0)
+		return;
+
+	if (scn->scn_destroy_pf_taskq == NULL) {
+		scn->scn_destroy_pf_taskq = taskq_create("z_destroy_pf",
+		    nthreads, minclsyspri, 1, INT_MAX, TASKQ_DYNAMIC);
+	}
+
+	ents = kmem_alloc(count * sizeof (*ents), KM_SLEEP);
+	if (bptree_get_entries(dp->dp_meta_objset, dp->dp_bptree_obj, ents,
+	    &count) == 0) {
+		for (uint64_t i = 0; i < count; i++) {
+			destroy_prefetch_t *dpf =
+			    kmem_zalloc(sizeof (*dpf), KM_SLEEP);
+			dpf->dpf_scn = scn;
+			dpf->dpf_bp = ents[i].be_bp;
+			dpf->dpf_birth_txg = ents[i].be_birth_txg;
+			dpf->dpf_zb = ents[i].be_zb;
+			dpf->dpf_end_object = UINT64_MAX;
+			dpf->dpf_slices = MAX(nthreads / count, 1);
+			if (!dsl_destroy_prefetch_dispatch(scn,
+			    dsl_destroy_prefetch_entry, dpf))
+				break;
+		}
+	}
+	kmem_free(ents, nthreads * sizeof (*ents));
+}
+
 static int
 dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 {
@@ -3791,6 +4227,8 @@ dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 	spa_t *spa = dp->dp_spa;
 	int err = 0;
 
+	dsl_destroy_prefetch_stop(scn);
+
 	if (spa_suspend_async_destroy(spa))
 		return (0);
 
@@ -3850,6 +4288,8 @@ dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 			 */
 			scn->scn_async_stalled =
 			    (scn->scn_visited_this_txg == 0);
+			if (err == ERESTART)
+				dsl_destroy_prefetch_start(scn);
 		}
 	}
 	if (scn->scn_visited_this_txg) {
@@ -4019,6 +4459,50 @@ read_by_block_level(dsl_scan_t *scn, zbookmark_phys_t zb)
 	dsl_dataset_rele(ds, FTAG);
 }
 
+typedef struct errorscrub_read {
+	dsl_scan_t		*esr_scn;
+	zbookmark_phys_t	esr_zb;
+} errorscrub_read_t;
+
+static void
+dsl_errorscrub_read_task(void *arg)
+{
+	errorscrub_read_t *esr = arg;
+	dsl_pool_t *dp = esr->esr_scn->scn_dp;
+
+	dsl_pool_config_enter(dp, FTAG);
+	read_by_block_level(esr->esr_scn, esr->esr_zb);
+	dsl_pool_config_exit(dp, FTAG);
+
+	kmem_free(esr, sizeof (*esr));
+}
+
+/*
+ * Resolve and read one error block.  Resolving the block pointer may
+ * require synchronous reads of indirect blocks and dnodes, so this is
+ * handed to scn_errorscrub_taskq and many error blocks are worked on at
+ * once.  The scrub reads themselves are children of scn_zio_root; the
+ * caller waits for the taskq and the root zio before it commits progress.
+ */
+static void
+dsl_errorscrub_read(dsl_scan_t *scn, const zbookmark_phys_t *zb)
+{
+	errorscrub_read_t *esr = kmem_alloc(sizeof (*esr), KM_SLEEP);
+
+	esr->esr_scn = scn;
+	esr->esr_zb = *zb;
+	(void) taskq_dispatch(scn->scn_errorscrub_taskq,
+	    dsl_errorscrub_read_task, esr, TQ_SLEEP);
+}
+
+static void
+dsl_errorscrub_wait(dsl_scan_t *scn)
+{
+	taskq_wait(scn->scn_errorscrub_taskq);
+	(void) zio_wait(scn->scn_zio_root);
+	scn->scn_zio_root = NULL;
+}
+
 /*
  * We keep track of the scrubbed error blocks in "count". This will be used
  * when deciding whether we exceeded zfs_scrub_error_blocks_per_txg. This
@@ -4052,13 +4536,7 @@ scrub_filesystem(spa_t *spa, uint64_t fs, zbookmark_err_phys_t *zep,
 		/* Block neither free nor re written. */
 		zbookmark_phys_t zb;
 		zep_to_zb(fs, zep, &zb);
-		scn->scn_zio_root = zio_root(spa, NULL, NULL,
-		    ZIO_FLAG_CANFAIL);
-		/* We have already acquired the config lock for spa */
-		read_by_block_level(scn, zb);
-
-		(void) zio_wait(scn->scn_zio_root);
-		scn->scn_zio_root = NULL;
+		dsl_errorscrub_read(scn, &zb);
 
 		scn->errorscrub_phys.dep_examined++;
 		scn->errorscrub_phys.dep_to_examine--;
@@ -4132,13 +4610,7 @@ scrub_filesystem(spa_t *spa, uint64_t fs, zbookmark_err_phys_t *zep,
 		if (affected) {
 			zbookmark_phys_t zb;
 			zep_to_zb(snap_obj, zep, &zb);
-			scn->scn_zio_root = zio_root(spa, NULL, NULL,
-			    ZIO_FLAG_CANFAIL);
-			/* We have already acquired the config lock for spa */
-			read_by_block_level(scn, zb);
-
-			(void) zio_wait(scn->scn_zio_root);
-			scn->scn_zio_root = NULL;
+			dsl_errorscrub_read(scn, &zb);
 
 			scn->errorscrub_phys.dep_examined++;
 			scn->errorscrub_phys.dep_to_examine--;
@@ -4213,6 +4685,13 @@ dsl_errorscrub_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 	zbookmark_phys_t *zb;
 	boolean_t limit_exceeded = B_FALSE;
 
+	if (scn->scn_errorscrub_taskq == NULL) {
+		scn->scn_errorscrub_taskq = taskq_create("z_errorscrub",
+		    MAX(zfs_scrub_error_threads, 1), minclsyspri, 1, INT_MAX,
+		    TASKQ_DYNAMIC);
+	}
+	scn->scn_zio_root = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+
 	za = zap_attribute_alloc();
 	zb = kmem_zalloc(sizeof (zbookmark_phys_t), KM_SLEEP);
 
@@ -4220,15 +4699,7 @@ dsl_errorscrub_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 		for (; zap_cursor_retrieve(&scn->errorscrub_cursor, za) == 0;
 		    zap_cursor_advance(&scn->errorscrub_cursor)) {
 			name_to_bookmark(za->za_name, zb);
-
-			scn->scn_zio_root = zio_root(dp->dp_spa, NULL,
-			    NULL, ZIO_FLAG_CANFAIL);
-			dsl_pool_config_enter(dp, FTAG);
-			read_by_block_level(scn, *zb);
-			dsl_pool_config_exit(dp, FTAG);
-
-			(void) zio_wait(scn->scn_zio_root);
-			scn->scn_zio_root = NULL;
+			dsl_errorscrub_read(scn, zb);
 
 			scn->errorscrub_phys.dep_examined += 1;
 			scn->errorscrub_phys.dep_to_examine -= 1;
@@ -4240,6 +4711,7 @@ dsl_errorscrub_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 			}
 		}
 
+		dsl_errorscrub_wait(scn);
 		if (!limit_exceeded)
 			dsl_errorscrub_done(scn, B_TRUE, tx);
 
@@ -4305,6 +4777,7 @@ dsl_errorscrub_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 
 	zap_attribute_free(za);
 	kmem_free(zb, sizeof (*zb));
+	dsl_errorscrub_wait(scn);
 	if (!limit_exceeded)
 		dsl_errorscrub_done(scn, B_TRUE, tx);
 
@@ -4407,6 +4880,7 @@ dsl_scan_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 	scn->scn_suspending = B_FALSE;
 	scn->scn_sync_start_time = gethrtime();
 	spa->spa_scrub_active = B_TRUE;
+	dsl_scan_throttle_update(scn);
 
 	/*
 	 * First process the async destroys.  If we suspend, don't do
@@ -4487,10 +4961,12 @@ dsl_scan_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 		 * scan for metadata or start issue scrub IOs. We accumulate
 		 * metadata until we hit our hard memory limit at which point
 		 * we issue scrub IOs until we are at our soft memory limit.
+		 * Metadata-first scans skip the periodic checkpoint so that
+		 * the traversal is not interrupted by data I/O.
 		 */
-		if (scn->scn_checkpointing ||
+		if (scn->scn_checkpointing || (!zfs_scan_metadata_first &&
 		    ddi_get_lbolt() - scn->scn_last_checkpoint >
-		    SEC_TO_TICK(zfs_scan_checkpoint_intval)) {
+		    SEC_TO_TICK(zfs_scan_checkpoint_intval))) {
 			if (!scn->scn_checkpointing)
 				zfs_dbgmsg("begin scan checkpoint for %s",
 				    spa->spa_name);
@@ -5313,6 +5789,12 @@ ZFS_MODULE_PARAM(zfs, zfs_, async_block_max_blocks, U64, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs, zfs_, max_async_dedup_frees, U64, ZMOD_RW,
 	"Max number of dedup blocks freed in one txg");
 
+ZFS_MODULE_PARAM(zfs, zfs_, async_destroy_prefetch_threads, UINT, ZMOD_RW,
+	"Max open context workers prefetching async destroy metadata");
+
+ZFS_MODULE_PARAM(zfs, zfs_, async_destroy_prefetch_blocks, U64, ZMOD_RW,
+	"Max metadata blocks read ahead by each async destroy worker per txg");
+
 ZFS_MODULE_PARAM(zfs, zfs_, free_bpobj_enabled, INT, ZMOD_RW,
 	"Enable processing of the free_bpobj");
 
@@ -5328,9 +5810,18 @@ ZFS_MODULE_PARAM(zfs, zfs_, scan_issue_strategy, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs, zfs_, scan_legacy, INT, ZMOD_RW,
 	"Scrub using legacy non-sequential method");
 
+ZFS_MODULE_PARAM(zfs, zfs_, scan_target_slowdown_pct, UINT, ZMOD_RW,
+	"Target foreground latency slowdown for adaptive scan pacing");
+
+ZFS_MODULE_PARAM(zfs, zfs_, scan_idle_ms, UINT, ZMOD_RW,
+	"Time without foreground I/O after which a vdev is considered idle");
+
 ZFS_MODULE_PARAM(zfs, zfs_, scan_checkpoint_intval, UINT, ZMOD_RW,
 	"Scan progress on-disk checkpointing interval");
 
+ZFS_MODULE_PARAM(zfs, zfs_, scan_metadata_first, INT, ZMOD_RW,
+	"Read scan metadata in LBA order before issuing data I/O");
+
 ZFS_MODULE_PARAM(zfs, zfs_, scan_max_ext_gap, U64, ZMOD_RW,
 	"Max gap in bytes between sequential scrub / resilver I/Os");
 
@@ -5352,5 +5843,8 @@ ZFS_MODULE_PARAM(zfs, zfs_, resilver_disable_defer, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs, zfs_, resilver_defer_percent, UINT, ZMOD_RW,
 	"Issued IO percent complete after which resilvers are deferred");
 
+ZFS_MODULE_PARAM(zfs, zfs_, scrub_error_threads, UINT, ZMOD_RW,
+	"Threads used to verify error blocks concurrently");
+
 ZFS_MODULE_PARAM(zfs, zfs_, scrub_error_blocks_per_txg, UINT, ZMOD_RW,
 	"Error blocks to be scrubbed in one txg");
@@ -29,7 +29,7 @@
 
 #include <sys/debug.h>
 #include <sys/types.h>
-#include <sys/qat.h>
+#include <sys/zio_offload.h>
 #include <sys/zio_compress.h>
 
 #ifdef _KERNEL
@@ -53,25 +53,25 @@ zfs_gzip_compress_buf(void *s_start, void *d_start, size_t s_len,
     size_t d_len, int n)
 {
 	int ret;
+	size_t c_len;
 	zlen_t dstlen = d_len;
 
 	ASSERT(d_len <= s_len);
 
 	/* check if hardware accelerator can be used */
-	if (qat_dc_use_accel(s_len)) {
-		ret = qat_compress(QAT_COMPRESS, s_start, s_len, d_start,
-		    d_len, &dstlen);
-		if (ret == CPA_STATUS_SUCCESS) {
-			return ((size_t)dstlen);
-		} else if (ret == CPA_STATUS_INCOMPRESSIBLE) {
-			if (d_len != s_len)
-				return (s_len);
-
-			memcpy(d_start, s_start, s_len);
+	ret = zio_offload_compress(ZIO_OFFLOAD_COMPRESS,
+	    ZIO_COMPRESS_GZIP_1 + n - 1, n, s_start, s_len, d_start, d_len,
+	    &c_len);
+	if (ret == 0) {
+		return (c_len);
+	} else if (ret == E2BIG) {
+		if (d_len != s_len)
 			return (s_len);
-		}
-		/* if hardware compression fails, do it again with software */
+
+		memcpy(d_start, s_start, s_len);
+		return (s_len);
 	}
+	/* if hardware compression fails, do it again with software */
 
 	if (compress_func(d_start, &dstlen, s_start, s_len, n) != Z_OK) {
 		if (d_len != s_len)
@@ -88,18 +88,17 @@ static int
 zfs_gzip_decompress_buf(void *s_start, void *d_start, size_t s_len,
     size_t d_len, int n)
 {
-	(void) n;
+	size_t c_len;
 	zlen_t dstlen = d_len;
 
 	ASSERT(d_len >= s_len);
 
 	/* check if hardware accelerator can be used */
-	if (qat_dc_use_accel(d_len)) {
-		if (qat_compress(QAT_DECOMPRESS, s_start, s_len,
-		    d_start, d_len, &dstlen) == CPA_STATUS_SUCCESS)
-			return (0);
-		/* if hardware de-compress fail, do it again with software */
-	}
+	if (zio_offload_compress(ZIO_OFFLOAD_DECOMPRESS,
+	    ZIO_COMPRESS_GZIP_1 + n - 1, n, s_start, s_len, d_start, d_len,
+	    &c_len) == 0)
+		return (0);
+	/* if hardware de-compress fail, do it again with software */
 
 	if (uncompress_func(d_start, &dstlen, s_start, s_len) != Z_OK)
 		return (-1);
@@ -207,6 +207,16 @@ static const uint32_t metaslab_min_search_count = 100;
  */
 static int metaslab_df_use_largest_segment = B_FALSE;
 
+/*
+ * When set, the data blocks of each object written in a txg are placed one
+ * after the other in a window of at least this many bytes that is kept for
+ * the object, instead of being interleaved with the blocks of the other
+ * objects written at the same time.  This keeps files written concurrently
+ * contiguous, at the cost of spreading the allocations of a txg over more
+ * of the metaslab.
+ */
+static uint64_t metaslab_stream_window = 0;
+
 /*
  * These tunables control how long a metaslab will remain loaded after the
  * last allocation from it.  A metaslab can't be unloaded until at least
@@ -228,6 +238,33 @@ uint_t metaslab_preload_limit = 10;
  */
 static int metaslab_preload_enabled = B_TRUE;
 
+/*
+ * Number of txgs of metaslab activations to preload ahead for.  Each txg
+ * metaslab_group_preload() predicts how many metaslabs the group's
+ * allocators will switch to from the recent activation rate and preloads
+ * that many of the highest weighted metaslabs, in addition to a primary
+ * and secondary for every allocator in use.
+ */
+static uint_t metaslab_preload_txgs = 4;
+
+/*
+ * Percentage of the zfs_metaslab_mem_limit budget which preloading may
+ * fill.  Beyond it only metaslabs which are forced to condense are
+ * preloaded, so preloading does not cause other metaslabs to be evicted.
+ */
+#ifdef _KERNEL
+static uint_t metaslab_preload_mem_pct = 75;
+#endif
+
+/*
+ * The btrees holding the free segments of a loaded metaslab are rebuilt
+ * with densely packed nodes when less than this percentage of their node
+ * capacity is in use.  Loading a space map and fragmenting allocations
+ * leave many half empty nodes, so compacting them allows more metaslabs to
+ * stay loaded within zfs_metaslab_mem_limit.  Zero disables compaction.
+ */
+static uint_t metaslab_compact_pct = 60;
+
 /*
  * Enable/disable fragmentation weighting on metaslabs.
  */
@@ -363,6 +400,10 @@ typedef struct metaslab_stats {
 	kstat_named_t metaslabstat_reload_tree;
 	kstat_named_t metaslabstat_too_many_tries;
 	kstat_named_t metaslabstat_try_hard;
+	kstat_named_t metaslabstat_alloc_load_waits;
+	kstat_named_t metaslabstat_preloads;
+	kstat_named_t metaslabstat_preload_over_budget;
+	kstat_named_t metaslabstat_compactions;
 } metaslab_stats_t;
 
 static metaslab_stats_t metaslab_stats = {
@@ -370,6 +411,10 @@ static metaslab_stats_t metaslab_stats = {
 	{ "reload_tree",		KSTAT_DATA_UINT64 },
 	{ "too_many_tries",		KSTAT_DATA_UINT64 },
 	{ "try_hard",			KSTAT_DATA_UINT64 },
+	{ "alloc_load_waits",		KSTAT_DATA_UINT64 },
+	{ "preloads",			KSTAT_DATA_UINT64 },
+	{ "preload_over_budget",	KSTAT_DATA_UINT64 },
+	{ "compactions",		KSTAT_DATA_UINT64 },
 };
 
 #define	METASLABSTAT_BUMP(stat) \
@@ -2437,6 +2482,27 @@ metaslab_potentially_evict(metaslab_class_t *mc)
 #endif
 }
 
+/*
+ * Repack the btrees of a loaded metaslab's free segments when they are
+ * sparsely filled, see metaslab_compact_pct.
+ */
+static void
+metaslab_compact(metaslab_t *msp)
+{
+	ASSERT(MUTEX_HELD(&msp->ms_lock));
+	ASSERT(msp->ms_loaded);
+
+	if (metaslab_compact_pct == 0)
+		return;
+
+	if (zfs_btree_compact(&msp->ms_allocatable->rt_root,
+	    metaslab_compact_pct))
+		METASLABSTAT_BUMP(metaslabstat_compactions);
+	if (zfs_btree_compact(&msp->ms_allocatable_by_size,
+	    metaslab_compact_pct))
+		METASLABSTAT_BUMP(metaslabstat_compactions);
+}
+
 static int
 metaslab_load_impl(metaslab_t *msp)
 {
@@ -2610,6 +2676,8 @@ metaslab_load_impl(metaslab_t *msp)
 		    zfs_range_tree_remove, msp->ms_allocatable);
 	}
 
+	metaslab_compact(msp);
+
 	/*
 	 * Call metaslab_recalculate_weight_and_sort() now that the
 	 * metaslab is loaded so we get the metaslab's real weight.
@@ -2729,6 +2797,7 @@ metaslab_unload(metaslab_t *msp)
 		return;
 
 	zfs_range_tree_vacate(msp->ms_allocatable, NULL, NULL);
+	memset(msp->ms_streams, 0, sizeof (msp->ms_streams));
 	msp->ms_loaded = B_FALSE;
 	msp->ms_unload_time = gethrtime();
 
@@ -3549,6 +3618,13 @@ metaslab_activate(metaslab_t *msp, int allocator, uint64_t activation_weight)
 		return (0);
 	}
 
+	/*
+	 * The allocation has to wait for the metaslab to be loaded, either
+	 * by us or by a preload which has not finished yet.
+	 */
+	if (!msp->ms_loaded)
+		METASLABSTAT_BUMP(metaslabstat_alloc_load_waits);
+
 	int error = metaslab_load(msp);
 	if (error != 0) {
 		metaslab_group_sort(msp->ms_group, msp, 0);
@@ -3598,6 +3674,8 @@ metaslab_activate(metaslab_t *msp, int allocator, uint64_t activation_weight)
 	    allocator, activation_weight)) != 0) {
 		return (error);
 	}
+	if (activation_weight != METASLAB_WEIGHT_CLAIM)
+		atomic_inc_64(&msp->ms_group->mg_activations);
 
 	ASSERT(msp->ms_loaded);
 	ASSERT(msp->ms_weight & METASLAB_ACTIVE_MASK);
@@ -3710,12 +3788,33 @@ metaslab_preload(void *arg)
 	ASSERT(!MUTEX_HELD(&msp->ms_group->mg_lock));
 
 	mutex_enter(&msp->ms_lock);
+	if (!msp->ms_loaded && !msp->ms_loading)
+		METASLABSTAT_BUMP(metaslabstat_preloads);
 	(void) metaslab_load(msp);
 	metaslab_set_selected_txg(msp, spa_syncing_txg(spa));
 	mutex_exit(&msp->ms_lock);
 	spl_fstrans_unmark(cookie);
 }
 
+/*
+ * Returns B_TRUE when loaded metaslabs use more than metaslab_preload_mem_pct
+ * of the memory which zfs_metaslab_mem_limit allows them.
+ */
+static boolean_t
+metaslab_preload_over_budget(void)
+{
+#ifdef _KERNEL
+	uint64_t allmem = arc_all_memory();
+	uint64_t inuse = spl_kmem_cache_inuse(zfs_btree_leaf_cache);
+	uint64_t size = spl_kmem_cache_entry_size(zfs_btree_leaf_cache);
+
+	return (allmem * zfs_metaslab_mem_limit / 100 *
+	    metaslab_preload_mem_pct / 100 < inuse * size);
+#else
+	return (B_FALSE);
+#endif
+}
+
 static void
 metaslab_group_preload(metaslab_group_t *mg)
 {
@@ -3724,24 +3823,42 @@ metaslab_group_preload(metaslab_group_t *mg)
 	avl_tree_t *t = &mg->mg_metaslab_tree;
 	int m = 0;
 
+	/*
+	 * Predict the number of metaslabs the allocators of this group will
+	 * need: a primary and secondary for each allocator in use, plus the
+	 * metaslabs they are expected to switch to over the next
+	 * metaslab_preload_txgs txgs at the recent activation rate.
+	 */
+	uint64_t activations = atomic_swap_64(&mg->mg_activations, 0);
+	mg->mg_activation_rate = MAX(activations,
+	    (mg->mg_activation_rate + activations) / 2);
+	uint64_t limit = MAX(metaslab_preload_limit,
+	    2 * spa->spa_alloc_active +
+	    mg->mg_activation_rate * metaslab_preload_txgs);
+
 	if (spa_shutting_down(spa) || !metaslab_preload_enabled)
 		return;
 
+	boolean_t over_budget = metaslab_preload_over_budget();
+	if (over_budget)
+		METASLABSTAT_BUMP(metaslabstat_preload_over_budget);
+
 	mutex_enter(&mg->mg_lock);
 
 	/*
-	 * Load the next potential metaslabs
+	 * Load the next potential metaslabs, which are the ones with the
+	 * highest weight.
 	 */
 	for (msp = avl_first(t); msp != NULL; msp = AVL_NEXT(t, msp)) {
 		ASSERT3P(msp->ms_group, ==, mg);
 
 		/*
-		 * We preload only the maximum number of metaslabs specified
-		 * by metaslab_preload_limit. If a metaslab is being forced
-		 * to condense then we preload it too. This will ensure
-		 * that force condensing happens in the next txg.
+		 * We preload only the predicted number of metaslabs, and
+		 * none while over the memory budget. If a metaslab is being
+		 * forced to condense then we preload it too. This will
+		 * ensure that force condensing happens in the next txg.
 		 */
-		if (++m > metaslab_preload_limit && !msp->ms_condense_wanted) {
+		if ((++m > limit || over_budget) && !msp->ms_condense_wanted) {
 			continue;
 		}
 
@@ -4586,6 +4703,9 @@ metaslab_sync_done(metaslab_t *msp, uint64_t txg)
 	}
 	metaslab_aux_histograms_update_done(msp, defer_allowed);
 
+	if (msp->ms_loaded)
+		metaslab_compact(msp);
+
 	if (msp->ms_new) {
 		msp->ms_new = B_FALSE;
 		mutex_enter(&mg->mg_lock);
@@ -4727,6 +4847,7 @@ metaslab_trace_init(zio_alloc_list_t *zal)
 	list_create(&zal->zal_list, sizeof (metaslab_alloc_trace_t),
 	    offsetof(metaslab_alloc_trace_t, mat_list_node));
 	zal->zal_size = 0;
+	zal->zal_stream = 0;
 }
 
 void
@@ -4787,11 +4908,103 @@ metaslab_group_alloc_decrement(spa_t *spa, uint64_t vdev, int allocator,
 	(void) zfs_refcount_remove_many(&mga->mga_queue_depth, psize, tag);
 }
 
+/*
+ * Find the start of a free window of the given size that does not overlap
+ * the rest of the window of any other stream, looking at the smallest free
+ * segments that fit first, to keep the large ones for larger windows.
+ */
+static uint64_t
+metaslab_stream_window_find(metaslab_t *msp, uint64_t window)
+{
+	zfs_range_tree_t *rt = msp->ms_allocatable;
+	zfs_btree_t *t = &msp->ms_allocatable_by_size;
+	zfs_btree_index_t where;
+
+	if (zfs_btree_numnodes(t) == 0)
+		metaslab_size_tree_full_load(rt);
+
+	zfs_range_seg_t *rs = metaslab_block_find(t, rt, msp->ms_start,
+	    window, window, &where);
+	for (int n = 0; rs != NULL && n < metaslab_min_search_count; n++) {
+		uint64_t start = zfs_rs_get_start(rs, rt);
+		uint64_t end = zfs_rs_get_end(rs, rt);
+		boolean_t moved;
+
+		do {
+			moved = B_FALSE;
+			for (int i = 0; i < METASLAB_STREAMS; i++) {
+				metaslab_stream_t *mss = &msp->ms_streams[i];
+				if (mss->mss_id != 0 &&
+				    start < mss->mss_end &&
+				    start + window > mss->mss_cursor) {
+					start = mss->mss_end;
+					moved = B_TRUE;
+				}
+			}
+		} while (moved && start + window <= end);
+
+		if (start + window <= end)
+			return (start);
+		rs = zfs_btree_next(t, &where, &where);
+	}
+	return (-1ULL);
+}
+
+/*
+ * Allocate the next block of a stream from its window, or from a new window
+ * if the stream has none in this metaslab or its next block is no longer
+ * free.  The least recently used slot is given to a new stream.
+ */
+static uint64_t
+metaslab_stream_alloc(metaslab_t *msp, uint64_t stream, uint64_t size)
+{
+	zfs_range_tree_t *rt = msp->ms_allocatable;
+	metaslab_stream_t *mss = NULL, *lru = &msp->ms_streams[0];
+	uint64_t ashift = msp->ms_group->mg_vd->vdev_ashift;
+	hrtime_t now = gethrtime();
+
+	ASSERT(MUTEX_HELD(&msp->ms_lock));
+	ASSERT3U(stream, !=, 0);
+
+	for (int i = 0; i < METASLAB_STREAMS; i++) {
+		if (msp->ms_streams[i].mss_id == stream) {
+			mss = &msp->ms_streams[i];
+			break;
+		}
+		if (msp->ms_streams[i].mss_used < lru->mss_used)
+			lru = &msp->ms_streams[i];
+	}
+
+	if (mss != NULL && mss->mss_cursor + size <= mss->mss_end &&
+	    zfs_range_tree_contains(rt, mss->mss_cursor, size)) {
+		uint64_t offset = mss->mss_cursor;
+		mss->mss_cursor += size;
+		mss->mss_used = now;
+		return (offset);
+	}
+
+	if (mss == NULL)
+		mss = lru;
+	mss->mss_id = 0;
+
+	uint64_t window = P2ROUNDUP(MAX(metaslab_stream_window, size),
+	    1ULL << ashift);
+	uint64_t offset = metaslab_stream_window_find(msp, window);
+	if (offset == -1ULL)
+		return (-1ULL);
+
+	mss->mss_id = stream;
+	mss->mss_cursor = offset + size;
+	mss->mss_end = offset + window;
+	mss->mss_used = now;
+	return (offset);
+}
+
 static uint64_t
 metaslab_block_alloc(metaslab_t *msp, uint64_t size, uint64_t max_size,
-    uint64_t txg, uint64_t *actual_size)
+    uint64_t txg, uint64_t stream, uint64_t *actual_size)
 {
-	uint64_t start;
+	uint64_t start = -1ULL;
 	zfs_range_tree_t *rt = msp->ms_allocatable;
 	metaslab_class_t *mc = msp->ms_group->mg_class;
 
@@ -4800,7 +5013,15 @@ metaslab_block_alloc(metaslab_t *msp, uint64_t size, uint64_t max_size,
 	VERIFY0(msp->ms_disabled);
 	VERIFY0(msp->ms_new);
 
-	start = mc->mc_ops->msop_alloc(msp, size, max_size, actual_size);
+	if (stream != 0 && metaslab_stream_window != 0) {
+		start = metaslab_stream_alloc(msp, stream, size);
+		if (start != -1ULL)
+			*actual_size = size;
+	}
+	if (start == -1ULL) {
+		start = mc->mc_ops->msop_alloc(msp, size, max_size,
+		    actual_size);
+	}
 	if (start != -1ULL) {
 		size = *actual_size;
 		metaslab_group_t *mg = msp->ms_group;
@@ -4949,6 +5170,7 @@ metaslab_group_alloc(metaslab_group_t *mg, zio_alloc_list_t *zal,
     dva_t *dva, int d, int allocator, boolean_t try_hard,
     uint64_t *actual_asize)
 {
+	spa_t *spa = mg->mg_vd->vdev_spa;
 	metaslab_t *msp = NULL;
 	uint64_t offset = -1ULL;
 
@@ -5029,7 +5251,11 @@ metaslab_group_alloc(metaslab_group_t *mg, zio_alloc_list_t *zal,
 		mutex_exit(&mg->mg_lock);
 		if (msp == NULL)
 			break;
-		mutex_enter(&msp->ms_lock);
+		wmsum_add(&spa->spa_alloc_locked, 1);
+		if (!mutex_tryenter(&msp->ms_lock)) {
+			wmsum_add(&spa->spa_alloc_contended, 1);
+			mutex_enter(&msp->ms_lock);
+		}
 
 		metaslab_active_mask_verify(msp);
 
@@ -5163,7 +5389,7 @@ metaslab_group_alloc(metaslab_group_t *mg, zio_alloc_list_t *zal,
 		}
 
 		offset = metaslab_block_alloc(msp, asize, max_asize, txg,
-		    actual_asize);
+		    zal->zal_stream, actual_asize);
 
 		if (offset != -1ULL) {
 			metaslab_trace_add(zal, mg, msp, *actual_asize, d,
@@ -6329,6 +6555,15 @@ ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, preload_enabled, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, preload_limit, UINT, ZMOD_RW,
 	"Max number of metaslabs per group to preload");
 
+ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, preload_txgs, UINT, ZMOD_RW,
+	"Number of txgs of predicted metaslab activations to preload");
+
+ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, preload_mem_pct, UINT, ZMOD_RW,
+	"Percent of the metaslab memory limit preloading may use");
+
+ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, compact_pct, UINT, ZMOD_RW,
+	"Compact free segment trees less full than this percent");
+
 ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, unload_delay, UINT, ZMOD_RW,
 	"Delay in txgs after metaslab was last used before unloading");
 
@@ -6378,6 +6613,10 @@ ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, df_max_search, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, df_use_largest_segment, INT, ZMOD_RW,
 	"When looking in size tree, use largest segment instead of exact fit");
 
+ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, stream_window, U64, ZMOD_RW,
+	"Size of the window kept for the data blocks of each object, 0 to "
+	"disable");
+
 ZFS_MODULE_PARAM(zfs_metaslab, zfs_metaslab_, max_size_cache_sec, U64,
 	ZMOD_RW, "How long to trust the cached max chunk size of a metaslab");
 
@@ -187,6 +187,18 @@ uint_t zfs_multihost_import_intervals = MMP_DEFAULT_IMPORT_INTERVALS;
  */
 uint_t zfs_multihost_fail_intervals = MMP_DEFAULT_FAIL_INTERVALS;
 
+/*
+ * When nonzero, at most this many mmp writes are issued per
+ * zfs_multihost_interval, rather than one for each leaf vdev.  The writes
+ * still rotate over all leaves, but a leaf whose recent mmp writes were
+ * much slower than the pool's average, or failed, is passed over in favor
+ * of the next healthy one.  Any single landed write is seen by the activity
+ * test, so this bounds the background write rate of pools with many leaves
+ * without lengthening the activity test, at the cost of refreshing the
+ * labels of each leaf less often.
+ */
+uint_t zfs_multihost_leaves = 0;
+
 static const void *const mmp_tag = "mmp_write_uberblock";
 static __attribute__((noreturn)) void mmp_thread(void *arg);
 
@@ -269,6 +281,64 @@ typedef enum mmp_vdev_state_flag {
 	MMP_FAIL_WRITE_PENDING	= (1 << 1),
 } mmp_vdev_state_flag_t;
 
+/*
+ * Number of mmp writes to issue per zfs_multihost_interval.
+ */
+static int
+mmp_writes_per_interval(spa_t *spa)
+{
+	int leaves = MAX(vdev_count_leaves(spa), 1);
+
+	if (zfs_multihost_leaves != 0)
+		leaves = MIN(leaves, zfs_multihost_leaves);
+
+	return (leaves);
+}
+
+/*
+ * A leaf is considered slow when its mmp writes have recently taken more
+ * than twice as long as the pool's average.  Leaves without a history are
+ * never slow.
+ */
+static boolean_t
+mmp_leaf_slow(spa_t *spa, vdev_t *leaf)
+{
+	ASSERT(MUTEX_HELD(&spa->spa_mmp.mmp_io_lock));
+
+	return (leaf->vdev_mmp_latency > 2 *
+	    MAX(spa->spa_mmp.mmp_latency, MSEC2NSEC(1)));
+}
+
+/*
+ * Track decaying averages of the mmp write latency of each leaf and of the
+ * pool.  A failed write counts as having taken at least a whole
+ * zfs_multihost_interval, so that the leaf is passed over until it has
+ * recovered.
+ */
+static void
+mmp_latency_update(spa_t *spa, vdev_t *leaf, int error, hrtime_t latency)
+{
+	mmp_thread_t *mts = &spa->spa_mmp;
+
+	ASSERT(MUTEX_HELD(&mts->mmp_io_lock));
+
+	if (error != 0) {
+		latency = MAX(latency,
+		    MSEC2NSEC(MMP_INTERVAL_OK(zfs_multihost_interval)));
+	}
+
+	if (leaf->vdev_mmp_latency == 0)
+		leaf->vdev_mmp_latency = latency;
+	else
+		leaf->vdev_mmp_latency =
+		    (latency + leaf->vdev_mmp_latency * 7) / 8;
+
+	if (mts->mmp_latency == 0)
+		mts->mmp_latency = latency;
+	else
+		mts->mmp_latency = (latency + mts->mmp_latency * 31) / 32;
+}
+
 /*
  * Find a leaf vdev to write an MMP block to.  It must not have an outstanding
  * mmp write (if so a new write will also likely block).  If there is no usable
@@ -285,6 +355,7 @@ mmp_next_leaf(spa_t *spa)
 {
 	vdev_t *leaf;
 	vdev_t *starting_leaf;
+	vdev_t *slow_leaf = NULL;
 	int fail_mask = 0;
 
 	ASSERT(MUTEX_HELD(&spa->spa_mmp.mmp_io_lock));
@@ -322,12 +393,26 @@ mmp_next_leaf(spa_t *spa)
 			continue;
 		} else if (leaf->vdev_mmp_pending != 0) {
 			fail_mask |= MMP_FAIL_WRITE_PENDING;
+		} else if (zfs_multihost_leaves != 0 &&
+		    mmp_leaf_slow(spa, leaf)) {
+			/*
+			 * Halve the recorded latency each time the leaf is
+			 * passed over, so that it is retried eventually.
+			 */
+			leaf->vdev_mmp_latency /= 2;
+			if (slow_leaf == NULL)
+				slow_leaf = leaf;
 		} else {
 			spa->spa_mmp.mmp_last_leaf = leaf;
 			return (0);
 		}
 	} while (leaf != starting_leaf);
 
+	if (slow_leaf != NULL) {
+		spa->spa_mmp.mmp_last_leaf = slow_leaf;
+		return (0);
+	}
+
 	ASSERT(fail_mask);
 
 	return (fail_mask);
@@ -381,7 +466,7 @@ mmp_delay_update(spa_t *spa, boolean_t write_completed)
 	if (delay < mts->mmp_delay) {
 		hrtime_t min_delay =
 		    MSEC2NSEC(MMP_INTERVAL_OK(zfs_multihost_interval)) /
-		    MAX(1, vdev_count_leaves(spa));
+		    mmp_writes_per_interval(spa);
 		mts->mmp_delay = MAX(((delay + mts->mmp_delay * 127) / 128),
 		    min_delay);
 	}
@@ -399,6 +484,7 @@ mmp_write_done(zio_t *zio)
 	hrtime_t mmp_write_duration = gethrtime() - vd->vdev_mmp_pending;
 
 	mmp_delay_update(spa, (zio->io_error == 0));
+	mmp_latency_update(spa, vd, zio->io_error, mmp_write_duration);
 
 	vd->vdev_mmp_pending = 0;
 	vd->vdev_mmp_kstat_id = 0;
@@ -577,7 +663,7 @@ mmp_thread(void *arg)
 	while (!mmp->mmp_thread_exiting) {
 		hrtime_t next_time = gethrtime() +
 		    MSEC2NSEC(MMP_DEFAULT_INTERVAL);
-		int leaves = MAX(vdev_count_leaves(spa), 1);
+		int leaves = mmp_writes_per_interval(spa);
 
 		/* Detect changes in tunables or state */
 
@@ -746,3 +832,6 @@ ZFS_MODULE_PARAM(zfs_multihost, zfs_multihost_, fail_intervals, UINT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_multihost, zfs_multihost_, import_intervals, UINT, ZMOD_RW,
 	"Number of zfs_multihost_interval periods to wait for activity");
+
+ZFS_MODULE_PARAM(zfs_multihost, zfs_multihost_, leaves, UINT, ZMOD_RW,
+	"Max mmp writes per zfs_multihost_interval, 0 for one per leaf");
@@ -297,6 +297,23 @@ multilist_sublist_lock_idx(multilist_t *ml, unsigned int sublist_idx)
 	return (mls);
 }
 
+/*
+ * Like multilist_sublist_lock_idx(), but return NULL rather than wait if
+ * the sublist is already locked.
+ */
+multilist_sublist_t *
+multilist_sublist_trylock_idx(multilist_t *ml, unsigned int sublist_idx)
+{
+	multilist_sublist_t *mls;
+
+	ASSERT3U(sublist_idx, <, ml->ml_num_sublists);
+	mls = &ml->ml_sublists[sublist_idx];
+	if (!mutex_tryenter(&mls->mls_lock))
+		return (NULL);
+
+	return (mls);
+}
+
 /* Lock and return the sublist that would be used to store the specified obj */
 multilist_sublist_t *
 multilist_sublist_lock_obj(multilist_t *ml, void *obj)
@@ -192,14 +192,59 @@ zfs_range_tree_seg_gap_compare(const void *x1, const void *x2)
 	return ((r1->rs_start >= r2->rs_end) - (r1->rs_end <= r2->rs_start));
 }
 
-ZFS_BTREE_FIND_IN_BUF_FUNC(zfs_range_tree_seg32_find_in_buf, zfs_range_seg32_t,
+/*
+ * Segments stored in a range tree are never empty, so a segment in the tree
+ * sorts before the searched for segment exactly when it ends at or before
+ * the searched for start.  This halves the comparisons made while
+ * searching the btree nodes.
+ */
+__attribute__((always_inline)) inline
+static int
+zfs_range_tree_seg32_before(const void *x1, const void *x2)
+{
+	const zfs_range_seg32_t *r1 = x1;
+	const zfs_range_seg32_t *r2 = x2;
+
+	ASSERT3U(r1->rs_start, <, r1->rs_end);
+
+	return (-(r1->rs_end <= r2->rs_start));
+}
+
+__attribute__((always_inline)) inline
+static int
+zfs_range_tree_seg64_before(const void *x1, const void *x2)
+{
+	const zfs_range_seg64_t *r1 = x1;
+	const zfs_range_seg64_t *r2 = x2;
+
+	ASSERT3U(r1->rs_start, <, r1->rs_end);
+
+	return (-(r1->rs_end <= r2->rs_start));
+}
+
+__attribute__((always_inline)) inline
+static int
+zfs_range_tree_seg_gap_before(const void *x1, const void *x2)
+{
+	const zfs_range_seg_gap_t *r1 = x1;
+	const zfs_range_seg_gap_t *r2 = x2;
+
+	ASSERT3U(r1->rs_start, <, r1->rs_end);
+
+	return (-(r1->rs_end <= r2->rs_start));
+}
+
+ZFS_BTREE_FIND_IN_BUF_BEFORE_FUNC(zfs_range_tree_seg32_find_in_buf,
+    zfs_range_seg32_t, zfs_range_tree_seg32_before,
     zfs_range_tree_seg32_compare)
 
-ZFS_BTREE_FIND_IN_BUF_FUNC(zfs_range_tree_seg64_find_in_buf, zfs_range_seg64_t,
+ZFS_BTREE_FIND_IN_BUF_BEFORE_FUNC(zfs_range_tree_seg64_find_in_buf,
+    zfs_range_seg64_t, zfs_range_tree_seg64_before,
     zfs_range_tree_seg64_compare)
 
-ZFS_BTREE_FIND_IN_BUF_FUNC(zfs_range_tree_seg_gap_find_in_buf,
-    zfs_range_seg_gap_t, zfs_range_tree_seg_gap_compare)
+ZFS_BTREE_FIND_IN_BUF_BEFORE_FUNC(zfs_range_tree_seg_gap_find_in_buf,
+    zfs_range_seg_gap_t, zfs_range_tree_seg_gap_before,
+    zfs_range_tree_seg_gap_compare)
 
 zfs_range_tree_t *
 zfs_range_tree_create_gap(const zfs_range_tree_ops_t *ops,
@@ -165,30 +165,64 @@ zfs_refcount_add_few(zfs_refcount_t *rc, uint64_t number, const void *holder)
 		(void) zfs_refcount_add(rc, holder);
 }
 
-int64_t
-zfs_refcount_remove_many(zfs_refcount_t *rc, uint64_t number,
-    const void *holder)
+/*
+ * Add a reference only if the count is not zero, and return whether it
+ * was added.  Together with zfs_refcount_remove_if_shared(), this lets
+ * users whose first and last references are serialized by a lock take
+ * and drop the other ones without that lock.
+ */
+boolean_t
+zfs_refcount_add_if_held(zfs_refcount_t *rc, const void *holder)
 {
-	reference_t *ref, s;
-	int64_t count;
+	reference_t *ref;
+	uint64_t count, old;
 
 	if (likely(!rc->rc_tracked)) {
-		count = atomic_add_64_nv(&(rc)->rc_count, -number);
-		ASSERT3S(count, >=, 0);
-		return (count);
+		count = atomic_load_64(&rc->rc_count);
+		while (count != 0) {
+			old = atomic_cas_64(&rc->rc_count, count, count + 1);
+			if (old == count)
+				return (B_TRUE);
+			count = old;
+		}
+		return (B_FALSE);
+	}
+
+	ref = kmem_cache_alloc(reference_cache, KM_SLEEP);
+	ref->ref_holder = holder;
+	ref->ref_number = 1;
+	ref->ref_search = B_FALSE;
+	mutex_enter(&rc->rc_mtx);
+	if (rc->rc_count == 0) {
+		mutex_exit(&rc->rc_mtx);
+		kmem_cache_free(reference_cache, ref);
+		return (B_FALSE);
 	}
+	avl_add(&rc->rc_tree, ref);
+	rc->rc_count++;
+	mutex_exit(&rc->rc_mtx);
+
+	return (B_TRUE);
+}
+
+static void
+zfs_refcount_remove_locked(zfs_refcount_t *rc, uint64_t number,
+    const void *holder)
+{
+	reference_t *ref, s;
+
+	ASSERT(MUTEX_HELD(&rc->rc_mtx));
 
 	s.ref_holder = holder;
 	s.ref_number = number;
 	s.ref_search = B_TRUE;
-	mutex_enter(&rc->rc_mtx);
 	ASSERT3U(rc->rc_count, >=, number);
 	ref = avl_find(&rc->rc_tree, &s, NULL);
 	if (unlikely(ref == NULL)) {
 		PANIC("No such hold %llx on refcount %llx",
 		    (u_longlong_t)(uintptr_t)holder,
 		    (u_longlong_t)(uintptr_t)rc);
-		return (-1);
+		return;
 	}
 	avl_remove(&rc->rc_tree, ref);
 	if (reference_history > 0) {
@@ -203,11 +237,58 @@ zfs_refcount_remove_many(zfs_refcount_t *rc, uint64_t number,
 		kmem_cache_free(reference_cache, ref);
 	}
 	rc->rc_count -= number;
+}
+
+int64_t
+zfs_refcount_remove_many(zfs_refcount_t *rc, uint64_t number,
+    const void *holder)
+{
+	int64_t count;
+
+	if (likely(!rc->rc_tracked)) {
+		count = atomic_add_64_nv(&(rc)->rc_count, -number);
+		ASSERT3S(count, >=, 0);
+		return (count);
+	}
+
+	mutex_enter(&rc->rc_mtx);
+	zfs_refcount_remove_locked(rc, number, holder);
 	count = rc->rc_count;
 	mutex_exit(&rc->rc_mtx);
 	return (count);
 }
 
+/*
+ * Remove a reference only if it is not the last one, and return whether
+ * it was removed.  See zfs_refcount_add_if_held().
+ */
+boolean_t
+zfs_refcount_remove_if_shared(zfs_refcount_t *rc, const void *holder)
+{
+	uint64_t count, old;
+
+	if (likely(!rc->rc_tracked)) {
+		count = atomic_load_64(&rc->rc_count);
+		while (count > 1) {
+			old = atomic_cas_64(&rc->rc_count, count, count - 1);
+			if (old == count)
+				return (B_TRUE);
+			count = old;
+		}
+		ASSERT3U(count, ==, 1);
+		return (B_FALSE);
+	}
+
+	mutex_enter(&rc->rc_mtx);
+	if (rc->rc_count <= 1) {
+		mutex_exit(&rc->rc_mtx);
+		return (B_FALSE);
+	}
+	zfs_refcount_remove_locked(rc, 1, holder);
+	mutex_exit(&rc->rc_mtx);
+	return (B_TRUE);
+}
+
 int64_t
 zfs_refcount_remove(zfs_refcount_t *rc, const void *holder)
 {
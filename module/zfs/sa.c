@@ -1170,6 +1170,7 @@ sa_build_idx_tab(void *hdr, void *attr_addr, sa_attr_type_t attr,
 		ASSERT(idx_tab->sa_variable_lengths);
 		idx_tab->sa_variable_lengths[length_idx] = length;
 	}
+	idx_tab->sa_attr_lengths[attr] = length;
 	TOC_ATTR_ENCODE(idx_tab->sa_idx_tab[attr], length_idx,
 	    (uint32_t)((uintptr_t)attr_addr - (uintptr_t)hdr));
 }
@@ -1341,6 +1342,8 @@ sa_idx_tab_rele(objset_t *os, void *arg)
 		zfs_refcount_destroy(&idx_tab->sa_refcount);
 		kmem_free(idx_tab->sa_idx_tab,
 		    sizeof (uint32_t) * sa->sa_num_attrs);
+		kmem_free(idx_tab->sa_attr_lengths,
+		    sizeof (uint16_t) * sa->sa_num_attrs);
 		kmem_free(idx_tab, sizeof (sa_idx_tab_t));
 	}
 	mutex_exit(&sa->sa_lock);
@@ -1467,11 +1470,58 @@ sa_buf_rele(dmu_buf_t *db, const void *tag)
 	dmu_buf_rele(db, tag);
 }
 
+/*
+ * Lookup fast path for the common case where every requested attribute
+ * lives in the bonus buffer, such as the bulk lookups done when a znode
+ * is instantiated or its attributes are fetched.  The index table of the
+ * bonus layout already holds the offset and the resolved length of each
+ * attribute, so the whole request is a single table driven copy without
+ * the per attribute spill checks of sa_attr_op().  Returns B_FALSE
+ * without touching the bulk array if any attribute is not in the bonus
+ * buffer, in which case the caller takes the general path.
+ */
+static boolean_t
+sa_lookup_bonus(sa_handle_t *hdl, sa_bulk_attr_t *bulk, int count)
+{
+	sa_idx_tab_t *tab = hdl->sa_bonus_tab;
+	sa_hdr_phys_t *hdr;
+	int i;
+
+	if (tab == NULL)
+		return (B_FALSE);
+
+	for (i = 0; i != count; i++) {
+		ASSERT3U(bulk[i].sa_attr, <=, hdl->sa_os->os_sa->sa_num_attrs);
+		if (!TOC_ATTR_PRESENT(tab->sa_idx_tab[bulk[i].sa_attr]))
+			return (B_FALSE);
+	}
+
+	hdr = SA_GET_HDR(hdl, SA_BONUS);
+	for (i = 0; i != count; i++) {
+		sa_attr_type_t attr = bulk[i].sa_attr;
+
+		bulk[i].sa_addr = (void *)((uintptr_t)hdr +
+		    TOC_OFF(tab->sa_idx_tab[attr]));
+		bulk[i].sa_size = tab->sa_attr_lengths[attr];
+		bulk[i].sa_buftype = SA_BONUS;
+		ASSERT3U(bulk[i].sa_size, ==,
+		    SA_ATTR_LEN(hdl->sa_os->os_sa, tab, attr, hdr));
+		if (bulk[i].sa_data) {
+			SA_COPY_DATA(bulk[i].sa_data_func,
+			    bulk[i].sa_addr, bulk[i].sa_data,
+			    MIN(bulk[i].sa_size, bulk[i].sa_length));
+		}
+	}
+	return (B_TRUE);
+}
+
 static int
 sa_lookup_impl(sa_handle_t *hdl, sa_bulk_attr_t *bulk, int count)
 {
 	ASSERT(hdl);
 	ASSERT(MUTEX_HELD(&hdl->sa_lock));
+	if (sa_lookup_bonus(hdl, bulk, count))
+		return (0);
 	return (sa_attr_op(hdl, bulk, count, SA_LOOKUP, NULL));
 }
 
@@ -1809,6 +1859,8 @@ sa_find_idx_tab(objset_t *os, dmu_object_type_t bonustype, sa_hdr_phys_t *hdr)
 	idx_tab = kmem_zalloc(sizeof (sa_idx_tab_t), KM_SLEEP);
 	idx_tab->sa_idx_tab =
 	    kmem_zalloc(sizeof (uint32_t) * sa->sa_num_attrs, KM_SLEEP);
+	idx_tab->sa_attr_lengths =
+	    kmem_zalloc(sizeof (uint16_t) * sa->sa_num_attrs, KM_SLEEP);
 	idx_tab->sa_layout = tb;
 	zfs_refcount_create(&idx_tab->sa_refcount);
 	if (tb->lot_var_sizes)
@@ -2215,6 +2267,54 @@ sa_handle_object(sa_handle_t *hdl)
 	return (hdl->sa_bonus->db_object);
 }
 
+/*
+ * Returns B_FALSE if attribute attr can be set to size bytes, and all other
+ * attributes of the handle kept, without a spill block.  The estimate is
+ * conservative, and objects which already have a spill block always report
+ * B_TRUE.
+ */
+boolean_t
+sa_attr_would_spill(sa_handle_t *hdl, sa_attr_type_t attr, int size)
+{
+	sa_os_t *sa = hdl->sa_os->os_sa;
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)hdl->sa_bonus;
+	sa_idx_tab_t *tab;
+	sa_lot_t *lot;
+	boolean_t spill;
+	int dnodesize, hdrsize, total, nvar, i;
+
+	mutex_enter(&hdl->sa_lock);
+	tab = hdl->sa_bonus_tab;
+	DB_DNODE_ENTER(db);
+	spill = DB_DNODE(db)->dn_have_spill;
+	DB_DNODE_EXIT(db);
+	if (spill || sa->sa_force_spill || tab == NULL ||
+	    SA_BONUSTYPE_FROM_DB(db) != DMU_OT_SA) {
+		mutex_exit(&hdl->sa_lock);
+		return (B_TRUE);
+	}
+
+	lot = tab->sa_layout;
+	total = P2ROUNDUP(size, 8);
+	nvar = (SA_REGISTERED_LEN(sa, attr) == 0) ? 1 : 0;
+	for (i = 0; i != lot->lot_attr_count; i++) {
+		sa_attr_type_t a = lot->lot_attrs[i];
+
+		if (a == attr)
+			continue;
+		total += P2ROUNDUP(tab->sa_attr_lengths[a], 8);
+		if (SA_REGISTERED_LEN(sa, a) == 0)
+			nvar++;
+	}
+	mutex_exit(&hdl->sa_lock);
+
+	hdrsize = sizeof (sa_hdr_phys_t) +
+	    ((nvar > 1) ? (nvar - 1) * sizeof (uint16_t) : 0);
+	dmu_object_dnsize_from_db(hdl->sa_bonus, &dnodesize);
+
+	return (total + P2ROUNDUP(hdrsize, 8) >= DN_BONUS_SIZE(dnodesize));
+}
+
 boolean_t
 sa_enabled(objset_t *os)
 {
@@ -2276,6 +2376,7 @@ EXPORT_SYMBOL(sa_get_userdata);
 EXPORT_SYMBOL(sa_set_userp);
 EXPORT_SYMBOL(sa_get_db);
 EXPORT_SYMBOL(sa_handle_object);
+EXPORT_SYMBOL(sa_attr_would_spill);
 EXPORT_SYMBOL(sa_register_update_callback);
 EXPORT_SYMBOL(sa_setup);
 EXPORT_SYMBOL(sa_replace_all_by_template);
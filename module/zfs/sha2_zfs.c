@@ -30,7 +30,7 @@
 #include <sys/zio_checksum.h>
 #include <sys/sha2.h>
 #include <sys/abd.h>
-#include <sys/qat.h>
+#include <sys/zio_offload.h>
 
 static int
 sha_incremental(void *buf, size_t size, void *arg)
@@ -49,17 +49,20 @@ abd_checksum_sha256(abd_t *abd, uint64_t size,
 	SHA2_CTX ctx;
 	zio_cksum_t tmp;
 
-	if (qat_checksum_use_accel(size)) {
+	if (zio_offload_usable(ZIO_OFFLOAD_CHECKSUM, ZIO_CHECKSUM_SHA256,
+	    size)) {
 		uint8_t *buf = abd_borrow_buf_copy(abd, size);
-		ret = qat_checksum(ZIO_CHECKSUM_SHA256, buf, size, &tmp);
+		ret = zio_offload_checksum(ZIO_CHECKSUM_SHA256, buf, size,
+		    &tmp);
 		abd_return_buf(abd, buf, size);
-		if (ret == CPA_STATUS_SUCCESS)
+		if (ret == 0)
 			goto bswap;
 
 		/* If the hardware implementation fails fall back to software */
 	}
 
 	SHA2Init(SHA256, &ctx);
+	SHA2SizeHint(&ctx, size);
 	(void) abd_iterate_func(abd, 0, size, sha_incremental, &ctx);
 	SHA2Final(&tmp, &ctx);
 
@@ -85,6 +88,7 @@ abd_checksum_sha512_native(abd_t *abd, uint64_t size,
 	SHA2_CTX	ctx;
 
 	SHA2Init(SHA512_256, &ctx);
+	SHA2SizeHint(&ctx, size);
 	(void) abd_iterate_func(abd, 0, size, sha_incremental, &ctx);
 	SHA2Final(zcp, &ctx);
 }
@@ -49,6 +49,7 @@
 #include <sys/zfs_context.h>
 #include <sys/fm/fs/zfs.h>
 #include <sys/spa_impl.h>
+#include <sys/spa_arc_warm.h>
 #include <sys/zio.h>
 #include <sys/zio_checksum.h>
 #include <sys/dmu.h>
@@ -217,6 +218,19 @@ static const boolean_t spa_create_process = B_TRUE; /* no process => no sysdc */
 
 static uint_t	zio_taskq_write_tpq = 16;
 
+/*
+ * Split the scaled zio taskqs into one group per NUMA node, with each
+ * group's threads bound to that node, and dispatch zios to the group
+ * local to their data buffer.
+ */
+static int	zio_taskq_numa = 0;
+
+/*
+ * Create the issue and interrupt zio taskqs as work-stealing taskqs, with
+ * per-thread queues instead of one shared list, where the platform has them.
+ */
+static int	zio_taskq_steal = 0;
+
 /*
  * Report any spa_load_verify errors found, but do not fail spa_load.
  * This is used by zdb to analyze non-idle pools.
@@ -1130,7 +1144,11 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 	uint_t value = ztip->zti_value;
 	uint_t count = ztip->zti_count;
 	spa_taskqs_t *tqs = &spa->spa_zio_taskq[t][q];
-	uint_t cpus, flags = TASKQ_DYNAMIC;
+	uint_t cpus, nodes = 1, flags = TASKQ_DYNAMIC;
+
+	if (zio_taskq_steal &&
+	    (q == ZIO_TASKQ_ISSUE || q == ZIO_TASKQ_INTERRUPT))
+		flags |= TASKQ_STEAL;
 
 	switch (mode) {
 	case ZTI_MODE_FIXED:
@@ -1199,6 +1217,7 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 
 	case ZTI_MODE_NULL:
 		tqs->stqs_count = 0;
+		tqs->stqs_nodes = 0;
 		tqs->stqs_taskq = NULL;
 		return;
 
@@ -1209,8 +1228,25 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 		break;
 	}
 
+	/*
+	 * For NUMA-local taskqs give every node the same number of taskqs,
+	 * keeping the total thread percentage unchanged.  The write issue
+	 * taskqs are sized to divide the allocators evenly, so they are only
+	 * split when their count already is a multiple of the node count.
+	 */
+	uint_t nnodes = zio_taskq_numa ? boot_nnodes : 1;
+	if (nnodes > 1 && (mode == ZTI_MODE_SCALE ||
+	    (mode == ZTI_MODE_SYNC && count % nnodes == 0))) {
+		nodes = nnodes;
+		count = roundup(count, nodes);
+		value = (zio_taskq_batch_pct + count / 2) / count;
+		value = MIN(MAX(value, 1), 100);
+	}
+
 	ASSERT3U(count, >, 0);
+	ASSERT0(count % nodes);
 	tqs->stqs_count = count;
+	tqs->stqs_nodes = nodes;
 	tqs->stqs_taskq = kmem_alloc(count * sizeof (taskq_t *), KM_SLEEP);
 
 	for (uint_t i = 0; i < count; i++) {
@@ -1254,8 +1290,14 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 #error "unknown OS"
 #endif
 			}
-			tq = taskq_create_proc(name, value, pri, 50,
-			    INT_MAX, spa->spa_proc, flags);
+			if (nodes > 1) {
+				tq = taskq_create_node(name, value, pri, 50,
+				    INT_MAX, flags,
+				    spl_node_id(i / (count / nodes)));
+			} else {
+				tq = taskq_create_proc(name, value, pri, 50,
+				    INT_MAX, spa->spa_proc, flags);
+			}
 #ifdef HAVE_SYSDC
 		}
 #endif
@@ -1579,7 +1621,30 @@ spa_taskq_dispatch(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
 		tq = tqs->stqs_taskq[0];
 	} else if ((t == ZIO_TYPE_WRITE) && (q == ZIO_TASKQ_ISSUE) &&
 	    ZIO_HAS_ALLOCATOR(zio)) {
+		/*
+		 * Each allocator keeps its own taskq, NUMA-local or not, so
+		 * that its allocations are issued in order.
+		 */
 		tq = tqs->stqs_taskq[zio->io_allocator % tqs->stqs_count];
+	} else if (tqs->stqs_nodes > 1) {
+		/*
+		 * With NUMA-local taskqs, pick among the taskqs of the node
+		 * holding the zio's data, or of the current CPU if that is
+		 * unknown or has no CPUs.
+		 */
+		int index = -1;
+		if (zio->io_abd != NULL) {
+			int node = abd_numa_node(zio->io_abd);
+			if (node >= 0)
+				index = spl_node_index(node);
+		}
+		if (index < 0)
+			index = spl_node_index(CPU_NODE);
+		if (index < 0)
+			index = 0;
+		uint_t n = tqs->stqs_count / tqs->stqs_nodes;
+		uint_t base = ((uint_t)index % tqs->stqs_nodes) * n;
+		tq = tqs->stqs_taskq[base + ((uint64_t)gethrtime()) % n];
 	} else {
 		tq = tqs->stqs_taskq[((uint64_t)gethrtime()) % tqs->stqs_count];
 	}
@@ -2039,6 +2104,10 @@ spa_destroy_aux_threads(spa_t *spa)
 		zthr_destroy(spa->spa_raidz_expand_zthr);
 		spa->spa_raidz_expand_zthr = NULL;
 	}
+	if (spa->spa_arc_warm_zthr != NULL) {
+		zthr_destroy(spa->spa_arc_warm_zthr);
+		spa->spa_arc_warm_zthr = NULL;
+	}
 }
 
 /*
@@ -2757,6 +2826,9 @@ static uint_t spa_load_verify_shift = 4;
 static int spa_load_verify_metadata = B_TRUE;
 static int spa_load_verify_data = B_TRUE;
 
+/* Load independent MOS structures in parallel during import. */
+static int spa_load_parallel = B_FALSE;
+
 static int
 spa_load_verify_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
     const zbookmark_phys_t *zb, const dnode_phys_t *dnp, void *arg)
@@ -3343,6 +3415,8 @@ spa_spawn_aux_threads(spa_t *spa)
 	    zthr_create("z_checkpoint_discard",
 	    spa_checkpoint_discard_thread_check,
 	    spa_checkpoint_discard_thread, spa, minclsyspri);
+
+	spa_arc_warm_start(spa);
 }
 
 /*
@@ -4641,6 +4715,14 @@ spa_ld_check_features(spa_t *spa, boolean_t *missing_feat_writep)
 			return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, EIO));
 	}
 
+	spa->spa_gang_header_txg = UINT64_MAX;
+	if (spa_feature_is_active(spa, SPA_FEATURE_DYNAMIC_GANG_HEADER)) {
+		uint64_t txg;
+		VERIFY(spa_feature_enabled_txg(spa,
+		    SPA_FEATURE_DYNAMIC_GANG_HEADER, &txg));
+		spa->spa_gang_header_txg = txg + TXG_CONCURRENT_STATES;
+	}
+
 	/*
 	 * Encryption was added before bookmark_v2, even though bookmark_v2
 	 * is now a dependency. If this pool has encryption enabled without
@@ -4984,6 +5066,57 @@ spa_ld_load_brt(spa_t *spa)
 	return (0);
 }
 
+/*
+ * The DDT and BRT are independent MOS structures, so with
+ * spa_load_parallel the BRT is loaded on a taskq while the DDT is loaded
+ * by the import thread.
+ */
+typedef struct spa_load_brt_arg {
+	spa_t	*slba_spa;
+	int	slba_error;
+} spa_load_brt_arg_t;
+
+static void
+spa_ld_load_brt_task(void *arg)
+{
+	spa_load_brt_arg_t *slba = arg;
+
+	slba->slba_error = brt_load(slba->slba_spa);
+}
+
+static int
+spa_ld_load_dedup_tables_and_brt(spa_t *spa)
+{
+	vdev_t *rvd = spa->spa_root_vdev;
+	spa_load_brt_arg_t slba = { .slba_spa = spa };
+	int error;
+
+	taskq_t *tq = taskq_create("spa_load_brt", 1, minclsyspri, 1, 1,
+	    TASKQ_PREPOPULATE);
+	if (tq == NULL || taskq_dispatch(tq, spa_ld_load_brt_task, &slba,
+	    TQ_SLEEP) == TASKQID_INVALID)
+		spa_ld_load_brt_task(&slba);
+
+	error = ddt_load(spa);
+
+	if (tq != NULL) {
+		taskq_wait(tq);
+		taskq_destroy(tq);
+	}
+
+	if (error != 0) {
+		spa_load_failed(spa, "ddt_load failed [error=%d]", error);
+		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, EIO));
+	}
+	if (slba.slba_error != 0) {
+		spa_load_failed(spa, "brt_load failed [error=%d]",
+		    slba.slba_error);
+		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, EIO));
+	}
+
+	return (0);
+}
+
 static int
 spa_ld_verify_logs(spa_t *spa, spa_import_type_t type, const char **ereport)
 {
@@ -5476,15 +5609,23 @@ spa_load_impl(spa_t *spa, spa_import_type_t type, const char **ereport)
 	if (error != 0)
 		goto fail;
 
-	spa_import_progress_set_notes(spa, "Loading dedup tables");
-	error = spa_ld_load_dedup_tables(spa);
-	if (error != 0)
-		goto fail;
+	if (spa_load_parallel) {
+		spa_import_progress_set_notes(spa,
+		    "Loading dedup tables and BRT");
+		error = spa_ld_load_dedup_tables_and_brt(spa);
+		if (error != 0)
+			goto fail;
+	} else {
+		spa_import_progress_set_notes(spa, "Loading dedup tables");
+		error = spa_ld_load_dedup_tables(spa);
+		if (error != 0)
+			goto fail;
 
-	spa_import_progress_set_notes(spa, "Loading BRT");
-	error = spa_ld_load_brt(spa);
-	if (error != 0)
-		goto fail;
+		spa_import_progress_set_notes(spa, "Loading BRT");
+		error = spa_ld_load_brt(spa);
+		if (error != 0)
+			goto fail;
+	}
 
 	/*
 	 * Verify the logs now to make sure we don't have any unexpected errors
@@ -5884,17 +6025,13 @@ spa_open_common(const char *pool, spa_t **spapp, const void *tag,
 
 	spa_open_ref(spa, tag);
 
-	if (config != NULL)
-		*config = spa_config_generate(spa, NULL, -1ULL, B_TRUE);
-
 	/*
 	 * If we've recovered the pool, pass back any information we
 	 * gathered while doing the load.
 	 */
-	if (state == SPA_LOAD_RECOVER && config != NULL) {
-		fnvlist_add_nvlist(*config, ZPOOL_CONFIG_LOAD_INFO,
-		    spa->spa_load_info);
-	}
+	nvlist_t *load_info = NULL;
+	if (state == SPA_LOAD_RECOVER && config != NULL)
+		load_info = fnvlist_dup(spa->spa_load_info);
 
 	if (locked) {
 		spa->spa_last_open_failed = 0;
@@ -5903,6 +6040,23 @@ spa_open_common(const char *pool, spa_t **spapp, const void *tag,
 		mutex_exit(&spa_namespace_lock);
 	}
 
+	/*
+	 * Generating the config walks the whole vdev tree and gathers its
+	 * stats, which is slow on large pools and done on every
+	 * ZFS_IOC_POOL_STATS.  Our reference keeps the pool from being
+	 * exported or destroyed and spa_config_generate() takes the config
+	 * locks it needs, so do it after dropping spa_namespace_lock rather
+	 * than stalling every other pool operation behind it.
+	 */
+	if (config != NULL) {
+		*config = spa_config_generate(spa, NULL, -1ULL, B_TRUE);
+		if (load_info != NULL) {
+			fnvlist_add_nvlist(*config, ZPOOL_CONFIG_LOAD_INFO,
+			    load_info);
+			fnvlist_free(load_info);
+		}
+	}
+
 	if (firstopen)
 		zvol_create_minors_recursive(spa_name(spa));
 
@@ -6377,13 +6531,16 @@ spa_l2cache_drop(spa_t *spa)
  */
 static int
 spa_create_check_encryption_params(dsl_crypto_params_t *dcp,
-    boolean_t has_encryption)
+    boolean_t has_encryption, boolean_t has_chacha20)
 {
 	if (dcp->cp_crypt != ZIO_CRYPT_OFF &&
 	    dcp->cp_crypt != ZIO_CRYPT_INHERIT &&
 	    !has_encryption)
 		return (SET_ERROR(ENOTSUP));
 
+	if (dcp->cp_crypt == ZIO_CRYPT_CHACHA20_POLY1305 && !has_chacha20)
+		return (SET_ERROR(ENOTSUP));
+
 	return (dmu_objset_create_crypt_check(NULL, dcp, NULL));
 }
 
@@ -6406,6 +6563,7 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	uint64_t version, obj, ndraid = 0;
 	boolean_t has_features;
 	boolean_t has_encryption;
+	boolean_t has_chacha20;
 	boolean_t has_allocclass;
 	spa_feature_t feat;
 	const char *feat_name;
@@ -6452,6 +6610,7 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 
 	has_features = B_FALSE;
 	has_encryption = B_FALSE;
+	has_chacha20 = B_FALSE;
 	has_allocclass = B_FALSE;
 	for (nvpair_t *elem = nvlist_next_nvpair(props, NULL);
 	    elem != NULL; elem = nvlist_next_nvpair(props, elem)) {
@@ -6462,6 +6621,8 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 			VERIFY0(zfeature_lookup_name(feat_name, &feat));
 			if (feat == SPA_FEATURE_ENCRYPTION)
 				has_encryption = B_TRUE;
+			if (feat == SPA_FEATURE_CHACHA20_POLY1305)
+				has_chacha20 = B_TRUE;
 			if (feat == SPA_FEATURE_ALLOCATION_CLASSES)
 				has_allocclass = B_TRUE;
 		}
@@ -6469,7 +6630,8 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 
 	/* verify encryption params, if they were provided */
 	if (dcp != NULL) {
-		error = spa_create_check_encryption_params(dcp, has_encryption);
+		error = spa_create_check_encryption_params(dcp, has_encryption,
+		    has_chacha20);
 		if (error != 0) {
 			spa_deactivate(spa);
 			spa_remove(spa);
@@ -9259,6 +9421,10 @@ spa_async_suspend(spa_t *spa)
 	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
 	if (ll_condense_thread != NULL)
 		zthr_cancel(ll_condense_thread);
+
+	zthr_t *arc_warm_thread = spa->spa_arc_warm_zthr;
+	if (arc_warm_thread != NULL)
+		zthr_cancel(arc_warm_thread);
 }
 
 void
@@ -9289,6 +9455,10 @@ spa_async_resume(spa_t *spa)
 	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
 	if (ll_condense_thread != NULL)
 		zthr_resume(ll_condense_thread);
+
+	zthr_t *arc_warm_thread = spa->spa_arc_warm_zthr;
+	if (arc_warm_thread != NULL)
+		zthr_resume(arc_warm_thread);
 }
 
 static boolean_t
@@ -10000,6 +10170,7 @@ spa_sync_iterate_to_convergence(spa_t *spa, dmu_tx_t *tx)
 	dsl_pool_t *dp = spa->spa_dsl_pool;
 	uint64_t txg = tx->tx_txg;
 	bplist_t *free_bpl = &spa->spa_free_bplist[txg & TXG_MASK];
+	hrtime_t start;
 
 	do {
 		int pass = ++spa->spa_sync_pass;
@@ -10012,6 +10183,7 @@ spa_sync_iterate_to_convergence(spa_t *spa, dmu_tx_t *tx)
 		spa_errlog_sync(spa, txg);
 		dsl_pool_sync(dp, txg);
 
+		start = gethrtime();
 		if (pass < zfs_sync_pass_deferred_free ||
 		    spa_feature_is_active(spa, SPA_FEATURE_LOG_SPACEMAP)) {
 			/*
@@ -10030,20 +10202,28 @@ spa_sync_iterate_to_convergence(spa_t *spa, dmu_tx_t *tx)
 			bplist_iterate(free_bpl, bpobj_enqueue_alloc_cb,
 			    &spa->spa_deferred_bpobj, tx);
 		}
+		spa_sync_phase_add(spa, SPA_SYNC_PHASE_FREES, start);
 
+		start = gethrtime();
 		brt_sync(spa, txg);
 		ddt_sync(spa, txg);
+		spa_sync_phase_add(spa, SPA_SYNC_PHASE_DDT_BRT, start);
+
 		dsl_scan_sync(dp, tx);
 		dsl_errorscrub_sync(dp, tx);
 		svr_sync(spa, tx);
 		spa_sync_upgrades(spa, tx);
 
+		start = gethrtime();
 		spa_flush_metaslabs(spa, tx);
+		spa_sync_phase_add(spa, SPA_SYNC_PHASE_LOG_FLUSH, start);
 
+		start = gethrtime();
 		vdev_t *vd = NULL;
 		while ((vd = txg_list_remove(&spa->spa_vdev_txg_list, txg))
 		    != NULL)
 			vdev_sync(vd, txg);
+		spa_sync_phase_add(spa, SPA_SYNC_PHASE_VDEVS, start);
 
 		if (pass == 1) {
 			/*
@@ -10090,7 +10270,9 @@ spa_sync_iterate_to_convergence(spa_t *spa, dmu_tx_t *tx)
 			break;
 		}
 
+		start = gethrtime();
 		spa_sync_deferred_frees(spa, tx);
+		spa_sync_phase_add(spa, SPA_SYNC_PHASE_DEFERRED, start);
 	} while (dmu_objset_is_dirty(mos, txg));
 }
 
@@ -10192,6 +10374,9 @@ spa_sync(spa_t *spa, uint64_t txg)
 
 	spa->spa_syncing_txg = txg;
 	spa->spa_sync_pass = 0;
+	memset(spa->spa_sync_phase_time, 0, sizeof (spa->spa_sync_phase_time));
+	memset(spa->spa_sync_pass_blocks, 0,
+	    sizeof (spa->spa_sync_pass_blocks));
 
 	/*
 	 * If there are any pending vdev state changes, convert them
@@ -10256,6 +10441,8 @@ spa_sync(spa_t *spa, uint64_t txg)
 
 	spa_sync_adjust_vdev_max_queue_depth(spa);
 
+	spa_alloc_rebalance(spa);
+
 	spa_sync_condense_indirect(spa, tx);
 
 	spa_sync_iterate_to_convergence(spa, tx);
@@ -10281,7 +10468,9 @@ spa_sync(spa_t *spa, uint64_t txg)
 		ASSERT0(spa->spa_vdev_removal->svr_bytes_done[txg & TXG_MASK]);
 	}
 
+	hrtime_t start = gethrtime();
 	spa_sync_rewrite_vdev_config(spa, tx);
+	spa_sync_phase_add(spa, SPA_SYNC_PHASE_CONFIG, start);
 	dmu_tx_commit(tx);
 
 	taskq_cancel_id(system_delay_taskq, spa->spa_deadman_tqid);
@@ -10336,6 +10525,7 @@ spa_sync(spa_t *spa, uint64_t txg)
 	while (zfs_pause_spa_sync)
 		delay(1);
 
+	spa->spa_sync_passes = spa->spa_sync_pass;
 	spa->spa_sync_pass = 0;
 
 	/*
@@ -10501,7 +10691,7 @@ spa_select_allocator(zio_t *zio)
 	uint64_t hv = cityhash4(bm->zb_objset, bm->zb_object, bm->zb_level,
 	    bm->zb_blkid >> 20);
 
-	zio->io_allocator = (uint_t)hv % spa->spa_alloc_count;
+	zio->io_allocator = (uint_t)hv % spa->spa_alloc_active;
 }
 
 /*
@@ -11071,6 +11261,9 @@ ZFS_MODULE_PARAM(zfs_spa, spa_, load_verify_data, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_spa, spa_, load_print_vdev_tree, INT, ZMOD_RW,
 	"Print vdev tree to zfs_dbgmsg during pool import");
 
+ZFS_MODULE_PARAM(zfs_spa, spa_, load_parallel, INT, ZMOD_RW,
+	"Load the DDT and BRT in parallel during pool import");
+
 ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_batch_pct, UINT, ZMOD_RW,
 	"Percentage of CPUs to run an IO worker thread");
 
@@ -11111,3 +11304,9 @@ ZFS_MODULE_VIRTUAL_PARAM_CALL(zfs_zio, zio_, taskq_write,
 
 ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_write_tpq, UINT, ZMOD_RW,
 	"Number of CPUs per write issue taskq");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_numa, INT, ZMOD_RW,
+	"Create NUMA-local zio taskqs and dispatch to the data's node");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_steal, INT, ZMOD_RW,
+	"Use work-stealing issue and interrupt zio taskqs");
@@ -0,0 +1,417 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * ARC warm-start
+ *
+ * After an export/import or a reboot the ARC starts out empty and it can
+ * take a long time for a busy pool to rebuild its working set.  To shorten
+ * that, a per-pool zthr periodically records which blocks are cached and
+ * replays that record as prefetch reads the next time the pool is imported.
+ *
+ * The record is a list of block bookmarks (dataset, object, level, blkid)
+ * taken from the dbuf hash table rather than ARC header identities: a DVA
+ * alone is not enough to issue a checksummed read, while a bookmark can
+ * always be resolved to the current block pointer.  Stale entries (freed
+ * objects, destroyed datasets) simply fail to resolve and are skipped.
+ *
+ * The record cannot be taken at export time because datasets are unmounted,
+ * and their dbufs evicted, before the pool itself is exported, so it is
+ * refreshed every zfs_arc_warm_interval seconds instead.  It is stored in
+ * a MOS object referenced from the pool directory by DMU_POOL_ARC_WARM;
+ * pools without the entry are unaffected and older software ignores it.
+ *
+ * The feature is disabled while zfs_arc_warm_max_blocks is zero.
+ */
+
+#include <sys/btree.h>
+#include <sys/dbuf.h>
+#include <sys/dmu_objset.h>
+#include <sys/dmu_tx.h>
+#include <sys/dnode.h>
+#include <sys/dsl_dataset.h>
+#include <sys/dsl_pool.h>
+#include <sys/dsl_synctask.h>
+#include <sys/spa_arc_warm.h>
+#include <sys/spa_impl.h>
+#include <sys/zap.h>
+#include <sys/zthr.h>
+
+/*
+ * Maximum number of blocks recorded per pool (0 disables the feature).
+ * Each record takes 32 bytes on disk and in memory while it is built.
+ */
+static uint_t zfs_arc_warm_max_blocks = 0;
+
+/* Seconds between updates of the on-disk record (0 to never update). */
+static uint_t zfs_arc_warm_interval = 600;
+
+/* Records prefetched per pool config lock hold during replay. */
+#define	SPA_ARC_WARM_BATCH	1024
+
+typedef struct spa_arc_warm_walk {
+	spa_arc_warm_rec_t	*aww_recs;
+	uint64_t		aww_count;
+	uint64_t		aww_max;
+} spa_arc_warm_walk_t;
+
+typedef struct spa_arc_warm_save {
+	spa_arc_warm_rec_t	*aws_recs;	/* header + records */
+	uint64_t		aws_count;
+	uint64_t		aws_max;
+} spa_arc_warm_save_t;
+
+typedef struct spa_arc_warm_replay {
+	kmutex_t	awp_lock;
+	kcondvar_t	awp_cv;
+	uint64_t	awp_pending_io;
+} spa_arc_warm_replay_t;
+
+static int
+spa_arc_warm_rec_compare(const void *x1, const void *x2)
+{
+	const spa_arc_warm_rec_t *r1 = x1;
+	const spa_arc_warm_rec_t *r2 = x2;
+
+	int cmp = TREE_CMP(r1->awr_objset, r2->awr_objset);
+	if (likely(cmp))
+		return (cmp);
+	cmp = TREE_CMP(r1->awr_object, r2->awr_object);
+	if (likely(cmp))
+		return (cmp);
+	cmp = TREE_CMP(r1->awr_level, r2->awr_level);
+	if (likely(cmp))
+		return (cmp);
+	return (TREE_CMP(r1->awr_blkid, r2->awr_blkid));
+}
+
+ZFS_BTREE_FIND_IN_BUF_FUNC(spa_arc_warm_rec_find_in_buf, spa_arc_warm_rec_t,
+    spa_arc_warm_rec_compare)
+
+/*
+ * Called from dbuf_walk_cached() with the hash chain lock held; must not
+ * block.
+ */
+static int
+spa_arc_warm_walk_cb(dmu_buf_impl_t *db, void *arg)
+{
+	spa_arc_warm_walk_t *aww = arg;
+	objset_t *os = db->db_objset;
+
+	if (aww->aww_count >= aww->aww_max)
+		return (1);
+
+	if (os->os_dsl_dataset == NULL || os->os_encrypted ||
+	    DMU_OBJECT_IS_SPECIAL(db->db.db_object) ||
+	    db->db_blkid == DMU_BONUS_BLKID ||
+	    db->db_blkid == DMU_SPILL_BLKID)
+		return (0);
+
+	spa_arc_warm_rec_t *rec = &aww->aww_recs[aww->aww_count++];
+	rec->awr_objset = os->os_dsl_dataset->ds_object;
+	rec->awr_object = db->db.db_object;
+	rec->awr_level = db->db_level;
+	rec->awr_blkid = db->db_blkid;
+
+	return (aww->aww_count == aww->aww_max);
+}
+
+static void
+spa_arc_warm_save_sync(void *arg, dmu_tx_t *tx)
+{
+	spa_arc_warm_save_t *aws = arg;
+	spa_t *spa = dmu_tx_pool(tx)->dp_spa;
+	objset_t *mos = spa_meta_objset(spa);
+	uint64_t size = (aws->aws_count + 1) * sizeof (spa_arc_warm_rec_t);
+
+	if (spa->spa_arc_warm_obj == 0) {
+		spa->spa_arc_warm_obj = dmu_object_alloc(mos,
+		    DMU_OT_UINT64_OTHER, SPA_OLD_MAXBLOCKSIZE, DMU_OT_NONE, 0,
+		    tx);
+		VERIFY0(zap_add(mos, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_ARC_WARM, sizeof (uint64_t), 1,
+		    &spa->spa_arc_warm_obj, tx));
+	}
+
+	aws->aws_recs[0].awr_level = dmu_tx_get_txg(tx);
+	dmu_write(mos, spa->spa_arc_warm_obj, 0, size, aws->aws_recs, tx);
+	VERIFY0(dmu_free_range(mos, spa->spa_arc_warm_obj, size,
+	    DMU_OBJECT_END, tx));
+
+	vmem_free(aws->aws_recs,
+	    (aws->aws_max + 1) * sizeof (spa_arc_warm_rec_t));
+	kmem_free(aws, sizeof (*aws));
+}
+
+/*
+ * Snapshot the bookmarks of the pool's cached dbufs and hand them to a
+ * sync task that writes them out, sorted, to the warm-start object.
+ */
+static void
+spa_arc_warm_save(spa_t *spa)
+{
+	/*
+	 * Read the tunable once: the buffer, the walk and the sync task
+	 * must all agree on its size even if it is changed meanwhile.
+	 */
+	uint64_t max = atomic_load_32(&zfs_arc_warm_max_blocks);
+	spa_arc_warm_walk_t aww;
+	zfs_btree_t tree;
+	zfs_btree_index_t where;
+
+	if (max == 0)
+		return;
+
+	/* Slot 0 is reserved for the header. */
+	aww.aww_recs = vmem_alloc((max + 1) * sizeof (spa_arc_warm_rec_t),
+	    KM_SLEEP);
+	aww.aww_count = 0;
+	aww.aww_max = max;
+	(void) dbuf_walk_cached(spa, spa_arc_warm_walk_cb, &aww);
+
+	/*
+	 * The walk returns dbufs in hash order; sort them so that the replay
+	 * visits each dataset and object only once.
+	 */
+	zfs_btree_create(&tree, spa_arc_warm_rec_compare,
+	    spa_arc_warm_rec_find_in_buf, sizeof (spa_arc_warm_rec_t));
+	for (uint64_t i = 0; i < aww.aww_count; i++) {
+		if (zfs_btree_find(&tree, &aww.aww_recs[i], &where) == NULL)
+			zfs_btree_add_idx(&tree, &aww.aww_recs[i], &where);
+	}
+
+	spa_arc_warm_rec_t *rec = &aww.aww_recs[1];
+	for (spa_arc_warm_rec_t *r = zfs_btree_first(&tree, &where);
+	    r != NULL; r = zfs_btree_next(&tree, &where, &where))
+		*rec++ = *r;
+	aww.aww_count = zfs_btree_numnodes(&tree);
+	zfs_btree_clear(&tree);
+	zfs_btree_destroy(&tree);
+
+	aww.aww_recs[0].awr_objset = SPA_ARC_WARM_MAGIC;
+	aww.aww_recs[0].awr_object = aww.aww_count;
+	aww.aww_recs[0].awr_level = 0;
+	aww.aww_recs[0].awr_blkid = 0;
+
+	spa_arc_warm_save_t *aws = kmem_alloc(sizeof (*aws), KM_SLEEP);
+	aws->aws_recs = aww.aww_recs;
+	aws->aws_count = aww.aww_count;
+	aws->aws_max = max;
+
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	dmu_tx_t *tx = dmu_tx_create_dd(dp->dp_mos_dir);
+	if (dmu_tx_assign(tx, DMU_TX_WAIT) != 0) {
+		dmu_tx_abort(tx);
+		vmem_free(aws->aws_recs,
+		    (max + 1) * sizeof (spa_arc_warm_rec_t));
+		kmem_free(aws, sizeof (*aws));
+		return;
+	}
+	dsl_sync_task_nowait(dp, spa_arc_warm_save_sync, aws, tx);
+	dmu_tx_commit(tx);
+}
+
+static void
+spa_arc_warm_prefetch_done(void *arg, uint64_t level, uint64_t blkid,
+    boolean_t issued)
+{
+	(void) level; (void) blkid; (void) issued;
+	spa_arc_warm_replay_t *awp = arg;
+
+	mutex_enter(&awp->awp_lock);
+	ASSERT3U(awp->awp_pending_io, >, 0);
+	if (--awp->awp_pending_io == 0)
+		cv_broadcast(&awp->awp_cv);
+	mutex_exit(&awp->awp_lock);
+}
+
+/*
+ * Issue prefetches for a batch of sorted records and wait for them to
+ * complete, so that at most one batch of reads is outstanding.
+ */
+static void
+spa_arc_warm_prefetch(spa_t *spa, const spa_arc_warm_rec_t *recs,
+    uint64_t count, spa_arc_warm_replay_t *awp)
+{
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	dsl_dataset_t *ds = NULL;
+	objset_t *os = NULL;
+	dnode_t *dn = NULL;
+	uint64_t cur_ds = 0, cur_obj = 0;
+
+	dsl_pool_config_enter(dp, FTAG);
+	for (uint64_t i = 0; i < count; i++) {
+		const spa_arc_warm_rec_t *rec = &recs[i];
+
+		if (ds == NULL || rec->awr_objset != cur_ds) {
+			if (dn != NULL) {
+				dnode_rele(dn, FTAG);
+				dn = NULL;
+			}
+			if (ds != NULL) {
+				dsl_dataset_rele(ds, FTAG);
+				ds = NULL;
+			}
+			os = NULL;
+			cur_ds = rec->awr_objset;
+			cur_obj = 0;
+			if (dsl_dataset_hold_obj(dp, cur_ds, FTAG, &ds) != 0) {
+				ds = NULL;
+				continue;
+			}
+			if (dmu_objset_from_ds(ds, &os) != 0 ||
+			    os->os_encrypted)
+				os = NULL;
+		}
+		if (os == NULL)
+			continue;
+
+		if (dn == NULL || rec->awr_object != cur_obj) {
+			if (dn != NULL) {
+				dnode_rele(dn, FTAG);
+				dn = NULL;
+			}
+			cur_obj = rec->awr_object;
+			if (dnode_hold(os, cur_obj, FTAG, &dn) != 0) {
+				dn = NULL;
+				continue;
+			}
+		}
+
+		mutex_enter(&awp->awp_lock);
+		awp->awp_pending_io++;
+		mutex_exit(&awp->awp_lock);
+
+		rw_enter(&dn->dn_struct_rwlock, RW_READER);
+		(void) dbuf_prefetch_impl(dn, rec->awr_level, rec->awr_blkid,
+		    ZIO_PRIORITY_ASYNC_READ, 0, spa_arc_warm_prefetch_done,
+		    awp);
+		rw_exit(&dn->dn_struct_rwlock);
+	}
+	if (dn != NULL)
+		dnode_rele(dn, FTAG);
+	if (ds != NULL)
+		dsl_dataset_rele(ds, FTAG);
+	dsl_pool_config_exit(dp, FTAG);
+
+	mutex_enter(&awp->awp_lock);
+	while (awp->awp_pending_io > 0)
+		cv_wait(&awp->awp_cv, &awp->awp_lock);
+	mutex_exit(&awp->awp_lock);
+}
+
+static void
+spa_arc_warm_replay(spa_t *spa, zthr_t *zthr)
+{
+	objset_t *mos = spa_meta_objset(spa);
+	uint64_t obj = spa->spa_arc_warm_obj;
+	spa_arc_warm_rec_t hdr;
+
+	if (obj == 0 || dmu_read(mos, obj, 0, sizeof (hdr), &hdr,
+	    DMU_READ_PREFETCH) != 0 || hdr.awr_objset != SPA_ARC_WARM_MAGIC)
+		return;
+
+	spa_arc_warm_replay_t awp;
+	mutex_init(&awp.awp_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&awp.awp_cv, NULL, CV_DEFAULT, NULL);
+	awp.awp_pending_io = 0;
+
+	spa_arc_warm_rec_t *recs = vmem_alloc(SPA_ARC_WARM_BATCH *
+	    sizeof (spa_arc_warm_rec_t), KM_SLEEP);
+	uint64_t total = MIN(hdr.awr_object, zfs_arc_warm_max_blocks);
+	uint64_t done = 0;
+
+	while (done < total && !zthr_iscancelled(zthr)) {
+		uint64_t count = MIN(total - done, SPA_ARC_WARM_BATCH);
+		if (dmu_read(mos, obj, (done + 1) * sizeof (*recs),
+		    count * sizeof (*recs), recs, DMU_READ_PREFETCH) != 0)
+			break;
+		spa_arc_warm_prefetch(spa, recs, count, &awp);
+		done += count;
+	}
+
+	zfs_dbgmsg("spa=%s arc warm-start replayed %llu/%llu blocks "
+	    "recorded in txg %llu", spa_name(spa), (u_longlong_t)done,
+	    (u_longlong_t)hdr.awr_object, (u_longlong_t)hdr.awr_level);
+
+	vmem_free(recs, SPA_ARC_WARM_BATCH * sizeof (spa_arc_warm_rec_t));
+	mutex_destroy(&awp.awp_lock);
+	cv_destroy(&awp.awp_cv);
+}
+
+static boolean_t
+spa_arc_warm_cb_check(void *arg, zthr_t *zthr)
+{
+	(void) zthr;
+	spa_t *spa = arg;
+
+	if (zfs_arc_warm_max_blocks == 0)
+		return (B_FALSE);
+	if (spa->spa_arc_warm_replay)
+		return (B_TRUE);
+	return (zfs_arc_warm_interval != 0 && gethrestime_sec() >=
+	    spa->spa_arc_warm_last + zfs_arc_warm_interval);
+}
+
+static void
+spa_arc_warm_cb(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+
+	if (spa->spa_arc_warm_replay) {
+		spa_arc_warm_replay(spa, zthr);
+		/*
+		 * Only clear the flag once the replay ran to completion, so
+		 * that a suspended replay resumes rather than being
+		 * overwritten by a record of a still cold cache.
+		 */
+		if (zthr_iscancelled(zthr))
+			return;
+		spa->spa_arc_warm_replay = B_FALSE;
+	} else {
+		spa_arc_warm_save(spa);
+	}
+	spa->spa_arc_warm_last = gethrestime_sec();
+}
+
+void
+spa_arc_warm_start(spa_t *spa)
+{
+	int error = zap_lookup(spa_meta_objset(spa),
+	    DMU_POOL_DIRECTORY_OBJECT, DMU_POOL_ARC_WARM,
+	    sizeof (uint64_t), 1, &spa->spa_arc_warm_obj);
+	if (error != 0)
+		spa->spa_arc_warm_obj = 0;
+	spa->spa_arc_warm_replay = (spa->spa_arc_warm_obj != 0);
+	spa->spa_arc_warm_last = gethrestime_sec();
+
+	ASSERT3P(spa->spa_arc_warm_zthr, ==, NULL);
+	spa->spa_arc_warm_zthr = zthr_create_timer("z_arc_warm",
+	    spa_arc_warm_cb_check, spa_arc_warm_cb, spa, SEC2NSEC(1),
+	    minclsyspri);
+}
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, warm_max_blocks, UINT, ZMOD_RW,
+	"Max cached blocks recorded per pool for ARC warm-start (0=off)");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, warm_interval, UINT, ZMOD_RW,
+	"Seconds between updates of the ARC warm-start record");
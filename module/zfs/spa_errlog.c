@@ -1188,6 +1188,14 @@ sync_error_list(spa_t *spa, avl_tree_t *t, uint64_t *obj, dmu_tx_t *tx)
 			    strlen(name) + 1, name, tx);
 		}
 	} else {
+		/*
+		 * The list is sorted by bookmark, so errors in the same
+		 * dataset are adjacent.  Resolve the head dataset and its
+		 * error log once per run rather than once per error, which
+		 * matters when a failing device logs many thousands of them.
+		 */
+		uint64_t objset = 0, err_obj = 0;
+
 		for (se = avl_first(t); se != NULL; se = AVL_NEXT(t, se)) {
 			zbookmark_err_phys_t zep;
 			zep.zb_object = se->se_zep.zb_object;
@@ -1195,28 +1203,34 @@ sync_error_list(spa_t *spa, avl_tree_t *t, uint64_t *obj, dmu_tx_t *tx)
 			zep.zb_blkid = se->se_zep.zb_blkid;
 			zep.zb_birth = se->se_zep.zb_birth;
 
-			uint64_t head_ds = 0;
-			int error = get_head_ds(spa, se->se_bookmark.zb_objset,
-			    &head_ds);
-
-			/*
-			 * If get_head_ds() errors out, set the head filesystem
-			 * to the filesystem stored in the bookmark of the
-			 * error block.
-			 */
-			if (error != 0)
-				head_ds = se->se_bookmark.zb_objset;
-
-			uint64_t err_obj;
-			error = zap_lookup_int_key(spa->spa_meta_objset,
-			    *obj, head_ds, &err_obj);
-
-			if (error == ENOENT) {
-				err_obj = zap_create(spa->spa_meta_objset,
-				    DMU_OT_ERROR_LOG, DMU_OT_NONE, 0, tx);
-
-				(void) zap_update_int_key(spa->spa_meta_objset,
-				    *obj, head_ds, err_obj, tx);
+			if (err_obj == 0 ||
+			    se->se_bookmark.zb_objset != objset) {
+				objset = se->se_bookmark.zb_objset;
+
+				uint64_t head_ds = 0;
+				int error = get_head_ds(spa, objset, &head_ds);
+
+				/*
+				 * If get_head_ds() errors out, set the head
+				 * filesystem to the filesystem stored in the
+				 * bookmark of the error block.
+				 */
+				if (error != 0)
+					head_ds = objset;
+
+				error = zap_lookup_int_key(spa->spa_meta_objset,
+				    *obj, head_ds, &err_obj);
+
+				if (error == ENOENT) {
+					err_obj = zap_create(
+					    spa->spa_meta_objset,
+					    DMU_OT_ERROR_LOG, DMU_OT_NONE,
+					    0, tx);
+
+					(void) zap_update_int_key(
+					    spa->spa_meta_objset, *obj,
+					    head_ds, err_obj, tx);
+				}
 			}
 			errphys_to_name(&zep, buf, sizeof (buf));
 
@@ -296,6 +296,20 @@ static uint64_t zfs_min_metaslabs_to_flush = 1;
  */
 static uint64_t zfs_max_log_walking = 5;
 
+/*
+ * Maximum number of threads applying log space map entries to the unflushed
+ * trees of the metaslabs during import.  Entries are read in TXG order and
+ * handed to the thread owning their metaslab, so each metaslab still sees
+ * its changes in order.  Limited to the number of CPUs.
+ */
+static uint_t zfs_log_sm_replay_threads = 16;
+
+/*
+ * Number of log space map entries buffered per replay thread before they
+ * are applied.
+ */
+#define	SPA_LD_LOG_SM_BATCH	4096
+
 /*
  * This tunable exists solely for testing purposes. It ensures that the log
  * spacemaps are not flushed and destroyed during export in order for the
@@ -1069,11 +1083,90 @@ spa_ld_log_sm_metadata(spa_t *spa)
 	return (0);
 }
 
+/*
+ * A log space map entry which is to be applied to the unflushed trees of
+ * its metaslab.
+ */
+typedef struct spa_ld_log_sm_ent {
+	metaslab_t	*slle_ms;
+	uint64_t	slle_start;
+	uint64_t	slle_size;
+	maptype_t	slle_type;
+} spa_ld_log_sm_ent_t;
+
+/*
+ * The entries buffered for one replay thread.  A metaslab always maps to
+ * the same shard, so its entries are applied in the order they were read.
+ */
+typedef struct spa_ld_log_sm_shard {
+	spa_ld_log_sm_ent_t	*slsh_ents;
+	uint_t			slsh_count;
+} spa_ld_log_sm_shard_t;
+
 typedef struct spa_ld_log_sm_arg {
 	spa_t *slls_spa;
 	uint64_t slls_txg;
+	taskq_t *slls_tq;
+	spa_ld_log_sm_shard_t *slls_shards;
+	uint_t slls_nshards;
 } spa_ld_log_sm_arg_t;
 
+static void
+spa_ld_log_sm_apply(void *arg)
+{
+	spa_ld_log_sm_shard_t *slsh = arg;
+
+	for (uint_t i = 0; i < slsh->slsh_count; i++) {
+		spa_ld_log_sm_ent_t *e = &slsh->slsh_ents[i];
+		metaslab_t *ms = e->slle_ms;
+		uint64_t end = e->slle_start + e->slle_size;
+
+		switch (e->slle_type) {
+		case SM_ALLOC:
+			zfs_range_tree_remove_xor_add_segment(e->slle_start,
+			    end, ms->ms_unflushed_frees,
+			    ms->ms_unflushed_allocs);
+			break;
+		case SM_FREE:
+			zfs_range_tree_remove_xor_add_segment(e->slle_start,
+			    end, ms->ms_unflushed_allocs,
+			    ms->ms_unflushed_frees);
+			break;
+		default:
+			panic("invalid maptype_t");
+			break;
+		}
+
+		/*
+		 * The log summary is updated for the dirtied metaslabs once
+		 * all entries have been applied [see spa_ld_log_sm_data()].
+		 */
+		metaslab_set_unflushed_dirty(ms, B_TRUE);
+	}
+	slsh->slsh_count = 0;
+}
+
+/*
+ * Apply all buffered entries, each shard by its own thread.
+ */
+static void
+spa_ld_log_sm_apply_all(spa_ld_log_sm_arg_t *slls)
+{
+	if (slls->slls_nshards == 1) {
+		spa_ld_log_sm_apply(&slls->slls_shards[0]);
+		return;
+	}
+
+	for (uint_t i = 0; i < slls->slls_nshards; i++) {
+		spa_ld_log_sm_shard_t *slsh = &slls->slls_shards[i];
+		if (slsh->slsh_count == 0)
+			continue;
+		VERIFY3U(taskq_dispatch(slls->slls_tq, spa_ld_log_sm_apply,
+		    slsh, TQ_SLEEP), !=, TASKQID_INVALID);
+	}
+	taskq_wait(slls->slls_tq);
+}
+
 static int
 spa_ld_log_sm_cb(space_map_entry_t *sme, void *arg)
 {
@@ -1107,24 +1200,19 @@ spa_ld_log_sm_cb(space_map_entry_t *sme, void *arg)
 	if (slls->slls_txg < metaslab_unflushed_txg(ms))
 		return (0);
 
-	switch (sme->sme_type) {
-	case SM_ALLOC:
-		zfs_range_tree_remove_xor_add_segment(offset, offset + size,
-		    ms->ms_unflushed_frees, ms->ms_unflushed_allocs);
-		break;
-	case SM_FREE:
-		zfs_range_tree_remove_xor_add_segment(offset, offset + size,
-		    ms->ms_unflushed_allocs, ms->ms_unflushed_frees);
-		break;
-	default:
-		panic("invalid maptype_t");
-		break;
-	}
-	if (!metaslab_unflushed_dirty(ms)) {
-		metaslab_set_unflushed_dirty(ms, B_TRUE);
-		spa_log_summary_dirty_flushed_metaslab(spa,
-		    metaslab_unflushed_txg(ms));
-	}
+	ASSERT(sme->sme_type == SM_ALLOC || sme->sme_type == SM_FREE);
+
+	spa_ld_log_sm_shard_t *slsh = &slls->slls_shards[
+	    (vdev_id + ms->ms_id) % slls->slls_nshards];
+	spa_ld_log_sm_ent_t *e = &slsh->slsh_ents[slsh->slsh_count++];
+	e->slle_ms = ms;
+	e->slle_start = offset;
+	e->slle_size = size;
+	e->slle_type = sme->sme_type;
+
+	if (slsh->slsh_count == SPA_LD_LOG_SM_BATCH)
+		spa_ld_log_sm_apply_all(slls);
+
 	return (0);
 }
 
@@ -1146,6 +1234,26 @@ spa_ld_log_sm_data(spa_t *spa)
 
 	hrtime_t read_logs_starttime = gethrtime();
 
+	/*
+	 * The entries are read by this thread and applied to the metaslabs
+	 * by up to zfs_log_sm_replay_threads threads.
+	 */
+	struct spa_ld_log_sm_arg vla = {
+		.slls_spa = spa,
+		.slls_nshards = MAX(1, MIN(zfs_log_sm_replay_threads,
+		    boot_ncpus)),
+	};
+	vla.slls_shards = kmem_zalloc(vla.slls_nshards *
+	    sizeof (spa_ld_log_sm_shard_t), KM_SLEEP);
+	for (uint_t i = 0; i < vla.slls_nshards; i++) {
+		vla.slls_shards[i].slsh_ents = vmem_alloc(SPA_LD_LOG_SM_BATCH *
+		    sizeof (spa_ld_log_sm_ent_t), KM_SLEEP);
+	}
+	if (vla.slls_nshards > 1) {
+		vla.slls_tq = taskq_create("z_log_sm_replay", vla.slls_nshards,
+		    minclsyspri, vla.slls_nshards, INT_MAX, TASKQ_PREPOPULATE);
+	}
+
 	/* Prefetch log spacemaps dnodes. */
 	for (sls = avl_first(&spa->spa_sm_logs_by_txg); sls;
 	    sls = AVL_NEXT(&spa->spa_sm_logs_by_txg, sls)) {
@@ -1192,10 +1300,7 @@ spa_ld_log_sm_data(spa_t *spa)
 		    "Read %llu of %lu log space maps", (u_longlong_t)nsm,
 		    avl_numnodes(&spa->spa_sm_logs_by_txg));
 
-		struct spa_ld_log_sm_arg vla = {
-			.slls_spa = spa,
-			.slls_txg = sls->sls_txg
-		};
+		vla.slls_txg = sls->sls_txg;
 		error = space_map_iterate(sls->sls_sm,
 		    space_map_length(sls->sls_sm), spa_ld_log_sm_cb, &vla);
 		if (error != 0) {
@@ -1216,6 +1321,8 @@ spa_ld_log_sm_data(spa_t *spa)
 		spa_log_sm_set_blocklimit(spa);
 	}
 
+	spa_ld_log_sm_apply_all(&vla);
+
 	hrtime_t read_logs_endtime = gethrtime();
 	spa_load_note(spa,
 	    "Read %lu log space maps (%llu total blocks - blksz = %llu bytes) "
@@ -1225,6 +1332,21 @@ spa_ld_log_sm_data(spa_t *spa)
 	    (longlong_t)NSEC2MSEC(read_logs_endtime - read_logs_starttime));
 
 out:
+	/*
+	 * On error the unflushed trees are torn down by spa_unload(), so
+	 * it does not matter whether any buffered entries were applied.
+	 */
+	if (vla.slls_tq != NULL) {
+		taskq_wait(vla.slls_tq);
+		taskq_destroy(vla.slls_tq);
+	}
+	for (uint_t i = 0; i < vla.slls_nshards; i++) {
+		vmem_free(vla.slls_shards[i].slsh_ents, SPA_LD_LOG_SM_BATCH *
+		    sizeof (spa_ld_log_sm_ent_t));
+	}
+	kmem_free(vla.slls_shards, vla.slls_nshards *
+	    sizeof (spa_ld_log_sm_shard_t));
+
 	if (error != 0) {
 		for (spa_log_sm_t *sls = avl_first(&spa->spa_sm_logs_by_txg);
 		    sls; sls = AVL_NEXT(&spa->spa_sm_logs_by_txg, sls)) {
@@ -1242,7 +1364,8 @@ out:
 	 * [1] recalculate their actual allocated space
 	 * [2] recalculate their weights
 	 * [3] sum up the memory usage of their unflushed range trees
-	 * [4] optionally load them, if debug_load is set
+	 * [4] account for them in the log summary if they were dirtied
+	 * [5] optionally load them, if debug_load is set
 	 *
 	 * Note that even in the case where we get here because of an
 	 * error (e.g. error != 0), we still want to update the fields
@@ -1267,6 +1390,11 @@ out:
 		spa->spa_unflushed_stats.sus_memused +=
 		    metaslab_unflushed_changes_memused(m);
 
+		if (metaslab_unflushed_dirty(m)) {
+			spa_log_summary_dirty_flushed_metaslab(spa,
+			    metaslab_unflushed_txg(m));
+		}
+
 		if (metaslab_debug_load && m->ms_sm != NULL) {
 			VERIFY0(metaslab_load(m));
 			metaslab_set_selected_txg(m, 0);
@@ -1405,3 +1533,6 @@ ZFS_MODULE_PARAM(zfs, zfs_, max_logsm_summary_length, U64, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs, zfs_, min_metaslabs_to_flush, U64, ZMOD_RW,
 	"Minimum number of metaslabs to flush per dirty TXG");
+
+ZFS_MODULE_PARAM(zfs, zfs_, log_sm_replay_threads, UINT, ZMOD_RW,
+	"Max threads applying log spacemap entries at import");
@@ -66,6 +66,8 @@
 #include <sys/btree.h>
 #include <sys/zfeature.h>
 #include <sys/qat.h>
+#include <sys/zio_offload.h>
+#include <sys/zcp.h>
 #include <sys/zstd/zstd.h>
 
 /*
@@ -392,11 +394,19 @@ static const uint64_t spa_min_slop = 128ULL * 1024 * 1024;
 static const uint64_t spa_max_slop = 128ULL * 1024 * 1024 * 1024;
 
 /*
- * Number of allocators to use, per spa instance
+ * Maximum number of allocators to use, per spa instance.  Of these only
+ * spa_alloc_active are used for new writes; see spa_alloc_rebalance().
  */
-static int spa_num_allocators = 4;
+static int spa_num_allocators = 16;
 static int spa_cpus_per_allocator = 4;
 
+/*
+ * Percentage of metaslab allocations which had to wait for the ms_lock of
+ * their allocator's metaslab during a txg above which another allocator is
+ * put in to use.  Below a quarter of it an allocator is retired.
+ */
+static uint_t spa_alloc_contention_pct = 5;
+
 /*
  * Spa active allocator.
  * Valid values are zfs_active_allocator=<dynamic|cursor|new-dynamic>.
@@ -765,6 +775,9 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 		mutex_init(&spa->spa_allocs_use->sau_lock, NULL, MUTEX_DEFAULT,
 		    NULL);
 	}
+	spa->spa_alloc_active = spa->spa_alloc_count;
+	wmsum_init(&spa->spa_alloc_locked, 0);
+	wmsum_init(&spa->spa_alloc_contended, 0);
 
 	avl_create(&spa->spa_metaslabs_by_flushed, metaslab_sort_by_flushed,
 	    sizeof (metaslab_t), offsetof(metaslab_t, ms_spa_txg_node));
@@ -819,6 +832,7 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 	for (int i = 0; i < SPA_FEATURES; i++) {
 		spa->spa_feat_refcount_cache[i] = SPA_FEATURE_DISABLED;
 	}
+	spa->spa_gang_header_txg = UINT64_MAX;
 
 	list_create(&spa->spa_leaf_list, sizeof (vdev_t),
 	    offsetof(vdev_t, vdev_leaf_node));
@@ -859,6 +873,8 @@ spa_remove(spa_t *spa)
 		kmem_free(spa->spa_allocs_use, offsetof(spa_allocs_use_t,
 		    sau_inuse[spa->spa_alloc_count]));
 	}
+	wmsum_fini(&spa->spa_alloc_locked);
+	wmsum_fini(&spa->spa_alloc_contended);
 
 	avl_destroy(&spa->spa_metaslabs_by_flushed);
 	avl_destroy(&spa->spa_sm_logs_by_txg);
@@ -1457,6 +1473,40 @@ spa_vdev_state_exit(spa_t *spa, vdev_t *vd, int error)
 	return (error);
 }
 
+/*
+ * Called once per txg from spa_sync() to adjust the number of allocators
+ * used for new writes to the write concurrency.  Allocator shards keep
+ * their own primary metaslab, so when writers frequently wait on the
+ * ms_lock of their allocator's metaslab another allocator is put in to use,
+ * up to one per spa_cpus_per_allocator online CPUs.  When there is little
+ * contention allocators are retired one at a time, which keeps the number
+ * of metaslabs being written to (and the resulting fragmentation) low.
+ * Retired allocators keep their metaslabs until they are used again.
+ */
+void
+spa_alloc_rebalance(spa_t *spa)
+{
+	uint64_t locked = wmsum_value(&spa->spa_alloc_locked);
+	uint64_t contended = wmsum_value(&spa->spa_alloc_contended);
+	uint64_t dlocked = locked - spa->spa_alloc_locked_last;
+	uint64_t dcontended = contended - spa->spa_alloc_contended_last;
+	int active = spa->spa_alloc_active;
+	int limit = MAX(MIN(spa->spa_alloc_count,
+	    (int)boot_ncpus / MAX(spa_cpus_per_allocator, 1)), 1);
+
+	spa->spa_alloc_locked_last = locked;
+	spa->spa_alloc_contended_last = contended;
+
+	if (dlocked != 0 && dcontended * 100 >
+	    dlocked * spa_alloc_contention_pct) {
+		active = MIN(active * 2, limit);
+	} else if (dcontended * 400 < dlocked * spa_alloc_contention_pct) {
+		active = MAX(active - 1, 1);
+	}
+
+	spa->spa_alloc_active = MIN(active, limit);
+}
+
 /*
  * ==========================================================================
  * Miscellaneous functions
@@ -2063,13 +2113,22 @@ spa_preferred_class(spa_t *spa, const zio_t *zio)
 			return (spa_normal_class(spa));
 	}
 
+	/*
+	 * Blocks rewritten by zfs_rewrite() to demote them are kept out
+	 * of the special class regardless of their size.
+	 */
+	if (zp->zp_class_hint == ZIO_CLASS_HINT_NORMAL)
+		return (spa_normal_class(spa));
+
 	/*
 	 * Allow small file blocks in special class in some cases (like
-	 * for the dRAID vdev feature). But always leave a reserve of
+	 * for the dRAID vdev feature), as well as file blocks explicitly
+	 * promoted by zfs_rewrite(). But always leave a reserve of
 	 * zfs_special_class_metadata_reserve_pct exclusively for metadata.
 	 */
-	if (DMU_OT_IS_FILE(objtype) &&
-	    has_special_class && zio->io_size <= zp->zp_zpl_smallblk) {
+	if (DMU_OT_IS_FILE(objtype) && has_special_class &&
+	    (zio->io_size <= zp->zp_zpl_smallblk ||
+	    zp->zp_class_hint == ZIO_CLASS_HINT_SPECIAL)) {
 		metaslab_class_t *special = spa_special_class(spa);
 		uint64_t alloc = metaslab_class_get_alloc(special);
 		uint64_t space = metaslab_class_get_space(special);
@@ -2257,6 +2316,7 @@ typedef struct spa_import_progress {
 	char			*spa_load_notes;
 	uint64_t		mmp_sec_remaining;	/* MMP activity check */
 	uint64_t		spa_load_max_txg;	/* rewind txg */
+	hrtime_t		spa_load_step_start;	/* current step */
 	procfs_list_node_t	smh_node;
 } spa_import_progress_t;
 
@@ -2265,9 +2325,9 @@ spa_history_list_t *spa_import_progress_list = NULL;
 static int
 spa_import_progress_show_header(struct seq_file *f)
 {
-	seq_printf(f, "%-20s %-14s %-14s %-12s %-16s %s\n", "pool_guid",
-	    "load_state", "multihost_secs", "max_txg",
-	    "pool_name", "notes");
+	seq_printf(f, "%-20s %-14s %-14s %-12s %-10s %-16s %s\n",
+	    "pool_guid", "load_state", "multihost_secs", "max_txg",
+	    "step_ms", "pool_name", "notes");
 	return (0);
 }
 
@@ -2276,10 +2336,13 @@ spa_import_progress_show(struct seq_file *f, void *data)
 {
 	spa_import_progress_t *sip = (spa_import_progress_t *)data;
 
-	seq_printf(f, "%-20llu %-14llu %-14llu %-12llu %-16s %s\n",
+	uint64_t step_ms = sip->spa_load_step_start == 0 ? 0 :
+	    NSEC2MSEC(gethrtime() - sip->spa_load_step_start);
+
+	seq_printf(f, "%-20llu %-14llu %-14llu %-12llu %-10llu %-16s %s\n",
 	    (u_longlong_t)sip->pool_guid, (u_longlong_t)sip->spa_load_state,
 	    (u_longlong_t)sip->mmp_sec_remaining,
-	    (u_longlong_t)sip->spa_load_max_txg,
+	    (u_longlong_t)sip->spa_load_max_txg, (u_longlong_t)step_ms,
 	    (sip->pool_name ? sip->pool_name : "-"),
 	    (sip->spa_load_notes ? sip->spa_load_notes : "-"));
 
@@ -2387,8 +2450,24 @@ spa_import_progress_set_notes_impl(spa_t *spa, boolean_t log_dbgmsg,
 				sip->spa_load_notes = NULL;
 			}
 			sip->spa_load_notes = notes;
-			if (log_dbgmsg)
-				zfs_dbgmsg("'%s' %s", sip->pool_name, notes);
+			/*
+			 * Logged notes start a new step of the import, and
+			 * record how long the previous one took.  Unlogged
+			 * notes only report progress within a step.
+			 */
+			if (log_dbgmsg) {
+				hrtime_t now = gethrtime();
+				if (sip->spa_load_step_start != 0) {
+					zfs_dbgmsg("'%s' %s (previous step "
+					    "took %llu ms)", sip->pool_name,
+					    notes, (u_longlong_t)NSEC2MSEC(
+					    now - sip->spa_load_step_start));
+				} else {
+					zfs_dbgmsg("'%s' %s", sip->pool_name,
+					    notes);
+				}
+				sip->spa_load_step_start = now;
+			}
 			notes = NULL;
 			break;
 		}
@@ -2589,7 +2668,9 @@ spa_init(spa_mode_t mode)
 	dmu_init();
 	zil_init();
 	vdev_mirror_stat_init();
+	vdev_queue_stat_init();
 	vdev_raidz_math_init();
+	vdev_raidz_combrec_init();
 	vdev_file_init();
 	zfs_prop_init();
 	chksum_init();
@@ -2599,9 +2680,11 @@ spa_init(spa_mode_t mode)
 	vdev_prop_init();
 	l2arc_start();
 	scan_init();
+	zio_offload_init();
 	qat_init();
 	spa_import_progress_init();
 	zap_init();
+	zcp_init();
 }
 
 void
@@ -2612,7 +2695,9 @@ spa_fini(void)
 	spa_evict_all();
 
 	vdev_file_fini();
+	vdev_queue_stat_fini();
 	vdev_mirror_stat_fini();
+	vdev_raidz_combrec_fini();
 	vdev_raidz_math_fini();
 	chksum_fini();
 	zil_fini();
@@ -2627,8 +2712,10 @@ spa_fini(void)
 	fm_fini();
 	scan_fini();
 	qat_fini();
+	zio_offload_fini();
 	spa_import_progress_destroy();
 	zap_fini();
+	zcp_fini();
 
 	avl_destroy(&spa_namespace_avl);
 	avl_destroy(&spa_spare_avl);
@@ -3163,3 +3250,6 @@ ZFS_MODULE_PARAM(zfs, spa_, num_allocators, INT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs, spa_, cpus_per_allocator, INT, ZMOD_RW,
 	"Minimum number of CPUs per allocators");
+
+ZFS_MODULE_PARAM(zfs, spa_, alloc_contention_pct, UINT, ZMOD_RW,
+	"Percent of contended allocations to add an allocator");
@@ -23,6 +23,7 @@
 #include <sys/zfs_context.h>
 #include <sys/spa_impl.h>
 #include <sys/vdev_impl.h>
+#include <sys/zio_impl.h>
 #include <sys/spa.h>
 #include <zfs_comutil.h>
 
@@ -200,6 +201,9 @@ typedef struct spa_txg_history {
 	uint64_t	writes;		/* number of write operations */
 	uint64_t	ndirty;		/* number of dirty bytes */
 	hrtime_t	times[TXG_STATE_COMMITTED]; /* completion times */
+	hrtime_t	phase[SPA_SYNC_PHASES];	/* spa_sync() phase times */
+	uint64_t	pass_blocks[SPA_SYNC_PASS_HIST]; /* blocks per pass */
+	uint32_t	passes;		/* number of sync passes */
 	procfs_list_node_t	sth_node;
 } spa_txg_history_t;
 
@@ -207,9 +211,13 @@ static int
 spa_txg_history_show_header(struct seq_file *f)
 {
 	seq_printf(f, "%-8s %-16s %-5s %-12s %-12s %-12s "
-	    "%-8s %-8s %-12s %-12s %-12s %-12s\n", "txg", "birth", "state",
+	    "%-8s %-8s %-12s %-12s %-12s %-12s ", "txg", "birth", "state",
 	    "ndirty", "nread", "nwritten", "reads", "writes",
 	    "otime", "qtime", "wtime", "stime");
+	seq_printf(f, "%-12s %-12s %-12s %-12s %-12s %-12s %-12s %-12s "
+	    "%-12s %-6s %-8s %-8s %-8s %-8s\n", "dstime", "mostime",
+	    "tktime", "frtime", "ddtime", "lftime", "vdtime", "dftime",
+	    "cftime", "passes", "blk1", "blk2", "blk3", "blk4+");
 	return (0);
 }
 
@@ -247,13 +255,20 @@ spa_txg_history_show(struct seq_file *f, void *data)
 		    sth->times[TXG_STATE_WAIT_FOR_SYNC];
 
 	seq_printf(f, "%-8llu %-16llu %-5c %-12llu "
-	    "%-12llu %-12llu %-8llu %-8llu %-12llu %-12llu %-12llu %-12llu\n",
+	    "%-12llu %-12llu %-8llu %-8llu %-12llu %-12llu %-12llu %-12llu ",
 	    (longlong_t)sth->txg, sth->times[TXG_STATE_BIRTH], state,
 	    (u_longlong_t)sth->ndirty,
 	    (u_longlong_t)sth->nread, (u_longlong_t)sth->nwritten,
 	    (u_longlong_t)sth->reads, (u_longlong_t)sth->writes,
 	    (u_longlong_t)open, (u_longlong_t)quiesce, (u_longlong_t)wait,
 	    (u_longlong_t)sync);
+	for (int p = 0; p < SPA_SYNC_PHASES; p++)
+		seq_printf(f, "%-12llu ", (u_longlong_t)sth->phase[p]);
+	seq_printf(f, "%-6u %-8llu %-8llu %-8llu %-8llu\n", sth->passes,
+	    (u_longlong_t)sth->pass_blocks[0],
+	    (u_longlong_t)sth->pass_blocks[1],
+	    (u_longlong_t)sth->pass_blocks[2],
+	    (u_longlong_t)sth->pass_blocks[3]);
 
 	return (0);
 }
@@ -397,6 +412,49 @@ spa_txg_history_set_io(spa_t *spa, uint64_t txg, uint64_t nread,
 	return (error);
 }
 
+/*
+ * Set txg spa_sync() phase times and per-pass block counts.  Only called
+ * from the sync thread once spa_sync() has returned, so the spa fields
+ * are stable.
+ */
+static int
+spa_txg_history_set_phases(spa_t *spa, uint64_t txg)
+{
+	spa_history_list_t *shl = &spa->spa_stats.txg_history;
+	spa_txg_history_t *sth;
+	int error = ENOENT;
+
+	if (zfs_txg_history == 0)
+		return (0);
+
+	mutex_enter(&shl->procfs_list.pl_lock);
+	for (sth = list_tail(&shl->procfs_list.pl_list); sth != NULL;
+	    sth = list_prev(&shl->procfs_list.pl_list, sth)) {
+		if (sth->txg == txg) {
+			memcpy(sth->phase, spa->spa_sync_phase_time,
+			    sizeof (sth->phase));
+			memcpy(sth->pass_blocks, spa->spa_sync_pass_blocks,
+			    sizeof (sth->pass_blocks));
+			sth->passes = spa->spa_sync_passes;
+			error = 0;
+			break;
+		}
+	}
+	mutex_exit(&shl->procfs_list.pl_lock);
+
+	return (error);
+}
+
+/*
+ * Charge the time since 'start' to the given spa_sync() phase.
+ */
+void
+spa_sync_phase_add(spa_t *spa, spa_sync_phase_t phase, hrtime_t start)
+{
+	ASSERT3U(phase, <, SPA_SYNC_PHASES);
+	spa->spa_sync_phase_time[phase] += gethrtime() - start;
+}
+
 txg_stat_t *
 spa_txg_history_init_io(spa_t *spa, uint64_t txg, dsl_pool_t *dp)
 {
@@ -441,6 +499,7 @@ spa_txg_history_fini_io(spa_t *spa, txg_stat_t *ts)
 	    ts->vs2.vs_ops[ZIO_TYPE_READ] - ts->vs1.vs_ops[ZIO_TYPE_READ],
 	    ts->vs2.vs_ops[ZIO_TYPE_WRITE] - ts->vs1.vs_ops[ZIO_TYPE_WRITE],
 	    ts->ndirty);
+	spa_txg_history_set_phases(spa, ts->txg);
 
 	kmem_free(ts, sizeof (txg_stat_t));
 }
@@ -549,6 +608,140 @@ spa_tx_assign_add_nsecs(spa_t *spa, uint64_t nsecs)
 	atomic_inc_64(&((kstat_named_t *)shk->priv)[idx].value.ui64);
 }
 
+/*
+ * ==========================================================================
+ * SPA ZIO Pipeline Stage Histogram Routines
+ * ==========================================================================
+ */
+
+/*
+ * Latency of each zio pipeline stage, collected while zio_stage_histograms
+ * is set.  The time charged to a stage runs from its start until the next
+ * stage of the same zio starts, so it includes waiting for children, for
+ * the vdev queue and for the device.  Bucket n counts the stages which took
+ * less than 2^n microseconds (2^n * 1024 ns); the last one also counts all
+ * slower ones.  Output in /proc/spl/kstat/zfs/<pool>/zio_stages is one row
+ * per stage:
+ *
+ * stage                    1us     2us     4us ...     4s      8s
+ * write_compress          1840     391      12 ...      0       0
+ */
+#define	SPA_ZIO_STAGE_BUCKETS	24
+
+static int
+spa_zio_stages_headers(char *buf, size_t size)
+{
+	ssize_t off = 0;
+
+	off += kmem_scnprintf(buf + off, size - off, "%-20s", "stage");
+	for (int b = 0; b < SPA_ZIO_STAGE_BUCKETS; b++) {
+		u_longlong_t us = 1ULL << b;
+		char label[16];
+
+		if (us < 1000)
+			(void) snprintf(label, sizeof (label), "%lluus", us);
+		else if (us < 1000000)
+			(void) snprintf(label, sizeof (label), "%llums",
+			    us / 1000);
+		else
+			(void) snprintf(label, sizeof (label), "%llus",
+			    us / 1000000);
+		off += kmem_scnprintf(buf + off, size - off, " %7s", label);
+	}
+	(void) kmem_scnprintf(buf + off, size - off, "\n");
+
+	return (0);
+}
+
+static int
+spa_zio_stages_data(char *buf, size_t size, void *data)
+{
+	uint64_t *row = data;
+	ssize_t off = 0;
+
+	off += kmem_scnprintf(buf + off, size - off, "%-20s",
+	    zio_stage_names[row[SPA_ZIO_STAGE_BUCKETS]]);
+	for (int b = 0; b < SPA_ZIO_STAGE_BUCKETS; b++) {
+		off += kmem_scnprintf(buf + off, size - off, " %7llu",
+		    (u_longlong_t)atomic_load_64(&row[b]));
+	}
+	(void) kmem_scnprintf(buf + off, size - off, "\n");
+
+	return (0);
+}
+
+/*
+ * Each row holds the bucket counts followed by the stage index.
+ */
+static void *
+spa_zio_stages_addr(kstat_t *ksp, loff_t n)
+{
+	spa_t *spa = ksp->ks_private;
+	uint64_t *rows = spa->spa_stats.zio_stages.priv;
+
+	if (n < 0 || n >= ZIO_STAGES)
+		return (NULL);
+	return (&rows[n * (SPA_ZIO_STAGE_BUCKETS + 1)]);
+}
+
+static void
+spa_zio_stages_init(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.zio_stages;
+	uint64_t *rows;
+	char *name;
+	kstat_t *ksp;
+
+	mutex_init(&shk->lock, NULL, MUTEX_DEFAULT, NULL);
+
+	shk->count = ZIO_STAGES;
+	shk->size = ZIO_STAGES * (SPA_ZIO_STAGE_BUCKETS + 1) *
+	    sizeof (uint64_t);
+	shk->priv = rows = kmem_zalloc(shk->size, KM_SLEEP);
+	for (int s = 0; s < ZIO_STAGES; s++) {
+		rows[s * (SPA_ZIO_STAGE_BUCKETS + 1) +
+		    SPA_ZIO_STAGE_BUCKETS] = s;
+	}
+
+	name = kmem_asprintf("zfs/%s", spa_name(spa));
+	ksp = kstat_create(name, 0, "zio_stages", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+	shk->kstat = ksp;
+
+	if (ksp) {
+		ksp->ks_lock = &shk->lock;
+		ksp->ks_data = NULL;
+		ksp->ks_ndata = UINT32_MAX;
+		ksp->ks_private = spa;
+		kstat_set_raw_ops(ksp, spa_zio_stages_headers,
+		    spa_zio_stages_data, spa_zio_stages_addr);
+		kstat_install(ksp);
+	}
+	kmem_strfree(name);
+}
+
+static void
+spa_zio_stages_destroy(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.zio_stages;
+
+	if (shk->kstat)
+		kstat_delete(shk->kstat);
+
+	kmem_free(shk->priv, shk->size);
+	mutex_destroy(&shk->lock);
+}
+
+void
+spa_zio_stage_add_nsecs(spa_t *spa, int stage, uint64_t nsecs)
+{
+	uint64_t *rows = spa->spa_stats.zio_stages.priv;
+	int b = MIN(highbit64(nsecs >> 10), SPA_ZIO_STAGE_BUCKETS - 1);
+
+	ASSERT3S(stage, <, ZIO_STAGES);
+	atomic_inc_64(&rows[stage * (SPA_ZIO_STAGE_BUCKETS + 1) + b]);
+}
+
 /*
  * ==========================================================================
  * SPA MMP History Routines
@@ -904,6 +1097,16 @@ static const spa_iostats_t spa_iostats_template = {
 	{ "direct_read_bytes",			KSTAT_DATA_UINT64 },
 	{ "direct_write_count",			KSTAT_DATA_UINT64 },
 	{ "direct_write_bytes",			KSTAT_DATA_UINT64 },
+	{ "config_syncs",			KSTAT_DATA_UINT64 },
+	{ "config_flush_nsecs",			KSTAT_DATA_UINT64 },
+	{ "config_label_nsecs",			KSTAT_DATA_UINT64 },
+	{ "config_uberblock_nsecs",		KSTAT_DATA_UINT64 },
+	{ "alloc_throttle_normal_count",	KSTAT_DATA_UINT64 },
+	{ "alloc_throttle_normal_nsecs",	KSTAT_DATA_UINT64 },
+	{ "alloc_throttle_special_count",	KSTAT_DATA_UINT64 },
+	{ "alloc_throttle_special_nsecs",	KSTAT_DATA_UINT64 },
+	{ "alloc_throttle_dedup_count",		KSTAT_DATA_UINT64 },
+	{ "alloc_throttle_dedup_nsecs",		KSTAT_DATA_UINT64 },
 };
 
 #define	SPA_IOSTATS_ADD(stat, val) \
@@ -987,6 +1190,55 @@ spa_iostats_write_add(spa_t *spa, uint64_t size, uint64_t iops,
 	}
 }
 
+/*
+ * Account a completed vdev_config_sync(): the time spent flushing the
+ * disks written in the txg, writing and flushing both label waves, and
+ * writing and flushing the uberblocks.
+ */
+void
+spa_iostats_config_sync_add(spa_t *spa, hrtime_t flush, hrtime_t labels,
+    hrtime_t uberblocks)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.iostats;
+	kstat_t *ksp = shk->kstat;
+
+	if (ksp == NULL)
+		return;
+
+	spa_iostats_t *iostats = ksp->ks_data;
+	SPA_IOSTATS_ADD(config_syncs, 1);
+	SPA_IOSTATS_ADD(config_flush_nsecs, flush);
+	SPA_IOSTATS_ADD(config_label_nsecs, labels);
+	SPA_IOSTATS_ADD(config_uberblock_nsecs, uberblocks);
+}
+
+/*
+ * Account a write that the allocation throttle held back: the time it
+ * spent queued on its class allocator before a reservation was granted.
+ */
+void
+spa_iostats_alloc_throttle_add(spa_t *spa, metaslab_class_t *mc,
+    hrtime_t wait)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.iostats;
+	kstat_t *ksp = shk->kstat;
+
+	if (ksp == NULL)
+		return;
+
+	spa_iostats_t *iostats = ksp->ks_data;
+	if (mc == spa_normal_class(spa)) {
+		SPA_IOSTATS_ADD(alloc_throttle_normal_count, 1);
+		SPA_IOSTATS_ADD(alloc_throttle_normal_nsecs, wait);
+	} else if (mc == spa_special_class(spa)) {
+		SPA_IOSTATS_ADD(alloc_throttle_special_count, 1);
+		SPA_IOSTATS_ADD(alloc_throttle_special_nsecs, wait);
+	} else if (mc == spa_dedup_class(spa)) {
+		SPA_IOSTATS_ADD(alloc_throttle_dedup_count, 1);
+		SPA_IOSTATS_ADD(alloc_throttle_dedup_nsecs, wait);
+	}
+}
+
 static int
 spa_iostats_update(kstat_t *ksp, int rw)
 {
@@ -1047,11 +1299,13 @@ spa_stats_init(spa_t *spa)
 	spa_state_init(spa);
 	spa_guid_init(spa);
 	spa_iostats_init(spa);
+	spa_zio_stages_init(spa);
 }
 
 void
 spa_stats_destroy(spa_t *spa)
 {
+	spa_zio_stages_destroy(spa);
 	spa_iostats_destroy(spa);
 	spa_health_destroy(spa);
 	spa_tx_assign_destroy(spa);
@@ -651,6 +651,13 @@ txg_quiesce_thread(void *arg)
 
 		mutex_exit(&tx->tx_sync_lock);
 		txg_quiesce(dp, txg);
+
+		/*
+		 * While the previous txg is still syncing, start writing
+		 * out the data of this one.
+		 */
+		if (tx->tx_syncing_txg != 0)
+			dsl_pool_early_write(dp, txg);
 		mutex_enter(&tx->tx_sync_lock);
 
 		/*
@@ -727,6 +727,7 @@ vdev_alloc_common(spa_t *spa, uint_t id, uint64_t guid, vdev_ops_t *ops)
 	mutex_init(&vd->vdev_dtl_lock, NULL, MUTEX_NOLOCKDEP, NULL);
 	mutex_init(&vd->vdev_stat_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&vd->vdev_probe_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&vd->vdev_zil_flush_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&vd->vdev_scan_io_queue_lock, NULL, MUTEX_DEFAULT, NULL);
 
 	mutex_init(&vd->vdev_initialize_lock, NULL, MUTEX_DEFAULT, NULL);
@@ -1194,6 +1195,9 @@ vdev_free(vdev_t *vd)
 	mutex_destroy(&vd->vdev_dtl_lock);
 	mutex_destroy(&vd->vdev_stat_lock);
 	mutex_destroy(&vd->vdev_probe_lock);
+	ASSERT3P(vd->vdev_zil_flush_next, ==, NULL);
+	ASSERT(!vd->vdev_zil_flush_active);
+	mutex_destroy(&vd->vdev_zil_flush_lock);
 	mutex_destroy(&vd->vdev_scan_io_queue_lock);
 
 	mutex_destroy(&vd->vdev_initialize_lock);
@@ -4801,7 +4805,9 @@ vdev_get_stats_ex_impl(vdev_t *vd, vdev_stat_t *vs, vdev_stat_ex_t *vsx)
 		memcpy(vsx, &vd->vdev_stat_ex, sizeof (vd->vdev_stat_ex));
 
 		for (t = 0; t < ZIO_PRIORITY_NUM_QUEUEABLE; t++) {
-			vsx->vsx_active_queue[t] = vd->vdev_queue.vq_cactive[t];
+			vsx->vsx_active_queue[t] =
+			    vd->vdev_queue.vq_cactive[t] +
+			    vd->vdev_queue.vq_mq_cactive[t];
 			vsx->vsx_pend_queue[t] = vdev_queue_class_length(vd, t);
 		}
 	}
@@ -5681,6 +5687,14 @@ vdev_deadman(vdev_t *vd, const char *tag)
 				zio_deadman(fio, tag);
 		}
 		mutex_exit(&vq->vq_lock);
+
+		/* I/Os which bypassed the queue are tracked separately. */
+		mutex_enter(&vq->vq_bypass_lock);
+		zio_t *bio = list_head(&vq->vq_bypass_list);
+		if (bio != NULL && gethrtime() - bio->io_timestamp >
+		    spa_deadman_synctime(vd->vdev_spa))
+			zio_deadman(bio, tag);
+		mutex_exit(&vq->vq_bypass_lock);
 	}
 }
 
@@ -6402,6 +6416,18 @@ vdev_prop_get(vdev_t *vd, nvlist_t *innvl, nvlist_t *outnvl)
 					    ZPROP_SRC_NONE);
 				}
 				continue;
+			case VDEV_PROP_AGG_READ_OPS:
+			case VDEV_PROP_AGG_WRITE_OPS:
+			case VDEV_PROP_AGG_READ_GAP_BYTES:
+			case VDEV_PROP_AGG_WRITE_GAP_BYTES:
+			case VDEV_PROP_READ_GAP_LIMIT:
+				/* only valid for leaf vdevs */
+				if (vd->vdev_ops->vdev_op_leaf) {
+					vdev_prop_add_list(outnvl, propname,
+					    NULL, vdev_queue_agg_stat(vd, prop),
+					    ZPROP_SRC_NONE);
+				}
+				continue;
 			case VDEV_PROP_TRIM_SUPPORT:
 				/* only valid for leaf vdevs */
 				if (vd->vdev_ops->vdev_op_leaf) {
@@ -552,8 +552,51 @@ vdev_draid_lookup_map(uint64_t children, const draid_map_t **mapp)
 	return (ENOENT);
 }
 
+/*
+ * Each permutation row is used with every iteration id, giving a cycle of
+ * (nperms * children) distinct child mappings.  When the fully expanded
+ * cycle fits in this many bytes it is precomputed when the vdev is
+ * initialized, and mapping a child becomes a single table lookup.
+ */
+static uint64_t zfs_vdev_draid_perm_cache_max = 16 << 20;
+
+/*
+ * Expand the permutation array in to a table of (nperms * children) rows,
+ * with row (perm * children + iter) holding the child ids of the given
+ * permutation and iteration id.  Each row is contiguous so an I/O only
+ * touches the cache lines covering its group.
+ */
+static uint8_t *
+vdev_draid_expand_perms(vdev_draid_config_t *vdc)
+{
+	uint64_t ncols = vdc->vdc_children;
+	uint64_t cachesz = vdc->vdc_nperms * ncols * ncols;
+
+	if (cachesz > zfs_vdev_draid_perm_cache_max)
+		return (NULL);
+
+	uint8_t *cache = vmem_alloc(cachesz, KM_SLEEP);
+
+	for (uint64_t p = 0; p < vdc->vdc_nperms; p++) {
+		uint8_t *base = &vdc->vdc_perms[p * ncols];
+
+		for (uint64_t iter = 0; iter < ncols; iter++) {
+			uint8_t *row = &cache[(p * ncols + iter) * ncols];
+
+			for (uint64_t c = 0; c < ncols; c++)
+				row[c] = (base[c] + iter) % ncols;
+		}
+	}
+
+	vdc->vdc_perm_cachesz = cachesz;
+
+	return (cache);
+}
+
 /*
  * Lookup the permutation array and iteration id for the provided offset.
+ * When the expanded permutations are cached the returned base is the
+ * expanded row and the iteration id is always zero.
  */
 static void
 vdev_draid_get_perm(vdev_draid_config_t *vdc, uint64_t pindex,
@@ -562,6 +605,12 @@ vdev_draid_get_perm(vdev_draid_config_t *vdc, uint64_t pindex,
 	uint64_t ncols = vdc->vdc_children;
 	uint64_t poff = pindex % (vdc->vdc_nperms * ncols);
 
+	if (vdc->vdc_perm_cache != NULL) {
+		*base = vdc->vdc_perm_cache + poff * ncols;
+		*iter = 0;
+		return;
+	}
+
 	*base = vdc->vdc_perms + (poff / ncols) * ncols;
 	*iter = poff % ncols;
 }
@@ -570,6 +619,11 @@ static inline uint64_t
 vdev_draid_permute_id(vdev_draid_config_t *vdc,
     uint8_t *base, uint64_t iter, uint64_t index)
 {
+	if (vdc->vdc_perm_cache != NULL) {
+		ASSERT0(iter);
+		return (base[index]);
+	}
+
 	return ((base[index] + iter) % vdc->vdc_children);
 }
 
@@ -2267,6 +2321,7 @@ vdev_draid_init(spa_t *spa, nvlist_t *nv, void **tsd)
 	vdc->vdc_groupsz = vdc->vdc_groupwidth * VDEV_DRAID_ROWHEIGHT;
 	vdc->vdc_devslicesz = (vdc->vdc_groupsz * vdc->vdc_ngroups) /
 	    vdc->vdc_ndisks;
+	vdc->vdc_perm_cache = vdev_draid_expand_perms(vdc);
 
 	ASSERT3U(vdc->vdc_groupwidth, >=, 2);
 	ASSERT3U(vdc->vdc_groupwidth, <=, vdc->vdc_ndisks);
@@ -2288,6 +2343,8 @@ vdev_draid_fini(vdev_t *vd)
 
 	vmem_free(vdc->vdc_perms, sizeof (uint8_t) *
 	    vdc->vdc_children * vdc->vdc_nperms);
+	if (vdc->vdc_perm_cache != NULL)
+		vmem_free(vdc->vdc_perm_cache, vdc->vdc_perm_cachesz);
 	kmem_free(vdc, sizeof (*vdc));
 }
 
@@ -2823,3 +2880,6 @@ vdev_ops_t vdev_draid_spare_ops = {
 	.vdev_op_type = VDEV_TYPE_DRAID_SPARE,
 	.vdev_op_leaf = B_TRUE,
 };
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, draid_perm_cache_max, U64, ZMOD_RW,
+	"Max bytes of expanded dRAID permutations cached per vdev");
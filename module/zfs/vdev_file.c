@@ -52,6 +52,19 @@ static taskq_t *vdev_file_taskq;
 static uint_t vdev_file_logical_ashift = SPA_MINBLOCKSHIFT;
 static uint_t vdev_file_physical_ashift = SPA_MINBLOCKSHIFT;
 
+/*
+ * When set, reads and writes are submitted through zfs_file_aio_rw() so
+ * that the number of outstanding requests is bounded by the vdev queue
+ * rather than by the size of vdev_file_taskq.  Where the platform has no
+ * asynchronous file interface the taskq is used as before.
+ */
+static int vdev_file_aio = 0;
+
+typedef struct vdev_file_aio_req {
+	zio_t	*vfa_zio;
+	void	*vfa_buf;
+} vdev_file_aio_req_t;
+
 void
 vdev_file_init(void)
 {
@@ -238,6 +251,56 @@ vdev_file_io_strategy(void *arg)
 	zio_delay_interrupt(zio);
 }
 
+static void
+vdev_file_io_return_buf(zio_t *zio, void *buf)
+{
+	if (zio->io_type == ZIO_TYPE_READ)
+		abd_return_buf_copy(zio->io_abd, buf, zio->io_size);
+	else
+		abd_return_buf(zio->io_abd, buf, zio->io_size);
+}
+
+static void
+vdev_file_io_aio_done(void *arg, int err, ssize_t resid)
+{
+	vdev_file_aio_req_t *vfa = arg;
+	zio_t *zio = vfa->vfa_zio;
+
+	vdev_file_io_return_buf(zio, vfa->vfa_buf);
+	kmem_free(vfa, sizeof (vdev_file_aio_req_t));
+
+	zio->io_error = err;
+	if (resid != 0 && zio->io_error == 0)
+		zio->io_error = SET_ERROR(ENOSPC);
+
+	zio_delay_interrupt(zio);
+}
+
+static int
+vdev_file_io_aio(zio_t *zio)
+{
+	vdev_file_t *vf = zio->io_vd->vdev_tsd;
+	vdev_file_aio_req_t *vfa;
+	int err;
+
+	vfa = kmem_alloc(sizeof (vdev_file_aio_req_t), KM_SLEEP);
+	vfa->vfa_zio = zio;
+	if (zio->io_type == ZIO_TYPE_READ)
+		vfa->vfa_buf = abd_borrow_buf(zio->io_abd, zio->io_size);
+	else
+		vfa->vfa_buf = abd_borrow_buf_copy(zio->io_abd, zio->io_size);
+
+	err = zfs_file_aio_rw(vf->vf_file, zio->io_type == ZIO_TYPE_WRITE,
+	    vfa->vfa_buf, zio->io_size, zio->io_offset,
+	    vdev_file_io_aio_done, vfa);
+	if (err != 0) {
+		vdev_file_io_return_buf(zio, vfa->vfa_buf);
+		kmem_free(vfa, sizeof (vdev_file_aio_req_t));
+	}
+
+	return (err);
+}
+
 static void
 vdev_file_io_fsync(void *arg)
 {
@@ -298,6 +361,9 @@ vdev_file_io_start(zio_t *zio)
 	ASSERT(zio->io_type == ZIO_TYPE_READ || zio->io_type == ZIO_TYPE_WRITE);
 	zio->io_target_timestamp = zio_handle_io_delay(zio);
 
+	if (vdev_file_aio && vdev_file_io_aio(zio) == 0)
+		return;
+
 	VERIFY3U(taskq_dispatch(vdev_file_taskq, vdev_file_io_strategy, zio,
 	    TQ_SLEEP), !=, TASKQID_INVALID);
 }
@@ -370,3 +436,5 @@ ZFS_MODULE_PARAM(zfs_vdev_file, vdev_file_, logical_ashift, UINT, ZMOD_RW,
 	"Logical ashift for file-based devices");
 ZFS_MODULE_PARAM(zfs_vdev_file, vdev_file_, physical_ashift, UINT, ZMOD_RW,
 	"Physical ashift for file-based devices");
+ZFS_MODULE_PARAM(zfs_vdev_file, vdev_file_, aio, INT, ZMOD_RW,
+	"Submit file vdev reads and writes asynchronously where supported");
@@ -39,6 +39,9 @@ vdev_indirect_mapping_verify(vdev_indirect_mapping_t *vim)
 
 	EQUIV(vim->vim_phys->vimp_num_entries > 0,
 	    vim->vim_entries != NULL);
+	ASSERT3U(vim->vim_index_count, ==,
+	    (vim->vim_phys->vimp_num_entries + VIM_INDEX_STRIDE - 1) >>
+	    VIM_INDEX_SHIFT);
 	if (vim->vim_phys->vimp_num_entries > 0) {
 		vdev_indirect_mapping_entry_phys_t *last_entry __maybe_unused =
 		    &vim->vim_entries[vim->vim_phys->vimp_num_entries - 1];
@@ -106,6 +109,31 @@ vdev_indirect_mapping_size(vdev_indirect_mapping_t *vim)
 	return (vim->vim_phys->vimp_num_entries * sizeof (*vim->vim_entries));
 }
 
+/*
+ * (Re)build the top level of the lookup index from vim_entries.
+ */
+static void
+vdev_indirect_mapping_index_build(vdev_indirect_mapping_t *vim)
+{
+	uint64_t count = (vim->vim_phys->vimp_num_entries +
+	    VIM_INDEX_STRIDE - 1) >> VIM_INDEX_SHIFT;
+
+	if (vim->vim_index != NULL) {
+		vmem_free(vim->vim_index,
+		    vim->vim_index_count * sizeof (uint64_t));
+		vim->vim_index = NULL;
+	}
+	vim->vim_index_count = count;
+	if (count == 0)
+		return;
+
+	vim->vim_index = vmem_alloc(count * sizeof (uint64_t), KM_SLEEP);
+	for (uint64_t i = 0; i < count; i++) {
+		vim->vim_index[i] = DVA_MAPPING_GET_SRC_OFFSET(
+		    &vim->vim_entries[i << VIM_INDEX_SHIFT]);
+	}
+}
+
 /*
  * Compare an offset with an indirect mapping entry; there are three
  * possible scenarios:
@@ -182,15 +210,39 @@ vdev_indirect_mapping_entry_for_offset_impl(vdev_indirect_mapping_t *vim,
 
 	vdev_indirect_mapping_entry_phys_t *entry = NULL;
 
-	uint64_t last = vim->vim_phys->vimp_num_entries - 1;
-	uint64_t base = 0;
+	/*
+	 * Offsets before the first entry have no match, and the first
+	 * entry is the next one.
+	 */
+	if (offset < vim->vim_index[0])
+		return (next_if_missing ? &vim->vim_entries[0] : NULL);
+
+	/*
+	 * Find the last stride starting at or before the offset.  Only
+	 * that stride can contain it, and if it does not, the next entry
+	 * is at most one past its end.
+	 */
+	uint64_t lo = 0;
+	uint64_t hi = vim->vim_index_count - 1;
+	while (lo < hi) {
+		uint64_t i = hi - ((hi - lo) >> 1);
+		if (vim->vim_index[i] <= offset)
+			lo = i;
+		else
+			hi = i - 1;
+	}
+
+	uint64_t base = lo << VIM_INDEX_SHIFT;
+	uint64_t last = MIN(base + VIM_INDEX_STRIDE,
+	    vim->vim_phys->vimp_num_entries) - 1;
 
 	/*
 	 * We don't define these inside of the while loop because we use
-	 * their value in the case that offset isn't in the mapping.
+	 * their value in the case that offset isn't in the mapping.  The
+	 * stride holds at least one entry, so the loop always assigns them.
 	 */
-	uint64_t mid;
-	int result;
+	uint64_t mid = base;
+	int result = 0;
 
 	while (last >= base) {
 		mid = base + ((last - base) >> 1);
@@ -295,6 +347,10 @@ vdev_indirect_mapping_close(vdev_indirect_mapping_t *vim)
 		uint64_t map_size = vdev_indirect_mapping_size(vim);
 		vmem_free(vim->vim_entries, map_size);
 		vim->vim_entries = NULL;
+		vmem_free(vim->vim_index,
+		    vim->vim_index_count * sizeof (uint64_t));
+		vim->vim_index = NULL;
+		vim->vim_index_count = 0;
 	}
 
 	dmu_buf_rele(vim->vim_dbuf, vim);
@@ -363,6 +419,7 @@ vdev_indirect_mapping_open(objset_t *os, uint64_t mapping_object)
 		vim->vim_entries = vmem_alloc(map_size, KM_SLEEP);
 		VERIFY0(dmu_read(os, vim->vim_object, 0, map_size,
 		    vim->vim_entries, DMU_READ_PREFETCH));
+		vdev_indirect_mapping_index_build(vim);
 	}
 
 	ASSERT(vdev_indirect_mapping_verify(vim));
@@ -489,6 +546,7 @@ vdev_indirect_mapping_add_entries(vdev_indirect_mapping_t *vim,
 	VERIFY0(dmu_read(vim->vim_objset, vim->vim_object, old_size,
 	    new_size - old_size, &vim->vim_entries[old_count],
 	    DMU_READ_PREFETCH));
+	vdev_indirect_mapping_index_build(vim);
 
 	zfs_dbgmsg("txg %llu: wrote %llu entries to "
 	    "indirect mapping obj %llu; max offset=0x%llx",
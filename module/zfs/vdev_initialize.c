@@ -45,6 +45,14 @@ static const int zfs_initialize_limit = 1;
 /* size of initializing writes; default 1MiB, see zfs_remove_max_segment */
 static uint64_t zfs_initialize_chunk_size = 1024 * 1024;
 
+/*
+ * Zero free space with the device's WRITE ZEROES offload when it has one,
+ * instead of writing zfs_initialize_value.  No data is transferred, so
+ * the ranges are issued in chunks as large as TRIM extents.
+ */
+static int zfs_initialize_write_zeroes = 0;
+#define	ZFS_INITIALIZE_ZEROES_CHUNK_SIZE	(128ULL * 1024 * 1024)
+
 static boolean_t
 vdev_initialize_should_stop(vdev_t *vd)
 {
@@ -206,6 +214,14 @@ vdev_initialize_cb(zio_t *zio)
 {
 	vdev_t *vd = zio->io_vd;
 	mutex_enter(&vd->vdev_initialize_io_lock);
+	if (zio->io_type == ZIO_TYPE_TRIM && zio->io_error != 0 &&
+	    zio->io_error != ENXIO) {
+		/*
+		 * The device does not really support WRITE ZEROES; use
+		 * regular writes from now on.
+		 */
+		vd->vdev_has_write_zeroes = B_FALSE;
+	}
 	if (zio->io_error == ENXIO && !vdev_writeable(vd)) {
 		/*
 		 * The I/O failed because the vdev was unavailable; roll the
@@ -234,7 +250,10 @@ vdev_initialize_cb(zio_t *zio)
 	spa_config_exit(vd->vdev_spa, SCL_STATE_ALL, vd);
 }
 
-/* Takes care of physical writing and limiting # of concurrent ZIOs. */
+/*
+ * Takes care of physical writing and limiting # of concurrent ZIOs.  A NULL
+ * data buffer zeroes the range with WRITE ZEROES instead.
+ */
 static int
 vdev_initialize_write(vdev_t *vd, uint64_t start, uint64_t size, abd_t *data)
 {
@@ -282,9 +301,16 @@ vdev_initialize_write(vdev_t *vd, uint64_t start, uint64_t size, abd_t *data)
 	mutex_exit(&vd->vdev_initialize_lock);
 
 	vd->vdev_initialize_offset[txg & TXG_MASK] = start + size;
-	zio_nowait(zio_write_phys(spa->spa_txg_zio[txg & TXG_MASK], vd, start,
-	    size, data, ZIO_CHECKSUM_OFF, vdev_initialize_cb, NULL,
-	    ZIO_PRIORITY_INITIALIZING, ZIO_FLAG_CANFAIL, B_FALSE));
+	if (data == NULL) {
+		zio_nowait(zio_trim(spa->spa_txg_zio[txg & TXG_MASK], vd,
+		    start, size, vdev_initialize_cb, NULL, ZIO_PRIORITY_TRIM,
+		    ZIO_FLAG_CANFAIL, ZIO_TRIM_ZEROES));
+	} else {
+		zio_nowait(zio_write_phys(spa->spa_txg_zio[txg & TXG_MASK], vd,
+		    start, size, data, ZIO_CHECKSUM_OFF, vdev_initialize_cb,
+		    NULL, ZIO_PRIORITY_INITIALIZING, ZIO_FLAG_CANFAIL,
+		    B_FALSE));
+	}
 	/* vdev_initialize_cb releases SCL_STATE_ALL */
 
 	dmu_tx_commit(tx);
@@ -339,19 +365,21 @@ vdev_initialize_ranges(vdev_t *vd, abd_t *data)
 	    rs = zfs_btree_next(bt, &where, &where)) {
 		uint64_t size = zfs_rs_get_end(rs, rt) -
 		    zfs_rs_get_start(rs, rt);
+		boolean_t zeroes = zfs_initialize_write_zeroes &&
+		    vd->vdev_has_write_zeroes;
+		uint64_t chunk = zeroes ? ZFS_INITIALIZE_ZEROES_CHUNK_SIZE :
+		    zfs_initialize_chunk_size;
 
 		/* Split range into legally-sized physical chunks */
-		uint64_t writes_required =
-		    ((size - 1) / zfs_initialize_chunk_size) + 1;
+		uint64_t writes_required = ((size - 1) / chunk) + 1;
 
 		for (uint64_t w = 0; w < writes_required; w++) {
 			int error;
 
 			error = vdev_initialize_write(vd,
 			    VDEV_LABEL_START_SIZE + zfs_rs_get_start(rs, rt) +
-			    (w * zfs_initialize_chunk_size),
-			    MIN(size - (w * zfs_initialize_chunk_size),
-			    zfs_initialize_chunk_size), data);
+			    (w * chunk), MIN(size - (w * chunk), chunk),
+			    zeroes ? NULL : data);
 			if (error != 0)
 				return (error);
 		}
@@ -832,3 +860,6 @@ ZFS_MODULE_PARAM(zfs, zfs_, initialize_value, U64, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs, zfs_, initialize_chunk_size, U64, ZMOD_RW,
 	"Size in bytes of writes by zpool initialize");
+
+ZFS_MODULE_PARAM(zfs, zfs_, initialize_write_zeroes, INT, ZMOD_RW,
+	"Use WRITE ZEROES offload, when supported, for zpool initialize");
@@ -154,6 +154,13 @@
 #include <sys/fs/zfs.h>
 #include <sys/byteorder.h>
 #include <sys/zfs_bootenv.h>
+#include <sys/dsl_pool.h>
+
+/*
+ * Generate and write the labels of each dirty top-level vdev on
+ * dp_sync_taskq, rather than one vdev after another in the sync thread.
+ */
+static int zfs_vdev_label_sync_parallel = 0;
 
 /*
  * Basic routines to read and write from a vdev label.
@@ -1960,14 +1967,67 @@ vdev_label_sync(zio_t *zio, uint64_t *good_writes,
 	nvlist_free(label);
 }
 
+typedef struct vdev_label_sync_arg {
+	zio_t		*vlsa_zio;
+	uint64_t	*vlsa_good_writes;
+	vdev_t		*vlsa_vd;
+	int		vlsa_l;
+	uint64_t	vlsa_txg;
+	int		vlsa_flags;
+} vdev_label_sync_arg_t;
+
+static void
+vdev_label_sync_task(void *arg)
+{
+	vdev_label_sync_arg_t *vlsa = arg;
+
+	vdev_label_sync(vlsa->vlsa_zio, vlsa->vlsa_good_writes, vlsa->vlsa_vd,
+	    vlsa->vlsa_l, vlsa->vlsa_txg, vlsa->vlsa_flags);
+	zio_nowait(vlsa->vlsa_zio);
+	kmem_free(vlsa, sizeof (vdev_label_sync_arg_t));
+}
+
+/*
+ * Write the labels of vd under vio, either on tq or directly.  Most of the
+ * cost is generating and packing a config for every leaf, so spreading the
+ * top-level vdevs over threads helps wide pools.  The root zio cannot
+ * complete before vio is issued, so the caller need not wait for tq.
+ */
+static void
+vdev_label_sync_dispatch(taskq_t *tq, zio_t *vio, uint64_t *good_writes,
+    vdev_t *vd, int l, uint64_t txg, int flags)
+{
+	if (tq != NULL) {
+		vdev_label_sync_arg_t *vlsa = kmem_alloc(sizeof (*vlsa),
+		    KM_SLEEP);
+		vlsa->vlsa_zio = vio;
+		vlsa->vlsa_good_writes = good_writes;
+		vlsa->vlsa_vd = vd;
+		vlsa->vlsa_l = l;
+		vlsa->vlsa_txg = txg;
+		vlsa->vlsa_flags = flags;
+		if (taskq_dispatch(tq, vdev_label_sync_task, vlsa,
+		    TQ_SLEEP) != TASKQID_INVALID)
+			return;
+		kmem_free(vlsa, sizeof (*vlsa));
+	}
+
+	vdev_label_sync(vio, good_writes, vd, l, txg, flags);
+	zio_nowait(vio);
+}
+
 static int
 vdev_label_sync_list(spa_t *spa, int l, uint64_t txg, int flags)
 {
 	list_t *dl = &spa->spa_config_dirty_list;
 	vdev_t *vd;
 	zio_t *zio;
+	taskq_t *tq = NULL;
 	int error;
 
+	if (zfs_vdev_label_sync_parallel && spa->spa_dsl_pool != NULL)
+		tq = spa->spa_dsl_pool->dp_sync_taskq;
+
 	/*
 	 * Write the new labels to disk.
 	 */
@@ -1983,8 +2043,8 @@ vdev_label_sync_list(spa_t *spa, int l, uint64_t txg, int flags)
 		    (vd->vdev_islog || vd->vdev_aux != NULL) ?
 		    vdev_label_sync_ignore_done : vdev_label_sync_top_done,
 		    good_writes, flags);
-		vdev_label_sync(vio, good_writes, vd, l, txg, flags);
-		zio_nowait(vio);
+		vdev_label_sync_dispatch(tq, vio, good_writes, vd, l, txg,
+		    flags);
 	}
 
 	/*
@@ -1999,9 +2059,8 @@ vdev_label_sync_list(spa_t *spa, int l, uint64_t txg, int flags)
 			good_writes = kmem_zalloc(sizeof (uint64_t), KM_SLEEP);
 			zio_t *vio = zio_null(zio, spa, NULL,
 			    vdev_label_sync_ignore_done, good_writes, flags);
-			vdev_label_sync(vio, good_writes, sav[i]->sav_vdevs[v],
-			    l, txg, flags);
-			zio_nowait(vio);
+			vdev_label_sync_dispatch(tq, vio, good_writes,
+			    sav[i]->sav_vdevs[v], l, txg, flags);
 		}
 	}
 
@@ -2092,6 +2151,7 @@ retry:
 	 * written in this txg will be committed to stable storage
 	 * before any uberblock that references them.
 	 */
+	hrtime_t start = gethrtime();
 	zio_t *zio = zio_root(spa, NULL, NULL, flags);
 
 	for (vdev_t *vd =
@@ -2100,6 +2160,7 @@ retry:
 		zio_flush(zio, vd);
 
 	(void) zio_wait(zio);
+	hrtime_t flushed = gethrtime();
 
 	/*
 	 * Sync out the even labels (L0, L2) for every dirty vdev.  If the
@@ -2118,6 +2179,7 @@ retry:
 		}
 		goto retry;
 	}
+	hrtime_t even_synced = gethrtime();
 
 	/*
 	 * Sync the uberblocks to all vdevs in svd[].
@@ -2142,6 +2204,8 @@ retry:
 		goto retry;
 	}
 
+	hrtime_t ub_synced = gethrtime();
+
 	if (spa_multihost(spa))
 		mmp_update_uberblock(spa, ub);
 
@@ -2164,5 +2228,12 @@ retry:
 		goto retry;
 	}
 
+	spa_iostats_config_sync_add(spa, flushed - start,
+	    (even_synced - flushed) + (gethrtime() - ub_synced),
+	    ub_synced - even_synced);
+
 	return (0);
 }
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, label_sync_parallel, INT, ZMOD_RW,
+	"Write the labels of dirty top-level vdevs in parallel");
@@ -54,6 +54,12 @@ typedef struct mirror_stats {
 
 	kstat_named_t vdev_mirror_stat_preferred_found;
 	kstat_named_t vdev_mirror_stat_preferred_not_found;
+
+	kstat_named_t vdev_mirror_stat_latency_penalty;
+	kstat_named_t vdev_mirror_stat_stall_avoided;
+
+	kstat_named_t vdev_mirror_stat_split_reads;
+	kstat_named_t vdev_mirror_stat_split_fallback;
 } mirror_stats_t;
 
 static mirror_stats_t mirror_stats = {
@@ -71,6 +77,14 @@ static mirror_stats_t mirror_stats = {
 	{ "preferred_found",			KSTAT_DATA_UINT64 },
 	/* Preferred child vdev not found or equal load  */
 	{ "preferred_not_found",		KSTAT_DATA_UINT64 },
+	/* Child load raised because it is slower than its siblings */
+	{ "latency_penalty",			KSTAT_DATA_UINT64 },
+	/* Child passed over because an I/O to it has stalled */
+	{ "stall_avoided",			KSTAT_DATA_UINT64 },
+	/* Read split across several children */
+	{ "split_reads",			KSTAT_DATA_UINT64 },
+	/* Split read failed and was retried from a single child */
+	{ "split_fallback",			KSTAT_DATA_UINT64 },
 
 };
 
@@ -112,6 +126,7 @@ typedef struct mirror_child {
 	uint8_t		mc_skipped;
 	uint8_t		mc_speculative;
 	uint8_t		mc_rebuilding;
+	uint8_t		mc_split;
 } mirror_child_t;
 
 typedef struct mirror_map {
@@ -121,6 +136,7 @@ typedef struct mirror_map {
 	boolean_t	mm_resilvering;
 	boolean_t	mm_rebuilding;
 	boolean_t	mm_root;
+	boolean_t	mm_split;
 	mirror_child_t	mm_child[];
 } mirror_map_t;
 
@@ -145,6 +161,30 @@ static int zfs_vdev_mirror_rotating_seek_offset = 1 * 1024 * 1024;
 static int zfs_vdev_mirror_non_rotating_inc = 0;
 static int zfs_vdev_mirror_non_rotating_seek_inc = 1;
 
+/*
+ * When enabled, the load of each child is additionally scaled by how much
+ * slower its recent reads have been than those of the fastest child, so
+ * that reads drift away from a degraded leg.  Samples older than
+ * zfs_vdev_mirror_latency_max_age_ms are ignored, which lets a child that
+ * has been starved of reads be probed again.
+ */
+static int zfs_vdev_mirror_latency_select = 0;
+static uint_t zfs_vdev_mirror_latency_max_age_ms = 1000;
+
+/*
+ * A child with an I/O outstanding for longer than this is only read from
+ * if every other child is in the same state, so that reads issued while a
+ * drive is busy with error recovery go to its siblings.  Zero disables.
+ */
+static uint_t zfs_vdev_mirror_stall_ms = 0;
+
+/*
+ * Normal reads of at least twice this size are split into contiguous
+ * pieces of at least this size, each read from a different child in
+ * parallel.  Zero disables splitting.
+ */
+static uint_t zfs_vdev_mirror_split_size = 0;
+
 static inline size_t
 vdev_mirror_map_size(int children)
 {
@@ -448,6 +488,13 @@ vdev_mirror_child_done(zio_t *zio)
 	mc->mc_skipped = 0;
 }
 
+static void
+vdev_mirror_split_child_done(zio_t *zio)
+{
+	vdev_mirror_child_done(zio);
+	abd_free(zio->io_abd);
+}
+
 /*
  * Check the other, lower-index DVAs to see if they're on the same
  * vdev as the child we picked.  If they are, use them since they
@@ -525,15 +572,187 @@ vdev_mirror_child_missing(mirror_child_t *mc, uint64_t txg, uint64_t size)
  * are created when another disk in the dRAID fails. In order to restore
  * redundancy those gaps must be read to trigger the required repair IO.
  */
+static hrtime_t
+vdev_mirror_latency_min(mirror_map_t *mm, hrtime_t max_age)
+{
+	hrtime_t lat_min = 0;
+	int samples = 0;
+
+	for (int c = 0; c < mm->mm_children; c++) {
+		mirror_child_t *mc = &mm->mm_child[c];
+
+		if (mc->mc_vd == NULL || mc->mc_tried || mc->mc_skipped)
+			continue;
+
+		hrtime_t lat = vdev_queue_read_latency(mc->mc_vd, max_age);
+		if (lat == 0)
+			continue;
+		if (lat_min == 0 || lat < lat_min)
+			lat_min = lat;
+		samples++;
+	}
+
+	return (samples > 1 ? lat_min : 0);
+}
+
+/*
+ * Scale the load so that it approximates the time to drain this child's
+ * queue, expressed in I/Os on the fastest child.
+ */
+static int
+vdev_mirror_latency_load(mirror_child_t *mc, hrtime_t lat_min,
+    hrtime_t max_age)
+{
+	hrtime_t lat = vdev_queue_read_latency(mc->mc_vd, max_age);
+
+	if (lat <= lat_min)
+		return (mc->mc_load);
+
+	MIRROR_BUMP(vdev_mirror_stat_latency_penalty);
+	int64_t extra = ((int64_t)mc->mc_load + 1) * (lat - lat_min) / lat_min;
+	return ((int)MIN((int64_t)mc->mc_load + extra, INT_MAX / 2));
+}
+
+/*
+ * Split a large read into contiguous pieces served by different children
+ * in parallel.  The pieces are read without a block pointer, so that the
+ * checksum is verified once over the reassembled buffer in
+ * vdev_mirror_split_done(); if that fails the block is read again whole
+ * from a single child as usual.
+ */
+static boolean_t
+vdev_mirror_split_read(zio_t *zio, mirror_map_t *mm)
+{
+	uint64_t split = zfs_vdev_mirror_split_size;
+	int c, n = 0;
+
+	if (split == 0 || mm->mm_root || mm->mm_resilvering ||
+	    mm->mm_rebuilding || zio->io_bp == NULL ||
+	    BP_IS_GANG(zio->io_bp) || zio->io_size < 2 * split ||
+	    (zio->io_flags & (ZIO_FLAG_DIO_READ | ZIO_FLAG_IO_RETRY |
+	    ZIO_FLAG_SCRUB | ZIO_FLAG_RESILVER)))
+		return (B_FALSE);
+
+	for (c = 0; c < mm->mm_children; c++) {
+		mirror_child_t *mc = &mm->mm_child[c];
+
+		if (mc->mc_vd == NULL || !vdev_mirror_child_readable(mc) ||
+		    vdev_mirror_child_missing(mc, zio->io_txg, 1))
+			continue;
+
+		/* A distributed spare is always read on its own. */
+		if (mc->mc_vd->vdev_ops == &vdev_draid_spare_ops)
+			break;
+
+		mc->mc_load = vdev_mirror_load(mm, mc->mc_vd, mc->mc_offset);
+		mc->mc_split = 1;
+		n++;
+	}
+
+	/* Use as many of the least loaded children as the size allows. */
+	int pieces = MIN(n, zio->io_size / split);
+	if (c < mm->mm_children)
+		pieces = 0;
+	for (; n > pieces; n--) {
+		mirror_child_t *worst = NULL;
+		for (c = 0; c < mm->mm_children; c++) {
+			mirror_child_t *mc = &mm->mm_child[c];
+			if (mc->mc_split &&
+			    (worst == NULL || mc->mc_load > worst->mc_load))
+				worst = mc;
+		}
+		worst->mc_split = 0;
+	}
+	if (n < 2)
+		return (B_FALSE);
+
+	uint64_t align = 1ULL << zio->io_vd->vdev_top->vdev_ashift;
+	uint64_t chunk = P2ROUNDUP(zio->io_size / n, align);
+	uint64_t off = 0;
+
+	mm->mm_split = B_TRUE;
+	MIRROR_BUMP(vdev_mirror_stat_split_reads);
+
+	for (c = 0; c < mm->mm_children; c++) {
+		mirror_child_t *mc = &mm->mm_child[c];
+
+		if (!mc->mc_split)
+			continue;
+		if (off == zio->io_size) {
+			mc->mc_split = 0;
+			continue;
+		}
+
+		uint64_t len = MIN(chunk, zio->io_size - off);
+		zio_nowait(zio_vdev_child_io(zio, NULL, mc->mc_vd,
+		    mc->mc_offset + off,
+		    abd_get_offset_size(zio->io_abd, off, len), len,
+		    ZIO_TYPE_READ, zio->io_priority, 0,
+		    vdev_mirror_split_child_done, mc));
+		off += len;
+	}
+	ASSERT3U(off, ==, zio->io_size);
+
+	return (B_TRUE);
+}
+
+/*
+ * Verify a split read.  Returns B_TRUE if the reassembled block is good.
+ * Otherwise the children are reset so that vdev_mirror_child_select() can
+ * pick one to read the whole block from; a child that returned an I/O
+ * error keeps it, so that it is avoided and later repaired.
+ */
+static boolean_t
+vdev_mirror_split_done(zio_t *zio, mirror_map_t *mm)
+{
+	zio_bad_cksum_t zbc = {0};
+	boolean_t failed = B_FALSE;
+	int c;
+
+	mm->mm_split = B_FALSE;
+
+	for (c = 0; c < mm->mm_children; c++) {
+		if (mm->mm_child[c].mc_split && mm->mm_child[c].mc_error != 0)
+			failed = B_TRUE;
+	}
+
+	if (!failed && zio_checksum_error(zio, &zbc) == 0) {
+		zio_checksum_verified(zio);
+		for (c = 0; c < mm->mm_children; c++)
+			mm->mm_child[c].mc_split = 0;
+		return (B_TRUE);
+	}
+
+	MIRROR_BUMP(vdev_mirror_stat_split_fallback);
+	for (c = 0; c < mm->mm_children; c++) {
+		mirror_child_t *mc = &mm->mm_child[c];
+
+		if (!mc->mc_split)
+			continue;
+		mc->mc_split = 0;
+		if (mc->mc_error != 0)
+			continue;
+		mc->mc_tried = 0;
+	}
+
+	return (B_FALSE);
+}
+
 static int
 vdev_mirror_child_select(zio_t *zio)
 {
 	mirror_map_t *mm = zio->io_vsd;
 	uint64_t txg = zio->io_txg;
 	int c, lowest_load;
+	hrtime_t max_age = MSEC2NSEC(zfs_vdev_mirror_latency_max_age_ms);
+	hrtime_t stall = MSEC2NSEC(zfs_vdev_mirror_stall_ms);
+	hrtime_t lat_min = 0;
 
 	ASSERT(zio->io_bp == NULL || BP_GET_BIRTH(zio->io_bp) == txg);
 
+	if (zfs_vdev_mirror_latency_select && !mm->mm_root)
+		lat_min = vdev_mirror_latency_min(mm, max_age);
+
 	lowest_load = INT_MAX;
 	mm->mm_preferred_cnt = 0;
 	for (c = 0; c < mm->mm_children; c++) {
@@ -565,6 +784,14 @@ vdev_mirror_child_select(zio_t *zio)
 		}
 
 		mc->mc_load = vdev_mirror_load(mm, mc->mc_vd, mc->mc_offset);
+		if (lat_min != 0)
+			mc->mc_load = vdev_mirror_latency_load(mc, lat_min,
+			    max_age);
+		if (stall != 0 && !mm->mm_root &&
+		    vdev_queue_stall_time(mc->mc_vd) > stall) {
+			MIRROR_BUMP(vdev_mirror_stat_stall_avoided);
+			mc->mc_load = INT_MAX / 2;
+		}
 		if (mc->mc_load > lowest_load)
 			continue;
 
@@ -654,8 +881,13 @@ vdev_mirror_io_start(zio_t *zio)
 			return;
 		}
 		/*
-		 * For normal reads just pick one child.
+		 * For normal reads just pick one child, unless the read is
+		 * large enough to be split across several.
 		 */
+		if (vdev_mirror_split_read(zio, mm)) {
+			zio_execute(zio);
+			return;
+		}
 		c = vdev_mirror_child_select(zio);
 		children = (c >= 0);
 	} else {
@@ -721,6 +953,9 @@ vdev_mirror_io_done(zio_t *zio)
 	if (mm == NULL)
 		return;
 
+	if (mm->mm_split && vdev_mirror_split_done(zio, mm))
+		return;
+
 	for (c = 0; c < mm->mm_children; c++) {
 		mc = &mm->mm_child[c];
 
@@ -1061,3 +1296,15 @@ ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, non_rotating_inc, INT,
 
 ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, non_rotating_seek_inc, INT,
 	ZMOD_RW, "Non-rotating media load increment for seeking I/Os");
+
+ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, latency_select, INT,
+	ZMOD_RW, "Scale child load by recent read latency");
+
+ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, latency_max_age_ms, UINT,
+	ZMOD_RW, "Ignore read latency samples older than this");
+
+ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, split_size, UINT,
+	ZMOD_RW, "Minimum piece size when splitting reads across children");
+
+ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, stall_ms, UINT, ZMOD_RW,
+	"Avoid reading from a child with an I/O outstanding this long");
@@ -32,7 +32,7 @@
 #include <sys/vdev_impl.h>
 #include <sys/spa_impl.h>
 #include <sys/zio.h>
-#include <sys/avl.h>
+#include <sys/btree.h>
 #include <sys/dsl_pool.h>
 #include <sys/metaslab_impl.h>
 #include <sys/spa.h>
@@ -193,6 +193,84 @@ static uint_t zfs_vdev_nia_delay = 5;
  */
 static uint_t zfs_vdev_nia_credit = 5;
 
+/*
+ * When non-zero, each leaf vdev adapts the per-class active I/O limits to
+ * keep the average completion latency of every class near this target (in
+ * microseconds).  The limit grows by one each time a class completes an I/O
+ * while saturated and under target, and shrinks by a quarter, at most once
+ * per target interval, while the moving average is above target.  The
+ * adaptive limit never goes below the class *_min_active nor above its
+ * *_max_active.
+ */
+static uint_t zfs_vdev_target_latency_us = 0;
+
+/*
+ * On non-rotational leaves the offset-sorted queues and aggregation buy
+ * little, while vq_lock becomes a point of contention at high IOPS.  When
+ * zfs_vdev_queue_bypass is set, synchronous reads and writes to such a
+ * leaf skip the queue entirely, without taking vq_lock, as long as the
+ * regular queue is idle and fewer than zfs_vdev_queue_bypass_max_active
+ * bypassed I/Os are outstanding.  Atomic per-class counters are kept for
+ * them, and they are tracked on vq_bypass_list, under its own short-held
+ * lock, so that the deadman still sees them.  Once the bypass depth is
+ * reached I/Os fall back to the regular queue, which drains independently.
+ * The block layer's own per-CPU submission queues provide the multi-queue
+ * behaviour below us.
+ */
+static int zfs_vdev_queue_bypass = 0;
+static uint_t zfs_vdev_queue_bypass_max_active = 64;
+
+/*
+ * Optional per-class deadlines, in milliseconds (0 disables).  When the
+ * oldest queued I/O of a class has waited longer than its deadline, the
+ * class is served ahead of higher-priority classes that are past their
+ * min_active, and its oldest I/O is issued instead of continuing in LBA
+ * order.  The class max_active and zfs_vdev_max_active still apply, and
+ * the expired I/O may still be aggregated with its neighbours.  For the
+ * LBA-ordered classes "oldest" means the first I/O of the earliest 0.5
+ * second interval.  Each such issue is counted in the vdev_queue_stats
+ * kstat.
+ */
+static uint_t zfs_vdev_sync_read_deadline_ms = 0;
+static uint_t zfs_vdev_sync_write_deadline_ms = 0;
+static uint_t zfs_vdev_async_read_deadline_ms = 0;
+static uint_t zfs_vdev_async_write_deadline_ms = 0;
+
+static kstat_t *vdev_queue_ksp = NULL;
+
+typedef struct vdev_queue_stats {
+	/* Indexed by zio_priority_t */
+	kstat_named_t vqs_deadline_miss[ZIO_PRIORITY_ASYNC_WRITE + 1];
+} vdev_queue_stats_t;
+
+static vdev_queue_stats_t vdev_queue_stats = { {
+	{ "sync_read_deadline_miss",		KSTAT_DATA_UINT64 },
+	{ "sync_write_deadline_miss",		KSTAT_DATA_UINT64 },
+	{ "async_read_deadline_miss",		KSTAT_DATA_UINT64 },
+	{ "async_write_deadline_miss",		KSTAT_DATA_UINT64 },
+} };
+
+void
+vdev_queue_stat_init(void)
+{
+	vdev_queue_ksp = kstat_create("zfs", 0, "vdev_queue_stats",
+	    "misc", KSTAT_TYPE_NAMED, sizeof (vdev_queue_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (vdev_queue_ksp != NULL) {
+		vdev_queue_ksp->ks_data = &vdev_queue_stats;
+		kstat_install(vdev_queue_ksp);
+	}
+}
+
+void
+vdev_queue_stat_fini(void)
+{
+	if (vdev_queue_ksp != NULL) {
+		kstat_delete(vdev_queue_ksp);
+		vdev_queue_ksp = NULL;
+	}
+}
+
 /*
  * To reduce IOPs, we aggregate small adjacent I/Os into one large I/O.
  * For read I/Os, we also aggregate across small adjacency gaps; for writes
@@ -202,39 +280,99 @@ static uint_t zfs_vdev_nia_credit = 5;
 static uint_t zfs_vdev_aggregation_limit = 1 << 20;
 static uint_t zfs_vdev_aggregation_limit_non_rotating = SPA_OLD_MAXBLOCKSIZE;
 static uint_t zfs_vdev_read_gap_limit = 32 << 10;
+static uint_t zfs_vdev_read_gap_limit_non_rotating = 32 << 10;
 static uint_t zfs_vdev_write_gap_limit = 4 << 10;
 
+/*
+ * Reading a gap between two I/Os pays off when the gap can be transferred
+ * in less time than the fixed per-I/O overhead it saves.  When
+ * zfs_vdev_read_gap_auto is set, each leaf estimates that break-even gap
+ * from the device times (io_delay) of its small and large reads, modeling
+ * a read of size s as taking overhead + s * per-byte cost, and uses it in
+ * place of the static read gap limits.  Until both sizes have been seen,
+ * or if the estimate is not meaningful, the static limits apply.
+ */
+static int zfs_vdev_read_gap_auto = 0;
+#define	VDQ_COST_SMALL	(16 << 10)
+#define	VDQ_COST_LARGE	(128 << 10)
+
+__attribute__((always_inline)) inline
 static int
 vdev_queue_offset_compare(const void *x1, const void *x2)
 {
-	const zio_t *z1 = (const zio_t *)x1;
-	const zio_t *z2 = (const zio_t *)x2;
+	const vdev_queue_ent_t *e1 = (const vdev_queue_ent_t *)x1;
+	const vdev_queue_ent_t *e2 = (const vdev_queue_ent_t *)x2;
 
-	int cmp = TREE_CMP(z1->io_offset, z2->io_offset);
+	int cmp = TREE_CMP(e1->vqe_offset, e2->vqe_offset);
 
 	if (likely(cmp))
 		return (cmp);
 
-	return (TREE_PCMP(z1, z2));
+	return (TREE_PCMP(e1->vqe_zio, e2->vqe_zio));
 }
 
+ZFS_BTREE_FIND_IN_BUF_FUNC(vdev_queue_offset_find_in_buf, vdev_queue_ent_t,
+    vdev_queue_offset_compare)
+
 #define	VDQ_T_SHIFT 29
 
+/*
+ * The time an I/O sorts by in the LBA-ordered queues.  Async reads from
+ * datasets with a non-default qos_weight are treated as if queued later
+ * (or earlier) by one 0.5 second interval scaled by ZFS_QOS_WEIGHT_DEFAULT /
+ * weight minus one, so that a dataset's share of a busy device grows with
+ * its weight while no I/O waits indefinitely.  Other classes are issued on
+ * behalf of the pool, e.g. txg sync writes, and are not weighted.
+ */
+static inline hrtime_t
+vdev_queue_sort_ts(const zio_t *zio)
+{
+	uint_t w = zio->io_qos_weight;
+
+	if (likely(w == 0 || w == ZFS_QOS_WEIGHT_DEFAULT ||
+	    zio->io_priority != ZIO_PRIORITY_ASYNC_READ))
+		return (zio->io_timestamp);
+	return (zio->io_timestamp +
+	    ((hrtime_t)ZFS_QOS_WEIGHT_DEFAULT << VDQ_T_SHIFT) / w -
+	    ((hrtime_t)1 << VDQ_T_SHIFT));
+}
+
+/*
+ * Searches use a NULL vqe_zio, which sorts before any queued zio with the
+ * same time interval and offset.
+ */
+__attribute__((always_inline)) inline
 static int
 vdev_queue_to_compare(const void *x1, const void *x2)
 {
-	const zio_t *z1 = (const zio_t *)x1;
-	const zio_t *z2 = (const zio_t *)x2;
+	const vdev_queue_ent_t *e1 = (const vdev_queue_ent_t *)x1;
+	const vdev_queue_ent_t *e2 = (const vdev_queue_ent_t *)x2;
 
-	int tcmp = TREE_CMP(z1->io_timestamp >> VDQ_T_SHIFT,
-	    z2->io_timestamp >> VDQ_T_SHIFT);
-	int ocmp = TREE_CMP(z1->io_offset, z2->io_offset);
+	int tcmp = TREE_CMP(e1->vqe_ts, e2->vqe_ts);
+	int ocmp = TREE_CMP(e1->vqe_offset, e2->vqe_offset);
 	int cmp = tcmp ? tcmp : ocmp;
 
-	if (likely(cmp | (z1->io_queue_state == ZIO_QS_NONE)))
+	if (likely(cmp))
 		return (cmp);
 
-	return (TREE_PCMP(z1, z2));
+	return (TREE_PCMP(e1->vqe_zio, e2->vqe_zio));
+}
+
+ZFS_BTREE_FIND_IN_BUF_FUNC(vdev_queue_to_find_in_buf, vdev_queue_ent_t,
+    vdev_queue_to_compare)
+
+static inline void
+vdev_queue_ent_init(vdev_queue_ent_t *e, zio_t *zio)
+{
+	e->vqe_ts = vdev_queue_sort_ts(zio) >> VDQ_T_SHIFT;
+	e->vqe_offset = zio->io_offset;
+	e->vqe_zio = zio;
+}
+
+static inline zio_t *
+vdev_queue_ent_zio(const vdev_queue_ent_t *e)
+{
+	return (e == NULL ? NULL : e->vqe_zio);
 }
 
 static inline boolean_t
@@ -252,9 +390,11 @@ vdev_queue_class_add(vdev_queue_t *vq, zio_t *zio)
 	if (vdev_queue_class_fifo(p)) {
 		list_insert_tail(&vq->vq_class[p].vqc_list, zio);
 		vq->vq_class[p].vqc_list_numnodes++;
+	} else {
+		vdev_queue_ent_t e;
+		vdev_queue_ent_init(&e, zio);
+		zfs_btree_add(&vq->vq_class[p].vqc_tree, &e);
 	}
-	else
-		avl_add(&vq->vq_class[p].vqc_tree, zio);
 }
 
 static void
@@ -268,9 +408,11 @@ vdev_queue_class_remove(vdev_queue_t *vq, zio_t *zio)
 		empty = list_is_empty(list);
 		vq->vq_class[p].vqc_list_numnodes--;
 	} else {
-		avl_tree_t *tree = &vq->vq_class[p].vqc_tree;
-		avl_remove(tree, zio);
-		empty = avl_is_empty(tree);
+		zfs_btree_t *tree = &vq->vq_class[p].vqc_tree;
+		vdev_queue_ent_t e;
+		vdev_queue_ent_init(&e, zio);
+		zfs_btree_remove(tree, &e);
+		empty = zfs_btree_numnodes(tree) == 0;
 	}
 	vq->vq_cqueued &= ~(empty << p);
 }
@@ -354,7 +496,7 @@ vdev_queue_max_async_writes(spa_t *spa)
 }
 
 static uint_t
-vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
+vdev_queue_class_tunable_max_active(vdev_queue_t *vq, zio_priority_t p)
 {
 	switch (p) {
 	case ZIO_PRIORITY_SYNC_READ:
@@ -401,16 +543,112 @@ vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
 	}
 }
 
+static uint_t
+vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
+{
+	uint_t max = vdev_queue_class_tunable_max_active(vq, p);
+
+	if (zfs_vdev_target_latency_us != 0 && vq->vq_lat_max[p] != 0) {
+		max = MAX(MIN(max, vq->vq_lat_max[p]),
+		    vdev_queue_class_min_active(vq, p));
+	}
+	return (max);
+}
+
+/*
+ * Feed the service time of a completed I/O into its class's latency
+ * average and adjust the class's adaptive active limit: additive increase
+ * while under target and saturated, multiplicative decrease while over.
+ */
+static void
+vdev_queue_latency_adjust(vdev_queue_t *vq, zio_t *zio, hrtime_t now)
+{
+	zio_priority_t p = zio->io_priority;
+	hrtime_t target = USEC2NSEC(zfs_vdev_target_latency_us);
+	uint_t max = vdev_queue_class_tunable_max_active(vq, p);
+	uint32_t lim = vq->vq_lat_max[p];
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+
+	if (lim == 0 || lim > max)
+		lim = max;
+
+	vq->vq_lat_avg[p] += (zio->io_delta - vq->vq_lat_avg[p]) / 8;
+	if (vq->vq_lat_avg[p] > target) {
+		if (now - vq->vq_lat_ts[p] >= target && lim > 1) {
+			lim -= MAX(lim / 4, 1);
+			vq->vq_lat_ts[p] = now;
+		}
+	} else if (vq->vq_cactive[p] >= lim && lim < max) {
+		lim++;
+	}
+	vq->vq_lat_max[p] = MAX(lim, 1);
+}
+
+static hrtime_t
+vdev_queue_class_deadline(zio_priority_t p)
+{
+	switch (p) {
+	case ZIO_PRIORITY_SYNC_READ:
+		return (MSEC2NSEC(zfs_vdev_sync_read_deadline_ms));
+	case ZIO_PRIORITY_SYNC_WRITE:
+		return (MSEC2NSEC(zfs_vdev_sync_write_deadline_ms));
+	case ZIO_PRIORITY_ASYNC_READ:
+		return (MSEC2NSEC(zfs_vdev_async_read_deadline_ms));
+	case ZIO_PRIORITY_ASYNC_WRITE:
+		return (MSEC2NSEC(zfs_vdev_async_write_deadline_ms));
+	default:
+		return (0);
+	}
+}
+
+static zio_t *
+vdev_queue_class_oldest(vdev_queue_t *vq, zio_priority_t p)
+{
+	if (vdev_queue_class_fifo(p))
+		return (list_head(&vq->vq_class[p].vqc_list));
+	return (vdev_queue_ent_zio(zfs_btree_first(&vq->vq_class[p].vqc_tree,
+	    NULL)));
+}
+
+/*
+ * Return a class with queued I/O whose oldest I/O is past the class
+ * deadline and which has room below its max_active, or
+ * ZIO_PRIORITY_NUM_QUEUEABLE if there is none.
+ */
+static zio_priority_t
+vdev_queue_class_expired(vdev_queue_t *vq, uint32_t cq)
+{
+	hrtime_t now = 0;
+
+	for (zio_priority_t p = 0; p <= ZIO_PRIORITY_ASYNC_WRITE; p++) {
+		hrtime_t deadline = vdev_queue_class_deadline(p);
+
+		if (deadline == 0 || (cq & (1U << p)) == 0 ||
+		    vq->vq_cactive[p] >= vdev_queue_class_max_active(vq, p))
+			continue;
+		if (now == 0)
+			now = gethrtime();
+		if (now - vdev_queue_class_oldest(vq, p)->io_timestamp >
+		    deadline)
+			return (p);
+	}
+	return (ZIO_PRIORITY_NUM_QUEUEABLE);
+}
+
 /*
  * Return the i/o class to issue from, or ZIO_PRIORITY_NUM_QUEUEABLE if
- * there is no eligible class.
+ * there is no eligible class.  *expired is set if the class was chosen
+ * because its oldest I/O has missed its deadline.
  */
 static zio_priority_t
-vdev_queue_class_to_issue(vdev_queue_t *vq)
+vdev_queue_class_to_issue(vdev_queue_t *vq, boolean_t *expired)
 {
 	uint32_t cq = vq->vq_cqueued;
 	zio_priority_t p, p1;
 
+	*expired = B_FALSE;
+
 	if (cq == 0 || vq->vq_active >= zfs_vdev_max_active)
 		return (ZIO_PRIORITY_NUM_QUEUEABLE);
 
@@ -433,6 +671,16 @@ vdev_queue_class_to_issue(vdev_queue_t *vq)
 			goto found;
 	}
 
+	/*
+	 * Otherwise let a class whose oldest i/o has missed its deadline go
+	 * ahead of higher-priority classes.
+	 */
+	p = vdev_queue_class_expired(vq, cq);
+	if (p != ZIO_PRIORITY_NUM_QUEUEABLE) {
+		*expired = B_TRUE;
+		goto found;
+	}
+
 	/*
 	 * If we haven't found a queue, look for one that hasn't reached its
 	 * maximum # outstanding i/os.
@@ -462,22 +710,24 @@ vdev_queue_init(vdev_t *vd)
 			    sizeof (zio_t),
 			    offsetof(struct zio, io_queue_node.l));
 		} else {
-			avl_create(&vq->vq_class[p].vqc_tree,
-			    vdev_queue_to_compare, sizeof (zio_t),
-			    offsetof(struct zio, io_queue_node.a));
+			zfs_btree_create(&vq->vq_class[p].vqc_tree,
+			    vdev_queue_to_compare, vdev_queue_to_find_in_buf,
+			    sizeof (vdev_queue_ent_t));
 		}
 	}
-	avl_create(&vq->vq_read_offset_tree,
-	    vdev_queue_offset_compare, sizeof (zio_t),
-	    offsetof(struct zio, io_offset_node));
-	avl_create(&vq->vq_write_offset_tree,
-	    vdev_queue_offset_compare, sizeof (zio_t),
-	    offsetof(struct zio, io_offset_node));
+	zfs_btree_create(&vq->vq_read_offset_tree, vdev_queue_offset_compare,
+	    vdev_queue_offset_find_in_buf, sizeof (vdev_queue_ent_t));
+	zfs_btree_create(&vq->vq_write_offset_tree, vdev_queue_offset_compare,
+	    vdev_queue_offset_find_in_buf, sizeof (vdev_queue_ent_t));
 
 	vq->vq_last_offset = 0;
+	vq->vq_read_gap = UINT64_MAX;
 	list_create(&vq->vq_active_list, sizeof (struct zio),
 	    offsetof(struct zio, io_queue_node.l));
+	list_create(&vq->vq_bypass_list, sizeof (struct zio),
+	    offsetof(struct zio, io_queue_node.l));
 	mutex_init(&vq->vq_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&vq->vq_bypass_lock, NULL, MUTEX_DEFAULT, NULL);
 }
 
 void
@@ -489,34 +739,50 @@ vdev_queue_fini(vdev_t *vd)
 		if (vdev_queue_class_fifo(p))
 			list_destroy(&vq->vq_class[p].vqc_list);
 		else
-			avl_destroy(&vq->vq_class[p].vqc_tree);
+			zfs_btree_destroy(&vq->vq_class[p].vqc_tree);
 	}
-	avl_destroy(&vq->vq_read_offset_tree);
-	avl_destroy(&vq->vq_write_offset_tree);
+	zfs_btree_destroy(&vq->vq_read_offset_tree);
+	zfs_btree_destroy(&vq->vq_write_offset_tree);
 
 	list_destroy(&vq->vq_active_list);
+	list_destroy(&vq->vq_bypass_list);
 	mutex_destroy(&vq->vq_lock);
+	mutex_destroy(&vq->vq_bypass_lock);
+}
+
+static zfs_btree_t *
+vdev_queue_offset_tree(vdev_queue_t *vq, zio_t *zio)
+{
+	if (zio->io_type == ZIO_TYPE_READ)
+		return (&vq->vq_read_offset_tree);
+	else if (zio->io_type == ZIO_TYPE_WRITE)
+		return (&vq->vq_write_offset_tree);
+	return (NULL);
 }
 
 static void
 vdev_queue_io_add(vdev_queue_t *vq, zio_t *zio)
 {
+	zfs_btree_t *t = vdev_queue_offset_tree(vq, zio);
+
 	zio->io_queue_state = ZIO_QS_QUEUED;
 	vdev_queue_class_add(vq, zio);
-	if (zio->io_type == ZIO_TYPE_READ)
-		avl_add(&vq->vq_read_offset_tree, zio);
-	else if (zio->io_type == ZIO_TYPE_WRITE)
-		avl_add(&vq->vq_write_offset_tree, zio);
+	if (t != NULL) {
+		vdev_queue_ent_t e = { 0, zio->io_offset, zio };
+		zfs_btree_add(t, &e);
+	}
 }
 
 static void
 vdev_queue_io_remove(vdev_queue_t *vq, zio_t *zio)
 {
+	zfs_btree_t *t = vdev_queue_offset_tree(vq, zio);
+
 	vdev_queue_class_remove(vq, zio);
-	if (zio->io_type == ZIO_TYPE_READ)
-		avl_remove(&vq->vq_read_offset_tree, zio);
-	else if (zio->io_type == ZIO_TYPE_WRITE)
-		avl_remove(&vq->vq_write_offset_tree, zio);
+	if (t != NULL) {
+		vdev_queue_ent_t e = { 0, zio->io_offset, zio };
+		zfs_btree_remove(t, &e);
+	}
 	zio->io_queue_state = ZIO_QS_NONE;
 }
 
@@ -592,6 +858,136 @@ vdev_queue_agg_io_done(zio_t *aio)
  * io_offsets by simply getting the zero ABD for writes or allocating
  * a new ABD for reads and placing them in the gang ABD as well.
  */
+static uint64_t
+vdev_queue_read_gap(vdev_queue_t *vq)
+{
+	if (zfs_vdev_read_gap_auto && vq->vq_read_gap != UINT64_MAX)
+		return (vq->vq_read_gap);
+	if (vq->vq_vdev->vdev_nonrot)
+		return (zfs_vdev_read_gap_limit_non_rotating);
+	return (zfs_vdev_read_gap_limit);
+}
+
+/*
+ * Fold the device time of a completed read into the small or large read
+ * average and recompute the break-even read gap.  See
+ * zfs_vdev_read_gap_auto.
+ */
+/*
+ * Fold a completed read into the device's average read time.  A failed
+ * read counts as twice the current average, so that a child returning
+ * errors looks slow as well.  Like vq_io_complete_ts this is updated
+ * without vq_lock, as it is only a hint for mirror child selection.
+ */
+static void
+vdev_queue_read_latency_update(vdev_queue_t *vq, zio_t *zio, hrtime_t now)
+{
+	hrtime_t lat = vq->vq_read_lat;
+	hrtime_t sample = zio->io_error != 0 ? lat * 2 : zio->io_delay;
+
+	if (sample <= 0)
+		return;
+
+	vq->vq_read_lat = (lat == 0) ? sample :
+	    lat - (lat >> 3) + (sample >> 3);
+	vq->vq_read_lat_ts = now;
+}
+
+/*
+ * Fold a completed interactive I/O into the device's foreground latency
+ * averages.  The baseline average is only updated while no scrub, resilver
+ * or rebuild I/O is active on the device, so comparing the two tells the
+ * scan code how much it slows down foreground I/O.  Updated without
+ * vq_lock, as these are only hints for scan throttling.
+ */
+static void
+vdev_queue_fg_latency_update(vdev_queue_t *vq, zio_t *zio, hrtime_t now)
+{
+	hrtime_t sample = zio->io_delta;
+
+	if (sample <= 0)
+		return;
+
+	vq->vq_fg_lat = (vq->vq_fg_lat == 0) ? sample :
+	    vq->vq_fg_lat - (vq->vq_fg_lat >> 3) + (sample >> 3);
+	if (vq->vq_cactive[ZIO_PRIORITY_SCRUB] == 0 &&
+	    vq->vq_cactive[ZIO_PRIORITY_REBUILD] == 0) {
+		vq->vq_fg_lat_base = (vq->vq_fg_lat_base == 0) ? sample :
+		    vq->vq_fg_lat_base - (vq->vq_fg_lat_base >> 4) +
+		    (sample >> 4);
+	}
+	vq->vq_fg_ts = now;
+}
+
+static void
+vdev_queue_read_cost_update(vdev_queue_t *vq, zio_t *zio)
+{
+	uint64_t *ns, *size;
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+
+	if (zio->io_size <= VDQ_COST_SMALL) {
+		ns = &vq->vq_cost_small_ns;
+		size = &vq->vq_cost_small_size;
+	} else if (zio->io_size >= VDQ_COST_LARGE) {
+		ns = &vq->vq_cost_large_ns;
+		size = &vq->vq_cost_large_size;
+	} else {
+		return;
+	}
+
+	if (*size == 0) {
+		*ns = zio->io_delay;
+		*size = zio->io_size;
+	} else {
+		*ns = *ns - (*ns >> 3) + (zio->io_delay >> 3);
+		*size = *size - (*size >> 3) + (zio->io_size >> 3);
+	}
+
+	uint64_t sns = vq->vq_cost_small_ns, ssz = vq->vq_cost_small_size;
+	uint64_t lns = vq->vq_cost_large_ns, lsz = vq->vq_cost_large_size;
+	if (ssz == 0 || lsz <= ssz || lns <= sns) {
+		vq->vq_read_gap = UINT64_MAX;
+		return;
+	}
+
+	/*
+	 * per-byte cost = (lns - sns) / (lsz - ssz)
+	 * overhead = sns - ssz * per-byte cost
+	 * break-even gap = overhead / per-byte cost
+	 */
+	uint64_t xfer = ssz * (lns - sns) / (lsz - ssz);
+	if (xfer >= sns) {
+		vq->vq_read_gap = 0;
+		return;
+	}
+	uint64_t limit = vq->vq_vdev->vdev_nonrot ?
+	    zfs_vdev_aggregation_limit_non_rotating :
+	    zfs_vdev_aggregation_limit;
+	vq->vq_read_gap = MIN((sns - xfer) * (lsz - ssz) / (lns - sns), limit);
+}
+
+uint64_t
+vdev_queue_agg_stat(vdev_t *vd, vdev_prop_t prop)
+{
+	vdev_queue_t *vq = &vd->vdev_queue;
+
+	switch (prop) {
+	case VDEV_PROP_AGG_READ_OPS:
+		return (vq->vq_agg_ops[0]);
+	case VDEV_PROP_AGG_WRITE_OPS:
+		return (vq->vq_agg_ops[1]);
+	case VDEV_PROP_AGG_READ_GAP_BYTES:
+		return (vq->vq_agg_gap_bytes[0]);
+	case VDEV_PROP_AGG_WRITE_GAP_BYTES:
+		return (vq->vq_agg_gap_bytes[1]);
+	case VDEV_PROP_READ_GAP_LIMIT:
+		return (vdev_queue_read_gap(vq));
+	default:
+		return (0);
+	}
+}
+
 static zio_t *
 vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 {
@@ -602,7 +998,8 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	boolean_t stretch = B_FALSE;
 	uint64_t next_offset;
 	abd_t *abd;
-	avl_tree_t *t;
+	zfs_btree_t *t;
+	zfs_btree_index_t fidx, lidx, idx;
 
 	/*
 	 * TRIM aggregation should not be needed since code in zfs_trim.c can
@@ -632,13 +1029,21 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	first = last = zio;
 
 	if (zio->io_type == ZIO_TYPE_READ) {
-		maxgap = zfs_vdev_read_gap_limit;
+		maxgap = vdev_queue_read_gap(vq);
 		t = &vq->vq_read_offset_tree;
 	} else {
 		ASSERT3U(zio->io_type, ==, ZIO_TYPE_WRITE);
 		t = &vq->vq_write_offset_tree;
 	}
 
+	/*
+	 * first and last are tracked along with their B-tree indices, which
+	 * stay valid until the tree is modified below.
+	 */
+	vdev_queue_ent_t search = { 0, zio->io_offset, zio };
+	VERIFY3P(zfs_btree_find(t, &search, &fidx), !=, NULL);
+	lidx = fidx;
+
 	/*
 	 * We can aggregate I/Os that are sufficiently adjacent and of
 	 * the same flavor, as expressed by the AGG_INHERIT flags.
@@ -659,12 +1064,14 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	 * recording the last non-optional I/O.
 	 */
 	zio_flag_t flags = zio->io_flags & ZIO_FLAG_AGG_INHERIT;
-	while ((dio = AVL_PREV(t, first)) != NULL &&
-	    (dio->io_flags & ZIO_FLAG_AGG_INHERIT) == flags &&
+	idx = fidx;
+	while ((dio = vdev_queue_ent_zio(zfs_btree_prev(t, &idx, &idx))) !=
+	    NULL && (dio->io_flags & ZIO_FLAG_AGG_INHERIT) == flags &&
 	    IO_SPAN(dio, last) <= limit &&
 	    IO_GAP(dio, first) <= maxgap &&
 	    dio->io_type == zio->io_type) {
 		first = dio;
+		fidx = idx;
 		if (mandatory == NULL && !(first->io_flags & ZIO_FLAG_OPTIONAL))
 			mandatory = first;
 	}
@@ -673,7 +1080,7 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	 * Skip any initial optional I/Os.
 	 */
 	while ((first->io_flags & ZIO_FLAG_OPTIONAL) && first != last) {
-		first = AVL_NEXT(t, first);
+		first = vdev_queue_ent_zio(zfs_btree_next(t, &fidx, &fidx));
 		ASSERT(first != NULL);
 	}
 
@@ -684,14 +1091,16 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	 * we can issue contiguous writes even if they are larger than the
 	 * aggregation limit.
 	 */
-	while ((dio = AVL_NEXT(t, last)) != NULL &&
-	    (dio->io_flags & ZIO_FLAG_AGG_INHERIT) == flags &&
+	idx = lidx;
+	while ((dio = vdev_queue_ent_zio(zfs_btree_next(t, &idx, &idx))) !=
+	    NULL && (dio->io_flags & ZIO_FLAG_AGG_INHERIT) == flags &&
 	    (IO_SPAN(first, dio) <= limit ||
 	    (dio->io_flags & ZIO_FLAG_OPTIONAL)) &&
 	    IO_SPAN(first, dio) <= SPA_MAXBLOCKSIZE &&
 	    IO_GAP(last, dio) <= maxgap &&
 	    dio->io_type == zio->io_type) {
 		last = dio;
+		lidx = idx;
 		if (!(last->io_flags & ZIO_FLAG_OPTIONAL))
 			mandatory = last;
 	}
@@ -708,8 +1117,9 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	 */
 	if (zio->io_type == ZIO_TYPE_WRITE && mandatory != NULL) {
 		zio_t *nio = last;
-		while ((dio = AVL_NEXT(t, nio)) != NULL &&
-		    IO_GAP(nio, dio) == 0 &&
+		idx = lidx;
+		while ((dio = vdev_queue_ent_zio(zfs_btree_next(t, &idx,
+		    &idx))) != NULL && IO_GAP(nio, dio) == 0 &&
 		    IO_GAP(mandatory, dio) <= zfs_vdev_write_gap_limit) {
 			nio = dio;
 			if (!(nio->io_flags & ZIO_FLAG_OPTIONAL)) {
@@ -726,14 +1136,16 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 		 * start aggregated spans, so make sure that the next i/o
 		 * after our span is mandatory.
 		 */
-		dio = AVL_NEXT(t, last);
+		idx = lidx;
+		dio = vdev_queue_ent_zio(zfs_btree_next(t, &idx, &idx));
 		ASSERT3P(dio, !=, NULL);
 		dio->io_flags &= ~ZIO_FLAG_OPTIONAL;
 	} else {
 		/* do not include the optional i/o */
 		while (last != mandatory && last != first) {
 			ASSERT(last->io_flags & ZIO_FLAG_OPTIONAL);
-			last = AVL_PREV(t, last);
+			last = vdev_queue_ent_zio(zfs_btree_prev(t, &lidx,
+			    &lidx));
 			ASSERT(last != NULL);
 		}
 	}
@@ -753,22 +1165,35 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	    flags | ZIO_FLAG_DONT_QUEUE, vdev_queue_agg_io_done, NULL);
 	aio->io_timestamp = first->io_timestamp;
 
+	int rw = (first->io_type == ZIO_TYPE_WRITE);
+	vq->vq_agg_ops[rw]++;
+
+	/*
+	 * Removing an I/O invalidates the B-tree indices, so the next one is
+	 * looked up from the position the removed one left behind.
+	 */
 	nio = first;
 	next_offset = first->io_offset;
 	do {
 		dio = nio;
-		nio = AVL_NEXT(t, dio);
 		ASSERT3P(dio, !=, NULL);
 		zio_add_child(dio, aio);
 		vdev_queue_io_remove(vq, dio);
+		if (dio != last) {
+			search.vqe_offset = dio->io_offset;
+			search.vqe_zio = dio;
+			VERIFY3P(zfs_btree_find(t, &search, &idx), ==, NULL);
+			nio = vdev_queue_ent_zio(zfs_btree_next(t, &idx, &idx));
+		}
 
 		if (dio->io_offset != next_offset) {
 			/* allocate a buffer for a read gap */
 			ASSERT3U(dio->io_type, ==, ZIO_TYPE_READ);
 			ASSERT3U(dio->io_offset, >, next_offset);
-			abd = abd_alloc_for_io(
-			    dio->io_offset - next_offset, B_TRUE);
+			uint64_t gap = dio->io_offset - next_offset;
+			abd = abd_alloc_for_io(gap, B_TRUE);
 			abd_gang_add(aio->io_abd, abd, B_TRUE);
+			vq->vq_agg_gap_bytes[rw] += gap;
 		}
 		if (dio->io_abd &&
 		    (dio->io_size != abd_get_size(dio->io_abd))) {
@@ -783,6 +1208,7 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 				ASSERT3P(dio->io_abd, ==, NULL);
 				abd_gang_add(aio->io_abd,
 				    abd_get_zeros(dio->io_size), B_TRUE);
+				vq->vq_agg_gap_bytes[rw] += dio->io_size;
 			} else {
 				/*
 				 * We pass B_FALSE to abd_gang_add()
@@ -813,13 +1239,15 @@ vdev_queue_io_to_issue(vdev_queue_t *vq)
 {
 	zio_t *zio, *aio;
 	zio_priority_t p;
-	avl_index_t idx;
-	avl_tree_t *tree;
+	zfs_btree_index_t idx;
+	zfs_btree_t *tree;
+	vdev_queue_ent_t *e, search;
+	boolean_t expired;
 
 again:
 	ASSERT(MUTEX_HELD(&vq->vq_lock));
 
-	p = vdev_queue_class_to_issue(vq);
+	p = vdev_queue_class_to_issue(vq, &expired);
 
 	if (p == ZIO_PRIORITY_NUM_QUEUEABLE) {
 		/* No eligible queued i/os */
@@ -836,22 +1264,25 @@ again:
 		 * the same 0.5 second interval as the first I/O.
 		 */
 		tree = &vq->vq_class[p].vqc_tree;
-		zio = aio = avl_first(tree);
-		if (zio->io_offset < vq->vq_last_offset) {
-			vq->vq_io_search.io_timestamp = zio->io_timestamp;
-			vq->vq_io_search.io_offset = vq->vq_last_offset;
-			zio = avl_find(tree, &vq->vq_io_search, &idx);
-			if (zio == NULL) {
-				zio = avl_nearest(tree, idx, AVL_AFTER);
-				if (zio == NULL ||
-				    (zio->io_timestamp >> VDQ_T_SHIFT) !=
-				    (aio->io_timestamp >> VDQ_T_SHIFT))
-					zio = aio;
-			}
+		e = zfs_btree_first(tree, NULL);
+		zio = aio = e->vqe_zio;
+		if (!expired && zio->io_offset < vq->vq_last_offset) {
+			search.vqe_ts = e->vqe_ts;
+			search.vqe_offset = vq->vq_last_offset;
+			search.vqe_zio = NULL;
+			VERIFY3P(zfs_btree_find(tree, &search, &idx), ==, NULL);
+			e = zfs_btree_next(tree, &idx, &idx);
+			if (e != NULL && e->vqe_ts == search.vqe_ts)
+				zio = e->vqe_zio;
 		}
 	}
 	ASSERT3U(zio->io_priority, ==, p);
 
+	if (expired) {
+		atomic_inc_64(
+		    &vdev_queue_stats.vqs_deadline_miss[p].value.ui64);
+	}
+
 	aio = vdev_queue_aggregate(vq, zio);
 	if (aio != NULL) {
 		zio = aio;
@@ -875,10 +1306,44 @@ again:
 
 	vdev_queue_pending_add(vq, zio);
 	vq->vq_last_offset = zio->io_offset + zio->io_size;
+	DTRACE_PROBE1(vdev__queue__issue, zio_t *, zio);
 
 	return (zio);
 }
 
+/*
+ * Try to issue the zio directly, bypassing the queue and vq_lock.  See
+ * zfs_vdev_queue_bypass.  Returns B_TRUE if the zio should be issued now.
+ */
+static boolean_t
+vdev_queue_bypass(vdev_queue_t *vq, zio_t *zio)
+{
+	if (!zfs_vdev_queue_bypass || !vq->vq_vdev->vdev_nonrot ||
+	    (zio->io_priority != ZIO_PRIORITY_SYNC_READ &&
+	    zio->io_priority != ZIO_PRIORITY_SYNC_WRITE))
+		return (B_FALSE);
+
+	/*
+	 * Unlocked reads: if the regular queue has work we let it keep
+	 * ordering and class fairness; a race here only costs one I/O.
+	 */
+	if (vq->vq_active != 0 || vq->vq_cqueued != 0)
+		return (B_FALSE);
+
+	if (atomic_inc_32_nv(&vq->vq_mq_active) >
+	    zfs_vdev_queue_bypass_max_active) {
+		atomic_dec_32(&vq->vq_mq_active);
+		return (B_FALSE);
+	}
+	atomic_inc_32(&vq->vq_mq_cactive[zio->io_priority]);
+	zio->io_queue_state = ZIO_QS_BYPASS;
+	mutex_enter(&vq->vq_bypass_lock);
+	list_insert_tail(&vq->vq_bypass_list, zio);
+	mutex_exit(&vq->vq_bypass_lock);
+	DTRACE_PROBE1(vdev__queue__issue, zio_t *, zio);
+	return (B_TRUE);
+}
+
 zio_t *
 vdev_queue_io(zio_t *zio)
 {
@@ -921,6 +1386,10 @@ vdev_queue_io(zio_t *zio)
 
 	zio->io_flags |= ZIO_FLAG_DONT_QUEUE;
 	zio->io_timestamp = gethrtime();
+	DTRACE_PROBE1(vdev__queue__enqueue, zio_t *, zio);
+
+	if (vdev_queue_bypass(vq, zio))
+		return (zio);
 
 	mutex_enter(&vq->vq_lock);
 	vdev_queue_io_add(vq, zio);
@@ -953,8 +1422,27 @@ vdev_queue_io_done(zio_t *zio)
 	hrtime_t now = gethrtime();
 	vq->vq_io_complete_ts = now;
 	vq->vq_io_delta_ts = zio->io_delta = now - zio->io_timestamp;
+	if (zio->io_type == ZIO_TYPE_READ)
+		vdev_queue_read_latency_update(vq, zio, now);
+	if ((zio->io_type == ZIO_TYPE_READ || zio->io_type == ZIO_TYPE_WRITE) &&
+	    vdev_queue_is_interactive(zio->io_priority))
+		vdev_queue_fg_latency_update(vq, zio, now);
+
+	if (zio->io_queue_state == ZIO_QS_BYPASS) {
+		mutex_enter(&vq->vq_bypass_lock);
+		list_remove(&vq->vq_bypass_list, zio);
+		mutex_exit(&vq->vq_bypass_lock);
+		atomic_dec_32(&vq->vq_mq_cactive[zio->io_priority]);
+		atomic_dec_32(&vq->vq_mq_active);
+		zio->io_queue_state = ZIO_QS_NONE;
+		return;
+	}
 
 	mutex_enter(&vq->vq_lock);
+	if (zfs_vdev_target_latency_us != 0)
+		vdev_queue_latency_adjust(vq, zio, now);
+	if (zio->io_type == ZIO_TYPE_READ && zio->io_delay > 0)
+		vdev_queue_read_cost_update(vq, zio);
 	vdev_queue_pending_remove(vq, zio);
 
 	while ((nio = vdev_queue_io_to_issue(vq)) != NULL) {
@@ -1044,7 +1532,71 @@ vdev_queue_pool_busy(spa_t *spa)
 uint32_t
 vdev_queue_length(vdev_t *vd)
 {
-	return (vd->vdev_queue.vq_active);
+	return (vd->vdev_queue.vq_active + vd->vdev_queue.vq_mq_active);
+}
+
+/*
+ * Average device time of recent reads, or 0 if there has been no read
+ * within max_age.  Used by the mirror code to steer reads away from a
+ * slow child.
+ */
+hrtime_t
+vdev_queue_read_latency(vdev_t *vd, hrtime_t max_age)
+{
+	vdev_queue_t *vq = &vd->vdev_queue;
+
+	if (!vd->vdev_ops->vdev_op_leaf || vq->vq_read_lat == 0 ||
+	    gethrtime() - vq->vq_read_lat_ts > max_age)
+		return (0);
+
+	return (vq->vq_read_lat);
+}
+
+/*
+ * How long the oldest active I/O of a leaf vdev has been outstanding, or 0
+ * if there is none.  Unlike vdev_queue_read_latency(), which only moves
+ * when I/Os complete, this notices a device that has stopped completing
+ * them, so reads can be sent to its redundancy instead.
+ */
+hrtime_t
+vdev_queue_stall_time(vdev_t *vd)
+{
+	vdev_queue_t *vq = &vd->vdev_queue;
+	hrtime_t stall = 0;
+	zio_t *fio;
+
+	if (!vd->vdev_ops->vdev_op_leaf ||
+	    (vq->vq_active == 0 && vq->vq_mq_active == 0))
+		return (0);
+
+	mutex_enter(&vq->vq_lock);
+	if ((fio = list_head(&vq->vq_active_list)) != NULL)
+		stall = gethrtime() - fio->io_timestamp;
+	mutex_exit(&vq->vq_lock);
+
+	mutex_enter(&vq->vq_bypass_lock);
+	if ((fio = list_head(&vq->vq_bypass_list)) != NULL)
+		stall = MAX(stall, gethrtime() - fio->io_timestamp);
+	mutex_exit(&vq->vq_bypass_lock);
+
+	return (stall);
+}
+
+/*
+ * Average time of recent interactive I/Os on a leaf vdev, together with
+ * the same average measured while no scan I/O was active and the time of
+ * the last interactive I/O.  Returns 0 if there has been none.
+ */
+hrtime_t
+vdev_queue_fg_latency(vdev_t *vd, hrtime_t *base, hrtime_t *last)
+{
+	vdev_queue_t *vq = &vd->vdev_queue;
+
+	ASSERT(vd->vdev_ops->vdev_op_leaf);
+
+	*base = vq->vq_fg_lat_base;
+	*last = vq->vq_fg_ts;
+	return (vq->vq_fg_lat);
 }
 
 uint64_t
@@ -1060,7 +1612,7 @@ vdev_queue_class_length(vdev_t *vd, zio_priority_t p)
 	if (vdev_queue_class_fifo(p))
 		return (vq->vq_class[p].vqc_list_numnodes);
 	else
-		return (avl_numnodes(&vq->vq_class[p].vqc_tree));
+		return (zfs_btree_numnodes(&vq->vq_class[p].vqc_tree));
 }
 
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, aggregation_limit, UINT, ZMOD_RW,
@@ -1072,6 +1624,12 @@ ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, aggregation_limit_non_rotating, UINT,
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, read_gap_limit, UINT, ZMOD_RW,
 	"Aggregate read I/O over gap");
 
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, read_gap_limit_non_rotating, UINT,
+	ZMOD_RW, "Aggregate read I/O over gap on non-rotating media");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, read_gap_auto, INT, ZMOD_RW,
+	"Estimate the read gap limit from measured device times");
+
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, write_gap_limit, UINT, ZMOD_RW,
 	"Aggregate write I/O over gap");
 
@@ -1141,5 +1699,26 @@ ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, rebuild_min_active, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, nia_credit, UINT, ZMOD_RW,
 	"Number of non-interactive I/Os to allow in sequence");
 
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, target_latency_us, UINT, ZMOD_RW,
+	"Target I/O latency for adaptive per-class active limits (0=off)");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, queue_bypass, INT, ZMOD_RW,
+	"Issue interactive I/O to non-rotational vdevs without queueing");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, queue_bypass_max_active, UINT, ZMOD_RW,
+	"Max bypassed I/Os active per non-rotational vdev");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, sync_read_deadline_ms, UINT, ZMOD_RW,
+	"Deadline for queued sync read I/Os in ms (0=off)");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, sync_write_deadline_ms, UINT, ZMOD_RW,
+	"Deadline for queued sync write I/Os in ms (0=off)");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, async_read_deadline_ms, UINT, ZMOD_RW,
+	"Deadline for queued async read I/Os in ms (0=off)");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, async_write_deadline_ms, UINT, ZMOD_RW,
+	"Deadline for queued async write I/Os in ms (0=off)");
+
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, nia_delay, UINT, ZMOD_RW,
 	"Number of non-interactive I/Os before _max_active");
@@ -370,6 +370,34 @@ static unsigned long raidz_expand_max_copy_bytes = 10 * SPA_MAXBLOCKSIZE;
  */
 static unsigned long raidz_io_aggregate_rows = 4;
 
+/*
+ * A data column whose child has had an I/O outstanding for longer than this
+ * is reconstructed from parity instead of read, as long as the row has
+ * parity to spare.  Zero disables.
+ */
+static uint_t raidz_read_stall_ms = 0;
+
+/*
+ * Unallocated gaps up to this size between allocated segments are copied
+ * along with them, so that a fragmented metaslab is reflowed in large
+ * multi-row chunks instead of one small chunk per segment.
+ */
+static uint_t raidz_expand_max_gap_bytes = 0;
+
+/*
+ * Shrink the amount of outstanding reflow i/o while the children have
+ * foreground i/o waiting, see raidz_expand_copy_limit().
+ */
+static int raidz_expand_adaptive = 0;
+
+/*
+ * Number of threads used to evaluate combinatorial reconstruction candidates
+ * in parallel.  Values below 2 evaluate them serially in the calling thread.
+ */
+static uint_t raidz_combrec_threads = 0;
+
+static taskq_t *raidz_combrec_taskq;
+
 /*
  * Automatically start a pool scrub when a RAIDZ expansion completes in
  * order to verify the checksums of all blocks which have been copied
@@ -2440,6 +2468,36 @@ raidz_start_skip_writes(zio_t *zio)
 	}
 }
 
+/*
+ * Return B_TRUE if data column c of a normal read should be skipped and
+ * reconstructed, because its child has stalled and every parity column of
+ * the row can be read in its place.
+ */
+static boolean_t
+vdev_raidz_col_stalled(zio_t *zio, raidz_row_t *rr, int c)
+{
+	vdev_t *vd = zio->io_vd;
+	hrtime_t stall = MSEC2NSEC(raidz_read_stall_ms);
+
+	if (stall == 0 || c < rr->rr_firstdatacol ||
+	    rr->rr_missingdata >= rr->rr_firstdatacol ||
+	    (zio->io_flags & (ZIO_FLAG_SCRUB | ZIO_FLAG_RESILVER |
+	    ZIO_FLAG_IO_RETRY)) ||
+	    vdev_queue_stall_time(vd->vdev_child[rr->rr_col[c].rc_devidx]) <=
+	    stall)
+		return (B_FALSE);
+
+	for (int p = 0; p < rr->rr_firstdatacol; p++) {
+		vdev_t *pvd = vd->vdev_child[rr->rr_col[p].rc_devidx];
+
+		if (!vdev_readable(pvd) ||
+		    vdev_dtl_contains(pvd, DTL_MISSING, zio->io_txg, 1))
+			return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
 static void
 vdev_raidz_io_start_read_row(zio_t *zio, raidz_row_t *rr, boolean_t forceparity)
 {
@@ -2473,6 +2531,12 @@ vdev_raidz_io_start_read_row(zio_t *zio, raidz_row_t *rr, boolean_t forceparity)
 			rc->rc_skipped = 1;
 			continue;
 		}
+		if (vdev_raidz_col_stalled(zio, rr, c)) {
+			rr->rr_missingdata++;
+			rc->rc_error = SET_ERROR(EBUSY);
+			rc->rc_skipped = 1;
+			continue;
+		}
 		if (forceparity ||
 		    c >= rr->rr_firstdatacol || rr->rr_missingdata > 0 ||
 		    (zio->io_flags & (ZIO_FLAG_SCRUB | ZIO_FLAG_RESILVER))) {
@@ -3092,13 +3156,490 @@ raidz_reconstruct(zio_t *zio, int *ltgts, int ntgts, int nparity)
 	return (ECKSUM);
 }
 
+/*
+ * State shared by the attempts of a single vdev_raidz_combrec() call.
+ *
+ * Many combinations of simulated failures lead to exactly the same
+ * reconstruction.  For example, with double parity, targeting data column 4
+ * alone or together with Q both rebuild column 4 from P.  Every attempt is
+ * therefore reduced to a signature recording, for each row, the data columns
+ * being rebuilt and the parity columns they are rebuilt from.  Attempts whose
+ * signature has already been tried are skipped, since their outcome is
+ * already known.
+ *
+ * When raidz_combrec_threads allows it, candidates are collected in batches
+ * and evaluated by workers on raidz_combrec_taskq.  Each worker rebuilds the
+ * block in a private copy so that the map itself is only modified by the
+ * final, serial, raidz_reconstruct() of the winning candidate.  The batch is
+ * scanned in order, so the combination chosen is the same one the serial
+ * search would have found.
+ */
+#define	RAIDZ_COMBREC_BATCH	64
+
+typedef struct raidz_combrec_sig {
+	avl_node_t	rcs_node;
+	int		rcs_nrows;
+	uint64_t	rcs_row[];
+} raidz_combrec_sig_t;
+
+typedef struct raidz_combrec_worker {
+	struct raidz_combrec	*rcw_rcc;
+	raidz_row_t		*rcw_row;	/* private copy of the row */
+	abd_t			*rcw_abd;	/* private copy of the block */
+	int			rcw_id;
+	taskqid_t		rcw_tqid;
+} raidz_combrec_worker_t;
+
+typedef struct raidz_combrec {
+	zio_t			*rcc_zio;
+	int			rcc_nparity;
+	avl_tree_t		rcc_known;	/* signatures already tried */
+	raidz_combrec_sig_t	*rcc_key;	/* signature of the candidate */
+	size_t			rcc_keysize;
+	int			rcc_nworkers;	/* 0 when searching serially */
+	raidz_combrec_worker_t	*rcc_workers;
+	int			rcc_batch;	/* candidates per batch */
+	int			rcc_ntgts;
+	int			rcc_ncand;
+	volatile uint32_t	rcc_found;	/* first successful candidate */
+	int			rcc_tgts[RAIDZ_COMBREC_BATCH *
+	    VDEV_RAIDZ_MAXPARITY];
+	int			rcc_result[RAIDZ_COMBREC_BATCH];
+} raidz_combrec_t;
+
+static int
+raidz_combrec_sig_compare(const void *x1, const void *x2)
+{
+	const raidz_combrec_sig_t *s1 = x1;
+	const raidz_combrec_sig_t *s2 = x2;
+
+	for (int r = 0; r < s1->rcs_nrows; r++) {
+		int cmp = TREE_CMP(s1->rcs_row[r], s2->rcs_row[r]);
+		if (cmp != 0)
+			return (cmp);
+	}
+	return (0);
+}
+
+/*
+ * Fill in rcc_key with the signature of the reconstruction raidz_reconstruct()
+ * would perform for the given logical targets.  Returns EINVAL if it would
+ * find too many failures to attempt a reconstruction, 0 otherwise.
+ */
+static int
+raidz_combrec_signature(raidz_combrec_t *rcc, const int *ltgts, int ntgts)
+{
+	zio_t *zio = rcc->rcc_zio;
+	raidz_map_t *rm = zio->io_vsd;
+	int nparity = rcc->rcc_nparity;
+	int physical_width = zio->io_vd->vdev_children;
+	int original_width = (rm->rm_original_width != 0) ?
+	    rm->rm_original_width : physical_width;
+	int ashift = zio->io_vd->vdev_top->vdev_ashift;
+
+	for (int r = 0; r < rm->rm_nrows; r++) {
+		raidz_row_t *rr = rm->rm_row[r];
+		uint64_t sig = 0;
+		int parity_valid = 0;
+		int dead = 0;
+		int dead_data = 0;
+
+		for (int c = 0; c < rr->rr_cols; c++) {
+			raidz_col_t *rc = &rr->rr_col[c];
+			boolean_t failed = (rc->rc_error != 0);
+
+			for (int lt = 0; lt < ntgts && !failed &&
+			    rc->rc_size != 0; lt++) {
+				failed = raidz_simulate_failure(physical_width,
+				    original_width, ashift, ltgts[lt], rc);
+			}
+
+			if (failed) {
+				dead++;
+				if (c >= nparity) {
+					dead_data++;
+					sig = (sig << 16) | c;
+				}
+			} else if (c < nparity) {
+				parity_valid |= 1 << c;
+			}
+		}
+		if (dead > nparity)
+			return (EINVAL);
+
+		/*
+		 * The missing data is always rebuilt from the first valid
+		 * parity columns, see vdev_raidz_reconstruct_row().
+		 */
+		int used = 0;
+		for (int c = 0, i = 0; c < nparity && i < dead_data; c++) {
+			if (parity_valid & (1 << c)) {
+				used |= 1 << c;
+				i++;
+			}
+		}
+		rcc->rcc_key->rcs_row[r] = (sig << VDEV_RAIDZ_MAXPARITY) | used;
+	}
+	return (0);
+}
+
+/*
+ * Returns B_TRUE if the reconstruction described by rcc_key was already
+ * attempted, otherwise records it and returns B_FALSE.
+ */
+static boolean_t
+raidz_combrec_known(raidz_combrec_t *rcc)
+{
+	avl_index_t where;
+
+	if (avl_find(&rcc->rcc_known, rcc->rcc_key, &where) != NULL) {
+		if (zfs_flags & ZFS_DEBUG_RAIDZ_RECONSTRUCT) {
+			zfs_dbgmsg("reconstruction of zio=%px already tried",
+			    rcc->rcc_zio);
+		}
+		return (B_TRUE);
+	}
+
+	raidz_combrec_sig_t *rcs = rcc->rcc_key;
+	avl_insert(&rcc->rcc_known, rcs, where);
+	rcc->rcc_key = kmem_alloc(rcc->rcc_keysize, KM_SLEEP);
+	rcc->rcc_key->rcs_nrows = rcs->rcs_nrows;
+	return (B_FALSE);
+}
+
+/*
+ * Workers rebuild the block in a private buffer, which relies on the data
+ * columns of a single row tiling io_abd in order.  Injected checksum errors
+ * and Direct I/O verification are only handled by raidz_checksum_verify(),
+ * so those reads are always searched serially.
+ */
+static boolean_t
+raidz_combrec_parallel_ok(zio_t *zio)
+{
+	raidz_map_t *rm = zio->io_vsd;
+
+	if (raidz_combrec_threads < 2 || raidz_combrec_taskq == NULL)
+		return (B_FALSE);
+
+	if (zio->io_vd->vdev_ops != &vdev_raidz_ops || rm->rm_nrows != 1 ||
+	    rm->rm_phys_col != NULL)
+		return (B_FALSE);
+
+	if (zio_injection_enabled || (zio->io_flags & ZIO_FLAG_DIO_READ))
+		return (B_FALSE);
+
+	raidz_row_t *rr = rm->rm_row[0];
+	uint64_t size = 0;
+	for (int c = rr->rr_firstdatacol; c < rr->rr_cols; c++)
+		size += rr->rr_col[c].rc_size;
+
+	return (size == zio->io_size);
+}
+
+static void
+raidz_combrec_worker_init(raidz_combrec_worker_t *rcw, zio_t *zio)
+{
+	raidz_row_t *rr = ((raidz_map_t *)zio->io_vsd)->rm_row[0];
+	size_t size = offsetof(raidz_row_t, rr_col[rr->rr_scols]);
+	raidz_row_t *wrr = kmem_alloc(size, KM_SLEEP);
+
+	rcw->rcw_abd = abd_alloc_linear(zio->io_size, B_FALSE);
+	abd_copy(rcw->rcw_abd, zio->io_abd, zio->io_size);
+
+	memcpy(wrr, rr, size);
+	uint64_t off = 0;
+	for (int c = 0; c < rr->rr_cols; c++) {
+		raidz_col_t *rc = &wrr->rr_col[c];
+
+		rc->rc_orig_data = NULL;
+		rc->rc_need_orig_restore = B_FALSE;
+
+		/* Parity is only read, and can be shared with the map. */
+		if (c < rr->rr_firstdatacol || rc->rc_size == 0)
+			continue;
+
+		rc->rc_abd = abd_get_offset_size(rcw->rcw_abd, off,
+		    rc->rc_size);
+		ASSERT0(abd_cmp(rc->rc_abd, rr->rr_col[c].rc_abd));
+		off += rc->rc_size;
+	}
+	rcw->rcw_row = wrr;
+}
+
+static void
+raidz_combrec_worker_fini(raidz_combrec_worker_t *rcw)
+{
+	raidz_row_t *wrr = rcw->rcw_row;
+
+	for (int c = wrr->rr_firstdatacol; c < wrr->rr_cols; c++) {
+		if (wrr->rr_col[c].rc_size != 0)
+			abd_free(wrr->rr_col[c].rc_abd);
+	}
+	kmem_free(wrr, offsetof(raidz_row_t, rr_col[wrr->rr_scols]));
+	abd_free(rcw->rcw_abd);
+}
+
+static raidz_combrec_t *
+raidz_combrec_alloc(zio_t *zio, int nparity)
+{
+	raidz_map_t *rm = zio->io_vsd;
+	raidz_combrec_t *rcc = kmem_zalloc(sizeof (*rcc), KM_SLEEP);
+
+	rcc->rcc_zio = zio;
+	rcc->rcc_nparity = nparity;
+	rcc->rcc_keysize = offsetof(raidz_combrec_sig_t, rcs_row[rm->rm_nrows]);
+	rcc->rcc_key = kmem_alloc(rcc->rcc_keysize, KM_SLEEP);
+	rcc->rcc_key->rcs_nrows = rm->rm_nrows;
+	avl_create(&rcc->rcc_known, raidz_combrec_sig_compare,
+	    sizeof (raidz_combrec_sig_t),
+	    offsetof(raidz_combrec_sig_t, rcs_node));
+
+	if (raidz_combrec_parallel_ok(zio)) {
+		rcc->rcc_nworkers = MIN(raidz_combrec_threads, boot_ncpus);
+		rcc->rcc_nworkers = MAX(rcc->rcc_nworkers, 2);
+		rcc->rcc_batch = MIN(rcc->rcc_nworkers * 4,
+		    RAIDZ_COMBREC_BATCH);
+		rcc->rcc_workers = kmem_zalloc(rcc->rcc_nworkers *
+		    sizeof (raidz_combrec_worker_t), KM_SLEEP);
+		for (int w = 0; w < rcc->rcc_nworkers; w++) {
+			raidz_combrec_worker_t *rcw = &rcc->rcc_workers[w];
+
+			rcw->rcw_rcc = rcc;
+			rcw->rcw_id = w;
+			raidz_combrec_worker_init(rcw, zio);
+		}
+	}
+
+	return (rcc);
+}
+
+static void
+raidz_combrec_free(raidz_combrec_t *rcc)
+{
+	raidz_combrec_sig_t *rcs;
+	void *cookie = NULL;
+
+	for (int w = 0; w < rcc->rcc_nworkers; w++)
+		raidz_combrec_worker_fini(&rcc->rcc_workers[w]);
+	if (rcc->rcc_workers != NULL) {
+		kmem_free(rcc->rcc_workers,
+		    rcc->rcc_nworkers * sizeof (raidz_combrec_worker_t));
+	}
+
+	while ((rcs = avl_destroy_nodes(&rcc->rcc_known, &cookie)) != NULL)
+		kmem_free(rcs, rcc->rcc_keysize);
+	avl_destroy(&rcc->rcc_known);
+	kmem_free(rcc->rcc_key, rcc->rcc_keysize);
+	kmem_free(rcc, sizeof (*rcc));
+}
+
+/*
+ * Equivalent of raidz_reconstruct() operating on a worker's private copy of
+ * the block.  The map is left untouched and no errors are reported.
+ */
+static int
+raidz_combrec_try(raidz_combrec_worker_t *rcw, const int *ltgts)
+{
+	raidz_combrec_t *rcc = rcw->rcw_rcc;
+	zio_t *zio = rcc->rcc_zio;
+	raidz_map_t *rm = zio->io_vsd;
+	raidz_row_t *rr = rm->rm_row[0];
+	raidz_row_t *wrr = rcw->rcw_row;
+	blkptr_t *bp = zio->io_bp;
+	int nparity = rcc->rcc_nparity;
+	int physical_width = zio->io_vd->vdev_children;
+	int original_width = (rm->rm_original_width != 0) ?
+	    rm->rm_original_width : physical_width;
+	int my_tgts[VDEV_RAIDZ_MAXPARITY];
+	int t = 0;
+	int dead = 0;
+	int dead_data = 0;
+
+	for (int c = 0; c < wrr->rr_cols; c++) {
+		raidz_col_t *rc = &wrr->rr_col[c];
+		if (rc->rc_error != 0) {
+			dead++;
+			if (c >= nparity)
+				dead_data++;
+			continue;
+		}
+		if (rc->rc_size == 0)
+			continue;
+		for (int lt = 0; lt < rcc->rcc_ntgts; lt++) {
+			if (raidz_simulate_failure(physical_width,
+			    original_width, zio->io_vd->vdev_top->vdev_ashift,
+			    ltgts[lt], rc)) {
+				dead++;
+				if (c >= nparity)
+					dead_data++;
+				if (t < VDEV_RAIDZ_MAXPARITY)
+					my_tgts[t++] = c;
+				break;
+			}
+		}
+	}
+	if (dead > nparity)
+		return (EINVAL);
+	if (dead_data > 0)
+		vdev_raidz_reconstruct_row(rm, wrr, my_tgts, t);
+
+	zio_bad_cksum_t zbc = {0};
+	int err = zio_checksum_error_impl(zio->io_spa, bp,
+	    BP_IS_GANG(bp) ? ZIO_CHECKSUM_GANG_HEADER : BP_GET_CHECKSUM(bp),
+	    rcw->rcw_abd, BP_IS_GANG(bp) ? zio_gang_header_size(zio->io_spa,
+	    bp, BP_GET_BIRTH(bp)) : BP_GET_PSIZE(bp), zio->io_offset, &zbc);
+
+	/* Put back the data of the columns treated as failed */
+	for (int i = 0; i < t; i++) {
+		int c = my_tgts[i];
+		if (c >= wrr->rr_firstdatacol) {
+			abd_copy(wrr->rr_col[c].rc_abd, rr->rr_col[c].rc_abd,
+			    rr->rr_col[c].rc_size);
+		}
+	}
+
+	return (err == 0 ? 0 : ECKSUM);
+}
+
+static void
+raidz_combrec_worker(void *arg)
+{
+	raidz_combrec_worker_t *rcw = arg;
+	raidz_combrec_t *rcc = rcw->rcw_rcc;
+
+	for (int j = rcw->rcw_id; j < rcc->rcc_ncand;
+	    j += rcc->rcc_nworkers) {
+		/* An earlier candidate already succeeded */
+		if ((uint32_t)j > rcc->rcc_found)
+			break;
+
+		int err = raidz_combrec_try(rcw,
+		    &rcc->rcc_tgts[j * rcc->rcc_ntgts]);
+		rcc->rcc_result[j] = err;
+		if (err == 0) {
+			uint32_t found;
+			do {
+				found = rcc->rcc_found;
+				if ((uint32_t)j >= found)
+					break;
+			} while (atomic_cas_32(&rcc->rcc_found, found, j) !=
+			    found);
+			break;
+		}
+	}
+}
+
+/*
+ * Evaluate the current batch of candidates in parallel, then apply the first
+ * one which succeeded to the map.  Returns 0 on success, ECKSUM otherwise.
+ */
+static int
+raidz_combrec_run(raidz_combrec_t *rcc)
+{
+	int ntgts = rcc->rcc_ntgts;
+	int ncand = rcc->rcc_ncand;
+
+	rcc->rcc_found = ncand;
+	for (int j = 0; j < ncand; j++)
+		rcc->rcc_result[j] = -1;
+
+	for (int w = 1; w < rcc->rcc_nworkers; w++) {
+		raidz_combrec_worker_t *rcw = &rcc->rcc_workers[w];
+
+		rcw->rcw_tqid = taskq_dispatch(raidz_combrec_taskq,
+		    raidz_combrec_worker, rcw, TQ_SLEEP);
+		if (rcw->rcw_tqid == TASKQID_INVALID)
+			raidz_combrec_worker(rcw);
+	}
+	raidz_combrec_worker(&rcc->rcc_workers[0]);
+	for (int w = 1; w < rcc->rcc_nworkers; w++) {
+		raidz_combrec_worker_t *rcw = &rcc->rcc_workers[w];
+
+		if (rcw->rcw_tqid != TASKQID_INVALID)
+			taskq_wait_id(raidz_combrec_taskq, rcw->rcw_tqid);
+	}
+
+	/*
+	 * Candidates skipped by the workers are only tried here if the
+	 * winning one unexpectedly fails when applied to the map.
+	 */
+	rcc->rcc_ncand = 0;
+	for (int j = 0; j < ncand; j++) {
+		if (rcc->rcc_result[j] != -1 && rcc->rcc_result[j] != 0)
+			continue;
+		if (raidz_reconstruct(rcc->rcc_zio, &rcc->rcc_tgts[j * ntgts],
+		    ntgts, rcc->rcc_nparity) == 0)
+			return (0);
+	}
+
+	return (ECKSUM);
+}
+
+/*
+ * Advance ltgts[] to the next combination to try, following the rules
+ * described above vdev_raidz_combrec().  Returns B_FALSE once every
+ * combination of num_failures logical children has been generated.
+ */
+static boolean_t
+raidz_combrec_next(int *ltgts, int num_failures, int n)
+{
+	for (int t = 0; ; t++) {
+		ASSERT3U(t, <, num_failures);
+		ltgts[t]++;
+		if (ltgts[t] == n) {
+			/* try more failures */
+			ASSERT3U(t, ==, num_failures - 1);
+			if (zfs_flags & ZFS_DEBUG_RAIDZ_RECONSTRUCT) {
+				zfs_dbgmsg("reconstruction failed for "
+				    "num_failures=%u; tried all combinations",
+				    num_failures);
+			}
+			return (B_FALSE);
+		}
+
+		ASSERT3U(ltgts[t], <, n);
+		ASSERT3U(ltgts[t], <=, ltgts[t + 1]);
+
+		/*
+		 * If that spot is available, we're done here.
+		 * Try the next combination.
+		 */
+		if (ltgts[t] != ltgts[t + 1])
+			return (B_TRUE);
+
+		/*
+		 * Otherwise, reset this tgt to the minimum,
+		 * and move on to the next tgt.
+		 */
+		ltgts[t] = ltgts[t - 1] + 1;
+		ASSERT3U(ltgts[t], ==, t);
+	}
+}
+
+void
+vdev_raidz_combrec_init(void)
+{
+	raidz_combrec_taskq = taskq_create("z_raidz_combrec", boot_ncpus,
+	    defclsyspri, boot_ncpus, INT_MAX, TASKQ_DYNAMIC);
+
+	VERIFY(raidz_combrec_taskq);
+}
+
+void
+vdev_raidz_combrec_fini(void)
+{
+	taskq_destroy(raidz_combrec_taskq);
+	raidz_combrec_taskq = NULL;
+}
+
 /*
  * Iterate over all combinations of N bad vdevs and attempt a reconstruction.
- * Note that the algorithm below is non-optimal because it doesn't take into
- * account how reconstruction is actually performed. For example, with
- * triple-parity RAID-Z the reconstruction procedure is the same if column 4
- * is targeted as invalid as if columns 1 and 4 are targeted since in both
- * cases we'd only use parity information in column 0.
+ * Note that the enumeration below doesn't take into account how
+ * reconstruction is actually performed. For example, with triple-parity
+ * RAID-Z the reconstruction procedure is the same if column 4 is targeted as
+ * invalid as if columns 1 and 4 are targeted since in both cases we'd only
+ * use parity information in column 0.  Such duplicates are detected using
+ * the signatures described above raidz_combrec_t, and only attempted once.
  *
  * The order that we find the various possible combinations of failed
  * disks is dictated by these rules:
@@ -3149,6 +3690,7 @@ vdev_raidz_combrec(zio_t *zio)
 	int physical_width = zio->io_vd->vdev_children;
 	int original_width = (rm->rm_original_width != 0) ?
 	    rm->rm_original_width : physical_width;
+	int err = ECKSUM;
 
 	for (int i = 0; i < rm->rm_nrows; i++) {
 		raidz_row_t *rr = rm->rm_row[i];
@@ -3163,7 +3705,10 @@ vdev_raidz_combrec(zio_t *zio)
 			return (vdev_raidz_worst_error(rr));
 	}
 
-	for (int num_failures = 1; num_failures <= nparity; num_failures++) {
+	raidz_combrec_t *rcc = raidz_combrec_alloc(zio, nparity);
+
+	for (int num_failures = 1; num_failures <= nparity && err != 0;
+	    num_failures++) {
 		int tstore[VDEV_RAIDZ_MAXPARITY + 2];
 		int *ltgts = &tstore[1]; /* value is logical child ID */
 
@@ -3187,63 +3732,43 @@ vdev_raidz_combrec(zio_t *zio)
 			ltgts[i] = i;
 		}
 		ltgts[num_failures] = n;
+		rcc->rcc_ntgts = num_failures;
 
-		for (;;) {
-			int err = raidz_reconstruct(zio, ltgts, num_failures,
-			    nparity);
-			if (err == EINVAL) {
+		do {
+			if (raidz_combrec_signature(rcc, ltgts,
+			    num_failures) == EINVAL) {
 				/*
 				 * Reconstruction not possible with this #
 				 * failures; try more failures.
 				 */
 				break;
-			} else if (err == 0)
-				return (0);
-
-			/* Compute next targets to try */
-			for (int t = 0; ; t++) {
-				ASSERT3U(t, <, num_failures);
-				ltgts[t]++;
-				if (ltgts[t] == n) {
-					/* try more failures */
-					ASSERT3U(t, ==, num_failures - 1);
-					if (zfs_flags &
-					    ZFS_DEBUG_RAIDZ_RECONSTRUCT) {
-						zfs_dbgmsg("reconstruction "
-						    "failed for num_failures="
-						    "%u; tried all "
-						    "combinations",
-						    num_failures);
-					}
-					break;
-				}
-
-				ASSERT3U(ltgts[t], <, n);
-				ASSERT3U(ltgts[t], <=, ltgts[t + 1]);
-
-				/*
-				 * If that spot is available, we're done here.
-				 * Try the next combination.
-				 */
-				if (ltgts[t] != ltgts[t + 1])
-					break; // found next combination
+			}
+			if (raidz_combrec_known(rcc))
+				continue;
 
-				/*
-				 * Otherwise, reset this tgt to the minimum,
-				 * and move on to the next tgt.
-				 */
-				ltgts[t] = ltgts[t - 1] + 1;
-				ASSERT3U(ltgts[t], ==, t);
+			if (rcc->rcc_nworkers == 0) {
+				err = raidz_reconstruct(zio, ltgts,
+				    num_failures, nparity);
+				ASSERT3S(err, !=, EINVAL);
+			} else {
+				memcpy(&rcc->rcc_tgts[rcc->rcc_ncand *
+				    num_failures], ltgts,
+				    num_failures * sizeof (int));
+				if (++rcc->rcc_ncand == rcc->rcc_batch)
+					err = raidz_combrec_run(rcc);
 			}
+		} while (err != 0 &&
+		    raidz_combrec_next(ltgts, num_failures, n));
 
-			/* Increase the number of failures and keep trying. */
-			if (ltgts[num_failures - 1] == n)
-				break;
-		}
+		if (err != 0 && rcc->rcc_ncand != 0)
+			err = raidz_combrec_run(rcc);
 	}
-	if (zfs_flags & ZFS_DEBUG_RAIDZ_RECONSTRUCT)
+
+	raidz_combrec_free(rcc);
+
+	if (err != 0 && (zfs_flags & ZFS_DEBUG_RAIDZ_RECONSTRUCT))
 		zfs_dbgmsg("reconstruction failed for all num_failures");
-	return (ECKSUM);
+	return (err == 0 ? 0 : ECKSUM);
 }
 
 void
@@ -3998,6 +4523,24 @@ raidz_reflow_impl(vdev_t *vd, vdev_raidz_expand_t *vre, zfs_range_tree_t *rt,
 
 	uint64_t blkid = offset >> ashift;
 	uint_t old_children = vd->vdev_children - 1;
+	uint64_t max_size = MIN(raidz_expand_max_copy_bytes,
+	    (uint64_t)old_children * MIN(zfs_max_recordsize, SPA_MAXBLOCKSIZE));
+
+	/*
+	 * Extend the chunk over small unallocated gaps to the following
+	 * segments.  The metaslab is disabled for the duration of its reflow,
+	 * so nothing can be allocated in the gaps and copying their contents
+	 * is harmless.
+	 */
+	uint64_t gap = raidz_expand_max_gap_bytes;
+	uint64_t nstart, nsize;
+	while (gap != 0 && size < max_size &&
+	    zfs_range_tree_find_in(rt, offset + size, gap, &nstart, &nsize)) {
+		ASSERT3U(nstart, >, offset + size);
+		VERIFY(zfs_range_tree_find_in(rt, nstart, max_size,
+		    &nstart, &nsize));
+		size = nstart + nsize - offset;
+	}
 
 	/*
 	 * We can only progress to the point that writes will not overlap
@@ -4022,14 +4565,12 @@ raidz_reflow_impl(vdev_t *vd, vdev_raidz_expand_t *vre, zfs_range_tree_t *rt,
 		return (B_TRUE);
 	}
 
-	size = MIN(size, raidz_expand_max_copy_bytes);
-	size = MIN(size, (uint64_t)old_children *
-	    MIN(zfs_max_recordsize, SPA_MAXBLOCKSIZE));
+	size = MIN(size, max_size);
 	size = MAX(size, 1 << ashift);
 	uint_t blocks = MIN(size >> ashift, next_overwrite_blkid - blkid);
 	size = (uint64_t)blocks << ashift;
 
-	zfs_range_tree_remove(rt, offset, size);
+	zfs_range_tree_clear(rt, offset, size);
 
 	uint_t reads = MIN(blocks, old_children);
 	uint_t writes = MIN(blocks, vd->vdev_children);
@@ -4124,6 +4665,45 @@ raidz_reflow_impl(vdev_t *vd, vdev_raidz_expand_t *vre, zfs_range_tree_t *rt,
 	return (B_FALSE);
 }
 
+/*
+ * Limit on the amount of outstanding reflow i/o.  With raidz_expand_adaptive
+ * set, the limit is halved each time a chunk is issued while any child has
+ * foreground i/o waiting in its queue, and grows back by a sixteenth of
+ * raidz_expand_max_copy_bytes per chunk while the children keep up.
+ */
+static uint64_t
+raidz_expand_copy_limit(vdev_t *vd, vdev_raidz_expand_t *vre)
+{
+	uint64_t max = raidz_expand_max_copy_bytes;
+	uint64_t min = MIN(max, SPA_MAXBLOCKSIZE);
+
+	if (!raidz_expand_adaptive) {
+		vre->vre_copy_limit = max;
+		return (max);
+	}
+
+	boolean_t busy = B_FALSE;
+	for (uint64_t c = 0; c < vd->vdev_children && !busy; c++) {
+		vdev_t *cvd = vd->vdev_child[c];
+
+		if (!cvd->vdev_ops->vdev_op_leaf)
+			continue;
+		for (zio_priority_t p = ZIO_PRIORITY_SYNC_READ;
+		    p <= ZIO_PRIORITY_ASYNC_WRITE && !busy; p++) {
+			busy = (vdev_queue_class_length(cvd, p) != 0);
+		}
+	}
+
+	uint64_t limit = MIN(MAX(vre->vre_copy_limit, min), max);
+	if (busy)
+		limit = MAX(limit / 2, min);
+	else
+		limit = MIN(limit + max / 16, max);
+	vre->vre_copy_limit = limit;
+
+	return (limit);
+}
+
 /*
  * For testing (ztest specific)
  */
@@ -4552,6 +5132,14 @@ spa_raidz_expand_thread(void *arg, zthr_t *zthr)
 
 	uint64_t guid = raidvd->vdev_guid;
 
+	mutex_enter(&vre->vre_lock);
+	vre->vre_copy_limit = raidz_expand_max_copy_bytes;
+	vre->vre_pass_start_time = gethrestime_sec();
+	vre->vre_pass_start_copied = vre->vre_bytes_copied;
+	for (int i = 0; i < TXG_SIZE; i++)
+		vre->vre_pass_start_copied += vre->vre_bytes_copied_pertxg[i];
+	mutex_exit(&vre->vre_lock);
+
 	/* Iterate over all the remaining metaslabs */
 	for (uint64_t i = vre->vre_offset >> raidvd->vdev_ms_shift;
 	    i < raidvd->vdev_ms_count &&
@@ -4618,6 +5206,7 @@ spa_raidz_expand_thread(void *arg, zthr_t *zthr)
 		while (!zthr_iscancelled(zthr) &&
 		    !zfs_range_tree_is_empty(rt) &&
 		    vre->vre_failed_offset == UINT64_MAX) {
+			uint64_t limit = raidz_expand_copy_limit(raidvd, vre);
 
 			/*
 			 * We need to periodically drop the config lock so that
@@ -4643,8 +5232,7 @@ spa_raidz_expand_thread(void *arg, zthr_t *zthr)
 			}
 
 			mutex_enter(&vre->vre_lock);
-			while (vre->vre_outstanding_bytes >
-			    raidz_expand_max_copy_bytes) {
+			while (vre->vre_outstanding_bytes > limit) {
 				cv_wait(&vre->vre_cv, &vre->vre_lock);
 			}
 			mutex_exit(&vre->vre_lock);
@@ -4929,6 +5517,9 @@ spa_raidz_expand_get_stats(spa_t *spa, pool_raidz_expand_stat_t *pres)
 	pres->pres_reflowed = vre->vre_bytes_copied;
 	for (int i = 0; i < TXG_SIZE; i++)
 		pres->pres_reflowed += vre->vre_bytes_copied_pertxg[i];
+	pres->pres_pass_start = vre->vre_pass_start_time;
+	pres->pres_pass_reflowed = pres->pres_reflowed -
+	    MIN(vre->vre_pass_start_copied, pres->pres_reflowed);
 	mutex_exit(&vre->vre_lock);
 
 	pres->pres_start_time = vre->vre_start_time;
@@ -5147,6 +5738,14 @@ ZFS_MODULE_PARAM(zfs_vdev, raidz_, expand_max_copy_bytes, ULONG, ZMOD_RW,
 	"Max amount of concurrent i/o for RAIDZ expansion");
 ZFS_MODULE_PARAM(zfs_vdev, raidz_, io_aggregate_rows, ULONG, ZMOD_RW,
 	"For expanded RAIDZ, aggregate reads that have more rows than this");
+ZFS_MODULE_PARAM(zfs_vdev, raidz_, read_stall_ms, UINT, ZMOD_RW,
+	"Reconstruct reads of a child with an I/O outstanding this long");
+ZFS_MODULE_PARAM(zfs_vdev, raidz_, expand_max_gap_bytes, UINT, ZMOD_RW,
+	"Copy unallocated gaps up to this size during RAIDZ expansion");
+ZFS_MODULE_PARAM(zfs_vdev, raidz_, expand_adaptive, INT, ZMOD_RW,
+	"Throttle RAIDZ expansion i/o while children have foreground i/o");
+ZFS_MODULE_PARAM(zfs_vdev, raidz_, combrec_threads, UINT, ZMOD_RW,
+	"Threads used to search RAIDZ reconstruction combinations in parallel");
 ZFS_MODULE_PARAM(zfs, zfs_, scrub_after_expand, INT, ZMOD_RW,
 	"For expanded RAIDZ, automatically start a pool scrub when expansion "
 	"completes");
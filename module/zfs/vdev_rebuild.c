@@ -126,6 +126,26 @@ static uint64_t zfs_rebuild_max_segment = 1024 * 1024;
  */
 static uint64_t zfs_rebuild_vdev_limit = 64 << 20;
 
+/*
+ * Number of metaslabs of a top-level vdev which are rebuilt concurrently.
+ * A single worker leaves the vdev idle while each metaslab is loaded and
+ * while waiting for its pending allocations to sync.  On wide dRAID vdevs
+ * additional workers keep the rebuild I/O flowing across those gaps.  All
+ * workers share the zfs_rebuild_vdev_limit in-flight window.
+ */
+static uint_t zfs_rebuild_max_metaslabs = 1;
+
+/*
+ * Maximum rate in bytes per second at which rebuild I/O is issued for a
+ * top-level vdev, summed over all of its workers.  Zero means unlimited.
+ */
+static uint64_t zfs_rebuild_max_rate = 0;
+
+/*
+ * The zfs_rebuild_max_rate budget is refilled in windows of this length.
+ */
+#define	REBUILD_RATE_WINDOW	MSEC2NSEC(100)
+
 /*
  * Automatically start a pool scrub when the last active sequential resilver
  * completes in order to verify the checksums of all blocks which have been
@@ -549,15 +569,72 @@ vdev_rebuild_blkptr_init(blkptr_t *bp, vdev_t *vd, uint64_t start,
 	BP_SET_BYTEORDER(bp, ZFS_HOST_BYTEORDER);
 }
 
+/*
+ * Returns the offset below which rebuild I/O has been issued for all
+ * allocated ranges.  Metaslabs are handed out to the workers in order, so
+ * this is the lowest offset reached by any worker which is scanning one.
+ */
+static uint64_t
+vdev_rebuild_issued_offset(vdev_rebuild_t *vr)
+{
+	uint64_t offset = UINT64_MAX;
+
+	ASSERT(MUTEX_HELD(&vr->vr_io_lock));
+
+	for (uint_t i = 0; i < vr->vr_nworkers; i++) {
+		vdev_rebuild_worker_t *vrw = &vr->vr_workers[i];
+		if (vrw->vrw_msp != NULL)
+			offset = MIN(offset, vrw->vrw_offset);
+	}
+
+	ASSERT3U(offset, !=, UINT64_MAX);
+	return (offset);
+}
+
+/*
+ * Wait until the zfs_rebuild_max_rate budget of the current window allows
+ * another size bytes to be issued.  A window's first I/O is always allowed,
+ * so that rates lower than the segment size still make progress.
+ */
+static void
+vdev_rebuild_rate_wait(vdev_rebuild_t *vr, uint64_t size)
+{
+	ASSERT(MUTEX_HELD(&vr->vr_io_lock));
+
+	for (;;) {
+		uint64_t rate = zfs_rebuild_max_rate;
+		hrtime_t now = gethrtime();
+
+		if (rate == 0)
+			return;
+
+		if (now >= vr->vr_rate_start + REBUILD_RATE_WINDOW) {
+			vr->vr_rate_start = now;
+			vr->vr_rate_bytes = 0;
+		}
+
+		if (vr->vr_rate_bytes == 0 || vr->vr_rate_bytes + size <=
+		    rate * REBUILD_RATE_WINDOW / NANOSEC) {
+			vr->vr_rate_bytes += size;
+			return;
+		}
+
+		(void) cv_timedwait_hires(&vr->vr_io_cv, &vr->vr_io_lock,
+		    vr->vr_rate_start + REBUILD_RATE_WINDOW, MSEC2NSEC(1),
+		    CALLOUT_FLAG_ABSOLUTE);
+	}
+}
+
 /*
  * Issues a rebuild I/O and takes care of rate limiting the number of queued
  * rebuild I/Os.  The provided start and size must be properly aligned for the
  * top-level vdev type being rebuilt.
  */
 static int
-vdev_rebuild_range(vdev_rebuild_t *vr, uint64_t start, uint64_t size)
+vdev_rebuild_range(vdev_rebuild_worker_t *vrw, uint64_t start, uint64_t size)
 {
-	uint64_t ms_id __maybe_unused = vr->vr_scan_msp->ms_id;
+	vdev_rebuild_t *vr = vrw->vrw_vr;
+	uint64_t ms_id __maybe_unused = vrw->vrw_msp->ms_id;
 	vdev_t *vd = vr->vr_top_vdev;
 	spa_t *spa = vd->vdev_spa;
 	blkptr_t blk;
@@ -565,9 +642,6 @@ vdev_rebuild_range(vdev_rebuild_t *vr, uint64_t start, uint64_t size)
 	ASSERT3U(ms_id, ==, start >> vd->vdev_ms_shift);
 	ASSERT3U(ms_id, ==, (start + size - 1) >> vd->vdev_ms_shift);
 
-	vr->vr_pass_bytes_scanned += size;
-	vr->vr_rebuild_phys.vrp_bytes_scanned += size;
-
 	/*
 	 * Rebuild the data in this range by constructing a special block
 	 * pointer.  It has no relation to any existing blocks in the pool.
@@ -576,18 +650,25 @@ vdev_rebuild_range(vdev_rebuild_t *vr, uint64_t start, uint64_t size)
 	 */
 	vdev_rebuild_blkptr_init(&blk, vd, start, size);
 	uint64_t psize = BP_GET_PSIZE(&blk);
+	boolean_t needed = vdev_dtl_need_resilver(vd, &blk.blk_dva[0], psize,
+	    TXG_UNKNOWN);
+
+	mutex_enter(&vr->vr_io_lock);
+	vr->vr_pass_bytes_scanned += size;
+	vr->vr_rebuild_phys.vrp_bytes_scanned += size;
 
-	if (!vdev_dtl_need_resilver(vd, &blk.blk_dva[0], psize, TXG_UNKNOWN)) {
+	if (!needed) {
 		vr->vr_pass_bytes_skipped += size;
+		mutex_exit(&vr->vr_io_lock);
 		return (0);
 	}
 
-	mutex_enter(&vr->vr_io_lock);
-
 	/* Limit in flight rebuild I/Os */
 	while (vr->vr_bytes_inflight >= vr->vr_bytes_inflight_max)
 		cv_wait(&vr->vr_io_cv, &vr->vr_io_lock);
 
+	vdev_rebuild_rate_wait(vr, psize);
+
 	vr->vr_bytes_inflight += psize;
 	mutex_exit(&vr->vr_io_lock);
 
@@ -600,7 +681,10 @@ vdev_rebuild_range(vdev_rebuild_t *vr, uint64_t start, uint64_t size)
 
 	/* This is the first I/O for this txg. */
 	if (vr->vr_scan_offset[txg & TXG_MASK] == 0) {
-		vr->vr_scan_offset[txg & TXG_MASK] = start;
+		mutex_enter(&vr->vr_io_lock);
+		vr->vr_scan_offset[txg & TXG_MASK] =
+		    vdev_rebuild_issued_offset(vr);
+		mutex_exit(&vr->vr_io_lock);
 		dsl_sync_task_nowait(spa_get_dsl(spa),
 		    vdev_rebuild_update_sync,
 		    (void *)(uintptr_t)vd->vdev_id, tx);
@@ -610,18 +694,23 @@ vdev_rebuild_range(vdev_rebuild_t *vr, uint64_t start, uint64_t size)
 	if (vdev_rebuild_should_stop(vd)) {
 		mutex_enter(&vr->vr_io_lock);
 		vr->vr_bytes_inflight -= psize;
+		cv_broadcast(&vr->vr_io_cv);
 		mutex_exit(&vr->vr_io_lock);
 		spa_config_exit(vd->vdev_spa, SCL_STATE_ALL, vd);
 		mutex_exit(&vd->vdev_rebuild_lock);
 		dmu_tx_commit(tx);
 		return (SET_ERROR(EINTR));
 	}
-	mutex_exit(&vd->vdev_rebuild_lock);
-	dmu_tx_commit(tx);
 
-	vr->vr_scan_offset[txg & TXG_MASK] = start + size;
+	mutex_enter(&vr->vr_io_lock);
+	vrw->vrw_offset = start + size;
+	vr->vr_scan_offset[txg & TXG_MASK] = vdev_rebuild_issued_offset(vr);
 	vr->vr_pass_bytes_issued += size;
 	vr->vr_rebuild_phys.vrp_bytes_issued += size;
+	mutex_exit(&vr->vr_io_lock);
+
+	mutex_exit(&vd->vdev_rebuild_lock);
+	dmu_tx_commit(tx);
 
 	zio_nowait(zio_read(spa->spa_txg_zio[txg & TXG_MASK], spa, &blk,
 	    abd_alloc(psize, B_FALSE), psize, vdev_rebuild_cb, vr,
@@ -632,20 +721,21 @@ vdev_rebuild_range(vdev_rebuild_t *vr, uint64_t start, uint64_t size)
 }
 
 /*
- * Issues rebuild I/Os for all ranges in the provided vr->vr_tree range tree.
+ * Issues rebuild I/Os for all ranges in the provided vrw->vrw_scan_tree
+ * range tree.
  */
 static int
-vdev_rebuild_ranges(vdev_rebuild_t *vr)
+vdev_rebuild_ranges(vdev_rebuild_worker_t *vrw)
 {
-	vdev_t *vd = vr->vr_top_vdev;
-	zfs_btree_t *t = &vr->vr_scan_tree->rt_root;
+	vdev_t *vd = vrw->vrw_vr->vr_top_vdev;
+	zfs_btree_t *t = &vrw->vrw_scan_tree->rt_root;
 	zfs_btree_index_t idx;
 	int error;
 
 	for (zfs_range_seg_t *rs = zfs_btree_first(t, &idx); rs != NULL;
 	    rs = zfs_btree_next(t, &idx, &idx)) {
-		uint64_t start = zfs_rs_get_start(rs, vr->vr_scan_tree);
-		uint64_t size = zfs_rs_get_end(rs, vr->vr_scan_tree) - start;
+		uint64_t start = zfs_rs_get_start(rs, vrw->vrw_scan_tree);
+		uint64_t size = zfs_rs_get_end(rs, vrw->vrw_scan_tree) - start;
 
 		/*
 		 * zfs_scan_suspend_progress can be set to disable rebuild
@@ -668,7 +758,7 @@ vdev_rebuild_ranges(vdev_rebuild_t *vr)
 			chunk_size = vd->vdev_ops->vdev_op_rebuild_asize(vd,
 			    start, size, zfs_rebuild_max_segment);
 
-			error = vdev_rebuild_range(vr, start, chunk_size);
+			error = vdev_rebuild_range(vrw, start, chunk_size);
 			if (error != 0)
 				return (error);
 
@@ -754,63 +844,67 @@ vdev_rebuild_load(vdev_t *vd)
 }
 
 /*
- * Each scan thread is responsible for rebuilding a top-level vdev.  The
- * rebuild progress in tracked on-disk in VDEV_TOP_ZAP_VDEV_REBUILD_PHYS.
+ * Claim the next metaslab to be rebuilt for the worker.  Returns B_FALSE
+ * when all metaslabs have been handed out or another worker failed.
  */
-static __attribute__((noreturn)) void
-vdev_rebuild_thread(void *arg)
+static boolean_t
+vdev_rebuild_claim_ms(vdev_rebuild_worker_t *vrw)
 {
-	vdev_t *vd = arg;
-	spa_t *spa = vd->vdev_spa;
-	vdev_t *rvd = spa->spa_root_vdev;
-	int error = 0;
-
-	/*
-	 * If there's a scrub in process request that it be stopped.  This
-	 * is not required for a correct rebuild, but we do want rebuilds to
-	 * emulate the resilver behavior as much as possible.
-	 */
-	dsl_pool_t *dsl = spa_get_dsl(spa);
-	if (dsl_scan_scrubbing(dsl))
-		dsl_scan_cancel(dsl);
+	vdev_rebuild_t *vr = vrw->vrw_vr;
+	vdev_t *vd = vr->vr_top_vdev;
+	boolean_t claimed = B_FALSE;
 
-	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
-	mutex_enter(&vd->vdev_rebuild_lock);
+	mutex_enter(&vr->vr_io_lock);
+	if (vr->vr_error == 0 && vr->vr_next_ms < vd->vdev_ms_count) {
+		vrw->vrw_msp = vd->vdev_ms[vr->vr_next_ms++];
+		vrw->vrw_offset = vrw->vrw_msp->ms_start;
+		claimed = B_TRUE;
+	}
+	mutex_exit(&vr->vr_io_lock);
 
-	ASSERT3P(vd->vdev_top, ==, vd);
-	ASSERT3P(vd->vdev_rebuild_thread, !=, NULL);
-	ASSERT(vd->vdev_rebuilding);
-	ASSERT(spa_feature_is_active(spa, SPA_FEATURE_DEVICE_REBUILD));
-	ASSERT3B(vd->vdev_rebuild_cancel_wanted, ==, B_FALSE);
+	return (claimed);
+}
 
-	vdev_rebuild_t *vr = &vd->vdev_rebuild_config;
-	vdev_rebuild_phys_t *vrp = &vr->vr_rebuild_phys;
-	vr->vr_top_vdev = vd;
-	vr->vr_scan_msp = NULL;
-	vr->vr_scan_tree = zfs_range_tree_create(NULL, ZFS_RANGE_SEG64, NULL,
-	    0, 0);
-	mutex_init(&vr->vr_io_lock, NULL, MUTEX_DEFAULT, NULL);
-	cv_init(&vr->vr_io_cv, NULL, CV_DEFAULT, NULL);
+/*
+ * Release the worker's metaslab, recording the first error of the rebuild.
+ */
+static void
+vdev_rebuild_release_ms(vdev_rebuild_worker_t *vrw, int error)
+{
+	vdev_rebuild_t *vr = vrw->vrw_vr;
 
-	vr->vr_pass_start_time = gethrtime();
-	vr->vr_pass_bytes_scanned = 0;
-	vr->vr_pass_bytes_issued = 0;
-	vr->vr_pass_bytes_skipped = 0;
+	mutex_enter(&vr->vr_io_lock);
+	vrw->vrw_msp = NULL;
+	if (vr->vr_error == 0)
+		vr->vr_error = error;
+	mutex_exit(&vr->vr_io_lock);
+}
 
-	uint64_t update_est_time = gethrtime();
-	vdev_rebuild_update_bytes_est(vd, 0);
+/*
+ * Systematically walk the metaslabs and issue rebuild I/Os for all ranges
+ * in the allocated space map.  With zfs_rebuild_max_metaslabs greater than
+ * one, several of these run concurrently on different metaslabs.
+ */
+static void
+vdev_rebuild_worker(void *arg)
+{
+	vdev_rebuild_worker_t *vrw = arg;
+	vdev_rebuild_t *vr = vrw->vrw_vr;
+	vdev_rebuild_phys_t *vrp = &vr->vr_rebuild_phys;
+	vdev_t *vd = vr->vr_top_vdev;
+	spa_t *spa = vd->vdev_spa;
+	vdev_t *rvd = spa->spa_root_vdev;
+	dsl_pool_t *dsl = spa_get_dsl(spa);
+	int error = 0;
 
-	clear_rebuild_bytes(vr->vr_top_vdev);
+	vrw->vrw_scan_tree = zfs_range_tree_create(NULL, ZFS_RANGE_SEG64,
+	    NULL, 0, 0);
 
-	mutex_exit(&vd->vdev_rebuild_lock);
+	spa_config_enter(spa, SCL_CONFIG, vrw, RW_READER);
 
-	/*
-	 * Systematically walk the metaslabs and issue rebuild I/Os for
-	 * all ranges in the allocated space map.
-	 */
-	for (uint64_t i = 0; i < vd->vdev_ms_count; i++) {
-		metaslab_t *msp = vd->vdev_ms[i];
-		vr->vr_scan_msp = msp;
+	while (vdev_rebuild_claim_ms(vrw)) {
+		metaslab_t *msp = vrw->vrw_msp;
+		uint64_t i = msp->ms_id;
 
 		/*
 		 * Calculate the max number of in-flight bytes for top-level
@@ -831,14 +925,14 @@ vdev_rebuild_thread(void *arg)
 		 */
 		if (vdev_rebuild_should_cancel(vd)) {
 			vd->vdev_rebuild_cancel_wanted = B_TRUE;
-			error = EINTR;
+			vdev_rebuild_release_ms(vrw, EINTR);
 			break;
 		}
 
-		ASSERT0(zfs_range_tree_space(vr->vr_scan_tree));
+		ASSERT0(zfs_range_tree_space(vrw->vrw_scan_tree));
 
 		/* Disable any new allocations to this metaslab */
-		spa_config_exit(spa, SCL_CONFIG, FTAG);
+		spa_config_exit(spa, SCL_CONFIG, vrw);
 		metaslab_disable(msp);
 
 		mutex_enter(&msp->ms_sync_lock);
@@ -862,13 +956,13 @@ vdev_rebuild_thread(void *arg)
 
 		/*
 		 * When a metaslab has been allocated from read its allocated
-		 * ranges from the space map object into the vr_scan_tree.
+		 * ranges from the space map object into the vrw_scan_tree.
 		 * Then add inflight / unflushed ranges and remove inflight /
 		 * unflushed frees.  This is the minimum range to be rebuilt.
 		 */
 		if (msp->ms_sm != NULL) {
 			VERIFY0(space_map_load(msp->ms_sm,
-			    vr->vr_scan_tree, SM_ALLOC));
+			    vrw->vrw_scan_tree, SM_ALLOC));
 
 			for (int i = 0; i < TXG_SIZE; i++) {
 				ASSERT0(zfs_range_tree_space(
@@ -876,16 +970,16 @@ vdev_rebuild_thread(void *arg)
 			}
 
 			zfs_range_tree_walk(msp->ms_unflushed_allocs,
-			    zfs_range_tree_add, vr->vr_scan_tree);
+			    zfs_range_tree_add, vrw->vrw_scan_tree);
 			zfs_range_tree_walk(msp->ms_unflushed_frees,
-			    zfs_range_tree_remove, vr->vr_scan_tree);
+			    zfs_range_tree_remove, vrw->vrw_scan_tree);
 
 			/*
 			 * Remove ranges which have already been rebuilt based
 			 * on the last offset.  This can happen when restarting
 			 * a scan after exporting and re-importing the pool.
 			 */
-			zfs_range_tree_clear(vr->vr_scan_tree, 0,
+			zfs_range_tree_clear(vrw->vrw_scan_tree, 0,
 			    vrp->vrp_last_offset);
 		}
 
@@ -897,27 +991,109 @@ vdev_rebuild_thread(void *arg)
 		 * size every 5 minutes to account for recent allocations and
 		 * frees made to space maps which have not yet been rebuilt.
 		 */
-		if (gethrtime() > update_est_time + SEC2NSEC(300)) {
-			update_est_time = gethrtime();
-			vdev_rebuild_update_bytes_est(vd, i);
+		boolean_t update_est = B_FALSE;
+		mutex_enter(&vr->vr_io_lock);
+		if (gethrtime() > vr->vr_update_est_time + SEC2NSEC(300)) {
+			vr->vr_update_est_time = gethrtime();
+			update_est = B_TRUE;
 		}
+		mutex_exit(&vr->vr_io_lock);
+		if (update_est)
+			vdev_rebuild_update_bytes_est(vd, i);
 
 		/*
 		 * Walk the allocated space map and issue the rebuild I/O.
 		 */
-		error = vdev_rebuild_ranges(vr);
-		zfs_range_tree_vacate(vr->vr_scan_tree, NULL, NULL);
+		error = vdev_rebuild_ranges(vrw);
+		zfs_range_tree_vacate(vrw->vrw_scan_tree, NULL, NULL);
 
-		spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+		spa_config_enter(spa, SCL_CONFIG, vrw, RW_READER);
 		metaslab_enable(msp, B_FALSE, B_FALSE);
 
+		vdev_rebuild_release_ms(vrw, error);
 		if (error != 0)
 			break;
 	}
 
-	zfs_range_tree_destroy(vr->vr_scan_tree);
+	spa_config_exit(spa, SCL_CONFIG, vrw);
+	zfs_range_tree_destroy(vrw->vrw_scan_tree);
+	vrw->vrw_scan_tree = NULL;
+}
+
+/*
+ * Each scan thread is responsible for rebuilding a top-level vdev.  The
+ * rebuild progress in tracked on-disk in VDEV_TOP_ZAP_VDEV_REBUILD_PHYS.
+ */
+static __attribute__((noreturn)) void
+vdev_rebuild_thread(void *arg)
+{
+	vdev_t *vd = arg;
+	spa_t *spa = vd->vdev_spa;
+	int error = 0;
+
+	/*
+	 * If there's a scrub in process request that it be stopped.  This
+	 * is not required for a correct rebuild, but we do want rebuilds to
+	 * emulate the resilver behavior as much as possible.
+	 */
+	dsl_pool_t *dsl = spa_get_dsl(spa);
+	if (dsl_scan_scrubbing(dsl))
+		dsl_scan_cancel(dsl);
+
+	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+	mutex_enter(&vd->vdev_rebuild_lock);
+
+	ASSERT3P(vd->vdev_top, ==, vd);
+	ASSERT3P(vd->vdev_rebuild_thread, !=, NULL);
+	ASSERT(vd->vdev_rebuilding);
+	ASSERT(spa_feature_is_active(spa, SPA_FEATURE_DEVICE_REBUILD));
+	ASSERT3B(vd->vdev_rebuild_cancel_wanted, ==, B_FALSE);
+
+	vdev_rebuild_t *vr = &vd->vdev_rebuild_config;
+	vdev_rebuild_phys_t *vrp = &vr->vr_rebuild_phys;
+	vr->vr_top_vdev = vd;
+	vr->vr_nworkers = MAX(1, MIN(zfs_rebuild_max_metaslabs,
+	    vd->vdev_ms_count));
+	vr->vr_workers = kmem_zalloc(vr->vr_nworkers *
+	    sizeof (vdev_rebuild_worker_t), KM_SLEEP);
+	for (uint_t i = 0; i < vr->vr_nworkers; i++)
+		vr->vr_workers[i].vrw_vr = vr;
+	vr->vr_next_ms = 0;
+	vr->vr_error = 0;
+	vr->vr_rate_start = 0;
+	vr->vr_rate_bytes = 0;
+	mutex_init(&vr->vr_io_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&vr->vr_io_cv, NULL, CV_DEFAULT, NULL);
+
+	vr->vr_pass_start_time = gethrtime();
+	vr->vr_pass_bytes_scanned = 0;
+	vr->vr_pass_bytes_issued = 0;
+	vr->vr_pass_bytes_skipped = 0;
+
+	vr->vr_update_est_time = gethrtime();
+	vdev_rebuild_update_bytes_est(vd, 0);
+
+	clear_rebuild_bytes(vr->vr_top_vdev);
+
+	mutex_exit(&vd->vdev_rebuild_lock);
 	spa_config_exit(spa, SCL_CONFIG, FTAG);
 
+	if (vr->vr_nworkers == 1) {
+		vdev_rebuild_worker(&vr->vr_workers[0]);
+	} else {
+		taskq_t *tq = taskq_create("z_rebuild", vr->vr_nworkers,
+		    minclsyspri, vr->vr_nworkers, vr->vr_nworkers,
+		    TASKQ_PREPOPULATE);
+
+		for (uint_t i = 0; i < vr->vr_nworkers; i++) {
+			VERIFY3U(taskq_dispatch(tq, vdev_rebuild_worker,
+			    &vr->vr_workers[i], TQ_SLEEP), !=, TASKQID_INVALID);
+		}
+		taskq_wait(tq);
+		taskq_destroy(tq);
+	}
+	error = vr->vr_error;
+
 	/* Wait for any remaining rebuild I/O to complete */
 	mutex_enter(&vr->vr_io_lock);
 	while (vr->vr_bytes_inflight > 0)
@@ -928,6 +1104,11 @@ vdev_rebuild_thread(void *arg)
 	mutex_destroy(&vr->vr_io_lock);
 	cv_destroy(&vr->vr_io_cv);
 
+	kmem_free(vr->vr_workers, vr->vr_nworkers *
+	    sizeof (vdev_rebuild_worker_t));
+	vr->vr_workers = NULL;
+	vr->vr_nworkers = 0;
+
 	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
 
 	dsl_pool_t *dp = spa_get_dsl(spa);
@@ -1178,5 +1359,11 @@ ZFS_MODULE_PARAM(zfs, zfs_, rebuild_max_segment, U64, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs, zfs_, rebuild_vdev_limit, U64, ZMOD_RW,
 	"Max bytes in flight per leaf vdev for sequential resilvers");
 
+ZFS_MODULE_PARAM(zfs, zfs_, rebuild_max_metaslabs, UINT, ZMOD_RW,
+	"Number of metaslabs rebuilt concurrently per top-level vdev");
+
+ZFS_MODULE_PARAM(zfs, zfs_, rebuild_max_rate, U64, ZMOD_RW,
+	"Max bytes per second of rebuild I/O per top-level vdev");
+
 ZFS_MODULE_PARAM(zfs, zfs_, rebuild_scrub_enabled, INT, ZMOD_RW,
 	"Automatically scrub after sequential resilver completes");
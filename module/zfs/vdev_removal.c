@@ -84,6 +84,7 @@
 typedef struct vdev_copy_arg {
 	metaslab_t	*vca_msp;
 	uint64_t	vca_outstanding_bytes;
+	uint64_t	vca_issued_bytes;
 	uint64_t	vca_read_error_bytes;
 	uint64_t	vca_write_error_bytes;
 	kcondvar_t	vca_cv;
@@ -95,7 +96,14 @@ typedef struct vdev_copy_arg {
  * doing a device removal.  This determines how much i/o we can have
  * in flight concurrently.
  */
-static const uint_t zfs_remove_max_copy_bytes = 64 * 1024 * 1024;
+static uint_t zfs_remove_max_copy_bytes = 64 * 1024 * 1024;
+
+/*
+ * Limit the removal copy to this many bytes of i/o per second, so that a
+ * removal can be run alongside a production workload and finish in a
+ * predictable time.  Zero means no limit.
+ */
+static uint64_t zfs_removal_max_rate = 0;
 
 /*
  * The largest contiguous segment that we will attempt to allocate when
@@ -1068,6 +1076,7 @@ spa_vdev_copy_one_child(vdev_copy_arg_t *vca, zio_t *nzio,
 
 	mutex_enter(&vca->vca_lock);
 	vca->vca_outstanding_bytes += size;
+	vca->vca_issued_bytes += size;
 	mutex_exit(&vca->vca_lock);
 
 	abd_t *abd = abd_alloc_for_io(size, B_FALSE);
@@ -1554,6 +1563,34 @@ spa_vdev_copy_impl(vdev_t *vd, spa_vdev_removal_t *svr, vdev_copy_arg_t *vca,
 	zfs_range_tree_destroy(segs);
 }
 
+/*
+ * Wait while more than zfs_removal_max_rate bytes have been issued in the
+ * current one second window.
+ */
+static void
+spa_vdev_copy_throttle(spa_vdev_removal_t *svr, vdev_copy_arg_t *vca,
+    hrtime_t *window_start, uint64_t *window_base)
+{
+	for (;;) {
+		uint64_t rate = zfs_removal_max_rate;
+		hrtime_t now = gethrtime();
+
+		mutex_enter(&vca->vca_lock);
+		uint64_t issued = vca->vca_issued_bytes;
+		mutex_exit(&vca->vca_lock);
+
+		if (now - *window_start >= NANOSEC) {
+			*window_start = now;
+			*window_base = issued;
+		}
+		if (rate == 0 || issued - *window_base < rate ||
+		    svr->svr_thread_exit)
+			return;
+
+		delay(MAX(1, NSEC_TO_TICK(*window_start + NANOSEC - now)));
+	}
+}
+
 /*
  * The size of each removal mapping is limited by the tunable
  * zfs_remove_max_segment, but we must adjust this to be a multiple of the
@@ -1592,6 +1629,8 @@ spa_vdev_remove_thread(void *arg)
 	vdev_copy_arg_t vca;
 	uint64_t max_alloc = spa_remove_max_segment(spa);
 	uint64_t last_txg = 0;
+	hrtime_t window_start = gethrtime();
+	uint64_t window_base = 0;
 
 	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
 	vdev_t *vd = vdev_lookup_top(spa, svr->svr_vdev_id);
@@ -1607,6 +1646,7 @@ spa_vdev_remove_thread(void *arg)
 	mutex_init(&vca.vca_lock, NULL, MUTEX_DEFAULT, NULL);
 	cv_init(&vca.vca_cv, NULL, CV_DEFAULT, NULL);
 	vca.vca_outstanding_bytes = 0;
+	vca.vca_issued_bytes = 0;
 	vca.vca_read_error_bytes = 0;
 	vca.vca_write_error_bytes = 0;
 
@@ -1721,6 +1761,9 @@ again:
 			}
 			mutex_exit(&vca.vca_lock);
 
+			spa_vdev_copy_throttle(svr, &vca, &window_start,
+			    &window_base);
+
 			dmu_tx_t *tx =
 			    dmu_tx_create_dd(spa_get_dsl(spa)->dp_mos_dir);
 
@@ -2553,6 +2596,12 @@ spa_removal_get_stats(spa_t *spa, pool_removal_stat_t *prs)
 ZFS_MODULE_PARAM(zfs_vdev, zfs_, removal_ignore_errors, INT, ZMOD_RW,
 	"Ignore hard IO errors when removing device");
 
+ZFS_MODULE_PARAM(zfs_vdev, zfs_, remove_max_copy_bytes, UINT, ZMOD_RW,
+	"Largest amount of removal copy i/o in flight at once");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_, removal_max_rate, U64, ZMOD_RW,
+	"Largest number of bytes per second copied by a device removal");
+
 ZFS_MODULE_PARAM(zfs_vdev, zfs_, remove_max_segment, UINT, ZMOD_RW,
 	"Largest contiguous segment to allocate when removing device");
 
@@ -105,6 +105,14 @@ static unsigned int zfs_trim_extent_bytes_max = 128 * 1024 * 1024;
  */
 static unsigned int zfs_trim_extent_bytes_min = 32 * 1024;
 
+/*
+ * Shrink TRIM extents to the discard granularity reported by the device,
+ * and split them at its maximum discard size.  Devices ignore, or have to
+ * zero, the parts of a discard that do not cover a whole granule, so those
+ * bytes are counted as skipped instead of being sent.
+ */
+static int zfs_trim_device_align = 0;
+
 /*
  * Skip uninitialized metaslabs during the TRIM process.  This option is
  * useful for pools constructed from large thinly-provisioned devices where
@@ -596,17 +604,53 @@ vdev_trim_ranges(trim_args_t *ta)
 	zfs_btree_index_t idx;
 	uint64_t extent_bytes_max = ta->trim_extent_bytes_max;
 	uint64_t extent_bytes_min = ta->trim_extent_bytes_min;
+	uint64_t granularity = 0;
 	spa_t *spa = vd->vdev_spa;
 	int error = 0;
 
 	ta->trim_start_time = gethrtime();
 	ta->trim_bytes_done = 0;
 
+	if (zfs_trim_device_align && !(ta->trim_flags & ZIO_TRIM_SECURE)) {
+		if (ISP2(vd->vdev_trim_granularity) &&
+		    vd->vdev_trim_granularity > (1ULL << vd->vdev_ashift))
+			granularity = vd->vdev_trim_granularity;
+		uint64_t devmax = vd->vdev_trim_max_bytes;
+		if (granularity != 0)
+			devmax = P2ALIGN_TYPED(devmax, granularity, uint64_t);
+		else
+			devmax = P2ALIGN_TYPED(devmax,
+			    1ULL << vd->vdev_ashift, uint64_t);
+		if (devmax != 0 && devmax < extent_bytes_max)
+			extent_bytes_max = devmax;
+	}
+
 	for (zfs_range_seg_t *rs = zfs_btree_first(t, &idx); rs != NULL;
 	    rs = zfs_btree_next(t, &idx, &idx)) {
+		uint64_t start = VDEV_LABEL_START_SIZE +
+		    zfs_rs_get_start(rs, ta->trim_tree);
 		uint64_t size = zfs_rs_get_end(rs, ta->trim_tree) -
 		    zfs_rs_get_start(rs, ta->trim_tree);
 
+		if (granularity != 0) {
+			uint64_t astart = P2ROUNDUP(start, granularity);
+			uint64_t aend = P2ALIGN_TYPED(start + size,
+			    granularity, uint64_t);
+			uint64_t asize = aend > astart ? aend - astart : 0;
+
+			if (asize == 0) {
+				spa_iostats_trim_add(spa, ta->trim_type,
+				    0, 0, 1, size, 0, 0);
+				continue;
+			}
+			if (asize < size) {
+				spa_iostats_trim_add(spa, ta->trim_type,
+				    0, 0, 0, size - asize, 0, 0);
+			}
+			start = astart;
+			size = asize;
+		}
+
 		if (extent_bytes_min && size < extent_bytes_min) {
 			spa_iostats_trim_add(spa, ta->trim_type,
 			    0, 0, 1, size, 0, 0);
@@ -617,9 +661,8 @@ vdev_trim_ranges(trim_args_t *ta)
 		uint64_t writes_required = ((size - 1) / extent_bytes_max) + 1;
 
 		for (uint64_t w = 0; w < writes_required; w++) {
-			error = vdev_trim_range(ta, VDEV_LABEL_START_SIZE +
-			    zfs_rs_get_start(rs, ta->trim_tree) +
-			    (w *extent_bytes_max), MIN(size -
+			error = vdev_trim_range(ta, start +
+			    (w * extent_bytes_max), MIN(size -
 			    (w * extent_bytes_max), extent_bytes_max));
 			if (error != 0) {
 				goto done;
@@ -1782,6 +1825,9 @@ ZFS_MODULE_PARAM(zfs_trim, zfs_trim_, extent_bytes_max, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_trim, zfs_trim_, extent_bytes_min, UINT, ZMOD_RW,
 	"Min size of TRIM commands, smaller will be skipped");
 
+ZFS_MODULE_PARAM(zfs_trim, zfs_trim_, device_align, INT, ZMOD_RW,
+	"Align TRIM commands to the device discard granularity");
+
 ZFS_MODULE_PARAM(zfs_trim, zfs_trim_, metaslab_skip, UINT, ZMOD_RW,
 	"Skip metaslabs which have never been initialized");
 
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/wmsum_kstat.h>
+
+/*
+ * Per-CPU statistics for hot paths.  A subsystem describes its statistics
+ * as a struct of kstat_named_t, as usual, with the counters updated on hot
+ * paths first.  wmsum_kstat_init() creates a wmsum_t for each of those and
+ * installs the kstat, whose update callback sums them on read.  Updating
+ * a counter is then a single per-CPU add with no shared cache line, and
+ * the subsystem does not need its own parallel struct of wmsum_t, update
+ * callback, or init and fini boilerplate.
+ */
+
+static int
+wmsum_kstat_update(kstat_t *ksp, int rw)
+{
+	wmsum_kstat_t *wk = ksp->ks_private;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	for (uint_t i = 0; i < wk->wk_nsums; i++)
+		wk->wk_named[i].value.ui64 = wmsum_value(&wk->wk_sums[i]);
+
+	if (wk->wk_update != NULL)
+		wk->wk_update(wk->wk_named);
+
+	return (0);
+}
+
+/*
+ * Create the counters for the first nsums of the ndata values in named,
+ * and install them as the module:0:name kstat of the given class.  The
+ * counters are usable even if the kstat could not be created.
+ */
+void
+wmsum_kstat_init(wmsum_kstat_t *wk, const char *module, const char *name,
+    const char *class, kstat_named_t *named, uint_t ndata, uint_t nsums,
+    void (*update)(kstat_named_t *))
+{
+	ASSERT3U(nsums, <=, ndata);
+
+	wk->wk_named = named;
+	wk->wk_nsums = nsums;
+	wk->wk_update = update;
+	wk->wk_sums = kmem_alloc(nsums * sizeof (wmsum_t), KM_SLEEP);
+	for (uint_t i = 0; i < nsums; i++)
+		wmsum_init(&wk->wk_sums[i], 0);
+
+	wk->wk_ksp = kstat_create(module, 0, name, class, KSTAT_TYPE_NAMED,
+	    ndata, KSTAT_FLAG_VIRTUAL);
+	if (wk->wk_ksp != NULL) {
+		wk->wk_ksp->ks_data = named;
+		wk->wk_ksp->ks_private = wk;
+		wk->wk_ksp->ks_update = wmsum_kstat_update;
+		kstat_install(wk->wk_ksp);
+	}
+}
+
+void
+wmsum_kstat_fini(wmsum_kstat_t *wk)
+{
+	if (wk->wk_ksp != NULL) {
+		kstat_delete(wk->wk_ksp);
+		wk->wk_ksp = NULL;
+	}
+
+	for (uint_t i = 0; i < wk->wk_nsums; i++)
+		wmsum_fini(&wk->wk_sums[i]);
+	kmem_free(wk->wk_sums, wk->wk_nsums * sizeof (wmsum_t));
+	wk->wk_sums = NULL;
+	wk->wk_nsums = 0;
+}
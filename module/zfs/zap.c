@@ -82,6 +82,15 @@
  */
 static int zap_iterate_prefetch = B_TRUE;
 
+/*
+ * The whole-object prefetch above only helps when iteration starts at the
+ * beginning and the object fits in dmu_prefetch_max; zfs_readdir() resumes
+ * the cursor on every getdents() call.  So in addition, as the cursor moves
+ * into new leaves, keep this many of the leaves that follow it (in hash
+ * order) prefetched.
+ */
+static uint_t zap_iterate_prefetch_leaves = 32;
+
 /*
  * Enable ZAP shrinking. When enabled, empty sibling leaf blocks will be
  * collapsed into a single block.
@@ -1081,6 +1090,52 @@ fzap_prefetch(zap_name_t *zn)
 	    ZIO_PRIORITY_SYNC_READ);
 }
 
+/*
+ * Prefetch the next zap_iterate_prefetch_leaves leaf blocks in hash order
+ * after the cursor position.  More are issued once the cursor gets halfway
+ * through the previous batch.
+ */
+static void
+fzap_cursor_prefetch(zap_t *zap, zap_cursor_t *zc)
+{
+	uint_t nleaves = zap_iterate_prefetch_leaves;
+	int shift = zap_f_phys(zap)->zap_ptrtbl.zt_shift;
+	int bs = FZAP_BLOCK_SHIFT(zap);
+	uint64_t idx, lastblk, blk, maxidx, iters;
+	uint_t found = 0;
+
+	if (!zap_iterate_prefetch || !zc->zc_prefetch || nleaves == 0 ||
+	    zc->zc_hash < zc->zc_prefetch_next || shift == 0)
+		return;
+
+	maxidx = 1ULL << shift;
+	idx = ZAP_HASH_IDX(MAX(zc->zc_hash, zc->zc_prefetch_end), shift);
+	if (zap_idx_to_blk(zap, ZAP_HASH_IDX(zc->zc_hash, shift),
+	    &lastblk) != 0)
+		return;
+
+	/*
+	 * Several pointer table entries can reference the same leaf.  Bound
+	 * the walk, in case the leaves are much bigger than the table slots.
+	 */
+	for (iters = 0; idx < maxidx && found < nleaves &&
+	    iters < 16ULL * nleaves; idx++, iters++) {
+		if (zap_idx_to_blk(zap, idx, &blk) != 0)
+			break;
+		if (blk == lastblk)
+			continue;
+		lastblk = blk;
+		dmu_prefetch_by_dnode(zap->zap_dnode, 0, blk << bs, 1ULL << bs,
+		    ZIO_PRIORITY_ASYNC_READ);
+		if (++found == nleaves / 2)
+			zc->zc_prefetch_next = idx << (64 - shift);
+	}
+
+	zc->zc_prefetch_end = (idx == maxidx) ? -1ULL : idx << (64 - shift);
+	if (found < nleaves / 2 || nleaves == 1)
+		zc->zc_prefetch_next = zc->zc_prefetch_end;
+}
+
 /*
  * Helper functions for consumers.
  */
@@ -1343,6 +1398,7 @@ fzap_cursor_retrieve(zap_t *zap, zap_cursor_t *zc, zap_attribute_t *za)
 
 again:
 	if (zc->zc_leaf == NULL) {
+		fzap_cursor_prefetch(zap, zc);
 		err = zap_deref_leaf(zap, zc->zc_hash, NULL, RW_READER,
 		    &zc->zc_leaf);
 		if (err != 0)
@@ -1710,5 +1766,8 @@ zap_shrink(zap_name_t *zn, zap_leaf_t *l, dmu_tx_t *tx)
 ZFS_MODULE_PARAM(zfs, , zap_iterate_prefetch, INT, ZMOD_RW,
 	"When iterating ZAP object, prefetch it");
 
+ZFS_MODULE_PARAM(zfs, , zap_iterate_prefetch_leaves, UINT, ZMOD_RW,
+	"Number of leaf blocks to read ahead of a ZAP cursor");
+
 ZFS_MODULE_PARAM(zfs, , zap_shrink_enabled, INT, ZMOD_RW,
 	"Enable ZAP shrinking");
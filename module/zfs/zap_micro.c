@@ -1192,7 +1192,9 @@ zap_prefetch(objset_t *os, uint64_t zapobj, const char *name)
 		return (SET_ERROR(ENOTSUP));
 	}
 
-	fzap_prefetch(zn);
+	/* A microzap is a single block, already read by zap_lockdir(). */
+	if (!zap->zap_ismicro)
+		fzap_prefetch(zn);
 	zap_name_free(zn);
 	zap_unlockdir(zap, FTAG);
 	return (err);
@@ -1825,6 +1827,8 @@ zap_cursor_init_impl(zap_cursor_t *zc, objset_t *os, uint64_t zapobj,
 	zc->zc_hash = 0;
 	zc->zc_cd = 0;
 	zc->zc_prefetch = prefetch;
+	zc->zc_prefetch_next = 0;
+	zc->zc_prefetch_end = 0;
 }
 void
 zap_cursor_init_serialized(zap_cursor_t *zc, objset_t *os, uint64_t zapobj,
@@ -40,6 +40,14 @@
  * single operation.  When expressed as a single ZCP script, all these changes
  * can be performed at once in one txg sync.
  *
+ * Batches too large for one txg can be split by calling zfs.yield() from the
+ * script. This suspends the script at the end of the current txg sync, gives
+ * the sync thread back to the rest of the pool, and resumes the script in a
+ * later txg with a fresh instruction budget. Atomicity then only holds
+ * between two calls to zfs.yield(). Between txgs, the datasets passed to
+ * zfs.yield() are read in from open context, so that the next part of the
+ * batch does not wait on those reads in syncing context.
+ *
  * A modified version of the Lua 5.2 interpreter is used to run channel program
  * scripts. The Lua 5.2 manual can be found at:
  *
@@ -48,11 +56,11 @@
  * If being run by a user (via an ioctl syscall), executing a ZCP script
  * requires root privileges in the global zone.
  *
- * Scripts are passed to zcp_eval() as a string, then run in a synctask by
- * zcp_eval_sync().  Arguments can be passed into the Lua script as an nvlist,
- * which will be converted to a Lua table.  Similarly, values returned from
- * a ZCP script will be converted to an nvlist.  See zcp_lua_to_nvlist_impl()
- * for details on exact allowed types and conversion.
+ * Scripts are passed to zcp_eval() as a string, then run as a Lua thread in
+ * a synctask by zcp_eval_sync().  Arguments can be passed into the Lua script
+ * as an nvlist, which will be converted to a Lua table.  Similarly, values
+ * returned from a ZCP script will be converted to an nvlist.  See
+ * zcp_lua_to_nvlist_impl() for details on exact allowed types and conversion.
  *
  * ZFS functionality is exposed to a ZCP script as a library of function calls.
  * These calls are sorted into submodules, such as zfs.list and zfs.sync, for
@@ -97,6 +105,7 @@
 #include <sys/dsl_prop.h>
 #include <sys/dsl_synctask.h>
 #include <sys/dsl_dataset.h>
+#include <sys/sha2.h>
 #include <sys/zcp.h>
 #include <sys/zcp_iter.h>
 #include <sys/zcp_prop.h>
@@ -113,6 +122,28 @@ static const uint64_t zfs_lua_check_instrlimit_interval = 100;
 uint64_t zfs_lua_max_instrlimit = ZCP_MAX_INSTRLIMIT;
 uint64_t zfs_lua_max_memlimit = ZCP_MAX_MEMLIMIT;
 
+/*
+ * Channel programs are often run many times with the same source, so the
+ * bytecode they compile to is cached, keyed by the SHA-256 of the source,
+ * and later runs load it instead of parsing the program again.  The cache
+ * holds at most zfs_lua_cache_size bytes of bytecode and evicts the least
+ * recently used programs first; 0 disables it.  It is shared by all pools,
+ * as the bytecode does not depend on the pool the program runs in.
+ */
+typedef struct zcp_cache_entry {
+	avl_node_t	zce_avl;
+	list_node_t	zce_lru;
+	zio_cksum_t	zce_hash;	/* SHA-256 of the source */
+	char		*zce_code;	/* output of lua_dump() */
+	size_t		zce_size;
+} zcp_cache_entry_t;
+
+static kmutex_t zcp_cache_lock;
+static avl_tree_t zcp_cache_tree;
+static list_t zcp_cache_lru;		/* most recently used first */
+static uint64_t zcp_cache_used;
+static uint64_t zfs_lua_cache_size = 1024 * 1024;
+
 /*
  * Forward declarations for mutually recursive functions
  */
@@ -121,27 +152,25 @@ static int zcp_lua_to_nvlist_impl(lua_State *, int, nvlist_t *, const char *,
     int);
 
 /*
- * The outer-most error callback handler for use with lua_pcall(). On
- * error Lua will call this callback with a single argument that
- * represents the error value. In most cases this will be a string
- * containing an error message, but channel programs can use Lua's
- * error() function to return arbitrary objects as errors. This callback
- * returns (on the Lua stack) the original error object along with a traceback.
+ * Called when the script thread died with an error. The thread is left
+ * with the error value on top of its stack, which in most cases will be
+ * a string containing an error message, but channel programs can use
+ * Lua's error() function to return arbitrary objects as errors. This
+ * pushes the error message along with a traceback of the thread onto
+ * the main stack.
  *
  * Fatal Lua errors can occur while resources are held, so we also call any
  * registered cleanup function here.
  */
-static int
-zcp_error_handler(lua_State *state)
+static void
+zcp_error_handler(lua_State *state, lua_State *thread)
 {
 	const char *msg;
 
 	zcp_cleanup(state);
 
-	VERIFY3U(1, ==, lua_gettop(state));
-	msg = lua_tostring(state, 1);
-	luaL_traceback(state, state, msg, 1);
-	return (1);
+	msg = lua_tostring(thread, -1);
+	luaL_traceback(state, thread, msg, 0);
 }
 
 int
@@ -705,6 +734,55 @@ zcp_exists(lua_State *state)
 	return (1);
 }
 
+static int zcp_yield(lua_State *);
+static const zcp_lib_info_t zcp_yield_info = {
+	.name = "yield",
+	.func = zcp_yield,
+	.pargs = {
+	    {NULL, 0}
+	},
+	.kwargs = {
+	    { .za_name = "prefetch", .za_lua_type = LUA_TTABLE },
+	    {NULL, 0}
+	}
+};
+
+static int
+zcp_yield(lua_State *state)
+{
+	zcp_run_info_t *ri = zcp_run_info(state);
+	const zcp_lib_info_t *libinfo = &zcp_yield_info;
+
+	zcp_parse_args(state, libinfo->name, libinfo->pargs, libinfo->kwargs);
+
+	/*
+	 * In open context there is no txg to end, so there is nothing to do.
+	 */
+	if (!ri->zri_sync)
+		return (0);
+
+	if (state != ri->zri_thread) {
+		return (luaL_error(state,
+		    "zfs.yield() cannot be called from a coroutine"));
+	}
+
+	if (!lua_isnil(state, 1)) {
+		lua_pushnil(state);
+		while (lua_next(state, 1) != 0) {
+			if (lua_type(state, -1) != LUA_TSTRING) {
+				return (luaL_error(state, "prefetch list "
+				    "must contain dataset names"));
+			}
+			fnvlist_add_boolean(ri->zri_prefetch,
+			    lua_tostring(state, -1));
+			lua_pop(state, 1);
+		}
+	}
+
+	ri->zri_yielded = B_TRUE;
+	return (lua_yield(state, 0));
+}
+
 /*
  * Allocate/realloc/free a buffer for the lua interpreter.
  *
@@ -815,12 +893,16 @@ zcp_eval_impl(dmu_tx_t *tx, zcp_run_info_t *ri)
 {
 	int err;
 	lua_State *state = ri->zri_state;
+	lua_State *thread = ri->zri_thread;
 
-	VERIFY3U(3, ==, lua_gettop(state));
+	VERIFY3U(1, ==, lua_gettop(state));
 
 	/* finish initializing our runtime state */
 	ri->zri_pool = dmu_tx_pool(tx);
 	ri->zri_tx = tx;
+	ri->zri_curinstrs = 0;
+	ri->zri_space_used = 0;
+	ri->zri_yielded = B_FALSE;
 	list_create(&ri->zri_cleanup_handlers, sizeof (zcp_cleanup_handler_t),
 	    offsetof(zcp_cleanup_handler_t, zch_node));
 
@@ -831,14 +913,14 @@ zcp_eval_impl(dmu_tx_t *tx, zcp_run_info_t *ri)
 	 */
 	lua_pushlightuserdata(state, ri);
 	lua_setfield(state, LUA_REGISTRYINDEX, ZCP_RUN_INFO_KEY);
-	VERIFY3U(3, ==, lua_gettop(state));
+	VERIFY3U(1, ==, lua_gettop(state));
 
 	/*
 	 * Tell the Lua interpreter to call our handler every count
 	 * instructions. Channel programs that execute too many instructions
 	 * should die with ETIME.
 	 */
-	(void) lua_sethook(state, zcp_lua_counthook, LUA_MASKCOUNT,
+	(void) lua_sethook(thread, zcp_lua_counthook, LUA_MASKCOUNT,
 	    zfs_lua_check_instrlimit_interval);
 
 	/*
@@ -849,24 +931,54 @@ zcp_eval_impl(dmu_tx_t *tx, zcp_run_info_t *ri)
 	ri->zri_allocargs->aa_must_succeed = B_FALSE;
 
 	/*
-	 * Call the Lua function that open-context passed us. This pops the
-	 * function and its input from the stack and pushes any return
-	 * or error values.
+	 * Start the Lua function that open-context passed us, or resume it
+	 * from the zfs.yield() call it made in a previous txg. When it
+	 * returns, this pops the function and its input from the stack of
+	 * the thread and pushes any return or error values.
 	 */
-	err = lua_pcall(state, 1, LUA_MULTRET, 1);
+	err = lua_resume(thread, state,
+	    (lua_status(thread) == LUA_YIELD) ? 0 : 1);
 
 	/*
 	 * Let Lua use KM_SLEEP while we interpret the return values.
 	 */
 	ri->zri_allocargs->aa_must_succeed = B_TRUE;
 
+	if (err == LUA_YIELD) {
+		if (ri->zri_yielded) {
+			/*
+			 * Leave the thread on the stack, to be resumed by
+			 * the next txg.
+			 */
+			list_destroy(&ri->zri_cleanup_handlers);
+			return;
+		}
+
+		/*
+		 * The script called coroutine.yield() from its main function
+		 * rather than from a coroutine of its own. Fail it the way
+		 * Lua does when not running in a coroutine.
+		 */
+		lua_settop(thread, 0);
+		(void) lua_pushstring(thread,
+		    "attempt to yield from outside a coroutine");
+		err = LUA_ERRRUN;
+	}
+
 	/*
-	 * Remove the error handler callback from the stack. At this point,
-	 * there shouldn't be any cleanup handler registered in the handler
-	 * list (zri_cleanup_handlers), regardless of whether it ran or not.
+	 * Move the return values or the error message and its traceback to
+	 * the main stack, then drop the thread. At this point, there
+	 * shouldn't be any cleanup handler registered in the handler list
+	 * (zri_cleanup_handlers), regardless of whether it ran or not.
 	 */
+	if (err == LUA_OK) {
+		lua_xmove(thread, state, lua_gettop(thread));
+	} else {
+		zcp_error_handler(state, thread);
+	}
 	list_destroy(&ri->zri_cleanup_handlers);
 	lua_remove(state, 1);
+	ri->zri_thread = NULL;
 
 	switch (err) {
 	case LUA_OK: {
@@ -928,9 +1040,8 @@ zcp_eval_impl(dmu_tx_t *tx, zcp_run_info_t *ri)
 	case LUA_ERRERR: {
 		/*
 		 * The channel program encountered a fatal error within the
-		 * script, and we encountered another error while trying to
-		 * compute the traceback in zcp_error_handler(). We can only
-		 * return the error message.
+		 * script, and Lua encountered another error while handling
+		 * it. We can only return the error message.
 		 */
 		VERIFY3U(1, ==, lua_gettop(state));
 		if (ri->zri_timed_out) {
@@ -950,6 +1061,7 @@ zcp_eval_impl(dmu_tx_t *tx, zcp_run_info_t *ri)
 		 * Lua ran out of memory while running the channel program.
 		 * There's not much we can do.
 		 */
+		lua_settop(state, 0);
 		ri->zri_result = SET_ERROR(ENOSPC);
 		break;
 	default:
@@ -990,11 +1102,13 @@ zcp_eval_sync(void *arg, dmu_tx_t *tx)
 
 	/*
 	 * Open context should have setup the stack to contain:
-	 * 1: Error handler callback
-	 * 2: Script to run (converted to a Lua function)
-	 * 3: nvlist input to function (converted to Lua table or nil)
+	 * 1: Lua thread to run the script in
+	 *
+	 * And the stack of the thread, unless it is resumed from a yield:
+	 * 1: Script to run (converted to a Lua function)
+	 * 2: nvlist input to function (converted to Lua table or nil)
 	 */
-	VERIFY3U(3, ==, lua_gettop(ri->zri_state));
+	VERIFY3U(1, ==, lua_gettop(ri->zri_state));
 
 	zcp_eval_impl(tx, ri);
 }
@@ -1009,7 +1123,7 @@ zcp_eval_open(zcp_run_info_t *ri, const char *poolname)
 	/*
 	 * See comment from the same assertion in zcp_eval_sync().
 	 */
-	VERIFY3U(3, ==, lua_gettop(ri->zri_state));
+	VERIFY3U(1, ==, lua_gettop(ri->zri_state));
 
 	error = dsl_pool_hold(poolname, FTAG, &dp);
 	if (error != 0) {
@@ -1035,6 +1149,228 @@ zcp_eval_open(zcp_run_info_t *ri, const char *poolname)
 	dsl_pool_rele(dp, FTAG);
 }
 
+/*
+ * Called in open context between two txgs of a channel program which
+ * yielded, to read in the datasets it passed to zfs.yield(). Holding them
+ * reads their headers, and destroying a snapshot also walks its deadlist
+ * and the one of the next snapshot, so those are prefetched too.
+ */
+static void
+zcp_prefetch(zcp_run_info_t *ri, const char *poolname)
+{
+	dsl_pool_t *dp;
+	dsl_dataset_t *ds, *next;
+
+	if (nvlist_empty(ri->zri_prefetch))
+		return;
+
+	if (dsl_pool_hold(poolname, FTAG, &dp) == 0) {
+		objset_t *mos = dp->dp_meta_objset;
+
+		for (nvpair_t *pair = nvlist_next_nvpair(ri->zri_prefetch,
+		    NULL); pair != NULL && !issig();
+		    pair = nvlist_next_nvpair(ri->zri_prefetch, pair)) {
+			if (dsl_dataset_hold(dp, nvpair_name(pair), FTAG,
+			    &ds) != 0)
+				continue;
+			dmu_prefetch(mos, dsl_dataset_phys(ds)->ds_deadlist_obj,
+			    0, 0, dmu_prefetch_max, ZIO_PRIORITY_ASYNC_READ);
+			if (ds->ds_is_snapshot && dsl_dataset_hold_obj(dp,
+			    dsl_dataset_phys(ds)->ds_next_snap_obj, FTAG,
+			    &next) == 0) {
+				dmu_prefetch(mos,
+				    dsl_dataset_phys(next)->ds_deadlist_obj,
+				    0, 0, dmu_prefetch_max,
+				    ZIO_PRIORITY_ASYNC_READ);
+				dsl_dataset_rele(next, FTAG);
+			}
+			dsl_dataset_rele(ds, FTAG);
+		}
+		dsl_pool_rele(dp, FTAG);
+	}
+
+	fnvlist_free(ri->zri_prefetch);
+	ri->zri_prefetch = fnvlist_alloc();
+}
+
+/*
+ * Decide, in open context, whether a channel program which ran in syncing
+ * context should be resumed in another txg.
+ */
+static boolean_t
+zcp_eval_resume(zcp_run_info_t *ri, const char *poolname)
+{
+	if (!ri->zri_yielded)
+		return (B_FALSE);
+
+	if (ri->zri_canceled || issig()) {
+		ri->zri_canceled = B_TRUE;
+		ri->zri_result = SET_ERROR(EINTR);
+		lua_settop(ri->zri_state, 0);
+		(void) lua_pushstring(ri->zri_state,
+		    "Channel program was canceled.");
+		zcp_convert_return_values(ri->zri_state, ri->zri_outnvl,
+		    ZCP_RET_ERROR, &ri->zri_result);
+		return (B_FALSE);
+	}
+
+	zcp_prefetch(ri, poolname);
+	return (B_TRUE);
+}
+
+static int
+zcp_cache_compare(const void *x1, const void *x2)
+{
+	const zcp_cache_entry_t *zce1 = x1;
+	const zcp_cache_entry_t *zce2 = x2;
+
+	int cmp = memcmp(&zce1->zce_hash, &zce2->zce_hash,
+	    sizeof (zio_cksum_t));
+	return (TREE_ISIGN(cmp));
+}
+
+static void
+zcp_cache_remove(zcp_cache_entry_t *zce)
+{
+	ASSERT(MUTEX_HELD(&zcp_cache_lock));
+
+	avl_remove(&zcp_cache_tree, zce);
+	list_remove(&zcp_cache_lru, zce);
+	zcp_cache_used -= zce->zce_size;
+	kmem_free(zce->zce_code, zce->zce_size);
+	kmem_free(zce, sizeof (*zce));
+}
+
+static void
+zcp_cache_evict(uint64_t limit)
+{
+	zcp_cache_entry_t *zce;
+
+	ASSERT(MUTEX_HELD(&zcp_cache_lock));
+
+	while (zcp_cache_used > limit &&
+	    (zce = list_tail(&zcp_cache_lru)) != NULL)
+		zcp_cache_remove(zce);
+}
+
+static void
+zcp_cache_hash(const char *program, zio_cksum_t *hash)
+{
+	SHA2_CTX ctx;
+
+	SHA2Init(SHA256, &ctx);
+	SHA2Update(&ctx, program, strlen(program));
+	SHA2Final(hash, &ctx);
+}
+
+/*
+ * Return a copy of the cached bytecode of the program, or NULL.  The
+ * caller loads it and frees it; the entry itself may be evicted at any
+ * time once the lock is dropped.
+ */
+static char *
+zcp_cache_lookup(const zio_cksum_t *hash, size_t *sizep)
+{
+	zcp_cache_entry_t search, *zce;
+	char *code = NULL;
+
+	search.zce_hash = *hash;
+
+	mutex_enter(&zcp_cache_lock);
+	zcp_cache_evict(zfs_lua_cache_size);
+	zce = avl_find(&zcp_cache_tree, &search, NULL);
+	if (zce != NULL) {
+		list_remove(&zcp_cache_lru, zce);
+		list_insert_head(&zcp_cache_lru, zce);
+		code = kmem_alloc(zce->zce_size, KM_SLEEP);
+		memcpy(code, zce->zce_code, zce->zce_size);
+		*sizep = zce->zce_size;
+	}
+	mutex_exit(&zcp_cache_lock);
+
+	return (code);
+}
+
+typedef struct zcp_dump_arg {
+	char	*zda_code;	/* NULL while sizing */
+	size_t	zda_size;
+} zcp_dump_arg_t;
+
+static int
+zcp_cache_writer(lua_State *state, const void *p, size_t size, void *ud)
+{
+	(void) state;
+	zcp_dump_arg_t *zda = ud;
+
+	if (zda->zda_code != NULL)
+		memcpy(zda->zda_code + zda->zda_size, p, size);
+	zda->zda_size += size;
+	return (0);
+}
+
+/*
+ * Add the function on top of the stack of state, the program that was
+ * just compiled, to the cache.
+ */
+static void
+zcp_cache_insert(lua_State *state, const zio_cksum_t *hash)
+{
+	zcp_dump_arg_t zda = { 0 };
+	zcp_cache_entry_t *zce;
+	avl_index_t where;
+
+	/* The first pass only sizes the bytecode */
+	VERIFY0(lua_dump(state, zcp_cache_writer, &zda));
+	if (zda.zda_size > zfs_lua_cache_size)
+		return;
+
+	zce = kmem_alloc(sizeof (*zce), KM_SLEEP);
+	zce->zce_hash = *hash;
+	zce->zce_size = zda.zda_size;
+	zce->zce_code = kmem_alloc(zce->zce_size, KM_SLEEP);
+	zda.zda_code = zce->zce_code;
+	zda.zda_size = 0;
+	VERIFY0(lua_dump(state, zcp_cache_writer, &zda));
+	ASSERT3U(zda.zda_size, ==, zce->zce_size);
+
+	mutex_enter(&zcp_cache_lock);
+	if (avl_find(&zcp_cache_tree, zce, &where) != NULL) {
+		/* Another run of the same program got there first */
+		mutex_exit(&zcp_cache_lock);
+		kmem_free(zce->zce_code, zce->zce_size);
+		kmem_free(zce, sizeof (*zce));
+		return;
+	}
+	avl_insert(&zcp_cache_tree, zce, where);
+	list_insert_head(&zcp_cache_lru, zce);
+	zcp_cache_used += zce->zce_size;
+	zcp_cache_evict(zfs_lua_cache_size);
+	mutex_exit(&zcp_cache_lock);
+}
+
+void
+zcp_init(void)
+{
+	mutex_init(&zcp_cache_lock, NULL, MUTEX_DEFAULT, NULL);
+	avl_create(&zcp_cache_tree, zcp_cache_compare,
+	    sizeof (zcp_cache_entry_t), offsetof(zcp_cache_entry_t, zce_avl));
+	list_create(&zcp_cache_lru, sizeof (zcp_cache_entry_t),
+	    offsetof(zcp_cache_entry_t, zce_lru));
+}
+
+void
+zcp_fini(void)
+{
+	mutex_enter(&zcp_cache_lock);
+	zcp_cache_evict(0);
+	mutex_exit(&zcp_cache_lock);
+	ASSERT0(zcp_cache_used);
+
+	list_destroy(&zcp_cache_lru);
+	avl_destroy(&zcp_cache_tree);
+	mutex_destroy(&zcp_cache_lock);
+}
+
 int
 zcp_eval(const char *poolname, const char *program, boolean_t sync,
     uint64_t instrlimit, uint64_t memlimit, nvpair_t *nvarg, nvlist_t *outnvl)
@@ -1098,14 +1434,17 @@ zcp_eval(const char *poolname, const char *program, boolean_t sync,
 	lua_setfield(state, -2, zcp_debug_info.name);
 	lua_pushcclosure(state, zcp_exists_info.func, 0);
 	lua_setfield(state, -2, zcp_exists_info.name);
+	lua_pushcclosure(state, zcp_yield_info.func, 0);
+	lua_setfield(state, -2, zcp_yield_info.name);
 	lua_setglobal(state, "zfs");
 	VERIFY0(lua_gettop(state));
 
 	/*
-	 * Push the error-callback that calculates Lua stack traces on
-	 * unexpected failures.
+	 * Create the thread the script runs in, which can then be suspended
+	 * and resumed between txgs. It is kept on the main stack to protect
+	 * it from the garbage collector.
 	 */
-	lua_pushcfunction(state, zcp_error_handler);
+	lua_State *thread = lua_newthread(state);
 	VERIFY3U(1, ==, lua_gettop(state));
 
 	/*
@@ -1115,36 +1454,60 @@ zcp_eval(const char *poolname, const char *program, boolean_t sync,
 	 * KM_SLEEP.  ERRGCMM should not be possible because we have not added
 	 * any objects with __gc metamethods to the interpreter that could
 	 * fail.
+	 *
+	 * If the program was compiled before, load the bytecode from the
+	 * cache as a binary ("b") chunk instead.  Bytecode never comes from
+	 * userland: the ioctl only passes source text to the "t" load.
 	 */
-	err = luaL_loadbufferx(state, program, strlen(program),
-	    "channel program", "t");
-	if (err == LUA_ERRSYNTAX) {
-		fnvlist_add_string(outnvl, ZCP_RET_ERROR,
-		    lua_tostring(state, -1));
-		lua_close(state);
-		return (SET_ERROR(EINVAL));
+	boolean_t cache = (zfs_lua_cache_size != 0);
+	zio_cksum_t hash;
+	char *code = NULL;
+	size_t codesize = 0;
+
+	if (cache) {
+		zcp_cache_hash(program, &hash);
+		code = zcp_cache_lookup(&hash, &codesize);
+	}
+	if (code != NULL) {
+		err = luaL_loadbufferx(thread, code, codesize,
+		    "channel program", "b");
+		kmem_free(code, codesize);
+	} else {
+		err = luaL_loadbufferx(thread, program, strlen(program),
+		    "channel program", "t");
+		if (err == LUA_ERRSYNTAX) {
+			fnvlist_add_string(outnvl, ZCP_RET_ERROR,
+			    lua_tostring(thread, -1));
+			lua_close(state);
+			return (SET_ERROR(EINVAL));
+		}
+		if (err == 0 && cache)
+			zcp_cache_insert(thread, &hash);
 	}
 	VERIFY0(err);
-	VERIFY3U(2, ==, lua_gettop(state));
+	VERIFY3U(1, ==, lua_gettop(thread));
 
 	/*
 	 * Convert the input nvlist to a Lua object and put it on top of the
 	 * stack.
 	 */
 	char errmsg[128];
-	err = zcp_nvpair_value_to_lua(state, nvarg,
+	err = zcp_nvpair_value_to_lua(thread, nvarg,
 	    errmsg, sizeof (errmsg));
 	if (err != 0) {
 		fnvlist_add_string(outnvl, ZCP_RET_ERROR, errmsg);
 		lua_close(state);
 		return (SET_ERROR(EINVAL));
 	}
-	VERIFY3U(3, ==, lua_gettop(state));
+	VERIFY3U(2, ==, lua_gettop(thread));
 
 	cred_t *cr = CRED();
 	crhold(cr);
 
 	runinfo.zri_state = state;
+	runinfo.zri_thread = thread;
+	runinfo.zri_yielded = B_FALSE;
+	runinfo.zri_prefetch = fnvlist_alloc();
 	runinfo.zri_allocargs = &allocargs;
 	runinfo.zri_outnvl = outnvl;
 	runinfo.zri_result = 0;
@@ -1158,14 +1521,20 @@ zcp_eval(const char *poolname, const char *program, boolean_t sync,
 	runinfo.zri_new_zvols = fnvlist_alloc();
 
 	if (sync) {
-		err = dsl_sync_task_sig(poolname, NULL, zcp_eval_sync,
-		    zcp_eval_sig, &runinfo, 0, ZFS_SPACE_CHECK_ZCP_EVAL);
-		if (err != 0)
-			zcp_pool_error(&runinfo, poolname, err);
+		do {
+			err = dsl_sync_task_sig(poolname, NULL, zcp_eval_sync,
+			    zcp_eval_sig, &runinfo, 0,
+			    ZFS_SPACE_CHECK_ZCP_EVAL);
+			if (err != 0) {
+				zcp_pool_error(&runinfo, poolname, err);
+				break;
+			}
+		} while (zcp_eval_resume(&runinfo, poolname));
 	} else {
 		zcp_eval_open(&runinfo, poolname);
 	}
 	lua_close(state);
+	fnvlist_free(runinfo.zri_prefetch);
 
 	crfree(cr);
 
@@ -1452,3 +1821,6 @@ ZFS_MODULE_PARAM(zfs_lua, zfs_lua_, max_instrlimit, U64, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_lua, zfs_lua_, max_memlimit, U64, ZMOD_RW,
 	"Max memory limit that can be specified for a channel program");
+
+ZFS_MODULE_PARAM(zfs_lua, zfs_lua_, cache_size, U64, ZMOD_RW,
+	"Max bytes of compiled channel programs to cache");
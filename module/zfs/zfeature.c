@@ -376,6 +376,16 @@ feature_enable_sync(spa_t *spa, zfeature_info_t *feature, dmu_tx_t *tx)
 		VERIFY0(zap_add(spa->spa_meta_objset,
 		    spa->spa_feat_enabled_txg_obj, feature->fi_guid,
 		    sizeof (uint64_t), 1, &enabling_txg, tx));
+
+		/*
+		 * Blocks of the open and quiescing txgs may already have
+		 * been allocated, so wide gang headers only start once
+		 * every txg that could have been open is past.
+		 */
+		if (feature->fi_feature == SPA_FEATURE_DYNAMIC_GANG_HEADER) {
+			spa->spa_gang_header_txg =
+			    enabling_txg + TXG_CONCURRENT_STATES;
+		}
 	}
 
 	/*
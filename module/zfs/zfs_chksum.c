@@ -180,6 +180,27 @@ chksum_run(chksum_stat_t *cs, abd_t *abd, void *ctx, int round,
 	*result = run_bw/1024/1024; /* MiB/s */
 }
 
+/*
+ * Remember the fastest implementation for each benchmarked block size,
+ * sizes skipped on slow CPUs keep using the overall fastest one.
+ */
+static void
+chksum_pick_sized(const zfs_impl_t *impl, uint32_t id, chksum_stat_t *cs,
+    uint64_t *max)
+{
+	uint64_t bw[ZFS_IMPL_SIZE_CLASSES] = {
+		cs->bs1k, cs->bs4k, cs->bs16k, cs->bs64k,
+		cs->bs256k, cs->bs1m, cs->bs4m, cs->bs16m
+	};
+
+	for (uint32_t c = 0; c < ZFS_IMPL_SIZE_CLASSES; c++) {
+		if (bw[c] > max[c]) {
+			max[c] = bw[c];
+			impl->set_fastest_sized(id, c);
+		}
+	}
+}
+
 #define	LIMIT_INIT	0
 #define	LIMIT_NEEDED	1
 #define	LIMIT_NOLIMIT	2
@@ -245,7 +266,7 @@ chksum_benchmark(void)
 #endif
 
 	chksum_stat_t *cs;
-	uint64_t max;
+	uint64_t max, max_sized[ZFS_IMPL_SIZE_CLASSES];
 	uint32_t id, cbid = 0, id_save;
 	const zfs_impl_t *blake3 = zfs_impl_get_ops("blake3");
 	const zfs_impl_t *sha256 = zfs_impl_get_ops("sha256");
@@ -281,6 +302,7 @@ chksum_benchmark(void)
 
 	/* sha256 */
 	id_save = sha256->getid();
+	memset(max_sized, 0, sizeof (max_sized));
 	for (max = 0, id = 0; id < sha256->getcnt(); id++) {
 		sha256->setid(id);
 		cs = &chksum_stat_data[cbid++];
@@ -290,6 +312,7 @@ chksum_benchmark(void)
 		cs->name = sha256->name;
 		cs->impl = sha256->getname();
 		chksum_benchit(cs);
+		chksum_pick_sized(sha256, id, cs, max_sized);
 		if (cs->bs256k > max) {
 			max = cs->bs256k;
 			sha256->set_fastest(id);
@@ -299,6 +322,7 @@ chksum_benchmark(void)
 
 	/* sha512 */
 	id_save = sha512->getid();
+	memset(max_sized, 0, sizeof (max_sized));
 	for (max = 0, id = 0; id < sha512->getcnt(); id++) {
 		sha512->setid(id);
 		cs = &chksum_stat_data[cbid++];
@@ -308,6 +332,7 @@ chksum_benchmark(void)
 		cs->name = sha512->name;
 		cs->impl = sha512->getname();
 		chksum_benchit(cs);
+		chksum_pick_sized(sha512, id, cs, max_sized);
 		if (cs->bs256k > max) {
 			max = cs->bs256k;
 			sha512->set_fastest(id);
@@ -317,6 +342,7 @@ chksum_benchmark(void)
 
 	/* blake3 */
 	id_save = blake3->getid();
+	memset(max_sized, 0, sizeof (max_sized));
 	for (max = 0, id = 0; id < blake3->getcnt(); id++) {
 		blake3->setid(id);
 		cs = &chksum_stat_data[cbid++];
@@ -326,6 +352,7 @@ chksum_benchmark(void)
 		cs->name = blake3->name;
 		cs->impl = blake3->getname();
 		chksum_benchit(cs);
+		chksum_pick_sized(blake3, id, cs, max_sized);
 		if (cs->bs256k > max) {
 			max = cs->bs256k;
 			blake3->set_fastest(id);
@@ -134,6 +134,16 @@ static unsigned int zfs_zevent_retain_max = 2000;
  */
 static unsigned int zfs_zevent_retain_expire_secs = 900;
 
+/*
+ * Once a vdev has posted its zfs_checksum_events_per_second worth of
+ * checksum ereports, further checksum errors on it are only counted,
+ * before the duplicate check and its global lock are reached.  This keeps
+ * a storm of checksum errors from a failing device or cable from stalling
+ * I/O completion.  The count is reported as cksum_suppressed in the next
+ * checksum ereport posted for the vdev.
+ */
+static int zfs_checksum_events_aggregate = 1;
+
 typedef enum zfs_subclass {
 	ZSC_IO,
 	ZSC_DATA,
@@ -459,11 +469,45 @@ zfs_is_ratelimiting_event(const char *subclass, vdev_t *vd)
 	if (rc)	{
 		/* We're rate limiting */
 		fm_erpt_dropped_increment();
+		if (strcmp(subclass, FM_EREPORT_ZFS_CHECKSUM) == 0)
+			atomic_inc_64(&vd->vdev_checksum_suppressed);
 	}
 
 	return (rc);
 }
 
+/*
+ * Cheaply drop a checksum ereport for a vdev which is already being rate
+ * limited, counting it towards the next ereport's cksum_suppressed.
+ */
+static boolean_t
+zfs_ereport_checksum_suppress(vdev_t *vd)
+{
+	if (!zfs_checksum_events_aggregate ||
+	    !zfs_ratelimit_exceeded(&vd->vdev_checksum_rl))
+		return (B_FALSE);
+
+	fm_erpt_dropped_increment();
+	atomic_inc_64(&vd->vdev_checksum_suppressed);
+
+	return (B_TRUE);
+}
+
+/*
+ * Record how many checksum ereports were rate limited on the vdev since
+ * the last one posted.
+ */
+static void
+zfs_ereport_checksum_suppressed(nvlist_t *ereport, vdev_t *vd)
+{
+	uint64_t suppressed = atomic_swap_64(&vd->vdev_checksum_suppressed, 0);
+
+	if (suppressed != 0) {
+		fm_payload_set(ereport, FM_EREPORT_PAYLOAD_ZFS_CKSUM_SUPPRESSED,
+		    DATA_TYPE_UINT64, suppressed, NULL);
+	}
+}
+
 /*
  * Return B_TRUE if the event actually posted, B_FALSE if not.
  */
@@ -1211,6 +1255,9 @@ zfs_ereport_start_checksum(spa_t *spa, vdev_t *vd, const zbookmark_phys_t *zb,
 	if (!zfs_ereport_is_valid(FM_EREPORT_ZFS_CHECKSUM, spa, vd, zio))
 		return (SET_ERROR(EINVAL));
 
+	if (zfs_ereport_checksum_suppress(vd))
+		return (SET_ERROR(EBUSY));
+
 	if (zfs_ereport_is_duplicate(FM_EREPORT_ZFS_CHECKSUM, spa, vd, zb, zio,
 	    offset, length))
 		return (SET_ERROR(EALREADY));
@@ -1244,6 +1291,7 @@ zfs_ereport_start_checksum(spa_t *spa, vdev_t *vd, const zbookmark_phys_t *zb,
 		zfs_ereport_free_checksum(report);
 		return (0);
 	}
+	zfs_ereport_checksum_suppressed(report->zcr_ereport, vd);
 #endif
 
 	mutex_enter(&spa->spa_errlist_lock);
@@ -1319,6 +1367,9 @@ zfs_ereport_post_checksum(spa_t *spa, vdev_t *vd, const zbookmark_phys_t *zb,
 	if (!zfs_ereport_is_valid(FM_EREPORT_ZFS_CHECKSUM, spa, vd, zio))
 		return (SET_ERROR(EINVAL));
 
+	if (zfs_ereport_checksum_suppress(vd))
+		return (SET_ERROR(EBUSY));
+
 	if (zfs_ereport_is_duplicate(FM_EREPORT_ZFS_CHECKSUM, spa, vd, zb, zio,
 	    offset, length))
 		return (SET_ERROR(EALREADY));
@@ -1330,6 +1381,7 @@ zfs_ereport_post_checksum(spa_t *spa, vdev_t *vd, const zbookmark_phys_t *zb,
 	    spa, vd, zb, zio, offset, length) || (ereport == NULL)) {
 		return (SET_ERROR(EINVAL));
 	}
+	zfs_ereport_checksum_suppressed(ereport, vd);
 
 	info = annotate_ecksum(ereport, zbc, good_data, bad_data, length,
 	    B_FALSE);
@@ -1609,4 +1661,6 @@ ZFS_MODULE_PARAM(zfs_zevent, zfs_zevent_, retain_max, UINT, ZMOD_RW,
 	"Maximum recent zevents records to retain for duplicate checking");
 ZFS_MODULE_PARAM(zfs_zevent, zfs_zevent_, retain_expire_secs, UINT, ZMOD_RW,
 	"Expiration time for recent zevents records");
+ZFS_MODULE_PARAM(zfs, zfs_, checksum_events_aggregate, INT, ZMOD_RW,
+	"Count rate limited checksum events without duplicate checking");
 #endif /* _KERNEL */
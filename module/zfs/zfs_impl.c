@@ -36,6 +36,7 @@
  */
 const zfs_impl_t *impl_ops[] = {
 	&zfs_blake3_ops,
+	&zfs_chacha20_ops,
 	&zfs_sha256_ops,
 	&zfs_sha512_ops,
 	NULL
@@ -1700,10 +1700,12 @@ zfs_ioc_pool_scan(zfs_cmd_t *zc)
  * poolname             name of the pool
  * scan_type            scan func (pool_scan_func_t)
  * scan_command         scrub pause/resume flag (pool_scrub_cmd_t)
+ * (optional) scan_txg_start  only scrub blocks born after this txg
  */
 static const zfs_ioc_key_t zfs_keys_pool_scrub[] = {
 	{"scan_type",		DATA_TYPE_UINT64,	0},
 	{"scan_command",	DATA_TYPE_UINT64,	0},
+	{"scan_txg_start",	DATA_TYPE_UINT64,	ZK_OPTIONAL},
 };
 
 static int
@@ -1711,15 +1713,20 @@ zfs_ioc_pool_scrub(const char *poolname, nvlist_t *innvl, nvlist_t *outnvl)
 {
 	spa_t *spa;
 	int error;
-	uint64_t scan_type, scan_cmd;
+	uint64_t scan_type, scan_cmd, txgstart;
+	boolean_t range;
 
 	if (nvlist_lookup_uint64(innvl, "scan_type", &scan_type) != 0)
 		return (SET_ERROR(EINVAL));
 	if (nvlist_lookup_uint64(innvl, "scan_command", &scan_cmd) != 0)
 		return (SET_ERROR(EINVAL));
+	range = (nvlist_lookup_uint64(innvl, "scan_txg_start",
+	    &txgstart) == 0);
 
 	if (scan_cmd >= POOL_SCRUB_FLAGS_END)
 		return (SET_ERROR(EINVAL));
+	if (range && scan_cmd != POOL_SCRUB_NORMAL)
+		return (SET_ERROR(EINVAL));
 
 	if ((error = spa_open(poolname, &spa, FTAG)) != 0)
 		return (error);
@@ -1731,6 +1738,8 @@ zfs_ioc_pool_scrub(const char *poolname, nvlist_t *innvl, nvlist_t *outnvl)
 	} else if (scan_cmd == POOL_SCRUB_FROM_LAST_TXG) {
 		error = spa_scan_range(spa, scan_type,
 		    spa_get_last_scrubbed_txg(spa), 0);
+	} else if (range) {
+		error = spa_scan_range(spa, scan_type, txgstart, 0);
 	} else {
 		error = spa_scan(spa, scan_type);
 	}
@@ -1913,6 +1922,73 @@ zfs_ioc_obj_to_stats(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * innvl: {
+ *     "objs_objects" -> uint64 array of up to ZFS_OBJS_STATS_MAX objects
+ * }
+ *
+ * outnvl: {
+ *     object number (decimal) -> {
+ *         "objs_path" -> path to object, when found
+ *         "objs_error" -> error of ZFS_IOC_OBJ_TO_STATS, when not zero
+ *         "objs_stat" -> zfs_stat_t as a byte array
+ *     }
+ *     ...
+ * }
+ *
+ * Does the work of ZFS_IOC_OBJ_TO_STATS for many objects at once, under a
+ * single hold of the objset, for zfs diff.
+ */
+static const zfs_ioc_key_t zfs_keys_objs_to_stats[] = {
+	{ZFS_OBJS_STATS_OBJECTS,	DATA_TYPE_UINT64_ARRAY,	0},
+};
+
+static int
+zfs_ioc_objs_to_stats(const char *dsname, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	objset_t *os;
+	uint64_t *objs;
+	uint_t nobjs;
+	char *path;
+	int error;
+
+	if (nvlist_lookup_uint64_array(innvl, ZFS_OBJS_STATS_OBJECTS,
+	    &objs, &nobjs) != 0 || nobjs > ZFS_OBJS_STATS_MAX)
+		return (SET_ERROR(EINVAL));
+
+	/* XXX reading from objset not owned */
+	if ((error = dmu_objset_hold_flags(dsname, B_TRUE, FTAG, &os)) != 0)
+		return (error);
+	if (dmu_objset_type(os) != DMU_OST_ZFS) {
+		dmu_objset_rele_flags(os, B_TRUE, FTAG);
+		return (SET_ERROR(EINVAL));
+	}
+
+	path = kmem_alloc(MAXPATHLEN, KM_SLEEP);
+	for (uint_t i = 0; i < nobjs; i++) {
+		nvlist_t *entry = fnvlist_alloc();
+		zfs_stat_t sb = { 0 };
+		char name[32];
+
+		error = zfs_obj_to_stats(os, objs[i], &sb, path, MAXPATHLEN);
+		if (error == 0)
+			fnvlist_add_string(entry, ZFS_OBJS_STATS_PATH, path);
+		else
+			fnvlist_add_int32(entry, ZFS_OBJS_STATS_ERROR, error);
+		fnvlist_add_uint8_array(entry, ZFS_OBJS_STATS_STAT,
+		    (uint8_t *)&sb, sizeof (sb));
+
+		(void) snprintf(name, sizeof (name), "%llu",
+		    (u_longlong_t)objs[i]);
+		fnvlist_add_nvlist(outnvl, name, entry);
+		fnvlist_free(entry);
+	}
+	kmem_free(path, MAXPATHLEN);
+	dmu_objset_rele_flags(os, B_TRUE, FTAG);
+
+	return (0);
+}
+
 static int
 zfs_ioc_vdev_add(zfs_cmd_t *zc)
 {
@@ -2112,6 +2188,41 @@ zfs_ioc_vdev_setfru(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * Gather all the properties and statistics of an objset, as returned in
+ * the property nvlist of ZFS_IOC_OBJSET_STATS.
+ */
+static int
+zfs_objset_props_get(objset_t *os, const dmu_objset_stats_t *stat,
+    nvlist_t **nvp)
+{
+	nvlist_t *nv;
+	int error;
+
+	if ((error = dsl_prop_get_all(os, &nv)) != 0)
+		return (error);
+
+	dmu_objset_stats(os, nv);
+	/*
+	 * NB: zvol_get_stats() will read the objset contents,
+	 * which we aren't supposed to do with a
+	 * DS_MODE_USER hold, because it could be
+	 * inconsistent.  So this is a bit of a workaround...
+	 * XXX reading without owning
+	 */
+	if (!stat->dds_inconsistent && dmu_objset_type(os) == DMU_OST_ZVOL) {
+		error = zvol_get_stats(os, nv);
+		if (error == EIO) {
+			nvlist_free(nv);
+			return (error);
+		}
+		VERIFY0(error);
+	}
+
+	*nvp = nv;
+	return (0);
+}
+
 static int
 zfs_ioc_objset_stats_impl(zfs_cmd_t *zc, objset_t *os)
 {
@@ -2121,26 +2232,9 @@ zfs_ioc_objset_stats_impl(zfs_cmd_t *zc, objset_t *os)
 	dmu_objset_fast_stat(os, &zc->zc_objset_stats);
 
 	if (!zc->zc_simple && zc->zc_nvlist_dst != 0 &&
-	    (error = dsl_prop_get_all(os, &nv)) == 0) {
-		dmu_objset_stats(os, nv);
-		/*
-		 * NB: zvol_get_stats() will read the objset contents,
-		 * which we aren't supposed to do with a
-		 * DS_MODE_USER hold, because it could be
-		 * inconsistent.  So this is a bit of a workaround...
-		 * XXX reading without owning
-		 */
-		if (!zc->zc_objset_stats.dds_inconsistent &&
-		    dmu_objset_type(os) == DMU_OST_ZVOL) {
-			error = zvol_get_stats(os, nv);
-			if (error == EIO) {
-				nvlist_free(nv);
-				return (error);
-			}
-			VERIFY0(error);
-		}
-		if (error == 0)
-			error = put_nvlist(zc, nv);
+	    (error = zfs_objset_props_get(os, &zc->zc_objset_stats,
+	    &nv)) == 0) {
+		error = put_nvlist(zc, nv);
 		nvlist_free(nv);
 	}
 
@@ -2443,6 +2537,211 @@ zfs_ioc_snapshot_list_next(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * Fill in the list entry of one child dataset or snapshot of a
+ * ZFS_IOC_LIST_BULK request, returns ENOENT if it was destroyed meanwhile.
+ */
+static int
+zfs_list_bulk_entry(dsl_dataset_t *ds, boolean_t simple, nvlist_t *filter,
+    nvlist_t *entry)
+{
+	dmu_objset_stats_t stat;
+	objset_t *os = NULL;
+	nvlist_t *props;
+	int error;
+
+	if (simple && ds->ds_is_snapshot) {
+		dsl_dataset_fast_stat(ds, &stat);
+	} else {
+		if ((error = dmu_objset_from_ds(ds, &os)) != 0)
+			return (error);
+		dmu_objset_fast_stat(os, &stat);
+	}
+	fnvlist_add_uint8_array(entry, ZFS_LIST_BULK_STATS,
+	    (uint8_t *)&stat, sizeof (stat));
+	if (simple)
+		return (0);
+
+	if ((error = zfs_objset_props_get(os, &stat, &props)) != 0)
+		return (error);
+	if (filter != NULL) {
+		nvpair_t *pair, *next;
+		for (pair = nvlist_next_nvpair(props, NULL); pair != NULL;
+		    pair = next) {
+			next = nvlist_next_nvpair(props, pair);
+			if (!nvlist_exists(filter, nvpair_name(pair)))
+				fnvlist_remove_nvpair(props, pair);
+		}
+	}
+	fnvlist_add_nvlist(entry, ZFS_LIST_BULK_PROPS, props);
+	nvlist_free(props);
+	return (0);
+}
+
+/*
+ * innvl: {
+ *     "list_cursor" -> resume point returned by a previous call (optional)
+ *     "list_count" -> max number of datasets to return (optional)
+ *     "list_snapshots" -> list snapshots rather than children (optional)
+ *     "list_simple" -> only return "list_stats" (optional)
+ *     "list_props" -> { prop1, prop2, ... } properties to return (optional)
+ *     "snap_iter_min_txg" -> oldest snapshot creation txg (optional)
+ *     "snap_iter_max_txg" -> newest snapshot creation txg (optional)
+ * }
+ *
+ * outnvl: {
+ *     "list_datasets" -> {
+ *         dataset name -> {
+ *             "list_stats" -> dmu_objset_stats_t as a byte array
+ *             "list_props" -> { same as ZFS_IOC_OBJSET_STATS }
+ *         }
+ *         ...
+ *     }
+ *     "list_cursor" -> resume point, absent once the listing is complete
+ * }
+ *
+ * Returns the stats of many child datasets (or snapshots) of fsname, in
+ * the order of ZFS_IOC_DATASET_LIST_NEXT (or ZFS_IOC_SNAPSHOT_LIST_NEXT),
+ * under a single hold of the pool configuration.
+ */
+static const zfs_ioc_key_t zfs_keys_list_bulk[] = {
+	{ZFS_LIST_BULK_CURSOR,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{ZFS_LIST_BULK_COUNT,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{ZFS_LIST_BULK_SNAPSHOTS,	DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
+	{ZFS_LIST_BULK_SIMPLE,		DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
+	{ZFS_LIST_BULK_PROPS,		DATA_TYPE_NVLIST,	ZK_OPTIONAL},
+	{SNAP_ITER_MIN_TXG,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{SNAP_ITER_MAX_TXG,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+};
+
+static int
+zfs_ioc_list_bulk(const char *fsname, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	boolean_t snapshots = nvlist_exists(innvl, ZFS_LIST_BULK_SNAPSHOTS);
+	boolean_t simple = nvlist_exists(innvl, ZFS_LIST_BULK_SIMPLE);
+	uint64_t cookie = 0, count = ZFS_LIST_BULK_MAX;
+	uint64_t min_txg = 0, max_txg = 0;
+	nvlist_t *filter = NULL;
+	boolean_t done = B_FALSE;
+	dsl_pool_t *dp;
+	dsl_dataset_t *ds;
+	objset_t *os;
+	int error;
+
+	(void) nvlist_lookup_uint64(innvl, ZFS_LIST_BULK_CURSOR, &cookie);
+	(void) nvlist_lookup_uint64(innvl, ZFS_LIST_BULK_COUNT, &count);
+	(void) nvlist_lookup_nvlist(innvl, ZFS_LIST_BULK_PROPS, &filter);
+	(void) nvlist_lookup_uint64(innvl, SNAP_ITER_MIN_TXG, &min_txg);
+	(void) nvlist_lookup_uint64(innvl, SNAP_ITER_MAX_TXG, &max_txg);
+	if (count == 0)
+		return (SET_ERROR(EINVAL));
+	count = MIN(count, ZFS_LIST_BULK_MAX);
+
+	if ((error = dsl_pool_hold(fsname, FTAG, &dp)) != 0)
+		return (error);
+	if ((error = dsl_dataset_hold(dp, fsname, FTAG, &ds)) != 0) {
+		dsl_pool_rele(dp, FTAG);
+		return (error);
+	}
+	if ((error = dmu_objset_from_ds(ds, &os)) != 0) {
+		dsl_dataset_rele(ds, FTAG);
+		dsl_pool_rele(dp, FTAG);
+		return (error);
+	}
+
+	nvlist_t *datasets = fnvlist_alloc();
+	char *name = kmem_alloc(ZFS_MAX_DATASET_NAME_LEN, KM_SLEEP);
+	size_t len = strlcpy(name, fsname, ZFS_MAX_DATASET_NAME_LEN);
+	if (len + 1 >= ZFS_MAX_DATASET_NAME_LEN) {
+		/* A dataset name of maximum length cannot have children. */
+		done = B_TRUE;
+		count = 0;
+	} else {
+		name[len++] = snapshots ? '@' : '/';
+	}
+
+	for (uint64_t n = 0; n < count; ) {
+		dsl_dataset_t *cds;
+		uint64_t obj;
+
+		if (issig()) {
+			error = SET_ERROR(EINTR);
+			break;
+		}
+
+		if (snapshots) {
+			error = dmu_snapshot_list_next(os,
+			    ZFS_MAX_DATASET_NAME_LEN - len, name + len, &obj,
+			    &cookie, NULL);
+		} else {
+			error = dmu_dir_list_next(os,
+			    ZFS_MAX_DATASET_NAME_LEN - len, name + len, NULL,
+			    &cookie);
+		}
+		if (error == ENOENT) {
+			error = 0;
+			done = B_TRUE;
+			break;
+		} else if (error != 0) {
+			break;
+		}
+
+		/*
+		 * Skip hidden and internal datasets (ie. with a '$' in
+		 * their name), we can't get stats for the latter.
+		 */
+		if (!snapshots && (zfs_dataset_name_hidden(name) ||
+		    strchr(name, '$') != NULL))
+			continue;
+
+		if (snapshots)
+			error = dsl_dataset_hold_obj(dp, obj, FTAG, &cds);
+		else
+			error = dsl_dataset_hold(dp, name, FTAG, &cds);
+		if (error == ENOENT) {
+			/* We lost a race with destroy, get the next one. */
+			error = 0;
+			continue;
+		} else if (error != 0) {
+			break;
+		}
+
+		if (snapshots &&
+		    ((min_txg != 0 && dsl_get_creationtxg(cds) < min_txg) ||
+		    (max_txg != 0 && dsl_get_creationtxg(cds) > max_txg))) {
+			dsl_dataset_rele(cds, FTAG);
+			continue;
+		}
+
+		nvlist_t *entry = fnvlist_alloc();
+		error = zfs_list_bulk_entry(cds, simple, filter, entry);
+		dsl_dataset_rele(cds, FTAG);
+		if (error == 0) {
+			fnvlist_add_nvlist(datasets, name, entry);
+			n++;
+		}
+		fnvlist_free(entry);
+		if (error == ENOENT)
+			error = 0;
+		else if (error != 0)
+			break;
+	}
+
+	kmem_free(name, ZFS_MAX_DATASET_NAME_LEN);
+	dsl_dataset_rele(ds, FTAG);
+	dsl_pool_rele(dp, FTAG);
+
+	if (error == 0) {
+		fnvlist_add_nvlist(outnvl, ZFS_LIST_BULK_DATASETS, datasets);
+		if (!done) {
+			fnvlist_add_uint64(outnvl, ZFS_LIST_BULK_CURSOR,
+			    cookie);
+		}
+	}
+	fnvlist_free(datasets);
+	return (error);
+}
+
 static int
 zfs_prop_set_userquota(const char *dsname, nvpair_t *pair)
 {
@@ -4655,6 +4954,90 @@ zfs_ioc_wait_fs(const char *name, nvlist_t *innvl, nvlist_t *outnvl)
 	return (error);
 }
 
+/*
+ * fsname is name of a filesystem, volume or snapshot
+ *
+ * innvl: {
+ *     "prefetch_object" -> object to read (uint64, optional, defaults to
+ *         every object, or the data of a volume if a range is given)
+ *     "prefetch_offset" -> start of the range to read (uint64, optional)
+ *     "prefetch_length" -> length of the range to read (uint64, optional)
+ *     "prefetch_rate" -> bytes per second to read at most (uint64, optional)
+ * }
+ *
+ * outnvl: empty
+ *
+ * Reads the given range of an object, or every object of the dataset,
+ * into the ARC (and so, as it is evicted, the L2ARC) and returns once the
+ * reads have completed.  This is used to warm the caches for a dataset or
+ * file ahead of its use, e.g. on a standby before a failover.
+ */
+static const zfs_ioc_key_t zfs_keys_prefetch[] = {
+	{ZFS_PREFETCH_OBJECT,	DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{ZFS_PREFETCH_OFFSET,	DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{ZFS_PREFETCH_LENGTH,	DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{ZFS_PREFETCH_RATE,	DATA_TYPE_UINT64,	ZK_OPTIONAL},
+};
+
+static int
+zfs_ioc_prefetch(const char *dsname, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	(void) outnvl;
+	uint64_t object, offset = 0, length = UINT64_MAX, rate = 0;
+	dsl_pool_t *dp;
+	dsl_dataset_t *ds;
+	objset_t *os;
+	int error;
+
+	boolean_t all =
+	    (nvlist_lookup_uint64(innvl, ZFS_PREFETCH_OBJECT, &object) != 0);
+	boolean_t range = (nvlist_exists(innvl, ZFS_PREFETCH_OFFSET) ||
+	    nvlist_exists(innvl, ZFS_PREFETCH_LENGTH));
+	(void) nvlist_lookup_uint64(innvl, ZFS_PREFETCH_OFFSET, &offset);
+	(void) nvlist_lookup_uint64(innvl, ZFS_PREFETCH_LENGTH, &length);
+	(void) nvlist_lookup_uint64(innvl, ZFS_PREFETCH_RATE, &rate);
+
+	if ((error = dsl_pool_hold(dsname, FTAG, &dp)) != 0)
+		return (error);
+	error = dsl_dataset_hold_flags(dp, dsname, DS_HOLD_FLAG_DECRYPT, FTAG,
+	    &ds);
+	if (error != 0) {
+		dsl_pool_rele(dp, FTAG);
+		return (error);
+	}
+	if ((error = dmu_objset_from_ds(ds, &os)) != 0) {
+		dsl_dataset_rele_flags(ds, DS_HOLD_FLAG_DECRYPT, FTAG);
+		dsl_pool_rele(dp, FTAG);
+		return (error);
+	}
+	if (all && range) {
+		if (dmu_objset_type(os) != DMU_OST_ZVOL) {
+			dsl_dataset_rele_flags(ds, DS_HOLD_FLAG_DECRYPT, FTAG);
+			dsl_pool_rele(dp, FTAG);
+			return (SET_ERROR(EINVAL));
+		}
+		object = ZVOL_OBJ;
+		all = B_FALSE;
+	}
+
+	/*
+	 * As for zfs_ioc_wait_fs(), a long hold keeps the dataset around
+	 * without holding the pool config lock for the whole of the reads.
+	 */
+	dsl_dataset_long_hold(ds, FTAG);
+	dsl_pool_rele(dp, FTAG);
+
+	if (all)
+		error = dmu_prefetch_objset(os, rate);
+	else
+		error = dmu_prefetch_object(os, object, offset, length, rate);
+
+	dsl_dataset_long_rele(ds, FTAG);
+	dsl_dataset_rele_flags(ds, DS_HOLD_FLAG_DECRYPT, FTAG);
+
+	return (error);
+}
+
 /*
  * fsname is name of dataset to rollback (to most recent snapshot)
  *
@@ -5009,6 +5392,19 @@ zfs_check_settable(const char *dsname, nvpair_t *pair, cred_t *cr)
 		 */
 		break;
 
+	case ZFS_PROP_QOS_WEIGHT:
+		if (nvpair_value_uint64(pair, &intval) == 0 &&
+		    (intval < ZFS_QOS_WEIGHT_MIN ||
+		    intval > ZFS_QOS_WEIGHT_MAX))
+			return (SET_ERROR(ERANGE));
+		break;
+
+	case ZFS_PROP_RESILVER_PRIORITY:
+		if (nvpair_value_uint64(pair, &intval) == 0 &&
+		    intval > ZFS_RESILVER_PRIORITY_MAX)
+			return (SET_ERROR(ERANGE));
+		break;
+
 	case ZFS_PROP_SHARESMB:
 		if (zpl_earlier_version(dsname, ZPL_VERSION_FUID))
 			return (SET_ERROR(ENOTSUP));
@@ -7499,6 +7895,21 @@ zfs_ioctl_init(void)
 	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
 	    zfs_keys_get_bookmarks, ARRAY_SIZE(zfs_keys_get_bookmarks));
 
+	zfs_ioctl_register("list_bulk", ZFS_IOC_LIST_BULK,
+	    zfs_ioc_list_bulk, zfs_secpolicy_read, DATASET_NAME,
+	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
+	    zfs_keys_list_bulk, ARRAY_SIZE(zfs_keys_list_bulk));
+
+	zfs_ioctl_register("objs_to_stats", ZFS_IOC_OBJS_TO_STATS,
+	    zfs_ioc_objs_to_stats, zfs_secpolicy_diff, DATASET_NAME,
+	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
+	    zfs_keys_objs_to_stats, ARRAY_SIZE(zfs_keys_objs_to_stats));
+
+	zfs_ioctl_register("prefetch", ZFS_IOC_PREFETCH,
+	    zfs_ioc_prefetch, zfs_secpolicy_config, DATASET_NAME,
+	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
+	    zfs_keys_prefetch, ARRAY_SIZE(zfs_keys_prefetch));
+
 	zfs_ioctl_register("get_bookmark_props", ZFS_IOC_GET_BOOKMARK_PROPS,
 	    zfs_ioc_get_bookmark_props, zfs_secpolicy_read, ENTITY_NAME,
 	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE, zfs_keys_get_bookmark_props,
@@ -626,7 +626,10 @@ zfs_log_write(zilog_t *zilog, dmu_tx_t *tx, int txtype,
 		return;
 	}
 
-	if (zilog->zl_logbias == ZFS_LOGBIAS_THROUGHPUT || o_direct)
+	/* Inline data has no block to point to, it is always copied. */
+	if (zp->z_pflags & ZFS_INLINE_DATA)
+		write_state = WR_COPIED;
+	else if (zilog->zl_logbias == ZFS_LOGBIAS_THROUGHPUT || o_direct)
 		write_state = WR_INDIRECT;
 	else if (!spa_has_slogs(zilog->zl_spa) &&
 	    resid >= zfs_immediate_write_sz)
@@ -666,11 +669,16 @@ zfs_log_write(zilog_t *zilog, dmu_tx_t *tx, int txtype,
 		 */
 		if (wr_state == WR_COPIED) {
 			int err;
-			DB_DNODE_ENTER(db);
-			err = dmu_read_by_dnode(DB_DNODE(db), off, len,
-			    &lr->lr_data[0], DMU_READ_NO_PREFETCH |
-			    DMU_KEEP_CACHING);
-			DB_DNODE_EXIT(db);
+			if (zp->z_pflags & ZFS_INLINE_DATA) {
+				err = zfs_sa_inline_read(zp, &lr->lr_data[0],
+				    off, len);
+			} else {
+				DB_DNODE_ENTER(db);
+				err = dmu_read_by_dnode(DB_DNODE(db), off, len,
+				    &lr->lr_data[0], DMU_READ_NO_PREFETCH |
+				    DMU_KEEP_CACHING);
+				DB_DNODE_EXIT(db);
+			}
 			if (err != 0) {
 				zil_itx_destroy(itx);
 				itx = zil_itx_create(txtype, sizeof (*lr));
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/zfs_qos.h>
+
+/*
+ * The rate fields may be changed by property callbacks before the lock is
+ * initialized, so zfs_qos_set_limit() only ever stores the new rate and
+ * leaves the bucket state to the next zfs_qos_charge().
+ */
+void
+zfs_qos_init(zfs_qos_t *zq)
+{
+	mutex_init(&zq->zq_lock, NULL, MUTEX_DEFAULT, NULL);
+}
+
+void
+zfs_qos_fini(zfs_qos_t *zq)
+{
+	mutex_destroy(&zq->zq_lock);
+}
+
+void
+zfs_qos_set_limit(zfs_qos_t *zq, zfs_qos_limit_t limit, uint64_t rate)
+{
+	ASSERT3U(limit, <, ZFS_QOS_NUM_LIMITS);
+	atomic_store_64(&zq->zq_bucket[limit].zqb_rate,
+	    MIN(rate, ZFS_QOS_RATE_MAX));
+}
+
+/*
+ * Refill the bucket for the time elapsed since the last charge, take
+ * "amount" tokens, and return how long the caller must wait to repay any
+ * resulting debt, in microseconds.
+ */
+static uint64_t
+zfs_qos_bucket_take(zfs_qos_bucket_t *zqb, uint64_t rate, hrtime_t now,
+    uint64_t amount)
+{
+	uint64_t elapsed = NSEC2USEC(MIN(now - zqb->zqb_last, NANOSEC));
+
+	zqb->zqb_last = now;
+	zqb->zqb_tokens = MIN(zqb->zqb_tokens +
+	    (int64_t)(rate * elapsed / MICROSEC), (int64_t)rate);
+	zqb->zqb_tokens -= MIN(amount, ZFS_QOS_RATE_MAX);
+	if (zqb->zqb_tokens >= 0)
+		return (0);
+
+	uint64_t debt = -zqb->zqb_tokens;
+	return (debt / rate * MICROSEC + debt % rate * MICROSEC / rate);
+}
+
+/*
+ * Charge a read or write of "bytes" against the dataset's limits, sleeping
+ * if it exceeds them.  Each call counts as one operation.
+ */
+void
+zfs_qos_charge(zfs_qos_t *zq, boolean_t write, uint64_t bytes)
+{
+	zfs_qos_bucket_t *bw = &zq->zq_bucket[write ?
+	    ZFS_QOS_WRITE_BW : ZFS_QOS_READ_BW];
+	zfs_qos_bucket_t *ops = &zq->zq_bucket[write ?
+	    ZFS_QOS_WRITE_IOPS : ZFS_QOS_READ_IOPS];
+	uint64_t bw_rate = atomic_load_64(&bw->zqb_rate);
+	uint64_t ops_rate = atomic_load_64(&ops->zqb_rate);
+	uint64_t wait = 0;
+
+	if (bw_rate == 0 && ops_rate == 0)
+		return;
+
+	hrtime_t now = gethrtime();
+	mutex_enter(&zq->zq_lock);
+	if (bw_rate != 0)
+		wait = zfs_qos_bucket_take(bw, bw_rate, now, bytes);
+	if (ops_rate != 0)
+		wait = MAX(wait, zfs_qos_bucket_take(ops, ops_rate, now, 1));
+	mutex_exit(&zq->zq_lock);
+
+	if (wait != 0)
+		zfs_sleep_until(now + USEC2NSEC(wait));
+}
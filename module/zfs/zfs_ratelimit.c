@@ -98,3 +98,18 @@ zfs_ratelimit(zfs_ratelimit_t *rl)
 
 	return (error);
 }
+
+/*
+ * Check whether events are currently being rate limited, without counting
+ * one.  The state is read without the lock, so the answer is only a hint,
+ * suitable for skipping work which would be discarded anyway.
+ *
+ * 0: If we're not rate limiting
+ * 1: If we're rate limiting.
+ */
+int
+zfs_ratelimit_exceeded(zfs_ratelimit_t *rl)
+{
+	return (rl->count >= *rl->burst &&
+	    NSEC2SEC(gethrtime() - rl->start) < rl->interval);
+}
@@ -848,10 +848,12 @@ zfs_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 	 * write needs to be there. So we write the whole block and
 	 * reduce the eof. This needs to be done within the single dmu
 	 * transaction created within vn_rdwr -> zfs_write. So a possible
-	 * new end of file is passed through in zfsvfs->z_replay_eof
+	 * new end of file is passed through in zp->z_replay_eof, which
+	 * is per znode as records of different objects may be replayed
+	 * concurrently.
 	 */
 
-	zfsvfs->z_replay_eof = 0; /* 0 means don't change end of file */
+	zp->z_replay_eof = 0; /* 0 means don't change end of file */
 
 	/* If it's a dmu_sync() block, write the whole block */
 	if (lr->lr_common.lrc_reclen == sizeof (lr_write_t)) {
@@ -861,11 +863,11 @@ zfs_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 			length = blocksize;
 		}
 		if (zp->z_size < eod)
-			zfsvfs->z_replay_eof = eod;
+			zp->z_replay_eof = eod;
 	}
 	error = zfs_write_simple(zp, data, length, offset, NULL);
+	zp->z_replay_eof = 0;	/* safety */
 	zrele(zp);
-	zfsvfs->z_replay_eof = 0;	/* safety */
 
 	return (error);
 }
@@ -893,6 +895,13 @@ zfs_replay_write2(void *arg1, void *arg2, boolean_t byteswap)
 	if ((error = zfs_zget(zfsvfs, lr->lr_foid, &zp)) != 0)
 		return (error);
 
+	/* Inline data must cover the whole file, extend it as a block. */
+	if ((zp->z_pflags & ZFS_INLINE_DATA) &&
+	    (error = zfs_sa_inline_to_blocks(zp)) != 0) {
+		zrele(zp);
+		return (error);
+	}
+
 top:
 	end = lr->lr_offset + lr->lr_length;
 	if (end > zp->z_size) {
@@ -1001,8 +1010,14 @@ zfs_replay_setattr(void *arg1, void *arg2, boolean_t byteswap)
 	} else
 		xva.xva_vattr.va_mask &= ~ATTR_XVATTR;
 
-	zfsvfs->z_fuid_replay = zfs_replay_fuid_domain(start, &start,
-	    lr->lr_uid, lr->lr_gid);
+	/*
+	 * Records without FUIDs may be replayed in parallel with others, see
+	 * zil_replay_has_fuids(), so they must leave z_fuid_replay alone.
+	 */
+	if (zfs_replay_domain_cnt(lr->lr_uid, lr->lr_gid) != 0) {
+		zfsvfs->z_fuid_replay = zfs_replay_fuid_domain(start, &start,
+		    lr->lr_uid, lr->lr_gid);
+	}
 
 #if defined(__linux__)
 	error = zfs_setattr(zp, vap, 0, kcred, zfs_init_idmap);
@@ -1010,8 +1025,10 @@ zfs_replay_setattr(void *arg1, void *arg2, boolean_t byteswap)
 	error = zfs_setattr(zp, vap, 0, kcred, NULL);
 #endif
 
-	zfs_fuid_info_free(zfsvfs->z_fuid_replay);
-	zfsvfs->z_fuid_replay = NULL;
+	if (zfsvfs->z_fuid_replay != NULL) {
+		zfs_fuid_info_free(zfsvfs->z_fuid_replay);
+		zfsvfs->z_fuid_replay = NULL;
+	}
 	zrele(zp);
 
 	return (error);
@@ -1192,10 +1209,10 @@ zfs_replay_acl(void *arg1, void *arg2, boolean_t byteswap)
 
 	error = zfs_setsecattr(zp, &vsa, 0, kcred);
 
-	if (zfsvfs->z_fuid_replay)
+	if (lr->lr_fuidcnt) {
 		zfs_fuid_info_free(zfsvfs->z_fuid_replay);
-
-	zfsvfs->z_fuid_replay = NULL;
+		zfsvfs->z_fuid_replay = NULL;
+	}
 	zrele(zp);
 
 	return (error);
@@ -109,11 +109,54 @@
  * So if the block size needs to be grown then the whole file is
  * exclusively locked, then later the caller will reduce the lock
  * range to just the range to be written using rangelock_reduce().
+ *
+ * Sharding
+ * --------
+ * All of the above is serialized by rl_lock, which becomes the bottleneck
+ * when many threads do small I/O to disjoint parts of one large file or
+ * zvol.  Once rl_lock has been found busy zfs_rangelock_shard_contention
+ * times, the next time the tree is empty the lock is switched (for good)
+ * to ZFS_RANGELOCK_BUCKETS bucket range locks, each a zfs_rangelock_t of
+ * its own.  The object is divided into regions of
+ * 1 << ZFS_RANGELOCK_REGION_SHIFT bytes, assigned round-robin to the
+ * buckets, and a range is locked in the bucket of every region it touches.
+ * Two overlapping ranges always share a region, so they still conflict
+ * in that region's bucket, while ranges in different regions usually take
+ * different bucket mutexes.
+ *
+ * A range is locked in all of its buckets at once: their mutexes are
+ * taken in bucket order, and only if none of their trees has a conflicting
+ * range is it added to all of them.  Otherwise the other mutexes are
+ * dropped and we wait on the conflicting range, marking it wanted just
+ * like the unsharded case does, so that new readers queue behind a wide
+ * writer instead of starving it.  A waiter never holds part of a range,
+ * so callers that hold one range while taking another (e.g. cloning
+ * within a file) can't deadlock against a wide lock.  The callback is run
+ * without any lock held, and run again once the range is held to check
+ * that its answer didn't change in the meantime.
  */
 
 #include <sys/zfs_context.h>
 #include <sys/zfs_rlock.h>
 
+#define	ZFS_RANGELOCK_BUCKETS		16
+#define	ZFS_RANGELOCK_REGION_SHIFT	20	/* 1MB */
+
+/*
+ * Number of times a range lock's mutex must be found busy before it is
+ * switched to bucket locks.  0 disables sharding.
+ */
+static uint_t zfs_rangelock_shard_contention = 64;
+
+typedef enum {
+	ZRL_LOCKED,	/* range was locked */
+	ZRL_BUSY,	/* nonblocking request would have had to wait */
+	ZRL_SHARDED,	/* lock was sharded while we waited, start over */
+} zfs_rangelock_status_t;
+
+static zfs_locked_range_t *zfs_rangelock_enter_sharded(zfs_rangelock_t *,
+    uint64_t, uint64_t, zfs_rangelock_type_t, boolean_t);
+
 
 /*
  * AVL comparison function used to order range locks
@@ -128,6 +171,22 @@ zfs_rangelock_compare(const void *arg1, const void *arg2)
 	return (TREE_CMP(rl1->lr_offset, rl2->lr_offset));
 }
 
+static void
+zfs_rangelock_init_impl(zfs_rangelock_t *rl, zfs_rangelock_cb_t *cb,
+    void *arg, boolean_t bucket)
+{
+	/* Wide ranges hold several bucket mutexes at once, in order. */
+	mutex_init(&rl->rl_lock, NULL,
+	    bucket ? MUTEX_NOLOCKDEP : MUTEX_DEFAULT, NULL);
+	avl_create(&rl->rl_tree, zfs_rangelock_compare,
+	    sizeof (zfs_locked_range_t), offsetof(zfs_locked_range_t, lr_node));
+	rl->rl_cb = cb;
+	rl->rl_arg = arg;
+	rl->rl_buckets = NULL;
+	rl->rl_contended = 0;
+	rl->rl_bucket = bucket;
+}
+
 /*
  * The callback is invoked when acquiring a RL_WRITER or RL_APPEND lock.
  * It must convert RL_APPEND to RL_WRITER (starting at the end of the file),
@@ -136,25 +195,55 @@ zfs_rangelock_compare(const void *arg1, const void *arg2)
 void
 zfs_rangelock_init(zfs_rangelock_t *rl, zfs_rangelock_cb_t *cb, void *arg)
 {
-	mutex_init(&rl->rl_lock, NULL, MUTEX_DEFAULT, NULL);
-	avl_create(&rl->rl_tree, zfs_rangelock_compare,
-	    sizeof (zfs_locked_range_t), offsetof(zfs_locked_range_t, lr_node));
-	rl->rl_cb = cb;
-	rl->rl_arg = arg;
+	zfs_rangelock_init_impl(rl, cb, arg, B_FALSE);
 }
 
 void
 zfs_rangelock_fini(zfs_rangelock_t *rl)
 {
+	if (rl->rl_buckets != NULL) {
+		for (int b = 0; b < ZFS_RANGELOCK_BUCKETS; b++)
+			zfs_rangelock_fini(&rl->rl_buckets[b]);
+		kmem_free(rl->rl_buckets,
+		    sizeof (zfs_rangelock_t) * ZFS_RANGELOCK_BUCKETS);
+		rl->rl_buckets = NULL;
+	}
 	mutex_destroy(&rl->rl_lock);
 	avl_destroy(&rl->rl_tree);
 }
 
+/*
+ * Switch to bucket locks if rl_lock has been contended enough.  Must be
+ * called with rl_lock held and no ranges locked in rl_tree, so nothing
+ * needs to be moved over.  Threads waiting in rl_tree's cvs notice the
+ * change when they wake up and start over.
+ */
+static boolean_t
+zfs_rangelock_maybe_shard(zfs_rangelock_t *rl)
+{
+	ASSERT(MUTEX_HELD(&rl->rl_lock));
+
+	if (rl->rl_buckets != NULL)
+		return (B_TRUE);
+	if (rl->rl_bucket || zfs_rangelock_shard_contention == 0 ||
+	    rl->rl_contended < zfs_rangelock_shard_contention ||
+	    avl_numnodes(&rl->rl_tree) != 0)
+		return (B_FALSE);
+
+	zfs_rangelock_t *buckets = kmem_alloc(
+	    sizeof (zfs_rangelock_t) * ZFS_RANGELOCK_BUCKETS, KM_SLEEP);
+	for (int b = 0; b < ZFS_RANGELOCK_BUCKETS; b++)
+		zfs_rangelock_init_impl(&buckets[b], NULL, NULL, B_TRUE);
+	membar_producer();
+	rl->rl_buckets = buckets;
+	return (B_TRUE);
+}
+
 /*
  * Check if a write lock can be grabbed.  If not, fail immediately or sleep and
  * recheck until available, depending on the value of the "nonblock" parameter.
  */
-static boolean_t
+static zfs_rangelock_status_t
 zfs_rangelock_enter_writer(zfs_rangelock_t *rl, zfs_locked_range_t *new,
     boolean_t nonblock)
 {
@@ -186,7 +275,7 @@ zfs_rangelock_enter_writer(zfs_rangelock_t *rl, zfs_locked_range_t *new,
 		 */
 		if (avl_numnodes(tree) == 0) {
 			avl_add(tree, new);
-			return (B_TRUE);
+			return (ZRL_LOCKED);
 		}
 
 		/*
@@ -207,15 +296,17 @@ zfs_rangelock_enter_writer(zfs_rangelock_t *rl, zfs_locked_range_t *new,
 			goto wait;
 
 		avl_insert(tree, new, where);
-		return (B_TRUE);
+		return (ZRL_LOCKED);
 wait:
 		if (nonblock)
-			return (B_FALSE);
+			return (ZRL_BUSY);
 		if (!lr->lr_write_wanted) {
 			cv_init(&lr->lr_write_cv, NULL, CV_DEFAULT, NULL);
 			lr->lr_write_wanted = B_TRUE;
 		}
 		cv_wait(&lr->lr_write_cv, &rl->rl_lock);
+		if (rl->rl_buckets != NULL)
+			return (ZRL_SHARDED);
 
 		/* reset to original */
 		new->lr_offset = orig_off;
@@ -399,7 +490,7 @@ zfs_rangelock_add_reader(avl_tree_t *tree, zfs_locked_range_t *new,
  * Check if a reader lock can be grabbed.  If not, fail immediately or sleep and
  * recheck until available, depending on the value of the "nonblock" parameter.
  */
-static boolean_t
+static zfs_rangelock_status_t
 zfs_rangelock_enter_reader(zfs_rangelock_t *rl, zfs_locked_range_t *new,
     boolean_t nonblock)
 {
@@ -423,13 +514,15 @@ retry:
 	if (prev && (off < prev->lr_offset + prev->lr_length)) {
 		if ((prev->lr_type == RL_WRITER) || (prev->lr_write_wanted)) {
 			if (nonblock)
-				return (B_FALSE);
+				return (ZRL_BUSY);
 			if (!prev->lr_read_wanted) {
 				cv_init(&prev->lr_read_cv,
 				    NULL, CV_DEFAULT, NULL);
 				prev->lr_read_wanted = B_TRUE;
 			}
 			cv_wait(&prev->lr_read_cv, &rl->rl_lock);
+			if (rl->rl_buckets != NULL)
+				return (ZRL_SHARDED);
 			goto retry;
 		}
 		if (off + len < prev->lr_offset + prev->lr_length)
@@ -449,13 +542,15 @@ retry:
 			goto got_lock;
 		if ((next->lr_type == RL_WRITER) || (next->lr_write_wanted)) {
 			if (nonblock)
-				return (B_FALSE);
+				return (ZRL_BUSY);
 			if (!next->lr_read_wanted) {
 				cv_init(&next->lr_read_cv,
 				    NULL, CV_DEFAULT, NULL);
 				next->lr_read_wanted = B_TRUE;
 			}
 			cv_wait(&next->lr_read_cv, &rl->rl_lock);
+			if (rl->rl_buckets != NULL)
+				return (ZRL_SHARDED);
 			goto retry;
 		}
 		if (off + len <= next->lr_offset + next->lr_length)
@@ -468,7 +563,7 @@ got_lock:
 	 * locks and bumping ref counts (r_count).
 	 */
 	zfs_rangelock_add_reader(tree, new, prev, where);
-	return (B_TRUE);
+	return (ZRL_LOCKED);
 }
 
 /*
@@ -484,9 +579,16 @@ zfs_rangelock_enter_impl(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
     zfs_rangelock_type_t type, boolean_t nonblock)
 {
 	zfs_locked_range_t *new;
+	zfs_rangelock_status_t status;
 
 	ASSERT(type == RL_READER || type == RL_WRITER || type == RL_APPEND);
 
+	if (rl->rl_buckets != NULL) {
+		membar_consumer();
+		return (zfs_rangelock_enter_sharded(rl, off, len, type,
+		    nonblock));
+	}
+
 	new = kmem_alloc(sizeof (zfs_locked_range_t), KM_SLEEP);
 	new->lr_rangelock = rl;
 	new->lr_offset = off;
@@ -498,24 +600,227 @@ zfs_rangelock_enter_impl(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
 	new->lr_proxy = B_FALSE;
 	new->lr_write_wanted = B_FALSE;
 	new->lr_read_wanted = B_FALSE;
+	new->lr_sub = NULL;
 
-	mutex_enter(&rl->rl_lock);
-	if (type == RL_READER) {
+	if (!mutex_tryenter(&rl->rl_lock)) {
+		if (!rl->rl_bucket)
+			atomic_inc_uint(&rl->rl_contended);
+		mutex_enter(&rl->rl_lock);
+	}
+	if (zfs_rangelock_maybe_shard(rl)) {
+		status = ZRL_SHARDED;
+	} else if (type == RL_READER) {
 		/*
 		 * First check for the usual case of no locks
 		 */
 		if (avl_numnodes(&rl->rl_tree) == 0) {
 			avl_add(&rl->rl_tree, new);
-		} else if (!zfs_rangelock_enter_reader(rl, new, nonblock)) {
-			kmem_free(new, sizeof (*new));
-			new = NULL;
+			status = ZRL_LOCKED;
+		} else {
+			status = zfs_rangelock_enter_reader(rl, new, nonblock);
 		}
-	} else if (!zfs_rangelock_enter_writer(rl, new, nonblock)) {
-		kmem_free(new, sizeof (*new));
-		new = NULL;
+	} else {
+		status = zfs_rangelock_enter_writer(rl, new, nonblock);
 	}
 	mutex_exit(&rl->rl_lock);
-	return (new);
+
+	if (status == ZRL_LOCKED)
+		return (new);
+	kmem_free(new, sizeof (*new));
+	if (status == ZRL_SHARDED) {
+		return (zfs_rangelock_enter_sharded(rl, off, len, type,
+		    nonblock));
+	}
+	return (NULL);
+}
+
+/*
+ * Return the mask of the buckets covering the range.
+ */
+static uint_t
+zfs_rangelock_buckets(uint64_t off, uint64_t len)
+{
+	uint64_t first = off >> ZFS_RANGELOCK_REGION_SHIFT;
+	uint64_t last = (off + MAX(len, 1) - 1) >> ZFS_RANGELOCK_REGION_SHIFT;
+	uint_t mask = 0;
+
+	if (last - first >= ZFS_RANGELOCK_BUCKETS - 1)
+		return ((1U << ZFS_RANGELOCK_BUCKETS) - 1);
+	for (uint64_t r = first; r <= last; r++)
+		mask |= 1U << (r % ZFS_RANGELOCK_BUCKETS);
+	return (mask);
+}
+
+static void
+zfs_rangelock_exit_buckets(zfs_locked_range_t *lr)
+{
+	for (int b = 0; b < ZFS_RANGELOCK_BUCKETS; b++) {
+		if (lr->lr_sub[b] != NULL) {
+			zfs_rangelock_exit(lr->lr_sub[b]);
+			lr->lr_sub[b] = NULL;
+		}
+	}
+}
+
+/*
+ * Return a range of a bucket that the given new range has to wait for, or
+ * NULL if there is none.  These are the same conflicts
+ * zfs_rangelock_enter_writer() and zfs_rangelock_enter_reader() wait for.
+ */
+static zfs_locked_range_t *
+zfs_rangelock_conflict(zfs_rangelock_t *rl, zfs_locked_range_t *new)
+{
+	avl_tree_t *tree = &rl->rl_tree;
+	uint64_t off = new->lr_offset;
+	uint64_t len = new->lr_length;
+	zfs_locked_range_t *lr;
+	avl_index_t where;
+
+	ASSERT(MUTEX_HELD(&rl->rl_lock));
+
+	lr = avl_find(tree, new, &where);
+	if (lr == NULL) {
+		lr = avl_nearest(tree, where, AVL_BEFORE);
+		if (lr == NULL || lr->lr_offset + lr->lr_length <= off)
+			lr = avl_nearest(tree, where, AVL_AFTER);
+	}
+	for (; lr != NULL && lr->lr_offset < off + len;
+	    lr = AVL_NEXT(tree, lr)) {
+		if (new->lr_type == RL_WRITER || lr->lr_type == RL_WRITER ||
+		    lr->lr_write_wanted)
+			return (lr);
+	}
+	return (NULL);
+}
+
+/*
+ * Add a range to a bucket that zfs_rangelock_conflict() found free.
+ */
+static void
+zfs_rangelock_add(zfs_rangelock_t *rl, zfs_locked_range_t *new)
+{
+	avl_tree_t *tree = &rl->rl_tree;
+	zfs_locked_range_t *prev;
+	avl_index_t where;
+
+	ASSERT(MUTEX_HELD(&rl->rl_lock));
+
+	prev = avl_find(tree, new, &where);
+	if (new->lr_type == RL_WRITER) {
+		ASSERT3P(prev, ==, NULL);
+		avl_insert(tree, new, where);
+		return;
+	}
+	if (prev == NULL)
+		prev = avl_nearest(tree, where, AVL_BEFORE);
+	zfs_rangelock_add_reader(tree, new, prev, where);
+}
+
+/*
+ * Lock a range of a sharded range lock, see "Sharding" above.
+ */
+static zfs_locked_range_t *
+zfs_rangelock_enter_sharded(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
+    zfs_rangelock_type_t type, boolean_t nonblock)
+{
+	zfs_rangelock_t *buckets = rl->rl_buckets;
+	zfs_locked_range_t *new;
+
+	new = kmem_zalloc(sizeof (zfs_locked_range_t), KM_SLEEP);
+	new->lr_rangelock = rl;
+	new->lr_count = 1;
+	new->lr_sub = kmem_zalloc(sizeof (zfs_locked_range_t *) *
+	    ZFS_RANGELOCK_BUCKETS, KM_SLEEP);
+	if (len + off < off)	/* overflow */
+		len = UINT64_MAX - off;
+
+	for (;;) {
+		new->lr_offset = off;
+		new->lr_length = len;
+		new->lr_type = type;
+		if (type != RL_READER && rl->rl_cb != NULL)
+			rl->rl_cb(new, rl->rl_arg);
+		ASSERT(new->lr_type == RL_READER || new->lr_type == RL_WRITER);
+
+		uint_t mask = zfs_rangelock_buckets(new->lr_offset,
+		    new->lr_length);
+		zfs_locked_range_t *lr = NULL;
+		int b;
+
+		for (b = 0; b < ZFS_RANGELOCK_BUCKETS; b++) {
+			if (!(mask & (1U << b)))
+				continue;
+			mutex_enter(&buckets[b].rl_lock);
+			lr = zfs_rangelock_conflict(&buckets[b], new);
+			if (lr != NULL)
+				break;
+		}
+
+		if (lr != NULL) {
+			for (int i = 0; i < b; i++) {
+				if (mask & (1U << i))
+					mutex_exit(&buckets[i].rl_lock);
+			}
+			if (nonblock) {
+				mutex_exit(&buckets[b].rl_lock);
+				kmem_free(new->lr_sub,
+				    sizeof (zfs_locked_range_t *) *
+				    ZFS_RANGELOCK_BUCKETS);
+				kmem_free(new, sizeof (*new));
+				return (NULL);
+			}
+
+			/* Wait for the conflicting range, holding nothing. */
+			if (new->lr_type == RL_WRITER) {
+				if (!lr->lr_write_wanted) {
+					cv_init(&lr->lr_write_cv, NULL,
+					    CV_DEFAULT, NULL);
+					lr->lr_write_wanted = B_TRUE;
+				}
+				cv_wait(&lr->lr_write_cv, &buckets[b].rl_lock);
+			} else {
+				if (!lr->lr_read_wanted) {
+					cv_init(&lr->lr_read_cv, NULL,
+					    CV_DEFAULT, NULL);
+					lr->lr_read_wanted = B_TRUE;
+				}
+				cv_wait(&lr->lr_read_cv, &buckets[b].rl_lock);
+			}
+			mutex_exit(&buckets[b].rl_lock);
+			continue;
+		}
+
+		for (b = 0; b < ZFS_RANGELOCK_BUCKETS; b++) {
+			if (!(mask & (1U << b)))
+				continue;
+			zfs_locked_range_t *sub = kmem_zalloc(
+			    sizeof (zfs_locked_range_t), KM_SLEEP);
+			sub->lr_rangelock = &buckets[b];
+			sub->lr_offset = new->lr_offset;
+			sub->lr_length = new->lr_length;
+			sub->lr_count = 1;
+			sub->lr_type = new->lr_type;
+			zfs_rangelock_add(&buckets[b], sub);
+			new->lr_sub[b] = sub;
+			mutex_exit(&buckets[b].rl_lock);
+		}
+
+		if (type == RL_READER || rl->rl_cb == NULL)
+			return (new);
+
+		/* Check the callback still agrees, now we hold it. */
+		zfs_locked_range_t check = {
+			.lr_offset = off,
+			.lr_length = len,
+			.lr_type = type,
+		};
+		rl->rl_cb(&check, rl->rl_arg);
+		if (check.lr_offset == new->lr_offset &&
+		    check.lr_length == new->lr_length)
+			return (new);
+
+		zfs_rangelock_exit_buckets(new);
+	}
 }
 
 zfs_locked_range_t *
@@ -623,6 +928,14 @@ zfs_rangelock_exit(zfs_locked_range_t *lr)
 	ASSERT(lr->lr_count == 1 || lr->lr_count == 0);
 	ASSERT(!lr->lr_proxy);
 
+	if (lr->lr_sub != NULL) {
+		zfs_rangelock_exit_buckets(lr);
+		kmem_free(lr->lr_sub,
+		    sizeof (zfs_locked_range_t *) * ZFS_RANGELOCK_BUCKETS);
+		kmem_free(lr, sizeof (zfs_locked_range_t));
+		return;
+	}
+
 	/*
 	 * The free list is used to defer the cv_destroy() and
 	 * subsequent kmem_free until after the mutex is dropped.
@@ -646,6 +959,8 @@ zfs_rangelock_exit(zfs_locked_range_t *lr)
 		 */
 		zfs_rangelock_exit_reader(rl, lr, &free_list);
 	}
+	if (rl->rl_contended >= zfs_rangelock_shard_contention)
+		(void) zfs_rangelock_maybe_shard(rl);
 	mutex_exit(&rl->rl_lock);
 
 	while ((free_lr = list_remove_head(&free_list)) != NULL)
@@ -664,6 +979,23 @@ zfs_rangelock_reduce(zfs_locked_range_t *lr, uint64_t off, uint64_t len)
 {
 	zfs_rangelock_t *rl = lr->lr_rangelock;
 
+	if (lr->lr_sub != NULL) {
+		uint_t mask = zfs_rangelock_buckets(off, len);
+		for (int b = 0; b < ZFS_RANGELOCK_BUCKETS; b++) {
+			if (lr->lr_sub[b] == NULL)
+				continue;
+			if (mask & (1U << b)) {
+				zfs_rangelock_reduce(lr->lr_sub[b], off, len);
+			} else {
+				zfs_rangelock_exit(lr->lr_sub[b]);
+				lr->lr_sub[b] = NULL;
+			}
+		}
+		lr->lr_offset = off;
+		lr->lr_length = len;
+		return;
+	}
+
 	/* Ensure there are no other locks */
 	ASSERT3U(avl_numnodes(&rl->rl_tree), ==, 1);
 	ASSERT3U(lr->lr_offset, ==, 0);
@@ -690,3 +1022,6 @@ EXPORT_SYMBOL(zfs_rangelock_tryenter);
 EXPORT_SYMBOL(zfs_rangelock_exit);
 EXPORT_SYMBOL(zfs_rangelock_reduce);
 #endif
+
+ZFS_MODULE_PARAM(zfs, zfs_, rangelock_shard_contention, UINT, ZMOD_RW,
+	"Contention on a file's range lock before it is split into buckets");
@@ -29,6 +29,7 @@
 #include <sys/zfs_acl.h>
 #include <sys/zfs_sa.h>
 #include <sys/dmu_objset.h>
+#include <sys/dsl_dataset.h>
 #include <sys/sa_impl.h>
 #include <sys/zfeature.h>
 
@@ -68,6 +69,7 @@ const sa_attr_reg_t zfs_attr_table[ZPL_END+1] = {
 	{"ZPL_DACL_ACES", 0, SA_ACL, 0},
 	{"ZPL_DXATTR", 0, SA_UINT8_ARRAY, 0},
 	{"ZPL_PROJID", sizeof (uint64_t), SA_UINT64_ARRAY, 0},
+	{"ZPL_INLINE_DATA", 0, SA_UINT8_ARRAY, 0},
 	{NULL, 0, 0, 0}
 };
 
@@ -75,6 +77,12 @@ const sa_attr_reg_t zfs_attr_table[ZPL_END+1] = {
 #ifdef _KERNEL
 static int zfs_zil_saxattr = 1;
 
+/*
+ * Regular files up to this size may keep their data in the bonus buffer of
+ * their dnode, see zfs_sa_inline_fits().  0 disables this.
+ */
+static uint_t zfs_inline_data_max = 0;
+
 int
 zfs_sa_readlink(znode_t *zp, zfs_uio_t *uio)
 {
@@ -457,9 +465,225 @@ zfs_sa_upgrade_txholds(dmu_tx_t *tx, znode_t *zp)
 	}
 }
 
+/*
+ * Returns B_TRUE if the data of a file of the given size can be stored
+ * inline, in the ZPL_INLINE_DATA system attribute.  The attribute has to
+ * fit in the bonus buffer next to all other attributes of the file, so
+ * this effectively requires a dnodesize larger than legacy.
+ *
+ * While ZFS_INLINE_DATA is set, the data of the file is exactly the
+ * z_size bytes of the attribute, and the object has no data blocks.  All
+ * changes to inline data, and to the flag, are made under a range lock of
+ * the whole file, and a file is only made inline while it has no cached
+ * pages.
+ */
+boolean_t
+zfs_sa_inline_fits(znode_t *zp, uint64_t size)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+
+	if (size == 0 || size > MIN(zfs_inline_data_max,
+	    DN_BONUS_SIZE(DNODE_MAX_SIZE)))
+		return (B_FALSE);
+	if (!zp->z_is_sa || !S_ISREG(zp->z_mode))
+		return (B_FALSE);
+	if (!spa_feature_is_enabled(dmu_objset_spa(zfsvfs->z_os),
+	    SPA_FEATURE_INLINE_DATA))
+		return (B_FALSE);
+
+	return (!sa_attr_would_spill(zp->z_sa_hdl, SA_ZPL_INLINE_DATA(zfsvfs),
+	    size));
+}
+
+/*
+ * Copy len bytes at offset off of the inline data of the file into buf.
+ */
+int
+zfs_sa_inline_read(znode_t *zp, void *buf, uint64_t off, uint64_t len)
+{
+	sa_bulk_attr_t bulk;
+	int error;
+
+	ASSERT(zp->z_pflags & ZFS_INLINE_DATA);
+
+	bulk.sa_attr = SA_ZPL_INLINE_DATA(ZTOZSB(zp));
+	bulk.sa_data = NULL;
+	bulk.sa_length = 0;
+	bulk.sa_data_func = NULL;
+
+	sa_handle_lock(zp->z_sa_hdl);
+	error = sa_bulk_lookup_locked(zp->z_sa_hdl, &bulk, 1);
+	if (error != 0 || off + len > bulk.sa_size)
+		error = SET_ERROR(EIO);
+	else
+		memcpy(buf, (char *)bulk.sa_addr + off, len);
+	sa_handle_unlock(zp->z_sa_hdl);
+
+	return (error);
+}
+
+/*
+ * Replace the inline data of the file with size bytes from buf, and set
+ * ZFS_INLINE_DATA.  The caller updates the file size.
+ */
+void
+zfs_sa_inline_update(znode_t *zp, const void *buf, uint64_t size,
+    dmu_tx_t *tx)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	dsl_dataset_t *ds = dmu_objset_ds(zfsvfs->z_os);
+	sa_bulk_attr_t bulk[2];
+	int count = 0;
+
+	ASSERT3U(size, >, 0);
+	ASSERT3U(size, <=, SA_ATTR_MAX_LEN);
+
+	zp->z_pflags |= ZFS_INLINE_DATA;
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_INLINE_DATA(zfsvfs), NULL,
+	    (void *)buf, size);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_FLAGS(zfsvfs), NULL,
+	    &zp->z_pflags, 8);
+	VERIFY0(sa_bulk_update(zp->z_sa_hdl, bulk, count, tx));
+
+	ds->ds_feature_activation[SPA_FEATURE_INLINE_DATA] = (void *)B_TRUE;
+}
+
+/*
+ * Drop the inline data of the file, and clear ZFS_INLINE_DATA.
+ */
+void
+zfs_sa_inline_remove(znode_t *zp, dmu_tx_t *tx)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+
+	ASSERT(zp->z_pflags & ZFS_INLINE_DATA);
+
+	VERIFY0(sa_remove(zp->z_sa_hdl, SA_ZPL_INLINE_DATA(zfsvfs), tx));
+	zp->z_pflags &= ~ZFS_INLINE_DATA;
+	VERIFY0(sa_update(zp->z_sa_hdl, SA_ZPL_FLAGS(zfsvfs), &zp->z_pflags,
+	    sizeof (zp->z_pflags), tx));
+}
+
+/*
+ * Move the inline data of the file to a data block, for the operations
+ * which only work on data blocks.  No log record is needed, the contents
+ * of the file do not change.  The caller holds a range lock of the whole
+ * file.
+ */
+int
+zfs_sa_inline_to_blocks_locked(znode_t *zp)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	uint64_t size = zp->z_size;
+	uint64_t blksz;
+	u_longlong_t dummy;
+	dmu_tx_t *tx;
+	void *buf;
+	int error;
+
+	ASSERT(zp->z_pflags & ZFS_INLINE_DATA);
+
+	buf = kmem_alloc(size, KM_SLEEP);
+	error = zfs_sa_inline_read(zp, buf, 0, size);
+	if (error != 0)
+		goto out;
+
+	tx = dmu_tx_create(zfsvfs->z_os);
+	dmu_tx_hold_sa(tx, zp->z_sa_hdl, B_TRUE);
+	dmu_tx_hold_write(tx, zp->z_id, 0, size);
+	error = dmu_tx_assign(tx, DMU_TX_WAIT);
+	if (error != 0) {
+		dmu_tx_abort(tx);
+		goto out;
+	}
+
+	/*
+	 * The object has no blocks yet, so pick the block size the file
+	 * would have had if it had been written normally.
+	 */
+	blksz = MIN(P2ROUNDUP(size, SPA_MINBLOCKSIZE), zfsvfs->z_max_blksz);
+	if (blksz > zp->z_blksz) {
+		VERIFY0(dmu_object_set_blocksize(zfsvfs->z_os, zp->z_id,
+		    blksz, 0, tx));
+		dmu_object_size_from_db(sa_get_db(zp->z_sa_hdl),
+		    &zp->z_blksz, &dummy);
+	}
+
+	dmu_write(zfsvfs->z_os, zp->z_id, 0, size, buf, tx);
+	zfs_sa_inline_remove(zp, tx);
+	dmu_tx_commit(tx);
+out:
+	kmem_free(buf, size);
+	return (error);
+}
+
+/*
+ * As zfs_sa_inline_to_blocks_locked(), taking the range lock.  Does nothing
+ * if the file has no inline data.
+ */
+int
+zfs_sa_inline_to_blocks(znode_t *zp)
+{
+	zfs_locked_range_t *lr;
+	int error = 0;
+
+	lr = zfs_rangelock_enter(&zp->z_rangelock, 0, UINT64_MAX, RL_WRITER);
+	if (zp->z_pflags & ZFS_INLINE_DATA)
+		error = zfs_sa_inline_to_blocks_locked(zp);
+	zfs_rangelock_exit(lr);
+
+	return (error);
+}
+
+/*
+ * Prepare a file with inline data for zfs_freesp(), which only works on
+ * data blocks.  A truncation to zero just drops the inline data, anything
+ * else moves it to a block first.
+ */
+int
+zfs_sa_inline_freesp(znode_t *zp, uint64_t off, uint64_t len)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	zfs_locked_range_t *lr;
+	dmu_tx_t *tx;
+	int error = 0;
+
+	lr = zfs_rangelock_enter(&zp->z_rangelock, 0, UINT64_MAX, RL_WRITER);
+	if (!(zp->z_pflags & ZFS_INLINE_DATA)) {
+		zfs_rangelock_exit(lr);
+		return (0);
+	}
+
+	if (off != 0 || len != 0) {
+		error = zfs_sa_inline_to_blocks_locked(zp);
+		zfs_rangelock_exit(lr);
+		return (error);
+	}
+
+	tx = dmu_tx_create(zfsvfs->z_os);
+	dmu_tx_hold_sa(tx, zp->z_sa_hdl, B_TRUE);
+	error = dmu_tx_assign(tx, DMU_TX_WAIT);
+	if (error != 0) {
+		dmu_tx_abort(tx);
+		zfs_rangelock_exit(lr);
+		return (error);
+	}
+	zfs_sa_inline_remove(zp, tx);
+	zp->z_size = 0;
+	VERIFY0(sa_update(zp->z_sa_hdl, SA_ZPL_SIZE(zfsvfs), &zp->z_size,
+	    sizeof (zp->z_size), tx));
+	dmu_tx_commit(tx);
+	zfs_rangelock_exit(lr);
+
+	return (0);
+}
+
 ZFS_MODULE_PARAM(zfs, zfs_, zil_saxattr, INT, ZMOD_RW,
 	"Disable xattr=sa extended attribute logging in ZIL by settng 0.");
 
+ZFS_MODULE_PARAM(zfs, zfs_, inline_data_max, UINT, ZMOD_RW,
+	"Largest file size in bytes to store in the dnode, 0 to disable");
+
 EXPORT_SYMBOL(zfs_attr_table);
 EXPORT_SYMBOL(zfs_sa_readlink);
 EXPORT_SYMBOL(zfs_sa_symlink);
@@ -469,5 +693,12 @@ EXPORT_SYMBOL(zfs_sa_get_xattr);
 EXPORT_SYMBOL(zfs_sa_set_xattr);
 EXPORT_SYMBOL(zfs_sa_upgrade);
 EXPORT_SYMBOL(zfs_sa_upgrade_txholds);
+EXPORT_SYMBOL(zfs_sa_inline_fits);
+EXPORT_SYMBOL(zfs_sa_inline_read);
+EXPORT_SYMBOL(zfs_sa_inline_update);
+EXPORT_SYMBOL(zfs_sa_inline_remove);
+EXPORT_SYMBOL(zfs_sa_inline_to_blocks_locked);
+EXPORT_SYMBOL(zfs_sa_inline_to_blocks);
+EXPORT_SYMBOL(zfs_sa_inline_freesp);
 
 #endif
@@ -52,6 +52,8 @@
 #include <sys/spa.h>
 #include <sys/txg.h>
 #include <sys/dbuf.h>
+#include <sys/dmu_impl.h>
+#include <sys/abd.h>
 #include <sys/policy.h>
 #include <sys/zfeature.h>
 #include <sys/zfs_vnops.h>
@@ -101,8 +103,63 @@ static int zfs_dio_strict = 0;
  */
 static uint64_t zfs_vnops_read_chunk_size = 1024 * 1024;
 
+/*
+ * Pick the block size of each file from how it is written while it still
+ * fits in its first block.  Files that are only appended to grow up to the
+ * "recordsize" property as usual, while overwrites within the file cap the
+ * block size at the largest overwrite seen, so that small random updates
+ * do not read-modify-write whole records.
+ */
+static int zfs_recordsize_auto = 0;
+
+/*
+ * Write out the full blocks of files written sequentially as soon as a
+ * write has filled them, while their txg is still open, rather than leaving
+ * all the data to spa_sync().  See zfs_write_early().
+ */
+static int zfs_early_writeout = 0;
+
+/*
+ * Largest block size the file may still grow to.
+ */
+static uint64_t
+zfs_max_file_blksz(znode_t *zp)
+{
+	uint64_t max_blksz = ZTOZSB(zp)->z_max_blksz;
+
+	if (zfs_recordsize_auto && zp->z_auto_blksz != 0)
+		max_blksz = MIN(max_blksz, zp->z_auto_blksz);
+
+	return (max_blksz);
+}
+
+/*
+ * Note an overwrite of n bytes for zfs_recordsize_auto.  Once the file
+ * outgrows its first block, the block size is fixed, so only the writes
+ * until then matter.
+ */
+static void
+zfs_note_overwrite(znode_t *zp, uint64_t n)
+{
+	uint64_t blksz = MAX(PAGE_SIZE, 1ULL << highbit64(n - 1));
+
+	blksz = MIN(blksz, ZTOZSB(zp)->z_max_blksz);
+	if (blksz > zp->z_auto_blksz)
+		zp->z_auto_blksz = blksz;
+}
+
 int
 zfs_fsync(znode_t *zp, int syncflag, cred_t *cr)
+{
+	return (zfs_fsync_range(zp, syncflag, 0, UINT64_MAX, cr));
+}
+
+/*
+ * Only the data in [off, off + len) has to be made stable.
+ */
+int
+zfs_fsync_range(znode_t *zp, int syncflag, uint64_t off, uint64_t len,
+    cred_t *cr)
 {
 	int error = 0;
 	zfsvfs_t *zfsvfs = ZTOZSB(zp);
@@ -110,9 +167,12 @@ zfs_fsync(znode_t *zp, int syncflag, cred_t *cr)
 	if (zfsvfs->z_os->os_sync != ZFS_SYNC_DISABLED) {
 		if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
 			return (error);
+		hrtime_t start = dataset_kstats_start(&zfsvfs->z_kstat);
 		atomic_inc_32(&zp->z_sync_writes_cnt);
-		zil_commit(zfsvfs->z_log, zp->z_id);
+		zil_commit_range(zfsvfs->z_log, zp->z_id, off, len);
 		atomic_dec_32(&zp->z_sync_writes_cnt);
+		dataset_kstats_update_histograms(&zfsvfs->z_kstat,
+		    DATASET_OP_SYNC, 0, start);
 		zfs_exit(zfsvfs, FTAG);
 	}
 	return (error);
@@ -148,6 +208,13 @@ zfs_holey_common(znode_t *zp, ulong_t cmd, loff_t *off)
 		zn_flush_cached_data(zp, B_TRUE);
 
 	lr = zfs_rangelock_enter(&zp->z_rangelock, 0, UINT64_MAX, RL_READER);
+	if (zp->z_pflags & ZFS_INLINE_DATA) {
+		/* Inline data has no holes, just the virtual one at EOF */
+		zfs_rangelock_exit(lr);
+		if (hole)
+			*off = file_sz;
+		return (0);
+	}
 	error = dmu_offset_next(ZTOZSB(zp)->z_os, zp->z_id, hole, &noff);
 	zfs_rangelock_exit(lr);
 
@@ -303,6 +370,30 @@ out:
 	return (error);
 }
 
+/*
+ * Read from a file whose data is stored inline, see zfs_sa_inline_fits().
+ * Direct I/O does not apply, there is no data block to read directly.
+ */
+static int
+zfs_read_inline(znode_t *zp, zfs_uio_t *uio)
+{
+	ssize_t n = MIN(zfs_uio_resid(uio), zp->z_size - zfs_uio_offset(uio));
+	void *buf;
+	int error;
+
+#ifdef UIO_NOCOPY
+	if (zfs_uio_segflg(uio) == UIO_NOCOPY)
+		return (mappedread_sf(zp, n, uio));
+#endif
+	buf = kmem_alloc(n, KM_SLEEP);
+	error = zfs_sa_inline_read(zp, buf, zfs_uio_offset(uio), n);
+	if (error == 0)
+		error = zfs_uiomove(buf, n, UIO_READ, uio);
+	kmem_free(buf, n);
+
+	return (error);
+}
+
 /*
  * Read bytes from specified file into supplied buffer.
  *
@@ -331,6 +422,7 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	zfsvfs_t *zfsvfs = ZTOZSB(zp);
 	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
 		return (error);
+	hrtime_t start = dataset_kstats_start(&zfsvfs->z_kstat);
 
 	if (zp->z_pflags & ZFS_AV_QUARANTINED) {
 		zfs_exit(zfsvfs, FTAG);
@@ -359,6 +451,8 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		return (0);
 	}
 
+	zfs_qos_charge(&zfsvfs->z_os->os_qos, B_FALSE, zfs_uio_resid(uio));
+
 #ifdef FRSYNC
 	/*
 	 * If we're in FRSYNC mode, sync out this znode before reading it.
@@ -374,6 +468,21 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	    (frsync || zfsvfs->z_os->os_sync == ZFS_SYNC_ALWAYS))
 		zil_commit(zfsvfs->z_log, zp->z_id);
 
+	/*
+	 * Cached pages are only kept coherent with data blocks, so inline
+	 * data is moved to a block before any page is created for it.
+	 */
+	if (zp->z_pflags & ZFS_INLINE_DATA) {
+		boolean_t to_blocks = zn_has_cached_data(zp, 0, zp->z_size - 1);
+#ifdef UIO_NOCOPY
+		to_blocks |= (zfs_uio_segflg(uio) == UIO_NOCOPY);
+#endif
+		if (to_blocks && (error = zfs_sa_inline_to_blocks(zp)) != 0) {
+			zfs_exit(zfsvfs, FTAG);
+			return (error);
+		}
+	}
+
 	/*
 	 * Lock the range against changes.
 	 */
@@ -390,6 +499,17 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	}
 	ASSERT(zfs_uio_offset(uio) < zp->z_size);
 
+	if (zp->z_pflags & ZFS_INLINE_DATA) {
+		ssize_t resid = zfs_uio_resid(uio);
+
+		error = zfs_read_inline(zp, uio);
+		resid -= zfs_uio_resid(uio);
+		dataset_kstats_update_read_kstats(&zfsvfs->z_kstat, resid);
+		dataset_kstats_update_histograms(&zfsvfs->z_kstat,
+		    DATASET_OP_READ, resid, start);
+		goto out;
+	}
+
 	/*
 	 * Setting up Direct I/O if requested.
 	 */
@@ -517,6 +637,8 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	int64_t nread = start_resid - n;
 
 	dataset_kstats_update_read_kstats(&zfsvfs->z_kstat, nread);
+	dataset_kstats_update_histograms(&zfsvfs->z_kstat, DATASET_OP_READ,
+	    nread, start);
 out:
 	zfs_rangelock_exit(lr);
 
@@ -534,6 +656,199 @@ out:
 	return (error);
 }
 
+/*
+ * State of a Direct I/O read issued by zfs_read_async().
+ */
+typedef struct zfs_read_async {
+	znode_t			*zra_zp;
+	zfs_locked_range_t	*zra_lr;
+	zfs_uio_t		zra_uio;	/* owns the pinned pages */
+	abd_t			*zra_abd;	/* the pinned pages */
+	uint64_t		zra_offset;
+	ssize_t			zra_size;
+	int			zra_error;	/* error issuing the reads */
+	zfs_read_done_func_t	*zra_done;
+	void			*zra_arg;
+} zfs_read_async_t;
+
+/*
+ * Each read issued by zfs_read_async() is counted in z_async_reads until
+ * it completes, and zfsvfs_teardown() waits for them with this once it
+ * holds the teardown lock.  That keeps the zfsvfs, and the objset and
+ * SA handles the reads use, from being torn down under them, while the
+ * reads themselves do not hold the teardown lock, which is owned by a
+ * thread.
+ */
+void
+zfs_read_async_wait(zfsvfs_t *zfsvfs)
+{
+	mutex_enter(&zfsvfs->z_async_lock);
+	while (zfsvfs->z_async_reads > 0)
+		cv_wait(&zfsvfs->z_async_cv, &zfsvfs->z_async_lock);
+	mutex_exit(&zfsvfs->z_async_lock);
+}
+
+static void
+zfs_read_async_finish(zfs_read_async_t *zra, int error)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zra->zra_zp);
+
+	if (error == ECKSUM)
+		error = SET_ERROR(EIO);
+	if (error == 0)
+		dataset_kstats_update_read_kstats(&zfsvfs->z_kstat,
+		    zra->zra_size);
+
+	abd_free(zra->zra_abd);
+	zfs_rangelock_exit(zra->zra_lr);
+	zfs_uio_free_dio_pages(&zra->zra_uio, UIO_READ);
+
+	/* The caller may release the file, and so the znode, in done. */
+	zra->zra_done(zra->zra_arg, error == 0 ? zra->zra_size : 0, error);
+	kmem_free(zra, sizeof (*zra));
+
+	mutex_enter(&zfsvfs->z_async_lock);
+	if (--zfsvfs->z_async_reads == 0)
+		cv_broadcast(&zfsvfs->z_async_cv);
+	mutex_exit(&zfsvfs->z_async_lock);
+}
+
+/*
+ * A Direct I/O read that failed checksum verification is suspicious, as
+ * the buffer could have been changed while the I/O was in flight.  Like
+ * zfs_read() does, read it again through the ARC, into the pinned pages
+ * through a bounce buffer of at most zfs_vnops_read_chunk_size bytes.
+ * The read is still counted in z_async_reads, so the file system cannot
+ * be torn down meanwhile.
+ */
+static void
+zfs_read_async_retry(void *arg)
+{
+	zfs_read_async_t *zra = arg;
+	znode_t *zp = zra->zra_zp;
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	size_t chunk = MIN(zra->zra_size, MAX(zfs_vnops_read_chunk_size,
+	    PAGESIZE));
+	void *buf = vmem_alloc(chunk, KM_SLEEP);
+	int error = 0;
+
+	for (size_t off = 0; off < zra->zra_size && error == 0; off += chunk) {
+		size_t n = MIN(chunk, zra->zra_size - off);
+
+		error = dmu_read(zfsvfs->z_os, zp->z_id, zra->zra_offset + off,
+		    n, buf, DMU_READ_PREFETCH | DMU_UNCACHEDIO);
+		if (error == 0)
+			abd_copy_from_buf_off(zra->zra_abd, buf, off, n);
+	}
+	vmem_free(buf, chunk);
+	zfs_read_async_finish(zra, error);
+}
+
+static void
+zfs_read_async_done(zio_t *zio)
+{
+	zfs_read_async_t *zra = zio->io_private;
+	int error = zra->zra_error != 0 ? zra->zra_error : zio->io_error;
+
+	/* The retry does synchronous reads, so it can't be done here. */
+	if (error == ECKSUM && zra->zra_error == 0) {
+		(void) taskq_dispatch(system_taskq, zfs_read_async_retry, zra,
+		    TQ_SLEEP);
+		return;
+	}
+	zfs_read_async_finish(zra, error);
+}
+
+/*
+ * Asynchronous version of zfs_read() for Direct I/O.  It issues the reads
+ * and returns without waiting for them, so that a single thread can have
+ * many requests in flight.  The done callback is called with the number
+ * of bytes read or an error once the reads complete, possibly from the
+ * I/O completion context.
+ *
+ * Only reads that qualify for Direct I/O as a whole, fully page aligned
+ * and within the file, are handled this way.  For all others EOPNOTSUPP
+ * is returned with uio left untouched, so zfs_read() can be used instead.
+ * Any other error is returned without calling done.
+ */
+int
+zfs_read_async(znode_t *zp, zfs_uio_t *uio, int ioflag,
+    zfs_read_done_func_t *done, void *arg)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	int error;
+
+	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
+		return (error);
+
+	if ((zp->z_pflags & ZFS_AV_QUARANTINED) || Z_ISDIR(ZTOTYPE(zp)) ||
+	    zfs_uio_offset(uio) < (offset_t)0 || zfs_uio_resid(uio) == 0 ||
+	    (zfsvfs->z_log && zfsvfs->z_os->os_sync == ZFS_SYNC_ALWAYS)) {
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(EOPNOTSUPP));
+	}
+
+	zfs_locked_range_t *lr = zfs_rangelock_enter(&zp->z_rangelock,
+	    zfs_uio_offset(uio), zfs_uio_resid(uio), RL_READER);
+
+	uint64_t offset = zfs_uio_offset(uio);
+	ssize_t n = zfs_uio_resid(uio);
+	if (offset + n > zp->z_size || n > DMU_MAX_ACCESS ||
+	    (zp->z_pflags & ZFS_INLINE_DATA)) {
+		zfs_rangelock_exit(lr);
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(EOPNOTSUPP));
+	}
+
+	error = zfs_setup_direct(zp, uio, UIO_READ, &ioflag);
+	if (error != 0 || !(uio->uio_extflg & UIO_DIRECT)) {
+		zfs_rangelock_exit(lr);
+		zfs_exit(zfsvfs, FTAG);
+		return (error != 0 ? error : SET_ERROR(EOPNOTSUPP));
+	}
+
+	/*
+	 * Charge the read only now that it can no longer fall back to
+	 * zfs_read(), which would charge it again.  The range lock is held
+	 * until the read completes anyway.
+	 */
+	zfs_qos_charge(&zfsvfs->z_os->os_qos, B_FALSE, n);
+
+	zfs_read_async_t *zra = kmem_zalloc(sizeof (*zra), KM_SLEEP);
+	zra->zra_zp = zp;
+	zra->zra_lr = lr;
+	zra->zra_uio = *uio;
+	zra->zra_abd = abd_alloc_from_pages(uio->uio_dio.pages, 0, n);
+	zra->zra_offset = offset;
+	zra->zra_size = n;
+	zra->zra_done = done;
+	zra->zra_arg = arg;
+
+	mutex_enter(&zfsvfs->z_async_lock);
+	zfsvfs->z_async_reads++;
+	mutex_exit(&zfsvfs->z_async_lock);
+
+	ZFS_ACCESSTIME_STAMP(zfsvfs, zp);
+
+	zio_t *rio = zio_root(zfsvfs->z_os->os_spa, zfs_read_async_done, zra,
+	    ZIO_FLAG_CANFAIL);
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)sa_get_db(zp->z_sa_hdl);
+	DB_DNODE_ENTER(db);
+	zra->zra_error = dmu_read_abd_nowait(DB_DNODE(db), offset, n,
+	    zra->zra_abd, DMU_READ_PREFETCH | DMU_UNCACHEDIO | DMU_DIRECTIO,
+	    rio);
+	DB_DNODE_EXIT(db);
+
+	/*
+	 * The read may complete, and the caller release the file, as soon as
+	 * it is issued, so zp must not be used past this point.  The zfsvfs
+	 * stays valid as teardown waits for our zfs_exit().
+	 */
+	zio_nowait(rio);
+	zfs_exit(zfsvfs, FTAG);
+	return (0);
+}
+
 static void
 zfs_clear_setid_bits_if_necessary(zfsvfs_t *zfsvfs, znode_t *zp, cred_t *cr,
     uint64_t *clear_setid_bits_txgp, dmu_tx_t *tx)
@@ -589,6 +904,183 @@ zfs_clear_setid_bits_if_necessary(zfsvfs_t *zfsvfs, znode_t *zp, cred_t *cr,
 	}
 }
 
+/*
+ * Write to a file whose data is stored inline, or to an empty file whose
+ * data can be, see zfs_sa_inline_fits().  The data of the file is rebuilt
+ * with the new bytes and stored as a whole in a single transaction, which
+ * also makes the file size size bytes.  The caller holds a range lock of
+ * the whole file.
+ */
+static int
+zfs_write_inline(znode_t *zp, zfs_uio_t *uio, offset_t woff, ssize_t n,
+    uint64_t size, cred_t *cr, boolean_t commit, uint64_t *clear_setid_txgp)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	const uint64_t uid = KUID_TO_SUID(ZTOUID(zp));
+	const uint64_t gid = KGID_TO_SGID(ZTOGID(zp));
+	const uint64_t projid = zp->z_projid;
+	uint64_t mtime[2], ctime[2];
+	sa_bulk_attr_t bulk[3];
+	int count = 0;
+	size_t len, cbytes;
+	dmu_tx_t *tx;
+	void *buf;
+	int error;
+
+	if (zfs_id_overblockquota(zfsvfs, DMU_USERUSED_OBJECT, uid) ||
+	    zfs_id_overblockquota(zfsvfs, DMU_GROUPUSED_OBJECT, gid) ||
+	    (projid != ZFS_DEFAULT_PROJID &&
+	    zfs_id_overblockquota(zfsvfs, DMU_PROJECTUSED_OBJECT, projid)))
+		return (SET_ERROR(EDQUOT));
+
+	/*
+	 * Build the new data before entering the transaction, so a page
+	 * fault on the user buffer cannot hold up the txg.
+	 */
+	buf = kmem_zalloc(size, KM_SLEEP);
+	if (zp->z_pflags & ZFS_INLINE_DATA) {
+		error = zfs_sa_inline_read(zp, buf, 0, MIN(zp->z_size, size));
+		if (error != 0)
+			goto out;
+	}
+	len = (woff < size) ? MIN(n, size - woff) : 0;
+	if (len != 0) {
+		error = zfs_uiocopy((char *)buf + woff, len, UIO_WRITE, uio,
+		    &cbytes);
+		if (error == 0 && cbytes != len)
+			error = SET_ERROR(EFAULT);
+		if (error != 0)
+			goto out;
+	}
+
+	tx = dmu_tx_create(zfsvfs->z_os);
+	dmu_tx_hold_sa(tx, zp->z_sa_hdl, B_TRUE);
+	error = dmu_tx_assign(tx, DMU_TX_WAIT);
+	if (error != 0) {
+		dmu_tx_abort(tx);
+		goto out;
+	}
+
+	zfs_clear_setid_bits_if_necessary(zfsvfs, zp, cr, clear_setid_txgp,
+	    tx);
+	zfs_tstamp_update_setup(zp, CONTENT_MODIFIED, mtime, ctime);
+	zfs_sa_inline_update(zp, buf, size, tx);
+	zp->z_size = size;
+
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_MTIME(zfsvfs), NULL, &mtime, 16);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_CTIME(zfsvfs), NULL, &ctime, 16);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_SIZE(zfsvfs), NULL,
+	    &zp->z_size, 8);
+	VERIFY0(sa_bulk_update(zp->z_sa_hdl, bulk, count, tx));
+
+	zfs_log_write(zfsvfs->z_log, tx, TX_WRITE, zp, woff, n, commit,
+	    B_FALSE, NULL, NULL);
+	dmu_tx_commit(tx);
+
+	zfs_uioskip(uio, n);
+out:
+	kmem_free(buf, size);
+	return (error);
+}
+
+static void
+zfs_write_early_done(zgd_t *zgd, int error)
+{
+	(void) error;
+	znode_t *zp = zgd->zgd_private;
+
+	if (zgd->zgd_db)
+		dmu_buf_rele(zgd->zgd_db, zgd);
+
+	zfs_rangelock_exit(zgd->zgd_lr);
+
+	/*
+	 * Release the vnode asynchronously, this may run from the
+	 * completion of the write.
+	 */
+	zfs_zrele_async(zp);
+
+	kmem_free(zgd->zgd_bp, sizeof (blkptr_t));
+	kmem_free(zgd, sizeof (zgd_t));
+}
+
+/*
+ * Write out the blocks that a write just filled entirely, between off and
+ * end, the same way dmu_sync() does for the ZIL.  The dirty records are
+ * overridden with the written blocks, so that the device is kept busy while
+ * the txg is open and spa_sync() only has to record the block pointers.
+ * A block that is modified again in the same txg is simply freed and
+ * written once more by spa_sync() (see dbuf_unoverride()).
+ *
+ * As in zfs_get_data(), each block is range locked until its write is done,
+ * so that its data cannot change under the checksum.  Blocks that are busy
+ * are left to spa_sync().
+ */
+static void
+zfs_write_early(znode_t *zp, uint64_t off, uint64_t end)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	objset_t *os = zfsvfs->z_os;
+	uint64_t blksz = zp->z_blksz;
+	zio_t *pio = NULL;
+
+	/*
+	 * The block size is only fixed once the file outgrows its first
+	 * block.  dmu_sync() writes are not deduplicated.
+	 */
+	if (zp->z_size <= blksz || !ISP2(blksz) ||
+	    os->os_dedup_checksum != ZIO_CHECKSUM_OFF)
+		return;
+
+	for (off = P2ROUNDUP(off, blksz); off + blksz <= end; off += blksz) {
+		zfs_locked_range_t *lr = zfs_rangelock_tryenter(
+		    &zp->z_rangelock, off, blksz, RL_READER);
+		if (lr == NULL)
+			continue;
+
+		zgd_t *zgd = kmem_zalloc(sizeof (zgd_t), KM_SLEEP);
+		zgd->zgd_bp = kmem_zalloc(sizeof (blkptr_t), KM_SLEEP);
+		zgd->zgd_lr = lr;
+		zgd->zgd_private = zp;
+		zhold(zp);
+
+		/* Test for truncation needs to be done while range locked. */
+		dmu_buf_t *dbp;
+		if (zp->z_blksz != blksz || off >= zp->z_size ||
+		    dmu_buf_hold_noread(os, zp->z_id, off, zgd, &dbp) != 0) {
+			zfs_write_early_done(zgd, 0);
+			break;
+		}
+		zgd->zgd_db = dbp;
+
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp;
+		uint64_t txg = 0;
+		mutex_enter(&db->db_mtx);
+		dbuf_dirty_record_t *dr = list_head(&db->db_dirty_records);
+		if (dr != NULL && dr->dt.dl.dr_data != NULL &&
+		    !dr->dt.dl.dr_has_raw_params &&
+		    dr->dt.dl.dr_override_state == DR_NOT_OVERRIDDEN)
+			txg = dr->dr_txg;
+		mutex_exit(&db->db_mtx);
+
+		if (txg == 0) {
+			zfs_write_early_done(zgd, 0);
+			continue;
+		}
+
+		if (pio == NULL) {
+			pio = zio_root(dmu_objset_spa(os), NULL, NULL,
+			    ZIO_FLAG_CANFAIL);
+		}
+		int error = dmu_sync(pio, txg, zfs_write_early_done, zgd);
+		if (error != 0)
+			zfs_write_early_done(zgd, error);
+	}
+
+	if (pio != NULL)
+		zio_nowait(pio);
+}
+
 /*
  * Write the bytes to a file.
  *
@@ -625,6 +1117,7 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	zfsvfs_t *zfsvfs = ZTOZSB(zp);
 	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
 		return (error);
+	hrtime_t start = dataset_kstats_start(&zfsvfs->z_kstat);
 
 	sa_bulk_attr_t bulk[4];
 	int count = 0;
@@ -675,6 +1168,8 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		return (SET_ERROR(error));
 	}
 
+	zfs_qos_charge(&zfsvfs->z_os->os_qos, B_TRUE, n);
+
 	/*
 	 * Pre-fault the pages to ensure slow (eg NFS) pages
 	 * don't hold up txg.
@@ -685,11 +1180,28 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		return (SET_ERROR(EFAULT));
 	}
 
+	/*
+	 * Inline data is always rewritten as a whole, see zfs_write_inline(),
+	 * so lock the whole file if it has inline data or may get it now.
+	 */
+	boolean_t lock_all = (zp->z_pflags & ZFS_INLINE_DATA) ||
+	    (zp->z_size == 0 && !(uio->uio_extflg & UIO_DIRECT) &&
+	    zfs_sa_inline_fits(zp, woff + n));
+
 	/*
 	 * If in append mode, set the io offset pointer to eof.
 	 */
 	zfs_locked_range_t *lr;
-	if (ioflag & O_APPEND) {
+top:
+	if (lock_all) {
+		lr = zfs_rangelock_enter(&zp->z_rangelock, 0, UINT64_MAX,
+		    RL_WRITER);
+		if (ioflag & O_APPEND) {
+			woff = zp->z_size;
+			zfs_uio_setoffset(uio, woff);
+			zfs_uio_setsoffset(uio, woff);
+		}
+	} else if (ioflag & O_APPEND) {
 		/*
 		 * Obtain an appending range lock to guarantee file append
 		 * semantics.  We reset the write offset once we have the lock.
@@ -720,6 +1232,13 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		lr = zfs_rangelock_enter(&zp->z_rangelock, woff, n, RL_WRITER);
 	}
 
+	/* The file got inline data while we were waiting for the lock. */
+	if ((zp->z_pflags & ZFS_INLINE_DATA) && lr->lr_length != UINT64_MAX) {
+		zfs_rangelock_exit(lr);
+		lock_all = B_TRUE;
+		goto top;
+	}
+
 	if (zn_rlimit_fsize_uio(zp, uio)) {
 		zfs_rangelock_exit(lr);
 		zfs_exit(zfsvfs, FTAG);
@@ -746,6 +1265,31 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	const uint64_t gid = KGID_TO_SGID(ZTOGID(zp));
 	const uint64_t projid = zp->z_projid;
 
+	if (lr->lr_length == UINT64_MAX &&
+	    ((zp->z_pflags & ZFS_INLINE_DATA) || zp->z_size == 0)) {
+		uint64_t inline_size = end_size;
+
+		if (zfsvfs->z_replay && zp->z_replay_eof != 0)
+			inline_size = zp->z_replay_eof;
+
+		if (!(uio->uio_extflg & UIO_DIRECT) &&
+		    !zn_has_cached_data(zp, 0, inline_size - 1) &&
+		    zfs_sa_inline_fits(zp, inline_size)) {
+			error = zfs_write_inline(zp, uio, woff, n, inline_size,
+			    cr, commit, &clear_setid_bits_txg);
+			n = 0;
+		} else if (zp->z_pflags & ZFS_INLINE_DATA) {
+			/*
+			 * The data no longer fits inline, move it to a block
+			 * and write normally.  The block size is grown as
+			 * usual, since the whole file is still locked.
+			 */
+			error = zfs_sa_inline_to_blocks_locked(zp);
+			if (error != 0)
+				n = 0;
+		}
+	}
+
 	/*
 	 * In the event we are increasing the file block size
 	 * (lr_length == UINT64_MAX), we will direct the write to the ARC.
@@ -768,6 +1312,10 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	 * through the ARC; however, the following 3 1K requests will
 	 * use Direct I/O.
 	 */
+	if (zfs_recordsize_auto && n > 0 && woff < zp->z_size &&
+	    zp->z_size <= zp->z_blksz)
+		zfs_note_overwrite(zp, n);
+
 	if (uio->uio_extflg & UIO_DIRECT && lr->lr_length == UINT64_MAX) {
 		uio->uio_extflg &= ~UIO_DIRECT;
 		o_direct_defer = B_TRUE;
@@ -801,7 +1349,7 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 				 */
 				blksz = 1 << highbit64(zp->z_blksz);
 			} else {
-				blksz = zfsvfs->z_max_blksz;
+				blksz = zfs_max_file_blksz(zp);
 			}
 			blksz = MIN(blksz, P2ROUNDUP(end_size,
 			    SPA_MINBLOCKSIZE));
@@ -1001,11 +1549,11 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		}
 		/*
 		 * If we are replaying and eof is non zero then force
-		 * the file size to the specified eof. Note, there's no
-		 * concurrency during replay.
+		 * the file size to the specified eof. Records of a given
+		 * object are never replayed concurrently.
 		 */
-		if (zfsvfs->z_replay && zfsvfs->z_replay_eof != 0)
-			zp->z_size = zfsvfs->z_replay_eof;
+		if (zfsvfs->z_replay && zp->z_replay_eof != 0)
+			zp->z_size = zp->z_replay_eof;
 
 		error1 = sa_bulk_update(zp->z_sa_hdl, bulk, count, tx);
 		if (error1 != 0)
@@ -1066,11 +1614,17 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		return (error);
 	}
 
+	int64_t nwritten = start_resid - zfs_uio_resid(uio);
+
 	if (commit)
 		zil_commit(zilog, zp->z_id);
+	else if (zfs_early_writeout)
+		zfs_write_early(zp, zfs_uio_offset(uio) - nwritten,
+		    zfs_uio_offset(uio));
 
-	int64_t nwritten = start_resid - zfs_uio_resid(uio);
 	dataset_kstats_update_write_kstats(&zfsvfs->z_kstat, nwritten);
+	dataset_kstats_update_histograms(&zfsvfs->z_kstat, DATASET_OP_WRITE,
+	    nwritten, start);
 
 	zfs_exit(zfsvfs, FTAG);
 	return (0);
@@ -1082,7 +1636,7 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
  *	IN:	zp	- znode of file to be rewritten.
  *		off	- Offset of the range to rewrite.
  *		len	- Length of the range to rewrite.
- *		flags	- Random rewrite parameters.
+ *		flags	- ZFS_REWRITE_* rewrite parameters.
  *		arg	- flags-specific argument.
  *
  *	RETURN:	0 if success
@@ -1094,8 +1648,19 @@ zfs_rewrite(znode_t *zp, uint64_t off, uint64_t len, uint64_t flags,
 {
 	int error;
 
-	if (flags != 0 || arg != 0)
+	if ((flags & ~ZFS_REWRITE_MASK) != 0 ||
+	    (flags & (ZFS_REWRITE_SPECIAL | ZFS_REWRITE_NORMAL)) ==
+	    (ZFS_REWRITE_SPECIAL | ZFS_REWRITE_NORMAL) ||
+	    ((flags & ZFS_REWRITE_RATE) ? arg == 0 : arg != 0))
 		return (SET_ERROR(EINVAL));
+	const uint64_t rate = (flags & ZFS_REWRITE_RATE) ? arg : 0;
+	const hrtime_t start = gethrtime();
+
+	uint8_t hint = ZIO_CLASS_HINT_NONE;
+	if (flags & ZFS_REWRITE_SPECIAL)
+		hint = ZIO_CLASS_HINT_SPECIAL;
+	else if (flags & ZFS_REWRITE_NORMAL)
+		hint = ZIO_CLASS_HINT_NORMAL;
 
 	zfsvfs_t *zfsvfs = ZTOZSB(zp);
 	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
@@ -1120,6 +1685,13 @@ zfs_rewrite(znode_t *zp, uint64_t off, uint64_t len, uint64_t flags,
 	zfs_locked_range_t *lr;
 	lr = zfs_rangelock_enter(&zp->z_rangelock, off, len, RL_WRITER);
 
+	/* Inline data is rewritten with the dnode, there are no blocks. */
+	if (zp->z_pflags & ZFS_INLINE_DATA) {
+		zfs_rangelock_exit(lr);
+		zfs_exit(zfsvfs, FTAG);
+		return (0);
+	}
+
 	const uint64_t uid = KUID_TO_SUID(ZTOUID(zp));
 	const uint64_t gid = KGID_TO_SGID(ZTOGID(zp));
 	const uint64_t projid = zp->z_projid;
@@ -1129,6 +1701,7 @@ zfs_rewrite(znode_t *zp, uint64_t off, uint64_t len, uint64_t flags,
 	dnode_t *dn = DB_DNODE(db);
 
 	uint64_t n, noff = off, nr = 0, nw = 0;
+	hrtime_t wakeup = 0;
 	while (len > 0) {
 		/*
 		 * Rewrite only actual data, skipping any holes.  This might
@@ -1165,6 +1738,8 @@ zfs_rewrite(znode_t *zp, uint64_t off, uint64_t len, uint64_t flags,
 
 		n = MIN(MIN(len, noff - off),
 		    DMU_MAX_ACCESS / 2 - P2PHASE(off, zp->z_blksz));
+		if (rate != 0)
+			n = MIN(n, MAX(rate / 10, zp->z_blksz));
 
 		dmu_tx_t *tx = dmu_tx_create(zfsvfs->z_os);
 		dmu_tx_hold_write_by_dnode(tx, dn, off, n);
@@ -1185,10 +1760,12 @@ zfs_rewrite(znode_t *zp, uint64_t off, uint64_t len, uint64_t flags,
 		}
 		for (int i = 0; i < numbufs; i++) {
 			nr += dbp[i]->db_size;
-			if (dmu_buf_is_dirty(dbp[i], tx))
-				continue;
-			nw += dbp[i]->db_size;
-			dmu_buf_will_dirty(dbp[i], tx);
+			if (!dmu_buf_is_dirty(dbp[i], tx)) {
+				nw += dbp[i]->db_size;
+				dmu_buf_will_dirty(dbp[i], tx);
+			}
+			if (hint != ZIO_CLASS_HINT_NONE)
+				dmu_buf_set_class_hint(dbp[i], tx, hint);
 		}
 		dmu_buf_rele_array(dbp, numbufs, FTAG);
 
@@ -1197,6 +1774,25 @@ zfs_rewrite(znode_t *zp, uint64_t off, uint64_t len, uint64_t flags,
 		len -= n;
 		off += n;
 
+		/*
+		 * Hold back to the rate, without keeping the range locked
+		 * meanwhile.  The file may have been truncated once we have
+		 * the lock again.
+		 */
+		if (rate != 0) {
+			wakeup = start + SEC2NSEC(nw / rate) +
+			    USEC2NSEC((nw % rate) * MICROSEC / rate);
+		}
+		if (len > 0 && wakeup > gethrtime()) {
+			zfs_rangelock_exit(lr);
+			zfs_sleep_until(wakeup);
+			lr = zfs_rangelock_enter(&zp->z_rangelock, off, len,
+			    RL_WRITER);
+			if (off >= zp->z_size)
+				break;
+			len = MIN(len, zp->z_size - off);
+		}
+
 		if (issig()) {
 			error = SET_ERROR(EINTR);
 			break;
@@ -1210,6 +1806,10 @@ zfs_rewrite(znode_t *zp, uint64_t off, uint64_t len, uint64_t flags,
 
 	zfs_rangelock_exit(lr);
 	zfs_exit(zfsvfs, FTAG);
+
+	/* Pace the last piece too, so that rewrites of many files add up. */
+	if (error == 0 && wakeup > gethrtime())
+		zfs_sleep_until(wakeup);
 	return (error);
 }
 
@@ -1278,8 +1878,9 @@ zfs_get_direct_alignment(znode_t *zp, uint64_t *alignp)
 	 * maximum (meaning, if the file grew past the current block size, the
 	 * block size could would be increased).
 	 */
-	if (zp->z_size <= zp->z_blksz && zp->z_blksz < zfsvfs->z_max_blksz)
-		*alignp = MAX(zfsvfs->z_max_blksz, PAGE_SIZE);
+	uint64_t max_blksz = zfs_max_file_blksz(zp);
+	if (zp->z_size <= zp->z_blksz && zp->z_blksz < max_blksz)
+		*alignp = MAX(max_blksz, PAGE_SIZE);
 	else
 		*alignp = MAX(zp->z_blksz, PAGE_SIZE);
 
@@ -1353,11 +1954,16 @@ zfs_get_data(void *arg, uint64_t gen, lr_write_t *lr, char *buf,
 		/* test for truncation needs to be done while range locked */
 		if (offset >= zp->z_size) {
 			error = SET_ERROR(ENOENT);
+		} else if (zp->z_pflags & ZFS_INLINE_DATA) {
+			uint64_t len = MIN(size, zp->z_size - offset);
+
+			error = zfs_sa_inline_read(zp, buf, offset, len);
+			memset(buf + len, 0, size - len);
 		} else {
 			error = dmu_read(os, object, offset, size, buf,
 			    DMU_READ_NO_PREFETCH | DMU_KEEP_CACHING);
 		}
-		ASSERT(error == 0 || error == ENOENT);
+		ASSERT(error == 0 || error == ENOENT || error == EIO);
 	} else { /* indirect write */
 		ASSERT3P(zio, !=, NULL);
 		/*
@@ -1378,8 +1984,13 @@ zfs_get_data(void *arg, uint64_t gen, lr_write_t *lr, char *buf,
 			offset += blkoff;
 			zfs_rangelock_exit(zgd->zgd_lr);
 		}
-		/* test for truncation needs to be done while range locked */
-		if (lr->lr_offset >= zp->z_size)
+		/*
+		 * test for truncation needs to be done while range locked.
+		 * Data which is now inline was written after a truncation
+		 * to zero, which is logged after this record.
+		 */
+		if (lr->lr_offset >= zp->z_size ||
+		    (zp->z_pflags & ZFS_INLINE_DATA))
 			error = SET_ERROR(ENOENT);
 #ifdef ZFS_DEBUG
 		if (zil_fault_io) {
@@ -1689,6 +2300,15 @@ zfs_clone_range(znode_t *inzp, uint64_t *inoffp, znode_t *outzp,
 		    RL_READER);
 	}
 
+	/*
+	 * Inline data has no blocks to clone, let the caller fall back to
+	 * a plain copy.
+	 */
+	if ((inzp->z_pflags | outzp->z_pflags) & ZFS_INLINE_DATA) {
+		error = SET_ERROR(EXDEV);
+		goto unlock;
+	}
+
 	inblksz = inzp->z_blksz;
 
 	/*
@@ -1974,6 +2594,12 @@ zfs_clone_range_replay(znode_t *zp, uint64_t off, uint64_t len, uint64_t blksz,
 		return (SET_ERROR(EINVAL));
 	}
 
+	if ((zp->z_pflags & ZFS_INLINE_DATA) &&
+	    (error = zfs_sa_inline_to_blocks(zp)) != 0) {
+		zfs_exit(zfsvfs, FTAG);
+		return (error);
+	}
+
 	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_MTIME(zfsvfs), NULL, &mtime, 16);
 	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_CTIME(zfsvfs), NULL, &ctime, 16);
 	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_SIZE(zfsvfs), NULL,
@@ -2048,3 +2674,9 @@ ZFS_MODULE_PARAM(zfs, zfs_, dio_enabled, INT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs, zfs_, dio_strict, INT, ZMOD_RW,
 	"Return errors on misaligned Direct I/O");
+
+ZFS_MODULE_PARAM(zfs, zfs_, recordsize_auto, INT, ZMOD_RW,
+	"Pick the block size of each file from its write pattern");
+
+ZFS_MODULE_PARAM(zfs, zfs_, early_writeout, INT, ZMOD_RW,
+	"Write out full file blocks while their txg is still open");
@@ -123,6 +123,10 @@ static zil_kstat_values_t zil_stats = {
 static zil_sums_t zil_sums_global;
 static kstat_t *zil_kstats_global;
 
+static const char *const zil_lat_stage_names[ZIL_LAT_STAGES] = {
+	"commit", "assign", "issue", "write", "flush"
+};
+
 /*
  * Disable intent logging replay.  This global ZIL switch affects all pools.
  */
@@ -148,6 +152,8 @@ static kmem_cache_t *zil_zcw_cache;
 static void zil_lwb_commit(zilog_t *zilog, lwb_t *lwb, itx_t *itx);
 static itx_t *zil_itx_clone(itx_t *oitx);
 static uint64_t zil_max_waste_space(zilog_t *zilog);
+static void zil_commit_impl_range(zilog_t *zilog, uint64_t foid, uint64_t off,
+    uint64_t len);
 
 static int
 zil_bp_compare(const void *x1, const void *x2)
@@ -362,6 +368,7 @@ zil_read_log_data(zilog_t *zilog, const lr_write_t *lr, void *wbuf)
 void
 zil_sums_init(zil_sums_t *zs)
 {
+	memset(zs->zil_lat, 0, sizeof (zs->zil_lat));
 	wmsum_init(&zs->zil_commit_count, 0);
 	wmsum_init(&zs->zil_commit_writer_count, 0);
 	wmsum_init(&zs->zil_commit_error_count, 0);
@@ -452,6 +459,45 @@ zil_kstat_values_update(zil_kstat_values_t *zs, zil_sums_t *zil_sums)
 	    wmsum_value(&zil_sums->zil_itx_metaslab_slog_write);
 	zs->zil_itx_metaslab_slog_alloc.value.ui64 =
 	    wmsum_value(&zil_sums->zil_itx_metaslab_slog_alloc);
+	for (int s = 0; s < ZIL_LAT_STAGES; s++) {
+		for (int b = 0; b < ZIL_LAT_BUCKETS; b++) {
+			zs->zil_lat[s][b].value.ui64 =
+			    atomic_load_64(&zil_sums->zil_lat[s][b]);
+		}
+	}
+}
+
+/*
+ * Name the latency histogram entries of a freshly copied kstat template.
+ */
+void
+zil_kstat_values_init(zil_kstat_values_t *zs)
+{
+	for (int s = 0; s < ZIL_LAT_STAGES; s++) {
+		for (int b = 0; b < ZIL_LAT_BUCKETS; b++) {
+			kstat_named_t *kn = &zs->zil_lat[s][b];
+			(void) snprintf(kn->name, sizeof (kn->name),
+			    "zil_lat_%s_%lluus", zil_lat_stage_names[s],
+			    1ULL << b);
+			kn->data_type = KSTAT_DATA_UINT64;
+			kn->value.ui64 = 0;
+		}
+	}
+}
+
+/*
+ * Account one event of the given commit stage, which took "delta"
+ * nanoseconds, in the global and per-dataset latency histograms.
+ */
+static void
+zil_lat_add(zilog_t *zilog, zil_lat_stage_t stage, hrtime_t delta)
+{
+	uint64_t us = delta > 0 ? (uint64_t)delta / 1000 : 0;
+	int b = MIN(highbit64(us), ZIL_LAT_BUCKETS - 1);
+
+	atomic_inc_64(&zil_sums_global.zil_lat[stage][b]);
+	if (zilog->zl_sums != NULL)
+		atomic_inc_64(&zilog->zl_sums->zil_lat[stage][b]);
 }
 
 /*
@@ -845,6 +891,7 @@ zil_alloc_lwb(zilog_t *zilog, int sz, blkptr_t *bp, boolean_t slog,
 	lwb->lwb_write_zio = NULL;
 	lwb->lwb_root_zio = NULL;
 	lwb->lwb_issued_timestamp = 0;
+	lwb->lwb_written_timestamp = 0;
 	lwb->lwb_issued_txg = 0;
 	lwb->lwb_alloc_txg = txg;
 	lwb->lwb_max_txg = 0;
@@ -1460,7 +1507,12 @@ zil_lwb_flush_vdevs_done(zio_t *zio)
 
 	spa_config_exit(zilog->zl_spa, SCL_STATE, lwb);
 
-	hrtime_t t = gethrtime() - lwb->lwb_issued_timestamp;
+	hrtime_t now = gethrtime();
+	hrtime_t t = now - lwb->lwb_issued_timestamp;
+	if (lwb->lwb_written_timestamp != 0) {
+		zil_lat_add(zilog, ZIL_LAT_FLUSH,
+		    now - lwb->lwb_written_timestamp);
+	}
 
 	mutex_enter(&zilog->zl_lock);
 
@@ -1561,6 +1613,91 @@ zil_lwb_flush_wait_all(zilog_t *zilog, uint64_t txg)
 #endif
 }
 
+/*
+ * Shared flush epochs.  When many datasets commit at the same time, each
+ * of their lwbs would send its own cache flush to the same (usually slog)
+ * leaf vdevs.  With zil_shared_flush set, only one flush per leaf vdev is
+ * in flight at a time: lwbs whose writes complete while a flush is already
+ * outstanding join a single "next" flush, which is issued as soon as the
+ * current one finishes.  That next flush covers every write which had
+ * completed before it was issued, so it is as good as the individual
+ * flushes it replaces, and a burst of N commits costs two flushes instead
+ * of N.
+ *
+ * The pending epoch is a null zio that every joining lwb root zio is made
+ * a parent of; it isn't issued until its real flush has been created as
+ * its child.
+ */
+static int zil_shared_flush = 0;
+
+static void zil_flush_issue(zio_t *pio, vdev_t *vd);
+
+static void
+zil_flush_done(zio_t *zio)
+{
+	vdev_t *vd = zio->io_private;
+	zio_t *next;
+
+	mutex_enter(&vd->vdev_zil_flush_lock);
+	ASSERT(vd->vdev_zil_flush_active);
+	next = vd->vdev_zil_flush_next;
+	vd->vdev_zil_flush_next = NULL;
+	if (next == NULL)
+		vd->vdev_zil_flush_active = B_FALSE;
+	mutex_exit(&vd->vdev_zil_flush_lock);
+
+	if (next != NULL) {
+		zil_flush_issue(next, vd);
+		zio_nowait(next);
+	}
+}
+
+/*
+ * Flush leaf "vd" on behalf of "pio", starting the next epoch (if any)
+ * once the flush has completed.
+ */
+static void
+zil_flush_issue(zio_t *pio, vdev_t *vd)
+{
+	zio_t *zio = zio_null(pio, vd->vdev_spa, NULL, zil_flush_done, vd,
+	    ZIO_FLAG_CANFAIL | ZIO_FLAG_DONT_PROPAGATE);
+
+	zio_flush(zio, vd);
+	zio_nowait(zio);
+}
+
+static void
+zil_flush_vdev(zio_t *pio, vdev_t *vd)
+{
+	if (!zil_shared_flush) {
+		zio_flush(pio, vd);
+		return;
+	}
+
+	if (vd->vdev_nowritecache)
+		return;
+
+	if (vd->vdev_children != 0) {
+		for (uint64_t c = 0; c < vd->vdev_children; c++)
+			zil_flush_vdev(pio, vd->vdev_child[c]);
+		return;
+	}
+
+	mutex_enter(&vd->vdev_zil_flush_lock);
+	if (!vd->vdev_zil_flush_active) {
+		vd->vdev_zil_flush_active = B_TRUE;
+		mutex_exit(&vd->vdev_zil_flush_lock);
+		zil_flush_issue(pio, vd);
+		return;
+	}
+	if (vd->vdev_zil_flush_next == NULL) {
+		vd->vdev_zil_flush_next = zio_null(NULL, vd->vdev_spa, NULL,
+		    NULL, NULL, ZIO_FLAG_CANFAIL | ZIO_FLAG_DONT_PROPAGATE);
+	}
+	zio_add_child(pio, vd->vdev_zil_flush_next);
+	mutex_exit(&vd->vdev_zil_flush_lock);
+}
+
 /*
  * This is called when an lwb's write zio completes. The callback's purpose is
  * to issue the flush commands for the vdevs in the lwb's lwb_vdev_tree. The
@@ -1586,6 +1723,10 @@ zil_lwb_write_done(zio_t *zio)
 
 	ASSERT3S(spa_config_held(spa, SCL_STATE, RW_READER), !=, 0);
 
+	lwb->lwb_written_timestamp = gethrtime();
+	zil_lat_add(zilog, ZIL_LAT_WRITE,
+	    lwb->lwb_written_timestamp - lwb->lwb_issued_timestamp);
+
 	abd_free(zio->io_abd);
 	zio_buf_free(lwb->lwb_buf, lwb->lwb_sz);
 	lwb->lwb_buf = NULL;
@@ -1660,7 +1801,7 @@ zil_lwb_write_done(zio_t *zio)
 			 * since these "zio_flush" errors will not be
 			 * propagated up to "zil_lwb_flush_vdevs_done".
 			 */
-			zio_flush(lwb->lwb_root_zio, vd);
+			zil_flush_vdev(lwb->lwb_root_zio, vd);
 		}
 		kmem_free(zv, sizeof (*zv));
 	}
@@ -1901,6 +2042,7 @@ zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
 	zbookmark_phys_t zb;
 	zio_priority_t prio;
 	int error;
+	hrtime_t start = gethrtime();
 
 	ASSERT3S(lwb->lwb_state, ==, LWB_STATE_CLOSED);
 
@@ -2049,6 +2191,8 @@ next_lwb:
 		    BP_GET_LSIZE(&lwb->lwb_blk));
 	}
 	lwb->lwb_issued_timestamp = gethrtime();
+	zil_lat_add(zilog, ZIL_LAT_ISSUE, lwb->lwb_issued_timestamp - start);
+	start = lwb->lwb_issued_timestamp;
 	if (lwb->lwb_child_zio)
 		zio_nowait(lwb->lwb_child_zio);
 	zio_nowait(lwb->lwb_write_zio);
@@ -2786,6 +2930,105 @@ zil_async_to_sync(zilog_t *zilog, uint64_t foid)
 	}
 }
 
+/*
+ * Commit only the writes overlapping the byte range given to
+ * zil_commit_range(), rather than everything pending for the object.
+ */
+static int zil_range_commit = 0;
+
+/*
+ * Move the TX_WRITE itxs in the async list that overlap [*start, *end) to
+ * the sync list, widening the range by each write moved.  The list is
+ * walked from the newest itx, so any older write that overlaps a newer one
+ * being committed is committed too, and replay sees every byte written in
+ * its original order.  Any other itx, such as a truncate, may depend on
+ * writes outside the range; if one is found, the whole list is moved and
+ * B_TRUE returned.
+ */
+static boolean_t
+zil_async_range_to_sync(list_t *sync_list, list_t *async_list,
+    uint64_t *start, uint64_t *end)
+{
+	list_t picked;
+	itx_t *itx, *prev;
+
+	for (itx = list_head(async_list); itx != NULL;
+	    itx = list_next(async_list, itx)) {
+		if (itx->itx_lr.lrc_txtype != TX_WRITE) {
+			list_move_tail(sync_list, async_list);
+			return (B_TRUE);
+		}
+	}
+
+	list_create(&picked, sizeof (itx_t), offsetof(itx_t, itx_node));
+	for (itx = list_tail(async_list); itx != NULL; itx = prev) {
+		lr_write_t *lr = (lr_write_t *)&itx->itx_lr;
+
+		prev = list_prev(async_list, itx);
+		if (lr->lr_offset >= *end ||
+		    lr->lr_offset + lr->lr_length <= *start)
+			continue;
+
+		*start = MIN(*start, lr->lr_offset);
+		*end = MAX(*end, lr->lr_offset + lr->lr_length);
+		list_remove(async_list, itx);
+		list_insert_head(&picked, itx);
+	}
+	list_move_tail(sync_list, &picked);
+	list_destroy(&picked);
+
+	return (B_FALSE);
+}
+
+/*
+ * Like zil_async_to_sync() for a single object, but only for the writes
+ * overlapping [off, off + len).  The itxgs are walked from the newest, so
+ * that the range has grown to cover every newer write already picked by
+ * the time an older itxg is searched.  Once a whole list had to be moved,
+ * all older ones are moved whole as well, so that nothing left behind
+ * predates an itx which is being committed.
+ */
+static void
+zil_async_to_sync_range(zilog_t *zilog, uint64_t foid, uint64_t off,
+    uint64_t len)
+{
+	uint64_t otxg, txg;
+	uint64_t start = off, end = off + MIN(len, UINT64_MAX - off);
+	boolean_t whole = B_FALSE;
+	itx_async_node_t *ian, ian_search;
+	avl_index_t where;
+
+	ASSERT3U(foid, !=, 0);
+
+	if (spa_freeze_txg(zilog->zl_spa) != UINT64_MAX) /* ziltest support */
+		otxg = ZILTEST_TXG;
+	else
+		otxg = spa_last_synced_txg(zilog->zl_spa) + 1;
+
+	for (txg = otxg + TXG_CONCURRENT_STATES; txg-- > otxg; ) {
+		itxg_t *itxg = &zilog->zl_itxg[txg & TXG_MASK];
+
+		mutex_enter(&itxg->itxg_lock);
+		if (itxg->itxg_txg != txg) {
+			mutex_exit(&itxg->itxg_lock);
+			continue;
+		}
+
+		ian_search.ia_foid = foid;
+		ian = avl_find(&itxg->itxg_itxs->i_async_tree, &ian_search,
+		    &where);
+		if (ian != NULL && whole) {
+			list_move_tail(&itxg->itxg_itxs->i_sync_list,
+			    &ian->ia_list);
+		} else if (ian != NULL) {
+			whole = zil_async_range_to_sync(
+			    &itxg->itxg_itxs->i_sync_list, &ian->ia_list,
+			    &start, &end);
+		}
+		mutex_exit(&itxg->itxg_lock);
+	}
+}
+
 /*
  * This function will prune commit itxs that are at the head of the
  * commit list (it won't prune past the first non-commit itx), and
@@ -3140,6 +3383,7 @@ zil_commit_writer(zilog_t *zilog, zil_commit_waiter_t *zcw)
 	list_t ilwbs;
 	lwb_t *lwb;
 	uint64_t wtxg = 0;
+	hrtime_t start = gethrtime();
 
 	ASSERT(!MUTEX_HELD(&zilog->zl_lock));
 	ASSERT(spa_writeable(zilog->zl_spa));
@@ -3175,6 +3419,7 @@ zil_commit_writer(zilog_t *zilog, zil_commit_waiter_t *zcw)
 
 out:
 	mutex_exit(&zilog->zl_issuer_lock);
+	zil_lat_add(zilog, ZIL_LAT_ASSIGN, gethrtime() - start);
 	while ((lwb = list_remove_head(&ilwbs)) != NULL)
 		zil_lwb_write_issue(zilog, lwb);
 	list_destroy(&ilwbs);
@@ -3584,6 +3829,18 @@ zil_commit_itx_assign(zilog_t *zilog, zil_commit_waiter_t *zcw)
  */
 void
 zil_commit(zilog_t *zilog, uint64_t foid)
+{
+	zil_commit_range(zilog, foid, 0, UINT64_MAX);
+}
+
+/*
+ * Like zil_commit(), but only the writes to foid overlapping the given byte
+ * range need to be on stable storage when it returns.  Other records for
+ * the object are left for a later commit, unless one of them is not a
+ * write (see zil_async_range_to_sync()).
+ */
+void
+zil_commit_range(zilog_t *zilog, uint64_t foid, uint64_t off, uint64_t len)
 {
 	/*
 	 * We should never attempt to call zil_commit on a snapshot for
@@ -3631,13 +3888,23 @@ zil_commit(zilog_t *zilog, uint64_t foid)
 		return;
 	}
 
-	zil_commit_impl(zilog, foid);
+	zil_commit_impl_range(zilog, foid, off, len);
 }
 
 void
 zil_commit_impl(zilog_t *zilog, uint64_t foid)
 {
+	zil_commit_impl_range(zilog, foid, 0, UINT64_MAX);
+}
+
+static void
+zil_commit_impl_range(zilog_t *zilog, uint64_t foid, uint64_t off,
+    uint64_t len)
+{
+	hrtime_t start = gethrtime();
+
 	ZIL_STAT_BUMP(zilog, zil_commit_count);
+	DTRACE_PROBE2(zil__commit__start, zilog_t *, zilog, uint64_t, foid);
 
 	/*
 	 * Move the "async" itxs for the specified foid to the "sync"
@@ -3648,7 +3915,10 @@ zil_commit_impl(zilog_t *zilog, uint64_t foid)
 	 * call to zil_commit returning, we must perform this operation
 	 * before we call zil_commit_itx_assign().
 	 */
-	zil_async_to_sync(zilog, foid);
+	if (zil_range_commit && foid != 0 && (off != 0 || len != UINT64_MAX))
+		zil_async_to_sync_range(zilog, foid, off, len);
+	else
+		zil_async_to_sync(zilog, foid);
 
 	/*
 	 * We allocate a new "waiter" structure which will initially be
@@ -3690,6 +3960,8 @@ zil_commit_impl(zilog_t *zilog, uint64_t foid)
 	}
 
 	zil_free_commit_waiter(zcw);
+	zil_lat_add(zilog, ZIL_LAT_COMMIT, gethrtime() - start);
+	DTRACE_PROBE2(zil__commit__done, zilog_t *, zilog, uint64_t, foid);
 }
 
 /*
@@ -3815,6 +4087,7 @@ zil_init(void)
 	    sizeof (zil_commit_waiter_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
 
 	zil_sums_init(&zil_sums_global);
+	zil_kstat_values_init(&zil_stats);
 	zil_kstats_global = kstat_create("zfs", 0, "zil", "misc",
 	    KSTAT_TYPE_NAMED, sizeof (zil_stats) / sizeof (kstat_named_t),
 	    KSTAT_FLAG_VIRTUAL);
@@ -4182,54 +4455,93 @@ zil_resume(void *cookie)
 	dsl_dataset_rele(dmu_objset_ds(os), suspend_tag);
 }
 
+/*
+ * Out-of-order records (see TX_OOO()) only touch the object named by their
+ * lr_foid, so when zil_replay_threads allows it they are handed to a taskq
+ * instead of being replayed one at a time.  Each object gets at most one
+ * task, which replays that object's records in log order; all other record
+ * types (creates, removes, renames, ...) and records carrying FUIDs wait
+ * for the taskq to drain and are then replayed inline, as before.
+ *
+ * Records replayed by the taskq do not advance zh_replay_seq, since the
+ * txgs they land in don't follow log order.  The header only moves forward
+ * when an inline record is replayed, at which point every earlier record
+ * has been committed to the same or an earlier txg.  If we crash part way
+ * through, the out-of-order records since the last inline record will be
+ * replayed again, which is harmless as they are idempotent.
+ */
+static uint_t zil_replay_threads = 8;
+
+/*
+ * Limit on the memory used by the copies of records (and their TX_WRITE
+ * data) queued for parallel replay.
+ */
+#define	ZIL_REPLAY_INFLIGHT_MAX	(64ULL << 20)
+
+typedef struct zil_replay_rec {
+	list_node_t	zrr_node;	/* zro_recs linkage */
+	uint64_t	zrr_seq;	/* lrc_seq of the record */
+	uint64_t	zrr_txtype;	/* lrc_txtype of the record */
+	size_t		zrr_size;	/* allocated size of zrr_lr */
+	char		*zrr_lr;	/* copy of the record and data */
+} zil_replay_rec_t;
+
+typedef struct zil_replay_obj {
+	avl_node_t	zro_node;	/* zr_objs linkage */
+	uint64_t	zro_object;	/* object the records apply to */
+	list_t		zro_recs;	/* records, in log order */
+	struct zil_replay_arg *zro_zr;
+} zil_replay_obj_t;
+
 typedef struct zil_replay_arg {
 	zil_replay_func_t *const *zr_replay;
 	void		*zr_arg;
 	boolean_t	zr_byteswap;
 	char		*zr_lr;
+	zilog_t		*zr_zilog;
+	taskq_t		*zr_taskq;	/* NULL when replaying serially */
+	kmutex_t	zr_lock;	/* protects the fields below */
+	kcondvar_t	zr_cv;		/* signalled when records finish */
+	avl_tree_t	zr_objs;	/* objects with queued records */
+	uint64_t	zr_inflight;	/* number of queued records */
+	uint64_t	zr_inflight_bytes; /* memory used by queued records */
+	int		zr_error;	/* first parallel replay error */
 } zil_replay_arg_t;
 
-static int
-zil_replay_error(zilog_t *zilog, const lr_t *lr, int error)
+static void
+zil_replay_warn(zilog_t *zilog, uint64_t seq, uint64_t txtype, int error)
 {
 	char name[ZFS_MAX_DATASET_NAME_LEN];
 
-	zilog->zl_replaying_seq--;	/* didn't actually replay this one */
-
 	dmu_objset_name(zilog->zl_os, name);
 
 	cmn_err(CE_WARN, "ZFS replay transaction error %d, "
 	    "dataset %s, seq 0x%llx, txtype %llu %s\n", error, name,
-	    (u_longlong_t)lr->lrc_seq,
-	    (u_longlong_t)(lr->lrc_txtype & ~TX_CI),
-	    (lr->lrc_txtype & TX_CI) ? "CI" : "");
-
-	return (error);
+	    (u_longlong_t)seq, (u_longlong_t)(txtype & ~TX_CI),
+	    (txtype & TX_CI) ? "CI" : "");
 }
 
 static int
-zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
-    uint64_t claim_txg)
+zil_replay_error(zilog_t *zilog, const lr_t *lr, int error)
 {
-	zil_replay_arg_t *zr = zra;
-	const zil_header_t *zh = zilog->zl_header;
-	uint64_t reclen = lr->lrc_reclen;
-	uint64_t txtype = lr->lrc_txtype;
-	int error = 0;
-
-	zilog->zl_replaying_seq = lr->lrc_seq;
-
-	if (lr->lrc_seq <= zh->zh_replay_seq)	/* already replayed */
-		return (0);
+	zilog->zl_replaying_seq--;	/* didn't actually replay this one */
 
-	if (lr->lrc_txg < claim_txg)		/* already committed */
-		return (0);
+	zil_replay_warn(zilog, lr->lrc_seq, lr->lrc_txtype, error);
 
-	/* Strip case-insensitive bit, still present in log record */
-	txtype &= ~TX_CI;
+	return (error);
+}
 
-	if (txtype == 0 || txtype >= TX_MAX_TYPE)
-		return (zil_replay_error(zilog, lr, EINVAL));
+/*
+ * Replay a single record of type "txtype", which has been copied into
+ * "buf".  The buffer must have room for the data of an indirect TX_WRITE.
+ */
+static int
+zil_replay_one(zilog_t *zilog, zil_replay_arg_t *zr, char *buf,
+    uint64_t txtype)
+{
+	const lr_t *lr = (const lr_t *)buf;
+	uint64_t reclen = lr->lrc_reclen;
+	int error;
 
 	/*
 	 * If this record type can be logged out of order, the object
@@ -4237,24 +4549,19 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 	 */
 	if (TX_OOO(txtype)) {
 		error = dmu_object_info(zilog->zl_os,
-		    LR_FOID_GET_OBJ(((lr_ooo_t *)lr)->lr_foid), NULL);
+		    LR_FOID_GET_OBJ(((lr_ooo_t *)buf)->lr_foid), NULL);
 		if (error == ENOENT || error == EEXIST)
 			return (0);
 	}
 
-	/*
-	 * Make a copy of the data so we can revise and extend it.
-	 */
-	memcpy(zr->zr_lr, lr, reclen);
-
 	/*
 	 * If this is a TX_WRITE with a blkptr, suck in the data.
 	 */
 	if (txtype == TX_WRITE && reclen == sizeof (lr_write_t)) {
-		error = zil_read_log_data(zilog, (lr_write_t *)lr,
-		    zr->zr_lr + reclen);
+		error = zil_read_log_data(zilog, (lr_write_t *)buf,
+		    buf + reclen);
 		if (error != 0)
-			return (zil_replay_error(zilog, lr, error));
+			return (error);
 	}
 
 	/*
@@ -4265,7 +4572,7 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 	 * the lr was byteswapped, undo it before invoking the replay vector.
 	 */
 	if (zr->zr_byteswap)
-		byteswap_uint64_array(zr->zr_lr, reclen);
+		byteswap_uint64_array(buf, reclen);
 
 	/*
 	 * We must now do two things atomically: replay this log record,
@@ -4273,7 +4580,7 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 	 * we did so. At the end of each replay function the sequence number
 	 * is updated if we are in replay mode.
 	 */
-	error = zr->zr_replay[txtype](zr->zr_arg, zr->zr_lr, zr->zr_byteswap);
+	error = zr->zr_replay[txtype](zr->zr_arg, buf, zr->zr_byteswap);
 	if (error != 0) {
 		/*
 		 * The DMU's dnode layer doesn't see removes until the txg
@@ -4283,10 +4590,220 @@ zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
 		 * specify B_FALSE for byteswap now, so we don't do it twice.
 		 */
 		txg_wait_synced(spa_get_dsl(zilog->zl_spa), 0);
-		error = zr->zr_replay[txtype](zr->zr_arg, zr->zr_lr, B_FALSE);
-		if (error != 0)
-			return (zil_replay_error(zilog, lr, error));
+		error = zr->zr_replay[txtype](zr->zr_arg, buf, B_FALSE);
+	}
+	return (error);
+}
+
+static int
+zil_replay_obj_compare(const void *x1, const void *x2)
+{
+	const zil_replay_obj_t *zro1 = x1;
+	const zil_replay_obj_t *zro2 = x2;
+
+	return (TREE_CMP(zro1->zro_object, zro2->zro_object));
+}
+
+/*
+ * Taskq callback replaying all queued records of one object in order.
+ */
+static void
+zil_replay_obj_task(void *arg)
+{
+	zil_replay_obj_t *zro = arg;
+	zil_replay_arg_t *zr = zro->zro_zr;
+	zilog_t *zilog = zr->zr_zilog;
+	zil_replay_rec_t *zrr;
+
+	mutex_enter(&zr->zr_lock);
+	while ((zrr = list_head(&zro->zro_recs)) != NULL) {
+		int error = zr->zr_error;
+		mutex_exit(&zr->zr_lock);
+
+		/* Once a record has failed, only drain the queue. */
+		if (error == 0) {
+			error = zil_replay_one(zilog, zr, zrr->zrr_lr,
+			    zrr->zrr_txtype & ~TX_CI);
+			if (error != 0) {
+				zil_replay_warn(zilog, zrr->zrr_seq,
+				    zrr->zrr_txtype, error);
+			}
+		} else {
+			error = 0;
+		}
+
+		mutex_enter(&zr->zr_lock);
+		if (error != 0 && zr->zr_error == 0)
+			zr->zr_error = error;
+		list_remove(&zro->zro_recs, zrr);
+		zr->zr_inflight--;
+		zr->zr_inflight_bytes -= zrr->zrr_size;
+		cv_broadcast(&zr->zr_cv);
+		vmem_free(zrr->zrr_lr, zrr->zrr_size);
+		kmem_free(zrr, sizeof (*zrr));
+	}
+	avl_remove(&zr->zr_objs, zro);
+	mutex_exit(&zr->zr_lock);
+
+	list_destroy(&zro->zro_recs);
+	kmem_free(zro, sizeof (*zro));
+}
+
+/*
+ * Queue an out-of-order record of "size" bytes (including any TX_WRITE
+ * data still to be read) behind the other records of its object.
+ */
+static int
+zil_replay_dispatch(zilog_t *zilog, zil_replay_arg_t *zr, const lr_t *lr,
+    size_t size)
+{
+	zil_replay_obj_t search, *zro;
+	zil_replay_rec_t *zrr;
+	avl_index_t where;
+
+	zrr = kmem_alloc(sizeof (*zrr), KM_SLEEP);
+	zrr->zrr_seq = lr->lrc_seq;
+	zrr->zrr_txtype = lr->lrc_txtype;
+	zrr->zrr_size = size;
+	zrr->zrr_lr = vmem_alloc(size, KM_SLEEP);
+	memcpy(zrr->zrr_lr, lr, lr->lrc_reclen);
+	search.zro_object = LR_FOID_GET_OBJ(((const lr_ooo_t *)lr)->lr_foid);
+
+	mutex_enter(&zr->zr_lock);
+	while (zr->zr_inflight > 0 &&
+	    zr->zr_inflight_bytes + size > ZIL_REPLAY_INFLIGHT_MAX &&
+	    zr->zr_error == 0)
+		cv_wait(&zr->zr_cv, &zr->zr_lock);
+	if (zr->zr_error != 0) {
+		int error = zr->zr_error;
+		mutex_exit(&zr->zr_lock);
+		vmem_free(zrr->zrr_lr, size);
+		kmem_free(zrr, sizeof (*zrr));
+		return (error);
+	}
+
+	zilog->zl_replaying_seq = lr->lrc_seq;
+	zr->zr_inflight++;
+	zr->zr_inflight_bytes += size;
+
+	zro = avl_find(&zr->zr_objs, &search, &where);
+	if (zro != NULL) {
+		list_insert_tail(&zro->zro_recs, zrr);
+		mutex_exit(&zr->zr_lock);
+		return (0);
+	}
+
+	zro = kmem_alloc(sizeof (*zro), KM_SLEEP);
+	zro->zro_object = search.zro_object;
+	zro->zro_zr = zr;
+	list_create(&zro->zro_recs, sizeof (zil_replay_rec_t),
+	    offsetof(zil_replay_rec_t, zrr_node));
+	list_insert_tail(&zro->zro_recs, zrr);
+	avl_insert(&zr->zr_objs, zro, where);
+	mutex_exit(&zr->zr_lock);
+
+	VERIFY3U(taskq_dispatch(zr->zr_taskq, zil_replay_obj_task, zro,
+	    TQ_SLEEP), !=, TASKQID_INVALID);
+	return (0);
+}
+
+/*
+ * Wait for all queued records to be replayed.
+ */
+static int
+zil_replay_drain(zil_replay_arg_t *zr)
+{
+	int error;
+
+	mutex_enter(&zr->zr_lock);
+	while (zr->zr_inflight > 0)
+		cv_wait(&zr->zr_cv, &zr->zr_lock);
+	error = zr->zr_error;
+	mutex_exit(&zr->zr_lock);
+
+	return (error);
+}
+
+/*
+ * TX_SETATTR and TX_ACL records may carry FUID domains, which the ZPL
+ * hands down to zfs_fuid_create() through a single per file system
+ * pointer.  Such records are replayed inline, so that no two of them are
+ * ever in flight at once.  A FUID has its domain index in the upper 32
+ * bits, and ACL records count theirs in lr_fuidcnt.
+ */
+static boolean_t
+zil_replay_has_fuids(const lr_t *lr, uint64_t txtype, boolean_t byteswap)
+{
+	if (txtype == TX_SETATTR && lr->lrc_reclen >= sizeof (lr_setattr_t)) {
+		const lr_setattr_t *lrs = (const lr_setattr_t *)lr;
+		uint64_t uid = lrs->lr_uid;
+		uint64_t gid = lrs->lr_gid;
+
+		if (byteswap) {
+			uid = BSWAP_64(uid);
+			gid = BSWAP_64(gid);
+		}
+		return ((uid >> 32) != 0 || (gid >> 32) != 0);
 	}
+	if (txtype == TX_ACL && lr->lrc_reclen >= sizeof (lr_acl_t))
+		return (((const lr_acl_t *)lr)->lr_fuidcnt != 0);
+	return (B_FALSE);
+}
+
+static int
+zil_replay_log_record(zilog_t *zilog, const lr_t *lr, void *zra,
+    uint64_t claim_txg)
+{
+	zil_replay_arg_t *zr = zra;
+	const zil_header_t *zh = zilog->zl_header;
+	uint64_t reclen = lr->lrc_reclen;
+	uint64_t txtype = lr->lrc_txtype;
+	int error = 0;
+
+	/* Strip case-insensitive bit, still present in log record */
+	txtype &= ~TX_CI;
+
+	if (lr->lrc_seq <= zh->zh_replay_seq ||	/* already replayed */
+	    lr->lrc_txg < claim_txg) {		/* already committed */
+		if (zr->zr_taskq != NULL)
+			mutex_enter(&zr->zr_lock);
+		zilog->zl_replaying_seq = lr->lrc_seq;
+		if (zr->zr_taskq != NULL)
+			mutex_exit(&zr->zr_lock);
+		return (0);
+	}
+
+	if (zr->zr_taskq != NULL) {
+		if (TX_OOO(txtype) &&
+		    !zil_replay_has_fuids(lr, txtype, zr->zr_byteswap)) {
+			uint64_t size = reclen;
+			if (txtype == TX_WRITE &&
+			    reclen == sizeof (lr_write_t)) {
+				const lr_write_t *lrw = (const lr_write_t *)lr;
+				size += MAX(BP_GET_LSIZE(&lrw->lr_blkptr),
+				    lrw->lr_length);
+			}
+			if (size <= 2 * SPA_MAXBLOCKSIZE)
+				return (zil_replay_dispatch(zilog, zr, lr,
+				    size));
+		}
+		if ((error = zil_replay_drain(zr)) != 0)
+			return (error);
+	}
+
+	zilog->zl_replaying_seq = lr->lrc_seq;
+
+	if (txtype == 0 || txtype >= TX_MAX_TYPE)
+		return (zil_replay_error(zilog, lr, EINVAL));
+
+	/*
+	 * Make a copy of the data so we can revise and extend it.
+	 */
+	memcpy(zr->zr_lr, lr, reclen);
+
+	error = zil_replay_one(zilog, zr, zr->zr_lr, txtype);
+	if (error != 0)
+		return (zil_replay_error(zilog, lr, error));
 	return (0);
 }
 
@@ -4320,6 +4837,20 @@ zil_replay(objset_t *os, void *arg,
 	zr.zr_arg = arg;
 	zr.zr_byteswap = BP_SHOULD_BYTESWAP(&zh->zh_log);
 	zr.zr_lr = vmem_alloc(2 * SPA_MAXBLOCKSIZE, KM_SLEEP);
+	zr.zr_zilog = zilog;
+	zr.zr_taskq = NULL;
+	if (zil_replay_threads > 1) {
+		mutex_init(&zr.zr_lock, NULL, MUTEX_DEFAULT, NULL);
+		cv_init(&zr.zr_cv, NULL, CV_DEFAULT, NULL);
+		avl_create(&zr.zr_objs, zil_replay_obj_compare,
+		    sizeof (zil_replay_obj_t),
+		    offsetof(zil_replay_obj_t, zro_node));
+		zr.zr_inflight = 0;
+		zr.zr_inflight_bytes = 0;
+		zr.zr_error = 0;
+		zr.zr_taskq = taskq_create("z_zil_replay", zil_replay_threads,
+		    defclsyspri, 1, INT_MAX, TASKQ_DYNAMIC);
+	}
 
 	/*
 	 * Wait for in-progress removes to sync before starting replay.
@@ -4328,11 +4859,22 @@ zil_replay(objset_t *os, void *arg,
 
 	zilog->zl_replay = B_TRUE;
 	zilog->zl_replay_time = ddi_get_lbolt();
+	zilog->zl_replay_arg = &zr;
 	ASSERT(zilog->zl_replay_blks == 0);
 	(void) zil_parse(zilog, zil_incr_blks, zil_replay_log_record, &zr,
 	    zh->zh_claim_txg, B_TRUE);
 	vmem_free(zr.zr_lr, 2 * SPA_MAXBLOCKSIZE);
 
+	if (zr.zr_taskq != NULL) {
+		(void) zil_replay_drain(&zr);
+		taskq_destroy(zr.zr_taskq);
+		ASSERT0(avl_numnodes(&zr.zr_objs));
+		avl_destroy(&zr.zr_objs);
+		cv_destroy(&zr.zr_cv);
+		mutex_destroy(&zr.zr_lock);
+	}
+	zilog->zl_replay_arg = NULL;
+
 	zil_destroy(zilog, B_FALSE);
 	txg_wait_synced(zilog->zl_dmu_pool, zilog->zl_destroy_txg);
 	zilog->zl_replay = B_FALSE;
@@ -4347,9 +4889,25 @@ zil_replaying(zilog_t *zilog, dmu_tx_t *tx)
 		return (B_TRUE);
 
 	if (zilog->zl_replay) {
+		zil_replay_arg_t *zr = zilog->zl_replay_arg;
+		boolean_t inline_replay = B_TRUE;
+
 		dsl_dataset_dirty(dmu_objset_ds(zilog->zl_os), tx);
-		zilog->zl_replayed_seq[dmu_tx_get_txg(tx) & TXG_MASK] =
-		    zilog->zl_replaying_seq;
+
+		/*
+		 * Only records replayed inline may advance the log header,
+		 * see the comment above zil_replay_threads.  Parallel replay
+		 * tasks always run with their own record still queued.
+		 */
+		if (zr != NULL && zr->zr_taskq != NULL) {
+			mutex_enter(&zr->zr_lock);
+			inline_replay = (zr->zr_inflight == 0);
+			mutex_exit(&zr->zr_lock);
+		}
+		if (inline_replay) {
+			zilog->zl_replayed_seq[dmu_tx_get_txg(tx) & TXG_MASK] =
+			    zilog->zl_replaying_seq;
+		}
 		return (B_TRUE);
 	}
 
@@ -4394,17 +4952,27 @@ EXPORT_SYMBOL(zil_set_sync);
 EXPORT_SYMBOL(zil_set_logbias);
 EXPORT_SYMBOL(zil_sums_init);
 EXPORT_SYMBOL(zil_sums_fini);
+EXPORT_SYMBOL(zil_kstat_values_init);
 EXPORT_SYMBOL(zil_kstat_values_update);
 
 ZFS_MODULE_PARAM(zfs, zfs_, commit_timeout_pct, UINT, ZMOD_RW,
 	"ZIL block open timeout percentage");
 
+ZFS_MODULE_PARAM(zfs_zil, zil_, range_commit, INT, ZMOD_RW,
+	"Commit only the writes overlapping a ranged fsync");
+
 ZFS_MODULE_PARAM(zfs_zil, zil_, replay_disable, INT, ZMOD_RW,
 	"Disable intent logging replay");
 
+ZFS_MODULE_PARAM(zfs_zil, zil_, replay_threads, UINT, ZMOD_RW,
+	"Number of threads for parallel replay of out-of-order log records");
+
 ZFS_MODULE_PARAM(zfs_zil, zil_, nocacheflush, INT, ZMOD_RW,
 	"Disable ZIL cache flushes");
 
+ZFS_MODULE_PARAM(zfs_zil, zil_, shared_flush, INT, ZMOD_RW,
+	"Coalesce concurrent ZIL cache flushes of all datasets per vdev");
+
 ZFS_MODULE_PARAM(zfs_zil, zil_, slog_bulk, U64, ZMOD_RW,
 	"Limit in bytes slog sync writes per commit");
 
@@ -53,6 +53,7 @@
 #include <sys/trace_zfs.h>
 #include <sys/abd.h>
 #include <sys/dsl_crypt.h>
+#include <sys/blake3.h>
 #include <cityhash.h>
 
 /*
@@ -140,6 +141,30 @@ static uint_t zfs_sync_pass_rewrite = 2;
 int zio_exclude_metadata = 0;
 static int zio_requeue_io_start_cut_in_line = 1;
 
+/*
+ * Time every pipeline stage transition and aggregate the results into the
+ * per-pool "zio_stages" kstat.  Off by default to keep gethrtime() out of
+ * the pipeline.
+ */
+static int zio_stage_histograms = 0;
+
+/*
+ * Compute the checksums of up to this many small concurrent BLAKE3 writes
+ * together, so that the multi-buffer BLAKE3 kernels can fill their SIMD
+ * lanes with chunks of different blocks.  0 or 1 disables batching.
+ */
+static uint_t zio_checksum_batch_max = 0;
+
+/*
+ * Writes waiting for their checksum to be computed in a batch.  The first
+ * write to find zio_checksum_batch_busy clear computes the checksums of
+ * everything that queues up until the queue is empty, everybody else only
+ * adds its write and suspends it.
+ */
+static kmutex_t zio_checksum_batch_lock;
+static list_t zio_checksum_batch_list;
+static boolean_t zio_checksum_batch_busy;
+
 #ifdef ZFS_DEBUG
 static const int zio_buf_debug_limit = 16384;
 #else
@@ -289,9 +314,14 @@ zio_init(void)
 			zio_data_buf_cache[c - 1] = zio_data_buf_cache[c];
 	}
 
+	mutex_init(&zio_checksum_batch_lock, NULL, MUTEX_DEFAULT, NULL);
+	list_create(&zio_checksum_batch_list, sizeof (zio_t),
+	    offsetof(zio_t, io_queue_node.l));
+
 	zio_inject_init();
 
 	lz4_init();
+	zio_compress_init();
 }
 
 void
@@ -356,8 +386,13 @@ zio_fini(void)
 	kmem_cache_destroy(zio_link_cache);
 	kmem_cache_destroy(zio_cache);
 
+	ASSERT(!zio_checksum_batch_busy);
+	list_destroy(&zio_checksum_batch_list);
+	mutex_destroy(&zio_checksum_batch_lock);
+
 	zio_inject_fini();
 
+	zio_compress_fini();
 	lz4_fini();
 }
 
@@ -796,7 +831,13 @@ zio_add_child_first(zio_t *pio, zio_t *cio)
 	    (cio->io_child_type != ZIO_CHILD_VDEV),
 	    (pio->io_pipeline & ZIO_STAGE_READY) == 0);
 
-	zio_link_t *zl = kmem_cache_alloc(zio_link_cache, KM_SLEEP);
+	/*
+	 * A zio's first parent is always added here, when the zio is
+	 * created, so its link is embedded in the child and does not need
+	 * to be allocated.  This saves a zio_link_cache allocation for every
+	 * child of a mirror, RAID-Z or other vdev fan-out.
+	 */
+	zio_link_t *zl = &cio->io_parent_link;
 	zl->zl_parent = pio;
 	zl->zl_child = cio;
 
@@ -830,7 +871,8 @@ zio_remove_child(zio_t *pio, zio_t *cio, zio_link_t *zl)
 
 	mutex_exit(&cio->io_lock);
 	mutex_exit(&pio->io_lock);
-	kmem_cache_free(zio_link_cache, zl);
+	if (zl != &cio->io_parent_link)
+		kmem_cache_free(zio_link_cache, zl);
 }
 
 static boolean_t
@@ -1054,6 +1096,7 @@ zio_create(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 
 	if (pio != NULL) {
 		zio->io_metaslab_class = pio->io_metaslab_class;
+		zio->io_qos_weight = pio->io_qos_weight;
 		if (zio->io_logical == NULL)
 			zio->io_logical = pio->io_logical;
 		if (zio->io_child_type == ZIO_CHILD_GANG)
@@ -1063,6 +1106,8 @@ zio_create(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 
 	taskq_init_ent(&zio->io_tqent);
 
+	DTRACE_PROBE1(zio__create, zio_t *, zio);
+
 	return (zio);
 }
 
@@ -1388,6 +1433,16 @@ zio_write(zio_t *pio, spa_t *spa, uint64_t txg, blkptr_t *bp,
 	zio->io_children_ready = children_ready;
 	zio->io_prop = *zp;
 
+	/*
+	 * Count blocks written by each spa_sync() pass for the txgs kstat.
+	 * Open context writes (dmu_sync()) are never for the syncing txg.
+	 */
+	uint32_t pass = spa->spa_sync_pass;
+	if (pass != 0 && txg == spa->spa_syncing_txg) {
+		atomic_inc_64(&spa->spa_sync_pass_blocks[
+		    MIN(pass, SPA_SYNC_PASS_HIST) - 1]);
+	}
+
 	/*
 	 * Data can be NULL if we are going to call zio_write_override() to
 	 * provide the already-allocated BP.  But we may need the data to
@@ -1999,12 +2054,30 @@ zio_write_compress(zio_t *zio)
 			psize = 0;
 		else if (compress == ZIO_COMPRESS_EMPTY)
 			psize = lsize;
-		else
+		else if (zio_compress_incompressible(zio->io_abd, lsize))
+			psize = lsize;
+		else {
+			boolean_t autolevel = ((compress == ZIO_COMPRESS_ZSTD ||
+			    compress == ZIO_COMPRESS_ZSTD_CHUNKED) &&
+			    zp->zp_complevel == ZIO_ZSTD_LEVEL_AUTO);
+			uint8_t complevel = autolevel ?
+			    zio_zstd_auto_level() : zp->zp_complevel;
+
 			psize = zio_compress_data(compress, zio->io_abd, &cabd,
 			    lsize,
 			    zio_get_compression_max_size(compress,
 			    spa->spa_gcd_alloc, spa->spa_min_alloc, lsize),
-			    zp->zp_complevel);
+			    complevel);
+
+			/*
+			 * Record the level actually used, so that the ARC and
+			 * L2ARC can recompress the block identically.
+			 */
+			if (autolevel) {
+				zio_zstd_auto_done(complevel, lsize, psize);
+				zp->zp_complevel = complevel;
+			}
+		}
 		if (psize == 0) {
 			compress = ZIO_COMPRESS_OFF;
 		} else if (psize >= lsize) {
@@ -2013,6 +2086,7 @@ zio_write_compress(zio_t *zio)
 				abd_free(cabd);
 		} else if (psize <= BPE_PAYLOAD_SIZE && !zp->zp_encrypt &&
 		    zp->zp_level == 0 && !DMU_OT_HAS_FILL(zp->zp_type) &&
+		    !ZIO_COMPRESS_IS_CHUNKED(compress) &&
 		    spa_feature_is_enabled(spa, SPA_FEATURE_EMBEDDED_DATA)) {
 			void *cbuf = abd_borrow_buf_copy(cabd, lsize);
 			encode_embedded_bp_compressed(bp,
@@ -2491,6 +2565,21 @@ __zio_execute(zio_t *zio)
 			return;
 		}
 
+		/*
+		 * Charge the time since the previous stage started, which
+		 * includes any waiting for children or for the device, to
+		 * that stage.
+		 */
+		if (unlikely(zio_stage_histograms)) {
+			hrtime_t now = gethrtime();
+			if (zio->io_stage_timestamp != 0) {
+				spa_zio_stage_add_nsecs(zio->io_spa,
+				    highbit64(zio->io_stage) - 1,
+				    now - zio->io_stage_timestamp);
+			}
+			zio->io_stage_timestamp = now;
+		}
+
 		zio->io_stage = stage;
 		zio->io_pipeline_trace |= zio->io_stage;
 
@@ -2766,6 +2855,9 @@ zio_resume_wait(spa_t *spa)
  * an indirect block: it's an array of block pointers.  It consumes
  * only one sector and hence is allocatable regardless of fragmentation.
  * The gang header's bps point to its gang members, which hold the data.
+ * With the dynamic_gang_header feature, the gang header fills the whole
+ * sector rather than its first SPA_GANGBLOCKSIZE bytes, so that on a
+ * vdev with 4K sectors it holds up to 31 gang members instead of three.
  *
  * Gang blocks are self-checksumming, using the bp's <vdev, offset, txg>
  * as the verifier to ensure uniqueness of the SHA256 checksum.
@@ -2817,6 +2909,38 @@ zio_resume_wait(spa_t *spa)
  * ==========================================================================
  */
 
+/*
+ * Return the size of the gang header that bp points to, written in txg
+ * birth.  Headers born once the dynamic_gang_header feature is in use fill
+ * one sector of the smallest ashift among the bp's vdevs; this costs no
+ * extra space, since SPA_GANGBLOCKSIZE is rounded up to a sector anyway.
+ * Older headers are SPA_GANGBLOCKSIZE bytes.  Top-level vdevs never change
+ * their ashift, so the writer and every later reader agree on the size.
+ */
+uint64_t
+zio_gang_header_size(spa_t *spa, const blkptr_t *bp, uint64_t birth)
+{
+	if (birth < spa->spa_gang_header_txg)
+		return (SPA_GANGBLOCKSIZE);
+
+	boolean_t locked = !spa_config_held(spa, SCL_VDEV, RW_WRITER);
+	if (locked)
+		spa_config_enter(spa, SCL_VDEV, FTAG, RW_READER);
+
+	uint64_t ashift = ASHIFT_MAX;
+	for (int d = 0; d < BP_GET_NDVAS(bp); d++) {
+		vdev_t *vd = vdev_lookup_top(spa,
+		    DVA_GET_VDEV(&bp->blk_dva[d]));
+		if (vd != NULL && vd->vdev_ashift != 0)
+			ashift = MIN(ashift, vd->vdev_ashift);
+	}
+
+	if (locked)
+		spa_config_exit(spa, SCL_VDEV, FTAG);
+
+	return (MAX(1ULL << ashift, SPA_GANGBLOCKSIZE));
+}
+
 static void
 zio_gang_issue_func_done(zio_t *zio)
 {
@@ -2844,10 +2968,10 @@ zio_rewrite_gang(zio_t *pio, blkptr_t *bp, zio_gang_node_t *gn, abd_t *data,
 
 	if (gn != NULL) {
 		abd_t *gbh_abd =
-		    abd_get_from_buf(gn->gn_gbh, SPA_GANGBLOCKSIZE);
+		    abd_get_from_buf(gn->gn_gbh, gn->gn_gangblocksize);
 		zio = zio_rewrite(pio, pio->io_spa, pio->io_txg, bp,
-		    gbh_abd, SPA_GANGBLOCKSIZE, zio_gang_issue_func_done, NULL,
-		    pio->io_priority, ZIO_GANG_CHILD_FLAGS(pio),
+		    gbh_abd, gn->gn_gangblocksize, zio_gang_issue_func_done,
+		    NULL, pio->io_priority, ZIO_GANG_CHILD_FLAGS(pio),
 		    &pio->io_bookmark);
 		/*
 		 * As we rewrite each gang header, the pipeline will compute
@@ -2917,15 +3041,23 @@ static zio_gang_issue_func_t *zio_gang_issue_func[ZIO_TYPES] = {
 
 static void zio_gang_tree_assemble_done(zio_t *zio);
 
+static size_t
+zio_gang_node_size(uint64_t gangblocksize)
+{
+	return (offsetof(zio_gang_node_t,
+	    gn_child[gbh_nblkptrs(gangblocksize)]));
+}
+
 static zio_gang_node_t *
-zio_gang_node_alloc(zio_gang_node_t **gnpp)
+zio_gang_node_alloc(zio_gang_node_t **gnpp, uint64_t gangblocksize)
 {
 	zio_gang_node_t *gn;
 
 	ASSERT(*gnpp == NULL);
 
-	gn = kmem_zalloc(sizeof (*gn), KM_SLEEP);
-	gn->gn_gbh = zio_buf_alloc(SPA_GANGBLOCKSIZE);
+	gn = kmem_zalloc(zio_gang_node_size(gangblocksize), KM_SLEEP);
+	gn->gn_gangblocksize = gangblocksize;
+	gn->gn_gbh = zio_buf_alloc(gangblocksize);
 	*gnpp = gn;
 
 	return (gn);
@@ -2935,12 +3067,13 @@ static void
 zio_gang_node_free(zio_gang_node_t **gnpp)
 {
 	zio_gang_node_t *gn = *gnpp;
+	uint64_t gangblocksize = gn->gn_gangblocksize;
 
-	for (int g = 0; g < SPA_GBH_NBLKPTRS; g++)
+	for (int g = 0; g < gbh_nblkptrs(gangblocksize); g++)
 		ASSERT(gn->gn_child[g] == NULL);
 
-	zio_buf_free(gn->gn_gbh, SPA_GANGBLOCKSIZE);
-	kmem_free(gn, sizeof (*gn));
+	zio_buf_free(gn->gn_gbh, gangblocksize);
+	kmem_free(gn, zio_gang_node_size(gangblocksize));
 	*gnpp = NULL;
 }
 
@@ -2952,7 +3085,7 @@ zio_gang_tree_free(zio_gang_node_t **gnpp)
 	if (gn == NULL)
 		return;
 
-	for (int g = 0; g < SPA_GBH_NBLKPTRS; g++)
+	for (int g = 0; g < gbh_nblkptrs(gn->gn_gangblocksize); g++)
 		zio_gang_tree_free(&gn->gn_child[g]);
 
 	zio_gang_node_free(gnpp);
@@ -2961,13 +3094,15 @@ zio_gang_tree_free(zio_gang_node_t **gnpp)
 static void
 zio_gang_tree_assemble(zio_t *gio, blkptr_t *bp, zio_gang_node_t **gnpp)
 {
-	zio_gang_node_t *gn = zio_gang_node_alloc(gnpp);
-	abd_t *gbh_abd = abd_get_from_buf(gn->gn_gbh, SPA_GANGBLOCKSIZE);
+	uint64_t gangblocksize = zio_gang_header_size(gio->io_spa, bp,
+	    BP_GET_BIRTH(bp));
+	zio_gang_node_t *gn = zio_gang_node_alloc(gnpp, gangblocksize);
+	abd_t *gbh_abd = abd_get_from_buf(gn->gn_gbh, gangblocksize);
 
 	ASSERT(gio->io_gang_leader == gio);
 	ASSERT(BP_IS_GANG(bp));
 
-	zio_nowait(zio_read(gio, gio->io_spa, bp, gbh_abd, SPA_GANGBLOCKSIZE,
+	zio_nowait(zio_read(gio, gio->io_spa, bp, gbh_abd, gangblocksize,
 	    zio_gang_tree_assemble_done, gn, gio->io_priority,
 	    ZIO_GANG_CHILD_FLAGS(gio), &gio->io_bookmark));
 }
@@ -2990,13 +3125,14 @@ zio_gang_tree_assemble_done(zio_t *zio)
 		byteswap_uint64_array(abd_to_buf(zio->io_abd), zio->io_size);
 
 	ASSERT3P(abd_to_buf(zio->io_abd), ==, gn->gn_gbh);
-	ASSERT(zio->io_size == SPA_GANGBLOCKSIZE);
-	ASSERT(gn->gn_gbh->zg_tail.zec_magic == ZEC_MAGIC);
+	ASSERT(zio->io_size == gn->gn_gangblocksize);
+	ASSERT(gbh_eck(gn->gn_gbh, gn->gn_gangblocksize)->zec_magic ==
+	    ZEC_MAGIC);
 
 	abd_free(zio->io_abd);
 
-	for (int g = 0; g < SPA_GBH_NBLKPTRS; g++) {
-		blkptr_t *gbp = &gn->gn_gbh->zg_blkptr[g];
+	for (int g = 0; g < gbh_nblkptrs(gn->gn_gangblocksize); g++) {
+		blkptr_t *gbp = gbh_bp(gn->gn_gbh, g);
 		if (!BP_IS_GANG(gbp))
 			continue;
 		zio_gang_tree_assemble(gio, gbp, &gn->gn_child[g]);
@@ -3021,10 +3157,11 @@ zio_gang_tree_issue(zio_t *pio, zio_gang_node_t *gn, blkptr_t *bp, abd_t *data,
 	zio = zio_gang_issue_func[gio->io_type](pio, bp, gn, data, offset);
 
 	if (gn != NULL) {
-		ASSERT(gn->gn_gbh->zg_tail.zec_magic == ZEC_MAGIC);
+		ASSERT(gbh_eck(gn->gn_gbh, gn->gn_gangblocksize)->zec_magic ==
+		    ZEC_MAGIC);
 
-		for (int g = 0; g < SPA_GBH_NBLKPTRS; g++) {
-			blkptr_t *gbp = &gn->gn_gbh->zg_blkptr[g];
+		for (int g = 0; g < gbh_nblkptrs(gn->gn_gangblocksize); g++) {
+			blkptr_t *gbp = gbh_bp(gn->gn_gbh, g);
 			if (BP_IS_HOLE(gbp))
 				continue;
 			zio_gang_tree_issue(zio, gn->gn_child[g], gbp, data,
@@ -3191,15 +3328,31 @@ zio_write_gang_block(zio_t *pio, metaslab_class_t *mc)
 		ASSERT(pio->io_ready == zio_write_gang_member_ready);
 	}
 
-	gn = zio_gang_node_alloc(gnpp);
+	/*
+	 * The header was allocated as SPA_GANGBLOCKSIZE, which takes a whole
+	 * sector; now that we know its vdevs, fill as much of it as we may.
+	 */
+	uint64_t gangblocksize = zio_gang_header_size(spa, bp, txg);
+	int nblkptrs = gbh_nblkptrs(gangblocksize);
+	if (gangblocksize != SPA_GANGBLOCKSIZE) {
+		/* The queue depth is released at the size we write. */
+		for (int d = 0; d < BP_GET_NDVAS(bp); d++) {
+			metaslab_group_alloc_decrement(spa,
+			    DVA_GET_VDEV(&bp->blk_dva[d]), pio->io_allocator,
+			    flags, SPA_GANGBLOCKSIZE, pio);
+		}
+		metaslab_group_alloc_increment_all(spa, bp, pio->io_allocator,
+		    flags, gangblocksize, pio);
+	}
+	gn = zio_gang_node_alloc(gnpp, gangblocksize);
 	gbh = gn->gn_gbh;
-	memset(gbh, 0, SPA_GANGBLOCKSIZE);
-	gbh_abd = abd_get_from_buf(gbh, SPA_GANGBLOCKSIZE);
+	memset(gbh, 0, gangblocksize);
+	gbh_abd = abd_get_from_buf(gbh, gangblocksize);
 
 	/*
 	 * Create the gang header.
 	 */
-	zio = zio_rewrite(pio, spa, txg, bp, gbh_abd, SPA_GANGBLOCKSIZE,
+	zio = zio_rewrite(pio, spa, txg, bp, gbh_abd, gangblocksize,
 	    zio_write_gang_done, NULL, pio->io_priority,
 	    ZIO_GANG_CHILD_FLAGS(pio), &pio->io_bookmark);
 
@@ -3231,21 +3384,39 @@ zio_write_gang_block(zio_t *pio, metaslab_class_t *mc)
 		zp.zp_encrypt = gio->io_prop.zp_encrypt;
 		zp.zp_byteorder = gio->io_prop.zp_byteorder;
 		zp.zp_direct_write = B_FALSE;
+		zp.zp_class_hint = ZIO_CLASS_HINT_NONE;
 		memset(zp.zp_salt, 0, ZIO_DATA_SALT_LEN);
 		memset(zp.zp_iv, 0, ZIO_DATA_IV_LEN);
 		memset(zp.zp_mac, 0, ZIO_DATA_MAC_LEN);
 
+		/*
+		 * Every member costs an I/O, so first ask for pieces as large
+		 * as a three member header would, and only fall back to
+		 * spreading what is left over all the remaining slots of a
+		 * wide header if the pool is too fragmented for that.
+		 */
 		uint64_t min_size = zio_roundup_alloc_size(spa,
-		    resid / (SPA_GBH_NBLKPTRS - g));
+		    resid / (nblkptrs - g));
 		min_size = MIN(min_size, resid);
-		bp = &gbh->zg_blkptr[g];
+		uint64_t want_size = zio_roundup_alloc_size(spa,
+		    resid / MIN(nblkptrs - g, SPA_GBH_NBLKPTRS));
+		want_size = MIN(want_size, resid);
+		bp = gbh_bp(gbh, g);
 
 		zio_alloc_list_t cio_list;
 		metaslab_trace_init(&cio_list);
 		uint64_t allocated_size = UINT64_MAX;
-		error = metaslab_alloc_range(spa, mc, min_size, resid,
+		error = metaslab_alloc_range(spa, mc, want_size, resid,
 		    bp, gio->io_prop.zp_copies, txg, NULL,
 		    flags, &cio_list, zio->io_allocator, NULL, &allocated_size);
+		if (error != 0 && want_size > min_size) {
+			metaslab_trace_fini(&cio_list);
+			metaslab_trace_init(&cio_list);
+			error = metaslab_alloc_range(spa, mc, min_size, resid,
+			    bp, gio->io_prop.zp_copies, txg, NULL, flags,
+			    &cio_list, zio->io_allocator, NULL,
+			    &allocated_size);
+		}
 
 		boolean_t allocated = error == 0;
 
@@ -3741,6 +3912,22 @@ zio_ddt_write(zio_t *zio)
 	 */
 	ASSERT3B(zio->io_prop.zp_direct_write, ==, B_FALSE);
 
+	/*
+	 * On the first pass, queue our key for a sorted batch prefetch and
+	 * go to the back of the issue queue, so the writes behind us can add
+	 * theirs and the stored entries are read in together. When we come
+	 * back, issue whatever is still pending before our own lookup.
+	 */
+	if (!(zio->io_flags & ZIO_FLAG_DDT_PREFETCHED)) {
+		zio->io_flags |= ZIO_FLAG_DDT_PREFETCHED;
+		if (ddt_prefetch_batch_add(ddt, bp)) {
+			zio->io_stage >>= 1;
+			zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, B_FALSE);
+			return (NULL);
+		}
+	}
+	ddt_prefetch_batch_issue(ddt);
+
 	ddt_enter(ddt);
 	/*
 	 * Search DDT for matching entry.  Skip DVAs verification here, since
@@ -4101,6 +4288,17 @@ zio_io_to_allocate(metaslab_class_allocator_t *mca, boolean_t *more)
 	return (zio);
 }
 
+/*
+ * Called for a zio that could not be given a reservation when it first
+ * reached the throttle and was issued later, once one freed up.
+ */
+static void
+zio_dva_throttle_waited(zio_t *zio)
+{
+	spa_iostats_alloc_throttle_add(zio->io_spa, zio->io_metaslab_class,
+	    gethrtime() - zio->io_throttle_timestamp);
+}
+
 static zio_t *
 zio_dva_throttle(zio_t *zio)
 {
@@ -4131,10 +4329,13 @@ zio_dva_throttle(zio_t *zio)
 
 	zio->io_metaslab_class = mc;
 	metaslab_class_allocator_t *mca = &mc->mc_allocator[zio->io_allocator];
+	zio->io_throttle_timestamp = gethrtime();
 	mutex_enter(&mca->mca_lock);
 	avl_add(&mca->mca_tree, zio);
 	nio = zio_io_to_allocate(mca, &more);
 	mutex_exit(&mca->mca_lock);
+	if (nio != NULL && nio != zio)
+		zio_dva_throttle_waited(nio);
 	return (nio);
 }
 
@@ -4154,6 +4355,7 @@ zio_allocate_dispatch(metaslab_class_t *mc, int allocator)
 
 		ASSERT3U(zio->io_stage, ==, ZIO_STAGE_DVA_THROTTLE);
 		ASSERT0(zio->io_error);
+		zio_dva_throttle_waited(zio);
 		zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, B_TRUE);
 	} while (more);
 }
@@ -4202,6 +4404,18 @@ zio_dva_allocate(zio_t *zio)
 	}
 	ZIOSTAT_BUMP(ziostat_total_allocations);
 
+	/*
+	 * The data blocks of one object form a stream, which the metaslab
+	 * allocator may keep together.
+	 */
+	if (zio->io_prop.zp_level == 0 &&
+	    !DMU_OT_IS_METADATA(zio->io_prop.zp_type) &&
+	    !(flags & METASLAB_GANG_CHILD)) {
+		zio->io_alloc_list.zal_stream =
+		    cityhash2(zio->io_bookmark.zb_objset,
+		    zio->io_bookmark.zb_object) | 1;
+	}
+
 again:
 	/*
 	 * Try allocating the block in the usual metaslab class.
@@ -4342,9 +4556,9 @@ zio_dva_unallocate(zio_t *zio, zio_gang_node_t *gn, blkptr_t *bp)
 	}
 
 	if (gn != NULL) {
-		for (int g = 0; g < SPA_GBH_NBLKPTRS; g++) {
+		for (int g = 0; g < gbh_nblkptrs(gn->gn_gangblocksize); g++) {
 			zio_dva_unallocate(zio, gn->gn_child[g],
-			    &gn->gn_gbh->zg_blkptr[g]);
+			    gbh_bp(gn->gn_gbh, g));
 		}
 	}
 }
@@ -4379,7 +4593,7 @@ zio_alloc_zil(spa_t *spa, objset_t *os, uint64_t txg, blkptr_t *new_bp,
 	 */
 	int flags = METASLAB_ZIL;
 	int allocator = (uint_t)cityhash1(os->os_dsl_dataset->ds_object)
-	    % spa->spa_alloc_count;
+	    % spa->spa_alloc_active;
 	ZIOSTAT_BUMP(ziostat_total_allocations);
 	error = metaslab_alloc(spa, spa_log_class(spa), size, new_bp, 1,
 	    txg, NULL, flags, &io_alloc_list, allocator, NULL);
@@ -4989,6 +5203,63 @@ zio_encrypt(zio_t *zio)
  * Generate and verify checksums
  * ==========================================================================
  */
+/*
+ * The widest BLAKE3 kernel (AVX-512) hashes 16 chunks at a time, so blocks
+ * of 16 KiB and up already fill its lanes on their own.
+ */
+static boolean_t
+zio_checksum_batch_eligible(zio_t *zio, enum zio_checksum checksum)
+{
+	return (zio_checksum_batch_max > 1 &&
+	    checksum == ZIO_CHECKSUM_BLAKE3 &&
+	    ISP2(zio->io_size) &&
+	    zio->io_size < 16 * BLAKE3_CHUNK_LEN);
+}
+
+static zio_t *
+zio_checksum_generate_batch(zio_t *zio)
+{
+	uint_t max = MIN(zio_checksum_batch_max, BLAKE3_MANY_MAX);
+	zio_t *batch[BLAKE3_MANY_MAX];
+
+	mutex_enter(&zio_checksum_batch_lock);
+	list_insert_tail(&zio_checksum_batch_list, zio);
+	if (zio_checksum_batch_busy) {
+		/* The current leader will compute it and resume the zio. */
+		mutex_exit(&zio_checksum_batch_lock);
+		return (NULL);
+	}
+	zio_checksum_batch_busy = B_TRUE;
+
+	zio_t *head;
+	while ((head = list_head(&zio_checksum_batch_list)) != NULL) {
+		uint_t n = 0;
+
+		for (zio_t *z = head, *next; z != NULL && n < max; z = next) {
+			next = list_next(&zio_checksum_batch_list, z);
+			if (z->io_spa != head->io_spa ||
+			    z->io_size != head->io_size)
+				continue;
+			list_remove(&zio_checksum_batch_list, z);
+			batch[n++] = z;
+		}
+		mutex_exit(&zio_checksum_batch_lock);
+
+		zio_checksum_compute_many(batch, n, ZIO_CHECKSUM_BLAKE3);
+		for (uint_t i = 0; i < n; i++) {
+			if (batch[i] != zio)
+				zio_taskq_dispatch(batch[i], ZIO_TASKQ_ISSUE,
+				    B_FALSE);
+		}
+
+		mutex_enter(&zio_checksum_batch_lock);
+	}
+	zio_checksum_batch_busy = B_FALSE;
+	mutex_exit(&zio_checksum_batch_lock);
+
+	return (zio);
+}
+
 static zio_t *
 zio_checksum_generate(zio_t *zio)
 {
@@ -5015,6 +5286,9 @@ zio_checksum_generate(zio_t *zio)
 		}
 	}
 
+	if (zio_checksum_batch_eligible(zio, checksum))
+		return (zio_checksum_generate_batch(zio));
+
 	zio_checksum_compute(zio, checksum, zio->io_abd, zio->io_size);
 
 	return (zio);
@@ -5642,6 +5916,7 @@ zio_done(zio_t *zio)
 	 * particular zio is no longer discoverable for adoption, and as
 	 * such, cannot acquire any new parents.
 	 */
+	DTRACE_PROBE1(zio__done, zio_t *, zio);
 	if (zio->io_done)
 		zio->io_done(zio);
 
@@ -5709,6 +5984,39 @@ static zio_pipe_stage_t *zio_pipeline[] = {
 	zio_done
 };
 
+_Static_assert(ARRAY_SIZE(zio_pipeline) == ZIO_STAGES,
+	"ZIO_STAGES does not match the pipeline");
+
+const char *const zio_stage_names[ZIO_STAGES] = {
+	"open",
+	"read_bp_init",
+	"write_bp_init",
+	"free_bp_init",
+	"issue_async",
+	"write_compress",
+	"encrypt",
+	"checksum_generate",
+	"nop_write",
+	"brt_free",
+	"ddt_read_start",
+	"ddt_read_done",
+	"ddt_write",
+	"ddt_free",
+	"gang_assemble",
+	"gang_issue",
+	"dva_throttle",
+	"dva_allocate",
+	"dva_free",
+	"dva_claim",
+	"ready",
+	"vdev_io_start",
+	"vdev_io_done",
+	"vdev_io_assess",
+	"checksum_verify",
+	"dio_checksum_verify",
+	"done"
+};
+
 
 
 
@@ -5862,9 +6170,15 @@ EXPORT_SYMBOL(zio_data_buf_free);
 ZFS_MODULE_PARAM(zfs_zio, zio_, slow_io_ms, INT, ZMOD_RW,
 	"Max I/O completion time (milliseconds) before marking it as slow");
 
+ZFS_MODULE_PARAM(zfs_zio, zio_, stage_histograms, INT, ZMOD_RW,
+	"Collect per-pool latency histograms of zio pipeline stages");
+
 ZFS_MODULE_PARAM(zfs_zio, zio_, requeue_io_start_cut_in_line, INT, ZMOD_RW,
 	"Prioritize requeued I/O");
 
+ZFS_MODULE_PARAM(zfs_zio, zio_, checksum_batch_max, UINT, ZMOD_RW,
+	"Max small BLAKE3 writes to checksum together");
+
 ZFS_MODULE_PARAM(zfs, zfs_, sync_pass_deferred_free,  UINT, ZMOD_RW,
 	"Defer frees starting in this pass");
 
@@ -32,6 +32,7 @@
 #include <sys/zio_checksum.h>
 #include <sys/zil.h>
 #include <sys/abd.h>
+#include <sys/blake3.h>
 #include <zfs_fletcher.h>
 
 /*
@@ -418,6 +419,45 @@ zio_checksum_compute(zio_t *zio, enum zio_checksum checksum,
 	}
 }
 
+/*
+ * Compute the checksums of n zios of the same pool and size at once. Only
+ * checksums that store their result in the block pointer and that have a
+ * multi-buffer implementation (currently BLAKE3) can be batched.
+ */
+void
+zio_checksum_compute_many(zio_t **zios, uint_t n, enum zio_checksum checksum)
+{
+	zio_checksum_info_t *ci = &zio_checksum_table[checksum];
+	boolean_t insecure = (ci->ci_flags & ZCHECKSUM_FLAG_DEDUP) == 0;
+	spa_t *spa = zios[0]->io_spa;
+	uint64_t size = zios[0]->io_size;
+	abd_t *abds[BLAKE3_MANY_MAX];
+	zio_cksum_t cksums[BLAKE3_MANY_MAX];
+
+	ASSERT3U(checksum, ==, ZIO_CHECKSUM_BLAKE3);
+	ASSERT3U(n, <=, BLAKE3_MANY_MAX);
+
+	zio_checksum_template_init(checksum, spa);
+
+	for (uint_t i = 0; i < n; i++) {
+		ASSERT3P(zios[i]->io_spa, ==, spa);
+		ASSERT3U(zios[i]->io_size, ==, size);
+		abds[i] = zios[i]->io_abd;
+	}
+
+	abd_checksum_blake3_native_many(abds, n, size,
+	    spa->spa_cksum_tmpls[checksum], cksums);
+
+	for (uint_t i = 0; i < n; i++) {
+		blkptr_t *bp = zios[i]->io_bp;
+		zio_cksum_t saved = bp->blk_cksum;
+
+		if (BP_USES_CRYPT(bp) && BP_GET_TYPE(bp) != DMU_OT_OBJSET)
+			zio_checksum_handle_crypt(&cksums[i], &saved, insecure);
+		bp->blk_cksum = cksums[i];
+	}
+}
+
 int
 zio_checksum_error_impl(spa_t *spa, const blkptr_t *bp,
     enum zio_checksum checksum, abd_t *abd, uint64_t size, uint64_t offset,
@@ -545,11 +585,12 @@ zio_checksum_error(zio_t *zio, zio_bad_cksum_t *info)
 	uint_t checksum = (bp == NULL ? zio->io_prop.zp_checksum :
 	    (BP_IS_GANG(bp) ? ZIO_CHECKSUM_GANG_HEADER : BP_GET_CHECKSUM(bp)));
 	int error;
+	spa_t *spa = zio->io_spa;
 	uint64_t size = (bp == NULL ? zio->io_size :
-	    (BP_IS_GANG(bp) ? SPA_GANGBLOCKSIZE : BP_GET_PSIZE(bp)));
+	    (BP_IS_GANG(bp) ? zio_gang_header_size(spa, bp, BP_GET_BIRTH(bp)) :
+	    BP_GET_PSIZE(bp)));
 	uint64_t offset = zio->io_offset;
 	abd_t *data = zio->io_abd;
-	spa_t *spa = zio->io_spa;
 
 	error = zio_checksum_error_impl(spa, bp, checksum, data, size,
 	    offset, info);
@@ -43,6 +43,135 @@
  */
 static unsigned long zio_decompress_fail_fraction = 0;
 
+/*
+ * Before compressing a block, zio_write_compress() samples it and skips
+ * compression if the byte entropy of the sample is at least this percentage
+ * of the 8 bits per byte maximum.  Zero disables the check.  It is off by
+ * default because it changes which blocks are compressed; 98 is a
+ * reasonable value for pools holding much incompressible data.
+ */
+static uint_t zio_compress_probe_pct = 0;
+
+#define	ZIO_PROBE_SAMPLES	64
+#define	ZIO_PROBE_SAMPLE_SIZE	64
+#define	ZIO_PROBE_SHIFT		12	/* log2(samples * sample size) */
+#define	ZIO_PROBE_MIN_SIZE	(16 * 1024)
+
+/*
+ * compression=zstd-auto picks a level for each block between zstd_auto_min
+ * and zstd_auto_max.  The more blocks are being compressed at once relative
+ * to the number of CPUs, the lower the level; when recently written data
+ * has barely compressed (compressed/logical size above zstd_auto_poor_pct)
+ * the minimum level is used, as extra effort is unlikely to pay off.
+ */
+static uint_t zstd_auto_min = ZIO_ZSTD_LEVEL_1;
+static uint_t zstd_auto_max = ZIO_ZSTD_LEVEL_9;
+static uint_t zstd_auto_poor_pct = 95;
+
+static uint64_t zstd_auto_busy;		/* zstd-auto blocks in progress */
+static uint_t zstd_auto_ratio_pct = 50;	/* decaying psize/lsize percentage */
+
+typedef struct zstd_auto_stats {
+	kstat_named_t	zas_blocks;
+	kstat_named_t	zas_lsize;
+	kstat_named_t	zas_psize;
+	kstat_named_t	zas_saved;
+	kstat_named_t	zas_level[ZIO_ZSTD_LEVEL_MAX];
+} zstd_auto_stats_t;
+
+static zstd_auto_stats_t zstd_auto_stats = {
+	{ "blocks",	KSTAT_DATA_UINT64 },
+	{ "lsize",	KSTAT_DATA_UINT64 },
+	{ "psize",	KSTAT_DATA_UINT64 },
+	{ "saved",	KSTAT_DATA_UINT64 },
+};
+static kstat_t *zstd_auto_ksp;
+
+/*
+ * Level 0 file blocks of at least this logical size are compressed as
+ * independent chunks of ZIO_CHUNK_SIZE bytes, so that a single block can be
+ * compressed and decompressed by several threads.  Zero disables it.
+ *
+ * The chunked format starts with an index, all big endian 32-bit words:
+ * the number of chunks, followed by the compressed size of each chunk.
+ * A chunk whose compressed size equals its logical size is stored as is.
+ * The chunks follow the index back to back, each compressed with the inner
+ * algorithm as if it were a block of its own.
+ */
+static uint_t zio_compress_chunk_min = 0;
+
+#define	ZIO_CHUNK_SHIFT		17
+#define	ZIO_CHUNK_SIZE		(1U << ZIO_CHUNK_SHIFT)
+
+typedef struct zio_chunks zio_chunks_t;
+
+struct zio_chunks {
+	zio_compress_info_t *zc_ci;
+	void		(*zc_func)(zio_chunks_t *, uint_t);
+	abd_t		*zc_src;
+	abd_t		*zc_dst;
+	size_t		zc_lsize;	/* logical size of the block */
+	int		zc_level;
+	uint_t		zc_nchunks;
+	uint32_t	*zc_len;	/* compressed size of each chunk */
+	uint32_t	*zc_off;	/* offset of each compressed chunk */
+	uint8_t		*zc_levels;	/* level found in each chunk */
+	int		zc_error;
+	uint32_t	zc_next;	/* next chunk to process */
+	uint_t		zc_helpers;	/* dispatched helpers still running */
+	kmutex_t	zc_lock;
+	kcondvar_t	zc_cv;
+};
+
+static taskq_t *zio_chunk_tq;
+
+static size_t zio_chunked_compress(enum zio_compress c, abd_t *src,
+    abd_t *dst, size_t s_len, size_t d_len, int level);
+static int zio_chunked_decompress(enum zio_compress c, abd_t *src,
+    abd_t *dst, size_t s_len, size_t d_len, uint8_t *level);
+
+static size_t
+zfs_lz4_chunked_compress(abd_t *src, abd_t *dst, size_t s_len, size_t d_len,
+    int level)
+{
+	return (zio_chunked_compress(ZIO_COMPRESS_LZ4, src, dst, s_len, d_len,
+	    level));
+}
+
+static int
+zfs_lz4_chunked_decompress(abd_t *src, abd_t *dst, size_t s_len,
+    size_t d_len, int level)
+{
+	(void) level;
+	return (zio_chunked_decompress(ZIO_COMPRESS_LZ4, src, dst, s_len,
+	    d_len, NULL));
+}
+
+static size_t
+zfs_zstd_chunked_compress(abd_t *src, abd_t *dst, size_t s_len,
+    size_t d_len, int level)
+{
+	return (zio_chunked_compress(ZIO_COMPRESS_ZSTD, src, dst, s_len,
+	    d_len, level));
+}
+
+static int
+zfs_zstd_chunked_decompress(abd_t *src, abd_t *dst, size_t s_len,
+    size_t d_len, int level)
+{
+	(void) level;
+	return (zio_chunked_decompress(ZIO_COMPRESS_ZSTD, src, dst, s_len,
+	    d_len, NULL));
+}
+
+static int
+zfs_zstd_chunked_decompress_level(abd_t *src, abd_t *dst, size_t s_len,
+    size_t d_len, uint8_t *level)
+{
+	return (zio_chunked_decompress(ZIO_COMPRESS_ZSTD, src, dst, s_len,
+	    d_len, level));
+}
+
 /*
  * Compression vectors.
  */
@@ -77,6 +206,11 @@ zio_compress_info_t zio_compress_table[ZIO_COMPRESS_FUNCTIONS] = {
 	    zfs_lz4_compress,	zfs_lz4_decompress, NULL},
 	{"zstd",	ZIO_ZSTD_LEVEL_DEFAULT,
 	    zfs_zstd_compress,	zfs_zstd_decompress, zfs_zstd_decompress_level},
+	{"lz4-chunked",	0,
+	    zfs_lz4_chunked_compress, zfs_lz4_chunked_decompress, NULL},
+	{"zstd-chunked", ZIO_ZSTD_LEVEL_DEFAULT,
+	    zfs_zstd_chunked_compress, zfs_zstd_chunked_decompress,
+	    zfs_zstd_chunked_decompress_level},
 };
 
 uint8_t
@@ -120,6 +254,257 @@ zio_compress_select(spa_t *spa, enum zio_compress child,
 	return (result);
 }
 
+/*
+ * Return the chunked variant of the compression algorithm to write a level
+ * 0 file block of lsize bytes with, or the algorithm itself.
+ */
+enum zio_compress
+zio_compress_chunked(spa_t *spa, enum zio_compress compress, uint64_t lsize)
+{
+	if (zio_compress_chunk_min == 0 ||
+	    lsize < MAX(zio_compress_chunk_min, 2 * ZIO_CHUNK_SIZE) ||
+	    !spa_feature_is_enabled(spa, SPA_FEATURE_CHUNKED_COMPRESS))
+		return (compress);
+
+	switch (compress) {
+	case ZIO_COMPRESS_LZ4:
+		return (ZIO_COMPRESS_LZ4_CHUNKED);
+	case ZIO_COMPRESS_ZSTD:
+		return (ZIO_COMPRESS_ZSTD_CHUNKED);
+	default:
+		return (compress);
+	}
+}
+
+static void
+zio_chunks_work(zio_chunks_t *zc)
+{
+	uint_t i;
+
+	while ((i = atomic_inc_32_nv(&zc->zc_next) - 1) < zc->zc_nchunks)
+		zc->zc_func(zc, i);
+}
+
+static void
+zio_chunks_helper(void *arg)
+{
+	zio_chunks_t *zc = arg;
+
+	zio_chunks_work(zc);
+
+	mutex_enter(&zc->zc_lock);
+	if (--zc->zc_helpers == 0)
+		cv_broadcast(&zc->zc_cv);
+	mutex_exit(&zc->zc_lock);
+}
+
+/*
+ * Call zc_func for every chunk, spread over the chunk taskq.  The caller
+ * takes part, so this makes progress even when no helper can be dispatched.
+ */
+static void
+zio_chunks_run(zio_chunks_t *zc)
+{
+	uint_t helpers = MIN(zc->zc_nchunks, MAX(boot_ncpus, 1)) - 1;
+
+	mutex_init(&zc->zc_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zc->zc_cv, NULL, CV_DEFAULT, NULL);
+	zc->zc_next = 0;
+	zc->zc_helpers = 0;
+
+	for (uint_t h = 0; h < helpers && zio_chunk_tq != NULL; h++) {
+		mutex_enter(&zc->zc_lock);
+		zc->zc_helpers++;
+		mutex_exit(&zc->zc_lock);
+		if (taskq_dispatch(zio_chunk_tq, zio_chunks_helper, zc,
+		    TQ_NOSLEEP) == TASKQID_INVALID) {
+			mutex_enter(&zc->zc_lock);
+			zc->zc_helpers--;
+			mutex_exit(&zc->zc_lock);
+			break;
+		}
+	}
+
+	zio_chunks_work(zc);
+
+	mutex_enter(&zc->zc_lock);
+	while (zc->zc_helpers > 0)
+		cv_wait(&zc->zc_cv, &zc->zc_lock);
+	mutex_exit(&zc->zc_lock);
+
+	cv_destroy(&zc->zc_cv);
+	mutex_destroy(&zc->zc_lock);
+}
+
+/*
+ * Compress chunk i of the source into the same range of zc_dst, which is
+ * a scratch buffer of the logical size.
+ */
+static void
+zio_chunk_compress(zio_chunks_t *zc, uint_t i)
+{
+	size_t off = (size_t)i << ZIO_CHUNK_SHIFT;
+	size_t len = MIN(ZIO_CHUNK_SIZE, zc->zc_lsize - off);
+	abd_t *src = abd_get_offset_size(zc->zc_src, off, len);
+	abd_t *dst = abd_get_offset_size(zc->zc_dst, off, len);
+	size_t c_len;
+
+	c_len = zc->zc_ci->ci_compress(src, dst, len, len, zc->zc_level);
+	zc->zc_len[i] = MIN(c_len, len);
+
+	abd_free(dst);
+	abd_free(src);
+}
+
+static size_t
+zio_chunked_compress(enum zio_compress c, abd_t *src, abd_t *dst,
+    size_t s_len, size_t d_len, int level)
+{
+	zio_chunks_t zc = { 0 };
+	uint_t n = howmany(s_len, ZIO_CHUNK_SIZE);
+	size_t hdrsize = (n + 1) * sizeof (uint32_t);
+	uint32_t *hdr;
+	size_t c_len;
+
+	zc.zc_ci = &zio_compress_table[c];
+	zc.zc_func = zio_chunk_compress;
+	zc.zc_src = src;
+	zc.zc_dst = abd_alloc_sametype(src, s_len);
+	zc.zc_lsize = s_len;
+	zc.zc_level = level;
+	zc.zc_nchunks = n;
+	zc.zc_len = kmem_alloc(n * sizeof (uint32_t), KM_SLEEP);
+
+	zio_chunks_run(&zc);
+
+	hdr = kmem_alloc(hdrsize, KM_SLEEP);
+	hdr[0] = BE_32(n);
+	c_len = hdrsize;
+	for (uint_t i = 0; i < n; i++) {
+		hdr[i + 1] = BE_32(zc.zc_len[i]);
+		c_len += zc.zc_len[i];
+	}
+
+	if (c_len <= d_len) {
+		size_t pos = hdrsize;
+
+		abd_copy_from_buf_off(dst, hdr, 0, hdrsize);
+		for (uint_t i = 0; i < n; i++) {
+			size_t off = (size_t)i << ZIO_CHUNK_SHIFT;
+			size_t len = MIN(ZIO_CHUNK_SIZE, s_len - off);
+
+			abd_copy_off(dst, zc.zc_len[i] == len ? src : zc.zc_dst,
+			    pos, off, zc.zc_len[i]);
+			pos += zc.zc_len[i];
+		}
+	} else {
+		c_len = s_len;
+	}
+
+	kmem_free(hdr, hdrsize);
+	kmem_free(zc.zc_len, n * sizeof (uint32_t));
+	abd_free(zc.zc_dst);
+
+	return (c_len);
+}
+
+static void
+zio_chunk_decompress(zio_chunks_t *zc, uint_t i)
+{
+	size_t off = (size_t)i << ZIO_CHUNK_SHIFT;
+	size_t len = MIN(ZIO_CHUNK_SIZE, zc->zc_lsize - off);
+	zio_compress_info_t *ci = zc->zc_ci;
+	int err;
+
+	if (zc->zc_len[i] == len) {
+		abd_copy_off(zc->zc_dst, zc->zc_src, off, zc->zc_off[i], len);
+		return;
+	}
+
+	abd_t *src = abd_get_offset_size(zc->zc_src, zc->zc_off[i],
+	    zc->zc_len[i]);
+	abd_t *dst = abd_get_offset_size(zc->zc_dst, off, len);
+
+	if (zc->zc_levels != NULL && ci->ci_decompress_level != NULL) {
+		err = ci->ci_decompress_level(src, dst, zc->zc_len[i], len,
+		    &zc->zc_levels[i]);
+	} else {
+		err = ci->ci_decompress(src, dst, zc->zc_len[i], len,
+		    ci->ci_level);
+	}
+	if (err != 0)
+		zc->zc_error = err;
+
+	abd_free(dst);
+	abd_free(src);
+}
+
+static int
+zio_chunked_decompress(enum zio_compress c, abd_t *src, abd_t *dst,
+    size_t s_len, size_t d_len, uint8_t *level)
+{
+	zio_chunks_t zc = { 0 };
+	uint_t n = howmany(d_len, ZIO_CHUNK_SIZE);
+	size_t hdrsize = (n + 1) * sizeof (uint32_t);
+	uint32_t *hdr;
+	size_t pos = hdrsize;
+	int err = 0;
+
+	if (s_len < hdrsize)
+		return (SET_ERROR(EINVAL));
+
+	hdr = kmem_alloc(hdrsize, KM_SLEEP);
+	zc.zc_len = kmem_alloc(n * sizeof (uint32_t), KM_SLEEP);
+	zc.zc_off = kmem_alloc(n * sizeof (uint32_t), KM_SLEEP);
+	if (level != NULL)
+		zc.zc_levels = kmem_zalloc(n, KM_SLEEP);
+
+	abd_copy_to_buf_off(hdr, src, 0, hdrsize);
+	if (BE_32(hdr[0]) != n)
+		err = SET_ERROR(EINVAL);
+	for (uint_t i = 0; i < n && err == 0; i++) {
+		size_t len = MIN(ZIO_CHUNK_SIZE, d_len -
+		    ((size_t)i << ZIO_CHUNK_SHIFT));
+
+		zc.zc_len[i] = BE_32(hdr[i + 1]);
+		zc.zc_off[i] = pos;
+		if (zc.zc_len[i] == 0 || zc.zc_len[i] > len ||
+		    zc.zc_len[i] > s_len - pos)
+			err = SET_ERROR(EINVAL);
+		pos += zc.zc_len[i];
+	}
+
+	if (err == 0) {
+		zc.zc_ci = &zio_compress_table[c];
+		zc.zc_func = zio_chunk_decompress;
+		zc.zc_src = src;
+		zc.zc_dst = dst;
+		zc.zc_lsize = d_len;
+		zc.zc_nchunks = n;
+
+		zio_chunks_run(&zc);
+		err = zc.zc_error;
+	}
+
+	/* All chunks were written at the same level, report the first. */
+	if (err == 0 && level != NULL) {
+		for (uint_t i = 0; i < n; i++) {
+			if (zc.zc_levels[i] != 0) {
+				*level = zc.zc_levels[i];
+				break;
+			}
+		}
+	}
+
+	if (zc.zc_levels != NULL)
+		kmem_free(zc.zc_levels, n);
+	kmem_free(zc.zc_off, n * sizeof (uint32_t));
+	kmem_free(zc.zc_len, n * sizeof (uint32_t));
+	kmem_free(hdr, hdrsize);
+
+	return (err);
+}
+
 size_t
 zio_compress_data(enum zio_compress c, abd_t *src, abd_t **dst, size_t s_len,
     size_t d_len, uint8_t level)
@@ -133,7 +518,7 @@ zio_compress_data(enum zio_compress c, abd_t *src, abd_t **dst, size_t s_len,
 
 	complevel = ci->ci_level;
 
-	if (c == ZIO_COMPRESS_ZSTD) {
+	if (c == ZIO_COMPRESS_ZSTD || c == ZIO_COMPRESS_ZSTD_CHUNKED) {
 		/* If we don't know the level, we can't compress it */
 		if (level == ZIO_COMPLEVEL_INHERIT)
 			return (s_len);
@@ -189,8 +574,171 @@ zio_compress_to_feature(enum zio_compress comp)
 	switch (comp) {
 	case ZIO_COMPRESS_ZSTD:
 		return (SPA_FEATURE_ZSTD_COMPRESS);
+	case ZIO_COMPRESS_LZ4_CHUNKED:
+	case ZIO_COMPRESS_ZSTD_CHUNKED:
+		return (SPA_FEATURE_CHUNKED_COMPRESS);
 	default:
 		break;
 	}
 	return (SPA_FEATURE_NONE);
 }
+
+static int
+zio_compress_probe_cb(void *buf, size_t len, void *priv)
+{
+	uint16_t *hist = priv;
+	const uint8_t *p = buf;
+
+	for (size_t i = 0; i < len; i++)
+		hist[p[i]]++;
+
+	return (0);
+}
+
+/*
+ * log2(x) for x >= 1, in 1/256ths.
+ */
+static uint_t
+zio_compress_probe_log2(uint_t x)
+{
+	int n = highbit64(x) - 1;
+	uint64_t m = ((uint64_t)x << 16) >> n;
+	uint_t r = n << 8;
+
+	for (int i = 7; i >= 0; i--) {
+		m = (m * m) >> 16;
+		if (m >= (2ULL << 16)) {
+			m >>= 1;
+			r |= 1U << i;
+		}
+	}
+	return (r);
+}
+
+/*
+ * Estimate from a sample of the block whether compressing it is pointless:
+ * a byte distribution this close to uniform (random, encrypted or already
+ * compressed data) will not shrink enough with any of our algorithms.
+ * Used only when writing new blocks; recompression of existing blocks must
+ * always reproduce the original result.
+ */
+boolean_t
+zio_compress_incompressible(abd_t *src, size_t s_len)
+{
+	uint16_t hist[256] = { 0 };
+	uint64_t bits = 0;
+	size_t stride;
+
+	if (zio_compress_probe_pct == 0 || s_len < ZIO_PROBE_MIN_SIZE)
+		return (B_FALSE);
+
+	stride = s_len / ZIO_PROBE_SAMPLES;
+	for (int i = 0; i < ZIO_PROBE_SAMPLES; i++) {
+		(void) abd_iterate_func(src, i * stride,
+		    ZIO_PROBE_SAMPLE_SIZE, zio_compress_probe_cb, hist);
+	}
+
+	/* Sum of -count * log2(count / total), in 1/256 bits. */
+	for (int b = 0; b < 256; b++) {
+		if (hist[b] != 0) {
+			bits += hist[b] * ((ZIO_PROBE_SHIFT << 8) -
+			    zio_compress_probe_log2(hist[b]));
+		}
+	}
+
+	/* Compare bits per byte against the percentage of 8 << 8. */
+	return ((bits >> ZIO_PROBE_SHIFT) * 100 >=
+	    (uint64_t)zio_compress_probe_pct * (8 << 8));
+}
+
+uint8_t
+zio_zstd_auto_level(void)
+{
+	uint_t lo = MIN(MAX(zstd_auto_min, ZIO_ZSTD_LEVEL_MIN),
+	    ZIO_ZSTD_LEVEL_MAX);
+	uint_t hi = MIN(MAX(zstd_auto_max, lo), ZIO_ZSTD_LEVEL_MAX);
+	uint64_t cpus = MAX((uint64_t)boot_ncpus, 1);
+	uint64_t busy = atomic_inc_64_nv(&zstd_auto_busy);
+
+	if (zstd_auto_ratio_pct >= zstd_auto_poor_pct)
+		return (lo);
+
+	/* Don't count ourselves; a lone writer gets the maximum level. */
+	busy = MIN(busy, cpus) - 1;
+	return (hi - (hi - lo) * busy / MAX(cpus - 1, 1));
+}
+
+/*
+ * Must be called once for every zio_zstd_auto_level() call, with the
+ * result of compressing lsize bytes at that level.
+ */
+void
+zio_zstd_auto_done(uint8_t level, size_t lsize, size_t psize)
+{
+	zstd_auto_stats_t *zas = &zstd_auto_stats;
+
+	atomic_dec_64(&zstd_auto_busy);
+
+	psize = MIN(psize, lsize);
+	zstd_auto_ratio_pct = (zstd_auto_ratio_pct * 7 +
+	    (uint_t)(psize * 100 / lsize)) / 8;
+
+	atomic_inc_64(&zas->zas_blocks.value.ui64);
+	atomic_add_64(&zas->zas_lsize.value.ui64, lsize);
+	atomic_add_64(&zas->zas_psize.value.ui64, psize);
+	atomic_add_64(&zas->zas_saved.value.ui64, lsize - psize);
+	if (level >= ZIO_ZSTD_LEVEL_MIN && level <= ZIO_ZSTD_LEVEL_MAX)
+		atomic_inc_64(&zas->zas_level[level - 1].value.ui64);
+}
+
+void
+zio_compress_init(void)
+{
+	zstd_auto_stats_t *zas = &zstd_auto_stats;
+
+	for (int i = 0; i < ZIO_ZSTD_LEVEL_MAX; i++) {
+		kstat_named_t *kn = &zas->zas_level[i];
+		(void) snprintf(kn->name, sizeof (kn->name), "level_%d", i + 1);
+		kn->data_type = KSTAT_DATA_UINT64;
+	}
+
+	zstd_auto_ksp = kstat_create("zfs", 0, "zstd_auto", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (zstd_auto_stats_t) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (zstd_auto_ksp != NULL) {
+		zstd_auto_ksp->ks_data = zas;
+		kstat_install(zstd_auto_ksp);
+	}
+
+	zio_chunk_tq = taskq_create("z_zio_chunk", MAX(boot_ncpus, 1),
+	    maxclsyspri, MAX(boot_ncpus, 1), INT_MAX, TASKQ_PREPOPULATE);
+}
+
+void
+zio_compress_fini(void)
+{
+	if (zstd_auto_ksp != NULL) {
+		kstat_delete(zstd_auto_ksp);
+		zstd_auto_ksp = NULL;
+	}
+
+	if (zio_chunk_tq != NULL) {
+		taskq_destroy(zio_chunk_tq);
+		zio_chunk_tq = NULL;
+	}
+}
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, compress_probe_pct, UINT, ZMOD_RW,
+	"Sampled entropy percentage above which blocks are not compressed");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, compress_chunk_min, UINT, ZMOD_RW,
+	"Minimum file block size compressed in independent chunks");
+
+ZFS_MODULE_PARAM(zfs, zstd_, auto_min, UINT, ZMOD_RW,
+	"Lowest level used by compression=zstd-auto");
+
+ZFS_MODULE_PARAM(zfs, zstd_, auto_max, UINT, ZMOD_RW,
+	"Highest level used by compression=zstd-auto");
+
+ZFS_MODULE_PARAM(zfs, zstd_, auto_poor_pct, UINT, ZMOD_RW,
+	"Compression ratio percentage above which zstd-auto uses its minimum");
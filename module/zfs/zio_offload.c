@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: CDDL-1.0
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/zio_offload.h>
+
+/*
+ * Registry of hardware offload providers, see sys/zio_offload.h.
+ *
+ * Providers are kept in a small array protected by zio_offload_lock.
+ * Consumers hold the lock as reader for the duration of a request, so
+ * zio_offload_unregister() waits for all requests to a provider to finish
+ * before returning.  zio_offload_count lets consumers skip the lock
+ * entirely when nothing is registered, which is the common case.
+ */
+#define	ZIO_OFFLOAD_MAX_PROVIDERS	4
+
+static krwlock_t zio_offload_lock;
+static const zio_offload_provider_t
+	*zio_offload_providers[ZIO_OFFLOAD_MAX_PROVIDERS];
+static uint_t zio_offload_count;
+
+/*
+ * Disable all offload, forcing the software implementations.
+ */
+static int zio_offload_disable = 0;
+
+typedef struct zio_offload_stats {
+	kstat_named_t	zos_offloaded[ZIO_OFFLOAD_OPS];
+	kstat_named_t	zos_fallback[ZIO_OFFLOAD_OPS];
+} zio_offload_stats_t;
+
+static const char *const zio_offload_op_names[ZIO_OFFLOAD_OPS] = {
+	"compress", "decompress", "checksum", "encrypt", "decrypt"
+};
+
+static zio_offload_stats_t zio_offload_stats;
+static kstat_t *zio_offload_ksp;
+
+void
+zio_offload_init(void)
+{
+	zio_offload_stats_t *zos = &zio_offload_stats;
+
+	rw_init(&zio_offload_lock, NULL, RW_DEFAULT, NULL);
+
+	for (int op = 0; op < ZIO_OFFLOAD_OPS; op++) {
+		kstat_named_t *kn = &zos->zos_offloaded[op];
+		(void) snprintf(kn->name, sizeof (kn->name), "%s_offloaded",
+		    zio_offload_op_names[op]);
+		kn->data_type = KSTAT_DATA_UINT64;
+
+		kn = &zos->zos_fallback[op];
+		(void) snprintf(kn->name, sizeof (kn->name), "%s_fallback",
+		    zio_offload_op_names[op]);
+		kn->data_type = KSTAT_DATA_UINT64;
+	}
+
+	zio_offload_ksp = kstat_create("zfs", 0, "offload", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (zio_offload_stats_t) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (zio_offload_ksp != NULL) {
+		zio_offload_ksp->ks_data = zos;
+		kstat_install(zio_offload_ksp);
+	}
+}
+
+void
+zio_offload_fini(void)
+{
+	ASSERT0(zio_offload_count);
+
+	if (zio_offload_ksp != NULL) {
+		kstat_delete(zio_offload_ksp);
+		zio_offload_ksp = NULL;
+	}
+
+	rw_destroy(&zio_offload_lock);
+}
+
+int
+zio_offload_register(const zio_offload_provider_t *zop)
+{
+	int error = SET_ERROR(ENOSPC);
+
+	ASSERT3P(zop->zop_usable, !=, NULL);
+
+	rw_enter(&zio_offload_lock, RW_WRITER);
+	for (int i = 0; i < ZIO_OFFLOAD_MAX_PROVIDERS; i++) {
+		ASSERT3P(zio_offload_providers[i], !=, zop);
+		if (zio_offload_providers[i] == NULL) {
+			zio_offload_providers[i] = zop;
+			atomic_inc_uint(&zio_offload_count);
+			error = 0;
+			break;
+		}
+	}
+	rw_exit(&zio_offload_lock);
+
+	if (error == 0)
+		zfs_dbgmsg("registered offload provider %s", zop->zop_name);
+	return (error);
+}
+
+void
+zio_offload_unregister(const zio_offload_provider_t *zop)
+{
+	rw_enter(&zio_offload_lock, RW_WRITER);
+	for (int i = 0; i < ZIO_OFFLOAD_MAX_PROVIDERS; i++) {
+		if (zio_offload_providers[i] == zop) {
+			zio_offload_providers[i] = NULL;
+			atomic_dec_uint(&zio_offload_count);
+			break;
+		}
+	}
+	rw_exit(&zio_offload_lock);
+}
+
+boolean_t
+zio_offload_usable(zio_offload_op_t op, uint64_t alg, size_t len)
+{
+	boolean_t usable = B_FALSE;
+
+	if (zio_offload_count == 0 || zio_offload_disable)
+		return (B_FALSE);
+
+	rw_enter(&zio_offload_lock, RW_READER);
+	for (int i = 0; i < ZIO_OFFLOAD_MAX_PROVIDERS && !usable; i++) {
+		const zio_offload_provider_t *zop = zio_offload_providers[i];
+		if (zop != NULL)
+			usable = zop->zop_usable(op, alg, len);
+	}
+	rw_exit(&zio_offload_lock);
+
+	return (usable);
+}
+
+/*
+ * Finish a request: count it, and map any provider failure other than
+ * incompressible data to ENOTSUP so the caller uses software.
+ */
+static int
+zio_offload_done(zio_offload_op_t op, int error)
+{
+	if (error == 0 || error == E2BIG) {
+		atomic_inc_64(&zio_offload_stats.zos_offloaded[op].value.ui64);
+		return (error);
+	}
+
+	atomic_inc_64(&zio_offload_stats.zos_fallback[op].value.ui64);
+	return (SET_ERROR(ENOTSUP));
+}
+
+#define	ZIO_OFFLOAD_FOREACH(zop, op, alg, len)				\
+	for (int i_ = 0; i_ < ZIO_OFFLOAD_MAX_PROVIDERS; i_++)		\
+		if (((zop) = zio_offload_providers[i_]) != NULL &&	\
+		    (zop)->zop_usable((op), (alg), (len)))
+
+int
+zio_offload_compress(zio_offload_op_t op, enum zio_compress alg, int level,
+    void *src, size_t s_len, void *dst, size_t d_len, size_t *c_len)
+{
+	const zio_offload_provider_t *zop;
+	int error = SET_ERROR(ENOTSUP);
+
+	ASSERT(op == ZIO_OFFLOAD_COMPRESS || op == ZIO_OFFLOAD_DECOMPRESS);
+
+	if (zio_offload_count == 0 || zio_offload_disable)
+		return (error);
+
+	rw_enter(&zio_offload_lock, RW_READER);
+	ZIO_OFFLOAD_FOREACH(zop, op, alg, op == ZIO_OFFLOAD_COMPRESS ?
+	    s_len : d_len) {
+		if (zop->zop_compress == NULL)
+			continue;
+		error = zop->zop_compress(op, alg, level, src, s_len, dst,
+		    d_len, c_len);
+		if (error == 0 || error == E2BIG)
+			break;
+	}
+	rw_exit(&zio_offload_lock);
+
+	return (zio_offload_done(op, error));
+}
+
+int
+zio_offload_checksum(enum zio_checksum alg, void *buf, size_t size,
+    zio_cksum_t *zcp)
+{
+	const zio_offload_provider_t *zop;
+	int error = SET_ERROR(ENOTSUP);
+
+	if (zio_offload_count == 0 || zio_offload_disable)
+		return (error);
+
+	rw_enter(&zio_offload_lock, RW_READER);
+	ZIO_OFFLOAD_FOREACH(zop, ZIO_OFFLOAD_CHECKSUM, alg, size) {
+		if (zop->zop_checksum == NULL)
+			continue;
+		error = zop->zop_checksum(alg, buf, size, zcp);
+		if (error == 0)
+			break;
+	}
+	rw_exit(&zio_offload_lock);
+
+	return (zio_offload_done(ZIO_OFFLOAD_CHECKSUM, error));
+}
+
+int
+zio_offload_crypt(zio_offload_op_t op, uint64_t crypt, crypto_key_t *key,
+    uint8_t *src, uint8_t *dst, uint8_t *aad, uint_t aad_len, uint8_t *iv,
+    uint8_t *digest, uint_t len)
+{
+	const zio_offload_provider_t *zop;
+	int error = SET_ERROR(ENOTSUP);
+
+	ASSERT(op == ZIO_OFFLOAD_ENCRYPT || op == ZIO_OFFLOAD_DECRYPT);
+
+	if (zio_offload_count == 0 || zio_offload_disable)
+		return (error);
+
+	rw_enter(&zio_offload_lock, RW_READER);
+	ZIO_OFFLOAD_FOREACH(zop, op, crypt, len) {
+		if (zop->zop_crypt == NULL)
+			continue;
+		error = zop->zop_crypt(op, crypt, key, src, dst, aad, aad_len,
+		    iv, digest, len);
+		if (error == 0)
+			break;
+	}
+	rw_exit(&zio_offload_lock);
+
+	return (zio_offload_done(op, error));
+}
+
+EXPORT_SYMBOL(zio_offload_register);
+EXPORT_SYMBOL(zio_offload_unregister);
+
+ZFS_MODULE_PARAM(zfs, zio_, offload_disable, INT, ZMOD_RW,
+	"Disable hardware offload providers");
@@ -93,6 +93,8 @@ unsigned int zvol_volmode = ZFS_VOLMODE_GEOM;
 unsigned int zvol_threads = 0;
 unsigned int zvol_num_taskqs = 0;
 unsigned int zvol_request_sync = 0;
+static unsigned int zvol_write_prefetch = 1;
+static unsigned int zvol_create_minors_threads = 1;
 
 struct hlist_head *zvol_htable;
 static list_t zvol_state_list;
@@ -856,6 +858,36 @@ zil_replay_func_t *const zvol_replay_vector[TX_MAX_TYPE] = {
 	zvol_replay_clone_range,	/* TX_CLONE_RANGE */
 };
 
+/*
+ * A write that covers only part of a volblocksize block must read the rest
+ * of the block before it can dirty it, and does so synchronously while
+ * holding the range lock (see dmu_tx_count_write()).  Start those reads
+ * when the write is queued, so they overlap the time it spends waiting for
+ * a taskq thread.  Further sub-block writes to the same block in the same
+ * txg are already absorbed by the dbuf dirty record and only dirty it once.
+ */
+void
+zvol_prefetch_partial(zvol_state_t *zv, uint64_t off, uint64_t len)
+{
+	uint64_t bs = zv->zv_volblocksize;
+	uint64_t end = off + len;
+
+	if (zvol_write_prefetch == 0 || len == 0 || zv->zv_dn == NULL)
+		return;
+
+	boolean_t head = P2PHASE(off, bs) != 0;
+	if (head) {
+		dmu_prefetch_by_dnode(zv->zv_dn, 0, off, 1,
+		    ZIO_PRIORITY_SYNC_READ);
+	}
+	if (P2PHASE(end, bs) != 0 && end < zv->zv_volsize &&
+	    !(head && P2ALIGN_TYPED(off, bs, uint64_t) ==
+	    P2ALIGN_TYPED(end, bs, uint64_t))) {
+		dmu_prefetch_by_dnode(zv->zv_dn, 0, end, 1,
+		    ZIO_PRIORITY_SYNC_READ);
+	}
+}
+
 /*
  * zvol_log_write() handles synchronous writes using TX_WRITE ZIL transactions.
  *
@@ -1275,6 +1307,14 @@ zvol_prefetch_minors_impl(void *arg)
 	}
 }
 
+static void
+zvol_create_minor_task(void *arg)
+{
+	minors_job_t *job = arg;
+
+	(void) zvol_os_create_minor(job->name);
+}
+
 /*
  * Mask errors to continue dmu_objset_find() traversal
  */
@@ -1489,12 +1529,31 @@ zvol_create_minors_recursive(const char *name)
 	taskq_wait_outstanding(system_taskq, 0);
 
 	/*
-	 * Prefetch is completed, we can do zvol_os_create_minor
-	 * sequentially.
+	 * Prefetch is completed, we can do zvol_os_create_minor.  Each
+	 * minor owns its objset and may replay its ZIL, which dominates
+	 * import time with many zvols, so spread them over up to
+	 * zvol_create_minors_threads threads.
 	 */
-	while ((job = list_remove_head(&minors_list)) != NULL) {
-		if (!job->error)
+	taskq_t *tq = NULL;
+	if (zvol_create_minors_threads > 1 &&
+	    list_head(&minors_list) != list_tail(&minors_list)) {
+		tq = taskq_create("z_zvol_minors", zvol_create_minors_threads,
+		    defclsyspri, 1, INT_MAX, TASKQ_DYNAMIC);
+	}
+	for (job = list_head(&minors_list); job != NULL;
+	    job = list_next(&minors_list, job)) {
+		if (job->error)
+			continue;
+		if (tq == NULL || taskq_dispatch(tq, zvol_create_minor_task,
+		    job, TQ_SLEEP) == TASKQID_INVALID)
 			(void) zvol_os_create_minor(job->name);
+	}
+	if (tq != NULL) {
+		taskq_wait(tq);
+		taskq_destroy(tq);
+	}
+
+	while ((job = list_remove_head(&minors_list)) != NULL) {
 		kmem_strfree(job->name);
 		kmem_free(job, sizeof (minors_job_t));
 	}
@@ -2160,3 +2219,7 @@ ZFS_MODULE_PARAM(zfs, , zvol_num_taskqs, UINT, ZMOD_RW,
 	"Number of zvol taskqs");
 ZFS_MODULE_PARAM(zfs, , zvol_request_sync, UINT, ZMOD_RW,
 	"Synchronously handle bio requests");
+ZFS_MODULE_PARAM(zfs, , zvol_create_minors_threads, UINT, ZMOD_RW,
+	"Number of threads creating zvol minors at import");
+ZFS_MODULE_PARAM(zfs, , zvol_write_prefetch, UINT, ZMOD_RW,
+	"Prefetch partially written blocks when queueing zvol writes");
@@ -86,6 +86,7 @@ my $tagged_patterns = q(
 	cmd/arcstat.in
 	cmd/arc_summary
 	cmd/dbufstat.in
+	cmd/dsiostat.in
 	cmd/zilstat.in
 	cmd/zpool/zpool.d/*
 	etc/init.d/zfs-import.in
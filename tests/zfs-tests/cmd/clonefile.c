@@ -40,6 +40,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/fs/zfs.h>
 
 #ifndef __NR_copy_file_range
 #if defined(__x86_64__)
@@ -132,6 +133,7 @@ typedef enum {
 	CF_MODE_CLONERANGE,
 	CF_MODE_COPYFILERANGE,
 	CF_MODE_DEDUPERANGE,
+	CF_MODE_CLONEBATCH,
 } cf_mode_t;
 
 static int
@@ -146,7 +148,10 @@ usage(void)
 	    "  copy_file_range:\n"
 	    "    clonefile -f <src> <dst> [<soff> <doff> <len | \"all\">]\n"
 	    "  FIDEDUPERANGE:\n"
-	    "    clonefile -d <src> <dst> <soff> <doff> <len>\n");
+	    "    clonefile -d <src> <dst> <soff> <doff> <len>\n"
+	    "  ZFS_IOC_CLONE_BATCH:\n"
+	    "    clonefile -b <src> <dst> <soff> <doff> <len> "
+	    "[<soff> <doff> <len> ...]\n");
 	return (1);
 }
 
@@ -154,6 +159,7 @@ int do_clone(int sfd, int dfd);
 int do_clonerange(int sfd, int dfd, loff_t soff, loff_t doff, size_t len);
 int do_copyfilerange(int sfd, int dfd, loff_t soff, loff_t doff, size_t len);
 int do_deduperange(int sfd, int dfd, loff_t soff, loff_t doff, size_t len);
+int do_clonebatch(int sfd, int dfd, int nranges, char **ranges);
 
 int quiet = 0;
 
@@ -163,7 +169,7 @@ main(int argc, char **argv)
 	cf_mode_t mode = CF_MODE_NONE;
 
 	int c;
-	while ((c = getopt(argc, argv, "crfdq")) != -1) {
+	while ((c = getopt(argc, argv, "crfdbq")) != -1) {
 		switch (c) {
 			case 'c':
 				mode = CF_MODE_CLONE;
@@ -177,6 +183,9 @@ main(int argc, char **argv)
 			case 'd':
 				mode = CF_MODE_DEDUPERANGE;
 				break;
+			case 'b':
+				mode = CF_MODE_CLONEBATCH;
+				break;
 			case 'q':
 				quiet = 1;
 				break;
@@ -199,6 +208,10 @@ main(int argc, char **argv)
 			if ((argc-optind) != 2 && (argc-optind) != 5)
 				return (usage());
 			break;
+		case CF_MODE_CLONEBATCH:
+			if ((argc-optind) < 5 || (argc-optind-2) % 3 != 0)
+				return (usage());
+			break;
 		default:
 			abort();
 	}
@@ -206,7 +219,7 @@ main(int argc, char **argv)
 	loff_t soff = 0, doff = 0;
 	size_t len = SSIZE_MAX;
 	unsigned long long len2;
-	if ((argc-optind) == 5) {
+	if ((argc-optind) == 5 && mode != CF_MODE_CLONEBATCH) {
 		soff = strtoull(argv[optind+2], NULL, 10);
 		if (soff == ULLONG_MAX) {
 			fprintf(stderr, "invalid source offset");
@@ -261,6 +274,10 @@ main(int argc, char **argv)
 		case CF_MODE_DEDUPERANGE:
 			err = do_deduperange(sfd, dfd, soff, doff, len);
 			break;
+		case CF_MODE_CLONEBATCH:
+			err = do_clonebatch(sfd, dfd, (argc-optind-2) / 3,
+			    &argv[optind+2]);
+			break;
 		default:
 			abort();
 	}
@@ -374,3 +391,52 @@ do_deduperange(int sfd, int dfd, loff_t soff, loff_t doff, size_t len)
 
 	return (err);
 }
+
+int
+do_clonebatch(int sfd, int dfd, int nranges, char **ranges)
+{
+	if (!quiet)
+		fprintf(stderr, "using ZFS_IOC_CLONE_BATCH\n");
+
+	zfs_clone_range_ent_t *ents = calloc(nranges, sizeof (*ents));
+	if (ents == NULL) {
+		perror("calloc");
+		return (1);
+	}
+	for (int i = 0; i < nranges; i++) {
+		ents[i].zcre_src_fd = sfd;
+		ents[i].zcre_src_off = strtoull(ranges[i*3], NULL, 10);
+		ents[i].zcre_dst_fd = dfd;
+		ents[i].zcre_dst_off = strtoull(ranges[i*3+1], NULL, 10);
+		ents[i].zcre_len = strtoull(ranges[i*3+2], NULL, 10);
+	}
+
+	zfs_clone_batch_args_t args = {
+		.zcba_ents = (uint64_t)(uintptr_t)ents,
+		.zcba_count = nranges,
+	};
+	int err = ioctl(dfd, ZFS_IOC_CLONE_BATCH, &args);
+	if (err < 0) {
+		fprintf(stderr, "ioctl(ZFS_IOC_CLONE_BATCH): %s\n",
+		    strerror(errno));
+		free(ents);
+		return (err);
+	}
+	if (args.zcba_done != nranges) {
+		fprintf(stderr, "clone batch: processed %llu of %d ranges\n",
+		    (unsigned long long)args.zcba_done, nranges);
+		err = -1;
+	}
+	for (int i = 0; i < args.zcba_done; i++) {
+		if (ents[i].zcre_error != 0) {
+			fprintf(stderr, "clone batch: range %d: %s\n", i,
+			    strerror(ents[i].zcre_error));
+			err = -1;
+		} else if (!quiet) {
+			fprintf(stderr, "clone batch: range %d: cloned %llu\n",
+			    i, (unsigned long long)ents[i].zcre_len);
+		}
+	}
+	free(ents);
+	return (err);
+}
@@ -58,6 +58,7 @@ typedef enum {
 	ALG_NONE,
 	ALG_AES_GCM,
 	ALG_AES_CCM,
+	ALG_CHACHA20_POLY1305,
 } crypto_test_alg_t;
 
 /*
@@ -320,6 +321,8 @@ load_tests(const char *filepath, crypto_test_alg_t *algp)
 					alg = ALG_AES_GCM;
 				else if (strcmp(v, "AES-CCM") == 0)
 					alg = ALG_AES_CCM;
+				else if (strcmp(v, "ChaCha20-Poly1305") == 0)
+					alg = ALG_CHACHA20_POLY1305;
 				else {
 					fprintf(stderr,
 					    "E: unknown algorithm [%s:%d]: "
@@ -529,6 +532,14 @@ static const char *aes_gcm_impl[][2] = {
 	{ "aesni",   "pclmulqdq" },
 	{ "x86_64",  "avx" },
 	{ "aesni",   "avx" },
+	{ "x86_64",  "avx512" },
+	{ "aesni",   "avx512" },
+};
+
+static const char *chacha20_impl[] = {
+	"generic",
+	"avx2",
+	"neon",
 };
 
 /* signature of function to call after setting implementation params */
@@ -584,6 +595,26 @@ foreach_aes_gcm(alg_cb_t cb, void *arg, crypto_test_outmode_t outmode)
 	}
 }
 
+/* loop over each ChaCha20 implementation */
+static void
+foreach_chacha20_poly1305(alg_cb_t cb, void *arg,
+    crypto_test_outmode_t outmode)
+{
+	char alginfo[64];
+
+	for (int i = 0; i < ARRAY_SIZE(chacha20_impl); i++) {
+		snprintf(alginfo, sizeof (alginfo), "ChaCha20-Poly1305 [%s]",
+		    chacha20_impl[i]);
+
+		int err = -chacha20_impl_set(chacha20_impl[i]);
+		if (err != 0 && outmode != OUT_SUMMARY)
+			printf("W: %s couldn't enable ChaCha20 impl '%s': "
+			    "%s\n", alginfo, chacha20_impl[i], strerror(err));
+
+		cb(alginfo, (err == 0) ? arg : NULL);
+	}
+}
+
 /* ========== */
 
 /* ICP lowlevel drivers */
@@ -633,6 +664,18 @@ init_mech(crypto_mechanism_t *mech, crypto_test_alg_t alg,
 		p->ulDataSize = msglen + (decrypt ? taglen : 0);
 		break;
 	}
+	case ALG_CHACHA20_POLY1305: {
+		mech->cm_type = crypto_mech2id(SUN_CKM_CHACHA20_POLY1305);
+		mech->cm_param_len =
+		    sizeof (CK_SALSA20_CHACHA20_POLY1305_PARAMS);
+		CK_SALSA20_CHACHA20_POLY1305_PARAMS *p =
+		    (CK_SALSA20_CHACHA20_POLY1305_PARAMS *)mech->cm_param;
+		p->pNonce = iv;
+		p->ulNonceLen = ivlen;
+		p->pAAD = aad;
+		p->ulAADLen = aadlen;
+		break;
+	}
 	default:
 		abort();
 	}
@@ -945,6 +988,7 @@ run_tests(const char *alginfo, const crypto_test_t *tests,
 	union {
 		CK_AES_GCM_PARAMS gcm;
 		CK_AES_CCM_PARAMS ccm;
+		CK_SALSA20_CHACHA20_POLY1305_PARAMS chacha;
 	} params = {};
 	mech.cm_param = (caddr_t)&params;
 
@@ -1030,6 +1074,9 @@ runtests_main(const char *filename, crypto_test_outmode_t outmode)
 	case ALG_AES_GCM:
 		foreach_aes_gcm(run_test_alg_cb, &args, outmode);
 		break;
+	case ALG_CHACHA20_POLY1305:
+		foreach_chacha20_poly1305(run_test_alg_cb, &args, outmode);
+		break;
 	default:
 		abort();
 	}
@@ -1098,6 +1145,7 @@ perf_alg_cb(const char *alginfo, void *arg)
 	union {
 		CK_AES_GCM_PARAMS gcm;
 		CK_AES_CCM_PARAMS ccm;
+		CK_SALSA20_CHACHA20_POLY1305_PARAMS chacha;
 	} params = {};
 	mech.cm_param = (caddr_t)&params;
 
@@ -1140,6 +1188,8 @@ perf_main(const char *algname, crypto_test_outmode_t outmode)
 		args.alg = ALG_AES_CCM;
 	else if (strcmp(algname, "AES-GCM") == 0)
 		args.alg = ALG_AES_GCM;
+	else if (strcmp(algname, "ChaCha20-Poly1305") == 0)
+		args.alg = ALG_CHACHA20_POLY1305;
 	else {
 		fprintf(stderr, "E: unknown algorithm: %s\n", algname);
 		return (1);
@@ -1183,6 +1233,9 @@ perf_main(const char *algname, crypto_test_outmode_t outmode)
 	case ALG_AES_GCM:
 		foreach_aes_gcm(perf_alg_cb, &args, outmode);
 		break;
+	case ALG_CHACHA20_POLY1305:
+		foreach_chacha20_poly1305(perf_alg_cb, &args, outmode);
+		break;
 	default:
 		abort();
 	}
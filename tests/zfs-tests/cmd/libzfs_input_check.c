@@ -745,6 +745,52 @@ test_get_bookmark_props(const char *bookmark)
 	IOC_INPUT_TEST(ZFS_IOC_GET_BOOKMARK_PROPS, bookmark, NULL, NULL, 0);
 }
 
+static void
+test_list_bulk(const char *dataset)
+{
+	nvlist_t *optional = fnvlist_alloc();
+	nvlist_t *props = fnvlist_alloc();
+
+	fnvlist_add_boolean(props, "used");
+	fnvlist_add_uint64(optional, ZFS_LIST_BULK_CURSOR, 0);
+	fnvlist_add_uint64(optional, ZFS_LIST_BULK_COUNT, 16);
+	fnvlist_add_boolean(optional, ZFS_LIST_BULK_SNAPSHOTS);
+	fnvlist_add_boolean(optional, ZFS_LIST_BULK_SIMPLE);
+	fnvlist_add_nvlist(optional, ZFS_LIST_BULK_PROPS, props);
+	fnvlist_add_uint64(optional, SNAP_ITER_MIN_TXG, 1);
+	fnvlist_add_uint64(optional, SNAP_ITER_MAX_TXG, UINT64_MAX);
+
+	IOC_INPUT_TEST(ZFS_IOC_LIST_BULK, dataset, NULL, optional, 0);
+
+	nvlist_free(props);
+	nvlist_free(optional);
+}
+
+static void
+test_objs_to_stats(const char *snapshot)
+{
+	nvlist_t *required = fnvlist_alloc();
+	uint64_t objs[] = { 1, 2 };
+
+	fnvlist_add_uint64_array(required, ZFS_OBJS_STATS_OBJECTS, objs, 2);
+
+	IOC_INPUT_TEST(ZFS_IOC_OBJS_TO_STATS, snapshot, required, NULL, 0);
+
+	nvlist_free(required);
+}
+
+static void
+test_prefetch(const char *dataset)
+{
+	nvlist_t *optional = fnvlist_alloc();
+
+	fnvlist_add_uint64(optional, ZFS_PREFETCH_RATE, 1ULL << 30);
+
+	IOC_INPUT_TEST(ZFS_IOC_PREFETCH, dataset, NULL, optional, 0);
+
+	nvlist_free(optional);
+}
+
 static void
 test_wait(const char *pool)
 {
@@ -851,6 +897,9 @@ zfs_ioc_input_tests(const char *pool)
 	test_bookmark(pool, snapshot, bookmark);
 	test_get_bookmarks(dataset);
 	test_get_bookmark_props(bookmark);
+	test_list_bulk(dataset);
+	test_objs_to_stats(snapshot);
+	test_prefetch(dataset);
 	test_destroy_bookmarks(pool, bookmark);
 
 	test_hold(pool, snapshot);
@@ -1040,6 +1089,9 @@ validate_ioc_values(void)
 	CHECK(ZFS_IOC_BASE + 83 == ZFS_IOC_WAIT);
 	CHECK(ZFS_IOC_BASE + 84 == ZFS_IOC_WAIT_FS);
 	CHECK(ZFS_IOC_BASE + 87 == ZFS_IOC_POOL_SCRUB);
+	CHECK(ZFS_IOC_BASE + 90 == ZFS_IOC_LIST_BULK);
+	CHECK(ZFS_IOC_BASE + 91 == ZFS_IOC_OBJS_TO_STATS);
+	CHECK(ZFS_IOC_BASE + 92 == ZFS_IOC_PREFETCH);
 	CHECK(ZFS_IOC_PLATFORM_BASE + 1 == ZFS_IOC_EVENTS_NEXT);
 	CHECK(ZFS_IOC_PLATFORM_BASE + 2 == ZFS_IOC_EVENTS_CLEAR);
 	CHECK(ZFS_IOC_PLATFORM_BASE + 3 == ZFS_IOC_EVENTS_SEEK);